@@ -142,5 +142,14 @@ bad_alignment::bad_alignment(size_t a):
     arbor_exception(pprintf("Mechanism reported unsupported alignment '{}'", a)),
     alignment{a} {}
 
+bad_checkpoint::bad_checkpoint(const std::string& msg):
+    arbor_exception(pprintf("bad simulation checkpoint: {}", msg)) {}
+
+bad_sample_file::bad_sample_file(const std::string& msg):
+    arbor_exception(pprintf("sample file error: {}", msg)) {}
+
+bad_spike_file::bad_spike_file(const std::string& msg):
+    arbor_exception(pprintf("spike file error: {}", msg)) {}
+
 } // namespace arb
 
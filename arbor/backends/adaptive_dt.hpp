@@ -0,0 +1,44 @@
+#pragma once
+
+// Step size control of adaptive time steps, common to the back ends.
+//
+// Each integration domain steps with dt·2^level for the base step dt. After a
+// step of length h1 that followed a step of length h0, the second derivative
+// of the voltage of a CV is estimated from its voltages at the start of both
+// steps and at the end of the step, and the local error of the step by
+// h1²/2 times the largest second derivative of the domain. The next step is
+// the largest power of two multiple of dt below 0.9·h1·sqrt(tolerance/error),
+// at a level at most one above the current one. Steps are not rejected.
+
+#include <cmath>
+
+#if defined(__CUDACC__) || defined(__HIPCC__)
+#   define ARB_ADAPTIVE_DT_HOST_DEVICE __host__ __device__
+#else
+#   define ARB_ADAPTIVE_DT_HOST_DEVICE
+#endif
+
+namespace arb {
+
+// Estimate of |d²v/dt²| [mV/ms²] from the voltages at t-h0, t and t+h1, or
+// zero if either step is empty.
+ARB_ADAPTIVE_DT_HOST_DEVICE
+inline double adaptive_dt_curvature(double v_prev, double v_start, double v, double h0, double h1) {
+    if (h0<=0 || h1<=0) return 0;
+    return 2*std::fabs((v-v_start)/h1 - (v_start-v_prev)/h0)/(h0+h1);
+}
+
+// Level of the next step after a step of length h1, following one of h0,
+// with the given curvature estimate. Without a previous step, the level is
+// kept.
+ARB_ADAPTIVE_DT_HOST_DEVICE
+inline int adaptive_dt_level(int level, int max_level, double curvature, double h0, double h1, double dt, double tolerance) {
+    if (h0<=0 || h1<=0) return level;
+    int grow = level<max_level? level+1: max_level;
+    double err = 0.5*h1*h1*curvature;
+    if (!(err>0)) return grow;
+    int l = (int)std::floor(std::log2(0.9*h1*std::sqrt(tolerance/err)/dt));
+    return l<0? 0: l>grow? grow: l;
+}
+
+} // namespace arb
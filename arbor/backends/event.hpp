@@ -30,11 +30,26 @@ struct deliverable_event {
         time(time), weight(weight), handle(handle) {}
 };
 
+// A connection from a spike source onto a target handle, for back ends
+// that generate deliverable events from spikes themselves.
+struct target_connection {
+    cell_member_type source;
+    target_handle target;
+    float weight;
+    float delay;
+};
+
 // Stream index accessor function for multi_event_stream:
 inline cell_size_type event_index(const deliverable_event& ev) {
     return ev.handle.intdom_index;
 }
 
+// Partition key accessor function for multi_event_stream: the events of
+// each mechanism can be held in streams of their own.
+inline cell_local_size_type event_partition(const deliverable_event& ev) {
+    return ev.handle.mech_id;
+}
+
 // Subset of event information required for mechanism delivery.
 struct deliverable_event_data {
     cell_local_size_type mech_id;    // same as target_handle::mech_id
@@ -71,5 +86,9 @@ inline cell_size_type event_index(const sample_event& ev) {
     return ev.intdom_index;
 }
 
+inline cell_local_size_type event_partition(const sample_event&) {
+    return 0;
+}
+
 
 } // namespace arb
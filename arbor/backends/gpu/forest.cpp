@@ -1,3 +1,8 @@
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
 #include "backends/gpu/forest.hpp"
 #include "util/span.hpp"
 
@@ -118,6 +123,101 @@ void forest::optimize() {
     }
 }
 
+std::vector<unsigned> forest::pack_blocks(unsigned max_branches_per_level) {
+    using util::make_span;
+
+    // Number of branches and longest branch at each depth.
+    struct profile {
+        std::vector<unsigned> count;
+        std::vector<unsigned> length;
+    };
+
+    auto num_cells = trees.size();
+    std::vector<profile> cells(num_cells);
+    std::vector<unsigned> cost(num_cells, 0);
+    for (auto c: make_span(num_cells)) {
+        auto depths = depth_from_root(trees[c]);
+        auto& prof = cells[c];
+        for (auto i: make_span(depths.size())) {
+            auto d = depths[i];
+            if (d>=prof.count.size()) {
+                prof.count.resize(d+1, 0);
+                prof.length.resize(d+1, 0);
+            }
+            prof.count[d] += 1;
+            prof.length[d] = std::max(prof.length[d], tree_branch_lengths[c][i]);
+        }
+        for (auto d: make_span(prof.count.size())) {
+            if (prof.count[d]>max_branches_per_level) {
+                throw std::runtime_error(
+                    "Could not fit " + std::to_string(prof.count[d])
+                    + " branches in a block of size "
+                    + std::to_string(max_branches_per_level));
+            }
+            cost[c] += prof.length[d];
+        }
+    }
+
+    std::vector<unsigned> order(num_cells);
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&cost](unsigned a, unsigned b) { return cost[a]>cost[b]; });
+
+    // Blocks that can take further cells: every cell has a branch at depth
+    // zero, so a block is closed when that level is full. Only the most
+    // recently opened blocks are searched, bounding the set up time.
+    constexpr unsigned max_open = 64;
+    std::vector<profile> blocks;
+    std::vector<unsigned> open;
+    std::vector<unsigned> block_of(num_cells);
+
+    for (auto c: order) {
+        const auto& prof = cells[c];
+        unsigned best = -1;
+        unsigned best_increase = -1;
+        for (auto b: open) {
+            const auto& blk = blocks[b];
+            unsigned increase = 0;
+            bool fits = true;
+            for (auto d: make_span(prof.count.size())) {
+                unsigned count = d<blk.count.size()? blk.count[d]: 0;
+                unsigned length = d<blk.length.size()? blk.length[d]: 0;
+                if (count+prof.count[d]>max_branches_per_level) {
+                    fits = false;
+                    break;
+                }
+                increase += std::max(length, prof.length[d]) - length;
+            }
+            if (fits && increase<best_increase) {
+                best = b;
+                best_increase = increase;
+            }
+        }
+
+        if (best==unsigned(-1)) {
+            best = blocks.size();
+            blocks.emplace_back();
+            open.push_back(best);
+            if (open.size()>max_open) open.erase(open.begin());
+        }
+
+        auto& blk = blocks[best];
+        if (prof.count.size()>blk.count.size()) {
+            blk.count.resize(prof.count.size(), 0);
+            blk.length.resize(prof.count.size(), 0);
+        }
+        for (auto d: make_span(prof.count.size())) {
+            blk.count[d] += prof.count[d];
+            blk.length[d] = std::max(blk.length[d], prof.length[d]);
+        }
+        if (blk.count[0]==max_branches_per_level) {
+            open.erase(std::find(open.begin(), open.end(), best));
+        }
+        block_of[c] = best;
+    }
+
+    return block_of;
+}
+
 
 // debugging functions:
 
@@ -14,6 +14,18 @@ struct forest {
 
     void optimize();
 
+    // Assign the cells to GPU blocks of the fine solver, such that no level of
+    // a block holds more than `max_branches_per_level` branches, and return
+    // the block of each cell.
+    //
+    // A level takes as many steps as its longest branch, so the cost of a
+    // block is the sum over levels of the longest branch at that depth. Cells
+    // are placed in order of decreasing cost, each in the open block whose
+    // cost it raises least, so that cells of similar shape share blocks and
+    // the threads of small cells do not idle through the long levels of large
+    // ones.
+    std::vector<unsigned> pack_blocks(unsigned max_branches_per_level);
+
     unsigned num_trees() {
         return fine_trees.size();
     }
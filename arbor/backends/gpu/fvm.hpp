@@ -17,6 +17,9 @@
 #include "threshold_watcher.hpp"
 
 #include "matrix_state_fine.hpp"
+#include "sample_buffer.hpp"
+#include "spike_delivery.hpp"
+#include "step_graph.hpp"
 
 namespace arb {
 namespace gpu {
@@ -51,6 +54,15 @@ struct backend {
     using shared_state = arb::gpu::shared_state;
     using ion_state = arb::gpu::ion_state;
 
+    using step_graph = arb::gpu::step_graph;
+    using spike_delivery = arb::gpu::spike_delivery;
+    using sample_buffer = arb::gpu::sample_buffer;
+
+    // Mechanisms are updated by a single kernel launch each.
+    struct mechanism_slices {
+        static constexpr bool supported = false;
+    };
+
     static threshold_watcher voltage_watcher(
         shared_state& state,
         const std::vector<index_type>& cv,
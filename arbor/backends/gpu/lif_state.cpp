@@ -0,0 +1,113 @@
+#include <vector>
+
+#include "backends/gpu/lif_state.hpp"
+#include "gpu_context.hpp"
+#include "memory/gpu_wrappers.hpp"
+#include "memory/memory.hpp"
+
+namespace arb {
+namespace gpu {
+
+// Implemented in the lif_state.cu file, which is separately compiled by
+// nvcc, to protect nvcc from having to parse C++17.
+void advance_lif_w(unsigned n_cell,
+        fvm_value_type t_until,
+        const fvm_value_type* tau_m_inv,
+        const fvm_value_type* C_m_inv,
+        const fvm_value_type* V_th,
+        const fvm_value_type* E_L,
+        const fvm_value_type* t_ref,
+        fvm_value_type* V_m,
+        fvm_value_type* t_last,
+        const fvm_index_type* offsets,
+        const fvm_value_type* times,
+        const float* weights,
+        fvm_value_type* spike_times);
+
+// Reallocate `a`, discarding its contents, if it holds fewer than n elements.
+template <typename Array>
+static void grow(Array& a, std::size_t n) {
+    if (a.size()<n) a = Array(n);
+}
+
+// Select the device and stream of the cell group for the duration of a call.
+namespace {
+    struct stream_guard {
+        const gpu_context& gpu;
+
+        stream_guard(const gpu_context& gpu, unsigned stream): gpu(gpu) {
+            gpu.set_gpu();
+            gpu.set_stream(stream);
+        }
+
+        ~stream_guard() { gpu.set_default_stream(); }
+    };
+}
+
+lif_state::lif_state(
+    gpu_context_handle gpu,
+    const std::vector<value_type>& tau_m_inv,
+    const std::vector<value_type>& C_m_inv,
+    const std::vector<value_type>& V_th,
+    const std::vector<value_type>& E_L,
+    const std::vector<value_type>& t_ref):
+    gpu_(std::move(gpu)),
+    stream_(gpu_->acquire_stream()),
+    n_cell_(tau_m_inv.size())
+{
+    stream_guard guard(*gpu_, stream_);
+
+    tau_m_inv_ = memory::on_gpu(tau_m_inv);
+    C_m_inv_ = memory::on_gpu(C_m_inv);
+    V_th_ = memory::on_gpu(V_th);
+    E_L_ = memory::on_gpu(E_L);
+    t_ref_ = memory::on_gpu(t_ref);
+
+    V_m_ = array(n_cell_);
+    t_last_ = array(n_cell_);
+}
+
+void lif_state::set_state(const value_type* V_m, const value_type* t_last) {
+    stream_guard guard(*gpu_, stream_);
+    memory::gpu_memcpy_h2d(V_m_.data(), V_m, n_cell_*sizeof(value_type));
+    memory::gpu_memcpy_h2d(t_last_.data(), t_last, n_cell_*sizeof(value_type));
+}
+
+void lif_state::get_state(value_type* V_m, value_type* t_last) const {
+    stream_guard guard(*gpu_, stream_);
+    memory::gpu_memcpy_d2h(V_m, V_m_.data(), n_cell_*sizeof(value_type));
+    memory::gpu_memcpy_d2h(t_last, t_last_.data(), n_cell_*sizeof(value_type));
+}
+
+void lif_state::advance(
+    value_type t_until,
+    const std::vector<index_type>& offsets,
+    const std::vector<value_type>& times,
+    const std::vector<float>& weights,
+    std::vector<value_type>& spike_times)
+{
+    const auto n_event = times.size();
+    spike_times.resize(n_event);
+    if (!n_event) return;
+
+    stream_guard guard(*gpu_, stream_);
+
+    grow(offsets_, n_cell_+1);
+    grow(times_, n_event);
+    grow(weights_, n_event);
+    grow(spike_times_, n_event);
+
+    memory::gpu_memcpy_h2d(offsets_.data(), offsets.data(), (n_cell_+1)*sizeof(index_type));
+    memory::gpu_memcpy_h2d(times_.data(), times.data(), n_event*sizeof(value_type));
+    memory::gpu_memcpy_h2d(weights_.data(), weights.data(), n_event*sizeof(float));
+
+    advance_lif_w(n_cell_, t_until,
+        tau_m_inv_.data(), C_m_inv_.data(), V_th_.data(), E_L_.data(), t_ref_.data(),
+        V_m_.data(), t_last_.data(),
+        offsets_.data(), times_.data(), weights_.data(), spike_times_.data());
+
+    memory::gpu_memcpy_d2h(spike_times.data(), spike_times_.data(), n_event*sizeof(value_type));
+}
+
+} // namespace gpu
+} // namespace arb
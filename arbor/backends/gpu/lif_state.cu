@@ -0,0 +1,84 @@
+#include <arbor/fvm_types.hpp>
+#include <arbor/gpu/gpu_common.hpp>
+
+namespace arb {
+namespace gpu {
+
+namespace kernels {
+    // Advance each cell through its events, as lif_cell_group::advance_cell.
+    template <typename T, typename I>
+    __global__ void advance_lif(
+        unsigned n_cell,
+        T t_until,
+        const T* __restrict__ const tau_m_inv,
+        const T* __restrict__ const C_m_inv,
+        const T* __restrict__ const V_th,
+        const T* __restrict__ const E_L,
+        const T* __restrict__ const t_ref,
+        T* __restrict__ const V_m,
+        T* __restrict__ const t_last,
+        const I* __restrict__ const offsets,
+        const T* __restrict__ const times,
+        const float* __restrict__ const weights,
+        T* __restrict__ const spike_times)
+    {
+        unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
+        if (i<n_cell) {
+            T t = t_last[i];
+            T v = V_m[i];
+            const I end = offsets[i+1];
+
+            for (I k = offsets[i]; k<end; ++k) {
+                spike_times[k] = -1;
+            }
+
+            for (I k = offsets[i]; k<end; ++k) {
+                const T time = times[k];
+                if (time<t) continue;       // in refractory period
+                if (time>=t_until) break;   // end of integration interval
+
+                // Sum the weights of simultaneous events.
+                const I first = k;
+                T weight = weights[k];
+                while (k+1<end && times[k+1]<=time) {
+                    weight += weights[++k];
+                }
+
+                v = v*exp(-(time-t)*tau_m_inv[i]) + weight*C_m_inv[i];
+                t = time;
+                if (v>=V_th[i]) {
+                    spike_times[first] = t;
+                    t += t_ref[i];
+                    v = E_L[i];
+                }
+            }
+
+            t_last[i] = t;
+            V_m[i] = v;
+        }
+    }
+} // namespace kernels
+
+void advance_lif_w(unsigned n_cell,
+        fvm_value_type t_until,
+        const fvm_value_type* tau_m_inv,
+        const fvm_value_type* C_m_inv,
+        const fvm_value_type* V_th,
+        const fvm_value_type* E_L,
+        const fvm_value_type* t_ref,
+        fvm_value_type* V_m,
+        fvm_value_type* t_last,
+        const fvm_index_type* offsets,
+        const fvm_value_type* times,
+        const float* weights,
+        fvm_value_type* spike_times)
+{
+    if (!n_cell) return;
+    const int nblock = impl::block_count(n_cell, 128);
+    kernels::advance_lif
+        <<<nblock, 128, 0, current_stream()>>>
+        (n_cell, t_until, tau_m_inv, C_m_inv, V_th, E_L, t_ref, V_m, t_last, offsets, times, weights, spike_times);
+}
+
+} // namespace gpu
+} // namespace arb
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+
+#include <arbor/common_types.hpp>
+#include <arbor/fvm_types.hpp>
+
+#include "gpu_context.hpp"
+#include "memory/memory.hpp"
+#include "util/rangeutil.hpp"
+
+namespace arb {
+namespace gpu {
+
+// Parameters and state of a group of LIF cells on the device.
+//
+// The cells are advanced with the exact update of lif_cell_group, by one
+// thread per cell, through the events of each cell, which are passed as a
+// sorted per-cell array. All calls issue their GPU work on a stream of the
+// GPU context reserved for the group.
+
+class lif_state {
+public:
+    using value_type = double;
+    using index_type = fvm_index_type;
+
+    lif_state(gpu_context_handle gpu,
+              const std::vector<value_type>& tau_m_inv,
+              const std::vector<value_type>& C_m_inv,
+              const std::vector<value_type>& V_th,
+              const std::vector<value_type>& E_L,
+              const std::vector<value_type>& t_ref);
+
+    unsigned size() const { return n_cell_; }
+
+    // Copy the membrane potentials and times of last update to and from the
+    // device.
+    void set_state(const value_type* V_m, const value_type* t_last);
+    void get_state(value_type* V_m, value_type* t_last) const;
+
+    // Advance the cells through the events before t_until. The events of
+    // cell i are [offsets[i], offsets[i+1]) of `times` and `weights`, in
+    // time order. On return, spike_times[k] is the time of the spike caused
+    // by event k, or negative if it caused none.
+    void advance(value_type t_until,
+                 const std::vector<index_type>& offsets,
+                 const std::vector<value_type>& times,
+                 const std::vector<float>& weights,
+                 std::vector<value_type>& spike_times);
+
+    // Bytes held on the device.
+    std::size_t bytes() const {
+        return util::size_in_bytes(tau_m_inv_, C_m_inv_, V_th_, E_L_, t_ref_, V_m_, t_last_,
+                                   offsets_, times_, weights_, spike_times_);
+    }
+
+private:
+    using array = memory::device_vector<value_type>;
+    using iarray = memory::device_vector<index_type>;
+
+    gpu_context_handle gpu_;
+    unsigned stream_ = 0;
+    unsigned n_cell_ = 0;
+
+    array tau_m_inv_;
+    array C_m_inv_;
+    array V_th_;
+    array E_L_;
+    array t_ref_;
+
+    array V_m_;
+    array t_last_;
+
+    // Event arrays, grown on demand.
+    iarray offsets_;
+    array times_;
+    memory::device_vector<float> weights_;
+    array spike_times_;
+};
+
+} // namespace gpu
+} // namespace arb
@@ -173,7 +173,7 @@ void assemble_matrix_flat(
 
     kernels::assemble_matrix_flat
         <fvm_value_type, fvm_index_type>
-        <<<grid_dim, block_dim>>>
+        <<<grid_dim, block_dim, 0, current_stream()>>>
         (d, rhs, invariant_d, voltage, current, conductivity, cv_capacitance,
          area, cv_to_cell, dt_intdom, cell_to_intdom, n);
 }
@@ -204,7 +204,7 @@ void assemble_matrix_interleaved(
 
     kernels::assemble_matrix_interleaved
         <fvm_value_type, fvm_index_type, bd, lw, block_dim>
-        <<<grid_dim, block_dim>>>
+        <<<grid_dim, block_dim, 0, current_stream()>>>
         (d, rhs, invariant_d, voltage, current, conductivity, cv_capacitance, area,
          sizes, starts, matrix_to_cell,
          dt_intdom, cell_to_intdom, padded_size, num_mtx);
@@ -34,6 +34,18 @@ constexpr inline unsigned matrix_padding() {
     return load_width();
 }
 
+// The largest cell, in CVs, that is assembled and solved by the fused
+// small cell kernel, and the number of threads assigned to each such cell.
+HOST_DEVICE_IF_GPU
+constexpr inline unsigned small_cell_max_size() {
+    return 64u;
+}
+
+HOST_DEVICE_IF_GPU
+constexpr inline unsigned small_cell_threads() {
+    return 32u;
+}
+
 // Placeholders to use for mark padded locations in data structures that use
 // padding. Using such markers makes it easier to test that padding is
 // performed correctly.
@@ -28,6 +28,20 @@ void gather(const T* __restrict__ const from,
     }
 }
 
+// to[i] = 2*from[p[i]] - to[i]
+template <typename T, typename I>
+__global__
+void gather_extrapolate(const T* __restrict__ const from,
+                        T* __restrict__ const to,
+                        const I* __restrict__ const p,
+                        unsigned n) {
+    unsigned i = threadIdx.x + blockDim.x*blockIdx.x;
+
+    if (i<n) {
+        to[i] = 2*from[p[i]] - to[i];
+    }
+}
+
 // to[p[i]] = from[i]
 template <typename T, typename I>
 __global__
@@ -62,6 +76,7 @@ void assemble_matrix_fine(
         const I* __restrict__ const cv_to_intdom,
         const T* __restrict__ const dt_intdom,
         const I* __restrict__ const perm,
+        T oodt_scale,
         unsigned n)
 {
     const unsigned tid = threadIdx.x + blockDim.x*blockIdx.x;
@@ -69,11 +84,13 @@ void assemble_matrix_fine(
         // The 1e-3 is a constant of proportionality required to ensure that the
         // conductance (gi) values have units μS (micro-Siemens).
         // See the model documentation in docs/model for more information.
+        // The capacitance term is scaled by oodt_scale, which is 1e-3, or
+        // 2e-3 for the half step of Crank–Nicolson integration.
         const auto dt = dt_intdom[cv_to_intdom[tid]];
         const auto p = dt > 0;
         const auto pid = perm[tid];
         const auto area_factor = T(1e-3)*area[tid];
-        const auto gi = T(1e-3)*cv_capacitance[tid]/dt + area_factor*conductivity[tid];
+        const auto gi = oodt_scale*cv_capacitance[tid]/dt + area_factor*conductivity[tid];
         const auto r_d = gi + invariant_d[tid];
         const auto r_rhs = gi*voltage[tid] - area_factor*current[tid];
 
@@ -243,6 +260,95 @@ void solve_matrix_fine(
     }
 }
 
+/// Fused assembly and solve for small cells.
+/// Each cell is owned by impl::small_cell_threads() threads, which load and
+/// assemble its matrix in flat order into shared memory. One thread then
+/// performs the backward and forward substitution, as in the flat solver,
+/// after which the solution is written directly to the voltage. This replaces
+/// the assemble, solve and gather kernels of the fine solver, and the round
+/// trips of d and rhs through global memory, for cells too small to fill the
+/// levels of the fine solver.
+template <typename T, typename I, unsigned BlockDim>
+__global__
+void assemble_solve_matrix_small(
+    T* __restrict__ const voltage,
+    const T* __restrict__ const current,
+    const T* __restrict__ const conductivity,
+    const T* __restrict__ const invariant_d,
+    const T* __restrict__ const u,
+    const I* __restrict__ const p,
+    const T* __restrict__ const cv_capacitance,
+    const T* __restrict__ const area,
+    const I* __restrict__ const cv_to_intdom,
+    const T* __restrict__ const dt_intdom,
+    const I* __restrict__ const cell_cv_divs,
+    T oodt_scale,
+    bool extrapolate,
+    unsigned num_cells)
+{
+    constexpr unsigned width = impl::small_cell_threads();
+    constexpr unsigned max_size = impl::small_cell_max_size();
+    constexpr unsigned cells_per_block = BlockDim/width;
+
+    __shared__ T s_d[cells_per_block][max_size];
+    __shared__ T s_u[cells_per_block][max_size];
+    __shared__ T s_rhs[cells_per_block][max_size];
+    __shared__ I s_p[cells_per_block][max_size];
+
+    const unsigned lane = threadIdx.x%width;
+    const unsigned slot = threadIdx.x/width;
+    const unsigned cell = blockIdx.x*cells_per_block + slot;
+
+    I first = 0;
+    I n = 0;
+    T dt = 0;
+    if (cell<num_cells) {
+        first = cell_cv_divs[cell];
+        n = cell_cv_divs[cell+1]-first;
+        dt = dt_intdom[cv_to_intdom[first]];
+    }
+
+    T* const d = s_d[slot];
+    T* const su = s_u[slot];
+    T* const rhs = s_rhs[slot];
+    I* const sp = s_p[slot];
+
+    // See assemble_matrix_fine for the assembly; a cell with dt==0 keeps
+    // its voltage. With extrapolate, the solution is the voltage at the
+    // middle of a Crank–Nicolson step, extrapolated to its end.
+    for (I k = lane; k<n; k += width) {
+        const auto i = first+k;
+        const auto area_factor = T(1e-3)*area[i];
+        const auto gi = oodt_scale*cv_capacitance[i]/dt + area_factor*conductivity[i];
+        d[k]   = dt>0? gi + invariant_d[i]: 0;
+        rhs[k] = dt>0? gi*voltage[i] - area_factor*current[i]: voltage[i];
+        su[k]  = u[i];
+        sp[k]  = p[i]-first;
+    }
+    __syncthreads();
+
+    if (lane==0 && dt>0) {
+        // backward sweep
+        for (I k = n-1; k>0; --k) {
+            const auto factor = su[k]/d[k];
+            d[sp[k]]   -= factor*su[k];
+            rhs[sp[k]] -= factor*rhs[k];
+        }
+        rhs[0] /= d[0];
+
+        // forward sweep
+        for (I k = 1; k<n; ++k) {
+            rhs[k] -= su[k]*rhs[sp[k]];
+            rhs[k] /= d[k];
+        }
+    }
+    __syncthreads();
+
+    for (I k = lane; k<n; k += width) {
+        voltage[first+k] = extrapolate? 2*rhs[k] - voltage[first+k]: rhs[k];
+    }
+}
+
 } // namespace kernels
 
 void gather(
@@ -254,7 +360,19 @@ void gather(
     constexpr unsigned blockdim = 128;
     const unsigned griddim = impl::block_count(n, blockdim);
 
-    kernels::gather<<<griddim, blockdim>>>(from, to, p, n);
+    kernels::gather<<<griddim, blockdim, 0, current_stream()>>>(from, to, p, n);
+}
+
+void gather_extrapolate(
+    const fvm_value_type* from,
+    fvm_value_type* to,
+    const fvm_index_type* p,
+    unsigned n)
+{
+    constexpr unsigned blockdim = 128;
+    const unsigned griddim = impl::block_count(n, blockdim);
+
+    kernels::gather_extrapolate<<<griddim, blockdim, 0, current_stream()>>>(from, to, p, n);
 }
 
 void scatter(
@@ -266,7 +384,7 @@ void scatter(
     constexpr unsigned blockdim = 128;
     const unsigned griddim = impl::block_count(n, blockdim);
 
-    kernels::scatter<<<griddim, blockdim>>>(from, to, p, n);
+    kernels::scatter<<<griddim, blockdim, 0, current_stream()>>>(from, to, p, n);
 }
 
 void assemble_matrix_fine(
@@ -281,14 +399,15 @@ void assemble_matrix_fine(
     const fvm_index_type* cv_to_intdom,
     const fvm_value_type* dt_intdom,
     const fvm_index_type* perm,
+    fvm_value_type oodt_scale,
     unsigned n)
 {
     const unsigned block_dim = 128;
     const unsigned num_blocks = impl::block_count(n, block_dim);
 
-    kernels::assemble_matrix_fine<<<num_blocks, block_dim>>>(
+    kernels::assemble_matrix_fine<<<num_blocks, block_dim, 0, current_stream()>>>(
         d, rhs, invariant_d, voltage, current, conductivity, cv_capacitance, area,
-        cv_to_intdom, dt_intdom, perm, n);
+        cv_to_intdom, dt_intdom, perm, oodt_scale, n);
 }
 
 // Example:
@@ -321,10 +440,36 @@ void solve_matrix_fine(
     unsigned num_blocks,                   // number of blocks
     unsigned blocksize)                    // size of each block
 {
-    kernels::solve_matrix_fine<<<num_blocks, blocksize>>>(
+    kernels::solve_matrix_fine<<<num_blocks, blocksize, 0, current_stream()>>>(
         rhs, d, u, level_meta, level_lengths, level_parents, block_index,
         num_cells);
 }
 
+void assemble_solve_matrix_small(
+    fvm_value_type* voltage,
+    const fvm_value_type* current,
+    const fvm_value_type* conductivity,
+    const fvm_value_type* invariant_d,
+    const fvm_value_type* u,
+    const fvm_index_type* p,
+    const fvm_value_type* cv_capacitance,
+    const fvm_value_type* area,
+    const fvm_index_type* cv_to_intdom,
+    const fvm_value_type* dt_intdom,
+    const fvm_index_type* cell_cv_divs,
+    fvm_value_type oodt_scale,
+    bool extrapolate,
+    unsigned num_cells)
+{
+    constexpr unsigned block_dim = 128;
+    constexpr unsigned cells_per_block = block_dim/impl::small_cell_threads();
+    const unsigned num_blocks = impl::block_count(num_cells, cells_per_block);
+
+    kernels::assemble_solve_matrix_small<fvm_value_type, fvm_index_type, block_dim>
+        <<<num_blocks, block_dim, 0, current_stream()>>>(
+        voltage, current, conductivity, invariant_d, u, p, cv_capacitance, area,
+        cv_to_intdom, dt_intdom, cell_cv_divs, oodt_scale, extrapolate, num_cells);
+}
+
 } // namespace gpu
 } // namespace arb
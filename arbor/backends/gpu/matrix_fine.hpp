@@ -25,6 +25,13 @@ void scatter(
     const fvm_index_type* p,
     unsigned n);
 
+// to[i] = 2*from[p[i]] - to[i]
+void gather_extrapolate(
+    const fvm_value_type* from,
+    fvm_value_type* to,
+    const fvm_index_type* p,
+    unsigned n);
+
 void assemble_matrix_fine(
     fvm_value_type* d,
     fvm_value_type* rhs,
@@ -37,6 +44,7 @@ void assemble_matrix_fine(
     const fvm_index_type* cv_to_intdom,
     const fvm_value_type* dt_intdom,
     const fvm_index_type* perm,
+    fvm_value_type oodt_scale,
     unsigned n);
 
 void solve_matrix_fine(
@@ -52,5 +60,24 @@ void solve_matrix_fine(
     unsigned num_blocks,                   // number of blocks
     unsigned blocksize);                   // size of each block
 
+// Assemble and solve the matrices of cells with at most
+// impl::small_cell_max_size() CVs in one kernel, in flat storage.
+// The solution is written to voltage.
+void assemble_solve_matrix_small(
+    fvm_value_type* voltage,
+    const fvm_value_type* current,
+    const fvm_value_type* conductivity,
+    const fvm_value_type* invariant_d,
+    const fvm_value_type* u,               // upper diagonal, flat
+    const fvm_index_type* p,               // parent index, flat
+    const fvm_value_type* cv_capacitance,
+    const fvm_value_type* area,
+    const fvm_index_type* cv_to_intdom,
+    const fvm_value_type* dt_intdom,
+    const fvm_index_type* cell_cv_divs,
+    fvm_value_type oodt_scale,
+    bool extrapolate,
+    unsigned num_cells);
+
 } // namespace gpu
 } // namespace arb
@@ -98,7 +98,7 @@ void solve_matrix_flat(
     const unsigned grid_dim = impl::block_count(num_mtx, block_dim);
     kernels::solve_matrix_flat
         <fvm_value_type, fvm_index_type>
-        <<<grid_dim, block_dim>>>
+        <<<grid_dim, block_dim, 0, current_stream()>>>
         (rhs, d, u, p, cell_cv_divs, num_mtx);
 }
 
@@ -114,7 +114,7 @@ void solve_matrix_interleaved(
     constexpr unsigned block_dim = impl::matrices_per_block();
     const unsigned grid_dim = impl::block_count(num_mtx, block_dim);
     kernels::solve_matrix_interleaved<fvm_value_type, fvm_index_type, block_dim>
-        <<<grid_dim, block_dim>>>
+        <<<grid_dim, block_dim, 0, current_stream()>>>
         (rhs, d, u, p, sizes, padded_size, num_mtx);
 }
 
@@ -6,6 +6,7 @@
 #include <type_traits>
 
 #include <arbor/common_types.hpp>
+#include <arbor/gpu/gpu_common.hpp>
 
 #include "memory/memory.hpp"
 #include "util/partition.hpp"
@@ -13,10 +14,16 @@
 #include "util/span.hpp"
 #include "tree.hpp"
 
+#include "matrix_common.hpp"
 #include "matrix_fine.hpp"
 #include "forest.hpp"
 
 namespace arb {
+
+namespace threading {
+class task_system;
+}
+
 namespace gpu {
 
 // Helper type for branch meta data in setup phase of fine grained
@@ -104,6 +111,10 @@ public:
     // Maximum number of branches in each level per block
     unsigned max_branches_per_level;
 
+    // Threads per block of the solver: the widest level of any block, in
+    // whole warps.
+    unsigned block_dim;
+
     // Number of rows in matrix
     unsigned matrix_size;
 
@@ -137,6 +148,14 @@ public:
     //      `solver_format[perm[i]] = external_format[i]`
     iarray perm;
 
+    // When no cell has more than impl::small_cell_max_size() CVs,
+    // assemble_solve() uses a single fused kernel over the flat storage
+    // below instead of the packed storage of the fine solver.
+    bool small_cells = false;
+    iarray flat_parent_index;
+    iarray flat_cell_cv_divs;
+    array flat_u;
+
 
     matrix_state_fine() = default;
 
@@ -158,25 +177,20 @@ public:
         forest trees(p, cell_cv_divs);
         trees.optimize();
 
-        // Now distribute the cells into gpu blocks.
-        // While the total number of branches on each level of theses cells in a
-        // block are less than `max_branches_per_level` we add more cells. If
-        // one block is full, we start a new gpu block.
-
-        unsigned current_block = 0;
-        std::vector<unsigned> block_num_branches_per_depth;
-        std::vector<unsigned> block_ix(num_cells);
+        // Now distribute the cells into gpu blocks, such that the branches of
+        // no level of a block exceed `max_branches_per_level`, grouping cells
+        // with levels of similar length.
+        auto block_ix = trees.pack_blocks(max_branches_per_level);
+        unsigned num_blocks = std::max(1u, block_ix.empty()? 0u: util::max_value(block_ix)+1);
 
         // Accumulate num cells in block in a temporary vector to be copied to the device
-        std::vector<size_type> temp_ncells_in_block;
-        temp_ncells_in_block.resize(1, 0);
+        std::vector<size_type> temp_ncells_in_block(num_blocks, 0);
 
         // branch_map = branch_maps[block] is a branch map for each gpu block
         // branch_map[depth] is list of branches is this level
         // each branch branch_map[depth][i] has
         // {id, parent_id, start_idx, parent_idx, length}
-        std::vector<std::vector<std::vector<branch>>> branch_maps;
-        branch_maps.resize(1);
+        std::vector<std::vector<std::vector<branch>>> branch_maps(num_blocks);
 
         unsigned num_branches = 0u;
         for (auto c: make_span(0u, num_cells)) {
@@ -193,54 +207,7 @@ public:
 
             auto num_cell_branches = cell_tree.num_segments();
 
-            // count number of branches per level
-            std::vector<unsigned> cell_num_branches_per_depth(cell_num_levels, 0u);
-            for (auto i: make_span(num_cell_branches)) {
-                cell_num_branches_per_depth[depths[i]] += 1;
-            }
-            // resize the block levels if neccessary
-            if (cell_num_levels > block_num_branches_per_depth.size()) {
-                block_num_branches_per_depth.resize(cell_num_levels, 0);
-            }
-
-
-            // check if we can fit the current cell into the last gpu block
-            bool fits_current_block = true;
-            for (auto i: make_span(cell_num_levels)) {
-                unsigned new_branches_per_depth =
-                    block_num_branches_per_depth[i]
-                    + cell_num_branches_per_depth[i];
-                if (new_branches_per_depth > max_branches_per_level) {
-                    fits_current_block = false;
-                }
-            }
-            if (fits_current_block) {
-                // put the cell into current block
-                block_ix[c] = current_block;
-                temp_ncells_in_block[block_ix[c]] += 1;
-                // and increment counter
-                for (auto i: make_span(cell_num_levels)) {
-                    block_num_branches_per_depth[i] += cell_num_branches_per_depth[i];
-                }
-            } else {
-                // otherwise start a new block
-                block_ix[c] = current_block + 1;
-                temp_ncells_in_block.push_back(1);
-                branch_maps.resize(branch_maps.size()+1);
-                current_block += 1;
-                // and reset counter
-                block_num_branches_per_depth = cell_num_branches_per_depth;
-                for (auto num: block_num_branches_per_depth) {
-                    if (num > max_branches_per_level) {
-                        throw std::runtime_error(
-                            "Could not fit " + std::to_string(num)
-                            + " branches in a block of size "
-                            + std::to_string(max_branches_per_level));
-                    }
-                }
-            }
-            num_cells_in_block = memory::make_const_view(temp_ncells_in_block);
-
+            temp_ncells_in_block[block_ix[c]] += 1;
 
             // the branch map for the block in which we put the cell
             // maps levels to a list of branches in that level
@@ -267,6 +234,7 @@ public:
             // total number of branches of all cells
             num_branches += num_cell_branches;
         }
+        num_cells_in_block = memory::make_const_view(temp_ncells_in_block);
 
         for (auto& branch_map: branch_maps) {
             // reverse the levels
@@ -367,6 +335,12 @@ public:
         }
         data_size = pos;
 
+        unsigned max_width = 1;
+        for (const auto& lvl_meta: temp_meta) {
+            max_width = std::max(max_width, lvl_meta.num_branches);
+        }
+        block_dim = impl::threads_per_warp()*impl::block_count(max_width, impl::threads_per_warp());
+
         // set matrix state
         matrix_size = p.size();
 
@@ -463,6 +437,24 @@ public:
         }
         cv_to_intdom = memory::make_const_view(cv_to_intdom_tmp);
 
+        small_cells = num_cells>0;
+        for (auto cv_span: util::partition_view(cell_cv_divs)) {
+            small_cells &= cv_span.second-cv_span.first <= (size_type)impl::small_cell_max_size();
+        }
+        if (small_cells) {
+            flat_parent_index = memory::make_const_view(p);
+            flat_cell_cv_divs = memory::make_const_view(cell_cv_divs);
+            flat_u = memory::make_const_view(temp_u_shuffled);
+        }
+    }
+
+    // With Crank–Nicolson integration, the matrix assembled for a step of dt
+    // is that of an implicit Euler step of dt/2, whose solution is the voltage
+    // at the middle of the step; assemble_solve() extrapolates it to the end
+    // of the step, v(t+dt) = 2·v(t+dt/2) - v(t).
+    void set_crank_nicolson(bool enable) {
+        crank_nicolson_ = enable;
+        oodt_scale_ = enable? 2e-3: 1e-3;
     }
 
     // Assemble the matrix
@@ -484,10 +476,67 @@ public:
             cv_to_intdom.data(),
             dt_intdom.data(),
             perm.data(),
+            oodt_scale_,
             size());
     }
 
+    void assemble_solve(const_view dt_intdom, array& voltage, const_view current, const_view conductivity) {
+        if (small_cells) {
+            assemble_solve_matrix_small(
+                voltage.data(),
+                current.data(),
+                conductivity.data(),
+                invariant_d.data(),
+                flat_u.data(),
+                flat_parent_index.data(),
+                cv_capacitance.data(),
+                cv_area.data(),
+                cv_to_intdom.data(),
+                dt_intdom.data(),
+                flat_cell_cv_divs.data(),
+                oodt_scale_,
+                crank_nicolson_,
+                num_cells);
+            return;
+        }
+        assemble(dt_intdom, voltage, current, conductivity);
+        if (crank_nicolson_) {
+            solve_packed();
+            gather_extrapolate(rhs.data(), voltage.data(), perm.data(), perm.size());
+        }
+        else {
+            solve(voltage);
+        }
+    }
+
+    // The solve runs on the GPU; there is no use for the host threads.
+    void set_task_system(threading::task_system*) {}
+    void set_parallel_cells(bool) {}
+
     void solve(array& to) {
+        solve_packed();
+        // unpermute the solution
+        packed_to_flat(rhs, to);
+    }
+
+    // Size of the matrix and solver data in bytes.
+    std::size_t bytes() const {
+        return util::size_in_bytes(cv_to_intdom, d, u, rhs, cv_area, cv_capacitance,
+            invariant_d, solution_, num_cells_in_block, data_partition, level_meta,
+            level_lengths, level_parents, block_index, perm,
+            flat_parent_index, flat_cell_cv_divs, flat_u);
+    }
+
+private:
+    bool crank_nicolson_ = false;
+    value_type oodt_scale_ = 1e-3;
+
+    std::size_t size() const {
+        return matrix_size;
+    }
+
+    // Solve in place, leaving the solution in rhs in packed order.
+    void solve_packed() {
         solve_matrix_fine(rhs.data(),
                           d.data(),
                           u.data(),
@@ -498,14 +547,7 @@ public:
                           num_cells_in_block.data(),
                           data_partition.data(),
                           num_cells_in_block.size(),
-                          max_branches_per_level);
-        // unpermute the solution
-        packed_to_flat(rhs, to);
-    }
-
-private:
-    std::size_t size() const {
-        return matrix_size;
+                          block_dim);
     }
 
     void flat_to_packed(const array& from, array& to ) {
@@ -1,3 +1,7 @@
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 #include <arbor/common_types.hpp>
 
 #include "backends/gpu/multi_event_stream.hpp"
@@ -9,11 +13,13 @@ namespace gpu {
 // These wrappers are implemented in the multi_event_stream.cu file, which
 // is spearately compiled by nvcc, to protect nvcc from having to parse C++17.
 void mark_until_after_w(unsigned n,
+        unsigned n_index,
         fvm_index_type* mark,
         fvm_index_type* span_end,
         fvm_value_type* ev_time,
         const fvm_value_type* t_until);
 void mark_until_w(unsigned n,
+        unsigned n_index,
         fvm_index_type* mark,
         fvm_index_type* span_end,
         fvm_value_type* ev_time,
@@ -24,10 +30,45 @@ void drop_marked_events_w(unsigned n,
         fvm_index_type* span_end,
         fvm_index_type* mark);
 void event_time_if_before_w(unsigned n,
+        unsigned n_partition,
         fvm_index_type* span_begin,
         fvm_index_type* span_end,
         fvm_value_type* ev_time,
         fvm_value_type* t_until);
+void count_nonempty_w(unsigned n,
+        fvm_index_type* n_nonempty_stream,
+        const fvm_index_type* span_begin,
+        const fvm_index_type* span_end);
+
+void multi_event_stream_base::init(array ev_time, const iarray& divs) {
+    auto n = n_total_streams();
+    arb_assert(divs.size()>n);
+
+    ev_time_ = std::move(ev_time);
+    memory::copy(divs(0, n), span_begin_);
+    memory::copy(divs(1, n+1), span_end_);
+    memory::copy(span_begin_, mark_);
+    memory::fill(n_nonempty_stream_, 0);
+    count_nonempty_w(n, n_nonempty_stream_.data(), span_begin_.data(), span_end_.data());
+}
+
+void multi_event_stream_base::set_partitions(std::vector<index_type> partition) {
+    n_partition_ = 1;
+    if (!partition.empty()) {
+        for (auto p: partition) {
+            if (p>=0) n_partition_ = std::max(n_partition_, size_type(p+1));
+        }
+        unkeyed_ = n_partition_++;
+    }
+    partition_ = iarray(memory::make_view(partition));
+    partition_host_ = std::move(partition);
+
+    auto n = n_total_streams();
+    span_begin_ = iarray(n);
+    span_end_ = iarray(n);
+    mark_ = iarray(n);
+    clear();
+}
 
 void multi_event_stream_base::clear() {
     memory::fill(span_begin_, 0u);
@@ -40,24 +81,24 @@ void multi_event_stream_base::clear() {
 // until `event_time(ev)` > `t_until[i]`.
 void multi_event_stream_base::mark_until_after(const_view t_until) {
     arb_assert(n_streams()==t_until.size());
-    mark_until_after_w(n_stream_, mark_.data(), span_end_.data(), ev_time_.data(), t_until.data());
+    mark_until_after_w(n_total_streams(), n_stream_, mark_.data(), span_end_.data(), ev_time_.data(), t_until.data());
 }
 
 // Designate for processing events `ev` at head of each event stream `i`
 // while `t_until[i]` > `event_time(ev)`.
 void multi_event_stream_base::mark_until(const_view t_until) {
-    mark_until_w(n_stream_, mark_.data(), span_end_.data(), ev_time_.data(), t_until.data());
+    mark_until_w(n_total_streams(), n_stream_, mark_.data(), span_end_.data(), ev_time_.data(), t_until.data());
 }
 
 // Remove marked events from front of each event stream.
 void multi_event_stream_base::drop_marked_events() {
-    drop_marked_events_w(n_stream_, n_nonempty_stream_.data(), span_begin_.data(), span_end_.data(), mark_.data());
+    drop_marked_events_w(n_total_streams(), n_nonempty_stream_.data(), span_begin_.data(), span_end_.data(), mark_.data());
 }
 
 // If the head of `i`th event stream exists and has time less than `t_until[i]`, set
 // `t_until[i]` to the event time.
 void multi_event_stream_base::event_time_if_before(view t_until) {
-    event_time_if_before_w(n_stream_, span_begin_.data(), span_end_.data(), ev_time_.data(), t_until.data());
+    event_time_if_before_w(n_stream_, n_partition_, span_begin_.data(), span_end_.data(), ev_time_.data(), t_until.data());
 }
 
 } // namespace gpu
@@ -10,6 +10,7 @@ namespace kernels {
     template <typename T, typename I>
     __global__ void mark_until_after(
         unsigned n,
+        unsigned n_index,
         I* __restrict__ const mark,
         const I* __restrict__ const span_end,
         const T* __restrict__ const ev_time,
@@ -17,7 +18,7 @@ namespace kernels {
     {
         unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
         if (i<n) {
-            auto t = t_until[i];
+            auto t = t_until[i%n_index];
             auto end = span_end[i];
             auto &m = mark[i];
 
@@ -30,6 +31,7 @@ namespace kernels {
     template <typename T, typename I>
     __global__ void mark_until(
         unsigned n,
+        unsigned n_index,
         I* __restrict__ const mark,
         const I* __restrict__ const span_end,
         const T* __restrict__ const ev_time,
@@ -37,7 +39,7 @@ namespace kernels {
     {
         unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
         if (i<n) {
-            auto t = t_until[i];
+            auto t = t_until[i%n_index];
             auto end = span_end[i];
             auto &m = mark[i];
 
@@ -65,9 +67,11 @@ namespace kernels {
         }
     }
 
+    // One thread per index, taking the earliest head over the partitions.
     template <typename T, typename I>
     __global__ void event_time_if_before(
         unsigned n,
+        unsigned n_partition,
         const I* __restrict__ const span_begin,
         const I* __restrict__ const span_end,
         const T* __restrict__ const ev_time,
@@ -75,17 +79,34 @@ namespace kernels {
     {
         unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
         if (i<n) {
-            if (span_begin[i]<span_end[i]) {
-                auto ev_t = ev_time[span_begin[i]];
-                if (t_until[i]>ev_t) {
-                    t_until[i] = ev_t;
+            auto t = t_until[i];
+            for (unsigned s = i; s<n*n_partition; s += n) {
+                if (span_begin[s]<span_end[s]) {
+                    auto ev_t = ev_time[span_begin[s]];
+                    if (t>ev_t) t = ev_t;
                 }
             }
+            t_until[i] = t;
+        }
+    }
+    template <typename I>
+    __global__ void count_nonempty(
+        unsigned n,
+        I* __restrict__ const n_nonempty,
+        const I* __restrict__ const span_begin,
+        const I* __restrict__ const span_end)
+    {
+        unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
+        if (i<n) {
+            if (span_begin[i]<span_end[i]) {
+                atomicAdd(n_nonempty, (I)1);
+            }
         }
     }
 } // namespace kernels
 
 void mark_until_after_w(unsigned n,
+        unsigned n_index,
         fvm_index_type* mark,
         fvm_index_type* span_end,
         fvm_value_type* ev_time,
@@ -93,11 +114,12 @@ void mark_until_after_w(unsigned n,
 {
     const int nblock = impl::block_count(n, 128);
     kernels::mark_until_after
-        <<<nblock, 128>>>
-        (n, mark, span_end, ev_time, t_until);
+        <<<nblock, 128, 0, current_stream()>>>
+        (n, n_index, mark, span_end, ev_time, t_until);
 }
 
 void mark_until_w(unsigned n,
+        unsigned n_index,
         fvm_index_type* mark,
         fvm_index_type* span_end,
         fvm_value_type* ev_time,
@@ -105,8 +127,8 @@ void mark_until_w(unsigned n,
 {
     const int nblock = impl::block_count(n, 128);
     kernels::mark_until
-        <<<nblock, 128>>>
-        (n, mark, span_end, ev_time, t_until);
+        <<<nblock, 128, 0, current_stream()>>>
+        (n, n_index, mark, span_end, ev_time, t_until);
 }
 
 void drop_marked_events_w(unsigned n,
@@ -117,12 +139,13 @@ void drop_marked_events_w(unsigned n,
 {
     const int nblock = impl::block_count(n, 128);
     kernels::drop_marked_events
-        <<<nblock, 128>>>
+        <<<nblock, 128, 0, current_stream()>>>
         (n, n_nonempty_stream, span_begin, span_end, mark);
 
 }
 
 void event_time_if_before_w(unsigned n,
+        unsigned n_partition,
         fvm_index_type* span_begin,
         fvm_index_type* span_end,
         fvm_value_type* ev_time,
@@ -130,8 +153,19 @@ void event_time_if_before_w(unsigned n,
 {
     const int nblock = impl::block_count(n, 128);
     kernels::event_time_if_before
-        <<<nblock, 128>>>
-        (n, span_begin, span_end, ev_time, t_until);
+        <<<nblock, 128, 0, current_stream()>>>
+        (n, n_partition, span_begin, span_end, ev_time, t_until);
+}
+
+void count_nonempty_w(unsigned n,
+        fvm_index_type* n_nonempty_stream,
+        const fvm_index_type* span_begin,
+        const fvm_index_type* span_end)
+{
+    const int nblock = impl::block_count(n, 128);
+    kernels::count_nonempty
+        <<<nblock, 128, 0, current_stream()>>>
+        (n, n_nonempty_stream, span_begin, span_end);
 }
 
 } // namespace gpu
@@ -2,6 +2,11 @@
 
 // Indexed collection of pop-only event queues --- CUDA back-end implementation.
 
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
+
 #include <arbor/arbexcept.hpp>
 #include <arbor/common_types.hpp>
 #include <arbor/fvm_types.hpp>
@@ -11,6 +16,8 @@
 #include "backends/multi_event_stream_state.hpp"
 #include "memory/array.hpp"
 #include "memory/copy.hpp"
+#include "memory/gpu_wrappers.hpp"
+#include "memory/memory.hpp"
 #include "profile/profiler_macro.hpp"
 #include "util/rangeutil.hpp"
 
@@ -30,12 +37,31 @@ public:
     using const_view = array::const_view_type;
     using view = array::view_type;
 
+    // Number of streams in each partition, one per event index.
     size_type n_streams() const { return n_stream_; }
 
+    size_type n_partitions() const { return n_partition_; }
+
+    // The partition of the events of each `event_partition` key, on the
+    // device; empty if the streams are not partitioned.
+    const iarray& partitions() const { return partition_; }
+
+    // The partition of the events with keys past the end of partitions().
+    size_type unkeyed_partition() const { return unkeyed_; }
+
     bool empty() const { return n_nonempty_stream_[0]==0; }
 
     void clear();
 
+    // Partition the streams by the `event_partition` key of the events: events
+    // with key k are held in streams of their own in partition `partition[k]`,
+    // and are dropped if `partition[k]` is negative. Events with keys past the
+    // end of `partition`, such as those of exact sampling, which belong to no
+    // mechanism, are held in a last partition of their own: they are never
+    // delivered, but still bound the integration steps. Without partitions,
+    // all events share one set of streams.
+    void set_partitions(std::vector<index_type> partition);
+
     // Designate for processing events `ev` at head of each event stream `i`
     // until `event_time(ev)` > `t_until[i]`.
     void mark_until_after(const_view t_until);
@@ -62,61 +88,154 @@ protected:
         n_nonempty_stream_(1)
     {}
 
-    // The list of events must be sorted sorted first by index and then by time.
+    // The events must be sorted by time within each event index. The position
+    // of each event in the streams, or -1 if it is dropped, is left in tmp_pos_.
     template <typename Event>
     void init(const std::vector<Event>& staged) {
-        using ::arb::event_time;
-        using ::arb::event_index;
-
         if (staged.size()>std::numeric_limits<size_type>::max()) {
             throw arbor_internal_error("gpu/multi_event_stream: too many events for size type");
         }
 
-        arb_assert(util::is_sorted_by(staged, [](const Event& ev) { return event_index(ev); }));
+        // The staging vectors are page locked, and the copies from the
+        // previous call may still be in flight.
+        memory::gpu_synchronize_stream();
+
+        size_type n = n_total_streams();
+        size_type n_nonempty = init_ordered(staged)? count_nonempty(): init_unordered(staged);
+
+        for (size_type s = 0; s<n; ++s) {
+            // Within a stream, events should be sorted by time.
+            arb_assert(util::is_sorted(util::subrange_view(tmp_ev_time_, tmp_divs_[s], tmp_divs_[s+1])));
+        }
+
+        // The event times stay on the device, and are only reallocated if
+        // they grow beyond the events of all calls so far.
+        const size_type n_ev = tmp_divs_[n];
+        if (ev_time_.size()<n_ev) ev_time_ = array(std::max<std::size_t>(n_ev, 2*ev_time_.size()));
+        if (n_ev) memory::copy(memory::make_view(tmp_ev_time_)(0, n_ev), ev_time_(0, n_ev));
+        memory::copy(memory::make_view(tmp_divs_)(0,n), span_begin_);
+        memory::copy(memory::make_view(tmp_divs_)(1,n+1), span_end_);
+        memory::copy(span_begin_, mark_);
+        n_nonempty_stream_[0] = n_nonempty;
+    }
+
+    // Cell groups stage the events of each integration domain contiguously,
+    // so that the events are ordered by stream: their positions and the
+    // spans are then found in one pass. Returns false if they are not.
+    template <typename Event>
+    bool init_ordered(const std::vector<Event>& staged) {
+        using ::arb::event_time;
 
-        std::size_t n_ev = staged.size();
-        tmp_ev_time_.clear();
-        tmp_ev_time_.reserve(n_ev);
+        size_type n = n_total_streams();
+        tmp_divs_.resize(n+1);
+        tmp_pos_.resize(staged.size());
+        tmp_ev_time_.resize(staged.size());
+
+        size_type s = 0;
+        index_type n_ev = 0;
+        tmp_divs_[0] = 0;
+        for (std::size_t i = 0; i<staged.size(); ++i) {
+            auto e = stream_of(staged[i]);
+            tmp_pos_[i] = e<0? -1: n_ev;
+            if (e<0) continue;
+            if (size_type(e)<s) return false;
+            for (; s<size_type(e); ++s) tmp_divs_[s+1] = n_ev;
+            tmp_ev_time_[n_ev++] = event_time(staged[i]);
+        }
+        for (; s<n; ++s) tmp_divs_[s+1] = n_ev;
+        tmp_ev_time_.resize(n_ev);
+        return true;
+    }
 
-        util::assign_by(tmp_ev_time_, staged, [](const Event& ev) { return event_time(ev); });
-        ev_time_ = array(memory::make_view(tmp_ev_time_));
+    // Count the events of each stream, then place them stream by stream,
+    // keeping their order within each stream. Returns the number of
+    // non-empty streams.
+    template <typename Event>
+    size_type init_unordered(const std::vector<Event>& staged) {
+        using ::arb::event_time;
 
-        // Determine divisions by `event_index` in ev list.
-        tmp_divs_.clear();
-        tmp_divs_.reserve(n_stream_+1);
+        size_type n = n_total_streams();
+        tmp_divs_.assign(n+1, 0);
+        tmp_pos_.clear();
+        tmp_pos_.reserve(staged.size());
+        for (const auto& ev: staged) {
+            auto s = stream_of(ev);
+            tmp_pos_.push_back(s);
+            if (s>=0) ++tmp_divs_[s+1];
+        }
 
         size_type n_nonempty = 0;
-        index_type ev_begin_i = 0;
-        index_type ev_i = 0;
-        tmp_divs_.push_back(ev_i);
-        for (size_type s = 0; s<n_stream_; ++s) {
-            while ((size_type)ev_i<n_ev && (size_type)event_index(staged[ev_i])<s+1) ++ev_i;
-
-            // Within a subrange of events with the same index, events should
-            // be sorted by time.
-            arb_assert(util::is_sorted(util::subrange_view(tmp_ev_time_, ev_begin_i, ev_i)));
-            n_nonempty += (tmp_divs_.back()!=ev_i);
-            tmp_divs_.push_back(ev_i);
-            ev_begin_i = ev_i;
+        for (size_type s = 0; s<n; ++s) {
+            n_nonempty += tmp_divs_[s+1]!=0;
+            tmp_divs_[s+1] += tmp_divs_[s];
         }
 
-        arb_assert(tmp_divs_.size()==n_stream_+1);
-        memory::copy(memory::make_view(tmp_divs_)(0,n_stream_), span_begin_);
-        memory::copy(memory::make_view(tmp_divs_)(1,n_stream_+1), span_end_);
-        memory::copy(span_begin_, mark_);
-        n_nonempty_stream_[0] = n_nonempty;
+        tmp_ev_time_.resize(tmp_divs_[n]);
+        for (std::size_t i = 0; i<staged.size(); ++i) {
+            auto s = tmp_pos_[i];
+            if (s<0) continue;
+            tmp_pos_[i] = tmp_divs_[s]++;
+            tmp_ev_time_[tmp_pos_[i]] = event_time(staged[i]);
+        }
+
+        // The cursors now hold the ends of the streams.
+        for (size_type s = n; s>0; --s) tmp_divs_[s] = tmp_divs_[s-1];
+        tmp_divs_[0] = 0;
+        return n_nonempty;
+    }
+
+    size_type count_nonempty() const {
+        size_type n_nonempty = 0;
+        for (size_type s = 0; s<n_total_streams(); ++s) {
+            n_nonempty += tmp_divs_[s+1]!=tmp_divs_[s];
+        }
+        return n_nonempty;
+    }
+
+    // Initialize from event times already on the device, sorted by time
+    // within each stream: stream i holds the events [divs[i], divs[i+1]).
+    void init(array ev_time, const iarray& divs);
+
+    size_type n_total_streams() const { return n_partition_*n_stream_; }
+
+    // Offset of the streams of `event_partition` key `key` in the span
+    // arrays, or -1 if the key has no partition.
+    index_type partition_offset(size_type key) const {
+        if (partition_host_.empty()) return 0;
+        if (key>=partition_host_.size()) return unkeyed_*n_stream_;
+        if (partition_host_[key]<0) return -1;
+        return partition_host_[key]*n_stream_;
     }
 
-    size_type n_stream_;
+    // Index of the stream of `ev` in the span arrays, or -1 if it is dropped.
+    template <typename Event>
+    index_type stream_of(const Event& ev) const {
+        using ::arb::event_index;
+        using ::arb::event_partition;
+
+        index_type i = event_index(ev);
+        if (partition_host_.empty()) return i;
+
+        auto offset = partition_offset(event_partition(ev));
+        return offset<0? -1: offset+i;
+    }
+
+    size_type n_stream_ = 0;
+    size_type n_partition_ = 1;
+    size_type unkeyed_ = 0;
+    std::vector<index_type> partition_host_;
+    iarray partition_;
     array ev_time_;
     iarray span_begin_;
     iarray span_end_;
     iarray mark_;
     iarray n_nonempty_stream_;
 
-    // Host-side vectors for staging values in init():
-    std::vector<value_type> tmp_ev_time_;
-    std::vector<index_type> tmp_divs_;
+    // Host-side vectors for staging values in init(), page locked so that
+    // the copies to the device do not block:
+    memory::staging_vector<value_type> tmp_ev_time_;
+    memory::staging_vector<index_type> tmp_divs_;
+    std::vector<index_type> tmp_pos_;
 };
 
 template <typename Event>
@@ -132,28 +251,44 @@ public:
     explicit multi_event_stream(size_type n_stream):
         multi_event_stream_base(n_stream) {}
 
-    // Initialize event streams from a vector of events, sorted first by index
-    // and then by time.
+    // Initialize event streams from a vector of events, sorted by time
+    // within each event index.
     void init(const std::vector<Event>& staged) {
+        using ::arb::event_data;
+
         multi_event_stream_base::init(staged);
 
-        tmp_ev_data_.clear();
-        tmp_ev_data_.reserve(staged.size());
+        const std::size_t n_ev = tmp_ev_time_.size();
+        tmp_ev_data_.resize(n_ev);
+        for (std::size_t i = 0; i<staged.size(); ++i) {
+            if (tmp_pos_[i]>=0) tmp_ev_data_[tmp_pos_[i]] = event_data(staged[i]);
+        }
+        if (ev_data_.size()<n_ev) ev_data_ = data_array(std::max(n_ev, 2*ev_data_.size()));
+        if (n_ev) memory::copy(memory::make_view(tmp_ev_data_)(0, n_ev), ev_data_(0, n_ev));
+    }
 
-        using ::arb::event_data;
-        util::assign_by(tmp_ev_data_, staged, [](const Event& ev) { return event_data(ev); });
-        ev_data_ = data_array(memory::make_view(tmp_ev_data_));
+    // Initialize event streams from event times and data already on the
+    // device, sorted by time within each stream, where stream i holds the
+    // events [divs[i], divs[i+1]), with the streams of each partition in turn.
+    void init(array ev_time, data_array ev_data, const iarray& divs) {
+        multi_event_stream_base::init(std::move(ev_time), divs);
+        ev_data_ = std::move(ev_data);
     }
 
-    state marked_events() const {
-        return {n_stream_, ev_data_.data(), span_begin_.data(), mark_.data()};
+    // The streams of the partition of events with `event_partition` key `key`.
+    state marked_events(size_type key = 0) const {
+        auto offset = partition_offset(key);
+        if (offset<0 || (!partition_host_.empty() && key>=partition_host_.size())) {
+            return {n_stream_, ev_data_.data(), mark_.data(), mark_.data()};
+        }
+        return {n_stream_, ev_data_.data(), span_begin_.data()+offset, mark_.data()+offset};
     }
 
 private:
     data_array ev_data_;
 
-    // Host-side vector for staging event data in init():
-    std::vector<event_data_type> tmp_ev_data_;
+    // Host-side vector for staging event data in init(), page locked:
+    memory::staging_vector<event_data_type> tmp_ev_data_;
 };
 
 } // namespace gpu
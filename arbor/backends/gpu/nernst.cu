@@ -0,0 +1,32 @@
+#include <arbor/fvm_types.hpp>
+#include <arbor/gpu/gpu_api.hpp>
+#include <arbor/gpu/gpu_common.hpp>
+
+#include "backends/gpu/nernst.hpp"
+
+namespace arb {
+namespace gpu {
+
+namespace kernel {
+
+// One row of blocks per ion, so that all ions are updated by one launch.
+__global__
+void nernst_reversal_potential_impl(const nernst_pp* __restrict__ const ions) {
+    const nernst_pp ion = ions[blockIdx.y];
+    const unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
+    if (i<ion.n) {
+        ion.eX[i] = ion.coeff[i]*log(ion.Xo[i]/ion.Xi[i]);
+    }
+}
+
+} // namespace kernel
+
+void nernst_reversal_potential_impl(unsigned n_ion, fvm_size_type n_max, const nernst_pp* ions) {
+    constexpr unsigned block_dim = 128;
+    const unsigned grid_dim = impl::block_count(n_max, block_dim);
+    if (!grid_dim || !n_ion) return;
+    kernel::nernst_reversal_potential_impl<<<dim3(grid_dim, n_ion), block_dim, 0, current_stream()>>>(ions);
+}
+
+} // namespace gpu
+} // namespace arb
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <arbor/fvm_types.hpp>
+
+namespace arb {
+namespace gpu {
+
+// Pointer representation of an ion whose reversal potential is set by the
+// Nernst equation, passed to the GPU kernel.
+
+struct nernst_pp {
+    fvm_size_type n;                // number of instances of the ion
+    const fvm_value_type* coeff;    // (mV) RT/zF per instance
+    const fvm_value_type* Xi;
+    const fvm_value_type* Xo;
+    fvm_value_type* eX;
+};
+
+// Set the reversal potentials of n_ion ions of at most n_max instances each
+// with a single launch.
+void nernst_reversal_potential_impl(unsigned n_ion, fvm_size_type n_max, const nernst_pp* ions);
+
+} // namespace gpu
+} // namespace arb
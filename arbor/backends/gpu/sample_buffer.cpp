@@ -0,0 +1,37 @@
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+
+#include "backends/gpu/sample_buffer.hpp"
+#include "memory/gpu_wrappers.hpp"
+#include "memory/memory.hpp"
+
+namespace arb {
+namespace gpu {
+
+void sample_buffer::copy_to_host(const array& time, const array& value, std::size_t b, std::size_t e) {
+    if (b==e) return;
+
+    if (host_time_.size()<e) {
+        // Copies to the old mirror may still be in flight.
+        synchronize();
+
+        auto capacity = std::max(e, 2*host_time_.size());
+        memory::pinned_vector<value_type> host_time(capacity), host_value(capacity);
+        std::copy_n(host_time_.data(), b, host_time.data());
+        std::copy_n(host_value_.data(), b, host_value.data());
+        std::swap(host_time_, host_time);
+        std::swap(host_value_, host_value);
+    }
+
+    auto n = (e-b)*sizeof(value_type);
+    memory::gpu_memcpy_d2h_async(host_time_.data()+b, time.data()+b, n);
+    memory::gpu_memcpy_d2h_async(host_value_.data()+b, value.data()+b, n);
+}
+
+void sample_buffer::synchronize() {
+    memory::gpu_synchronize_stream();
+}
+
+} // namespace gpu
+} // namespace arb
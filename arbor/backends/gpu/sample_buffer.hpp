@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+
+#include <arbor/fvm_types.hpp>
+
+#include "memory/memory.hpp"
+#include "util/rangeutil.hpp"
+
+namespace arb {
+namespace gpu {
+
+// Pinned host mirror of device sample time and value arrays that are filled
+// over several integration epochs.
+//
+// The samples of each epoch are copied to the mirror asynchronously as soon
+// as they have been taken, with copy_to_host(); the host copies can be read
+// once synchronize() has been called. All calls must be made with the stream
+// on which the samples are taken current.
+
+class sample_buffer {
+public:
+    static constexpr bool supported = true;
+
+    using value_type = fvm_value_type;
+    using array = memory::device_vector<value_type>;
+
+    // Start the copy of the samples [b, e) of `time` and `value` to the
+    // host; samples [0, b) already copied are kept.
+    void copy_to_host(const array& time, const array& value, std::size_t b, std::size_t e);
+
+    // Wait for all copies to the host to complete.
+    void synchronize();
+
+    const value_type* host_time() const { return host_time_.data(); }
+    const value_type* host_value() const { return host_value_.data(); }
+
+    // Pinned host memory held, in bytes.
+    std::size_t bytes() const { return util::size_in_bytes(host_time_, host_value_); }
+
+private:
+    memory::pinned_vector<value_type> host_time_;
+    memory::pinned_vector<value_type> host_value_;
+};
+
+} // namespace gpu
+} // namespace arb
@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <cstddef>
+#include <limits>
 #include <vector>
 
 #include <arbor/constants.hpp>
@@ -9,6 +11,8 @@
 #include "backends/gpu/gpu_store_types.hpp"
 #include "backends/gpu/shared_state.hpp"
 #include "backends/multi_event_stream_state.hpp"
+#include "backends/stochastic_input.hpp"
+#include "io/serialize.hpp"
 #include "memory/copy.hpp"
 #include "memory/wrappers.hpp"
 #include "util/index_into.hpp"
@@ -26,25 +30,54 @@ namespace gpu {
 
 void update_time_to_impl(
     std::size_t n, fvm_value_type* time_to, const fvm_value_type* time,
-    fvm_value_type dt, fvm_value_type tmax);
+    fvm_value_type dt, fvm_value_type tmax, const fvm_index_type* dt_level);
 
-void update_time_to_impl(
-    std::size_t n, fvm_value_type* time_to, const fvm_value_type* time,
-    fvm_value_type dt, fvm_value_type tmax);
+void save_step_voltage_impl(
+    std::size_t n, fvm_value_type* voltage_prev, fvm_value_type* voltage_start, const fvm_value_type* voltage);
+
+void adapt_dt_impl(
+    fvm_size_type nintdom, fvm_size_type ncv, fvm_index_type* dt_level, fvm_value_type* dt_prev,
+    fvm_value_type* curvature, const fvm_value_type* voltage_prev, const fvm_value_type* voltage_start,
+    const fvm_value_type* voltage, const fvm_value_type* dt_intdom, const fvm_value_type* time,
+    const fvm_value_type* time_to, const fvm_index_type* cv_to_intdom,
+    fvm_value_type dt, fvm_value_type tmax, unsigned max_level, fvm_value_type tolerance);
 
 void set_dt_impl(
     fvm_size_type nintdom, fvm_size_type ncomp, fvm_value_type* dt_intdom, fvm_value_type* dt_comp,
     const fvm_value_type* time_to, const fvm_value_type* time, const fvm_index_type* cv_to_intdom);
 
 void add_gj_current_impl(
-    fvm_size_type n_gj, const fvm_gap_junction* gj, const fvm_value_type* v, fvm_value_type* i);
+    fvm_size_type n_gj, const fvm_index_type* gj_cv, const fvm_index_type* gj_peer, const fvm_value_type* gj_weight,
+    const fvm_value_type* v, fvm_value_type* i);
+
+void add_remote_gj_current_impl(
+    fvm_size_type n_gj, const fvm_index_type* gj_cv, const fvm_value_type* gj_weight, const fvm_value_type* gj_v,
+    const fvm_value_type* v, fvm_value_type* i);
 
 void take_samples_impl(
     const multi_event_stream_state<raw_probe_info>& s,
-    const fvm_value_type* time, fvm_value_type* sample_time, fvm_value_type* sample_value);
+    const fvm_value_type* time, fvm_value_type* sample_time, fvm_value_type* sample_value,
+    std::size_t n_acc, const fvm_value_type* acc_value, fvm_value_type* acc_weight);
+
+void accumulate_samples_impl(
+    std::size_t n, fvm_value_type* value, fvm_value_type* weight, const probe_handle* source,
+    const fvm_index_type* intdom, const sampling_policy* op, const fvm_value_type* dt_intdom);
+
+void record_sample_rings_impl(
+    std::size_t n, fvm_size_type capacity, fvm_size_type pos, fvm_value_type* value, fvm_value_type* time_out,
+    const probe_handle* source, const fvm_index_type* intdom, const fvm_value_type* time);
 
 void add_scalar(std::size_t n, fvm_value_type* data, fvm_value_type v);
 
+void scatter_scaled_impl(
+    std::size_t n, fvm_value_type* to, const fvm_index_type* index, const fvm_value_type* from, fvm_value_type scale);
+
+void gather_impl(std::size_t n, fvm_value_type* to, const fvm_value_type* from, const fvm_index_type* index);
+
+void reduce_probes_impl(
+    std::size_t n, fvm_value_type* value, const probe_handle* term,
+    const fvm_value_type* weight, const fvm_index_type* divs);
+
 // GPU-side minmax: consider CUDA kernel replacement.
 std::pair<fvm_value_type, fvm_value_type> minmax_value_impl(fvm_size_type n, const fvm_value_type* v) {
     auto v_copy = memory::on_host(memory::const_device_view<fvm_value_type>(v, n));
@@ -68,15 +101,32 @@ ion_state::ion_state(
     reset_Xi_(make_const_view(ion_data.reset_iconc)),
     reset_Xo_(make_const_view(ion_data.reset_econc)),
     init_eX_(make_const_view(ion_data.init_revpot)),
-    charge(1u, charge)
+    charge(1u, charge),
+    source_scale_(1e6/(charge*constant::faraday))
 {
     arb_assert(node_index_.size()==init_Xi_.size());
     arb_assert(node_index_.size()==init_Xo_.size());
     arb_assert(node_index_.size()==init_eX_.size());
 }
 
+void ion_state::configure_diffusion(std::size_t n_cv) {
+    Xd_ = array(n_cv, 0);
+    Xd_source_ = array(n_cv, 0);
+}
+
+// See the multicore back end for the scale of the source.
+void ion_state::diffusion_source() {
+    memory::fill(Xd_source_, 0);
+    scatter_scaled_impl(node_index_.size(), Xd_source_.data(), node_index_.data(), iX_.data(), source_scale_);
+}
+
 void ion_state::init_concentration() {
-    memory::copy(init_Xi_, Xi_);
+    if (Xd_.empty()) {
+        memory::copy(init_Xi_, Xi_);
+    }
+    else {
+        gather_impl(node_index_.size(), Xi_.data(), Xd_.data(), node_index_.data());
+    }
     memory::copy(init_Xo_, Xo_);
 }
 
@@ -84,11 +134,24 @@ void ion_state::zero_current() {
     memory::fill(iX_, 0);
 }
 
+void ion_state::configure_nernst(int charge, fvm_value_type scale, const array& temperature_degC) {
+    auto cv = memory::on_host(node_index_);
+    auto T = memory::on_host(temperature_degC);
+    std::vector<fvm_value_type> coeff(cv.size());
+    for (auto i: util::count_along(cv)) {
+        coeff[i] = scale*(T[cv[i]]+273.15)/charge;
+    }
+    nernst_coeff_ = array(make_const_view(coeff));
+}
+
 void ion_state::reset() {
     zero_current();
     memory::copy(reset_Xi_, Xi_);
     memory::copy(reset_Xo_, Xo_);
     memory::copy(init_eX_, eX_);
+    if (!Xd_.empty()) {
+        scatter_scaled_impl(node_index_.size(), Xd_.data(), node_index_.data(), reset_Xi_.data(), 1);
+    }
 }
 
 // istim_state methods:
@@ -132,6 +195,11 @@ istim_state::istim_state(const fvm_stimulus_config& stim) {
 
     // Initial indices into envelope match partition divisions; ignore last (index n) element.
     envl_index_ = envl_divs_;
+    seg_t0_ = array(n);
+    seg_t1_ = array(n);
+    seg_j0_ = array(n);
+    seg_slope_ = array(n);
+    clear_segments();
 
     // Initialize ppack pointers.
     ppack_.accu_index = accu_index_.data();
@@ -143,6 +211,10 @@ istim_state::istim_state(const fvm_stimulus_config& stim) {
     ppack_.envl_divs = envl_divs_.data();
     ppack_.accu_stim = accu_stim_.data();
     ppack_.envl_index = envl_index_.data();
+    ppack_.seg_t0 = seg_t0_.data();
+    ppack_.seg_t1 = seg_t1_.data();
+    ppack_.seg_j0 = seg_j0_.data();
+    ppack_.seg_slope = seg_slope_.data();
     // The following ppack fields must be set in add_current() before queuing kernel.
     ppack_.time = nullptr;
     ppack_.cv_to_intdom = nullptr;
@@ -160,6 +232,11 @@ void istim_state::zero_current() {
 void istim_state::reset() {
     zero_current();
     memory::copy(envl_divs_, envl_index_);
+    clear_segments();
+}
+
+void istim_state::clear_segments() {
+    memory::fill(seg_t1_, -std::numeric_limits<fvm_value_type>::infinity());
 }
 
 void istim_state::add_current(const array& time, const iarray& cv_to_intdom, array& current_density) {
@@ -169,12 +246,70 @@ void istim_state::add_current(const array& time, const iarray& cv_to_intdom, arr
     istim_add_current_impl((int)size(), ppack_);
 }
 
+// stochastic_input_state methods:
+
+stochastic_input_state::stochastic_input_state(const fvm_stochastic_input_config& config):
+    intdom_(make_const_view(config.intdom)),
+    weight_(make_const_view(config.weight)),
+    rate_(make_const_view(config.rate)),
+    tstart_(make_const_view(config.tstart)),
+    tstop_(make_const_view(config.tstop)),
+    seed_(make_const_view(config.seed)),
+    stream_(make_const_view(config.stream)),
+    instance_divs_(make_const_view(config.instance_divs))
+{
+    std::vector<arb_deliverable_event_data> events;
+    std::vector<fvm_index_type> begin, end;
+    for (auto i: util::count_along(config.mech_id)) {
+        events.push_back({config.mech_id[i], config.mech_index[i], 0});
+        begin.push_back(i);
+        end.push_back(i+1);
+
+        auto& range = mech_range_[config.mech_id[i]];
+        if (range.first==range.second) range.first = i;
+        range.second = i+1;
+    }
+    events_ = make_const_view(events);
+    stream_begin_ = make_const_view(begin);
+    stream_end_ = make_const_view(end);
+
+    ppack_.instance_divs = instance_divs_.data();
+    ppack_.intdom = intdom_.data();
+    ppack_.weight = weight_.data();
+    ppack_.rate = rate_.data();
+    ppack_.tstart = tstart_.data();
+    ppack_.tstop = tstop_.data();
+    ppack_.seed = seed_.data();
+    ppack_.stream = stream_.data();
+    ppack_.events = events_.data();
+    // The following ppack fields must be set in sample() before queuing kernel.
+    ppack_.time = nullptr;
+    ppack_.dt_intdom = nullptr;
+}
+
+void stochastic_input_state::sample(const array& time, const array& dt_intdom) {
+    ppack_.time = time.data();
+    ppack_.dt_intdom = dt_intdom.data();
+    stochastic_input_sample_impl((int)size(), ppack_);
+}
+
+arb_deliverable_event_stream stochastic_input_state::events(unsigned mech_id) const {
+    arb_deliverable_event_stream s{0, events_.data(), stream_begin_.data(), stream_end_.data()};
+    auto it = mech_range_.find(mech_id);
+    if (it!=mech_range_.end()) {
+        s.n_streams = it->second.second - it->second.first;
+        s.begin += it->second.first;
+        s.end += it->second.first;
+    }
+    return s;
+}
+
 // Shared state methods:
 
 shared_state::shared_state(
     fvm_size_type n_intdom,
     fvm_size_type n_cell,
-    fvm_size_type n_detector,
+    const std::vector<fvm_index_type>& detector_divs,
     const std::vector<fvm_index_type>& cv_to_intdom_vec,
     const std::vector<fvm_index_type>& cv_to_cell_vec,
     const std::vector<fvm_gap_junction>& gj_vec,
@@ -185,12 +320,10 @@ shared_state::shared_state(
     unsigned // alignment parameter ignored.
     ):
     n_intdom(n_intdom),
-    n_detector(n_detector),
     n_cv(cv_to_intdom_vec.size()),
     n_gj(gj_vec.size()),
     cv_to_intdom(make_const_view(cv_to_intdom_vec)),
     cv_to_cell(make_const_view(cv_to_cell_vec)),
-    gap_junctions(make_const_view(gj_vec)),
     time(n_intdom),
     time_to(n_intdom),
     dt_intdom(n_intdom),
@@ -201,12 +334,30 @@ shared_state::shared_state(
     init_voltage(make_const_view(init_membrane_potential)),
     temperature_degC(make_const_view(temperature_K)),
     diam_um(make_const_view(diam)),
-    time_since_spike(n_cell*n_detector),
+    time_since_spike(detector_divs.empty()? 0: detector_divs.back()),
+    detector_divs(make_const_view(detector_divs)),
     src_to_spike(make_const_view(src_to_spike)),
     deliverable_events(n_intdom)
 {
     memory::fill(time_since_spike, -1.0);
     add_scalar(temperature_degC.size(), temperature_degC.data(), -273.15);
+
+    // Gap junctions are sorted by CV, so that the contributions to each CV
+    // are adjacent and can be reduced within a warp.
+    if (n_gj>0) {
+        auto gjs = gj_vec;
+        util::stable_sort_by(gjs, [](const fvm_gap_junction& gj) { return gj.loc; });
+        std::vector<fvm_index_type> cv, peer;
+        std::vector<fvm_value_type> weight;
+        for (const auto& gj: gjs) {
+            cv.push_back(gj.loc.first);
+            peer.push_back(gj.loc.second);
+            weight.push_back(gj.weight);
+        }
+        gj_cv = make_const_view(cv);
+        gj_peer = make_const_view(peer);
+        gj_weight = make_const_view(weight);
+    }
 }
 
 namespace {
@@ -238,6 +389,16 @@ void shared_state::set_parameter(mechanism& m, const std::string& key, const std
     memory::copy(memory::make_const_view(values), memory::device_view<arb_value_type>(field_ptr, m.ppack_.width));
 }
 
+arb_deliverable_event_stream shared_state::marked_events(mechanism& m) {
+    auto marked = deliverable_events.marked_events(m.mechanism_id());
+    arb_deliverable_event_stream events;
+    events.n_streams = marked.n;
+    events.begin     = marked.begin_offset;
+    events.end       = marked.end_offset;
+    events.events    = (arb_deliverable_event_data*) marked.ev_data; // FIXME(TH): This relies on bit-castability
+    return events;
+}
+
 void shared_state::instantiate(mechanism& m, unsigned id, const mechanism_overrides& overrides, const mechanism_layout& pos_data) {
     assert(m.iface_.backend == arb_backend_kind_gpu);
     using util::make_range;
@@ -267,7 +428,7 @@ void shared_state::instantiate(mechanism& m, unsigned id, const mechanism_overri
     m.ppack_.temperature_degC = temperature_degC.data();
     m.ppack_.diam_um          = diam_um.data();
     m.ppack_.time_since_spike = time_since_spike.data();
-    m.ppack_.n_detectors      = n_detector;
+    m.ppack_.detector_divs    = detector_divs.data();
 
     if (storage.find(id) != storage.end()) throw arb::arbor_internal_error("Duplicate mech id in shared state");
     auto& store = storage[id];
@@ -277,6 +438,7 @@ void shared_state::instantiate(mechanism& m, unsigned id, const mechanism_overri
     store.parameters_ = std::vector<arb_value_type*>(m.mech_.n_parameters);
     store.ion_states_ = std::vector<arb_ion_state>(m.mech_.n_ions);
     store.globals_    = std::vector<arb_value_type>(m.mech_.n_globals);
+    store.random_numbers_ = std::vector<arb_value_type*>(m.mech_.n_random_variables);
 
     // Set ion views
     for (auto idx: make_span(m.mech_.n_ions)) {
@@ -349,6 +511,24 @@ void shared_state::instantiate(mechanism& m, unsigned id, const mechanism_overri
         if (mult_in_place) append_chunk(pos_data.multiplicity, m.ppack_.multiplicity, base_ptr, width);
     }
 
+    // Random variables are zero until drawn for the first step.
+    if (auto n = m.mech_.n_random_variables) {
+        if (n>white_noise_max_variables) {
+            throw arbor_internal_error(util::pprintf("gpu/mechanism: too many random variables for '{}'", m.mech_.name));
+        }
+        if (pos_data.random_instance.size()!=width) {
+            throw arbor_internal_error(util::pprintf("gpu/mechanism: no random streams for '{}'", m.mech_.name));
+        }
+        store.random_data_ = array(n*width_padded, 0);
+        auto base_ptr = store.random_data_.data();
+        for (auto idx: make_span(n)) {
+            append_const(0., store.random_numbers_[idx], base_ptr, width);
+        }
+        store.random_seed_ = pos_data.random_seed;
+        store.random_stream_ = pos_data.random_stream;
+        store.random_instance_ = memory::device_vector<std::uint64_t>(make_const_view(pos_data.random_instance));
+    }
+
     // Shift data to GPU, set up pointers
     store.parameters_d_ = memory::device_vector<arb_value_type*>(store.parameters_.size());
     memory::copy(std_view(store.parameters_), store.parameters_d_);
@@ -359,6 +539,9 @@ void shared_state::instantiate(mechanism& m, unsigned id, const mechanism_overri
     store.ion_states_d_ = memory::device_vector<arb_ion_state>(store.ion_states_.size());
     memory::copy(std_view(store.ion_states_), store.ion_states_d_);
     m.ppack_.ion_states = store.ion_states_d_.data();
+    store.random_numbers_d_ = memory::device_vector<arb_value_type*>(store.random_numbers_.size());
+    memory::copy(std_view(store.random_numbers_), store.random_numbers_d_);
+    m.ppack_.random_numbers = store.random_numbers_d_.data();
 }
 
 void shared_state::add_ion(
@@ -371,10 +554,110 @@ void shared_state::add_ion(
         std::forward_as_tuple(charge, ion_info, 1u));
 }
 
+void shared_state::configure_ion_diffusion(const std::string& ion_name) {
+    ion_data.at(ion_name).configure_diffusion(n_cv);
+}
+
 void shared_state::configure_stimulus(const fvm_stimulus_config& stims) {
     stim_data = istim_state(stims);
 }
 
+void shared_state::configure_stochastic_inputs(const fvm_stochastic_input_config& config) {
+    stochastic_inputs = stochastic_input_state(config);
+}
+
+void shared_state::configure_adaptive_dt(fvm_value_type tolerance, unsigned max_level) {
+    adaptive_dt_tolerance = tolerance;
+    adaptive_dt_max_level = max_level;
+    dt_level = iarray(n_intdom, 0);
+    dt_prev = array(n_intdom, 0.);
+    dt_curvature = array(n_intdom, 0.);
+    voltage_start = array(n_cv, 0.);
+    voltage_prev = array(n_cv, 0.);
+}
+
+void shared_state::configure_remote_gap_junctions(
+    const std::vector<fvm_index_type>& cv,
+    const std::vector<fvm_value_type>& weight)
+{
+    arb_assert(cv.size()==weight.size());
+
+    gj_remote_cv = make_const_view(cv);
+    gj_remote_weight = make_const_view(weight);
+    gj_remote_v = array(cv.size(), 0.);
+}
+
+void shared_state::set_remote_gj_voltage(const std::vector<fvm_value_type>& v) {
+    arb_assert(v.size()==gj_remote_v.size());
+    memory::copy(make_const_view(v), gj_remote_v);
+}
+
+void shared_state::configure_reductions(
+    const std::vector<probe_handle>& terms,
+    const std::vector<fvm_value_type>& weights,
+    const std::vector<fvm_index_type>& divs)
+{
+    arb_assert(terms.size()==weights.size());
+    arb_assert(!divs.empty() && divs.back()==(fvm_index_type)terms.size());
+
+    reduction_value = array(divs.size()-1, 0.);
+    reduction_term = make_const_view(terms);
+    reduction_weight = make_const_view(weights);
+    reduction_divs = make_const_view(divs);
+}
+
+void shared_state::configure_accumulators(
+    const std::vector<probe_handle>& sources,
+    const std::vector<fvm_index_type>& intdoms,
+    const std::vector<sampling_policy>& ops)
+{
+    arb_assert(sources.size()==intdoms.size());
+    arb_assert(sources.size()==ops.size());
+
+    accumulator_value = array(sources.size(), 0.);
+    accumulator_weight = array(sources.size(), 0.);
+    accumulator_source = make_const_view(sources);
+    accumulator_intdom = make_const_view(intdoms);
+    accumulator_op = make_const_view(ops);
+}
+
+void shared_state::configure_sample_rings(
+    const std::vector<probe_handle>& sources,
+    const std::vector<fvm_index_type>& intdoms,
+    fvm_size_type capacity)
+{
+    arb_assert(sources.size()==intdoms.size());
+    arb_assert(capacity>0 || sources.empty());
+
+    ring_capacity = capacity;
+    ring_steps = 0;
+    ring_value = array(sources.size()*capacity, 0.);
+    ring_time = array(sources.size()*capacity, 0.);
+    ring_source = make_const_view(sources);
+    ring_intdom = make_const_view(intdoms);
+}
+
+// The ring is copied to the host whole: it is read only on a trigger.
+void shared_state::read_sample_ring(
+    std::size_t i,
+    fvm_value_type t0,
+    fvm_value_type t1,
+    std::vector<fvm_value_type>& times,
+    std::vector<fvm_value_type>& values) const
+{
+    auto ring_t = memory::on_host(memory::const_device_view<fvm_value_type>(ring_time.data()+i*ring_capacity, ring_capacity));
+    auto ring_v = memory::on_host(memory::const_device_view<fvm_value_type>(ring_value.data()+i*ring_capacity, ring_capacity));
+
+    const fvm_size_type n = std::min(ring_steps, ring_capacity);
+    for (fvm_size_type k = ring_steps-n; k<ring_steps; ++k) {
+        auto j = k%ring_capacity;
+        if (ring_t[j]>=t0 && ring_t[j]<=t1) {
+            times.push_back(ring_t[j]);
+            values.push_back(ring_v[j]);
+        }
+    }
+}
+
 void shared_state::reset() {
     memory::copy(init_voltage, voltage);
     memory::fill(current_density, 0);
@@ -382,10 +665,30 @@ void shared_state::reset() {
     memory::fill(time, 0);
     memory::fill(time_to, 0);
     memory::fill(time_since_spike, -1.0);
+    memory::fill(accumulator_value, 0);
+    memory::fill(accumulator_weight, 0);
+    ring_steps = 0;
+    memory::fill(dt_level, 0);
+    memory::fill(dt_prev, 0);
 
     for (auto& i: ion_data) {
         i.second.reset();
     }
+    for (auto& [id, m]: storage) {
+        memory::fill(m.random_data_, 0);
+    }
+    stim_data.reset();
+}
+
+void shared_state::reset_time() {
+    memory::fill(time, 0);
+    memory::fill(time_to, 0);
+    memory::fill(time_since_spike, -1.0);
+    memory::fill(accumulator_value, 0);
+    memory::fill(accumulator_weight, 0);
+    ring_steps = 0;
+    memory::fill(dt_level, 0);
+    memory::fill(dt_prev, 0);
     stim_data.reset();
 }
 
@@ -404,8 +707,45 @@ void shared_state::ions_init_concentration() {
     }
 }
 
+void shared_state::configure_nernst(const std::string& ion_name, fvm_value_type scale, bool constant) {
+    auto& ion = ion_data.at(ion_name);
+    ion.configure_nernst(memory::on_host(ion.charge)[0], scale, temperature_degC);
+
+    fvm_size_type n = ion.node_index_.size();
+    nernst_pp pp{n, ion.nernst_coeff_.data(), ion.Xi_.data(), ion.Xo_.data(), ion.eX_.data()};
+    (constant? nernst_constant: nernst_varying).push_back(pp);
+    nernst_max_size = std::max(nernst_max_size, n);
+
+    nernst_constant_d = memory::device_vector<nernst_pp>(nernst_constant.size());
+    memory::copy(std_view(nernst_constant), nernst_constant_d);
+    nernst_varying_d = memory::device_vector<nernst_pp>(nernst_varying.size());
+    memory::copy(std_view(nernst_varying), nernst_varying_d);
+}
+
+void shared_state::ions_nernst_reversal_potential(bool constant) {
+    const auto& ions = constant? nernst_constant_d: nernst_varying_d;
+    nernst_reversal_potential_impl(ions.size(), nernst_max_size, ions.data());
+}
+
 void shared_state::update_time_to(fvm_value_type dt_step, fvm_value_type tmax) {
-    update_time_to_impl(n_intdom, time_to.data(), time.data(), dt_step, tmax);
+    update_time_to_impl(n_intdom, time_to.data(), time.data(), dt_step, tmax,
+        adaptive_dt_tolerance>0? dt_level.data(): nullptr);
+}
+
+void shared_state::save_step_voltage() {
+    if (adaptive_dt_tolerance>0) {
+        save_step_voltage_impl(n_cv, voltage_prev.data(), voltage_start.data(), voltage.data());
+    }
+}
+
+void shared_state::adapt_dt(fvm_value_type dt_step, fvm_value_type tmax) {
+    if (!(adaptive_dt_tolerance>0)) return;
+
+    memory::fill(dt_curvature, 0);
+    adapt_dt_impl(n_intdom, n_cv, dt_level.data(), dt_prev.data(), dt_curvature.data(),
+        voltage_prev.data(), voltage_start.data(), voltage.data(), dt_intdom.data(),
+        time.data(), time_to.data(), cv_to_intdom.data(),
+        dt_step, tmax, adaptive_dt_max_level, adaptive_dt_tolerance);
 }
 
 void shared_state::set_dt() {
@@ -413,13 +753,31 @@ void shared_state::set_dt() {
 }
 
 void shared_state::add_gj_current() {
-    add_gj_current_impl(n_gj, gap_junctions.data(), voltage.data(), current_density.data());
+    add_gj_current_impl(n_gj, gj_cv.data(), gj_peer.data(), gj_weight.data(), voltage.data(), current_density.data());
+    add_remote_gj_current_impl(gj_remote_cv.size(), gj_remote_cv.data(), gj_remote_weight.data(), gj_remote_v.data(),
+        voltage.data(), current_density.data());
 }
 
 void shared_state::add_stimulus_current() {
     stim_data.add_current(time, cv_to_intdom, current_density);
 }
 
+void shared_state::sample_stochastic_inputs() {
+    stochastic_inputs.sample(time, dt_intdom);
+}
+
+arb_deliverable_event_stream shared_state::stochastic_events(mechanism& m) const {
+    return stochastic_inputs.events(m.mechanism_id());
+}
+
+void shared_state::draw_white_noise(mechanism& m) {
+    const auto& store = storage.at(m.mechanism_id());
+    white_noise_pp pp{store.random_seed_, store.random_stream_, store.random_instance_.data(),
+        m.ppack_.node_index, m.ppack_.random_numbers, m.mech_.n_random_variables,
+        cv_to_intdom.data(), time.data()};
+    white_noise_draw_impl(m.ppack_.width, pp);
+}
+
 std::pair<fvm_value_type, fvm_value_type> shared_state::time_bounds() const {
     return minmax_value_impl(n_intdom, time.data());
 }
@@ -428,8 +786,134 @@ std::pair<fvm_value_type, fvm_value_type> shared_state::voltage_bounds() const {
     return minmax_value_impl(n_cv, voltage.data());
 }
 
+std::size_t shared_state::bytes() const {
+    std::size_t n = util::size_in_bytes(cv_to_intdom, cv_to_cell, gj_cv, gj_peer, gj_weight,
+        gj_remote_cv, gj_remote_weight, gj_remote_v, time, time_to, dt_intdom, dt_cv, dt_level, dt_prev, dt_curvature, voltage_start, voltage_prev,
+        voltage, current_density, conductivity, init_voltage, temperature_degC, diam_um, time_since_spike, detector_divs, src_to_spike,
+        reduction_value, reduction_term, reduction_weight, reduction_divs,
+        accumulator_value, accumulator_weight, accumulator_source, accumulator_intdom, accumulator_op,
+        ring_value, ring_time, ring_source, ring_intdom);
+
+    for (const auto& [name, ion]: ion_data) {
+        n += util::size_in_bytes(ion.node_index_, ion.iX_, ion.eX_, ion.Xi_, ion.Xo_,
+            ion.init_Xi_, ion.init_Xo_, ion.reset_Xi_, ion.reset_Xo_, ion.init_eX_, ion.charge,
+            ion.Xd_, ion.Xd_source_);
+    }
+
+    const auto& st = stim_data;
+    n += util::size_in_bytes(st.accu_index_, st.accu_to_cv_, st.frequency_, st.phase_,
+        st.envl_amplitudes_, st.envl_times_, st.envl_divs_, st.accu_stim_, st.envl_index_,
+        st.seg_t0_, st.seg_t1_, st.seg_j0_, st.seg_slope_);
+
+    const auto& si = stochastic_inputs;
+    n += util::size_in_bytes(si.intdom_, si.weight_, si.rate_, si.tstart_, si.tstop_,
+        si.seed_, si.stream_, si.instance_divs_, si.events_, si.stream_begin_, si.stream_end_);
+
+    for (const auto& [id, m]: storage) {
+        n += util::size_in_bytes(m.data_, m.indices_, m.parameters_d_, m.state_vars_d_, m.ion_states_d_,
+            m.random_data_, m.random_numbers_d_, m.random_instance_);
+    }
+    return n;
+}
+
 void shared_state::take_samples(const sample_event_stream::state& s, array& sample_time, array& sample_value) {
-    take_samples_impl(s, time.data(), sample_time.data(), sample_value.data());
+    // Marked events are in device memory, so the sums are updated whether
+    // or not any samples are taken in this step.
+    reduce_probes_impl(reduction_value.size(), reduction_value.data(), reduction_term.data(),
+        reduction_weight.data(), reduction_divs.data());
+    take_samples_impl(s, time.data(), sample_time.data(), sample_value.data(),
+        accumulator_value.size(), accumulator_value.data(), accumulator_weight.data());
+}
+
+void shared_state::accumulate_samples() {
+    if (accumulator_value.empty() && ring_source.empty()) return;
+
+    // Accumulator and ring sources may be weighted sums.
+    reduce_probes_impl(reduction_value.size(), reduction_value.data(), reduction_term.data(),
+        reduction_weight.data(), reduction_divs.data());
+    accumulate_samples_impl(accumulator_value.size(), accumulator_value.data(), accumulator_weight.data(),
+        accumulator_source.data(), accumulator_intdom.data(), accumulator_op.data(), dt_intdom.data());
+
+    if (!ring_source.empty()) {
+        record_sample_rings_impl(ring_source.size(), ring_capacity, ring_steps%ring_capacity, ring_value.data(), ring_time.data(),
+            ring_source.data(), ring_intdom.data(), time.data());
+        ++ring_steps;
+    }
+}
+
+// State is copied through host memory, one array at a time. Ions and
+// mechanism storage are written in order of name and id.
+template <typename Map>
+static std::vector<typename Map::key_type> sorted_keys(const Map& m) {
+    std::vector<typename Map::key_type> keys;
+    util::assign(keys, util::keys(m));
+    util::sort(keys);
+    return keys;
+}
+
+template <typename T>
+static void serialize_array(io::serializer& out, const memory::device_vector<T>& a) {
+    out.array(memory::on_host(a));
+}
+
+template <typename T>
+static void deserialize_array(io::deserializer& in, memory::device_vector<T>& a) {
+    std::vector<T> host(a.size());
+    in.array(host);
+    memory::copy(host, a);
+}
+
+void shared_state::serialize(io::serializer& out) const {
+    for (auto* a: {&time, &time_to, &dt_intdom, &dt_cv, &voltage, &current_density, &conductivity, &time_since_spike}) {
+        serialize_array(out, *a);
+    }
+    serialize_array(out, stim_data.accu_stim_);
+    serialize_array(out, stim_data.envl_index_);
+    for (auto* a: {&dt_prev, &voltage_start, &voltage_prev}) {
+        serialize_array(out, *a);
+    }
+    serialize_array(out, dt_level);
+
+    for (const auto& name: sorted_keys(ion_data)) {
+        const auto& ion = ion_data.at(name);
+        out.string(name);
+        for (auto* a: {&ion.iX_, &ion.eX_, &ion.Xi_, &ion.Xo_, &ion.Xd_}) {
+            serialize_array(out, *a);
+        }
+    }
+
+    for (auto id: sorted_keys(storage)) {
+        out.value(id);
+        serialize_array(out, storage.at(id).data_);
+    }
+}
+
+void shared_state::deserialize(io::deserializer& in) {
+    for (auto* a: {&time, &time_to, &dt_intdom, &dt_cv, &voltage, &current_density, &conductivity, &time_since_spike}) {
+        deserialize_array(in, *a);
+    }
+    deserialize_array(in, stim_data.accu_stim_);
+    deserialize_array(in, stim_data.envl_index_);
+    stim_data.clear_segments();
+    for (auto* a: {&dt_prev, &voltage_start, &voltage_prev}) {
+        deserialize_array(in, *a);
+    }
+    deserialize_array(in, dt_level);
+
+    for (const auto& name: sorted_keys(ion_data)) {
+        auto& ion = ion_data.at(name);
+        if (in.string()!=name) {
+            throw bad_checkpoint("ion species do not match the simulation");
+        }
+        for (auto* a: {&ion.iX_, &ion.eX_, &ion.Xi_, &ion.Xo_, &ion.Xd_}) {
+            deserialize_array(in, *a);
+        }
+    }
+
+    for (auto id: sorted_keys(storage)) {
+        in.expect(id, "mechanism id");
+        deserialize_array(in, storage.at(id).data_);
+    }
 }
 
 // Debug interface
@@ -2,11 +2,14 @@
 
 #include <cstdint>
 
+#include <backends/adaptive_dt.hpp>
 #include <backends/event.hpp>
 #include <backends/multi_event_stream_state.hpp>
 
+#include <arbor/sampling.hpp>
 #include <arbor/gpu/gpu_api.hpp>
 #include <arbor/gpu/gpu_common.hpp>
+#include <arbor/gpu/reduce_by_key.hpp>
 
 namespace arb {
 namespace gpu {
@@ -18,25 +21,103 @@ __global__ void update_time_to_impl(unsigned n,
                                     T* __restrict__ const time_to,
                                     const T* __restrict__ const time,
                                     T dt,
-                                    T tmax) {
+                                    T tmax,
+                                    const int* __restrict__ const dt_level) {
     unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
     if (i<n) {
-        auto t = time[i]+dt;
+        auto t = time[i] + (dt_level? ldexp(dt, dt_level[i]): dt);
         time_to[i] = t<tmax? t: tmax;
     }
 }
 
+template <typename T>
+__global__ void save_step_voltage_impl(unsigned n,
+                                       T* __restrict__ const voltage_prev,
+                                       T* __restrict__ const voltage_start,
+                                       const T* __restrict__ const voltage) {
+    unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
+    if (i<n) {
+        voltage_prev[i] = voltage_start[i];
+        voltage_start[i] = voltage[i];
+    }
+}
+
+// The curvature estimates are non-negative, so that their maximum is that
+// of their bit patterns.
+template <typename T, typename I>
+__global__ void max_curvature_impl(unsigned n,
+                                   T* __restrict__ const curvature,
+                                   const T* __restrict__ const voltage_prev,
+                                   const T* __restrict__ const voltage_start,
+                                   const T* __restrict__ const voltage,
+                                   const T* __restrict__ const dt_prev,
+                                   const T* __restrict__ const dt_intdom,
+                                   const I* __restrict__ const cv_to_intdom) {
+    unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
+    if (i<n) {
+        auto d = cv_to_intdom[i];
+        double c = adaptive_dt_curvature(voltage_prev[i], voltage_start[i], voltage[i], dt_prev[d], dt_intdom[d]);
+        if (c>0) {
+            atomicMax((unsigned long long*)(curvature+d), (unsigned long long)__double_as_longlong(c));
+        }
+    }
+}
+
+template <typename T>
+__global__ void adapt_dt_impl(unsigned n,
+                              int* __restrict__ const dt_level,
+                              T* __restrict__ const dt_prev,
+                              const T* __restrict__ const curvature,
+                              const T* __restrict__ const dt_intdom,
+                              const T* __restrict__ const time,
+                              const T* __restrict__ const time_to,
+                              T dt,
+                              T tmax,
+                              int max_level,
+                              T tolerance) {
+    unsigned d = threadIdx.x+blockIdx.x*blockDim.x;
+    if (d<n) {
+        bool cut = time_to[d]<tmax && time_to[d]<time[d] + ldexp(dt, dt_level[d]);
+        dt_level[d] = cut? 0: adaptive_dt_level(dt_level[d], max_level, curvature[d], dt_prev[d], dt_intdom[d], dt, tolerance);
+        dt_prev[d] = dt_intdom[d];
+    }
+}
+
+// Junctions are sorted by CV, so that the contributions to a CV are
+// combined within the warp before the atomic update.
 template <typename T, typename I>
 __global__ void add_gj_current_impl(unsigned n,
-                                    const T* __restrict__ const gj_info,
-                                    const I* __restrict__ const voltage,
-                                    I* __restrict__ const current_density) {
+                                    const I* __restrict__ const gj_cv,
+                                    const I* __restrict__ const gj_peer,
+                                    const T* __restrict__ const gj_weight,
+                                    const T* __restrict__ const voltage,
+                                    T* __restrict__ const current_density) {
+    unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
+    unsigned mask = ballot(0xffffffff, i<n);
+    if (i<n) {
+        auto cv = gj_cv[i];
+        auto curr = gj_weight[i] * (voltage[gj_peer[i]] - voltage[cv]); // nA
+
+        reduce_by_key(-curr, current_density, cv, mask);
+    }
+}
+
+// Junctions with peers in other cell groups, at the peer voltages last
+// received.
+template <typename T, typename I>
+__global__ void add_remote_gj_current_impl(unsigned n,
+                                           const I* __restrict__ const gj_cv,
+                                           const T* __restrict__ const gj_weight,
+                                           const T* __restrict__ const gj_v,
+                                           const T* __restrict__ const voltage,
+                                           T* __restrict__ const current_density) {
     unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
+    unsigned mask = ballot(0xffffffff, i<n);
     if (i<n) {
-        auto gj = gj_info[i];
-        auto curr = gj.weight * (voltage[gj.loc.second] - voltage[gj.loc.first]); // nA
+        auto cv = gj_cv[i];
+        auto curr = gj_weight[i] * (gj_v[i] - voltage[cv]); // nA
 
-        gpu_atomic_sub(current_density + gj.loc.first, curr);
+        reduce_by_key(-curr, current_density, cv, mask);
     }
 }
 
@@ -51,6 +132,29 @@ __global__ void add_scalar(unsigned n,
     }
 }
 
+template <typename T, typename I>
+__global__ void scatter_scaled_impl(unsigned n,
+                                    T* __restrict__ const to,
+                                    const I* __restrict__ const index,
+                                    const T* __restrict__ const from,
+                                    T scale) {
+    unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
+    if (i<n) {
+        to[index[i]] = scale*from[i];
+    }
+}
+
+template <typename T, typename I>
+__global__ void gather_impl(unsigned n,
+                            T* __restrict__ const to,
+                            const T* __restrict__ const from,
+                            const I* __restrict__ const index) {
+    unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
+    if (i<n) {
+        to[i] = from[index[i]];
+    }
+}
+
 template <typename T, typename I>
 __global__ void set_dt_impl(      T* __restrict__ dt_intdom,
                             const T* __restrict__ time_to,
@@ -71,16 +175,92 @@ __global__ void take_samples_impl(
     multi_event_stream_state<raw_probe_info> s,
     const fvm_value_type* __restrict__ const time,
     fvm_value_type* __restrict__ const sample_time,
-    fvm_value_type* __restrict__ const sample_value)
+    fvm_value_type* __restrict__ const sample_value,
+    unsigned n_acc,
+    const fvm_value_type* const acc_value,
+    fvm_value_type* __restrict__ const acc_weight)
 {
-    unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
+    // One warp per stream: the samples of a stream, e.g. the many of a
+    // whole-cell probe, are taken by the threads of the warp in turn, and
+    // are written to consecutive offsets.
+    constexpr unsigned width = impl::threads_per_warp();
+    const unsigned lane = threadIdx.x%width;
+    const unsigned i = (threadIdx.x+blockIdx.x*blockDim.x)/width;
     if (i<s.n) {
         auto begin = s.ev_data+s.begin_offset[i];
         auto end = s.ev_data+s.end_offset[i];
-        for (auto p = begin; p!=end; ++p) {
+        for (auto p = begin+lane; p<end; p += width) {
             sample_time[p->offset] = time[i];
             sample_value[p->offset] = p->handle? *p->handle: 0;
+
+            // Restart sampled accumulators.
+            if (p->handle>=acc_value && p->handle<acc_value+n_acc) {
+                acc_weight[p->handle-acc_value] = 0;
+            }
+        }
+    }
+}
+
+// One thread per ring; see shared_state::accumulate_samples.
+__global__ void record_sample_rings_impl(unsigned n, fvm_size_type capacity, fvm_size_type pos,
+                                         fvm_value_type* __restrict__ const value,
+                                         fvm_value_type* __restrict__ const time_out,
+                                         const probe_handle* __restrict__ const source,
+                                         const fvm_index_type* __restrict__ const intdom,
+                                         const fvm_value_type* __restrict__ const time) {
+    unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
+    if (i<n) {
+        auto src = source[i];
+        value[i*capacity+pos] = src? *src: 0;
+        time_out[i*capacity+pos] = time[intdom[i]];
+    }
+}
+
+// One thread per accumulator; see shared_state::accumulate_samples.
+__global__ void accumulate_samples_impl(unsigned n,
+                                        fvm_value_type* __restrict__ const value,
+                                        fvm_value_type* __restrict__ const weight,
+                                        const probe_handle* __restrict__ const source,
+                                        const fvm_index_type* __restrict__ const intdom,
+                                        const sampling_policy* __restrict__ const op,
+                                        const fvm_value_type* __restrict__ const dt_intdom) {
+    unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
+    if (i<n) {
+        auto src = source[i];
+        fvm_value_type v = src? *src: 0;
+        fvm_value_type w = dt_intdom[intdom[i]];
+        fvm_value_type a = value[i];
+        fvm_value_type n_i = weight[i];
+
+        if (n_i==0) {
+            a = v;
+        }
+        else {
+            switch (op[i]) {
+            case sampling_policy::mean: a += (v-a)*w/(n_i+w); break;
+            case sampling_policy::min:  a = v<a? v: a; break;
+            case sampling_policy::max:  a = v>a? v: a; break;
+            default:                    a = v; break;
+            }
         }
+        value[i] = a;
+        weight[i] = n_i+w;
+    }
+}
+
+// One thread per weighted sum: value[i] = Σ weight[k]·*term[k], k ∈ [divs[i], divs[i+1]).
+__global__ void reduce_probes(unsigned n,
+                              fvm_value_type* __restrict__ const value,
+                              const probe_handle* __restrict__ const term,
+                              const fvm_value_type* __restrict__ const weight,
+                              const fvm_index_type* __restrict__ const divs) {
+    unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
+    if (i<n) {
+        fvm_value_type sum = 0;
+        for (auto k = divs[i]; k<divs[i+1]; ++k) {
+            sum += weight[k]*(*term[k]);
+        }
+        value[i] = sum;
     }
 }
 
@@ -93,18 +273,66 @@ void add_scalar(std::size_t n, fvm_value_type* data, fvm_value_type v) {
 
     constexpr int block_dim = 128;
     const int nblock = block_count(n, block_dim);
-    kernel::add_scalar<<<nblock, block_dim>>>(n, data, v);
+    kernel::add_scalar<<<nblock, block_dim, 0, current_stream()>>>(n, data, v);
+}
+
+void scatter_scaled_impl(
+    std::size_t n, fvm_value_type* to, const fvm_index_type* index, const fvm_value_type* from, fvm_value_type scale)
+{
+    if (!n) return;
+
+    constexpr int block_dim = 128;
+    const int nblock = block_count(n, block_dim);
+    kernel::scatter_scaled_impl<<<nblock, block_dim, 0, current_stream()>>>(n, to, index, from, scale);
+}
+
+void gather_impl(std::size_t n, fvm_value_type* to, const fvm_value_type* from, const fvm_index_type* index) {
+    if (!n) return;
+
+    constexpr int block_dim = 128;
+    const int nblock = block_count(n, block_dim);
+    kernel::gather_impl<<<nblock, block_dim, 0, current_stream()>>>(n, to, from, index);
 }
 
 void update_time_to_impl(
     std::size_t n, fvm_value_type* time_to, const fvm_value_type* time,
-    fvm_value_type dt, fvm_value_type tmax)
+    fvm_value_type dt, fvm_value_type tmax, const fvm_index_type* dt_level)
 {
     if (!n) return;
 
     constexpr int block_dim = 128;
     const int nblock = block_count(n, block_dim);
-    kernel::update_time_to_impl<<<nblock, block_dim>>>(n, time_to, time, dt, tmax);
+    kernel::update_time_to_impl<<<nblock, block_dim, 0, current_stream()>>>(n, time_to, time, dt, tmax, dt_level);
+}
+
+void save_step_voltage_impl(
+    std::size_t n, fvm_value_type* voltage_prev, fvm_value_type* voltage_start, const fvm_value_type* voltage)
+{
+    if (!n) return;
+
+    constexpr int block_dim = 128;
+    const int nblock = block_count(n, block_dim);
+    kernel::save_step_voltage_impl<<<nblock, block_dim, 0, current_stream()>>>(n, voltage_prev, voltage_start, voltage);
+}
+
+void adapt_dt_impl(
+    fvm_size_type nintdom, fvm_size_type ncv, fvm_index_type* dt_level, fvm_value_type* dt_prev,
+    fvm_value_type* curvature, const fvm_value_type* voltage_prev, const fvm_value_type* voltage_start,
+    const fvm_value_type* voltage, const fvm_value_type* dt_intdom, const fvm_value_type* time,
+    const fvm_value_type* time_to, const fvm_index_type* cv_to_intdom,
+    fvm_value_type dt, fvm_value_type tmax, unsigned max_level, fvm_value_type tolerance)
+{
+    if (!nintdom) return;
+
+    constexpr int block_dim = 128;
+    if (ncv) {
+        const int nblock = block_count(ncv, block_dim);
+        kernel::max_curvature_impl<<<nblock, block_dim, 0, current_stream()>>>(
+            ncv, curvature, voltage_prev, voltage_start, voltage, dt_prev, dt_intdom, cv_to_intdom);
+    }
+    const int nblock = block_count(nintdom, block_dim);
+    kernel::adapt_dt_impl<<<nblock, block_dim, 0, current_stream()>>>(
+        nintdom, dt_level, dt_prev, curvature, dt_intdom, time, time_to, dt, tmax, (int)max_level, tolerance);
 }
 
 void set_dt_impl(
@@ -115,28 +343,75 @@ void set_dt_impl(
 
     constexpr int block_dim = 128;
     const int nblock = block_count(ncomp, block_dim);
-    kernel::set_dt_impl<<<nblock, block_dim>>>(dt_intdom, time_to, time, ncomp, dt_comp, cv_to_intdom);
+    kernel::set_dt_impl<<<nblock, block_dim, 0, current_stream()>>>(dt_intdom, time_to, time, ncomp, dt_comp, cv_to_intdom);
 }
 
 void add_gj_current_impl(
-    fvm_size_type n_gj, const fvm_gap_junction* gj_info, const fvm_value_type* voltage, fvm_value_type* current_density)
+    fvm_size_type n_gj, const fvm_index_type* gj_cv, const fvm_index_type* gj_peer, const fvm_value_type* gj_weight,
+    const fvm_value_type* voltage, fvm_value_type* current_density)
 {
     if (!n_gj) return;
 
     constexpr int block_dim = 128;
     int nblock = block_count(n_gj, block_dim);
-    kernel::add_gj_current_impl<<<nblock, block_dim>>>(n_gj, gj_info, voltage, current_density);
+    kernel::add_gj_current_impl<<<nblock, block_dim, 0, current_stream()>>>(n_gj, gj_cv, gj_peer, gj_weight, voltage, current_density);
+}
+
+void add_remote_gj_current_impl(
+    fvm_size_type n_gj, const fvm_index_type* gj_cv, const fvm_value_type* gj_weight, const fvm_value_type* gj_v,
+    const fvm_value_type* voltage, fvm_value_type* current_density)
+{
+    if (!n_gj) return;
+
+    constexpr int block_dim = 128;
+    int nblock = block_count(n_gj, block_dim);
+    kernel::add_remote_gj_current_impl<<<nblock, block_dim, 0, current_stream()>>>(n_gj, gj_cv, gj_weight, gj_v, voltage, current_density);
+}
+
+void reduce_probes_impl(
+    std::size_t n, fvm_value_type* value, const probe_handle* term,
+    const fvm_value_type* weight, const fvm_index_type* divs)
+{
+    if (!n) return;
+
+    constexpr int block_dim = 128;
+    const int nblock = block_count(n, block_dim);
+    kernel::reduce_probes<<<nblock, block_dim, 0, current_stream()>>>(n, value, term, weight, divs);
 }
 
 void take_samples_impl(
     const multi_event_stream_state<raw_probe_info>& s,
-    const fvm_value_type* time, fvm_value_type* sample_time, fvm_value_type* sample_value)
+    const fvm_value_type* time, fvm_value_type* sample_time, fvm_value_type* sample_value,
+    std::size_t n_acc, const fvm_value_type* acc_value, fvm_value_type* acc_weight)
 {
     if (!s.n_streams()) return;
 
     constexpr int block_dim = 128;
-    const int nblock = block_count(s.n_streams(), block_dim);
-    kernel::take_samples_impl<<<nblock, block_dim>>>(s, time, sample_time, sample_value);
+    const int nblock = block_count(s.n_streams()*impl::threads_per_warp(), block_dim);
+    kernel::take_samples_impl<<<nblock, block_dim, 0, current_stream()>>>(s, time, sample_time, sample_value,
+        n_acc, acc_value, acc_weight);
+}
+
+void accumulate_samples_impl(
+    std::size_t n, fvm_value_type* value, fvm_value_type* weight, const probe_handle* source,
+    const fvm_index_type* intdom, const sampling_policy* op, const fvm_value_type* dt_intdom)
+{
+    if (!n) return;
+
+    constexpr int block_dim = 128;
+    const int nblock = block_count(n, block_dim);
+    kernel::accumulate_samples_impl<<<nblock, block_dim, 0, current_stream()>>>(n, value, weight, source, intdom, op, dt_intdom);
+}
+
+void record_sample_rings_impl(
+    std::size_t n, fvm_size_type capacity, fvm_size_type pos, fvm_value_type* value, fvm_value_type* time_out,
+    const probe_handle* source, const fvm_index_type* intdom, const fvm_value_type* time)
+{
+    if (!n) return;
+
+    constexpr int block_dim = 128;
+    const int nblock = block_count(n, block_dim);
+    kernel::record_sample_rings_impl<<<nblock, block_dim, 0, current_stream()>>>(n, capacity, pos, value, time_out, source, intdom, time);
 }
 
 } // namespace gpu
@@ -1,18 +1,28 @@
 #pragma once
 
+#include <cstdint>
 #include <iosfwd>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include <arbor/fvm_types.hpp>
+#include <arbor/sampling.hpp>
 
 #include "fvm_layout.hpp"
 
 #include "backends/gpu/gpu_store_types.hpp"
+#include "backends/gpu/nernst.hpp"
 #include "backends/gpu/stimulus.hpp"
+#include "backends/gpu/stochastic_input.hpp"
 
 namespace arb {
+
+namespace io {
+class serializer;
+class deserializer;
+} // namespace io
+
 namespace gpu {
 
 /*
@@ -39,9 +49,17 @@ struct ion_state {
     array reset_Xi_;    // (mM) area-weighted user-set internal concentration
     array reset_Xo_;    // (mM) area-weighted user-set internal concentration
     array init_eX_;     // (mM) initial reversal potential
+    array nernst_coeff_; // (mV) RT/zF per instance for the Nernst kernel, or empty
 
     array charge;       // charge of ionic species (global, length 1)
 
+    // For a diffusing ion, the internal concentration is held per CV of the
+    // cell group, and is integrated by the diffusion solver with the source
+    // derived from the ionic current; both are empty otherwise.
+    array Xd_;          // (mM) diffusing internal concentration per CV
+    array Xd_source_;   // ionic current per CV as a source of Xd_, in solver units
+    fvm_value_type source_scale_ = 0; // iX_ to Xd_source_ factor, 1e6/(zF)
+
     ion_state() = default;
 
     ion_state(
@@ -50,12 +68,24 @@ struct ion_state {
         unsigned align
     );
 
-    // Set ion concentrations to weighted proportion of default concentrations.
+    // Hold the internal concentration per CV for diffusion; n_cv is the
+    // number of CVs in the cell group.
+    void configure_diffusion(std::size_t n_cv);
+
+    // Set the diffusion source from the ionic current density.
+    void diffusion_source();
+
+    // Set ion concentrations to weighted proportion of default concentrations,
+    // or for a diffusing ion, the internal concentration to that of Xd_.
     void init_concentration();
 
     // Set ionic current density to zero.
     void zero_current();
 
+    // Set the coefficients of the Nernst equation, scale·T/z with scale
+    // 1e3·R/F [mV/K], from the temperature of the CV of each instance.
+    void configure_nernst(int charge, fvm_value_type scale, const array& temperature_degC);
+
     // Zero currents, reset concentrations, and reset reversal potential from
     // initial values.
     void reset();
@@ -76,6 +106,14 @@ struct istim_state {
     array accu_stim_;       // (A/m²) accumulated stim current / CV area, one per CV with a stimulus.
     iarray envl_index_;     // Per instance index into envl_ arrays, corresponding to last sample time.
 
+    // Per instance envelope segment containing the last sample time: the
+    // envelope is seg_j0_ + seg_slope_·(t - seg_t0_) for t < seg_t1_, see
+    // the multicore istim_state.
+    array seg_t0_;          // (ms)
+    array seg_t1_;          // (ms)
+    array seg_j0_;          // (A/m²)
+    array seg_slope_;       // (A/m²/ms)
+
     // Parameter pack presents pointers to state arrays, relevant shared state to GPU kernels.
     // Initialized at state construction.
     istim_pp ppack_;
@@ -86,6 +124,10 @@ struct istim_state {
     // Zero stim current, reset indices.
     void reset();
 
+    // Find the envelope segments afresh from the envelope indices at the
+    // next sample, e.g. after the indices are restored.
+    void clear_segments();
+
     // Contribute to current density:
     void add_current(const array& time, const iarray& cv_to_intdom, array& current_density);
 
@@ -98,6 +140,46 @@ struct istim_state {
     istim_state() = default;
 };
 
+// Stochastic inputs, see backends/stochastic_input.hpp. In each step, one
+// thread per target instance draws the event counts of its inputs and sets
+// the summed weight of its event; each event is a stream of its own, so that
+// the events of a mechanism are applied in parallel.
+struct stochastic_input_state {
+    // Integration domain, parameters and generator key, per input.
+    iarray intdom_;
+    array weight_;
+    array rate_;            // (kHz)
+    array tstart_;          // (ms)
+    array tstop_;           // (ms)
+    memory::device_vector<std::uint64_t> seed_;
+    memory::device_vector<std::uint64_t> stream_;
+
+    // Partition of the inputs by target instance, the event of each
+    // instance, and the bounds [i, i+1) of the stream of event i.
+    iarray instance_divs_;
+    memory::device_vector<arb_deliverable_event_data> events_;
+    iarray stream_begin_;
+    iarray stream_end_;
+
+    // Range of the instances of each mechanism with inputs.
+    std::unordered_map<unsigned, std::pair<arb_index_type, arb_index_type>> mech_range_;
+
+    stochastic_input_pp ppack_;
+
+    std::size_t size() const { return events_.size(); }
+
+    // Draw the counts of the step from time to time+dt_intdom of each
+    // integration domain, and set the weights of the events.
+    void sample(const array& time, const array& dt_intdom);
+
+    // The sampled events of a mechanism; empty if it has no inputs.
+    arb_deliverable_event_stream events(unsigned mech_id) const;
+
+    stochastic_input_state(const fvm_stochastic_input_config& config);
+
+    stochastic_input_state() = default;
+};
+
 struct shared_state {
     struct mech_storage {
         array data_;
@@ -109,20 +191,37 @@ struct shared_state {
         memory::device_vector<arb_value_type*> parameters_d_;
         memory::device_vector<arb_value_type*> state_vars_d_;
         memory::device_vector<arb_ion_state>   ion_states_d_;
+
+        // Values of the random variables, and their keys; see mechanism_layout.
+        array random_data_;
+        std::vector<arb_value_type*> random_numbers_;
+        memory::device_vector<arb_value_type*> random_numbers_d_;
+        memory::device_vector<std::uint64_t> random_instance_;
+        std::uint64_t random_seed_ = 0;
+        std::uint64_t random_stream_ = 0;
     };
 
     fvm_size_type n_intdom = 0;   // Number of distinct integration domains.
-    fvm_size_type n_detector = 0; // Max number of detectors on all cells.
     fvm_size_type n_cv = 0;       // Total number of CVs.
     fvm_size_type n_gj = 0;       // Total number of GJs.
 
     iarray cv_to_intdom;     // Maps CV index to intdom index.
     iarray cv_to_cell;       // Maps CV index to cell index.
-    gjarray gap_junctions;   // Stores gap_junction info.
+    iarray gj_cv;             // Maps GJ index to CV, sorted by CV and then peer.
+    iarray gj_peer;           // Maps GJ index to peer CV.
+    array gj_weight;          // Maps GJ index to weight [μS].
+    iarray gj_remote_cv;      // Maps remote GJ index to CV, see configure_remote_gap_junctions.
+    array gj_remote_weight;   // Maps remote GJ index to weight [μS].
+    array gj_remote_v;        // Maps remote GJ index to last received peer voltage [mV].
     array time;              // Maps intdom index to integration start time [ms].
     array time_to;           // Maps intdom index to integration stop time [ms].
     array dt_intdom;         // Maps intdom index to (stop time) - (start time) [ms].
     array dt_cv;             // Maps CV index to dt [ms].
+    iarray dt_level;         // Maps intdom index to adaptive step size level, see configure_adaptive_dt.
+    array dt_prev;           // Maps intdom index to length of the previous adaptive step [ms].
+    array dt_curvature;      // Maps intdom index to max estimated |d²v/dt²| in the step [mV/ms²].
+    array voltage_start;     // Maps CV index to voltage at the start of the step [mV].
+    array voltage_prev;      // Maps CV index to voltage at the start of the previous step [mV].
     array voltage;           // Maps CV index to membrane voltage [mV].
     array current_density;   // Maps CV index to current density [A/m²].
     array conductivity;      // Maps CV index to membrane conductivity [kS/m²].
@@ -132,13 +231,57 @@ struct shared_state {
     array diam_um;           // Maps CV to local diameter (read only) [µm].
 
     array time_since_spike;   // Stores time since last spike on any detector, organized by cell.
+    iarray detector_divs;     // Partitions time_since_spike by cell: detectors of cell i are in [divs[i], divs[i+1]).
     iarray src_to_spike;      // Maps spike source index to spike index
 
     arb_value_type* time_ptr;
 
+    // Adaptive time steps are used if adaptive_dt_tolerance>0 [mV].
+    fvm_value_type adaptive_dt_tolerance = 0;
+    unsigned adaptive_dt_max_level = 0;
+
+    // Weighted sums of state values for probes: sum i is the sum of
+    // reduction_weight[k]·*reduction_term[k] for k in the i-th range of
+    // reduction_divs. Sums are updated before samples are taken.
+    array reduction_value;
+    memory::device_vector<probe_handle> reduction_term;
+    array reduction_weight;
+    iarray reduction_divs;
+
+    // Accumulators for decimating samplers: accumulator i summarizes the
+    // values of *accumulator_source[i] by accumulator_op[i] over the steps
+    // of integration domain accumulator_intdom[i] since it was last sampled,
+    // which together last accumulator_weight[i] ms. Accumulators are sampled
+    // through handles into accumulator_value.
+    array accumulator_value;
+    array accumulator_weight;
+    memory::device_vector<probe_handle> accumulator_source;
+    iarray accumulator_intdom;
+    memory::device_vector<sampling_policy> accumulator_op;
+
+    // Ring buffers for triggered samplers: ring i holds the values of
+    // *ring_source[i] at the start of the last ring_capacity steps, and the
+    // times of integration domain ring_intdom[i] at these steps, at
+    // [i*ring_capacity, (i+1)*ring_capacity) of ring_value and ring_time.
+    // Step n is held at offset n%ring_capacity; ring_steps steps have been
+    // recorded.
+    fvm_size_type ring_capacity = 0;
+    fvm_size_type ring_steps = 0;
+    array ring_value;
+    array ring_time;
+    memory::device_vector<probe_handle> ring_source;
+    iarray ring_intdom;
+
     istim_state stim_data;
+    stochastic_input_state stochastic_inputs;
     std::unordered_map<std::string, ion_state> ion_data;
     deliverable_event_stream deliverable_events;
+
+    // The ions with reversal potentials set by the Nernst kernel: those with
+    // constant and those with varying concentrations, each updated by one launch.
+    std::vector<nernst_pp> nernst_constant, nernst_varying;
+    memory::device_vector<nernst_pp> nernst_constant_d, nernst_varying_d;
+    fvm_size_type nernst_max_size = 0;
     std::unordered_map<unsigned, mech_storage> storage;
 
     shared_state() = default;
@@ -146,7 +289,7 @@ struct shared_state {
     shared_state(
         fvm_size_type n_intdom,
         fvm_size_type n_cell,
-        fvm_size_type n_detector,
+        const std::vector<fvm_index_type>& detector_divs,
         const std::vector<fvm_index_type>& cv_to_intdom_vec,
         const std::vector<fvm_index_type>& cv_to_cell_vec,
         const std::vector<fvm_gap_junction>& gj_vec,
@@ -162,20 +305,87 @@ struct shared_state {
 
     void set_parameter(mechanism&, const std::string&, const std::vector<arb_value_type>&);
 
+    // Events marked for delivery to a mechanism. Events are not combined per
+    // instance on the GPU, as the event data are in device memory.
+    arb_deliverable_event_stream marked_events(mechanism&);
+
     void add_ion(
         const std::string& ion_name,
         int charge,
         const fvm_ion_config& ion_data);
 
+    void configure_ion_diffusion(const std::string& ion_name);
+
     void configure_stimulus(const fvm_stimulus_config&);
 
+    void configure_stochastic_inputs(const fvm_stochastic_input_config&);
+
+    void configure_reductions(
+        const std::vector<probe_handle>& terms,
+        const std::vector<fvm_value_type>& weights,
+        const std::vector<fvm_index_type>& divs);
+
+    void configure_accumulators(
+        const std::vector<probe_handle>& sources,
+        const std::vector<fvm_index_type>& intdoms,
+        const std::vector<sampling_policy>& ops);
+
+    void configure_sample_rings(
+        const std::vector<probe_handle>& sources,
+        const std::vector<fvm_index_type>& intdoms,
+        fvm_size_type capacity);
+
+    // Append the times and values held by ring i with times in [t0, t1], in
+    // order of time.
+    void read_sample_ring(
+        std::size_t i,
+        fvm_value_type t0,
+        fvm_value_type t1,
+        std::vector<fvm_value_type>& times,
+        std::vector<fvm_value_type>& values) const;
+
     void zero_currents();
 
     void ions_init_concentration();
 
-    // Set time_to to earliest of time+dt_step and tmax.
+    // Set the reversal potential of the ion by the Nernst kernel in place of
+    // a reversal potential mechanism, with scale 1e3·R/F [mV/K].
+    void configure_nernst(const std::string& ion_name, fvm_value_type scale, bool constant);
+
+    // Set the reversal potentials of the ions configured by configure_nernst
+    // in one launch: of those with constant concentrations, which are set on
+    // reset, or of those with varying concentrations, set on every step.
+    void ions_nernst_reversal_potential(bool constant);
+
+    // Use adaptive time steps: each integration domain steps with
+    // dt_step·2^level, where the level in [0, max_level] is chosen after each
+    // step such that the estimated local voltage error stays below tolerance.
+    void configure_adaptive_dt(fvm_value_type tolerance, unsigned max_level);
+
+    // Add gap junctions with peers in other cell groups, at the given CVs
+    // with the given weights [μS]. The voltages of their peers are set by
+    // set_remote_gj_voltage, and held until it is called again.
+    void configure_remote_gap_junctions(
+        const std::vector<fvm_index_type>& cv,
+        const std::vector<fvm_value_type>& weight);
+
+    void set_remote_gj_voltage(const std::vector<fvm_value_type>& v);
+
+    // Set time_to to earliest of time+dt_step and tmax, or of
+    // time+dt_step·2^level and tmax with adaptive time steps.
     void update_time_to(fvm_value_type dt_step, fvm_value_type tmax);
 
+    // With adaptive time steps, keep the voltage at the start of the step;
+    // call before the matrix solve.
+    void save_step_voltage();
+
+    // With adaptive time steps, choose the level of the next step of each
+    // integration domain from the voltages at the start of the previous
+    // step, and at the start and end of this step; call after the matrix
+    // solve. A step that was cut short before tmax by an event restarts at
+    // level 0.
+    void adapt_dt(fvm_value_type dt_step, fvm_value_type tmax);
+
     // Set the per-intdom and per-compartment dt from time_to - time.
     void set_dt();
 
@@ -185,6 +395,16 @@ struct shared_state {
     // Update stimulus state and add current contributions.
     void add_stimulus_current();
 
+    // Draw the events of the stochastic inputs for the step from time to time_to.
+    void sample_stochastic_inputs();
+
+    // The events of the stochastic inputs to a mechanism in the step.
+    arb_deliverable_event_stream stochastic_events(mechanism&) const;
+
+    // Draw the values of the random variables of a mechanism for the step
+    // from the integration start time of each instance.
+    void draw_white_noise(mechanism&);
+
     // Return minimum and maximum time value [ms] across cells.
     std::pair<fvm_value_type, fvm_value_type> time_bounds() const;
 
@@ -192,13 +412,31 @@ struct shared_state {
     // (Used for solution bounds checking.)
     std::pair<fvm_value_type, fvm_value_type> voltage_bounds() const;
 
-    // Take samples according to marked events in a sample_event_stream.
+    // Size in bytes of the state of the cells, ions, stimuli, stochastic
+    // inputs, mechanisms, probe reductions and accumulators.
+    std::size_t bytes() const;
+
+    // Add the current values of the accumulator sources, weighted by the
+    // integration domain dt, to the accumulators, and record those of the
+    // ring sources.
+    void accumulate_samples();
+
+    // Take samples according to marked events in a sample_event_stream,
+    // updating the weighted sums first. Sampled accumulators are restarted.
     void take_samples(
         const sample_event_stream::state& s,
         array& sample_time,
         array& sample_value);
 
     void reset();
+
+    // Return the integration domains to time zero, keeping the state of the
+    // cells, e.g. once they have been relaxed to rest.
+    void reset_time();
+
+    // Write and restore the time-dependent state, for checkpointing.
+    void serialize(io::serializer&) const;
+    void deserialize(io::deserializer&);
 };
 
 // For debugging only
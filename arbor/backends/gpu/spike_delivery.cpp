@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/common_types.hpp>
+#include <arbor/spike.hpp>
+
+#include "backends/event.hpp"
+#include "backends/gpu/multi_event_stream.hpp"
+#include "backends/gpu/spike_delivery.hpp"
+#include "memory/gpu_wrappers.hpp"
+#include "memory/memory.hpp"
+#include "util/rangeutil.hpp"
+
+namespace arb {
+namespace gpu {
+
+// These wrappers are implemented in the spike_delivery.cu file, which
+// is separately compiled by nvcc, to protect nvcc from having to parse C++17.
+void match_spikes_w(unsigned n,
+        const spike* spikes,
+        unsigned n_source,
+        const cell_member_type* sources,
+        const fvm_index_type* offsets,
+        fvm_index_type* first,
+        fvm_index_type* count);
+void make_events_w(unsigned n,
+        const spike* spikes,
+        const fvm_index_type* first,
+        const fvm_index_type* count,
+        const fvm_index_type* pos,
+        const target_handle* targets,
+        const float* weights,
+        const float* delays,
+        deliverable_event* out);
+void block_scan_w(unsigned n,
+        const fvm_index_type* in,
+        fvm_index_type* out,
+        fvm_index_type* block_sums);
+void add_block_offsets_w(unsigned n,
+        fvm_index_type* out,
+        const fvm_index_type* block_offsets);
+void flag_due_w(unsigned n,
+        const deliverable_event* events,
+        fvm_value_type t_until,
+        fvm_index_type* flags);
+void split_due_w(unsigned n,
+        const deliverable_event* events,
+        const fvm_index_type* flags,
+        const fvm_index_type* pos,
+        fvm_value_type bin_interval,
+        fvm_value_type t_start,
+        deliverable_event* due,
+        deliverable_event* rest);
+void count_by_stream_w(unsigned n,
+        const deliverable_event* events,
+        unsigned n_intdom,
+        const fvm_index_type* partition,
+        unsigned n_key,
+        unsigned unkeyed,
+        fvm_index_type* counts);
+void scatter_by_stream_w(unsigned n,
+        const deliverable_event* events,
+        unsigned n_intdom,
+        const fvm_index_type* partition,
+        unsigned n_key,
+        unsigned unkeyed,
+        fvm_index_type* cursor,
+        fvm_value_type* ev_time,
+        deliverable_event_data* ev_data);
+void sort_streams_w(unsigned n,
+        const fvm_index_type* divs,
+        fvm_value_type* ev_time,
+        deliverable_event_data* ev_data);
+
+// The number of elements scanned by each thread block of block_scan_w().
+constexpr unsigned scan_block_size = 512;
+
+// Reallocate `a`, discarding its contents, if it holds fewer than n elements.
+template <typename Array>
+static void grow(Array& a, std::size_t n) {
+    if (a.size()<n) a = Array(n);
+}
+
+spike_delivery::spike_delivery(unsigned n_intdom):
+    n_intdom_(n_intdom),
+    offsets_(1, 0),
+    stream_count_(n_intdom+1),
+    stream_divs_(n_intdom+1)
+{}
+
+void spike_delivery::set_connections(std::vector<target_connection> connections) {
+    util::sort_by(connections, [](const target_connection& c) { return c.source; });
+
+    std::vector<cell_member_type> sources;
+    std::vector<index_type> offsets = {0};
+    std::vector<target_handle> targets;
+    std::vector<float> weights, delays;
+
+    for (const auto& c: connections) {
+        if (sources.empty() || sources.back()!=c.source) {
+            sources.push_back(c.source);
+            offsets.push_back(offsets.back());
+        }
+        ++offsets.back();
+        targets.push_back(c.target);
+        weights.push_back(c.weight);
+        delays.push_back(c.delay);
+    }
+
+    sources_ = memory::on_gpu(sources);
+    host_sources_ = std::move(sources);
+    offsets_ = memory::on_gpu(offsets);
+    targets_ = memory::on_gpu(targets);
+    weights_ = memory::on_gpu(weights);
+    delays_ = memory::on_gpu(delays);
+}
+
+void spike_delivery::set_binning_policy(binning_kind policy, value_type bin_interval) {
+    switch (policy) {
+    case binning_kind::none:
+        bin_interval_ = 0;
+        break;
+    case binning_kind::regular:
+        bin_interval_ = bin_interval;
+        break;
+    default:
+        throw arbor_exception("gpu::spike_delivery: only regular event binning is supported with GPU spike delivery");
+    }
+}
+
+void spike_delivery::enqueue(std::shared_ptr<const std::vector<spike>> spikes) {
+    std::lock_guard<std::mutex> guard(queue_mutex_);
+    queued_.push_back(std::move(spikes));
+}
+
+void spike_delivery::clear() {
+    std::lock_guard<std::mutex> guard(queue_mutex_);
+    queued_.clear();
+    n_pending_ = 0;
+}
+
+void spike_delivery::reserve_pending(std::size_t n) {
+    if (pending_.size()>=n) return;
+
+    event_array grown(std::max(n, 2*pending_.size()));
+    if (n_pending_) {
+        memory::copy(pending_(0, n_pending_), grown(0, n_pending_));
+    }
+    std::swap(pending_, grown);
+}
+
+void spike_delivery::scan(const index_type* in, index_type* out, unsigned n, unsigned level) {
+    unsigned n_block = (n+scan_block_size-1)/scan_block_size;
+    if (scan_sums_.size()<=level) {
+        scan_sums_.resize(level+1);
+        scan_offsets_.resize(level+1);
+    }
+    auto& sums = scan_sums_[level];
+    auto& offsets = scan_offsets_[level];
+    grow(sums, n_block);
+    grow(offsets, n_block);
+
+    block_scan_w(n, in, out, sums.data());
+    if (n_block>1) {
+        scan(sums.data(), offsets.data(), n_block, level+1);
+        add_block_offsets_w(n, out, offsets.data());
+    }
+}
+
+spike_delivery::index_type spike_delivery::scan_total(const index_type* in, index_type* out, unsigned n) {
+    scan(in, out, n+1, 0);
+
+    index_type total;
+    memory::gpu_memcpy_d2h(&total, out+n, sizeof(index_type));
+    return total;
+}
+
+void spike_delivery::generate_events() {
+    unsigned n = spikes_host_.size();
+    if (!n || !sources_.size()) return;
+
+    // The copy from the page locked buffer is complete once scan_total()
+    // below has synchronized the stream.
+    grow(spikes_, n);
+    memory::copy(spikes_host_, spikes_(0, n));
+
+    grow(first_, n+1);
+    grow(count_, n+1);
+    grow(pos_, n+1);
+    match_spikes_w(n, spikes_.data(), sources_.size(), sources_.data(), offsets_.data(), first_.data(), count_.data());
+
+    auto n_event = scan_total(count_.data(), pos_.data(), n);
+    if (!n_event) return;
+
+    reserve_pending(n_pending_+n_event);
+    make_events_w(n, spikes_.data(), first_.data(), count_.data(), pos_.data(),
+        targets_.data(), weights_.data(), delays_.data(), pending_.data()+n_pending_);
+    n_pending_ += n_event;
+}
+
+void spike_delivery::stage(
+    value_type t_start,
+    value_type t_until,
+    const std::vector<deliverable_event>& staged,
+    multi_event_stream<deliverable_event>& stream)
+{
+    // Spikes of all queued exchanges are gathered into a page locked
+    // buffer, and matched in a single pass. Only the spikes of sources with
+    // connections onto the group are copied to the device: with many groups,
+    // or many domains, these are a small part of the global spikes.
+    std::vector<std::shared_ptr<const std::vector<spike>>> batches;
+    {
+        std::lock_guard<std::mutex> guard(queue_mutex_);
+        std::swap(batches, queued_);
+    }
+    if (!batches.empty()) {
+        spikes_host_.clear();
+        for (const auto& b: batches) {
+            for (const auto& s: *b) {
+                if (std::binary_search(host_sources_.begin(), host_sources_.end(), s.source)) {
+                    spikes_host_.push_back(s);
+                }
+            }
+        }
+        generate_events();
+    }
+
+    // Split the pending events into those due in this epoch, which are
+    // binned, and the remainder, which keep their order.
+    unsigned n = n_pending_;
+    index_type n_due = 0;
+    if (n) {
+        grow(count_, n+1);
+        grow(pos_, n+1);
+        flag_due_w(n, pending_.data(), t_until, count_.data());
+        n_due = scan_total(count_.data(), pos_.data(), n);
+    }
+
+    // Events staged on the host are already binned, and follow the due events.
+    std::size_t n_staged = staged.size();
+    std::size_t n_total = n_due+n_staged;
+    if (n_total>std::numeric_limits<index_type>::max()) {
+        throw arbor_internal_error("gpu::spike_delivery: too many events for index type");
+    }
+
+    grow(due_, n_total);
+    if (n_due) {
+        grow(pending_scratch_, pending_.size());
+        split_due_w(n, pending_.data(), count_.data(), pos_.data(), bin_interval_, t_start,
+            due_.data(), pending_scratch_.data());
+        std::swap(pending_, pending_scratch_);
+        n_pending_ = n-n_due;
+    }
+    if (n_staged) {
+        memory::copy(staged, due_(n_due, n_total));
+    }
+
+    // Partition the events by stream, that is by integration domain within
+    // the partition of their mechanism: count, scan for the divisions, then
+    // scatter with the divisions as cursors, and sort the events of each
+    // stream by time.
+    unsigned n_stream = n_intdom_*stream.n_partitions();
+    const index_type* partition = stream.partitions().size()? stream.partitions().data(): nullptr;
+    unsigned n_key = stream.partitions().size();
+    unsigned unkeyed = stream.unkeyed_partition();
+    grow(stream_count_, n_stream+1);
+    grow(stream_divs_, n_stream+1);
+
+    memory::fill(stream_count_, 0);
+    count_by_stream_w(n_total, due_.data(), n_intdom_, partition, n_key, unkeyed, stream_count_.data());
+    scan(stream_count_.data(), stream_divs_.data(), n_stream+1, 0);
+    memory::copy(stream_divs_(0, n_stream), stream_count_(0, n_stream));
+
+    multi_event_stream_base::array ev_time(n_total);
+    multi_event_stream<deliverable_event>::data_array ev_data(n_total);
+    scatter_by_stream_w(n_total, due_.data(), n_intdom_, partition, n_key, unkeyed, stream_count_.data(), ev_time.data(), ev_data.data());
+    sort_streams_w(n_stream, stream_divs_.data(), ev_time.data(), ev_data.data());
+
+    stream.init(std::move(ev_time), std::move(ev_data), stream_divs_);
+}
+
+} // namespace gpu
+} // namespace arb
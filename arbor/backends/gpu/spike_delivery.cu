@@ -0,0 +1,380 @@
+#include <arbor/common_types.hpp>
+#include <arbor/fvm_types.hpp>
+#include <arbor/spike.hpp>
+#include <arbor/gpu/gpu_common.hpp>
+
+#include "backends/event.hpp"
+
+namespace arb {
+namespace gpu {
+
+// Must match the block size assumed by spike_delivery::exclusive_scan().
+constexpr unsigned scan_block_size = 512;
+
+namespace kernels {
+    __device__
+    inline bool member_less(const cell_member_type& a, const cell_member_type& b) {
+        return a.gid<b.gid || (a.gid==b.gid && a.index<b.index);
+    }
+
+    // For each spike, find the range of connections from its source.
+    // The count of entry n, one past the last spike, is set to zero.
+    template <typename I>
+    __global__ void match_spikes(
+        unsigned n,
+        const spike* __restrict__ const spikes,
+        unsigned n_source,
+        const cell_member_type* __restrict__ const sources,
+        const I* __restrict__ const offsets,
+        I* __restrict__ const first,
+        I* __restrict__ const count)
+    {
+        unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
+        if (i<n) {
+            auto s = spikes[i].source;
+            unsigned lo = 0, hi = n_source;
+            while (lo<hi) {
+                unsigned mid = (lo+hi)/2;
+                if (member_less(sources[mid], s)) lo = mid+1;
+                else hi = mid;
+            }
+            bool found = lo<n_source && !member_less(s, sources[lo]);
+            first[i] = found? offsets[lo]: 0;
+            count[i] = found? offsets[lo+1]-offsets[lo]: 0;
+        }
+        else if (i==n) {
+            count[n] = 0;
+        }
+    }
+
+    template <typename I>
+    __global__ void make_events(
+        unsigned n,
+        const spike* __restrict__ const spikes,
+        const I* __restrict__ const first,
+        const I* __restrict__ const count,
+        const I* __restrict__ const pos,
+        const target_handle* __restrict__ const targets,
+        const float* __restrict__ const weights,
+        const float* __restrict__ const delays,
+        deliverable_event* __restrict__ const out)
+    {
+        unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
+        if (i<n) {
+            auto t = spikes[i].time;
+            auto c = first[i];
+            auto p = pos[i];
+            for (I k = 0; k<count[i]; ++k, ++c, ++p) {
+                out[p].time = t+delays[c];
+                out[p].weight = weights[c];
+                out[p].handle = targets[c];
+            }
+        }
+    }
+
+    // Exclusive scan of each block of `in`, with the block totals written
+    // to `block_sums`.
+    template <typename I>
+    __global__ void block_scan(
+        unsigned n,
+        const I* __restrict__ const in,
+        I* __restrict__ const out,
+        I* __restrict__ const block_sums)
+    {
+        __shared__ I buf[2][scan_block_size];
+
+        unsigned tid = threadIdx.x;
+        unsigned i = tid+blockIdx.x*blockDim.x;
+        I x = i<n? in[i]: 0;
+
+        int src = 0;
+        buf[src][tid] = x;
+        __syncthreads();
+        for (unsigned d = 1; d<blockDim.x; d *= 2) {
+            I v = buf[src][tid];
+            if (tid>=d) v += buf[src][tid-d];
+            buf[1-src][tid] = v;
+            __syncthreads();
+            src = 1-src;
+        }
+
+        I inclusive = buf[src][tid];
+        if (i<n) out[i] = inclusive-x;
+        if (tid==blockDim.x-1) block_sums[blockIdx.x] = inclusive;
+    }
+
+    template <typename I>
+    __global__ void add_block_offsets(
+        unsigned n,
+        I* __restrict__ const out,
+        const I* __restrict__ const block_offsets)
+    {
+        unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
+        if (i<n) {
+            out[i] += block_offsets[blockIdx.x];
+        }
+    }
+
+    // Flag the events before t_until; the flag of entry n is set to zero.
+    template <typename T, typename I>
+    __global__ void flag_due(
+        unsigned n,
+        const deliverable_event* __restrict__ const events,
+        T t_until,
+        I* __restrict__ const flags)
+    {
+        unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
+        if (i<n) {
+            flags[i] = events[i].time<t_until;
+        }
+        else if (i==n) {
+            flags[n] = 0;
+        }
+    }
+
+    // Move the flagged events to `due`, binning their times, and the
+    // remainder to `rest`, preserving their order.
+    template <typename T, typename I>
+    __global__ void split_due(
+        unsigned n,
+        const deliverable_event* __restrict__ const events,
+        const I* __restrict__ const flags,
+        const I* __restrict__ const pos,
+        T bin_interval,
+        T t_start,
+        deliverable_event* __restrict__ const due,
+        deliverable_event* __restrict__ const rest)
+    {
+        unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
+        if (i<n) {
+            if (flags[i]) {
+                auto& ev = due[pos[i]];
+                ev = events[i];
+                T t = ev.time;
+                if (bin_interval>0) {
+                    t = floor(t/bin_interval)*bin_interval;
+                }
+                ev.time = t<t_start? t_start: t;
+            }
+            else {
+                rest[i-pos[i]] = events[i];
+            }
+        }
+    }
+
+    // The stream of an event: its integration domain within the partition of
+    // its mechanism, if the streams are partitioned, or -1 if it is dropped.
+    // Events of keys past the `n_key` of the map go to partition `unkeyed`.
+    template <typename I>
+    __device__
+    inline I stream_of(const deliverable_event& ev, unsigned n_intdom, const I* partition, unsigned n_key, unsigned unkeyed) {
+        if (!partition) return ev.handle.intdom_index;
+        I p = ev.handle.mech_id<n_key? partition[ev.handle.mech_id]: I(unkeyed);
+        return p<0? I(-1): p*I(n_intdom)+I(ev.handle.intdom_index);
+    }
+
+    template <typename I>
+    __global__ void count_by_stream(
+        unsigned n,
+        const deliverable_event* __restrict__ const events,
+        unsigned n_intdom,
+        const I* __restrict__ const partition,
+        unsigned n_key,
+        unsigned unkeyed,
+        I* __restrict__ const counts)
+    {
+        unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
+        if (i<n) {
+            I s = stream_of(events[i], n_intdom, partition, n_key, unkeyed);
+            if (s>=0) atomicAdd(counts+s, I(1));
+        }
+    }
+
+    template <typename T, typename I>
+    __global__ void scatter_by_stream(
+        unsigned n,
+        const deliverable_event* __restrict__ const events,
+        unsigned n_intdom,
+        const I* __restrict__ const partition,
+        unsigned n_key,
+        unsigned unkeyed,
+        I* __restrict__ const cursor,
+        T* __restrict__ const ev_time,
+        deliverable_event_data* __restrict__ const ev_data)
+    {
+        unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
+        if (i<n) {
+            const auto& ev = events[i];
+            I s = stream_of(ev, n_intdom, partition, n_key, unkeyed);
+            if (s<0) return;
+            I j = atomicAdd(cursor+s, I(1));
+            ev_time[j] = ev.time;
+            ev_data[j].mech_id = ev.handle.mech_id;
+            ev_data[j].mech_index = ev.handle.mech_index;
+            ev_data[j].weight = ev.weight;
+        }
+    }
+
+    template <typename T>
+    __device__
+    inline bool event_less(T ta, const deliverable_event_data& a, T tb, const deliverable_event_data& b) {
+        if (ta!=tb) return ta<tb;
+        if (a.mech_id!=b.mech_id) return a.mech_id<b.mech_id;
+        if (a.mech_index!=b.mech_index) return a.mech_index<b.mech_index;
+        return a.weight<b.weight;
+    }
+
+    // Sort the events of each stream by time, with one thread per stream.
+    // Ties are ordered by target and then weight, as on the host, so that
+    // the order of delivery does not depend on the order of the scatter.
+    template <typename T, typename I>
+    __global__ void sort_streams(
+        unsigned n,
+        const I* __restrict__ const divs,
+        T* __restrict__ const ev_time,
+        deliverable_event_data* __restrict__ const ev_data)
+    {
+        unsigned i = threadIdx.x+blockIdx.x*blockDim.x;
+        if (i<n) {
+            auto b = divs[i];
+            auto e = divs[i+1];
+            for (auto j = b+1; j<e; ++j) {
+                T t = ev_time[j];
+                deliverable_event_data d = ev_data[j];
+                auto k = j;
+                for (; k>b && event_less(t, d, ev_time[k-1], ev_data[k-1]); --k) {
+                    ev_time[k] = ev_time[k-1];
+                    ev_data[k] = ev_data[k-1];
+                }
+                ev_time[k] = t;
+                ev_data[k] = d;
+            }
+        }
+    }
+} // namespace kernels
+
+void match_spikes_w(unsigned n,
+        const spike* spikes,
+        unsigned n_source,
+        const cell_member_type* sources,
+        const fvm_index_type* offsets,
+        fvm_index_type* first,
+        fvm_index_type* count)
+{
+    const int nblock = impl::block_count(n+1, 128);
+    kernels::match_spikes
+        <<<nblock, 128, 0, current_stream()>>>
+        (n, spikes, n_source, sources, offsets, first, count);
+}
+
+void make_events_w(unsigned n,
+        const spike* spikes,
+        const fvm_index_type* first,
+        const fvm_index_type* count,
+        const fvm_index_type* pos,
+        const target_handle* targets,
+        const float* weights,
+        const float* delays,
+        deliverable_event* out)
+{
+    if (!n) return;
+    const int nblock = impl::block_count(n, 128);
+    kernels::make_events
+        <<<nblock, 128, 0, current_stream()>>>
+        (n, spikes, first, count, pos, targets, weights, delays, out);
+}
+
+void block_scan_w(unsigned n,
+        const fvm_index_type* in,
+        fvm_index_type* out,
+        fvm_index_type* block_sums)
+{
+    const int nblock = impl::block_count(n, scan_block_size);
+    kernels::block_scan
+        <<<nblock, scan_block_size, 0, current_stream()>>>
+        (n, in, out, block_sums);
+}
+
+void add_block_offsets_w(unsigned n,
+        fvm_index_type* out,
+        const fvm_index_type* block_offsets)
+{
+    const int nblock = impl::block_count(n, scan_block_size);
+    kernels::add_block_offsets
+        <<<nblock, scan_block_size, 0, current_stream()>>>
+        (n, out, block_offsets);
+}
+
+void flag_due_w(unsigned n,
+        const deliverable_event* events,
+        fvm_value_type t_until,
+        fvm_index_type* flags)
+{
+    const int nblock = impl::block_count(n+1, 128);
+    kernels::flag_due
+        <<<nblock, 128, 0, current_stream()>>>
+        (n, events, t_until, flags);
+}
+
+void split_due_w(unsigned n,
+        const deliverable_event* events,
+        const fvm_index_type* flags,
+        const fvm_index_type* pos,
+        fvm_value_type bin_interval,
+        fvm_value_type t_start,
+        deliverable_event* due,
+        deliverable_event* rest)
+{
+    if (!n) return;
+    const int nblock = impl::block_count(n, 128);
+    kernels::split_due
+        <<<nblock, 128, 0, current_stream()>>>
+        (n, events, flags, pos, bin_interval, t_start, due, rest);
+}
+
+void count_by_stream_w(unsigned n,
+        const deliverable_event* events,
+        unsigned n_intdom,
+        const fvm_index_type* partition,
+        unsigned n_key,
+        unsigned unkeyed,
+        fvm_index_type* counts)
+{
+    if (!n) return;
+    const int nblock = impl::block_count(n, 128);
+    kernels::count_by_stream
+        <<<nblock, 128, 0, current_stream()>>>
+        (n, events, n_intdom, partition, n_key, unkeyed, counts);
+}
+
+void scatter_by_stream_w(unsigned n,
+        const deliverable_event* events,
+        unsigned n_intdom,
+        const fvm_index_type* partition,
+        unsigned n_key,
+        unsigned unkeyed,
+        fvm_index_type* cursor,
+        fvm_value_type* ev_time,
+        deliverable_event_data* ev_data)
+{
+    if (!n) return;
+    const int nblock = impl::block_count(n, 128);
+    kernels::scatter_by_stream
+        <<<nblock, 128, 0, current_stream()>>>
+        (n, events, n_intdom, partition, n_key, unkeyed, cursor, ev_time, ev_data);
+}
+
+void sort_streams_w(unsigned n,
+        const fvm_index_type* divs,
+        fvm_value_type* ev_time,
+        deliverable_event_data* ev_data)
+{
+    if (!n) return;
+    const int nblock = impl::block_count(n, 128);
+    kernels::sort_streams
+        <<<nblock, 128, 0, current_stream()>>>
+        (n, divs, ev_time, ev_data);
+}
+
+} // namespace gpu
+} // namespace arb
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+#include <arbor/fvm_types.hpp>
+#include <arbor/spike.hpp>
+
+#include "backends/event.hpp"
+#include "backends/gpu/multi_event_stream.hpp"
+#include "memory/memory.hpp"
+#include "util/rangeutil.hpp"
+
+namespace arb {
+namespace gpu {
+
+// Generation of deliverable events from spikes on the device.
+//
+// The connections onto the targets of a cell group are held on the device,
+// indexed by source. Of each batch of global spikes passed to enqueue(),
+// the spikes of sources with connections are copied to the device once;
+// the events of matching connections are made
+// by device kernels and held there until they are due. stage() then moves
+// the events due before the end of an epoch, together with events staged
+// on the host, into the per integration domain event streams, binned and
+// sorted by time, without returning them to the host.
+//
+// enqueue() may be called concurrently with stage(), from another thread;
+// all other calls must be made from the thread that owns the cell group,
+// with its GPU stream current.
+
+class spike_delivery {
+public:
+    static constexpr bool supported = true;
+
+    using value_type = fvm_value_type;
+    using index_type = fvm_index_type;
+    using iarray = memory::device_vector<index_type>;
+    using event_array = memory::device_vector<deliverable_event>;
+
+    explicit spike_delivery(unsigned n_intdom);
+
+    // Replace the connection table; queued spikes and pending events are kept.
+    void set_connections(std::vector<target_connection> connections);
+
+    // Only regular binning can be applied to events on the device.
+    void set_binning_policy(binning_kind policy, value_type bin_interval);
+
+    // Add the spikes of a global exchange; their events are generated at
+    // the next call to stage().
+    void enqueue(std::shared_ptr<const std::vector<spike>> spikes);
+
+    // Discard queued spikes and pending events.
+    void clear();
+
+    // Initialize `stream` with the events before `t_until`: those generated
+    // from queued spikes plus `staged`, which must lie in [t_start, t_until).
+    // The times of generated events are binned and clamped to `t_start`.
+    void stage(value_type t_start,
+               value_type t_until,
+               const std::vector<deliverable_event>& staged,
+               multi_event_stream<deliverable_event>& stream);
+
+    // Number of events that are held on the device for later epochs.
+    std::size_t num_pending() const { return n_pending_; }
+
+    // Device memory held by the connection table, events and scratch space, in bytes.
+    std::size_t bytes() const {
+        std::size_t n = util::size_in_bytes(sources_, offsets_, targets_, weights_, delays_,
+            pending_, pending_scratch_, spikes_, staged_, due_, first_, count_, pos_,
+            stream_count_, stream_divs_);
+        for (const auto& a: scan_sums_) n += util::size_in_bytes(a);
+        for (const auto& a: scan_offsets_) n += util::size_in_bytes(a);
+        return n;
+    }
+
+private:
+    // Generate the events of the spikes gathered in spikes_host_.
+    void generate_events();
+
+    // Ensure room for n pending events, keeping those already held.
+    void reserve_pending(std::size_t n);
+
+    // Exclusive scan of the n values of `in` into `out`; `level` selects
+    // the scratch space for the block sums.
+    void scan(const index_type* in, index_type* out, unsigned n, unsigned level);
+
+    // Exclusive scan of in[0, n] into out[0, n]; returns out[n], the sum
+    // of in[0, n), to the host. Requires in[n]==0.
+    index_type scan_total(const index_type* in, index_type* out, unsigned n);
+
+    unsigned n_intdom_ = 0;
+
+    // Connection table: the connections from sources_[k] occupy the range
+    // [offsets_[k], offsets_[k+1]) of the per-connection arrays.
+    memory::device_vector<cell_member_type> sources_;
+    iarray offsets_;
+    memory::device_vector<target_handle> targets_;
+    memory::device_vector<float> weights_;
+    memory::device_vector<float> delays_;
+
+    // Host copy of sources_, to select the spikes copied to the device.
+    std::vector<cell_member_type> host_sources_;
+
+    value_type bin_interval_ = 0;
+
+    std::mutex queue_mutex_;
+    std::vector<std::shared_ptr<const std::vector<spike>>> queued_;
+
+    // Events generated from spikes that are not yet due, in pending_[0, n_pending_).
+    event_array pending_;
+    event_array pending_scratch_;
+    std::size_t n_pending_ = 0;
+
+    // Scratch space, grown on demand.
+    memory::staging_vector<spike> spikes_host_;
+    memory::device_vector<spike> spikes_;
+    event_array staged_;
+    event_array due_;
+    iarray first_;
+    iarray count_;
+    iarray pos_;
+    iarray stream_count_;
+    iarray stream_divs_;
+    std::vector<iarray> scan_sums_;
+    std::vector<iarray> scan_offsets_;
+};
+
+} // namespace gpu
+} // namespace arb
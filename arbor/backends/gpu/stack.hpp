@@ -1,7 +1,9 @@
 #pragma once
 
 #include <algorithm>
+#include <cstring>
 #include <memory>
+#include <vector>
 
 #include <arbor/assert.hpp>
 
@@ -26,6 +28,11 @@ namespace gpu {
 //
 // It is designed to be initialized empty with a given capacity on the host,
 // updated by device kernels, and periodically read and reset from the host side.
+//
+// The device storage and the values are held in one allocation, so that
+// update_host() can read the number of stores together with a prefix of the
+// values in a single copy. The length of the prefix follows the largest size
+// seen so far, so that once it has settled each update takes one round trip.
 template <typename T>
 class stack {
     using value_type = T;
@@ -38,8 +45,13 @@ class stack {
     using gpu_context_handle = std::shared_ptr<arb::gpu_context>;
 
 private:
-    // pointer in GPU memory
+    // Offset of the values from the device storage in the allocation.
+    static constexpr std::size_t data_offset =
+        (sizeof(storage_type)+alignof(value_type)-1)/alignof(value_type)*alignof(value_type);
+
+    // pointer in GPU memory, followed by the values
     storage_type* device_storage_;
+    std::size_t bytes_ = 0;
 
     // copy of the device_storage in host
     storage_type host_storage_;
@@ -48,15 +60,25 @@ private:
     // copy of data from GPU memory, to be manually refreshed before access
     std::vector<T> data_;
 
+    // Host side buffer for the storage and the prefix of the values read
+    // by update_host(), and the number of values in the prefix.
+    std::vector<char> staging_;
+    unsigned prefix_ = 0;
+
     void create_storage(unsigned n) {
         data_.reserve(n);
 
+        bytes_ = data_offset + n*sizeof(value_type);
+        char* buffer = allocator<char>().allocate(bytes_);
+
         host_storage_.capacity = n;
         host_storage_.stores = 0u;
-        host_storage_.data = n>0u ? allocator<value_type>().allocate(n): nullptr;
+        host_storage_.data = n>0u ? reinterpret_cast<value_type*>(buffer+data_offset): nullptr;
 
-        device_storage_ = allocator<storage_type>().allocate(1);
+        device_storage_ = reinterpret_cast<storage_type*>(buffer);
         memory::gpu_memcpy_h2d(device_storage_, &host_storage_, sizeof(storage_type));
+
+        prefix_ = std::min(n, 64u);
     }
 
 public:
@@ -66,6 +88,8 @@ public:
     stack() = delete;
 
     stack(gpu_context_handle h): gpu_context_(h) {
+        host_storage_.capacity = 0u;
+        host_storage_.stores = 0u;
         host_storage_.data = nullptr;
         device_storage_ = nullptr;
     }
@@ -73,12 +97,18 @@ public:
     stack& operator=(stack&& other) {
         gpu_context_ = other.gpu_context_;
         std::swap(device_storage_, other.device_storage_);
+        std::swap(bytes_, other.bytes_);
         std::swap(host_storage_, other.host_storage_);
         std::swap(data_, other.data_);
+        std::swap(staging_, other.staging_);
+        std::swap(prefix_, other.prefix_);
         return *this;
     }
 
-    stack(stack&& other) {
+    stack(stack&& other): device_storage_(nullptr) {
+        host_storage_.capacity = 0u;
+        host_storage_.stores = 0u;
+        host_storage_.data = nullptr;
         *this = std::move(other);
     }
 
@@ -87,27 +117,42 @@ public:
     }
 
     ~stack() {
-        if (host_storage_.data) {
-            allocator<value_type>().deallocate(host_storage_.data, host_storage_.capacity);
+        if (device_storage_) {
+            allocator<char>().deallocate(reinterpret_cast<char*>(device_storage_), bytes_);
         }
-        allocator<storage_type>().deallocate(device_storage_, sizeof(storage_type));
     }
 
     // After this call both host and device storage are synchronized to the GPU
     // state before the call.
+    //
+    // The storage and the first prefix_ values are read in one copy; only
+    // values beyond the prefix require a second.
     void update_host() {
-        memory::gpu_memcpy_d2h(&host_storage_, device_storage_, sizeof(storage_type));
+        const std::size_t head = data_offset + prefix_*sizeof(value_type);
+        staging_.resize(head);
+        memory::gpu_memcpy_d2h(staging_.data(), device_storage_, head);
+
+        storage_type device_copy;
+        std::memcpy(&device_copy, staging_.data(), sizeof(storage_type));
+        host_storage_.stores = device_copy.stores;
 
         auto num = size();
         data_.resize(num);
-        auto bytes = num*sizeof(T);
-        memory::gpu_memcpy_d2h(data_.data(), host_storage_.data, bytes);
+        auto in_prefix = std::min(num, prefix_);
+        std::memcpy(data_.data(), staging_.data()+data_offset, in_prefix*sizeof(value_type));
+        if (num>in_prefix) {
+            memory::gpu_memcpy_d2h(data_.data()+in_prefix, host_storage_.data+in_prefix, (num-in_prefix)*sizeof(value_type));
+            prefix_ = num;
+        }
     }
 
     // After this call both host and device storage are synchronized to empty state.
+    // Only the number of stores is written to the device, without synchronization.
     void clear() {
         host_storage_.stores = 0u;
-        memory::gpu_memcpy_h2d(device_storage_, &host_storage_, sizeof(storage_type));
+        if (device_storage_) {
+            memory::gpu_memcpy_h2d(&device_storage_->stores, &host_storage_.stores, sizeof(host_storage_.stores));
+        }
         data_.clear();
     }
 
@@ -26,5 +26,44 @@ void push_back(stack_storage<T>& s, const T& value) {
     // be overwritten from the front of the stack.
 }
 
+// Block cooperative push_back: each thread of the block, which must have
+// BlockDim threads, pushes `value` if `push` is set. The positions are given
+// by a prefix sum over the block, so that the values of a block are stored
+// contiguously, in thread order, with one atomic update of the stack per
+// block. Must be called by all threads of the block.
+template <unsigned BlockDim, typename T>
+__device__
+void push_back_block(stack_storage<T>& s, bool push, const T& value) {
+    __shared__ unsigned offsets[BlockDim];
+    __shared__ unsigned base;
+
+    const unsigned tid = threadIdx.x;
+    offsets[tid] = push;
+    __syncthreads();
+
+    // Inclusive scan of the push flags.
+    for (unsigned d = 1; d<BlockDim; d *= 2) {
+        unsigned x = tid>=d? offsets[tid-d]: 0u;
+        __syncthreads();
+        offsets[tid] += x;
+        __syncthreads();
+    }
+
+    if (tid==BlockDim-1) {
+        auto total = offsets[tid];
+        base = total? atomicAdd(&(s.stores), total): 0u;
+    }
+    __syncthreads();
+
+    if (push) {
+        // As for push_back, values beyond the capacity are lost, and
+        // stores records the number of attempts.
+        unsigned position = base + offsets[tid] - 1;
+        if (position<s.capacity) {
+            s.data[position] = value;
+        }
+    }
+}
+
 } // namespace gpu
 } // namespace arb
@@ -0,0 +1,60 @@
+#include <string>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/gpu/gpu_api.hpp>
+
+#include "backends/gpu/step_graph.hpp"
+
+namespace arb {
+namespace gpu {
+
+static void check_status(const api_error_type& status, const char* what) {
+    if (!status) {
+        throw arbor_exception(std::string("gpu::step_graph: unable to ")+what+": "+status.description());
+    }
+}
+
+step_graph::~step_graph() {
+    if (exec_) graph_exec_destroy(static_cast<graph_exec_type>(exec_));
+    if (graph_) graph_destroy(static_cast<graph_type>(graph_));
+}
+
+void step_graph::begin_capture() {
+    check_status(stream_begin_capture(current_stream()), "begin stream capture");
+}
+
+void step_graph::abort_capture() {
+    graph_type graph = nullptr;
+    stream_end_capture(current_stream(), &graph);
+    if (graph) graph_destroy(graph);
+}
+
+void step_graph::end_capture() {
+    graph_type graph;
+    check_status(stream_end_capture(current_stream(), &graph), "end stream capture");
+
+    auto exec = static_cast<graph_exec_type>(exec_);
+    if (exec && !graph_exec_update(exec, graph)) {
+        // The topology has changed: instantiate anew.
+        graph_exec_destroy(exec);
+        exec_ = exec = nullptr;
+    }
+    if (!exec) {
+        auto status = graph_instantiate(&exec, graph);
+        if (!status) {
+            graph_destroy(graph);
+            check_status(status, "instantiate graph");
+        }
+        exec_ = exec;
+    }
+
+    if (graph_) graph_destroy(static_cast<graph_type>(graph_));
+    graph_ = graph;
+}
+
+void step_graph::launch() {
+    check_status(graph_launch(static_cast<graph_exec_type>(exec_), current_stream()), "launch graph");
+}
+
+} // namespace gpu
+} // namespace arb
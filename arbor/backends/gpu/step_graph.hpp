@@ -0,0 +1,62 @@
+#pragma once
+
+#include <utility>
+
+namespace arb {
+namespace gpu {
+
+// A CUDA/HIP graph of the GPU work of a fixed sequence of integration steps.
+//
+// The work issued on the calling thread's current stream by the callable
+// passed to capture() is recorded instead of executed; launch() then
+// submits the whole recording to the current stream with a single call.
+// Recapturing a sequence of the same shape only updates the kernel
+// parameters of the instantiated graph, which is much cheaper than
+// instantiating it afresh.
+
+class step_graph {
+public:
+    static constexpr bool supported = true;
+
+    step_graph() = default;
+    step_graph(const step_graph&) = delete;
+    step_graph& operator=(const step_graph&) = delete;
+
+    step_graph(step_graph&& other) { *this = std::move(other); }
+    step_graph& operator=(step_graph&& other) {
+        std::swap(graph_, other.graph_);
+        std::swap(exec_, other.exec_);
+        return *this;
+    }
+
+    ~step_graph();
+
+    template <typename F>
+    void capture(F&& f) {
+        begin_capture();
+        try {
+            std::forward<F>(f)();
+        }
+        catch (...) {
+            abort_capture();
+            throw;
+        }
+        end_capture();
+    }
+
+    bool empty() const { return !exec_; }
+
+    void launch();
+
+private:
+    void begin_capture();
+    void end_capture();
+    void abort_capture();
+
+    // Opaque graph_type and graph_exec_type handles.
+    void* graph_ = nullptr;
+    void* exec_ = nullptr;
+};
+
+} // namespace gpu
+} // namespace arb
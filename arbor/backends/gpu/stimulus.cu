@@ -15,35 +15,52 @@ namespace gpu {
 
 namespace kernel {
 
+// The envelope segment of a stimulus is kept from step to step, and is
+// moved along the envelope only once the time passes its end.
 __global__
 void istim_add_current_impl(int n, istim_pp pp) {
     constexpr double two_pi = 2*pi;
+    constexpr double inf = INFINITY;
 
     auto i = threadIdx.x + blockDim.x*blockIdx.x;
     if (i>=n) return;
 
-    fvm_index_type ei_left = pp.envl_divs[i];
-    fvm_index_type ei_right = pp.envl_divs[i+1];
-
     fvm_index_type ai = pp.accu_index[i];
     fvm_index_type cv = pp.accu_to_cv[ai];
     double t = pp.time[pp.cv_to_intdom[cv]];
 
-    if (ei_left==ei_right || t<pp.envl_times[ei_left]) return;
-
-    fvm_index_type& ei = pp.envl_index[i];
-    while (ei+1<ei_right && pp.envl_times[ei+1]<=t) ++ei;
-
-    double J = pp.envl_amplitudes[ei]; // current density (A/m²)
-    if (ei+1<ei_right) {
-        // linearly interpolate:
-        double J1 = pp.envl_amplitudes[ei+1];
-        double u = (t-pp.envl_times[ei])/(pp.envl_times[ei+1]-pp.envl_times[ei]);
-        J = lerp(J, J1, u);
+    if (t>=pp.seg_t1[i]) {
+        fvm_index_type ei_left = pp.envl_divs[i];
+        fvm_index_type ei_right = pp.envl_divs[i+1];
+
+        if (ei_left==ei_right || t<pp.envl_times[ei_left]) {
+            pp.seg_t0[i] = 0;
+            pp.seg_t1[i] = ei_left==ei_right? inf: pp.envl_times[ei_left];
+            pp.seg_j0[i] = 0;
+            pp.seg_slope[i] = 0;
+        }
+        else {
+            fvm_index_type& ei = pp.envl_index[i];
+            while (ei+1<ei_right && pp.envl_times[ei+1]<=t) ++ei;
+
+            pp.seg_t0[i] = pp.envl_times[ei];
+            pp.seg_j0[i] = pp.envl_amplitudes[ei];
+            if (ei+1<ei_right) {
+                pp.seg_t1[i] = pp.envl_times[ei+1];
+                pp.seg_slope[i] = (pp.envl_amplitudes[ei+1]-pp.envl_amplitudes[ei])/(pp.envl_times[ei+1]-pp.envl_times[ei]);
+            }
+            else {
+                pp.seg_t1[i] = inf;
+                pp.seg_slope[i] = 0;
+            }
+        }
     }
 
+    double J = fma(pp.seg_slope[i], t-pp.seg_t0[i], pp.seg_j0[i]); // current density (A/m²)
+    if (J==0) return;
+
     if (double f = pp.frequency[i]) {
-         J *= std::sin(two_pi*f*t + pp.phase[i]);
+         J *= sin(two_pi*f*t + pp.phase[i]);
     }
 
     gpu_atomic_add(&pp.accu_stim[ai], J);
@@ -56,7 +73,7 @@ void istim_add_current_impl(int n, const istim_pp& pp) {
     constexpr unsigned block_dim = 128;
     const unsigned grid_dim = impl::block_count(n, block_dim);
     if (!grid_dim) return;
-    kernel::istim_add_current_impl<<<grid_dim, block_dim>>>(n, pp);
+    kernel::istim_add_current_impl<<<grid_dim, block_dim, 0, current_stream()>>>(n, pp);
 }
 
 } // namespace gpu
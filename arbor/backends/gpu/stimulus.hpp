@@ -18,6 +18,10 @@ struct istim_pp {
     const fvm_index_type* envl_divs;
     fvm_value_type* accu_stim;
     fvm_index_type* envl_index;
+    fvm_value_type* seg_t0;
+    fvm_value_type* seg_t1;
+    fvm_value_type* seg_j0;
+    fvm_value_type* seg_slope;
 
     // Pointers to shared state data:
     const fvm_value_type* time;
@@ -0,0 +1,63 @@
+#include <arbor/fvm_types.hpp>
+#include <arbor/gpu/gpu_api.hpp>
+#include <arbor/gpu/gpu_common.hpp>
+
+#include "backends/stochastic_input.hpp"
+#include "backends/gpu/stochastic_input.hpp"
+
+namespace arb {
+namespace gpu {
+
+namespace kernel {
+
+// One thread per target instance sums the weights of the events of its
+// inputs, in the order of the inputs as on the CPU.
+__global__
+void stochastic_input_sample_impl(int n, stochastic_input_pp pp) {
+    auto i = threadIdx.x + blockDim.x*blockIdx.x;
+    if (i>=n) return;
+
+    double w = 0;
+    for (auto k = pp.instance_divs[i]; k<pp.instance_divs[i+1]; ++k) {
+        auto d = pp.intdom[k];
+        double t = pp.time[d];
+        if (t>=pp.tstart[k] && t<pp.tstop[k]) {
+            double u = stochastic_input_uniform(pp.seed[k], pp.stream[k], t);
+            w += stochastic_input_count(pp.rate[k]*pp.dt_intdom[d], u)*pp.weight[k];
+        }
+    }
+    pp.events[i].weight = w;
+}
+
+// One thread per mechanism instance draws all of its random variables.
+__global__
+void white_noise_draw_impl(int n, white_noise_pp pp) {
+    auto i = threadIdx.x + blockDim.x*blockIdx.x;
+    if (i>=n) return;
+
+    double t = pp.time[pp.cv_to_intdom[pp.node_index[i]]];
+    for (unsigned k = 0; k<pp.n_variables; k += 2) {
+        auto z = white_noise_normals(pp.seed, pp.stream, pp.instance[i] | k/2, t);
+        pp.random_numbers[k][i] = z.z0;
+        if (k+1<pp.n_variables) pp.random_numbers[k+1][i] = z.z1;
+    }
+}
+
+} // namespace kernel
+
+void stochastic_input_sample_impl(int n, const stochastic_input_pp& pp) {
+    constexpr unsigned block_dim = 128;
+    const unsigned grid_dim = impl::block_count(n, block_dim);
+    if (!grid_dim) return;
+    kernel::stochastic_input_sample_impl<<<grid_dim, block_dim, 0, current_stream()>>>(n, pp);
+}
+
+void white_noise_draw_impl(int n, const white_noise_pp& pp) {
+    constexpr unsigned block_dim = 128;
+    const unsigned grid_dim = impl::block_count(n, block_dim);
+    if (!grid_dim) return;
+    kernel::white_noise_draw_impl<<<grid_dim, block_dim, 0, current_stream()>>>(n, pp);
+}
+
+} // namespace gpu
+} // namespace arb
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+#include <arbor/fvm_types.hpp>
+#include <arbor/mechanism_abi.h>
+
+namespace arb {
+namespace gpu {
+
+// Pointer representation of the stochastic input state passed to GPU kernels.
+
+struct stochastic_input_pp {
+    // Inputs, partitioned by target instance:
+    const fvm_index_type* instance_divs;
+    const fvm_index_type* intdom;
+    const fvm_value_type* weight;
+    const fvm_value_type* rate;
+    const fvm_value_type* tstart;
+    const fvm_value_type* tstop;
+    const std::uint64_t* seed;
+    const std::uint64_t* stream;
+
+    // Event of each target instance:
+    arb_deliverable_event_data* events;
+
+    // Pointers to shared state data:
+    const fvm_value_type* time;
+    const fvm_value_type* dt_intdom;
+};
+
+void stochastic_input_sample_impl(int n, const stochastic_input_pp& pp);
+
+// Pointer representation of the random variables of a mechanism.
+
+struct white_noise_pp {
+    std::uint64_t seed;
+    std::uint64_t stream;
+    const std::uint64_t* instance;
+    const fvm_index_type* node_index;
+    arb_value_type* const* random_numbers;
+    unsigned n_variables;
+
+    // Pointers to shared state data:
+    const fvm_index_type* cv_to_intdom;
+    const fvm_value_type* time;
+};
+
+void white_noise_draw_impl(int n, const white_noise_pp& pp);
+
+} // namespace gpu
+} // namespace arb
@@ -1,6 +1,7 @@
 #include <cmath>
 
 #include <arbor/fvm_types.hpp>
+#include <arbor/gpu/gpu_api.hpp>
 #include <arbor/gpu/math_cu.hpp>
 
 #include "backends/threshold_crossing.hpp"
@@ -9,6 +10,9 @@
 namespace arb {
 namespace gpu {
 
+// The block size of test_thresholds_impl, over which crossings are compacted.
+constexpr unsigned threshold_block_dim = 128;
+
 namespace kernel {
 
 /// kernel used to test for threshold crossing test code.
@@ -40,7 +44,7 @@ void test_thresholds_impl(
     int i = threadIdx.x + blockIdx.x*blockDim.x;
 
     bool crossed = false;
-    float crossing_time;
+    float crossing_time = 0;
 
     if (i<size) {
         // Test for threshold crossing
@@ -78,9 +82,7 @@ void test_thresholds_impl(
         prev_values[i] = v;
     }
 
-    if (crossed) {
-        push_back(stack, {fvm_size_type(i), crossing_time});
-    }
+    push_back_block<threshold_block_dim>(stack, crossed, threshold_crossing{fvm_size_type(i), crossing_time});
 }
 
 __global__
@@ -108,9 +110,9 @@ void test_thresholds_impl(
     bool record_time_since_spike)
 {
     if (size>0) {
-        constexpr int block_dim = 128;
+        constexpr int block_dim = threshold_block_dim;
         const int grid_dim = impl::block_count(size, block_dim);
-        kernel::test_thresholds_impl<<<grid_dim, block_dim>>>(
+        kernel::test_thresholds_impl<<<grid_dim, block_dim, 0, current_stream()>>>(
             size, cv_to_intdom, t_after, t_before, src_to_spike, time_since_spike,
             stack, is_crossed, prev_values, cv_index, values, thresholds, record_time_since_spike);
     }
@@ -123,7 +125,7 @@ void reset_crossed_impl(
     if (size>0) {
         constexpr int block_dim = 128;
         const int grid_dim = impl::block_count(size, block_dim);
-        kernel::reset_crossed_impl<<<grid_dim, block_dim>>>(size, is_crossed, cv_index, values, thresholds);
+        kernel::reset_crossed_impl<<<grid_dim, block_dim, 0, current_stream()>>>(size, is_crossed, cv_index, values, thresholds);
     }
 }
 
@@ -5,6 +5,7 @@
 #include <arbor/fvm_types.hpp>
 
 #include "execution_context.hpp"
+#include "io/serialize.hpp"
 #include "memory/memory.hpp"
 #include "util/span.hpp"
 
@@ -71,8 +72,8 @@ public:
     }
 
     /// Remove all stored crossings that were detected in previous calls to test()
+    /// The crossings are discarded on the device; nothing is read back.
     void clear_crossings() {
-        stack_.update_host();
         stack_.clear();
     }
 
@@ -86,6 +87,22 @@ public:
         }
     }
 
+    /// Write and restore the state machine of each detector, for checkpointing.
+    void serialize(io::serializer& out) const {
+        out.array(memory::on_host(is_crossed_));
+        out.array(memory::on_host(v_prev_));
+    }
+
+    void deserialize(io::deserializer& in) {
+        clear_crossings();
+        auto is_crossed = memory::on_host(is_crossed_);
+        auto v_prev = memory::on_host(v_prev_);
+        in.array(is_crossed);
+        in.array(v_prev);
+        memory::copy(is_crossed, is_crossed_);
+        memory::copy(v_prev, v_prev_);
+    }
+
     // Testing-only interface.
     bool is_crossed(int i) const {
         return is_crossed_[i];
@@ -118,8 +135,7 @@ public:
                 cv_index_.data(), values_, thresholds_.data(),
                 !time_since_spike->empty());
 
-            // Check that the number of spikes has not exceeded capacity.
-            arb_assert(!stack_.overflow());
+            // Overflow is detected from the count read by crossings().
         }
     }
 
@@ -7,6 +7,7 @@
 
 #include "backends/event.hpp"
 #include "backends/multicore/matrix_state.hpp"
+#include "backends/multicore/mechanism_slices.hpp"
 #include "backends/multicore/multi_event_stream.hpp"
 #include "backends/multicore/multicore_common.hpp"
 #include "backends/multicore/shared_state.hpp"
@@ -49,6 +50,24 @@ struct backend {
     using shared_state = arb::multicore::shared_state;
     using ion_state = arb::multicore::ion_state;
 
+    // Recording integration steps as a graph is a GPU feature.
+    struct step_graph {
+        static constexpr bool supported = false;
+    };
+
+    // Events are generated from spikes by the communicator.
+    struct spike_delivery {
+        static constexpr bool supported = false;
+    };
+
+    // Samples are read directly from host memory.
+    struct sample_buffer {
+        static constexpr bool supported = false;
+    };
+
+    // The instances of large mechanisms can be updated in parallel.
+    using mechanism_slices = arb::multicore::mechanism_slices;
+
     static threshold_watcher voltage_watcher(
         shared_state& state,
         const std::vector<index_type>& cv,
@@ -1,10 +1,21 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <map>
+#include <optional>
+#include <vector>
+
+#include <arbor/simd/simd.hpp>
+
 #include <util/partition.hpp>
+#include <util/rangeutil.hpp>
 #include <util/span.hpp>
 
 #include <memory/memory.hpp>
 
+#include "threading/threading.hpp"
+
 #include "multicore_common.hpp"
 
 namespace arb {
@@ -46,10 +57,10 @@ public:
                  const std::vector<index_type>& cell_to_intdom):
         parent_index(p.begin(), p.end()),
         cell_cv_divs(cell_cv_divs.begin(), cell_cv_divs.end()),
-        d(size(), 0), u(size(), 0), rhs(size()),
-        cv_capacitance(cap.begin(), cap.end()),
-        face_conductance(cond.begin(), cond.end()),
-        cv_area(area.begin(), area.end()),
+        d(size(), 0, pad(alignment)), u(size(), 0, pad(alignment)), rhs(size(), 0, pad(alignment)),
+        cv_capacitance(cap.begin(), cap.end(), pad(alignment)),
+        face_conductance(cond.begin(), cond.end(), pad(alignment)),
+        cv_area(area.begin(), area.end(), pad(alignment)),
         cell_to_intdom(cell_to_intdom.begin(), cell_to_intdom.end())
     {
         arb_assert(cap.size() == size());
@@ -57,7 +68,7 @@ public:
         arb_assert(cell_cv_divs.back() == (index_type)size());
 
         auto n = size();
-        invariant_d = array(n, 0);
+        invariant_d = array(n, 0, pad(alignment));
         if (n >= 1) { // skip empty matrix, ie cell with empty morphology
             for (auto i: util::make_span(1u, n)) {
                 auto gij = face_conductance[i];
@@ -69,6 +80,9 @@ public:
                 }
             }
         }
+
+        build_interleaved();
+        build_forests();
     }
 
     const_view solution() const {
@@ -78,6 +92,15 @@ public:
     }
 
 
+    // With Crank–Nicolson integration, the matrix assembled for a step of dt
+    // is that of an implicit Euler step of dt/2, whose solution is the voltage
+    // at the middle of the step; assemble_solve() extrapolates it to the end
+    // of the step, v(t+dt) = 2·v(t+dt/2) - v(t).
+    void set_crank_nicolson(bool enable) {
+        crank_nicolson_ = enable;
+        oodt_scale_ = enable? 2e-3: 1e-3;
+    }
+
     // Assemble the matrix
     // Afterwards the diagonal and RHS will have been set given dt, voltage and current.
     //   dt_intdom       [ms]      (per integration domain)
@@ -85,68 +108,600 @@ public:
     //   current density [A.m^-2]  (per control volume)
     //   conductivity    [kS.m^-2] (per control volume)
     void assemble(const_view dt_intdom, const_view voltage, const_view current, const_view conductivity) {
+        // In the common case that all integration domains share the same
+        // positive dt, every CV is assembled in a single SIMD pass.
+        if (uniform_dt(dt_intdom)) {
+            assemble_uniform(dt_intdom[0], 0, size(), voltage, current, conductivity);
+            return;
+        }
+
+        // loop over submatrices
+        for (auto m: util::make_span(0, (index_type)cell_cv_divs.size()-1)) {
+            assemble_cell(m, dt_intdom, voltage, current, conductivity);
+        }
+    }
+
+    // Assemble and solve the matrix, and store the solution in voltage.
+    // Equivalent to assemble followed by solve(voltage), but performed
+    // tile by tile, so that each CV is assembled, solved and stored while
+    // still in cache, rather than in three passes over all CVs. A tile is
+    // a run of consecutive cells solved one at a time, a block of cells
+    // sharing their structure, or a large cell solved by subtrees.
+    void assemble_solve(const_view dt_intdom, array& voltage, const_view current, const_view conductivity) {
+        const bool uniform = uniform_dt(dt_intdom);
+        auto assemble_cells = [&](index_type c0, index_type c1) {
+            if (uniform) {
+                assemble_uniform(dt_intdom[0], cell_cv_divs[c0], cell_cv_divs[c1], voltage, current, conductivity);
+            }
+            else {
+                for (auto c = c0; c<c1; ++c) {
+                    assemble_cell(c, dt_intdom, voltage, current, conductivity);
+                }
+            }
+        };
+        auto store_cells = [&](index_type c0, index_type c1) {
+            if (crank_nicolson_) {
+                for (auto i = cell_cv_divs[c0]; i<cell_cv_divs[c1]; ++i) {
+                    voltage[i] = 2*rhs[i] - voltage[i];
+                }
+            }
+            else {
+                std::copy(rhs.begin()+cell_cv_divs[c0], rhs.begin()+cell_cv_divs[c1], voltage.begin()+cell_cv_divs[c0]);
+            }
+        };
+
+        auto run_tile = [&](std::size_t k) {
+            auto [c0, c1] = tiles_[k];
+            assemble_cells(c0, c1);
+            for (auto c = c0; c<c1; ++c) {
+                solve_cell(c);
+            }
+            store_cells(c0, c1);
+        };
+        auto run_block = [&](std::size_t k) {
+            assemble_solve_block(blocks_[k], dt_intdom, voltage, current, conductivity);
+        };
+
+        if (parallel_cells()) {
+            threading::parallel_for::apply(0, tiles_.size(), task_system_, run_tile);
+        }
+        else {
+            for (std::size_t k = 0; k<tiles_.size(); ++k) run_tile(k);
+        }
+        for (const auto& f: forests_) {
+            assemble_cells(f.cell, f.cell+1);
+            solve_forest(f);
+            store_cells(f.cell, f.cell+1);
+        }
+        if (parallel_cells()) {
+            threading::parallel_for::apply(0, blocks_.size(), task_system_, run_block);
+        }
+        else {
+            for (std::size_t k = 0; k<blocks_.size(); ++k) run_block(k);
+        }
+    }
+
+    // Solve cells with at least `parallel_min_cvs` CVs by subtrees in
+    // parallel on the given task system; a null task system, or one
+    // with a single thread, solves every cell serially.
+    void set_task_system(threading::task_system* ts) {
+        task_system_ = ts;
+        build_forests();
+    }
+
+    // Solve the tiles and blocks of cells in parallel in assemble_solve,
+    // on the task system, if the matrix has at least `parallel_min_cvs` CVs.
+    void set_parallel_cells(bool enable) {
+        parallel_cells_ = enable;
+    }
+
+    void solve() {
+        for (auto c: scalar_cells_) {
+            solve_cell(c);
+        }
+        for (const auto& f: forests_) {
+            solve_forest(f);
+        }
+        for (const auto& b: blocks_) {
+            solve_block(b);
+        }
+    }
+
+    template<typename VTo>
+    void solve(VTo& to) {
+        solve();
+        memory::copy(rhs, to);
+    }
+
+    // Size of the matrix and solver data in bytes.
+    std::size_t bytes() const {
+        std::size_t n = util::size_in_bytes(parent_index, cell_cv_divs, d, u, rhs,
+            cv_capacitance, face_conductance, cv_area, cell_to_intdom, invariant_d,
+            structure_parent_, structure_divs_, blocks_, scalar_cells_,
+            ilv_d_, ilv_u_, ilv_rhs_, tiles_);
+        for (const auto& f: forests_) {
+            n += util::size_in_bytes(f.upper, f.chunk_cvs, f.chunk_divs);
+        }
+        return n;
+    }
+
+private:
+    // Cells that share the structure of their matrix are solved together,
+    // in blocks of `lanes` cells. The matrices of a block are copied into
+    // storage interleaved lane by lane, as in the GPU interleaved layout
+    // (see backends/matrix_storage.md), so that each step of the sweeps is
+    // a SIMD operation over the cells of the block. Other cells are solved
+    // one at a time in place.
+    static constexpr unsigned lanes = std::max(4, simd::simd_abi::native_width<value_type>::value);
+    using simd_value = simd::simd<value_type, lanes, simd::simd_abi::default_abi>;
+
+    // Arrays are aligned to the SIMD vector size.
+    static constexpr std::size_t alignment = sizeof(value_type)*lanes;
+    using pad = util::padded_allocator<>;
+
+    struct interleaved_block {
+        index_type structure;               // index of the shared structure
+        index_type offset;                  // offset into the interleaved arrays
+        std::array<index_type, lanes> first; // first CV of the cell in each lane, or -1
+        std::array<index_type, lanes> cell;  // the cell in each lane, or -1
+    };
+
+    // Parent index of each CV relative to the first CV of its cell, for
+    // each distinct structure, partitioned by structure_divs_.
+    std::vector<index_type> structure_parent_;
+    std::vector<index_type> structure_divs_ = {0};
+
+    std::vector<interleaved_block> blocks_;
+    std::vector<index_type> scalar_cells_;
+
+    // Interleaved copies of d, u and rhs, for all blocks.
+    array ilv_d_, ilv_u_, ilv_rhs_;
+
+    // A large cell is split into disjoint subtrees, small enough that there
+    // are several per thread, and the CVs above them. The subtrees are
+    // independent in both sweeps: the backward sweep of each stops at its
+    // root, and the forward sweep starts below it. The CVs above the
+    // subtrees, with the subtree roots, are swept serially in between.
+    // Subtrees are packed into chunks of similar size, one task per chunk.
+    struct subtree_forest {
+        index_type cell;
+        std::vector<index_type> upper;       // serial CVs, in increasing order
+        std::vector<index_type> chunk_cvs;   // non-root subtree CVs of each chunk, in increasing order
+        std::vector<index_type> chunk_divs;  // partition of chunk_cvs by chunk
+    };
+
+    static constexpr index_type parallel_min_cvs = 4096;
+
+    // Runs of consecutive cells, solved one at a time, partitioned into
+    // tiles [first, last) of at most tile_cvs CVs, or a single cell where
+    // that is larger, for assemble_solve.
+    static constexpr index_type tile_cvs = 4096;
+    std::vector<std::pair<index_type, index_type>> tiles_;
+    static constexpr int chunks_per_thread = 4;
+
+    threading::task_system* task_system_ = nullptr;
+    std::vector<subtree_forest> forests_;
+    bool parallel_cells_ = false;
+
+    bool parallel_cells() const {
+        return parallel_cells_ && task_system_ && task_system_->get_num_threads()>1 &&
+               size()>=std::size_t(parallel_min_cvs) && tiles_.size()+blocks_.size()>1;
+    }
+
+    // Scale of capacitance/dt in the diagonal: 1e-3 converts pF/ms to μS,
+    // and a factor of two halves the step for Crank–Nicolson integration.
+    bool crank_nicolson_ = false;
+    value_type oodt_scale_ = 1e-3;
+
+    std::size_t size() const {
+        return parent_index.size();
+    }
+
+    void build_interleaved() {
         auto cell_cv_part = util::partition_view(cell_cv_divs);
         const index_type ncells = cell_cv_part.size();
 
-        // loop over submatrices
-        for (auto m: util::make_span(0, ncells)) {
-            auto dt = dt_intdom[cell_to_intdom[m]];
+        // Group cells by structure: the parent index of each CV relative
+        // to the first CV of the cell, with the root marked by zero.
+        std::map<std::vector<index_type>, std::vector<index_type>> by_structure;
+        for (auto c: util::make_span(0, ncells)) {
+            auto first = cell_cv_part[c].first;
+            auto last = cell_cv_part[c].second;
+            if (first >= last) continue; // skip cell with no CVs
 
-            if (dt>0) {
-                value_type oodt_factor = 1e-3/dt; // [1/µs]
-                for (auto i: util::make_span(cell_cv_part[m])) {
-                    auto area_factor = 1e-3*cv_area[i]; // [1e-9·m²]
+            std::vector<index_type> structure(last-first, 0);
+            bool ordered = true;
+            for (auto i = first+1; i<last; ++i) {
+                structure[i-first] = parent_index[i]-first;
+                ordered &= parent_index[i]>=first && parent_index[i]<i;
+            }
+            if (ordered) {
+                by_structure[std::move(structure)].push_back(c);
+            }
+            else {
+                scalar_cells_.push_back(c);
+            }
+        }
 
-                    auto gi = oodt_factor*cv_capacitance[i] + area_factor*conductivity[i]; // [μS]
+        index_type offset = 0;
+        for (auto& [structure, cells]: by_structure) {
+            if (cells.size()<2) {
+                scalar_cells_.insert(scalar_cells_.end(), cells.begin(), cells.end());
+                continue;
+            }
 
-                    d[i] = gi + invariant_d[i];
-                    // convert current to units nA
-                    rhs[i] = gi*voltage[i] - area_factor*current[i];
+            index_type id = structure_divs_.size()-1;
+            structure_parent_.insert(structure_parent_.end(), structure.begin(), structure.end());
+            structure_divs_.push_back(structure_parent_.size());
+
+            const index_type n = structure.size();
+            for (std::size_t k = 0; k<cells.size(); k += lanes) {
+                interleaved_block b{id, offset, {}, {}};
+                for (unsigned l = 0; l<lanes; ++l) {
+                    b.cell[l] = k+l<cells.size()? cells[k+l]: -1;
+                    b.first[l] = b.cell[l]<0? -1: cell_cv_divs[b.cell[l]];
                 }
+                blocks_.push_back(b);
+                offset += n*lanes;
             }
-            else {
-                for (auto i: util::make_span(cell_cv_part[m])) {
-                    d[i] = 0;
-                    rhs[i] = voltage[i];
+        }
+        std::sort(scalar_cells_.begin(), scalar_cells_.end());
+
+        ilv_d_ = array(offset, 0, pad(alignment));
+        ilv_u_ = array(offset, 0, pad(alignment));
+        ilv_rhs_ = array(offset, 0, pad(alignment));
+    }
+
+    // Move the large scalar cells, if any, to forests_, or back again
+    // if there is no parallelism to be had, and partition the remaining
+    // scalar cells into tiles.
+    void build_forests() {
+        for (const auto& f: forests_) {
+            scalar_cells_.push_back(f.cell);
+        }
+        forests_.clear();
+
+        const int nthreads = task_system_? task_system_->get_num_threads(): 1;
+        if (nthreads>1) {
+            std::vector<index_type> small;
+            for (auto c: scalar_cells_) {
+                if (auto f = make_forest(c, nthreads)) {
+                    forests_.push_back(std::move(*f));
+                }
+                else {
+                    small.push_back(c);
                 }
             }
+            scalar_cells_ = std::move(small);
+        }
+        std::sort(scalar_cells_.begin(), scalar_cells_.end());
+
+        tiles_.clear();
+        for (auto c: scalar_cells_) {
+            if (tiles_.empty() || tiles_.back().second!=c ||
+                cell_cv_divs[c+1]-cell_cv_divs[tiles_.back().first]>tile_cvs)
+            {
+                tiles_.push_back({c, c+1});
+            }
+            else {
+                tiles_.back().second = c+1;
+            }
         }
     }
 
-    void solve() {
-        // loop over submatrices
-        for (auto cv_span: util::partition_view(cell_cv_divs)) {
-            auto first = cv_span.first;
-            auto last = cv_span.second; // one past the end
-            if (first >= last) continue; // skip cell with no CVs
-            if (d[first]!=0) {
-                // backward sweep
-                for(auto i=last-1; i>first; --i) {
+    std::optional<subtree_forest> make_forest(index_type c, int nthreads) const {
+        const auto first = cell_cv_divs[c];
+        const auto last = cell_cv_divs[c+1];
+        const index_type n = last-first;
+        if (n<parallel_min_cvs) return std::nullopt;
+
+        for (auto i = first+1; i<last; ++i) {
+            if (parent_index[i]<first || parent_index[i]>=i) return std::nullopt;
+        }
+
+        // Number of CVs in the subtree rooted at each CV.
+        std::vector<index_type> count(n, 1);
+        for (auto i = last-1; i>first; --i) {
+            count[parent_index[i]-first] += count[i-first];
+        }
+
+        // Subtree roots are the largest CVs with at most `target` CVs below
+        // them; every CV is either in exactly one subtree, or above them.
+        const index_type target = std::max<index_type>(1, n/(chunks_per_thread*nthreads));
+        std::vector<index_type> subtree(n, -1);
+        subtree_forest f{c, {first}, {}, {0}};
+        index_type nsubtree = 0;
+        for (auto i = first+1; i<last; ++i) {
+            auto k = i-first, pk = parent_index[i]-first;
+            if (subtree[pk]>=0) {
+                subtree[k] = subtree[pk];
+            }
+            else {
+                f.upper.push_back(i);
+                if (count[k]<=target) subtree[k] = nsubtree++;
+            }
+        }
+        if (nsubtree<2) return std::nullopt;
+
+        // Pack consecutive subtrees into chunks of about `target` CVs.
+        std::vector<std::vector<index_type>> members(nsubtree);
+        for (auto i = first+1; i<last; ++i) {
+            auto k = i-first;
+            if (subtree[k]>=0 && subtree[parent_index[i]-first]==subtree[k]) {
+                members[subtree[k]].push_back(i);
+            }
+        }
+        index_type in_chunk = 0;
+        for (auto& m: members) {
+            f.chunk_cvs.insert(f.chunk_cvs.end(), m.begin(), m.end());
+            in_chunk += m.size();
+            if (in_chunk>=target) {
+                f.chunk_divs.push_back(f.chunk_cvs.size());
+                in_chunk = 0;
+            }
+        }
+        if (in_chunk) {
+            f.chunk_divs.push_back(f.chunk_cvs.size());
+        }
+        return f;
+    }
+
+    static bool uniform_dt(const_view dt_intdom) {
+        return !dt_intdom.empty() && dt_intdom[0]>0 &&
+            std::all_of(dt_intdom.begin(), dt_intdom.end(), [dt = dt_intdom[0]](auto x) { return x==dt; });
+    }
+
+    // Assemble the CVs [first, last) with the same dt > 0.
+    void assemble_uniform(value_type dt, index_type first, index_type last,
+                          const_view voltage, const_view current, const_view conductivity)
+    {
+        using simd::assign;
+        using simd::indirect;
+
+        const value_type oodt_factor = oodt_scale_/dt; // [1/µs]
+        auto assemble_cv = [&](index_type i) {
+            auto area_factor = 1e-3*cv_area[i];
+            auto gi = oodt_factor*cv_capacitance[i] + area_factor*conductivity[i];
+
+            d[i] = gi + invariant_d[i];
+            rhs[i] = gi*voltage[i] - area_factor*current[i];
+        };
+
+        // Peel to an aligned CV, so that vector accesses stay aligned.
+        index_type i = first;
+        for (; i<last && i%lanes; ++i) {
+            assemble_cv(i);
+        }
+
+        simd_value cap, area, cond, inv, v, cur;
+        for (; i+(index_type)lanes<=last; i += lanes) {
+            assign(cap, indirect(cv_capacitance.data()+i, lanes));
+            assign(area, indirect(cv_area.data()+i, lanes));
+            assign(cond, indirect(conductivity.data()+i, lanes));
+            assign(inv, indirect(invariant_d.data()+i, lanes));
+            assign(v, indirect(voltage.data()+i, lanes));
+            assign(cur, indirect(current.data()+i, lanes));
+
+            auto area_factor = 1e-3*area; // [1e-9·m²]
+            auto gi = oodt_factor*cap + area_factor*cond; // [μS]
+
+            indirect(d.data()+i, lanes) = gi + inv;
+            // convert current to units nA
+            indirect(rhs.data()+i, lanes) = gi*v - area_factor*cur;
+        }
+        for (; i<last; ++i) {
+            assemble_cv(i);
+        }
+    }
+
+    void assemble_cell(index_type m, const_view dt_intdom, const_view voltage, const_view current, const_view conductivity) {
+        auto dt = dt_intdom[cell_to_intdom[m]];
+        auto cv = util::make_span(cell_cv_divs[m], cell_cv_divs[m+1]);
+
+        if (dt>0) {
+            value_type oodt_factor = oodt_scale_/dt; // [1/µs]
+            for (auto i: cv) {
+                auto area_factor = 1e-3*cv_area[i]; // [1e-9·m²]
+
+                auto gi = oodt_factor*cv_capacitance[i] + area_factor*conductivity[i]; // [μS]
+
+                d[i] = gi + invariant_d[i];
+                // convert current to units nA
+                rhs[i] = gi*voltage[i] - area_factor*current[i];
+            }
+        }
+        else {
+            for (auto i: cv) {
+                d[i] = 0;
+                rhs[i] = voltage[i];
+            }
+        }
+    }
+
+    void solve_cell(index_type c) {
+        auto first = cell_cv_divs[c];
+        auto last = cell_cv_divs[c+1]; // one past the end
+        if (d[first]!=0) {
+            // backward sweep
+            for(auto i=last-1; i>first; --i) {
+                auto factor = u[i] / d[i];
+                d[parent_index[i]]   -= factor * u[i];
+                rhs[parent_index[i]] -= factor * rhs[i];
+            }
+            rhs[first] /= d[first];
+
+            // forward sweep
+            for(auto i=first+1; i<last; ++i) {
+                rhs[i] -= u[i] * rhs[parent_index[i]];
+                rhs[i] /= d[i];
+            }
+        }
+    }
+
+    void solve_forest(const subtree_forest& f) {
+        const auto first = cell_cv_divs[f.cell];
+        if (d[first]==0) return;
+
+        const index_type* p = parent_index.data();
+        const index_type* cvs = f.chunk_cvs.data();
+        const index_type nchunk = f.chunk_divs.size()-1;
+
+        // backward sweep: the subtrees, then the CVs above them
+        threading::parallel_for::apply(0, nchunk, 1, task_system_,
+            [&](index_type k) {
+                for (auto j = f.chunk_divs[k+1]-1; j>=f.chunk_divs[k]; --j) {
+                    auto i = cvs[j];
                     auto factor = u[i] / d[i];
-                    d[parent_index[i]]   -= factor * u[i];
-                    rhs[parent_index[i]] -= factor * rhs[i];
+                    d[p[i]]   -= factor * u[i];
+                    rhs[p[i]] -= factor * rhs[i];
                 }
-                rhs[first] /= d[first];
+            });
+        for (auto j = f.upper.size()-1; j>0; --j) {
+            auto i = f.upper[j];
+            auto factor = u[i] / d[i];
+            d[p[i]]   -= factor * u[i];
+            rhs[p[i]] -= factor * rhs[i];
+        }
+        rhs[first] /= d[first];
 
-                // forward sweep
-                for(auto i=first+1; i<last; ++i) {
-                    rhs[i] -= u[i] * rhs[parent_index[i]];
+        // forward sweep: the CVs above the subtrees, then the subtrees
+        for (std::size_t j = 1; j<f.upper.size(); ++j) {
+            auto i = f.upper[j];
+            rhs[i] -= u[i] * rhs[p[i]];
+            rhs[i] /= d[i];
+        }
+        threading::parallel_for::apply(0, nchunk, 1, task_system_,
+            [&](index_type k) {
+                for (auto j = f.chunk_divs[k]; j<f.chunk_divs[k+1]; ++j) {
+                    auto i = cvs[j];
+                    rhs[i] -= u[i] * rhs[p[i]];
                     rhs[i] /= d[i];
                 }
+            });
+    }
+
+    void solve_block(const interleaved_block& b) {
+        const index_type n = structure_divs_[b.structure+1]-structure_divs_[b.structure];
+        value_type* bd = ilv_d_.data()+b.offset;
+        value_type* bu = ilv_u_.data()+b.offset;
+        value_type* brhs = ilv_rhs_.data()+b.offset;
+
+        // Copy into the interleaved storage. Unused lanes, and cells with a
+        // zero diagonal, which are to be left as is, are given an identity
+        // matrix, so that their rhs passes through the sweeps unchanged.
+        for (unsigned l = 0; l<lanes; ++l) {
+            auto first = b.first[l];
+            if (first<0 || d[first]==0) {
+                for (index_type j = 0; j<n; ++j) {
+                    bd[j*lanes+l] = 1;
+                    bu[j*lanes+l] = 0;
+                    brhs[j*lanes+l] = first<0? 0: rhs[first+j];
+                }
+            }
+            else {
+                for (index_type j = 0; j<n; ++j) {
+                    bd[j*lanes+l] = d[first+j];
+                    bu[j*lanes+l] = u[first+j];
+                    brhs[j*lanes+l] = rhs[first+j];
+                }
             }
         }
+
+        sweep_block(b);
+        unpack_block(b, rhs.data());
     }
 
-    template<typename VTo>
-    void solve(VTo& to) {
-        solve();
-        memory::copy(rhs, to);
+    // As solve_block, but assembling each lane directly into the
+    // interleaved storage and storing the solution in voltage.
+    void assemble_solve_block(const interleaved_block& b, const_view dt_intdom,
+                              array& voltage, const_view current, const_view conductivity)
+    {
+        const index_type n = structure_divs_[b.structure+1]-structure_divs_[b.structure];
+        value_type* bd = ilv_d_.data()+b.offset;
+        value_type* bu = ilv_u_.data()+b.offset;
+        value_type* brhs = ilv_rhs_.data()+b.offset;
+
+        for (unsigned l = 0; l<lanes; ++l) {
+            auto first = b.first[l];
+            auto dt = first<0? 0: dt_intdom[cell_to_intdom[b.cell[l]]];
+            if (dt>0) {
+                value_type oodt_factor = oodt_scale_/dt; // [1/µs]
+                for (index_type j = 0; j<n; ++j) {
+                    auto i = first+j;
+                    auto area_factor = 1e-3*cv_area[i]; // [1e-9·m²]
+                    auto gi = oodt_factor*cv_capacitance[i] + area_factor*conductivity[i]; // [μS]
+
+                    bd[j*lanes+l] = gi + invariant_d[i];
+                    bu[j*lanes+l] = u[i];
+                    brhs[j*lanes+l] = gi*voltage[i] - area_factor*current[i];
+                }
+            }
+            else {
+                // A zero dt leaves the voltage as is.
+                for (index_type j = 0; j<n; ++j) {
+                    bd[j*lanes+l] = 1;
+                    bu[j*lanes+l] = 0;
+                    brhs[j*lanes+l] = first<0? 0: voltage[first+j];
+                }
+            }
+        }
+
+        sweep_block(b);
+        unpack_block(b, voltage.data(), crank_nicolson_);
     }
 
-private:
+    void sweep_block(const interleaved_block& b) {
+        using simd::assign;
+        using simd::indirect;
 
-    std::size_t size() const {
-        return parent_index.size();
+        const index_type* p = structure_parent_.data()+structure_divs_[b.structure];
+        const index_type n = structure_divs_[b.structure+1]-structure_divs_[b.structure];
+        value_type* bd = ilv_d_.data()+b.offset;
+        value_type* bu = ilv_u_.data()+b.offset;
+        value_type* brhs = ilv_rhs_.data()+b.offset;
+
+        // backward sweep
+        simd_value di, ui, ri, dp, rp;
+        for (auto i = n-1; i>0; --i) {
+            auto pi = p[i];
+            assign(di, indirect(bd+i*lanes, lanes));
+            assign(ui, indirect(bu+i*lanes, lanes));
+            assign(ri, indirect(brhs+i*lanes, lanes));
+            assign(dp, indirect(bd+pi*lanes, lanes));
+            assign(rp, indirect(brhs+pi*lanes, lanes));
+
+            auto factor = ui/di;
+            indirect(bd+pi*lanes, lanes) = dp - factor*ui;
+            indirect(brhs+pi*lanes, lanes) = rp - factor*ri;
+        }
+        assign(di, indirect(bd, lanes));
+        assign(ri, indirect(brhs, lanes));
+        indirect(brhs, lanes) = ri/di;
+
+        // forward sweep
+        for (index_type i = 1; i<n; ++i) {
+            assign(di, indirect(bd+i*lanes, lanes));
+            assign(ui, indirect(bu+i*lanes, lanes));
+            assign(ri, indirect(brhs+i*lanes, lanes));
+            assign(rp, indirect(brhs+p[i]*lanes, lanes));
+            indirect(brhs+i*lanes, lanes) = (ri - ui*rp)/di;
+        }
+    }
+
+    // Copy the solution of a block to `to`, or extrapolate from the
+    // midpoint values of `to` to the end of a Crank–Nicolson step.
+    void unpack_block(const interleaved_block& b, value_type* to, bool extrapolate = false) {
+        const index_type n = structure_divs_[b.structure+1]-structure_divs_[b.structure];
+        const value_type* brhs = ilv_rhs_.data()+b.offset;
+
+        for (unsigned l = 0; l<lanes; ++l) {
+            auto first = b.first[l];
+            if (first<0) continue;
+            for (index_type j = 0; j<n; ++j) {
+                auto x = brhs[j*lanes+l];
+                to[first+j] = extrapolate? 2*x - to[first+j]: x;
+            }
+        }
     }
 };
 
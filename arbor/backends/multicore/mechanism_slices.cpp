@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <vector>
+
+#include <arbor/mechanism.hpp>
+#include <arbor/mechanism_abi.h>
+#include <arbor/profile/profiler.hpp>
+
+#include "backends/multicore/mechanism_slices.hpp"
+#include "threading/threading.hpp"
+
+namespace arb {
+namespace multicore {
+
+mechanism_slices::mechanism_slices(arb::mechanism& m, threading::task_system* ts):
+    mech_(&m), task_system_(ts)
+{
+    const auto& pp = m.ppack_;
+    const arb_size_type width = pp.width;
+    const int n_threads = ts? ts->get_num_threads(): 1;
+
+    if (n_threads<2 || width<2*min_width || m.mech_.has_active_index) return;
+    if (!std::is_sorted(pp.node_index, pp.node_index+width)) return;
+
+    // Ranges start at a multiple of `step`, and not between instances on one
+    // CV. Several ranges per thread allow for imbalance between them.
+    const arb_size_type step = std::max<arb_size_type>(m.iface_.partition_width, m.data_alignment());
+    const arb_size_type n = std::min<arb_size_type>(4*n_threads, width/min_width);
+
+    std::vector<arb_size_type> divs = {0};
+    for (arb_size_type k = 1; k<n; ++k) {
+        arb_size_type b = (std::size_t(width)*k/n)/step*step;
+        while (b<width && b>0 && pp.node_index[b-1]==pp.node_index[b]) b += step;
+        if (b>divs.back() && b<width) divs.push_back(b);
+    }
+    divs.push_back(width);
+    if (divs.size()<3) return;
+
+    // Chunk starts of each constraint in [s0, s1), relative to s0.
+    auto slice_constraint = [](const arb_index_type* c, arb_size_type n_c, arb_size_type s0, arb_size_type s1) {
+        iarray out;
+        for (arb_size_type i = 0; i<n_c; ++i) {
+            if (c[i]>=arb_index_type(s0) && c[i]<arb_index_type(s1)) out.push_back(c[i]-s0);
+        }
+        return out;
+    };
+
+    for (std::size_t k = 0; k+1<divs.size(); ++k) {
+        const auto s0 = divs[k], s1 = divs[k+1];
+        slice s;
+        s.ppack = pp;
+        s.ppack.width = s1-s0;
+        s.ppack.node_index = pp.node_index+s0;
+        s.ppack.weight = pp.weight+s0;
+        if (pp.multiplicity) s.ppack.multiplicity = pp.multiplicity+s0;
+        for (auto i = 0u; i<m.mech_.n_parameters; ++i) s.parameters.push_back(pp.parameters[i]+s0);
+        for (auto i = 0u; i<m.mech_.n_state_vars; ++i) s.state_vars.push_back(pp.state_vars[i]+s0);
+        for (auto i = 0u; i<m.mech_.n_random_variables; ++i) s.random_numbers.push_back(pp.random_numbers[i]+s0);
+        for (auto i = 0u; i<m.mech_.n_ions; ++i) {
+            auto ion = pp.ion_states[i];
+            ion.index += s0;
+            s.ion_states.push_back(ion);
+        }
+
+        const auto& c = pp.index_constraints;
+        s.constraints.contiguous  = slice_constraint(c.contiguous, c.n_contiguous, s0, s1);
+        s.constraints.constant    = slice_constraint(c.constant, c.n_constant, s0, s1);
+        s.constraints.independent = slice_constraint(c.independent, c.n_independent, s0, s1);
+        s.constraints.none        = slice_constraint(c.none, c.n_none, s0, s1);
+        slices_.push_back(std::move(s));
+    }
+
+    // Point the parameter packs at the views of their slices, now that the
+    // slices have their final addresses.
+    for (auto& s: slices_) {
+        s.ppack.parameters = s.parameters.data();
+        s.ppack.state_vars = s.state_vars.data();
+        s.ppack.random_numbers = s.random_numbers.data();
+        s.ppack.ion_states = s.ion_states.data();
+
+        auto& c = s.ppack.index_constraints;
+        c.contiguous    = s.constraints.contiguous.data();
+        c.constant      = s.constraints.constant.data();
+        c.independent   = s.constraints.independent.data();
+        c.none          = s.constraints.none.data();
+        c.n_contiguous  = s.constraints.contiguous.size();
+        c.n_constant    = s.constraints.constant.size();
+        c.n_independent = s.constraints.independent.size();
+        c.n_none        = s.constraints.none.size();
+    }
+}
+
+// With mechanism timing enabled, the mechanism is updated as a whole, so that
+// its time is recorded as usual.
+
+void mechanism_slices::update_current() {
+    if (slices_.empty() || profile::profiler_mechanism_timing()) {
+        mech_->update_current();
+        return;
+    }
+    run(mech_->iface_.compute_currents);
+}
+
+void mechanism_slices::update_state() {
+    if (slices_.empty() || profile::profiler_mechanism_timing()) {
+        mech_->update_state();
+        return;
+    }
+    run(mech_->iface_.advance_state);
+}
+
+void mechanism_slices::run(arb_mechanism_method f) {
+    const auto t = *mech_->time_ptr_ptr;
+    threading::parallel_for::apply(0, slices_.size(), 1, task_system_,
+        [&](int k) {
+            slices_[k].ppack.vec_t = t;
+            f(&slices_[k].ppack);
+        });
+}
+
+} // namespace multicore
+} // namespace arb
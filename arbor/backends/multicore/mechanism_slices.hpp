@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+
+#include <arbor/mechanism.hpp>
+#include <arbor/mechanism_abi.h>
+
+#include "backends/multicore/multicore_common.hpp"
+#include "backends/multicore/partition_by_constraint.hpp"
+#include "threading/threading.hpp"
+
+namespace arb {
+namespace multicore {
+
+// The instances of a mechanism, split into ranges that are updated in
+// parallel by compute_currents and advance_state.
+//
+// Each range has a parameter pack of its own that views the instances of the
+// range, with its share of the SIMD index constraints. Ranges start at a
+// multiple of the SIMD width and data alignment, and instances that share a
+// CV are kept in one range, so that the ranges write disjoint CVs of the
+// shared state. Mechanisms with an active index, or whose instances are not
+// ordered by CV, are not split.
+
+class mechanism_slices {
+public:
+    static constexpr bool supported = true;
+
+    // Minimum number of instances in a range.
+    static constexpr arb_size_type min_width = 1024;
+
+    mechanism_slices() = default;
+    mechanism_slices(arb::mechanism& m, threading::task_system* ts);
+
+    mechanism_slices(mechanism_slices&&) = default;
+    mechanism_slices& operator=(mechanism_slices&&) = default;
+
+    // Number of ranges, or zero if the mechanism is updated as a whole.
+    std::size_t size() const { return slices_.size(); }
+
+    void update_current();
+    void update_state();
+
+private:
+    struct slice {
+        arb_mechanism_ppack ppack;
+        std::vector<arb_value_type*> parameters;
+        std::vector<arb_value_type*> state_vars;
+        std::vector<arb_value_type*> random_numbers;
+        std::vector<arb_ion_state> ion_states;
+        constraint_partition constraints;
+    };
+
+    arb::mechanism* mech_ = nullptr;
+    threading::task_system* task_system_ = nullptr;
+    std::vector<slice> slices_;
+
+    void run(arb_mechanism_method f);
+};
+
+} // namespace multicore
+} // namespace arb
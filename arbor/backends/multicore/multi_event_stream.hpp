@@ -2,6 +2,7 @@
 
 // Indexed collection of pop-only event queues --- multicore back-end implementation.
 
+#include <algorithm>
 #include <limits>
 #include <ostream>
 #include <utility>
@@ -36,9 +37,12 @@ public:
     multi_event_stream() {}
 
     explicit multi_event_stream(size_type n_stream):
-       span_begin_(n_stream), span_end_(n_stream), mark_(n_stream) {}
+       n_index_(n_stream), span_begin_(n_stream), span_end_(n_stream), mark_(n_stream) {}
 
-    size_type n_streams() const { return span_begin_.size(); }
+    // Number of streams in each partition, one per event index.
+    size_type n_streams() const { return n_index_; }
+
+    size_type n_partitions() const { return n_partition_; }
 
     bool empty() const { return remaining_==0; }
 
@@ -51,63 +55,67 @@ public:
         util::fill(mark_, 0);
     }
 
-    // Initialize event streams from a vector of events, sorted by time.
-    void init(std::vector<Event> staged) {
-        using ::arb::event_time;
-        using ::arb::event_index;
-        using ::arb::event_data;
+    // Partition the streams by the `event_partition` key of the events: events
+    // with key k are held in streams of their own in partition `partition[k]`,
+    // and are dropped if `partition[k]` is negative. Events with keys past the
+    // end of `partition`, such as those of exact sampling, which belong to no
+    // mechanism, are held in a last partition of their own: they are never
+    // delivered, but still bound the integration steps. Without partitions,
+    // all events share one set of streams.
+    void set_partitions(std::vector<index_type> partition) {
+        n_partition_ = 1;
+        if (!partition.empty()) {
+            for (auto p: partition) {
+                if (p>=0) n_partition_ = std::max(n_partition_, size_type(p+1));
+            }
+            unkeyed_ = n_partition_++;
+        }
+        partition_ = std::move(partition);
+
+        auto n = n_partition_*n_index_;
+        span_begin_.assign(n, 0);
+        span_end_.assign(n, 0);
+        mark_.assign(n, 0);
+        clear();
+    }
 
+    // Initialize event streams from a vector of events, sorted by time within
+    // each event index. The event arrays keep their capacity from one call
+    // to the next.
+    void init(const std::vector<Event>& staged) {
         if (staged.size()>std::numeric_limits<size_type>::max()) {
             throw arbor_internal_error("multicore/multi_event_stream: too many events for size type");
         }
 
-        // Staged events should already be sorted by index.
-        arb_assert(util::is_sorted_by(staged, [](const Event& ev) { return event_index(ev); }));
-
-        std::size_t n_ev = staged.size();
-        util::assign_by(ev_data_, staged, [](const Event& ev) { return event_data(ev); });
-        util::assign_by(ev_time_, staged, [](const Event& ev) { return event_time(ev); });
-
-        // Determine divisions by `event_index` in ev list.
-        arb_assert(n_streams() == span_begin_.size());
-        arb_assert(n_streams() == span_end_.size());
-        arb_assert(n_streams() == mark_.size());
-
-        index_type ev_begin_i = 0;
-        index_type ev_i = 0;
-        for (size_type s = 0; s<n_streams(); ++s) {
-            while ((size_type)ev_i<n_ev && (size_type)(event_index(staged[ev_i]))<s+1) ++ev_i;
+        if (!init_ordered(staged)) init_unordered(staged);
 
-            // Within a subrange of events with the same index, events should
-            // be sorted by time.
-            arb_assert(util::is_sorted(util::subrange_view(ev_time_, ev_begin_i, ev_i)));
-            mark_[s] = ev_begin_i;
-            span_begin_[s] = ev_begin_i;
-            span_end_[s] = ev_i;
-            ev_begin_i = ev_i;
+        for (std::size_t s = 0; s<span_begin_.size(); ++s) {
+            // Within a stream, events should be sorted by time.
+            arb_assert(util::is_sorted(util::subrange_view(ev_time_, span_begin_[s], span_end_[s])));
+            mark_[s] = span_begin_[s];
         }
-
-        remaining_ = n_ev;
     }
 
     // Designate for processing events `ev` at head of each event stream `i`
     // until `event_time(ev)` > `t_until[i]`.
     template <typename TimeSeq>
     void mark_until_after(const TimeSeq& t_until) {
-        using ::arb::event_time;
-
         arb_assert(n_streams()==std::size(t_until));
 
-        // note: operation on each `i` is independent.
-        for (size_type i = 0; i<n_streams(); ++i) {
-            auto end = span_end_[i];
-            auto t = t_until[i];
-
-            auto mark = span_begin_[i];
-            while (mark!=end && !(ev_time_[mark]>t)) {
-                ++mark;
+        // note: operation on each stream is independent.
+        for (size_type p = 0; p<n_partition_; ++p) {
+            auto offset = p*n_index_;
+            for (size_type i = 0; i<n_index_; ++i) {
+                auto s = offset+i;
+                auto end = span_end_[s];
+                auto t = t_until[i];
+
+                auto mark = span_begin_[s];
+                while (mark!=end && !(ev_time_[mark]>t)) {
+                    ++mark;
+                }
+                mark_[s] = mark;
             }
-            mark_[i] = mark;
         }
     }
 
@@ -115,59 +123,71 @@ public:
     // while `t_until[i]` > `event_time(ev)`.
     template <typename TimeSeq>
     void mark_until(const TimeSeq& t_until) {
-        using ::arb::event_time;
-
         arb_assert(n_streams()==std::size(t_until));
 
-        // note: operation on each `i` is independent.
-        for (size_type i = 0; i<n_streams(); ++i) {
-            auto end = span_end_[i];
-            auto t = t_until[i];
-
-            auto mark = span_begin_[i];
-            while (mark!=end && t>ev_time_[mark]) {
-                ++mark;
+        // note: operation on each stream is independent.
+        for (size_type p = 0; p<n_partition_; ++p) {
+            auto offset = p*n_index_;
+            for (size_type i = 0; i<n_index_; ++i) {
+                auto s = offset+i;
+                auto end = span_end_[s];
+                auto t = t_until[i];
+
+                auto mark = span_begin_[s];
+                while (mark!=end && t>ev_time_[mark]) {
+                    ++mark;
+                }
+                mark_[s] = mark;
             }
-            mark_[i] = mark;
         }
     }
 
     // Remove marked events from front of each event stream.
     void drop_marked_events() {
-        // note: operation on each `i` is independent.
-        for (size_type i = 0; i<n_streams(); ++i) {
-            remaining_ -= (mark_[i]-span_begin_[i]);
-            span_begin_[i] = mark_[i];
+        // note: operation on each stream is independent.
+        for (std::size_t s = 0; s<span_begin_.size(); ++s) {
+            remaining_ -= (mark_[s]-span_begin_[s]);
+            span_begin_[s] = mark_[s];
         }
     }
 
-    // Interface for access to marked events by mechanisms/kernels:
-    state marked_events() const {
-        return {n_streams(), ev_data_.data(), span_begin_.data(), mark_.data()};
+    // Interface for access to marked events by mechanisms/kernels: the
+    // streams of the partition of events with `event_partition` key `key`.
+    state marked_events(size_type key = 0) const {
+        if (partition_.empty()) {
+            return {n_index_, ev_data_.data(), span_begin_.data(), mark_.data()};
+        }
+        if (key>=partition_.size() || partition_[key]<0) {
+            return {n_index_, ev_data_.data(), mark_.data(), mark_.data()};
+        }
+        auto offset = partition_[key]*n_index_;
+        return {n_index_, ev_data_.data(), span_begin_.data()+offset, mark_.data()+offset};
     }
 
     // If the head of `i`th event stream exists and has time less than `t_until[i]`, set
     // `t_until[i]` to the event time.
     template <typename TimeSeq>
     void event_time_if_before(TimeSeq& t_until) {
-        using ::arb::event_time;
-
         // note: operation on each `i` is independent.
-        for (size_type i = 0; i<n_streams(); ++i) {
-            if (span_begin_[i]==span_end_[i]) {
-               continue;
-            }
-
-            auto ev_t = ev_time_[span_begin_[i]];
-            if (t_until[i]>ev_t) {
-                t_until[i] = ev_t;
+        for (size_type p = 0; p<n_partition_; ++p) {
+            auto offset = p*n_index_;
+            for (size_type i = 0; i<n_index_; ++i) {
+                auto s = offset+i;
+                if (span_begin_[s]==span_end_[s]) {
+                   continue;
+                }
+
+                auto ev_t = ev_time_[span_begin_[s]];
+                if (t_until[i]>ev_t) {
+                    t_until[i] = ev_t;
+                }
             }
         }
     }
 
     friend std::ostream& operator<<(std::ostream& out, const multi_event_stream<Event>& m) {
         auto n_ev = m.ev_data_.size();
-        auto n = m.n_streams();
+        auto n = m.span_begin_.size();
 
         out << "\n[";
         unsigned i = 0;
@@ -196,12 +216,101 @@ public:
     }
 
 private:
+    size_type n_index_ = 0;
     std::vector<event_time_type> ev_time_;
     std::vector<index_type> span_begin_;
     std::vector<index_type> span_end_;
     std::vector<index_type> mark_;
     std::vector<event_data_type> ev_data_;
+    std::vector<index_type> partition_;
+    size_type n_partition_ = 1;
+    size_type unkeyed_ = 0;
     size_type remaining_ = 0;
+
+    // Cell groups stage the events of each integration domain contiguously,
+    // so that the events are ordered by stream: they are then copied in one
+    // pass, with the spans found along the way. Returns false, leaving the
+    // streams to be initialized by init_unordered(), if they are not ordered.
+    bool init_ordered(const std::vector<Event>& staged) {
+        using ::arb::event_time;
+        using ::arb::event_data;
+
+        ev_data_.resize(staged.size());
+        ev_time_.resize(staged.size());
+
+        const std::size_t n = span_begin_.size();
+        std::size_t s = 0;
+        index_type n_ev = 0;
+        if (n) span_begin_[0] = 0;
+        for (const auto& ev: staged) {
+            auto e = stream_of(ev);
+            if (e<0) continue;
+            if (std::size_t(e)<s) return false;
+            for (; s<std::size_t(e); ++s) {
+                span_end_[s] = n_ev;
+                span_begin_[s+1] = n_ev;
+            }
+            ev_data_[n_ev] = event_data(ev);
+            ev_time_[n_ev] = event_time(ev);
+            ++n_ev;
+        }
+        for (; s<n; ++s) {
+            span_end_[s] = n_ev;
+            if (s+1<n) span_begin_[s+1] = n_ev;
+        }
+
+        ev_data_.resize(n_ev);
+        ev_time_.resize(n_ev);
+        remaining_ = n_ev;
+        return true;
+    }
+
+    // Count the events of each stream, then place them stream by stream,
+    // keeping their order within each stream.
+    void init_unordered(const std::vector<Event>& staged) {
+        using ::arb::event_time;
+        using ::arb::event_data;
+
+        auto n = span_begin_.size();
+        util::fill(span_end_, 0);
+        for (const auto& ev: staged) {
+            auto s = stream_of(ev);
+            if (s>=0) ++span_end_[s];
+        }
+
+        index_type n_ev = 0;
+        for (std::size_t s = 0; s<n; ++s) {
+            span_begin_[s] = n_ev;
+            n_ev += span_end_[s];
+            span_end_[s] = span_begin_[s];
+        }
+
+        ev_data_.resize(n_ev);
+        ev_time_.resize(n_ev);
+        for (const auto& ev: staged) {
+            auto s = stream_of(ev);
+            if (s<0) continue;
+            auto i = span_end_[s]++;
+            ev_data_[i] = event_data(ev);
+            ev_time_[i] = event_time(ev);
+        }
+
+        remaining_ = n_ev;
+    }
+
+    // Index of the stream of `ev` in the span arrays, or -1 if it is dropped.
+    index_type stream_of(const Event& ev) const {
+        using ::arb::event_index;
+        using ::arb::event_partition;
+
+        index_type i = event_index(ev);
+        if (partition_.empty()) return i;
+
+        auto key = event_partition(ev);
+        if (key>=partition_.size()) return unkeyed_*n_index_+i;
+        if (partition_[key]<0) return -1;
+        return partition_[key]*n_index_+i;
+    }
 };
 
 } // namespace multicore
@@ -2,6 +2,7 @@
 
 #include <vector>
 
+#include <arbor/fvm_types.hpp>
 #include <arbor/simd/simd.hpp>
 
 namespace arb {
@@ -94,6 +95,28 @@ constraint_partition make_constraint_partition(const T& node_index, unsigned wid
     return part;
 }
 
+// An index of `width` entries is padded to a multiple of `simd_width` by
+// repeating its last entry, which makes a partial last chunk `none` even if
+// its valid entries are contiguous. If they are, and continuing the sequence
+// stays below `bound`, the padding can instead continue the sequence so that
+// the chunk is `contiguous`; SIMD mechanisms mask their writes to the padded
+// lanes of such a chunk.
+template <typename T>
+bool can_extend_contiguous_tail(const T& index, unsigned width, unsigned simd_width, fvm_index_type bound) {
+    unsigned k = simd_width? width%simd_width: 0;
+    if (!k) return false;
+    auto tail = &index[width-k];
+    return is_contiguous_n(tail, k) && tail[k-1] + fvm_index_type(simd_width-k) < bound;
+}
+
+template <typename T>
+void extend_contiguous_tail(T& index, unsigned width, unsigned simd_width) {
+    unsigned k = width%simd_width;
+    for (unsigned i = width; i<width-k+simd_width; ++i) {
+        index[i] = index[i-1]+1;
+    }
+}
+
 bool constexpr is_constraint_stronger(index_constraint a, index_constraint b) {
     return a==b ||
            a==index_constraint::none ||
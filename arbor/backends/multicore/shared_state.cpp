@@ -2,6 +2,7 @@
 #include <cfloat>
 #include <cmath>
 #include <iostream>
+#include <limits>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -15,8 +16,11 @@
 #include <arbor/mechanism.hpp>
 #include <arbor/simd/simd.hpp>
 
+#include "backends/adaptive_dt.hpp"
 #include "backends/event.hpp"
+#include "backends/stochastic_input.hpp"
 #include "io/sepval.hpp"
+#include "io/serialize.hpp"
 #include "util/index_into.hpp"
 #include "util/padded_alloc.hpp"
 #include "util/rangeutil.hpp"
@@ -77,8 +81,31 @@ ion_state::ion_state(
     arb_assert(node_index_.size()==init_eX_.size());
 }
 
+void ion_state::configure_diffusion(std::size_t n_cv) {
+    Xd_ = array(n_cv, 0, pad(alignment));
+    Xd_source_ = array(n_cv, 0, pad(alignment));
+}
+
+// With concentrations in mM, volumes in µm³ and times in ms, an outward
+// current density iX [A/m²] through an area A [µm²] removes 1e3·iX·A/(zF)
+// [mM·µm³/ms]; the matrix solver scales current densities by 1e-3·A.
+void ion_state::diffusion_source() {
+    const fvm_value_type scale = 1e6/(charge[0]*constant::faraday);
+    util::fill(Xd_source_, 0);
+    for (auto i: util::count_along(node_index_)) {
+        Xd_source_[node_index_[i]] = scale*iX_[i];
+    }
+}
+
 void ion_state::init_concentration() {
-    std::copy(init_Xi_.begin(), init_Xi_.end(), Xi_.begin());
+    if (Xd_.empty()) {
+        std::copy(init_Xi_.begin(), init_Xi_.end(), Xi_.begin());
+    }
+    else {
+        for (auto i: util::count_along(node_index_)) {
+            Xi_[i] = Xd_[node_index_[i]];
+        }
+    }
     std::copy(init_Xo_.begin(), init_Xo_.end(), Xo_.begin());
 }
 
@@ -86,20 +113,41 @@ void ion_state::zero_current() {
     util::fill(iX_, 0);
 }
 
+void ion_state::configure_nernst(fvm_value_type scale, const array& temperature_degC) {
+    const auto z = charge[0];
+    nernst_coeff_ = array(node_index_.size(), 0, pad(alignment));
+    for (auto i: util::count_along(node_index_)) {
+        nernst_coeff_[i] = scale*(temperature_degC[node_index_[i]]+273.15)/z;
+    }
+}
+
+// The arrays of the ion are padded to the SIMD width, and the results in
+// the padding are not read.
+void ion_state::nernst_reversal_potential() {
+    for (std::size_t i = 0; i<eX_.size(); i += simd_width) {
+        const simd_value_type Xi(Xi_.data()+i), Xo(Xo_.data()+i), coeff(nernst_coeff_.data()+i);
+        simd_value_type eX = coeff*simd::log(Xo/Xi);
+        eX.copy_to(eX_.data()+i);
+    }
+}
+
 void ion_state::reset() {
     zero_current();
     std::copy(reset_Xi_.begin(), reset_Xi_.end(), Xi_.begin());
     std::copy(reset_Xo_.begin(), reset_Xo_.end(), Xo_.begin());
     std::copy(init_eX_.begin(), init_eX_.end(), eX_.begin());
+    if (!Xd_.empty()) {
+        for (auto i: util::count_along(node_index_)) {
+            Xd_[node_index_[i]] = reset_Xi_[i];
+        }
+    }
 }
 
 // istim_state methods:
 
 istim_state::istim_state(const fvm_stimulus_config& stim, unsigned align):
     alignment(min_alignment(align)),
-    accu_to_cv_(stim.cv_unique.begin(), stim.cv_unique.end(), pad(alignment)),
-    frequency_(stim.frequency.begin(), stim.frequency.end(), pad(alignment)),
-    phase_(stim.phase.begin(), stim.phase.end(), pad(alignment))
+    accu_to_cv_(stim.cv_unique.begin(), stim.cv_unique.end(), pad(alignment))
 {
     using util::assign;
 
@@ -111,7 +159,7 @@ istim_state::istim_state(const fvm_stimulus_config& stim, unsigned align):
     std::vector<fvm_value_type> envl_a, envl_t;
     std::vector<fvm_index_type> edivs;
 
-    arb_assert(n==frequency_.size());
+    arb_assert(n==stim.frequency.size());
     arb_assert(n==stim.envelope_time.size());
     arb_assert(n==stim.envelope_amplitude.size());
 
@@ -131,6 +179,21 @@ istim_state::istim_state(const fvm_stimulus_config& stim, unsigned align):
     assign(envl_times_, envl_t);
     assign(envl_divs_, edivs);
     envl_index_.assign(edivs.data(), edivs.data()+n);
+
+    // Per instance data evaluated with SIMD is padded to the alignment.
+    std::size_t n_padded = math::round_up(n, alignment);
+    cv_ = iarray(n_padded, 0, pad(alignment));
+    for (auto i: util::make_span(n)) {
+        cv_[i] = accu_to_cv_[accu_index_[i]];
+    }
+    frequency_ = array(n_padded, 0., pad(alignment));
+    phase_ = array(n_padded, 0., pad(alignment));
+    std::copy(stim.frequency.begin(), stim.frequency.end(), frequency_.begin());
+    std::copy(stim.phase.begin(), stim.phase.end(), phase_.begin());
+    for (auto* a: {&seg_t0_, &seg_t1_, &seg_j0_, &seg_slope_, &time_, &current_}) {
+        *a = array(n_padded, 0., pad(alignment));
+    }
+    reset();
 }
 
 void istim_state::zero_current() {
@@ -142,45 +205,149 @@ void istim_state::reset() {
 
     std::size_t n = envl_index_.size();
     std::copy(envl_divs_.data(), envl_divs_.data()+n, envl_index_.begin());
+    clear_segments();
+}
+
+void istim_state::clear_segments() {
+    util::fill(seg_t1_, -std::numeric_limits<fvm_value_type>::infinity());
+}
+
+void istim_state::update_segment(std::size_t i, fvm_value_type t) {
+    constexpr auto inf = std::numeric_limits<fvm_value_type>::infinity();
+
+    fvm_index_type ei_left = envl_divs_[i];
+    fvm_index_type ei_right = envl_divs_[i+1];
+
+    if (ei_left==ei_right || t<envl_times_[ei_left]) {
+        seg_t0_[i] = 0;
+        seg_t1_[i] = ei_left==ei_right? inf: envl_times_[ei_left];
+        seg_j0_[i] = 0;
+        seg_slope_[i] = 0;
+        return;
+    }
+
+    // Advance index into envelope until either
+    // - the next envelope time is greater than simulation time, or
+    // - it is the last valid index for the envelope.
+    fvm_index_type& ei = envl_index_[i];
+    while (ei+1<ei_right && envl_times_[ei+1]<=t) ++ei;
+
+    seg_t0_[i] = envl_times_[ei];
+    seg_j0_[i] = envl_amplitudes_[ei];
+    if (ei+1<ei_right) {
+        arb_assert(envl_times_[ei]<=t && envl_times_[ei+1]>t);
+        seg_t1_[i] = envl_times_[ei+1];
+        seg_slope_[i] = (envl_amplitudes_[ei+1]-envl_amplitudes_[ei])/(envl_times_[ei+1]-envl_times_[ei]);
+    }
+    else {
+        seg_t1_[i] = inf;
+        seg_slope_[i] = 0;
+    }
 }
 
+// The envelope segments are updated one instance at a time, which is rare,
+// and the current densities are evaluated with explicit SIMD over the
+// padded instances, before they are added to the CVs one at a time, as
+// several stimuli can share a CV.
 void istim_state::add_current(const array& time, const iarray& cv_to_intdom, array& current_density) {
-    constexpr double two_pi = 2*math::pi<double>;
+    const std::size_t n = accu_index_.size();
+    for (std::size_t i = 0; i<n; ++i) {
+        double t = time[cv_to_intdom[cv_[i]]];
+        if (t>=seg_t1_[i]) update_segment(i, t);
+        time_[i] = t;
+    }
 
-    // Consider vectorizing...
-    for (auto i: util::count_along(accu_index_)) {
-        // Advance index into envelope until either
-        // - the next envelope time is greater than simulation time, or
-        // - it is the last valid index for the envelope.
+    const simd_value_type two_pi(2*math::pi<double>), zero(0.);
+    for (std::size_t i = 0; i<time_.size(); i += simd_width) {
+        const simd_value_type t(time_.data()+i), f(frequency_.data()+i);
+        simd_value_type J = simd::fma(simd_value_type(seg_slope_.data()+i), t-simd_value_type(seg_t0_.data()+i), simd_value_type(seg_j0_.data()+i));
+        simd::where(simd::cmp_neq(f, zero), J) = J*simd::sin(two_pi*f*t + simd_value_type(phase_.data()+i));
+        J.copy_to(current_.data()+i);
+    }
 
-        fvm_index_type ei_left = envl_divs_[i];
-        fvm_index_type ei_right = envl_divs_[i+1];
+    for (std::size_t i = 0; i<n; ++i) {
+        accu_stim_[accu_index_[i]] += current_[i];
+        current_density[cv_[i]] -= current_[i];
+    }
+}
 
-        fvm_index_type ai = accu_index_[i];
-        fvm_index_type cv = accu_to_cv_[ai];
-        double t = time[cv_to_intdom[cv]];
+// stochastic_input_state methods:
+
+stochastic_input_state::stochastic_input_state(const fvm_stochastic_input_config& config, unsigned align):
+    intdom_(config.intdom.begin(), config.intdom.end(), pad(min_alignment(align))),
+    weight_(config.weight.begin(), config.weight.end(), pad(min_alignment(align))),
+    rate_(config.rate.begin(), config.rate.end(), pad(min_alignment(align))),
+    tstart_(config.tstart.begin(), config.tstart.end(), pad(min_alignment(align))),
+    tstop_(config.tstop.begin(), config.tstop.end(), pad(min_alignment(align))),
+    seed_(config.seed),
+    stream_(config.stream),
+    instance_divs_(config.instance_divs.begin(), config.instance_divs.end(), pad(min_alignment(align))),
+    lambda_(config.intdom.size(), 0, pad(min_alignment(align))),
+    uniform_(config.intdom.size(), 0, pad(min_alignment(align)))
+{
+    for (auto i: util::count_along(config.mech_id)) {
+        events_.push_back({config.mech_id[i], config.mech_index[i], 0});
 
-        if (ei_left==ei_right || t<envl_times_[ei_left]) continue;
+        auto& range = mech_range_[config.mech_id[i]];
+        if (range.first==range.second) range.first = i;
+        range.second = i+1;
+    }
+}
 
-        fvm_index_type& ei = envl_index_[i];
-        while (ei+1<ei_right && envl_times_[ei+1]<=t) ++ei;
+// The variates are drawn one input at a time, and the counts found by
+// inversion with explicit SIMD, which is the bulk of the work for rates of
+// several events per step; the remainder are found one at a time.
+void stochastic_input_state::sample(const array& time, const array& dt_intdom) {
+    const std::size_t n = size();
+    for (std::size_t i = 0; i<n; ++i) {
+        const auto d = intdom_[i];
+        const auto t = time[d];
+        lambda_[i] = t>=tstart_[i] && t<tstop_[i]? rate_[i]*dt_intdom[d]: 0;
+        uniform_[i] = stochastic_input_uniform(seed_[i], stream_[i], t);
+    }
 
-        double J = envl_amplitudes_[ei]; // current density (A/m²)
-        if (ei+1<ei_right) {
-            // linearly interpolate:
-            arb_assert(envl_times_[ei]<=t && envl_times_[ei+1]>t);
-            double J1 = envl_amplitudes_[ei+1];
-            double u = (t-envl_times_[ei])/(envl_times_[ei+1]-envl_times_[ei]);
-            J = math::lerp(J, J1, u);
+    const std::size_t width = simd_width;
+    std::size_t i = 0;
+    for (; i+width<=n; i += width) {
+        const simd_value_type lambda(lambda_.data()+i), u(uniform_.data()+i);
+        const simd_value_type zero(0.), one(1.);
+
+        simd_value_type p = simd::exp(-lambda), F = p, k = zero;
+        auto more = simd::logical_and(simd::cmp_gt(u, F), simd::cmp_gt(p, zero));
+        simd_value_type pending = zero;
+        simd::where(more, pending) = one;
+        while (simd::sum(pending)>0) {
+            simd::where(more, k) = k + one;
+            simd::where(more, p) = p*lambda/k;
+            simd::where(more, F) = F + p;
+            more = simd::logical_and(more, simd::logical_and(simd::cmp_gt(u, F), simd::cmp_gt(p, zero)));
+            pending = zero;
+            simd::where(more, pending) = one;
         }
+        (k*simd_value_type(weight_.data()+i)).copy_to(lambda_.data()+i);
+    }
+    for (; i<n; ++i) {
+        lambda_[i] = stochastic_input_count(lambda_[i], uniform_[i])*weight_[i];
+    }
 
-        if (frequency_[i]) {
-            J *= std::sin(two_pi*frequency_[i]*t + phase_[i]);
+    for (auto j: util::count_along(events_)) {
+        double w = 0;
+        for (auto k = instance_divs_[j]; k<instance_divs_[j+1]; ++k) {
+            w += lambda_[k];
         }
+        events_[j].weight = w;
+    }
+}
 
-        accu_stim_[ai] += J;
-        current_density[cv] -= J;
+arb_deliverable_event_stream stochastic_input_state::events(unsigned mech_id) const {
+    arb_deliverable_event_stream s{0, events_.data(), nullptr, nullptr};
+    auto it = mech_range_.find(mech_id);
+    if (it!=mech_range_.end()) {
+        s.n_streams = 1;
+        s.begin = &it->second.first;
+        s.end = &it->second.second;
     }
+    return s;
 }
 
 // shared_state methods:
@@ -188,7 +355,7 @@ void istim_state::add_current(const array& time, const iarray& cv_to_intdom, arr
 shared_state::shared_state(
     fvm_size_type n_intdom,
     fvm_size_type n_cell,
-    fvm_size_type n_detector,
+    const std::vector<fvm_index_type>& detector_divs,
     const std::vector<fvm_index_type>& cv_to_intdom_vec,
     const std::vector<fvm_index_type>& cv_to_cell_vec,
     const std::vector<fvm_gap_junction>& gj_vec,
@@ -201,12 +368,13 @@ shared_state::shared_state(
     alignment(min_alignment(align)),
     alloc(alignment),
     n_intdom(n_intdom),
-    n_detector(n_detector),
     n_cv(cv_to_intdom_vec.size()),
     n_gj(gj_vec.size()),
     cv_to_intdom(math::round_up(n_cv, alignment), pad(alignment)),
     cv_to_cell(math::round_up(cv_to_cell_vec.size(), alignment), pad(alignment)),
-    gap_junctions(math::round_up(n_gj, alignment), pad(alignment)),
+    gj_cv(math::round_up(n_gj, alignment), pad(alignment)),
+    gj_peer(math::round_up(n_gj, alignment), pad(alignment)),
+    gj_weight(math::round_up(n_gj, alignment), pad(alignment)),
     time(n_intdom, pad(alignment)),
     time_to(n_intdom, pad(alignment)),
     dt_intdom(n_intdom, pad(alignment)),
@@ -217,7 +385,8 @@ shared_state::shared_state(
     init_voltage(init_membrane_potential.begin(), init_membrane_potential.end(), pad(alignment)),
     temperature_degC(n_cv, pad(alignment)),
     diam_um(diam.begin(), diam.end(), pad(alignment)),
-    time_since_spike(n_cell*n_detector, pad(alignment)),
+    time_since_spike(detector_divs.empty()? 0: detector_divs.back(), pad(alignment)),
+    detector_divs(detector_divs.begin(), detector_divs.end(), pad(alignment)),
     src_to_spike(src_to_spike.begin(), src_to_spike.end(), pad(alignment)),
     deliverable_events(n_intdom)
 {
@@ -232,9 +401,18 @@ shared_state::shared_state(
         std::copy(cv_to_cell_vec.begin(), cv_to_cell_vec.end(), cv_to_cell.begin());
         std::fill(cv_to_cell.begin() + n_cv, cv_to_cell.end(), cv_to_cell_vec.back());
     }
+    // Gap junctions are sorted by CV, so that the voltage and current of
+    // consecutive junctions are contiguous or repeated. The padded tail has
+    // zero weight, on the last CV.
     if (n_gj>0) {
-        std::copy(gj_vec.begin(), gj_vec.end(), gap_junctions.begin());
-        std::fill(gap_junctions.begin()+n_gj, gap_junctions.end(), gj_vec.back());
+        auto gjs = gj_vec;
+        util::stable_sort_by(gjs, [](const fvm_gap_junction& gj) { return gj.loc; });
+        for (unsigned i = 0; i<gj_cv.size(); ++i) {
+            const auto& gj = gjs[std::min<std::size_t>(i, n_gj-1)];
+            gj_cv[i] = gj.loc.first;
+            gj_peer[i] = gj.loc.second;
+            gj_weight[i] = i<n_gj? gj.weight: 0;
+        }
     }
 
     util::fill(time_since_spike, -1.0);
@@ -253,10 +431,106 @@ void shared_state::add_ion(
         std::forward_as_tuple(charge, ion_info, alignment));
 }
 
+void shared_state::configure_ion_diffusion(const std::string& ion_name) {
+    ion_data.at(ion_name).configure_diffusion(n_cv);
+}
+
 void shared_state::configure_stimulus(const fvm_stimulus_config& stims) {
     stim_data = istim_state(stims, alignment);
 }
 
+void shared_state::configure_stochastic_inputs(const fvm_stochastic_input_config& config) {
+    stochastic_inputs = stochastic_input_state(config, alignment);
+}
+
+void shared_state::configure_adaptive_dt(fvm_value_type tolerance, unsigned max_level) {
+    adaptive_dt_tolerance = tolerance;
+    adaptive_dt_max_level = max_level;
+    dt_level = iarray(n_intdom, 0, pad(alignment));
+    dt_prev = array(n_intdom, 0., pad(alignment));
+    dt_curvature = array(n_intdom, 0., pad(alignment));
+    voltage_start = array(n_cv, 0., pad(alignment));
+    voltage_prev = array(n_cv, 0., pad(alignment));
+}
+
+void shared_state::configure_remote_gap_junctions(
+    const std::vector<fvm_index_type>& cv,
+    const std::vector<fvm_value_type>& weight)
+{
+    arb_assert(cv.size()==weight.size());
+
+    gj_remote_cv = iarray(cv.begin(), cv.end(), pad(alignment));
+    gj_remote_weight = array(weight.begin(), weight.end(), pad(alignment));
+    gj_remote_v = array(cv.size(), 0., pad(alignment));
+}
+
+void shared_state::set_remote_gj_voltage(const std::vector<fvm_value_type>& v) {
+    arb_assert(v.size()==gj_remote_v.size());
+    std::copy(v.begin(), v.end(), gj_remote_v.begin());
+}
+
+void shared_state::configure_reductions(
+    const std::vector<probe_handle>& terms,
+    const std::vector<fvm_value_type>& weights,
+    const std::vector<fvm_index_type>& divs)
+{
+    arb_assert(terms.size()==weights.size());
+    arb_assert(!divs.empty() && divs.back()==(fvm_index_type)terms.size());
+
+    reduction_value = array(divs.size()-1, 0., pad(alignment));
+    reduction_term.assign(terms.begin(), terms.end());
+    reduction_weight = array(weights.begin(), weights.end(), pad(alignment));
+    reduction_divs = iarray(divs.begin(), divs.end(), pad(alignment));
+}
+
+void shared_state::configure_accumulators(
+    const std::vector<probe_handle>& sources,
+    const std::vector<fvm_index_type>& intdoms,
+    const std::vector<sampling_policy>& ops)
+{
+    arb_assert(sources.size()==intdoms.size());
+    arb_assert(sources.size()==ops.size());
+
+    accumulator_value = array(sources.size(), 0., pad(alignment));
+    accumulator_weight = array(sources.size(), 0., pad(alignment));
+    accumulator_source.assign(sources.begin(), sources.end());
+    accumulator_intdom = iarray(intdoms.begin(), intdoms.end(), pad(alignment));
+    accumulator_op = ops;
+}
+
+void shared_state::configure_sample_rings(
+    const std::vector<probe_handle>& sources,
+    const std::vector<fvm_index_type>& intdoms,
+    fvm_size_type capacity)
+{
+    arb_assert(sources.size()==intdoms.size());
+    arb_assert(capacity>0 || sources.empty());
+
+    ring_capacity = capacity;
+    ring_steps = 0;
+    ring_value = array(sources.size()*capacity, 0., pad(alignment));
+    ring_time = array(sources.size()*capacity, 0., pad(alignment));
+    ring_source.assign(sources.begin(), sources.end());
+    ring_intdom = iarray(intdoms.begin(), intdoms.end(), pad(alignment));
+}
+
+void shared_state::read_sample_ring(
+    std::size_t i,
+    fvm_value_type t0,
+    fvm_value_type t1,
+    std::vector<fvm_value_type>& times,
+    std::vector<fvm_value_type>& values) const
+{
+    const fvm_size_type n = std::min(ring_steps, ring_capacity);
+    for (fvm_size_type k = ring_steps-n; k<ring_steps; ++k) {
+        auto j = i*ring_capacity + k%ring_capacity;
+        if (ring_time[j]>=t0 && ring_time[j]<=t1) {
+            times.push_back(ring_time[j]);
+            values.push_back(ring_value[j]);
+        }
+    }
+}
+
 void shared_state::reset() {
     std::copy(init_voltage.begin(), init_voltage.end(), voltage.begin());
     util::fill(current_density, 0);
@@ -264,11 +538,32 @@ void shared_state::reset() {
     util::fill(time, 0);
     util::fill(time_to, 0);
     util::fill(time_since_spike, -1.0);
+    util::fill(accumulator_value, 0);
+    util::fill(accumulator_weight, 0);
+    ring_steps = 0;
+    util::fill(dt_level, 0);
+    util::fill(dt_prev, 0);
 
     for (auto& i: ion_data) {
         i.second.reset();
     }
 
+    for (auto& [id, m]: storage) {
+        util::fill(m.random_data_, 0);
+    }
+
+    stim_data.reset();
+}
+
+void shared_state::reset_time() {
+    util::fill(time, 0);
+    util::fill(time_to, 0);
+    util::fill(time_since_spike, -1.0);
+    util::fill(accumulator_value, 0);
+    util::fill(accumulator_weight, 0);
+    ring_steps = 0;
+    util::fill(dt_level, 0);
+    util::fill(dt_prev, 0);
     stim_data.reset();
 }
 
@@ -287,7 +582,27 @@ void shared_state::ions_init_concentration() {
     }
 }
 
+void shared_state::configure_nernst(const std::string& ion_name, fvm_value_type scale, bool constant) {
+    auto& ion = ion_data.at(ion_name);
+    ion.configure_nernst(scale, temperature_degC);
+    nernst_ions.push_back(&ion);
+    nernst_constant.push_back(constant);
+}
+
+void shared_state::ions_nernst_reversal_potential(bool constant) {
+    for (auto i: util::count_along(nernst_ions)) {
+        if (bool(nernst_constant[i])==constant) nernst_ions[i]->nernst_reversal_potential();
+    }
+}
+
 void shared_state::update_time_to(fvm_value_type dt_step, fvm_value_type tmax) {
+    if (adaptive_dt_tolerance>0) {
+        for (fvm_size_type i = 0; i<n_intdom; ++i) {
+            time_to[i] = std::min(time[i] + std::ldexp(dt_step, dt_level[i]), tmax);
+        }
+        return;
+    }
+
     using simd::assign;
     using simd::indirect;
     using simd::add;
@@ -323,13 +638,58 @@ void shared_state::set_dt() {
     }
 }
 
+void shared_state::save_step_voltage() {
+    if (adaptive_dt_tolerance>0) {
+        std::swap(voltage_prev, voltage_start);
+        std::copy(voltage.begin(), voltage.begin()+n_cv, voltage_start.begin());
+    }
+}
+
+void shared_state::adapt_dt(fvm_value_type dt_step, fvm_value_type tmax) {
+    if (!(adaptive_dt_tolerance>0)) return;
+
+    util::fill(dt_curvature, 0);
+    for (fvm_size_type i = 0; i<n_cv; ++i) {
+        auto d = cv_to_intdom[i];
+        auto c = adaptive_dt_curvature(voltage_prev[i], voltage_start[i], voltage[i], dt_prev[d], dt_intdom[d]);
+        dt_curvature[d] = std::max(dt_curvature[d], c);
+    }
+
+    for (fvm_size_type d = 0; d<n_intdom; ++d) {
+        // time_to is below both bounds of update_time_to only if the step
+        // was cut short by an event.
+        bool cut = time_to[d]<tmax && time_to[d]<time[d] + std::ldexp(dt_step, dt_level[d]);
+        dt_level[d] = cut? 0: adaptive_dt_level(dt_level[d], adaptive_dt_max_level, dt_curvature[d],
+            dt_prev[d], dt_intdom[d], dt_step, adaptive_dt_tolerance);
+        dt_prev[d] = dt_intdom[d];
+    }
+}
+
 void shared_state::add_gj_current() {
-    for (unsigned i = 0; i < n_gj; i++) {
-        auto gj = gap_junctions[i];
-        auto curr = gj.weight *
-                    (voltage[gj.loc.second] - voltage[gj.loc.first]); // nA
+    using simd::assign;
+    using simd::indirect;
+    using simd::mul;
+    using simd::sub;
+    // Junctions on the same CV may fall in the same SIMD vector in any
+    // order: the indexed update of the currents assumes no constraint on the
+    // indices, and accumulates the contributions to repeated CVs.
+    for (fvm_size_type i = 0; i<n_gj; i+=simd_width) {
+        simd_index_type cv, peer;
+        assign(cv, indirect(gj_cv.data()+i, simd_width));
+        assign(peer, indirect(gj_peer.data()+i, simd_width));
+
+        simd_value_type weight, v, v_peer;
+        assign(weight, indirect(gj_weight.data()+i, simd_width));
+        assign(v, indirect(voltage.data(), cv, simd_width));
+        assign(v_peer, indirect(voltage.data(), peer, simd_width));
+
+        auto curr = mul(weight, sub(v_peer, v)); // nA
+        indirect(current_density.data(), cv, simd_width, simd::index_constraint::none) -= curr;
+    }
 
-        current_density[gj.loc.first] -= curr;
+    for (std::size_t i = 0; i<gj_remote_cv.size(); ++i) {
+        auto cv = gj_remote_cv[i];
+        current_density[cv] -= gj_remote_weight[i]*(gj_remote_v[i]-voltage[cv]); // nA
     }
 }
 
@@ -337,6 +697,29 @@ void shared_state::add_stimulus_current() {
      stim_data.add_current(time, cv_to_intdom, current_density);
 }
 
+void shared_state::sample_stochastic_inputs() {
+    stochastic_inputs.sample(time, dt_intdom);
+}
+
+arb_deliverable_event_stream shared_state::stochastic_events(mechanism& m) const {
+    return stochastic_inputs.events(m.mechanism_id());
+}
+
+void shared_state::draw_white_noise(mechanism& m) {
+    const auto& store = storage.at(m.mechanism_id());
+    const auto n = m.mech_.n_random_variables;
+    auto random = m.ppack_.random_numbers;
+
+    for (arb_size_type i = 0; i<m.ppack_.width; ++i) {
+        auto t = time[cv_to_intdom[m.ppack_.node_index[i]]];
+        for (arb_size_type k = 0; k<n; k += 2) {
+            auto z = white_noise_normals(store.random_seed_, store.random_stream_, store.random_instance_[i] | k/2, t);
+            random[k][i] = z.z0;
+            if (k+1<n) random[k+1][i] = z.z1;
+        }
+    }
+}
+
 std::pair<fvm_value_type, fvm_value_type> shared_state::time_bounds() const {
     return util::minmax_value(time);
 }
@@ -345,11 +728,102 @@ std::pair<fvm_value_type, fvm_value_type> shared_state::voltage_bounds() const {
     return util::minmax_value(voltage);
 }
 
+std::size_t shared_state::bytes() const {
+    std::size_t n = util::size_in_bytes(cv_to_intdom, cv_to_cell, gj_cv, gj_peer, gj_weight,
+        gj_remote_cv, gj_remote_weight, gj_remote_v, time, time_to, dt_intdom, dt_cv, dt_level, dt_prev, dt_curvature, voltage_start, voltage_prev,
+        voltage, current_density, conductivity, init_voltage, temperature_degC, diam_um, time_since_spike, detector_divs, src_to_spike,
+        reduction_value, reduction_term, reduction_weight, reduction_divs,
+        accumulator_value, accumulator_weight, accumulator_source, accumulator_intdom, accumulator_op,
+        ring_value, ring_time, ring_source, ring_intdom);
+
+    for (const auto& [name, ion]: ion_data) {
+        n += util::size_in_bytes(ion.node_index_, ion.iX_, ion.eX_, ion.Xi_, ion.Xo_,
+            ion.init_Xi_, ion.init_Xo_, ion.reset_Xi_, ion.reset_Xo_, ion.init_eX_, ion.charge,
+            ion.Xd_, ion.Xd_source_);
+    }
+
+    const auto& st = stim_data;
+    n += util::size_in_bytes(st.accu_index_, st.accu_to_cv_, st.cv_, st.frequency_, st.phase_,
+        st.envl_amplitudes_, st.envl_times_, st.envl_divs_, st.accu_stim_, st.envl_index_,
+        st.seg_t0_, st.seg_t1_, st.seg_j0_, st.seg_slope_, st.time_, st.current_);
+
+    const auto& si = stochastic_inputs;
+    n += util::size_in_bytes(si.intdom_, si.weight_, si.rate_, si.tstart_, si.tstop_,
+        si.seed_, si.stream_, si.instance_divs_, si.events_, si.lambda_, si.uniform_);
+
+    for (const auto& [id, m]: storage) {
+        n += util::size_in_bytes(m.data_, m.indices_, m.globals_, m.parameters_, m.state_vars_,
+            m.ion_states_, m.events_, m.random_data_, m.random_numbers_, m.random_instance_);
+    }
+    return n;
+}
+
+void shared_state::update_reductions() {
+    for (std::size_t i = 0; i<reduction_value.size(); ++i) {
+        fvm_value_type sum = 0;
+        for (auto k = reduction_divs[i]; k<reduction_divs[i+1]; ++k) {
+            sum += reduction_weight[k]*(*reduction_term[k]);
+        }
+        reduction_value[i] = sum;
+    }
+}
+
+void shared_state::accumulate_samples() {
+    if (accumulator_value.empty() && ring_source.empty()) return;
+
+    // Accumulator sources may be weighted sums.
+    update_reductions();
+
+    for (std::size_t i = 0; i<accumulator_value.size(); ++i) {
+        auto src = accumulator_source[i];
+        fvm_value_type v = src? *src: 0;
+        fvm_value_type w = dt_intdom[accumulator_intdom[i]];
+
+        auto& a = accumulator_value[i];
+        auto& n = accumulator_weight[i];
+        if (n==0) {
+            a = v;
+        }
+        else {
+            switch (accumulator_op[i]) {
+            case sampling_policy::mean: a += (v-a)*w/(n+w); break;
+            case sampling_policy::min:  a = std::min(a, v); break;
+            case sampling_policy::max:  a = std::max(a, v); break;
+            default:                    a = v; break;
+            }
+        }
+        n += w;
+    }
+
+    if (!ring_source.empty()) {
+        const fvm_size_type pos = ring_steps%ring_capacity;
+        for (std::size_t i = 0; i<ring_source.size(); ++i) {
+            auto src = ring_source[i];
+            ring_value[i*ring_capacity+pos] = src? *src: 0;
+            ring_time[i*ring_capacity+pos] = time[ring_intdom[i]];
+        }
+        ++ring_steps;
+    }
+}
+
 void shared_state::take_samples(
     const sample_event_stream::state& s,
     array& sample_time,
     array& sample_value)
 {
+    if (!reduction_value.empty()) {
+        bool any_marked = false;
+        for (fvm_size_type i = 0; i<s.n_streams() && !any_marked; ++i) {
+            any_marked = s.begin_marked(i)!=s.end_marked(i);
+        }
+        if (any_marked) {
+            update_reductions();
+        }
+    }
+
+    const fvm_value_type* acc_begin = accumulator_value.data();
+    const fvm_value_type* acc_end = acc_begin+accumulator_value.size();
+
     for (fvm_size_type i = 0; i<s.n_streams(); ++i) {
         auto begin = s.begin_marked(i);
         auto end = s.end_marked(i);
@@ -359,6 +833,84 @@ void shared_state::take_samples(
         for (auto p = begin; p<end; ++p) {
             sample_time[p->offset] = time[i];
             sample_value[p->offset] = p->handle? *p->handle: 0;
+
+            if (p->handle>=acc_begin && p->handle<acc_end) {
+                accumulator_weight[p->handle-acc_begin] = 0;
+            }
+        }
+    }
+}
+
+// Ions and mechanism storage are written in order of name and id.
+template <typename Map>
+static std::vector<typename Map::key_type> sorted_keys(const Map& m) {
+    std::vector<typename Map::key_type> keys;
+    util::assign(keys, util::keys(m));
+    util::sort(keys);
+    return keys;
+}
+
+void shared_state::serialize(io::serializer& out) const {
+    for (auto* a: {&time, &time_to, &dt_intdom, &dt_cv, &voltage, &current_density, &conductivity, &time_since_spike}) {
+        out.array(*a);
+    }
+    out.array(stim_data.accu_stim_);
+    out.array(stim_data.envl_index_);
+    for (auto* a: {&dt_prev, &voltage_start, &voltage_prev}) {
+        out.array(*a);
+    }
+    out.array(dt_level);
+
+    for (const auto& name: sorted_keys(ion_data)) {
+        const auto& ion = ion_data.at(name);
+        out.string(name);
+        for (auto* a: {&ion.iX_, &ion.eX_, &ion.Xi_, &ion.Xo_, &ion.Xd_}) {
+            out.array(*a);
+        }
+    }
+
+    for (auto id: sorted_keys(storage)) {
+        const auto& store = storage.at(id);
+        out.value(id);
+        out.array(store.data_);
+        if (auto p = store.active_ppack_) {
+            out.value(p->n_active);
+            out.array(p->active_index, p->width);
+            out.array(p->active_flag, p->width);
+        }
+    }
+}
+
+void shared_state::deserialize(io::deserializer& in) {
+    for (auto* a: {&time, &time_to, &dt_intdom, &dt_cv, &voltage, &current_density, &conductivity, &time_since_spike}) {
+        in.array(*a);
+    }
+    in.array(stim_data.accu_stim_);
+    in.array(stim_data.envl_index_);
+    stim_data.clear_segments();
+    for (auto* a: {&dt_prev, &voltage_start, &voltage_prev}) {
+        in.array(*a);
+    }
+    in.array(dt_level);
+
+    for (const auto& name: sorted_keys(ion_data)) {
+        auto& ion = ion_data.at(name);
+        if (in.string()!=name) {
+            throw bad_checkpoint("ion species do not match the simulation");
+        }
+        for (auto* a: {&ion.iX_, &ion.eX_, &ion.Xi_, &ion.Xo_, &ion.Xd_}) {
+            in.array(*a);
+        }
+    }
+
+    for (auto id: sorted_keys(storage)) {
+        auto& store = storage.at(id);
+        in.expect(id, "mechanism id");
+        in.array(store.data_);
+        if (auto p = store.active_ppack_) {
+            in.value(p->n_active);
+            in.array(p->active_index, p->width);
+            in.array(p->active_flag, p->width);
         }
     }
 }
@@ -404,6 +956,49 @@ void shared_state::set_parameter(mechanism& m, const std::string& key, const std
     copy_extend(values, util::range_n(field_ptr, m.width_padded_), values.back());
 }
 
+arb_deliverable_event_stream shared_state::marked_events(mechanism& m) {
+    auto marked = deliverable_events.marked_events(m.mechanism_id());
+    arb_deliverable_event_stream events;
+    events.n_streams = marked.n;
+    events.begin     = marked.begin_offset;
+    events.end       = marked.end_offset;
+    events.events    = (arb_deliverable_event_data*) marked.ev_data; // FIXME(TH): This relies on bit-castability
+    if (!m.mech_.has_additive_events) return events;
+
+    // Gather the events for this mechanism from all streams, then sum the
+    // weights of events for the same instance. Unless the streams are
+    // partitioned by mechanism, they hold the events of other mechanisms too.
+    auto& store = storage.at(m.mechanism_id());
+    auto& combined = store.events_;
+    combined.clear();
+    for (arb_size_type c = 0; c<events.n_streams; ++c) {
+        for (auto p = events.events+events.begin[c]; p<events.events+events.end[c]; ++p) {
+            if (p->mech_id==m.mechanism_id()) combined.push_back(*p);
+        }
+    }
+    std::sort(combined.begin(), combined.end(),
+              [](const auto& a, const auto& b) { return a.mech_index<b.mech_index; });
+
+    auto out = combined.begin();
+    for (auto p = combined.begin(); p!=combined.end(); ++p) {
+        if (out!=combined.begin() && (out-1)->mech_index==p->mech_index) {
+            (out-1)->weight += p->weight;
+        }
+        else {
+            *out++ = *p;
+        }
+    }
+    combined.erase(out, combined.end());
+
+    store.events_begin_ = 0;
+    store.events_end_   = combined.size();
+    events.n_streams = 1;
+    events.begin     = &store.events_begin_;
+    events.end       = &store.events_end_;
+    events.events    = combined.data();
+    return events;
+}
+
 
 // ion_state methods:
 
@@ -445,7 +1040,7 @@ void shared_state::instantiate(arb::mechanism& m, unsigned id, const mechanism_o
     m.ppack_.temperature_degC = temperature_degC.data();
     m.ppack_.diam_um          = diam_um.data();
     m.ppack_.time_since_spike = time_since_spike.data();
-    m.ppack_.n_detectors      = n_detector;
+    m.ppack_.detector_divs    = detector_divs.data();
     m.ppack_.events           = {};
     m.ppack_.vec_t            = nullptr;
 
@@ -460,6 +1055,7 @@ void shared_state::instantiate(arb::mechanism& m, unsigned id, const mechanism_o
     store.state_vars_.resize(m.mech_.n_state_vars); m.ppack_.state_vars = store.state_vars_.data();
     store.parameters_.resize(m.mech_.n_parameters); m.ppack_.parameters = store.parameters_.data();
     store.ion_states_.resize(m.mech_.n_ions);       m.ppack_.ion_states = store.ion_states_.data();
+    store.random_numbers_.resize(m.mech_.n_random_variables); m.ppack_.random_numbers = store.random_numbers_.data();
 
     // Set ion views
     for (auto idx: make_span(m.mech_.n_ions)) {
@@ -487,18 +1083,30 @@ void shared_state::instantiate(arb::mechanism& m, unsigned id, const mechanism_o
 
     // Initialize state and parameter vectors with default values.
     {
+        // The fields of an instance are read together: if the sub-arrays are
+        // a multiple of 4 KiB long, each is staggered by a cache line so
+        // that they do not all map to the same cache sets.
+        std::size_t stagger = 0;
+        if (width_padded*sizeof(arb_value_type)%4096==0) {
+            stagger = std::max<std::size_t>(alignment, 64)/sizeof(arb_value_type);
+        }
+
         // Allocate bulk storage
-        auto count = (m.mech_.n_state_vars + m.mech_.n_parameters + 1)*width_padded + m.mech_.n_globals;
+        auto n_fields = m.mech_.n_state_vars + m.mech_.n_parameters + 1;
+        auto count = n_fields*(width_padded + stagger) + m.mech_.n_globals;
         store.data_ = array(count, NAN, pad);
         auto base_ptr = store.data_.data();
         // First sub-array of data_ is used for weight_
         append_chunk(pos_data.weight, m.ppack_.weight, 0, base_ptr);
+        base_ptr += stagger;
         // Set fields
         for (auto idx: make_span(m.mech_.n_parameters)) {
             append_const(m.mech_.parameters[idx].default_value, m.ppack_.parameters[idx], base_ptr);
+            base_ptr += stagger;
         }
         for (auto idx: make_span(m.mech_.n_state_vars)) {
             append_const(m.mech_.state_vars[idx].default_value, m.ppack_.state_vars[idx], base_ptr);
+            base_ptr += stagger;
         }
 
         // Assign global scalar parameters
@@ -520,26 +1128,37 @@ void shared_state::instantiate(arb::mechanism& m, unsigned id, const mechanism_o
         store.globals_ = std::vector<arb_value_type>(m.ppack_.globals, m.ppack_.globals + m.mech_.n_globals);
     }
 
+    // Random variables are zero until drawn for the first step.
+    if (auto n = m.mech_.n_random_variables) {
+        if (n>white_noise_max_variables) {
+            throw arbor_internal_error(util::pprintf("multicore/mechanism: too many random variables for '{}'", m.mech_.name));
+        }
+        if (pos_data.random_instance.size()!=pos_data.cv.size()) {
+            throw arbor_internal_error(util::pprintf("multicore/mechanism: no random streams for '{}'", m.mech_.name));
+        }
+        store.random_data_ = array(n*width_padded, 0, pad);
+        auto base_ptr = store.random_data_.data();
+        for (auto idx: make_span(n)) {
+            append_const(0, m.ppack_.random_numbers[idx], base_ptr);
+        }
+        store.random_seed_ = pos_data.random_seed;
+        store.random_stream_ = pos_data.random_stream;
+        store.random_instance_ = pos_data.random_instance;
+    }
+
     // Make index bulk storage
     {
         // Allocate bulk storage
-        auto count     = (mult_in_place ? 1 : 0) + m.mech_.n_ions + 1;
+        auto count     = (mult_in_place ? 1 : 0) + (m.mech_.has_active_index ? 2 : 0) + m.mech_.n_ions + 1;
         store.indices_ = iarray(count*width_padded, 0, pad);
         auto base_ptr  = store.indices_.data();
         // Setup node indices
         append_chunk(pos_data.cv, m.ppack_.node_index, pos_data.cv.back(), base_ptr);
         auto node_index = util::range_n(m.ppack_.node_index, width_padded);
-        // Make SIMD index constraints and set the view
-        store.constraints_ = make_constraint_partition(node_index, m.ppack_.width, m.iface_.partition_width);
-        m.ppack_.index_constraints.contiguous    = store.constraints_.contiguous.data();
-        m.ppack_.index_constraints.constant      = store.constraints_.constant.data();
-        m.ppack_.index_constraints.independent   = store.constraints_.independent.data();
-        m.ppack_.index_constraints.none          = store.constraints_.none.data();
-        m.ppack_.index_constraints.n_contiguous  = store.constraints_.contiguous.size();
-        m.ppack_.index_constraints.n_constant    = store.constraints_.constant.size();
-        m.ppack_.index_constraints.n_independent = store.constraints_.independent.size();
-        m.ppack_.index_constraints.n_none        = store.constraints_.none.size();
         // Create ion indices
+        auto width = m.ppack_.width;
+        auto simd_width = m.iface_.partition_width;
+        bool contiguous_tail = can_extend_contiguous_tail(node_index, width, simd_width, n_cv);
         for (auto idx: make_span(m.mech_.n_ions)) {
             auto  ion = m.mech_.ions[idx].name;
             auto& index_ptr = m.ppack_.ion_states[idx].index;
@@ -550,11 +1169,47 @@ void shared_state::instantiate(arb::mechanism& m, unsigned id, const mechanism_o
             // Obtain index and move data
             auto indices = util::index_into(node_index, oion->node_index_);
             append_chunk(indices, index_ptr, util::back(indices), base_ptr);
-            // Check SIMD constraints
             auto ion_index = util::range_n(index_ptr, width_padded);
-            arb_assert(compatible_index_constraints(node_index, ion_index, m.iface_.partition_width));
+            contiguous_tail &= can_extend_contiguous_tail(ion_index, width, simd_width, oion->node_index_.size());
+        }
+        // A partial last chunk with contiguous indices is padded to stay
+        // contiguous, rather than by repeating the last index.
+        if (contiguous_tail) {
+            extend_contiguous_tail(node_index, width, simd_width);
+            for (auto idx: make_span(m.mech_.n_ions)) {
+                auto ion_index = util::range_n(m.ppack_.ion_states[idx].index, width_padded);
+                extend_contiguous_tail(ion_index, width, simd_width);
+            }
+        }
+        // Flag index maps that are contiguous over all instances; the
+        // generated kernels then skip the index loads.
+        bool contiguous = is_contiguous_n(node_index.begin(), width);
+        for (auto idx: make_span(m.mech_.n_ions)) {
+            contiguous &= is_contiguous_n(m.ppack_.ion_states[idx].index, width);
         }
+        m.ppack_.index_contiguous = contiguous;
+        // Check SIMD constraints
+        for (auto idx: make_span(m.mech_.n_ions)) {
+            auto ion_index = util::range_n(m.ppack_.ion_states[idx].index, width_padded);
+            arb_assert(compatible_index_constraints(node_index, ion_index, simd_width));
+        }
+        // Make SIMD index constraints and set the view
+        store.constraints_ = make_constraint_partition(node_index, width, simd_width);
+        m.ppack_.index_constraints.contiguous    = store.constraints_.contiguous.data();
+        m.ppack_.index_constraints.constant      = store.constraints_.constant.data();
+        m.ppack_.index_constraints.independent   = store.constraints_.independent.data();
+        m.ppack_.index_constraints.none          = store.constraints_.none.data();
+        m.ppack_.index_constraints.n_contiguous  = store.constraints_.contiguous.size();
+        m.ppack_.index_constraints.n_constant    = store.constraints_.constant.size();
+        m.ppack_.index_constraints.n_independent = store.constraints_.independent.size();
+        m.ppack_.index_constraints.n_none        = store.constraints_.none.size();
         if (mult_in_place) append_chunk(pos_data.multiplicity, m.ppack_.multiplicity, 0, base_ptr);
+        // Active index, filled by the mechanism on initialization
+        if (m.mech_.has_active_index) {
+            append_const(0, m.ppack_.active_index, base_ptr);
+            append_const(0, m.ppack_.active_flag, base_ptr);
+            store.active_ppack_ = &m.ppack_;
+        }
     }
 }
 
@@ -1,11 +1,15 @@
 #pragma once
 
+#include <algorithm>
+
 #include <arbor/assert.hpp>
 #include <arbor/fvm_types.hpp>
 #include <arbor/math.hpp>
+#include <arbor/simd/simd.hpp>
 
 #include "backends/threshold_crossing.hpp"
 #include "execution_context.hpp"
+#include "io/serialize.hpp"
 #include "multicore_common.hpp"
 
 namespace arb {
@@ -33,10 +37,10 @@ public:
         t_before_ptr_(t_before),
         t_after_ptr_(t_after),
         n_cv_(cv_index.size()),
-        cv_index_(cv_index),
-        is_crossed_(n_cv_),
-        thresholds_(thresholds),
-        v_prev_(values_, values_+n_cv_)
+        cv_index_(cv_index.begin(), cv_index.end(), pad(alignment)),
+        is_crossed_(n_cv_, 0, pad(alignment)),
+        thresholds_(thresholds.begin(), thresholds.end(), pad(alignment)),
+        v_prev_(values_, values_+n_cv_, pad(alignment))
     {
         arb_assert(n_cv_==thresholds.size());
         reset();
@@ -58,6 +62,18 @@ public:
         }
     }
 
+    /// Write and restore the state machine of each detector, for checkpointing.
+    void serialize(io::serializer& out) const {
+        out.array(is_crossed_);
+        out.array(v_prev_);
+    }
+
+    void deserialize(io::deserializer& in) {
+        clear_crossings();
+        in.array(is_crossed_);
+        in.array(v_prev_);
+    }
+
     const std::vector<threshold_crossing>& crossings() const {
         return crossings_;
     }
@@ -66,43 +82,50 @@ public:
     /// Crossing events are recorded for each threshold that
     /// is crossed since the last call to test
     void test(array* time_since_spike) {
+        using simd::assign;
+        using simd::indirect;
+
         // Reset all spike times to -1.0 indicating no spike has been recorded on the detector
-        const fvm_value_type* t_before = t_before_ptr_->data();
-        const fvm_value_type* t_after  = t_after_ptr_->data();
-        for (fvm_size_type i = 0; i<n_cv_; ++i) {
-            auto cv     = cv_index_[i];
-            auto intdom = cv_to_intdom_[cv];
-            auto v_prev = v_prev_[i];
-            auto v      = values_[cv];
-            auto thresh = thresholds_[i];
-            fvm_index_type spike_idx = 0;
-
-            if (!time_since_spike->empty()) {
-                spike_idx = src_to_spike_[i];
-                (*time_since_spike)[spike_idx] = -1.0;
+        if (!time_since_spike->empty()) {
+            for (fvm_size_type i = 0; i<n_cv_; ++i) {
+                (*time_since_spike)[src_to_spike_[i]] = -1.0;
             }
+        }
 
-            if (!is_crossed_[i]) {
-                if (v>=thresh) {
-                    // The threshold has been passed, so estimate the time using
-                    // linear interpolation.
-                    auto pos = (thresh - v_prev)/(v - v_prev);
-                    auto crossing_time = math::lerp(t_before[intdom], t_after[intdom], pos);
-                    crossings_.push_back({i, crossing_time});
-
-                    if (!time_since_spike->empty()) {
-                        (*time_since_spike)[spike_idx] = t_after[intdom] - crossing_time;
-                    }
-
-                    is_crossed_[i] = true;
-                }
-            }
-            else {
-                if (v<thresh) {
-                    is_crossed_[i] = false;
-                }
+        // Detectors are tested `lanes` at a time. A detector is crossed
+        // after the test exactly when its value is at or above threshold,
+        // and crossings are rare, so the state update is a vector store;
+        // only the lanes with a new crossing are visited to record them,
+        // in detector order.
+        const simd_value one(1.);
+        simd_index cv;
+        simd_value v, thresh, crossed;
+        fvm_size_type i = 0;
+        for (; i+lanes<=n_cv_; i += lanes) {
+            assign(cv, indirect(cv_index_.data()+i, lanes));
+            assign(v, indirect(values_, cv, lanes));
+            assign(thresh, indirect(thresholds_.data()+i, lanes));
+            assign(crossed, indirect(is_crossed_.data()+i, lanes));
+
+            auto above = simd::cmp_geq(v, thresh);
+            auto up = simd::logical_and(above, simd::cmp_eq(crossed, simd_value(0.)));
+
+            bool up_lanes[lanes];
+            up.copy_to(up_lanes);
+            for (unsigned l = 0; l<lanes; ++l) {
+                if (up_lanes[l]) record_crossing(i+l, values_[cv_index_[i+l]], time_since_spike);
             }
 
+            simd_value next(0.);
+            simd::where(above, next) = one;
+            indirect(is_crossed_.data()+i, lanes) = next;
+            indirect(v_prev_.data()+i, lanes) = v;
+        }
+        for (; i<n_cv_; ++i) {
+            auto v = values_[cv_index_[i]];
+            bool above = v>=thresholds_[i];
+            if (above && !is_crossed_[i]) record_crossing(i, v, time_since_spike);
+            is_crossed_[i] = above;
             v_prev_[i] = v;
         }
     }
@@ -117,6 +140,31 @@ public:
     }
 
 private:
+    static constexpr unsigned lanes = std::max(4, simd::simd_abi::native_width<fvm_value_type>::value);
+    using simd_value = simd::simd<fvm_value_type, lanes, simd::simd_abi::default_abi>;
+    using simd_index = simd::simd<fvm_index_type, lanes, simd::simd_abi::default_abi>;
+
+    static constexpr std::size_t alignment = sizeof(fvm_value_type)*lanes;
+    using pad = util::padded_allocator<>;
+
+    // The threshold of detector i has been passed on the way up: estimate
+    // the time of the crossing using linear interpolation.
+    void record_crossing(fvm_size_type i, fvm_value_type v, array* time_since_spike) {
+        auto intdom = cv_to_intdom_[cv_index_[i]];
+        auto t_before = (*t_before_ptr_)[intdom];
+        auto t_after = (*t_after_ptr_)[intdom];
+        auto v_prev = v_prev_[i];
+        auto thresh = thresholds_[i];
+
+        auto pos = (thresh - v_prev)/(v - v_prev);
+        auto crossing_time = math::lerp(t_before, t_after, pos);
+        crossings_.push_back({i, crossing_time});
+
+        if (!time_since_spike->empty()) {
+            (*time_since_spike)[src_to_spike_[i]] = t_after - crossing_time;
+        }
+    }
+
     /// Non-owning pointers to cv-to-intdom map,
     /// the values for to test against thresholds,
     /// and pointers to the time arrays
@@ -128,10 +176,10 @@ private:
 
     /// Threshold watcher state.
     fvm_size_type n_cv_ = 0;
-    std::vector<fvm_index_type> cv_index_;
-    std::vector<fvm_size_type> is_crossed_;
-    std::vector<fvm_value_type> thresholds_;
-    std::vector<fvm_value_type> v_prev_;
+    iarray cv_index_;
+    array is_crossed_;  // 1 if crossed, else 0
+    array thresholds_;
+    array v_prev_;
     std::vector<threshold_crossing> crossings_;
 };
 
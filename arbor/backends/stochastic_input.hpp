@@ -0,0 +1,104 @@
+#pragma once
+
+// Sampling of the event counts of stochastic inputs and of the white noise of
+// mechanisms, common to the back ends.
+//
+// The count of input i in the step from t is drawn by inversion from one
+// uniform variate, given by the counter-based generator Threefry-2x64 with
+// key (seed[i], stream[i]) and counter (bits of t, 0). The count is therefore
+// a function of the input and the start of the step only, whichever back end
+// or thread draws it, and is not affected by a reset or restored checkpoint.
+//
+// The WHITE_NOISE variables of mechanisms are drawn in the same way: the
+// standard normal samples of the instance with stream i in the step from t
+// are the Box-Muller transform of Threefry-2x64 with key (seed, hash of the
+// mechanism name) and counter (bits of t, i), two variables per counter.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <arbor/math.hpp>
+
+#include <Random123/threefry.h>
+#include <Random123/uniform.hpp>
+
+#if defined(__CUDACC__) || defined(__HIPCC__)
+#   define ARB_STOCHASTIC_HOST_DEVICE __host__ __device__
+#else
+#   define ARB_STOCHASTIC_HOST_DEVICE
+#endif
+
+namespace arb {
+
+ARB_STOCHASTIC_HOST_DEVICE
+inline double stochastic_input_uniform(std::uint64_t seed, std::uint64_t stream, double t) {
+    using cbrng = r123::Threefry2x64;
+    std::uint64_t bits;
+    std::memcpy(&bits, &t, sizeof bits);
+    const cbrng::key_type key = {{seed, stream}};
+    const cbrng::ctr_type ctr = {{bits, 0}};
+    return r123::u01<double>(cbrng{}(ctr, key)[0]);
+}
+
+// Number of events of a Poisson process with mean count lambda, for the
+// uniform variate u. The search stops once the terms of the distribution
+// vanish, so that it terminates for u that round to one.
+ARB_STOCHASTIC_HOST_DEVICE
+inline unsigned stochastic_input_count(double lambda, double u) {
+    double p = std::exp(-lambda);
+    double F = p;
+    unsigned k = 0;
+    while (u>F && p>0) {
+        ++k;
+        p *= lambda/k;
+        F += p;
+    }
+    return k;
+}
+
+struct white_noise_pair {
+    double z0, z1;
+};
+
+// The pair of standard normal samples of counter word (instance | pair).
+ARB_STOCHASTIC_HOST_DEVICE
+inline white_noise_pair white_noise_normals(std::uint64_t seed, std::uint64_t stream, std::uint64_t instance, double t) {
+    using cbrng = r123::Threefry2x64;
+    std::uint64_t bits;
+    std::memcpy(&bits, &t, sizeof bits);
+    const cbrng::key_type key = {{seed, stream}};
+    const cbrng::ctr_type ctr = {{bits, instance}};
+    auto r = cbrng{}(ctr, key);
+
+    // u01 excludes zero, so that the logarithm is finite.
+    double rho = std::sqrt(-2*std::log(r123::u01<double>(r[0])));
+    double phi = 2*math::pi<double>*r123::u01<double>(r[1]);
+    return {rho*std::cos(phi), rho*std::sin(phi)};
+}
+
+// The counter word of the pairs of an instance, from the gid of its cell and
+// its index among the instances of the mechanism on the cell; the low eight
+// bits number the pairs.
+ARB_STOCHASTIC_HOST_DEVICE
+inline std::uint64_t white_noise_instance(std::uint64_t gid, std::uint64_t lid) {
+    return gid<<32 | lid<<8;
+}
+
+// The key word of a mechanism, the FNV-1a hash of its name, which is the
+// same on every platform.
+inline std::uint64_t white_noise_stream(const char* name) {
+    std::uint64_t h = 14695981039346656037ull;
+    for (; *name; ++name) {
+        h ^= (unsigned char)*name;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// Limits of the counter words: the index on the cell takes 24 bits, and the
+// pairs of an instance 8 bits.
+constexpr unsigned white_noise_max_lid = 1u<<24;
+constexpr unsigned white_noise_max_variables = 2*256;
+
+} // namespace arb
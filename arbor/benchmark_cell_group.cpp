@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <exception>
 
 #include <arbor/arbexcept.hpp>
@@ -11,6 +13,7 @@
 #include "label_resolution.hpp"
 #include "profile/profiler_macro.hpp"
 
+#include "util/rangeutil.hpp"
 #include "util/span.hpp"
 
 namespace arb {
@@ -32,6 +35,14 @@ benchmark_cell_group::benchmark_cell_group(const std::vector<cell_gid_type>& gid
         cells_.push_back(util::any_cast<benchmark_cell>(rec.get_cell_description(gid)));
     }
 
+    // The state is allocated, and first touched, on the thread that builds
+    // the group, as the state of real cells is.
+    state_.reserve(cells_.size());
+    for (const auto& c: cells_) {
+        state_.emplace_back(c.workload.state_bytes/sizeof(double));
+    }
+    event_pos_.resize(cells_.size());
+
     for (const auto& c: cells_) {
         cg_sources.add_cell();
         cg_targets.add_cell();
@@ -46,6 +57,19 @@ void benchmark_cell_group::reset() {
     for (auto& c: cells_) {
         c.time_sequence.reset();
     }
+    for (auto& x: state_) {
+        std::fill(x.begin(), x.end(), 0.);
+    }
+    std::fill(event_pos_.begin(), event_pos_.end(), 0);
+
+    clear_spikes();
+}
+
+void benchmark_cell_group::deserialize(io::deserializer&, time_type t) {
+    for (auto& c: cells_) {
+        c.time_sequence.reset();
+        c.time_sequence.events(0, t);
+    }
 
     clear_spikes();
 }
@@ -54,6 +78,22 @@ cell_kind benchmark_cell_group::get_cell_kind() const {
     return cell_kind::benchmark;
 }
 
+namespace {
+// One time step of the workload: each value of the state is updated by
+// `flops` dependent multiply-adds, which converge to 2.
+void stream_state(double* x, std::size_t n, unsigned flops) {
+    for (std::size_t i = 0; i<n; ++i) {
+        double v = x[i];
+        for (unsigned k = 0; k<flops; ++k) v = 0.5*v+1.;
+        x[i] = v;
+    }
+}
+
+// Stride between the positions of successive events in the state, in values:
+// a prime, so that the events visit all of a state of fewer values.
+constexpr std::size_t event_stride = 7919;
+} // anonymous namespace
+
 void benchmark_cell_group::advance(epoch ep,
                                    time_type dt,
                                    const event_lane_subrange& event_lanes)
@@ -77,6 +117,27 @@ void benchmark_cell_group::advance(epoch ep,
             spikes_.push_back({{gid, 0u}, t});
         }
 
+        // Synthetic workload: stream through the state at each time step,
+        // and update part of it for each event of the epoch.
+        const auto& work = cells_[i].workload;
+        auto& x = state_[i];
+        if (const auto n = x.size()) {
+            const auto n_step = dt>0? (std::size_t)std::ceil(ep.duration()/dt): 1;
+            for (std::size_t k = 0; k<n_step; ++k) {
+                stream_state(x.data(), n, std::max(1u, work.flops));
+            }
+
+            const auto n_event = std::min(n, work.event_bytes/sizeof(double));
+            auto& pos = event_pos_[i];
+            for (const auto& e: event_lanes[i]) {
+                if (e.time>=ep.t1) break;
+                for (std::size_t j = 0; j<n_event; ++j) {
+                    x[(pos+j)%n] += e.weight;
+                }
+                pos = (pos+event_stride)%n;
+            }
+        }
+
         // Wait until the expected time to advance has elapsed. Use a busy-wait
         // so that the resources of this thread are tied up until the interval
         // has elapsed, to emulate a "real" cell.
@@ -94,6 +155,13 @@ void benchmark_cell_group::clear_spikes() {
     spikes_.clear();
 }
 
+memory_use benchmark_cell_group::state_memory() const {
+    memory_use m;
+    m.host = util::size_in_bytes(gids_, spikes_, event_pos_);
+    for (const auto& x: state_) m.host += util::size_in_bytes(x);
+    return m;
+}
+
 void benchmark_cell_group::add_sampler(sampler_association_handle h,
                                    cell_member_predicate probe_ids,
                                    schedule sched,
@@ -22,6 +22,9 @@ public:
 
     void reset() override;
 
+    void serialize(io::serializer& out) const override {}
+    void deserialize(io::deserializer& in, time_type t) override;
+
     void set_binning_policy(binning_kind policy, time_type bin_interval) override {}
 
     const std::vector<spike>& spikes() const override;
@@ -34,10 +37,17 @@ public:
 
     void remove_all_samplers() override {}
 
+    memory_use state_memory() const override;
+
 private:
     std::vector<benchmark_cell> cells_;
     std::vector<spike> spikes_;
     std::vector<cell_gid_type> gids_;
+
+    // State of the synthetic workload of each cell, and the position in the
+    // state at which the next event is delivered.
+    std::vector<std::vector<double>> state_;
+    std::vector<std::size_t> event_pos_;
 };
 
 } // namespace arb
@@ -84,7 +84,7 @@ struct cable_cell_impl {
         cell_lid_type& lid = placed_count.get<Item>();
         cell_lid_type first = lid;
 
-        for (auto l: thingify(ls, provider)) {
+        for (auto l: provider.evaluate(ls)) {
             placed<Item> p{l, lid++, item};
             mm.push_back(p);
         }
@@ -116,7 +116,7 @@ struct cable_cell_impl {
 
     template <typename Property>
     void paint(const region& reg, const Property& prop) {
-        mextent cables = thingify(reg, provider);
+        mextent cables = provider.evaluate(reg);
         auto& mm = get_region_map(prop);
 
         for (auto c: cables) {
@@ -130,11 +130,11 @@ struct cable_cell_impl {
     }
 
     mlocation_list concrete_locset(const locset& l) const {
-        return thingify(l, provider);
+        return provider.evaluate(l);
     }
 
     mextent concrete_region(const region& r) const {
-        return thingify(r, provider);
+        return provider.evaluate(r);
     }
 };
 
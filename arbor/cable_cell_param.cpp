@@ -50,6 +50,14 @@ void check_global_properties(const cable_cell_global_properties& G) {
             throw cable_cell_error("missing init_reversal_potential or reversal_potential_method for ion "+ion);
         }
     }
+
+    if (!(G.gap_junction_interval>=0)) {
+        throw cable_cell_error("gap_junction_interval must be non-negative");
+    }
+
+    if (G.steady_state_tolerance>0 && !(G.steady_state_dt>0 && G.steady_state_tmax>=0)) {
+        throw cable_cell_error("steady_state_dt must be positive and steady_state_tmax non-negative");
+    }
 }
 
 cable_cell_parameter_set neuron_parameter_defaults = {
@@ -5,13 +5,17 @@
 #include <vector>
 
 #include <arbor/common_types.hpp>
+#include <arbor/memory_footprint.hpp>
 #include <arbor/sampling.hpp>
 #include <arbor/schedule.hpp>
 #include <arbor/spike.hpp>
 #include <arbor/spike_event.hpp>
 
+#include "connection.hpp"
 #include "epoch.hpp"
 #include "event_binner.hpp"
+#include "io/serialize.hpp"
+#include "label_resolution.hpp"
 #include "util/rangeutil.hpp"
 
 // The specialized cell_group constructors are expected to accept at least:
@@ -24,6 +28,13 @@ namespace arb {
 
 using event_lane_subrange = util::subrange_view_type<std::vector<pse_vector>>;
 
+// Time [s] spent by advance() in the set up of events for delivery, and in
+// the set up and delivery of samples.
+struct advance_phase_times {
+    double event_setup = 0;
+    double sampling = 0;
+};
+
 class cell_group {
 public:
     virtual ~cell_group() = default;
@@ -32,15 +43,80 @@ public:
 
     virtual void reset() = 0;
     virtual void set_binning_policy(binning_kind policy, time_type bin_interval) = 0;
+
+    // Only groups that integrate on a time step adjusted to event times
+    // distinguish event delivery policies.
+    virtual void set_event_delivery(event_delivery_kind) {}
     virtual void advance(epoch epoch, time_type dt, const event_lane_subrange& events) = 0;
 
     virtual const std::vector<spike>& spikes() const = 0;
     virtual void clear_spikes() = 0;
 
+    // Advance the group as advance(), and append the spikes generated to
+    // `out`, the spike store of the calling thread. Groups that generate many
+    // spikes may write them there directly.
+    virtual void advance_collect(epoch ep, time_type dt, const event_lane_subrange& events, std::vector<spike>& out) {
+        advance(ep, dt, events);
+        util::append(out, spikes());
+        clear_spikes();
+    }
+
+    // A cell group may generate the events of incoming spikes itself, e.g.
+    // on a GPU, instead of receiving them in its event lanes. It is given
+    // the connections onto its cells once, with index_on_domain() the index
+    // of the target cell in the group, and then the global spikes of each
+    // exchange, which may be enqueued while the group is advancing.
+    virtual bool delivers_spikes() const { return false; }
+    virtual void set_connections(const std::vector<connection>&) {}
+    virtual void enqueue_spikes(std::shared_ptr<const std::vector<spike>>) {}
+
+    // Gap junctions may join cells of different groups, if enabled for
+    // cable cells by gap_junction_interval. A group gives the labels of its
+    // gap junction sites, and the peers of its gap junctions in other
+    // groups, as (gid, index of the site on the cell) resolved against the
+    // labels of all groups. It is then given the sites of its cells whose
+    // voltages other groups require. At each exchange, it appends the
+    // voltages of these sites, and receives those of its peers in the order
+    // in which it gave them.
+    virtual cell_labels_and_gids gap_junction_labels() const { return {}; }
+    virtual std::vector<cell_member_type> remote_gap_junction_peers(const label_resolution_map&) { return {}; }
+    virtual void set_published_gap_junction_sites(const std::vector<cell_member_type>&) {}
+    virtual void published_gap_junction_voltages(std::vector<double>&) const {}
+    virtual void set_remote_gap_junction_voltages(const std::vector<double>&) {}
+
+    // Write the state of the cells at the end of an advance(), and restore it
+    // in a group built from the same recipe, for checkpointing. The time t is
+    // the end of the last epoch through which the group was advanced.
+    virtual void serialize(io::serializer&) const = 0;
+    virtual void deserialize(io::deserializer&, time_type t) = 0;
+
+    // Bytes held by the state of the cells, and by the buffers of samples.
+    virtual memory_use state_memory() const { return {}; }
+    virtual memory_use sample_memory() const { return {}; }
+
+    // Call samplers for any samples held back over several epochs; called
+    // at the end of each simulation run.
+    virtual void flush_samples() {}
+
+    // While set, advance() adds the time spent in its phases other than the
+    // integration of the cells to `t`. Groups that do not distinguish the
+    // phases leave it unchanged.
+    void set_phase_times(advance_phase_times* t) { phase_times_ = t; }
+
     // Sampler association methods below should be thread-safe, as they might be invoked
     // from a sampler call back called from a different cell group running on a different thread.
 
     virtual void add_sampler(sampler_association_handle, cell_member_predicate, schedule, sampler_function, sampling_policy) = 0;
+
+    // Cell groups without probes need not support matrix samplers.
+    virtual void add_matrix_sampler(sampler_association_handle, cell_member_predicate, schedule, matrix_sampler_function, sampling_policy) {}
+
+    // Nor triggered samplers. Triggers are the spikes of the cell of each
+    // probe, and those given by trigger_sampler(), at times not before the
+    // start of the next advance().
+    virtual void add_triggered_sampler(sampler_association_handle, cell_member_predicate, sampling_window, sampler_function) {}
+    virtual void trigger_sampler(sampler_association_handle, time_type) {}
+
     virtual void remove_sampler(sampler_association_handle) = 0;
     virtual void remove_all_samplers() = 0;
 
@@ -50,6 +126,9 @@ public:
     virtual std::vector<probe_metadata> get_probe_metadata(cell_member_type) const {
         return {};
     }
+
+protected:
+    advance_phase_times* phase_times_ = nullptr;
 };
 
 using cell_group_ptr = std::unique_ptr<cell_group>;
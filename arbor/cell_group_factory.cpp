@@ -10,6 +10,7 @@
 #include "fvm_lowered_cell.hpp"
 #include "lif_cell_group.hpp"
 #include "mc_cell_group.hpp"
+#include "point_neuron_cell_group.hpp"
 #include "spike_source_cell_group.hpp"
 
 namespace arb {
@@ -38,10 +39,26 @@ cell_group_factory cell_kind_implementation(
         };
 
     case cell_kind::lif:
+#ifndef ARB_HAVE_GPU
+        if (bk!=backend_kind::multicore) break;
+#endif
+
+        return [bk, ctx](const gid_vector& gids, const recipe& rec, cell_label_range& cg_sources, cell_label_range& cg_targets) {
+            return make_cell_group<lif_cell_group>(gids, rec, cg_sources, cg_targets, bk, ctx);
+        };
+
+    case cell_kind::adex:
+        if (bk!=backend_kind::multicore) break;
+
+        return [](const gid_vector& gids, const recipe& rec, cell_label_range& cg_sources, cell_label_range& cg_targets) {
+            return make_cell_group<adex_cell_group>(gids, rec, cg_sources, cg_targets);
+        };
+
+    case cell_kind::izhikevich:
         if (bk!=backend_kind::multicore) break;
 
         return [](const gid_vector& gids, const recipe& rec, cell_label_range& cg_sources, cell_label_range& cg_targets) {
-            return make_cell_group<lif_cell_group>(gids, rec, cg_sources, cg_targets);
+            return make_cell_group<izhikevich_cell_group>(gids, rec, cg_sources, cg_targets);
         };
 
     case cell_kind::benchmark:
@@ -51,7 +68,8 @@ cell_group_factory cell_kind_implementation(
             return make_cell_group<benchmark_cell_group>(gids, rec, cg_sources, cg_targets);
         };
 
-    default: ;
+    default:
+        return custom_cell_group_implementation(ck, bk);
     }
 
     return cell_group_factory{}; // empty function => not supported
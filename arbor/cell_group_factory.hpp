@@ -23,6 +23,10 @@ using cell_group_factory = std::function<
 cell_group_factory cell_kind_implementation(
         cell_kind, backend_kind, const execution_context&);
 
+// The factory registered for a custom cell kind on a back end, if any; see
+// register_cell_group().
+cell_group_factory custom_cell_group_implementation(cell_kind, backend_kind);
+
 inline bool cell_kind_supported(
         cell_kind c, backend_kind b, const execution_context& ctx)
 {
@@ -29,8 +29,13 @@ std::ostream& operator<<(std::ostream& o, arb::cell_kind k) {
         return o << "lif";
     case arb::cell_kind::benchmark:
         return o << "benchmark_cell";
+    case arb::cell_kind::adex:
+        return o << "adex";
+    case arb::cell_kind::izhikevich:
+        return o << "izhikevich";
+    default:
+        return o << "custom" << (unsigned(k)-unsigned(arb::cell_kind::custom));
     }
-    return o;
 }
 
 std::ostream& operator<<(std::ostream& o, arb::backend_kind k) {
@@ -1,3 +1,9 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -11,22 +17,129 @@
 #include "communication/gathered_vector.hpp"
 #include "connection.hpp"
 #include "distributed_context.hpp"
+#include "event_buffer.hpp"
 #include "execution_context.hpp"
+#include "io/serialize.hpp"
 #include "profile/profiler_macro.hpp"
 #include "threading/threading.hpp"
 #include "util/partition.hpp"
 #include "util/rangeutil.hpp"
 #include "util/span.hpp"
+#include "util/strprintf.hpp"
 
 #include "communication/communicator.hpp"
 
 namespace arb {
 
+namespace {
+// The connections terminating at a run of consecutive local gids, queried
+// in bulk from the recipe, and held in order of cell.
+struct run_connections: connection_sink {
+    cell_gid_type begin = 0, end = 0; // gids of the run
+    cell_size_type index = 0;         // index on domain of the first cell
+    std::vector<cell_size_type> counts;
+    std::vector<cell_connection> conns;
+    cell_gid_type last = 0;
+
+    void add(cell_gid_type target, cell_connection c) override {
+        if (target<std::max(begin, last) || target>=end) {
+            throw arbor_exception(util::pprintf(
+                "recipe::connections_on_range({}, {}) gave a connection onto gid {} out of range or order", begin, end, target));
+        }
+        last = target;
+        ++counts[target-begin];
+        conns.push_back(std::move(c));
+    }
+
+    // Call f(gid, index on domain, connection) for each connection.
+    template <typename F>
+    void for_each(F&& f) const {
+        std::size_t k = 0;
+        for (cell_size_type i = 0; i<counts.size(); ++i) {
+            for (auto n = counts[i]; n>0; --n) f(begin+i, index+i, conns[k++]);
+        }
+    }
+};
+} // anonymous namespace
+
+// Obtain the labels of the cells `gids`, ordered by gid, from the domains to
+// which they are assigned. Each domain answers from the labels of its local
+// cells, `local_sources`; gids unknown to their domain are left out.
+static cell_labels_and_gids fetch_source_labels(const std::vector<cell_gid_type>& gids,
+                                                const domain_decomposition& dom_dec,
+                                                const cell_labels_and_gids& local_sources,
+                                                const distributed_context& dist) {
+    using count_type = gathered_vector<cell_gid_type>::count_type;
+    const auto num_domains = dist.size();
+
+    // Requests, partitioned by the domain of the gid.
+    std::vector<count_type> counts(num_domains);
+    std::vector<unsigned> domains;
+    domains.reserve(gids.size());
+    for (auto gid: gids) {
+        domains.push_back(dom_dec.gid_domain(gid));
+        ++counts[domains.back()];
+    }
+    std::vector<count_type> request_part;
+    util::make_partition(request_part, counts);
+    std::vector<cell_gid_type> requests(gids.size());
+    auto offsets = request_part;
+    for (auto i: util::count_along(gids)) {
+        requests[offsets[domains[i]]++] = gids[i];
+    }
+    auto incoming = dist.alltoall_gids({std::move(requests), std::move(request_part)});
+
+    // Replies, in the order and with the partition of the requests.
+    const auto& local_labels = local_sources.label_range;
+    std::vector<cell_size_type> label_divs;
+    auto label_part = util::make_partition(label_divs, local_labels.sizes());
+    std::unordered_map<cell_gid_type, cell_size_type> local_index;
+    for (auto i: util::count_along(local_sources.gids)) {
+        local_index[local_sources.gids[i]] = i;
+    }
+
+    cell_labels_and_gids replies;
+    std::vector<cell_size_type> reply_part = {0};
+    for (auto d: util::make_span(num_domains)) {
+        for (auto k: util::make_span(incoming.partition()[d], incoming.partition()[d+1])) {
+            auto gid = incoming.values()[k];
+            auto it = local_index.find(gid);
+            if (it==local_index.end()) continue;
+            replies.label_range.add_cell();
+            for (auto l: util::make_span(label_part[it->second])) {
+                replies.label_range.add_label(local_labels.labels()[l], local_labels.ranges()[l]);
+            }
+            replies.gids.push_back(gid);
+        }
+        reply_part.push_back(replies.gids.size());
+    }
+    return dist.alltoall_cell_labels_and_gids(replies, reply_part);
+}
+
 communicator::communicator(const recipe& rec,
                            const domain_decomposition& dom_dec,
                            const label_resolution_map& source_resolution_map,
                            const label_resolution_map& target_resolution_map,
                            execution_context& ctx)
+{
+    construct(rec, dom_dec, &source_resolution_map, nullptr, target_resolution_map, ctx);
+}
+
+communicator::communicator(const recipe& rec,
+                           const domain_decomposition& dom_dec,
+                           const cell_labels_and_gids& local_sources,
+                           const label_resolution_map& target_resolution_map,
+                           execution_context& ctx)
+{
+    construct(rec, dom_dec, nullptr, &local_sources, target_resolution_map, ctx);
+}
+
+void communicator::construct(const recipe& rec,
+                             const domain_decomposition& dom_dec,
+                             const label_resolution_map* source_resolution_map,
+                             const cell_labels_and_gids* local_sources,
+                             const label_resolution_map& target_resolution_map,
+                             execution_context& ctx)
 {
     distributed_ = ctx.distributed;
     thread_pool_ = ctx.thread_pool;
@@ -36,25 +149,14 @@ communicator::communicator(const recipe& rec,
     num_local_cells_ = dom_dec.num_local_cells;
     auto num_total_cells = rec.num_cells();
 
-    // For caching information about each cell
-    struct gid_info {
-        using connection_list = decltype(std::declval<recipe>().connections_on(0));
-        cell_gid_type gid;              // global identifier of cell
-        cell_size_type index_on_domain; // index of cell in this domain
-        connection_list conns;          // list of connections terminating at this cell
-        gid_info() = default;           // so we can in a std::vector
-        gid_info(cell_gid_type g, cell_size_type di, connection_list c):
-            gid(g), index_on_domain(di), conns(std::move(c)) {}
-    };
-
-    // Make a list of local gid with their group index and connections
-    //   -> gid_infos
+    // Make a list of the connections of the local cells, by run of gids
+    //   -> runs
     // Count the number of local connections (i.e. connections terminating on this domain)
     //   -> n_cons: scalar
-    // Calculate and store domain id of the presynaptic cell on each local connection
+    // Calculate and store target chunk and domain id of the presynaptic cell on each local connection
     //   -> src_domains: array with one entry for every local connection
-    // Also the count of presynaptic sources from each domain
-    //   -> src_counts: array with one entry for each domain
+    // Also the count of presynaptic sources from each domain, per target chunk
+    //   -> src_counts: array with one entry for each chunk and domain
 
     // Record all the gid in a flat vector.
     // These are used to map from local index to gid in the parallel loop
@@ -64,48 +166,159 @@ communicator::communicator(const recipe& rec,
     for (auto g: dom_dec.groups) {
         util::append(gids, g.gids);
     }
-    // Build the connection information for local cells in parallel.
-    std::vector<gid_info> gid_infos;
-    gid_infos.resize(num_local_cells_);
-    threading::parallel_for::apply(0, gids.size(), thread_pool_.get(),
-        [&](cell_size_type i) {
-            auto gid = gids[i];
-            gid_infos[i] = gid_info(gid, i, rec.connections_on(gid));
+    // Build the connection information for local cells in parallel, over
+    // runs of at most max_run consecutive gids.
+    constexpr cell_size_type max_run = 1024;
+    std::vector<run_connections> runs;
+    for (auto i: util::count_along(gids)) {
+        if (runs.empty() || runs.back().end!=gids[i] || runs.back().end-runs.back().begin==max_run) {
+            runs.emplace_back();
+            runs.back().begin = gids[i];
+            runs.back().end = gids[i];
+            runs.back().index = i;
+        }
+        ++runs.back().end;
+    }
+    threading::parallel_for::apply(0, runs.size(), thread_pool_.get(),
+        [&](std::size_t i) {
+            auto& r = runs[i];
+            r.counts.assign(r.end-r.begin, 0);
+            rec.connections_on_range(r.begin, r.end, r);
         });
+    auto for_each_connection = [&runs](auto&& f) {
+        for (const auto& r: runs) r.for_each(f);
+    };
+
+    // Local cells are split into contiguous chunks, so that event queues for
+    // each chunk can be built concurrently with no contention on the queues.
+    // With a single thread there is one chunk, and the connections are
+    // ordered exactly as for a serial walk.
+    num_chunks_ = std::max(1u, std::min(num_local_cells_,
+                      thread_pool_->get_num_threads()>1? 4u*thread_pool_->get_num_threads(): 1u));
+    auto chunk_of = [this](cell_size_type i) { return cell_chunk(i); };
 
     cell_local_size_type n_cons =
-        util::sum_by(gid_infos, [](const gid_info& g){ return g.conns.size(); });
+        util::sum_by(runs, [](const run_connections& r){ return r.conns.size(); });
     std::vector<unsigned> src_domains;
     src_domains.reserve(n_cons);
-    std::vector<cell_size_type> src_counts(num_domains_);
+    std::vector<cell_size_type> src_counts(num_chunks_*num_domains_);
 
-    for (const auto& cell: gid_infos) {
-        for (auto c: cell.conns) {
-            if (c.source.gid >= num_total_cells) {
-                throw arb::bad_connection_source_gid(cell.gid, c.source.gid, num_total_cells);
-            }
-            const auto src = dom_dec.gid_domain(c.source.gid);
-            src_domains.push_back(src);
-            src_counts[src]++;
+    for_each_connection([&](cell_gid_type gid, cell_size_type index, const cell_connection& c) {
+        if (c.source.gid >= num_total_cells) {
+            throw arb::bad_connection_source_gid(gid, c.source.gid, num_total_cells);
+        }
+        const auto src = chunk_of(index)*num_domains_ + dom_dec.gid_domain(c.source.gid);
+        src_domains.push_back(src);
+        src_counts[src]++;
+    });
+
+    // Procedural projections with targets on local cells.
+    std::vector<std::shared_ptr<const procedural_projection>> projections;
+    for (auto& p: rec.projections()) {
+        if (p->source_end>num_total_cells) {
+            throw arb::bad_connection_source_gid(p->target_begin, p->source_end-1, num_total_cells);
+        }
+        if (util::any_of(gids, [&p](auto gid) { return gid>=p->target_begin && gid<p->target_end; })) {
+            projections.push_back(p);
         }
     }
 
+    // Without a global source map, resolve against the labels of just those
+    // sources that the local connections reference.
+    std::optional<label_resolution_map> fetched_sources;
+    if (!source_resolution_map) {
+        std::vector<cell_gid_type> source_gids;
+        source_gids.reserve(n_cons);
+        for_each_connection([&](cell_gid_type, cell_size_type, const cell_connection& c) {
+            source_gids.push_back(c.source.gid);
+        });
+        for (const auto& p: projections) {
+            for (auto gid: util::make_span(p->source_begin, p->source_end)) source_gids.push_back(gid);
+        }
+        util::sort(source_gids);
+        source_gids.erase(std::unique(source_gids.begin(), source_gids.end()), source_gids.end());
+        fetched_sources.emplace(fetch_source_labels(source_gids, dom_dec, *local_sources, *distributed_));
+        source_resolution_map = &*fetched_sources;
+    }
+
     // Construct the connections.
     // The loop above gave the information required to construct in place
-    // the connections as partitioned by the domain of their source gid.
-    connections_.resize(n_cons);
-    util::make_partition(connection_part_, src_counts);
-    auto offsets = connection_part_;
+    // the connections as partitioned by target chunk, then by the domain of
+    // their source gid.
+    std::vector<connection> connections(n_cons);
+    std::vector<cell_size_type> connection_part;
+    util::make_partition(connection_part, src_counts);
+    auto offsets = connection_part;
     std::size_t pos = 0;
     auto target_resolver = resolver(&target_resolution_map);
-    for (const auto& cell: gid_infos) {
-        auto source_resolver = resolver(&source_resolution_map);
-        for (const auto& c: cell.conns) {
+    for (const auto& run: runs) {
+        // Source labels are resolved afresh for each cell.
+        auto source_resolver = resolver(source_resolution_map);
+        auto resolver_gid = run.begin;
+        run.for_each([&](cell_gid_type gid, cell_size_type index, const cell_connection& c) {
+            if (gid!=resolver_gid) {
+                source_resolver = resolver(source_resolution_map);
+                resolver_gid = gid;
+            }
             const auto i = offsets[src_domains[pos]]++;
             auto src_lid = source_resolver.resolve(c.source);
-            auto tgt_lid = target_resolver.resolve({cell.gid, c.dest});
-            connections_[i] = {{c.source.gid, src_lid}, tgt_lid, c.weight, c.delay, cell.index_on_domain};
+            auto tgt_lid = target_resolver.resolve({gid, c.dest});
+            std::uint8_t rule = 0;
+            if (c.plasticity) {
+                auto it = std::find(rules_.begin(), rules_.end(), *c.plasticity);
+                if (it==rules_.end()) {
+                    if (rules_.size()==std::numeric_limits<std::uint8_t>::max()) {
+                        throw arbor_exception("more than 255 distinct plasticity rules on a domain");
+                    }
+                    it = rules_.insert(it, *c.plasticity);
+                }
+                rule = 1+(it-rules_.begin());
+            }
+            connections[i] = {{c.source.gid, src_lid}, tgt_lid, c.weight, c.delay, index, rule};
             ++pos;
+        });
+    }
+
+    // Resolve the sources and local targets of the projections, and record
+    // their sources and delays by source domain.
+    projection_sources_.assign(num_domains_, {});
+    projection_min_delay_.assign(num_domains_, std::numeric_limits<time_type>::max());
+    for (auto& p: projections) {
+        local_projection lp{p, {}, std::vector<cell_lid_type>(num_local_cells_, 0)};
+
+        auto source_resolver = resolver(source_resolution_map);
+        lp.source_lids.reserve(p->source_end-p->source_begin);
+        for (auto gid: util::make_span(p->source_begin, p->source_end)) {
+            lp.source_lids.push_back(source_resolver.resolve({gid, p->source}));
+
+            auto dom = dom_dec.gid_domain(gid);
+            projection_sources_[dom].push_back(gid);
+            projection_min_delay_[dom] = std::min(projection_min_delay_[dom], time_type(p->min_delay()));
+        }
+        for (auto i: util::count_along(gids)) {
+            if (gids[i]>=p->target_begin && gids[i]<p->target_end) {
+                lp.target_lids[i] = target_resolver.resolve({gids[i], p->target});
+            }
+        }
+        projections_.push_back(std::move(lp));
+    }
+    for (auto& sources: projection_sources_) {
+        util::sort(sources);
+        sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+    }
+
+    // Split the local cells of each chunk into runs of consecutive gids, over
+    // which the projections are evaluated.
+    chunk_runs_.assign(num_chunks_, {});
+    if (!projections_.empty()) {
+        for (auto i: util::count_along(gids)) {
+            auto& runs = chunk_runs_[chunk_of(i)];
+            if (!runs.empty() && runs.back().gid+runs.back().size==gids[i]) {
+                ++runs.back().size;
+            }
+            else {
+                runs.push_back({gids[i], cell_size_type(i), 1});
+            }
         }
     }
 
@@ -115,60 +328,283 @@ communicator::communicator(const recipe& rec,
             dom_dec.groups,
             [](const group_description& g){return g.gids.size();}));
 
-    // Sort the connections for each domain.
-    // This is num_domains_ independent sorts, so it can be parallelized trivially.
-    const auto& cp = connection_part_;
-    threading::parallel_for::apply(0, num_domains_, thread_pool_.get(),
+    // Sort the connections for each chunk and domain.
+    // These are independent sorts, so it can be parallelized trivially.
+    const auto& cp = connection_part;
+    threading::parallel_for::apply(0, num_chunks_*num_domains_, thread_pool_.get(),
         [&](cell_size_type i) {
-            util::sort(util::subrange_view(connections_, cp[i], cp[i+1]));
+            util::sort(util::subrange_view(connections, cp[i], cp[i+1]));
         });
+
+    // Compress the sorted connections into the source-indexed table,
+    // one partition for each chunk and domain.
+    for (auto i: util::make_span(num_chunks_*num_domains_)) {
+        auto part = util::subrange_view(connections, cp[i], cp[i+1]);
+        connections_.append_partition(part.begin(), part.end());
+    }
+    connections_.compress();
+
+    // Index the plastic connections by target cell, and their sources.
+    if (connections_.plastic()) {
+        const auto& ct = connections_;
+        std::vector<cell_size_type> counts(num_local_cells_);
+        for (auto k: util::count_along(ct.sources)) {
+            bool plastic = false;
+            for (auto i: util::make_span(ct.offsets[k], ct.offsets[k+1])) {
+                if (ct.rules[i]) {
+                    ++counts[ct.index_on_domain[i]];
+                    plastic = true;
+                }
+            }
+            if (plastic) plastic_sources_.push_back({ct.sources[k], k});
+        }
+        util::stable_sort_by(plastic_sources_, [](const auto& p) { return p.first; });
+
+        util::make_partition(plastic_in_divs_, counts);
+        plastic_in_.resize(plastic_in_divs_.back());
+        auto next = plastic_in_divs_;
+        for (auto k: util::count_along(ct.sources)) {
+            for (auto i: util::make_span(ct.offsets[k], ct.offsets[k+1])) {
+                if (ct.rules[i]) {
+                    plastic_in_[next[ct.index_on_domain[i]]++] = {cell_size_type(i), cell_size_type(k)};
+                }
+            }
+        }
+        initial_weights_.reserve(plastic_in_.size());
+        for (auto [i, k]: plastic_in_) {
+            initial_weights_.push_back(ct.weights[i]);
+        }
+
+        for (auto cell: util::make_span(num_local_cells_)) {
+            if (counts[cell]) plastic_targets_.push_back({gids[cell], cell});
+        }
+        util::sort_by(plastic_targets_, [](const auto& p) { return p.first; });
+
+        reset_plasticity();
+    }
 }
 
-std::pair<cell_size_type, cell_size_type> communicator::group_queue_range(cell_size_type i) {
+// Cell i of n is in chunk (i*C+C-1)/n of C, rounded down: chunk c comprises
+// the cells with indices i such that c*n <= i*C+C-1 < (c+1)*n, a contiguous
+// range of n/C cells, rounded up or down.
+cell_size_type communicator::cell_chunk(cell_size_type index_on_domain) const {
+    return cell_size_type((std::uint64_t(index_on_domain)*num_chunks_+num_chunks_-1)/num_local_cells_);
+}
+
+std::pair<cell_size_type, cell_size_type> communicator::group_queue_range(cell_size_type i) const {
     arb_assert(i<num_local_groups_);
     return index_part_[i];
 }
 
 time_type communicator::min_delay() {
-    auto local_min = std::numeric_limits<time_type>::max();
-    for (auto& con : connections_) {
-        local_min = std::min(local_min, con.delay());
+    time_type local_min = std::numeric_limits<time_type>::max();
+    for (auto i: util::make_span(connections_.delays.size())) {
+        local_min = std::min(local_min, time_type(connections_.delays[i]));
+    }
+    for (auto delay: projection_min_delay_) {
+        local_min = std::min(local_min, delay);
     }
 
     return distributed_->min(local_min);
 }
 
 gathered_vector<spike> communicator::exchange(std::vector<spike> local_spikes) {
+    auto request = exchange_begin(local_spikes);
+    return exchange_end(request);
+}
+
+spike_gather_request communicator::exchange_begin(std::vector<spike>& local_spikes) {
     PE(communication_exchange_sort);
-    // sort the spikes in ascending order of source gid
-    util::sort_by(local_spikes, [](spike s){return s.source;});
+    // sort the spikes in ascending order of source gid, unless the caller
+    // has gathered them sorted already
+    auto by_source = [](const spike& a, const spike& b) { return a.source<b.source; };
+    if (!std::is_sorted(local_spikes.begin(), local_spikes.end(), by_source)) {
+        util::sort_by(local_spikes, [](spike s){return s.source;});
+    }
+    PL();
+
+    if (exchange_kind_==spike_exchange_kind::point_to_point) {
+        using count_type = gathered_vector<spike>::count_type;
+
+        PE(communication_exchange_route);
+        // Bucket spikes by destination domain, in two passes: count, then scatter.
+        // Spikes are visited in order, so each bucket remains sorted by source.
+        std::vector<count_type> counts(num_domains_);
+        for (const auto& s: local_spikes) {
+            if (auto it = route_index_.find(s.source.gid); it!=route_index_.end()) {
+                for (auto i: util::make_span(it->second)) {
+                    ++counts[route_domains_[i]];
+                }
+            }
+        }
+
+        std::vector<count_type> partition;
+        util::make_partition(partition, counts);
+        std::vector<spike> routed(partition.back());
+        auto offsets = partition;
+        for (const auto& s: local_spikes) {
+            if (auto it = route_index_.find(s.source.gid); it!=route_index_.end()) {
+                for (auto i: util::make_span(it->second)) {
+                    routed[offsets[route_domains_[i]]++] = s;
+                }
+            }
+        }
+        PL();
+
+        PE(communication_exchange_gather);
+        // Not every spike is received on every domain: the global total is
+        // counted from the local contributions once the exchange completes.
+        exchange_local_spikes_ = local_spikes.size();
+        auto request = distributed_->alltoall_spikes_async(
+            gathered_vector<spike>(std::move(routed), std::move(partition)));
+        PL();
+
+        return request;
+    }
+
+    PE(communication_exchange_gather);
+    // start global all-to-all to gather a local copy of the global spike list on each node.
+    auto request = distributed_->gather_spikes_async(local_spikes);
     PL();
 
+    return request;
+}
+
+gathered_vector<spike> communicator::exchange_end(spike_gather_request& request) {
     PE(communication_exchange_gather);
-    // global all-to-all to gather a local copy of the global spike list on each node.
-    auto global_spikes = distributed_->gather_spikes(local_spikes);
-    num_spikes_ += global_spikes.size();
+    auto global_spikes = request.wait();
+    if (exchange_kind_==spike_exchange_kind::allgather) {
+        num_spikes_ += global_spikes.size();
+    }
+    else {
+        num_spikes_ += distributed_->sum(exchange_local_spikes_);
+    }
     PL();
 
     return global_spikes;
 }
 
+void communicator::set_exchange_kind(spike_exchange_kind kind) {
+    exchange_kind_ = kind;
+    route_index_.clear();
+    route_domains_.clear();
+
+    if (kind!=spike_exchange_kind::point_to_point) return;
+
+    // Collect, for each source domain, the distinct source gids with
+    // connections on this domain, over all target chunks.
+    using count_type = gathered_vector<cell_gid_type>::count_type;
+    std::vector<cell_gid_type> wanted;
+    std::vector<count_type> wanted_part = {0};
+    const auto& ct = connections_;
+    for (auto dom: util::make_span(num_domains_)) {
+        auto first = wanted.size();
+        for (auto chunk: util::make_span(num_chunks_)) {
+            auto part = chunk*num_domains_ + dom;
+            for (auto k: util::make_span(ct.source_part[part], ct.source_part[part+1])) {
+                wanted.push_back(ct.sources[k].gid);
+            }
+        }
+        util::append(wanted, projection_sources_[dom]);
+        // The spikes of local cells with plastic connections are needed
+        // locally for the plasticity of the connections.
+        if (dom==cell_size_type(distributed_->id())) {
+            for (auto& [gid, cell]: plastic_targets_) wanted.push_back(gid);
+        }
+        auto gids = util::make_range(wanted.begin()+first, wanted.end());
+        util::sort(gids);
+        wanted.erase(std::unique(gids.begin(), gids.end()), wanted.end());
+        wanted_part.push_back(wanted.size());
+    }
+
+    // Tell each domain which of its sources we require; in return, learn
+    // which of our sources are required by each domain.
+    auto requested = distributed_->alltoall_gids(
+        gathered_vector<cell_gid_type>(std::move(wanted), std::move(wanted_part)));
+
+    // Invert the per-domain gid lists into per-gid destination lists.
+    std::unordered_map<cell_gid_type, cell_size_type> counts;
+    for (auto gid: requested.values()) {
+        ++counts[gid];
+    }
+
+    cell_size_type n = 0;
+    for (auto& [gid, count]: counts) {
+        route_index_[gid] = {n, n};
+        n += count;
+    }
+    route_domains_.resize(n);
+
+    const auto& rp = requested.partition();
+    for (auto dom: util::make_span(num_domains_)) {
+        for (auto i: util::make_span(rp[dom], rp[dom+1])) {
+            auto& range = route_index_[requested.values()[i]];
+            route_domains_[range.second++] = dom;
+        }
+    }
+}
+
 void communicator::make_event_queues(
         const gathered_vector<spike>& global_spikes,
-        std::vector<pse_vector>& queues)
+        event_buffer& queues)
 {
-    arb_assert(queues.size()==num_local_cells_);
+    arb_assert(queues.num_cells()==num_local_cells_);
+
+    // Events are generated in two passes over the chunks: the first matches
+    // spikes against the connection table and counts the events for each
+    // cell, the second scatters the events into the partitioned buffer.
+    // Each chunk only generates events for its own contiguous range of cells,
+    // so the chunks are processed concurrently without synchronization.
+    chunk_matches_.resize(num_chunks_);
+    chunk_projection_events_.resize(num_chunks_);
+
+    auto for_each_chunk = [&](auto&& f) {
+        if (num_chunks_>1) {
+            threading::parallel_for::apply(0, num_chunks_, thread_pool_.get(), f);
+        }
+        else {
+            f(0);
+        }
+    };
 
+    for_each_chunk([&](cell_size_type c) {
+        match_spikes_chunk(c, global_spikes, queues);
+        match_projections_chunk(c, global_spikes, queues);
+    });
+    queues.allocate();
+    for_each_chunk([&](cell_size_type c) { make_event_queues_chunk(c, queues); });
+}
+
+void communicator::match_spikes_chunk(
+        cell_size_type chunk,
+        const gathered_vector<spike>& global_spikes,
+        event_buffer& queues)
+{
     using util::subrange_view;
     using util::make_span;
-    using util::make_range;
+
+    auto& matches = chunk_matches_[chunk];
+    matches.clear();
 
     const auto& sp = global_spikes.partition();
-    const auto& cp = connection_part_;
+    const auto& ct = connections_;
     for (auto dom: make_span(num_domains_)) {
-        auto cons = subrange_view(connections_, cp[dom], cp[dom+1]);
+        auto part = chunk*num_domains_ + dom;
+        auto sb = ct.sources.begin();
+        auto srcs = util::make_range(sb+ct.source_part[part], sb+ct.source_part[part+1]);
         auto spks = subrange_view(global_spikes.values(), sp[dom], sp[dom+1]);
 
+        // Record that spike s generates events for the connections from
+        // source k; these occupy a contiguous range of the connection table.
+        auto match = [&](std::size_t k, const spike& s) {
+            matches.push_back({k, &s});
+            for (auto i: make_span(ct.offsets[k], ct.offsets[k+1])) {
+                if (!delegated(ct.index_on_domain[i])) {
+                    queues.count(ct.index_on_domain[i]);
+                }
+            }
+        };
+
         struct spike_pred {
             bool operator()(const spike& spk, const cell_member_type& src)
                 {return spk.source<src;}
@@ -176,42 +612,255 @@ void communicator::make_event_queues(
                 {return src<spk.source;}
         };
 
-        // We have a choice of whether to walk spikes or connections:
+        // We have a choice of whether to walk spikes or sources:
         // i.e., we can iterate over the spikes, and for each spike search
-        // the for connections that have the same source; or alternatively
-        // for each connection, we can search the list of spikes for spikes
+        // the for the (unique) source in the connection table; or alternatively
+        // for each source, we can search the list of spikes for spikes
         // with the same source.
         //
         // We iterate over whichever set is the smallest, which has
-        // complexity of order max(S log(C), C log(S)), where S is the
-        // number of spikes, and C is the number of connections.
-        if (cons.size()<spks.size()) {
+        // complexity of order max(S log(N), N log(S)), where S is the
+        // number of spikes, and N is the number of distinct sources.
+        if (srcs.size()<spks.size()) {
             auto sp = spks.begin();
-            auto cn = cons.begin();
-            while (cn!=cons.end() && sp!=spks.end()) {
-                auto sources = std::equal_range(sp, spks.end(), cn->source(), spike_pred());
-                for (auto s: make_range(sources)) {
-                    queues[cn->index_on_domain()].push_back(cn->make_event(s));
+            for (auto src = srcs.begin(); src!=srcs.end() && sp!=spks.end(); ++src) {
+                auto sources = std::equal_range(sp, spks.end(), *src, spike_pred());
+                for (auto s = sources.first; s!=sources.second; ++s) {
+                    match(src-sb, *s);
                 }
-
-                sp = sources.first;
-                ++cn;
+                sp = sources.second;
             }
         }
         else {
-            auto cn = cons.begin();
-            auto sp = spks.begin();
-            while (cn!=cons.end() && sp!=spks.end()) {
-                auto targets = std::equal_range(cn, cons.end(), sp->source);
-                for (auto c: make_range(targets)) {
-                    queues[c.index_on_domain()].push_back(c.make_event(*sp));
+            auto src = srcs.begin();
+            for (auto sp = spks.begin(); sp!=spks.end() && src!=srcs.end(); ++sp) {
+                src = std::lower_bound(src, srcs.end(), sp->source);
+                if (src!=srcs.end() && *src==sp->source) {
+                    match(src-sb, *sp);
+                }
+            }
+        }
+    }
+}
+
+// The events of projections are generated once, in the first pass, and
+// stored until they are scattered into the buffer in the second.
+void communicator::match_projections_chunk(
+        cell_size_type chunk,
+        const gathered_vector<spike>& global_spikes,
+        event_buffer& queues)
+{
+    auto& events = chunk_projection_events_[chunk];
+    events.clear();
+    if (projections_.empty()) return;
+
+    std::vector<procedural_connection> generated;
+    for (const auto& lp: projections_) {
+        const auto& p = *lp.projection;
+        for (const auto& s: global_spikes.values()) {
+            auto gid = s.source.gid;
+            if (gid<p.source_begin || gid>=p.source_end || s.source.index!=lp.source_lids[gid-p.source_begin]) {
+                continue;
+            }
+
+            for (const auto& run: chunk_runs_[chunk]) {
+                generated.clear();
+                p.connections_from(gid, run.gid, run.gid+run.size, generated);
+                for (const auto& c: generated) {
+                    arb_assert(c.target>=run.gid && c.target<run.gid+run.size);
+                    auto cell = run.index + (c.target-run.gid);
+                    if (!delegated(cell)) {
+                        queues.count(cell);
+                        events.push_back({cell, {lp.target_lids[cell], s.time+c.delay, c.weight}});
+                    }
                 }
+            }
+        }
+    }
+}
+
+void communicator::make_event_queues_chunk(
+        cell_size_type chunk,
+        event_buffer& queues) const
+{
+    const auto& ct = connections_;
+    for (auto& [k, s]: chunk_matches_[chunk]) {
+        for (auto i: util::make_span(ct.offsets[k], ct.offsets[k+1])) {
+            if (!delegated(ct.index_on_domain[i])) {
+                queues.push(ct.index_on_domain[i], ct.make_event(i, *s));
+            }
+        }
+    }
+    for (auto& [cell, ev]: chunk_projection_events_[chunk]) {
+        queues.push(cell, ev);
+    }
+}
+
+// Spikes are taken in time order, and for simultaneous spikes, those of
+// sources before those of targets, so that a pair of simultaneous spikes
+// increases the weight. All the connections and traces affected by a spike
+// are in the chunk of its source index or target cell, and the chunks are
+// updated concurrently.
+void communicator::update_plasticity(const gathered_vector<spike>& global_spikes) {
+    if (!connections_.plastic()) return;
+    PE(communication_plasticity);
+
+    struct plastic_spike {
+        time_type time;
+        bool post;              // a spike of a target cell
+        cell_size_type index;   // the source index in the table, or index on domain
+        cell_size_type chunk;
+    };
+    std::vector<plastic_spike> spikes;
+
+    const auto& ct = connections_;
+    auto by_first = [](const auto& a, const auto& b) { return a.first<b.first; };
+    for (const auto& s: global_spikes.values()) {
+        auto sources = std::equal_range(plastic_sources_.begin(), plastic_sources_.end(),
+                                        std::make_pair(s.source, cell_size_type(0)), by_first);
+        for (auto p = sources.first; p!=sources.second; ++p) {
+            auto k = p->second;
+            auto part = std::upper_bound(ct.source_part.begin(), ct.source_part.end(), k)-ct.source_part.begin()-1;
+            spikes.push_back({s.time, false, k, cell_size_type(part/num_domains_)});
+        }
+        auto target = std::lower_bound(plastic_targets_.begin(), plastic_targets_.end(),
+                                       std::make_pair(s.source.gid, cell_size_type(0)), by_first);
+        if (target!=plastic_targets_.end() && target->first==s.source.gid) {
+            spikes.push_back({s.time, true, target->second, cell_chunk(target->second)});
+        }
+    }
+    util::stable_sort_by(spikes, [](const plastic_spike& p) { return std::make_pair(p.time, p.post); });
+
+    auto& weights = connections_.weights;
+    const auto n_rule = rules_.size();
+
+    // A spike of the source with index k: depression of its connections by
+    // the traces of their targets, then the spike is added to its traces.
+    auto pre = [&](cell_size_type k, time_type t) {
+        for (auto i: util::make_span(ct.offsets[k], ct.offsets[k+1])) {
+            if (!ct.rules[i]) continue;
+            const auto& rule = rules_[ct.rules[i]-1];
+            auto cell = ct.index_on_domain[i];
+            auto y = post_trace_[cell*n_rule+ct.rules[i]-1]*std::exp(-(t-post_time_[cell])/rule.tau_minus);
+            weights.set(i, std::clamp(float(weights[i]-rule.a_minus*y), rule.w_min, rule.w_max));
+        }
+        for (auto r: util::make_span(n_rule)) {
+            auto& x = pre_trace_[k*n_rule+r];
+            x = x*std::exp(-(t-pre_time_[k])/rules_[r].tau_plus) + 1;
+        }
+        pre_time_[k] = t;
+    };
+
+    // A spike of the local cell: potentiation of the connections onto it
+    // by the traces of their sources, then the spike is added to its traces.
+    auto post = [&](cell_size_type cell, time_type t) {
+        for (auto j: util::make_span(plastic_in_divs_[cell], plastic_in_divs_[cell+1])) {
+            auto [i, k] = plastic_in_[j];
+            const auto& rule = rules_[ct.rules[i]-1];
+            auto x = pre_trace_[k*n_rule+ct.rules[i]-1]*std::exp(-(t-pre_time_[k])/rule.tau_plus);
+            weights.set(i, std::clamp(float(weights[i]+rule.a_plus*x), rule.w_min, rule.w_max));
+        }
+        for (auto r: util::make_span(n_rule)) {
+            auto& y = post_trace_[cell*n_rule+r];
+            y = y*std::exp(-(t-post_time_[cell])/rules_[r].tau_minus) + 1;
+        }
+        post_time_[cell] = t;
+    };
+
+    auto update_chunk = [&](cell_size_type chunk) {
+        for (const auto& p: spikes) {
+            if (p.chunk!=chunk) continue;
+            if (p.post) post(p.index, p.time);
+            else pre(p.index, p.time);
+        }
+    };
+    if (num_chunks_>1) {
+        threading::parallel_for::apply(0, num_chunks_, thread_pool_.get(), update_chunk);
+    }
+    else {
+        update_chunk(0);
+    }
+    PL();
+}
 
-                cn = targets.first;
-                ++sp;
+void communicator::reset_plasticity() {
+    for (auto j: util::count_along(plastic_in_)) {
+        connections_.weights.set(plastic_in_[j].first, initial_weights_[j]);
+    }
+    const auto n_rule = rules_.size();
+    const auto never = -std::numeric_limits<time_type>::infinity();
+    pre_trace_.assign(connections_.sources.size()*n_rule, 0.f);
+    pre_time_.assign(connections_.sources.size(), never);
+    post_trace_.assign(num_local_cells_*n_rule, 0.f);
+    post_time_.assign(num_local_cells_, never);
+}
+
+void communicator::serialize(io::serializer& out) const {
+    std::vector<float> weights;
+    weights.reserve(plastic_in_.size());
+    for (auto [i, k]: plastic_in_) weights.push_back(connections_.weights[i]);
+    out.array(weights);
+    out.array(pre_trace_);
+    out.array(pre_time_);
+    out.array(post_trace_);
+    out.array(post_time_);
+}
+
+void communicator::deserialize(io::deserializer& in) {
+    std::vector<float> weights(plastic_in_.size());
+    in.array(weights);
+    for (auto j: util::count_along(plastic_in_)) {
+        connections_.weights.set(plastic_in_[j].first, weights[j]);
+    }
+    in.array(pre_trace_);
+    in.array(pre_time_);
+    in.array(post_trace_);
+    in.array(post_time_);
+}
+
+std::vector<connection> communicator::delegate_group(cell_size_type i) {
+    auto [first, last] = group_queue_range(i);
+    if (connections_.plastic() && plastic_in_divs_[first]!=plastic_in_divs_[last]) {
+        throw arbor_exception("plastic connections onto a cell group that delivers its own spikes");
+    }
+    if (delegated_.empty()) {
+        delegated_.assign(num_local_cells_, 0);
+    }
+    std::fill(delegated_.begin()+first, delegated_.begin()+last, 1);
+
+    std::vector<connection> cons;
+    for (auto k: util::make_span(connections_.sources.size())) {
+        for (auto j: util::make_span(connections_.offsets[k], connections_.offsets[k+1])) {
+            auto cell = connections_.index_on_domain[j];
+            if (cell>=first && cell<last) {
+                auto c = connections_.at(k, j);
+                cons.emplace_back(c.source(), c.destination(), c.weight(), c.delay(), cell-first);
+            }
+        }
+    }
+
+    // The group's cells are a contiguous range of local cells, and so are
+    // covered by the runs of the chunks, clipped to the group.
+    std::vector<procedural_connection> generated;
+    for (const auto& lp: projections_) {
+        const auto& p = *lp.projection;
+        for (const auto& runs: chunk_runs_) {
+            for (const auto& run: runs) {
+                auto b = std::max(run.index, first), e = std::min(run.index+run.size, last);
+                if (b>=e) continue;
+                for (auto src: util::make_span(p.source_begin, p.source_end)) {
+                    generated.clear();
+                    p.connections_from(src, run.gid+(b-run.index), run.gid+(e-run.index), generated);
+                    for (const auto& c: generated) {
+                        auto cell = run.index + (c.target-run.gid);
+                        cons.emplace_back(cell_member_type{src, lp.source_lids[src-p.source_begin]},
+                                          lp.target_lids[cell], c.weight, c.delay, cell-first);
+                    }
+                }
             }
         }
     }
+    return cons;
 }
 
 std::uint64_t communicator::num_spikes() const {
@@ -222,12 +871,40 @@ cell_size_type communicator::num_local_cells() const {
     return num_local_cells_;
 }
 
-const std::vector<connection>& communicator::connections() const {
-    return connections_;
+std::vector<connection> communicator::connections() const {
+    std::vector<connection> cons;
+    cons.reserve(connections_.size());
+    for (auto k: util::make_span(connections_.sources.size())) {
+        for (auto i: util::make_span(connections_.offsets[k], connections_.offsets[k+1])) {
+            cons.push_back(connections_.at(k, i));
+        }
+    }
+    return cons;
+}
+
+std::size_t communicator::bytes() const {
+    std::size_t n = connections_.bytes();
+    n += index_divisions_.capacity()*sizeof(cell_size_type);
+    n += delegated_.capacity();
+    for (const auto& p: projections_) {
+        n += (p.source_lids.capacity()+p.target_lids.capacity())*sizeof(cell_lid_type);
+    }
+    for (const auto& runs: chunk_runs_) {
+        n += runs.capacity()*sizeof(gid_run);
+    }
+    for (const auto& sources: projection_sources_) {
+        n += sources.capacity()*sizeof(cell_gid_type);
+    }
+    // Hash table nodes hold the key, the value and a pointer.
+    n += route_index_.size()*(sizeof(cell_gid_type)+2*sizeof(cell_size_type)+sizeof(void*));
+    n += route_index_.bucket_count()*sizeof(void*);
+    n += route_domains_.capacity()*sizeof(cell_size_type);
+    return n;
 }
 
 void communicator::reset() {
     num_spikes_ = 0;
+    if (connections_.plastic()) reset_plasticity();
 }
 
 } // namespace arb
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <memory>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <arbor/common_types.hpp>
@@ -9,11 +12,18 @@
 
 #include "communication/gathered_vector.hpp"
 #include "connection.hpp"
+#include "distributed_context.hpp"
+#include "event_buffer.hpp"
 #include "execution_context.hpp"
 #include "util/partition.hpp"
 
 namespace arb {
 
+namespace io {
+class serializer;
+class deserializer;
+} // namespace io
+
 // When the communicator is constructed the number of target groups and targets
 // is specified, along with a mapping between local cell id and local
 // target id.
@@ -35,8 +45,18 @@ public:
                           const label_resolution_map& target_resolver,
                           execution_context& ctx);
 
+    /// Construct from the source labels of the local cells only. The labels
+    /// of the sources referenced by local connections are requested from the
+    /// domains of those sources, so that no domain holds the labels of all
+    /// cells. This is a collective operation.
+    explicit communicator(const recipe& rec,
+                          const domain_decomposition& dom_dec,
+                          const cell_labels_and_gids& local_sources,
+                          const label_resolution_map& target_resolver,
+                          execution_context& ctx);
+
     /// The range of event queues that belong to cells in group i.
-    std::pair<cell_size_type, cell_size_type> group_queue_range(cell_size_type i);
+    std::pair<cell_size_type, cell_size_type> group_queue_range(cell_size_type i) const;
 
     /// The minimum delay of all connections in the global network.
     time_type min_delay();
@@ -47,36 +67,211 @@ public:
     /// Returns the full global set of vectors, along with meta data about their partition
     gathered_vector<spike> exchange(std::vector<spike> local_spikes);
 
+    /// Start a non-blocking exchange of spikes.
+    ///
+    /// The local spikes are sorted in place by source, unless they are sorted
+    /// already, and handed to the distributed context; the exchange is
+    /// completed with exchange_end(), which returns the same global spike
+    /// set as exchange(). This allows the
+    /// communication to proceed while cell groups are being updated.
+    spike_gather_request exchange_begin(std::vector<spike>& local_spikes);
+
+    /// Complete an exchange started with exchange_begin().
+    gathered_vector<spike> exchange_end(spike_gather_request& request);
+
+    /// Select the strategy used for spike exchange.
+    ///
+    /// With spike_exchange_kind::point_to_point, each domain is sent only
+    /// the spikes from sources that have connections terminating on it, with
+    /// a personalised all-to-all exchange in place of the global gather. The
+    /// routing tables are built on selection, which is a collective operation.
+    ///
+    /// In point-to-point mode the gathered spikes returned by exchange() are
+    /// restricted to those relevant to the local domain; their partition is
+    /// still by source domain, as required by make_event_queues().
+    void set_exchange_kind(spike_exchange_kind kind);
+
+    spike_exchange_kind exchange_kind() const { return exchange_kind_; }
+
     /// Check each global spike in turn to see it generates local events.
     /// If so, make the events and insert them into the appropriate event list.
     ///
-    /// Takes reference to a vector of event lists as an argument, with one list
-    /// for each local cell group. On completion, the events in each list are
-    /// all events that must be delivered to targets in that cell group as a
-    /// result of the global spike exchange, plus any events that were already
-    /// in the list.
+    /// Takes reference to an event buffer partitioned by local cell. On
+    /// completion, the events of each cell are all events that must be
+    /// delivered to targets on that cell as a result of the global spike
+    /// exchange, plus any events that were already in the buffer. The events
+    /// of a cell are not sorted.
+    ///
+    /// When the execution context provides more than one thread, the local
+    /// cells are split into contiguous chunks with their own connection
+    /// lists, and the events for each chunk are generated in parallel.
+    ///
+    /// Events of procedural projections are generated from the projection
+    /// for each spike of one of its sources, and are not stored.
     void make_event_queues(
             const gathered_vector<spike>& global_spikes,
-            std::vector<pse_vector>& queues);
+            event_buffer& queues);
+
+    /// Update the weights of plastic connections (see stdp_rule) with the
+    /// global spikes of an exchange, so that the events generated by the
+    /// following make_event_queues() carry the new weights.
+    ///
+    /// The spikes of each exchange must be passed once, in the order of the
+    /// exchanges; within an exchange, the spikes are taken in time order.
+    /// The weights are thus updated once per epoch, and the events of all
+    /// spikes of an epoch carry the weights at its end. Traces are decayed
+    /// lazily, so that the cost is proportional to the number of plastic
+    /// connections from the sources and onto the targets of the spikes.
+    void update_plasticity(const gathered_vector<spike>& global_spikes);
+
+    /// Whether any local connection is plastic.
+    bool plastic() const { return connections_.plastic(); }
+
+    /// Write and restore the weights of the plastic connections and the
+    /// spike traces of their sources and targets.
+    void serialize(io::serializer&) const;
+    void deserialize(io::deserializer&);
+
+    /// Hand the generation of events for the cells of group i over to the
+    /// group itself: make_event_queues() no longer generates events for
+    /// them. Returns the connections onto the cells of the group, with
+    /// index_on_domain() the index of the target cell in the group; these
+    /// include the connections of procedural projections onto the group.
+    std::vector<connection> delegate_group(cell_size_type i);
 
     /// Returns the total number of global spikes over the duration of the simulation
     std::uint64_t num_spikes() const;
 
+    /// Restore the number of spikes exchanged, from a checkpoint.
+    void set_num_spikes(std::uint64_t n) { num_spikes_ = n; }
+
     cell_size_type num_local_cells() const;
 
-    const std::vector<connection>& connections() const;
+    /// The number of local connections, not including those of procedural projections.
+    std::size_t num_connections() const { return connections_.size(); }
 
+    /// The local connections, reconstituted from the connection table in
+    /// table order: by target chunk, source domain and then source. The
+    /// connections of procedural projections are not included.
+    std::vector<connection> connections() const;
+
+    /// Approximate size in bytes of the connection and routing tables.
+    std::size_t bytes() const;
+
+    /// Reset the number of spikes, and the weights of plastic connections
+    /// to their initial values.
     void reset();
 
 private:
+    // Exactly one of `source_resolver` and `local_sources` is given.
+    void construct(const recipe& rec,
+                   const domain_decomposition& dom_dec,
+                   const label_resolution_map* source_resolver,
+                   const cell_labels_and_gids* local_sources,
+                   const label_resolution_map& target_resolver,
+                   execution_context& ctx);
+
+    void match_spikes_chunk(
+            cell_size_type chunk,
+            const gathered_vector<spike>& global_spikes,
+            event_buffer& queues);
+
+    void match_projections_chunk(
+            cell_size_type chunk,
+            const gathered_vector<spike>& global_spikes,
+            event_buffer& queues);
+
+    void make_event_queues_chunk(
+            cell_size_type chunk,
+            event_buffer& queues) const;
+
+    // The chunk of a local cell.
+    cell_size_type cell_chunk(cell_size_type index_on_domain) const;
+
+    bool delegated(cell_size_type index_on_domain) const {
+        return !delegated_.empty() && delegated_[index_on_domain];
+    }
+
     cell_size_type num_local_cells_;
     cell_size_type num_local_groups_;
     cell_size_type num_domains_;
-    std::vector<connection> connections_;
-    std::vector<cell_size_type> connection_part_;
+    cell_size_type num_chunks_ = 1;
+    // Connections, indexed by source, with source partitions by target cell
+    // chunk and then by source domain.
+    connection_table connections_;
     std::vector<cell_size_type> index_divisions_;
     util::partition_view_type<std::vector<cell_size_type>> index_part_;
 
+    // Flags the local cells of groups that generate their own events; empty
+    // if there are none.
+    std::vector<char> delegated_;
+
+    // Scratch space for make_event_queues(): for each chunk, the connection
+    // table source index and spike of each matching spike.
+    std::vector<std::vector<std::pair<std::size_t, const spike*>>> chunk_matches_;
+
+    // Procedural projections with targets on local cells, with the lid of
+    // the source on each source cell, indexed by gid less source_begin, and
+    // of the target on each local cell in the target range, by index on
+    // domain.
+    struct local_projection {
+        std::shared_ptr<const procedural_projection> projection;
+        std::vector<cell_lid_type> source_lids;
+        std::vector<cell_lid_type> target_lids;
+    };
+    std::vector<local_projection> projections_;
+
+    // Runs of local cells with consecutive gids, for each chunk.
+    struct gid_run {
+        cell_gid_type gid;
+        cell_size_type index;
+        cell_size_type size;
+    };
+    std::vector<std::vector<gid_run>> chunk_runs_;
+
+    // The source gids of local projections, and the minimum delay of the
+    // projections, by source domain.
+    std::vector<std::vector<cell_gid_type>> projection_sources_;
+    std::vector<time_type> projection_min_delay_;
+
+    // Scratch space for make_event_queues(): for each chunk, the events
+    // generated by projections, with the index on domain of their cell.
+    std::vector<std::vector<std::pair<cell_size_type, spike_event>>> chunk_projection_events_;
+
+    // Point-to-point exchange: for each local source gid with remote or local
+    // connections, the domains to which its spikes are sent, as a partition of
+    // route_domains_ indexed by route_index_.
+    spike_exchange_kind exchange_kind_ = spike_exchange_kind::allgather;
+    std::unordered_map<cell_gid_type, std::pair<cell_size_type, cell_size_type>> route_index_;
+    std::vector<cell_size_type> route_domains_;
+
+    // Point-to-point exchange: the number of local spikes of the exchange in
+    // flight, summed over domains when the exchange is completed.
+    unsigned long long exchange_local_spikes_ = 0;
+
+    // Plasticity of connections: the distinct rules, referred to by the
+    // rules of the connection table; the plastic connections onto each
+    // local cell, as pairs of connection and source index in the table,
+    // partitioned by index on domain, with their initial weights; and the
+    // sources and local cells with plastic connections, sorted by source
+    // and gid respectively.
+    //
+    // Traces are held for each rule: that of spikes from the source of
+    // each source index k of the table, and that of spikes of each local
+    // cell, as decayed to the time of the last spike.
+    std::vector<stdp_rule> rules_;
+    std::vector<std::pair<cell_size_type, cell_size_type>> plastic_in_;
+    std::vector<cell_size_type> plastic_in_divs_;
+    std::vector<float> initial_weights_;
+    std::vector<std::pair<cell_member_type, cell_size_type>> plastic_sources_;
+    std::vector<std::pair<cell_gid_type, cell_size_type>> plastic_targets_;
+    std::vector<float> pre_trace_;
+    std::vector<time_type> pre_time_;
+    std::vector<float> post_trace_;
+    std::vector<time_type> post_time_;
+
+    void reset_plasticity();
+
     distributed_context_handle distributed_;
     task_system_handle thread_pool_;
     std::uint64_t num_spikes_ = 0u;
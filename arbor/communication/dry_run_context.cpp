@@ -7,7 +7,9 @@
 #include "distributed_context.hpp"
 #include "label_resolution.hpp"
 #include "threading/threading.hpp"
+#include "util/partition.hpp"
 #include "util/rangeutil.hpp"
+#include "util/span.hpp"
 
 namespace arb {
 
@@ -43,6 +45,11 @@ struct dry_run_context_impl {
         return gathered_vector<arb::spike>(std::move(gathered_spikes), std::move(partition));
     }
 
+    spike_gather_request
+    gather_spikes_async(const std::vector<arb::spike>& local_spikes) const {
+        return spike_gather_request(gather_spikes(local_spikes));
+    }
+
     gathered_vector<cell_gid_type>
     gather_gids(const std::vector<cell_gid_type>& local_gids) const {
         using count_type = typename gathered_vector<cell_gid_type>::count_type;
@@ -70,6 +77,80 @@ struct dry_run_context_impl {
         return gathered_vector<cell_gid_type>(std::move(gathered_gids), std::move(partition));
     }
 
+    // Every domain contributes the local values.
+    gathered_vector<double>
+    gather_values(const std::vector<double>& local_values) const {
+        using count_type = typename gathered_vector<double>::count_type;
+
+        count_type local_size = local_values.size();
+
+        std::vector<double> gathered_values;
+        gathered_values.reserve(local_size*num_ranks_);
+        std::vector<count_type> partition = {0};
+        for (count_type i = 0; i < num_ranks_; i++) {
+            util::append(gathered_values, local_values);
+            partition.push_back(static_cast<count_type>((i+1)*local_size));
+        }
+
+        return gathered_vector<double>(std::move(gathered_values), std::move(partition));
+    }
+
+    // Every domain contributes the local values.
+    sum_request
+    sum_async(std::vector<double> values, int) const {
+        for (auto& v: values) {
+            v *= num_ranks_;
+        }
+        return sum_request(std::move(values));
+    }
+
+    // The dry run domains are translated copies of the local domain: domain j
+    // sends to domain k what the local domain sends to domain k-j, with gids
+    // shifted by j tiles. The values received from domain j are thus the local
+    // values sent to domain (n-j)%n, translated by `shift(gid, j)`.
+    template <typename T, typename Shift>
+    gathered_vector<T> alltoall(const gathered_vector<T>& local, Shift shift) const {
+        using count_type = typename gathered_vector<T>::count_type;
+
+        std::vector<T> received;
+        std::vector<count_type> partition = {0};
+        received.reserve(local.size());
+
+        for (unsigned j = 0; j < num_ranks_; j++) {
+            auto src = (num_ranks_-j)%num_ranks_;
+            for (auto k = local.partition()[src]; k < local.partition()[src+1]; ++k) {
+                received.push_back(shift(local.values()[k], j, src));
+            }
+            partition.push_back(static_cast<count_type>(received.size()));
+        }
+
+        return gathered_vector<T>(std::move(received), std::move(partition));
+    }
+
+    gathered_vector<arb::spike>
+    alltoall_spikes(const gathered_vector<arb::spike>& spikes) const {
+        // Spikes originate on the sending domain.
+        return alltoall(spikes,
+            [this](arb::spike s, unsigned j, unsigned) {
+                s.source.gid += num_cells_per_tile_*j;
+                return s;
+            });
+    }
+
+    spike_gather_request
+    alltoall_spikes_async(const gathered_vector<arb::spike>& spikes) const {
+        return spike_gather_request(alltoall_spikes(spikes));
+    }
+
+    gathered_vector<cell_gid_type>
+    alltoall_gids(const gathered_vector<cell_gid_type>& gids) const {
+        // Gids sent to a domain belong to that domain, and are received by the local domain.
+        return alltoall(gids,
+            [this](cell_gid_type gid, unsigned, unsigned src) {
+                return gid - num_cells_per_tile_*src;
+            });
+    }
+
     cell_label_range gather_cell_label_range(const cell_label_range& local_ranges) const {
         cell_label_range global_ranges;
         for (unsigned i = 0; i < num_ranks_; i++) {
@@ -84,6 +165,28 @@ struct dry_run_context_impl {
         return cell_labels_and_gids(global_ranges, gids.values());
     }
 
+    cell_labels_and_gids
+    alltoall_cell_labels_and_gids(const cell_labels_and_gids& local,
+                                  const std::vector<cell_size_type>& partition) const {
+        // Labels sent to a domain describe cells of the sending domain.
+        const auto& lr = local.label_range;
+        std::vector<cell_size_type> label_divs;
+        auto label_part = util::make_partition(label_divs, lr.sizes());
+
+        cell_labels_and_gids received;
+        for (unsigned j = 0; j < num_ranks_; j++) {
+            auto src = (num_ranks_-j)%num_ranks_;
+            for (auto c = partition[src]; c < partition[src+1]; ++c) {
+                received.label_range.add_cell();
+                for (auto l: util::make_span(label_part[c])) {
+                    received.label_range.add_label(lr.labels()[l], lr.ranges()[l]);
+                }
+                received.gids.push_back(local.gids[c] + num_cells_per_tile_*j);
+            }
+        }
+        return received;
+    }
+
     template <typename T>
     std::vector<T> gather(T value, int) const {
         return std::vector<T>(num_ranks_, value);
@@ -1,5 +1,13 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
 #include <mpi.h>
 
+#include <arbor/arbexcept.hpp>
+
 #include "communication/mpi.hpp"
 
 namespace arb {
@@ -21,5 +29,136 @@ void barrier(MPI_Comm comm) {
     MPI_OR_THROW(MPI_Barrier, comm);
 }
 
+slot_gather_request::slot_gather_request(std::vector<char> values, slot_state& state, MPI_Comm comm):
+    send_(std::move(values)), state_(&state), slot_(state.bytes), comm_(comm)
+{
+    using header_type = std::uint64_t;
+
+    // The send buffer is extended to a whole slot, after the values that
+    // are sent in the second round if they do not fit.
+    const header_type n = send_.size();
+    const auto fit = std::min<std::size_t>(n, slot_-sizeof(header_type));
+    std::vector<char> slot(slot_);
+    std::memcpy(slot.data(), &n, sizeof(header_type));
+    std::copy(send_.begin(), send_.begin()+fit, slot.begin()+sizeof(header_type));
+    send_.erase(send_.begin(), send_.begin()+fit);
+    send_.insert(send_.end(), slot.begin(), slot.end());
+
+    recv_.resize(slot_*size(comm));
+    MPI_OR_THROW(MPI_Iallgather,
+            send_.data()+send_.size()-slot_, int(slot_), MPI_CHAR,
+            recv_.data(), int(slot_), MPI_CHAR,
+            comm, &request_);
+}
+
+slot_gather_request::slot_gather_request(slot_gather_request&& other):
+    send_(std::move(other.send_)),
+    recv_(std::move(other.recv_)),
+    state_(other.state_),
+    slot_(other.slot_),
+    comm_(other.comm_),
+    request_(other.request_)
+{
+    other.request_ = MPI_REQUEST_NULL;
+}
+
+slot_gather_request::~slot_gather_request() {
+    if (request_!=MPI_REQUEST_NULL) {
+        MPI_Wait(&request_, MPI_STATUS_IGNORE);
+    }
+}
+
+bool slot_gather_request::test() {
+    int flag = 0;
+    MPI_OR_THROW(MPI_Test, &request_, &flag, MPI_STATUS_IGNORE);
+    return flag;
+}
+
+gathered_vector<char> slot_gather_request::wait() {
+    using header_type = std::uint64_t;
+    using count_type = gathered_vector<char>::count_type;
+
+    MPI_OR_THROW(MPI_Wait, &request_, MPI_STATUS_IGNORE);
+
+    const int nranks = size(comm_);
+    const std::size_t capacity = slot_-sizeof(header_type);
+    std::vector<std::size_t> sizes(nranks);
+    std::size_t max_size = 0;
+    for (int i = 0; i<nranks; ++i) {
+        header_type n;
+        std::memcpy(&n, recv_.data()+i*slot_, sizeof(header_type));
+        sizes[i] = n;
+        max_size = std::max<std::size_t>(max_size, n);
+    }
+
+    // Second round: the bytes that did not fit, in the same order.
+    std::vector<char> rest;
+    std::vector<std::size_t> rest_displs(nranks+1, 0);
+    if (max_size>capacity) {
+        PE(communication_exchange_overflow);
+        for (int i = 0; i<nranks; ++i) {
+            rest_displs[i+1] = rest_displs[i]+(sizes[i]>capacity? sizes[i]-capacity: 0);
+        }
+        rest.resize(rest_displs.back());
+        const auto n_rest = send_.size()-slot_;
+#if MPI_VERSION>=4
+        std::vector<MPI_Count> counts(nranks);
+        std::vector<MPI_Aint> displs(nranks);
+        for (int i = 0; i<nranks; ++i) {
+            counts[i] = rest_displs[i+1]-rest_displs[i];
+            displs[i] = rest_displs[i];
+        }
+        MPI_OR_THROW(MPI_Allgatherv_c,
+                send_.data(), MPI_Count(n_rest), MPI_CHAR,
+                rest.data(), counts.data(), displs.data(), MPI_CHAR,
+                comm_);
+#else
+        if (rest.size()>std::size_t(std::numeric_limits<int>::max())) {
+            throw arbor_internal_error("slot_gather_request: gather exceeds 2^31 bytes and MPI-4 large counts are unavailable");
+        }
+        std::vector<int> counts(nranks), displs(nranks);
+        for (int i = 0; i<nranks; ++i) {
+            counts[i] = int(rest_displs[i+1]-rest_displs[i]);
+            displs[i] = int(rest_displs[i]);
+        }
+        MPI_OR_THROW(MPI_Allgatherv,
+                send_.data(), int(n_rest), MPI_CHAR,
+                rest.data(), counts.data(), displs.data(), MPI_CHAR,
+                comm_);
+#endif
+        PL();
+    }
+
+    std::vector<char> values;
+    std::vector<count_type> partition(1, 0);
+    values.reserve(util::sum(sizes, std::size_t(0)));
+    for (int i = 0; i<nranks; ++i) {
+        auto slot = recv_.data()+i*slot_+sizeof(header_type);
+        values.insert(values.end(), slot, slot+std::min(sizes[i], capacity));
+        values.insert(values.end(), rest.data()+rest_displs[i], rest.data()+rest_displs[i+1]);
+        partition.push_back(values.size());
+    }
+
+    // Grow the slot to fit the largest buffer with a quarter to spare, or
+    // halve it after 16 consecutive gathers that used less than a quarter.
+    // The slots of all ranks together are kept within 64 MiB, beyond which
+    // the second round is cheaper than the padding.
+    auto& st = *state_;
+    if (max_size>capacity) {
+        const std::size_t max_slot = std::max<std::size_t>((std::size_t(64)<<20)/nranks/8*8, slot_state{}.bytes);
+        st.bytes = std::min(sizeof(header_type)+(max_size+max_size/4+7)/8*8, std::max(max_slot, slot_));
+        st.underused = 0;
+    }
+    else if (4*(max_size+sizeof(header_type))<slot_ && ++st.underused>=16) {
+        st.bytes = std::max<std::size_t>(slot_/16*8, slot_state{}.bytes);
+        st.underused = 0;
+    }
+    else if (4*(max_size+sizeof(header_type))>=slot_) {
+        st.underused = 0;
+    }
+
+    return gathered_vector<char>(std::move(values), std::move(partition));
+}
+
 } // namespace mpi
 } // namespace arb
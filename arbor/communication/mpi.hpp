@@ -222,6 +222,310 @@ gathered_vector<T> gather_all_with_partition(const std::vector<T>& values, MPI_C
     );
 }
 
+/// Personalised all-to-all exchange of a partitioned vector: the values in
+/// partition i are sent to rank i. Returns the received values, partitioned
+/// by the rank from which they were sent.
+template <typename T>
+gathered_vector<T> alltoall_with_partition(const gathered_vector<T>& values, MPI_Comm comm) {
+    using gathered_type = gathered_vector<T>;
+    using count_type = typename gathered_vector<T>::count_type;
+    using traits = mpi_traits<T>;
+
+    const auto nranks = size(comm);
+    arb_assert(values.partition().size()==std::size_t(nranks)+1);
+
+    std::vector<int> send_counts(nranks), send_displs;
+    for (int i=0; i<nranks; ++i) {
+        send_counts[i] = values.count(i)*traits::count();
+    }
+    util::make_partition(send_displs, send_counts);
+
+    std::vector<int> recv_counts(nranks), recv_displs;
+    MPI_OR_THROW(MPI_Alltoall,
+            send_counts.data(), 1, MPI_INT, // send buffer
+            recv_counts.data(), 1, MPI_INT, // receive buffer
+            comm);
+    util::make_partition(recv_displs, recv_counts);
+
+    std::vector<T> buffer(recv_displs.back()/traits::count());
+    MPI_OR_THROW(MPI_Alltoallv,
+            // const_cast required for MPI implementations that don't use const* in their interfaces
+            const_cast<T*>(values.values().data()), send_counts.data(), send_displs.data(), traits::mpi_type(), // send buffer
+            buffer.data(), recv_counts.data(), recv_displs.data(), traits::mpi_type(), // receive buffer
+            comm);
+
+    for (auto& d : recv_displs) {
+        d /= traits::count();
+    }
+
+    return gathered_type(
+        std::move(buffer),
+        std::vector<count_type>(recv_displs.begin(), recv_displs.end())
+    );
+}
+
+/// Non-blocking variant of gather_all_with_partition.
+///
+/// Per-rank counts are exchanged with a (small) blocking MPI_Allgather on
+/// construction, after which the values are exchanged with MPI_Iallgatherv.
+/// The gather is completed by wait(); test() reports completion without
+/// blocking. Both the send and receive buffers are owned by the object, so
+/// the caller's local values may be released once the constructor returns.
+template <typename T>
+class gather_all_with_partition_request {
+public:
+    using gathered_type = gathered_vector<T>;
+    using count_type = typename gathered_vector<T>::count_type;
+    using traits = mpi_traits<T>;
+
+    gather_all_with_partition_request(std::vector<T> values, MPI_Comm comm):
+        send_(std::move(values))
+    {
+        counts_ = gather_all(int(send_.size()), comm);
+        for (auto& c : counts_) {
+            c *= traits::count();
+        }
+        util::make_partition(displs_, counts_);
+
+        recv_.resize(displs_.back()/traits::count());
+
+        MPI_OR_THROW(MPI_Iallgatherv,
+                send_.data(), counts_[rank(comm)], traits::mpi_type(), // send buffer
+                recv_.data(), counts_.data(), displs_.data(), traits::mpi_type(), // receive buffer
+                comm, &request_);
+    }
+
+    gather_all_with_partition_request(gather_all_with_partition_request&& other):
+        send_(std::move(other.send_)),
+        recv_(std::move(other.recv_)),
+        counts_(std::move(other.counts_)),
+        displs_(std::move(other.displs_)),
+        request_(other.request_)
+    {
+        other.request_ = MPI_REQUEST_NULL;
+    }
+
+    gather_all_with_partition_request(const gather_all_with_partition_request&) = delete;
+    gather_all_with_partition_request& operator=(const gather_all_with_partition_request&) = delete;
+
+    // An abandoned request must still be completed before its buffers are released.
+    ~gather_all_with_partition_request() {
+        if (request_!=MPI_REQUEST_NULL) {
+            MPI_Wait(&request_, MPI_STATUS_IGNORE);
+        }
+    }
+
+    bool test() {
+        int flag = 0;
+        MPI_OR_THROW(MPI_Test, &request_, &flag, MPI_STATUS_IGNORE);
+        return flag;
+    }
+
+    gathered_type wait() {
+        MPI_OR_THROW(MPI_Wait, &request_, MPI_STATUS_IGNORE);
+
+        for (auto& d : displs_) {
+            d /= traits::count();
+        }
+
+        return gathered_type(
+            std::move(recv_),
+            std::vector<count_type>(displs_.begin(), displs_.end())
+        );
+    }
+
+private:
+    std::vector<T> send_;
+    std::vector<T> recv_;
+    std::vector<int> counts_, displs_;
+    MPI_Request request_ = MPI_REQUEST_NULL;
+};
+
+/// Non-blocking variant of alltoall_with_partition.
+///
+/// Per-rank counts are exchanged with a (small) blocking MPI_Alltoall on
+/// construction, after which the values are exchanged with MPI_Ialltoallv.
+/// Buffers are owned by the object, as in gather_all_with_partition_request.
+template <typename T>
+class alltoall_with_partition_request {
+public:
+    using gathered_type = gathered_vector<T>;
+    using count_type = typename gathered_vector<T>::count_type;
+    using traits = mpi_traits<T>;
+
+    alltoall_with_partition_request(gathered_vector<T> values, MPI_Comm comm):
+        send_(std::move(values))
+    {
+        const auto nranks = size(comm);
+        arb_assert(send_.partition().size()==std::size_t(nranks)+1);
+
+        send_counts_.resize(nranks);
+        for (int i=0; i<nranks; ++i) {
+            send_counts_[i] = send_.count(i)*traits::count();
+        }
+        util::make_partition(send_displs_, send_counts_);
+
+        recv_counts_.resize(nranks);
+        MPI_OR_THROW(MPI_Alltoall,
+                send_counts_.data(), 1, MPI_INT, // send buffer
+                recv_counts_.data(), 1, MPI_INT, // receive buffer
+                comm);
+        util::make_partition(recv_displs_, recv_counts_);
+
+        recv_.resize(recv_displs_.back()/traits::count());
+        MPI_OR_THROW(MPI_Ialltoallv,
+                // const_cast required for MPI implementations that don't use const* in their interfaces
+                const_cast<T*>(send_.values().data()), send_counts_.data(), send_displs_.data(), traits::mpi_type(), // send buffer
+                recv_.data(), recv_counts_.data(), recv_displs_.data(), traits::mpi_type(), // receive buffer
+                comm, &request_);
+    }
+
+    alltoall_with_partition_request(alltoall_with_partition_request&& other):
+        send_(std::move(other.send_)),
+        recv_(std::move(other.recv_)),
+        send_counts_(std::move(other.send_counts_)),
+        send_displs_(std::move(other.send_displs_)),
+        recv_counts_(std::move(other.recv_counts_)),
+        recv_displs_(std::move(other.recv_displs_)),
+        request_(other.request_)
+    {
+        other.request_ = MPI_REQUEST_NULL;
+    }
+
+    alltoall_with_partition_request(const alltoall_with_partition_request&) = delete;
+    alltoall_with_partition_request& operator=(const alltoall_with_partition_request&) = delete;
+
+    // An abandoned request must still be completed before its buffers are released.
+    ~alltoall_with_partition_request() {
+        if (request_!=MPI_REQUEST_NULL) {
+            MPI_Wait(&request_, MPI_STATUS_IGNORE);
+        }
+    }
+
+    bool test() {
+        int flag = 0;
+        MPI_OR_THROW(MPI_Test, &request_, &flag, MPI_STATUS_IGNORE);
+        return flag;
+    }
+
+    gathered_type wait() {
+        MPI_OR_THROW(MPI_Wait, &request_, MPI_STATUS_IGNORE);
+
+        for (auto& d : recv_displs_) {
+            d /= traits::count();
+        }
+
+        return gathered_type(
+            std::move(recv_),
+            std::vector<count_type>(recv_displs_.begin(), recv_displs_.end())
+        );
+    }
+
+private:
+    gathered_vector<T> send_;
+    std::vector<T> recv_;
+    std::vector<int> send_counts_, send_displs_;
+    std::vector<int> recv_counts_, recv_displs_;
+    MPI_Request request_ = MPI_REQUEST_NULL;
+};
+
+/// Gather of byte buffers of varying size, usually with a single collective.
+///
+/// Every rank contributes a slot of the same, agreed, size: the size of its
+/// buffer, followed by as much of the buffer as fits. The slots are gathered
+/// with one MPI_Iallgather, without the exchange of sizes that precedes an
+/// MPI_Allgatherv. If any buffer does not fit its slot, every rank learns so
+/// from the sizes in the slots, and the remaining bytes are gathered by a
+/// second, blocking, round in wait(). As all ranks see the same sizes, they
+/// agree on the slot size for the next gather: it grows to fit the largest
+/// buffer with a margin, and shrinks once it has been mostly unused for a
+/// number of gathers. The slot size is held by the caller across gathers.
+class slot_gather_request {
+public:
+    struct slot_state {
+        std::size_t bytes = 1024;   // Slot size, including the size header.
+        unsigned underused = 0;     // Consecutive gathers that used < 1/4 of the slot.
+    };
+
+    slot_gather_request(std::vector<char> values, slot_state& state, MPI_Comm comm);
+
+    slot_gather_request(slot_gather_request&& other);
+    slot_gather_request(const slot_gather_request&) = delete;
+    slot_gather_request& operator=(const slot_gather_request&) = delete;
+
+    // An abandoned request must still be completed before its buffers are released.
+    ~slot_gather_request();
+
+    bool test();
+
+    // Completes the gather, with the second round if needed, and updates
+    // the slot size. Must be called on all ranks.
+    gathered_vector<char> wait();
+
+private:
+    std::vector<char> send_;
+    std::vector<char> recv_;
+    slot_state* state_;
+    std::size_t slot_;
+    MPI_Comm comm_;
+    MPI_Request request_ = MPI_REQUEST_NULL;
+};
+
+/// Non-blocking element-wise reduction of values onto the rank root with
+/// MPI_Ireduce. The result of wait() is defined on the root only; other
+/// ranks receive an empty vector. Buffers are owned by the object, as in
+/// gather_all_with_partition_request.
+template <typename T>
+class reduce_request {
+public:
+    using traits = mpi_traits<T>;
+    static_assert(traits::is_mpi_native_type(),
+                  "can only perform reductions on MPI native types");
+
+    reduce_request(std::vector<T> values, MPI_Op op, int root, MPI_Comm comm):
+        send_(std::move(values)),
+        recv_(rank(comm)==root? send_.size(): 0)
+    {
+        MPI_OR_THROW(MPI_Ireduce,
+                send_.data(), recv_.data(), int(send_.size()), traits::mpi_type(),
+                op, root, comm, &request_);
+    }
+
+    reduce_request(reduce_request&& other):
+        send_(std::move(other.send_)),
+        recv_(std::move(other.recv_)),
+        request_(other.request_)
+    {
+        other.request_ = MPI_REQUEST_NULL;
+    }
+
+    reduce_request(const reduce_request&) = delete;
+    reduce_request& operator=(const reduce_request&) = delete;
+
+    // An abandoned request must still be completed before its buffers are released.
+    ~reduce_request() {
+        if (request_!=MPI_REQUEST_NULL) {
+            MPI_Wait(&request_, MPI_STATUS_IGNORE);
+        }
+    }
+
+    bool test() {
+        int flag = 0;
+        MPI_OR_THROW(MPI_Test, &request_, &flag, MPI_STATUS_IGNORE);
+        return flag;
+    }
+
+    std::vector<T> wait() {
+        MPI_OR_THROW(MPI_Wait, &request_, MPI_STATUS_IGNORE);
+        return std::move(recv_);
+    }
+
+private:
+    std::vector<T> send_;
+    std::vector<T> recv_;
+    MPI_Request request_ = MPI_REQUEST_NULL;
+};
+
 template <typename T>
 T reduce(T value, MPI_Op op, int root, MPI_Comm comm) {
     using traits = mpi_traits<T>;
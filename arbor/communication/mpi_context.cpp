@@ -5,6 +5,9 @@
 #error "build only if MPI is enabled"
 #endif
 
+#include <cstdint>
+#include <cstring>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -13,25 +16,225 @@
 #include <arbor/spike.hpp>
 
 #include "communication/mpi.hpp"
+#include "communication/spike_codec.hpp"
 #include "distributed_context.hpp"
 #include "label_resolution.hpp"
+#include "util/span.hpp"
 
 namespace arb {
 
+// Adapt an in-flight MPI spike gather to the spike_gather_request interface.
+// Spikes are exchanged in their compact encoding, see spike_codec.hpp, in
+// slots of a size agreed from the previous gathers.
+struct mpi_spike_gather_request: spike_gather_request::interface {
+    mpi::slot_gather_request request;
+
+    mpi_spike_gather_request(const std::vector<arb::spike>& local_spikes, mpi::slot_gather_request::slot_state& slot, MPI_Comm comm):
+        request(encode_spikes(local_spikes), slot, comm)
+    {}
+
+    bool test() override { return request.test(); }
+    gathered_vector<arb::spike> wait() override { return decode_spikes(request.wait()); }
+};
+
+// Adapt an in-flight MPI all-to-all exchange of spikes, in their compact
+// encoding, to the spike_gather_request interface.
+struct mpi_spike_alltoall_request: spike_gather_request::interface {
+    mpi::alltoall_with_partition_request<char> request;
+
+    mpi_spike_alltoall_request(const gathered_vector<arb::spike>& spikes, MPI_Comm comm):
+        request(encode_spikes(spikes), comm)
+    {}
+
+    bool test() override { return request.test(); }
+    gathered_vector<arb::spike> wait() override { return decode_spikes(request.wait()); }
+};
+
+// Adapt an in-flight MPI reduction to the sum_request interface.
+struct mpi_sum_request: sum_request::interface {
+    mpi::reduce_request<double> request;
+
+    mpi_sum_request(std::vector<double> values, int root, MPI_Comm comm):
+        request(std::move(values), MPI_SUM, root, comm)
+    {}
+
+    bool test() override { return request.test(); }
+    std::vector<double> wait() override { return request.wait(); }
+};
+
+// Gather of spikes through one leader rank per node. The encoded spikes of
+// the ranks of a node are gathered onto its leader; the leaders exchange
+// them; and each leader writes the global spikes, ordered by rank, into a
+// window in the shared memory of its node, from which all of its ranks
+// decode them. Only the leaders communicate between nodes, and the global
+// spikes are held in encoded form once per node.
+class node_spike_gather {
+public:
+    explicit node_spike_gather(MPI_Comm comm): size_(mpi::size(comm)) {
+        const int rank = mpi::rank(comm);
+        MPI_OR_THROW(MPI_Comm_split_type, comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm_);
+        node_rank_ = mpi::rank(node_comm_);
+        MPI_OR_THROW(MPI_Comm_split, comm, node_rank_==0? 0: MPI_UNDEFINED, rank, &leader_comm_);
+
+        // The global ranks of the ranks of the node, on the leader.
+        members_.resize(node_rank_==0? mpi::size(node_comm_): 0);
+        MPI_OR_THROW(MPI_Gather, &rank, 1, MPI_INT, members_.data(), 1, MPI_INT, 0, node_comm_);
+
+        reserve(64*1024);
+    }
+
+    node_spike_gather(const node_spike_gather&) = delete;
+    node_spike_gather& operator=(const node_spike_gather&) = delete;
+
+    ~node_spike_gather() {
+        int finalized = 0;
+        MPI_Finalized(&finalized);
+        if (finalized) return;
+        MPI_Win_unlock_all(win_);
+        MPI_Win_free(&win_);
+        if (leader_comm_!=MPI_COMM_NULL) MPI_Comm_free(&leader_comm_);
+        MPI_Comm_free(&node_comm_);
+    }
+
+    gathered_vector<arb::spike> gather(const std::vector<arb::spike>& local_spikes) {
+        using header_type = std::uint64_t;
+        using count_type = gathered_vector<arb::spike>::count_type;
+        const bool leader = node_rank_==0;
+
+        // Gather the encoded spikes of the node onto the leader.
+        auto bytes = encode_spikes(local_spikes);
+        int n = bytes.size();
+        std::vector<int> counts(leader? members_.size(): 0), displs;
+        MPI_OR_THROW(MPI_Gather, &n, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, node_comm_);
+        util::make_partition(displs, counts);
+        std::vector<char> node_bytes(leader? displs.back(): 0);
+        MPI_OR_THROW(MPI_Gatherv, bytes.data(), n, MPI_CHAR,
+                     node_bytes.data(), counts.data(), displs.data(), MPI_CHAR, 0, node_comm_);
+
+        // Exchange between leaders blocks of the global rank and byte count
+        // of each rank of the node, followed by the bytes, and lay out the
+        // global byte counts by rank, followed by the bytes of each rank.
+        std::vector<char> layout;
+        header_type total = 0;
+        if (leader) {
+            std::vector<header_type> head = {members_.size()};
+            for (auto i: util::count_along(members_)) {
+                head.push_back(members_[i]);
+                head.push_back(counts[i]);
+            }
+            std::vector<char> block(head.size()*sizeof(header_type));
+            std::memcpy(block.data(), head.data(), block.size());
+            block.insert(block.end(), node_bytes.begin(), node_bytes.end());
+            auto blocks = mpi::slot_gather_request(std::move(block), slot_, leader_comm_).wait();
+
+            std::vector<header_type> sizes(size_);
+            std::vector<const char*> sources(size_);
+            auto p = blocks.values().data();
+            for (auto b: util::make_span(blocks.partition().size()-1)) {
+                auto q = p+blocks.partition()[b];
+                header_type m;
+                std::memcpy(&m, q, sizeof(header_type));
+                auto bytes = q+(1+2*m)*sizeof(header_type);
+                for (header_type i = 0; i<m; ++i) {
+                    header_type r[2];
+                    std::memcpy(r, q+(1+2*i)*sizeof(header_type), sizeof(r));
+                    sizes[r[0]] = r[1];
+                    sources[r[0]] = bytes;
+                    bytes += r[1];
+                }
+            }
+            layout.resize(size_*sizeof(header_type));
+            std::memcpy(layout.data(), sizes.data(), layout.size());
+            for (auto r: util::make_span(size_)) {
+                layout.insert(layout.end(), sources[r], sources[r]+sizes[r]);
+            }
+            total = layout.size();
+        }
+
+        // Publish the layout in the window of the node.
+        MPI_OR_THROW(MPI_Bcast, &total, 1, MPI_UINT64_T, 0, node_comm_);
+        if (total>capacity_) reserve(total+total/4);
+        if (leader) std::memcpy(base_, layout.data(), total);
+        MPI_OR_THROW(MPI_Win_sync, win_);
+        MPI_OR_THROW(MPI_Barrier, node_comm_);
+        MPI_OR_THROW(MPI_Win_sync, win_);
+
+        // The window is only written again once all ranks of the node have
+        // entered the next gather, after they have decoded this one.
+        std::vector<header_type> sizes(size_);
+        std::memcpy(sizes.data(), base_, size_*sizeof(header_type));
+        std::vector<arb::spike> spikes;
+        std::vector<count_type> partition = {0};
+        auto p = base_+size_*sizeof(header_type);
+        for (auto r: util::make_span(size_)) {
+            decode_spikes(p, p+sizes[r], spikes);
+            p += sizes[r];
+            partition.push_back(spikes.size());
+        }
+        return gathered_vector<arb::spike>(std::move(spikes), std::move(partition));
+    }
+
+private:
+    int size_;
+    int node_rank_;
+    MPI_Comm node_comm_ = MPI_COMM_NULL;
+    MPI_Comm leader_comm_ = MPI_COMM_NULL;
+    std::vector<int> members_;
+    mpi::slot_gather_request::slot_state slot_;
+
+    // The shared window, allocated on the leader, and its size.
+    MPI_Win win_ = MPI_WIN_NULL;
+    char* base_ = nullptr;
+    std::size_t capacity_ = 0;
+
+    // Collective over the ranks of the node.
+    void reserve(std::size_t bytes) {
+        if (win_!=MPI_WIN_NULL) {
+            MPI_OR_THROW(MPI_Win_unlock_all, win_);
+            MPI_OR_THROW(MPI_Win_free, &win_);
+        }
+        char* local = nullptr;
+        MPI_OR_THROW(MPI_Win_allocate_shared, MPI_Aint(node_rank_==0? bytes: 0), 1, MPI_INFO_NULL,
+                     node_comm_, &local, &win_);
+        MPI_Aint size;
+        int disp;
+        MPI_OR_THROW(MPI_Win_shared_query, win_, 0, &size, &disp, &base_);
+        MPI_OR_THROW(MPI_Win_lock_all, MPI_MODE_NOCHECK, win_);
+        capacity_ = bytes;
+    }
+};
+
 // Throws arb::mpi::mpi_error if MPI calls fail.
 struct mpi_context_impl {
     int size_;
     int rank_;
     MPI_Comm comm_;
 
-    explicit mpi_context_impl(MPI_Comm comm): comm_(comm) {
+    // Slot size of the spike gathers, which is the same on all ranks.
+    mutable mpi::slot_gather_request::slot_state spike_slot_;
+
+    // Set for spike gathers through the node leaders.
+    std::shared_ptr<node_spike_gather> node_gather_;
+
+    mpi_context_impl(MPI_Comm comm, bool node_shared_spikes): comm_(comm) {
         size_ = mpi::size(comm_);
         rank_ = mpi::rank(comm_);
+        if (node_shared_spikes) {
+            node_gather_ = std::make_shared<node_spike_gather>(comm_);
+        }
     }
 
     gathered_vector<arb::spike>
     gather_spikes(const std::vector<arb::spike>& local_spikes) const {
-        return mpi::gather_all_with_partition(local_spikes, comm_);
+        if (node_gather_) return node_gather_->gather(local_spikes);
+        return decode_spikes(mpi::slot_gather_request(encode_spikes(local_spikes), spike_slot_, comm_).wait());
+    }
+
+    // The gather through the node leaders completes eagerly.
+    spike_gather_request
+    gather_spikes_async(const std::vector<arb::spike>& local_spikes) const {
+        if (node_gather_) return spike_gather_request(node_gather_->gather(local_spikes));
+        return spike_gather_request(std::make_unique<mpi_spike_gather_request>(local_spikes, spike_slot_, comm_));
     }
 
     gathered_vector<cell_gid_type>
@@ -39,6 +242,31 @@ struct mpi_context_impl {
         return mpi::gather_all_with_partition(local_gids, comm_);
     }
 
+    gathered_vector<double>
+    gather_values(const std::vector<double>& local_values) const {
+        return mpi::gather_all_with_partition(local_values, comm_);
+    }
+
+    sum_request
+    sum_async(std::vector<double> values, int root) const {
+        return sum_request(std::make_unique<mpi_sum_request>(std::move(values), root, comm_));
+    }
+
+    gathered_vector<arb::spike>
+    alltoall_spikes(const gathered_vector<arb::spike>& spikes) const {
+        return decode_spikes(mpi::alltoall_with_partition(encode_spikes(spikes), comm_));
+    }
+
+    spike_gather_request
+    alltoall_spikes_async(const gathered_vector<arb::spike>& spikes) const {
+        return spike_gather_request(std::make_unique<mpi_spike_alltoall_request>(spikes, comm_));
+    }
+
+    gathered_vector<cell_gid_type>
+    alltoall_gids(const gathered_vector<cell_gid_type>& gids) const {
+        return mpi::alltoall_with_partition(gids, comm_);
+    }
+
     cell_label_range gather_cell_label_range(const cell_label_range& local_ranges) const {
         std::vector<cell_size_type> sizes;
         std::vector<cell_tag_type> labels;
@@ -56,6 +284,48 @@ struct mpi_context_impl {
         return cell_labels_and_gids(global_ranges, global_gids);
     }
 
+    cell_labels_and_gids
+    alltoall_cell_labels_and_gids(const cell_labels_and_gids& local,
+                                  const std::vector<cell_size_type>& partition) const {
+        using count_type = gathered_vector<cell_gid_type>::count_type;
+        const auto& lr = local.label_range;
+
+        // Labels are sent as their lengths and concatenated characters, with
+        // partitions by destination derived from the partition of the cells.
+        std::vector<count_type> cell_part(partition.begin(), partition.end());
+        std::vector<count_type> label_part = {0}, char_part = {0};
+        std::vector<cell_size_type> lengths;
+        std::vector<char> chars;
+        lengths.reserve(lr.labels().size());
+        std::size_t label = 0;
+        for (auto d: util::make_span(size_)) {
+            for (auto c: util::make_span(partition[d], partition[d+1])) {
+                for (auto end = label + lr.sizes()[c]; label<end; ++label) {
+                    const auto& l = lr.labels()[label];
+                    lengths.push_back(l.size());
+                    chars.insert(chars.end(), l.begin(), l.end());
+                }
+            }
+            label_part.push_back(label);
+            char_part.push_back(chars.size());
+        }
+
+        auto gids    = mpi::alltoall_with_partition(gathered_vector<cell_gid_type>(std::vector<cell_gid_type>(local.gids), std::vector<count_type>(cell_part)), comm_);
+        auto sizes   = mpi::alltoall_with_partition(gathered_vector<cell_size_type>(std::vector<cell_size_type>(lr.sizes()), std::move(cell_part)), comm_);
+        auto ranges  = mpi::alltoall_with_partition(gathered_vector<lid_range>(std::vector<lid_range>(lr.ranges()), std::vector<count_type>(label_part)), comm_);
+        auto lens    = mpi::alltoall_with_partition(gathered_vector<cell_size_type>(std::move(lengths), std::move(label_part)), comm_);
+        auto text    = mpi::alltoall_with_partition(gathered_vector<char>(std::move(chars), std::move(char_part)), comm_);
+
+        std::vector<cell_tag_type> labels;
+        labels.reserve(lens.size());
+        const char* p = text.values().data();
+        for (auto n: lens.values()) {
+            labels.emplace_back(p, n);
+            p += n;
+        }
+        return cell_labels_and_gids(cell_label_range(sizes.values(), std::move(labels), ranges.values()), gids.values());
+    }
+
     template <typename T>
     std::vector<T> gather(T value, int root) const {
         return mpi::gather(value, root, comm_);
@@ -86,8 +356,8 @@ struct mpi_context_impl {
 };
 
 template <>
-std::shared_ptr<distributed_context> make_mpi_context(MPI_Comm comm) {
-    return std::make_shared<distributed_context>(mpi_context_impl(comm));
+std::shared_ptr<distributed_context> make_mpi_context(MPI_Comm comm, bool node_shared_spikes) {
+    return std::make_shared<distributed_context>(mpi_context_impl(comm, node_shared_spikes));
 }
 
 } // namespace arb
@@ -0,0 +1,99 @@
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/spike.hpp>
+
+#include "communication/gathered_vector.hpp"
+#include "communication/spike_codec.hpp"
+
+namespace arb {
+
+namespace {
+void put_varint(std::uint64_t v, std::vector<char>& out) {
+    while (v>=0x80) {
+        out.push_back(char(v|0x80));
+        v >>= 7;
+    }
+    out.push_back(char(v));
+}
+
+std::uint64_t get_varint(const char*& p, const char* last) {
+    std::uint64_t v = 0;
+    for (unsigned shift = 0; shift<64; shift += 7) {
+        if (p==last) break;
+        auto b = (unsigned char)*p++;
+        v |= std::uint64_t(b&0x7f)<<shift;
+        if (!(b&0x80)) return v;
+    }
+    throw arbor_internal_error("decode_spikes: truncated or malformed varint");
+}
+} // anonymous namespace
+
+void encode_spikes(const spike* first, const spike* last, std::vector<char>& out) {
+    out.reserve(out.size()+10*(last-first));
+    std::int64_t prev = 0;
+    for (auto s = first; s!=last; ++s) {
+        std::int64_t delta = std::int64_t(s->source.gid)-prev;
+        prev = s->source.gid;
+        std::uint64_t zigzag = (std::uint64_t(delta)<<1)^std::uint64_t(delta>>63);
+        put_varint(zigzag<<1 | (s->source.index!=0), out);
+        if (s->source.index) put_varint(s->source.index, out);
+
+        char time[sizeof(time_type)];
+        std::memcpy(time, &s->time, sizeof(time_type));
+        out.insert(out.end(), time, time+sizeof(time_type));
+    }
+}
+
+void decode_spikes(const char* first, const char* last, std::vector<spike>& out) {
+    out.reserve(out.size()+(last-first)/(1+sizeof(time_type)));
+    std::int64_t prev = 0;
+    auto p = first;
+    while (p!=last) {
+        auto head = get_varint(p, last);
+        auto zigzag = head>>1;
+        prev += std::int64_t(zigzag>>1)^-std::int64_t(zigzag&1);
+
+        spike s;
+        s.source.gid = cell_gid_type(prev);
+        s.source.index = head&1? cell_lid_type(get_varint(p, last)): 0;
+        if (last-p<std::ptrdiff_t(sizeof(time_type))) {
+            throw arbor_internal_error("decode_spikes: truncated spike time");
+        }
+        std::memcpy(&s.time, p, sizeof(time_type));
+        p += sizeof(time_type);
+        out.push_back(s);
+    }
+}
+
+gathered_vector<char> encode_spikes(const gathered_vector<spike>& spikes) {
+    using count_type = gathered_vector<char>::count_type;
+    const auto& part = spikes.partition();
+    const auto* data = spikes.values().data();
+
+    std::vector<char> bytes;
+    std::vector<count_type> divs = {0};
+    for (std::size_t i = 0; i+1<part.size(); ++i) {
+        encode_spikes(data+part[i], data+part[i+1], bytes);
+        divs.push_back(bytes.size());
+    }
+    return gathered_vector<char>(std::move(bytes), std::move(divs));
+}
+
+gathered_vector<spike> decode_spikes(const gathered_vector<char>& bytes) {
+    using count_type = gathered_vector<spike>::count_type;
+    const auto& part = bytes.partition();
+    const auto* data = bytes.values().data();
+
+    std::vector<spike> spikes;
+    std::vector<count_type> divs = {0};
+    for (std::size_t i = 0; i+1<part.size(); ++i) {
+        decode_spikes(data+part[i], data+part[i+1], spikes);
+        divs.push_back(spikes.size());
+    }
+    return gathered_vector<spike>(std::move(spikes), std::move(divs));
+}
+
+} // namespace arb
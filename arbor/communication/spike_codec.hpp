@@ -0,0 +1,41 @@
+#pragma once
+
+// Compact encoding of spikes for their exchange between domains.
+//
+// Each spike is encoded as a varint of the zig-zag coded difference of its
+// source gid from that of the previous spike, shifted left by one bit, with
+// the low bit set if the source index is not zero; then the source index as
+// a varint if it is not zero; then the eight bytes of the spike time. Spikes
+// sorted by source, as exchanged by the communicator, take nine or ten bytes
+// for the sixteen of an arb::spike. Times are not quantised: the encoding is
+// lossless, and the exchanged spikes are identical to those sent.
+//
+// Encoded spikes are only decoded on domains of the same byte order.
+
+#include <vector>
+
+#include <arbor/spike.hpp>
+
+#include "communication/gathered_vector.hpp"
+
+namespace arb {
+
+// Append the encoding of the spikes in [first, last) to `out`.
+void encode_spikes(const spike* first, const spike* last, std::vector<char>& out);
+
+// Append the spikes encoded in the bytes [first, last) to `out`.
+void decode_spikes(const char* first, const char* last, std::vector<spike>& out);
+
+inline std::vector<char> encode_spikes(const std::vector<spike>& spikes) {
+    std::vector<char> out;
+    encode_spikes(spikes.data(), spikes.data()+spikes.size(), out);
+    return out;
+}
+
+// Encode each partition separately, partitioning the bytes alike.
+gathered_vector<char> encode_spikes(const gathered_vector<spike>& spikes);
+
+// Decode each partition separately, partitioning the spikes alike.
+gathered_vector<spike> decode_spikes(const gathered_vector<char>& bytes);
+
+} // namespace arb
@@ -1,9 +1,16 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <vector>
 
+#include <arbor/assert.hpp>
 #include <arbor/common_types.hpp>
 #include <arbor/spike.hpp>
+#include <arbor/spike_event.hpp>
 
 namespace arb {
 
@@ -14,12 +21,14 @@ public:
                cell_lid_type dest,
                float w,
                float d,
-               cell_gid_type didx=cell_gid_type(-1)):
+               cell_gid_type didx=cell_gid_type(-1),
+               std::uint8_t rule=0):
         source_(src),
         destination_(dest),
         weight_(w),
         delay_(d),
-        index_on_domain_(didx)
+        index_on_domain_(didx),
+        rule_(rule)
     {}
 
     float weight() const { return weight_; }
@@ -29,7 +38,11 @@ public:
     cell_lid_type destination() const { return destination_; }
     cell_size_type index_on_domain() const { return index_on_domain_; }
 
-    spike_event make_event(const spike& s) {
+    // One more than the index of the plasticity rule of the connection in the
+    // communicator; zero if the weight is fixed.
+    std::uint8_t rule() const { return rule_; }
+
+    spike_event make_event(const spike& s) const {
         return {destination_, s.time + delay_, weight_};
     }
 
@@ -39,6 +52,148 @@ private:
     float weight_;
     float delay_;
     cell_size_type index_on_domain_;
+    std::uint8_t rule_;
+};
+
+// A sequence of float values, one per connection.
+//
+// Networks built from a few classes of connection have few distinct weights
+// and delays. Once all values have been added, compress() replaces them by
+// 16 bit indices into a table of the distinct values, if there are no more
+// than 2^16 of them; the values themselves are unchanged.
+class connection_values {
+public:
+    void push_back(float v) {
+        arb_assert(!compressed_);
+        values_.push_back(v);
+    }
+
+    float operator[](std::size_t i) const {
+        return compressed_? values_[index_[i]]: values_[i];
+    }
+
+    std::size_t size() const { return compressed_? index_.size(): values_.size(); }
+
+    bool compressed() const { return compressed_; }
+
+    // Change the value at i; only possible if not compressed.
+    void set(std::size_t i, float v) {
+        arb_assert(!compressed_);
+        values_[i] = v;
+    }
+
+    // Size of the stored values and indices in bytes.
+    std::size_t bytes() const {
+        return values_.capacity()*sizeof(float) + index_.capacity()*sizeof(std::uint16_t);
+    }
+
+    void compress() {
+        using index_type = std::uint16_t;
+        constexpr std::size_t max_distinct = std::size_t(std::numeric_limits<index_type>::max())+1;
+
+        if (compressed_) return;
+
+        // Values are identified by their bit pattern.
+        std::unordered_map<std::uint32_t, index_type> ids;
+        std::vector<float> distinct;
+        std::vector<index_type> index;
+        index.reserve(values_.size());
+        for (auto v: values_) {
+            std::uint32_t key;
+            std::memcpy(&key, &v, sizeof key);
+            auto it = ids.find(key);
+            if (it==ids.end()) {
+                if (distinct.size()==max_distinct) return;
+                it = ids.emplace(key, index_type(distinct.size())).first;
+                distinct.push_back(v);
+            }
+            index.push_back(it->second);
+        }
+
+        values_ = std::move(distinct);
+        index_ = std::move(index);
+        compressed_ = true;
+    }
+
+private:
+    std::vector<float> values_;
+    std::vector<std::uint16_t> index_;
+    bool compressed_ = false;
+};
+
+// Connections stored in compressed sparse row form, indexed by source.
+//
+// The distinct sources are held in `sources`, with the connections from
+// sources[k] occupying the index range [offsets[k], offsets[k+1]) of the
+// per-connection arrays. Sources are further grouped into partitions
+// (described by `source_part`), within which they are sorted.
+struct connection_table {
+    std::vector<cell_member_type> sources;
+    std::vector<cell_size_type> source_part = {0};
+    std::vector<cell_size_type> offsets = {0};
+
+    std::vector<cell_lid_type> destinations;
+    connection_values weights;
+    connection_values delays;
+    std::vector<cell_size_type> index_on_domain;
+
+    // Plasticity rule of each connection, as connection::rule(); empty if
+    // no connection is plastic.
+    std::vector<std::uint8_t> rules;
+
+    // Total number of connections.
+    std::size_t size() const { return destinations.size(); }
+
+    // Size of the table in bytes.
+    std::size_t bytes() const {
+        return sources.capacity()*sizeof(cell_member_type)
+             + (source_part.capacity()+offsets.capacity()+index_on_domain.capacity())*sizeof(cell_size_type)
+             + destinations.capacity()*sizeof(cell_lid_type)
+             + weights.bytes() + delays.bytes() + rules.capacity();
+    }
+
+    bool plastic() const { return !rules.empty(); }
+
+    // Store weights and delays compactly; no further connections can be added.
+    // Weights that can change are kept as they are.
+    void compress() {
+        if (std::all_of(rules.begin(), rules.end(), [](auto r) { return r==0; })) {
+            rules.clear();
+            rules.shrink_to_fit();
+            weights.compress();
+        }
+        delays.compress();
+    }
+
+    // Number of source partitions.
+    std::size_t num_partitions() const { return source_part.size()-1; }
+
+    // Append the connections in [b, e), which must be sorted by source, as a new partition.
+    template <typename Iter>
+    void append_partition(Iter b, Iter e) {
+        for (; b!=e; ++b) {
+            if (sources.size()==source_part.back() || sources.back()!=b->source()) {
+                sources.push_back(b->source());
+                offsets.push_back(offsets.back());
+            }
+            destinations.push_back(b->destination());
+            weights.push_back(b->weight());
+            delays.push_back(b->delay());
+            index_on_domain.push_back(b->index_on_domain());
+            rules.push_back(b->rule());
+            ++offsets.back();
+        }
+        source_part.push_back(sources.size());
+    }
+
+    spike_event make_event(std::size_t i, const spike& s) const {
+        return {destinations[i], s.time + delays[i], weights[i]};
+    }
+
+    // Reconstitute the connection at index i, with source index k.
+    connection at(std::size_t k, std::size_t i) const {
+        return {sources[k], destinations[i], weights[i], delays[i], index_on_domain[i], plastic()? rules[i]: std::uint8_t(0)};
+    }
 };
 
 // connections are sorted by source id
@@ -0,0 +1,146 @@
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/common_types.hpp>
+#include <arbor/custom_cell_group.hpp>
+#include <arbor/recipe.hpp>
+
+#include "cell_group.hpp"
+#include "cell_group_factory.hpp"
+#include "epoch.hpp"
+#include "label_resolution.hpp"
+#include "util/span.hpp"
+#include "util/strprintf.hpp"
+
+namespace arb {
+
+namespace {
+
+// A custom cell group, presented to the simulation as a cell group.
+class custom_cell_group_adapter: public cell_group {
+public:
+    custom_cell_group_adapter(
+        cell_kind kind,
+        const custom_cell_group_factory& factory,
+        const std::vector<cell_gid_type>& gids,
+        const recipe& rec,
+        cell_label_range& cg_sources,
+        cell_label_range& cg_targets):
+        kind_(kind), impl_(factory(gids, rec))
+    {
+        if (!impl_) {
+            throw arbor_exception(util::pprintf("no cell group built for {}", kind));
+        }
+
+        for (auto i: util::count_along(gids)) {
+            cg_sources.add_cell();
+            cg_targets.add_cell();
+            for (auto& [tag, range]: impl_->source_labels(i)) {
+                cg_sources.add_label(tag, range);
+            }
+            for (auto& [tag, range]: impl_->target_labels(i)) {
+                cg_targets.add_label(tag, range);
+            }
+        }
+    }
+
+    cell_kind get_cell_kind() const override { return kind_; }
+
+    void reset() override { impl_->reset(); }
+
+    // Events are delivered to the group at their times.
+    void set_binning_policy(binning_kind, time_type) override {}
+
+    void advance(epoch ep, time_type dt, const event_lane_subrange& event_lanes) override {
+        custom_event_lanes events;
+        if (!event_lanes.empty()) {
+            events.lanes = &*event_lanes.begin();
+            events.n = event_lanes.size();
+        }
+        impl_->advance(ep.t0, ep.t1, dt, events);
+    }
+
+    const std::vector<spike>& spikes() const override { return impl_->spikes(); }
+    void clear_spikes() override { impl_->clear_spikes(); }
+
+    void serialize(io::serializer& out) const override {
+        out.string(impl_->serialize());
+    }
+
+    void deserialize(io::deserializer& in, time_type t) override {
+        impl_->deserialize(in.string(), t);
+    }
+
+    void add_sampler(sampler_association_handle h, cell_member_predicate probeset_ids, schedule sched, sampler_function fn, sampling_policy policy) override {
+        impl_->add_sampler(h, std::move(probeset_ids), std::move(sched), std::move(fn), policy);
+    }
+
+    void remove_sampler(sampler_association_handle h) override { impl_->remove_sampler(h); }
+    void remove_all_samplers() override { impl_->remove_all_samplers(); }
+
+    std::vector<probe_metadata> get_probe_metadata(cell_member_type probe_id) const override {
+        return impl_->get_probe_metadata(probe_id);
+    }
+
+private:
+    cell_kind kind_;
+    custom_cell_group_ptr impl_;
+};
+
+// Registered factories, by kind and back end.
+struct custom_cell_group_registry {
+    std::mutex mutex;
+    std::map<std::pair<cell_kind, backend_kind>, custom_cell_group_factory> factories;
+};
+
+custom_cell_group_registry& registry() {
+    static custom_cell_group_registry r;
+    return r;
+}
+
+} // anonymous namespace
+
+void register_cell_group(cell_kind kind, backend_kind backend, custom_cell_group_factory factory) {
+    if (kind<cell_kind::custom) {
+        throw arbor_exception(util::pprintf("cell groups can not be registered for built-in {}", kind));
+    }
+
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if (factory) {
+        r.factories[{kind, backend}] = std::move(factory);
+    }
+    else {
+        r.factories.erase({kind, backend});
+    }
+}
+
+void unregister_cell_group(cell_kind kind) {
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (auto backend: {backend_kind::multicore, backend_kind::gpu}) {
+        r.factories.erase({kind, backend});
+    }
+}
+
+cell_group_factory custom_cell_group_implementation(cell_kind ck, backend_kind bk) {
+    using gid_vector = std::vector<cell_gid_type>;
+
+    custom_cell_group_factory factory;
+    {
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        auto it = r.factories.find({ck, bk});
+        if (it==r.factories.end()) return {};
+        factory = it->second;
+    }
+
+    return [ck, factory](const gid_vector& gids, const recipe& rec, cell_label_range& cg_sources, cell_label_range& cg_targets) {
+        return cell_group_ptr(new custom_cell_group_adapter(ck, factory, gids, rec, cg_sources, cg_targets));
+    };
+}
+
+} // namespace arb
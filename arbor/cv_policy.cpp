@@ -1,9 +1,13 @@
+#include <algorithm>
+#include <cmath>
 #include <utility>
 #include <ostream>
 #include <vector>
 
 #include <arbor/cable_cell.hpp>
 #include <arbor/cv_policy.hpp>
+#include <arbor/math.hpp>
+#include <arbor/morph/mcable_map.hpp>
 #include <arbor/morph/locset.hpp>
 #include <arbor/morph/region.hpp>
 
@@ -85,7 +89,7 @@ locset cv_policy_explicit::cv_boundary_points(const cable_cell& cell) const {
                     return sum(std::move(l), ls::restrict(locs_, comp));
                 },
                 ls::boundary(domain_),
-                components(cell.morphology(), thingify(domain_, cell.provider()))));
+                components(cell.morphology(), cell.provider().evaluate(domain_))));
 }
 
 cv_policy_base_ptr cv_policy_explicit::clone() const {
@@ -113,7 +117,7 @@ locset cv_policy_max_extent::cv_boundary_points(const cable_cell& cell) const {
 
     std::vector<mlocation> points;
     double oomax_extent = 1./max_extent_;
-    auto comps = components(cell.morphology(), thingify(domain_, cell.provider()));
+    auto comps = components(cell.morphology(), cell.provider().evaluate(domain_));
 
     for (auto& comp: comps) {
         for (mcable c: comp) {
@@ -145,6 +149,123 @@ cv_policy_base_ptr cv_policy_max_extent::clone() const {
 
 region cv_policy_max_extent::domain() const { return domain_; }
 
+// cv_policy_d_lambda
+
+// Heterogeneous ordering of locations and painted cables by branch id.
+struct by_branch {
+    static msize_t branch(msize_t b) { return b; }
+    static msize_t branch(const mlocation& l) { return l.branch; }
+    template <typename T>
+    static msize_t branch(const std::pair<mcable, T>& el) { return el.first.branch; }
+
+    template <typename A, typename B>
+    bool operator()(const A& a, const B& b) const { return branch(a)<branch(b); }
+};
+
+// Value of a painted parameter at a location, or the default if unpainted.
+template <typename T>
+static double painted_value(const mcable_map<T>& mm, mlocation loc, double dflt) {
+    // Last cable starting at or before the location; cables are disjoint.
+    auto it = std::upper_bound(mm.begin(), mm.end(), loc,
+        [](const mlocation& l, const auto& el) {
+            return l.branch<el.first.branch || (l.branch==el.first.branch && l.pos<el.first.prox_pos);
+        });
+    if (it==mm.begin()) return dflt;
+    const auto& el = *--it;
+    return el.first.branch==loc.branch && loc.pos<=el.first.dist_pos? el.second.value: dflt;
+}
+
+locset cv_policy_d_lambda::cv_boundary_points(const cable_cell& cell) const {
+    const unsigned nbranch = cell.morphology().num_branches();
+    const auto& embed = cell.embedding();
+    if (!nbranch || d_lambda_<=0 || freq_<=0) return ls::nil();
+
+    const auto& dflt = cell.default_parameters();
+    double dflt_ra = dflt.axial_resistivity.value_or(*neuron_parameter_defaults.axial_resistivity);
+    double dflt_cm = dflt.membrane_capacitance.value_or(*neuron_parameter_defaults.membrane_capacitance);
+    const auto& ra_map = cell.region_assignments().get<axial_resistivity>();
+    const auto& cm_map = cell.region_assignments().get<membrane_capacitance>();
+    const auto& seg_ends = embed.segment_ends();
+
+    // Electrotonic length of a piece of cable over which the parameters are
+    // constant and the radius linear. The AC length constant [µm] at
+    // frequency f [Hz] of a cable of diameter d [µm] with axial resistivity
+    // ra [Ω·cm] and capacitance cm [µF/cm²] is 1e5·√(d/(4π·f·ra·cm)); a
+    // capacitance of 1 F/m² is 100 µF/cm².
+    auto electrotonic_length = [&](mcable c) {
+        mlocation mid{c.branch, 0.5*(c.prox_pos+c.dist_pos)};
+        double d = 2*embed.radius(mid);
+        double ra = painted_value(ra_map, mid, dflt_ra);
+        double cm = 100*painted_value(cm_map, mid, dflt_cm);
+        double lambda = 1e5*std::sqrt(d/(4*math::pi<double>*freq_*ra*cm));
+        return lambda>0? embed.integrate_length(c)/lambda: 0.;
+    };
+
+    std::vector<mlocation> points;
+    std::vector<double> breaks, cumulative;
+    auto comps = components(cell.morphology(), cell.provider().evaluate(domain_));
+
+    for (auto& comp: comps) {
+        for (mcable c: comp) {
+            // Split the cable where the radius or the parameters may change.
+            breaks.assign({c.prox_pos, c.dist_pos});
+            auto add_break = [&](double x) { if (x>c.prox_pos && x<c.dist_pos) breaks.push_back(x); };
+            auto add_painted_breaks = [&](const auto& mm) {
+                auto on_branch = std::equal_range(mm.begin(), mm.end(), c.branch, by_branch{});
+                for (auto it = on_branch.first; it!=on_branch.second; ++it) {
+                    add_break(it->first.prox_pos);
+                    add_break(it->first.dist_pos);
+                }
+            };
+
+            auto ends = std::equal_range(seg_ends.begin(), seg_ends.end(), c.branch, by_branch{});
+            for (auto it = ends.first; it!=ends.second; ++it) add_break(it->pos);
+            add_painted_breaks(ra_map);
+            add_painted_breaks(cm_map);
+            util::sort(breaks);
+            breaks.erase(std::unique(breaks.begin(), breaks.end()), breaks.end());
+
+            // Place boundary points evenly in electrotonic distance.
+            cumulative.assign(1, 0.);
+            for (unsigned i = 1; i<breaks.size(); ++i) {
+                cumulative.push_back(cumulative.back()+electrotonic_length({c.branch, breaks[i-1], breaks[i]}));
+            }
+            double total = cumulative.back();
+            unsigned ncv = std::max(1., std::ceil(total/d_lambda_));
+
+            auto position = [&](double x) {
+                unsigned i = std::upper_bound(cumulative.begin(), cumulative.end(), x)-cumulative.begin();
+                if (i>=cumulative.size()) return c.dist_pos;
+                double l = cumulative[i]-cumulative[i-1];
+                double t = l>0? (x-cumulative[i-1])/l: 0;
+                return breaks[i-1]+t*(breaks[i]-breaks[i-1]);
+            };
+
+            if (flags_&cv_policy_flag::interior_forks) {
+                for (unsigned i = 0; i<ncv; ++i) {
+                    points.push_back({c.branch, position((1+2*i)*total/(2*ncv))});
+                }
+            }
+            else {
+                points.push_back({c.branch, c.prox_pos});
+                for (unsigned i = 1; i<ncv; ++i) {
+                    points.push_back({c.branch, position(i*total/ncv)});
+                }
+                points.push_back({c.branch, c.dist_pos});
+            }
+        }
+    }
+
+    util::sort(points);
+    return unique_sum(locset(std::move(points)), ls::cboundary(domain_));
+}
+
+cv_policy_base_ptr cv_policy_d_lambda::clone() const {
+    return cv_policy_base_ptr(new cv_policy_d_lambda(*this));
+}
+
+region cv_policy_d_lambda::domain() const { return domain_; }
+
 // cv_policy_fixed_per_branch
 locset cv_policy_fixed_per_branch::cv_boundary_points(const cable_cell& cell) const {
     const unsigned nbranch = cell.morphology().num_branches();
@@ -152,7 +273,7 @@ locset cv_policy_fixed_per_branch::cv_boundary_points(const cable_cell& cell) co
 
     std::vector<mlocation> points;
     double ooncv = 1./cv_per_branch_;
-    auto comps = components(cell.morphology(), thingify(domain_, cell.provider()));
+    auto comps = components(cell.morphology(), cell.provider().evaluate(domain_));
 
     for (auto& comp: comps) {
         for (mcable c: comp) {
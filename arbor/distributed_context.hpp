@@ -2,7 +2,9 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
+#include <arbor/assert.hpp>
 #include <arbor/spike.hpp>
 #include <arbor/util/pp_util.hpp>
 
@@ -31,6 +33,119 @@ namespace arb {
 
 #define ARB_COLLECTIVE_TYPES_ float, double, int, unsigned, long, unsigned long, long long, unsigned long long
 
+// Handle to a spike gather that may still be in progress.
+//
+// Returned by distributed_context::gather_spikes_async. The gathered spikes are
+// retrieved with wait(), which blocks until the communication has completed;
+// test() polls for completion without blocking. A handle can be waited upon
+// only once.
+//
+// Contexts that have no means to overlap communication with computation
+// complete the gather eagerly and return a handle that is already complete.
+
+class spike_gather_request {
+public:
+    struct interface {
+        virtual bool test() = 0;
+        virtual gathered_vector<arb::spike> wait() = 0;
+        virtual ~interface() {}
+    };
+
+    spike_gather_request() = default;
+
+    explicit spike_gather_request(std::unique_ptr<interface> impl):
+        impl_(std::move(impl))
+    {}
+
+    // Construct a completed request from an already gathered spike vector.
+    explicit spike_gather_request(gathered_vector<arb::spike> gathered):
+        impl_(new completed(std::move(gathered)))
+    {}
+
+    spike_gather_request(spike_gather_request&&) = default;
+    spike_gather_request& operator=(spike_gather_request&&) = default;
+
+    // True if there is a gather associated with this handle that has not been waited upon.
+    bool pending() const { return static_cast<bool>(impl_); }
+
+    bool test() {
+        arb_assert(impl_);
+        return impl_->test();
+    }
+
+    gathered_vector<arb::spike> wait() {
+        arb_assert(impl_);
+        auto impl = std::move(impl_);
+        return impl->wait();
+    }
+
+private:
+    struct completed: interface {
+        explicit completed(gathered_vector<arb::spike> g): gathered(std::move(g)) {}
+        bool test() override { return true; }
+        gathered_vector<arb::spike> wait() override { return std::move(gathered); }
+
+        gathered_vector<arb::spike> gathered;
+    };
+
+    std::unique_ptr<interface> impl_;
+};
+
+// Handle to an element-wise sum across domains that may still be in progress.
+//
+// Returned by distributed_context::sum_async. The sums are retrieved with
+// wait(), which blocks until the communication has completed, and are only
+// defined on the root domain of the reduction: other domains receive an empty
+// vector. As with spike_gather_request, a handle can be waited upon only once.
+
+class sum_request {
+public:
+    struct interface {
+        virtual bool test() = 0;
+        virtual std::vector<double> wait() = 0;
+        virtual ~interface() {}
+    };
+
+    sum_request() = default;
+
+    explicit sum_request(std::unique_ptr<interface> impl):
+        impl_(std::move(impl))
+    {}
+
+    // Construct a completed request from already reduced values.
+    explicit sum_request(std::vector<double> sums):
+        impl_(new completed(std::move(sums)))
+    {}
+
+    sum_request(sum_request&&) = default;
+    sum_request& operator=(sum_request&&) = default;
+
+    // True if there is a reduction associated with this handle that has not been waited upon.
+    bool pending() const { return static_cast<bool>(impl_); }
+
+    bool test() {
+        arb_assert(impl_);
+        return impl_->test();
+    }
+
+    std::vector<double> wait() {
+        arb_assert(impl_);
+        auto impl = std::move(impl_);
+        return impl->wait();
+    }
+
+private:
+    struct completed: interface {
+        explicit completed(std::vector<double> s): sums(std::move(s)) {}
+        bool test() override { return true; }
+        std::vector<double> wait() override { return std::move(sums); }
+
+        std::vector<double> sums;
+    };
+
+    std::unique_ptr<interface> impl_;
+};
+
 // Defines the concept/interface for a distributed communication context.
 //
 // Uses value-semantic type erasure to define the interface, so that
@@ -60,10 +175,47 @@ public:
         return impl_->gather_spikes(local_spikes);
     }
 
+    // Start a gather of spikes across all domains, returning a handle that is
+    // used to complete the gather. The local spikes are copied, and may be
+    // modified or released by the caller once the call returns.
+    spike_gather_request gather_spikes_async(const spike_vector& local_spikes) const {
+        return impl_->gather_spikes_async(local_spikes);
+    }
+
     gathered_vector<cell_gid_type> gather_gids(const gid_vector& local_gids) const {
         return impl_->gather_gids(local_gids);
     }
 
+    // Gather the values of all domains, partitioned by the domain from which
+    // they were sent.
+    gathered_vector<double> gather_values(const std::vector<double>& local_values) const {
+        return impl_->gather_values(local_values);
+    }
+
+    // Start an element-wise sum of values across all domains onto the domain
+    // `root`, returning a handle that is used to complete the reduction. All
+    // domains must supply the same number of values.
+    sum_request sum_async(std::vector<double> values, int root) const {
+        return impl_->sum_async(std::move(values), root);
+    }
+
+    // Personalised all-to-all exchange: the values in partition i of the
+    // argument are sent to domain i. Returns the values received, partitioned
+    // by the domain from which they were sent.
+    gathered_vector<arb::spike> alltoall_spikes(const gathered_vector<arb::spike>& spikes) const {
+        return impl_->alltoall_spikes(spikes);
+    }
+
+    // Start a personalised all-to-all exchange of spikes, returning a handle
+    // that is used to complete the exchange, as with gather_spikes_async.
+    spike_gather_request alltoall_spikes_async(const gathered_vector<arb::spike>& spikes) const {
+        return impl_->alltoall_spikes_async(spikes);
+    }
+
+    gathered_vector<cell_gid_type> alltoall_gids(const gathered_vector<cell_gid_type>& gids) const {
+        return impl_->alltoall_gids(gids);
+    }
+
     cell_label_range gather_cell_label_range(const cell_label_range& local_ranges) const {
         return impl_->gather_cell_label_range(local_ranges);
     }
@@ -72,6 +224,15 @@ public:
         return impl_->gather_cell_labels_and_gids(local_labels_and_gids);
     }
 
+    // Personalised all-to-all exchange of cell labels: the cells with indices
+    // in [partition[i], partition[i+1]) are sent to domain i. Returns the
+    // labels of the cells received, ordered by the domain from which they
+    // were sent.
+    cell_labels_and_gids alltoall_cell_labels_and_gids(const cell_labels_and_gids& labels_and_gids,
+                                                       const std::vector<cell_size_type>& partition) const {
+        return impl_->alltoall_cell_labels_and_gids(labels_and_gids, partition);
+    }
+
     std::vector<std::string> gather(std::string value, int root) const {
         return impl_->gather(value, root);
     }
@@ -98,12 +259,27 @@ private:
     struct interface {
         virtual gathered_vector<arb::spike>
             gather_spikes(const spike_vector& local_spikes) const = 0;
+        virtual spike_gather_request
+            gather_spikes_async(const spike_vector& local_spikes) const = 0;
         virtual gathered_vector<cell_gid_type>
             gather_gids(const gid_vector& local_gids) const = 0;
+        virtual gathered_vector<double>
+            gather_values(const std::vector<double>& local_values) const = 0;
+        virtual sum_request
+            sum_async(std::vector<double> values, int root) const = 0;
+        virtual gathered_vector<arb::spike>
+            alltoall_spikes(const gathered_vector<arb::spike>& spikes) const = 0;
+        virtual spike_gather_request
+            alltoall_spikes_async(const gathered_vector<arb::spike>& spikes) const = 0;
+        virtual gathered_vector<cell_gid_type>
+            alltoall_gids(const gathered_vector<cell_gid_type>& gids) const = 0;
         virtual cell_label_range
             gather_cell_label_range(const cell_label_range& local_ranges) const = 0;
         virtual cell_labels_and_gids
             gather_cell_labels_and_gids(const cell_labels_and_gids& local_labels_and_gids) const = 0;
+        virtual cell_labels_and_gids
+            alltoall_cell_labels_and_gids(const cell_labels_and_gids& labels_and_gids,
+                                          const std::vector<cell_size_type>& partition) const = 0;
         virtual std::vector<std::string>
             gather(std::string value, int root) const = 0;
         virtual int id() const = 0;
@@ -125,10 +301,34 @@ private:
         gather_spikes(const spike_vector& local_spikes) const override {
             return wrapped.gather_spikes(local_spikes);
         }
+        spike_gather_request
+        gather_spikes_async(const spike_vector& local_spikes) const override {
+            return wrapped.gather_spikes_async(local_spikes);
+        }
         gathered_vector<cell_gid_type>
         gather_gids(const gid_vector& local_gids) const override {
             return wrapped.gather_gids(local_gids);
         }
+        gathered_vector<double>
+        gather_values(const std::vector<double>& local_values) const override {
+            return wrapped.gather_values(local_values);
+        }
+        sum_request
+        sum_async(std::vector<double> values, int root) const override {
+            return wrapped.sum_async(std::move(values), root);
+        }
+        gathered_vector<arb::spike>
+        alltoall_spikes(const gathered_vector<arb::spike>& spikes) const override {
+            return wrapped.alltoall_spikes(spikes);
+        }
+        spike_gather_request
+        alltoall_spikes_async(const gathered_vector<arb::spike>& spikes) const override {
+            return wrapped.alltoall_spikes_async(spikes);
+        }
+        gathered_vector<cell_gid_type>
+        alltoall_gids(const gathered_vector<cell_gid_type>& gids) const override {
+            return wrapped.alltoall_gids(gids);
+        }
         cell_label_range
         gather_cell_label_range(const cell_label_range& local_ranges) const override {
             return wrapped.gather_cell_label_range(local_ranges);
@@ -137,6 +337,11 @@ private:
         gather_cell_labels_and_gids(const cell_labels_and_gids& local_labels_and_gids) const override {
             return wrapped.gather_cell_labels_and_gids(local_labels_and_gids);
         }
+        cell_labels_and_gids
+        alltoall_cell_labels_and_gids(const cell_labels_and_gids& labels_and_gids,
+                                      const std::vector<cell_size_type>& partition) const override {
+            return wrapped.alltoall_cell_labels_and_gids(labels_and_gids, partition);
+        }
         std::vector<std::string>
         gather(std::string value, int root) const override {
             return wrapped.gather(value, root);
@@ -171,6 +376,10 @@ struct local_context {
             {0u, static_cast<count_type>(local_spikes.size())}
         );
     }
+    spike_gather_request
+    gather_spikes_async(const std::vector<arb::spike>& local_spikes) const {
+        return spike_gather_request(gather_spikes(local_spikes));
+    }
     gathered_vector<cell_gid_type>
     gather_gids(const std::vector<cell_gid_type>& local_gids) const {
         using count_type = typename gathered_vector<cell_gid_type>::count_type;
@@ -179,6 +388,30 @@ struct local_context {
                 {0u, static_cast<count_type>(local_gids.size())}
         );
     }
+    gathered_vector<double>
+    gather_values(const std::vector<double>& local_values) const {
+        using count_type = typename gathered_vector<double>::count_type;
+        return gathered_vector<double>(
+                std::vector<double>(local_values),
+                {0u, static_cast<count_type>(local_values.size())}
+        );
+    }
+    sum_request
+    sum_async(std::vector<double> values, int) const {
+        return sum_request(std::move(values));
+    }
+    gathered_vector<arb::spike>
+    alltoall_spikes(const gathered_vector<arb::spike>& spikes) const {
+        return spikes;
+    }
+    spike_gather_request
+    alltoall_spikes_async(const gathered_vector<arb::spike>& spikes) const {
+        return spike_gather_request(alltoall_spikes(spikes));
+    }
+    gathered_vector<cell_gid_type>
+    alltoall_gids(const gathered_vector<cell_gid_type>& gids) const {
+        return gids;
+    }
     cell_label_range
     gather_cell_label_range(const cell_label_range& local_ranges) const {
         return local_ranges;
@@ -187,6 +420,11 @@ struct local_context {
     gather_cell_labels_and_gids(const cell_labels_and_gids& local_labels_and_gids) const {
         return local_labels_and_gids;
     }
+    cell_labels_and_gids
+    alltoall_cell_labels_and_gids(const cell_labels_and_gids& labels_and_gids,
+                                  const std::vector<cell_size_type>&) const {
+        return labels_and_gids;
+    }
     template <typename T>
     std::vector<T> gather(T value, int) const {
         return {std::move(value)};
@@ -224,8 +462,10 @@ distributed_context_handle make_local_context() {
 distributed_context_handle make_dry_run_context(unsigned num_ranks, unsigned num_cells_per_rank);
 
 // MPI context creation functions only provided if built with MPI support.
+// With `node_shared_spikes`, spikes are gathered through one rank per node,
+// and shared between the ranks of a node; see proc_allocation.
 template <typename MPICommType>
-distributed_context_handle make_mpi_context(MPICommType);
+distributed_context_handle make_mpi_context(MPICommType, bool node_shared_spikes = false);
 
 } // namespace arb
 
@@ -10,6 +10,7 @@
 #include <arbor/spike.hpp>
 
 #include "event_binner.hpp"
+#include "io/serialize.hpp"
 
 namespace arb {
 
@@ -43,5 +44,16 @@ time_type event_binner::bin(time_type t, time_type t_min) {
     return std::max(t_binned, t_min);
 }
 
+void event_binner::serialize(io::serializer& out) const {
+    out.value<char>(last_event_time_.has_value());
+    out.value(last_event_time_.value_or(0));
+}
+
+void event_binner::deserialize(io::deserializer& in) {
+    auto has_time = in.value<char>();
+    auto t = in.value<time_type>();
+    last_event_time_ = has_time? std::optional<time_type>(t): std::nullopt;
+}
+
 } // namespace arb
 
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
 #include <limits>
 #include <optional>
 #include <unordered_map>
@@ -9,6 +11,11 @@
 
 namespace arb {
 
+namespace io {
+class serializer;
+class deserializer;
+} // namespace io
+
 class event_binner {
 public:
     event_binner(): policy_(binning_kind::none), bin_interval_(0) {}
@@ -26,6 +33,37 @@ public:
 
     time_type bin(time_type t, time_type t_min = std::numeric_limits<time_type>::lowest());
 
+    // Bin the times of the events in [first, last), in time order, as bin()
+    // would one at a time. The policy is dispatched once for the range, so
+    // that the loops for the stateless policies vectorize.
+    template <typename Event>
+    void bin(Event* first, Event* last, time_type t_min) {
+        switch (policy_) {
+        case binning_kind::regular:
+            if (bin_interval_>0) {
+                const time_type w = bin_interval_;
+                for (auto e = first; e!=last; ++e) {
+                    e->time = std::max(std::floor(e->time/w)*w, t_min);
+                }
+                break;
+            }
+            [[fallthrough]];
+        case binning_kind::none:
+            for (auto e = first; e!=last; ++e) {
+                e->time = std::max(e->time, t_min);
+            }
+            break;
+        default:
+            for (auto e = first; e!=last; ++e) {
+                e->time = bin(e->time, t_min);
+            }
+        }
+    }
+
+    // Write and restore the time of the last binned event, for checkpointing.
+    void serialize(io::serializer&) const;
+    void deserialize(io::deserializer&);
+
 private:
     binning_kind policy_;
 
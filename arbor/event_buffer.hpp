@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include <arbor/assert.hpp>
+#include <arbor/common_types.hpp>
+#include <arbor/spike_event.hpp>
+
+#include "util/range.hpp"
+
+namespace arb {
+
+// Events for a set of cells, stored in one contiguous buffer that is
+// partitioned by cell: the events of cell i occupy the index range
+// [divisions[i], divisions[i+1]) of `events`.
+//
+// Events are added in two passes. First the number of new events for each
+// cell is registered with count(); then allocate() extends the partition,
+// relocating any events already held, after which each new event is
+// scattered into its cell's range with push(). Within a pass, updates for
+// disjoint sets of cells may be performed concurrently.
+//
+// Storage is retained by clear(), so that a buffer that is refilled every
+// epoch settles on its high water mark and stops allocating.
+
+class event_buffer {
+public:
+    using span = util::range<spike_event*>;
+    using const_span = util::range<const spike_event*>;
+
+    event_buffer() = default;
+    explicit event_buffer(cell_size_type n) { resize(n); }
+
+    // Set the number of cells; the buffer is cleared.
+    void resize(cell_size_type n) {
+        divisions_.assign(n+1, 0);
+        counts_.assign(n, 0);
+        cursors_.assign(n, 0);
+        events_.clear();
+    }
+
+    // Remove all events, keeping the allocated storage.
+    void clear() {
+        std::fill(divisions_.begin(), divisions_.end(), 0);
+        std::fill(cursors_.begin(), cursors_.end(), 0);
+        events_.clear();
+    }
+
+    cell_size_type num_cells() const { return counts_.size(); }
+
+    // Total number of events over all cells.
+    std::size_t size() const { return events_.size(); }
+    bool empty() const { return events_.empty(); }
+
+    // First pass: register n further events for cell i.
+    void count(cell_size_type i, std::size_t n = 1) {
+        counts_[i] += n;
+    }
+
+    // Extend the partition by the registered counts.
+    void allocate() {
+        const auto n = num_cells();
+        const bool relocate = !events_.empty();
+
+        // Cells keep the events they already hold, which are moved back
+        // to their new positions, last cell first, so that no event is
+        // overwritten before it has been moved.
+        std::size_t total = 0;
+        for (cell_size_type i = 0; i<n; ++i) {
+            total += divisions_[i+1]-divisions_[i] + counts_[i];
+        }
+        events_.resize(total);
+
+        std::size_t end = total;
+        for (cell_size_type i = n; i-->0;) {
+            auto b = divisions_[i], e = divisions_[i+1];
+            auto first = end - counts_[i] - (e-b);
+            if (relocate && first!=b) {
+                std::move_backward(events_.begin()+b, events_.begin()+e, events_.begin()+first+(e-b));
+            }
+            cursors_[i] = first + (e-b);
+            divisions_[i+1] = end;
+            counts_[i] = 0;
+            end = first;
+        }
+        arb_assert(end==0);
+    }
+
+    // Second pass: store an event for cell i in the space reserved by count().
+    void push(cell_size_type i, const spike_event& ev) {
+        arb_assert(cursors_[i]<divisions_[i+1]);
+        events_[cursors_[i]++] = ev;
+    }
+
+    // Add the events in `extra`, one vector per cell, to those already held.
+    void append(const std::vector<pse_vector>& extra) {
+        arb_assert(extra.size()==num_cells());
+
+        for (cell_size_type i = 0; i<num_cells(); ++i) {
+            count(i, extra[i].size());
+        }
+        allocate();
+        for (cell_size_type i = 0; i<num_cells(); ++i) {
+            for (auto& ev: extra[i]) {
+                push(i, ev);
+            }
+        }
+    }
+
+    // The events of cell i.
+    span operator[](cell_size_type i) {
+        auto b = events_.data();
+        return {b+divisions_[i], b+divisions_[i+1]};
+    }
+
+    const_span operator[](cell_size_type i) const {
+        auto b = events_.data();
+        return {b+divisions_[i], b+divisions_[i+1]};
+    }
+
+    // Bytes of the allocated storage, which is kept when the buffer is cleared.
+    std::size_t bytes() const {
+        return events_.capacity()*sizeof(spike_event)
+             + (divisions_.capacity()+counts_.capacity()+cursors_.capacity())*sizeof(std::size_t);
+    }
+
+private:
+    pse_vector events_;
+    std::vector<std::size_t> divisions_ = {0};
+    std::vector<std::size_t> counts_;
+    std::vector<std::size_t> cursors_;
+};
+
+} // namespace arb
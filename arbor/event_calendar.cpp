@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <arbor/assert.hpp>
+#include <arbor/common_types.hpp>
+#include <arbor/math.hpp>
+#include <arbor/spike_event.hpp>
+
+#include "event_calendar.hpp"
+#include "util/span.hpp"
+
+namespace arb {
+
+void event_calendar::resize(cell_size_type n) {
+    rings_.clear();
+    rings_.resize(n);
+}
+
+void event_calendar::clear(time_type t) {
+    for (auto& r: rings_) {
+        for (auto& slot: r.slots) slot.clear();
+        r.base = dt_>0? first_step(t): 0;
+        r.t_taken = t;
+        r.n_events = 0;
+    }
+}
+
+void event_calendar::set_step(time_type dt) {
+    arb_assert(dt>0);
+    if (dt==dt_) return;
+    dt_ = dt;
+
+    pse_vector held;
+    for (auto i: util::make_span(num_cells())) {
+        auto& r = rings_[i];
+        held.clear();
+        for (auto& slot: r.slots) {
+            held.insert(held.end(), slot.begin(), slot.end());
+            slot.clear();
+        }
+        r.n_events = 0;
+        r.base = first_step(r.t_taken);
+        push(i, held);
+    }
+}
+
+std::size_t event_calendar::size() const {
+    std::size_t n = 0;
+    for (auto& r: rings_) n += r.n_events;
+    return n;
+}
+
+std::int64_t event_calendar::step_of(time_type t) const {
+    return std::floor(t/dt_);
+}
+
+std::int64_t event_calendar::first_step(time_type t) const {
+    std::int64_t k = std::ceil(t/dt_);
+    while (k>0 && (k-1)*dt_>=t) --k;
+    while (k*dt_<t) ++k;
+    return k;
+}
+
+void event_calendar::push(cell_size_type i, const spike_event& ev) {
+    arb_assert(dt_>0);
+    auto& r = rings_[i];
+    const auto k = std::max(step_of(ev.time), r.base);
+
+    // Grow the ring to hold step k, moving the slots of the steps it holds
+    // to their positions in the larger ring.
+    const std::size_t n = r.slots.size();
+    const std::size_t need = k-r.base+1;
+    if (need>n) {
+        const std::size_t m = math::next_pow2(std::max<std::size_t>({need, 2*n, 4}));
+        std::vector<pse_vector> slots(m);
+        for (std::size_t j = 0; j<n; ++j) {
+            const std::uint64_t s = r.base+j;
+            slots[s&(m-1)] = std::move(r.slots[s&(n-1)]);
+        }
+        std::swap(r.slots, slots);
+    }
+
+    r.slots[std::uint64_t(k)&(r.slots.size()-1)].push_back(ev);
+    ++r.n_events;
+}
+
+void event_calendar::take(cell_size_type i, time_type t0, time_type t1, pse_vector& out) {
+    auto& r = rings_[i];
+    const auto end = first_step(t1);
+
+    if (r.n_events) {
+        // Position in `out` of the event of each target in the current step.
+        thread_local static std::vector<std::ptrdiff_t> index;
+
+        const std::size_t mask = r.slots.size()-1;
+        for (auto k = r.base; k<end && r.n_events; ++k) {
+            auto& slot = r.slots[std::uint64_t(k)&mask];
+            if (slot.empty()) continue;
+
+            const time_type t = std::max(k*dt_, t0);
+            const std::size_t first = out.size();
+            for (auto& ev: slot) {
+                if (ev.target>=index.size()) index.resize(ev.target+1, -1);
+                auto& j = index[ev.target];
+                if (j<0) {
+                    j = out.size();
+                    out.push_back({ev.target, t, ev.weight});
+                }
+                else {
+                    out[j].weight += ev.weight;
+                }
+            }
+            for (auto j = first; j<out.size(); ++j) index[out[j].target] = -1;
+
+            r.n_events -= slot.size();
+            slot.clear();
+        }
+    }
+
+    r.base = std::max(r.base, end);
+    r.t_taken = std::max(r.t_taken, t1);
+}
+
+void event_calendar::copy(cell_size_type i, pse_vector& out) const {
+    for (auto& slot: rings_[i].slots) {
+        out.insert(out.end(), slot.begin(), slot.end());
+    }
+}
+
+std::size_t event_calendar::bytes() const {
+    std::size_t n = rings_.capacity()*sizeof(ring);
+    for (auto& r: rings_) {
+        n += r.slots.capacity()*sizeof(pse_vector);
+        for (auto& slot: r.slots) n += slot.capacity()*sizeof(spike_event);
+    }
+    return n;
+}
+
+} // namespace arb
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+#include <arbor/spike_event.hpp>
+
+namespace arb {
+
+// Pending events for a set of cells, stored by delivery step.
+//
+// The events of each cell are kept in a ring of slots, one for each step of
+// the grid k*dt, and each event is placed in the slot of the step that holds
+// its delivery time, so that storing an event takes constant time. Events
+// are taken in time order by walking the slots, without sorting. The events
+// to one target in the same step are taken as one event with the sum of
+// their weights, delivered at the start of the step.
+//
+// The ring of a cell grows to the span of the delivery times it holds, that
+// is to about the largest delay over dt slots. Updates of disjoint sets of
+// cells may be performed concurrently.
+
+class event_calendar {
+public:
+    event_calendar() = default;
+    event_calendar(cell_size_type n, time_type dt) { resize(n); set_step(dt); }
+
+    // Set the number of cells; the calendar is cleared.
+    void resize(cell_size_type n);
+
+    // Remove all events, keeping the allocated storage. The next events
+    // are taken from time t.
+    void clear(time_type t = 0);
+
+    // Set the step width; events already held are placed in slots of the new width.
+    void set_step(time_type dt);
+    time_type step() const { return dt_; }
+
+    cell_size_type num_cells() const { return rings_.size(); }
+
+    // Number of events held for cell i, and for all cells.
+    std::size_t size(cell_size_type i) const { return rings_[i].n_events; }
+    std::size_t size() const;
+    bool empty() const { return size()==0; }
+
+    // Store an event for cell i. Events due before the last interval taken
+    // are placed in the first step after it.
+    void push(cell_size_type i, const spike_event& ev);
+
+    template <typename Seq>
+    void push(cell_size_type i, const Seq& events) {
+        for (auto& ev: events) push(i, ev);
+    }
+
+    // Append the events of cell i in the steps that start before t1 to `out`,
+    // in time order, and remove them. The events are delivered no earlier
+    // than t0, the start of the interval of the caller.
+    void take(cell_size_type i, time_type t0, time_type t1, pse_vector& out);
+
+    // Append the events held for cell i to `out`, as stored and in no
+    // particular order.
+    void copy(cell_size_type i, pse_vector& out) const;
+
+    // Bytes of the allocated storage, which is kept when the calendar is cleared.
+    std::size_t bytes() const;
+
+private:
+    struct ring {
+        std::vector<pse_vector> slots;  // number of slots is zero or a power of two
+        std::int64_t base = 0;          // first step not yet taken
+        time_type t_taken = 0;          // end of the last interval taken
+        std::size_t n_events = 0;
+    };
+
+    time_type dt_ = 0;
+    std::vector<ring> rings_;
+
+    // The step that holds t, and the first step that starts at or after t.
+    std::int64_t step_of(time_type t) const;
+    std::int64_t first_step(time_type t) const;
+};
+
+} // namespace arb
@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <vector>
+
+#include <arbor/assert.hpp>
+#include <arbor/common_types.hpp>
+#include <arbor/spike_event.hpp>
+
+#include "event_sort.hpp"
+
+namespace arb {
+
+// Below this number of events the bucketing overhead is not worth it.
+static constexpr std::size_t bucket_sort_threshold = 32;
+
+void bucket_sort_events(event_range events) {
+    const std::size_t n = events.size();
+    if (n<bucket_sort_threshold) {
+        std::sort(events.begin(), events.end());
+        return;
+    }
+
+    auto [lo, hi] = std::minmax_element(events.begin(), events.end(),
+        [](const spike_event& a, const spike_event& b) { return a.time<b.time; });
+    const time_type t_min = lo->time;
+    const time_type t_max = hi->time;
+    if (t_min==t_max) {
+        std::sort(events.begin(), events.end());
+        return;
+    }
+
+    // One bucket per event on average.
+    const std::size_t n_buckets = n;
+    const time_type scale = n_buckets/(t_max-t_min);
+    auto bucket = [&](const spike_event& e) {
+        return std::min(n_buckets-1, std::size_t((e.time-t_min)*scale));
+    };
+
+    // Scratch space is kept per thread, and reused between calls.
+    thread_local static std::vector<std::size_t> divisions;
+    thread_local static pse_vector sorted;
+
+    divisions.assign(n_buckets+1, 0);
+    for (auto& e: events) {
+        ++divisions[bucket(e)+1];
+    }
+    for (std::size_t i = 0; i<n_buckets; ++i) {
+        divisions[i+1] += divisions[i];
+    }
+    arb_assert(divisions.back()==n);
+
+    sorted.resize(n);
+    for (auto& e: events) {
+        sorted[divisions[bucket(e)]++] = e;
+    }
+
+    // After the scatter, divisions[i] is the end of bucket i.
+    std::size_t b = 0;
+    for (std::size_t i = 0; i<n_buckets; ++i) {
+        auto e = divisions[i];
+        if (e-b>1) {
+            std::sort(sorted.begin()+b, sorted.begin()+e);
+        }
+        b = e;
+    }
+
+    std::copy(sorted.begin(), sorted.end(), events.begin());
+}
+
+void sort_events(event_range events, event_sort_kind kind) {
+    switch (kind) {
+    case event_sort_kind::bucket:
+        bucket_sort_events(events);
+        break;
+    default:
+        std::sort(events.begin(), events.end());
+    }
+}
+
+} // namespace arb
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <arbor/common_types.hpp>
+#include <arbor/spike_event.hpp>
+
+#include "util/range.hpp"
+
+// Sort a sequence of events into the spike_event ordering: by delivery time,
+// then target, then weight.
+
+namespace arb {
+
+using event_range = util::range<spike_event*>;
+
+void sort_events(event_range events, event_sort_kind kind = event_sort_kind::comparison);
+
+// Counting sort of events into buckets of equal delivery time width over the
+// span of delivery times, followed by a comparison sort within each bucket.
+// As the bucket index is monotonic in time, the result is identical to that
+// of a comparison sort.
+void bucket_sort_events(event_range events);
+
+} // namespace arb
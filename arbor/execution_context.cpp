@@ -1,6 +1,8 @@
 #include <iostream>
 #include <memory>
+#include <vector>
 
+#include <arbor/arbexcept.hpp>
 #include <arbor/context.hpp>
 
 #include "gpu_context.hpp"
@@ -18,11 +20,38 @@ void execution_context_deleter::operator()(execution_context* p) const {
     delete p;
 }
 
+static task_system_handle make_thread_pool(const proc_allocation& resources) {
+    bool work_stealing = resources.scheduler==task_scheduler_kind::work_stealing;
+    auto ts = std::make_shared<threading::task_system>(resources.num_threads, work_stealing);
+    ts->set_wait_policy(resources.wait);
+    if (resources.bind_threads) ts->bind_threads(resources.cpus);
+    return ts;
+}
+
+static std::vector<gpu_context_handle> make_gpu_contexts(const proc_allocation& resources) {
+    std::vector<gpu_context_handle> gpus;
+    if (!resources.has_gpu()) {
+        if (!resources.extra_gpu_ids.empty()) {
+            throw arbor_exception("proc_allocation: extra_gpu_ids requires gpu_id to select a GPU");
+        }
+        return gpus;
+    }
+
+    gpus.push_back(std::make_shared<gpu_context>(resources.gpu_id));
+    for (int id: resources.extra_gpu_ids) {
+        gpus.push_back(std::make_shared<gpu_context>(id));
+    }
+    // Leave the first device selected on the calling thread, as with a
+    // single GPU.
+    gpus.front()->set_gpu();
+    return gpus;
+}
+
 execution_context::execution_context(const proc_allocation& resources):
     distributed(make_local_context()),
-    thread_pool(std::make_shared<threading::task_system>(resources.num_threads)),
-    gpu(resources.has_gpu()? std::make_shared<gpu_context>(resources.gpu_id)
-                           : std::make_shared<gpu_context>())
+    thread_pool(make_thread_pool(resources)),
+    gpus(make_gpu_contexts(resources)),
+    gpu(gpus.empty()? std::make_shared<gpu_context>(): gpus.front())
 {}
 
 context make_context(const proc_allocation& p) {
@@ -32,10 +61,10 @@ context make_context(const proc_allocation& p) {
 #ifdef ARB_HAVE_MPI
 template <>
 execution_context::execution_context(const proc_allocation& resources, MPI_Comm comm):
-    distributed(make_mpi_context(comm)),
-    thread_pool(std::make_shared<threading::task_system>(resources.num_threads)),
-    gpu(resources.has_gpu()? std::make_shared<gpu_context>(resources.gpu_id)
-                           : std::make_shared<gpu_context>())
+    distributed(make_mpi_context(comm, resources.node_shared_spikes)),
+    thread_pool(make_thread_pool(resources)),
+    gpus(make_gpu_contexts(resources)),
+    gpu(gpus.empty()? std::make_shared<gpu_context>(): gpus.front())
 {}
 
 template <>
@@ -48,9 +77,9 @@ execution_context::execution_context(
         const proc_allocation& resources,
         dry_run_info d):
         distributed(make_dry_run_context(d.num_ranks, d.num_cells_per_rank)),
-        thread_pool(std::make_shared<threading::task_system>(resources.num_threads)),
-        gpu(resources.has_gpu()? std::make_shared<gpu_context>(resources.gpu_id)
-                               : std::make_shared<gpu_context>())
+        thread_pool(make_thread_pool(resources)),
+        gpus(make_gpu_contexts(resources)),
+        gpu(gpus.empty()? std::make_shared<gpu_context>(): gpus.front())
 {}
 
 template <>
@@ -66,6 +95,10 @@ bool has_gpu(const context& ctx) {
     return ctx->gpu->has_gpu();
 }
 
+unsigned num_gpus(const context& ctx) {
+    return ctx->gpus.size();
+}
+
 unsigned num_threads(const context& ctx) {
     return ctx->thread_pool->get_num_threads();
 }
@@ -82,5 +115,9 @@ bool has_mpi(const context& ctx) {
     return ctx->distributed->name() == "MPI";
 }
 
+void run_parallel(const context& ctx, std::size_t n, const std::function<void(std::size_t)>& f) {
+    threading::parallel_for::apply(0, n, ctx->thread_pool.get(), [&f](int i) { f(i); });
+}
+
 } // namespace arb
 
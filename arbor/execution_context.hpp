@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
 #include <arbor/context.hpp>
 
@@ -22,6 +23,12 @@ namespace arb {
 struct execution_context {
     distributed_context_handle distributed;
     task_system_handle thread_pool;
+
+    // One context per GPU device of the allocation, in the order gpu_id,
+    // extra_gpu_ids; empty if there is no GPU.
+    std::vector<gpu_context_handle> gpus;
+
+    // The first device, or a context without a GPU.
     gpu_context_handle gpu;
 
     execution_context(const proc_allocation& resources = proc_allocation{});
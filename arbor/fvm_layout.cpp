@@ -1,7 +1,12 @@
 #include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
 #include <optional>
 #include <set>
 #include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -11,8 +16,11 @@
 #include <arbor/morph/mcable_map.hpp>
 #include <arbor/morph/mprovider.hpp>
 #include <arbor/morph/morphology.hpp>
+#include <arbor/morph/place_pwlin.hpp>
+#include <arbor/util/hash_def.hpp>
 
 #include "fvm_layout.hpp"
+#include "io/serialize.hpp"
 #include "threading/threading.hpp"
 #include "util/maputil.hpp"
 #include "util/meta.hpp"
@@ -130,6 +138,31 @@ pw_elements<U> pw_over_cable(const mcable_map<T>& mm, mcable cable, U dflt_value
 
 // Construct cv_geometry for cell from locset describing CV boundary points.
 
+// Construct CV children mapping by sorting CV indices by parent.
+static void set_cv_children(cv_geometry& geom) {
+    fvm_index_type n_cv = geom.cv_parent.size();
+
+    geom.cv_children.clear();
+    for (fvm_index_type cv = 0; cv<n_cv; ++cv) {
+        if (geom.cv_parent[cv]!=-1) geom.cv_children.push_back(cv);
+    }
+    stable_sort_by(geom.cv_children, [&geom](auto cv) { return geom.cv_parent[cv]; });
+
+    geom.cv_children_divs.clear();
+    geom.cv_children_divs.reserve(n_cv+1);
+    geom.cv_children_divs.push_back(0);
+
+    auto b = geom.cv_children.begin();
+    auto e = geom.cv_children.end();
+    auto from = b;
+
+    for (fvm_index_type cv = 0; cv<n_cv; ++cv) {
+        from = std::partition_point(from, e,
+            [cv, &geom](auto i) { return geom.cv_parent[i]<=cv; });
+        geom.cv_children_divs.push_back(from-b);
+    }
+}
+
 cv_geometry cv_geometry_from_ends(const cable_cell& cell, const locset& lset) {
     auto pop = [](auto& vec) { auto h = vec.back(); return vec.pop_back(), h; };
 
@@ -218,22 +251,7 @@ cv_geometry cv_geometry_from_ends(const cable_cell& cell, const locset& lset) {
     arb_assert(util::all_of(util::subrange_view(geom.cv_parent, 1, n_cv),
             [](auto v) { return v!=no_parent; }));
 
-    // Construct CV children mapping by sorting CV indices by parent.
-    assign(geom.cv_children, make_span(1, n_cv));
-    stable_sort_by(geom.cv_children, [&geom](auto cv) { return geom.cv_parent[cv]; });
-
-    geom.cv_children_divs.reserve(n_cv+1);
-    geom.cv_children_divs.push_back(0);
-
-    auto b = geom.cv_children.begin();
-    auto e = geom.cv_children.end();
-    auto from = b;
-
-    for (fvm_index_type cv = 0; cv<n_cv; ++cv) {
-        from = std::partition_point(from, e,
-            [cv, &geom](auto i) { return geom.cv_parent[i]<=cv; });
-        geom.cv_children_divs.push_back(from-b);
-    }
+    set_cv_children(geom);
 
     // Fill cv/cell mapping for single cell (index 0).
     geom.cv_to_cell.assign(cv_index, 0);
@@ -327,6 +345,7 @@ fvm_cv_discretization& append(fvm_cv_discretization& dczn, const fvm_cv_discreti
     append(dczn.geometry, right.geometry);
 
     append(dczn.face_conductance, right.face_conductance);
+    append(dczn.face_area_per_length, right.face_area_per_length);
     append(dczn.cv_area, right.cv_area);
     append(dczn.cv_capacitance, right.cv_capacitance);
     append(dczn.init_membrane_potential, right.init_membrane_potential);
@@ -342,19 +361,27 @@ fvm_cv_discretization& append(fvm_cv_discretization& dczn, const fvm_cv_discreti
 // FVM discretization
 // ------------------
 
-fvm_cv_discretization fvm_cv_discretize(const cable_cell& cell, const cable_cell_parameter_set& global_dflt) {
+// CV boundary points of a cell, as given by its CV policy.
+static mlocation_list cv_boundary_locations(const cable_cell& cell, const cable_cell_parameter_set& global_dflt) {
     const auto& dflt = cell.default_parameters();
-    fvm_cv_discretization D;
-
-    D.geometry = cv_geometry_from_ends(cell,
+    return thingify(
         dflt.discretization? dflt.discretization->cv_boundary_points(cell):
         global_dflt.discretization? global_dflt.discretization->cv_boundary_points(cell):
-        default_cv_policy().cv_boundary_points(cell));
+        default_cv_policy().cv_boundary_points(cell),
+        cell.provider());
+}
+
+static fvm_cv_discretization fvm_cv_discretize(const cable_cell& cell, const cable_cell_parameter_set& global_dflt, const mlocation_list& cv_ends) {
+    const auto& dflt = cell.default_parameters();
+    fvm_cv_discretization D;
+
+    D.geometry = cv_geometry_from_ends(cell, cv_ends);
 
     if (D.geometry.empty()) return D;
 
     auto n_cv = D.geometry.size();
     D.face_conductance.resize(n_cv);
+    D.face_area_per_length.resize(n_cv);
     D.cv_area.resize(n_cv);
     D.cv_capacitance.resize(n_cv);
     D.init_membrane_potential.resize(n_cv);
@@ -387,6 +414,7 @@ fvm_cv_discretization fvm_cv_discretize(const cable_cell& cell, const cable_cell
         //       the interface between the two CVs.
 
         D.face_conductance[i] = 0;
+        D.face_area_per_length[i] = 0;
 
         fvm_index_type p = D.geometry.cv_parent[i];
         if (p!=-1) {
@@ -412,6 +440,7 @@ fvm_cv_discretization fvm_cv_discretize(const cable_cell& cell, const cable_cell
             mcable span{bid, parent_refpt, cv_refpt};
             double resistance = embedding.integrate_ixa(span, D.axial_resistivity[0].at(bid));
             D.face_conductance[i] = 100/resistance; // 100 scales to µS.
+            D.face_area_per_length[i] = 1/embedding.integrate_ixa(span);
         }
 
         D.cv_area[i] = 0;
@@ -463,21 +492,269 @@ fvm_cv_discretization fvm_cv_discretize(const cable_cell& cell, const cable_cell
     return D;
 }
 
+fvm_cv_discretization fvm_cv_discretize(const cable_cell& cell, const cable_cell_parameter_set& global_dflt) {
+    return fvm_cv_discretize(cell, global_dflt, cv_boundary_locations(cell, global_dflt));
+}
+
+// Cells that are copies of one template cell have the same discretization.
+// It is determined by the morphology, the CV boundary points, and the
+// painted and default values of the properties used above.
+
+static bool same_morphology(const morphology& a, const morphology& b) {
+    if (a.num_branches()!=b.num_branches()) return false;
+    for (msize_t i = 0; i<a.num_branches(); ++i) {
+        if (a.branch_parent(i)!=b.branch_parent(i)) return false;
+        const auto& sa = a.branch_segments(i);
+        const auto& sb = b.branch_segments(i);
+        auto same_segment = [](const msegment& x, const msegment& y) {
+            return x.id==y.id && x.prox==y.prox && x.dist==y.dist && x.tag==y.tag;
+        };
+        if (!std::equal(sa.begin(), sa.end(), sb.begin(), sb.end(), same_segment)) return false;
+    }
+    return true;
+}
+
+template <typename Property>
+static bool same_assignments(const cable_cell& a, const cable_cell& b) {
+    const auto& ma = a.region_assignments().get<Property>();
+    const auto& mb = b.region_assignments().get<Property>();
+    return std::equal(ma.begin(), ma.end(), mb.begin(), mb.end(),
+        [](const auto& x, const auto& y) { return x.first==y.first && x.second.value==y.second.value; });
+}
+
+static bool same_discretization(const cable_cell& a, const mlocation_list& a_ends,
+                                const cable_cell& b, const mlocation_list& b_ends) {
+    const auto& da = a.default_parameters();
+    const auto& db = b.default_parameters();
+    return a_ends==b_ends
+        && da.axial_resistivity==db.axial_resistivity
+        && da.membrane_capacitance==db.membrane_capacitance
+        && da.init_membrane_potential==db.init_membrane_potential
+        && da.temperature_K==db.temperature_K
+        && same_assignments<axial_resistivity>(a, b)
+        && same_assignments<membrane_capacitance>(a, b)
+        && same_assignments<init_membrane_potential>(a, b)
+        && same_assignments<temperature_K>(a, b)
+        && same_morphology(a.morphology(), b.morphology());
+}
+
+// Hash of the CV boundary points and the morphology geometry; cells with
+// the same discretization have the same hash.
+static std::size_t discretization_hash(const cable_cell& cell, const mlocation_list& cv_ends) {
+    const auto& m = cell.morphology();
+    std::size_t h = hash_value(m.num_branches(), cv_ends.size());
+    for (const auto& l: cv_ends) {
+        h = hash_value(h, l);
+    }
+    for (msize_t i = 0; i<m.num_branches(); ++i) {
+        for (const auto& seg: m.branch_segments(i)) {
+            h = hash_value(h, seg.dist.x, seg.dist.y, seg.dist.z, seg.dist.radius);
+        }
+    }
+    return h;
+}
+
 fvm_cv_discretization fvm_cv_discretize(const std::vector<cable_cell>& cells,
     const cable_cell_parameter_set& global_defaults,
     const arb::execution_context& ctx)
 {
-    std::vector<fvm_cv_discretization> cell_disc(cells.size());
+    std::vector<mlocation_list> cv_ends(cells.size());
+    std::vector<std::size_t> hashes(cells.size());
     threading::parallel_for::apply(0, cells.size(), ctx.thread_pool.get(),
-          [&] (int i) { cell_disc[i]=fvm_cv_discretize(cells[i], global_defaults);});
+          [&] (int i) {
+              cv_ends[i] = cv_boundary_locations(cells[i], global_defaults);
+              hashes[i] = discretization_hash(cells[i], cv_ends[i]);
+          });
+
+    // Map each cell to the first cell with the same discretization.
+    std::vector<std::size_t> cell_rep(cells.size());
+    std::vector<std::size_t> reps;
+    std::unordered_multimap<std::size_t, std::size_t> reps_by_hash;
+    for (auto i: count_along(cells)) {
+        auto [b, e] = reps_by_hash.equal_range(hashes[i]);
+        auto it = std::find_if(b, e, [&](const auto& kv) {
+            auto j = reps[kv.second];
+            return same_discretization(cells[i], cv_ends[i], cells[j], cv_ends[j]);
+        });
+        if (it!=e) {
+            cell_rep[i] = it->second;
+        }
+        else {
+            cell_rep[i] = reps.size();
+            reps_by_hash.emplace(hashes[i], reps.size());
+            reps.push_back(i);
+        }
+    }
+
+    std::vector<fvm_cv_discretization> rep_disc(reps.size());
+    threading::parallel_for::apply(0, reps.size(), ctx.thread_pool.get(),
+          [&] (int k) {
+              auto i = reps[k];
+              rep_disc[k] = fvm_cv_discretize(cells[i], global_defaults, cv_ends[i]);
+          });
+
+    // Size the combined arrays first, so that appending does not regrow
+    // them, leaving up to twice the final storage behind.
+    std::size_t n_cv = 0, n_cable = 0, n_child = 0;
+    for (auto cell_idx: count_along(cells)) {
+        const auto& d = rep_disc[cell_rep[cell_idx]];
+        n_cv += d.size();
+        n_cable += d.geometry.cv_cables.size();
+        n_child += d.geometry.cv_children.size();
+    }
 
     fvm_cv_discretization combined;
+    auto& geom = combined.geometry;
+    geom.cv_cables.reserve(n_cable);
+    geom.cv_cables_divs.reserve(n_cv+1);
+    geom.cv_parent.reserve(n_cv);
+    geom.cv_children.reserve(n_child);
+    geom.cv_children_divs.reserve(n_cv+1);
+    geom.cv_to_cell.reserve(n_cv);
+    geom.cell_cv_divs.reserve(cells.size()+1);
+    geom.branch_cv_map.reserve(cells.size());
+    for (auto* v: {&combined.face_conductance, &combined.face_area_per_length, &combined.cv_area, &combined.cv_capacitance,
+                   &combined.init_membrane_potential, &combined.temperature_K, &combined.diam_um}) {
+        v->reserve(n_cv);
+    }
+    combined.axial_resistivity.reserve(cells.size());
+
     for (auto cell_idx: count_along(cells)) {
-        append(combined, cell_disc[cell_idx]);
+        append(combined, rep_disc[cell_rep[cell_idx]]);
     }
     return combined;
 }
 
+// CV renumbering
+// --------------
+
+// New position of each CV of a cell, relative to its first CV. CVs are
+// placed so that each parent precedes its children: of the CVs whose parent
+// has been placed, the next is one with the same density mechanisms as the
+// CV placed last, if any, else the one with the least index.
+
+static std::vector<fvm_index_type> cell_cv_order(const cable_cell& cell, const fvm_cv_discretization& D, fvm_size_type cell_idx) {
+    auto [cv0, cv1] = D.geometry.cell_cv_interval(cell_idx);
+    fvm_index_type n_cv = cv1-cv0;
+    if (!n_cv) return {};
+
+    // Density mechanisms on each CV, by their order in the assignments, with
+    // the same criterion for support as in fvm_build_mechanism_data.
+    const auto& embedding = cell.embedding();
+    std::vector<std::vector<unsigned>> mechs(n_cv);
+    unsigned mech_idx = 0;
+    for (const auto& entry: cell.region_assignments().get<mechanism_desc>()) {
+        mcable_map<double> support;
+        for (auto& on_cable: entry.second) {
+            support.insert(on_cable.first, 1.);
+        }
+        for (auto i: make_span(n_cv)) {
+            for (mcable c: D.geometry.cables(cv0+i)) {
+                if (embedding.integrate_area(c.branch, pw_over_cable(support, c, 0.))) {
+                    mechs[i].push_back(mech_idx);
+                    break;
+                }
+            }
+        }
+        ++mech_idx;
+    }
+
+    std::map<std::vector<unsigned>, unsigned> signatures;
+    std::vector<unsigned> sig(n_cv);
+    for (auto i: make_span(n_cv)) {
+        sig[i] = signatures.emplace(mechs[i], signatures.size()).first->second;
+    }
+
+    std::set<fvm_index_type> ready;
+    std::vector<std::set<fvm_index_type>> ready_by_sig(signatures.size());
+    auto make_ready = [&](fvm_index_type i) {
+        ready.insert(i);
+        ready_by_sig[sig[i]].insert(i);
+    };
+
+    std::vector<fvm_index_type> position(n_cv);
+    make_ready(0);
+    unsigned last = sig[0];
+    for (fvm_index_type pos = 0; pos<n_cv; ++pos) {
+        const auto& same = ready_by_sig[last];
+        fvm_index_type i = same.empty()? *ready.begin(): *same.begin();
+        ready.erase(i);
+        ready_by_sig[sig[i]].erase(i);
+
+        position[i] = pos;
+        last = sig[i];
+        for (auto c: D.geometry.children(cv0+i)) {
+            make_ready(c-cv0);
+        }
+    }
+    return position;
+}
+
+void fvm_reorder_cvs(fvm_cv_discretization& D, const std::vector<cable_cell>& cells, const arb::execution_context& ctx) {
+    using index_type = fvm_index_type;
+    arb_assert(D.n_cell()==cells.size());
+
+    auto n_cv = D.size();
+    auto& geom = D.geometry;
+
+    // new_cv[i] is the new index of CV i, and old_cv its inverse.
+    std::vector<index_type> new_cv(n_cv);
+    threading::parallel_for::apply(0, cells.size(), ctx.thread_pool.get(),
+          [&] (int cell_idx) {
+              auto cv0 = geom.cell_cv_divs[cell_idx];
+              auto position = cell_cv_order(cells[cell_idx], D, cell_idx);
+              for (auto i: count_along(position)) {
+                  new_cv[cv0+i] = cv0+position[i];
+              }
+          });
+
+    std::vector<index_type> old_cv(n_cv);
+    for (auto i: make_span(n_cv)) {
+        old_cv[new_cv[i]] = i;
+    }
+
+    auto permute = [&old_cv](auto& v) {
+        std::remove_reference_t<decltype(v)> w;
+        w.reserve(v.size());
+        for (auto i: old_cv) {
+            w.push_back(v[i]);
+        }
+        v = std::move(w);
+    };
+
+    for (auto* v: {&D.face_conductance, &D.face_area_per_length, &D.cv_area, &D.cv_capacitance,
+                   &D.init_membrane_potential, &D.temperature_K, &D.diam_um}) {
+        permute(*v);
+    }
+
+    std::vector<mcable> cv_cables;
+    std::vector<index_type> cv_cables_divs = {0};
+    std::vector<index_type> cv_parent;
+    cv_cables.reserve(geom.cv_cables.size());
+    cv_cables_divs.reserve(n_cv+1);
+    cv_parent.reserve(n_cv);
+    for (auto i: old_cv) {
+        util::append(cv_cables, geom.cables(i));
+        cv_cables_divs.push_back(cv_cables.size());
+
+        auto p = geom.cv_parent[i];
+        cv_parent.push_back(p==-1? p: new_cv[p]);
+    }
+    geom.cv_cables = std::move(cv_cables);
+    geom.cv_cables_divs = std::move(cv_cables_divs);
+    geom.cv_parent = std::move(cv_parent);
+    set_cv_children(geom);
+
+    for (auto cell_idx: count_along(geom.branch_cv_map)) {
+        auto cv0 = geom.cell_cv_divs[cell_idx];
+        for (auto& pw: geom.branch_cv_map[cell_idx]) {
+            for (auto j: make_span(pw.size())) {
+                pw.element(j) = new_cv[cv0+pw.element(j)]-cv0;
+            }
+        }
+    }
+}
+
 // Voltage interpolation
 // ---------------------
 //
@@ -700,89 +977,215 @@ fvm_voltage_interpolant fvm_axial_current(const cable_cell& cell, const fvm_cv_d
     return vi;
 }
 
-// FVM mechanism data
-// ------------------
+// Extracellular potential response.
+//
+// The current of a CV is shared between its cables in proportion to their
+// membrane area. A line source of length L carrying current I gives, at a
+// point with offset x along the line from its proximal end and distance ρ
+// from the line,
+//
+//     φ = I/(4πσL)·(asinh((L-x)/ρ) + asinh(x/ρ)).
+//
+// Distances are bounded below by the radius of the segment, so that the
+// response of an electrode inside a cable remains finite.
 
-// CVs are absolute (taken from combined discretization) so do not need to be shifted.
-// Only target numbers need to be shifted.
+namespace {
+struct point_response {
+    double coef;
+    double operator()(const mpoint& e, const mpoint& p) const {
+        double r = std::hypot(e.x-p.x, e.y-p.y, e.z-p.z);
+        return coef/std::max(r, p.radius);
+    }
+};
 
-fvm_mechanism_data& append(fvm_mechanism_data& left, const fvm_mechanism_data& right) {
-    using util::append;
-    using impl::append_offset;
-    using impl::append_divs;
+struct line_response {
+    double coef;
+    double operator()(const mpoint& e, const msegment& s) const {
+        double dx = s.dist.x-s.prox.x, dy = s.dist.y-s.prox.y, dz = s.dist.z-s.prox.z;
+        double L = std::hypot(dx, dy, dz);
+        double radius = 0.5*(s.prox.radius+s.dist.radius);
 
-    fvm_size_type target_offset = left.n_target;
+        if (L==0) return point_response{coef}(e, {s.prox.x, s.prox.y, s.prox.z, radius});
 
-    for (const auto& kv: right.ions) {
-        fvm_ion_config& L = left.ions[kv.first];
-        const fvm_ion_config& R = kv.second;
+        double ex = e.x-s.prox.x, ey = e.y-s.prox.y, ez = e.z-s.prox.z;
+        double x = (ex*dx+ey*dy+ez*dz)/L;
+        double rho = std::sqrt(std::max(0., ex*ex+ey*ey+ez*ez-x*x));
+        rho = std::max(rho, radius);
 
-        append(L.cv, R.cv);
-        append(L.init_iconc, R.init_iconc);
-        append(L.init_econc, R.init_econc);
-        append(L.reset_iconc, R.reset_iconc);
-        append(L.reset_econc, R.reset_econc);
-        append(L.init_revpot, R.init_revpot);
+        return coef/L*(std::asinh((L-x)/rho)+std::asinh(x/rho));
     }
+};
+} // anonymous namespace
 
-    for (const auto& kv: right.mechanisms) {
-        if (!left.mechanisms.count(kv.first)) {
-            fvm_mechanism_config& L = left.mechanisms[kv.first];
-
-            L = kv.second;
-            for (auto& t: L.target) t += target_offset;
-        }
-        else {
-            fvm_mechanism_config& L = left.mechanisms[kv.first];
-            const fvm_mechanism_config& R = kv.second;
-
-            L.kind = R.kind;
-            append(L.cv, R.cv);
-            append(L.multiplicity, R.multiplicity);
-            append(L.norm_area, R.norm_area);
-            append_offset(L.target, target_offset, R.target);
-
-            arb_assert(util::equal(L.param_values, R.param_values,
-                [](auto& a, auto& b) { return a.first==b.first; }));
-            arb_assert(L.param_values.size()==R.param_values.size());
-
-            for (auto j: count_along(R.param_values)) {
-                arb_assert(L.param_values[j].first==R.param_values[j].first);
-                append(L.param_values[j].second, R.param_values[j].second);
-            }
-        }
+std::vector<std::vector<fvm_value_type>> fvm_extracellular_response(
+    const cable_cell& cell, const fvm_cv_discretization& D, fvm_size_type cell_idx,
+    const std::vector<mpoint>& electrodes, double sigma, extracellular_method method)
+{
+    if (!(sigma>0)) {
+        throw cable_cell_error(util::pprintf("extracellular conductivity {} must be positive", sigma));
     }
 
-    append(left.stimuli.cv, right.stimuli.cv);
-    append(left.stimuli.cv_unique, right.stimuli.cv_unique);
-    append(left.stimuli.frequency, right.stimuli.frequency);
-    append(left.stimuli.phase, right.stimuli.phase);
-    append(left.stimuli.envelope_time, right.stimuli.envelope_time);
-    append(left.stimuli.envelope_amplitude, right.stimuli.envelope_amplitude);
+    const auto cvs = D.geometry.cell_cvs(cell_idx);
+    const auto cv0 = D.geometry.cell_cv_interval(cell_idx).first;
+    const double coef = 1/(4*math::pi<double>*sigma); // [MΩ·µm]
 
-    left.n_target += right.n_target;
-    left.post_events |= right.post_events;
+    const auto& embedding = cell.embedding();
+    place_pwlin placement(cell.morphology());
 
-    append_divs(left.target_divs, right.target_divs);
-    arb_assert(left.n_target==left.target_divs.back());
+    std::vector<std::vector<fvm_value_type>> response(electrodes.size(), std::vector<fvm_value_type>(cvs.size()));
+    for (auto cv: cvs) {
+        double oo_cv_area = D.cv_area[cv]>0? 1./D.cv_area[cv]: 0;
 
-    return left;
+        for (auto cable: D.geometry.cables(cv)) {
+            double weight = embedding.integrate_area(cable)*oo_cv_area;
+            if (!(weight>0)) continue;
+
+            if (method==extracellular_method::point_source) {
+                mpoint mid = placement.at({cable.branch, 0.5*(cable.prox_pos+cable.dist_pos)});
+                for (auto i: util::count_along(electrodes)) {
+                    response[i][cv-cv0] += weight*point_response{coef}(electrodes[i], mid);
+                }
+            }
+            else {
+                // Segments contribute in proportion to their length.
+                auto segs = placement.all_segments(mcable_list{cable});
+                double length = 0;
+                for (auto& s: segs) {
+                    length += distance(s.prox, s.dist);
+                }
+                for (auto& s: segs) {
+                    double l = distance(s.prox, s.dist);
+                    double w = length>0? weight*l/length: weight/segs.size();
+                    for (auto i: util::count_along(electrodes)) {
+                        response[i][cv-cv0] += w*line_response{coef}(electrodes[i], s);
+                    }
+                }
+            }
+        }
+    }
+    return response;
 }
 
+// FVM mechanism data
+// ------------------
+
+// CVs are absolute (taken from combined discretization) so do not need to be shifted.
+// Only target numbers need to be shifted.
+
 fvm_mechanism_data fvm_build_mechanism_data(const cable_cell_global_properties& gprop,
     const cable_cell& cell, const fvm_cv_discretization& D, fvm_size_type cell_idx);
 
 fvm_mechanism_data fvm_build_mechanism_data(const cable_cell_global_properties& gprop,
     const std::vector<cable_cell>& cells, const fvm_cv_discretization& D, const execution_context& ctx)
 {
-    std::vector<fvm_mechanism_data> cell_mech(cells.size());
-    threading::parallel_for::apply(0, cells.size(), ctx.thread_pool.get(),
+    using util::append;
+    using impl::append_offset;
+    using impl::append_divs;
+
+    const auto n_cell = cells.size();
+    std::vector<fvm_mechanism_data> cell_mech(n_cell);
+    threading::parallel_for::apply(0, n_cell, ctx.thread_pool.get(),
           [&] (int i) { cell_mech[i]=fvm_build_mechanism_data(gprop, cells[i], D, i);});
 
+    // Per-cell data are merged with one task per mechanism and per ion. The
+    // entries of the combined maps are created up front, so that the tasks
+    // only touch their own entry.
+
     fvm_mechanism_data combined;
-    for (auto cell_idx: count_along(cells)) {
-        append(combined, cell_mech[cell_idx]);
+    std::vector<std::size_t> target_offset(n_cell);
+    for (auto cell_idx: make_span(n_cell)) {
+        const auto& R = cell_mech[cell_idx];
+        target_offset[cell_idx] = combined.n_target;
+
+        for (const auto& kv: R.mechanisms) combined.mechanisms[kv.first];
+        for (const auto& kv: R.ions) combined.ions[kv.first];
+
+        append(combined.stimuli.cv, R.stimuli.cv);
+        append(combined.stimuli.cv_unique, R.stimuli.cv_unique);
+        append(combined.stimuli.frequency, R.stimuli.frequency);
+        append(combined.stimuli.phase, R.stimuli.phase);
+        append(combined.stimuli.envelope_time, R.stimuli.envelope_time);
+        append(combined.stimuli.envelope_amplitude, R.stimuli.envelope_amplitude);
+
+        combined.n_target += R.n_target;
+        combined.post_events |= R.post_events;
+        append_divs(combined.target_divs, R.target_divs);
     }
+    arb_assert(combined.n_target==(combined.target_divs.empty()? 0: combined.target_divs.back()));
+
+    std::vector<std::pair<const std::string*, fvm_mechanism_config*>> mechs;
+    for (auto& kv: combined.mechanisms) mechs.push_back({&kv.first, &kv.second});
+
+    threading::parallel_for::apply(0, mechs.size(), ctx.thread_pool.get(),
+        [&](int m) {
+            const std::string& name = *mechs[m].first;
+            fvm_mechanism_config& L = *mechs[m].second;
+
+            std::size_t n_cv = 0, n_target = 0;
+            for (const auto& cm: cell_mech) {
+                auto it = cm.mechanisms.find(name);
+                if (it==cm.mechanisms.end()) continue;
+                n_cv += it->second.cv.size();
+                n_target += it->second.target.size();
+            }
+
+            bool first = true;
+            for (auto cell_idx: make_span(n_cell)) {
+                auto it = cell_mech[cell_idx].mechanisms.find(name);
+                if (it==cell_mech[cell_idx].mechanisms.end()) continue;
+                const fvm_mechanism_config& R = it->second;
+
+                if (first) {
+                    first = false;
+                    L.param_values.reserve(R.param_values.size());
+                    for (const auto& pv: R.param_values) {
+                        L.param_values.push_back({pv.first, {}});
+                        L.param_values.back().second.reserve(n_cv);
+                    }
+                    L.cv.reserve(n_cv);
+                    if (!R.multiplicity.empty()) L.multiplicity.reserve(n_cv);
+                    if (!R.norm_area.empty()) L.norm_area.reserve(n_cv);
+                    L.target.reserve(n_target);
+                }
+
+                L.kind = R.kind;
+                append(L.cv, R.cv);
+                append(L.multiplicity, R.multiplicity);
+                append(L.norm_area, R.norm_area);
+                append_offset(L.target, target_offset[cell_idx], R.target);
+
+                arb_assert(L.param_values.size()==R.param_values.size());
+                for (auto j: count_along(R.param_values)) {
+                    arb_assert(L.param_values[j].first==R.param_values[j].first);
+                    append(L.param_values[j].second, R.param_values[j].second);
+                }
+            }
+        });
+
+    std::vector<std::pair<const std::string*, fvm_ion_config*>> ions;
+    for (auto& kv: combined.ions) ions.push_back({&kv.first, &kv.second});
+
+    threading::parallel_for::apply(0, ions.size(), ctx.thread_pool.get(),
+        [&](int k) {
+            const std::string& name = *ions[k].first;
+            fvm_ion_config& L = *ions[k].second;
+
+            for (const auto& cm: cell_mech) {
+                auto it = cm.ions.find(name);
+                if (it==cm.ions.end()) continue;
+                const fvm_ion_config& R = it->second;
+
+                append(L.cv, R.cv);
+                append(L.init_iconc, R.init_iconc);
+                append(L.init_econc, R.init_econc);
+                append(L.reset_iconc, R.reset_iconc);
+                append(L.reset_econc, R.reset_econc);
+                append(L.init_revpot, R.init_revpot);
+                append(L.diffusivity, R.diffusivity);
+                L.constant_concentration &= R.constant_concentration;
+            }
+        });
+
     return combined;
 }
 
@@ -1155,12 +1558,25 @@ fvm_mechanism_data fvm_build_mechanism_data(const cable_cell_global_properties&
         auto dflt_iconc = global_ion_data.init_int_concentration.value();
         auto dflt_econc = global_ion_data.init_ext_concentration.value();
         auto dflt_rvpot = global_ion_data.init_reversal_potential.value();
+        auto diffusivity = global_ion_data.diffusivity.value_or(0.);
 
         if (auto ion_data = value_by_key(dflt.ion_data, ion)) {
             dflt_iconc = ion_data.value().init_int_concentration.value_or(dflt_iconc);
             dflt_econc = ion_data.value().init_ext_concentration.value_or(dflt_econc);
             dflt_rvpot = ion_data.value().init_reversal_potential.value_or(dflt_rvpot);
+            diffusivity = ion_data.value().diffusivity.value_or(diffusivity);
+        }
+
+        // A diffusing concentration is integrated from the ionic current,
+        // and cannot also be set by mechanisms.
+        if (diffusivity<0) {
+            throw cable_cell_error("negative diffusivity for ion "+ion);
+        }
+        if (diffusivity>0 && !init_iconc_mask[ion].empty()) {
+            throw cable_cell_error("ion "+ion+" diffuses, and its internal concentration cannot be written by a mechanism");
         }
+        config.diffusivity.assign(n_cv, diffusivity);
+        config.constant_concentration = diffusivity==0 && init_iconc_mask[ion].empty() && init_econc_mask[ion].empty();
 
         const mcable_map<init_int_concentration>&  iconc_on_cable = initial_iconc_map[ion];
         const mcable_map<init_ext_concentration>&  econc_on_cable = initial_econc_map[ion];
@@ -1282,4 +1698,425 @@ fvm_mechanism_data fvm_build_mechanism_data(const cable_cell_global_properties&
     return M;
 }
 
+// Serialization of lowered cell group data
+// ----------------------------------------
+
+namespace {
+    template <typename X>
+    void serialize_pw(io::serializer& out, const util::pw_elements<X>& pw) {
+        out.array(pw.vertices());
+        out.array(pw.elements());
+    }
+
+    template <typename X>
+    void deserialize_pw(io::deserializer& in, util::pw_elements<X>& pw) {
+        std::vector<double> vertices;
+        std::vector<X> elements;
+        in.vector(vertices);
+        in.vector(elements);
+        pw.assign(vertices, elements);
+    }
+
+    // Maps are written in key order.
+    template <typename Map>
+    std::vector<typename Map::key_type> sorted_keys(const Map& m) {
+        std::vector<typename Map::key_type> keys;
+        assign(keys, util::keys(m));
+        sort(keys);
+        return keys;
+    }
+} // anonymous namespace
+
+void serialize(io::serializer& out, const fvm_cv_discretization& D) {
+    const auto& g = D.geometry;
+    out.array(g.cv_cables);
+    out.array(g.cv_cables_divs);
+    out.array(g.cv_parent);
+    out.array(g.cv_children);
+    out.array(g.cv_children_divs);
+    out.array(g.cv_to_cell);
+    out.array(g.cell_cv_divs);
+
+    out.value<std::uint64_t>(g.branch_cv_map.size());
+    for (const auto& cell_map: g.branch_cv_map) {
+        out.value<std::uint64_t>(cell_map.size());
+        for (const auto& pw: cell_map) serialize_pw(out, pw);
+    }
+
+    for (auto* v: {&D.face_conductance, &D.face_area_per_length, &D.cv_area, &D.cv_capacitance,
+                   &D.init_membrane_potential, &D.temperature_K, &D.diam_um}) {
+        out.array(*v);
+    }
+
+    out.value<std::uint64_t>(D.axial_resistivity.size());
+    for (const auto& cell_fns: D.axial_resistivity) {
+        out.value<std::uint64_t>(cell_fns.size());
+        for (const auto& pw: cell_fns) serialize_pw(out, pw);
+    }
+}
+
+void deserialize(io::deserializer& in, fvm_cv_discretization& D) {
+    auto& g = D.geometry;
+    in.vector(g.cv_cables);
+    in.vector(g.cv_cables_divs);
+    in.vector(g.cv_parent);
+    in.vector(g.cv_children);
+    in.vector(g.cv_children_divs);
+    in.vector(g.cv_to_cell);
+    in.vector(g.cell_cv_divs);
+
+    g.branch_cv_map.resize(in.value<std::uint64_t>());
+    for (auto& cell_map: g.branch_cv_map) {
+        cell_map.resize(in.value<std::uint64_t>());
+        for (auto& pw: cell_map) deserialize_pw(in, pw);
+    }
+
+    for (auto* v: {&D.face_conductance, &D.face_area_per_length, &D.cv_area, &D.cv_capacitance,
+                   &D.init_membrane_potential, &D.temperature_K, &D.diam_um}) {
+        in.vector(*v);
+    }
+
+    D.axial_resistivity.resize(in.value<std::uint64_t>());
+    for (auto& cell_fns: D.axial_resistivity) {
+        cell_fns.resize(in.value<std::uint64_t>());
+        for (auto& pw: cell_fns) deserialize_pw(in, pw);
+    }
+}
+
+void serialize(io::serializer& out, const fvm_mechanism_data& M) {
+    out.value<std::uint64_t>(M.mechanisms.size());
+    for (const auto& name: sorted_keys(M.mechanisms)) {
+        const auto& config = M.mechanisms.at(name);
+        out.string(name);
+        out.value(config.kind);
+        out.array(config.cv);
+        out.array(config.multiplicity);
+        out.array(config.norm_area);
+        out.array(config.target);
+
+        out.value<std::uint64_t>(config.param_values.size());
+        for (const auto& [param, values]: config.param_values) {
+            out.string(param);
+            out.array(values);
+        }
+    }
+
+    out.value<std::uint64_t>(M.ions.size());
+    for (const auto& name: sorted_keys(M.ions)) {
+        const auto& config = M.ions.at(name);
+        out.string(name);
+        for (auto* v: {&config.init_iconc, &config.init_econc, &config.reset_iconc,
+                       &config.reset_econc, &config.init_revpot, &config.diffusivity}) {
+            out.array(*v);
+        }
+        out.array(config.cv);
+        out.value<std::uint8_t>(config.constant_concentration);
+    }
+
+    const auto& stim = M.stimuli;
+    out.array(stim.cv);
+    out.array(stim.cv_unique);
+    out.array(stim.frequency);
+    out.array(stim.phase);
+    for (auto* envelopes: {&stim.envelope_time, &stim.envelope_amplitude}) {
+        out.value<std::uint64_t>(envelopes->size());
+        for (const auto& e: *envelopes) out.array(e);
+    }
+
+    out.value<std::uint64_t>(M.n_target);
+    out.array(M.target_divs);
+    out.value<char>(M.post_events);
+}
+
+void deserialize(io::deserializer& in, fvm_mechanism_data& M) {
+    M.mechanisms.clear();
+    for (auto n = in.value<std::uint64_t>(); n; --n) {
+        auto& config = M.mechanisms[in.string()];
+        in.value(config.kind);
+        in.vector(config.cv);
+        in.vector(config.multiplicity);
+        in.vector(config.norm_area);
+        in.vector(config.target);
+
+        config.param_values.resize(in.value<std::uint64_t>());
+        for (auto& [param, values]: config.param_values) {
+            param = in.string();
+            in.vector(values);
+        }
+    }
+
+    M.ions.clear();
+    for (auto n = in.value<std::uint64_t>(); n; --n) {
+        auto& config = M.ions[in.string()];
+        for (auto* v: {&config.init_iconc, &config.init_econc, &config.reset_iconc,
+                       &config.reset_econc, &config.init_revpot, &config.diffusivity}) {
+            in.vector(*v);
+        }
+        in.vector(config.cv);
+        config.constant_concentration = in.value<std::uint8_t>();
+    }
+
+    auto& stim = M.stimuli;
+    in.vector(stim.cv);
+    in.vector(stim.cv_unique);
+    in.vector(stim.frequency);
+    in.vector(stim.phase);
+    for (auto* envelopes: {&stim.envelope_time, &stim.envelope_amplitude}) {
+        envelopes->resize(in.value<std::uint64_t>());
+        for (auto& e: *envelopes) in.vector(e);
+    }
+
+    M.n_target = in.value<std::uint64_t>();
+    in.vector(M.target_divs);
+    M.post_events = in.value<char>();
+}
+
+// Each cache entry starts with the format version, the gids of the group and
+// the key of the cells and properties it was built from.
+
+constexpr std::uint32_t lowered_cache_version = 4;
+
+namespace {
+    // FNV-1a over the bytes of the values, stable across runs unlike
+    // std::hash.
+    struct lowered_key_hasher {
+        std::uint64_t h = 0xcbf29ce484222325;
+
+        void bytes(const void* p, std::size_t n) {
+            auto c = static_cast<const unsigned char*>(p);
+            for (std::size_t i = 0; i<n; ++i) {
+                h = (h^c[i])*0x100000001b3;
+            }
+        }
+
+        template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T> || std::is_enum_v<T>>>
+        void operator()(T x) { bytes(&x, sizeof x); }
+
+        void operator()(const std::string& s) {
+            (*this)(s.size());
+            bytes(s.data(), s.size());
+        }
+
+        void operator()(const std::optional<double>& x) {
+            (*this)(bool(x));
+            if (x) (*this)(*x);
+        }
+
+        void operator()(const mlocation& loc) {
+            (*this)(loc.branch);
+            (*this)(loc.pos);
+        }
+
+        void operator()(const mcable& c) {
+            (*this)(c.branch);
+            (*this)(c.prox_pos);
+            (*this)(c.dist_pos);
+        }
+
+        void operator()(const mpoint& p) {
+            (*this)(p.x);
+            (*this)(p.y);
+            (*this)(p.z);
+            (*this)(p.radius);
+        }
+
+        void operator()(const mechanism_desc& m) {
+            (*this)(m.name());
+            for (const auto& k: sorted_keys(m.values())) {
+                (*this)(k);
+                (*this)(m.values().at(k));
+            }
+        }
+
+        template <typename T>
+        void value(const T& x) {
+            if constexpr (std::is_same_v<T, i_clamp>) {
+                (*this)(x.envelope.size());
+                for (const auto& e: x.envelope) {
+                    (*this)(e.t);
+                    (*this)(e.amplitude);
+                }
+                (*this)(x.frequency);
+                (*this)(x.phase);
+            }
+            else if constexpr (std::is_same_v<T, threshold_detector>) {
+                (*this)(x.threshold);
+            }
+            else if constexpr (std::is_same_v<T, mechanism_desc>) {
+                (*this)(x);
+            }
+            else if constexpr (!std::is_same_v<T, gap_junction_site>) {
+                (*this)(x.value);
+            }
+        }
+
+        template <typename T>
+        void operator()(const mcable_map<T>& m) {
+            (*this)(m.size());
+            for (const auto& [c, x]: m) {
+                (*this)(c);
+                value(x);
+            }
+        }
+
+        template <typename T>
+        void operator()(const mlocation_map<T>& m) {
+            (*this)(m.size());
+            for (const auto& p: m) {
+                (*this)(p.loc);
+                (*this)(p.lid);
+                value(p.item);
+            }
+        }
+
+        template <typename T>
+        void operator()(const std::unordered_map<std::string, T>& m) {
+            (*this)(m.size());
+            for (const auto& k: sorted_keys(m)) {
+                (*this)(k);
+                (*this)(m.at(k));
+            }
+        }
+
+        void operator()(const cable_cell_ion_data& d) {
+            (*this)(d.init_int_concentration);
+            (*this)(d.init_ext_concentration);
+            (*this)(d.init_reversal_potential);
+            (*this)(d.diffusivity);
+        }
+
+        // The CV policy is accounted for by the CV boundaries of each cell.
+        void operator()(const cable_cell_parameter_set& p) {
+            (*this)(p.init_membrane_potential);
+            (*this)(p.temperature_K);
+            (*this)(p.axial_resistivity);
+            (*this)(p.membrane_capacitance);
+            (*this)(p.ion_data);
+            (*this)(p.reversal_potential_method);
+        }
+
+        void operator()(const mechanism_field_spec& f) {
+            (*this)(f.default_value);
+            (*this)(f.lower_bound);
+            (*this)(f.upper_bound);
+        }
+
+        void operator()(const ion_dependency& d) {
+            (*this)(d.write_concentration_int);
+            (*this)(d.write_concentration_ext);
+            (*this)(d.read_reversal_potential);
+            (*this)(d.write_reversal_potential);
+            (*this)(d.read_ion_charge);
+            (*this)(d.verify_ion_charge);
+            (*this)(d.expected_ion_charge);
+        }
+
+        void operator()(const mechanism_info& info) {
+            (*this)(info.fingerprint);
+            (*this)(info.globals);
+            (*this)(info.parameters);
+            (*this)(info.state);
+            (*this)(info.ions);
+            (*this)(info.random_variables.size());
+            for (const auto& v: info.random_variables) (*this)(v);
+            (*this)(info.linear);
+            (*this)(info.post_events);
+        }
+    };
+} // anonymous namespace
+
+std::uint64_t fvm_lowered_key(const cable_cell_global_properties& gprop, const std::vector<cable_cell>& cells) {
+    lowered_key_hasher hash;
+    hash(lowered_cache_version);
+
+    hash(gprop.default_parameters);
+    hash(gprop.ion_species);
+    hash(gprop.coalesce_synapses);
+    hash(gprop.reorder_cvs);
+
+    auto names = gprop.catalogue->mechanism_names();
+    sort(names);
+    for (const auto& name: names) {
+        hash(name);
+        hash((*gprop.catalogue)[name]);
+    }
+
+    hash(cells.size());
+    for (const auto& cell: cells) {
+        const auto& m = cell.morphology();
+        hash(m.num_branches());
+        for (auto b: util::make_span(m.num_branches())) {
+            hash(m.branch_parent(b));
+            hash(m.branch_segments(b).size());
+            for (const auto& seg: m.branch_segments(b)) {
+                hash(seg.prox);
+                hash(seg.dist);
+                hash(seg.tag);
+            }
+        }
+
+        auto cv_ends = cv_boundary_locations(cell, gprop.default_parameters);
+        hash(cv_ends.size());
+        for (const auto& loc: cv_ends) hash(loc);
+
+        hash(cell.default_parameters());
+
+        const auto& paint = cell.region_assignments();
+        hash(paint.get<mechanism_desc>());
+        hash(paint.get<init_membrane_potential>());
+        hash(paint.get<axial_resistivity>());
+        hash(paint.get<temperature_K>());
+        hash(paint.get<membrane_capacitance>());
+        hash(paint.get<init_int_concentration>());
+        hash(paint.get<init_ext_concentration>());
+        hash(paint.get<init_reversal_potential>());
+
+        const auto& place = cell.location_assignments();
+        hash(place.get<mechanism_desc>());
+        hash(place.get<i_clamp>());
+        hash(place.get<gap_junction_site>());
+        hash(place.get<threshold_detector>());
+    }
+    return hash.h;
+}
+
+static std::string lowered_cache_file(const std::string& dir, const std::vector<cell_gid_type>& gids) {
+    return dir+"/group_"+std::to_string(gids.empty()? 0: gids.front())+"_"+std::to_string(gids.size())+".bin";
+}
+
+bool fvm_read_lowered(const std::string& dir, const std::vector<cell_gid_type>& gids, std::uint64_t key,
+    fvm_cv_discretization& D, fvm_mechanism_data& M)
+{
+    std::ifstream file(lowered_cache_file(dir, gids), std::ios::binary);
+    if (!file) return false;
+
+    io::deserializer in(file);
+    std::vector<cell_gid_type> entry_gids;
+    if (in.value<std::uint32_t>()!=lowered_cache_version) return false;
+    in.vector(entry_gids);
+    if (entry_gids!=gids) return false;
+    if (in.value<std::uint64_t>()!=key) return false;
+
+    deserialize(in, D);
+    deserialize(in, M);
+    return true;
+}
+
+void fvm_write_lowered(const std::string& dir, const std::vector<cell_gid_type>& gids, std::uint64_t key,
+    const fvm_cv_discretization& D, const fvm_mechanism_data& M)
+{
+    std::ofstream file(lowered_cache_file(dir, gids), std::ios::binary);
+    if (!file) {
+        throw file_not_found_error(lowered_cache_file(dir, gids));
+    }
+
+    io::serializer out(file);
+    out.value(lowered_cache_version);
+    out.array(gids);
+    out.value(key);
+
+    serialize(out, D);
+    serialize(out, M);
+}
+
 } // namespace arb
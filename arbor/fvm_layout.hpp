@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+#include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -17,6 +19,11 @@
 
 namespace arb {
 
+namespace io {
+class serializer;
+class deserializer;
+} // namespace io
+
 // CV geometry as determined by per-cell CV boundary points.
 //
 // Details of CV cable representation:
@@ -184,6 +191,7 @@ struct fvm_cv_discretization {
 
     // Following members have one element per CV.
     std::vector<value_type> face_conductance; // [µS]
+    std::vector<value_type> face_area_per_length; // [µm] cross-section area over length of the face, for diffusion
     std::vector<value_type> cv_area;          // [µm²]
     std::vector<value_type> cv_capacitance;   // [pF]
     std::vector<value_type> init_membrane_potential; // [mV]
@@ -202,6 +210,12 @@ fvm_cv_discretization& append(fvm_cv_discretization&, const fvm_cv_discretizatio
 fvm_cv_discretization fvm_cv_discretize(const cable_cell& cell, const cable_cell_parameter_set& global_dflt);
 fvm_cv_discretization fvm_cv_discretize(const std::vector<cable_cell>& cells, const cable_cell_parameter_set& global_defaults, const arb::execution_context& ctx={});
 
+// Renumber the CVs of each cell in place, so that CVs with the same density
+// mechanisms are adjacent where the tree allows, with each parent CV still
+// before its children. The supports of the mechanisms are then more often
+// contiguous ranges of CVs.
+void fvm_reorder_cvs(fvm_cv_discretization& D, const std::vector<cable_cell>& cells, const arb::execution_context& ctx={});
+
 
 // Interpolant data for voltage, axial current probes.
 //
@@ -219,6 +233,14 @@ fvm_voltage_interpolant fvm_interpolate_voltage(const cable_cell& cell, const fv
 // Axial current as linear combiantion of voltages.
 fvm_voltage_interpolant fvm_axial_current(const cable_cell& cell, const fvm_cv_discretization& D, fvm_size_type cell_idx, mlocation site);
 
+// Response of the extracellular potential at each electrode [mV] to the
+// membrane current of each CV of a cell [nA], in a medium of conductivity
+// sigma [S/m]: the result is indexed by electrode and then by CV, relative to
+// the first CV of the cell.
+std::vector<std::vector<fvm_value_type>> fvm_extracellular_response(
+    const cable_cell& cell, const fvm_cv_discretization& D, fvm_size_type cell_idx,
+    const std::vector<mpoint>& electrodes, double sigma, extracellular_method method);
+
 
 // Post-discretization data for point and density mechanism instantiation.
 
@@ -265,6 +287,15 @@ struct fvm_ion_config {
 
     // Ion-specific (initial) reversal potential per CV.
     std::vector<value_type> init_revpot;
+
+    // Longitudinal diffusivity of the internal concentration per CV [m²/s];
+    // zero where the ion does not diffuse.
+    std::vector<value_type> diffusivity;
+
+    // Set if no mechanism writes the internal or external concentration and
+    // the ion does not diffuse, so that the concentrations, and hence the
+    // reversal potential, keep their initial values.
+    bool constant_concentration = true;
 };
 
 struct fvm_stimulus_config {
@@ -285,6 +316,30 @@ struct fvm_stimulus_config {
     std::vector<std::vector<double>> envelope_amplitude; // [A/m²]
 };
 
+// Stochastic inputs, grouped by the target instance they apply to: the inputs
+// of instance i are those in [instance_divs[i], instance_divs[i+1]), and the
+// instances are sorted by mechanism id and then by index.
+struct fvm_stochastic_input_config {
+    using value_type = fvm_value_type;
+    using index_type = fvm_index_type;
+
+    // Target instance.
+    std::vector<arb_size_type> mech_id;
+    std::vector<arb_size_type> mech_index;
+    std::vector<index_type> instance_divs;
+
+    // Integration domain, parameters and generator key, per input.
+    std::vector<index_type> intdom;
+    std::vector<value_type> weight;
+    std::vector<value_type> rate;   // [kHz]
+    std::vector<value_type> tstart; // [ms]
+    std::vector<value_type> tstop;  // [ms]
+    std::vector<std::uint64_t> seed;
+    std::vector<std::uint64_t> stream;
+
+    bool empty() const { return mech_id.empty(); }
+};
+
 struct fvm_mechanism_data {
     // Mechanism config, indexed by mechanism name.
     std::unordered_map<std::string, fvm_mechanism_config> mechanisms;
@@ -307,4 +362,26 @@ struct fvm_mechanism_data {
 
 fvm_mechanism_data fvm_build_mechanism_data(const cable_cell_global_properties& gprop, const std::vector<cable_cell>& cells, const fvm_cv_discretization& D, const arb::execution_context& ctx={});
 
+// Write and read the discretization and mechanism data of a cell group.
+
+void serialize(io::serializer&, const fvm_cv_discretization&);
+void deserialize(io::deserializer&, fvm_cv_discretization&);
+
+void serialize(io::serializer&, const fvm_mechanism_data&);
+void deserialize(io::deserializer&, fvm_mechanism_data&);
+
+// Cache of the discretization and mechanism data of cell groups in the
+// directory `dir`, with one file per group. Each entry records the key
+// fvm_lowered_key() of the cells and global properties it was built from;
+// fvm_read_lowered() returns false if there is no entry for a group with these
+// gids, or if its key differs from `key`.
+
+std::uint64_t fvm_lowered_key(const cable_cell_global_properties& gprop, const std::vector<cable_cell>& cells);
+
+bool fvm_read_lowered(const std::string& dir, const std::vector<cell_gid_type>& gids, std::uint64_t key,
+    fvm_cv_discretization& D, fvm_mechanism_data& M);
+
+void fvm_write_lowered(const std::string& dir, const std::vector<cell_gid_type>& gids, std::uint64_t key,
+    const fvm_cv_discretization& D, const fvm_mechanism_data& M);
+
 } // namespace arb
@@ -11,13 +11,17 @@
 #include <arbor/common_types.hpp>
 #include <arbor/cable_cell.hpp>
 #include <arbor/fvm_types.hpp>
+#include <arbor/memory_footprint.hpp>
 #include <arbor/morph/primitives.hpp>
 #include <arbor/recipe.hpp>
+#include <arbor/sampling.hpp>
+#include <arbor/spike.hpp>
 #include <arbor/util/any_ptr.hpp>
 
 #include "backends/event.hpp"
 #include "backends/threshold_crossing.hpp"
 #include "execution_context.hpp"
+#include "io/serialize.hpp"
 #include "sampler_map.hpp"
 #include "util/meta.hpp"
 #include "util/range.hpp"
@@ -31,6 +35,11 @@ struct fvm_integration_result {
     util::range<const fvm_value_type*> sample_value;
 };
 
+struct fvm_sample_result {
+    util::range<const fvm_value_type*> sample_time;
+    util::range<const fvm_value_type*> sample_value;
+};
+
 // A sample for a probe may be derived from multiple 'raw' sampled
 // values from the backend.
 
@@ -126,6 +135,29 @@ struct fvm_probe_membrane_currents {
     util::any_ptr get_metadata_ptr() const { return &metadata; }
 };
 
+// Weighted sums of values in the back end, which are computed there before
+// samples are taken, so that only the sums are sampled: sum i is the sum of
+// weight[k]·*terms[k] for k in [term_divs[i], term_divs[i+1]). Once the
+// back end is configured with the sums, the raw handles refer to them and
+// the terms are discarded.
+struct fvm_probe_reduction {
+    std::vector<probe_handle> raw_handles;
+    std::vector<probe_handle> terms;
+    std::vector<fvm_value_type> weight;
+    std::vector<fvm_index_type> term_divs;
+    std::vector<mpoint> metadata;
+
+    void shrink_to_fit() {
+        raw_handles.shrink_to_fit();
+        terms.shrink_to_fit();
+        weight.shrink_to_fit();
+        term_divs.shrink_to_fit();
+        metadata.shrink_to_fit();
+    }
+
+    util::any_ptr get_metadata_ptr() const { return &metadata; }
+};
+
 struct missing_probe_info {
     // dummy data...
     std::array<probe_handle, 0> raw_handles;
@@ -142,6 +174,7 @@ struct fvm_probe_data {
     fvm_probe_data(fvm_probe_weighted_multi p): info(std::move(p)) {}
     fvm_probe_data(fvm_probe_interpolated_multi p): info(std::move(p)) {}
     fvm_probe_data(fvm_probe_membrane_currents p): info(std::move(p)) {}
+    fvm_probe_data(fvm_probe_reduction p): info(std::move(p)) {}
 
     std::variant<
         missing_probe_info,
@@ -150,7 +183,8 @@ struct fvm_probe_data {
         fvm_probe_multi,
         fvm_probe_weighted_multi,
         fvm_probe_interpolated_multi,
-        fvm_probe_membrane_currents
+        fvm_probe_membrane_currents,
+        fvm_probe_reduction
     > info = missing_probe_info{};
 
     auto raw_handle_range() const {
@@ -193,6 +227,21 @@ struct probe_association_map {
     }
 };
 
+// An accumulator of the values of a probe handle in one integration domain,
+// for a sampler with a decimating sampling policy.
+struct fvm_accumulator {
+    probe_handle source;
+    fvm_index_type intdom;
+    sampling_policy op;
+};
+
+// A ring buffer of the values of a probe handle in one integration domain at
+// recent steps, for a triggered sampler.
+struct fvm_sample_ring {
+    probe_handle source;
+    fvm_index_type intdom;
+};
+
 struct fvm_initialization_data {
     // Map from gid to integration domain id
     std::vector<fvm_index_type> cell_to_intdom;
@@ -225,11 +274,69 @@ struct fvm_lowered_cell {
     virtual fvm_integration_result integrate(
         fvm_value_type tfinal,
         fvm_value_type max_dt,
-        std::vector<deliverable_event> staged_events,
-        std::vector<sample_event> staged_samples) = 0;
+        const std::vector<deliverable_event>& staged_events,
+        const std::vector<sample_event>& staged_samples) = 0;
 
     virtual fvm_value_type time() const = 0;
 
+    // Write and restore the state of the cells between calls to integrate(),
+    // for checkpointing.
+    virtual void serialize(io::serializer&) = 0;
+    virtual void deserialize(io::deserializer&) = 0;
+
+    // A back end may generate deliverable events from spikes itself, in
+    // which case it is given the connections onto its targets once, and
+    // then the global spikes of each exchange. The events of these
+    // connections are then not staged with integrate().
+    virtual bool delivers_spikes() const { return false; }
+    virtual void set_spike_connections(std::vector<target_connection>) {}
+    virtual void set_spike_binning_policy(binning_kind, fvm_value_type) {}
+    virtual void enqueue_spikes(std::shared_ptr<const std::vector<spike>>) {}
+
+    // With a positive gap_junction_interval, gap junctions may have peers in
+    // other cell groups. remote_gap_junction_peers() gives these peers, in
+    // the order in which set_remote_gap_junction_voltages() takes their
+    // voltages. The sites of the cells whose voltages other groups require
+    // are set once, as (gid, index of the site on the cell), and their
+    // voltages appended in that order by published_gap_junction_voltages().
+    virtual std::vector<cell_global_label_type> remote_gap_junction_peers() const { return {}; }
+    virtual void set_published_gap_junction_sites(const std::vector<cell_member_type>&) {}
+    virtual void published_gap_junction_voltages(std::vector<fvm_value_type>&) const {}
+    virtual void set_remote_gap_junction_voltages(const std::vector<fvm_value_type>&) {}
+
+    // Whether integration steps end at event times, or events are applied
+    // at the start of the step in which they fall.
+    virtual void set_event_delivery(event_delivery_kind) = 0;
+
+    // A back end may also retain the samples of several calls to integrate(),
+    // for which returning samples every call is costly. The offsets of the
+    // samples staged with each call then continue from those of the previous
+    // call, integrate() returns no samples, and take_samples() returns all
+    // samples held, indexed by offset, and empties the buffer.
+    // sample_buffer_size() is the number of samples that a caller should let
+    // accumulate before taking them; zero if integrate() returns samples.
+    virtual fvm_size_type sample_buffer_size() const { return 0; }
+    virtual fvm_sample_result take_samples() { return {}; }
+
+    // Replace all accumulators, returning a handle to the value of each.
+    // Sampling an accumulator through its handle gives the summary of the
+    // source values over the steps since it was last sampled, and restarts
+    // it.
+    virtual std::vector<probe_handle> set_accumulators(const std::vector<fvm_accumulator>&) = 0;
+
+    // Replace all sample rings with rings that hold the values of their
+    // sources at the start of each of the last `capacity` steps. The values
+    // of ring i with times in [t0, t1] are appended to `times` and `values`
+    // by read_sample_ring(), in order of time.
+    virtual void set_sample_rings(const std::vector<fvm_sample_ring>&, fvm_size_type capacity) = 0;
+    virtual void read_sample_ring(std::size_t i, fvm_value_type t0, fvm_value_type t1,
+                                  std::vector<fvm_value_type>& times, std::vector<fvm_value_type>& values) = 0;
+
+    // Bytes held by the state of the cells, including the mechanisms and the
+    // linear system, and by the buffers of samples.
+    virtual memory_use state_memory() const { return {}; }
+    virtual memory_use sample_memory() const { return {}; }
+
     virtual ~fvm_lowered_cell() {}
 };
 
@@ -7,12 +7,17 @@
 // implementation details may be tested in the unit tests.
 // It should otherwise only be used in `fvm_lowered_cell.cpp`.
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <functional>
 #include <iterator>
 #include <memory>
 #include <optional>
 #include <queue>
+#include <sstream>
 #include <stdexcept>
+#include <tuple>
 #include <utility>
 #include <vector>
 #include <unordered_set>
@@ -20,14 +25,18 @@
 #include <arbor/assert.hpp>
 #include <arbor/common_types.hpp>
 #include <arbor/cable_cell_param.hpp>
+#include <arbor/mechcat.hpp>
 #include <arbor/recipe.hpp>
 #include <arbor/util/any_visitor.hpp>
+#include <arbor/util/scope_exit.hpp>
 
+#include "backends/stochastic_input.hpp"
 #include "execution_context.hpp"
 #include "fvm_layout.hpp"
 #include "fvm_lowered_cell.hpp"
 #include "label_resolution.hpp"
 #include "matrix.hpp"
+#include "memory/copy.hpp"
 #include "profile/profiler_macro.hpp"
 #include "sampler_map.hpp"
 #include "util/maputil.hpp"
@@ -47,7 +56,11 @@ public:
     using index_type = fvm_index_type;
     using size_type = fvm_size_type;
 
-    fvm_lowered_cell_impl(execution_context ctx): context_(ctx), threshold_watcher_(ctx) {};
+    fvm_lowered_cell_impl(execution_context ctx):
+        context_(ctx),
+        gpu_stream_(ctx.gpu->has_gpu()? ctx.gpu->acquire_stream(): 0),
+        threshold_watcher_(ctx)
+    {};
 
     void reset() override;
 
@@ -58,25 +71,60 @@ public:
     fvm_integration_result integrate(
         value_type tfinal,
         value_type max_dt,
-        std::vector<deliverable_event> staged_events,
-        std::vector<sample_event> staged_samples) override;
+        const std::vector<deliverable_event>& staged_events,
+        const std::vector<sample_event>& staged_samples) override;
 
     std::vector<fvm_gap_junction> fvm_gap_junctions(
         const std::vector<cable_cell>& cells,
         const std::vector<cell_gid_type>& gids,
         const cell_label_range& gj_data,
         const recipe& rec,
-        const fvm_cv_discretization& D);
+        const fvm_cv_discretization& D,
+        bool remote_peers = false);
 
     // Generates indom index for every gid, guarantees that gids belonging to the same supercell are in the same intdom
     // Fills cell_to_intdom map; returns number of intdoms
+    // With remote_peers, gap junctions with peers outside gids are ignored
+    // rather than rejected.
     fvm_size_type fvm_intdom(
         const recipe& rec,
         const std::vector<cell_gid_type>& gids,
-        std::vector<fvm_index_type>& cell_to_intdom);
+        std::vector<fvm_index_type>& cell_to_intdom,
+        bool remote_peers = false);
 
     value_type time() const override { return tmin_; }
 
+    void serialize(io::serializer& out) override;
+    void deserialize(io::deserializer& in) override;
+
+    bool delivers_spikes() const override { return (bool)spike_delivery_; }
+    void set_spike_connections(std::vector<target_connection> connections) override;
+    void set_spike_binning_policy(binning_kind policy, value_type bin_interval) override;
+    void enqueue_spikes(std::shared_ptr<const std::vector<spike>> spikes) override;
+
+    std::vector<cell_global_label_type> remote_gap_junction_peers() const override { return remote_gj_peers_; }
+    void set_published_gap_junction_sites(const std::vector<cell_member_type>& sites) override;
+    void published_gap_junction_voltages(std::vector<value_type>& out) const override;
+    void set_remote_gap_junction_voltages(const std::vector<value_type>& v) override;
+
+    void set_event_delivery(event_delivery_kind kind) override { event_delivery_ = kind; }
+
+    fvm_size_type sample_buffer_size() const override { return sample_buffer_size_; }
+    fvm_sample_result take_samples() override;
+
+    std::vector<probe_handle> set_accumulators(const std::vector<fvm_accumulator>& accumulators) override;
+
+    void set_sample_rings(const std::vector<fvm_sample_ring>& rings, fvm_size_type capacity) override;
+
+    void read_sample_ring(std::size_t i, fvm_value_type t0, fvm_value_type t1,
+                          std::vector<fvm_value_type>& times, std::vector<fvm_value_type>& values) override {
+        auto gpu_guard = set_gpu();
+        state_->read_sample_ring(i, t0, t1, times, values);
+    }
+
+    memory_use state_memory() const override;
+    memory_use sample_memory() const override;
+
     //Exposed for testing purposes
     std::vector<mechanism_ptr>& mechanisms() {
         return mechanisms_;
@@ -91,31 +139,152 @@ private:
 
     execution_context context_;
 
+    // The stream of context_.gpu on which this cell group's GPU work is issued.
+    unsigned gpu_stream_ = 0;
+
     std::unique_ptr<shared_state> state_; // Cell state shared across mechanisms.
 
     // TODO: Can we move the backend-dependent data structures below into state_?
     sample_event_stream sample_events_;
     array sample_time_;
     array sample_value_;
+
+    // While steps are on a fixed grid, the time of the next step on the host,
+    // and otherwise negative. The times of the samples staged for integrate()
+    // are then sorted in sample_times_, from which next_sample_ is the first
+    // that may not have been taken: steps in which no sample is due skip
+    // marking and taking samples, which on the GPU are kernel launches.
+    value_type host_time_ = -1;
+    std::vector<value_type> sample_times_;
+    std::size_t next_sample_ = 0;
+
+    // Whether samples may be due in the step of at most dt_max from
+    // host_time_, which is then advanced to the end of the step.
+    bool sample_due(value_type tfinal, value_type dt_max) {
+        if (host_time_<0) return true;
+
+        const value_type t_to = std::min(host_time_+dt_max, tfinal);
+        host_time_ = t_to;
+
+        // Samples before t_to are taken in the step. The margin keeps the
+        // rounding differences of host and device times on the side of
+        // taking samples.
+        const value_type margin = 1e-3*dt_max;
+        const bool due = next_sample_<sample_times_.size() && sample_times_[next_sample_]<t_to+margin;
+        while (next_sample_<sample_times_.size() && sample_times_[next_sample_]<t_to-margin) {
+            ++next_sample_;
+        }
+        return due;
+    }
     matrix<backend> matrix_;
     threshold_watcher threshold_watcher_;
 
+    // The internal concentration of a diffusing ion is integrated with a
+    // matrix of the same structure as that of the cable equation, with
+    // face conductances given by the diffusivity and capacitances by the
+    // volumes of the CVs.
+    struct ion_diffusion {
+        std::string ion;
+        matrix<backend> solver;
+        array zero;  // the ionic current does not depend on the concentration
+    };
+    std::vector<ion_diffusion> diffusion_;
+
     value_type tmin_ = 0;
+    event_delivery_kind event_delivery_ = event_delivery_kind::exact;
+    value_type adaptive_dt_tolerance_ = 0; // If >0, use adaptive time steps, except on a fixed grid.
     std::vector<mechanism_ptr> mechanisms_; // excludes reversal potential calculators.
     std::vector<mechanism_ptr> revpot_mechanisms_;
 
+    // revpot_constant_[i] is set if the concentrations of the ions of
+    // revpot_mechanisms_[i] are constant, so that its reversal potentials
+    // are computed once, on reset, rather than every step.
+    std::vector<char> revpot_constant_;
+
+    // Fused current kernels; bundled_[i] is set if the currents of
+    // mechanisms_[i] are computed by one of the bundles_.
+    std::vector<mechanism_bundle> bundles_;
+    std::vector<char> bundled_;
+
+    // If enabled and supported, slices_[i] updates the instances of
+    // mechanisms_[i] in parallel; empty otherwise.
+    std::vector<typename backend::mechanism_slices> slices_;
+
+    void update_current(std::size_t i) {
+        if constexpr (backend::mechanism_slices::supported) {
+            if (!slices_.empty()) return slices_[i].update_current();
+        }
+        mechanisms_[i]->update_current();
+    }
+
+    void update_state(std::size_t i) {
+        if constexpr (backend::mechanism_slices::supported) {
+            if (!slices_.empty()) return slices_[i].update_state();
+        }
+        mechanisms_[i]->update_state();
+    }
+
     // Non-physical voltage check threshold, 0 => no check.
     value_type check_voltage_mV_ = 0;
 
     // Flag indicating that at least one of the mechanisms implements the post_events procedure
     bool post_events_;
 
+    // Flag indicating that the cells have stochastic inputs.
+    bool stochastic_inputs_ = false;
+
+    // Flag indicating that at least one of the mechanisms has random variables.
+    bool white_noise_ = false;
+
+    // True while the cells are relaxed to rest: steps apply no stimuli or
+    // stochastic inputs, and take no samples.
+    bool relaxing_ = false;
+
+    // Recording of integration steps for replay, if enabled and supported.
+    typename backend::step_graph step_graph_;
+    bool use_step_graph_ = false;
+
+    // Gap junctions with peers in other cell groups, found by
+    // fvm_gap_junctions() with remote_peers set: their peers, CVs and
+    // weights; the CVs of the gap junction sites of each cell; and the CVs
+    // of the sites whose voltages are published to other groups.
+    std::vector<cell_global_label_type> remote_gj_peers_;
+    std::vector<index_type> remote_gj_cv_;
+    std::vector<value_type> remote_gj_weight_;
+    std::unordered_map<cell_gid_type, std::vector<index_type>> gj_site_cvs_;
+    std::vector<index_type> published_gj_cvs_;
+
+    // Generation of events from spikes by the back end, if enabled and supported.
+    std::unique_ptr<typename backend::spike_delivery> spike_delivery_;
+
+    // Host mirror for samples retained over several calls to integrate(), if
+    // enabled and supported; samples [0, n_buffered_samples_) are held.
+    std::unique_ptr<typename backend::sample_buffer> sample_buffer_;
+    size_type sample_buffer_size_ = 0;
+    size_type n_buffered_samples_ = 0;
+
+    // State of the cells and detectors once initialized, restored by reset()
+    // instead of running the initialization of every mechanism again.
+    std::string initial_state_;
+
     // Host-side views/copies and local state.
     decltype(backend::host_view(sample_time_)) sample_time_host_;
     decltype(backend::host_view(sample_value_)) sample_value_host_;
 
     void update_ion_state();
 
+    // Write or restore the time-dependent state, see serialize().
+    void write_state(io::serializer&);
+    void read_state(io::deserializer&);
+
+    // Advance all cells by one time step of at most dt_max, ending no later
+    // than tfinal.
+    void step(value_type tfinal, value_type dt_max);
+
+    // Relax the cells to their resting state, see steady_state_tolerance in
+    // the global properties, and return to time zero.
+    void relax_to_rest(value_type dt, value_type tolerance, value_type tmax);
+
     // Throw if absolute value of membrane voltage exceeds bounds.
     void assert_voltage_bounded(fvm_value_type bound);
 
@@ -132,12 +301,39 @@ private:
         return t0>=t1? 0: 1+(unsigned)((t1-t0)/dt);
     }
 
+    // Lower bound on the number of steps from t0 to t1 with steps of at
+    // most dt, as taken with adaptive time steps.
+    static unsigned min_steps(value_type t0, value_type t1, value_type dt) {
+        return t0>=t1? 0: std::max(1u, (unsigned)std::ceil((t1-t0)/dt));
+    }
+
+    // Number of steps from t0 to t1 when no step is shortened by events,
+    // with the arithmetic of shared_state::update_time_to, so that the last
+    // step ends at t1 exactly.
+    static unsigned grid_steps(value_type t0, value_type t1, value_type dt) {
+        unsigned n = 0;
+        for (auto t = t0; t<t1; t = std::min(t+dt, t1)) ++n;
+        return n;
+    }
+
     // Sets the GPU used for CUDA calls from the thread that calls it.
     // The GPU will be the one in the execution context context_.
     // If not called, the thread may attempt to launch on a different GPU,
     // leading to crashes.
-    void set_gpu() {
-        if (context_.gpu->has_gpu()) context_.gpu->set_gpu();
+    // Also selects this cell group's stream until the returned guard goes
+    // out of scope, so that its kernels and copies run asynchronously with
+    // respect to those of other cell groups, and copies to the host wait
+    // only for this cell group's work.
+    struct gpu_stream_guard {
+        const gpu_context* gpu = nullptr;
+        ~gpu_stream_guard() { if (gpu) gpu->set_default_stream(); }
+    };
+
+    [[nodiscard]] gpu_stream_guard set_gpu() {
+        if (!context_.gpu->has_gpu()) return {};
+        context_.gpu->set_gpu();
+        context_.gpu->set_stream(gpu_stream_);
+        return {context_.gpu.get()};
     }
 
     // Translate cell probe descriptions into probe handles etc.
@@ -165,6 +361,21 @@ void fvm_lowered_cell_impl<Backend>::assert_tmin() {
 
 template <typename Backend>
 void fvm_lowered_cell_impl<Backend>::reset() {
+    auto gpu_guard = set_gpu();
+
+    if constexpr (backend::spike_delivery::supported) {
+        if (spike_delivery_) spike_delivery_->clear();
+    }
+    n_buffered_samples_ = 0;
+
+    if (!initial_state_.empty()) {
+        io::memory_buf buf(initial_state_.data(), initial_state_.size());
+        std::istream is(&buf);
+        io::deserializer in(is);
+        read_state(in);
+        return;
+    }
+
     state_->reset();
     set_tmin(0);
 
@@ -190,165 +401,485 @@ void fvm_lowered_cell_impl<Backend>::reset() {
         m->initialize();
     }
 
+    for (auto i: util::count_along(revpot_mechanisms_)) {
+        if (revpot_constant_[i]) revpot_mechanisms_[i]->update_current();
+    }
+    state_->ions_nernst_reversal_potential(true);
+
     // NOTE: Threshold watcher reset must come after the voltage values are set,
     // as voltage is implicitly read by watcher to set initial state.
     threshold_watcher_.reset();
 }
 
+// Only the time-dependent state is written: the state of the cells, and the
+// state of the spike detectors. Events and samples are not held between calls
+// to integrate(), except by a back end that delivers spikes itself.
+
+template <typename Backend>
+void fvm_lowered_cell_impl<Backend>::serialize(io::serializer& out) {
+    if (spike_delivery_) {
+        throw arbor_exception("checkpointing is not supported with spike delivery on the GPU");
+    }
+    auto gpu_guard = set_gpu();
+
+    write_state(out);
+}
+
+template <typename Backend>
+void fvm_lowered_cell_impl<Backend>::deserialize(io::deserializer& in) {
+    if (spike_delivery_) {
+        throw arbor_exception("checkpointing is not supported with spike delivery on the GPU");
+    }
+    auto gpu_guard = set_gpu();
+
+    read_state(in);
+    n_buffered_samples_ = 0;
+}
+
+template <typename Backend>
+void fvm_lowered_cell_impl<Backend>::write_state(io::serializer& out) {
+    out.value(tmin_);
+    state_->serialize(out);
+    threshold_watcher_.serialize(out);
+}
+
+template <typename Backend>
+void fvm_lowered_cell_impl<Backend>::read_state(io::deserializer& in) {
+    auto t = in.value<value_type>();
+    state_->deserialize(in);
+    set_tmin(t);
+    threshold_watcher_.deserialize(in);
+}
+
+template <typename Backend>
+void fvm_lowered_cell_impl<Backend>::set_spike_connections(std::vector<target_connection> connections) {
+    if constexpr (backend::spike_delivery::supported) {
+        if (spike_delivery_) {
+            auto gpu_guard = set_gpu();
+            spike_delivery_->set_connections(std::move(connections));
+        }
+    }
+}
+
+template <typename Backend>
+void fvm_lowered_cell_impl<Backend>::set_spike_binning_policy(binning_kind policy, value_type bin_interval) {
+    if constexpr (backend::spike_delivery::supported) {
+        if (spike_delivery_) spike_delivery_->set_binning_policy(policy, bin_interval);
+    }
+}
+
+template <typename Backend>
+fvm_sample_result fvm_lowered_cell_impl<Backend>::take_samples() {
+    fvm_sample_result result;
+    if constexpr (backend::sample_buffer::supported) {
+        if (sample_buffer_) {
+            auto gpu_guard = set_gpu();
+            sample_buffer_->synchronize();
+
+            auto n = n_buffered_samples_;
+            result.sample_time = {sample_buffer_->host_time(), sample_buffer_->host_time()+n};
+            result.sample_value = {sample_buffer_->host_value(), sample_buffer_->host_value()+n};
+            n_buffered_samples_ = 0;
+        }
+    }
+    return result;
+}
+
+// The arrays of the back end are held in device memory by the GPU back end.
+template <typename Backend>
+memory_use fvm_lowered_cell_impl<Backend>::state_memory() const {
+    std::size_t n = matrix_.bytes();
+    for (const auto& d: diffusion_) n += d.solver.bytes()+util::size_in_bytes(d.zero);
+    if (state_) n += state_->bytes();
+    if constexpr (backend::spike_delivery::supported) {
+        if (spike_delivery_) n += spike_delivery_->bytes();
+    }
+
+    memory_use m;
+    (backend::kind==arb_backend_kind_gpu? m.device: m.host) = n;
+    m.host += initial_state_.capacity();
+    return m;
+}
+
+template <typename Backend>
+memory_use fvm_lowered_cell_impl<Backend>::sample_memory() const {
+    memory_use m;
+    (backend::kind==arb_backend_kind_gpu? m.device: m.host) = util::size_in_bytes(sample_time_, sample_value_);
+    if constexpr (backend::sample_buffer::supported) {
+        if (sample_buffer_) m.host += sample_buffer_->bytes();
+    }
+    return m;
+}
+
+template <typename Backend>
+std::vector<probe_handle> fvm_lowered_cell_impl<Backend>::set_accumulators(const std::vector<fvm_accumulator>& accumulators) {
+    auto gpu_guard = set_gpu();
+
+    std::vector<probe_handle> sources;
+    std::vector<fvm_index_type> intdoms;
+    std::vector<sampling_policy> ops;
+    for (const auto& a: accumulators) {
+        sources.push_back(a.source);
+        intdoms.push_back(a.intdom);
+        ops.push_back(a.op);
+    }
+    state_->configure_accumulators(sources, intdoms, ops);
+
+    std::vector<probe_handle> handles;
+    for (std::size_t i = 0; i<accumulators.size(); ++i) {
+        handles.push_back(state_->accumulator_value.data()+i);
+    }
+    return handles;
+}
+
+template <typename Backend>
+void fvm_lowered_cell_impl<Backend>::set_sample_rings(const std::vector<fvm_sample_ring>& rings, fvm_size_type capacity) {
+    auto gpu_guard = set_gpu();
+
+    std::vector<probe_handle> sources;
+    std::vector<fvm_index_type> intdoms;
+    for (const auto& r: rings) {
+        sources.push_back(r.source);
+        intdoms.push_back(r.intdom);
+    }
+    state_->configure_sample_rings(sources, intdoms, capacity);
+}
+
+template <typename Backend>
+void fvm_lowered_cell_impl<Backend>::enqueue_spikes(std::shared_ptr<const std::vector<spike>> spikes) {
+    if constexpr (backend::spike_delivery::supported) {
+        if (spike_delivery_) spike_delivery_->enqueue(std::move(spikes));
+    }
+}
+
 template <typename Backend>
 fvm_integration_result fvm_lowered_cell_impl<Backend>::integrate(
     value_type tfinal,
     value_type dt_max,
-    std::vector<deliverable_event> staged_events,
-    std::vector<sample_event> staged_samples)
+    const std::vector<deliverable_event>& staged_events,
+    const std::vector<sample_event>& staged_samples)
 {
-    set_gpu();
+    auto gpu_guard = set_gpu();
 
     // Integration setup
     PE(advance_integrate_setup);
     threshold_watcher_.clear_crossings();
 
-    auto n_samples = staged_samples.size();
+    // Samples retained from previous calls occupy the start of the sample
+    // arrays, and are kept if the arrays are grown.
+    auto n_held = n_buffered_samples_;
+    auto n_samples = n_held + staged_samples.size();
     if (sample_time_.size() < n_samples) {
-        sample_time_ = array(n_samples);
-        sample_value_ = array(n_samples);
+        array sample_time(n_held? std::max(n_samples, 2*sample_time_.size()): n_samples);
+        array sample_value(sample_time.size());
+        if constexpr (backend::sample_buffer::supported) {
+            if (n_held) {
+                memory::copy(sample_time_(0, n_held), sample_time(0, n_held));
+                memory::copy(sample_value_(0, n_held), sample_value(0, n_held));
+            }
+        }
+        sample_time_ = std::move(sample_time);
+        sample_value_ = std::move(sample_value);
     }
 
-    state_->deliverable_events.init(std::move(staged_events));
-    sample_events_.init(std::move(staged_samples));
+    bool staged_on_device = false;
+    if constexpr (backend::spike_delivery::supported) {
+        if (spike_delivery_) {
+            spike_delivery_->stage(tmin_, tfinal, staged_events, state_->deliverable_events);
+            staged_on_device = true;
+        }
+    }
+    if (!staged_on_device) {
+        state_->deliverable_events.init(staged_events);
+    }
+    sample_events_.init(staged_samples);
 
     arb_assert((assert_tmin(), true));
-    unsigned remaining_steps = dt_steps(tmin_, tfinal, dt_max);
+    const bool on_grid = event_delivery_==event_delivery_kind::step_start;
+
+    sample_times_.clear();
+    for (const auto& ev: staged_samples) sample_times_.push_back(event_time(ev));
+    util::sort(sample_times_);
+    next_sample_ = 0;
+    host_time_ = on_grid? tmin_: -1;
+    state_->adaptive_dt_tolerance = on_grid? 0: adaptive_dt_tolerance_;
+
+    // With adaptive time steps, integration domains advance by different
+    // steps, and the count of steps is a lower bound for the domain furthest
+    // behind, taking the longest steps.
+    const bool adaptive = state_->adaptive_dt_tolerance>0;
+    const value_type dt_longest = std::ldexp(dt_max, adaptive? state_->adaptive_dt_max_level: 0);
+    auto count_steps = [&](value_type t0) {
+        return adaptive? min_steps(t0, tfinal, dt_longest): dt_steps(t0, tfinal, dt_max);
+    };
+    unsigned remaining_steps = on_grid? grid_steps(tmin_, tfinal, dt_max): count_steps(tmin_);
     PL();
 
     // TODO: Consider devolving more of this to back-end routines (e.g.
     // per-compartment dt probably not a win on GPU), possibly rumbling
     // complete fvm state into shared state object.
 
+    // With a step graph, the work of two steps is recorded once per call and
+    // replayed while at least two steps remain: two, because each step swaps
+    // time and time_to, whose pointers are baked into the recorded kernels.
+    bool replay = false;
+    if constexpr (backend::step_graph::supported) {
+        if (use_step_graph_ && remaining_steps>=2) {
+            // Recorded steps always take samples.
+            host_time_ = -1;
+            step_graph_.capture([&] { step(tfinal, dt_max); step(tfinal, dt_max); });
+            replay = true;
+        }
+    }
+
     while (remaining_steps) {
-        // Update any required reversal potentials based on ionic concs.
+        unsigned n_steps = 1;
+        if constexpr (backend::step_graph::supported) {
+            if (replay && remaining_steps>=2) {
+                PE(advance_integrate_graph);
+                step_graph_.launch();
+                PL();
+                n_steps = 2;
+            }
+        }
+        if (n_steps==1) {
+            step(tfinal, dt_max);
+        }
 
-        for (auto& m: revpot_mechanisms_) {
-            m->update_current();
+        // Check for non-physical solutions:
+
+        if (check_voltage_mV_>0) {
+            PE(advance_integrate_physicalcheck);
+            assert_voltage_bounded(check_voltage_mV_);
+            PL();
         }
 
-        // Deliver events and accumulate mechanism current contributions.
+        // Check for end of integration. On a fixed grid of steps, the number
+        // of steps is known in advance.
 
-        PE(advance_integrate_events);
-        state_->deliverable_events.mark_until_after(state_->time);
+        PE(advance_integrate_stepsupdate);
+        remaining_steps -= n_steps;
+        if (!remaining_steps && !on_grid) {
+            tmin_ = state_->time_bounds().first;
+            remaining_steps = count_steps(tmin_);
+        }
         PL();
+    }
 
-        PE(advance_integrate_current_zero);
-        state_->zero_currents();
-        PL();
+    set_tmin(tfinal);
+
+    // Retained samples are copied to the host without waiting for them.
+    if constexpr (backend::sample_buffer::supported) {
+        if (sample_buffer_) {
+            sample_buffer_->copy_to_host(sample_time_, sample_value_, n_held, n_samples);
+            n_buffered_samples_ = n_samples;
+
+            return fvm_integration_result{util::range_pointer_view(threshold_watcher_.crossings()), {}, {}};
+        }
+    }
+
+    const auto& crossings = threshold_watcher_.crossings();
+    sample_time_host_ = backend::host_view(sample_time_);
+    sample_value_host_ = backend::host_view(sample_value_);
+
+    return fvm_integration_result{
+        util::range_pointer_view(crossings),
+        util::range_pointer_view(sample_time_host_),
+        util::range_pointer_view(sample_value_host_)
+    };
+}
+
+template <typename Backend>
+void fvm_lowered_cell_impl<Backend>::step(value_type tfinal, value_type dt_max) {
+    // Update any required reversal potentials based on ionic concs.
+
+    for (auto i: util::count_along(revpot_mechanisms_)) {
+        if (!revpot_constant_[i]) revpot_mechanisms_[i]->update_current();
+    }
+    state_->ions_nernst_reversal_potential(false);
+
+    // Draw the random variables of the step, used by both the currents and
+    // the state updates; they stay zero while relaxing to rest.
+
+    if (white_noise_ && !relaxing_) {
+        PE(advance_integrate_white_noise);
         for (auto& m: mechanisms_) {
-            auto state = state_->deliverable_events.marked_events();
-            arb_deliverable_event_stream events;
-            events.n_streams = state.n;
-            events.begin     = state.begin_offset;
-            events.end       = state.end_offset;
-            events.events    = (arb_deliverable_event_data*) state.ev_data; // FIXME(TH): This relies on bit-castability
-            m->deliver_events(events);
-            m->update_current();
+            if (m->mech_.n_random_variables) state_->draw_white_noise(*m);
         }
+        PL();
+    }
 
-        // Add current contribution from gap_junctions
-        state_->add_gj_current();
+    // Deliver events and accumulate mechanism current contributions. With
+    // event_delivery_kind::step_start, the step has its full length, and the
+    // events before its end are applied now; otherwise, the step ends at the
+    // next event, and only events up to the current time are applied.
 
-        PE(advance_integrate_events);
-        state_->deliverable_events.drop_marked_events();
+    const bool on_grid = event_delivery_==event_delivery_kind::step_start;
 
-        // Update event list and integration step times.
+    PE(advance_integrate_events);
+    if (on_grid) {
+        state_->update_time_to(dt_max, tfinal);
+        state_->deliverable_events.mark_until(state_->time_to);
+    }
+    else {
+        state_->deliverable_events.mark_until_after(state_->time);
+    }
+    PL();
 
+    PE(advance_integrate_current_zero);
+    state_->zero_currents();
+    PL();
+    for (auto i: util::count_along(mechanisms_)) {
+        auto& m = mechanisms_[i];
+        auto events = state_->marked_events(*m);
+        m->deliver_events(events);
+        if (!bundled_[i]) update_current(i);
+    }
+    for (auto& b: bundles_) {
+        b.update_current();
+    }
+
+    // Add current contribution from gap_junctions
+    state_->add_gj_current();
+
+    PE(advance_integrate_events);
+    state_->deliverable_events.drop_marked_events();
+
+    // Update event list and integration step times.
+
+    if (!on_grid) {
         state_->update_time_to(dt_max, tfinal);
         state_->deliverable_events.event_time_if_before(state_->time_to);
-        state_->set_dt();
-        PL();
+    }
+    state_->set_dt();
+    PL();
 
-        // Add stimulus current contributions.
-        // (Note: performed after dt, time_to calculation, in case we
-        // want to use mean current contributions as opposed to point
-        // sample.)
+    // Add stimulus current contributions.
+    // (Note: performed after dt, time_to calculation, in case we
+    // want to use mean current contributions as opposed to point
+    // sample.)
 
+    if (!relaxing_) {
         PE(advance_integrate_stimuli)
         state_->add_stimulus_current();
         PL();
 
-        // Take samples at cell time if sample time in this step interval.
+        // Accumulate the values at the start of the step for decimating
+        // samplers, then take samples at cell time if sample time in this step
+        // interval.
 
         PE(advance_integrate_samples);
-        sample_events_.mark_until(state_->time_to);
-        state_->take_samples(sample_events_.marked_events(), sample_time_, sample_value_);
-        sample_events_.drop_marked_events();
+        state_->accumulate_samples();
+        if (sample_due(tfinal, dt_max)) {
+            sample_events_.mark_until(state_->time_to);
+            state_->take_samples(sample_events_.marked_events(), sample_time_, sample_value_);
+            sample_events_.drop_marked_events();
+        }
         PL();
+    }
 
-        // Integrate voltage by matrix solve.
+    // Integrate voltage by matrix solve; assembly and solve are fused
+    // so that each cell is solved while its assembled rows are in cache.
+    // With adaptive time steps, the voltages before and after the solve
+    // determine the length of the next step.
 
-        PE(advance_integrate_matrix_build);
-        matrix_.assemble(state_->dt_intdom, state_->voltage, state_->current_density, state_->conductivity);
-        PL();
-        PE(advance_integrate_matrix_solve);
-        matrix_.solve(state_->voltage);
-        PL();
+    PE(advance_integrate_matrix);
+    state_->save_step_voltage();
+    matrix_.assemble_solve(state_->dt_intdom, state_->voltage, state_->current_density, state_->conductivity);
+    state_->adapt_dt(dt_max, tfinal);
+    PL();
 
-        // Integrate mechanism state.
+    // Apply the events of the stochastic inputs in the step, then integrate
+    // mechanism state. The events first contribute to the currents of the
+    // next step, as do events arriving during the step.
 
+    if (stochastic_inputs_ && !relaxing_) {
+        PE(advance_integrate_stochastic);
+        state_->sample_stochastic_inputs();
         for (auto& m: mechanisms_) {
-            m->update_state();
+            auto events = state_->stochastic_events(*m);
+            if (events.n_streams) m->deliver_events(events);
         }
-
-        // Update ion concentrations.
-
-        PE(advance_integrate_ionupdate);
-        update_ion_state();
         PL();
+    }
 
-        // Update time and test for spike threshold crossings.
+    for (auto i: util::count_along(mechanisms_)) {
+        update_state(i);
+    }
 
-        PE(advance_integrate_threshold);
-        threshold_watcher_.test(&state_->time_since_spike);
-        PL();
+    // Update ion concentrations, first integrating the diffusing ones
+    // over the step from their ionic currents.
 
-        PE(advance_integrate_post)
-        if (post_events_) {
-            for (auto& m: mechanisms_) {
-                m->post_event();
-            }
-        }
-        PL();
+    PE(advance_integrate_ionupdate);
+    for (auto& d: diffusion_) {
+        auto& ion = state_->ion_data.at(d.ion);
+        ion.diffusion_source();
+        d.solver.assemble_solve(state_->dt_intdom, ion.Xd_, ion.Xd_source_, d.zero);
+    }
+    update_ion_state();
+    PL();
 
-        std::swap(state_->time_to, state_->time);
-        state_->time_ptr = state_->time.data();
+    // Update time and test for spike threshold crossings.
 
-        // Check for non-physical solutions:
+    PE(advance_integrate_threshold);
+    threshold_watcher_.test(&state_->time_since_spike);
+    PL();
 
-        if (check_voltage_mV_>0) {
-            PE(advance_integrate_physicalcheck);
-            assert_voltage_bounded(check_voltage_mV_);
-            PL();
+    PE(advance_integrate_post)
+    if (post_events_) {
+        for (auto& m: mechanisms_) {
+            m->post_event();
         }
+    }
+    PL();
 
-        // Check for end of integration.
+    std::swap(state_->time_to, state_->time);
+    state_->time_ptr = state_->time.data();
+}
 
-        PE(advance_integrate_stepsupdate);
-        if (!--remaining_steps) {
-            tmin_ = state_->time_bounds().first;
-            remaining_steps = dt_steps(tmin_, tfinal, dt_max);
+// Implicit steps of the cable equation and of the mechanism kinetics have the
+// resting state as their fixed point, which long steps reach in far fewer
+// steps than the transient of a simulation with a small time step. All cells
+// of the group are relaxed together, until the voltage of none of them
+// changes faster than the tolerance.
+
+template <typename Backend>
+void fvm_lowered_cell_impl<Backend>::relax_to_rest(value_type dt, value_type tolerance, value_type tmax) {
+    relaxing_ = true;
+    auto guard = util::on_scope_exit([this] { relaxing_ = false; });
+
+    state_->deliverable_events.init(std::vector<deliverable_event>{});
+    sample_events_.init(std::vector<sample_event>{});
+    state_->adaptive_dt_tolerance = 0;
+
+    // The change of voltage is checked every few steps.
+    constexpr unsigned check_steps = 10;
+    auto v = backend::host_view(state_->voltage);
+    std::vector<value_type> v_prev(v.begin(), v.end());
+
+    value_type t = 0;
+    while (t<tmax) {
+        value_type t_check = std::min(t+check_steps*dt, tmax);
+        for (auto n = dt_steps(t, t_check, dt); n>0; --n) {
+            step(t_check, dt);
         }
-        PL();
-    }
 
-    set_tmin(tfinal);
+        auto v = backend::host_view(state_->voltage);
+        value_type dv = 0;
+        for (auto i: util::count_along(v_prev)) {
+            dv = std::max(dv, std::abs(v[i]-v_prev[i]));
+            v_prev[i] = v[i];
+        }
+        if (check_voltage_mV_>0) assert_voltage_bounded(check_voltage_mV_);
 
-    const auto& crossings = threshold_watcher_.crossings();
-    sample_time_host_ = backend::host_view(sample_time_);
-    sample_value_host_ = backend::host_view(sample_value_);
+        bool converged = dv<=tolerance*(t_check-t);
+        t = t_check;
+        if (converged) break;
+    }
 
-    return fvm_integration_result{
-        util::range_pointer_view(crossings),
-        util::range_pointer_view(sample_time_host_),
-        util::range_pointer_view(sample_value_host_)
-    };
+    state_->reset_time();
+    set_tmin(0);
+    threshold_watcher_.reset();
 }
 
 template <typename Backend>
@@ -385,7 +916,7 @@ fvm_initialization_data fvm_lowered_cell_impl<Backend>::initialize(
 
     fvm_initialization_data fvm_info;
 
-    set_gpu();
+    auto gpu_guard = set_gpu();
 
     std::vector<cable_cell> cells;
     const std::size_t ncell = gids.size();
@@ -456,11 +987,32 @@ fvm_initialization_data fvm_lowered_cell_impl<Backend>::initialize(
 
     check_voltage_mV_ = global_props.membrane_voltage_limit_mV;
 
-    auto nintdom = fvm_intdom(rec, gids, fvm_info.cell_to_intdom);
+    use_step_graph_ = backend::step_graph::supported && global_props.gpu_step_graph;
+
+    const bool gj_exchanged = global_props.gap_junction_interval>0;
+    auto nintdom = fvm_intdom(rec, gids, fvm_info.cell_to_intdom, gj_exchanged);
+
+    // Discretize cells, build matrix, and discretize mechanism data; or read
+    // them from the cache of lowered cell groups. A cache entry built from
+    // other cells or global properties is replaced.
 
-    // Discretize cells, build matrix.
+    fvm_cv_discretization D;
+    fvm_mechanism_data mech_data;
 
-    fvm_cv_discretization D = fvm_cv_discretize(cells, global_props.default_parameters, context_);
+    const auto& cache_dir = global_props.lowered_cache_dir;
+    const auto cache_key = cache_dir.empty()? 0: fvm_lowered_key(global_props, cells);
+    bool cached = !cache_dir.empty() && fvm_read_lowered(cache_dir, gids, cache_key, D, mech_data);
+
+    if (!cached) {
+        D = fvm_cv_discretize(cells, global_props.default_parameters, context_);
+        if (global_props.reorder_cvs) {
+            fvm_reorder_cvs(D, cells, context_);
+        }
+        mech_data = fvm_build_mechanism_data(global_props, cells, D, context_);
+        if (!cache_dir.empty()) {
+            fvm_write_lowered(cache_dir, gids, cache_key, D, mech_data);
+        }
+    }
 
     std::vector<index_type> cv_to_intdom(D.size());
     std::transform(D.geometry.cv_to_cell.begin(), D.geometry.cv_to_cell.end(), cv_to_intdom.begin(),
@@ -469,30 +1021,58 @@ fvm_initialization_data fvm_lowered_cell_impl<Backend>::initialize(
     arb_assert(D.n_cell() == ncell);
     matrix_ = matrix<backend>(D.geometry.cv_parent, D.geometry.cell_cv_divs,
                               D.cv_capacitance, D.face_conductance, D.cv_area, fvm_info.cell_to_intdom);
+    matrix_.set_task_system(context_.thread_pool.get());
+    matrix_.set_parallel_cells(global_props.parallel_cell_groups);
+    matrix_.set_crank_nicolson(global_props.crank_nicolson);
     sample_events_ = sample_event_stream(nintdom);
 
-    // Discretize mechanism data.
+    if constexpr (backend::sample_buffer::supported) {
+        if (global_props.gpu_sample_buffer_size) {
+            sample_buffer_ = std::make_unique<typename backend::sample_buffer>();
+            sample_buffer_size_ = global_props.gpu_sample_buffer_size;
+        }
+    }
 
-    fvm_mechanism_data mech_data = fvm_build_mechanism_data(global_props, cells, D, context_);
+    if constexpr (backend::spike_delivery::supported) {
+        if (global_props.gpu_spike_delivery) {
+            spike_delivery_ = std::make_unique<typename backend::spike_delivery>(nintdom);
+        }
+    }
 
     // Discretize and build gap junction info.
 
-    auto gj_vector = fvm_gap_junctions(cells, gids, fvm_info.gap_junction_data, rec, D);
+    auto gj_vector = fvm_gap_junctions(cells, gids, fvm_info.gap_junction_data, rec, D, gj_exchanged);
 
-    // Fill src_to_spike and cv_to_cell vectors only if mechanisms with post_events implemented are present.
-    post_events_ = mech_data.post_events;
-    auto max_detector = 0;
-    if (post_events_) {
-        auto it = util::max_element_by(fvm_info.num_sources, [](auto elem) {return util::second(elem);});
-        max_detector = it->second;
+    // Collect detectors and probes. Cells without probes are not needed
+    // beyond this point, and are released before the cell state is built.
+    std::vector<index_type> detector_cv;
+    std::vector<value_type> detector_threshold;
+    std::vector<std::vector<probe_info>> cell_probes(ncell);
+
+    for (auto cell_idx: make_span(ncell)) {
+        for (auto entry: cells[cell_idx].detectors()) {
+            detector_cv.push_back(D.geometry.location_cv(cell_idx, entry.loc, cv_prefer::cv_empty));
+            detector_threshold.push_back(entry.item.threshold);
+        }
+
+        cell_probes[cell_idx] = rec.get_probes(gids[cell_idx]);
+        if (cell_probes[cell_idx].empty()) {
+            cells[cell_idx] = cable_cell();
+        }
     }
-    std::vector<fvm_index_type> src_to_spike, cv_to_cell;
+
+    // Fill src_to_spike, detector_divs and cv_to_cell vectors only if mechanisms with post_events implemented are present.
+    // The detectors of each cell are stored contiguously, in the order of the spike sources.
+    post_events_ = mech_data.post_events;
+    std::vector<fvm_index_type> src_to_spike, detector_divs, cv_to_cell;
 
     if (post_events_) {
+        detector_divs.push_back(0);
         for (auto cell_idx: make_span(ncell)) {
             for (auto lid: make_span(fvm_info.num_sources[gids[cell_idx]])) {
-                src_to_spike.push_back(cell_idx * max_detector + lid);
+                src_to_spike.push_back(detector_divs.back() + lid);
             }
+            detector_divs.push_back(detector_divs.back() + fvm_info.num_sources[gids[cell_idx]]);
         }
         src_to_spike.shrink_to_fit();
         cv_to_cell = D.geometry.cv_to_cell;
@@ -506,10 +1086,19 @@ fvm_initialization_data fvm_lowered_cell_impl<Backend>::initialize(
             [&](const std::string& name) { return mech_instance(name).mech->data_alignment(); }));
 
     state_ = std::make_unique<shared_state>(
-                nintdom, ncell, max_detector, cv_to_intdom, std::move(cv_to_cell), gj_vector,
+                nintdom, ncell, detector_divs, cv_to_intdom, std::move(cv_to_cell), gj_vector,
                 D.init_membrane_potential, D.temperature_K, D.diam_um, std::move(src_to_spike),
                 data_alignment? data_alignment: 1u);
 
+    if (!remote_gj_cv_.empty()) {
+        state_->configure_remote_gap_junctions(remote_gj_cv_, remote_gj_weight_);
+    }
+
+    adaptive_dt_tolerance_ = global_props.adaptive_dt_tolerance;
+    if (adaptive_dt_tolerance_>0) {
+        state_->configure_adaptive_dt(adaptive_dt_tolerance_, global_props.adaptive_dt_max_doublings);
+    }
+
     // Instantiate mechanisms, ions, and stimuli.
 
     for (auto& i: mech_data.ions) {
@@ -523,6 +1112,37 @@ fvm_initialization_data fvm_lowered_cell_impl<Backend>::initialize(
         }
     }
 
+    diffusion_.clear();
+    for (const auto& [ion_name, config]: mech_data.ions) {
+        if (util::all_of(config.diffusivity, [](auto d) { return d==0; })) continue;
+
+        // CVs outside the support of the ion are decoupled, with an arbitrary
+        // capacitance; those of zero volume in it get a negligible one.
+        auto n_cv = D.size();
+        std::vector<value_type> diffusivity(n_cv, 0), cap(n_cv, 1e3), g(n_cv, 0);
+        for (auto k: util::count_along(config.cv)) {
+            auto cv = config.cv[k];
+            auto volume = D.cv_area[cv]*D.diam_um[cv]/4; // [µm³], as for a cylinder
+            diffusivity[cv] = config.diffusivity[k];
+            cap[cv] = volume>0? 1e3*volume: 1e-3;
+        }
+        for (auto cv: util::make_span(n_cv)) {
+            auto p = D.geometry.cv_parent[cv];
+            if (p!=-1 && diffusivity[cv]>0 && diffusivity[p]>0) {
+                // 1e9 converts m²/s to µm²/ms.
+                g[cv] = 1e9*std::min(diffusivity[cv], diffusivity[p])*D.face_area_per_length[cv];
+            }
+        }
+
+        ion_diffusion d{ion_name, matrix<backend>(D.geometry.cv_parent, D.geometry.cell_cv_divs,
+                                                  cap, g, D.cv_area, fvm_info.cell_to_intdom),
+                        array(n_cv, 0)};
+        d.solver.set_task_system(context_.thread_pool.get());
+        d.solver.set_parallel_cells(global_props.parallel_cell_groups);
+        state_->configure_ion_diffusion(ion_name);
+        diffusion_.push_back(std::move(d));
+    }
+
     if (!mech_data.stimuli.cv.empty()) {
         state_->configure_stimulus(mech_data.stimuli);
     }
@@ -532,6 +1152,14 @@ fvm_initialization_data fvm_lowered_cell_impl<Backend>::initialize(
     // Keep track of mechanisms by name for probe lookup.
     std::unordered_map<std::string, mechanism*> mechptr_by_name;
 
+    // Whether the events of each mechanism, by id, may be combined.
+    std::vector<char> additive_events;
+
+    // The partition of the event streams holding the events of each
+    // mechanism, by id: only point mechanisms with targets receive events.
+    std::vector<fvm_index_type> event_partitions;
+    fvm_index_type n_event_partition = 0;
+
     unsigned mech_id = 0;
     for (auto& m: mech_data.mechanisms) {
         auto& name = m.first;
@@ -585,14 +1213,93 @@ fvm_initialization_data fvm_lowered_cell_impl<Backend>::initialize(
         }
 
         auto minst = mech_instance(name);
+
+        // The reversal potentials of the Nernst mechanism of the default
+        // catalogue, with its default constants and parameters, are set by
+        // the back end for all of its ions in one pass over the ion arrays.
+        // The back end sets them on every CV of an ion, so this holds only if
+        // the mechanism is on all of them; where cells of the group choose
+        // other methods for the ion, the mechanism is kept.
+        if (config.kind==arb_mechanism_kind_reversal_potential && minst.overrides.globals.empty()) {
+            const auto& nernst = global_default_catalogue()["nernst"];
+            const auto& type = minst.mech->mech_;
+            // The layout holds the values of all parameters; coeff, which
+            // the mechanism sets on initialization, has the default NaN.
+            auto is_default = [&](const auto& pv) {
+                auto param = util::value_by_key(nernst.parameters, pv.first);
+                if (!param) return false;
+                const double d = param->default_value;
+                return util::all_of(pv.second, [d](double v) { return v==d || (std::isnan(v) && std::isnan(d)); });
+            };
+            if (nernst.fingerprint==type.fingerprint && util::all_of(config.param_values, is_default)) {
+                std::vector<std::pair<std::string, const fvm_ion_config*>> ions;
+                bool covers_ions = true;
+                for (auto j: make_span(type.n_ions)) {
+                    std::string ion = type.ions[j].name;
+                    ion = value_by_key(minst.overrides.ion_rebind, ion).value_or(ion);
+                    if (auto ion_config = util::ptr_by_key(mech_data.ions, ion)) {
+                        covers_ions = covers_ions && std::includes(config.cv.begin(), config.cv.end(), ion_config->cv.begin(), ion_config->cv.end());
+                        ions.emplace_back(ion, ion_config);
+                    }
+                }
+                if (covers_ions) {
+                    const auto scale = 1e3*nernst.globals.at("R").default_value/nernst.globals.at("F").default_value;
+                    for (const auto& [ion, ion_config]: ions) {
+                        state_->configure_nernst(ion, scale, ion_config->constant_concentration);
+                    }
+                    continue;
+                }
+            }
+        }
+
+        // The random variables of an instance are keyed by the gid of its
+        // cell and its index among the instances on the cell.
+        if (minst.mech->mech_.n_random_variables) {
+            layout.random_seed = global_props.white_noise_seed;
+            layout.random_stream = white_noise_stream(name.c_str());
+            std::vector<std::uint64_t> lid(ncell);
+            for (auto cv: layout.cv) {
+                auto cell = D.geometry.cv_to_cell[cv];
+                if (lid[cell]>=white_noise_max_lid) {
+                    throw arbor_internal_error(util::pprintf("too many instances of '{}' with random variables on cell {}", name, gids[cell]));
+                }
+                layout.random_instance.push_back(white_noise_instance(gids[cell], lid[cell]++));
+            }
+            white_noise_ = true;
+        }
+
         state_->instantiate(*minst.mech, mech_id++, minst.overrides, layout);
+        additive_events.push_back(minst.mech->mech_.has_additive_events);
+        event_partitions.push_back(config.target.empty()? -1: n_event_partition++);
         mechptr_by_name[name] = minst.mech.get();
 
         for (auto& pv: config.param_values) {
             state_->set_parameter(*minst.mech, pv.first, pv.second);
         }
 
+        // Parameters that are not set explicitly keep their default value, so
+        // kernels specialised for uniform parameters apply if every explicitly
+        // set parameter has the same value on all instances.
+        if (auto uniform = minst.mech->iface_.uniform_parameters) {
+            auto is_uniform = [](const auto& pv) {
+                return std::adjacent_find(pv.second.begin(), pv.second.end(), std::not_equal_to<>{})==pv.second.end();
+            };
+            if (std::all_of(config.param_values.begin(), config.param_values.end(), is_uniform)) {
+                minst.mech->iface_ = *uniform;
+            }
+        }
+
         if (config.kind==arb_mechanism_kind_reversal_potential) {
+            bool constant = true;
+            const auto& type = minst.mech->mech_;
+            for (auto j: make_span(type.n_ions)) {
+                std::string ion = type.ions[j].name;
+                ion = value_by_key(minst.overrides.ion_rebind, ion).value_or(ion);
+                if (auto ion_config = util::ptr_by_key(mech_data.ions, ion)) {
+                    constant &= ion_config->constant_concentration;
+                }
+            }
+            revpot_constant_.push_back(constant);
             revpot_mechanisms_.push_back(mechanism_ptr(minst.mech.release()));
         }
         else {
@@ -600,21 +1307,113 @@ fvm_initialization_data fvm_lowered_cell_impl<Backend>::initialize(
         }
     }
 
+    // Each mechanism reads its own events, rather than filtering the events
+    // of all mechanisms by id.
+    state_->deliverable_events.set_partitions(std::move(event_partitions));
+
+    // Resolve the targets of the stochastic inputs of each cell, and group the
+    // inputs by target instance. The events of an input in a step are
+    // applied together, which requires a mechanism with additive events.
+
+    {
+        struct input_entry {
+            target_handle handle;
+            std::uint64_t stream;
+            stochastic_input input;
+        };
+        std::vector<input_entry> inputs;
+
+        label_resolution_map target_map({fvm_info.target_data, gids});
+        for (auto cell_idx: make_span(ncell)) {
+            auto gid = gids[cell_idx];
+            auto cell_inputs = rec.stochastic_inputs(gid);
+            resolver target_resolver(&target_map);
+            for (auto i: count_along(cell_inputs)) {
+                auto& in = cell_inputs[i];
+                auto lid = target_resolver.resolve({gid, in.target});
+                auto handle = fvm_info.target_handles[mech_data.target_divs[cell_idx]+lid];
+                if (!additive_events[handle.mech_id]) {
+                    throw cable_cell_error(util::pprintf(
+                        "stochastic input {} of gid {} targets '{}', which does not have additive events", i, gid, in.target.tag));
+                }
+                inputs.push_back({handle, (std::uint64_t(gid)<<32) | i, std::move(in)});
+            }
+        }
+
+        std::stable_sort(inputs.begin(), inputs.end(), [](const auto& a, const auto& b) {
+            return std::tie(a.handle.mech_id, a.handle.mech_index)<std::tie(b.handle.mech_id, b.handle.mech_index);
+        });
+
+        fvm_stochastic_input_config config;
+        for (auto i: count_along(inputs)) {
+            const auto& h = inputs[i].handle;
+            if (!i || h.mech_id!=config.mech_id.back() || h.mech_index!=config.mech_index.back()) {
+                config.mech_id.push_back(h.mech_id);
+                config.mech_index.push_back(h.mech_index);
+                config.instance_divs.push_back(i);
+            }
+            const auto& in = inputs[i].input;
+            config.intdom.push_back(h.intdom_index);
+            config.weight.push_back(in.weight);
+            config.rate.push_back(in.rate_kHz);
+            config.tstart.push_back(in.tstart);
+            config.tstop.push_back(in.tstop);
+            config.seed.push_back(in.seed);
+            config.stream.push_back(inputs[i].stream);
+        }
+        config.instance_divs.push_back(inputs.size());
+
+        stochastic_inputs_ = !config.empty();
+        if (stochastic_inputs_) {
+            state_->configure_stochastic_inputs(config);
+        }
+    }
+
+    // Substitute a catalogue bundle for the current kernels of its members
+    // when they all are density mechanisms on exactly the same CVs.
+
+    std::unordered_set<mechanism*> in_bundle;
+    if (global_props.mechanism_bundles) {
+        for (auto& b: catalogue->bundles(backend::kind)) {
+            std::vector<mechanism*> members;
+            const std::vector<index_type>* cv = nullptr;
+            for (auto& name: b.members) {
+                auto m = value_by_key(mechptr_by_name, name);
+                if (!m || in_bundle.count(*m)) break;
+
+                const auto& config = mech_data.mechanisms.at(name);
+                if (config.kind!=arb_mechanism_kind_density) break;
+                if (cv && config.cv!=*cv) break;
+
+                cv = &config.cv;
+                members.push_back(*m);
+            }
+            if (members.empty() || members.size()!=b.members.size()) continue;
+
+            in_bundle.insert(members.begin(), members.end());
+            bundles_.emplace_back(b.iface, std::move(members));
+        }
+    }
+    for (auto& m: mechanisms_) {
+        bundled_.push_back(in_bundle.count(m.get()));
+    }
+
+    if constexpr (backend::mechanism_slices::supported) {
+        if (global_props.parallel_cell_groups) {
+            for (auto& m: mechanisms_) {
+                slices_.emplace_back(*m, context_.thread_pool.get());
+            }
+        }
+    }
+
 
-    std::vector<index_type> detector_cv;
-    std::vector<value_type> detector_threshold;
     std::vector<fvm_probe_data> probe_data;
 
     for (auto cell_idx: make_span(ncell)) {
         cell_gid_type gid = gids[cell_idx];
 
-        // Collect detectors, probe handles.
-        for (auto entry: cells[cell_idx].detectors()) {
-            detector_cv.push_back(D.geometry.location_cv(cell_idx, entry.loc, cv_prefer::cv_empty));
-            detector_threshold.push_back(entry.item.threshold);
-        }
-
-        std::vector<probe_info> rec_probes = rec.get_probes(gid);
+        // Collect probe handles.
+        auto& rec_probes = cell_probes[cell_idx];
         for (cell_lid_type i: count_along(rec_probes)) {
             probe_info& pi = rec_probes[i];
             resolve_probe_address(probe_data, cells, cell_idx, std::move(pi.address),
@@ -631,9 +1430,75 @@ fvm_initialization_data fvm_lowered_cell_impl<Backend>::initialize(
         }
     }
 
+    // Gather the weighted sums of all reduction probes, which are evaluated
+    // in the back end, and point the probes at the results. Interpolated
+    // probes are two-term sums, and are likewise evaluated in the back end
+    // in one pass over all probes, becoming scalar probes of the results.
+    {
+        std::vector<probe_handle> terms;
+        std::vector<fvm_value_type> weights;
+        std::vector<fvm_index_type> divs = {0};
+        std::vector<std::pair<fvm_probe_reduction*, std::size_t>> reductions;
+        std::vector<std::pair<fvm_probe_data*, std::size_t>> interpolations;
+
+        for (auto& entry: fvm_info.probe_map.data) {
+            if (auto* r = std::get_if<fvm_probe_reduction>(&entry.second.info)) {
+                reductions.push_back({r, divs.size()-1});
+                fvm_index_type offset = terms.size();
+                for (auto d: util::subrange_view(r->term_divs, 1, r->term_divs.size())) {
+                    divs.push_back(offset+d);
+                }
+                util::append(terms, r->terms);
+                util::append(weights, r->weight);
+            }
+            else if (auto* p = std::get_if<fvm_probe_interpolated>(&entry.second.info)) {
+                interpolations.push_back({&entry.second, divs.size()-1});
+                for (unsigned k = 0; k<2; ++k) {
+                    // A missing term, e.g. the stimulus current of a CV
+                    // without stimuli, contributes nothing.
+                    if (p->raw_handles[k]) {
+                        terms.push_back(p->raw_handles[k]);
+                        weights.push_back(p->coef[k]);
+                    }
+                }
+                divs.push_back(terms.size());
+            }
+        }
+
+        if (divs.size()>1) {
+            state_->configure_reductions(terms, weights, divs);
+
+            for (auto& [r, first]: reductions) {
+                for (auto j: util::count_along(r->raw_handles)) {
+                    r->raw_handles[j] = state_->reduction_value.data()+first+j;
+                }
+                r->terms.clear();
+                r->weight.clear();
+                r->term_divs.clear();
+                r->shrink_to_fit();
+            }
+            for (auto& [pdata, i]: interpolations) {
+                mlocation loc = std::get<fvm_probe_interpolated>(pdata->info).metadata;
+                pdata->info = fvm_probe_scalar{{state_->reduction_value.data()+i}, loc};
+            }
+        }
+    }
+
     threshold_watcher_ = backend::voltage_watcher(*state_, detector_cv, detector_threshold, context_);
 
+    // Initialize the mechanisms once, and keep the resulting state for
+    // subsequent resets.
+    initial_state_.clear();
     reset();
+    if (global_props.steady_state_tolerance>0) {
+        relax_to_rest(global_props.steady_state_dt, global_props.steady_state_tolerance, global_props.steady_state_tmax);
+    }
+    {
+        std::ostringstream os;
+        io::serializer out(os);
+        write_state(out);
+        initial_state_ = os.str();
+    }
 
     return fvm_info;
 }
@@ -644,13 +1509,16 @@ std::vector<fvm_gap_junction> fvm_lowered_cell_impl<Backend>::fvm_gap_junctions(
         const std::vector<cable_cell>& cells,
         const std::vector<cell_gid_type>& gids,
         const cell_label_range& gap_junction_data,
-        const recipe& rec, const fvm_cv_discretization& D) {
+        const recipe& rec, const fvm_cv_discretization& D,
+        bool remote_peers) {
 
     std::vector<fvm_gap_junction> gj_vec;
 
-    std::unordered_map<cell_gid_type, std::vector<unsigned>> gid_to_cvs;
+    // With remote peers, the sites of cells without gap junctions of their
+    // own may still be required by other groups.
+    std::unordered_map<cell_gid_type, std::vector<index_type>> gid_to_cvs;
     for (auto cell_idx: util::make_span(0, D.n_cell())) {
-        if (rec.gap_junctions_on(gids[cell_idx]).empty()) continue;
+        if (!remote_peers && rec.gap_junctions_on(gids[cell_idx]).empty()) continue;
 
         const auto& cell_gj = cells[cell_idx].gap_junction_sites();
         gid_to_cvs[gids[cell_idx]].reserve(cell_gj.size());
@@ -660,6 +1528,11 @@ std::vector<fvm_gap_junction> fvm_lowered_cell_impl<Backend>::fvm_gap_junctions(
             gid_to_cvs[gids[cell_idx]].push_back(cv);
         }
     }
+
+    remote_gj_peers_.clear();
+    remote_gj_cv_.clear();
+    remote_gj_weight_.clear();
+
     label_resolution_map resolution_map({gap_junction_data, gids});
     auto gj_resolver = resolver(&resolution_map);
     for (auto gid: gids) {
@@ -672,18 +1545,51 @@ std::vector<fvm_gap_junction> fvm_lowered_cell_impl<Backend>::fvm_gap_junctions(
                 throw gj_unsupported_lid_selection_policy(g.peer.gid, g.peer.label.tag);
             }
             auto cv_local = gid_to_cvs[gid][gj_resolver.resolve({gid, g.local})];
+            auto weight = g.ggap * 1e3 / D.cv_area[cv_local];
+            if (remote_peers && !gid_to_cvs.count(g.peer.gid)) {
+                remote_gj_peers_.push_back(g.peer);
+                remote_gj_cv_.push_back(cv_local);
+                remote_gj_weight_.push_back(weight);
+                continue;
+            }
             auto cv_peer = gid_to_cvs[g.peer.gid][gj_resolver.resolve(g.peer)];
-            gj_vec.emplace_back(fvm_gap_junction(std::make_pair(cv_local, cv_peer), g.ggap * 1e3 / D.cv_area[cv_local]));
+            gj_vec.emplace_back(fvm_gap_junction(std::make_pair(cv_local, cv_peer), weight));
         }
     }
+
+    if (remote_peers) gj_site_cvs_ = std::move(gid_to_cvs);
     return gj_vec;
 }
 
+template <typename Backend>
+void fvm_lowered_cell_impl<Backend>::set_published_gap_junction_sites(const std::vector<cell_member_type>& sites) {
+    published_gj_cvs_.clear();
+    for (const auto& s: sites) {
+        published_gj_cvs_.push_back(gj_site_cvs_.at(s.gid).at(s.index));
+    }
+}
+
+template <typename Backend>
+void fvm_lowered_cell_impl<Backend>::published_gap_junction_voltages(std::vector<value_type>& out) const {
+    if (published_gj_cvs_.empty()) return;
+
+    auto v = backend::host_view(state_->voltage);
+    for (auto cv: published_gj_cvs_) {
+        out.push_back(v[cv]);
+    }
+}
+
+template <typename Backend>
+void fvm_lowered_cell_impl<Backend>::set_remote_gap_junction_voltages(const std::vector<value_type>& v) {
+    if (!remote_gj_cv_.empty()) state_->set_remote_gj_voltage(v);
+}
+
 template <typename Backend>
 fvm_size_type fvm_lowered_cell_impl<Backend>::fvm_intdom(
         const recipe& rec,
         const std::vector<cell_gid_type>& gids,
-        std::vector<fvm_index_type>& cell_to_intdom) {
+        std::vector<fvm_index_type>& cell_to_intdom,
+        bool remote_peers) {
 
     cell_to_intdom.resize(gids.size());
 
@@ -709,6 +1615,7 @@ fvm_size_type fvm_lowered_cell_impl<Backend>::fvm_intdom(
 
             for (auto gj: rec.gap_junctions_on(g)) {
                 if (!gid_to_loc.count(gj.peer.gid)) {
+                    if (remote_peers) continue;
                     throw gj_unsupported_domain_decomposition(g, gj.peer.gid);
                 }
 
@@ -795,6 +1702,7 @@ void fvm_lowered_cell_impl<Backend>::resolve_probe_address(
         cable_probe_total_ion_current_cell,
         cable_probe_total_current_cell,
         cable_probe_stimulus_current_cell,
+        cable_probe_extracellular_potential,
         cable_probe_density_state,
         cable_probe_density_state_cell,
         cable_probe_point_state,
@@ -968,6 +1876,60 @@ void resolve_probe(const cable_probe_stimulus_current_cell& p, probe_resolution_
     R.result.push_back(std::move(r));
 }
 
+template <typename B>
+void resolve_probe(const cable_probe_extracellular_potential& p, probe_resolution_data<B>& R) {
+    fvm_probe_reduction r;
+
+    auto cell_cv_ival = R.D.geometry.cell_cv_interval(R.cell_idx);
+    auto cv0 = cell_cv_ival.first;
+    auto n_cv = cell_cv_ival.second-cv0;
+
+    auto response = fvm_extracellular_response(R.cell, R.D, R.cell_idx, p.electrodes, p.sigma, p.method);
+
+    // The membrane current of a CV, excluding stimuli, is the net axial
+    // current out of it less its stimulus current; the potentials are thus
+    // weighted sums of the CV voltages and stimulus currents.
+    std::vector<probe_handle> terms;
+    for (auto cv: R.D.geometry.cell_cvs(R.cell_idx)) {
+        terms.push_back(R.state->voltage.data()+cv);
+    }
+
+    std::vector<fvm_index_type> stim_cv;
+    std::vector<fvm_value_type> stim_scale;
+    for (auto cv: R.D.geometry.cell_cvs(R.cell_idx)) {
+        auto opt_i = util::binary_search_index(R.M.stimuli.cv_unique, cv);
+        if (!opt_i) continue;
+
+        terms.push_back(R.state->stim_data.accu_stim_.data()+*opt_i);
+        stim_cv.push_back(cv-cv0);
+        stim_scale.push_back(0.001*R.D.cv_area[cv]); // Scale from [µm²·A/m²] to [nA].
+    }
+
+    r.term_divs = {0};
+    for (auto& c: response) {
+        std::vector<fvm_value_type> w(terms.size(), 0.);
+        for (auto cv: util::make_span(n_cv)) {
+            auto parent = R.D.geometry.cv_parent[cv+cv0];
+            if (parent+1==0) continue;
+
+            double k = (c[parent-cv0]-c[cv])*R.D.face_conductance[cv+cv0];
+            w[cv] += k;
+            w[parent-cv0] -= k;
+        }
+        for (auto i: util::count_along(stim_cv)) {
+            w[n_cv+i] = -c[stim_cv[i]]*stim_scale[i];
+        }
+
+        util::append(r.terms, terms);
+        util::append(r.weight, w);
+        r.term_divs.push_back(r.terms.size());
+        r.raw_handles.push_back(nullptr);
+    }
+    r.metadata = p.electrodes;
+
+    R.result.push_back(std::move(r));
+}
+
 template <typename B>
 void resolve_probe(const cable_probe_density_state& p, probe_resolution_data<B>& R) {
     const fvm_value_type* data = R.mechanism_state(p.mechanism, p.state);
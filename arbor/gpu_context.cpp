@@ -36,13 +36,29 @@ void gpu_context::set_gpu() const {
     throw arbor_exception("Arbor must be compiled with CUDA/HIP support to set a GPU.");
 }
 
-gpu_context::gpu_context(int) {
+gpu_context::gpu_context(int, unsigned) {
     throw arbor_exception("Arbor must be compiled with CUDA/HIP support to select a GPU.");
 }
 
+gpu_context::~gpu_context() {}
+
+unsigned gpu_context::acquire_stream() const {
+    throw arbor_exception("Arbor must be compiled with CUDA/HIP support to use a GPU stream.");
+}
+
+void gpu_context::set_stream(unsigned) const {
+    throw arbor_exception("Arbor must be compiled with CUDA/HIP support to use a GPU stream.");
+}
+
+void gpu_context::set_default_stream() const {}
+
+void gpu_context::synchronize_stream(unsigned) const {
+    throw arbor_exception("Arbor must be compiled with CUDA/HIP support to use a GPU stream.");
+}
+
 #else
 
-gpu_context::gpu_context(int gpu_id) {
+gpu_context::gpu_context(int gpu_id, unsigned num_streams) {
     gpu::DeviceProp prop;
     auto status = gpu::get_device_properties(&prop, gpu_id);
     if (status.is_invalid_device()) {
@@ -61,6 +77,21 @@ gpu_context::gpu_context(int gpu_id) {
     if (prop.major*100 + prop.minor >= 600) {
         attributes_ |= gpu_flags::has_atomic_double;
     }
+
+    for (unsigned i = 0; i<num_streams; ++i) {
+        gpu::stream_type stream;
+        auto status = gpu::stream_create(&stream);
+        if (!status) {
+            throw arbor_exception("Unable to create GPU stream: "+status.description());
+        }
+        streams_.push_back(stream);
+    }
+}
+
+gpu_context::~gpu_context() {
+    for (auto s: streams_) {
+        gpu::stream_destroy(static_cast<gpu::stream_type>(s));
+    }
 }
 
 void gpu_context::set_gpu() const {
@@ -75,6 +106,28 @@ void gpu_context::set_gpu() const {
     }
 }
 
+unsigned gpu_context::acquire_stream() const {
+    if (streams_.empty()) {
+        throw arbor_exception("Call to gpu_context::acquire_stream() when the context has no streams.");
+    }
+    return next_stream_++ % streams_.size();
+}
+
+void gpu_context::set_stream(unsigned i) const {
+    gpu::current_stream() = static_cast<gpu::stream_type>(streams_.at(i));
+}
+
+void gpu_context::set_default_stream() const {
+    gpu::current_stream() = 0;
+}
+
+void gpu_context::synchronize_stream(unsigned i) const {
+    auto status = gpu::stream_synchronize(static_cast<gpu::stream_type>(streams_.at(i)));
+    if (!status) {
+        throw arbor_exception("Unable to synchronize GPU stream: "+status.description());
+    }
+}
+
 #endif
 
 } // namespace arb
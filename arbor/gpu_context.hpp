@@ -1,7 +1,9 @@
 #pragma once
 
+#include <atomic>
 #include <cstdlib>
 #include <memory>
+#include <vector>
 
 namespace arb {
 
@@ -9,15 +11,47 @@ class gpu_context {
     int id_ = -1;
     std::size_t attributes_ = 0;
 
+    // Streams owned by the context, held as opaque cudaStream_t/hipStream_t
+    // handles so that the GPU runtime headers are not needed here.
+    std::vector<void*> streams_;
+    mutable std::atomic<unsigned> next_stream_{0};
+
 public:
+    // Number of streams created for a GPU context by default: enough for
+    // a few cell groups to share the device concurrently.
+    static constexpr unsigned default_num_streams = 4;
+
     gpu_context() = default;
-    gpu_context(int id);
+    gpu_context(int id, unsigned num_streams = default_num_streams);
+    ~gpu_context();
+
+    gpu_context(const gpu_context&) = delete;
+    gpu_context& operator=(const gpu_context&) = delete;
 
     bool has_atomic_double() const;
     bool has_gpu() const;
     // Calls set_device(id), so that GPU calls from the calling thread will
     // be executed on the GPU.
     void set_gpu() const;
+
+    unsigned num_streams() const { return streams_.size(); }
+
+    // Reserve a stream for a client, such as a cell group, that issues an
+    // ordered sequence of GPU work. Streams are handed out round-robin, so
+    // that clients share the pool when there are more clients than streams.
+    unsigned acquire_stream() const;
+
+    // Make stream i the stream on which kernels and copies issued by the
+    // calling thread are launched; see gpu::current_stream().
+    void set_stream(unsigned i) const;
+
+    // Return the calling thread to the default stream. Clients select their
+    // stream for the duration of a call, so that the thread is not left
+    // referring to a stream that may be destroyed with the context.
+    void set_default_stream() const;
+
+    // Block the calling thread until the work on stream i has completed.
+    void synchronize_stream(unsigned i) const;
 };
 
 using gpu_context_handle = std::shared_ptr<gpu_context>;
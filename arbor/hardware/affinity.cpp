@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "affinity.hpp"
+
+#ifdef __linux__
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+extern "C" {
+#include <pthread.h>
+#include <sched.h>
+}
+
+namespace arb {
+namespace hw {
+
+// The socket of a CPU, as reported by sysfs; zero if unavailable.
+static int cpu_socket(int cpu) {
+    std::ifstream f("/sys/devices/system/cpu/cpu"+std::to_string(cpu)+"/topology/physical_package_id");
+    int socket = 0;
+    return f >> socket? socket: 0;
+}
+
+std::vector<int> available_cpus() {
+    cpu_set_t cpu_set_mask;
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &cpu_set_mask)) {
+        return {};
+    }
+
+    std::vector<std::pair<int, int>> cpus;
+    for (int i=0; i<CPU_SETSIZE; ++i) {
+        if (CPU_ISSET(i, &cpu_set_mask)) {
+            cpus.push_back({cpu_socket(i), i});
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+
+    std::vector<int> result;
+    for (auto& c: cpus) {
+        result.push_back(c.second);
+    }
+    return result;
+}
+
+static bool bind_native(pthread_t handle, int cpu) {
+    cpu_set_t cpu_set_mask;
+    CPU_ZERO(&cpu_set_mask);
+    CPU_SET(cpu, &cpu_set_mask);
+    return !pthread_setaffinity_np(handle, sizeof(cpu_set_t), &cpu_set_mask);
+}
+
+bool bind_this_thread(int cpu) {
+    return bind_native(pthread_self(), cpu);
+}
+
+bool bind_thread(std::thread& t, int cpu) {
+    return bind_native(t.native_handle(), cpu);
+}
+
+} // namespace hw
+} // namespace arb
+
+#else // def __linux__
+
+// No support for non-linux systems.
+namespace arb {
+namespace hw {
+
+std::vector<int> available_cpus() {
+    return {};
+}
+
+bool bind_this_thread(int) {
+    return false;
+}
+
+bool bind_thread(std::thread&, int) {
+    return false;
+}
+
+} // namespace hw
+} // namespace arb
+
+#endif // def __linux__
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <thread>
+#include <vector>
+
+namespace arb {
+namespace hw {
+
+// Returns the logical CPUs on which the process may run, ordered by socket
+// and then by CPU id, so that consecutive entries share a socket.
+// Returns an empty vector if the affinity can not be determined, or if the
+// operation is not supported on the target architecture.
+std::vector<int> available_cpus();
+
+// Restrict a thread to run only on the given CPU.
+// Returns false on error, or if the operation is not supported on the
+// target architecture.
+bool bind_this_thread(int cpu);
+bool bind_thread(std::thread& t, int cpu);
+
+} // namespace hw
+} // namespace arb
@@ -0,0 +1,181 @@
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#ifdef __linux__
+extern "C" {
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+}
+#endif
+
+#include "perf_counters.hpp"
+
+namespace arb {
+namespace hw {
+
+const char* perf_event_name(unsigned event) {
+    switch (event) {
+        case perf_cycles:       return "cycles";
+        case perf_instructions: return "instructions";
+        case perf_l1d_misses:   return "l1d-misses";
+        case perf_llc_misses:   return "llc-misses";
+    }
+    return "";
+}
+
+#if defined(__linux__)
+namespace {
+
+// The counters of one thread, opened as one group so that all events are read
+// with one system call. Events that can't be opened are left out of the group.
+struct thread_counters {
+    int leader = -1;
+    std::vector<int> fds;
+    // The event counted in each slot of the group.
+    std::vector<unsigned> events;
+    unsigned mask = 0;
+    bool opened = false;
+
+    void open();
+    perf_counts read() const;
+    ~thread_counters();
+};
+
+// All threads with open counters, and the counts of threads that have exited.
+struct counter_registry {
+    std::mutex mutex;
+    std::vector<const thread_counters*> threads;
+    perf_counts retired{};
+};
+
+counter_registry& registry() {
+    static counter_registry r;
+    return r;
+}
+
+thread_local thread_counters this_thread_counters;
+
+perf_event_attr event_attr(unsigned event) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    switch (event) {
+        case perf_cycles:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case perf_instructions:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case perf_l1d_misses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D
+                | (PERF_COUNT_HW_CACHE_OP_READ<<8)
+                | (PERF_COUNT_HW_CACHE_RESULT_MISS<<16);
+            break;
+        case perf_llc_misses:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+    }
+    return attr;
+}
+
+void thread_counters::open() {
+    if (opened) return;
+    opened = true;
+
+    for (unsigned e = 0; e<num_perf_events; ++e) {
+        auto attr = event_attr(e);
+        // The group is created disabled, and enabled once complete.
+        attr.disabled = leader<0;
+        int fd = syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+        if (fd<0) continue;
+        if (leader<0) leader = fd;
+        fds.push_back(fd);
+        events.push_back(e);
+        mask |= 1u<<e;
+    }
+    if (leader<0) return;
+
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    registry().threads.push_back(this);
+}
+
+perf_counts thread_counters::read() const {
+    perf_counts counts{};
+    if (leader<0) return counts;
+
+    // With PERF_FORMAT_GROUP, the number of events followed by their values.
+    std::uint64_t buf[1+num_perf_events];
+    if (::read(leader, buf, sizeof(buf))<ssize_t(sizeof(std::uint64_t))) return counts;
+    for (std::size_t i = 0; i<buf[0] && i<events.size(); ++i) {
+        counts[events[i]] = buf[1+i];
+    }
+    return counts;
+}
+
+thread_counters::~thread_counters() {
+    if (leader<0) return;
+
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    auto counts = read();
+    for (unsigned e = 0; e<num_perf_events; ++e) r.retired[e] += counts[e];
+    for (auto it = r.threads.begin(); it!=r.threads.end(); ++it) {
+        if (*it==this) {
+            r.threads.erase(it);
+            break;
+        }
+    }
+    for (auto fd: fds) close(fd);
+}
+
+} // namespace
+
+unsigned open_thread_perf_counters() {
+    this_thread_counters.open();
+    return this_thread_counters.mask;
+}
+
+perf_counts thread_perf_counts() {
+    this_thread_counters.open();
+    return this_thread_counters.read();
+}
+
+perf_counts total_perf_counts() {
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    auto total = r.retired;
+    for (auto t: r.threads) {
+        auto counts = t->read();
+        for (unsigned e = 0; e<num_perf_events; ++e) total[e] += counts[e];
+    }
+    return total;
+}
+
+#else
+
+unsigned open_thread_perf_counters() {
+    return 0;
+}
+
+perf_counts thread_perf_counts() {
+    return {};
+}
+
+perf_counts total_perf_counts() {
+    return {};
+}
+
+#endif
+
+} // namespace hw
+} // namespace arb
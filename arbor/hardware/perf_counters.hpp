@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace arb {
+namespace hw {
+
+// Hardware events counted in user space on each thread through the Linux
+// perf_event interface. Which events are available depends on the processor,
+// the kernel and /proc/sys/kernel/perf_event_paranoid; none are on other
+// systems.
+enum perf_event: unsigned {
+    perf_cycles,
+    perf_instructions,
+    perf_l1d_misses,  // L1 data cache read misses
+    perf_llc_misses,  // last level cache misses
+    num_perf_events
+};
+
+using perf_counts = std::array<std::uint64_t, num_perf_events>;
+
+// Name of each event, e.g. "l1d-misses".
+const char* perf_event_name(unsigned event);
+
+// Open the counters of the calling thread if not already open, and return a
+// bit mask of the events counted on the thread. Counters are opened on first
+// use by any of the functions below, and are closed when the thread exits.
+unsigned open_thread_perf_counters();
+
+// Events counted on the calling thread since its counters were opened; zero
+// for events that are not counted.
+perf_counts thread_perf_counts();
+
+// Events counted on all threads since their counters were opened, including
+// threads that have exited.
+perf_counts total_perf_counts();
+
+} // namespace hw
+} // namespace arb
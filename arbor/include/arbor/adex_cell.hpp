@@ -0,0 +1,40 @@
+#pragma once
+
+#include <arbor/common_types.hpp>
+
+namespace arb {
+
+// Model parameters of the adaptive exponential integrate and fire neuron,
+//
+//   C_m dV/dt = -g_L (V - E_L) + g_L Delta_T exp((V - V_T)/Delta_T) - w
+//   tau_w dw/dt = a (V - E_L) - w
+//
+// which spikes when V reaches V_peak, after which V is set to V_reset, w is
+// increased by b, and V is held at V_reset for the refractory period. An
+// event of weight q [pC] increases V by q/C_m.
+struct adex_cell {
+    cell_tag_type source; // Label of source.
+    cell_tag_type target; // Label of target.
+
+    // Neuronal parameters.
+    double C_m = 281;        // Membrane capacitance [pF].
+    double g_L = 30;         // Leak conductance [nS].
+    double E_L = -70.6;      // Resting potential [mV].
+    double V_T = -50.4;      // Threshold of the exponential term [mV].
+    double Delta_T = 2;      // Slope factor of the exponential term [mV].
+    double V_peak = 20;      // Spike detection threshold [mV].
+    double V_reset = -70.6;  // Reset potential [mV].
+    double t_ref = 0;        // Refractory period [ms].
+    double a = 4;            // Subthreshold adaptation [nS].
+    double b = 80.5;         // Spike triggered adaptation [pA].
+    double tau_w = 144;      // Adaptation time constant [ms].
+    double V_m = E_L;        // Initial value of the membrane potential [mV].
+    double w = 0;            // Initial value of the adaptation current [pA].
+
+    point_solver_kind solver = point_solver_kind::rk4;
+
+    adex_cell() = delete;
+    adex_cell(cell_tag_type source, cell_tag_type target): source(std::move(source)), target(std::move(target)) {}
+};
+
+} // namespace arb
@@ -164,4 +164,22 @@ struct unsupported_abi_error: arbor_exception {
     size_t version;
 };
 
+// Checkpoint errors
+
+struct bad_checkpoint: arbor_exception {
+    explicit bad_checkpoint(const std::string& msg);
+};
+
+// Sample file errors
+
+struct bad_sample_file: arbor_exception {
+    explicit bad_sample_file(const std::string& msg);
+};
+
+// Spike file errors
+
+struct bad_spike_file: arbor_exception {
+    explicit bad_spike_file(const std::string& msg);
+};
+
 } // namespace arb
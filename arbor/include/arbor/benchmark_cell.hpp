@@ -1,9 +1,27 @@
 #pragma once
 
+#include <cstddef>
+
 #include <arbor/schedule.hpp>
 
 namespace arb {
 
+// Synthetic work done by a benchmark cell at each time step, to emulate the
+// use of caches, memory bandwidth and floating point units by real cells.
+//
+// The state of the cell is an array of `state_bytes` bytes of doubles, which
+// is streamed through at each time step, updating each value by `flops`
+// dependent multiply-adds. A large state with few flops emulates a
+// memory-bound cell; a small state with many flops a compute-bound one.
+// Each event delivered to the cell also updates `event_bytes` bytes of the
+// state at a position that varies from event to event, emulating the scattered
+// accesses of synapses.
+struct benchmark_workload {
+    std::size_t state_bytes = 0;
+    unsigned flops = 1;
+    std::size_t event_bytes = 0;
+};
+
 // Cell description returned by recipe::cell_description(gid) for cells with
 // recipe::cell_kind(gid) returning cell_kind::benchmark
 
@@ -18,11 +36,14 @@ struct benchmark_cell {
     // If equal to 1, then a single cell can be advanced in realtime 
     double realtime_ratio;
 
+    // Work done to advance the cell; the cell busy-waits for the remainder
+    // of the time given by realtime_ratio.
+    benchmark_workload workload;
+
     benchmark_cell() = delete;
-    benchmark_cell(cell_tag_type source, cell_tag_type target, schedule seq, double ratio):
-        source(source), target(target), time_sequence(seq), realtime_ratio(ratio) {};
+    benchmark_cell(cell_tag_type source, cell_tag_type target, schedule seq, double ratio, benchmark_workload workload = {}):
+        source(source), target(target), time_sequence(seq), realtime_ratio(ratio), workload(workload) {};
 };
 
 } // namespace arb
 
-
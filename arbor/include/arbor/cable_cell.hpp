@@ -43,7 +43,8 @@ using cable_sample_range = std::pair<const double*, const double*>;
 //     * `mlocation` for most scalar queries;
 //     * `cable_probe_point_info` for point mechanism state queries;
 //     * `mcable_list` for most vector queries;
-//     * `std::vector<cable_probe_point_info>` for cell-wide point mechanism state queries.
+//     * `std::vector<cable_probe_point_info>` for cell-wide point mechanism state queries;
+//     * `std::vector<mpoint>` for extracellular potentials at a set of electrodes.
 //
 // Scalar probes which are described by a locset expression will generate multiple
 // calls to an attached sampler, one per valid location matched by the expression.
@@ -96,6 +97,25 @@ struct cable_probe_total_current_cell {};
 // Sample metadata type: `mcable_list`
 struct cable_probe_stimulus_current_cell {};
 
+// Extracellular potential [mV] at each of `electrodes`, due to the membrane
+// current of the cell _excluding_ stimulus currents, in a homogeneous medium
+// of conductivity `sigma` [S/m]. The current of each control volume is
+// treated either as spread uniformly along its cables (line sources) or as
+// placed at their midpoints (point sources). The potentials are computed by
+// the back end, and only they are sampled. Electrode radii are ignored.
+// Sample value type: `cable_sample_range`
+// Sample metadata type: `std::vector<mpoint>`
+enum class extracellular_method {
+    line_source,
+    point_source
+};
+
+struct cable_probe_extracellular_potential {
+    std::vector<mpoint> electrodes; // [µm]
+    double sigma = 0.3;             // [S/m]
+    extracellular_method method = extracellular_method::line_source;
+};
+
 // Value of state variable `state` in density mechanism `mechanism` in CV at `location`.
 // Sample value type: `double`
 // Sample metadata type: `mlocation`
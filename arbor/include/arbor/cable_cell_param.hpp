@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <unordered_map>
@@ -26,11 +28,15 @@ struct cable_cell_error: arbor_exception {
 // and set locally via painting init_int_concentration,
 // init_ext_concentration and init_reversal_potential
 // separately (see below).
+//
+// If the diffusivity [m²/s] is positive, the internal concentration
+// diffuses along the cell, driven by the ionic current; it is not painted.
 
 struct cable_cell_ion_data {
     std::optional<double> init_int_concentration;
     std::optional<double> init_ext_concentration;
     std::optional<double> init_reversal_potential;
+    std::optional<double> diffusivity;
 };
 
 // Clamp current is described by a sine wave with amplitude governed by a
@@ -271,9 +277,72 @@ struct cable_cell_global_properties {
     // during integration.
     double membrane_voltage_limit_mV = 0;
 
+    // True => integrate the cable equation with the second order Crank–Nicolson
+    // scheme, instead of implicit Euler, to allow a larger time step.
+    bool crank_nicolson = false;
+
+    // If >0, integrate with adaptive time steps: each integration domain
+    // steps with dt·2^k, for k up to adaptive_dt_max_doublings, chosen from
+    // an estimate of the local error of the membrane voltage, which is kept
+    // below this tolerance [mV].
+    double adaptive_dt_tolerance = 0;
+    unsigned adaptive_dt_max_doublings = 6;
+
     // True => combine linear synapses for performance.
     bool coalesce_synapses = true;
 
+    // True => on the GPU back end, record the kernels of integration steps
+    // as a CUDA/HIP graph and replay it, to amortise kernel launch latency.
+    bool gpu_step_graph = false;
+
+    // True => on the GPU back end, generate the events of incoming spikes on
+    // the device from a device-resident connection table.
+    bool gpu_spike_delivery = false;
+
+    // If >0, on the GPU back end, retain about this many raw samples on the
+    // device before copying them to the host and calling samplers.
+    std::size_t gpu_sample_buffer_size = 0;
+
+    // True => compute the currents of density mechanisms that share their
+    // CVs with a fused kernel, where the catalogue provides a bundle for them.
+    bool mechanism_bundles = true;
+
+    // True => renumber the CVs of each cell so that CVs with the same density
+    // mechanisms are adjacent, for more contiguous mechanism data access.
+    bool reorder_cvs = false;
+
+    // True => on the multicore back end, split the work of large cell groups
+    // between threads: the instances of each mechanism are updated, and the
+    // cells solved, in parallel.
+    bool parallel_cell_groups = false;
+
+    // If positive, gap junctions may join cells in different cell groups and
+    // on different ranks: the voltages at their sites are exchanged every
+    // gap_junction_interval [ms], and held in between. Zero => cells joined
+    // by gap junctions are placed in one cell group.
+    double gap_junction_interval = 0;
+
+    // If positive, the cells start from their resting state instead of the
+    // initial state of their mechanisms: once initialized, they are relaxed
+    // by implicit steps of steady_state_dt [ms], without events, stimuli or
+    // stochastic inputs, until no membrane voltage changes faster than
+    // steady_state_tolerance [mV/ms], or for at most steady_state_tmax [ms].
+    // Time then starts from zero in the relaxed state.
+    double steady_state_tolerance = 0;
+    double steady_state_dt = 1;
+    double steady_state_tmax = 1000;
+
+    // Seed of the WHITE_NOISE variables of mechanisms: their values depend
+    // on the seed, mechanism, gid, instance on the cell and time only.
+    std::uint64_t white_noise_seed = 0;
+
+    // If not empty, a directory in which the discretization and mechanism
+    // data of each cell group are cached: they are read from the cache when
+    // present, instead of being built from the cell descriptions, and written
+    // to it otherwise. Entries built from other cells, global properties or
+    // catalogue are rejected and rewritten.
+    std::string lowered_cache_dir;
+
     // Available ion species, together with charge.
     std::unordered_map<std::string, int> ion_species = {
         {"na", 1},
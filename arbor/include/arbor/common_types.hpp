@@ -126,6 +126,9 @@ enum class cell_kind {
     lif,       // Leaky-integrate and fire neuron.
     spike_source,     // Cell that generates spikes at a user-supplied sequence of time points.
     benchmark,        // Proxy cell used for benchmarking.
+    adex,             // Adaptive exponential integrate and fire neuron.
+    izhikevich,       // Izhikevich neuron.
+    custom,           // First of the kinds of custom cell groups, see custom_cell_group.hpp.
 };
 
 // Enumeration for event time binning policy.
@@ -136,6 +139,57 @@ enum class binning_kind {
     following, // => round times down to previous event if within binning interval.
 };
 
+// Enumeration for the delivery of events to cable cells.
+
+enum class event_delivery_kind {
+    exact,      // => integration steps end at event times.
+    step_start, // => events in a step are applied at its start, on a fixed grid of steps.
+};
+
+// Enumeration for the integration scheme of point neurons with nonlinear
+// dynamics, applied on the time step of the simulation.
+
+enum class point_solver_kind {
+    euler,  // => forward Euler.
+    rk4,    // => classical fourth order Runge-Kutta.
+};
+
+// Enumeration for the strategy used to exchange spikes between domains.
+
+enum class spike_exchange_kind {
+    allgather,      // Every domain receives every spike generated globally.
+    point_to_point, // Domains receive only spikes from sources with local connections.
+};
+
+// Enumeration for the algorithm used to sort pending events by delivery time.
+
+enum class event_sort_kind {
+    comparison, // => comparison sort on the full event ordering.
+    bucket,     // => counting sort into delivery time buckets, then sort within buckets.
+};
+
+// Enumeration for the storage of events pending delivery to local cells.
+
+enum class event_storage_kind {
+    lanes,      // => events are sorted and merged into a lane per cell each epoch.
+    calendar,   // => events are stored by delivery step, and merged per target and step.
+};
+
+// Enumeration for the schedule of cell group updates and spike exchanges.
+
+enum class epoch_schedule {
+    overlapped, // => epochs of half the minimum delay, exchange overlaps the next update.
+    serial,     // => epochs of the minimum delay, exchange follows the update.
+};
+
+// Enumeration for the placement of cell group updates on threads.
+
+enum class group_affinity {
+    none,       // => any thread may update any cell group.
+    preferred,  // => each cell group is updated by the same thread, unless it is overloaded.
+    fixed,      // => each cell group is only ever updated by the same thread.
+};
+
 std::ostream& operator<<(std::ostream& o, lid_selection_policy m);
 std::ostream& operator<<(std::ostream& o, cell_member_type m);
 std::ostream& operator<<(std::ostream& o, cell_kind k);
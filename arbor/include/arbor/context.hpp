@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstddef>
+#include <functional>
 #include <memory>
+#include <vector>
 
 namespace arb {
 
@@ -13,6 +16,20 @@ struct dry_run_info {
             num_cells_per_rank(cells_per_rank) {}
 };
 
+// Strategy used by the thread pool to distribute tasks between threads.
+enum class task_scheduler_kind {
+    notification_queue, // Per-thread locked task queues, visited round-robin.
+    work_stealing,      // Per-thread lock-free deques; idle threads steal tasks.
+};
+
+// Behaviour of a thread that waits for the tasks of a task group to
+// complete, while there are no tasks that it can run itself.
+enum class task_wait_policy {
+    spin,   // Poll the task queues continuously.
+    yield,  // Poll, yielding the processor between attempts after a while.
+    park,   // As yield, then sleep until a task completes or is enqueued.
+};
+
 // A description of local computation resources to use in a computation.
 // By default, a proc_allocation will comprise one thread and no GPU.
 
@@ -25,6 +42,34 @@ struct proc_allocation {
     // See documenation for cuda[/hip]SetDevice and cuda[/hip]DeviceGetAttribute.
     int gpu_id;
 
+    // Further GPU devices to use alongside gpu_id, which must then be
+    // selected. The load balancer spreads GPU cell groups over all of the
+    // devices, so that one rank can drive every GPU of a node. An id may be
+    // repeated, to give a device more than one share of the cell groups.
+    std::vector<int> extra_gpu_ids;
+
+    // Task scheduling strategy of the thread pool.
+    task_scheduler_kind scheduler = task_scheduler_kind::notification_queue;
+
+    // How threads of the thread pool wait for tasks to complete.
+    task_wait_policy wait = task_wait_policy::spin;
+
+    // Pin each thread of the thread pool to a CPU, filling sockets in turn,
+    // and give each cell group of a simulation a fixed owning thread, on
+    // which its state is allocated and updated.
+    bool bind_threads = false;
+
+    // The CPUs to which bind_threads pins the threads, in order. If empty,
+    // the CPUs available to the process are used.
+    std::vector<int> cpus;
+
+    // With MPI, gather spikes through one rank on each node, which exchanges
+    // them with the other nodes and shares them with the ranks of its node in
+    // shared memory. This divides the traffic between nodes by the number of
+    // ranks per node, at the cost of the overlap of the spike exchange with
+    // the update of the cell groups.
+    bool node_shared_spikes = false;
+
     proc_allocation(): proc_allocation(1, -1) {}
 
     proc_allocation(unsigned threads, int gpu):
@@ -68,9 +113,15 @@ context make_context(const proc_allocation& resources, Comm comm);
 
 std::string distribution_type(const context&);
 bool has_gpu(const context&);
+unsigned num_gpus(const context&);
 unsigned num_threads(const context&);
 bool has_mpi(const context&);
 unsigned num_ranks(const context&);
 unsigned rank(const context&);
 
+// Call f(i) for each i in [0, n) on the thread pool of the context, and
+// return once all calls have completed. If any call throws, one of the
+// exceptions is rethrown.
+void run_parallel(const context&, std::size_t n, const std::function<void(std::size_t)>& f);
+
 }
@@ -0,0 +1,97 @@
+#pragma once
+
+// Cell groups implemented outside of arbor.
+//
+// A factory registered for a custom cell kind and a back end builds the
+// groups of cells of that kind, which the simulation then drives like those
+// of the built-in kinds: their spikes are exchanged by the communicator,
+// their events delivered to them, and their updates scheduled on the thread
+// pool. The recipe describes the cells of a custom kind as it does those of
+// the built-in kinds, with get_cell_kind() returning the custom kind.
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+#include <arbor/recipe.hpp>
+#include <arbor/sampling.hpp>
+#include <arbor/schedule.hpp>
+#include <arbor/spike.hpp>
+#include <arbor/spike_event.hpp>
+
+namespace arb {
+
+// The n-th custom cell kind.
+constexpr cell_kind custom_cell_kind(unsigned n) {
+    return static_cast<cell_kind>(static_cast<unsigned>(cell_kind::custom)+n);
+}
+
+// The events of the cells of a group over one epoch: lanes[i] holds the
+// events of the i-th cell of the group, ordered by time. There are no
+// lanes if no cell of the group has events in the epoch.
+struct custom_event_lanes {
+    const pse_vector* lanes = nullptr;
+    std::size_t n = 0;
+
+    std::size_t size() const { return n; }
+    bool empty() const { return !n; }
+    const pse_vector& operator[](std::size_t i) const { return lanes[i]; }
+};
+
+// Labelled ranges of the sources or targets of one cell.
+using custom_cell_label_ranges = std::vector<std::pair<cell_tag_type, lid_range>>;
+
+class custom_cell_group {
+public:
+    virtual ~custom_cell_group() = default;
+
+    // Labels of the sources and targets of the i-th cell of the group.
+    virtual custom_cell_label_ranges source_labels(std::size_t i) const = 0;
+    virtual custom_cell_label_ranges target_labels(std::size_t i) const = 0;
+
+    // Return the cells to their initial state at time zero.
+    virtual void reset() = 0;
+
+    // Advance the cells from t0 to t1 with time step at most dt, applying the
+    // events of the epoch [t0, t1). Spikes generated are held until cleared.
+    virtual void advance(time_type t0, time_type t1, time_type dt, const custom_event_lanes& events) = 0;
+
+    virtual const std::vector<spike>& spikes() const = 0;
+    virtual void clear_spikes() = 0;
+
+    // The state of the cells at the end of an advance(), for checkpointing,
+    // and its restoration at time t. Groups without state need not provide
+    // them.
+    virtual std::string serialize() const { return {}; }
+    virtual void deserialize(const std::string&, time_type t) {}
+
+    // Groups with probes provide samplers and metadata; as for the built-in
+    // cell groups, these may be called from other threads while the group
+    // advances.
+    virtual void add_sampler(sampler_association_handle, cell_member_predicate, schedule, sampler_function, sampling_policy) {}
+    virtual void remove_sampler(sampler_association_handle) {}
+    virtual void remove_all_samplers() {}
+    virtual std::vector<probe_metadata> get_probe_metadata(cell_member_type) const { return {}; }
+};
+
+using custom_cell_group_ptr = std::unique_ptr<custom_cell_group>;
+
+// Builds the group of the cells with the given gids, in that order.
+using custom_cell_group_factory = std::function<
+    custom_cell_group_ptr(const std::vector<cell_gid_type>& gids, const recipe& rec)>;
+
+// Register the factory of the cell groups of a custom cell kind on a back
+// end, replacing any factory registered before for them. The load balancer
+// places cells of a kind on the GPU if a factory is registered for the GPU,
+// subject to the partition_hint of the kind. Throws arbor_exception if the
+// kind is not a custom cell kind.
+void register_cell_group(cell_kind kind, backend_kind backend, custom_cell_group_factory factory);
+
+// Remove the factories of a custom cell kind on all back ends.
+void unregister_cell_group(cell_kind kind);
+
+} // namespace arb
@@ -14,9 +14,7 @@
 // perform other transformations for numeric fidelity or performance reasons.
 //
 // The cv_policy class is a value-like wrapper for actual policies that derive
-// from `cv_policy_base`. At present, there are only a handful of policies
-// implemented, described below. The intent is to provide more sophisticated
-// policies in the near future, specifically one based on the 'd-lambda' rule.
+// from `cv_policy_base`. The policies implemented are described below.
 //
 //   cv_policy_explicit:
 //       Simply use the provided locset.
@@ -31,6 +29,13 @@
 //       Use as many CVs as required to ensure that no CV has
 //       a length longer than a given value.
 //
+//   cv_policy_d_lambda:
+//       Use as many CVs as required to ensure that no CV has an
+//       electrotonic length, at a given frequency, longer than a given
+//       fraction of the AC length constant. The length constant is
+//       computed from the diameter and the painted axial resistivity
+//       and membrane capacitance.
+//
 // The policies above can be restricted to apply only to a given region of a
 // cell morphology. If a region is supplied, the CV policy is applied to the
 // completion of each connected component of the morphology within the region,
@@ -169,6 +174,28 @@ private:
     cv_policy_flag::value flags_;
 };
 
+struct cv_policy_d_lambda: cv_policy_base {
+    cv_policy_d_lambda(double d_lambda, double freq, region domain, cv_policy_flag::value flags = cv_policy_flag::none):
+         d_lambda_(d_lambda), freq_(freq), domain_(std::move(domain)), flags_(flags) {}
+
+    explicit cv_policy_d_lambda(double d_lambda, double freq = 100, cv_policy_flag::value flags = cv_policy_flag::none):
+         d_lambda_(d_lambda), freq_(freq), domain_(reg::all()), flags_(flags) {}
+
+    cv_policy_base_ptr clone() const override;
+    locset cv_boundary_points(const cable_cell&) const override;
+    region domain() const override;
+    std::ostream& print(std::ostream& os) override {
+        os << "(d-lambda " << d_lambda_ << ' ' << freq_ << ' ' << domain_ << ' ' << flags_ << ')';
+        return os;
+    }
+
+private:
+    double d_lambda_;
+    double freq_;
+    region domain_;
+    cv_policy_flag::value flags_;
+};
+
 struct cv_policy_fixed_per_branch: cv_policy_base {
     cv_policy_fixed_per_branch(unsigned cv_per_branch, region domain, cv_policy_flag::value flags = cv_policy_flag::none):
          cv_per_branch_(cv_per_branch), domain_(std::move(domain)), flags_(flags) {}
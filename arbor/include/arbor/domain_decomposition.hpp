@@ -21,8 +21,12 @@ struct group_description {
     /// The back end on which the cell_group is to run.
     backend_kind backend;
 
-    group_description(cell_kind k, std::vector<cell_gid_type> g, backend_kind b):
-        kind(k), gids(std::move(g)), backend(b)
+    /// For the GPU back end, the index of the device in the local context
+    /// on which the cell_group is to run.
+    unsigned device;
+
+    group_description(cell_kind k, std::vector<cell_gid_type> g, backend_kind b, unsigned d = 0):
+        kind(k), gids(std::move(g)), backend(b), device(d)
     {}
 };
 
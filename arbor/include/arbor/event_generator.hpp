@@ -5,6 +5,8 @@
 #include <memory>
 #include <random>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 #include <arbor/assert.hpp>
 #include <arbor/common_types.hpp>
@@ -44,6 +46,14 @@ namespace arb {
 // the lifetime of the generator, and is invalidated upon a call
 // to `reset` or another call to `events`.
 //
+// `void event_generator::append_events(time_type t0, time_type t1, pse_vector& out)`
+//
+//     Append the events in [t0, t1) to `out`, as an alternative to `events`.
+//     This lets the events of many generators be collected in one buffer,
+//     without a buffer of each generator. The pre-defined generators implement
+//     it without an intermediate copy; for other implementations, the view
+//     returned by `events` is copied.
+//
 // Calls to the `events` method must be monotonic in time: without an
 // intervening call to `reset`, two successive calls `events(t0, t1)`
 // and `events(t2, t3)` to the same event generator must satisfy
@@ -75,6 +85,7 @@ struct empty_generator {
     event_seq events(time_type, time_type) {
         return {nullptr, nullptr};
     }
+    void append_events(time_type, time_type, pse_vector&) {}
     void resolve_label(resolution_function) {}
 };
 
@@ -107,15 +118,27 @@ public:
         return impl_->events(t0, t1);
     }
 
+    void append_events(time_type t0, time_type t1, pse_vector& out) {
+        impl_->append_events(t0, t1, out);
+    }
+
     void resolve_label(resolution_function label_resolver) {
         impl_->resolve_label(std::move(label_resolver));
     }
 
 private:
+    template <typename Impl, typename = void>
+    struct has_append_events: std::false_type {};
+
+    template <typename Impl>
+    struct has_append_events<Impl, std::void_t<decltype(std::declval<Impl&>().append_events(time_type{}, time_type{}, std::declval<pse_vector&>()))>>:
+        std::true_type {};
+
     struct interface {
         virtual void reset() = 0;
         virtual void resolve_label(resolution_function) = 0;
         virtual event_seq events(time_type, time_type) = 0;
+        virtual void append_events(time_type, time_type, pse_vector&) = 0;
         virtual std::unique_ptr<interface> clone() = 0;
         virtual ~interface() {}
     };
@@ -131,6 +154,16 @@ private:
             return wrapped.events(t0, t1);
         }
 
+        void append_events(time_type t0, time_type t1, pse_vector& out) override {
+            if constexpr (has_append_events<Impl>::value) {
+                wrapped.append_events(t0, t1, out);
+            }
+            else {
+                auto evs = wrapped.events(t0, t1);
+                if (evs.first!=evs.second) out.insert(out.end(), evs.first, evs.second);
+            }
+        }
+
         void reset() override {
             wrapped.reset();
         }
@@ -150,7 +183,8 @@ private:
 // Convenience routines for making schedule_generator:
 
 // Generate events with a fixed target and weight according to
-// a provided time schedule.
+// a provided time schedule. A target with the assert_univalent policy is
+// resolved once; others are resolved for every event.
 
 struct schedule_generator {
     schedule_generator(cell_local_label_type target, float weight, schedule sched):
@@ -159,6 +193,7 @@ struct schedule_generator {
 
     void resolve_label(resolution_function label_resolver) {
         label_resolver_ = std::move(label_resolver);
+        has_lid_ = false;
     }
 
     void reset() {
@@ -166,22 +201,39 @@ struct schedule_generator {
     }
 
     event_seq events(time_type t0, time_type t1) {
-        auto ts = sched_.events(t0, t1);
-
         events_.clear();
-        events_.reserve(ts.second-ts.first);
+        append_events(t0, t1, events_);
+        return {events_.data(), events_.data()+events_.size()};
+    }
 
-        for (auto i = ts.first; i!=ts.second; ++i) {
-            events_.push_back(spike_event{label_resolver_(target_), *i, weight_});
+    void append_events(time_type t0, time_type t1, pse_vector& out) {
+        times_.clear();
+        sched_.append_events(t0, t1, times_);
+        if (times_.empty()) return;
+
+        if (target_.policy==lid_selection_policy::assert_univalent) {
+            if (!has_lid_) {
+                lid_ = label_resolver_(target_);
+                has_lid_ = true;
+            }
+            for (auto t: times_) {
+                out.push_back(spike_event{lid_, t, weight_});
+            }
+        }
+        else {
+            for (auto t: times_) {
+                out.push_back(spike_event{label_resolver_(target_), t, weight_});
+            }
         }
-
-        return {events_.data(), events_.data()+events_.size()};
     }
 
 private:
     pse_vector events_;
+    std::vector<time_type> times_;
     cell_local_label_type target_;
     resolution_function label_resolver_;
+    cell_lid_type lid_ = 0;
+    bool has_lid_ = false;
     float weight_;
     schedule sched_;
 };
@@ -250,6 +302,11 @@ struct explicit_generator {
         return {lb, ub};
     }
 
+    void append_events(time_type t0, time_type t1, pse_vector& out) {
+        auto evs = events(t0, t1);
+        out.insert(out.end(), evs.first, evs.second);
+    }
+
 private:
     lse_vector input_events_;
     pse_vector events_;
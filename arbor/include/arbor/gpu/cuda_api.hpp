@@ -40,6 +40,10 @@ constexpr auto gpuMemcpyHostToDevice = cudaMemcpyHostToDevice;
 constexpr auto gpuMemcpyDeviceToDevice = cudaMemcpyDeviceToDevice;
 constexpr auto gpuHostRegisterPortable = cudaHostRegisterPortable;
 
+using stream_type = cudaStream_t;
+using graph_type = cudaGraph_t;
+using graph_exec_type = cudaGraphExec_t;
+
 template <typename... ARGS>
 inline api_error_type get_device_properties(ARGS &&... args) {
     return cudaGetDeviceProperties(std::forward<ARGS>(args)...);
@@ -70,6 +74,11 @@ inline api_error_type device_malloc(ARGS &&... args) {
     return cudaMalloc(std::forward<ARGS>(args)...);
 }
 
+template <typename... ARGS>
+inline api_error_type device_malloc_managed(ARGS &&... args) {
+    return cudaMallocManaged(std::forward<ARGS>(args)...);
+}
+
 template <typename... ARGS>
 inline api_error_type device_free(ARGS &&... args) {
     return cudaFree(std::forward<ARGS>(args)...);
@@ -80,7 +89,95 @@ inline api_error_type device_mem_get_info(ARGS &&... args) {
     return cudaMemGetInfo(std::forward<ARGS>(args)...);
 }
 
+/// Streams
+
+template <typename... ARGS>
+inline api_error_type device_memcpy_async(ARGS &&... args) {
+    return cudaMemcpyAsync(std::forward<ARGS>(args)...);
+}
+
+// Streams are created blocking, so that any work left on the legacy default
+// stream remains ordered with respect to them.
+inline api_error_type stream_create(stream_type* stream) {
+    return cudaStreamCreate(stream);
+}
+
+inline api_error_type stream_destroy(stream_type stream) {
+    return cudaStreamDestroy(stream);
+}
+
+inline api_error_type stream_synchronize(stream_type stream) {
+    return cudaStreamSynchronize(stream);
+}
+
+/// Graphs
+
+// Work issued by the calling thread on a stream between begin and end of
+// capture is recorded into a graph rather than executed.
+inline api_error_type stream_begin_capture(stream_type stream) {
+    return cudaStreamBeginCapture(stream, cudaStreamCaptureModeThreadLocal);
+}
+
+inline api_error_type stream_end_capture(stream_type stream, graph_type* graph) {
+    return cudaStreamEndCapture(stream, graph);
+}
+
+inline api_error_type graph_instantiate(graph_exec_type* exec, graph_type graph) {
+    return cudaGraphInstantiateWithFlags(exec, graph, 0);
+}
+
+// Replace the parameters of the nodes of exec with those of graph, which
+// must have the same topology.
+inline api_error_type graph_exec_update(graph_exec_type exec, graph_type graph) {
+#if CUDART_VERSION >= 12000
+    cudaGraphExecUpdateResultInfo info;
+    return cudaGraphExecUpdate(exec, graph, &info);
+#else
+    cudaGraphNode_t node;
+    cudaGraphExecUpdateResult result;
+    return cudaGraphExecUpdate(exec, graph, &node, &result);
+#endif
+}
+
+inline api_error_type graph_launch(graph_exec_type exec, stream_type stream) {
+    return cudaGraphLaunch(exec, stream);
+}
+
+inline api_error_type graph_destroy(graph_type graph) {
+    return cudaGraphDestroy(graph);
+}
+
+inline api_error_type graph_exec_destroy(graph_exec_type exec) {
+    return cudaGraphExecDestroy(exec);
+}
+
 #ifdef __CUDACC__
+/// Kernel launch
+
+// The block size, at most `limit`, that gives the largest occupancy for
+// `kernel` on the current device; `limit` if it can not be determined.
+template <typename Kernel>
+inline unsigned max_block_size(Kernel kernel, unsigned limit) {
+    int grid_size = 0, block_size = 0;
+    if (cudaOccupancyMaxPotentialBlockSize(&grid_size, &block_size, kernel, 0, limit)!=cudaSuccess || block_size<=0) {
+        return limit;
+    }
+    return block_size;
+}
+
+/// Read-only loads
+
+// Load through the read-only data cache, for data that is not written for
+// the lifetime of the kernel.
+template <typename T>
+__device__ __inline__ T ldg(const T* p) {
+#if __CUDA_ARCH__ >= 350
+    return __ldg(p);
+#else
+    return *p;
+#endif
+}
+
 /// Atomics
 
 // Wrappers around CUDA addition functions.
@@ -7,3 +7,18 @@
 #ifdef ARB_HIP
 #include "hip_api.hpp"
 #endif
+
+#if defined(ARB_CUDA) || defined(ARB_HIP)
+namespace arb {
+namespace gpu {
+
+// The stream on which the calling thread issues kernels and copies.
+// Defaults to the legacy default stream; see gpu_context::set_stream.
+inline stream_type& current_stream() {
+    static thread_local stream_type stream = 0;
+    return stream;
+}
+
+} // namespace gpu
+} // namespace arb
+#endif
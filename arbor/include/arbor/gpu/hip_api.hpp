@@ -39,6 +39,10 @@ constexpr auto gpuMemcpyHostToDevice = hipMemcpyHostToDevice;
 constexpr auto gpuMemcpyDeviceToDevice = hipMemcpyDeviceToDevice;
 constexpr auto gpuHostRegisterPortable = hipHostRegisterPortable;
 
+using stream_type = hipStream_t;
+using graph_type = hipGraph_t;
+using graph_exec_type = hipGraphExec_t;
+
 template <typename... ARGS>
 inline api_error_type get_device_properties(ARGS&&... args) {
     return hipGetDeviceProperties(std::forward<ARGS>(args)...);
@@ -69,6 +73,11 @@ inline api_error_type device_malloc(ARGS&&... args) {
     return hipMalloc(std::forward<ARGS>(args)...);
 }
 
+template <typename... ARGS>
+inline api_error_type device_malloc_managed(ARGS&&... args) {
+    return hipMallocManaged(std::forward<ARGS>(args)...);
+}
+
 template <typename... ARGS>
 inline api_error_type device_free(ARGS&&... args) {
     return hipFree(std::forward<ARGS>(args)...);
@@ -79,6 +88,85 @@ inline api_error_type device_mem_get_info(ARGS&&... args) {
     return hipMemGetInfo(std::forward<ARGS>(args)...);
 }
 
+/// Streams
+
+template <typename... ARGS>
+inline api_error_type device_memcpy_async(ARGS&&... args) {
+    return hipMemcpyAsync(std::forward<ARGS>(args)...);
+}
+
+// Streams are created blocking, so that any work left on the legacy default
+// stream remains ordered with respect to them.
+inline api_error_type stream_create(stream_type* stream) {
+    return hipStreamCreate(stream);
+}
+
+inline api_error_type stream_destroy(stream_type stream) {
+    return hipStreamDestroy(stream);
+}
+
+inline api_error_type stream_synchronize(stream_type stream) {
+    return hipStreamSynchronize(stream);
+}
+
+/// Graphs
+
+// Work issued by the calling thread on a stream between begin and end of
+// capture is recorded into a graph rather than executed.
+inline api_error_type stream_begin_capture(stream_type stream) {
+    return hipStreamBeginCapture(stream, hipStreamCaptureModeThreadLocal);
+}
+
+inline api_error_type stream_end_capture(stream_type stream, graph_type* graph) {
+    return hipStreamEndCapture(stream, graph);
+}
+
+inline api_error_type graph_instantiate(graph_exec_type* exec, graph_type graph) {
+    return hipGraphInstantiateWithFlags(exec, graph, 0);
+}
+
+// Replace the parameters of the nodes of exec with those of graph, which
+// must have the same topology.
+inline api_error_type graph_exec_update(graph_exec_type exec, graph_type graph) {
+    hipGraphNode_t node;
+    hipGraphExecUpdateResult result;
+    return hipGraphExecUpdate(exec, graph, &node, &result);
+}
+
+inline api_error_type graph_launch(graph_exec_type exec, stream_type stream) {
+    return hipGraphLaunch(exec, stream);
+}
+
+inline api_error_type graph_destroy(graph_type graph) {
+    return hipGraphDestroy(graph);
+}
+
+inline api_error_type graph_exec_destroy(graph_exec_type exec) {
+    return hipGraphExecDestroy(exec);
+}
+
+/// Kernel launch
+
+// The block size, at most `limit`, that gives the largest occupancy for
+// `kernel` on the current device; `limit` if it can not be determined.
+template <typename Kernel>
+inline unsigned max_block_size(Kernel kernel, unsigned limit) {
+    int grid_size = 0, block_size = 0;
+    if (hipOccupancyMaxPotentialBlockSize(&grid_size, &block_size, kernel, 0, limit)!=hipSuccess || block_size<=0) {
+        return limit;
+    }
+    return block_size;
+}
+
+/// Read-only loads
+
+// AMD GPUs have no separate read-only cache; the load is left to the
+// compiler, which may use scalar loads for const __restrict__ data.
+template <typename T>
+__device__ __inline__ T ldg(const T* p) {
+    return *p;
+}
+
 /// Atomics
 
 __device__
@@ -26,6 +26,23 @@ inline double exprelr(double x) {
     return x/expm1(x);
 }
 
+// Single precision variants, used by mechanisms compiled with --gpu-single-precision.
+__device__
+inline float safeinv(float x) {
+    if (1.0f+x == 1.0f) {
+        return 1/FLT_EPSILON;
+    }
+    return 1/x;
+}
+
+__device__
+inline float exprelr(float x) {
+    if (1.0f+x == 1.0f) {
+        return 1.0f;
+    }
+    return x/expm1f(x);
+}
+
 // Return minimum of the two values
 template <typename T>
 __device__
@@ -40,6 +57,19 @@ inline T max(T lhs, T rhs) {
     return lhs<rhs? rhs: lhs;
 }
 
+// Mixed precision arguments are compared in the wider type.
+template <typename T, typename U>
+__device__
+inline auto min(T lhs, U rhs) -> decltype(lhs+rhs) {
+    return lhs<rhs? lhs: rhs;
+}
+
+template <typename T, typename U>
+__device__
+inline auto max(T lhs, U rhs) -> decltype(lhs+rhs) {
+    return lhs<rhs? rhs: lhs;
+}
+
 template <typename T>
 __device__
 inline T lerp(T a, T b, T u) {
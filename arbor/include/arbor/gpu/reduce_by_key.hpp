@@ -16,9 +16,9 @@ namespace gpu {
 // knows how far it is from the end of the key set, and whether it is the first
 // thread in the warp with the key.
 //
-// As currently implemented, this could be performed inline inside the reduce_by_key
-// function, however it is in a separate data type as a first step towards reusing
-// the same key set information for multipe reduction kernel calls.
+// The key set depends only on the indices, so that a kernel that reduces several
+// values with the same index array, such as the current and the conductance of a
+// point mechanism, computes it once and passes it to each reduce_by_key.
 struct key_set_pos {
     unsigned width;         // distance to one past the end of this run
     unsigned lane_id;       // id of this warp lane
@@ -52,8 +52,7 @@ struct key_set_pos {
 
 template <typename T, typename I>
 __device__ __inline__
-void reduce_by_key(T contribution, T* target, I i, unsigned mask) {
-    key_set_pos run(i, mask);
+void reduce_by_key(T contribution, T* target, I i, const key_set_pos& run) {
     unsigned shift = 1;
     const unsigned width = run.width;
 
@@ -74,5 +73,11 @@ void reduce_by_key(T contribution, T* target, I i, unsigned mask) {
     }
 }
 
+template <typename T, typename I>
+__device__ __inline__
+void reduce_by_key(T contribution, T* target, I i, unsigned mask) {
+    reduce_by_key(contribution, target, i, key_set_pos(i, mask));
+}
+
 } // namespace gpu
 } // namespace arb
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <arbor/common_types.hpp>
+
+namespace arb {
+
+// Model parameters of the Izhikevich neuron,
+//
+//   dv/dt = 0.04 v^2 + 5 v + 140 - u
+//   du/dt = a (b v - u)
+//
+// with v in mV and t in ms, which spikes when v reaches v_peak, after which
+// v is set to c and u is increased by d. An event of weight q increases v
+// by q [mV]. The default parameters are those of a regular spiking neuron.
+struct izhikevich_cell {
+    cell_tag_type source; // Label of source.
+    cell_tag_type target; // Label of target.
+
+    // Neuronal parameters.
+    double a = 0.02;      // Time scale of the recovery variable [1/ms].
+    double b = 0.2;       // Sensitivity of the recovery variable.
+    double c = -65;       // Reset potential [mV].
+    double d = 8;         // Increase of the recovery variable on a spike.
+    double v_peak = 30;   // Spike detection threshold [mV].
+    double v = -65;       // Initial value of the membrane potential [mV].
+    double u = b*v;       // Initial value of the recovery variable.
+
+    point_solver_kind solver = point_solver_kind::rk4;
+
+    izhikevich_cell() = delete;
+    izhikevich_cell(cell_tag_type source, cell_tag_type target): source(std::move(source)), target(std::move(target)) {}
+};
+
+} // namespace arb
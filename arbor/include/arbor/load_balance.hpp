@@ -2,7 +2,9 @@
 
 #include <cstddef>
 #include <unordered_map>
+#include <vector>
 
+#include <arbor/common_types.hpp>
 #include <arbor/context.hpp>
 #include <arbor/domain_decomposition.hpp>
 #include <arbor/recipe.hpp>
@@ -15,13 +17,53 @@ struct partition_hint {
     std::size_t cpu_group_size = 1;
     std::size_t gpu_group_size = max_size;
     bool prefer_gpu = true;
+    // Fraction of the cost of the cells of a GPU kind to place in CPU cell
+    // groups instead, which run alongside the GPU groups on the CPU threads.
+    double cpu_fraction = 0;
 };
 
 using partition_hint_map = std::unordered_map<cell_kind, partition_hint>;
 
+// Enumeration for the assignment of cells to domains.
+
+enum class domain_partition_kind {
+    gid_block,    // => each domain is given a contiguous range of gids.
+    connectivity, // => cells are assigned by a streaming partition of the connection graph.
+};
+
 domain_decomposition partition_load_balance(
     const recipe& rec,
     const context& ctx,
-    partition_hint_map hint_map = {});
+    partition_hint_map hint_map = {},
+    domain_partition_kind partition = domain_partition_kind::gid_block);
+
+// Merge the GPU cell groups of the local domain that have the same cell kind
+// and device into one group, in place of the first of them, so that each
+// device advances all of its cells of a kind with one sequence of kernels.
+// The gids of the merged group are those of the groups in order, such that
+// cells connected by gap junctions stay in one group.
+domain_decomposition fuse_gpu_groups(domain_decomposition d);
+
+// Trials run by tune_partition_hints for each cell kind.
+struct partition_tuning {
+    // Candidate group sizes.
+    std::vector<std::size_t> group_sizes = {1, 4, 16, 64, 256, 1024};
+    // Largest number of cells of a kind built for the trials.
+    std::size_t max_sample = 2048;
+    // Time step [ms] and number of steps timed for each candidate.
+    time_type dt = 0.025;
+    unsigned steps = 20;
+};
+
+// Choose the group size of each cell kind of the recipe by timing trial
+// groups of each candidate size, built from a sample of the cells of the
+// kind. Returns the hints with the group size set for the backend on which
+// partition_load_balance will place the kind; other fields are unchanged.
+// Collective over the domains of the context.
+partition_hint_map tune_partition_hints(
+    const recipe& rec,
+    const context& ctx,
+    partition_hint_map hints = {},
+    const partition_tuning& opts = {});
 
 } // namespace arb
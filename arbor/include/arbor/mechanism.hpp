@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -56,12 +57,12 @@ public:
     void set_parameter(const std::string&, const std::vector<arb_value_type>&);
 
     // Forward to interface methods
-    void initialize()     { ppack_.vec_t = *time_ptr_ptr; iface_.init_mechanism(&ppack_); }
-    void update_current() { ppack_.vec_t = *time_ptr_ptr; iface_.compute_currents(&ppack_); }
-    void update_state()   { ppack_.vec_t = *time_ptr_ptr; iface_.advance_state(&ppack_); }
-    void update_ions()    { ppack_.vec_t = *time_ptr_ptr; iface_.write_ions(&ppack_); }
-    void post_event()     { ppack_.vec_t = *time_ptr_ptr; iface_.post_event(&ppack_); }
-    void deliver_events(arb_deliverable_event_stream& stream) { ppack_.vec_t  = *time_ptr_ptr; iface_.apply_events(&ppack_, &stream); }
+    void initialize()     { ppack_.vec_t = *time_ptr_ptr; call(method_init, iface_.init_mechanism); }
+    void update_current() { ppack_.vec_t = *time_ptr_ptr; call(method_current, iface_.compute_currents); }
+    void update_state()   { ppack_.vec_t = *time_ptr_ptr; call(method_state, iface_.advance_state); }
+    void update_ions()    { ppack_.vec_t = *time_ptr_ptr; call(method_ions, iface_.write_ions); }
+    void post_event()     { ppack_.vec_t = *time_ptr_ptr; call(method_post, iface_.post_event); }
+    void deliver_events(arb_deliverable_event_stream& stream) { ppack_.vec_t  = *time_ptr_ptr; call(iface_.apply_events, stream); }
 
     // Per-cell group identifier for an instantiated mechanism.
     unsigned mechanism_id() const { return ppack_.mechanism_id; }
@@ -70,6 +71,40 @@ public:
     arb_mechanism_interface iface_;
     arb_mechanism_ppack ppack_;
     arb_value_type** time_ptr_ptr;
+
+private:
+    enum method_index { method_init, method_current, method_events, method_state, method_ions, method_post, n_methods };
+
+    // Call an interface method, timing it if enabled in the profiler.
+    void call(method_index, arb_mechanism_method);
+    void call(arb_mechanism_method_events, arb_deliverable_event_stream&);
+
+    // Profiler ids of the methods, assigned on the first timed call.
+    std::size_t timing_ids_[n_methods] = {npos, npos, npos, npos, npos, npos};
+    static constexpr std::size_t npos = std::size_t(-1);
+};
+
+// Co-located density mechanisms whose currents are computed by a single fused
+// kernel; see arb_mechanism_bundle_interface.
+class mechanism_bundle {
+public:
+    mechanism_bundle(const arb_mechanism_bundle_interface& i, std::vector<mechanism*> members):
+        iface_{i}, members_(std::move(members))
+    {
+        for (auto m: members_) ppacks_.push_back(&m->ppack_);
+    }
+
+    void update_current() {
+        for (auto m: members_) m->ppack_.vec_t = *m->time_ptr_ptr;
+        iface_.compute_currents(ppacks_.data(), ppacks_.size());
+    }
+
+    const std::vector<mechanism*>& members() const { return members_; }
+
+private:
+    arb_mechanism_bundle_interface iface_;
+    std::vector<mechanism*> members_;
+    std::vector<arb_mechanism_ppack*> ppacks_;
 };
 
 struct mechanism_layout {
@@ -82,6 +117,13 @@ struct mechanism_layout {
     // Number of logical point processes at in-instance index;
     // if empty, point processes are not coalesced and all multipliers are 1.
     std::vector<fvm_index_type> multiplicity;
+
+    // Mechanisms with random variables only: the key of the mechanism, from
+    // the seed and its name, and the counter word of each in-instance index,
+    // from the gid of the cell and the index of the instance on the cell.
+    std::uint64_t random_seed = 0;
+    std::uint64_t random_stream = 0;
+    std::vector<std::uint64_t> random_instance;
 };
 
 struct mechanism_overrides {
@@ -9,9 +9,9 @@ extern "C" {
 
 // Version
 #define ARB_MECH_ABI_VERSION_MAJOR 0
-#define ARB_MECH_ABI_VERSION_MINOR 0
-#define ARB_MECH_ABI_VERSION_PATCH 1
-#define ARB_MECH_ABI_VERSION ((ARB_MECH_ABI_VERSION_MAJOR * 10000 * 10000) + (ARB_MECH_ABI_VERSION_MAJOR * 10000) + ARB_MECH_ABI_VERSION_PATCH)
+#define ARB_MECH_ABI_VERSION_MINOR 6
+#define ARB_MECH_ABI_VERSION_PATCH 0
+#define ARB_MECH_ABI_VERSION ((ARB_MECH_ABI_VERSION_MAJOR * 10000 * 10000) + (ARB_MECH_ABI_VERSION_MINOR * 10000) + ARB_MECH_ABI_VERSION_PATCH)
 
 typedef const char* arb_mechanism_fingerprint;
 
@@ -70,7 +70,6 @@ typedef struct arb_constraint_partition {
 // Parameter Pack
 typedef struct arb_mechanism_ppack {
     arb_size_type  width;                           // Number of CVs
-    arb_index_type  n_detectors;                     // Number of spike detectors
     arb_index_type* vec_ci;
     arb_index_type* vec_di;
     const arb_value_type* vec_t;
@@ -80,7 +79,8 @@ typedef struct arb_mechanism_ppack {
     arb_value_type* vec_g;
     arb_value_type* temperature_degC;
     arb_value_type* diam_um;
-    arb_value_type* time_since_spike;
+    arb_value_type* time_since_spike;               // Time since last spike, per detector, grouped by cell
+    arb_index_type* detector_divs;                  // Detectors of cell i are [detector_divs[i], detector_divs[i+1])
     arb_index_type* node_index;
     arb_index_type* multiplicity;
     arb_value_type* weight;
@@ -93,6 +93,19 @@ typedef struct arb_mechanism_ppack {
     arb_value_type** state_vars;                    // Array of integrable state       (Array)
     arb_value_type*  globals;                       // Array of global constant state  (Scalar)
     arb_ion_state*   ion_states;                    // Array of views into shared state
+
+    // Mechanisms with an active index only; see `has_active_index`.
+    arb_size_type    n_active;                      // Number of active instances
+    arb_index_type*  active_index;                  // Active instances, first n_active entries  (Array)
+    arb_index_type*  active_flag;                   // Non-zero for active instances            (Array)
+
+    // Non-zero if `node_index` and all ion indices satisfy index[i] == index[0] + i
+    // for i < width; kernels may then compute indices instead of loading them.
+    arb_index_type   index_contiguous;
+
+    // Standard normal samples of the step, one per random variable and instance;
+    // drawn by the library before the kernels of each step.
+    arb_value_type** random_numbers;                // Array of white noise            (Array)
 } arb_mechanism_ppack;
 
 
@@ -155,8 +168,33 @@ typedef struct arb_mechanism_interface {
      * - corresponds to NET_RECEIVE in NMODL
      */
     arb_mechanism_method post_event;
+    /* Optional: the same methods, specialised for the case that every
+     * parameter has the same value for all instances, or null. The engine
+     * substitutes them after instantiation if the parameters allow it.
+     */
+    struct arb_mechanism_interface* uniform_parameters;
 } arb_mechanism_interface;
 
+/* Mechanism Bundle
+ *
+ * A fused implementation of `compute_currents` for several density mechanisms
+ * that are placed on the same CVs, so that the voltage is read and the current
+ * and conductivity are accumulated once per CV rather than once per mechanism.
+ *
+ * The engine substitutes the bundle for the members' own `compute_currents`
+ * when every member is instantiated in a cell group with identical
+ * `node_index`. The method receives the members' ppacks in the order of
+ * `members`; all share `width`, `node_index`, `vec_v`, `vec_i` and `vec_g`.
+ */
+typedef void (*arb_mechanism_bundle_method)(arb_mechanism_ppack**, arb_size_type);
+
+typedef struct arb_mechanism_bundle_interface {
+    arb_backend_kind            backend;
+    const char**                members;   // Names of the member mechanisms
+    arb_size_type               n_members;
+    arb_mechanism_bundle_method compute_currents;
+} arb_mechanism_bundle_interface;
+
 typedef struct arb_field_info {
     const char* name;
     const char* unit;
@@ -186,6 +224,8 @@ typedef struct arb_mechanism_type {
     arb_mechanism_kind        kind;             // Point, Density, ReversalPotential, ...
     bool                      is_linear;        // linear, homogeneous mechanism
     bool                      has_post_events;
+    bool                      has_active_index; // instances may be quiescent; the kernels maintain the active index
+    bool                      has_additive_events; // events to an instance may be combined by summing their weights
     // Tables
     arb_field_info*           globals;          // Global constants
     arb_size_type             n_globals;
@@ -195,6 +235,8 @@ typedef struct arb_mechanism_type {
     arb_size_type             n_parameters;
     arb_ion_info*             ions;             // Ion properties
     arb_size_type             n_ions;
+    arb_field_info*           random_variables; // White noise, read only
+    arb_size_type             n_random_variables;
 } arb_mechanism_type;
 
 #ifdef __cplusplus
@@ -20,6 +20,9 @@
 // 3. A map taking mechanism names x back-end kind -> mechanism implementation
 //    prototype object.
 //
+// 4. A list of mechanism bundles: fused implementations of compute_currents
+//    over several co-located density mechanisms, by back-end kind.
+//
 // References to mechanism_info and mechanism_fingerprint objects are invalidated
 // after any modification to the catalogue.
 //
@@ -93,6 +96,18 @@ public:
         register_impl(be, name, std::move(proto));
     }
 
+    // Fused current kernel over mechanisms in this catalogue; members are named
+    // by the bundle interface.
+    struct bundle_entry {
+        std::vector<std::string> members;
+        arb_mechanism_bundle_interface iface;
+    };
+
+    void register_bundle(const arb_mechanism_bundle_interface& iface);
+
+    // Bundles registered for a back-end kind.
+    std::vector<bundle_entry> bundles(arb_backend_kind kind) const;
+
     // Copy over another catalogue's mechanism and attach a -- possibly empty -- prefix
     void import(const mechanism_catalogue& other, const std::string& prefix);
 
@@ -73,6 +73,10 @@ struct mechanism_info {
     // Ion dependencies.
     std::unordered_map<std::string, ion_dependency> ions;
 
+    // Random variables take an independent standard normal value per
+    // instance and time step, drawn by the library.
+    std::vector<std::string> random_variables;
+
     mechanism_fingerprint fingerprint;
 
     bool linear = false;
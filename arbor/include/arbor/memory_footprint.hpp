@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+#include <vector>
+
+namespace arb {
+
+// Bytes held in host and in device memory.
+struct memory_use {
+    std::size_t host = 0;
+    std::size_t device = 0;
+
+    std::size_t total() const { return host+device; }
+
+    memory_use& operator+=(const memory_use& other) {
+        host += other.host;
+        device += other.device;
+        return *this;
+    }
+};
+
+// Bytes held by the parts of a simulation on the local domain, as reported
+// by the data structures themselves; see simulation::memory_footprint.
+struct memory_footprint {
+    memory_use communicator;             // connection and routing tables
+    memory_use label_resolution;         // target labels of event generators
+    memory_use events;                   // pending events, event lanes and spikes
+    memory_use samplers;                 // sample buffers
+    std::vector<memory_use> cell_groups; // state of each cell group
+
+    memory_use total() const;
+};
+
+std::ostream& operator<<(std::ostream&, const memory_footprint&);
+
+} // namespace arb
@@ -42,6 +42,10 @@ struct embed_pwlin {
     double directed_projection(mlocation) const;
     mcable_list projection_cmp(msize_t bid, double proj_lim, comp_op op) const;
 
+    // Length, area and ixa are held as cumulative values from the root, so
+    // that the integral over a cable is the difference of two lookups, each
+    // a binary search within the branch.
+
     // Computed length of mcable.
     double integrate_length(mcable c) const;
     double integrate_length(mlocation proxmal, mlocation distal) const;
@@ -59,6 +63,11 @@ struct embed_pwlin {
     // Integrated inverse cross-sectional area of given mcable.
     double integrate_ixa(mcable c) const;
 
+    // Sums of the above over the cables of a cable list.
+    double integrate_length(const mcable_list&) const;
+    double integrate_area(const mcable_list&) const;
+    double integrate_ixa(const mcable_list&) const;
+
     double integrate_ixa(mcable c, const pw_constant_fn&) const;
     double integrate_ixa(msize_t bid, const pw_constant_fn&) const;
 
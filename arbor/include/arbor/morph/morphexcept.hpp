@@ -41,6 +41,12 @@ struct invalid_segment_parent: morphology_error {
     msize_t tree_size;
 };
 
+struct segment_array_size_mismatch: morphology_error {
+    segment_array_size_mismatch(msize_t expected, msize_t size);
+    msize_t expected;
+    msize_t size;
+};
+
 struct duplicate_stitch_id: morphology_error {
     duplicate_stitch_id(const std::string& id);
     std::string id;
@@ -11,6 +11,9 @@
 namespace arb {
 
 struct morphology_impl;
+struct morphology_label_cache;
+struct embed_pwlin;
+struct mprovider;
 
 class morphology {
     // Hold an immutable copy of the morphology implementation.
@@ -40,7 +43,17 @@ public:
     // Range of segments in a branch.
     const std::vector<msegment>& branch_segments(msize_t b) const;
 
+    // The embedding of the morphology, computed on first use and shared by
+    // all copies of the morphology.
+    const embed_pwlin& embedding() const;
+
     friend std::ostream& operator<<(std::ostream&, const morphology&);
+
+private:
+    // Regions and locsets evaluated by the mproviders of the morphology,
+    // shared by all copies of the morphology.
+    friend struct mprovider;
+    morphology_label_cache& label_cache() const;
 };
 
 // Represent a (possibly empty or disconnected) region on a morphology.
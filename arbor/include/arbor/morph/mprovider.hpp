@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 
@@ -12,6 +13,8 @@ namespace arb {
 
 using concrete_embedding = embed_pwlin;
 
+struct label_evaluation;
+
 struct mprovider {
     mprovider(arb::morphology m, const label_dict& dict): mprovider(m, &dict) {}
     explicit mprovider(arb::morphology m): mprovider(m, nullptr) {}
@@ -20,16 +23,25 @@ struct mprovider {
     const mextent& region(const std::string& name) const;
     const mlocation_list& locset(const std::string& name) const;
 
-    // Read-only access to morphology and constructed embedding.
+    // Evaluate a region or locset expression. Results are shared with every
+    // provider of the same morphology (or a copy of it) and an identical
+    // label dictionary, so that an expression is evaluated once for all the
+    // cells built from them.
+    mextent evaluate(const arb::region&) const;
+    mlocation_list evaluate(const arb::locset&) const;
+
+    // Read-only access to morphology and its embedding, which is shared by
+    // all providers of the same morphology.
     const auto& morphology() const { return morphology_; }
-    const auto& embedding() const { return embedding_; }
+    const concrete_embedding& embedding() const { return morphology_.embedding(); }
 
 private:
-    mprovider(arb::morphology m, const label_dict* ldptr):
-        morphology_(m), embedding_(m), label_dict_ptr(ldptr) { init(); }
+    mprovider(arb::morphology m, const label_dict* ldptr);
 
     arb::morphology morphology_;
-    concrete_embedding embedding_;
+
+    // Evaluations shared by providers of the morphology with the same labels.
+    std::shared_ptr<label_evaluation> shared_;
 
     struct circular_def {};
 
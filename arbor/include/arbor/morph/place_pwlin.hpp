@@ -4,7 +4,10 @@
 // sample points and interpolating linearly.
 
 #include <cmath>
+#include <cstddef>
+#include <memory>
 #include <utility>
+#include <vector>
 
 #include <arbor/morph/morphology.hpp>
 #include <arbor/morph/primitives.hpp>
@@ -84,8 +87,54 @@ struct place_pwlin {
     // Maximal set of segments or part segments whose union is coterminous with extent.
     std::vector<msegment> all_segments(const mextent& extent) const;
 
+    // The location closest to the point (x, y, z), and its distance from the
+    // point, measured to the axes of the segments. Scans all segments: for
+    // many queries, use a spatial_index.
+    std::pair<mlocation, double> closest(double x, double y, double z) const;
+
 private:
     std::shared_ptr<place_pwlin_data> data_;
+
+    friend struct spatial_index;
+};
+
+// A location on one of the placements in a spatial_index, and its distance
+// from the query point.
+struct spatial_hit {
+    std::size_t cell;   // Index of the placement in the spatial_index.
+    mlocation loc;
+    double distance;
+};
+
+struct spatial_index_data;
+
+// Bounding volume hierarchy over the segments of one or more placements, for
+// nearest-location and within-distance queries that visit only the segments
+// near the query point. Distances are measured to the axes of the segments.
+//
+// To index many cells in world coordinates, place each with the isometry of
+// the cell, and index the placements together.
+
+struct spatial_index {
+    spatial_index();
+    explicit spatial_index(const place_pwlin& p);
+    explicit spatial_index(const std::vector<place_pwlin>& ps);
+
+    // Total number of indexed segments.
+    std::size_t size() const;
+
+    // The closest location to a point; if the index is empty, the location
+    // has branch mnpos and the distance is infinite.
+    spatial_hit closest(double x, double y, double z) const;
+    std::vector<spatial_hit> closest(const std::vector<mpoint>& points) const;
+
+    // For each segment whose axis passes within distance r of the point, the
+    // closest location on that segment, in no particular order.
+    std::vector<spatial_hit> within(double x, double y, double z, double r) const;
+    std::vector<std::vector<spatial_hit>> within(const std::vector<mpoint>& points, double r) const;
+
+private:
+    std::shared_ptr<const spatial_index_data> data_;
 };
 
 } // namespace arb
@@ -25,6 +25,15 @@ class segment_tree {
 public:
     segment_tree() = default;
 
+    // Build a tree from per-segment arrays: segment i has parent parents[i],
+    // proximal and distal points prox[i] and dist[i], and tag tags[i].
+    // Parents must precede their children. Equivalent to appending the
+    // segments in order, without the per-segment bookkeeping.
+    segment_tree(std::vector<msize_t> parents,
+                 const std::vector<mpoint>& prox,
+                 const std::vector<mpoint>& dist,
+                 const std::vector<int>& tags);
+
     // Reserve space for n segments.
     void reserve(msize_t n);
 
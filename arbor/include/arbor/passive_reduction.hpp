@@ -0,0 +1,68 @@
+#pragma once
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <arbor/cable_cell.hpp>
+#include <arbor/morph/locset.hpp>
+#include <arbor/morph/primitives.hpp>
+
+namespace arb {
+
+// Reduction of the passive subtrees of a cable cell to equivalent cylinders.
+//
+// A subtree, a branch with all of its descendants, is passive if it holds no
+// placed items and no locations of `keep`, its only density mechanisms are
+// those of `passive_mechanisms`, and every painting either covers all of it or
+// none of it. Each maximal passive subtree that is not a root branch and has
+// at least `min_branches` branches is replaced by a single cylinder from its
+// fork point, with the membrane area and the mean electrotonic length from
+// the fork point to the tips of the subtree. The cylinder has the tag of the
+// first segment of the subtree, and the paintings of the subtree.
+//
+// The reduction is exact for subtrees that obey Rall's 3/2 power rule at
+// every fork and whose tips are at equal electrotonic distance from the fork
+// point; the deviations from both are reported, and subtrees for which
+// either exceeds `tolerance` are kept.
+//
+// Paintings and placements are given on the reduced morphology by explicit
+// cables and locations, and placements keep their labels and lids. The label
+// dictionary and defaults of the cell are kept as they are, so that regions
+// and locsets of the cv policy and of probes should not name branches.
+
+struct passive_reduction_options {
+    // Density mechanisms that may be painted on a passive subtree.
+    std::vector<std::string> passive_mechanisms = {"pas"};
+
+    // Locations that must be kept, such as the sites of probes.
+    std::vector<locset> keep;
+
+    // The smallest number of branches of a subtree to reduce.
+    unsigned min_branches = 2;
+
+    // Largest relative deviation from the conditions of Rall's reduction.
+    double tolerance = std::numeric_limits<double>::infinity();
+};
+
+struct passive_subtree_reduction {
+    msize_t branch;         // first branch of the subtree, in the original morphology
+    msize_t n_branches;     // number of branches of the subtree
+    double area;            // membrane area of the subtree and the cylinder [µm²]
+    double length;          // length of the cylinder [µm]
+    double diameter;        // diameter of the cylinder [µm]
+    double tip_spread;      // (max-min)/mean electrotonic distance of the tips
+    double rall_mismatch;   // largest relative deviation from the 3/2 power rule
+    bool reduced;           // false if an error exceeds the tolerance
+};
+
+struct reduced_cable_cell {
+    cable_cell cell;
+
+    // One entry for each passive subtree found, reduced or not.
+    std::vector<passive_subtree_reduction> subtrees;
+};
+
+reduced_cable_cell reduce_passive_subtrees(const cable_cell& cell, const passive_reduction_options& opts = {});
+
+} // namespace arb
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <ostream>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -15,6 +16,24 @@ namespace profile {
 // type used for region identifiers
 using region_id_type = std::size_t;
 
+// Accumulated timings of one interface method of one mechanism.
+struct mechanism_timing {
+    // the name of the mechanism.
+    std::string mechanism;
+
+    // the interface method: init, current, events, state, ions or post.
+    std::string method;
+
+    // the number of calls, summed over all cell groups.
+    std::size_t calls;
+
+    // the number of instances updated, summed over all calls.
+    std::size_t instances;
+
+    // the accumulated time spent in the method.
+    double time;
+};
+
 // The results of a profiler run.
 struct profile {
     // the name of each profiled region.
@@ -26,11 +45,26 @@ struct profile {
     // the accumulated time spent in each region.
     std::vector<double> times;
 
+    // the accumulated time spent in each region on each thread, indexed by
+    // region then thread.
+    std::vector<std::vector<double>> thread_times;
+
     // the number of threads for which profiling information was recorded.
     std::size_t num_threads;
 
     // the wall time between profile_start() and profile_stop().
     double wall_time;
+
+    // timings of mechanism methods, if enabled with profiler_time_mechanisms().
+    std::vector<mechanism_timing> mechanisms;
+
+    // the hardware events counted, if enabled with profiler_count_events(),
+    // e.g. "cycles" or "llc-misses".
+    std::vector<std::string> event_names;
+
+    // the number of each event in each region, summed over threads, indexed by
+    // region then event.
+    std::vector<std::vector<std::uint64_t>> events;
 };
 
 void profiler_clear();
@@ -41,6 +75,33 @@ void profiler_leave();
 profile profiler_summary();
 std::size_t profiler_region_id(const char* name);
 
+// Timing of mechanism methods can be switched on and off at run time; it is off
+// by default.
+void profiler_time_mechanisms(bool on);
+bool profiler_mechanism_timing();
+region_id_type profiler_mechanism_region_id(const std::string& mechanism, const char* method);
+void profiler_record_mechanism(region_id_type region_id, double time, std::size_t instances);
+
+// Counting of hardware events (cycles, instructions, L1 data and last level
+// cache misses) in each region can be switched on and off at run time; it is
+// off by default. Events are counted with Linux perf_event; those the system
+// does not allow are left out of the profile.
+void profiler_count_events(bool on);
+
+// Tracing records the start and end time of each region left on each thread,
+// tagged with the epoch and cell group last set on the thread with
+// profiler_trace_tag, in a ring buffer of `capacity` events per thread that
+// keeps the latest events. Starting a trace discards any events recorded.
+// Tracing is off by default, and has no effect unless profiling is enabled.
+void profiler_trace(bool on, std::size_t capacity = 1<<16);
+void profiler_trace_tag(std::int64_t epoch, std::int64_t group);
+
+// Write the trace events of all domains in the Chrome trace event format,
+// which can be viewed with Perfetto, with one process for each domain and
+// times relative to the start of the trace on each domain. This is a
+// collective operation; the trace is written on the root domain only.
+void profiler_write_trace(std::ostream&, const context&);
+
 std::ostream& operator<<(std::ostream&, const profile&);
 
 } // namespace profile
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+#include <arbor/recipe.hpp>
+
+namespace arb {
+
+// Connect each source to each target independently with a fixed probability,
+// with the same weight and delay for all connections.
+//
+// Connections are drawn from a counter-based random number generator keyed by
+// `seed`, indexed by source gid and by block of target gids, so that they are
+// regenerated identically each time a source spikes, on any domain. Within a
+// block, successive targets are found by sampling the gaps between them from
+// a geometric distribution, so that the cost is proportional to the number of
+// connections rather than the number of targets.
+
+class random_projection: public procedural_projection {
+public:
+    random_projection(cell_gid_type source_begin, cell_gid_type source_end, cell_local_label_type source,
+                      cell_gid_type target_begin, cell_gid_type target_end, cell_local_label_type target,
+                      double probability, float weight, float delay, std::uint64_t seed);
+
+    float min_delay() const override { return delay_; }
+
+    void connections_from(cell_gid_type source_gid, cell_gid_type first, cell_gid_type last,
+                          std::vector<procedural_connection>& out) const override;
+
+private:
+    double probability_;
+    float weight_;
+    float delay_;
+    std::uint64_t seed_;
+};
+
+} // namespace arb
@@ -0,0 +1,98 @@
+#pragma once
+
+// Piecewise linear tables of voltage-dependent rate functions, as emitted by
+// modcc with a non-zero --table-tolerance.
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <arbor/mechanism_abi.h>
+
+namespace arb {
+
+struct rate_table {
+    arb_value_type vmin = 0;
+    arb_value_type inv_dv = 0;
+    arb_size_type  n = 0;     // Number of intervals; zero if tabulation failed.
+    arb_size_type  width = 0; // Number of fields per node.
+
+    // Field values at the n+1 nodes vmin + k/inv_dv, row major.
+    std::vector<arb_value_type> data;
+};
+
+// Tabulate `eval(v, fields)`, which writes `width` values to `fields`, over
+// [vmin, vmax]. The node spacing is halved until linear interpolation at every
+// interval midpoint is within `tol*max(|f|, 1e-3*max|f|)` of the exact value
+// for each field, where the maximum is taken over the nodes of that field.
+//
+// If the bound can not be met with at most `max_intervals` intervals, or a
+// field is not finite on the range, the table is left empty.
+
+template <typename Eval>
+rate_table make_rate_table(arb_size_type width, arb_value_type vmin, arb_value_type vmax,
+                           arb_value_type tol, Eval eval, arb_size_type max_intervals = 1<<16)
+{
+    rate_table table;
+    table.width = width;
+    table.vmin = vmin;
+
+    auto finite = [](const std::vector<arb_value_type>& values) {
+        return std::all_of(values.begin(), values.end(), [](auto x) { return std::isfinite(x); });
+    };
+
+    arb_size_type n = 64;
+    std::vector<arb_value_type> nodes((n+1)*width);
+    for (arb_size_type k = 0; k<=n; ++k) {
+        eval(vmin + k*(vmax-vmin)/n, nodes.data() + k*width);
+    }
+    if (!finite(nodes)) return table;
+
+    for (;;) {
+        // Midpoints of the n intervals.
+        std::vector<arb_value_type> mids(n*width);
+        arb_value_type dv = (vmax-vmin)/n;
+        for (arb_size_type k = 0; k<n; ++k) {
+            eval(vmin + (k+0.5)*dv, mids.data() + k*width);
+        }
+        if (!finite(mids)) return table;
+
+        std::vector<arb_value_type> scale(width, 0);
+        for (arb_size_type k = 0; k<=n; ++k) {
+            for (arb_size_type j = 0; j<width; ++j) {
+                scale[j] = std::max(scale[j], std::abs(nodes[k*width+j]));
+            }
+        }
+
+        bool ok = true;
+        for (arb_size_type k = 0; ok && k<n; ++k) {
+            for (arb_size_type j = 0; j<width; ++j) {
+                auto exact = mids[k*width+j];
+                auto approx = 0.5*(nodes[k*width+j] + nodes[(k+1)*width+j]);
+                if (std::abs(approx-exact) > tol*std::max(std::abs(exact), 1e-3*scale[j])) {
+                    ok = false;
+                    break;
+                }
+            }
+        }
+
+        if (ok) {
+            table.n = n;
+            table.inv_dv = n/(vmax-vmin);
+            table.data = std::move(nodes);
+            return table;
+        }
+        if (2*n>max_intervals) return table;
+
+        // Refine: the midpoints become the new odd nodes.
+        std::vector<arb_value_type> refined((2*n+1)*width);
+        for (arb_size_type k = 0; k<=n; ++k) {
+            std::copy_n(nodes.data() + k*width, width, refined.data() + 2*k*width);
+            if (k<n) std::copy_n(mids.data() + k*width, width, refined.data() + (2*k+1)*width);
+        }
+        nodes = std::move(refined);
+        n *= 2;
+    }
+}
+
+} // namespace arb
@@ -1,11 +1,14 @@
 #pragma once
 
 #include <any>
+#include <memory>
+#include <optional>
 #include <utility>
 #include <vector>
 
 #include <arbor/common_types.hpp>
 #include <arbor/event_generator.hpp>
+#include <arbor/stochastic_input.hpp>
 #include <arbor/util/unique_any.hpp>
 
 namespace arb {
@@ -37,6 +40,29 @@ struct probe_info {
 // of internal gids, but we are not making the distinction between the
 // two in the current code. These two types could well be merged.
 
+// Pair-based spike timing dependent plasticity of the weight of a
+// connection, with exponential traces and all-to-all pairing. Each spike of
+// the target cell at time t increases the weight by
+// a_plus·exp(-(t-t_pre)/tau_plus) for every earlier spike of the source at
+// t_pre; each spike of the source at t decreases it by
+// a_minus·exp(-(t-t_post)/tau_minus) for every earlier spike of the target at
+// t_post. Spike times are those of the threshold crossings, not including
+// the delay of the connection. The weight is clamped to [w_min, w_max].
+
+struct stdp_rule {
+    float a_plus = 0.01f;
+    float a_minus = 0.01f;
+    float tau_plus = 20.f;   // [ms]
+    float tau_minus = 20.f;  // [ms]
+    float w_min = 0.f;
+    float w_max = 1.f;
+
+    bool operator==(const stdp_rule& other) const {
+        return a_plus==other.a_plus && a_minus==other.a_minus && tau_plus==other.tau_plus
+            && tau_minus==other.tau_minus && w_min==other.w_min && w_max==other.w_max;
+    }
+};
+
 struct cell_connection {
     // Connection end-points are represented by pairs
     // (cell index, source/target index on cell).
@@ -47,8 +73,15 @@ struct cell_connection {
     float weight;
     float delay;
 
+    // If set, the weight is plastic: it changes with the spikes of the source
+    // and target cells, and is the initial weight.
+    std::optional<stdp_rule> plasticity;
+
     cell_connection(cell_global_label_type src, cell_local_label_type dst, float w, float d):
         source(std::move(src)), dest(std::move(dst)), weight(w), delay(d) {}
+
+    cell_connection(cell_global_label_type src, cell_local_label_type dst, float w, float d, stdp_rule rule):
+        source(std::move(src)), dest(std::move(dst)), weight(w), delay(d), plasticity(rule) {}
 };
 
 struct gap_junction_connection {
@@ -61,6 +94,68 @@ struct gap_junction_connection {
         peer(std::move(peer)), local(std::move(local)), ggap(g) {}
 };
 
+// A connection from a cell of an external simulation, which exchanges spikes
+// with the simulation through an external_spike_port: the source is the
+// (gid, index) of the spike source in the external simulation.
+struct external_connection {
+    cell_member_type source;
+    cell_local_label_type dest;
+
+    float weight;
+    float delay;
+
+    external_connection(cell_member_type src, cell_local_label_type dst, float w, float d):
+        source(src), dest(std::move(dst)), weight(w), delay(d) {}
+};
+
+// Connectivity that is generated from a rule when spikes are delivered,
+// rather than enumerated by recipe::connections_on() and stored.
+//
+// A projection connects the sources labelled `source` on the cells with gids
+// in [source_begin, source_end) to the targets labelled `target` on the cells
+// with gids in [target_begin, target_end). Labels are resolved once per cell.
+
+struct procedural_connection {
+    cell_gid_type target;
+    float weight;
+    float delay;
+};
+
+class procedural_projection {
+public:
+    cell_gid_type source_begin, source_end;
+    cell_local_label_type source;
+    cell_gid_type target_begin, target_end;
+    cell_local_label_type target;
+
+    procedural_projection(cell_gid_type source_begin, cell_gid_type source_end, cell_local_label_type source,
+                          cell_gid_type target_begin, cell_gid_type target_end, cell_local_label_type target):
+        source_begin(source_begin), source_end(source_end), source(std::move(source)),
+        target_begin(target_begin), target_end(target_end), target(std::move(target))
+    {}
+
+    // A lower bound on the delays of all connections.
+    virtual float min_delay() const = 0;
+
+    // Append to `out` the connections from the cell `source_gid` onto the
+    // cells with gids in [first, last), a subrange of the targets. This is
+    // called for different subranges on each domain, and again every time
+    // the source spikes, so the connections onto a given target must depend
+    // only on the source and target gids.
+    virtual void connections_from(cell_gid_type source_gid, cell_gid_type first, cell_gid_type last,
+                                  std::vector<procedural_connection>& out) const = 0;
+
+    virtual ~procedural_projection() = default;
+};
+
+// Receives the connections of a range of cells from
+// recipe::connections_on_range().
+class connection_sink {
+public:
+    virtual void add(cell_gid_type target, cell_connection c) = 0;
+    virtual ~connection_sink() = default;
+};
+
 class recipe {
 public:
     virtual cell_size_type num_cells() const = 0;
@@ -72,6 +167,10 @@ public:
     virtual std::vector<event_generator> event_generators(cell_gid_type) const {
         return {};
     }
+    // Background input sampled by the back end of cable cells, see stochastic_input.
+    virtual std::vector<stochastic_input> stochastic_inputs(cell_gid_type) const {
+        return {};
+    }
     virtual std::vector<cell_connection> connections_on(cell_gid_type) const {
         return {};
     }
@@ -79,6 +178,31 @@ public:
         return {};
     }
 
+    // Bulk queries over the cells [begin, end), which arbor makes in place of
+    // the per-gid queries above when building a simulation. Recipes that can
+    // answer them without a vector per cell may override them; by default
+    // they make the per-gid queries. The kinds are written to out[0, end-begin),
+    // and the connections of each cell passed to the sink with the gid of the
+    // cell, in order of gid.
+    virtual void cell_kinds(cell_gid_type begin, cell_gid_type end, cell_kind* out) const {
+        for (auto gid = begin; gid<end; ++gid) *out++ = get_cell_kind(gid);
+    }
+    virtual void connections_on_range(cell_gid_type begin, cell_gid_type end, connection_sink& out) const {
+        for (auto gid = begin; gid<end; ++gid) {
+            for (auto& c: connections_on(gid)) out.add(gid, std::move(c));
+        }
+    }
+
+    // Connections from the cells of an external simulation, see external_spike_port.
+    virtual std::vector<external_connection> external_connections_on(cell_gid_type) const {
+        return {};
+    }
+
+    // Projections, in addition to the connections of each cell.
+    virtual std::vector<std::shared_ptr<const procedural_projection>> projections() const {
+        return {};
+    }
+
     virtual std::vector<probe_info> get_probes(cell_gid_type gid) const {
         return {};
     }
@@ -86,6 +210,13 @@ public:
     // Global property type will be specific to given cell kind.
     virtual std::any get_global_properties(cell_kind) const { return std::any{}; };
 
+    // Estimated relative cost of simulating a cell, e.g. proportional to its
+    // number of CVs and mechanisms, used by partition_load_balance to balance
+    // cost rather than cell counts across domains and cell groups. Either all
+    // cells or none have a cost: if the cost of gid 0 is not given, all cells
+    // are taken to be of equal cost.
+    virtual std::optional<double> cell_cost(cell_gid_type) const { return std::nullopt; }
+
     virtual ~recipe() {}
 };
 
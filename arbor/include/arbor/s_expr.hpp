@@ -206,7 +206,15 @@ struct s_expr {
     using pair_type = s_pair<value_wrapper<s_expr>>;
     std::variant<token, pair_type> state = token{{0,0}, tok::nil, "()"};
 
-    s_expr(const s_expr& s): state(s.state) {}
+    // Copies, moves and destruction walk the tail of a list iteratively, so
+    // that their depth of recursion is bounded by the nesting of the
+    // expression, not by the length of its lists. A moved-from s_expr is nil.
+    s_expr(const s_expr& other);
+    s_expr(s_expr&& other) noexcept;
+    s_expr& operator=(const s_expr& other);
+    s_expr& operator=(s_expr&& other) noexcept;
+    ~s_expr();
+
     s_expr() = default;
     s_expr(token t): state(std::move(t)) {}
     s_expr(s_expr l, s_expr r):
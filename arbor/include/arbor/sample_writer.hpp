@@ -0,0 +1,89 @@
+#pragma once
+
+/*
+ * Streaming recorder of sample data to a binary file.
+ *
+ * Samples are staged in memory and written by a dedicated I/O thread, so
+ * that the memory required for recording does not grow with the length
+ * of the simulation, and sampler callbacks do not wait on the file system
+ * unless the I/O thread falls behind.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+#include <arbor/sampling.hpp>
+
+namespace arb {
+
+// The file starts with the eight bytes of `sample_file_magic`, followed by
+// a sequence of blocks, each holding the samples of one probe from one
+// sampler call. A block is a `sample_block_header`, then the `n_sample`
+// sample times, then the `n_sample` rows of `width` sample values. Times
+// and values are stored as doubles, and all data in the byte order of the
+// platform that wrote the file.
+
+constexpr char sample_file_magic[8] = {'a', 'r', 'b', 's', 'm', 'p', 0, 1};
+
+struct sample_block_header {
+    std::uint64_t n_sample;
+    std::uint64_t width;
+    std::uint32_t gid;
+    std::uint32_t lid;
+    std::uint32_t index;
+    std::int32_t tag;
+};
+
+class sample_writer {
+public:
+    // Write samples to the file at `path`, which is created or truncated.
+    // Up to `buffer_size` bytes of samples are staged in memory before
+    // being passed to the I/O thread; as staging is double buffered, up to
+    // twice that may be held at once.
+    explicit sample_writer(const std::string& path, std::size_t buffer_size = std::size_t(1)<<24);
+
+    // Write any staged samples and close the file.
+    ~sample_writer();
+
+    sample_writer(const sample_writer&) = delete;
+    sample_writer& operator=(const sample_writer&) = delete;
+
+    // Stage the samples of one sampler call. Record samples must be either
+    // `const double*` or `const cable_sample_range*` of a fixed width.
+    // Errors raised by the I/O thread are rethrown here.
+    void write(probe_metadata pm, const sample_matrix& m);
+    void write(probe_metadata pm, std::size_t n, const sample_record* records);
+
+    // Sampler functions that stage their samples in this writer, which
+    // must outlive their use in the simulation.
+    matrix_sampler_function matrix_sampler();
+    sampler_function sampler();
+
+    // Wait until all staged samples have been written to the file.
+    void flush();
+
+private:
+    struct impl;
+    std::unique_ptr<impl> impl_;
+};
+
+// The samples of one block of a sample file.
+
+struct sample_block {
+    cell_member_type id;
+    probe_tag tag = 0;
+    unsigned index = 0;
+    std::size_t width = 0;
+    std::vector<time_type> times;
+    std::vector<double> values; // row-major, `width` values per sample time
+};
+
+// Read all the blocks of a sample file.
+std::vector<sample_block> read_samples(std::istream& in);
+
+} // namespace arb
@@ -40,11 +40,66 @@ using sampler_function = std::function<
           const sample_record*  // pointer to first sample record
          )>;
 
+// The samples of one probe over one cell group update, in columnar form: the
+// sample times, and for each a row of `width` values. Times and rows are
+// strided, so that the matrix can be a view onto the sample buffer of the
+// cell group without copying. The data are valid only for the duration of
+// the sampler call.
+
+struct sample_matrix {
+    std::size_t n_sample = 0;
+    std::size_t width = 0;
+    const time_type* times = nullptr;
+    std::size_t time_stride = 1;
+    const double* values = nullptr;
+    std::size_t row_stride = 0;
+
+    time_type time(std::size_t i) const { return times[i*time_stride]; }
+    const double* row(std::size_t i) const { return values+i*row_stride; }
+    double operator()(std::size_t i, std::size_t j) const { return row(i)[j]; }
+};
+
+using matrix_sampler_function = std::function<void (probe_metadata, const sample_matrix&)>;
+
+// Sums of the samples of a reduced sampler across all matching probes and
+// domains at one sample time; `values` points to one sum per sample value.
+
+struct reduced_sample_record {
+    time_type time;
+    const double* values;
+};
+
+using reduced_sampler_function = std::function<
+    void (std::size_t,                  // number of sums per record
+          std::size_t,                  // number of sample records
+          const reduced_sample_record*  // pointer to first sample record
+         )>;
+
 using sampler_association_handle = std::size_t;
 
+// A triggered sampler receives, for each trigger at time t, the values of a
+// probe at the start of every integration step in [t-pre, t+post], in one
+// call once the window has passed. The values are held at every step in
+// ring buffers in the back end, and only those in windows are copied out.
+
+struct sampling_window {
+    time_type pre = 0;   // [ms] before the trigger
+    time_type post = 0;  // [ms] after the trigger
+};
+
+// Under the decimating policies mean, min, max and last, a sample
+// summarizes the values of the probe at each integration step since the
+// previous sample of the sampler, in place of the value at the sample time.
+// The summaries are computed by the cell group as it integrates, and only
+// they are copied out of the back end.
+
 enum class sampling_policy {
     lax,
-    exact
+    exact,
+    mean,  // time-weighted mean
+    min,
+    max,
+    last   // value at the last step
 };
 
 } // namespace arb
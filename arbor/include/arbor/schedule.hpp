@@ -26,6 +26,17 @@ inline time_event_span as_time_event_span(const std::vector<time_type>& v) {
 // are queried monotonically in time: if two method calls `events(t0, t1)`
 // and `events(t2, t3)` are made without an intervening call to `reset()`,
 // then 0 ≤ _t0_ ≤ _t1_ ≤ _t2_ ≤ _t3_.
+//
+// Besides `events`, which returns a view of the times in [t0, t1), a schedule
+// provides `append_events(t0, t1, out)`, which appends them to a buffer of
+// the caller, so that the times of many schedules may be collected in one
+// buffer. For the built-in regular, explicit and Poisson schedules (the latter
+// with a std::mt19937_64 generator), this calls the implementation directly
+// instead of through the type-erased interface.
+
+class regular_schedule_impl;
+class explicit_schedule_impl;
+template <typename RandomNumberEngine> class poisson_schedule_impl;
 
 class schedule {
 public:
@@ -54,10 +65,25 @@ public:
         return impl_->events(t0, t1);
     }
 
+    inline void append_events(time_type t0, time_type t1, std::vector<time_type>& out);
+
     void reset() { impl_->reset(); }
 
 private:
+    // Implementations that are called directly by append_events.
+    enum class builtin_kind { none, regular, explicit_times, poisson };
+
+    template <typename Impl>
+    static constexpr builtin_kind builtin_kind_of() {
+        if constexpr (std::is_same_v<Impl, regular_schedule_impl>) return builtin_kind::regular;
+        else if constexpr (std::is_same_v<Impl, explicit_schedule_impl>) return builtin_kind::explicit_times;
+        else if constexpr (std::is_same_v<Impl, poisson_schedule_impl<std::mt19937_64>>) return builtin_kind::poisson;
+        else return builtin_kind::none;
+    }
+
     struct interface {
+        builtin_kind kind = builtin_kind::none;
+
         virtual time_event_span events(time_type t0, time_type t1) = 0;
         virtual void reset() = 0;
         virtual std::unique_ptr<interface> clone() = 0;
@@ -68,8 +94,8 @@ private:
 
     template <typename Impl>
     struct wrap: interface {
-        explicit wrap(const Impl& impl): wrapped(impl) {}
-        explicit wrap(Impl&& impl): wrapped(std::move(impl)) {}
+        explicit wrap(const Impl& impl): wrapped(impl) { kind = builtin_kind_of<Impl>(); }
+        explicit wrap(Impl&& impl): wrapped(std::move(impl)) { kind = builtin_kind_of<Impl>(); }
 
         virtual time_event_span events(time_type t0, time_type t1) {
             return wrapped.events(t0, t1);
@@ -113,6 +139,7 @@ public:
 
     void reset() {}
     time_event_span events(time_type t0, time_type t1);
+    void append_events(time_type t0, time_type t1, std::vector<time_type>& out) const;
 
 private:
     time_type t0_, t1_, dt_;
@@ -157,6 +184,11 @@ public:
 
     time_event_span events(time_type t0, time_type t1);
 
+    void append_events(time_type t0, time_type t1, std::vector<time_type>& out) {
+        auto ts = events(t0, t1);
+        out.insert(out.end(), ts.first, ts.second);
+    }
+
 private:
     std::ptrdiff_t start_index_;
     std::vector<time_type> times_;
@@ -191,17 +223,19 @@ public:
 
     time_event_span events(time_type t0, time_type t1) {
         times_.clear();
+        append_events(t0, t1, times_);
+        return as_time_event_span(times_);
+    }
 
+    void append_events(time_type t0, time_type t1, std::vector<time_type>& out) {
         while (next_<t0) {
             step();
         }
 
         while (next_<t1) {
-            times_.push_back(next_);
+            out.push_back(next_);
             step();
         }
-
-        return as_time_event_span(times_);
     }
 
 private:
@@ -227,4 +261,22 @@ inline schedule poisson_schedule(time_type tstart, time_type rate_kHz, const Ran
     return schedule(poisson_schedule_impl<RandomNumberEngine>(tstart, rate_kHz, rng));
 }
 
+inline void schedule::append_events(time_type t0, time_type t1, std::vector<time_type>& out) {
+    switch (impl_->kind) {
+    case builtin_kind::regular:
+        static_cast<wrap<regular_schedule_impl>*>(impl_.get())->wrapped.append_events(t0, t1, out);
+        break;
+    case builtin_kind::explicit_times:
+        static_cast<wrap<explicit_schedule_impl>*>(impl_.get())->wrapped.append_events(t0, t1, out);
+        break;
+    case builtin_kind::poisson:
+        static_cast<wrap<poisson_schedule_impl<std::mt19937_64>>*>(impl_.get())->wrapped.append_events(t0, t1, out);
+        break;
+    default: {
+        auto ts = impl_->events(t0, t1);
+        out.insert(out.end(), ts.first, ts.second);
+    }
+    }
+}
+
 } // namespace arb
@@ -52,6 +52,19 @@ constexpr double exp_maxarg = 709.782712893384;
 
 constexpr double expm1_minarg = -37.42994775023705;
 
+// Reduced precision exponential and logarithm (fast_exp,
+// fast_expm1, fast_log):
+//
+// e^g for |g| ≤ ln(2)/2 by its Taylor polynomial of degree 7,
+// with relative error below 6e-9; e^x-1 for |x| ≤ 0.5 by its
+// Taylor polynomial of degree 8, with relative error below
+// 1.1e-8; ln(u) for u in [sqrt(2)/2, sqrt(2)] by the series
+// 2·atanh((u-1)/(u+1)) to degree 9, with relative error below
+// 2e-9. The argument reduction is as for the full precision
+// functions, with a single-part ln(2).
+
+constexpr double ln2 = 0.69314718055994530942;
+
 // Logarithm:
 //
 // Positive denormal numbers are treated as zero
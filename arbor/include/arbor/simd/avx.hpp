@@ -893,6 +893,58 @@ struct avx2_double4: avx_double4 {
                 r)));
     }
 
+    // Reduced precision exponential and logarithm: see approx.hpp.
+
+    static __m256d fast_exp(const __m256d& x) {
+        auto is_large = cmp_gt(x, broadcast(exp_maxarg));
+        auto is_small = cmp_lt(x, broadcast(exp_minarg));
+        auto is_nan = _mm256_cmp_pd(x, x, cmp_unord_q);
+
+        auto n = _mm256_floor_pd(fma(broadcast(ln2inv), x, broadcast(0.5)));
+        auto g = fma(n, broadcast(-ln2), x);
+        auto expg = horner(g, 1., 1., 1./2, 1./6, 1./24, 1./120, 1./720, 1./5040);
+
+        auto result = ldexp_positive(expg, _mm256_cvtpd_epi32(n));
+
+        return
+            ifelse(is_large, broadcast(HUGE_VAL),
+            ifelse(is_small, broadcast(0),
+            ifelse(is_nan, broadcast(NAN),
+                   result)));
+    }
+
+    static __m256d fast_expm1(const __m256d& x) {
+        auto one = broadcast(1.);
+        auto nzero = cmp_leq(abs(x), broadcast(0.5));
+        auto expm1x = mul(x, horner(x, 1., 1./2, 1./6, 1./24, 1./120, 1./720, 1./5040, 1./40320));
+
+        return ifelse(nzero, expm1x, sub(fast_exp(x), one));
+    }
+
+    static __m256d fast_log(const __m256d& x) {
+        auto is_large = cmp_geq(x, broadcast(HUGE_VAL));
+        auto is_small = cmp_lt(x, broadcast(log_minarg));
+        auto is_domainerr = _mm256_cmp_pd(x, broadcast(0), cmp_nge_uq);
+
+        __m256d g = _mm256_cvtepi32_pd(logb_normal(x));
+        __m256d u = fraction_normal(x);
+
+        __m256d one = broadcast(1.);
+        auto gtsqrt2 = cmp_geq(u, broadcast(sqrt2));
+        g = ifelse(gtsqrt2, add(g, one), g);
+        u = ifelse(gtsqrt2, mul(u, broadcast(0.5)), u);
+
+        auto s = div(sub(u, one), add(u, one));
+        auto r = mul(add(s, s), horner(mul(s, s), 1., 1./3, 1./5, 1./7, 1./9));
+        r = fma(g, broadcast(ln2), r);
+
+        return
+            ifelse(is_domainerr, broadcast(NAN),
+            ifelse(is_large, broadcast(HUGE_VAL),
+            ifelse(is_small, broadcast(-HUGE_VAL),
+                r)));
+    }
+
 protected:
     static __m128i lo_epi32(__m256i a) {
         a = _mm256_shuffle_epi32(a, 0x08);
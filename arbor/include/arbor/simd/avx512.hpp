@@ -404,6 +404,7 @@ struct avx512_double8: implbase<avx512_double8> {
 
     using implbase<avx512_double8>::gather;
     using implbase<avx512_double8>::scatter;
+    using implbase<avx512_double8>::scatter_add;
     using implbase<avx512_double8>::cast_from;
 
     // CMPPD predicates:
@@ -577,6 +578,45 @@ struct avx512_double8: implbase<avx512_double8> {
         _mm512_mask_i32scatter_pd(p, mask, _mm512_castsi512_si256(index), s, 8);
     }
 
+#ifdef __AVX512CD__
+    // Lanes with the same index are summed in a segmented scan over runs of
+    // consecutive lanes, after which the last lane of each run holds the sum
+    // of the run, and only those lanes are updated. If the same index is in
+    // more than one run, the conflict is detected and the update falls back
+    // to the sequential implementation.
+    static void scatter_add(tag<avx512_int8>, const __m512d& s, double* p, const __m512i& index) {
+        const __m256i idx = _mm512_castsi512_si256(index);
+
+        // Lanes that continue the run of the preceding lane, and the last
+        // lanes of runs.
+        const __m512i prev = _mm512_permutexvar_epi32(_mm512_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6, 0, 0, 0, 0, 0, 0, 0, 0), index);
+        const unsigned c = _mm512_mask_cmpeq_epi32_mask(0xfe, index, prev);
+        const __mmask8 last = ~(c>>1);
+
+        const __m512i conflict = _mm512_maskz_conflict_epi32(last, index);
+        if (_mm512_mask_test_epi32_mask(last, conflict, _mm512_set1_epi32(last))) {
+            implbase<avx512_double8>::scatter_add(tag<avx512_int8>{}, s, p, index);
+            return;
+        }
+
+        if (c==0) {
+            _mm512_i32scatter_pd(p, idx, _mm512_add_pd(_mm512_i32gather_pd(idx, p, 8), s), 8);
+            return;
+        }
+
+        // Lane i adds lane i-k if lanes i-k+1 to i all continue the run.
+        const unsigned c2 = c&(c<<1);
+        const unsigned c4 = c2&(c2<<2);
+        __m512d v = s;
+        v = _mm512_mask_add_pd(v, c, v, _mm512_permutexvar_pd(_mm512_set_epi64(6, 5, 4, 3, 2, 1, 0, 0), v));
+        v = _mm512_mask_add_pd(v, c2, v, _mm512_permutexvar_pd(_mm512_set_epi64(5, 4, 3, 2, 1, 0, 0, 0), v));
+        v = _mm512_mask_add_pd(v, c4, v, _mm512_permutexvar_pd(_mm512_set_epi64(3, 2, 1, 0, 0, 0, 0, 0), v));
+
+        v = _mm512_add_pd(_mm512_mask_i32gather_pd(_mm512_setzero_pd(), last, idx, p, 8), v);
+        _mm512_mask_i32scatter_pd(p, last, idx, v, 8);
+    }
+#endif
+
     // Use SVML for exp and log if compiling with icpc, else use ratpoly
     // approximations.
 
@@ -718,6 +758,52 @@ auto odd = mul(g, horner(gg, P0exp, P1exp, P2exp));
     }
 #endif
 
+    // Reduced precision exponential and logarithm: see approx.hpp.
+
+    static __m512d fast_exp(const __m512d& x) {
+        auto is_large = cmp_gt(x, broadcast(exp_maxarg));
+        auto is_small = cmp_lt(x, broadcast(exp_minarg));
+
+        auto n = _mm512_floor_pd(fma(broadcast(ln2inv), x, broadcast(0.5)));
+        auto g = fma(n, broadcast(-ln2), x);
+        auto expg = horner(g, 1., 1., 1./2, 1./6, 1./24, 1./120, 1./720, 1./5040);
+
+        return
+            ifelse(is_large, broadcast(HUGE_VAL),
+            ifelse(is_small, broadcast(0),
+                   _mm512_scalef_pd(expg, n)));
+    }
+
+    static __m512d fast_expm1(const __m512d& x) {
+        auto nzero = cmp_leq(abs(x), broadcast(0.5));
+        auto expm1x = mul(x, horner(x, 1., 1./2, 1./6, 1./24, 1./120, 1./720, 1./5040, 1./40320));
+
+        return ifelse(nzero, expm1x, sub(fast_exp(x), broadcast(1.)));
+    }
+
+    static __m512d fast_log(const __m512d& x) {
+        auto is_large = cmp_geq(x, broadcast(HUGE_VAL));
+        auto is_small = cmp_lt(x, broadcast(log_minarg));
+        is_small = avx512_mask8::logical_and(is_small, cmp_geq(x, broadcast(0)));
+
+        __m512d g = _mm512_getexp_pd(x);
+        __m512d u = _mm512_getmant_pd(x, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_nan);
+
+        __m512d one = broadcast(1.);
+        auto gtsqrt2 = cmp_geq(u, broadcast(sqrt2));
+        g = ifelse(gtsqrt2, add(g, one), g);
+        u = ifelse(gtsqrt2, mul(u, broadcast(0.5)), u);
+
+        auto s = div(sub(u, one), add(u, one));
+        auto r = mul(add(s, s), horner(mul(s, s), 1., 1./3, 1./5, 1./7, 1./9));
+        r = fma(g, broadcast(ln2), r);
+
+        return
+            ifelse(is_large, broadcast(HUGE_VAL),
+            ifelse(is_small, broadcast(-HUGE_VAL),
+                r));
+    }
+
 protected:
     static inline __m512d horner1(__m512d x, double a0) {
         return add(x, broadcast(a0));
@@ -24,8 +24,16 @@
 // pow      | lane-wise std::pow
 // expm1    | lane-wise std::expm1
 // exprelr  | expm1, div, add, cmp_eq, ifelse
+// fast_exp | exp
+// fast_expm1 | expm1
+// fast_log | log
+// fast_exprelr | fast_expm1, div, add, cmp_eq, ifelse
 //
 // 'exprelr' is the function x ↦ x/(exp(x)-1).
+//
+// The fast_ variants trade accuracy for speed, with relative errors
+// of order 1e-8; implementations without a specialized version give
+// the full precision result.
 
 #include <cstring>
 #include <cmath>
@@ -437,6 +445,29 @@ struct implbase {
         }
     }
 
+    // Add the elements of `s` to `p[index[i]]`, where indices may repeat.
+    // Elements with the same index in consecutive lanes, as from sorted
+    // indices, are summed before each update.
+    template <typename ImplIndex>
+    static void scatter_add(tag<ImplIndex>, const vector_type& s, scalar_type* p, const typename ImplIndex::vector_type& index) {
+        typename ImplIndex::scalar_type o[width];
+        ImplIndex::copy_to(index, o);
+
+        store a;
+        I::copy_to(s, a);
+
+        scalar_type temp = 0;
+        for (unsigned i = 0; i<width-1; ++i) {
+            temp += a[i];
+            if (o[i] != o[i+1]) {
+                p[o[i]] += temp;
+                temp = 0;
+            }
+        }
+        temp += a[width-1];
+        p[o[width-1]] += temp;
+    }
+
     static scalar_type reduce_add(const vector_type& s) {
         store a;
         I::copy_to(s, a);
@@ -522,6 +553,23 @@ struct implbase {
         return I::ifelse(I::cmp_eq(ones, I::add(ones, s)), ones, I::div(s, I::expm1(s)));
     }
 
+    static vector_type fast_exp(const vector_type& s) {
+        return I::exp(s);
+    }
+
+    static vector_type fast_expm1(const vector_type& s) {
+        return I::expm1(s);
+    }
+
+    static vector_type fast_log(const vector_type& s) {
+        return I::log(s);
+    }
+
+    static vector_type fast_exprelr(const vector_type& s) {
+        vector_type ones = I::broadcast(1);
+        return I::ifelse(I::cmp_eq(ones, I::add(ones, s)), ones, I::div(s, I::fast_expm1(s)));
+    }
+
     static vector_type pow(const vector_type& s, const vector_type &t) {
         store a, b, r;
         I::copy_to(s, a);
@@ -83,6 +83,7 @@ typename detail::simd_impl<Impl>::simd_mask name(const typename detail::simd_imp
 ARB_PP_FOREACH(ARB_BINARY_ARITHMETIC_, add, sub, mul, div, pow, max, min)
 ARB_PP_FOREACH(ARB_BINARY_COMPARISON_, cmp_eq, cmp_neq, cmp_leq, cmp_lt, cmp_geq, cmp_gt)
 ARB_PP_FOREACH(ARB_UNARY_ARITHMETIC_,  neg, abs, sin, cos, exp, log, expm1, exprelr)
+ARB_PP_FOREACH(ARB_UNARY_ARITHMETIC_,  fast_exp, fast_log, fast_expm1, fast_exprelr)
 
 #undef ARB_BINARY_ARITHMETIC_
 #undef ARB_BINARY_COMPARISON__
@@ -243,24 +244,7 @@ namespace detail {
     {
         switch (constraint) {
             case index_constraint::none:
-            {
-                typename ImplIndex::scalar_type o[width];
-                ImplIndex::copy_to(index.value_, o);
-
-                V a[width];
-                Impl::copy_to(s.value_, a);
-
-                V temp = 0;
-                for (unsigned i = 0; i<width-1; ++i) {
-                    temp += a[i];
-                    if (o[i] != o[i+1]) {
-                        p[o[i]] += temp;
-                        temp = 0;
-                    }
-                }
-                temp += a[width-1];
-                p[o[width-1]] += temp;
-            }
+                Impl::scatter_add(tag<ImplIndex>{}, s.value_, p, index.value_);
                 break;
             case index_constraint::independent:
             {
@@ -681,6 +665,7 @@ namespace detail {
         ARB_PP_FOREACH(ARB_DECLARE_BINARY_ARITHMETIC_, add, sub, mul, div, pow, max, min, cmp_eq)
         ARB_PP_FOREACH(ARB_DECLARE_BINARY_COMPARISON_, cmp_eq, cmp_neq, cmp_lt, cmp_leq, cmp_gt, cmp_geq)
         ARB_PP_FOREACH(ARB_DECLARE_UNARY_ARITHMETIC_,  neg, abs, sin, cos, exp, log, expm1, exprelr)
+        ARB_PP_FOREACH(ARB_DECLARE_UNARY_ARITHMETIC_,  fast_exp, fast_log, fast_expm1, fast_exprelr)
 
         #undef ARB_DECLARE_UNARY_ARITHMETIC_
         #undef ARB_DECLARE_BINARY_ARITHMETIC_
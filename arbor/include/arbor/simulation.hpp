@@ -1,13 +1,19 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
+#include <future>
+#include <iosfwd>
 #include <memory>
+#include <optional>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
 #include <arbor/common_types.hpp>
 #include <arbor/context.hpp>
 #include <arbor/domain_decomposition.hpp>
+#include <arbor/memory_footprint.hpp>
 #include <arbor/recipe.hpp>
 #include <arbor/sampling.hpp>
 #include <arbor/schedule.hpp>
@@ -18,6 +24,146 @@ namespace arb {
 
 using spike_export_function = std::function<void(const std::vector<spike>&)>;
 
+// A channel to an external simulation, e.g. over an MPI intercommunicator or
+// shared memory, through which the simulation and the external simulation
+// exchange the spikes of each epoch. The spikes of the external simulation
+// are delivered along the recipe's external_connections_on().
+//
+// Each domain calls exchange_begin() once an epoch [t0, t1) has been
+// integrated, with the spikes of its cells in the epoch, and later
+// exchange_end(), which returns the spikes of the external simulation in the
+// same epoch. As for the exchange between domains, the exchange may proceed
+// while the next epoch is integrated: exchange_begin() should not wait for
+// the external simulation, and the local spikes stay valid until
+// exchange_end() returns. Exchanges are not concurrent, and are in the order
+// of the epochs.
+class external_spike_port {
+public:
+    virtual void exchange_begin(time_type t0, time_type t1, const std::vector<spike>& local_spikes) = 0;
+    virtual std::vector<spike> exchange_end() = 0;
+
+    virtual ~external_spike_port() = default;
+};
+
+// Called at the end of each epoch, once the spikes generated up to time `t`
+// have been presented to the spike callbacks, with the earliest time
+// `t_inject` of events that may be injected from within the call.
+using epoch_function = std::function<void(time_type t, time_type t_inject)>;
+
+// Performance of the local domain over a window of epochs [t0, t1), see
+// simulation::set_epoch_metrics_callback. Times are wall clock seconds;
+// those of tasks are summed over the threads that ran them.
+struct epoch_metrics {
+    time_type t0 = 0;             // [ms]
+    time_type t1 = 0;             // [ms]
+    unsigned epochs = 0;
+    cell_size_type num_cells = 0; // local cells
+
+    double wall_time = 0;         // of the window
+    double max_epoch_time = 0;    // longest epoch of the window
+    double advance_time = 0;      // advancing the cell groups
+    double enqueue_time = 0;      // sorting and merging events into event lanes
+    double exchange_time = 0;     // completing the spike exchange, generating events
+    double idle_time = 0;         // thread time spent on none of the above
+
+    std::uint64_t events = 0;     // delivered to local cells
+    std::uint64_t spikes = 0;     // generated by local cells
+    memory_use memory;            // footprint at the end of the window
+
+    // Time spent in each profiler region over the window, summed over
+    // threads, if Arbor is built with profiling.
+    std::vector<std::string> regions;
+    std::vector<double> region_times;
+
+    // Simulated time per wall clock time.
+    double speed() const { return wall_time>0? 1e-3*(t1-t0)/wall_time: 0; }
+
+    // Mean spike rate of the local cells [Hz].
+    double spike_rate() const { return num_cells && t1>t0? 1e3*spikes/(num_cells*(t1-t0)): 0; }
+};
+
+using epoch_metrics_function = std::function<void(const epoch_metrics&)>;
+
+// The population of a cell, if it belongs to one: see
+// simulation::add_population_monitor.
+using population_function = std::function<std::optional<unsigned>(cell_gid_type)>;
+
+// Spike counts of each population over the time interval [t0, t1); `counts`
+// points to one count per population.
+struct population_count_record {
+    time_type t0;
+    time_type t1;
+    const double* counts;
+};
+
+using population_count_function = std::function<
+    void (std::size_t,                    // number of populations
+          std::size_t,                    // number of count records
+          const population_count_record*  // pointer to first count record
+         )>;
+
+using population_monitor_handle = std::size_t;
+
+// The costs of a local cell group, accumulated while cost accounting is
+// enabled, see simulation::set_cost_accounting. Times are in seconds.
+struct cell_group_cost {
+    std::vector<cell_gid_type> gids;
+    cell_kind kind;
+    std::uint64_t updates = 0;      // number of advances of the group
+    double event_setup = 0;         // merging and staging of events
+    double integrate = 0;           // integration of the cells
+    double sampling = 0;            // set up and delivery of samples
+    std::uint64_t events = 0;       // events delivered to the cells
+    std::uint64_t spikes = 0;       // spikes generated by the cells
+
+    double time() const { return event_setup+integrate+sampling; }
+};
+
+// The costs of the local cell groups, printed as a table with the most
+// expensive groups first.
+struct cell_group_costs {
+    std::vector<cell_group_cost> groups;
+};
+
+std::ostream& operator<<(std::ostream&, const cell_group_costs&);
+
+// The spike traffic replayed by simulation::estimate_scaling: the recorded
+// spikes of the local cells, or if there are none, spikes of the local cells
+// at random times with a mean rate of `rate` Hz per cell.
+struct spike_traffic {
+    std::vector<spike> spikes;
+    double rate = 0;
+    std::uint64_t seed = 0;
+};
+
+// The mean and maximum of a quantity over the epochs of a run.
+struct epoch_statistic {
+    double mean = 0;
+    double max = 0;
+};
+
+// Estimated communication costs of the local domain over a run, see
+// simulation::estimate_scaling.
+struct scaling_estimate {
+    int num_domains = 0;
+    cell_size_type num_cells = 0;        // local cells
+    std::size_t num_connections = 0;     // connections onto local cells
+    std::size_t connection_bytes = 0;    // connection and routing tables
+    time_type epoch_length = 0;          // [ms]
+    unsigned num_epochs = 0;
+
+    // Per epoch:
+    epoch_statistic local_spikes;        // spikes of the local cells
+    epoch_statistic received_spikes;     // spikes received by the local domain
+    epoch_statistic received_bytes;      // volume of the spike exchange received
+    epoch_statistic events;              // events generated for local cells
+    epoch_statistic max_cell_events;     // events of the local cell with the most
+    epoch_statistic exchange_time;       // spike exchange [s]
+    epoch_statistic event_time;          // event generation [s]
+};
+
+std::ostream& operator<<(std::ostream&, const scaling_estimate&);
+
 // simulation_state comprises private implementation for simulation class.
 class simulation_state;
 
@@ -29,25 +175,191 @@ public:
 
     time_type run(time_type tfinal, time_type dt);
 
+    // Persistent run mode, for closed-loop control in short advances. After
+    // start(), a thread of the simulation advances it, with maximum time step
+    // size dt, to each time requested by run_until(), whose future is ready
+    // with the time reached once the spikes up to that time have been
+    // exchanged and the epoch callback has been called. While further times
+    // are requested, the epochs continue without the pipeline of run() being
+    // drained and restarted, and the future of a time may be ready while the
+    // cell groups have been advanced beyond it. Times must be requested in
+    // non-decreasing order. stop() returns once all requested times have
+    // been reached.
+    //
+    // While running, the simulation must not be accessed other than through
+    // run_until(), and from the epoch callback, which serves as the per-epoch
+    // hook. If distributed, each domain must request the same times, and each
+    // time is reached by a run of its own.
+    void start(time_type dt);
+    std::future<time_type> run_until(time_type t);
+    void stop();
+
     // Note: sampler functions may be invoked from a different thread than that
     // which called the `run` method.
 
     sampler_association_handle add_sampler(cell_member_predicate probe_ids,
         schedule sched, sampler_function f, sampling_policy policy = sampling_policy::lax);
 
+    // As add_sampler, but the samples of each probe are presented once per
+    // cell group update as a sample_matrix, avoiding the construction of a
+    // sample record for each sample.
+    sampler_association_handle add_matrix_sampler(cell_member_predicate probe_ids,
+        schedule sched, matrix_sampler_function f, sampling_policy policy = sampling_policy::lax);
+
+    // Call the functions of the record, matrix and triggered samplers added
+    // from now on from `n_threads` threads of their own, instead of from the
+    // threads that advance the cell groups. The samples of each call are
+    // copied into a queue of at most `capacity` calls, and a cell group only
+    // waits for the callbacks if the queue is full. The calls for one probe
+    // are made in order, and all are made before run() returns. Samplers
+    // added earlier are unaffected; zero threads restores direct calls.
+    void set_sampler_threads(unsigned n_threads, std::size_t capacity = 1024);
+
+    // Sample the matching probes at every integration step in the window
+    // [t-pre, t+post] around each trigger time t, and only then. Each spike
+    // of the cell of a probe triggers the probe; trigger_sampler() triggers
+    // all probes of the sampler, at a time not before the end of the last
+    // run. Each window is presented to `f` in one call, once the simulation
+    // has passed its end; windows of triggers too early for the back end to
+    // hold all of their steps, e.g. at the start of a run, are shortened.
+    sampler_association_handle add_triggered_sampler(cell_member_predicate probe_ids,
+        sampling_window window, sampler_function f);
+
+    void trigger_sampler(sampler_association_handle h, time_type t);
+
+    // Sum the samples of all matching probes across cells and domains, for
+    // additive signals such as extracellular potentials or total currents.
+    // Each sample must be a scalar, or a range of `width` values which are
+    // summed element-wise. Samples are summed into a buffer local to the
+    // domain, which is reduced onto the domain `root` every `interval` epochs
+    // without blocking the simulation. `f` is called on the root with the
+    // sums of each reduction once it has completed, and all sums are
+    // delivered before run() returns. A sample is attributed to the first
+    // time of `sched` not before the time at which it was taken.
+    //
+    // This is a collective operation, as is the removal of the sampler: it
+    // must be called on all domains in the same order.
+    sampler_association_handle add_reduced_sampler(cell_member_predicate probe_ids,
+        schedule sched, reduced_sampler_function f, std::size_t width,
+        unsigned interval = 1, int root = 0, sampling_policy policy = sampling_policy::lax);
+
     void remove_sampler(sampler_association_handle);
 
     void remove_all_samplers();
 
+    // Count the spikes generated by each of `n_population` populations of
+    // cells in time bins of width `bin_width`, where `population` maps the
+    // gid of each cell to its population, or to none if its spikes are not
+    // counted. Spikes are counted on the domain that generated them as they
+    // are exchanged, and the counts are reduced onto the domain `root` every
+    // `interval` epochs without blocking the simulation, so that the data
+    // moved scales with the number of populations rather than of spikes.
+    // `f` is called on the root with the counts of each reduction once it
+    // has completed, and all counts are delivered before run() returns;
+    // the bin that is current at the end of run() is reported up to that
+    // time, and its remainder in a separate record by the next run().
+    //
+    // This is a collective operation, as is the removal of the monitor: it
+    // must be called on all domains in the same order.
+    population_monitor_handle add_population_monitor(population_function population,
+        std::size_t n_population, time_type bin_width, population_count_function f,
+        unsigned interval = 1, int root = 0);
+
+    void remove_population_monitor(population_monitor_handle);
+
     // Return probe metadata, one entry per probe associated with supplied probe id,
     // or an empty vector if no local match for probe id.
     std::vector<probe_metadata> get_probe_metadata(cell_member_type probe_id) const;
 
     std::size_t num_spikes() const;
 
+    // Record the time spent on each local cell group in the phases of its
+    // updates, and the numbers of events delivered to and spikes generated by
+    // its cells. Costs are accumulated over calls to run() until they are
+    // cleared by reset() or by enabling accounting again.
+    void set_cost_accounting(bool enable);
+
+    // The costs of the local cell groups recorded so far.
+    cell_group_costs group_costs() const;
+
+    // The recorded cost of every cell in the model, indexed by gid: the time
+    // spent on its group divided by the number of cells in the group. These
+    // can be returned by recipe::cell_cost to balance the load of a later
+    // run by measured costs. This is a collective operation.
+    std::vector<double> cell_costs() const;
+
+    // The bytes held by the communicator, the label resolution map of the
+    // event generators, the event queues, the samplers and the state of each
+    // local cell group, as reported by each of them. Containers are counted
+    // by their contents, or by their allocated storage where it is kept from
+    // one epoch to the next.
+    arb::memory_footprint memory_footprint() const;
+
+    // Estimate the costs of spike communication in a run to tfinal from the
+    // spikes of `traffic`, without integrating the cells: in each epoch the
+    // spikes are exchanged and the events of the local cells generated, as in
+    // run(). On a dry-run context, this predicts the costs of one domain of a
+    // decomposition over many domains. Times exclude the transfer of data
+    // between domains, and the events of cell groups that generate their own
+    // are not counted. This is a collective operation, which leaves the state
+    // of the simulation unchanged.
+    scaling_estimate estimate_scaling(const spike_traffic& traffic, time_type tfinal);
+
     // Set event binning policy on all our groups.
     void set_binning_policy(binning_kind policy, time_type bin_interval);
 
+    // Set how events are delivered to cable cells. With
+    // event_delivery_kind::step_start, every step has the time step given
+    // to run(), except the last of each epoch, and the events that fall in
+    // a step are applied at its start.
+    void set_event_delivery(event_delivery_kind kind);
+
+    // Set the strategy used to exchange spikes between domains. This is
+    // a collective operation, and must be called on all ranks.
+    //
+    // With spike_exchange_kind::point_to_point, the global spike callback
+    // is presented only with the spikes received by the local domain, that is,
+    // those from sources with connections terminating on the local domain.
+    void set_spike_exchange(spike_exchange_kind kind);
+
+    // Set the algorithm used to sort the events pending delivery to each cell
+    // before they are merged into its event lane.
+    void set_event_sort(event_sort_kind kind);
+
+    // Set how the events pending delivery to each cell are stored. With
+    // event_storage_kind::calendar, events are stored by step of the dt of
+    // run(), and the events to a target in one step are delivered at the
+    // start of the step as one event with the sum of their weights.
+    void set_event_storage(event_storage_kind kind);
+
+    // Set how the updates of cell groups and the exchange of their spikes are
+    // scheduled, from the next call to run(). With epoch_schedule::serial,
+    // epochs are twice as long, and the exchange of the spikes of an epoch
+    // does not overlap the update of the next: this halves the number of
+    // epochs, and suits a single domain, where there is no communication to
+    // hide. This is a collective operation, and must be called on all ranks.
+    void set_epoch_schedule(epoch_schedule kind);
+
+    // Set how cell group updates are assigned to threads. The default is
+    // group_affinity::fixed if the threads of the context are bound to CPUs,
+    // and group_affinity::none otherwise.
+    void set_group_affinity(group_affinity affinity);
+
+    // Every `interval` epochs, reassign the cell groups to threads according
+    // to the time spent advancing each since the last reassignment, if that
+    // improves the balance of work between threads. An interval of zero,
+    // the default, disables the measurement and reassignment. Only has an
+    // effect if the group affinity is not group_affinity::none.
+    void set_group_rebalancing(unsigned interval);
+
+    // Exchange spikes with an external simulation through the port every
+    // epoch, or stop with an empty pointer. Epochs are no longer than half
+    // the minimum delay of the external connections of the recipe, so that
+    // the spikes of the external simulation arrive in time without further
+    // synchronization. This is a collective operation, and must be called
+    // on all ranks.
+    void set_external_spike_port(std::shared_ptr<external_spike_port> port);
+
     // Register a callback that will perform a export of the global
     // spike vector.
     void set_global_spike_callback(spike_export_function = spike_export_function{});
@@ -61,10 +373,48 @@ public:
     // are to be delivered at or after the current simulation time.
     void inject_events(const cse_vector& events);
 
+    // Add the `n` events given by the arrays of target gids, target indices,
+    // times and weights, as inject_events above, without building a vector
+    // of events for each cell.
+    void inject_events(std::size_t n, const cell_gid_type* gids, const cell_lid_type* targets,
+                       const time_type* times, const float* weights);
+
+    // Set a callback, called at each epoch boundary during run(), from which
+    // events can be injected in response to the spikes of the previous epochs,
+    // for closed-loop stimulation. The callback may be invoked from a different
+    // thread than that which called run(), concurrently with the integration
+    // of the cells.
+    void set_epoch_callback(epoch_function = epoch_function{});
+
+    // Set a callback that is passed the epoch_metrics of every `interval`
+    // epochs during run(), and of the remaining epochs at the end of each
+    // call to run(). It is called on the thread that called run(), between
+    // epochs. Without a callback, no metrics are recorded.
+    void set_epoch_metrics_callback(epoch_metrics_function = epoch_metrics_function{}, unsigned interval = 1);
+
+    // Write the state of the simulation to a binary stream, and restore it in
+    // a simulation built from the same recipe and domain decomposition. Each
+    // rank writes and reads its own stream. Samplers, callbacks and settings
+    // are not part of the state.
+    void serialize(std::ostream&) const;
+    void deserialize(std::istream&);
+
     ~simulation();
 
+    friend std::vector<time_type> run_ensemble(const std::vector<simulation*>&, time_type, time_type);
+
 private:
     std::unique_ptr<simulation_state> impl_;
 };
 
+// Run distinct, independent simulations built on the same context from their
+// current times to tfinal, with maximum time step size dt, and return the
+// time reached by each. Each simulation is run as one task of the thread pool
+// of the context, so that the threads are shared between the simulations
+// rather than given to each simulation in turn; the work within a simulation
+// is then run with little further concurrency, which suits ensembles of at
+// least as many simulations as threads, as in parameter sweeps. The context
+// must not be distributed over more than one domain.
+std::vector<time_type> run_ensemble(const std::vector<simulation*>& sims, time_type tfinal, time_type dt);
+
 } // namespace arb
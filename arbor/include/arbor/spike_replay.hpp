@@ -0,0 +1,64 @@
+#pragma once
+
+/*
+ * Replay of recorded spike trains from a memory-mapped spike file.
+ *
+ * A replay file is a spike file, as written by spike_writer, whose records
+ * are ordered by source gid and, for each gid, by time. The spikes of a gid
+ * are then a contiguous run of records, which replay_source_cells read in
+ * place, so that the spikes replayed are not copied into process memory.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include <arbor/common_types.hpp>
+
+namespace arb {
+
+class spike_replay_file {
+public:
+    // Map the replay file at `path`. Throws bad_spike_file if the file can
+    // not be read, is not a spike file, or is not ordered by gid and time.
+    explicit spike_replay_file(const std::string& path);
+    ~spike_replay_file();
+
+    spike_replay_file(const spike_replay_file&) = delete;
+    spike_replay_file& operator=(const spike_replay_file&) = delete;
+
+    // Number of spikes in the file.
+    std::size_t size() const { return n_; }
+
+    // The records [b, e) of the spikes of `gid`.
+    std::pair<std::size_t, std::size_t> range(cell_gid_type gid) const;
+
+    std::uint32_t gid(std::size_t i) const {
+        std::uint32_t v;
+        std::memcpy(&v, records_+i*record_size, sizeof v);
+        return v;
+    }
+
+    time_type time(std::size_t i) const {
+        float v;
+        std::memcpy(&v, records_+i*record_size+time_offset, sizeof v);
+        return v;
+    }
+
+private:
+    static constexpr std::size_t record_size = 10;
+    static constexpr std::size_t time_offset = 6;
+
+    void* addr_ = nullptr;
+    std::size_t bytes_ = 0;
+    const char* records_ = nullptr;
+    std::size_t n_ = 0;
+};
+
+// Order the records of the spike file at `path` by gid and time, in place,
+// to make a replay file of it.
+void sort_spike_file(const std::string& path);
+
+} // namespace arb
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
+
 #include <arbor/common_types.hpp>
 #include <arbor/schedule.hpp>
+#include <arbor/spike_replay.hpp>
 
 namespace arb {
 
@@ -16,4 +20,42 @@ struct spike_source_cell {
     spike_source_cell(cell_tag_type source, schedule seq): source(std::move(source)), seq(std::move(seq)) {};
 };
 
+// Alternative cell description for cells of kind cell_kind::spike_source,
+// which generate spikes as a Poisson process of the given rate from tstart
+// until tstop. The intervals are drawn from a counter-based generator keyed
+// by the seed and the gid of the cell, so that the spike times do not depend
+// on the domain decomposition or the number of threads. A cell group draws
+// the spikes of all its Poisson sources in bulk, which is much cheaper for
+// large populations than spike_source_cells with a poisson_schedule.
+
+struct poisson_source_cell {
+    cell_tag_type source;         // Label of source.
+    time_type rate_kHz;           // Mean rate [kHz].
+    std::uint64_t seed = 0;       // Seed of the generator.
+    time_type tstart = 0;         // Start of the process [ms].
+    time_type tstop = terminal_time; // End of the process [ms].
+
+    poisson_source_cell() = delete;
+    poisson_source_cell(cell_tag_type source, time_type rate_kHz, std::uint64_t seed = 0, time_type tstart = 0, time_type tstop = terminal_time):
+        source(std::move(source)), rate_kHz(rate_kHz), seed(seed), tstart(tstart), tstop(tstop)
+    {}
+};
+
+// Alternative cell description for cells of kind cell_kind::spike_source,
+// which replay the spikes of `file_gid` in a replay file, whatever their
+// source index, from their single source. The spikes are read from the
+// mapped file as the cell advances, and the file can be shared by any
+// number of cells.
+
+struct replay_source_cell {
+    cell_tag_type source;                           // Label of source.
+    std::shared_ptr<const spike_replay_file> file;  // Recorded spikes.
+    cell_gid_type file_gid;                         // Gid of the spikes in the file.
+
+    replay_source_cell() = delete;
+    replay_source_cell(cell_tag_type source, std::shared_ptr<const spike_replay_file> file, cell_gid_type file_gid):
+        source(std::move(source)), file(std::move(file)), file_gid(file_gid)
+    {}
+};
+
 } // namespace arb
@@ -0,0 +1,69 @@
+#pragma once
+
+/*
+ * Streaming recorder of spikes to a compact binary file.
+ *
+ * Spikes are staged in memory and written by a dedicated I/O thread, so
+ * that the memory required for recording does not grow with the number of
+ * spikes, and the spike callback does not wait on the file system unless
+ * the I/O thread falls behind.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arbor/simulation.hpp>
+#include <arbor/spike.hpp>
+
+namespace arb {
+
+// The file starts with the eight bytes of `spike_file_magic`, followed by
+// one record of `spike_file_record_size` bytes per spike: the source gid
+// as a 32 bit unsigned integer, the source index as a 16 bit unsigned
+// integer, and the spike time as a single precision float, with no padding
+// and in the byte order of the platform that wrote the file.
+
+constexpr char spike_file_magic[8] = {'a', 'r', 'b', 's', 'p', 'k', 0, 1};
+constexpr std::size_t spike_file_record_size = 10;
+
+class spike_writer {
+public:
+    // Write spikes to the file at `path`, which is created or truncated.
+    // Up to `buffer_size` bytes of spike records are staged in memory
+    // before being passed to the I/O thread; as staging is double
+    // buffered, up to twice that may be held at once.
+    explicit spike_writer(const std::string& path, std::size_t buffer_size = std::size_t(1)<<24);
+
+    // Write any staged spikes and close the file.
+    ~spike_writer();
+
+    spike_writer(const spike_writer&) = delete;
+    spike_writer& operator=(const spike_writer&) = delete;
+
+    // Stage spikes, in the given order. Throws bad_spike_file if a source
+    // index does not fit in 16 bits, in which case none of the spikes are
+    // staged. Errors raised by the I/O thread are rethrown here.
+    void write(const std::vector<spike>& spikes);
+
+    // A spike callback that stages its spikes in this writer, which must
+    // outlive its use in the simulation. Use it as the local spike callback
+    // to write one file per domain, or as the global spike callback to
+    // write all spikes from the root domain.
+    spike_export_function callback();
+
+    // Wait until all staged spikes have been written to the file.
+    void flush();
+
+private:
+    struct impl;
+    std::unique_ptr<impl> impl_;
+};
+
+// Read all the spikes of a spike file.
+std::vector<spike> read_spikes(std::istream& in);
+
+} // namespace arb
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+
+#include <arbor/common_types.hpp>
+
+namespace arb {
+
+// Background input to a synapse of a cable cell: events of a fixed weight
+// arriving as a Poisson process of the given rate from tstart until tstop.
+//
+// Unlike a poisson_schedule event generator, no events are generated.
+// Instead, in every integration step the back end draws the number of events
+// that fall in the step, and applies them to the synapse together as one event
+// of the summed weight. Therefore, the synapse must be a point mechanism with
+// additive events. The counts are drawn from a counter-based generator keyed
+// by the seed, the gid of the cell and the index of the input in the list of
+// the cell, and do not depend on the domain decomposition or the back end.
+
+struct stochastic_input {
+    cell_local_label_type target;    // Label of the target synapse.
+    float weight;                    // Weight of each event.
+    time_type rate_kHz;              // Mean rate [kHz].
+    std::uint64_t seed = 0;          // Seed of the generator.
+    time_type tstart = 0;            // Start of the process [ms].
+    time_type tstop = terminal_time; // End of the process [ms].
+
+    stochastic_input() = delete;
+    stochastic_input(cell_local_label_type target, float weight, time_type rate_kHz, std::uint64_t seed = 0, time_type tstart = 0, time_type tstop = terminal_time):
+        target(std::move(target)), weight(weight), rate_kHz(rate_kHz), seed(seed), tstart(tstart), tstop(tstop)
+    {}
+};
+
+} // namespace arb
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <any>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #include <arbor/recipe.hpp>
 #include <arbor/util/unique_any.hpp>
@@ -21,9 +24,14 @@ public:
 // as many ranks as tile indicates. Its functions call the
 // underlying functions of tile and perform transformations
 // on the results when needed.
+//
+// The bulk queries of the kinds and connections of cells are answered from
+// one copy of those of the cells of the tile, which is queried once and
+// shared by all the tiles of the domain.
 class symmetric_recipe: public recipe {
 public:
-    symmetric_recipe(std::unique_ptr<tile> rec): tiled_recipe_(std::move(rec)) {}
+    symmetric_recipe(std::unique_ptr<tile> rec):
+        tiled_recipe_(std::move(rec)), tile_data_(std::make_shared<tile_data>()) {}
 
     cell_size_type num_cells() const override;
 
@@ -35,10 +43,28 @@ public:
 
     std::vector<cell_connection> connections_on(cell_gid_type i) const override;
 
+    void cell_kinds(cell_gid_type begin, cell_gid_type end, cell_kind* out) const override;
+
+    void connections_on_range(cell_gid_type begin, cell_gid_type end, connection_sink& out) const override;
+
     std::vector<probe_info> get_probes(cell_gid_type i) const override;
 
     std::any get_global_properties(cell_kind ck) const override;
 
+    std::optional<double> cell_cost(cell_gid_type i) const override;
+
     std::unique_ptr<tile> tiled_recipe_;
+
+private:
+    // The kinds and connections of the cells of the tile, by cell.
+    struct tile_data {
+        std::once_flag built;
+        std::vector<cell_kind> kinds;
+        std::vector<std::size_t> conn_divs;
+        std::vector<cell_connection> conns;
+    };
+    std::shared_ptr<tile_data> tile_data_;
+
+    const tile_data& get_tile_data() const;
 };
 } // namespace arb
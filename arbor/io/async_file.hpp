@@ -0,0 +1,136 @@
+#pragma once
+
+// Binary output file written by a background thread.
+//
+// Data are appended to an in-memory staging buffer of fixed size. When it
+// is full, it is swapped with a second buffer, which a dedicated I/O thread
+// then writes to the file; only if that buffer is still being written does
+// an append wait. Write errors raised on the I/O thread are reported, as an
+// exception of type `Error`, by the next append or flush.
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+
+namespace arb {
+namespace io {
+
+template <typename Error>
+class async_file {
+public:
+    // Create or truncate the file at `path`, and write the `n_header` bytes
+    // at `header` to it.
+    async_file(const std::string& path, std::size_t buffer_size, const char* header, std::size_t n_header):
+        out_(path, std::ios::binary|std::ios::trunc),
+        buffer_size_(buffer_size)
+    {
+        if (!out_) {
+            throw file_not_found_error(path);
+        }
+        out_.write(header, n_header);
+
+        front_.reserve(buffer_size);
+        back_.reserve(buffer_size);
+        io_ = std::thread([this] { run(); });
+    }
+
+    ~async_file() {
+        {
+            std::unique_lock<std::mutex> lock(mex_);
+            if (!front_.empty()) hand_off(lock);
+            done_ = true;
+        }
+        cv_.notify_all();
+        io_.join();
+    }
+
+    async_file(const async_file&) = delete;
+    async_file& operator=(const async_file&) = delete;
+
+    // Append `n` bytes, which are written by `fill(p)` to the staging
+    // buffer at `p`.
+    template <typename Fill>
+    void append(std::size_t n, Fill&& fill) {
+        std::unique_lock<std::mutex> lock(mex_);
+        rethrow();
+
+        std::size_t offset = front_.size();
+        front_.resize(offset+n);
+        fill(front_.data()+offset);
+
+        if (front_.size()>=buffer_size_) hand_off(lock);
+    }
+
+    // Wait until all appended data have been written to the file.
+    void flush() {
+        std::unique_lock<std::mutex> lock(mex_);
+        if (!front_.empty()) hand_off(lock);
+        cv_.wait(lock, [this] { return !pending_; });
+        rethrow();
+    }
+
+private:
+    std::ofstream out_;
+    std::size_t buffer_size_;
+
+    std::mutex mex_;
+    std::condition_variable cv_;
+    std::vector<char> front_, back_;
+    bool pending_ = false;  // back buffer is waiting to be written
+    bool done_ = false;     // I/O thread should exit
+    std::exception_ptr error_;
+
+    std::thread io_;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mex_);
+        for (;;) {
+            cv_.wait(lock, [this] { return pending_ || done_; });
+            if (!pending_) return;
+
+            // The back buffer belongs to the I/O thread until pending is reset.
+            lock.unlock();
+            try {
+                if (!out_.write(back_.data(), back_.size()) || !out_.flush()) {
+                    throw Error("unable to write to file");
+                }
+            }
+            catch (...) {
+                lock.lock();
+                if (!error_) error_ = std::current_exception();
+                lock.unlock();
+            }
+            back_.clear();
+
+            lock.lock();
+            pending_ = false;
+            cv_.notify_all();
+        }
+    }
+
+    // Pass the front buffer to the I/O thread, once the back buffer is free.
+    void hand_off(std::unique_lock<std::mutex>& lock) {
+        cv_.wait(lock, [this] { return !pending_; });
+        std::swap(front_, back_);
+        pending_ = true;
+        cv_.notify_all();
+    }
+
+    void rethrow() {
+        if (error_) {
+            auto e = error_;
+            error_ = nullptr;
+            std::rethrow_exception(e);
+        }
+    }
+};
+
+} // namespace io
+} // namespace arb
@@ -0,0 +1,136 @@
+#pragma once
+
+// Binary output and input of simulation state, for checkpointing.
+//
+// Values and arrays of trivially copyable types are written in their native
+// representation, so that a checkpoint can only be read back by the same
+// build of arbor on the same platform. Each array is preceded by its length.
+
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <streambuf>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+
+#include "util/strprintf.hpp"
+
+namespace arb {
+namespace io {
+
+class serializer {
+public:
+    explicit serializer(std::ostream& out): out_(out) {}
+
+    template <typename T>
+    void value(const T& v) {
+        static_assert(std::is_trivially_copyable<T>::value, "value must be trivially copyable");
+        bytes(&v, sizeof v);
+    }
+
+    // Write a contiguous sequence, e.g. a std::vector or a back-end array.
+    template <typename Seq>
+    void array(const Seq& seq) {
+        array(std::data(seq), std::size(seq));
+    }
+
+    template <typename T>
+    void array(const T* p, std::size_t n) {
+        static_assert(std::is_trivially_copyable<T>::value, "array elements must be trivially copyable");
+
+        value<std::uint64_t>(n);
+        bytes(p, n*sizeof(T));
+    }
+
+    void string(const std::string& s) { array(s); }
+
+private:
+    std::ostream& out_;
+
+    void bytes(const void* p, std::size_t n) {
+        if (!out_.write(static_cast<const char*>(p), n)) {
+            throw bad_checkpoint("unable to write to stream");
+        }
+    }
+};
+
+class deserializer {
+public:
+    explicit deserializer(std::istream& in): in_(in) {}
+
+    template <typename T>
+    void value(T& v) {
+        static_assert(std::is_trivially_copyable<T>::value, "value must be trivially copyable");
+        bytes(&v, sizeof v);
+    }
+
+    template <typename T>
+    T value() {
+        T v;
+        value(v);
+        return v;
+    }
+
+    // Read a value, which must match the expected value of the state being
+    // restored: `what` describes the value in the error message.
+    template <typename T>
+    void expect(const T& expected, const char* what) {
+        if (value<T>()!=expected) {
+            throw bad_checkpoint(util::pprintf("{} does not match the simulation", what));
+        }
+    }
+
+    // Read into a contiguous sequence of fixed size, which must match the
+    // length of the stored array.
+    template <typename Seq>
+    void array(Seq& seq) {
+        array(std::data(seq), std::size(seq));
+    }
+
+    template <typename T>
+    void array(T* p, std::size_t n) {
+        auto m = value<std::uint64_t>();
+        if (m!=n) {
+            throw bad_checkpoint(util::pprintf("array of length {}, where {} expected", m, n));
+        }
+        bytes(p, n*sizeof(T));
+    }
+
+    // Read into a vector, resized to the length of the stored array.
+    template <typename T, typename A>
+    void vector(std::vector<T, A>& v) {
+        v.resize(value<std::uint64_t>());
+        bytes(v.data(), v.size()*sizeof(T));
+    }
+
+    std::string string() {
+        std::string s(value<std::uint64_t>(), '\0');
+        bytes(s.data(), s.size());
+        return s;
+    }
+
+private:
+    std::istream& in_;
+
+    void bytes(void* p, std::size_t n) {
+        if (!in_.read(static_cast<char*>(p), n)) {
+            throw bad_checkpoint("unexpected end of stream");
+        }
+    }
+};
+
+// Stream buffer over a block of memory, so that state held in memory can be
+// read back without copying it into a string stream first.
+class memory_buf: public std::streambuf {
+public:
+    memory_buf(const char* p, std::size_t n) {
+        auto q = const_cast<char*>(p);
+        setg(q, q, q+n);
+    }
+};
+
+} // namespace io
+} // namespace arb
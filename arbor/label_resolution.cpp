@@ -1,4 +1,7 @@
+#include <algorithm>
 #include <iterator>
+#include <stdexcept>
+#include <tuple>
 #include <vector>
 
 #include <arbor/assert.hpp>
@@ -82,13 +85,42 @@ lid_hopefully label_resolution_map::range_set::at(unsigned idx) const {
     return start + offset;
 }
 
-const label_resolution_map::range_set& label_resolution_map::at(const cell_gid_type& gid, const cell_tag_type& tag) const {
-    return map.at(gid).at(tag);
+label_resolution_map::range_set label_resolution_map::at(const cell_gid_type& gid, const cell_tag_type& tag) const {
+    auto i = find(gid, tag);
+    if (i==npos) throw std::out_of_range("label_resolution_map: no such gid and label");
+    return entry(i);
 }
 
 std::size_t label_resolution_map::count(const cell_gid_type& gid, const cell_tag_type& tag) const {
-    if (!map.count(gid)) return 0u;
-    return map.at(gid).count(tag);
+    return find(gid, tag)!=npos;
+}
+
+std::size_t label_resolution_map::find(const cell_gid_type& gid, const cell_tag_type& tag) const {
+    auto t = std::lower_bound(tags_.begin(), tags_.end(), tag);
+    if (t==tags_.end() || *t!=tag) return npos;
+    cell_size_type tag_id = t - tags_.begin();
+
+    auto g = std::lower_bound(gids_.begin(), gids_.end(), gid);
+    if (g==gids_.end() || *g!=gid) return npos;
+    auto gi = g - gids_.begin();
+
+    auto first = entry_tags_.begin() + gid_divs_[gi];
+    auto last  = entry_tags_.begin() + gid_divs_[gi+1];
+    auto e = std::lower_bound(first, last, tag_id);
+    if (e==last || *e!=tag_id) return npos;
+    return e - entry_tags_.begin();
+}
+
+label_resolution_map::range_set label_resolution_map::entry(std::size_t i) const {
+    auto b = entry_divs_[i], e = entry_divs_[i+1];
+    return {util::make_range(ranges_.data()+b, ranges_.data()+e),
+            util::make_range(lid_divs_.data()+b+i, lid_divs_.data()+e+i+1)};
+}
+
+std::size_t label_resolution_map::bytes() const {
+    std::size_t n = util::size_in_bytes(tags_, gids_, gid_divs_, entry_tags_, entry_divs_, ranges_, lid_divs_);
+    for (const auto& t: tags_) n += t.capacity();
+    return n;
 }
 
 label_resolution_map::label_resolution_map(const cell_labels_and_gids& clg) {
@@ -98,27 +130,65 @@ label_resolution_map::label_resolution_map(const cell_labels_and_gids& clg) {
     const auto& ranges = clg.label_range.ranges();
     const auto& sizes = clg.label_range.sizes();
 
+    auto sorted_gids = gids;
+    util::sort(sorted_gids);
+    if (std::adjacent_find(sorted_gids.begin(), sorted_gids.end())!=sorted_gids.end()) {
+        throw arb::arbor_internal_error("label_resolution_map: duplicate gid");
+    }
+
+    // Intern the labels.
+    tags_ = labels;
+    util::sort(tags_);
+    tags_.erase(std::unique(tags_.begin(), tags_.end()), tags_.end());
+    auto tag_id = [this](const cell_tag_type& tag) {
+        return cell_size_type(std::lower_bound(tags_.begin(), tags_.end(), tag) - tags_.begin());
+    };
+
+    // One record per label of each cell, ordered by gid and then label; the
+    // ranges of a (gid, label) pair keep their order.
+    struct record {
+        cell_gid_type gid;
+        cell_size_type tag;
+        lid_range range;
+    };
+    std::vector<record> records;
+    records.reserve(labels.size());
+
     std::vector<cell_size_type> label_divs;
     auto partn = util::make_partition(label_divs, sizes);
     for (auto i: util::count_along(partn)) {
-        auto gid = gids[i];
-
-        std::unordered_map<cell_tag_type, range_set> m;
         for (auto label_idx: util::make_span(partn[i])) {
             const auto range = ranges[label_idx];
-            auto size = int(range.end - range.begin);
-            if (size < 0) {
+            if (int(range.end - range.begin) < 0) {
                 throw arb::arbor_internal_error("label_resolution_map: invalid lid_range");
             }
-            auto& range_set = m[labels[label_idx]];
-            range_set.ranges.push_back(range);
-            range_set.ranges_partition.push_back(range_set.ranges_partition.back() + size);
+            records.push_back({gids[i], tag_id(labels[label_idx]), range});
         }
-        if (!map.insert({gid, std::move(m)}).second) {
-            throw arb::arbor_internal_error("label_resolution_map: duplicate gid");
+    }
+    std::stable_sort(records.begin(), records.end(),
+        [](const record& a, const record& b) { return std::tie(a.gid, a.tag) < std::tie(b.gid, b.tag); });
+
+    ranges_.reserve(records.size());
+    for (auto i: util::count_along(records)) {
+        const auto& r = records[i];
+        bool new_gid = i==0 || r.gid!=records[i-1].gid;
+        bool new_entry = new_gid || r.tag!=records[i-1].tag;
+        if (new_gid) {
+            gids_.push_back(r.gid);
+            gid_divs_.push_back(entry_tags_.size());
+        }
+        if (new_entry) {
+            entry_tags_.push_back(r.tag);
+            entry_divs_.push_back(ranges_.size());
+            lid_divs_.push_back(0);
         }
+        ranges_.push_back(r.range);
+        lid_divs_.push_back(lid_divs_.back() + (r.range.end - r.range.begin));
     }
+    gid_divs_.push_back(entry_tags_.size());
+    entry_divs_.push_back(ranges_.size());
 }
+
 // variant state methods
 lid_hopefully round_robin_state::update(const label_resolution_map::range_set& range_set) {
     auto lid = range_set.at(state);
@@ -146,17 +216,20 @@ resolver::state_variant resolver::construct_state(lid_selection_policy pol) {
 }
 
 cell_lid_type resolver::resolve(const cell_global_label_type& iden) {
-    if (!label_map_->count(iden.gid, iden.label.tag)) {
+    auto entry = label_map_->find(iden.gid, iden.label.tag);
+    if (entry==label_resolution_map::npos) {
         throw arb::bad_connection_label(iden.gid, iden.label.tag, "label does not exist");
     }
-    const auto& range_set = label_map_->at(iden.gid, iden.label.tag);
+    const auto range_set = label_map_->entry(entry);
 
     // Construct state if if doesn't exist
-    if (!state_map_[iden.gid][iden.label.tag].count(iden.label.policy)) {
-        state_map_[iden.gid][iden.label.tag][iden.label.policy] = construct_state(iden.label.policy);
+    auto key = 2*entry + (iden.label.policy==lid_selection_policy::round_robin? 0: 1);
+    auto state = state_map_.find(key);
+    if (state==state_map_.end()) {
+        state = state_map_.emplace(key, construct_state(iden.label.policy)).first;
     }
 
-    auto lid = std::visit([range_set](auto& state) { return state.update(range_set); }, state_map_[iden.gid][iden.label.tag][iden.label.policy]);
+    auto lid = std::visit([&range_set](auto& state) { return state.update(range_set); }, state->second);
     if (!lid) {
         throw arb::bad_connection_label(iden.gid, iden.label.tag, lid.error());
     }
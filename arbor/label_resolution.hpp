@@ -8,6 +8,7 @@
 #include <arbor/util/expected.hpp>
 
 #include "util/partition.hpp"
+#include "util/range.hpp"
 
 namespace arb {
 
@@ -66,24 +67,56 @@ struct cell_labels_and_gids {
 
 // Class constructed from `cell_labels_and_ranges`:
 // Represents the information in the object in a more
-// structured manner for lid resolution in `resolver`
+// structured manner for lid resolution in `resolver`.
+//
+// Labels are interned: each distinct label is stored once, and is identified
+// by its index in the sorted table of labels. The (gid, label) pairs are
+// kept in flat arrays ordered by gid and label id, so that lookups are
+// binary searches that neither hash nor copy strings.
 class label_resolution_map {
 public:
+    // View of the lid ranges of one (gid, label) pair; `ranges_partition`
+    // holds the running count of lids over `ranges`, starting at zero.
     struct range_set {
-        std::vector<lid_range> ranges;
-        std::vector<unsigned> ranges_partition = {0};
+        util::range<const lid_range*> ranges;
+        util::range<const cell_size_type*> ranges_partition;
         cell_size_type size() const;
         lid_hopefully at(unsigned idx) const;
     };
 
+    static constexpr std::size_t npos = std::size_t(-1);
+
     label_resolution_map() = delete;
     explicit label_resolution_map(const cell_labels_and_gids&);
 
-    const range_set& at(const cell_gid_type& gid, const cell_tag_type& tag) const;
+    // Throws std::out_of_range if there is no such (gid, label) pair.
+    range_set at(const cell_gid_type& gid, const cell_tag_type& tag) const;
     std::size_t count(const cell_gid_type& gid, const cell_tag_type& tag) const;
 
+    // Index of the (gid, label) pair, or npos.
+    std::size_t find(const cell_gid_type& gid, const cell_tag_type& tag) const;
+    range_set entry(std::size_t i) const;
+
+    // Bytes held by the map.
+    std::size_t bytes() const;
+
 private:
-    std::unordered_map<cell_gid_type, std::unordered_map<cell_tag_type, range_set>> map;
+    // Distinct labels, sorted.
+    std::vector<cell_tag_type> tags_;
+
+    // Distinct gids with at least one label, sorted, and the partition of
+    // the (gid, label) entries by gid.
+    std::vector<cell_gid_type> gids_;
+    std::vector<cell_size_type> gid_divs_;
+
+    // Label id of each entry, and the partition of `ranges_` by entry.
+    std::vector<cell_size_type> entry_tags_;
+    std::vector<cell_size_type> entry_divs_;
+
+    // Lid ranges, and for entry i the running lid counts over its ranges at
+    // offset entry_divs_[i] + i of `lid_divs_`.
+    std::vector<lid_range> ranges_;
+    std::vector<cell_size_type> lid_divs_;
 };
 
 struct round_robin_state {
@@ -109,6 +142,7 @@ private:
     state_variant construct_state(lid_selection_policy pol);
 
     const label_resolution_map* label_map_;
-    std::unordered_map<cell_gid_type, std::unordered_map<cell_tag_type, std::unordered_map <lid_selection_policy, state_variant>>> state_map_;
+    // Selection state, by map entry and policy.
+    std::unordered_map<std::size_t, state_variant> state_map_;
 };
 } // namespace arb
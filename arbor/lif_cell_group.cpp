@@ -1,13 +1,25 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
 #include <arbor/arbexcept.hpp>
 
+#include "execution_context.hpp"
 #include "label_resolution.hpp"
 #include "lif_cell_group.hpp"
 #include "profile/profiler_macro.hpp"
 #include "util/rangeutil.hpp"
 #include "util/span.hpp"
 
+#ifdef ARB_HAVE_GPU
+#include "backends/gpu/lif_state.hpp"
+#endif
+
 using namespace arb;
 
+// Alignment of the per-cell arrays, for vectorised updates.
+static constexpr std::size_t lif_alignment = 64;
+
 // Constructor containing gid of first cell in a group and a container of all cells.
 lif_cell_group::lif_cell_group(const std::vector<cell_gid_type>& gids, const recipe& rec, cell_label_range& cg_sources, cell_label_range& cg_targets):
     gids_(gids)
@@ -17,21 +29,57 @@ lif_cell_group::lif_cell_group(const std::vector<cell_gid_type>& gids, const rec
             throw bad_cell_probe(cell_kind::lif, gid);
         }
     }
-    // Default to no binning of events
-    set_binning_policy(binning_kind::none, 0);
-
-    cells_.reserve(gids_.size());
-    last_time_updated_.resize(gids_.size());
 
-    for (auto lid: util::make_span(gids_.size())) {
-        cells_.push_back(util::any_cast<lif_cell>(rec.get_cell_description(gids_[lid])));
+    const auto n = gids_.size();
+    util::padded_allocator<value_type> pad(lif_alignment);
+    for (auto* a: {&tau_m_inv_, &C_m_inv_, &V_th_, &E_L_, &t_ref_, &V_m_init_, &V_m_, &decay_, &binned_weights_, &carried_weights_, &last_time_updated_}) {
+        *a = array(pad);
+        a->reserve(n);
     }
+    last_time_updated_.assign(n, 0.);
+    carried_weights_.assign(n, 0.);
+
+    // Only the parameters of the cells are kept, in per-cell arrays.
+    for (auto lid: util::make_span(n)) {
+        auto cell = util::any_cast<lif_cell>(rec.get_cell_description(gids_[lid]));
+
+        tau_m_inv_.push_back(1/cell.tau_m);
+        C_m_inv_.push_back(1/cell.C_m);
+        V_th_.push_back(cell.V_th);
+        E_L_.push_back(cell.E_L);
+        t_ref_.push_back(cell.t_ref);
+        V_m_init_.push_back(cell.V_m);
 
-    for (const auto& c: cells_) {
         cg_sources.add_cell();
         cg_targets.add_cell();
-        cg_sources.add_label(c.source, {0, 1});
-        cg_targets.add_label(c.target, {0, 1});
+        cg_sources.add_label(cell.source, {0, 1});
+        cg_targets.add_label(cell.target, {0, 1});
+    }
+    V_m_ = V_m_init_;
+
+    // Default to no binning of events
+    set_binning_policy(binning_kind::none, 0);
+}
+
+lif_cell_group::lif_cell_group(const std::vector<cell_gid_type>& gids, const recipe& rec, cell_label_range& cg_sources, cell_label_range& cg_targets,
+                               backend_kind backend, const execution_context& ctx):
+    lif_cell_group(gids, rec, cg_sources, cg_targets)
+{
+    if (backend==backend_kind::gpu) {
+#ifdef ARB_HAVE_GPU
+        if (!ctx.gpu->has_gpu()) {
+            throw arbor_internal_error("lif_cell_group: no GPU for the GPU back end");
+        }
+        std::vector<value_type> tau_m_inv(tau_m_inv_.begin(), tau_m_inv_.end());
+        std::vector<value_type> C_m_inv(C_m_inv_.begin(), C_m_inv_.end());
+        std::vector<value_type> V_th(V_th_.begin(), V_th_.end());
+        std::vector<value_type> E_L(E_L_.begin(), E_L_.end());
+        std::vector<value_type> t_ref(t_ref_.begin(), t_ref_.end());
+        gpu_ = std::make_shared<gpu::lif_state>(ctx.gpu, tau_m_inv, C_m_inv, V_th, E_L, t_ref);
+        gpu_->set_state(V_m_.data(), last_time_updated_.data());
+#else
+        throw arbor_internal_error("lif_cell_group: arbor was built without GPU support");
+#endif
     }
 }
 
@@ -42,9 +90,17 @@ cell_kind lif_cell_group::get_cell_kind() const {
 void lif_cell_group::advance(epoch ep, time_type dt, const event_lane_subrange& event_lanes) {
     PE(advance_lif);
     if (event_lanes.size() > 0) {
-        for (auto lid: util::make_span(gids_.size())) {
-            // Advance each cell independently.
-            advance_cell(ep.t1, dt, lid, event_lanes[lid]);
+        if (gpu_) {
+            advance_gpu(ep, event_lanes);
+        }
+        else if (binning_==binning_kind::regular) {
+            advance_binned(ep, event_lanes);
+        }
+        else {
+            for (auto lid: util::make_span(gids_.size())) {
+                // Advance each cell independently.
+                advance_cell(ep.t1, dt, lid, event_lanes[lid]);
+            }
         }
     }
     PL();
@@ -58,19 +114,75 @@ void lif_cell_group::clear_spikes() {
     spikes_.clear();
 }
 
+memory_use lif_cell_group::state_memory() const {
+    memory_use m;
+    m.host = util::size_in_bytes(gids_, tau_m_inv_, C_m_inv_, V_th_, E_L_, t_ref_, V_m_init_, V_m_,
+                                 decay_, binned_weights_, carried_weights_, spikes_, last_time_updated_,
+                                 event_offsets_, event_times_, event_weights_, spike_times_);
+#ifdef ARB_HAVE_GPU
+    if (gpu_) m.device = gpu_->bytes();
+#endif
+    return m;
+}
+
 // TODO: implement sampler
 void lif_cell_group::add_sampler(sampler_association_handle h, cell_member_predicate probe_ids,
                                     schedule sched, sampler_function fn, sampling_policy policy) {}
 void lif_cell_group::remove_sampler(sampler_association_handle h) {}
 void lif_cell_group::remove_all_samplers() {}
 
-// TODO: implement binner_
+// With regular binning, the cells are updated on the grid of the binning
+// interval instead of at each event; other policies leave the exact update.
+// Cells on the GPU always use the exact update.
 void lif_cell_group::set_binning_policy(binning_kind policy, time_type bin_interval) {
+    if (policy==binning_kind::regular && (!(bin_interval>0) || gpu_)) {
+        policy = binning_kind::none;
+    }
+    binning_ = policy;
+    bin_interval_ = bin_interval;
+
+    decay_.clear();
+    if (binning_==binning_kind::regular) {
+        for (auto r: tau_m_inv_) {
+            decay_.push_back(exp(-bin_interval_*r));
+        }
+    }
 }
 
 void lif_cell_group::reset() {
     spikes_.clear();
     util::fill(last_time_updated_, 0.);
+    util::fill(carried_weights_, 0.);
+    V_m_ = V_m_init_;
+#ifdef ARB_HAVE_GPU
+    if (gpu_) gpu_->set_state(V_m_.data(), last_time_updated_.data());
+#endif
+}
+
+void lif_cell_group::serialize(io::serializer& out) const {
+#ifdef ARB_HAVE_GPU
+    if (gpu_) {
+        array t_last(last_time_updated_.size()), V_m(V_m_.size());
+        gpu_->get_state(V_m.data(), t_last.data());
+        out.array(t_last);
+        out.array(V_m);
+        out.array(carried_weights_);
+        return;
+    }
+#endif
+    out.array(last_time_updated_);
+    out.array(V_m_);
+    out.array(carried_weights_);
+}
+
+void lif_cell_group::deserialize(io::deserializer& in, time_type) {
+    spikes_.clear();
+    in.array(last_time_updated_);
+    in.array(V_m_);
+    in.array(carried_weights_);
+#ifdef ARB_HAVE_GPU
+    if (gpu_) gpu_->set_state(V_m_.data(), last_time_updated_.data());
+#endif
 }
 
 // Advances a single cell (lid) with the exact solution (jumps can be arbitrary).
@@ -78,7 +190,9 @@ void lif_cell_group::reset() {
 void lif_cell_group::advance_cell(time_type tfinal, time_type dt, cell_gid_type lid, pse_vector& event_lane) {
     // Current time of last update.
     auto t = last_time_updated_[lid];
-    auto& cell = cells_[lid];
+    auto V_m = V_m_[lid];
+    const auto tau_m_inv = tau_m_inv_[lid];
+    const auto C_m_inv = C_m_inv_[lid];
     const auto n_events = event_lane.size();
 
     // Integrate until tfinal using the exact solution of membrane voltage differential equation.
@@ -96,27 +210,122 @@ void lif_cell_group::advance_cell(time_type tfinal, time_type dt, cell_gid_type
             i++;
         }
 
-        // Let the membrane potential decay.
-        auto decay = exp(-(time - t) / cell.tau_m);
-        cell.V_m *= decay;
-        auto update = weight / cell.C_m;
-        // Add jump due to spike.
-        cell.V_m += update;
+        // Let the membrane potential decay, and add jump due to spike.
+        V_m = V_m*exp(-(time - t)*tau_m_inv) + weight*C_m_inv;
         t = time;
         // If crossing threshold occurred
-        if (cell.V_m >= cell.V_th) {
+        if (V_m >= V_th_[lid]) {
             cell_member_type spike_neuron_gid = {gids_[lid], 0};
             spike s = {spike_neuron_gid, t};
             spikes_.push_back(s);
 
             // Advance the last_time_updated to account for the refractory period.
-            t += cell.t_ref;
+            t += t_ref_[lid];
 
             // Reset the voltage to resting potential.
-            cell.V_m = cell.E_L;
+            V_m = E_L_[lid];
         }
     }
 
     // This is the last time a cell was updated.
     last_time_updated_[lid] = t;
-}
\ No newline at end of file
+    V_m_[lid] = V_m;
+}
+
+// Advances all cells through the steps k*h of the binning interval h in the
+// epoch. The events of each cell are summed by the first step at or after
+// their time, and applied after the potential has decayed by the precomputed
+// factor for one step; the events due at the first step after the epoch are
+// kept for the next. A cell in its refractory period at k*h ignores the
+// events of that step, as in the exact update. The update of each step is a
+// loop over the cell arrays without branches, so that it vectorises; only
+// the rare threshold crossings are handled per cell.
+void lif_cell_group::advance_binned(epoch ep, const event_lane_subrange& event_lanes) {
+    const auto h = bin_interval_;
+    const auto n = gids_.size();
+
+    // The first step at or after t. As the end of one epoch is the start of
+    // the next, no step is skipped or repeated.
+    auto first_step = [h](time_type t) {
+        auto k = (std::int64_t)std::ceil(t/h);
+        while (k>0 && (k-1)*h>=t) --k;
+        while (k*h<t) ++k;
+        return k;
+    };
+    const auto k0 = first_step(ep.t0);
+    const auto k1 = first_step(ep.t1);
+    const std::size_t n_steps = k1-k0;
+
+    // Weights by step, with a last row for the first step after the epoch.
+    binned_weights_.assign((n_steps+1)*n, 0.);
+    std::copy(carried_weights_.begin(), carried_weights_.end(), binned_weights_.begin());
+    for (auto lid: util::make_span(n)) {
+        for (const auto& ev: event_lanes[lid]) {
+            if (ev.time>=ep.t1) break;
+            binned_weights_[(first_step(ev.time)-k0)*n+lid] += ev.weight;
+        }
+    }
+    std::copy(binned_weights_.end()-n, binned_weights_.end(), carried_weights_.begin());
+
+    value_type* __restrict__ V_m = V_m_.data();
+    value_type* __restrict__ t_last = last_time_updated_.data();
+    const value_type* __restrict__ decay = decay_.data();
+    const value_type* __restrict__ C_m_inv = C_m_inv_.data();
+    const value_type* __restrict__ V_th = V_th_.data();
+
+    for (std::size_t s = 0; s<n_steps; ++s) {
+        const time_type t = (k0+(std::int64_t)s)*h;
+        const value_type* __restrict__ w = binned_weights_.data()+s*n;
+
+        int crossed = 0;
+        for (std::size_t i = 0; i<n; ++i) {
+            const bool active = t>=t_last[i];
+            const value_type v = V_m[i]*decay[i] + w[i]*C_m_inv[i];
+            V_m[i] = active? v: V_m[i];
+            t_last[i] = active? t: t_last[i];
+            crossed |= active & (v>=V_th[i]);
+        }
+
+        if (crossed) {
+            for (std::size_t i = 0; i<n; ++i) {
+                if (t_last[i]==t && V_m[i]>=V_th[i]) {
+                    spikes_.push_back({{gids_[i], 0}, t});
+                    t_last[i] = t + t_ref_[i];
+                    V_m[i] = E_L_[i];
+                }
+            }
+        }
+    }
+}
+
+// Advances all cells on the device, one thread per cell, through the events
+// of the epoch, which are passed as one array sorted by cell and time. Each
+// spike is reported at the index of the event that caused it, from which the
+// spikes are collected in the order of the cells.
+void lif_cell_group::advance_gpu(epoch ep, const event_lane_subrange& event_lanes) {
+#ifdef ARB_HAVE_GPU
+    const auto n = gids_.size();
+
+    event_offsets_.assign(1, 0);
+    event_times_.clear();
+    event_weights_.clear();
+    for (auto lid: util::make_span(n)) {
+        for (const auto& ev: event_lanes[lid]) {
+            if (ev.time>=ep.t1) break;
+            event_times_.push_back(ev.time);
+            event_weights_.push_back(ev.weight);
+        }
+        event_offsets_.push_back(event_times_.size());
+    }
+
+    gpu_->advance(ep.t1, event_offsets_, event_times_, event_weights_, spike_times_);
+
+    for (auto lid: util::make_span(n)) {
+        for (auto k = event_offsets_[lid]; k<event_offsets_[lid+1]; ++k) {
+            if (spike_times_[k]>=0) {
+                spikes_.push_back({{gids_[lid], 0}, spike_times_[k]});
+            }
+        }
+    }
+#endif
+}
@@ -1,18 +1,26 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 
 #include <arbor/common_types.hpp>
+#include <arbor/fvm_types.hpp>
 #include <arbor/lif_cell.hpp>
 #include <arbor/recipe.hpp>
 #include <arbor/sampling.hpp>
 #include <arbor/spike.hpp>
 
 #include "cell_group.hpp"
+#include "execution_context.hpp"
 #include "label_resolution.hpp"
+#include "util/padded_alloc.hpp"
 
 namespace arb {
 
+namespace gpu {
+class lif_state;
+}
+
 class lif_cell_group: public cell_group {
 public:
     using value_type = double;
@@ -22,14 +30,23 @@ public:
     // Constructor containing gid of first cell in a group and a container of all cells.
     lif_cell_group(const std::vector<cell_gid_type>& gids, const recipe& rec, cell_label_range& cg_sources, cell_label_range& cg_targets);
 
+    // Constructor for a group of cells on the given back end. With the GPU
+    // back end, the cells are advanced on the device of the context.
+    lif_cell_group(const std::vector<cell_gid_type>& gids, const recipe& rec, cell_label_range& cg_sources, cell_label_range& cg_targets,
+                   backend_kind backend, const execution_context& ctx);
+
     virtual cell_kind get_cell_kind() const override;
     virtual void reset() override;
+    virtual void serialize(io::serializer& out) const override;
+    virtual void deserialize(io::deserializer& in, time_type t) override;
     virtual void set_binning_policy(binning_kind policy, time_type bin_interval) override;
     virtual void advance(epoch epoch, time_type dt, const event_lane_subrange& events) override;
 
     virtual const std::vector<spike>& spikes() const override;
     virtual void clear_spikes() override;
 
+    virtual memory_use state_memory() const override;
+
     // Sampler association methods below should be thread-safe, as they might be invoked
     // from a sampler call back called from a different cell group running on a different thread.
     virtual void add_sampler(sampler_association_handle, cell_member_predicate, schedule, sampler_function, sampling_policy) override;
@@ -37,21 +54,57 @@ public:
     virtual void remove_all_samplers() override;
 
 private:
+    using array = std::vector<value_type, util::padded_allocator<value_type>>;
+
     // Advances a single cell (lid) with the exact solution (jumps can be arbitrary).
     // Parameter dt is ignored, since we make jumps between two consecutive spikes.
     void advance_cell(time_type tfinal, time_type dt, cell_gid_type lid, pse_vector& event_lane);
 
+    // Advances all cells on the grid of the regular binning interval, with
+    // the events of each cell summed by step.
+    void advance_binned(epoch ep, const event_lane_subrange& event_lanes);
+
+    // Advances all cells on the device with the exact solution.
+    void advance_gpu(epoch ep, const event_lane_subrange& event_lanes);
+
     // List of the gids of the cells in the group.
     std::vector<cell_gid_type> gids_;
 
-    // Cells that belong to this group.
-    std::vector<lif_cell> cells_;
+    // Parameters and state of the cells in the group, one entry per cell.
+    array tau_m_inv_;   // 1/tau_m
+    array C_m_inv_;     // 1/C_m
+    array V_th_;
+    array E_L_;
+    array t_ref_;
+    array V_m_init_;
+    array V_m_;
+
+    // Decay of the membrane potential over one binning interval, if events
+    // are binned regularly.
+    binning_kind binning_ = binning_kind::none;
+    time_type bin_interval_ = 0;
+    array decay_;
+
+    // Summed event weights by step and cell, and those of the events due at
+    // the first step of the next epoch.
+    array binned_weights_;
+    array carried_weights_;
 
     // Spikes that are generated (not necessarily sorted).
     std::vector<spike> spikes_;
 
     // Time when the cell was last updated.
-    std::vector<time_type> last_time_updated_;
+    array last_time_updated_;
+
+    // State of the cells on the device, if any, which holds the membrane
+    // potentials and times of last update in place of V_m_ and
+    // last_time_updated_; and the events of all cells of an epoch, in
+    // per-cell ranges, and the spikes they cause.
+    std::shared_ptr<gpu::lif_state> gpu_;
+    std::vector<fvm_index_type> event_offsets_;
+    std::vector<time_type> event_times_;
+    std::vector<float> event_weights_;
+    std::vector<time_type> spike_times_;
 };
 
 } // namespace arb
@@ -5,10 +5,15 @@
 #include <arbor/assert.hpp>
 
 #include <memory/memory.hpp>
+#include <util/rangeutil.hpp>
 #include <util/span.hpp>
 
 namespace arb {
 
+namespace threading {
+class task_system;
+}
+
 /// Hines matrix
 /// Make the back end state implementation optional to allow for
 /// testing different implementations in the same code.
@@ -66,11 +71,36 @@ public:
         state_.solve(to);
     }
 
+    /// Allow the back end to use the task system in solve.
+    void set_task_system(threading::task_system* ts) {
+        state_.set_task_system(ts);
+    }
+
+    /// Allow the back end to solve the cells in parallel in assemble_solve.
+    void set_parallel_cells(bool enable) {
+        state_.set_parallel_cells(enable);
+    }
+
+    /// Integrate with the Crank–Nicolson scheme in assemble_solve.
+    void set_crank_nicolson(bool enable) {
+        state_.set_crank_nicolson(enable);
+    }
+
     /// Assemble the matrix for given dt
     void assemble(const array& dt_cell, const array& voltage, const array& current, const array& conductivity) {
         state_.assemble(dt_cell, voltage, current, conductivity);
     }
 
+    /// Assemble the matrix for given dt and solve into voltage.
+    void assemble_solve(const array& dt_cell, array& voltage, const array& current, const array& conductivity) {
+        state_.assemble_solve(dt_cell, voltage, current, conductivity);
+    }
+
+    /// Size of the matrix in bytes, held by the back end.
+    std::size_t bytes() const {
+        return util::size_in_bytes(parent_index_, cell_index_, cell_to_intdom_) + state_.bytes();
+    }
+
 private:
     /// the parent indice that describe matrix structure
     iarray parent_index_;
@@ -1,4 +1,7 @@
+#include <algorithm>
+#include <cmath>
 #include <functional>
+#include <numeric>
 #include <optional>
 #include <unordered_set>
 #include <variant>
@@ -9,10 +12,12 @@
 #include <arbor/cable_cell.hpp>
 #include <arbor/sampling.hpp>
 #include <arbor/recipe.hpp>
+#include <arbor/profile/timer.hpp>
 #include <arbor/spike.hpp>
 
 #include "backends/event.hpp"
 #include "cell_group.hpp"
+#include "connection.hpp"
 #include "event_binner.hpp"
 #include "fvm_lowered_cell.hpp"
 #include "label_resolution.hpp"
@@ -22,6 +27,8 @@
 #include "util/filter.hpp"
 #include "util/maputil.hpp"
 #include "util/partition.hpp"
+#include "util/rangeutil.hpp"
+#include "util/scratch_pool.hpp"
 #include "util/range.hpp"
 #include "util/span.hpp"
 
@@ -56,6 +63,12 @@ mc_cell_group::mc_cell_group(const std::vector<cell_gid_type>& gids,
     target_handles_ = std::move(fvm_info.target_handles);
     cell_to_intdom_ = std::move(fvm_info.cell_to_intdom);
     probe_map_ = std::move(fvm_info.probe_map);
+    gap_junction_data_ = std::move(fvm_info.gap_junction_data);
+
+    // Events are collated by integration domain.
+    intdom_order_.resize(gids_.size());
+    std::iota(intdom_order_.begin(), intdom_order_.end(), 0);
+    util::stable_sort_by(intdom_order_, [&](cell_size_type i) { return cell_to_intdom_[i]; });
 
     // Create lookup structure for target ids.
     util::make_partition(target_handle_divisions_,
@@ -74,8 +87,15 @@ void mc_cell_group::reset() {
     spikes_.clear();
 
     sample_events_.clear();
-    for (auto &entry: sampler_map_) {
-        entry.second.sched.reset();
+    buffered_sample_calls_.clear();
+    n_buffered_samples_ = 0;
+    for (auto& entry: std::atomic_load(&sampler_plan_)->entries) {
+        entry->assoc.sched.reset();
+    }
+    pending_triggers_.clear();
+    {
+        std::lock_guard<std::mutex> guard(sampler_mex_);
+        external_triggers_.clear();
     }
 
     for (auto& b: binners_) {
@@ -85,27 +105,58 @@ void mc_cell_group::reset() {
     lowered_->reset();
 }
 
+void mc_cell_group::serialize(io::serializer& out) const {
+    for (const auto& b: binners_) {
+        b.serialize(out);
+    }
+    lowered_->serialize(out);
+}
+
+void mc_cell_group::deserialize(io::deserializer& in, time_type) {
+    spikes_.clear();
+
+    sample_events_.clear();
+    buffered_sample_calls_.clear();
+    n_buffered_samples_ = 0;
+
+    for (auto& b: binners_) {
+        b.deserialize(in);
+    }
+    lowered_->deserialize(in);
+}
+
 void mc_cell_group::set_binning_policy(binning_kind policy, time_type bin_interval) {
     binners_.clear();
     binners_.resize(gids_.size(), event_binner(policy, bin_interval));
+    lowered_->set_spike_binning_policy(policy, bin_interval);
 }
 
-// Probe-type specific sample data marshalling.
-
-struct sampler_call_info {
-    sampler_function sampler;
-    cell_member_type probe_id;
-    probe_tag tag;
-    unsigned index;
-    const fvm_probe_data* pdata_ptr;
+void mc_cell_group::set_connections(const std::vector<connection>& connections) {
+    std::vector<target_connection> targets;
+    targets.reserve(connections.size());
+    for (const auto& c: connections) {
+        auto h = target_handles_[target_handle_divisions_[c.index_on_domain()]+c.destination()];
+        targets.push_back({c.source(), h, c.weight(), float(c.delay())});
+    }
+    lowered_->set_spike_connections(std::move(targets));
+}
 
-    // Offsets are into lowered cell sample time and event arrays.
-    sample_size_type begin_offset;
-    sample_size_type end_offset;
-};
+std::vector<cell_member_type> mc_cell_group::remote_gap_junction_peers(const label_resolution_map& labels) {
+    auto peer_resolver = resolver(&labels);
+    std::vector<cell_member_type> peers;
+    for (const auto& p: lowered_->remote_gap_junction_peers()) {
+        peers.push_back({p.gid, peer_resolver.resolve(p)});
+    }
+    return peers;
+}
 
-// Working space for computing and collating data for samplers.
-using fvm_probe_scratch = std::tuple<std::vector<double>, std::vector<cable_sample_range>>;
+// Probe-type specific sample data marshalling.
+//
+// The samples of each sampler call are first presented as a sample_matrix:
+// for probes whose samples are the raw values of their handles, this is a
+// view onto the raw sample data of the lowered cell; otherwise the values
+// are computed into scratch space. Matrix samplers receive the matrix as is,
+// and record samplers one sample_record per row.
 
 template <typename VoidFn, typename... A>
 void tuple_foreach(VoidFn&& f, std::tuple<A...>& t) {
@@ -116,116 +167,115 @@ void reserve_scratch(fvm_probe_scratch& scratch, std::size_t n) {
     tuple_foreach([n](auto& v) { v.reserve(n); }, scratch);
 }
 
-void run_samples(
+// Scalar probes present each sample to record samplers as a double, and
+// all others as a cable_sample_range.
+template <typename P>
+constexpr bool is_scalar_probe = std::is_same_v<P, fvm_probe_scalar> || std::is_same_v<P, fvm_probe_interpolated>;
+
+// Matrix of the samples of a call with `n_raw_per_sample` raw values per
+// sample time and `width` values per sample, starting at `values`.
+sample_matrix make_sample_matrix(
+    const sampler_call_info& sc,
+    const fvm_value_type* raw_times,
+    sample_size_type n_raw_per_sample,
+    sample_size_type width,
+    const double* values,
+    sample_size_type row_stride)
+{
+    static_assert(std::is_same<double, fvm_value_type>::value, "require sample value translation");
+    static_assert(std::is_same<time_type, fvm_value_type>::value, "require sample time translation");
+
+    sample_size_type n_sample = (sc.end_offset-sc.begin_offset)/n_raw_per_sample;
+    arb_assert((sc.end_offset-sc.begin_offset)==n_sample*n_raw_per_sample);
+
+    return {std::size_t(n_sample), std::size_t(width),
+            raw_times+sc.begin_offset, std::size_t(n_raw_per_sample),
+            values, std::size_t(row_stride)};
+}
+
+sample_matrix sample_data(
     const missing_probe_info&,
     const sampler_call_info&,
     const fvm_value_type*,
     const fvm_value_type*,
-    std::vector<sample_record>&,
-    fvm_probe_scratch&)
+    std::vector<double>&)
 {
     throw arbor_internal_error("invalid fvm_probe_data in sampler map");
 }
 
-void run_samples(
-    const fvm_probe_scalar& p,
+// Scalar probes do not need scratch space.
+sample_matrix sample_data(
+    const fvm_probe_scalar&,
     const sampler_call_info& sc,
     const fvm_value_type* raw_times,
     const fvm_value_type* raw_samples,
-    std::vector<sample_record>& sample_records,
-    fvm_probe_scratch&)
+    std::vector<double>&)
 {
-    // Scalar probes do not need scratch space — provided that the user-presented
-    // sample type (double) matches the raw type (fvm_value_type).
-    static_assert(std::is_same<double, fvm_value_type>::value, "require sample value translation");
-
-    sample_size_type n_sample = sc.end_offset-sc.begin_offset;
-    sample_records.clear();
-    for (auto i = sc.begin_offset; i!=sc.end_offset; ++i) {
-       sample_records.push_back(sample_record{time_type(raw_times[i]), &raw_samples[i]});
-    }
-
-    sc.sampler({sc.probe_id, sc.tag, sc.index, p.get_metadata_ptr()}, n_sample, sample_records.data());
+    return make_sample_matrix(sc, raw_times, 1, 1, raw_samples+sc.begin_offset, 1);
 }
 
-void run_samples(
+sample_matrix sample_data(
     const fvm_probe_interpolated& p,
     const sampler_call_info& sc,
     const fvm_value_type* raw_times,
     const fvm_value_type* raw_samples,
-    std::vector<sample_record>& sample_records,
-    fvm_probe_scratch& scratch)
+    std::vector<double>& tmp)
 {
     constexpr sample_size_type n_raw_per_sample = 2;
     sample_size_type n_sample = (sc.end_offset-sc.begin_offset)/n_raw_per_sample;
-    arb_assert((sc.end_offset-sc.begin_offset)==n_sample*n_raw_per_sample);
 
-    auto& tmp = std::get<std::vector<double>>(scratch);
     tmp.clear();
-    sample_records.clear();
-
     for (sample_size_type j = 0; j<n_sample; ++j) {
         auto offset = j*n_raw_per_sample+sc.begin_offset;
         tmp.push_back(p.coef[0]*raw_samples[offset] + p.coef[1]*raw_samples[offset+1]);
     }
 
-    const auto& ctmp = tmp;
-    for (sample_size_type j = 0; j<n_sample; ++j) {
-        auto offset = j*n_raw_per_sample+sc.begin_offset;
-        sample_records.push_back(sample_record{time_type(raw_times[offset]), &ctmp[j]});
-    }
+    return make_sample_matrix(sc, raw_times, n_raw_per_sample, 1, tmp.data(), 1);
+}
 
-    sc.sampler({sc.probe_id, sc.tag, sc.index, p.get_metadata_ptr()}, n_sample, sample_records.data());
+// Samples are the raw values of each handle, unchanged.
+template <typename P>
+sample_matrix sample_data_multi(
+    const P& p,
+    const sampler_call_info& sc,
+    const fvm_value_type* raw_times,
+    const fvm_value_type* raw_samples)
+{
+    const sample_size_type n_raw_per_sample = p.raw_handles.size();
+    return make_sample_matrix(sc, raw_times, n_raw_per_sample, n_raw_per_sample, raw_samples+sc.begin_offset, n_raw_per_sample);
 }
 
-void run_samples(
+sample_matrix sample_data(
     const fvm_probe_multi& p,
     const sampler_call_info& sc,
     const fvm_value_type* raw_times,
     const fvm_value_type* raw_samples,
-    std::vector<sample_record>& sample_records,
-    fvm_probe_scratch& scratch)
+    std::vector<double>&)
 {
-    const sample_size_type n_raw_per_sample = p.raw_handles.size();
-    sample_size_type n_sample = (sc.end_offset-sc.begin_offset)/n_raw_per_sample;
-    arb_assert((sc.end_offset-sc.begin_offset)==n_sample*n_raw_per_sample);
-
-    auto& sample_ranges = std::get<std::vector<cable_sample_range>>(scratch);
-    sample_ranges.clear();
-    sample_records.clear();
-
-    for (sample_size_type j = 0; j<n_sample; ++j) {
-        auto offset = j*n_raw_per_sample+sc.begin_offset;
-        sample_ranges.push_back({raw_samples+offset, raw_samples+offset+n_raw_per_sample});
-    }
-
-    const auto& csample_ranges = sample_ranges;
-    for (sample_size_type j = 0; j<n_sample; ++j) {
-        auto offset = j*n_raw_per_sample+sc.begin_offset;
-        sample_records.push_back(sample_record{time_type(raw_times[offset]), &csample_ranges[j]});
-    }
+    return sample_data_multi(p, sc, raw_times, raw_samples);
+}
 
-    sc.sampler({sc.probe_id, sc.tag, sc.index, p.get_metadata_ptr()}, n_sample, sample_records.data());
+sample_matrix sample_data(
+    const fvm_probe_reduction& p,
+    const sampler_call_info& sc,
+    const fvm_value_type* raw_times,
+    const fvm_value_type* raw_samples,
+    std::vector<double>&)
+{
+    return sample_data_multi(p, sc, raw_times, raw_samples);
 }
 
-void run_samples(
+sample_matrix sample_data(
     const fvm_probe_weighted_multi& p,
     const sampler_call_info& sc,
     const fvm_value_type* raw_times,
     const fvm_value_type* raw_samples,
-    std::vector<sample_record>& sample_records,
-    fvm_probe_scratch& scratch)
+    std::vector<double>& tmp)
 {
     const sample_size_type n_raw_per_sample = p.raw_handles.size();
     sample_size_type n_sample = (sc.end_offset-sc.begin_offset)/n_raw_per_sample;
-    arb_assert((sc.end_offset-sc.begin_offset)==n_sample*n_raw_per_sample);
     arb_assert((unsigned)n_raw_per_sample==p.weight.size());
 
-    auto& sample_ranges = std::get<std::vector<cable_sample_range>>(scratch);
-    sample_ranges.clear();
-    sample_records.clear();
-
-    auto& tmp = std::get<std::vector<double>>(scratch);
     tmp.clear();
     tmp.reserve(n_raw_per_sample*n_sample);
 
@@ -236,41 +286,22 @@ void run_samples(
         }
     }
 
-    const double* tmp_ptr = tmp.data();
-    for (sample_size_type j = 0; j<n_sample; ++j) {
-        sample_ranges.push_back({tmp_ptr, tmp_ptr+n_raw_per_sample});
-        tmp_ptr += n_raw_per_sample;
-    }
-
-    const auto& csample_ranges = sample_ranges;
-    for (sample_size_type j = 0; j<n_sample; ++j) {
-        auto offset = j*n_raw_per_sample+sc.begin_offset;
-        sample_records.push_back(sample_record{time_type(raw_times[offset]), &csample_ranges[j]});
-    }
-
-    sc.sampler({sc.probe_id, sc.tag, sc.index, p.get_metadata_ptr()}, n_sample, sample_records.data());
+    return make_sample_matrix(sc, raw_times, n_raw_per_sample, n_raw_per_sample, tmp.data(), n_raw_per_sample);
 }
 
-void run_samples(
+sample_matrix sample_data(
     const fvm_probe_interpolated_multi& p,
     const sampler_call_info& sc,
     const fvm_value_type* raw_times,
     const fvm_value_type* raw_samples,
-    std::vector<sample_record>& sample_records,
-    fvm_probe_scratch& scratch)
+    std::vector<double>& tmp)
 {
     const sample_size_type n_raw_per_sample = p.raw_handles.size();
     const sample_size_type n_interp_per_sample = n_raw_per_sample/2;
     sample_size_type n_sample = (sc.end_offset-sc.begin_offset)/n_raw_per_sample;
-    arb_assert((sc.end_offset-sc.begin_offset)==n_sample*n_raw_per_sample);
     arb_assert((unsigned)n_interp_per_sample==p.coef[0].size());
     arb_assert((unsigned)n_interp_per_sample==p.coef[1].size());
 
-    auto& sample_ranges = std::get<std::vector<cable_sample_range>>(scratch);
-    sample_ranges.clear();
-    sample_records.clear();
-
-    auto& tmp = std::get<std::vector<double>>(scratch);
     tmp.clear();
     tmp.reserve(n_interp_per_sample*n_sample);
 
@@ -283,32 +314,18 @@ void run_samples(
         }
     }
 
-    const double* tmp_ptr = tmp.data();
-    for (sample_size_type j = 0; j<n_sample; ++j) {
-        sample_ranges.push_back({tmp_ptr, tmp_ptr+n_interp_per_sample});
-        tmp_ptr += n_interp_per_sample;
-    }
-
-    const auto& csample_ranges = sample_ranges;
-    for (sample_size_type j = 0; j<n_sample; ++j) {
-        auto offset = j*n_interp_per_sample+sc.begin_offset;
-        sample_records.push_back(sample_record{time_type(raw_times[offset]), &csample_ranges[j]});
-    }
-
-    sc.sampler({sc.probe_id, sc.tag, sc.index, p.get_metadata_ptr()}, n_sample, sample_records.data());
+    return make_sample_matrix(sc, raw_times, n_raw_per_sample, n_interp_per_sample, tmp.data(), n_interp_per_sample);
 }
 
-void run_samples(
+sample_matrix sample_data(
     const fvm_probe_membrane_currents& p,
     const sampler_call_info& sc,
     const fvm_value_type* raw_times,
     const fvm_value_type* raw_samples,
-    std::vector<sample_record>& sample_records,
-    fvm_probe_scratch& scratch)
+    std::vector<double>& tmp)
 {
     const sample_size_type n_raw_per_sample = p.raw_handles.size();
     sample_size_type n_sample = (sc.end_offset-sc.begin_offset)/n_raw_per_sample;
-    arb_assert((sc.end_offset-sc.begin_offset)==n_sample*n_raw_per_sample);
 
     const auto n_cable = p.metadata.size();
     const auto n_cv = p.cv_parent_cond.size();
@@ -316,14 +333,8 @@ void run_samples(
     const auto n_stim = p.stim_scale.size();
     arb_assert(n_stim+n_cv==(unsigned)n_raw_per_sample);
 
-    auto& sample_ranges = std::get<std::vector<cable_sample_range>>(scratch);
-    sample_ranges.clear();
-
-    auto& tmp = std::get<std::vector<double>>(scratch);
     tmp.assign(n_cable*n_sample, 0.);
 
-    sample_records.clear();
-
     for (sample_size_type j = 0; j<n_sample; ++j) {
         auto offset = j*n_raw_per_sample+sc.begin_offset;
         auto tmp_base = tmp.data()+j*n_cable;
@@ -360,16 +371,9 @@ void run_samples(
                 tmp_base[cable_i] -= cv_stim_I*p.weight[cable_i];
             }
         }
-        sample_ranges.push_back({tmp_base, tmp_base+n_cable});
-    }
-
-    const auto& csample_ranges = sample_ranges;
-    for (sample_size_type j = 0; j<n_sample; ++j) {
-        auto offset = j*n_raw_per_sample+sc.begin_offset;
-        sample_records.push_back(sample_record{time_type(raw_times[offset]), &csample_ranges[j]});
     }
 
-    sc.sampler({sc.probe_id, sc.tag, sc.index, p.get_metadata_ptr()}, n_sample, sample_records.data());
+    return make_sample_matrix(sc, raw_times, n_raw_per_sample, n_cable, tmp.data(), n_cable);
 }
 
 // Generic run_samples dispatches on probe info variant type.
@@ -380,58 +384,152 @@ void run_samples(
     std::vector<sample_record>& sample_records,
     fvm_probe_scratch& scratch)
 {
-    std::visit([&](auto& x) {run_samples(x, sc, raw_times, raw_samples, sample_records, scratch); }, sc.pdata_ptr->info);
+    std::visit([&](auto& p) {
+        using P = std::decay_t<decltype(p)>;
+
+        auto& tmp = std::get<std::vector<double>>(scratch);
+        sample_matrix m = sample_data(p, sc, raw_times, raw_samples, tmp);
+        probe_metadata meta{sc.probe_id, sc.tag, sc.index, p.get_metadata_ptr()};
+
+        const sampler_association& sa = sc.entry->assoc;
+        if (sa.matrix_sampler) {
+            sa.matrix_sampler(meta, m);
+            return;
+        }
+
+        sample_records.clear();
+        if constexpr (is_scalar_probe<P>) {
+            for (std::size_t j = 0; j<m.n_sample; ++j) {
+                sample_records.push_back(sample_record{m.time(j), m.row(j)});
+            }
+        }
+        else {
+            auto& sample_ranges = std::get<std::vector<cable_sample_range>>(scratch);
+            sample_ranges.clear();
+            for (std::size_t j = 0; j<m.n_sample; ++j) {
+                sample_ranges.push_back({m.row(j), m.row(j)+m.width});
+            }
+
+            const auto& csample_ranges = sample_ranges;
+            for (std::size_t j = 0; j<m.n_sample; ++j) {
+                sample_records.push_back(sample_record{m.time(j), &csample_ranges[j]});
+            }
+        }
+
+        sa.sampler(meta, m.n_sample, sample_records.data());
+    }, sc.pdata_ptr->info);
+}
+
+// Make the sampler calls in `call_info` with the raw sample data.
+void run_sampler_calls(
+    const std::vector<sampler_call_info>& call_info,
+    sample_size_type max_samples_per_call,
+    const fvm_value_type* raw_times,
+    const fvm_value_type* raw_samples,
+    std::vector<sample_record>& sample_records,
+    fvm_probe_scratch& scratch)
+{
+    sample_records.reserve(max_samples_per_call);
+    reserve_scratch(scratch, max_samples_per_call);
+
+    for (auto& sc: call_info) {
+        run_samples(sc, raw_times, raw_samples, sample_records, scratch);
+    }
+}
+
+// Working space of advance() and flush_samples(). It is borrowed from the
+// pool of the updating thread, and so shared by the cell groups that the
+// thread updates, rather than held by each group.
+struct mc_cell_group_scratch {
+    std::vector<deliverable_event> staged_events;
+    std::vector<std::size_t> runs;              // Runs of staged events to merge.
+    std::vector<sampler_call_info> call_info;
+    std::vector<sample_event> staged_samples;
+    std::vector<deliverable_event> exact_sampling_events;
+    std::vector<deliverable_event> merged_events;
+    std::vector<time_type> sample_times;        // Sample times of all associations.
+    std::vector<std::size_t> sample_time_divs;  // Partition of sample_times by association.
+    std::vector<time_event_span> entry_times;
+    std::vector<sample_size_type> probe_offset;
+    std::vector<sample_record> sample_records;
+    fvm_probe_scratch sample_scratch;
+};
+
+void mc_cell_group::flush_samples() {
+    if (buffered_sample_calls_.empty()) return;
+
+    PE(advance_sampledeliver);
+    sample_size_type max_samples_per_call = 0;
+    for (auto& sc: buffered_sample_calls_) {
+        max_samples_per_call = std::max(max_samples_per_call, sc.end_offset-sc.begin_offset);
+    }
+
+    auto samples = lowered_->take_samples();
+    auto scratch = util::scratch_pool<mc_cell_group_scratch>::borrow();
+    run_sampler_calls(buffered_sample_calls_, max_samples_per_call, samples.sample_time.data(), samples.sample_value.data(), scratch->sample_records, scratch->sample_scratch);
+
+    buffered_sample_calls_.clear();
+    n_buffered_samples_ = 0;
+    PL();
 }
 
 void mc_cell_group::advance(epoch ep, time_type dt, const event_lane_subrange& event_lanes) {
+    using timer = profile::timer<>;
     time_type tstart = lowered_->time();
 
     // Bin and collate deliverable events from event lanes.
 
+    tick_type tic = phase_times_? timer::tic(): 0;
     PE(advance_eventsetup);
-    staged_events_.clear();
+    auto scratch = util::scratch_pool<mc_cell_group_scratch>::borrow();
+    auto& staged_events = scratch->staged_events;
+    staged_events.clear();
 
     // Skip event handling if nothing to deliver.
     if (event_lanes.size()) {
-        std::vector<cell_size_type> idx_sorted_by_intdom(cell_to_intdom_.size());
-        std::iota(idx_sorted_by_intdom.begin(), idx_sorted_by_intdom.end(), 0);
-        util::sort_by(idx_sorted_by_intdom, [&](cell_size_type i) { return cell_to_intdom_[i]; });
+        // The events of each cell are staged in time order, with the cells of
+        // an integration domain contiguous. The runs of the cells of a domain
+        // are then merged pairwise, in log(number of cells) passes.
+        auto& runs = scratch->runs;
+        auto merge_runs = [&]() {
+            auto b = staged_events.begin();
+            while (runs.size()>2) {
+                std::size_t n = 0;
+                for (std::size_t j = 0; j+1<runs.size(); j += 2) {
+                    if (j+2<runs.size()) std::inplace_merge(b+runs[j], b+runs[j+1], b+runs[j+2]);
+                    runs[n++] = runs[j];
+                }
+                runs[n++] = runs.back();
+                runs.resize(n);
+            }
+        };
 
-        /// Event merging on integration domain could benefit from the use of the logic from `tree_merge_events`
-        fvm_index_type ev_begin = 0, ev_mid = 0, ev_end = 0;
         fvm_index_type prev_intdom = -1;
-        for (auto i: util::count_along(gids_)) {
-            unsigned count_staged = 0;
-
-            auto lid = idx_sorted_by_intdom[i];
-            auto& lane = event_lanes[lid];
-            auto curr_intdom = cell_to_intdom_[lid];
-
-            for (auto e: lane) {
-                if (e.time>=ep.t1) break;
-                e.time = binners_[lid].bin(e.time, tstart);
-                auto h = target_handles_[target_handle_divisions_[lid]+e.target];
-                auto ev = deliverable_event(e.time, h, e.weight);
-                staged_events_.push_back(ev);
-                count_staged++;
+        for (auto lid: intdom_order_) {
+            if (cell_to_intdom_[lid]!=prev_intdom) {
+                merge_runs();
+                runs.assign(1, staged_events.size());
+                prev_intdom = cell_to_intdom_[lid];
             }
 
-            ev_end += count_staged;
-
-            if (curr_intdom != prev_intdom) {
-                ev_begin = ev_end - count_staged;
-                prev_intdom = curr_intdom;
+            const auto first = staged_events.size();
+            const auto* handles = target_handles_.data()+target_handle_divisions_[lid];
+            for (const auto& e: event_lanes[lid]) {
+                if (e.time>=ep.t1) break;
+                staged_events.push_back(deliverable_event(e.time, handles[e.target], e.weight));
             }
-            else {
-                std::inplace_merge(staged_events_.begin() + ev_begin,
-                                   staged_events_.begin() + ev_mid,
-                                   staged_events_.begin() + ev_end);
+            if (staged_events.size()>first) {
+                binners_[lid].bin(staged_events.data()+first, staged_events.data()+staged_events.size(), tstart);
+                runs.push_back(staged_events.size());
             }
-
-            ev_mid = ev_end;
         }
+        merge_runs();
     }
     PL();
+    if (phase_times_) {
+        phase_times_->event_setup += timer::toc(tic);
+        tic = timer::tic();
+    }
 
     // Create sample events and delivery information.
     //
@@ -447,56 +545,157 @@ void mc_cell_group::advance(epoch ep, time_type dt, const event_lane_subrange& e
     // same probe for this callback in this association.
 
     PE(advance_samplesetup);
-    std::vector<sampler_call_info> call_info;
+    scratch->call_info.clear();
+    scratch->staged_samples.clear();
+    scratch->exact_sampling_events.clear();
 
-    std::vector<sample_event> sample_events;
-    sample_size_type n_samples = 0;
+    sample_size_type n_samples = n_buffered_samples_;
     sample_size_type max_samples_per_call = 0;
 
-    std::vector<deliverable_event> exact_sampling_events;
+    // The sampler plan is fixed for the duration of the update; schedules
+    // are only ever advanced here, by the thread advancing the group.
+    auto plan = std::atomic_load(&sampler_plan_);
+    const auto& entries = plan->entries;
+
+    // Collect the sample times of all associations in one buffer, noting
+    // whether all associations with samples in this interval share the same
+    // times, as associations with the same regular schedule do.
+    scratch->sample_times.clear();
+    scratch->sample_time_divs.assign(1, 0);
+    for (auto& entry: entries) {
+        entry->assoc.sched.append_events(tstart, ep.t1, scratch->sample_times);
+        scratch->sample_time_divs.push_back(scratch->sample_times.size());
+    }
 
-    {
-        std::lock_guard<std::mutex> guard(sampler_mex_);
+    scratch->entry_times.clear();
+    time_event_span common_times{nullptr, nullptr};
+    bool times_shared = true;
+    for (unsigned e = 0; e<entries.size(); ++e) {
+        const auto* t = scratch->sample_times.data();
+        time_event_span times{t+scratch->sample_time_divs[e], t+scratch->sample_time_divs[e+1]};
+        scratch->entry_times.push_back(times);
+        if (times.first==times.second) continue;
+
+        if (!common_times.first) {
+            common_times = times;
+        }
+        else if (times_shared) {
+            times_shared = std::equal(common_times.first, common_times.second, times.first, times.second);
+        }
+    }
+
+    // Assign the sample offsets of each probe and sampler call.
+    scratch->probe_offset.resize(plan->probe_divs.back());
+    for (unsigned e = 0; e<entries.size(); ++e) {
+        const auto& entry = entries[e];
+        auto sample_times = util::make_range(scratch->entry_times[e]);
+        if (sample_times.empty()) {
+            continue;
+        }
 
-        for (auto& sm_entry: sampler_map_) {
-            // Ignore sampler_association_handle, just need the association itself.
-            sampler_association& sa = sm_entry.second;
+        sample_size_type n_times = sample_times.size();
+        max_samples_per_call = std::max(max_samples_per_call, n_times);
 
-            auto sample_times = util::make_range(sa.sched.events(tstart, ep.t1));
-            if (sample_times.empty()) {
-                continue;
+        for (unsigned i = 0; i<entry->probes.size(); ++i) {
+            const auto& p = entry->probes[i];
+            scratch->probe_offset[plan->probe_divs[e]+i] = n_samples;
+
+            sample_size_type n_probe_samples = n_times*p.pdata_ptr->n_raw();
+            scratch->call_info.push_back({entry, p.probe_id, p.tag, p.index, p.pdata_ptr, n_samples, n_samples+n_probe_samples});
+            n_samples += n_probe_samples;
+
+            if (entry->assoc.policy==sampling_policy::exact) {
+                for (auto t: sample_times) {
+                    target_handle h(-1, 0, p.intdom);
+                    scratch->exact_sampling_events.push_back({t, h, 0.f});
+                }
             }
+        }
+    }
+
+    // Decimating samplers sample accumulators in place of the raw handles
+    // of their probes; these are set up in the lowered cell on the first
+    // update with a new plan.
+    if (plan!=accumulator_plan_) {
+        if (!plan->accumulators.empty() || !accumulator_handles_.empty()) {
+            accumulator_handles_ = lowered_->set_accumulators(plan->accumulators);
+        }
+        accumulator_plan_ = plan;
+    }
 
-            sample_size_type n_times = sample_times.size();
-            max_samples_per_call = std::max(max_samples_per_call, n_times);
-
-            for (cell_member_type pid: sa.probe_ids) {
-                auto cell_index = gid_index_map_.at(pid.gid);
-
-                probe_tag tag = probe_map_.tag.at(pid);
-                unsigned index = 0;
-                for (const fvm_probe_data& pdata: probe_map_.data_on(pid)) {
-                    call_info.push_back({sa.sampler, pid, tag, index++, &pdata, n_samples, n_samples + n_times*pdata.n_raw()});
-                    auto intdom = cell_to_intdom_[cell_index];
-
-                    for (auto t: sample_times) {
-                        for (probe_handle h: pdata.raw_handle_range()) {
-                            sample_event ev{t, (cell_gid_type)intdom, {h, n_samples++}};
-                            sample_events.push_back(ev);
-                        }
-                        if (sa.policy==sampling_policy::exact) {
-                            target_handle h(-1, 0, intdom);
-                            exact_sampling_events.push_back({t, h, 0.f});
-                        }
-                    }
+    // Triggered samplers record every step in sample rings of the lowered
+    // cell, which hold the longest window and the steps of an update, as the
+    // triggers of an update are only known at its end. The last step of each
+    // update can be cut short, so one more step is held per update spanned.
+    if (!plan->rings.empty() || ring_plan_) {
+        const time_type span = plan->max_window+ep.duration();
+        fvm_size_type capacity = plan->rings.empty()? 0: std::ceil(span/dt)+std::ceil(span/std::max(ep.duration(), dt))+2;
+        if (plan!=ring_plan_ || capacity>ring_capacity_) {
+            lowered_->set_sample_rings(plan->rings, capacity);
+            ring_plan_ = plan->rings.empty()? nullptr: plan;
+            ring_capacity_ = capacity;
+        }
+    }
+
+    // Append the sample events of probe target `i` of entry `e` at the
+    // `k`th sample time.
+    auto stage_samples = [&](unsigned e, unsigned i, sample_size_type k) {
+        const auto& p = entries[e]->probes[i];
+        auto j = plan->probe_divs[e]+i;
+        time_type t = scratch->entry_times[e].first[k];
+        sample_size_type offset = scratch->probe_offset[j] + k*p.pdata_ptr->n_raw();
+
+        if (auto acc = plan->accumulator_begin[j]; acc>=0) {
+            for (auto n = p.pdata_ptr->n_raw(); n>0; --n) {
+                scratch->staged_samples.push_back(sample_event{t, (cell_gid_type)p.intdom, {accumulator_handles_[acc++], offset++}});
+            }
+        }
+        else {
+            for (probe_handle h: p.pdata_ptr->raw_handle_range()) {
+                scratch->staged_samples.push_back(sample_event{t, (cell_gid_type)p.intdom, {h, offset++}});
+            }
+        }
+    };
+
+    scratch->staged_samples.reserve(n_samples-n_buffered_samples_);
+    if (times_shared) {
+        // Sample events must be ordered by integration domain, and then by
+        // time, for the lowered cell: with shared sample times, they can be
+        // generated in that order directly.
+        sample_size_type n_times = common_times.second-common_times.first;
+        const auto& order = plan->by_intdom;
+        auto intdom_of = [&](std::size_t j) { return entries[order[j].first]->probes[order[j].second].intdom; };
+
+        for (std::size_t j = 0; j<order.size();) {
+            std::size_t j_end = j+1;
+            while (j_end<order.size() && intdom_of(j_end)==intdom_of(j)) ++j_end;
+
+            for (sample_size_type k = 0; k<n_times; ++k) {
+                for (std::size_t l = j; l<j_end; ++l) {
+                    auto [e, i] = order[l];
+                    if (scratch->entry_times[e].first!=scratch->entry_times[e].second) stage_samples(e, i, k);
+                }
+            }
+            j = j_end;
+        }
+    }
+    else {
+        for (unsigned e = 0; e<entries.size(); ++e) {
+            sample_size_type n_times = scratch->entry_times[e].second-scratch->entry_times[e].first;
+            for (unsigned i = 0; i<entries[e]->probes.size(); ++i) {
+                for (sample_size_type k = 0; k<n_times; ++k) {
+                    stage_samples(e, i, k);
                 }
             }
-            arb_assert(n_samples==call_info.back().end_offset);
         }
+
+        util::sort_by(scratch->staged_samples, [](const sample_event& ev) { return event_time(ev); });
+        util::stable_sort_by(scratch->staged_samples, [](const sample_event& ev) { return event_index(ev); });
     }
+    arb_assert(scratch->staged_samples.size()==std::size_t(n_samples-n_buffered_samples_));
 
     // Sort exact sampling events into staged events for delivery.
-    if (exact_sampling_events.size()) {
+    if (scratch->exact_sampling_events.size()) {
         auto event_less =
             [](const auto& a, const auto& b) {
                  auto ai = event_index(a);
@@ -504,40 +703,44 @@ void mc_cell_group::advance(epoch ep, time_type dt, const event_lane_subrange& e
                  return ai<bi || (ai==bi && event_time(a)<event_time(b));
             };
 
-        util::sort(exact_sampling_events, event_less);
+        util::sort(scratch->exact_sampling_events, event_less);
 
-        std::vector<deliverable_event> merged;
-        merged.reserve(staged_events_.size()+exact_sampling_events.size());
+        scratch->merged_events.clear();
+        scratch->merged_events.reserve(staged_events.size()+scratch->exact_sampling_events.size());
 
-        std::merge(staged_events_.begin(), staged_events_.end(),
-                   exact_sampling_events.begin(), exact_sampling_events.end(),
-                   std::back_inserter(merged), event_less);
-        std::swap(merged, staged_events_);
+        std::merge(staged_events.begin(), staged_events.end(),
+                   scratch->exact_sampling_events.begin(), scratch->exact_sampling_events.end(),
+                   std::back_inserter(scratch->merged_events), event_less);
+        std::swap(scratch->merged_events, staged_events);
     }
-
-    // Sample events must be ordered by time for the lowered cell.
-    util::sort_by(sample_events, [](const sample_event& ev) { return event_time(ev); });
-    util::stable_sort_by(sample_events, [](const sample_event& ev) { return event_index(ev); });
     PL();
+    if (phase_times_) phase_times_->sampling += timer::toc(tic);
 
     // Run integration and collect samples, spikes.
-    auto result = lowered_->integrate(ep.t1, dt, staged_events_, std::move(sample_events));
+    auto result = lowered_->integrate(ep.t1, dt, staged_events, scratch->staged_samples);
+    if (phase_times_) tic = timer::tic();
 
     // For each sampler callback registered in `call_info`, construct the
     // vector of sample entries from the lowered cell sample times and values
     // and then call the callback.
 
-    PE(advance_sampledeliver);
-    std::vector<sample_record> sample_records;
-    sample_records.reserve(max_samples_per_call);
-
-    fvm_probe_scratch scratch;
-    reserve_scratch(scratch, max_samples_per_call);
-
-    for (auto& sc: call_info) {
-        run_samples(sc, result.sample_time.data(), result.sample_value.data(), sample_records, scratch);
+    //
+    // If the lowered cell retains samples, the calls are instead made once
+    // enough samples have accumulated, or at the end of the run.
+
+    if (sample_size_type buffer_size = lowered_->sample_buffer_size()) {
+        util::append(buffered_sample_calls_, scratch->call_info);
+        n_buffered_samples_ = n_samples;
+        if (n_buffered_samples_>=buffer_size) {
+            flush_samples();
+        }
     }
-    PL();
+    else {
+        PE(advance_sampledeliver);
+        run_sampler_calls(scratch->call_info, max_samples_per_call, result.sample_time.data(), result.sample_value.data(), scratch->sample_records, scratch->sample_scratch);
+        PL();
+    }
+    if (phase_times_) phase_times_->sampling += timer::toc(tic);
 
     // Copy out spike voltage threshold crossings from the back end, then
     // generate spikes with global spike source ids. The threshold crossings
@@ -547,30 +750,197 @@ void mc_cell_group::advance(epoch ep, time_type dt, const event_lane_subrange& e
     for (auto c: result.crossings) {
         spikes_.push_back({spike_sources_[c.index], time_type(c.time)});
     }
+
+    // Spikes trigger the probes of triggered samplers on their cells.
+    if (ring_plan_) {
+        if (phase_times_) tic = timer::tic();
+        PE(advance_sampledeliver);
+        for (auto c: result.crossings) {
+            auto gid = spike_sources_[c.index].gid;
+            for (const auto& entry: entries) {
+                if (!entry->assoc.window) continue;
+                for (unsigned i = 0; i<entry->probes.size(); ++i) {
+                    if (entry->probes[i].probe_id.gid==gid) pending_triggers_.push_back({entry, i, c.time});
+                }
+            }
+        }
+        run_triggered_samplers(*plan, ep.t1, scratch->sample_records, scratch->sample_scratch);
+        PL();
+        if (phase_times_) phase_times_->sampling += timer::toc(tic);
+    }
+}
+
+void mc_cell_group::run_triggered_samplers(const sampler_plan& plan, time_type t_end, std::vector<sample_record>& sample_records, fvm_probe_scratch& scratch) {
+    {
+        std::lock_guard<std::mutex> guard(sampler_mex_);
+        for (auto [h, t]: external_triggers_) {
+            for (const auto& entry: plan.entries) {
+                if (entry->handle!=h || !entry->assoc.window) continue;
+                for (unsigned i = 0; i<entry->probes.size(); ++i) {
+                    pending_triggers_.push_back({entry, i, t});
+                }
+            }
+        }
+        external_triggers_.clear();
+    }
+
+    // Windows are complete once their last step has started. The values of
+    // a probe with several raw handles are read from one ring per handle,
+    // and interleaved as the lowered cell samples them.
+    std::vector<fvm_value_type> times, values, raw_times, raw_values;
+    std::size_t n_kept = 0;
+    for (auto& pt: pending_triggers_) {
+        auto e = std::find(plan.entries.begin(), plan.entries.end(), pt.entry)-plan.entries.begin();
+        if (e==(std::ptrdiff_t)plan.entries.size()) continue;
+
+        const auto& window = *pt.entry->assoc.window;
+        if (pt.time+window.post>=t_end) {
+            pending_triggers_[n_kept++] = std::move(pt);
+            continue;
+        }
+
+        const auto& p = pt.entry->probes[pt.probe];
+        const sample_size_type n_raw = p.pdata_ptr->n_raw();
+        const int ring = plan.ring_begin[plan.probe_divs[e]+pt.probe];
+        raw_times.clear();
+        raw_values.clear();
+        for (sample_size_type h = 0; h<n_raw; ++h) {
+            times.clear();
+            values.clear();
+            lowered_->read_sample_ring(ring+h, pt.time-window.pre, pt.time+window.post, times, values);
+            if (h==0) {
+                raw_times.assign(times.size()*n_raw, 0);
+                raw_values.assign(times.size()*n_raw, 0);
+            }
+            for (std::size_t k = 0; k<times.size() && (k+1)*n_raw<=raw_times.size(); ++k) {
+                raw_times[k*n_raw+h] = times[k];
+                raw_values[k*n_raw+h] = values[k];
+            }
+        }
+        if (raw_values.empty()) continue;
+
+        sample_size_type n = raw_values.size();
+        sampler_call_info sc{pt.entry, p.probe_id, p.tag, p.index, p.pdata_ptr, 0, n};
+        sample_records.reserve(n);
+        reserve_scratch(scratch, n);
+        run_samples(sc, raw_times.data(), raw_values.data(), sample_records, scratch);
+    }
+    pending_triggers_.resize(n_kept);
 }
 
 void mc_cell_group::add_sampler(sampler_association_handle h, cell_member_predicate probe_ids,
                                 schedule sched, sampler_function fn, sampling_policy policy)
 {
+    add_sampler_association(h, probe_ids, sampler_association{std::move(sched), std::move(fn), {}, {}, policy});
+}
+
+void mc_cell_group::add_matrix_sampler(sampler_association_handle h, cell_member_predicate probe_ids,
+                                       schedule sched, matrix_sampler_function fn, sampling_policy policy)
+{
+    add_sampler_association(h, probe_ids, sampler_association{std::move(sched), {}, std::move(fn), {}, policy});
+}
+
+void mc_cell_group::add_triggered_sampler(sampler_association_handle h, cell_member_predicate probe_ids,
+                                          sampling_window window, sampler_function fn)
+{
+    add_sampler_association(h, probe_ids, sampler_association{schedule(), std::move(fn), {}, {}, sampling_policy::lax, window});
+}
+
+void mc_cell_group::trigger_sampler(sampler_association_handle h, time_type t) {
+    std::lock_guard<std::mutex> guard(sampler_mex_);
+    if (util::any_of(sampler_plan_->entries, [h](const auto& e) { return e->handle==h && e->assoc.window; })) {
+        external_triggers_.push_back({h, t});
+    }
+}
+
+// Resolve the probes of the association once, here, rather than on each
+// call to advance().
+void mc_cell_group::add_sampler_association(sampler_association_handle h, const cell_member_predicate& probe_ids, sampler_association sa) {
     std::lock_guard<std::mutex> guard(sampler_mex_);
 
     std::vector<cell_member_type> probeset =
         util::assign_from(util::filter(util::keys(probe_map_.tag), probe_ids));
-
-    if (!probeset.empty()) {
-        auto result = sampler_map_.insert({h, sampler_association{std::move(sched), std::move(fn), std::move(probeset), policy}});
-        arb_assert(result.second);
+    if (probeset.empty()) return;
+
+    auto entry = std::make_shared<sampler_plan_entry>();
+    entry->handle = h;
+    for (cell_member_type pid: probeset) {
+        auto intdom = cell_to_intdom_[gid_index_map_.at(pid.gid)];
+        probe_tag tag = probe_map_.tag.at(pid);
+        unsigned index = 0;
+        for (const fvm_probe_data& pdata: probe_map_.data_on(pid)) {
+            entry->probes.push_back({pid, tag, index++, &pdata, intdom});
+        }
     }
+    entry->assoc = std::move(sa);
+    entry->assoc.probe_ids = std::move(probeset);
+
+    auto entries = sampler_plan_->entries;
+    arb_assert(!util::any_of(entries, [h](const auto& e) { return e->handle==h; }));
+
+    entries.push_back(std::move(entry));
+    publish_sampler_plan(std::move(entries));
 }
 
 void mc_cell_group::remove_sampler(sampler_association_handle h) {
     std::lock_guard<std::mutex> guard(sampler_mex_);
-    sampler_map_.erase(h);
+
+    std::vector<std::shared_ptr<sampler_plan_entry>> entries;
+    for (const auto& e: sampler_plan_->entries) {
+        if (e->handle!=h) entries.push_back(e);
+    }
+    publish_sampler_plan(std::move(entries));
 }
 
 void mc_cell_group::remove_all_samplers() {
     std::lock_guard<std::mutex> guard(sampler_mex_);
-    sampler_map_.clear();
+    publish_sampler_plan({});
+}
+
+// Requires sampler_mex_ to be held.
+void mc_cell_group::publish_sampler_plan(std::vector<std::shared_ptr<sampler_plan_entry>> entries) {
+    auto plan = std::make_shared<sampler_plan>();
+    plan->entries = std::move(entries);
+
+    for (unsigned e = 0; e<plan->entries.size(); ++e) {
+        const auto& entry = plan->entries[e];
+        const auto& probes = entry->probes;
+        auto op = entry->assoc.policy;
+        bool decimating = op!=sampling_policy::lax && op!=sampling_policy::exact;
+        bool triggered = entry->assoc.window.has_value();
+        if (triggered) {
+            plan->max_window = std::max(plan->max_window, entry->assoc.window->pre+entry->assoc.window->post);
+        }
+
+        plan->probe_divs.push_back(plan->probe_divs.back()+probes.size());
+        for (unsigned i = 0; i<probes.size(); ++i) {
+            plan->by_intdom.push_back({e, i});
+
+            if (decimating) {
+                plan->accumulator_begin.push_back(plan->accumulators.size());
+                for (probe_handle h: probes[i].pdata_ptr->raw_handle_range()) {
+                    plan->accumulators.push_back({h, probes[i].intdom, op});
+                }
+            }
+            else {
+                plan->accumulator_begin.push_back(-1);
+            }
+
+            if (triggered) {
+                plan->ring_begin.push_back(plan->rings.size());
+                for (probe_handle h: probes[i].pdata_ptr->raw_handle_range()) {
+                    plan->rings.push_back({h, probes[i].intdom});
+                }
+            }
+            else {
+                plan->ring_begin.push_back(-1);
+            }
+        }
+    }
+    util::stable_sort_by(plan->by_intdom,
+        [&](const auto& ei) { return plan->entries[ei.first]->probes[ei.second].intdom; });
+
+    std::atomic_store(&sampler_plan_, std::shared_ptr<const sampler_plan>(std::move(plan)));
 }
 
 std::vector<probe_metadata> mc_cell_group::get_probe_metadata(cell_member_type probe_id) const {
@@ -592,4 +962,17 @@ std::vector<probe_metadata> mc_cell_group::get_probe_metadata(cell_member_type p
 
     return result;
 }
+
+memory_use mc_cell_group::state_memory() const {
+    memory_use m = lowered_->state_memory();
+    m.host += util::size_in_bytes(gids_, cell_to_intdom_, spike_sources_, spikes_, binners_,
+                                  target_handles_, target_handle_divisions_);
+    return m;
+}
+
+memory_use mc_cell_group::sample_memory() const {
+    memory_use m = lowered_->sample_memory();
+    m.host += util::size_in_bytes(buffered_sample_calls_, accumulator_handles_);
+    return m;
+}
 } // namespace arb
@@ -3,17 +3,23 @@
 #include <cstdint>
 #include <functional>
 #include <iterator>
+#include <memory>
 #include <mutex>
+#include <tuple>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include <arbor/cable_cell.hpp>
 #include <arbor/common_types.hpp>
 #include <arbor/recipe.hpp>
 #include <arbor/sampling.hpp>
+#include <arbor/schedule.hpp>
 #include <arbor/spike.hpp>
 
 #include "backends/event.hpp"
 #include "cell_group.hpp"
+#include "connection.hpp"
 #include "epoch.hpp"
 #include "event_binner.hpp"
 #include "event_queue.hpp"
@@ -23,6 +29,68 @@
 
 namespace arb {
 
+// A sampler association resolved against the probes of the group: for
+// each sampled probe, its data and integration domain.
+struct sampler_plan_entry {
+    struct probe_target {
+        cell_member_type probe_id;
+        probe_tag tag;
+        unsigned index;
+        const fvm_probe_data* pdata_ptr;
+        fvm_index_type intdom;
+    };
+
+    sampler_association_handle handle;
+    sampler_association assoc;
+    std::vector<probe_target> probes;
+};
+
+// The sampler associations of a group. A plan is never modified once
+// published: adding or removing a sampler publishes a new plan, which
+// shares the entries of the old one.
+struct sampler_plan {
+    std::vector<std::shared_ptr<sampler_plan_entry>> entries;
+
+    // The probe targets of all entries are numbered consecutively, entry by
+    // entry, and partitioned by entry by `probe_divs`.
+    std::vector<unsigned> probe_divs = {0};
+
+    // The probe targets as (entry, probe) indices, ordered by integration
+    // domain, so that sample events can be generated in the order required
+    // by the lowered cell.
+    std::vector<std::pair<unsigned, unsigned>> by_intdom;
+
+    // Accumulators in the lowered cell for the raw values of probe targets
+    // of entries with a decimating sampling policy: those of probe target j
+    // start at accumulator_begin[j], which is -1 if j is sampled directly.
+    std::vector<fvm_accumulator> accumulators;
+    std::vector<int> accumulator_begin;
+
+    // Sample rings in the lowered cell for the raw values of probe targets
+    // of triggered entries: those of probe target j start at ring_begin[j],
+    // which is -1 if j is not triggered. The rings must hold the steps of
+    // the longest window, of max_window ms.
+    std::vector<fvm_sample_ring> rings;
+    std::vector<int> ring_begin;
+    time_type max_window = 0;
+};
+
+// Working space for computing and collating data for samplers.
+using fvm_probe_scratch = std::tuple<std::vector<double>, std::vector<cable_sample_range>>;
+
+// The samples of one probe for one call of a sampler callback.
+struct sampler_call_info {
+    std::shared_ptr<const sampler_plan_entry> entry;
+    cell_member_type probe_id;
+    probe_tag tag;
+    unsigned index;
+    const fvm_probe_data* pdata_ptr;
+
+    // Offsets are into lowered cell sample time and event arrays.
+    sample_size_type begin_offset;
+    sample_size_type end_offset;
+};
+
 class mc_cell_group: public cell_group {
 public:
     mc_cell_group() = default;
@@ -39,8 +107,15 @@ public:
 
     void reset() override;
 
+    void serialize(io::serializer& out) const override;
+    void deserialize(io::deserializer& in, time_type t) override;
+
     void set_binning_policy(binning_kind policy, time_type bin_interval) override;
 
+    void set_event_delivery(event_delivery_kind kind) override {
+        lowered_->set_event_delivery(kind);
+    }
+
     void advance(epoch ep, time_type dt, const event_lane_subrange& event_lanes) override;
 
     const std::vector<spike>& spikes() const override {
@@ -51,22 +126,69 @@ public:
         spikes_.clear();
     }
 
+    bool delivers_spikes() const override {
+        return lowered_->delivers_spikes();
+    }
+
+    void set_connections(const std::vector<connection>& connections) override;
+
+    void enqueue_spikes(std::shared_ptr<const std::vector<spike>> spikes) override {
+        lowered_->enqueue_spikes(std::move(spikes));
+    }
+
+    cell_labels_and_gids gap_junction_labels() const override {
+        return {gap_junction_data_, gids_};
+    }
+
+    std::vector<cell_member_type> remote_gap_junction_peers(const label_resolution_map& labels) override;
+
+    void set_published_gap_junction_sites(const std::vector<cell_member_type>& sites) override {
+        lowered_->set_published_gap_junction_sites(sites);
+    }
+
+    void published_gap_junction_voltages(std::vector<double>& out) const override {
+        lowered_->published_gap_junction_voltages(out);
+    }
+
+    void set_remote_gap_junction_voltages(const std::vector<double>& v) override {
+        lowered_->set_remote_gap_junction_voltages(v);
+    }
+
+    void flush_samples() override;
+
     void add_sampler(sampler_association_handle h, cell_member_predicate probe_ids,
                      schedule sched, sampler_function fn, sampling_policy policy) override;
 
+    void add_matrix_sampler(sampler_association_handle h, cell_member_predicate probe_ids,
+                            schedule sched, matrix_sampler_function fn, sampling_policy policy) override;
+
+    void add_triggered_sampler(sampler_association_handle h, cell_member_predicate probe_ids,
+                               sampling_window window, sampler_function fn) override;
+
+    void trigger_sampler(sampler_association_handle h, time_type t) override;
+
     void remove_sampler(sampler_association_handle h) override;
 
     void remove_all_samplers() override;
 
     std::vector<probe_metadata> get_probe_metadata(cell_member_type probe_id) const override;
 
+    memory_use state_memory() const override;
+    memory_use sample_memory() const override;
+
 private:
     // List of the gids of the cells in the group.
     std::vector<cell_gid_type> gids_;
 
+    // Labels of the gap junction sites of the cells.
+    cell_label_range gap_junction_data_;
+
     // Map from gid to integration domain id
     std::vector<fvm_index_type> cell_to_intdom_;
 
+    // Local cell indices ordered by integration domain.
+    std::vector<cell_size_type> intdom_order_;
+
     // Hash table for converting gid to local index
     std::unordered_map<cell_gid_type, cell_gid_type> gid_index_map_;
 
@@ -82,24 +204,56 @@ private:
     // Event time binning manager.
     std::vector<event_binner> binners_;
 
-    // List of events to deliver
-    std::vector<deliverable_event> staged_events_;
-
     // Pending samples to be taken.
     event_queue<sample_event> sample_events_;
 
+    // Sampler calls for samples that the lowered cell retains, and the
+    // number of raw samples retained; see fvm_lowered_cell::take_samples().
+    std::vector<sampler_call_info> buffered_sample_calls_;
+    sample_size_type n_buffered_samples_ = 0;
+
     // Handles for accessing lowered cell.
     std::vector<target_handle> target_handles_;
 
     // Maps probe ids to probe handles (from lowered cell) and tags (from probe descriptions).
     probe_association_map probe_map_;
 
-    // Collection of samplers to be run against probes in this group.
-    sampler_association_map sampler_map_;
+    // Samplers to be run against probes in this group. The plan is read by
+    // advance() without locking, and replaced atomically by modifications.
+    std::shared_ptr<const sampler_plan> sampler_plan_ = std::make_shared<const sampler_plan>();
 
-    // Mutex for thread-safe access to sampler associations.
+    // Mutex serializing modifications of the sampler plan.
     std::mutex sampler_mex_;
 
+    void add_sampler_association(sampler_association_handle h, const cell_member_predicate& probe_ids, sampler_association sa);
+    void publish_sampler_plan(std::vector<std::shared_ptr<sampler_plan_entry>> entries);
+
+    // The plan for which the accumulators of the lowered cell were last
+    // set, and the handles of those accumulators.
+    std::shared_ptr<const sampler_plan> accumulator_plan_;
+    std::vector<probe_handle> accumulator_handles_;
+
+    // The plan for which the sample rings of the lowered cell were last set,
+    // and their capacity in steps.
+    std::shared_ptr<const sampler_plan> ring_plan_;
+    fvm_size_type ring_capacity_ = 0;
+
+    // Triggers of triggered samplers whose windows have not yet passed: the
+    // entry, the probe target within the entry, and the trigger time.
+    struct pending_trigger {
+        std::shared_ptr<const sampler_plan_entry> entry;
+        unsigned probe;
+        time_type time;
+    };
+    std::vector<pending_trigger> pending_triggers_;
+
+    // Triggers given by trigger_sampler(), guarded by sampler_mex_.
+    std::vector<std::pair<sampler_association_handle, time_type>> external_triggers_;
+
+    // Collect the triggers of the last advance(), and call the samplers of
+    // the windows that end before t_end.
+    void run_triggered_samplers(const sampler_plan& plan, time_type t_end, std::vector<sample_record>& sample_records, fvm_probe_scratch& scratch);
+
     // Lookup table for target ids -> local target handle indices.
     std::vector<std::size_t> target_handle_divisions_;
 };
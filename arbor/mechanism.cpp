@@ -0,0 +1,41 @@
+#include <arbor/mechanism.hpp>
+#include <arbor/profile/profiler.hpp>
+#include <arbor/profile/timer.hpp>
+
+namespace arb {
+
+using timer_type = profile::timer<>;
+
+static const char* method_names[] = {"init", "current", "events", "state", "ions", "post"};
+
+void mechanism::call(method_index m, arb_mechanism_method f) {
+    if (!profile::profiler_mechanism_timing()) {
+        f(&ppack_);
+        return;
+    }
+    auto start = timer_type::tic();
+    f(&ppack_);
+    auto time = timer_type::toc(start);
+
+    if (timing_ids_[m]==npos) {
+        timing_ids_[m] = profile::profiler_mechanism_region_id(mech_.name, method_names[m]);
+    }
+    profile::profiler_record_mechanism(timing_ids_[m], time, ppack_.width);
+}
+
+void mechanism::call(arb_mechanism_method_events f, arb_deliverable_event_stream& stream) {
+    if (!profile::profiler_mechanism_timing()) {
+        f(&ppack_, &stream);
+        return;
+    }
+    auto start = timer_type::tic();
+    f(&ppack_, &stream);
+    auto time = timer_type::toc(start);
+
+    if (timing_ids_[method_events]==npos) {
+        timing_ids_[method_events] = profile::profiler_mechanism_region_id(mech_.name, method_names[method_events]);
+    }
+    profile::profiler_record_mechanism(timing_ids_[method_events], time, ppack_.width);
+}
+
+} // namespace arb
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstdlib>
 #include <map>
 #include <memory>
@@ -60,6 +61,13 @@
  * the top-most (least-derived) ancestor and working down to the requested derived
  * mechanism.
  *
+ * 4. bundles_
+ *
+ *    Fused compute_currents implementations over several mechanisms, as
+ *    registered with register_bundle(). Member names are kept in step with
+ *    the catalogue: they are prefixed on import, and a bundle is dropped when
+ *    any of its members is removed.
+ *
  * The private implementation class catalogue_state does not throw any (catalogue
  * related) exceptions, but instead propagates errors via util::expected to the
  * mechanism_catalogue methods for handling.
@@ -153,6 +161,11 @@ struct catalogue_state {
             auto key = prefix + name_impls.first;
             impl_map_[key] = std::move(impls);
         }
+
+        for (const auto& b: other.bundles_) {
+            auto& entry = bundles_.emplace_back(b);
+            for (auto& m: entry.members) m = prefix + m;
+        }
     }
 
     // Check for presence of mechanism or derived mechanism.
@@ -190,11 +203,26 @@ struct catalogue_state {
         }
     }
 
-    // Remove mechanism and its derivations and implementations.
+    // Register fused kernel over defined mechanisms.
+    hopefully<void> register_bundle(const arb_mechanism_bundle_interface& iface) {
+        mechanism_catalogue::bundle_entry entry{{}, iface};
+        for (auto i: util::make_span(iface.n_members)) {
+            std::string name = iface.members[i];
+            if (!defined(name)) {
+                return unexpected_exception_ptr(no_such_mechanism(name));
+            }
+            entry.members.push_back(std::move(name));
+        }
+        bundles_.push_back(std::move(entry));
+        return {};
+    }
+
+    // Remove mechanism and its derivations, implementations and bundles.
     void remove(const std::string& name) {
         derived_map_.erase(name);
         info_map_.erase(name);
         impl_map_.erase(name);
+        drop_bundles(name);
 
         // Erase any dangling derivation map entries.
         std::size_t n_delete;
@@ -207,6 +235,7 @@ struct catalogue_state {
                 }
                 else {
                     impl_map_.erase(it->first);
+                    drop_bundles(it->first);
                     derived_map_.erase(it++);
                     ++n_delete;
                 }
@@ -214,6 +243,11 @@ struct catalogue_state {
         } while (n_delete>0);
     }
 
+    void drop_bundles(const std::string& name) {
+        auto names = [&](const auto& b) { return std::find(b.members.begin(), b.members.end(), name)!=b.members.end(); };
+        bundles_.erase(std::remove_if(bundles_.begin(), bundles_.end(), names), bundles_.end());
+    }
+
     // Retrieve mechanism info for mechanism, derived mechanism, or implicitly
     // derived mechanism.
     hopefully<mechanism_info> info(const std::string& name) const {
@@ -503,6 +537,9 @@ struct catalogue_state {
 
     // Prototype register, keyed on mechanism name, then backend type (index).
     string_map<std::unordered_map<arb_backend_kind, mechanism_ptr>> impl_map_;
+
+    // Fused current kernels over co-located mechanisms.
+    std::vector<mechanism_catalogue::bundle_entry> bundles_;
 };
 
 // Mechanism catalogue method implementations.
@@ -576,6 +613,18 @@ void mechanism_catalogue::register_impl(arb_backend_kind kind, const std::string
     value(state_->register_impl(kind, name, std::move(mech)));
 }
 
+void mechanism_catalogue::register_bundle(const arb_mechanism_bundle_interface& iface) {
+    value(state_->register_bundle(iface));
+}
+
+std::vector<mechanism_catalogue::bundle_entry> mechanism_catalogue::bundles(arb_backend_kind kind) const {
+    std::vector<bundle_entry> result;
+    for (const auto& b: state_->bundles_) {
+        if (b.iface.backend==kind) result.push_back(b);
+    }
+    return result;
+}
+
 std::pair<mechanism_ptr, mechanism_overrides> mechanism_catalogue::instance_impl(arb_backend_kind kind, const std::string& name) const {
     return {value(state_->implementation(kind, name)), value(state_->overrides(name))};
 }
@@ -29,6 +29,9 @@ mechanism_info::mechanism_info(const arb_mechanism_type& m) {
         v.verify_valence,
         v.expected_valence };
     }
+    for (auto idx: util::make_span(m.n_random_variables)) {
+        random_variables.push_back(m.random_variables[idx].name);
+    }
 }
 
 }
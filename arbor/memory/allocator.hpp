@@ -144,6 +144,32 @@ namespace impl {
                 return 128;
 #else
                 return 256;
+#endif
+            }
+            static constexpr bool is_malloc_compatible() {
+                return true;
+            }
+        };
+
+        // Managed (unified) memory is addressable from host and device, and
+        // pages are migrated on demand. It suits buffers that are written on
+        // the host and read once by a kernel, avoiding an explicit copy.
+        class managed_policy {
+        public:
+            void *allocate_policy(size_type size) {
+                return gpu_malloc_managed(size);
+            }
+
+            void free_policy(void *ptr) {
+                gpu_free(ptr);
+            }
+
+            // managed allocations have the same alignment as device allocations
+            static constexpr size_type alignment() {
+#ifdef ARB_HIP
+                return 128;
+#else
+                return 256;
 #endif
             }
             static constexpr bool is_malloc_compatible() {
@@ -244,6 +270,13 @@ namespace util {
         }
     };
 
+    template <>
+    struct type_printer<impl::gpu::managed_policy>{
+        static std::string print() {
+            return std::string("managed_policy");
+        }
+    };
+
     template <typename T, typename Policy>
     struct type_printer<allocator<T,Policy>>{
         static std::string print() {
@@ -270,5 +303,8 @@ using pinned_allocator = allocator<T, impl::gpu::pinned_policy<alignment>>;
 template <class T, size_t alignment=256>
 using gpu_allocator = allocator<T, impl::gpu::device_policy>;
 
+template <class T>
+using managed_allocator = allocator<T, impl::gpu::managed_policy>;
+
 } // namespace memory
 } // namespace arb
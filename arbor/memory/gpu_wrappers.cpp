@@ -18,27 +18,51 @@ namespace memory {
 using std::to_string;
 using namespace gpu;
  
+// Copies are issued on the calling thread's current stream, so that they are
+// ordered with respect to the kernels launched by that thread without
+// synchronizing the whole device. Copies to the host, whose result is read
+// immediately, wait for the stream. Copies from pageable host memory are
+// staged before returning; a pinned source must be kept alive until the
+// stream has been synchronized.
+
 void gpu_memcpy_d2d(void* dest, const void* src, std::size_t n) {
-    auto status = device_memcpy(dest, src, n, gpuMemcpyDeviceToDevice);
+    auto status = device_memcpy_async(dest, src, n, gpuMemcpyDeviceToDevice, current_stream());
     if (!status) {
         HANDLE_GPU_ERROR(status, "n="+to_string(n));
     }
 }
 
 void gpu_memcpy_d2h(void* dest, const void* src, std::size_t n) {
-    auto status = device_memcpy(dest, src, n, gpuMemcpyDeviceToHost);
+    auto status = device_memcpy_async(dest, src, n, gpuMemcpyDeviceToHost, current_stream());
+    if (status) {
+        status = stream_synchronize(current_stream());
+    }
     if (!status) {
         HANDLE_GPU_ERROR(status, "n="+to_string(n));
     }
 }
 
 void gpu_memcpy_h2d(void* dest, const void* src, std::size_t n) {
-    auto status = device_memcpy(dest, src, n, gpuMemcpyHostToDevice);
+    auto status = device_memcpy_async(dest, src, n, gpuMemcpyHostToDevice, current_stream());
+    if (!status) {
+        HANDLE_GPU_ERROR(status, "n="+to_string(n));
+    }
+}
+
+void gpu_memcpy_d2h_async(void* dest, const void* src, std::size_t n) {
+    auto status = device_memcpy_async(dest, src, n, gpuMemcpyDeviceToHost, current_stream());
     if (!status) {
         HANDLE_GPU_ERROR(status, "n="+to_string(n));
     }
 }
 
+void gpu_synchronize_stream() {
+    auto status = stream_synchronize(current_stream());
+    if (!status) {
+        HANDLE_GPU_ERROR(status, "");
+    }
+}
+
 void* gpu_host_register(void* ptr, std::size_t size) {
     auto status = host_register(ptr, size, gpuHostRegisterPortable);
     if (!status) {
@@ -61,6 +85,16 @@ void* gpu_malloc(std::size_t n) {
     return ptr;
 }
 
+void* gpu_malloc_managed(std::size_t n) {
+    void* ptr;
+
+    auto status = device_malloc_managed(&ptr, n);
+    if (!status) {
+        HANDLE_GPU_ERROR(status, "unable to allocate "+to_string(n)+" bytes of managed memory");
+    }
+    return ptr;
+}
+
 void gpu_free(void* ptr) {
     auto status = device_free(ptr);
     if (!status) {
@@ -91,6 +125,14 @@ void gpu_memcpy_h2d(void* dest, const void* src, std::size_t n) {
     NOGPU;
 }
 
+void gpu_memcpy_d2h_async(void* dest, const void* src, std::size_t n) {
+    NOGPU;
+}
+
+void gpu_synchronize_stream() {
+    NOGPU;
+}
+
 void* gpu_host_register(void* ptr, std::size_t size) {
     NOGPU;
     return 0;
@@ -105,6 +147,11 @@ void* gpu_malloc(std::size_t n) {
     return 0;
 }
 
+void* gpu_malloc_managed(std::size_t n) {
+    NOGPU;
+    return 0;
+}
+
 void gpu_free(void* ptr) {
     NOGPU;
 }
@@ -6,9 +6,16 @@ namespace memory {
 void gpu_memcpy_d2d(void* dest, const void* src, std::size_t n);
 void gpu_memcpy_d2h(void* dest, const void* src, std::size_t n);
 void gpu_memcpy_h2d(void* dest, const void* src, std::size_t n);
+// Copy to pinned host memory without waiting; the copy is complete once
+// the current stream has been synchronized.
+void gpu_memcpy_d2h_async(void* dest, const void* src, std::size_t n);
+void gpu_synchronize_stream();
 void* gpu_host_register(void* ptr, std::size_t size);
 void gpu_host_unregister(void* ptr);
 void* gpu_malloc(std::size_t n);
+// Allocate memory that is addressable from both host and device, and is
+// migrated on demand; it is released with gpu_free().
+void* gpu_malloc_managed(std::size_t n);
 void gpu_free(void* ptr);
 
 } // namespace memory
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <vector>
 
 #include "array.hpp"
 #include "definitions.hpp"
@@ -35,6 +36,20 @@ using pinned_vector = array<T, host_coordinator<T, pinned_allocator<T>>>;
 template <typename T>
 using pinned_view = array_view<T, host_coordinator<T, pinned_allocator<T>>>;
 
+// Page locked std::vector, for host buffers that are refilled and copied to
+// the device every epoch: copies from it are asynchronous, so it must not be
+// modified or reallocated until the stream has caught up with the copy.
+template <typename T>
+using staging_vector = std::vector<T, pinned_allocator<T>>;
+
+// specialization for managed vectors. Managed memory is addressable from
+// both the host and device, so the host_coordinator is used, as for pinned
+// vectors; the data pointer may be passed directly to kernels.
+template <typename T>
+using managed_vector = array<T, host_coordinator<T, managed_allocator<T>>>;
+template <typename T>
+using managed_view = array_view<T, host_coordinator<T, managed_allocator<T>>>;
+
 // specialization for device memory
 template <typename T>
 using device_vector = array<T, device_coordinator<T, gpu_allocator<T>>>;
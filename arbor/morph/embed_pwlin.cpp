@@ -48,26 +48,37 @@ double interpolate(const branch_pw_ratpoly<p, q>& f, unsigned bid, double pos) {
 // Integration wrt a piecewise constant function is performed by taking the difference between
 // interpolated values at the end points of each constant interval.
 
+template <unsigned p, unsigned q>
+double integrate(const branch_pw_ratpoly<p, q>& f, mcable c) {
+    return interpolate(f, c.branch, c.dist_pos)-interpolate(f, c.branch, c.prox_pos);
+}
+
+// The intervals of g are contiguous, so the value at the upper end of one
+// interval is reused as the value at the lower end of the next.
+
 template <unsigned p, unsigned q>
 double integrate(const branch_pw_ratpoly<p, q>& f, unsigned bid, const pw_constant_fn& g) {
+    if (g.empty()) return 0;
+
     double accum = 0;
+    double lower = interpolate(f, bid, g.bounds().first);
     for (msize_t i = 0; i<g.size(); ++i) {
-        std::pair<double, double> interval = g.interval(i);
-        accum += g.element(i)*(interpolate(f, bid, interval.second)-interpolate(f, bid, interval.first));
+        double upper = interpolate(f, bid, g.interval(i).second);
+        accum += g.element(i)*(upper-lower);
+        lower = upper;
     }
     return accum;
 }
 
-// Performance note: when integrating over a cable within a branch, the code effectively
-// performs a linear search for the starting interval. This can be replaced with a binary
-// search for a small increase in code complexity.
+// The first interval of g that meets the cable is found by binary search.
 
 template <unsigned p, unsigned q>
 double integrate(const branch_pw_ratpoly<p, q>& f, mcable c, const pw_constant_fn& g) {
     msize_t bid = c.branch;
     double accum = 0;
 
-    for (msize_t i = 0; i<g.size(); ++i) {
+    msize_t first = g.equal_range(c.prox_pos).first-g.begin();
+    for (msize_t i = first; i<g.size(); ++i) {
         std::pair<double, double> interval = g.interval(i);
 
         if (interval.second<c.prox_pos) {
@@ -159,15 +170,35 @@ double embed_pwlin::integrate_area(mlocation proximal, mlocation distal) const {
 // Integrate over cable:
 
 double embed_pwlin::integrate_length(mcable c) const {
-    return integrate_length(c.branch, pw_constant_fn{{c.prox_pos, c.dist_pos}, {1.}});
+    return integrate(data_->length, c);
 }
 
 double embed_pwlin::integrate_area(mcable c) const {
-    return integrate_area(c.branch, pw_constant_fn{{c.prox_pos, c.dist_pos}, {1.}});
+    return integrate(data_->area, c);
 }
 
 double embed_pwlin::integrate_ixa(mcable c) const {
-    return integrate_ixa(c.branch, pw_constant_fn{{c.prox_pos, c.dist_pos}, {1.}});
+    return integrate(data_->ixa, c);
+}
+
+// Integrate over cable list:
+
+double embed_pwlin::integrate_length(const mcable_list& cs) const {
+    double accum = 0;
+    for (const auto& c: cs) accum += integrate(data_->length, c);
+    return accum;
+}
+
+double embed_pwlin::integrate_area(const mcable_list& cs) const {
+    double accum = 0;
+    for (const auto& c: cs) accum += integrate(data_->area, c);
+    return accum;
+}
+
+double embed_pwlin::integrate_ixa(const mcable_list& cs) const {
+    double accum = 0;
+    for (const auto& c: cs) accum += integrate(data_->ixa, c);
+    return accum;
 }
 
 // Integrate piecewise function over a branch:
@@ -231,11 +262,23 @@ embed_pwlin::embed_pwlin(const arb::morphology& m) {
 
     double proj_shift = m.branch_segments(0).front().prox.z;
 
+    std::size_t n_segment = 0;
+    for (msize_t bid = 0; bid<n_branch; ++bid) {
+        n_segment += m.branch_segments(bid).size();
+    }
+    all_segment_ends_.reserve(n_segment+n_branch);
+    segment_cables_.resize(n_segment);
+
     for (msize_t bid = 0; bid<n_branch; ++bid) {
         unsigned parent = m.branch_parent(bid);
         auto& segments = m.branch_segments(bid);
         arb_assert(segments.size());
 
+        data_->directed_projection[bid].reserve(segments.size());
+        data_->radius[bid].reserve(segments.size());
+        data_->area[bid].reserve(segments.size());
+        data_->ixa[bid].reserve(segments.size());
+
         std::vector<double> seg_pos;
         seg_pos.reserve(segments.size()+1);
         seg_pos.push_back(0.);
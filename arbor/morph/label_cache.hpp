@@ -0,0 +1,58 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <arbor/morph/morphology.hpp>
+#include <arbor/morph/primitives.hpp>
+
+namespace arb {
+
+// Concrete regions and locsets evaluated on a morphology against one label
+// dictionary, keyed by the text of their expressions.
+//
+// Evaluation is deterministic, random locsets included, so the result of an
+// expression can be shared by every cell built on the same morphology with the
+// same labels. Expressions are evaluated outside the lock; if two threads
+// evaluate the same expression, the first result inserted is kept.
+struct label_evaluation {
+    template <typename T>
+    struct table {
+        std::mutex mutex;
+        std::unordered_map<std::string, T> values;
+
+        template <typename Eval>
+        T get(const std::string& key, Eval&& eval) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto it = values.find(key);
+                if (it!=values.end()) return it->second;
+            }
+            T value = eval();
+            std::lock_guard<std::mutex> lock(mutex);
+            return values.emplace(key, std::move(value)).first->second;
+        }
+    };
+
+    table<mextent> regions;
+    table<mlocation_list> locsets;
+};
+
+// The evaluations on a morphology, one per label dictionary, keyed by the
+// text of the dictionary. Held by the morphology implementation, and so shared
+// by all copies of the morphology.
+struct morphology_label_cache {
+    std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<label_evaluation>> entries;
+
+    std::shared_ptr<label_evaluation> get(const std::string& labels) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& p = entries[labels];
+        if (!p) p = std::make_shared<label_evaluation>();
+        return p;
+    }
+};
+
+} // namespace arb
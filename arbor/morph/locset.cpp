@@ -416,7 +416,7 @@ locset uniform(arb::region reg, unsigned left, unsigned right, uint64_t seed) {
 mlocation_list thingify_(const uniform_& u, const mprovider& p) {
     mlocation_list L;
     auto morpho = p.morphology();
-    auto embed = p.embedding();
+    const auto& embed = p.embedding();
 
     // Thingify the region and store relevant data
     mextent reg_extent = thingify(u.reg, p);
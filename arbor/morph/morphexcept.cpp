@@ -44,6 +44,12 @@ invalid_segment_parent::invalid_segment_parent(msize_t parent, msize_t tree_size
     tree_size(tree_size)
 {}
 
+segment_array_size_mismatch::segment_array_size_mismatch(msize_t expected, msize_t size):
+    morphology_error(pprintf("segment array of size {} does not match the {} segment parents", size, expected)),
+    expected(expected),
+    size(size)
+{}
+
 duplicate_stitch_id::duplicate_stitch_id(const std::string& id):
     morphology_error(pprintf("duplicate stitch id {}", id)),
     id(id)
@@ -1,15 +1,19 @@
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <stack>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
 
+#include <arbor/morph/embed_pwlin.hpp>
 #include <arbor/morph/morphexcept.hpp>
 #include <arbor/morph/morphology.hpp>
 #include <arbor/morph/segment_tree.hpp>
 #include <arbor/morph/primitives.hpp>
 
 #include "io/sepval.hpp"
+#include "morph/label_cache.hpp"
 #include "util/mergeview.hpp"
 #include "util/rangeutil.hpp"
 #include "util/span.hpp"
@@ -47,11 +51,20 @@ auto branches_from_segment_tree(const segment_tree& tree) {
         }
     }
 
+    // Size each branch up front, so that each is allocated once.
+    std::vector<msize_t> branch_sizes(nbranches);
+    for (auto b: bids) {
+        ++branch_sizes[b];
+    }
+
     // A working vector used to track whether the first segment in a branch has been visited.
     std::vector<char> visited(nbranches);
 
     branch_segs.resize(nbranches);
     branch_parents.resize(nbranches);
+    for (auto b: make_span(nbranches)) {
+        branch_segs[b].reserve(branch_sizes[b]);
+    }
     // Construct all of the cable segments for all of the branches.
     for (auto i: make_span(nsegs)) {
         auto p = seg_parents[i];
@@ -81,6 +94,13 @@ struct morphology_impl {
     std::vector<msize_t> terminal_branches_;
     std::vector<std::vector<msize_t>> branch_children_;
 
+    // Embedding, built on first use.
+    mutable std::once_flag embedding_flag_;
+    mutable std::unique_ptr<const embed_pwlin> embedding_;
+
+    // Evaluated regions and locsets, by label dictionary.
+    mutable morphology_label_cache label_cache_;
+
     morphology_impl(const segment_tree& m);
 
     void init();
@@ -173,6 +193,16 @@ msize_t morphology::num_branches() const {
     return impl_->branches_.size();
 }
 
+const embed_pwlin& morphology::embedding() const {
+    std::call_once(impl_->embedding_flag_,
+        [this] { impl_->embedding_ = std::make_unique<const embed_pwlin>(*this); });
+    return *impl_->embedding_;
+}
+
+morphology_label_cache& morphology::label_cache() const {
+    return impl_->label_cache_;
+}
+
 std::ostream& operator<<(std::ostream& o, const morphology& m) {
     return o << *m.impl_;
 }
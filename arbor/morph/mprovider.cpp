@@ -1,5 +1,9 @@
+#include <algorithm>
+#include <limits>
+#include <sstream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <arbor/morph/label_dict.hpp>
 #include <arbor/morph/locset.hpp>
@@ -9,8 +13,49 @@
 #include <arbor/morph/region.hpp>
 #include <arbor/util/expected.hpp>
 
+#include "morph/label_cache.hpp"
+
 namespace arb {
 
+// Expressions are identified by their text, written with enough digits to
+// distinguish any two locations or distances.
+template <typename X>
+static std::string expression_key(const char* def, const std::string& name, const X& x) {
+    std::stringstream s;
+    s.precision(std::numeric_limits<double>::max_digits10);
+    if (def) s << "(" << def << " \"" << name << "\" ";
+    s << x;
+    if (def) s << ")";
+    return s.str();
+}
+
+// The text of the definitions in a label dictionary, in order of label name,
+// which identifies the dictionary for sharing evaluations.
+static std::string label_dict_key(const label_dict* dict) {
+    if (!dict) return {};
+
+    std::vector<std::string> defs;
+    for (const auto& [name, reg]: dict->regions()) {
+        defs.push_back(expression_key("region-def", name, reg));
+    }
+    for (const auto& [name, ls]: dict->locsets()) {
+        defs.push_back(expression_key("locset-def", name, ls));
+    }
+    std::sort(defs.begin(), defs.end());
+
+    std::string key;
+    for (const auto& d: defs) key += d;
+    return key;
+}
+
+mprovider::mprovider(arb::morphology m, const label_dict* ldptr):
+    morphology_(m),
+    shared_(morphology_.label_cache().get(label_dict_key(ldptr))),
+    label_dict_ptr(ldptr)
+{
+    init();
+}
+
 void mprovider::init() {
     // Evaluate each named region or locset in provided dictionary
     // to populate concrete regions_, locsets_ maps.
@@ -48,7 +93,7 @@ static const auto& try_lookup(const mprovider& provider, const std::string& name
                 throw unbound_name(name);
             }
 
-            return (map[name] = thingify(it->second, provider)).value();
+            return (map[name] = provider.evaluate(it->second)).value();
         }
         else {
             throw unbound_name(name);
@@ -72,5 +117,12 @@ const mlocation_list& mprovider::locset(const std::string& name) const {
     return try_lookup(*this, name, locsets_, locsets_ptr);
 }
 
+mextent mprovider::evaluate(const arb::region& r) const {
+    return shared_->regions.get(expression_key(nullptr, {}, r), [&] { return thingify(r, *this); });
+}
+
+mlocation_list mprovider::evaluate(const arb::locset& l) const {
+    return shared_->locsets.get(expression_key(nullptr, {}, l), [&] { return thingify(l, *this); });
+}
 
 } // namespace arb
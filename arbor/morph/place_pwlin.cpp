@@ -1,5 +1,9 @@
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include <arbor/morph/morphology.hpp>
@@ -169,4 +173,258 @@ place_pwlin::place_pwlin(const arb::morphology& m, const isometry& iso) {
     }
 };
 
+// Closest point to (x, y, z) on the axis of a segment: the proportion of
+// the way along the segment, and the squared distance.
+static std::pair<double, double> closest_on_axis(const mpoint& a, const mpoint& b, double x, double y, double z) {
+    double dx = b.x-a.x, dy = b.y-a.y, dz = b.z-a.z;
+    double px = x-a.x, py = y-a.y, pz = z-a.z;
+
+    double len2 = dx*dx+dy*dy+dz*dz;
+    double t = len2>0? std::clamp((px*dx+py*dy+pz*dz)/len2, 0., 1.): 0.;
+
+    double ex = px-t*dx, ey = py-t*dy, ez = pz-t*dz;
+    return {t, ex*ex+ey*ey+ez*ez};
+}
+
+std::pair<mlocation, double> place_pwlin::closest(double x, double y, double z) const {
+    mlocation loc{mnpos, 0};
+    double best = std::numeric_limits<double>::infinity();
+
+    for (msize_t bid = 0; bid<data_->segment_index.size(); ++bid) {
+        for (auto [bounds, index]: data_->segment_index[bid]) {
+            const msegment& seg = data_->segments[index];
+            auto [t, d2] = closest_on_axis(seg.prox, seg.dist, x, y, z);
+            if (d2<best) {
+                best = d2;
+                loc = {bid, bounds.first+t*(bounds.second-bounds.first)};
+            }
+        }
+    }
+    return {loc, std::sqrt(best)};
+}
+
+// Spatial index implementation.
+
+struct spatial_index_data {
+    // A segment of a placement, with the cell and the part of the branch it covers.
+    struct entry {
+        mpoint prox, dist;
+        std::size_t cell;
+        msize_t branch;
+        double pos0, pos1;
+
+        spatial_hit hit(double t, double d2) const {
+            return {cell, {branch, pos0+t*(pos1-pos0)}, std::sqrt(d2)};
+        }
+    };
+
+    struct box {
+        double lo[3] = {INFINITY, INFINITY, INFINITY};
+        double hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+
+        void add(const mpoint& p) {
+            const double x[3] = {p.x, p.y, p.z};
+            for (int i = 0; i<3; ++i) {
+                lo[i] = std::min(lo[i], x[i]);
+                hi[i] = std::max(hi[i], x[i]);
+            }
+        }
+
+        // Squared distance from a point; zero inside the box.
+        double distance2(const double (&x)[3]) const {
+            double d2 = 0;
+            for (int i = 0; i<3; ++i) {
+                double d = std::max({lo[i]-x[i], 0., x[i]-hi[i]});
+                d2 += d*d;
+            }
+            return d2;
+        }
+    };
+
+    // Leaf nodes hold the entries [first, last); inner nodes have children
+    // at indices first and last.
+    struct node {
+        box bounds;
+        std::uint32_t first, last;
+        bool leaf;
+    };
+
+    static constexpr std::size_t leaf_size = 4;
+
+    std::vector<entry> entries;
+    std::vector<node> nodes;
+
+    explicit spatial_index_data(std::vector<entry> es): entries(std::move(es)) {
+        if (!entries.empty()) {
+            nodes.reserve(2*entries.size()/leaf_size+1);
+            build(0, entries.size());
+        }
+    }
+
+    // Split entries in the middle, by the centre of their bounds along the
+    // longest axis of the centres.
+    std::uint32_t build(std::size_t first, std::size_t last) {
+        node n;
+        box centres;
+        for (auto i = first; i<last; ++i) {
+            n.bounds.add(entries[i].prox);
+            n.bounds.add(entries[i].dist);
+            centres.add(centre(entries[i]));
+        }
+
+        std::uint32_t index = nodes.size();
+        nodes.push_back(n);
+
+        if (last-first<=leaf_size) {
+            nodes[index].first = first;
+            nodes[index].last = last;
+            nodes[index].leaf = true;
+            return index;
+        }
+
+        int axis = 0;
+        for (int i = 1; i<3; ++i) {
+            if (centres.hi[i]-centres.lo[i]>centres.hi[axis]-centres.lo[axis]) axis = i;
+        }
+        auto key = [axis](const entry& e) {
+            auto c = centre(e);
+            return axis==0? c.x: axis==1? c.y: c.z;
+        };
+
+        auto mid = first+(last-first)/2;
+        std::nth_element(entries.begin()+first, entries.begin()+mid, entries.begin()+last,
+            [&](const entry& a, const entry& b) { return key(a)<key(b); });
+
+        auto left = build(first, mid);
+        auto right = build(mid, last);
+        nodes[index].first = left;
+        nodes[index].last = right;
+        nodes[index].leaf = false;
+        return index;
+    }
+
+    static mpoint centre(const entry& e) {
+        return {(e.prox.x+e.dist.x)/2, (e.prox.y+e.dist.y)/2, (e.prox.z+e.dist.z)/2, 0};
+    }
+
+    spatial_hit closest(double x, double y, double z) const {
+        const double p[3] = {x, y, z};
+        spatial_hit best{0, {mnpos, 0}, INFINITY};
+        double best2 = INFINITY;
+        if (nodes.empty()) return best;
+
+        std::vector<std::uint32_t> stack = {0};
+        while (!stack.empty()) {
+            const node& n = nodes[stack.back()];
+            stack.pop_back();
+            if (n.bounds.distance2(p)>=best2) continue;
+
+            if (n.leaf) {
+                for (auto i = n.first; i<n.last; ++i) {
+                    auto [t, d2] = closest_on_axis(entries[i].prox, entries[i].dist, x, y, z);
+                    if (d2<best2) {
+                        best2 = d2;
+                        best = entries[i].hit(t, d2);
+                    }
+                }
+            }
+            else {
+                // Visit the nearer child first.
+                auto a = n.first, b = n.last;
+                if (nodes[a].bounds.distance2(p)<nodes[b].bounds.distance2(p)) std::swap(a, b);
+                stack.push_back(a);
+                stack.push_back(b);
+            }
+        }
+        return best;
+    }
+
+    void within(double x, double y, double z, double r, std::vector<spatial_hit>& hits) const {
+        const double p[3] = {x, y, z};
+        const double r2 = r*r;
+        if (nodes.empty()) return;
+
+        std::vector<std::uint32_t> stack = {0};
+        while (!stack.empty()) {
+            const node& n = nodes[stack.back()];
+            stack.pop_back();
+            if (n.bounds.distance2(p)>r2) continue;
+
+            if (n.leaf) {
+                for (auto i = n.first; i<n.last; ++i) {
+                    auto [t, d2] = closest_on_axis(entries[i].prox, entries[i].dist, x, y, z);
+                    if (d2<=r2) hits.push_back(entries[i].hit(t, d2));
+                }
+            }
+            else {
+                stack.push_back(n.first);
+                stack.push_back(n.last);
+            }
+        }
+    }
+};
+
+static void append_entries(std::vector<spatial_index_data::entry>& entries, const place_pwlin_data& data, std::size_t cell) {
+    for (msize_t bid = 0; bid<data.segment_index.size(); ++bid) {
+        for (auto [bounds, index]: data.segment_index[bid]) {
+            const msegment& seg = data.segments[index];
+            entries.push_back({seg.prox, seg.dist, cell, bid, bounds.first, bounds.second});
+        }
+    }
+}
+
+spatial_index::spatial_index():
+    data_(std::make_shared<const spatial_index_data>(std::vector<spatial_index_data::entry>{}))
+{}
+
+spatial_index::spatial_index(const place_pwlin& p) {
+    std::vector<spatial_index_data::entry> entries;
+    entries.reserve(p.data_->segments.size());
+    append_entries(entries, *p.data_, 0);
+    data_ = std::make_shared<const spatial_index_data>(std::move(entries));
+}
+
+spatial_index::spatial_index(const std::vector<place_pwlin>& ps) {
+    std::size_t n = 0;
+    for (const auto& p: ps) n += p.data_->segments.size();
+
+    std::vector<spatial_index_data::entry> entries;
+    entries.reserve(n);
+    for (auto i: util::count_along(ps)) {
+        append_entries(entries, *ps[i].data_, i);
+    }
+    data_ = std::make_shared<const spatial_index_data>(std::move(entries));
+}
+
+std::size_t spatial_index::size() const {
+    return data_->entries.size();
+}
+
+spatial_hit spatial_index::closest(double x, double y, double z) const {
+    return data_->closest(x, y, z);
+}
+
+std::vector<spatial_hit> spatial_index::closest(const std::vector<mpoint>& points) const {
+    std::vector<spatial_hit> result;
+    result.reserve(points.size());
+    for (const auto& p: points) {
+        result.push_back(data_->closest(p.x, p.y, p.z));
+    }
+    return result;
+}
+
+std::vector<spatial_hit> spatial_index::within(double x, double y, double z, double r) const {
+    std::vector<spatial_hit> hits;
+    data_->within(x, y, z, r, hits);
+    return hits;
+}
+
+std::vector<std::vector<spatial_hit>> spatial_index::within(const std::vector<mpoint>& points, double r) const {
+    std::vector<std::vector<spatial_hit>> result(points.size());
+    for (auto i: util::count_along(points)) {
+        data_->within(points[i].x, points[i].y, points[i].z, r, result[i]);
+    }
+    return result;
+}
+
 } // namespace arb
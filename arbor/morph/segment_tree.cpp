@@ -18,6 +18,32 @@ void segment_tree::reserve(msize_t n) {
     seg_children_.reserve(n);
 }
 
+segment_tree::segment_tree(std::vector<msize_t> parents,
+                           const std::vector<mpoint>& prox,
+                           const std::vector<mpoint>& dist,
+                           const std::vector<int>& tags):
+    parents_(std::move(parents))
+{
+    const msize_t n = parents_.size();
+    for (auto size: {prox.size(), dist.size(), tags.size()}) {
+        if (size!=n) throw segment_array_size_mismatch(n, size);
+    }
+
+    seg_children_.assign(n, child_prop{0});
+    for (msize_t i=0; i<n; ++i) {
+        auto p = parents_[i];
+        if (p!=mnpos) {
+            if (p>=i) throw invalid_segment_parent(p, i);
+            seg_children_[p].increment();
+        }
+    }
+
+    segments_.reserve(n);
+    for (msize_t i=0; i<n; ++i) {
+        segments_.push_back(msegment{i, prox[i], dist[i], tags[i]});
+    }
+}
+
 msize_t segment_tree::append(msize_t p, const mpoint& prox, const mpoint& dist, int tag) {
     if (p>=size() && p!=mnpos) {
         throw invalid_segment_parent(p, size());
@@ -138,10 +138,19 @@ struct stitched_morphology_impl {
         auto iter = bimpl.forest.preorder_begin();
         auto end = bimpl.forest.preorder_end();
 
+        // Segments are numbered in preorder, so that parents precede children
+        // and the tree can be built in one pass over the collected arrays.
+        std::vector<msize_t> parents;
+        std::vector<mpoint> prox, dist;
+        std::vector<int> tags;
         for (; iter!=end; ++iter) {
-            msize_t seg_parent_id = iter.parent()? iter.parent()->seg_id: mnpos;
-            iter->seg_id = stree.append(seg_parent_id, iter->prox, iter->dist, iter->tag);
+            iter->seg_id = parents.size();
+            parents.push_back(iter.parent()? iter.parent()->seg_id: mnpos);
+            prox.push_back(iter->prox);
+            dist.push_back(iter->dist);
+            tags.push_back(iter->tag);
         }
+        stree = segment_tree(std::move(parents), prox, dist, tags);
 
         for (const auto& id_node: bimpl.id_to_node) {
             const std::string& id = id_node.first;
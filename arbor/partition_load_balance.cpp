@@ -1,9 +1,13 @@
+#include <algorithm>
+#include <map>
 #include <queue>
+#include <stdexcept>
+#include <tuple>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 #include <arbor/arbexcept.hpp>
+#include <arbor/cable_cell_param.hpp>
 #include <arbor/domain_decomposition.hpp>
 #include <arbor/load_balance.hpp>
 #include <arbor/recipe.hpp>
@@ -15,33 +19,172 @@
 #include "gpu_context.hpp"
 #include "util/maputil.hpp"
 #include "util/partition.hpp"
+#include "util/rangeutil.hpp"
 #include "util/span.hpp"
 #include "util/strprintf.hpp"
 
 namespace arb {
 
+// Disjoint sets of gids, where the representative of each set is its
+// smallest gid.
+struct gid_union_find {
+    std::unordered_map<cell_gid_type, cell_gid_type> parent;
+
+    cell_gid_type find(cell_gid_type gid) {
+        parent.emplace(gid, gid);
+        // Path halving.
+        while (parent[gid]!=gid) {
+            auto& p = parent[gid];
+            p = parent[p];
+            gid = p;
+        }
+        return gid;
+    }
+
+    void unite(cell_gid_type a, cell_gid_type b) {
+        a = find(a);
+        b = find(b);
+        if (a<b) parent[b] = a;
+        else if (b<a) parent[a] = b;
+    }
+};
+
+// Linear deterministic greedy partition of the cells over num_domains domains
+// (Stanton and Kliot, 2012), returning the domain of each gid.
+//
+// Cells are visited once in gid order. Each is placed in the domain holding
+// the most of its presynaptic cells that have already been placed, weighted
+// by the remaining capacity of the domain; cells without placed presynaptic
+// cells go to the least loaded domain. Cells connected by gap junctions are
+// placed together. Domain loads are measured by cell_cost, and no domain is
+// filled beyond capacity unless all are.
+//
+// The partition depends only on the recipe, so every domain computes the
+// same one without communication.
+template <typename Cost>
+static std::vector<unsigned> partition_by_connectivity(const recipe& rec, unsigned num_domains, Cost&& cell_cost) {
+    constexpr unsigned unassigned = -1;
+    const cell_size_type num_cells = rec.num_cells();
+
+    double total_cost = 0;
+    for (auto gid: util::make_span(num_cells)) {
+        total_cost += cell_cost(gid);
+    }
+    // Allow for some imbalance, so that connected cells need not be split
+    // only to equalize the load.
+    const double capacity = 1.05*total_cost/num_domains;
+
+    std::vector<unsigned> domain(num_cells, unassigned);
+    std::vector<double> load(num_domains, 0.);
+    std::vector<double> neighbours(num_domains, 0.);
+
+    std::vector<cell_gid_type> unit;
+    std::queue<cell_gid_type> q;
+    for (auto gid: util::make_span(num_cells)) {
+        if (domain[gid]!=unassigned) continue;
+
+        // The cells to place together: gid, and any cells connected to it
+        // by gap junctions. They are marked as visited with num_domains.
+        unit.clear();
+        domain[gid] = num_domains;
+        q.push(gid);
+        while (!q.empty()) {
+            auto element = q.front();
+            q.pop();
+            unit.push_back(element);
+            for (const auto& c: rec.gap_junctions_on(element)) {
+                auto peer = c.peer.gid;
+                if (peer>=num_cells) {
+                    throw bad_connection_source_gid(element, peer, num_cells);
+                }
+                if (domain[peer]==unassigned) {
+                    domain[peer] = num_domains;
+                    q.push(peer);
+                }
+            }
+        }
+
+        double unit_cost = 0;
+        std::fill(neighbours.begin(), neighbours.end(), 0.);
+        for (auto member: unit) {
+            unit_cost += cell_cost(member);
+            for (const auto& c: rec.connections_on(member)) {
+                auto src = c.source.gid;
+                if (src<num_cells && domain[src]<num_domains) {
+                    neighbours[domain[src]] += 1;
+                }
+            }
+        }
+
+        // Best scoring domain with room for the cells, ties going to the
+        // least loaded; if none has room, the least loaded domain.
+        unsigned best = 0;
+        double best_score = -1;
+        bool best_fits = false;
+        for (unsigned d = 0; d<num_domains; ++d) {
+            bool fits = load[d]+unit_cost<=capacity;
+            double score = neighbours[d]*std::max(0., 1.-load[d]/capacity);
+            bool better =
+                fits!=best_fits? fits:
+                !fits? load[d]<load[best]:
+                score!=best_score? score>best_score:
+                load[d]<load[best];
+            if (d==0 || better) {
+                best = d;
+                best_score = score;
+                best_fits = fits;
+            }
+        }
+
+        for (auto member: unit) {
+            domain[member] = best;
+        }
+        load[best] += unit_cost;
+    }
+
+    return domain;
+}
+
 domain_decomposition partition_load_balance(
     const recipe& rec,
     const context& ctx,
-    partition_hint_map hint_map)
+    partition_hint_map hint_map,
+    domain_partition_kind partition)
 {
     const bool gpu_avail = ctx->gpu->has_gpu();
+    const unsigned num_gpus = ctx->gpus.size();
 
+    // The domain of each gid, from the contiguous gid ranges held by each
+    // domain, given as the gathered bounds [first, last) of the ranges. When
+    // domains hold contiguous gids this is a table of one range per domain,
+    // rather than of one entry per cell.
     struct partition_gid_domain {
-        partition_gid_domain(const gathered_vector<cell_gid_type>& divs, unsigned domains) {
-            auto rank_part = util::partition_view(divs.partition());
+        partition_gid_domain(const gathered_vector<cell_gid_type>& bounds) {
+            auto rank_part = util::partition_view(bounds.partition());
             for (auto rank: count_along(rank_part)) {
-                for (auto gid: util::subrange_view(divs.values(), rank_part[rank])) {
-                    gid_map[gid] = rank;
+                auto r = rank_part[rank];
+                for (auto i = r.first; i<r.second; i += 2) {
+                    ranges.push_back({bounds.values()[i], bounds.values()[i+1], int(rank)});
                 }
             }
+            std::sort(ranges.begin(), ranges.end(),
+                [](const gid_range& a, const gid_range& b) { return a.first<b.first; });
         }
 
         int operator()(cell_gid_type gid) const {
-            return gid_map.at(gid);
+            auto it = std::upper_bound(ranges.begin(), ranges.end(), gid,
+                [](cell_gid_type g, const gid_range& r) { return g<r.first; });
+            if (it==ranges.begin() || gid>=(--it)->last) {
+                throw std::out_of_range(util::pprintf("gid {} is not on any domain", gid));
+            }
+            return it->domain;
         }
 
-        std::unordered_map<cell_gid_type, int> gid_map;
+        struct gid_range {
+            cell_gid_type first, last;
+            int domain;
+        };
+        std::vector<gid_range> ranges;
     };
 
     struct cell_identifier {
@@ -55,82 +198,202 @@ domain_decomposition partition_load_balance(
     unsigned domain_id = ctx->distributed->id();
     auto num_global_cells = rec.num_cells();
 
-    auto dom_size = [&](unsigned dom) -> cell_gid_type {
-        const cell_gid_type B = num_global_cells/num_domains;
-        const cell_gid_type R = num_global_cells - num_domains*B;
-        return B + (dom<R);
+    // Cell costs, if the recipe provides them; otherwise all cells have
+    // unit cost.
+    const bool has_cost = num_global_cells && rec.cell_cost(0);
+    auto cell_cost = [&](cell_gid_type gid) -> double {
+        if (!has_cost) return 1;
+        auto c = rec.cell_cost(gid);
+        if (!c || !(*c>=0)) {
+            throw arbor_exception(util::pprintf("unable to perform load balancing because gid {} has no valid cost", gid));
+        }
+        return *c;
     };
 
-    // Global load balance
+    // Global load balance: the gids of the cells on this domain, in
+    // ascending order, and a predicate for the cells on this domain.
 
+    std::vector<cell_gid_type> domain_gids;
+    std::vector<unsigned> gid_domains;
     std::vector<cell_gid_type> gid_divisions;
-    auto gid_part = make_partition(
-        gid_divisions, transform_view(make_span(num_domains), dom_size));
+    if (partition==domain_partition_kind::connectivity) {
+        gid_domains = partition_by_connectivity(rec, num_domains, cell_cost);
+        for (auto gid: make_span(num_global_cells)) {
+            if (gid_domains[gid]==domain_id) domain_gids.push_back(gid);
+        }
+    }
+    else if (!has_cost) {
+        auto dom_size = [&](unsigned dom) -> cell_gid_type {
+            const cell_gid_type B = num_global_cells/num_domains;
+            const cell_gid_type R = num_global_cells - num_domains*B;
+            return B + (dom<R);
+        };
+        make_partition(gid_divisions, transform_view(make_span(num_domains), dom_size));
+    }
+    else {
+        // Contiguous gid ranges of equal cost: domain d starts at the gid
+        // where the summed cost of all preceding cells is nearest to
+        // d/num_domains of the total. All domains compute the same division
+        // from the recipe.
+        std::vector<double> cost_prefix(num_global_cells+1, 0.);
+        for (auto gid: make_span(num_global_cells)) {
+            cost_prefix[gid+1] = cost_prefix[gid] + cell_cost(gid);
+        }
+        const double total = cost_prefix.back();
+
+        gid_divisions.push_back(0);
+        for (unsigned dom = 1; dom<num_domains; ++dom) {
+            double target = total*dom/num_domains;
+            cell_gid_type first = std::lower_bound(cost_prefix.begin(), cost_prefix.end(), target) - cost_prefix.begin();
+            if (first>0 && target-cost_prefix[first-1]<cost_prefix[first]-target) --first;
+            gid_divisions.push_back(std::max(first, gid_divisions.back()));
+        }
+        gid_divisions.push_back(num_global_cells);
+    }
+    if (!gid_divisions.empty()) {
+        auto gids = util::partition_view(gid_divisions)[domain_id];
+        domain_gids.assign(make_span(gids).begin(), make_span(gids).end());
+    }
+
+    auto on_domain = [&](cell_gid_type gid) {
+        if (!gid_domains.empty()) return gid_domains[gid]==domain_id;
+        auto gids = util::partition_view(gid_divisions)[domain_id];
+        return gid>=gids.first && gid<gids.second;
+    };
 
     // Local load balance
 
-    std::vector<std::vector<cell_gid_type>> super_cells; //cells connected by gj
+    // Cells connected by gap junctions form super cells, which are placed on
+    // the domain of their smallest gid. They are found by union-find: each
+    // domain joins only the cells of its own gap junctions, and the sets
+    // that reach other domains are merged by collective exchanges of pairs
+    // of gids, so that no domain expands the gap junctions of another.
+    // Cable cells whose gap junction sites are exchanged between groups
+    // (a positive gap_junction_interval) do not form super cells.
+    bool gj_exchanged = false;
+    if (auto props = rec.get_global_properties(cell_kind::cable); props.has_value()) {
+        if (auto p = std::any_cast<cable_cell_global_properties>(&props)) {
+            gj_exchanged = p->gap_junction_interval>0;
+        }
+    }
+
+    gid_union_find components;
+    std::vector<cell_gid_type> gj_gids; // local cells in super cells
     std::vector<cell_gid_type> reg_cells; //independent cells
+    std::vector<cell_gid_type> remote_peers;
+    for (auto gid: domain_gids) {
+        auto conns = rec.gap_junctions_on(gid);
+        if (conns.empty()) continue;
+        for (const auto& c: conns) {
+            if (c.peer.gid>=num_global_cells) {
+                throw bad_connection_source_gid(gid, c.peer.gid, num_global_cells);
+            }
+        }
+        if (gj_exchanged) continue;
+
+        gj_gids.push_back(gid);
+        for (const auto& c: conns) {
+            auto peer = c.peer.gid;
+            components.unite(gid, peer);
+            if (on_domain(peer)) gj_gids.push_back(peer);
+            else remote_peers.push_back(peer);
+        }
+    }
 
-    // Map to track visited cells (cells that already belong to a group)
-    std::unordered_set<cell_gid_type> visited;
+    // Gather the pairs (set, peer) for the peers on other domains; the
+    // owner of each peer answers with the pair (set, peer) of its own set,
+    // to which the peer is added if it has no gap junctions itself.
+    std::vector<cell_gid_type> pairs;
+    for (auto peer: remote_peers) {
+        pairs.push_back(components.find(peer));
+        pairs.push_back(peer);
+    }
+    auto remote_pairs = ctx->distributed->gather_gids(pairs);
+
+    pairs.clear();
+    const auto& gathered = remote_pairs.values();
+    for (std::size_t i = 1; i<gathered.size(); i += 2) {
+        auto peer = gathered[i];
+        if (!on_domain(peer)) continue;
+        gj_gids.push_back(peer);
+        pairs.push_back(components.find(peer));
+        pairs.push_back(peer);
+    }
+    auto owner_pairs = ctx->distributed->gather_gids(pairs);
 
-    // Connected components algorithm using BFS
-    std::queue<cell_gid_type> q;
-    for (auto gid: make_span(gid_part[domain_id])) {
-        if (!rec.gap_junctions_on(gid).empty()) {
-            // If cell hasn't been visited yet, must belong to new super_cell
-            // Perform BFS starting from that cell
-            if (!visited.count(gid)) {
-                visited.insert(gid);
-                std::vector<cell_gid_type> cg;
-                q.push(gid);
-                while (!q.empty()) {
-                    auto element = q.front();
-                    q.pop();
-                    cg.push_back(element);
-                    // Adjacency list
-                    auto conns = rec.gap_junctions_on(element);
-                    for (auto c: conns) {
-                        if (!visited.count(c.peer.gid)) {
-                            visited.insert(c.peer.gid);
-                            q.push(c.peer.gid);
-                        }
-                    }
-                }
-                super_cells.push_back(cg);
-            }
+    for (const auto* v: {&remote_pairs.values(), &owner_pairs.values()}) {
+        for (std::size_t i = 0; i+1<v->size(); i += 2) {
+            components.unite((*v)[i], (*v)[i+1]);
+        }
+    }
+
+    // Each set is now labelled by the smallest gid of its super cell. Send
+    // the local members of super cells placed on other domains to them.
+    std::sort(gj_gids.begin(), gj_gids.end());
+    gj_gids.erase(std::unique(gj_gids.begin(), gj_gids.end()), gj_gids.end());
+
+    std::map<cell_gid_type, std::vector<cell_gid_type>> super_cell_members;
+    pairs.clear();
+    for (auto gid: gj_gids) {
+        auto label = components.find(gid);
+        if (on_domain(label)) {
+            super_cell_members[label].push_back(gid);
         }
         else {
-            // If cell has no gap_junctions, put in separate group of independent cells
+            pairs.push_back(label);
+            pairs.push_back(gid);
+        }
+    }
+    auto member_pairs = ctx->distributed->gather_gids(pairs);
+    const auto& members = member_pairs.values();
+    for (std::size_t i = 0; i+1<members.size(); i += 2) {
+        if (on_domain(members[i])) {
+            super_cell_members[members[i]].push_back(members[i+1]);
+        }
+    }
+
+    for (auto gid: domain_gids) {
+        if (!std::binary_search(gj_gids.begin(), gj_gids.end(), gid)) {
             reg_cells.push_back(gid);
         }
     }
 
-    // Sort super_cell groups and only keep those where the first element in the group belongs to domain
-    super_cells.erase(std::remove_if(super_cells.begin(), super_cells.end(),
-            [gid_part, domain_id](std::vector<cell_gid_type>& cg)
-            {
-                std::sort(cg.begin(), cg.end());
-                return cg.front() < gid_part[domain_id].first;
-            }), super_cells.end());
+    std::vector<std::vector<cell_gid_type>> super_cells; //cells connected by gj
+    for (auto& [label, cg]: super_cell_members) {
+        std::sort(cg.begin(), cg.end());
+        super_cells.push_back(std::move(cg));
+    }
 
     // Collect local gids that belong to this rank, and sort gids into kind lists
     // kind_lists maps a cell_kind to a vector of either:
     // 1. gids of regular cells (in reg_cells)
     // 2. indices of supercells (in super_cells)
 
+    // The kinds of the cells of the domain are queried in bulk over runs of
+    // consecutive gids; members of super cells on other domains one by one.
+    std::vector<cell_kind> domain_kinds(domain_gids.size());
+    for (std::size_t b = 0; b<domain_gids.size();) {
+        auto e = b+1;
+        while (e<domain_gids.size() && domain_gids[e]==domain_gids[e-1]+1) ++e;
+        rec.cell_kinds(domain_gids[b], domain_gids[e-1]+1, domain_kinds.data()+b);
+        b = e;
+    }
+    auto kind_of = [&](cell_gid_type gid) {
+        auto it = std::lower_bound(domain_gids.begin(), domain_gids.end(), gid);
+        return it!=domain_gids.end() && *it==gid? domain_kinds[it-domain_gids.begin()]: rec.get_cell_kind(gid);
+    };
+
     std::vector<cell_gid_type> local_gids;
     std::unordered_map<cell_kind, std::vector<cell_identifier>> kind_lists;
     for (auto gid: reg_cells) {
         local_gids.push_back(gid);
-        kind_lists[rec.get_cell_kind(gid)].push_back({gid, false});
+        kind_lists[kind_of(gid)].push_back({gid, false});
     }
 
     for (unsigned i = 0; i < super_cells.size(); i++) {
-        auto kind = rec.get_cell_kind(super_cells[i].front());
+        auto kind = kind_of(super_cells[i].front());
         for (auto gid: super_cells[i]) {
-            if (rec.get_cell_kind(gid) != kind) {
+            if (kind_of(gid) != kind) {
                 throw gj_kind_mismatch(gid, super_cells[i].front());
             }
             local_gids.push_back(gid);
@@ -160,7 +423,12 @@ domain_decomposition partition_load_balance(
     }
     std::partition(kinds.begin(), kinds.end(), has_gpu_backend);
 
+    // Cell groups are filled up to the hinted group size times the mean cost
+    // of the cells of their kind on this domain, so that a group holds fewer
+    // cells if they are more expensive. With unit costs, this is the hinted
+    // number of cells.
     std::vector<group_description> groups;
+    std::vector<double> group_costs;
     for (auto k: kinds) {
         partition_hint hint;
         if (auto opt_hint = util::value_by_key(hint_map, k)) {
@@ -171,45 +439,138 @@ domain_decomposition partition_load_balance(
             if(hint.prefer_gpu && !hint.gpu_group_size) {
                 throw arbor_exception(arb::util::pprintf("unable to perform load balancing because {} has invalid suggested gpu_cell_group size of {}", k, hint.gpu_group_size));
             }
+            if(!(hint.cpu_fraction>=0 && hint.cpu_fraction<=1)) {
+                throw arbor_exception(arb::util::pprintf("unable to perform load balancing because {} has invalid suggested cpu_fraction of {}", k, hint.cpu_fraction));
+            }
         }
 
-        backend_kind backend = backend_kind::multicore;
-        std::size_t group_size = hint.cpu_group_size;
-
-        if (hint.prefer_gpu && gpu_avail && has_gpu_backend(k)) {
-            backend = backend_kind::gpu;
-            group_size = hint.gpu_group_size;
-        }
+        auto entry_cost = [&](const cell_identifier& cell) {
+            if (!cell.is_super_cell) return cell_cost(cell.id);
+            double c = 0;
+            for (auto gid: super_cells[cell.id]) c += cell_cost(gid);
+            return c;
+        };
+        auto entry_size = [&](const cell_identifier& cell) -> std::size_t {
+            return cell.is_super_cell? super_cells[cell.id].size(): 1;
+        };
+
+        // Form the groups of `backend` from the cells of `cells`.
+        auto make_groups = [&](const auto& cells, backend_kind backend, std::size_t group_size) {
+            std::size_t n_kind_cells = 0;
+            double kind_cost = 0;
+            for (const auto& cell: cells) {
+                kind_cost += entry_cost(cell);
+                n_kind_cells += entry_size(cell);
+            }
+            const double mean_cost = n_kind_cells && kind_cost>0? kind_cost/n_kind_cells: 1.;
+            const double group_cost_limit = group_size*mean_cost;
 
-        std::vector<cell_gid_type> group_elements;
-        // group_elements are sorted such that the gids of all members of a super_cell are consecutive.
-        for (auto cell: kind_lists[k]) {
-            if (cell.is_super_cell == false) {
-                group_elements.push_back(cell.id);
-            } else {
-                if (group_elements.size() + super_cells[cell.id].size() > group_size && !group_elements.empty()) {
-                    groups.push_back({k, std::move(group_elements), backend});
-                    group_elements.clear();
+            std::vector<cell_gid_type> group_elements;
+            double group_cost = 0;
+            auto add_group = [&]() {
+                groups.push_back({k, std::move(group_elements), backend});
+                group_costs.push_back(group_cost);
+                group_elements.clear();
+                group_cost = 0;
+            };
+
+            // group_elements are sorted such that the gids of all members of a super_cell are consecutive.
+            for (const auto& cell: cells) {
+                if (cell.is_super_cell == false) {
+                    // Start a new group first if this cell would overshoot the
+                    // limit by more than the group falls short of it.
+                    double c = cell_cost(cell.id);
+                    if (!group_elements.empty() && group_cost+c-group_cost_limit>group_cost_limit-group_cost) {
+                        add_group();
+                    }
+                    group_elements.push_back(cell.id);
+                    group_cost += c;
+                } else {
+                    double super_cell_cost = entry_cost(cell);
+                    if (group_cost + super_cell_cost > group_cost_limit && !group_elements.empty()) {
+                        add_group();
+                    }
+                    for (auto gid: super_cells[cell.id]) {
+                        group_elements.push_back(gid);
+                    }
+                    group_cost += super_cell_cost;
                 }
-                for (auto gid: super_cells[cell.id]) {
-                    group_elements.push_back(gid);
+                if (group_cost>=group_cost_limit) {
+                    add_group();
                 }
             }
-            if (group_elements.size()>=group_size) {
-                groups.push_back({k, std::move(group_elements), backend});
-                group_elements.clear();
+            if (!group_elements.empty()) {
+                add_group();
+            }
+        };
+
+        const auto& cells = kind_lists[k];
+        if (!(hint.prefer_gpu && gpu_avail && has_gpu_backend(k))) {
+            make_groups(cells, backend_kind::multicore, hint.cpu_group_size);
+            continue;
+        }
+
+        // Split the cells between the GPU and CPU cell groups, such that the
+        // cells after the first 1-cpu_fraction of the total cost go to the CPU.
+        auto n_gpu_entries = cells.size();
+        if (hint.cpu_fraction>0) {
+            double total = 0;
+            for (const auto& cell: cells) total += entry_cost(cell);
+            const double gpu_cost = (1-hint.cpu_fraction)*total;
+
+            double cost = 0;
+            n_gpu_entries = 0;
+            while (n_gpu_entries<cells.size() && cost+0.5*entry_cost(cells[n_gpu_entries])<=gpu_cost) {
+                cost += entry_cost(cells[n_gpu_entries++]);
             }
         }
-        if (!group_elements.empty()) {
-            groups.push_back({k, std::move(group_elements), backend});
+        auto gpu_cells = util::subrange_view(cells, 0, n_gpu_entries);
+        auto cpu_cells = util::subrange_view(cells, n_gpu_entries, cells.size());
+
+        std::size_t group_size = hint.gpu_group_size;
+
+        // Make at least one group per device, so that all GPUs take part.
+        if (num_gpus>1) {
+            std::size_t n = 0;
+            for (const auto& cell: gpu_cells) n += entry_size(cell);
+            group_size = std::min(group_size, (n+num_gpus-1)/num_gpus);
+        }
+        make_groups(gpu_cells, backend_kind::gpu, group_size);
+        make_groups(cpu_cells, backend_kind::multicore, hint.cpu_group_size);
+    }
+
+    // Spread the GPU cell groups over the devices of the context: each group
+    // in turn goes to the device with the least cost so far.
+    if (num_gpus>1) {
+        std::vector<double> device_cost(num_gpus, 0);
+        for (auto i: util::count_along(groups)) {
+            auto& g = groups[i];
+            if (g.backend!=backend_kind::gpu) continue;
+            auto d = std::min_element(device_cost.begin(), device_cost.end()) - device_cost.begin();
+            g.device = d;
+            device_cost[d] += group_costs[i];
         }
     }
 
     cell_size_type num_local_cells = local_gids.size();
 
-    // Exchange gid list with all other nodes
-    // global all-to-all to gather a local copy of the global gid list on each node.
-    auto global_gids = ctx->distributed->gather_gids(local_gids);
+    // Exchange the contiguous ranges of local gids with all other domains,
+    // as the bounds [first, last) of each range.
+    std::vector<cell_gid_type> gid_bounds;
+    {
+        auto sorted_gids = local_gids;
+        std::sort(sorted_gids.begin(), sorted_gids.end());
+        for (auto gid: sorted_gids) {
+            if (gid_bounds.empty() || gid!=gid_bounds.back()) {
+                gid_bounds.push_back(gid);
+                gid_bounds.push_back(gid+1);
+            }
+            else {
+                ++gid_bounds.back();
+            }
+        }
+    }
+    auto global_gid_bounds = ctx->distributed->gather_gids(gid_bounds);
 
     domain_decomposition d;
     d.num_domains = num_domains;
@@ -217,8 +578,31 @@ domain_decomposition partition_load_balance(
     d.num_local_cells = num_local_cells;
     d.num_global_cells = num_global_cells;
     d.groups = std::move(groups);
-    d.gid_domain = partition_gid_domain(global_gids, num_domains);
+    d.gid_domain = partition_gid_domain(global_gid_bounds);
+
+    return d;
+}
 
+domain_decomposition fuse_gpu_groups(domain_decomposition d) {
+    std::vector<group_description> groups;
+    std::vector<std::tuple<cell_kind, unsigned, std::size_t>> fused; // kind, device, index in groups
+    for (auto& g: d.groups) {
+        if (g.backend!=backend_kind::gpu) {
+            groups.push_back(std::move(g));
+            continue;
+        }
+        auto it = std::find_if(fused.begin(), fused.end(),
+            [&](const auto& f) { return std::get<0>(f)==g.kind && std::get<1>(f)==g.device; });
+        if (it==fused.end()) {
+            fused.emplace_back(g.kind, g.device, groups.size());
+            groups.push_back(std::move(g));
+        }
+        else {
+            auto& gids = groups[std::get<2>(*it)].gids;
+            gids.insert(gids.end(), g.gids.begin(), g.gids.end());
+        }
+    }
+    d.groups = std::move(groups);
     return d;
 }
 
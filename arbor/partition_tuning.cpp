@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+#include <arbor/context.hpp>
+#include <arbor/load_balance.hpp>
+#include <arbor/profile/timer.hpp>
+#include <arbor/recipe.hpp>
+
+#include "cell_group.hpp"
+#include "cell_group_factory.hpp"
+#include "execution_context.hpp"
+#include "gpu_context.hpp"
+#include "threading/threading.hpp"
+#include "util/rangeutil.hpp"
+#include "util/span.hpp"
+
+namespace arb {
+
+namespace {
+// Kinds of the cells of the recipe are queried in blocks of this many gids.
+constexpr cell_size_type kind_block = 1<<16;
+
+template <typename F>
+void for_each_kind(const recipe& rec, F&& f) {
+    const cell_size_type n = rec.num_cells();
+    std::vector<cell_kind> kinds;
+    for (cell_size_type b = 0; b<n; b += kind_block) {
+        const cell_size_type e = std::min(n, b+kind_block);
+        kinds.resize(e-b);
+        rec.cell_kinds(b, e, kinds.data());
+        for (auto i: util::make_span(e-b)) f(b+i, kinds[i]);
+    }
+}
+} // namespace
+
+partition_hint_map tune_partition_hints(
+    const recipe& rec,
+    const context& ctx,
+    partition_hint_map hints,
+    const partition_tuning& opts)
+{
+    using timer = profile::timer<>;
+
+    if (opts.dt<=0 || !opts.steps) {
+        throw arbor_exception("partition tuning requires a positive time step and number of steps");
+    }
+
+    const unsigned num_domains = ctx->distributed->size();
+    const unsigned num_threads = ctx->thread_pool->get_num_threads();
+    auto* ts = ctx->thread_pool.get();
+
+    // Count the cells of each kind, then sample up to max_sample of them,
+    // spread evenly over the gids of the kind. Cells with gap junctions are
+    // skipped, as they cannot be placed in groups without their peers. The
+    // sample depends only on the recipe, so every domain takes the same one.
+    std::unordered_map<cell_kind, cell_size_type> kind_count;
+    for_each_kind(rec, [&](cell_gid_type, cell_kind k) { ++kind_count[k]; });
+
+    std::unordered_map<cell_kind, cell_size_type> kind_seen;
+    std::unordered_map<cell_kind, std::vector<cell_gid_type>> samples;
+    for_each_kind(rec, [&](cell_gid_type gid, cell_kind k) {
+        const auto stride = std::max<cell_size_type>(1, kind_count[k]/std::max<std::size_t>(1, opts.max_sample));
+        auto& sample = samples[k];
+        if (kind_seen[k]++%stride || sample.size()>=opts.max_sample) return;
+        if (rec.gap_junctions_on(gid).empty()) sample.push_back(gid);
+    });
+
+    // Kinds are visited in the same order on all domains.
+    std::vector<cell_kind> kinds;
+    for (const auto& [k, n]: kind_count) kinds.push_back(k);
+    std::sort(kinds.begin(), kinds.end());
+
+    for (auto kind: kinds) {
+        const auto& sample = samples[kind];
+        auto& hint = hints[kind];
+
+        const bool on_gpu = hint.prefer_gpu && ctx->gpu->has_gpu() && cell_kind_supported(kind, backend_kind::gpu, *ctx);
+        auto factory = cell_kind_implementation(kind, on_gpu? backend_kind::gpu: backend_kind::multicore, *ctx);
+        if (!factory || sample.empty()) continue;
+
+        // Cells of the kind on each domain.
+        const double n_local = std::max<double>(1, double(kind_count[kind])/num_domains);
+
+        std::vector<std::size_t> sizes;
+        for (auto s: opts.group_sizes) {
+            if (s>0 && s<=sample.size()) sizes.push_back(s);
+        }
+        if (sizes.empty()) sizes.push_back(sample.size());
+
+        std::size_t best_size = sizes.front();
+        double best_time = -1;
+        for (auto size: sizes) {
+            // Build the trial groups, and advance them by one step before
+            // timing, so that any set up on the first step is not counted.
+            std::vector<std::vector<cell_gid_type>> group_gids;
+            for (std::size_t i = 0; i<sample.size(); i += size) {
+                group_gids.emplace_back(sample.begin()+i, sample.begin()+std::min(sample.size(), i+size));
+            }
+            const int n_groups = group_gids.size();
+
+            std::vector<cell_group_ptr> groups(n_groups);
+            std::vector<double> group_time(n_groups, 0.);
+            threading::parallel_for::apply(0, n_groups, 1, ts,
+                [&](int i) {
+                    cell_label_range sources, targets;
+                    std::vector<pse_vector> lanes(group_gids[i].size());
+                    groups[i] = factory(group_gids[i], rec, sources, targets);
+                    groups[i]->advance(epoch(0, 0, opts.dt), opts.dt, util::subrange_view(lanes, 0, lanes.size()));
+                    groups[i]->clear_spikes();
+
+                    auto t0 = timer::tic();
+                    groups[i]->advance(epoch(1, opts.dt, (opts.steps+1)*opts.dt), opts.dt, util::subrange_view(lanes, 0, lanes.size()));
+                    group_time[i] = timer::toc(t0);
+                    groups[i]->clear_spikes();
+                });
+
+            // Wall time of the cells on a domain: the groups are advanced in
+            // rounds of one per thread, each taking the time of a full group.
+            // Domains agree on the slowest estimate, and so on the size.
+            const double cell_time = util::sum(group_time)/sample.size();
+            const double n_part = std::ceil(n_local/size);
+            const double rounds = std::ceil(n_part/num_threads);
+            const double estimate = ctx->distributed->max(rounds*std::min<double>(size, n_local)*cell_time);
+
+            if (best_time<0 || estimate<best_time) {
+                best_time = estimate;
+                best_size = size;
+            }
+        }
+
+        if (on_gpu) {
+            hint.gpu_group_size = best_size;
+        }
+        else {
+            hint.cpu_group_size = best_size;
+        }
+    }
+
+    return hints;
+}
+
+} // namespace arb
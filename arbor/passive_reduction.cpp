@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <arbor/cable_cell.hpp>
+#include <arbor/cable_cell_param.hpp>
+#include <arbor/math.hpp>
+#include <arbor/morph/morphology.hpp>
+#include <arbor/morph/primitives.hpp>
+#include <arbor/morph/segment_tree.hpp>
+#include <arbor/passive_reduction.hpp>
+
+#include "util/span.hpp"
+
+namespace arb {
+
+namespace {
+// Coverage of a branch by a painting.
+enum coverage: char { none = 0, full = 1, partial = 2 };
+
+bool is_passive(const mechanism_desc& m, const std::vector<std::string>& names) {
+    auto name = m.name().substr(0, m.name().find('/'));
+    return std::find(names.begin(), names.end(), name)!=names.end();
+}
+
+// Lateral area of the frustum of a segment.
+double segment_area(const msegment& s) {
+    double l = distance(s.prox, s.dist);
+    double dr = s.prox.radius-s.dist.radius;
+    return math::pi<double>*(s.prox.radius+s.dist.radius)*std::sqrt(l*l+dr*dr);
+}
+
+// Electrotonic length of a segment, the integral of 1/√d along it, in units
+// of √µm: the length constant is proportional to √d for uniform membrane and
+// axial resistivity.
+double segment_electrotonic_length(const msegment& s) {
+    double l = distance(s.prox, s.dist);
+    return 2*l/(std::sqrt(2*s.prox.radius)+std::sqrt(2*s.dist.radius));
+}
+} // namespace
+
+reduced_cable_cell reduce_passive_subtrees(const cable_cell& cell, const passive_reduction_options& opts) {
+    const auto& morph = cell.morphology();
+    const auto& dec = cell.decorations();
+    const msize_t n_branch = morph.num_branches();
+
+    // Coverage of each branch by each painting, and branches that may not
+    // be reduced for a placed item, a kept location or an active mechanism.
+    const auto& paintings = dec.paintings();
+    std::vector<mextent> extents;
+    std::vector<std::vector<char>> cover(n_branch, std::vector<char>(paintings.size(), none));
+    std::vector<char> blocked(n_branch, 0);
+
+    for (auto i: util::count_along(paintings)) {
+        const auto& [reg, item] = paintings[i];
+        extents.push_back(cell.concrete_region(reg));
+        for (const auto& c: extents.back()) {
+            if (c.prox_pos==c.dist_pos) continue;
+            cover[c.branch][i] = c.prox_pos==0 && c.dist_pos==1? full: partial;
+        }
+        if (auto m = std::get_if<mechanism_desc>(&item); m && !is_passive(*m, opts.passive_mechanisms)) {
+            for (const auto& c: extents.back()) blocked[c.branch] = 1;
+        }
+    }
+
+    for (const auto& [ls, item, tag]: dec.placements()) {
+        for (auto loc: cell.concrete_locset(ls)) blocked[loc.branch] = 1;
+    }
+    for (const auto& ls: opts.keep) {
+        for (auto loc: cell.concrete_locset(ls)) blocked[loc.branch] = 1;
+    }
+
+    // A subtree is passive if its first branch and the subtrees of its
+    // children are, with the same coverage. Children follow their parents
+    // in the branch order.
+    std::vector<char> passive(n_branch, 0);
+    for (msize_t b = n_branch; b-->0;) {
+        bool p = !blocked[b] && std::find(cover[b].begin(), cover[b].end(), partial)==cover[b].end();
+        for (auto c: morph.branch_children(b)) {
+            p = p && passive[c] && cover[c]==cover[b];
+        }
+        passive[b] = p;
+    }
+
+    auto is_root = [&](msize_t b) { return morph.branch_parent(b)==mnpos; };
+
+    reduced_cable_cell result;
+    std::vector<msize_t> roots;             // first branches of the reduced subtrees
+    std::vector<char> removed(n_branch, 0); // branches replaced by a cylinder
+    std::vector<msegment> cylinders;
+
+    for (msize_t b = 0; b<n_branch; ++b) {
+        auto parent = morph.branch_parent(b);
+        if (!passive[b] || is_root(b) || (passive[parent] && !is_root(parent))) continue;
+
+        passive_subtree_reduction r{b, 0, 0, 0, 0, 0, 0, false};
+
+        // Walk the subtree, accumulating the electrotonic distance from the
+        // fork point to the distal end of each branch.
+        std::vector<msize_t> subtree;
+        std::vector<std::pair<msize_t, double>> stack = {{b, 0.}};
+        std::vector<double> tips;
+        while (!stack.empty()) {
+            auto [c, x] = stack.back();
+            stack.pop_back();
+            subtree.push_back(c);
+
+            const auto& segs = morph.branch_segments(c);
+            for (const auto& s: segs) {
+                r.area += segment_area(s);
+                x += segment_electrotonic_length(s);
+            }
+
+            const auto& children = morph.branch_children(c);
+            if (children.empty()) {
+                tips.push_back(x);
+                continue;
+            }
+
+            double d = std::pow(2*segs.back().dist.radius, 1.5), sum = 0;
+            for (auto k: children) {
+                sum += std::pow(2*morph.branch_segments(k).front().prox.radius, 1.5);
+                stack.push_back({k, x});
+            }
+            r.rall_mismatch = std::max(r.rall_mismatch, d>0? std::abs(d-sum)/d: 0.);
+        }
+        r.n_branches = subtree.size();
+        if (r.n_branches<opts.min_branches) continue;
+
+        auto [lo, hi] = std::minmax_element(tips.begin(), tips.end());
+        double L = 0;
+        for (auto x: tips) L += x/tips.size();
+
+        // The cylinder of diameter d and length l = L√d has electrotonic
+        // length L and area A = πLd^(3/2).
+        if (L>0 && r.area>0) {
+            r.tip_spread = (*hi-*lo)/L;
+            r.diameter = std::pow(r.area/(math::pi<double>*L), 2./3.);
+            r.length = L*std::sqrt(r.diameter);
+            r.reduced = std::max(r.tip_spread, r.rall_mismatch)<=opts.tolerance;
+        }
+
+        if (r.reduced) {
+            const auto& first = morph.branch_segments(b).front();
+            const auto& last = morph.branch_segments(b).back();
+            double dx = last.dist.x-first.prox.x, dy = last.dist.y-first.prox.y, dz = last.dist.z-first.prox.z;
+            double n = std::sqrt(dx*dx+dy*dy+dz*dz);
+            if (n>0) { dx /= n; dy /= n; dz /= n; } else { dx = 1; dy = dz = 0; }
+
+            mpoint prox{first.prox.x, first.prox.y, first.prox.z, r.diameter/2};
+            mpoint dist{prox.x+dx*r.length, prox.y+dy*r.length, prox.z+dz*r.length, r.diameter/2};
+            cylinders.push_back(msegment{first.id, prox, dist, first.tag});
+            roots.push_back(b);
+            for (auto c: subtree) removed[c] = 1;
+        }
+        result.subtrees.push_back(r);
+    }
+
+    if (roots.empty()) {
+        result.cell = cell;
+        return result;
+    }
+
+    // Rebuild the segment tree in the order of the segment ids, with the
+    // first segment of each reduced subtree replaced by its cylinder and the
+    // remaining segments of the subtree left out.
+    std::size_t n_seg = 0;
+    for (msize_t b = 0; b<n_branch; ++b) n_seg += morph.branch_segments(b).size();
+
+    std::vector<msegment> segs(n_seg);
+    std::vector<msize_t> parents(n_seg, mnpos);
+    std::vector<char> keep(n_seg, 0);
+    for (msize_t b = 0; b<n_branch; ++b) {
+        const auto& bsegs = morph.branch_segments(b);
+        auto p = is_root(b)? mnpos: morph.branch_segments(morph.branch_parent(b)).back().id;
+        for (const auto& s: bsegs) {
+            segs[s.id] = s;
+            parents[s.id] = p;
+            keep[s.id] = !removed[b];
+            p = s.id;
+        }
+    }
+    for (const auto& s: cylinders) {
+        segs[s.id] = s;
+        keep[s.id] = 1;
+    }
+
+    segment_tree tree;
+    std::vector<msize_t> seg_map(n_seg, mnpos);
+    for (std::size_t i = 0; i<n_seg; ++i) {
+        if (!keep[i]) continue;
+        auto p = parents[i]==mnpos? mnpos: seg_map[parents[i]];
+        seg_map[i] = tree.append(p, segs[i].prox, segs[i].dist, segs[i].tag);
+    }
+    arb::morphology reduced(tree);
+
+    // Kept branches, and the cylinders in place of the first branches of
+    // the subtrees, are numbered in the same order as before.
+    std::vector<msize_t> seg_branch(tree.size());
+    for (msize_t b = 0; b<reduced.num_branches(); ++b) {
+        for (const auto& s: reduced.branch_segments(b)) seg_branch[s.id] = b;
+    }
+    std::vector<msize_t> branch_map(n_branch, mnpos);
+    for (msize_t b = 0; b<n_branch; ++b) {
+        if (!removed[b]) branch_map[b] = seg_branch[seg_map[morph.branch_segments(b).front().id]];
+    }
+    for (auto b: roots) {
+        branch_map[b] = seg_branch[seg_map[morph.branch_segments(b).front().id]];
+    }
+
+    decor reduced_decor;
+    for (const auto& d: dec.defaults().serialize()) reduced_decor.set_default(d);
+
+    for (auto i: util::count_along(paintings)) {
+        mcable_list cables;
+        for (const auto& c: extents[i]) {
+            if (!removed[c.branch]) cables.push_back({branch_map[c.branch], c.prox_pos, c.dist_pos});
+        }
+        for (auto b: roots) {
+            if (cover[b][i]==full) cables.push_back({branch_map[b], 0, 1});
+        }
+        std::sort(cables.begin(), cables.end());
+        reduced_decor.paint(mextent(cables), paintings[i].second);
+    }
+
+    for (const auto& [ls, item, tag]: dec.placements()) {
+        mlocation_list locs;
+        for (auto loc: cell.concrete_locset(ls)) locs.push_back({branch_map[loc.branch], loc.pos});
+        reduced_decor.place(locs, item, tag);
+    }
+
+    result.cell = cable_cell(reduced, cell.labels(), reduced_decor);
+    return result;
+}
+
+} // namespace arb
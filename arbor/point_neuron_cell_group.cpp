@@ -0,0 +1,326 @@
+#include <algorithm>
+#include <cmath>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/simd/simd.hpp>
+
+#include "label_resolution.hpp"
+#include "point_neuron_cell_group.hpp"
+#include "profile/profiler_macro.hpp"
+#include "util/span.hpp"
+
+namespace arb {
+
+// Alignment of the per-cell arrays, for vectorised updates.
+static constexpr std::size_t point_alignment = 64;
+
+// Cells whose update the compiler does not vectorise are updated `lanes`
+// at a time with explicit SIMD.
+static constexpr unsigned lanes = std::max(4, simd::simd_abi::native_width<double>::value);
+using simd_value = simd::simd<double, lanes, simd::simd_abi::default_abi>;
+
+point_array make_point_array() {
+    return point_array(util::padded_allocator<double>(point_alignment));
+}
+
+// One step of length dt of the solver S for the system
+//     dv/dt = f_v(v, w), dw/dt = f_w(v, w),
+// where f(v, w, dv, dw) evaluates both derivatives, for scalar or SIMD values.
+template <point_solver_kind S, typename T, typename F>
+static inline void integrate(T& v, T& w, double dt, F f) {
+    T dv1, dw1;
+    f(v, w, dv1, dw1);
+    if constexpr (S==point_solver_kind::euler) {
+        v += dt*dv1;
+        w += dt*dw1;
+    }
+    else {
+        const double h = 0.5*dt;
+        T dv2, dw2, dv3, dw3, dv4, dw4;
+        f(v + h*dv1, w + h*dw1, dv2, dw2);
+        f(v + h*dv2, w + h*dw2, dv3, dw3);
+        f(v + dt*dv3, w + dt*dw3, dv4, dw4);
+        v += dt/6*(dv1 + 2*(dv2 + dv3) + dv4);
+        w += dt/6*(dw1 + 2*(dw2 + dw3) + dw4);
+    }
+}
+
+// Adaptive exponential integrate and fire.
+
+void adex_dynamics::add_cell(const adex_cell& cell) {
+    C_m_inv.push_back(1/cell.C_m);
+    g_L.push_back(cell.g_L);
+    E_L.push_back(cell.E_L);
+    V_T.push_back(cell.V_T);
+    Delta_T.push_back(cell.Delta_T);
+    Delta_T_inv.push_back(1/cell.Delta_T);
+    V_peak.push_back(cell.V_peak);
+    V_reset.push_back(cell.V_reset);
+    t_ref.push_back(cell.t_ref);
+    a.push_back(cell.a);
+    b.push_back(cell.b);
+    tau_w_inv.push_back(1/cell.tau_w);
+
+    V_m_init.push_back(cell.V_m);
+    w_init.push_back(cell.w);
+    V_m.push_back(cell.V_m);
+    w.push_back(cell.w);
+    t_ready.push_back(0);
+}
+
+void adex_dynamics::reset() {
+    V_m = V_m_init;
+    w = w_init;
+    std::fill(t_ready.begin(), t_ready.end(), 0.);
+}
+
+// A cell in its refractory period at t ignores the events of the step and
+// is held at V_reset, while its adaptation current evolves. The derivatives
+// are evaluated with V bounded by V_peak, so that a cell that crosses the
+// threshold within a step neither overflows nor drives the adaptation
+// current by its overshoot. As the exponential stops
+// the compiler from vectorising the loop, the cells are updated with
+// explicit SIMD, and the remainder one at a time.
+template <point_solver_kind S>
+int adex_dynamics::step(std::size_t first, std::size_t last, time_type t, time_type dt, const double* q) {
+    int crossed = 0;
+    std::size_t i = first;
+    for (; i+lanes<=last; i += lanes) {
+        const simd_value C_inv(C_m_inv.data()+i), gL(g_L.data()+i), EL(E_L.data()+i);
+        const simd_value VT(V_T.data()+i), DT(Delta_T.data()+i), DT_inv(Delta_T_inv.data()+i);
+        const simd_value Vpk(V_peak.data()+i), Vrs(V_reset.data()+i);
+        const simd_value A(a.data()+i), tw_inv(tau_w_inv.data()+i);
+
+        const auto active = simd::cmp_geq(simd_value(t), simd_value(t_ready.data()+i));
+        simd_value v = Vrs;
+        simd::where(active, v) = simd_value(V_m.data()+i) + simd_value(q+i)*C_inv;
+        simd_value u(w.data()+i);
+        integrate<S>(v, u, dt, [&](const simd_value& x, const simd_value& y, simd_value& dx, simd_value& dy) {
+            const simd_value xc = simd::min(x, Vpk);
+            dx = (gL*(EL - xc + DT*simd::exp((xc - VT)*DT_inv)) - y)*C_inv;
+            dy = (A*(xc - EL) - y)*tw_inv;
+        });
+
+        simd_value V = Vrs, up(0.);
+        simd::where(active, V) = v;
+        simd::where(simd::logical_and(active, simd::cmp_geq(v, Vpk)), up) = simd_value(1.);
+        V.copy_to(V_m.data()+i);
+        u.copy_to(w.data()+i);
+        crossed |= simd::sum(up)>0;
+    }
+    for (; i<last; ++i) {
+        const bool active = t>=t_ready[i];
+        double v = active? V_m[i] + q[i]*C_m_inv[i]: V_reset[i];
+        double u = w[i];
+        integrate<S>(v, u, dt, [&](double x, double y, double& dx, double& dy) {
+            const double xc = std::min(x, V_peak[i]);
+            dx = (g_L[i]*(E_L[i] - xc + Delta_T[i]*std::exp((xc - V_T[i])*Delta_T_inv[i])) - y)*C_m_inv[i];
+            dy = (a[i]*(xc - E_L[i]) - y)*tau_w_inv[i];
+        });
+        V_m[i] = active? v: V_reset[i];
+        w[i] = u;
+        crossed |= active & (v>=V_peak[i]);
+    }
+    return crossed;
+}
+
+bool adex_dynamics::fire(std::size_t i, time_type t) {
+    if (!(V_m[i]>=V_peak[i])) return false;
+    V_m[i] = V_reset[i];
+    w[i] += b[i];
+    t_ready[i] = t + t_ref[i];
+    return true;
+}
+
+void adex_dynamics::serialize(io::serializer& out) const {
+    out.array(V_m);
+    out.array(w);
+    out.array(t_ready);
+}
+
+void adex_dynamics::deserialize(io::deserializer& in) {
+    in.array(V_m);
+    in.array(w);
+    in.array(t_ready);
+}
+
+// Izhikevich.
+
+void izhikevich_dynamics::add_cell(const izhikevich_cell& cell) {
+    a.push_back(cell.a);
+    b.push_back(cell.b);
+    c.push_back(cell.c);
+    d.push_back(cell.d);
+    v_peak.push_back(cell.v_peak);
+
+    v_init.push_back(cell.v);
+    u_init.push_back(cell.u);
+    v.push_back(cell.v);
+    u.push_back(cell.u);
+}
+
+void izhikevich_dynamics::reset() {
+    v = v_init;
+    u = u_init;
+}
+
+template <point_solver_kind S>
+int izhikevich_dynamics::step(std::size_t first, std::size_t last, time_type, time_type dt, const double* __restrict__ q) {
+    double* __restrict__ V = v.data();
+    double* __restrict__ U = u.data();
+    const double* __restrict__ A = a.data();
+    const double* __restrict__ B = b.data();
+    const double* __restrict__ Vpk = v_peak.data();
+
+    int crossed = 0;
+    for (std::size_t i = first; i<last; ++i) {
+        double x = V[i] + q[i];
+        double y = U[i];
+        integrate<S>(x, y, dt, [&](double x, double y, double& dx, double& dy) {
+            dx = (0.04*x + 5)*x + 140 - y;
+            dy = A[i]*(B[i]*x - y);
+        });
+        V[i] = x;
+        U[i] = y;
+        crossed |= x>=Vpk[i];
+    }
+    return crossed;
+}
+
+bool izhikevich_dynamics::fire(std::size_t i, time_type) {
+    if (!(v[i]>=v_peak[i])) return false;
+    v[i] = c[i];
+    u[i] += d[i];
+    return true;
+}
+
+void izhikevich_dynamics::serialize(io::serializer& out) const {
+    out.array(v);
+    out.array(u);
+}
+
+void izhikevich_dynamics::deserialize(io::deserializer& in) {
+    in.array(v);
+    in.array(u);
+}
+
+// The cell group.
+
+template <typename Dynamics>
+point_neuron_cell_group<Dynamics>::point_neuron_cell_group(const std::vector<cell_gid_type>& gids, const recipe& rec, cell_label_range& cg_sources, cell_label_range& cg_targets):
+    gids_(gids)
+{
+    const auto n = gids_.size();
+
+    std::vector<cell_type> cells;
+    cells.reserve(n);
+    for (auto gid: gids_) {
+        if (!rec.get_probes(gid).empty()) {
+            throw bad_cell_probe(Dynamics::kind, gid);
+        }
+        cells.push_back(util::any_cast<cell_type>(rec.get_cell_description(gid)));
+
+        cg_sources.add_cell();
+        cg_targets.add_cell();
+        cg_sources.add_label(cells.back().source, {0, 1});
+        cg_targets.add_label(cells.back().target, {0, 1});
+    }
+
+    // Place the cells integrated with forward Euler first, keeping the order
+    // of the lids within each solver.
+    lid_.resize(n);
+    for (auto lid: util::make_span(n)) lid_[lid] = lid;
+    std::stable_partition(lid_.begin(), lid_.end(),
+        [&](cell_lid_type lid) { return cells[lid].solver==point_solver_kind::euler; });
+    n_euler_ = std::count_if(cells.begin(), cells.end(),
+        [](const cell_type& c) { return c.solver==point_solver_kind::euler; });
+
+    pos_.resize(n);
+    for (auto p: util::make_span(n)) {
+        pos_[lid_[p]] = p;
+        dynamics_.add_cell(cells[lid_[p]]);
+    }
+}
+
+template <typename Dynamics>
+cell_kind point_neuron_cell_group<Dynamics>::get_cell_kind() const {
+    return Dynamics::kind;
+}
+
+// The epoch is divided into steps of length dt from its start, the last of
+// which may be shorter. The events of each cell are summed by the step in
+// which they fall, and applied at its start; spikes are reported at the end
+// of the step in which a cell reaches its threshold.
+template <typename Dynamics>
+void point_neuron_cell_group<Dynamics>::advance(epoch ep, time_type dt, const event_lane_subrange& event_lanes) {
+    PE(advance_point);
+    const auto n = gids_.size();
+    if (!n || !(ep.t1>ep.t0)) {
+        PL();
+        return;
+    }
+
+    const std::size_t n_steps = std::max<std::size_t>(1, std::ceil((ep.t1-ep.t0)/dt));
+
+    weights_.assign(n_steps*n, 0.);
+    if (event_lanes.size()) {
+        for (auto lid: util::make_span(n)) {
+            for (const auto& ev: event_lanes[lid]) {
+                if (ev.time>=ep.t1) break;
+                if (ev.time<ep.t0) continue;
+                auto s = std::min<std::size_t>((ev.time-ep.t0)/dt, n_steps-1);
+                weights_[s*n+pos_[lid]] += ev.weight;
+            }
+        }
+    }
+
+    for (auto s: util::make_span(n_steps)) {
+        const time_type t = ep.t0 + s*dt;
+        const time_type t_next = s+1==n_steps? ep.t1: t+dt;
+        const double* q = weights_.data()+s*n;
+
+        int crossed = dynamics_.template step<point_solver_kind::euler>(0, n_euler_, t, t_next-t, q);
+        crossed |= dynamics_.template step<point_solver_kind::rk4>(n_euler_, n, t, t_next-t, q);
+
+        if (crossed) {
+            for (auto p: util::make_span(n)) {
+                if (dynamics_.fire(p, t_next)) {
+                    spikes_.push_back({{gids_[lid_[p]], 0}, t_next});
+                }
+            }
+        }
+    }
+    PL();
+}
+
+template <typename Dynamics>
+const std::vector<spike>& point_neuron_cell_group<Dynamics>::spikes() const {
+    return spikes_;
+}
+
+template <typename Dynamics>
+void point_neuron_cell_group<Dynamics>::clear_spikes() {
+    spikes_.clear();
+}
+
+template <typename Dynamics>
+void point_neuron_cell_group<Dynamics>::reset() {
+    spikes_.clear();
+    dynamics_.reset();
+}
+
+template <typename Dynamics>
+void point_neuron_cell_group<Dynamics>::serialize(io::serializer& out) const {
+    dynamics_.serialize(out);
+}
+
+template <typename Dynamics>
+void point_neuron_cell_group<Dynamics>::deserialize(io::deserializer& in, time_type) {
+    spikes_.clear();
+    dynamics_.deserialize(in);
+}
+
+template class point_neuron_cell_group<adex_dynamics>;
+template class point_neuron_cell_group<izhikevich_dynamics>;
+
+} // namespace arb
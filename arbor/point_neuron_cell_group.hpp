@@ -0,0 +1,157 @@
+#pragma once
+
+// Cell groups of point neurons with nonlinear dynamics in two state
+// variables, such as the adaptive exponential and Izhikevich neurons.
+//
+// The group keeps the parameters and state of its cells in per-cell arrays,
+// and integrates all cells together on the time step of the simulation, with
+// the events of each cell summed by step. The dynamics of each model are a
+// policy class, which provides:
+//
+//   cell_type, kind     The cell description and kind of the model.
+//   add_cell(cell)      Append the parameters and initial state of a cell.
+//   reset()             Restore the initial state of all cells.
+//   step<S>(first, last, t, dt, q)
+//                       Advance the cells [first, last) from t by dt with
+//                       solver S, after applying the summed event weights
+//                       q[i] of each cell; return nonzero if any cell may
+//                       have reached its threshold.
+//   fire(i, t)          If cell i has reached its threshold, reset it and
+//                       return true, for a spike at time t.
+//   serialize(out), deserialize(in)
+//                       Write and read the state arrays.
+
+#include <cstddef>
+#include <vector>
+
+#include <arbor/adex_cell.hpp>
+#include <arbor/common_types.hpp>
+#include <arbor/izhikevich_cell.hpp>
+#include <arbor/recipe.hpp>
+#include <arbor/sampling.hpp>
+#include <arbor/spike.hpp>
+
+#include "cell_group.hpp"
+#include "label_resolution.hpp"
+#include "util/padded_alloc.hpp"
+
+namespace arb {
+
+using point_array = std::vector<double, util::padded_allocator<double>>;
+
+// Per-cell arrays are aligned for vectorised updates.
+point_array make_point_array();
+
+struct adex_dynamics {
+    using cell_type = adex_cell;
+    static constexpr cell_kind kind = cell_kind::adex;
+
+    // Parameters.
+    point_array C_m_inv = make_point_array();     // 1/C_m
+    point_array g_L = make_point_array();
+    point_array E_L = make_point_array();
+    point_array V_T = make_point_array();
+    point_array Delta_T = make_point_array();
+    point_array Delta_T_inv = make_point_array(); // 1/Delta_T
+    point_array V_peak = make_point_array();
+    point_array V_reset = make_point_array();
+    point_array t_ref = make_point_array();
+    point_array a = make_point_array();
+    point_array b = make_point_array();
+    point_array tau_w_inv = make_point_array();   // 1/tau_w
+
+    // Initial and current state, and end of the refractory period.
+    point_array V_m_init = make_point_array();
+    point_array w_init = make_point_array();
+    point_array V_m = make_point_array();
+    point_array w = make_point_array();
+    point_array t_ready = make_point_array();
+
+    void add_cell(const adex_cell& cell);
+    void reset();
+
+    template <point_solver_kind S>
+    int step(std::size_t first, std::size_t last, time_type t, time_type dt, const double* q);
+    bool fire(std::size_t i, time_type t);
+
+    void serialize(io::serializer& out) const;
+    void deserialize(io::deserializer& in);
+};
+
+struct izhikevich_dynamics {
+    using cell_type = izhikevich_cell;
+    static constexpr cell_kind kind = cell_kind::izhikevich;
+
+    // Parameters.
+    point_array a = make_point_array();
+    point_array b = make_point_array();
+    point_array c = make_point_array();
+    point_array d = make_point_array();
+    point_array v_peak = make_point_array();
+
+    // Initial and current state.
+    point_array v_init = make_point_array();
+    point_array u_init = make_point_array();
+    point_array v = make_point_array();
+    point_array u = make_point_array();
+
+    void add_cell(const izhikevich_cell& cell);
+    void reset();
+
+    template <point_solver_kind S>
+    int step(std::size_t first, std::size_t last, time_type t, time_type dt, const double* q);
+    bool fire(std::size_t i, time_type t);
+
+    void serialize(io::serializer& out) const;
+    void deserialize(io::deserializer& in);
+};
+
+template <typename Dynamics>
+class point_neuron_cell_group: public cell_group {
+public:
+    using cell_type = typename Dynamics::cell_type;
+
+    point_neuron_cell_group() = default;
+
+    point_neuron_cell_group(const std::vector<cell_gid_type>& gids, const recipe& rec, cell_label_range& cg_sources, cell_label_range& cg_targets);
+
+    virtual cell_kind get_cell_kind() const override;
+    virtual void reset() override;
+    virtual void serialize(io::serializer& out) const override;
+    virtual void deserialize(io::deserializer& in, time_type t) override;
+    virtual void set_binning_policy(binning_kind policy, time_type bin_interval) override {}
+    virtual void advance(epoch epoch, time_type dt, const event_lane_subrange& events) override;
+
+    virtual const std::vector<spike>& spikes() const override;
+    virtual void clear_spikes() override;
+
+    virtual void add_sampler(sampler_association_handle, cell_member_predicate, schedule, sampler_function, sampling_policy) override {}
+    virtual void remove_sampler(sampler_association_handle) override {}
+    virtual void remove_all_samplers() override {}
+
+private:
+    // List of the gids of the cells in the group.
+    std::vector<cell_gid_type> gids_;
+
+    // The cells are held in the arrays of the dynamics ordered by solver:
+    // those integrated with forward Euler come first, at positions
+    // [0, n_euler_). lid_[p] is the lid of the cell at position p, and
+    // pos_[lid] its position.
+    Dynamics dynamics_;
+    std::size_t n_euler_ = 0;
+    std::vector<cell_lid_type> lid_;
+    std::vector<std::size_t> pos_;
+
+    // Summed event weights by step and position.
+    point_array weights_ = make_point_array();
+
+    std::vector<spike> spikes_;
+};
+
+using adex_cell_group = point_neuron_cell_group<adex_dynamics>;
+using izhikevich_cell_group = point_neuron_cell_group<izhikevich_dynamics>;
+
+extern template class point_neuron_cell_group<adex_dynamics>;
+extern template class point_neuron_cell_group<izhikevich_dynamics>;
+
+} // namespace arb
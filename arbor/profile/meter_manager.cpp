@@ -4,7 +4,9 @@
 #include <arbor/context.hpp>
 
 #include "memory_meter.hpp"
+#include "perf_meter.hpp"
 #include "power_meter.hpp"
+#include "thread_pool_meter.hpp"
 
 #include "execution_context.hpp"
 #include "util/hostname.hpp"
@@ -59,6 +61,17 @@ void meter_manager::start(const context& ctx) {
 
     started_ = true;
 
+    // The thread pool meters read the thread pool of the context.
+    if (auto m = make_wait_meter(ctx->thread_pool)) {
+        meters_.push_back(std::move(m));
+    }
+    if (auto m = make_migration_meter(ctx->thread_pool)) {
+        meters_.push_back(std::move(m));
+    }
+    for (auto& m: make_perf_meters(ctx->thread_pool)) {
+        meters_.push_back(std::move(m));
+    }
+
     // take readings for the start point
     for (auto& m: meters_) {
         m->take_reading();
@@ -138,6 +151,12 @@ std::ostream& operator<<(std::ostream& o, const meter_report& report) {
         if (m.name=="time") {
             o << strprintf("%16s", "time(s)");
         }
+        else if (m.name=="wait") {
+            o << strprintf("%16s", "wait(s)");
+        }
+        else if (m.name=="migrations") {
+            o << strprintf("%16s", "migrations");
+        }
         else if (m.name.find("memory")!=std::string::npos) {
             o << strprintf("%16s", m.name+"(MB)");
         }
@@ -162,6 +181,18 @@ std::ostream& operator<<(std::ostream& o, const meter_report& report) {
                 sums[m_index] += time;
                 o << strprintf("%16.3f", time);
             }
+            else if (m.name=="wait") {
+                // Calculate the average wait time per rank in s.
+                double wait = mean(m.measurements[cp_index]);
+                sums[m_index] += wait;
+                o << strprintf("%16.3f", wait);
+            }
+            else if (m.name=="migrations") {
+                // Calculate the total number of migrations accross all ranks.
+                double migrations = util::sum(m.measurements[cp_index]);
+                sums[m_index] += migrations;
+                o << strprintf("%16.0f", migrations);
+            }
             else if (m.name.find("memory")!=std::string::npos) {
                 // Calculate the average memory per rank in MB.
                 double mem = mean(m.measurements[cp_index])*1e-6;
@@ -0,0 +1,74 @@
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arbor/profile/meter.hpp>
+
+#include "hardware/perf_counters.hpp"
+#include "threading/threading.hpp"
+#include "perf_meter.hpp"
+
+namespace arb {
+namespace profile {
+
+// The number of times a hardware event occurred, summed over all threads.
+
+class perf_meter: public meter {
+    unsigned event_;
+    std::vector<std::uint64_t> readings_;
+
+public:
+    explicit perf_meter(unsigned event): event_(event) {}
+
+    std::string name() override {
+        return hw::perf_event_name(event_);
+    }
+
+    std::string units() override {
+        return "";
+    }
+
+    void take_reading() override {
+        readings_.push_back(hw::total_perf_counts()[event_]);
+    }
+
+    std::vector<double> measurements() override {
+        std::vector<double> diffs;
+
+        for (auto i=1ul; i<readings_.size(); ++i) {
+            diffs.push_back(readings_[i]-readings_[i-1]);
+        }
+
+        return diffs;
+    }
+};
+
+std::vector<meter_ptr> make_perf_meters(task_system_handle ts) {
+    std::vector<meter_ptr> meters;
+    if (!ts) {
+        return meters;
+    }
+
+    // Counters count the thread that opens them, so they are opened by a task
+    // bound to each thread of the pool; thread 0 is the calling thread.
+    unsigned mask = hw::open_thread_perf_counters();
+    if (!mask) {
+        return meters;
+    }
+    std::atomic<int> pending = ts->get_num_threads()-1;
+    for (int i = 1; i<ts->get_num_threads(); ++i) {
+        ts->async_on(i, {[&pending] { hw::open_thread_perf_counters(); --pending; }, 0});
+    }
+    while (pending) std::this_thread::yield();
+
+    for (unsigned e = 0; e<hw::num_perf_events; ++e) {
+        if (mask & (1u<<e)) {
+            meters.push_back(meter_ptr(new perf_meter(e)));
+        }
+    }
+    return meters;
+}
+
+} // namespace profile
+} // namespace arb
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <vector>
+
+#include <arbor/profile/meter.hpp>
+
+#include "threading/threading.hpp"
+
+namespace arb {
+namespace profile {
+
+// One meter for each hardware event counted, summed over the threads of the
+// task system; empty if hardware events can't be counted.
+std::vector<meter_ptr> make_perf_meters(task_system_handle ts);
+
+} // namespace profile
+} // namespace arb
@@ -1,11 +1,16 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <cstdio>
 #include <mutex>
 #include <ostream>
+#include <sstream>
 
 #include <arbor/context.hpp>
 #include <arbor/profile/profiler.hpp>
 
 #include "execution_context.hpp"
+#include "hardware/perf_counters.hpp"
 #include "threading/threading.hpp"
 #include "util/span.hpp"
 #include "util/rangeutil.hpp"
@@ -44,12 +49,43 @@ namespace {
     }
 }
 
-// Holds the accumulated number of calls and time spent in a region.
+// Holds the accumulated number of calls, time spent and hardware events counted in a region.
 struct profile_accumulator {
     std::size_t count=0;
     double time=0.;
+    hw::perf_counts events{};
 };
 
+// Holds the accumulated number of calls, instances and time of a mechanism method.
+struct mechanism_accumulator {
+    std::size_t count=0;
+    std::size_t instances=0;
+    double time=0.;
+};
+
+// Set by profiler_time_mechanisms; read on every mechanism method call.
+std::atomic<bool> time_mechanisms{false};
+
+// Set by profiler_count_events; read on every region entry.
+std::atomic<bool> count_events{false};
+
+// A region entered and left on one thread, for tracing.
+struct trace_event {
+    region_id_type region;
+    tick_type t0;
+    tick_type t1;
+    std::int64_t epoch;
+    std::int64_t group;
+};
+
+// Set by profiler_trace; read on every region exit.
+std::atomic<bool> tracing{false};
+
+// The epoch and cell group of the work being done on this thread, set by
+// profiler_trace_tag.
+thread_local std::int64_t trace_epoch = -1;
+thread_local std::int64_t trace_group = -1;
+
 // Records the accumulated time spent in profiler regions on one thread.
 // There is one recorder for each thread.
 class recorder {
@@ -62,13 +98,38 @@ class recorder {
 
     tick_type start_time_;
 
+    // Hardware event counts on entering the region, if counting events.
+    bool counting_ = false;
+    hw::perf_counts start_events_;
+
     // One accumulator for call count and wall time for each region.
     std::vector<profile_accumulator> accumulators_;
 
+    // One accumulator for each mechanism method.
+    std::vector<mechanism_accumulator> mechanism_accumulators_;
+
+    // Ring buffer of trace events; once full, the oldest event is at trace_next_.
+    std::vector<trace_event> trace_;
+    std::size_t trace_capacity_ = 0;
+    std::size_t trace_next_ = 0;
+
 public:
+    // Start recording at most `capacity` trace events, discarding any recorded.
+    void start_trace(std::size_t capacity);
+
+    // Return the recorded trace events, oldest first.
+    std::vector<trace_event> trace() const;
+
     // Return a list of the accumulated call count and wall times for each region.
     const std::vector<profile_accumulator>& accumulators() const;
 
+    // Return a list of the accumulated timings of each mechanism method.
+    const std::vector<mechanism_accumulator>& mechanism_accumulators() const;
+
+    // Add a call of a mechanism method that took `time` for `instances` instances.
+    // Unlike regions, these may be recorded while timing a region.
+    void record_mechanism(region_id_type index, double time, std::size_t instances);
+
     // Start timing the region with index.
     // Throws std::runtime_error if already timing a region.
     void enter(region_id_type index);
@@ -97,12 +158,22 @@ class profiler {
     // is used to index into region_names_.
     std::vector<std::string> region_names_;
 
-    // Used to protect name_index_, which is shared between all threads.
+    // Mechanism and method names of each mechanism method being recorded, and
+    // the index of each, keyed by "mechanism/method".
+    std::vector<std::pair<std::string, std::string>> mechanism_regions_;
+    std::unordered_map<std::string, region_id_type> mechanism_index_;
+
+    // Used to protect name_index_ and mechanism_index_, which are shared between all threads.
     std::mutex mutex_;
 
     // Flag to indicate whether the profiler has been initialized with the task_system
     bool init_ = false;
 
+    // The time at which tracing was last started.
+    tick_type trace_start_ = 0;
+
+    recorder* local();
+
 public:
     profiler();
 
@@ -110,8 +181,13 @@ public:
     void enter(region_id_type index);
     void enter(const char* name);
     void leave();
+    void record_mechanism(region_id_type index, double time, std::size_t instances);
+    void clear();
+    void start_trace(std::size_t capacity);
+    std::string trace_json(int pid) const;
     const std::vector<std::string>& regions() const;
     region_id_type region_index(const char* name);
+    region_id_type mechanism_region_index(const std::string& mechanism, const char* method);
     profile results() const;
 
     static profiler& get_global_profiler() {
@@ -151,24 +227,75 @@ void recorder::enter(region_id_type index) {
         accumulators_.resize(index+1);
     }
     index_ = index;
+    counting_ = count_events.load(std::memory_order_relaxed);
+    if (counting_) start_events_ = hw::thread_perf_counts();
     start_time_ = timer_type::tic();
 }
 
 void recorder::leave() {
     // calculate the elapsed time before any other steps, to increase accuracy.
-    auto delta = timer_type::toc(start_time_);
+    auto now = timer_type::tic();
+    auto delta = (now-start_time_)*default_clock::seconds_per_tick();
 
     if (index_==npos) {
         throw std::runtime_error("recorder::leave without matching recorder::enter");
     }
     accumulators_[index_].count++;
     accumulators_[index_].time += delta;
+
+    if (counting_) {
+        auto events = hw::thread_perf_counts();
+        for (auto e: make_span(0, hw::num_perf_events)) {
+            accumulators_[index_].events[e] += events[e]-start_events_[e];
+        }
+    }
+
+    if (trace_capacity_ && tracing.load(std::memory_order_relaxed)) {
+        trace_event ev{index_, start_time_, now, trace_epoch, trace_group};
+        if (trace_.size()<trace_capacity_) {
+            trace_.push_back(ev);
+        }
+        else {
+            trace_[trace_next_] = ev;
+            trace_next_ = (trace_next_+1)%trace_capacity_;
+        }
+    }
     index_ = npos;
 }
 
 void recorder::clear() {
     index_ = npos;
     accumulators_.resize(0);
+    mechanism_accumulators_.resize(0);
+    trace_.clear();
+    trace_next_ = 0;
+}
+
+void recorder::start_trace(std::size_t capacity) {
+    trace_.clear();
+    trace_.reserve(capacity);
+    trace_capacity_ = capacity;
+    trace_next_ = 0;
+}
+
+std::vector<trace_event> recorder::trace() const {
+    std::vector<trace_event> result(trace_.begin()+trace_next_, trace_.end());
+    result.insert(result.end(), trace_.begin(), trace_.begin()+trace_next_);
+    return result;
+}
+
+const std::vector<mechanism_accumulator>& recorder::mechanism_accumulators() const {
+    return mechanism_accumulators_;
+}
+
+void recorder::record_mechanism(region_id_type index, double time, std::size_t instances) {
+    if (index>=mechanism_accumulators_.size()) {
+        mechanism_accumulators_.resize(index+1);
+    }
+    auto& acc = mechanism_accumulators_[index];
+    acc.count++;
+    acc.instances += instances;
+    acc.time += time;
 }
 
 // profiler implementation
@@ -181,20 +308,76 @@ void profiler::initialize(task_system_handle& ts) {
     init_ = true;
 }
 
+// The recorder of the calling thread, or none for threads that are not of
+// the task system, such as that of a simulation in persistent run mode.
+recorder* profiler::local() {
+    auto i = thread_ids_.find(std::this_thread::get_id());
+    return i==thread_ids_.end()? nullptr: &recorders_[i->second];
+}
+
 void profiler::enter(region_id_type index) {
     if (!init_) return;
-    recorders_[thread_ids_.at(std::this_thread::get_id())].enter(index);
+    if (auto r = local()) r->enter(index);
 }
 
 void profiler::enter(const char* name) {
     if (!init_) return;
     const auto index = region_index(name);
-    recorders_[thread_ids_.at(std::this_thread::get_id())].enter(index);
+    if (auto r = local()) r->enter(index);
 }
 
 void profiler::leave() {
     if (!init_) return;
-    recorders_[thread_ids_.at(std::this_thread::get_id())].leave();
+    if (auto r = local()) r->leave();
+}
+
+void profiler::record_mechanism(region_id_type index, double time, std::size_t instances) {
+    if (!init_) return;
+    if (auto r = local()) r->record_mechanism(index, time, instances);
+}
+
+void profiler::clear() {
+    for (auto& r: recorders_) r.clear();
+}
+
+void profiler::start_trace(std::size_t capacity) {
+    for (auto& r: recorders_) r.start_trace(capacity);
+    trace_start_ = timer_type::tic();
+}
+
+// The trace events of all threads as Chrome trace event objects, separated by
+// commas, with times in microseconds since the start of the trace.
+std::string profiler::trace_json(int pid) const {
+    std::ostringstream o;
+    const double us_per_tick = 1e6*default_clock::seconds_per_tick();
+    char buf[64];
+    bool first = true;
+    for (auto tid: make_span(0, recorders_.size())) {
+        for (auto& ev: recorders_[tid].trace()) {
+            if (ev.t0<trace_start_) continue;
+            if (!first) o << ",\n";
+            first = false;
+            o << "{\"name\":\"" << region_names_[ev.region] << "\",\"ph\":\"X\""
+              << ",\"pid\":" << pid << ",\"tid\":" << tid;
+            snprintf(buf, std::size(buf), ",\"ts\":%.3f,\"dur\":%.3f",
+                (ev.t0-trace_start_)*us_per_tick, (ev.t1-ev.t0)*us_per_tick);
+            o << buf << ",\"args\":{\"epoch\":" << ev.epoch << ",\"group\":" << ev.group << "}}";
+        }
+    }
+    return o.str();
+}
+
+region_id_type profiler::mechanism_region_index(const std::string& mechanism, const char* method) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto key = mechanism + "/" + method;
+    auto it = mechanism_index_.find(key);
+    if (it==mechanism_index_.end()) {
+        const auto index = mechanism_regions_.size();
+        mechanism_index_[key] = index;
+        mechanism_regions_.emplace_back(mechanism, method);
+        return index;
+    }
+    return it->second;
 }
 
 region_id_type profiler::region_index(const char* name) {
@@ -239,16 +422,57 @@ profile profiler::results() const {
 
     p.times = std::vector<double>(nregions);
     p.counts = std::vector<region_id_type>(nregions);
-    for (auto& r: recorders_) {
-        auto& accumulators = r.accumulators();
+    p.thread_times = std::vector<std::vector<double>>(nregions, std::vector<double>(recorders_.size()));
+    for (auto t: make_span(0, recorders_.size())) {
+        auto& accumulators = recorders_[t].accumulators();
         for (auto i: make_span(0, accumulators.size())) {
             p.times[i]  += accumulators[i].time;
             p.counts[i] += accumulators[i].count;
+            p.thread_times[i][t] = accumulators[i].time;
         }
     }
 
     p.num_threads = recorders_.size();
 
+    // Events are reported if any were counted in any region.
+    hw::perf_counts total{};
+    for (auto& r: recorders_) {
+        for (auto& a: r.accumulators()) {
+            for (auto e: make_span(0, hw::num_perf_events)) total[e] += a.events[e];
+        }
+    }
+    std::vector<unsigned> counted;
+    for (auto e: make_span(0u, unsigned(hw::num_perf_events))) {
+        if (total[e]) {
+            counted.push_back(e);
+            p.event_names.push_back(hw::perf_event_name(e));
+        }
+    }
+    if (!counted.empty()) {
+        p.events = std::vector<std::vector<std::uint64_t>>(nregions, std::vector<std::uint64_t>(counted.size()));
+        for (auto& r: recorders_) {
+            auto& accumulators = r.accumulators();
+            for (auto i: make_span(0, accumulators.size())) {
+                for (auto j: make_span(0, counted.size())) {
+                    p.events[i][j] += accumulators[i].events[counted[j]];
+                }
+            }
+        }
+    }
+
+    for (auto i: make_span(0, mechanism_regions_.size())) {
+        mechanism_timing t{mechanism_regions_[i].first, mechanism_regions_[i].second, 0, 0, 0.};
+        for (auto& r: recorders_) {
+            auto& accumulators = r.mechanism_accumulators();
+            if (i<accumulators.size()) {
+                t.calls     += accumulators[i].count;
+                t.instances += accumulators[i].instances;
+                t.time      += accumulators[i].time;
+            }
+        }
+        if (t.calls) p.mechanisms.push_back(std::move(t));
+    }
+
     return p;
 }
 
@@ -347,6 +571,133 @@ void profiler_initialize(context& ctx) {
     profiler::get_global_profiler().initialize(ctx->thread_pool);
 }
 
+void profiler_clear() {
+    profiler::get_global_profiler().clear();
+}
+
+void profiler_trace(bool on, std::size_t capacity) {
+    if (on) profiler::get_global_profiler().start_trace(capacity);
+    tracing = on;
+}
+
+void profiler_trace_tag(std::int64_t epoch, std::int64_t group) {
+    trace_epoch = epoch;
+    trace_group = group;
+}
+
+void profiler_write_trace(std::ostream& o, const context& ctx) {
+    auto& dist = ctx->distributed;
+    auto events = dist->gather(profiler::get_global_profiler().trace_json(dist->id()), 0);
+    if (dist->id()!=0) return;
+
+    o << "{\"traceEvents\":[\n";
+    bool first = true;
+    for (auto& e: events) {
+        if (e.empty()) continue;
+        if (!first) o << ",\n";
+        first = false;
+        o << e;
+    }
+    o << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+void profiler_count_events(bool on) {
+    count_events = on;
+}
+
+void profiler_time_mechanisms(bool on) {
+    time_mechanisms = on;
+}
+
+bool profiler_mechanism_timing() {
+    return time_mechanisms.load(std::memory_order_relaxed);
+}
+
+region_id_type profiler_mechanism_region_id(const std::string& mechanism, const char* method) {
+    return profiler::get_global_profiler().mechanism_region_index(mechanism, method);
+}
+
+void profiler_record_mechanism(region_id_type region_id, double time, std::size_t instances) {
+    profiler::get_global_profiler().record_mechanism(region_id, time, instances);
+}
+
+// Print the timings of mechanism methods, grouped by mechanism in descending
+// order of time taken; percentages are relative to the total time in mechanisms.
+void print_mechanisms(std::ostream& o, const profile& prof) {
+    char buf[128];
+
+    std::vector<std::string> names;
+    std::unordered_map<std::string, double> total;
+    double time = 0;
+    for (auto& t: prof.mechanisms) {
+        if (!total.count(t.mechanism)) names.push_back(t.mechanism);
+        total[t.mechanism] += t.time;
+        time += t.time;
+    }
+    util::sort_by(names, [&](const std::string& n) { return -total[n]; });
+
+    snprintf(buf, std::size(buf), "_p_ %-20s%12s%12s%12s%12s%8s", "MECHANISM", "CALLS", "INSTANCES", "THREAD", "WALL", "\%");
+    o << "\n" << buf;
+    for (auto& name: names) {
+        double t = total[name];
+        snprintf(buf, std::size(buf), "_p_ %-20s%12s%12s%12.3f%12.3f%8.1f",
+               name.c_str(), "-", "-", t, t/prof.num_threads, t/time*100);
+        o << "\n" << buf;
+
+        std::vector<const mechanism_timing*> methods;
+        for (auto& m: prof.mechanisms) {
+            if (m.mechanism==name) methods.push_back(&m);
+        }
+        util::sort_by(methods, [](const mechanism_timing* m) { return -m->time; });
+        for (auto m: methods) {
+            auto method = "  " + m->method;
+            snprintf(buf, std::size(buf), "_p_ %-20s%12lu%12lu%12.3f%12.3f%8.1f",
+                   method.c_str(), m->calls, m->instances, m->time, m->time/prof.num_threads, m->time/time*100);
+            o << "\n" << buf;
+        }
+    }
+}
+
+// Print the hardware events counted in each region in descending order of time
+// taken, with the instructions per cycle if both were counted.
+void print_events(std::ostream& o, const profile& prof) {
+    char buf[64];
+
+    auto find = [&](const char* name) {
+        auto it = std::find(prof.event_names.begin(), prof.event_names.end(), name);
+        return it==prof.event_names.end()? -1: int(it-prof.event_names.begin());
+    };
+    int cycles = find("cycles");
+    int instructions = find("instructions");
+    bool ipc = cycles>=0 && instructions>=0;
+
+    snprintf(buf, std::size(buf), "_p_ %-32s", "REGION");
+    o << "\n" << buf;
+    for (auto name: prof.event_names) {
+        std::transform(name.begin(), name.end(), name.begin(), [](char c) { return std::toupper(c); });
+        snprintf(buf, std::size(buf), "%16s", name.c_str());
+        o << buf;
+    }
+    if (ipc) o << "     IPC";
+
+    std::vector<std::size_t> order = util::assign_from(make_span(0, prof.names.size()));
+    util::sort_by(order, [&](std::size_t i) { return -prof.times[i]; });
+    for (auto i: order) {
+        if (!prof.counts[i]) continue;
+        snprintf(buf, std::size(buf), "_p_ %-32s", prof.names[i].c_str());
+        o << "\n" << buf;
+        for (auto n: prof.events[i]) {
+            snprintf(buf, std::size(buf), "%16llu", (unsigned long long)n);
+            o << buf;
+        }
+        if (ipc) {
+            auto c = prof.events[i][cycles];
+            snprintf(buf, std::size(buf), "%8.2f", c? double(prof.events[i][instructions])/c: 0.);
+            o << buf;
+        }
+    }
+}
+
 // Print profiler statistics to an ostream
 std::ostream& operator<<(std::ostream& o, const profile& prof) {
     char buf[80];
@@ -356,6 +707,14 @@ std::ostream& operator<<(std::ostream& o, const profile& prof) {
     snprintf(buf, std::size(buf), "_p_ %-20s%12s%12s%12s%8s", "REGION", "CALLS", "THREAD", "WALL", "\%");
     o << buf;
     print(o, tree, tree.time, prof.num_threads, 0, "");
+    if (!prof.mechanisms.empty()) {
+        o << "\n";
+        print_mechanisms(o, prof);
+    }
+    if (!prof.event_names.empty()) {
+        o << "\n";
+        print_events(o, prof);
+    }
     return o;
 }
 
@@ -367,11 +726,21 @@ profile profiler_summary() {
 
 void profiler_leave() {}
 void profiler_enter(region_id_type) {}
+void profiler_initialize(context&) {}
+void profiler_clear() {}
+void profiler_trace(bool, std::size_t) {}
+void profiler_trace_tag(std::int64_t, std::int64_t) {}
+void profiler_write_trace(std::ostream&, const context&) {}
 profile profiler_summary();
 void profiler_print(const profile& prof, float threshold) {};
 profile profiler_summary() {return profile();}
 region_id_type profiler_region_id(const char*) {return 0;}
 std::ostream& operator<<(std::ostream& o, const profile&) {return o;}
+void profiler_time_mechanisms(bool) {}
+void profiler_count_events(bool) {}
+bool profiler_mechanism_timing() {return false;}
+region_id_type profiler_mechanism_region_id(const std::string&, const char*) {return 0;}
+void profiler_record_mechanism(region_id_type, double, std::size_t) {}
 
 #endif // ARB_HAVE_PROFILING
 
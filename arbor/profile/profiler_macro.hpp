@@ -14,10 +14,14 @@
     // leave a profling region
     #define PL arb::profile::profiler_leave
 
+    // tag the regions subsequently entered on this thread for tracing
+    #define PT(epoch, group) arb::profile::profiler_trace_tag(epoch, group)
+
 #else
 
     #define PE(name)
     #define PL()
+    #define PT(epoch, group)
 
 #endif
 
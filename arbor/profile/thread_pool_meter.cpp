@@ -0,0 +1,94 @@
+#include <string>
+#include <vector>
+
+#include <arbor/profile/meter.hpp>
+
+#include "threading/threading.hpp"
+#include "thread_pool_meter.hpp"
+
+namespace arb {
+namespace profile {
+
+// Time spent by the threads of a task system waiting for tasks of task
+// groups to complete, without running a task themselves, summed over the
+// threads.
+
+class wait_meter: public meter {
+    task_system_handle ts_;
+    std::vector<double> readings_;
+
+public:
+    explicit wait_meter(task_system_handle ts): ts_(std::move(ts)) {}
+
+    std::string name() override {
+        return "wait";
+    }
+
+    std::string units() override {
+        return "s";
+    }
+
+    void take_reading() override {
+        readings_.push_back(ts_->wait_time());
+    }
+
+    std::vector<double> measurements() override {
+        std::vector<double> diffs;
+
+        for (auto i=1ul; i<readings_.size(); ++i) {
+            diffs.push_back(readings_[i]-readings_[i-1]);
+        }
+
+        return diffs;
+    }
+};
+
+meter_ptr make_wait_meter(task_system_handle ts) {
+    if (!ts) {
+        return nullptr;
+    }
+    return meter_ptr(new wait_meter(std::move(ts)));
+}
+
+// Number of tasks with a preferred thread, such as cell group updates, that
+// were run by another thread.
+
+class migration_meter: public meter {
+    task_system_handle ts_;
+    std::vector<std::size_t> readings_;
+
+public:
+    explicit migration_meter(task_system_handle ts): ts_(std::move(ts)) {}
+
+    std::string name() override {
+        return "migrations";
+    }
+
+    std::string units() override {
+        return "";
+    }
+
+    void take_reading() override {
+        readings_.push_back(ts_->migrations());
+    }
+
+    std::vector<double> measurements() override {
+        std::vector<double> diffs;
+
+        for (auto i=1ul; i<readings_.size(); ++i) {
+            diffs.push_back(readings_[i]-readings_[i-1]);
+        }
+
+        return diffs;
+    }
+};
+
+meter_ptr make_migration_meter(task_system_handle ts) {
+    if (!ts) {
+        return nullptr;
+    }
+    return meter_ptr(new migration_meter(std::move(ts)));
+}
+
+} // namespace profile
+} // namespace arb
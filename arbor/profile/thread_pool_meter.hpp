@@ -0,0 +1,14 @@
+#pragma once
+
+#include <arbor/profile/meter.hpp>
+
+#include "threading/threading.hpp"
+
+namespace arb {
+namespace profile {
+
+meter_ptr make_wait_meter(task_system_handle ts);
+meter_ptr make_migration_meter(task_system_handle ts);
+
+} // namespace profile
+} // namespace arb
@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <Random123/threefry.h>
+#include <Random123/uniform.hpp>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/random_projection.hpp>
+
+#include "util/strprintf.hpp"
+
+namespace arb {
+
+// Number of target gids drawn from one random stream.
+static constexpr cell_gid_type block_size = 1024;
+
+random_projection::random_projection(
+    cell_gid_type source_begin, cell_gid_type source_end, cell_local_label_type source,
+    cell_gid_type target_begin, cell_gid_type target_end, cell_local_label_type target,
+    double probability, float weight, float delay, std::uint64_t seed):
+    procedural_projection(source_begin, source_end, std::move(source),
+                          target_begin, target_end, std::move(target)),
+    probability_(probability), weight_(weight), delay_(delay), seed_(seed)
+{
+    if (!(probability>=0 && probability<=1)) {
+        throw arbor_exception(util::pprintf("random_projection: probability {} not in [0, 1]", probability));
+    }
+}
+
+void random_projection::connections_from(
+    cell_gid_type source_gid, cell_gid_type first, cell_gid_type last,
+    std::vector<procedural_connection>& out) const
+{
+    using cbrng = r123::Threefry2x64;
+
+    first = std::max(first, target_begin);
+    last = std::min(last, target_end);
+    if (first>=last || probability_==0) return;
+
+    if (probability_==1) {
+        for (auto gid = first; gid<last; ++gid) {
+            out.push_back({gid, weight_, delay_});
+        }
+        return;
+    }
+
+    const double log_q = std::log1p(-probability_);
+    const cbrng::key_type key = {{seed_, 0}};
+    cbrng g;
+
+    // Each block is generated in full and clipped to [first, last), so that
+    // the connections do not depend on how the targets are split up.
+    for (auto b = (first-target_begin)/block_size; b*block_size<last-target_begin; ++b) {
+        const cell_gid_type block_first = target_begin + b*block_size;
+        const cell_gid_type n = std::min(block_size, target_end-block_first);
+
+        cbrng::ctr_type ctr = {{(std::uint64_t(source_gid)<<32) | b, 0}};
+        cbrng::ctr_type r;
+        unsigned k = 2;
+
+        double pos = -1;
+        for (;;) {
+            if (k==2) {
+                r = g(ctr, key);
+                ++ctr[1];
+                k = 0;
+            }
+            // u01 is never 0, so the gap is finite.
+            double gap = std::floor(std::log(r123::u01<double>(r[k++]))/log_q);
+            pos += 1+gap;
+            if (pos>=n) break;
+
+            auto gid = block_first + cell_gid_type(pos);
+            if (gid>=first && gid<last) {
+                out.push_back({gid, weight_, delay_});
+            }
+        }
+    }
+}
+
+} // namespace arb
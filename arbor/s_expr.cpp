@@ -363,6 +363,56 @@ private:
 // s expression members
 //
 
+static const token nil_token{{0,0}, tok::nil, "()"};
+
+s_expr::s_expr(const s_expr& other) {
+    const s_expr* src = &other;
+    s_expr* dst = this;
+    while (!src->is_atom()) {
+        dst->state = pair_type(src->head(), s_expr());
+        src = &src->tail();
+        dst = &dst->tail();
+    }
+    dst->state = src->atom();
+}
+
+s_expr::s_expr(s_expr&& other) noexcept:
+    state(std::move(other.state))
+{
+    other.state = nil_token;
+}
+
+s_expr& s_expr::operator=(const s_expr& other) {
+    if (this!=&other) {
+        // Copy first: other may be a part of this expression.
+        *this = s_expr(other);
+    }
+    return *this;
+}
+
+s_expr& s_expr::operator=(s_expr&& other) noexcept {
+    if (this!=&other) {
+        // Keep the old state alive until the assignment is complete, as
+        // other may be a part of it; it is then destroyed iteratively.
+        s_expr old;
+        old.state = std::move(state);
+        state = std::move(other.state);
+        other.state = nil_token;
+    }
+    return *this;
+}
+
+s_expr::~s_expr() {
+    // Detach the tail of each pair in turn before it is destroyed.
+    auto detach_tail = [](s_expr& e) {
+        auto p = std::get_if<pair_type>(&e.state);
+        return p? std::move(p->tail.state): nullptr;
+    };
+    for (auto tail = detach_tail(*this); tail;) {
+        tail = detach_tail(*tail);
+    }
+}
+
 bool s_expr::is_atom() const {
     return state.index()==0;
 }
@@ -426,20 +476,21 @@ std::ostream& operator<<(std::ostream& o, const s_expr& x) {
 }
 
 std::size_t length(const s_expr& l) {
-    // The length of an atom is 1.
-    if (l.is_atom() && l) {
-        return 1;
+    std::size_t n = 0;
+    const s_expr* e = &l;
+    for (; !e->is_atom(); e = &e->tail()) {
+        ++n;
     }
-    // nil marks the end of a list.
-    if (!l) {
-        return 0u;
-    }
-    return 1+length(l.tail());
+    // nil marks the end of a list; any other atom has length 1.
+    return *e? n+1: n;
 }
 
 src_location location(const s_expr& l) {
-    if (l.is_atom()) return l.atom().loc;
-    return location(l.head());
+    const s_expr* e = &l;
+    while (!e->is_atom()) {
+        e = &e->head();
+    }
+    return e->atom().loc;
 }
 
 //
@@ -450,54 +501,57 @@ namespace impl {
 
 // If there is a parsing error, then an atom with kind==tok::error is returned
 // with the error string in its spelling.
+//
+// Lists are built in place without recursion: `open` holds, for each list
+// not yet closed, the node to be filled by its next element.
 s_expr parse(lexer& L) {
-    using namespace std::string_literals;
-
-    s_expr node;
-    auto t = L.current();
-
-    if (t.kind==tok::lparen) {
-        t = L.next();
-        s_expr* n = &node;
-        while (true) {
-            if (t.kind == tok::eof) {
-                return token{t.loc, tok::error,
-                    "Unexpected end of input. Missing a closing parenthesis ')'."};
-            }
-            if (t.kind == tok::error) {
-                return t;
-            }
-            else if (t.kind == tok::rparen) {
-                *n = token{t.loc, tok::nil, "nil"};
-                t = L.next();
-                break;
-            }
-            else if (t.kind == tok::lparen) {
-                auto e = parse(L);
-                if (e.is_atom() && e.atom().kind==tok::error) return e;
-                *n = {std::move(e), {}};
-                t = L.current();
-            }
-            else {
-                *n = {s_expr(t), {}};
-                t = L.next();
-            }
-
-            n = &n->tail();
-        }
-    }
-    else if (t.kind==tok::eof) {
-        return token{t.loc, tok::error, "Empty expression."};
+    const token& first = L.current();
+    if (first.kind==tok::eof) {
+        return token{first.loc, tok::error, "Empty expression."};
     }
-    else if (t.kind==tok::rparen) {
-        return token{t.loc, tok::error, "Missing opening parenthesis'('."};
+    else if (first.kind==tok::rparen) {
+        return token{first.loc, tok::error, "Missing opening parenthesis'('."};
     }
     // an atom or an error
-    else {
+    else if (first.kind!=tok::lparen) {
+        token t = first;
         L.next(); // advance the lexer to the next token
         return t;
     }
 
+    s_expr node;
+    std::vector<s_expr*> open = {&node};
+    L.next();
+    while (!open.empty()) {
+        const token& t = L.current();
+        s_expr* n = open.back();
+
+        if (t.kind == tok::eof) {
+            return token{t.loc, tok::error,
+                "Unexpected end of input. Missing a closing parenthesis ')'."};
+        }
+        else if (t.kind == tok::error) {
+            return t;
+        }
+        else if (t.kind == tok::rparen) {
+            *n = token{t.loc, tok::nil, "nil"};
+            open.pop_back();
+            // The closed list is the head of the next node in its parent.
+            if (!open.empty()) {
+                open.back() = &open.back()->tail();
+            }
+        }
+        else if (t.kind == tok::lparen) {
+            *n = {s_expr(), s_expr()};
+            open.push_back(&n->head());
+        }
+        else {
+            *n = {s_expr(t), s_expr()};
+            open.back() = &n->tail();
+        }
+        L.next();
+    }
+
     return node;
 }
 
@@ -0,0 +1,140 @@
+#include <cstring>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/cable_cell.hpp>
+#include <arbor/sample_writer.hpp>
+#include <arbor/sampling.hpp>
+#include <arbor/util/any_ptr.hpp>
+
+#include "io/async_file.hpp"
+
+namespace arb {
+
+// Samples are serialized into the staging buffer of an asynchronous file
+// by the sampler callbacks, one block per call.
+
+struct sample_writer::impl {
+    io::async_file<bad_sample_file> file;
+
+    impl(const std::string& path, std::size_t buffer_size):
+        file(path, buffer_size, sample_file_magic, sizeof sample_file_magic)
+    {}
+
+    // Append a block with the times and `width` values per sample given by
+    // the callbacks `time(i)` and `row(i)`.
+    template <typename Time, typename Row>
+    void append(probe_metadata pm, std::size_t n, std::size_t width, Time time, Row row) {
+        static_assert(sizeof(time_type)==sizeof(double), "sample times are stored as double");
+
+        sample_block_header h{n, width, pm.id.gid, pm.id.index, pm.index, pm.tag};
+        std::size_t bytes = sizeof h + n*(width+1)*sizeof(double);
+
+        file.append(bytes, [&](char* p) {
+            std::memcpy(p, &h, sizeof h);
+            p += sizeof h;
+            for (std::size_t i = 0; i<n; ++i) {
+                double t = time(i);
+                std::memcpy(p, &t, sizeof t);
+                p += sizeof t;
+            }
+            for (std::size_t i = 0; i<n; ++i) {
+                std::memcpy(p, row(i), width*sizeof(double));
+                p += width*sizeof(double);
+            }
+        });
+    }
+};
+
+sample_writer::sample_writer(const std::string& path, std::size_t buffer_size):
+    impl_(new impl(path, buffer_size))
+{}
+
+sample_writer::~sample_writer() = default;
+
+void sample_writer::write(probe_metadata pm, const sample_matrix& m) {
+    impl_->append(pm, m.n_sample, m.width,
+        [&m](std::size_t i) { return m.time(i); },
+        [&m](std::size_t i) { return m.row(i); });
+}
+
+void sample_writer::write(probe_metadata pm, std::size_t n, const sample_record* records) {
+    if (!n) return;
+
+    auto time = [records](std::size_t i) { return records[i].time; };
+
+    if (util::any_cast<const double*>(records[0].data)) {
+        for (std::size_t i = 1; i<n; ++i) {
+            if (!util::any_cast<const double*>(records[i].data)) {
+                throw bad_sample_file("mixed sample types in one sampler call");
+            }
+        }
+
+        impl_->append(pm, n, 1, time,
+            [records](std::size_t i) { return util::any_cast<const double*>(records[i].data); });
+    }
+    else if (auto r = util::any_cast<const cable_sample_range*>(records[0].data)) {
+        std::size_t width = r->second-r->first;
+        for (std::size_t i = 1; i<n; ++i) {
+            auto r = util::any_cast<const cable_sample_range*>(records[i].data);
+            if (!r || std::size_t(r->second-r->first)!=width) {
+                throw bad_sample_file("samples of varying type or width in one sampler call");
+            }
+        }
+
+        impl_->append(pm, n, width, time,
+            [records](std::size_t i) { return util::any_cast<const cable_sample_range*>(records[i].data)->first; });
+    }
+    else {
+        throw bad_sample_file("unsupported sample type");
+    }
+}
+
+matrix_sampler_function sample_writer::matrix_sampler() {
+    return [this](probe_metadata pm, const sample_matrix& m) { write(pm, m); };
+}
+
+sampler_function sample_writer::sampler() {
+    return [this](probe_metadata pm, std::size_t n, const sample_record* records) { write(pm, n, records); };
+}
+
+void sample_writer::flush() {
+    impl_->file.flush();
+}
+
+std::vector<sample_block> read_samples(std::istream& in) {
+    auto read = [&in](void* p, std::size_t n) {
+        if (!in.read(static_cast<char*>(p), n)) {
+            throw bad_sample_file("unexpected end of file");
+        }
+    };
+
+    char magic[sizeof sample_file_magic];
+    read(magic, sizeof magic);
+    if (std::memcmp(magic, sample_file_magic, sizeof magic)) {
+        throw bad_sample_file("not a sample file");
+    }
+
+    std::vector<sample_block> blocks;
+    sample_block_header h;
+    while (in.peek()!=std::istream::traits_type::eof()) {
+        read(&h, sizeof h);
+
+        sample_block b;
+        b.id = {h.gid, h.lid};
+        b.tag = h.tag;
+        b.index = h.index;
+        b.width = h.width;
+        b.times.resize(h.n_sample);
+        b.values.resize(h.n_sample*h.width);
+        read(b.times.data(), b.times.size()*sizeof(time_type));
+        read(b.values.data(), b.values.size()*sizeof(double));
+
+        blocks.push_back(std::move(b));
+    }
+    return blocks;
+}
+
+} // namespace arb
@@ -3,7 +3,7 @@
 // Helper classes for managing sampler/schedule associations in
 // cell group classes (see sampling_api doc).
 
-#include <unordered_map>
+#include <optional>
 #include <vector>
 
 #include <arbor/common_types.hpp>
@@ -13,15 +13,16 @@
 namespace arb {
 
 // An association between a samplers, schedule, and set of probe ids, as provided
-// to e.g. `model::add_sampler()`.
+// to e.g. `model::add_sampler()`. Exactly one of `sampler` and `matrix_sampler`
+// is set. Triggered samplers have a window, and an empty schedule.
 
 struct sampler_association {
     schedule sched;
     sampler_function sampler;
+    matrix_sampler_function matrix_sampler;
     std::vector<cell_member_type> probe_ids;
     sampling_policy policy;
+    std::optional<sampling_window> window;
 };
 
-using sampler_association_map = std::unordered_map<sampler_association_handle, sampler_association>;
-
 } // namespace arb
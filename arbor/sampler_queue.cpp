@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/cable_cell.hpp>
+#include <arbor/sampling.hpp>
+#include <arbor/util/any_ptr.hpp>
+
+#include "sampler_queue.hpp"
+
+namespace arb {
+
+sampler_queue::sampler_queue(unsigned n_threads, std::size_t capacity) {
+    if (!n_threads || !capacity) {
+        throw arbor_exception("sampler queue requires at least one thread and a positive capacity");
+    }
+
+    lane_capacity_ = std::max<std::size_t>(1, capacity/n_threads);
+    for (unsigned i = 0; i<n_threads; ++i) {
+        lanes_.push_back(std::make_unique<lane>());
+        auto& l = *lanes_.back();
+        l.consumer = std::thread([&l] { run(l); });
+    }
+}
+
+sampler_queue::~sampler_queue() {
+    for (auto& l: lanes_) {
+        {
+            std::lock_guard<std::mutex> lock(l->mex);
+            l->done = true;
+        }
+        l->cv.notify_all();
+    }
+    for (auto& l: lanes_) l->consumer.join();
+}
+
+sampler_function sampler_queue::wrap(sampler_function f) {
+    auto fn = std::make_shared<const sampler_function>(std::move(f));
+    return [this, fn](probe_metadata pm, std::size_t n, const sample_record* records) {
+        if (!n) return;
+
+        // Samples are copied as rows of doubles; samplers of probes with
+        // samples of any other type are called in place.
+        block b;
+        if (util::any_cast<const double*>(records[0].data)) {
+            b.width = 1;
+            for (std::size_t i = 0; i<n; ++i) {
+                auto p = util::any_cast<const double*>(records[i].data);
+                if (!p) return (*fn)(pm, n, records);
+                b.times.push_back(records[i].time);
+                b.values.push_back(*p);
+            }
+        }
+        else if (auto r = util::any_cast<const cable_sample_range*>(records[0].data)) {
+            b.ranges = true;
+            b.width = r->second-r->first;
+            for (std::size_t i = 0; i<n; ++i) {
+                auto r = util::any_cast<const cable_sample_range*>(records[i].data);
+                if (!r || std::size_t(r->second-r->first)!=b.width) return (*fn)(pm, n, records);
+                b.times.push_back(records[i].time);
+                b.values.insert(b.values.end(), r->first, r->second);
+            }
+        }
+        else {
+            return (*fn)(pm, n, records);
+        }
+
+        b.sampler = fn;
+        b.meta = pm;
+        b.n_sample = n;
+        push(std::move(b));
+    };
+}
+
+matrix_sampler_function sampler_queue::wrap(matrix_sampler_function f) {
+    auto fn = std::make_shared<const matrix_sampler_function>(std::move(f));
+    return [this, fn](probe_metadata pm, const sample_matrix& m) {
+        block b;
+        b.matrix_sampler = fn;
+        b.meta = pm;
+        b.n_sample = m.n_sample;
+        b.width = m.width;
+        b.times.reserve(m.n_sample);
+        b.values.reserve(m.n_sample*m.width);
+        for (std::size_t i = 0; i<m.n_sample; ++i) {
+            b.times.push_back(m.time(i));
+            b.values.insert(b.values.end(), m.row(i), m.row(i)+m.width);
+        }
+        push(std::move(b));
+    };
+}
+
+void sampler_queue::flush() {
+    std::exception_ptr error;
+    for (auto& l: lanes_) {
+        std::unique_lock<std::mutex> lock(l->mex);
+        l->cv.wait(lock, [&l] { return l->blocks.empty() && !l->busy; });
+        if (!error) error = l->error;
+        l->error = nullptr;
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+sampler_queue::lane& sampler_queue::lane_of(const probe_metadata& meta) {
+    auto h = std::hash<cell_member_type>{}(meta.id)^(std::size_t(meta.index)*0x9e3779b97f4a7c15ull);
+    return *lanes_[h%lanes_.size()];
+}
+
+void sampler_queue::push(block b) {
+    auto& l = lane_of(b.meta);
+    {
+        std::unique_lock<std::mutex> lock(l.mex);
+        l.cv.wait(lock, [&] { return l.blocks.size()<lane_capacity_; });
+        l.blocks.push_back(std::move(b));
+    }
+    l.cv.notify_all();
+}
+
+void sampler_queue::run(lane& l) {
+    std::unique_lock<std::mutex> lock(l.mex);
+    for (;;) {
+        l.cv.wait(lock, [&l] { return !l.blocks.empty() || l.done; });
+        if (l.blocks.empty()) return;
+
+        block b = std::move(l.blocks.front());
+        l.blocks.pop_front();
+        l.busy = true;
+        l.cv.notify_all();
+
+        lock.unlock();
+        try {
+            call(b);
+        }
+        catch (...) {
+            lock.lock();
+            if (!l.error) l.error = std::current_exception();
+            lock.unlock();
+        }
+
+        lock.lock();
+        l.busy = false;
+        l.cv.notify_all();
+    }
+}
+
+void sampler_queue::call(const block& b) {
+    const time_type* times = b.times.data();
+    const double* values = b.values.data();
+
+    if (b.matrix_sampler) {
+        (*b.matrix_sampler)(b.meta, sample_matrix{b.n_sample, b.width, times, 1, values, b.width});
+        return;
+    }
+
+    std::vector<sample_record> records;
+    std::vector<cable_sample_range> ranges;
+    records.reserve(b.n_sample);
+    if (b.ranges) {
+        ranges.reserve(b.n_sample);
+        for (std::size_t i = 0; i<b.n_sample; ++i) {
+            ranges.push_back({values+i*b.width, values+(i+1)*b.width});
+        }
+        const auto& cranges = ranges;
+        for (std::size_t i = 0; i<b.n_sample; ++i) {
+            records.push_back(sample_record{times[i], &cranges[i]});
+        }
+    }
+    else {
+        for (std::size_t i = 0; i<b.n_sample; ++i) {
+            records.push_back(sample_record{times[i], values+i});
+        }
+    }
+    (*b.sampler)(b.meta, b.n_sample, records.data());
+}
+
+} // namespace arb
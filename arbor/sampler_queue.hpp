@@ -0,0 +1,75 @@
+#pragma once
+
+// Asynchronous delivery of samples to sampler callbacks.
+//
+// A sampler function wrapped by a sampler_queue copies the samples of each
+// call into a block, which it appends to the queue of one of a number of
+// consumer threads; the consumer then makes the call with the copy. The
+// cell group that samples thus only waits if that queue is full. All calls
+// for one probe are made by the same consumer, in order.
+//
+// The metadata passed to the callbacks are views onto the cell groups, so
+// the queue must be flushed before the cell groups are modified or
+// destroyed. Exceptions thrown by callbacks are rethrown by flush().
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <arbor/sampling.hpp>
+
+namespace arb {
+
+class sampler_queue {
+public:
+    // Deliver samples on `n_threads` threads, with at most `capacity`
+    // calls pending in total.
+    sampler_queue(unsigned n_threads, std::size_t capacity);
+    ~sampler_queue();
+
+    sampler_queue(const sampler_queue&) = delete;
+    sampler_queue& operator=(const sampler_queue&) = delete;
+
+    sampler_function wrap(sampler_function f);
+    matrix_sampler_function wrap(matrix_sampler_function f);
+
+    // Wait until all pending calls have been made.
+    void flush();
+
+private:
+    struct block {
+        std::shared_ptr<const sampler_function> sampler;
+        std::shared_ptr<const matrix_sampler_function> matrix_sampler;
+        probe_metadata meta;
+        bool ranges = false;  // samples are cable_sample_ranges, else doubles
+        std::size_t n_sample = 0;
+        std::size_t width = 0;
+        std::vector<time_type> times;
+        std::vector<double> values;
+    };
+
+    struct lane {
+        std::mutex mex;
+        std::condition_variable cv;
+        std::deque<block> blocks;
+        bool busy = false;   // consumer is making a call
+        bool done = false;   // consumer should exit
+        std::exception_ptr error;
+        std::thread consumer;
+    };
+
+    std::size_t lane_capacity_;
+    std::vector<std::unique_ptr<lane>> lanes_;
+
+    lane& lane_of(const probe_metadata& meta);
+    void push(block b);
+    static void run(lane& l);
+    static void call(const block& b);
+};
+
+} // namespace arb
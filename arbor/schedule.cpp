@@ -15,13 +15,15 @@ namespace arb {
 
 time_event_span regular_schedule_impl::events(time_type t0, time_type t1) {
     times_.clear();
+    append_events(t0, t1, times_);
+    return as_time_event_span(times_);
+}
 
+void regular_schedule_impl::append_events(time_type t0, time_type t1, std::vector<time_type>& out) const {
     t0 = std::max(t0, t0_);
     t1 = std::min(t1, t1_);
 
     if (t1>t0) {
-        times_.reserve(1+std::size_t((t1-t0)*oodt_));
-
         long long n = t0*oodt_;
         time_type t = n*dt_;
 
@@ -30,12 +32,10 @@ time_event_span regular_schedule_impl::events(time_type t0, time_type t1) {
         }
 
         while (t<t1) {
-            times_.push_back(t);
+            out.push_back(t);
             t = (++n)*dt_;
         }
     }
-
-    return as_time_event_span(times_);
 }
 
 // Explicit schedule implementation.
@@ -1,26 +1,53 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <random>
 #include <set>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include <arbor/arbexcept.hpp>
+#include <arbor/cable_cell.hpp>
 #include <arbor/context.hpp>
 #include <arbor/domain_decomposition.hpp>
 #include <arbor/generic_event.hpp>
+#include <arbor/profile/profiler.hpp>
+#include <arbor/profile/timer.hpp>
 #include <arbor/recipe.hpp>
 #include <arbor/schedule.hpp>
 #include <arbor/simulation.hpp>
+#include <arbor/util/scope_exit.hpp>
 
 #include "cell_group.hpp"
 #include "cell_group_factory.hpp"
 #include "communication/communicator.hpp"
+#include "event_buffer.hpp"
+#include "event_calendar.hpp"
+#include "event_sort.hpp"
 #include "execution_context.hpp"
+#include "io/serialize.hpp"
 #include "merge_events.hpp"
+#include "sampler_queue.hpp"
 #include "thread_private_spike_store.hpp"
 #include "threading/threading.hpp"
 #include "util/filter.hpp"
 #include "util/maputil.hpp"
 #include "util/partition.hpp"
+#include "util/rangeutil.hpp"
 #include "util/span.hpp"
+#include "util/strprintf.hpp"
 #include "profile/profiler_macro.hpp"
 
 namespace arb {
@@ -52,6 +79,17 @@ void merge_cell_events(
     if (!generators.empty()) {
         PE(communication_enqueue_setup);
         // Tree-merge events in [t_from, t_to) from old, pending and generator events.
+        // The events of all generators are collected in one buffer of the
+        // thread, and the bounds of the events of each recorded.
+
+        thread_local static pse_vector generated;
+        thread_local static std::vector<std::size_t> generated_divs;
+        generated.clear();
+        generated_divs.assign(1, 0);
+        for (auto& g: generators) {
+            g.append_events(t_from, t_to, generated);
+            generated_divs.push_back(generated.size());
+        }
 
         std::vector<event_span> spanbuf;
         spanbuf.reserve(2+generators.size());
@@ -62,10 +100,9 @@ void merge_cell_events(
         spanbuf.push_back(old_split.first);
         spanbuf.push_back(pending_split.first);
 
-        for (auto& g: generators) {
-            event_span evs = g.events(t_from, t_to);
-            if (!evs.empty()) {
-                spanbuf.push_back(evs);
+        for (std::size_t i = 0; i+1<generated_divs.size(); ++i) {
+            if (generated_divs[i]!=generated_divs[i+1]) {
+                spanbuf.push_back({generated.data()+generated_divs[i], generated.data()+generated_divs[i+1]});
             }
         }
         PL();
@@ -91,31 +128,141 @@ class simulation_state {
 public:
     simulation_state(const recipe& rec, const domain_decomposition& decomp, execution_context ctx);
 
+    ~simulation_state() { stop(); }
+
     void reset();
 
-    time_type run(time_type tfinal, time_type dt);
+    // With `extend`, the run continues past tfinal to the times requested
+    // by run_until() before the end of the epoch ending at tfinal is known.
+    time_type run(time_type tfinal, time_type dt, bool extend = false);
+
+    void start(time_type dt);
+    std::future<time_type> run_until(time_type t);
+    void stop();
+    bool running() const { return driver_.joinable(); }
 
     sampler_association_handle add_sampler(cell_member_predicate probe_ids,
         schedule sched, sampler_function f, sampling_policy policy = sampling_policy::lax);
 
+    sampler_association_handle add_matrix_sampler(cell_member_predicate probe_ids,
+        schedule sched, matrix_sampler_function f, sampling_policy policy);
+
+    sampler_association_handle add_triggered_sampler(cell_member_predicate probe_ids,
+        sampling_window window, sampler_function f);
+
+    void trigger_sampler(sampler_association_handle h, time_type t);
+
+    void set_sampler_threads(unsigned n_threads, std::size_t capacity);
+
+    // Wait for the calls of asynchronous samplers.
+    void flush_sampler_queues();
+
+    sampler_association_handle add_reduced_sampler(cell_member_predicate probe_ids,
+        schedule sched, reduced_sampler_function f, std::size_t width,
+        unsigned interval, int root, sampling_policy policy);
+
     void remove_sampler(sampler_association_handle);
 
     void remove_all_samplers();
 
+    population_monitor_handle add_population_monitor(population_function population,
+        std::size_t n_population, time_type bin_width, population_count_function f,
+        unsigned interval, int root);
+
+    void remove_population_monitor(population_monitor_handle);
+
     std::vector<probe_metadata> get_probe_metadata(cell_member_type) const;
 
     std::size_t num_spikes() const {
         return communicator_.num_spikes();
     }
 
+    void set_cost_accounting(bool enable);
+    cell_group_costs group_costs() const;
+    std::vector<double> cell_costs() const;
+
+    scaling_estimate estimate_scaling(const spike_traffic& traffic, time_type tfinal);
+
+    arb::memory_footprint memory_footprint() const;
+
     void set_binning_policy(binning_kind policy, time_type bin_interval);
 
+    void set_event_delivery(event_delivery_kind kind);
+
+    void set_spike_exchange(spike_exchange_kind kind) {
+        communicator_.set_exchange_kind(kind);
+    }
+
+    void set_event_sort(event_sort_kind kind) {
+        event_sort_ = kind;
+    }
+
+    void set_event_storage(event_storage_kind kind);
+
+    void set_epoch_schedule(epoch_schedule kind) {
+        epoch_schedule_ = kind;
+        auto min_delay = communicator_.min_delay();
+        if (spike_port_) min_delay = std::min(min_delay, external_min_delay_);
+        t_interval_ = kind==epoch_schedule::serial? min_delay: min_delay/2;
+        if (gj_interval_>0) t_interval_ = std::min(t_interval_, gj_interval_);
+    }
+
+    void set_external_spike_port(std::shared_ptr<external_spike_port> port) {
+        spike_port_ = std::move(port);
+        set_epoch_schedule(epoch_schedule_);
+    }
+
+    void set_group_affinity(group_affinity affinity) {
+        group_affinity_ = affinity;
+    }
+
+    void set_group_rebalancing(unsigned interval) {
+        rebalance_interval_ = interval;
+        std::fill(group_time_.begin(), group_time_.end(), 0.);
+    }
+
     void inject_events(const cse_vector& events);
+    void inject_events(std::size_t n, const cell_gid_type* gids, const cell_lid_type* targets,
+                       const time_type* times, const float* weights);
+
+    void set_epoch_callback(epoch_function f) {
+        epoch_callback_ = std::move(f);
+    }
+
+    void set_epoch_metrics_callback(epoch_metrics_function f, unsigned interval);
+
+    void serialize(std::ostream&) const;
+    void deserialize(std::istream&);
+
+    const task_system_handle& task_system() const { return task_system_; }
+    int num_domains() const { return distributed_->size(); }
 
     spike_export_function global_export_callback_;
     spike_export_function local_export_callback_;
 
 private:
+    epoch_function epoch_callback_;
+
+    // Persistent run mode: the times requested by run_until() and not yet
+    // reached, in order, and the thread that advances the simulation to them.
+    std::mutex targets_mutex_;
+    std::condition_variable targets_cv_;
+    std::deque<std::pair<time_type, std::promise<time_type>>> targets_;
+    time_type last_target_ = 0;
+    bool stop_ = false;
+    std::thread driver_;
+
+    // The earliest requested time after t, or t if there is none.
+    time_type next_target(time_type t);
+
+    // Fulfil the requests for times up to t, or fail all requests.
+    void complete_targets(time_type t);
+    void fail_targets(std::exception_ptr e);
+
+    // The earliest time of events injected from the epoch callback, which
+    // is set while it is called; otherwise the end of the last epoch.
+    std::optional<time_type> inject_horizon_;
+
     // Record last computed epoch (integration interval).
     epoch epoch_;
 
@@ -124,6 +271,80 @@ private:
 
     std::vector<cell_group_ptr> cell_groups_;
 
+    // The thread of the task system that owns each cell group. Unless the
+    // affinity is none, a cell group is visited on its owning thread, where
+    // its state stays in cache from one epoch to the next. If the threads
+    // are bound to CPUs, the cell groups are also built on their owning
+    // threads, so that their state is allocated in memory local to them.
+    std::vector<unsigned> group_thread_;
+    group_affinity group_affinity_ = group_affinity::none;
+
+    // The number of leading threads that own only GPU cell groups, which is
+    // zero unless the rank has both GPU and CPU cell groups.
+    unsigned n_gpu_threads_ = 0;
+
+    // Time spent advancing each cell group since the last rebalancing, in
+    // seconds, and the number of epochs between rebalancings, or zero if
+    // cell groups keep their owning threads.
+    std::vector<double> group_time_;
+    unsigned rebalance_interval_ = 0;
+
+    // Reassign the cell groups to threads by their measured advance times.
+    void rebalance_groups();
+
+    // Costs of each cell group, recorded while cost accounting is enabled.
+    // The phase times are written by the group as it advances, and the
+    // enqueue time by the enqueue task for the next epoch, which may run
+    // concurrently with the update.
+    struct group_cost_record {
+        advance_phase_times phases;
+        double advance = 0;
+        double enqueue = 0;
+        std::uint64_t updates = 0;
+        std::uint64_t events = 0;
+        std::uint64_t spikes = 0;
+    };
+    bool cost_accounting_ = false;
+    std::vector<group_cost_record> group_costs_;
+
+    void clear_costs();
+
+    // Metrics of the current window of epochs, recorded while an epoch
+    // metrics callback is set. Task times are accumulated by each cell group
+    // and the exchange task, and collected between epochs; profiler region
+    // times are reported relative to those at the end of the last window.
+    struct group_metrics_record {
+        double advance = 0;
+        double enqueue = 0;
+        std::uint64_t events = 0;
+    };
+    epoch_metrics_function epoch_metrics_callback_;
+    unsigned epoch_metrics_interval_ = 1;
+    epoch_metrics epoch_metrics_;
+    std::vector<group_metrics_record> group_metrics_;
+    tick_type epoch_metrics_tic_ = 0;
+    std::vector<double> region_times_;
+
+    // Close epoch `current` in the window, and pass the metrics of the window
+    // to the callback if it is complete, or if `last` and not empty.
+    void record_epoch_metrics(epoch current, bool last);
+
+    // Run a task for cell group i in g, on its owning thread if any.
+    template <typename F>
+    void run_group_task(threading::task_group& g, int i, F&& f, int priority) {
+        switch (group_affinity_) {
+        case group_affinity::none:
+            g.run(std::forward<F>(f), priority);
+            break;
+        case group_affinity::preferred:
+            g.run_on(group_thread_[i], std::forward<F>(f), priority, threading::task_affinity::preferred);
+            break;
+        case group_affinity::fixed:
+            g.run_on(group_thread_[i], std::forward<F>(f), priority, threading::task_affinity::bound);
+            break;
+        }
+    }
+
     // One set of event_generators for each local cell
     std::vector<std::vector<event_generator>> event_generators_;
 
@@ -136,10 +357,59 @@ private:
 
     communicator communicator_;
 
+    // The target labels of the local cells, held by the event generators
+    // that resolve their targets through them.
+    std::weak_ptr<const label_resolution_map> target_resolution_map_;
+
+    // Indices of the cell groups that generate the events of incoming spikes
+    // themselves, see cell_group::delivers_spikes().
+    std::vector<cell_size_type> spike_delivery_groups_;
+
+    // Exchange of the voltages of gap junction sites between cell groups,
+    // at least every gj_interval_ if positive. The voltages published by the
+    // groups of all domains are gathered into one vector, in which
+    // gj_peer_slots_[i] are the indices of the peers of the gap junctions of
+    // group i, in the order that the group gave them.
+    time_type gj_interval_ = 0;
+    std::vector<std::vector<std::size_t>> gj_peer_slots_;
+    std::vector<double> gj_local_v_;
+    std::vector<double> gj_peer_v_;
+
+    void setup_gap_junction_exchange();
+    void exchange_gap_junctions();
+
+    // Exchange of spikes with an external simulation, if set. The external
+    // connections onto the local cells are held by source, and the minimum
+    // delay of the external connections of all domains bounds the epoch.
+    struct external_target {
+        cell_size_type cell;  // local cell index
+        cell_lid_type target;
+        float weight;
+        float delay;
+    };
+    std::shared_ptr<external_spike_port> spike_port_;
+    std::unordered_map<cell_member_type, std::vector<external_target>> external_targets_;
+    time_type external_min_delay_ = std::numeric_limits<time_type>::max();
+
+    // Add the events of external spikes to the pending events.
+    void deliver_external_spikes(const std::vector<spike>& spikes);
+
     task_system_handle task_system_;
 
-    // Pending events to be delivered.
-    std::vector<pse_vector> pending_events_;
+    // Pending events to be delivered, partitioned by local cell.
+    event_buffer pending_events_;
+
+    // Algorithm used to sort the pending events of each cell.
+    event_sort_kind event_sort_ = event_sort_kind::comparison;
+
+    // Storage of the events of each cell beyond the current pending events;
+    // with event_storage_kind::calendar, the events are held in calendar_
+    // and each event lane holds only the events of its epoch.
+    event_storage_kind event_storage_ = event_storage_kind::lanes;
+    event_calendar calendar_;
+
+    // Schedule of updates and exchanges; sets the epoch length t_interval_.
+    epoch_schedule epoch_schedule_ = epoch_schedule::overlapped;
     std::array<std::vector<pse_vector>, 2> event_lanes_;
 
     std::vector<pse_vector>& event_lanes(std::ptrdiff_t epoch_id) {
@@ -153,22 +423,116 @@ private:
         return local_spikes_[epoch_id&1];
     }
 
+    // Spike exchange in flight: started once the update of an epoch has completed,
+    // and completed by the exchange task that runs alongside the following update.
+    std::vector<spike> exchanged_local_spikes_;
+    spike_gather_request exchange_request_;
+
     // Sampler associations handles are managed by a helper class.
     util::handle_set<sampler_association_handle> sassoc_handles_;
 
+    distributed_context_handle distributed_;
+
+    // Global cell count, for the cost estimates by gid.
+    cell_size_type num_global_cells_ = 0;
+
+    // Samples summed across probes and domains, see add_reduced_sampler.
+    // The local sums are keyed by sample time, and are written by the
+    // samplers of all cell groups.
+    struct reduced_sampler {
+        schedule sched;
+        reduced_sampler_function fn;
+        std::size_t width;
+        unsigned interval;
+        int root;
+
+        std::mutex mutex;
+        std::map<time_type, std::vector<double>> local;
+
+        // Sums for sample times before t_posted have been posted.
+        time_type t_posted = 0;
+
+        // Reduction in flight and its sample times.
+        sum_request request;
+        std::vector<time_type> times;
+
+        void add(time_type t, const double* begin, const double* end);
+    };
+
+    // Reduced samplers by handle: reductions are posted in the order of their
+    // handles, which is the same on all domains.
+    std::map<sampler_association_handle, std::shared_ptr<reduced_sampler>> reduced_samplers_;
+
+    // Queues of asynchronous samplers, see set_sampler_threads. The samplers
+    // added under an earlier setting keep their queue, so all are kept, and
+    // are destroyed before the cell groups that their calls refer to.
+    std::vector<std::unique_ptr<sampler_queue>> sampler_queues_;
+    sampler_queue* sampler_queue_ = nullptr;
+
+    // Post the reduction of the local sums for sample times before the end of
+    // `current`, for each reduced sampler that is due or for all if `last`.
+    // Reductions posted earlier are completed first, and with `last` the new
+    // reductions are completed too.
+    void post_reductions(epoch current, bool last);
+    void complete_reduction(reduced_sampler&);
+
+    // Spike counts by population, see add_population_monitor. The local
+    // counts are keyed by bin index, and are updated by the exchange task
+    // with the spikes generated on this domain.
+    struct population_monitor {
+        std::unordered_map<cell_gid_type, unsigned> population; // of local cells
+        std::size_t n_population;
+        time_type bin_width;
+        population_count_function fn;
+        unsigned interval;
+        int root;
+
+        std::map<std::int64_t, std::vector<double>> local;
+
+        // Counts of spikes before t_posted have been posted.
+        time_type t_posted = 0;
+
+        // Reduction in flight and its bins.
+        sum_request request;
+        std::vector<std::pair<time_type, time_type>> bins;
+
+        void count(const std::vector<spike>& spikes);
+    };
+
+    // Population monitors by handle, which orders their reductions as for
+    // the reduced samplers.
+    std::map<population_monitor_handle, population_monitor> population_monitors_;
+    util::handle_set<population_monitor_handle> population_handles_;
+
+    // Post the reduction of the local counts of spikes before `t_counted`,
+    // all of which have been exchanged, for each monitor that is due or for
+    // all if `last`. Only whole bins are posted, except if `last`.
+    void post_population_counts(epoch current, time_type t_counted, bool last);
+    void complete_population_counts(population_monitor&);
+
     // Apply a functional to each cell group in parallel.
     template <typename L>
     void foreach_group(L&& fn) {
-        threading::parallel_for::apply(0, cell_groups_.size(), task_system_.get(),
-            [&, fn = std::forward<L>(fn)](int i) { fn(cell_groups_[i]); });
+        foreach_group_index([&](cell_group_ptr& group, int) { fn(group); });
     }
 
     // Apply a functional to each cell group in parallel, supplying
-    // the cell group pointer reference and index.
+    // the cell group pointer reference and index. Each cell group is
+    // visited on its owning thread, according to the group affinity.
     template <typename L>
     void foreach_group_index(L&& fn) {
-        threading::parallel_for::apply(0, cell_groups_.size(), task_system_.get(),
-            [&, fn = std::forward<L>(fn)](int i) { fn(cell_groups_[i], i); });
+        if (group_affinity_==group_affinity::none) {
+            threading::parallel_for::apply(0, cell_groups_.size(), task_system_.get(),
+                [&](int i) { fn(cell_groups_[i], i); });
+            return;
+        }
+
+        threading::task_group g(task_system_.get());
+        const int priority = threading::task_system::get_task_priority()+1;
+        for (unsigned i = 0; i<cell_groups_.size(); ++i) {
+            run_group_task(g, i, [&, i]() { fn(cell_groups_[i], i); }, priority);
+        }
+        g.wait();
     }
 
     // Apply a functional to each local cell in parallel.
@@ -184,17 +548,69 @@ simulation_state::simulation_state(
         execution_context ctx
     ):
     task_system_(ctx.thread_pool),
-    local_spikes_({thread_private_spike_store(ctx.thread_pool), thread_private_spike_store(ctx.thread_pool)})
+    local_spikes_({thread_private_spike_store(ctx.thread_pool), thread_private_spike_store(ctx.thread_pool)}),
+    distributed_(ctx.distributed),
+    num_global_cells_(decomp.num_global_cells)
 {
+    // Assign contiguous blocks of cell groups to each thread. If the threads
+    // are bound to CPUs, the memory of each group is first touched by its
+    // owning thread.
+    //
+    // If GPU and CPU cell groups share the rank, the first threads are set
+    // aside to drive the GPU groups, one per group as far as possible, and
+    // the CPU groups are spread over the others; the CPU groups then advance
+    // while the GPU groups wait on their devices.
+    const auto n_groups = decomp.groups.size();
+    const auto n_threads = task_system_->get_num_threads();
+    std::vector<std::size_t> gpu_groups, cpu_groups;
+    for (std::size_t i = 0; i<n_groups; ++i) {
+        (decomp.groups[i].backend==backend_kind::gpu? gpu_groups: cpu_groups).push_back(i);
+    }
+    group_thread_.resize(n_groups);
+    if (!gpu_groups.empty() && !cpu_groups.empty() && n_threads>1) {
+        n_gpu_threads_ = std::min<std::size_t>(gpu_groups.size(), n_threads-1);
+        for (auto i: util::count_along(gpu_groups)) {
+            group_thread_[gpu_groups[i]] = i*n_gpu_threads_/gpu_groups.size();
+        }
+        for (auto i: util::count_along(cpu_groups)) {
+            group_thread_[cpu_groups[i]] = n_gpu_threads_ + i*(n_threads-n_gpu_threads_)/cpu_groups.size();
+        }
+        group_affinity_ = group_affinity::preferred;
+    }
+    else {
+        for (std::size_t i = 0; i<n_groups; ++i) {
+            group_thread_[i] = i*n_threads/n_groups;
+        }
+    }
+    group_time_.assign(n_groups, 0.);
+    if (task_system_->threads_bound()) {
+        group_affinity_ = group_affinity::fixed;
+    }
+
     // Generate the cell groups in parallel, with one task per cell group.
-    cell_groups_.resize(decomp.groups.size());
+    cell_groups_.resize(n_groups);
     std::vector<cell_labels_and_gids> cg_sources(cell_groups_.size());
     std::vector<cell_labels_and_gids> cg_targets(cell_groups_.size());
     foreach_group_index(
         [&](cell_group_ptr& group, int i) {
           const auto& group_info = decomp.groups[i];
           cell_label_range sources, targets;
-          auto factory = cell_kind_implementation(group_info.kind, group_info.backend, ctx);
+          // A GPU cell group keeps all of its state on its assigned device.
+          auto group_ctx = ctx;
+          if (group_info.backend==backend_kind::gpu) {
+              if (group_info.device>=ctx.gpus.size()) {
+                  throw arbor_exception(util::pprintf(
+                      "cell group {} is assigned to GPU device {}, but the context has {} GPUs",
+                      i, group_info.device, ctx.gpus.size()));
+              }
+              group_ctx.gpu = ctx.gpus[group_info.device];
+          }
+          auto factory = cell_kind_implementation(group_info.kind, group_info.backend, group_ctx);
+          if (!factory) {
+              throw arbor_exception(util::pprintf(
+                  "cell group {} of {} has no implementation on {}",
+                  i, group_info.kind, group_info.backend));
+          }
           group = factory(group_info.gids, rec, sources, targets);
 
           cg_sources[i] = cell_labels_and_gids(std::move(sources), group_info.gids);
@@ -206,26 +622,44 @@ simulation_state::simulation_state(
         local_sources.append(cg_sources.at(i));
         local_targets.append(cg_targets.at(i));
     }
-    auto global_sources = ctx.distributed->gather_cell_labels_and_gids(local_sources);
-
-    auto source_resolution_map = label_resolution_map(std::move(global_sources));
     auto target_resolution_map = label_resolution_map(std::move(local_targets));
 
-    communicator_ = arb::communicator(rec, decomp, source_resolution_map, target_resolution_map, ctx);
+    // Source labels are resolved by the communicator, which fetches only the
+    // labels of the sources that local connections refer to.
+    communicator_ = arb::communicator(rec, decomp, local_sources, target_resolution_map, ctx);
 
     const auto num_local_cells = communicator_.num_local_cells();
 
+    // Cell groups that generate the events of incoming spikes themselves take
+    // over the connections onto their cells from the communicator.
+    for (auto i: util::make_span(cell_groups_.size())) {
+        if (cell_groups_[i]->delivers_spikes()) {
+            cell_groups_[i]->set_connections(communicator_.delegate_group(i));
+            spike_delivery_groups_.push_back(i);
+        }
+    }
+
+    // Cable cells may have gap junctions with cells of other groups, whose
+    // voltages are exchanged between epochs no longer than the interval.
+    if (auto props = rec.get_global_properties(cell_kind::cable); props.has_value()) {
+        if (auto p = std::any_cast<cable_cell_global_properties>(&props)) {
+            gj_interval_ = p->gap_junction_interval;
+        }
+    }
+
     // Use half minimum delay of the network for max integration interval.
-    t_interval_ = communicator_.min_delay()/2;
+    set_epoch_schedule(epoch_schedule::overlapped);
 
     // Initialize empty buffers for pending events for each local cell
     pending_events_.resize(num_local_cells);
+    calendar_.resize(num_local_cells);
 
     event_generators_.resize(num_local_cells);
     cell_size_type lidx = 0;
     cell_size_type grpidx = 0;
 
     auto target_resolution_map_ptr = std::make_shared<label_resolution_map>(std::move(target_resolution_map));
+    target_resolution_map_ = target_resolution_map_ptr;
     for (const auto& group_info: decomp.groups) {
         for (auto gid: group_info.gids) {
             // Store mapping of gid to local cell index.
@@ -244,6 +678,21 @@ simulation_state::simulation_state(
             // Set up the event generators for cell gid.
             event_generators_[lidx] = event_gens;
 
+            // Resolve the targets of external connections.
+            auto external = rec.external_connections_on(gid);
+            if (!external.empty()) {
+                auto target_resolver = resolver(target_resolution_map_ptr.get());
+                for (const auto& c: external) {
+                    if (!(c.delay>0)) {
+                        throw arbor_exception(util::pprintf(
+                            "external connection onto gid {} must have a positive delay", gid));
+                    }
+                    auto lid = target_resolver.resolve({gid, c.dest});
+                    external_targets_[c.source].push_back({lidx, lid, c.weight, c.delay});
+                    external_min_delay_ = std::min<time_type>(external_min_delay_, c.delay);
+                }
+            }
+
             ++lidx;
         }
         ++grpidx;
@@ -255,14 +704,139 @@ simulation_state::simulation_state(
     event_lanes_[0].resize(num_local_cells);
     event_lanes_[1].resize(num_local_cells);
 
+    external_min_delay_ = distributed_->min(external_min_delay_);
+
+    if (gj_interval_>0) setup_gap_junction_exchange();
+
     epoch_.reset();
 }
 
+void simulation_state::setup_gap_junction_exchange() {
+    const auto n_groups = cell_groups_.size();
+
+    // Gather sites of all domains, as gids and indices. The indices are
+    // gathered as values, which unlike gids are not offset between the
+    // tiles of a dry run.
+    auto gather_sites = [this](const std::vector<cell_member_type>& sites) {
+        std::vector<cell_gid_type> gids;
+        std::vector<double> indices;
+        for (const auto& s: sites) {
+            gids.push_back(s.gid);
+            indices.push_back(s.index);
+        }
+        auto all_gids = distributed_->gather_gids(gids);
+        auto all_indices = distributed_->gather_values(indices);
+
+        std::vector<cell_member_type> all;
+        for (auto k: util::count_along(all_gids.values())) {
+            all.push_back({all_gids.values()[k], cell_lid_type(all_indices.values()[k])});
+        }
+        return all;
+    };
+
+    // The peers of each group, resolved against the gap junction labels of
+    // the cells of all domains.
+    cell_labels_and_gids local_labels;
+    for (auto& group: cell_groups_) {
+        local_labels.append(group->gap_junction_labels());
+    }
+    label_resolution_map labels(distributed_->gather_cell_labels_and_gids(local_labels));
+
+    std::vector<std::vector<cell_member_type>> peers(n_groups);
+    std::vector<cell_member_type> requested;
+    for (auto i: util::make_span(n_groups)) {
+        peers[i] = cell_groups_[i]->remote_gap_junction_peers(labels);
+        util::append(requested, peers[i]);
+    }
+    util::sort(requested);
+    requested.erase(std::unique(requested.begin(), requested.end()), requested.end());
+
+    // Each group publishes the sites of its cells requested by any domain.
+    requested = gather_sites(requested);
+    util::sort(requested);
+    requested.erase(std::unique(requested.begin(), requested.end()), requested.end());
+
+    std::vector<std::vector<cell_member_type>> published(n_groups);
+    for (const auto& site: requested) {
+        if (auto it = gid_to_local_.find(site.gid); it!=gid_to_local_.end()) {
+            published[it->second.group_index].push_back(site);
+        }
+    }
+
+    std::vector<cell_member_type> local_published;
+    for (auto i: util::make_span(n_groups)) {
+        cell_groups_[i]->set_published_gap_junction_sites(published[i]);
+        util::append(local_published, published[i]);
+    }
+
+    auto global_published = gather_sites(local_published);
+    std::unordered_map<cell_member_type, std::size_t> slot;
+    for (auto k: util::count_along(global_published)) {
+        slot[global_published[k]] = k;
+    }
+
+    gj_peer_slots_.assign(n_groups, {});
+    for (auto i: util::make_span(n_groups)) {
+        for (const auto& peer: peers[i]) {
+            auto it = slot.find(peer);
+            if (it==slot.end()) {
+                throw arbor_internal_error(util::pprintf("gap junction site {} is not published", peer));
+            }
+            gj_peer_slots_[i].push_back(it->second);
+        }
+    }
+}
+
+void simulation_state::deliver_external_spikes(const std::vector<spike>& spikes) {
+    if (external_targets_.empty()) return;
+
+    for (const auto& s: spikes) {
+        if (auto it = external_targets_.find(s.source); it!=external_targets_.end()) {
+            for (const auto& t: it->second) {
+                pending_events_.count(t.cell);
+            }
+        }
+    }
+    pending_events_.allocate();
+    for (const auto& s: spikes) {
+        if (auto it = external_targets_.find(s.source); it!=external_targets_.end()) {
+            for (const auto& t: it->second) {
+                pending_events_.push(t.cell, {t.target, s.time+t.delay, t.weight});
+            }
+        }
+    }
+}
+
+void simulation_state::exchange_gap_junctions() {
+    PE(communication_gapjunctions);
+    gj_local_v_.clear();
+    for (auto& group: cell_groups_) {
+        group->published_gap_junction_voltages(gj_local_v_);
+    }
+    auto global_v = distributed_->gather_values(gj_local_v_);
+    const auto& values = global_v.values();
+
+    for (auto i: util::count_along(cell_groups_)) {
+        if (gj_peer_slots_[i].empty()) continue;
+        gj_peer_v_.clear();
+        for (auto k: gj_peer_slots_[i]) {
+            gj_peer_v_.push_back(values[k]);
+        }
+        cell_groups_[i]->set_remote_gap_junction_voltages(gj_peer_v_);
+    }
+    PL();
+}
+
 void simulation_state::reset() {
     epoch_ = epoch();
+    flush_sampler_queues();
 
     // Reset cell group state.
     foreach_group([](cell_group_ptr& group) { group->reset(); });
+    std::fill(group_time_.begin(), group_time_.end(), 0.);
+    if (cost_accounting_) clear_costs();
+    epoch_metrics_ = {};
+    for (auto& g: group_metrics_) g = {};
 
     // Clear all pending events in the event lanes.
     for (auto& lanes: event_lanes_) {
@@ -278,9 +852,8 @@ void simulation_state::reset() {
         }
     }
 
-    for (auto& lane: pending_events_) {
-        lane.clear();
-    }
+    pending_events_.clear();
+    calendar_.clear();
 
     communicator_.reset();
 
@@ -288,10 +861,21 @@ void simulation_state::reset() {
         spikes.clear();
     }
 
+    for (auto& [h, r]: reduced_samplers_) {
+        r->sched.reset();
+        r->local.clear();
+        r->t_posted = 0;
+    }
+
+    for (auto& [h, m]: population_monitors_) {
+        m.local.clear();
+        m.t_posted = 0;
+    }
+
     epoch_.reset();
 }
 
-time_type simulation_state::run(time_type tfinal, time_type dt) {
+time_type simulation_state::run(time_type tfinal, time_type dt, bool extend) {
     // Progress simulation to time tfinal, through a series of integration epochs
     // of length at most t_interval_. t_interval_ is chosen to be no more than
     // than half the network minimum delay.
@@ -305,7 +889,12 @@ time_type simulation_state::run(time_type tfinal, time_type dt) {
     // 2. Exchange:
     //    Consume local spikes held in local_spikes_ from a previous update, and collect
     //    such spikes from across all ranks.
-    //    Translate spikes to local postsynaptic spike events, to be appended to pending_events_.
+    //    Translate spikes to local postsynaptic spike events, to be stored in pending_events_.
+    //
+    //    The collection of spikes across ranks is started as soon as the update has
+    //    completed, using a non-blocking gather where the distributed context supports
+    //    one, and only completed in the exchange task. The communication then
+    //    proceeds in the background of the subsequent enqueue and update tasks.
     //
     // 3. Enqueue events:
     //    Take events from pending_events_, together with any event-generator events for the
@@ -327,120 +916,533 @@ time_type simulation_state::run(time_type tfinal, time_type dt) {
     // while E consumes and clears it). The local spike collection and the per-cell event
     // lanes are double buffered.
     //
+    // Update and enqueue are performed per cell group: writing U_i(k) and E_i(k) for the
+    // update and enqueue of group i, U_i(k+1) depends only upon U_i(k) and E_i(k+1). A group
+    // that has been updated through epoch k, while others are still being updated, is then
+    // advanced through epoch k+1 as soon as its events have been enqueued, without waiting
+    // for the remaining groups. It can go no further, as E(k+2) requires D(k), which in turn
+    // requires U(k) for every group.
+    //
     // Required state on run() invocation with epoch_.id==k:
     //     * For k≥0,  U(k) and D(k) have completed.
     //
     // Requires state at end of run(), with epoch_.id==k:
     //     * U(k) and D(k) have completed.
+    //
+    // With epoch_schedule::serial, t_interval_ is the minimum delay, and the
+    // spikes of epoch k generate events no earlier than epoch k+1: D(k) then
+    // precedes E(k+1), and the tasks run in the order E(k), U(k), D(k).
+    //
+    // In persistent run mode, an epoch ends no later than the next time
+    // requested by run_until(), and the schedule continues past tfinal while
+    // further times have been requested. A request is fulfilled once D(k)
+    // has completed for the epoch k ending at its time. Across domains, the
+    // requests that arrive during a run would not be seen alike, and each
+    // run stops at tfinal.
 
     if (tfinal<=epoch_.t1) return epoch_.t1;
+    extend = extend && num_domains()==1;
+
+    // The end of the epoch following one that ends at t.
+    auto horizon = [&](time_type t) {
+        return extend && t>=tfinal? next_target(t): tfinal;
+    };
+
+    if (event_storage_==event_storage_kind::calendar) calendar_.set_step(dt);
+
+    // Cell groups joined by gap junctions start from the voltages of their
+    // peers at the end of the last run, or after reset.
+    if (gj_interval_>0) exchange_gap_junctions();
 
     // Compute following epoch, with max time tfinal.
-    auto next_epoch = [tfinal](epoch e, time_type interval) -> epoch {
+    auto next_epoch = [&](epoch e, time_type interval) -> epoch {
         epoch next = e;
-        next.advance_to(std::min(next.t1+interval, tfinal));
+        next.advance_to(std::min(next.t1+interval, horizon(next.t1)));
         return next;
     };
 
-    // Update task: advance cell groups to end of current epoch and store spikes in local_spikes_.
-    auto update = [this, dt](epoch current) {
-        local_spikes(current.id).clear();
-        foreach_group_index(
-            [&](cell_group_ptr& group, int i) {
-                auto queues = util::subrange_view(event_lanes(current.id), communicator_.group_queue_range(i));
-                group->advance(current, dt, queues);
-
-                PE(advance_spikes);
-                local_spikes(current.id).insert(group->spikes());
-                group->clear_spikes();
-                PL();
-            });
+    // Update task: advance cell group i to end of the epoch and store spikes in local_spikes_.
+    auto update_group = [this, dt](epoch current, int i) {
+        auto& group = cell_groups_[i];
+        auto queues = util::subrange_view(event_lanes(current.id), communicator_.group_queue_range(i));
+        auto& spikes = local_spikes(current.id).get();
+        PT(current.id, i);
+        if (cost_accounting_ || epoch_metrics_callback_) {
+            using timer = profile::timer<>;
+            std::uint64_t n_events = 0;
+            for (const auto& lane: queues) {
+                n_events += std::partition_point(lane.begin(), lane.end(),
+                    [t1 = current.t1](const spike_event& e) { return e.time<t1; }) - lane.begin();
+            }
+            auto n_spikes = spikes.size();
+            auto t0 = timer::tic();
+            group->advance_collect(current, dt, queues, spikes);
+            auto t = timer::toc(t0);
+            if (cost_accounting_) {
+                auto& cost = group_costs_[i];
+                cost.advance += t;
+                cost.events += n_events;
+                cost.spikes += spikes.size()-n_spikes;
+                ++cost.updates;
+            }
+            if (epoch_metrics_callback_) {
+                group_metrics_[i].advance += t;
+                group_metrics_[i].events += n_events;
+            }
+            if (rebalance_interval_) group_time_[i] += t;
+        }
+        else if (rebalance_interval_) {
+            using timer = profile::timer<>;
+            auto t0 = timer::tic();
+            group->advance_collect(current, dt, queues, spikes);
+            group_time_[i] += timer::toc(t0);
+        }
+        else {
+            group->advance_collect(current, dt, queues, spikes);
+        }
+        local_spikes(current.id).close_run();
+        PT(current.id, -1);
     };
 
-    // Exchange task: gather previous locally generated spikes, distribute across all ranks, and deliver
-    // post-synaptic spike events to per-cell pending event vectors.
-    auto exchange = [this](epoch prev) {
-        // Collate locally generated spikes.
+    // Start exchange: collate spikes generated locally in an epoch and begin their
+    // distribution across all ranks. This is called between task groups, so that
+    // calls into the distributed context are never made concurrently.
+    auto start_exchange = [this](epoch prev) {
+        // Collate locally generated spikes, merging the runs of the cell
+        // groups into one sequence sorted by source.
         PE(communication_exchange_gatherlocal);
-        auto all_local_spikes = local_spikes(prev.id).gather();
+        local_spikes(prev.id).gather_sorted(exchanged_local_spikes_);
         PL();
-        // Gather generated spikes across all ranks.
-        auto global_spikes = communicator_.exchange(all_local_spikes);
+        if (epoch_metrics_callback_) epoch_metrics_.spikes += exchanged_local_spikes_.size();
+        // Start gathering generated spikes across all ranks, and sending
+        // them to the external simulation.
+        exchange_request_ = communicator_.exchange_begin(exchanged_local_spikes_);
+        if (spike_port_) spike_port_->exchange_begin(prev.t0, prev.t1, exchanged_local_spikes_);
+    };
+
+    // Exchange task: complete the exchange of previous locally generated spikes, and deliver
+    // post-synaptic spike events to per-cell pending event vectors. Events injected from
+    // the epoch callback join them, and are first delivered in the epoch starting at
+    // t_inject.
+    auto exchange = [this](epoch prev, time_type t_inject) {
+        using timer = profile::timer<>;
+        tick_type t0 = epoch_metrics_callback_? timer::tic(): 0;
+
+        // Complete gather of generated spikes across all ranks.
+        auto global_spikes = communicator_.exchange_end(exchange_request_);
 
         // Present spikes to user-supplied callbacks.
         PE(communication_spikeio);
         if (local_export_callback_) {
-            local_export_callback_(all_local_spikes);
+            local_export_callback_(exchanged_local_spikes_);
         }
         if (global_export_callback_) {
             global_export_callback_(global_spikes.values());
         }
+        for (auto& [h, m]: population_monitors_) {
+            m.count(exchanged_local_spikes_);
+        }
         PL();
 
         // Append events formed from global spikes to per-cell pending event queues.
         PE(communication_walkspikes);
         communicator_.make_event_queues(global_spikes, pending_events_);
+        if (spike_port_) deliver_external_spikes(spike_port_->exchange_end());
+        // Spikes are delivered with the weights of the previous exchange.
+        communicator_.update_plasticity(global_spikes);
+        if (!spike_delivery_groups_.empty()) {
+            auto spikes = std::make_shared<const std::vector<spike>>(global_spikes.values());
+            for (auto i: spike_delivery_groups_) {
+                cell_groups_[i]->enqueue_spikes(spikes);
+            }
+        }
         PL();
+        if (epoch_metrics_callback_) epoch_metrics_.exchange_time += timer::toc(t0);
+
+        if (epoch_callback_) {
+            inject_horizon_ = t_inject;
+            auto guard = util::on_scope_exit([this] { inject_horizon_.reset(); });
+            epoch_callback_(prev.t1, t_inject);
+        }
     };
 
-    // Enqueue task: build event_lanes for next epoch from pending events, event-generator events for the
-    // next epoch, and with any unprocessed events from the current event_lanes.
-    auto enqueue = [this](epoch next) {
-        foreach_cell(
-            [&](cell_size_type i) {
+    // Enqueue task: build event_lanes for the cells in group i for next epoch from pending events,
+    // event-generator events for the next epoch, and with any unprocessed events from the current
+    // event_lanes. The pending events are cleared once all groups have been enqueued.
+    auto enqueue_group = [this](epoch next, int i) {
+        using timer = profile::timer<>;
+        tick_type t0 = cost_accounting_ || epoch_metrics_callback_? timer::tic(): 0;
+        auto cells = communicator_.group_queue_range(i);
+        threading::parallel_for::apply(cells.first, cells.second, task_system_.get(),
+            [&](cell_size_type cell) {
+                auto cell_pending = pending_events_[cell];
+                event_span old_events = util::range_pointer_view(event_lanes(next.id-1)[cell]);
+
+                if (event_storage_==event_storage_kind::calendar) {
+                    // Events left in the previous lane, if it was formed
+                    // before the calendar was selected, are stored as well.
+                    PE(communication_enqueue_calendar);
+                    calendar_.push(cell, cell_pending);
+                    calendar_.push(cell, split_sorted_range(old_events, next.t0, event_time_less()).second);
+                    thread_local static pse_vector due;
+                    due.clear();
+                    calendar_.take(cell, next.t0, next.t1, due);
+                    PL();
+
+                    merge_cell_events(next.t0, next.t1, {}, util::range_pointer_view(due), event_generators_[cell], event_lanes(next.id)[cell]);
+                    return;
+                }
+
                 PE(communication_enqueue_sort);
-                util::sort(pending_events_[i]);
+                sort_events(cell_pending, event_sort_);
                 PL();
 
-                event_span pending = util::range_pointer_view(pending_events_[i]);
-                event_span old_events = util::range_pointer_view(event_lanes(next.id-1)[i]);
+                event_span pending(cell_pending.begin(), cell_pending.end());
 
-                merge_cell_events(next.t0, next.t1, old_events, pending, event_generators_[i], event_lanes(next.id)[i]);
-                pending_events_[i].clear();
+                merge_cell_events(next.t0, next.t1, old_events, pending, event_generators_[cell], event_lanes(next.id)[cell]);
             });
+        if (cost_accounting_ || epoch_metrics_callback_) {
+            auto t = timer::toc(t0);
+            if (cost_accounting_) group_costs_[i].enqueue += t;
+            if (epoch_metrics_callback_) group_metrics_[i].enqueue += t;
+        }
     };
 
-    threading::task_group g(task_system_.get());
-
-    epoch prev = epoch_;
-    epoch current = next_epoch(prev, t_interval_);
-    epoch next = next_epoch(current, t_interval_);
+    const int n_groups = cell_groups_.size();
+
+    // With gap junctions between cell groups, the voltages of their sites
+    // are exchanged after each update, before any group advances further.
+    if (epoch_schedule_==epoch_schedule::serial || gj_interval_>0) {
+        if (epoch_metrics_callback_) epoch_metrics_tic_ = profile::timer<>::tic();
+
+        epoch current = epoch_;
+        bool last = false;
+        do {
+            current = next_epoch(current, t_interval_);
+            local_spikes(current.id).clear();
+            threading::parallel_for::apply(0, n_groups, task_system_.get(),
+                [&](int i) { enqueue_group(current, i); });
+            pending_events_.clear();
+
+            foreach_group_index([&](cell_group_ptr&, int i) { update_group(current, i); });
+            if (gj_interval_>0) exchange_gap_junctions();
+            start_exchange(current);
+            exchange(current, current.t1);
+
+            last = current.t1>=horizon(current.t1);
+            if (last) foreach_group([](cell_group_ptr& group) { group->flush_samples(); });
+            post_reductions(current, last);
+            post_population_counts(current, current.t1, last);
+            if (epoch_metrics_callback_) record_epoch_metrics(current, false);
+            if (extend && !last) complete_targets(current.t1);
+
+            if (!last && rebalance_interval_ && (current.id+1)%rebalance_interval_==0) {
+                rebalance_groups();
+            }
+        } while (!last);
+        if (epoch_metrics_callback_) record_epoch_metrics(current, true);
+        flush_sampler_queues();
 
-    if (next.empty()) {
-        enqueue(current);
-        update(current);
-        exchange(current);
+        epoch_ = current;
+        return current.t1;
     }
-    else {
-        enqueue(current);
 
-        g.run([&]() { enqueue(next); });
-        g.run([&]() { update(current); });
-        g.wait();
+    // The id of the last epoch to which each cell group has been advanced.
+    std::vector<std::ptrdiff_t> group_epoch(n_groups, epoch_.id);
 
-        for (;;) {
-            prev = current;
-            current = next;
-            next = next_epoch(next, t_interval_);
-            if (next.empty()) break;
+    // Count of the dependencies of U_i(k+1) that are satisfied in the stage with
+    // current epoch k, namely U_i(k) and E_i(k+1).
+    std::vector<std::atomic<int>> ready(n_groups);
+
+    // Run one stage of the schedule: update all cell groups to the end of the current
+    // epoch, concurrently with the exchange of spikes from the previous epoch (if any)
+    // and the enqueueing of events for the next epoch (if not empty). A cell group that
+    // has completed both its update for the current epoch and the enqueueing of its
+    // events for the next is advanced immediately through the next epoch.
+    auto stage = [&](epoch prev, epoch current, epoch next) {
+        const bool lookahead = !next.empty();
+
+        // Spikes from the next epoch may be generated during this stage.
+        if (lookahead) {
+            local_spikes(next.id).clear();
+        }
 
-            g.run([&]() { exchange(prev); enqueue(next); });
-            g.run([&]() { update(current); });
-            g.wait();
+        threading::task_group g(task_system_.get());
+
+        const int update_priority = threading::task_system::get_task_priority()+1;
+
+        // On completion of U_i(k) or E_i(k+1), advance group i through epoch k+1
+        // if the other dependency has also completed: immediately, unless the
+        // group is owned by another thread.
+        auto satisfy = [&](int i) {
+            if (lookahead && ++ready[i]==2) {
+                auto advance = [&, i]() {
+                    update_group(next, i);
+                    group_epoch[i] = next.id;
+                };
+                if (group_affinity_==group_affinity::none || (int)group_thread_[i]==task_system_->current_thread()) {
+                    advance();
+                }
+                else {
+                    run_group_task(g, i, std::move(advance), update_priority);
+                }
+            }
+        };
+
+        // Groups advanced through the current epoch in the previous stage
+        // have already satisfied the first dependency.
+        for (int i = 0; i<n_groups; ++i) {
+            ready[i] = group_epoch[i]<current.id? 0: 1;
+        }
+
+        g.run([&]() {
+            if (prev) {
+                exchange(prev, current.t1);
+            }
+            if (lookahead) {
+                threading::parallel_for::apply(0, n_groups, task_system_.get(),
+                    [&](int i) {
+                        enqueue_group(next, i);
+                        satisfy(i);
+                    });
+                pending_events_.clear();
+            }
+        }, update_priority);
+
+        for (int i = 0; i<n_groups; ++i) {
+            if (group_epoch[i]<current.id) {
+                run_group_task(g, i, [&, i]() {
+                    update_group(current, i);
+                    group_epoch[i] = current.id;
+                    satisfy(i);
+                }, update_priority);
+            }
         }
 
-        g.run([&]() { exchange(prev); });
-        g.run([&]() { update(current); });
         g.wait();
+        start_exchange(current);
+    };
+
+    epoch prev = epoch_;
+    epoch current = next_epoch(prev, t_interval_);
+    epoch next = next_epoch(current, t_interval_);
 
-        exchange(current);
+    if (epoch_metrics_callback_) epoch_metrics_tic_ = profile::timer<>::tic();
+
+    local_spikes(current.id).clear();
+    threading::parallel_for::apply(0, n_groups, task_system_.get(),
+        [&](int i) { enqueue_group(current, i); });
+    pending_events_.clear();
+
+    // The spikes of the epoch preceding the first have been exchanged in the
+    // previous call to run().
+    stage(epoch(), current, next);
+    post_reductions(current, false);
+    post_population_counts(current, current.t0, false);
+    if (epoch_metrics_callback_) record_epoch_metrics(current, false);
+
+    while (!next.empty()) {
+        prev = current;
+        current = next;
+        next = next_epoch(next, t_interval_);
+        stage(prev, current, next);
+        post_reductions(current, false);
+        post_population_counts(current, current.t0, false);
+        if (epoch_metrics_callback_) record_epoch_metrics(current, false);
+        if (extend) complete_targets(prev.t1);
+
+        // No cell group update is in flight between stages.
+        if (rebalance_interval_ && (current.id+1)%rebalance_interval_==0) {
+            rebalance_groups();
+        }
     }
 
+    exchange(current, current.t1);
+
+    // Call samplers for samples that cell groups have held back.
+    foreach_group([](cell_group_ptr& group) { group->flush_samples(); });
+    post_reductions(current, true);
+    post_population_counts(current, current.t1, true);
+    if (epoch_metrics_callback_) record_epoch_metrics(current, true);
+    flush_sampler_queues();
+
     // Record current epoch for next run() invocation.
     epoch_ = current;
     return current.t1;
 }
 
+void simulation_state::start(time_type dt) {
+    if (driver_.joinable()) {
+        throw arbor_exception("simulation is already running");
+    }
+    stop_ = false;
+    last_target_ = epoch_.t1;
+
+    // Advance to the earliest requested time, and on through the times
+    // requested meanwhile, until stopped with no requests left.
+    driver_ = std::thread([this, dt]() {
+        for (;;) {
+            time_type t;
+            {
+                std::unique_lock<std::mutex> lock(targets_mutex_);
+                targets_cv_.wait(lock, [this] { return stop_ || !targets_.empty(); });
+                if (targets_.empty()) return;
+                t = targets_.front().first;
+            }
+            try {
+                complete_targets(run(t, dt, true));
+            }
+            catch (...) {
+                fail_targets(std::current_exception());
+                return;
+            }
+        }
+    });
+}
+
+std::future<time_type> simulation_state::run_until(time_type t) {
+    std::lock_guard<std::mutex> lock(targets_mutex_);
+    if (!driver_.joinable() || stop_) {
+        throw arbor_exception("simulation is not running");
+    }
+    if (t<last_target_) {
+        throw arbor_exception(util::pprintf("run_until time {} precedes the time {} requested before", t, last_target_));
+    }
+    last_target_ = t;
+    targets_.emplace_back(t, std::promise<time_type>());
+    targets_cv_.notify_one();
+    return targets_.back().second.get_future();
+}
+
+void simulation_state::stop() {
+    if (!driver_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(targets_mutex_);
+        stop_ = true;
+    }
+    targets_cv_.notify_one();
+    driver_.join();
+}
+
+time_type simulation_state::next_target(time_type t) {
+    std::lock_guard<std::mutex> lock(targets_mutex_);
+    for (auto& [t_target, p]: targets_) {
+        if (t_target>t) return t_target;
+    }
+    return t;
+}
+
+void simulation_state::complete_targets(time_type t) {
+    std::lock_guard<std::mutex> lock(targets_mutex_);
+    while (!targets_.empty() && targets_.front().first<=t) {
+        targets_.front().second.set_value(t);
+        targets_.pop_front();
+    }
+}
+
+void simulation_state::fail_targets(std::exception_ptr e) {
+    std::lock_guard<std::mutex> lock(targets_mutex_);
+    stop_ = true;
+    for (auto& [t, p]: targets_) p.set_exception(e);
+    targets_.clear();
+}
+
+void simulation_state::set_epoch_metrics_callback(epoch_metrics_function f, unsigned interval) {
+    if (!interval) {
+        throw arbor_exception("epoch metrics interval must be at least one epoch");
+    }
+    epoch_metrics_callback_ = std::move(f);
+    epoch_metrics_interval_ = interval;
+    epoch_metrics_ = {};
+    group_metrics_.assign(cell_groups_.size(), {});
+    region_times_ = profile::profiler_summary().times;
+}
+
+void simulation_state::record_epoch_metrics(epoch current, bool last) {
+    using timer = profile::timer<>;
+    auto& m = epoch_metrics_;
+
+    double t = timer::toc(epoch_metrics_tic_);
+    epoch_metrics_tic_ = timer::tic();
+    if (!last) {
+        if (!m.epochs) m.t0 = current.t0;
+        m.t1 = current.t1;
+        ++m.epochs;
+        m.max_epoch_time = std::max(m.max_epoch_time, t);
+    }
+    m.wall_time += t;
+
+    if (!m.epochs || (!last && m.epochs<epoch_metrics_interval_)) {
+        // Times and spikes left over at the end of a run that closed a
+        // window are not carried into the next run.
+        if (last) m = {};
+        return;
+    }
+
+    m.num_cells = communicator_.num_local_cells();
+    for (auto& g: group_metrics_) {
+        m.advance_time += g.advance;
+        m.enqueue_time += g.enqueue;
+        m.events += g.events;
+        g = {};
+    }
+    double busy = m.advance_time+m.enqueue_time+m.exchange_time;
+    m.idle_time = std::max(0., task_system_->get_num_threads()*m.wall_time-busy);
+    m.memory = memory_footprint().total();
+
+    // Region times drop if the profiler has been cleared since the last window.
+    auto prof = profile::profiler_summary();
+    m.regions = std::move(prof.names);
+    m.region_times.resize(prof.times.size());
+    for (auto i: util::count_along(prof.times)) {
+        double t0 = i<region_times_.size()? region_times_[i]: 0.;
+        m.region_times[i] = prof.times[i]>=t0? prof.times[i]-t0: prof.times[i];
+    }
+    region_times_ = std::move(prof.times);
+
+    epoch_metrics_callback_(m);
+    m = {};
+}
+
+void simulation_state::rebalance_groups() {
+    PE(advance_rebalance);
+    const unsigned n_threads = task_system_->get_num_threads();
+
+    // Longest processing time first: each cell group in order of decreasing
+    // time goes to the thread with the least time so far. Groups are only
+    // moved if this shortens the longest time of any thread by at least 10%,
+    // as a moved group loses its state from the cache of its old thread.
+    // The GPU groups keep the threads set aside for them, and only the CPU
+    // groups are balanced over the remaining threads.
+    std::vector<unsigned> order;
+    for (auto i: util::count_along(group_time_)) {
+        if (group_thread_[i]>=n_gpu_threads_) order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(),
+        [this](unsigned a, unsigned b) { return group_time_[a]>group_time_[b]; });
+
+    std::vector<double> thread_time(n_threads, 0.);
+    std::vector<unsigned> group_thread = group_thread_;
+    for (auto i: order) {
+        auto t = std::min_element(thread_time.begin()+n_gpu_threads_, thread_time.end())-thread_time.begin();
+        group_thread[i] = t;
+        thread_time[t] += group_time_[i];
+    }
+    const double balanced = *std::max_element(thread_time.begin(), thread_time.end());
+
+    std::fill(thread_time.begin(), thread_time.end(), 0.);
+    for (auto i: order) {
+        thread_time[group_thread_[i]] += group_time_[i];
+    }
+    const double current = *std::max_element(thread_time.begin(), thread_time.end());
+
+    if (balanced<0.9*current) {
+        group_thread_ = std::move(group_thread);
+    }
+    std::fill(group_time_.begin(), group_time_.end(), 0.);
+    PL();
+}
+
 sampler_association_handle simulation_state::add_sampler(
         cell_member_predicate probe_ids,
         schedule sched,
@@ -448,6 +1450,7 @@ sampler_association_handle simulation_state::add_sampler(
         sampling_policy policy)
 {
     sampler_association_handle h = sassoc_handles_.acquire();
+    if (sampler_queue_) f = sampler_queue_->wrap(std::move(f));
 
     foreach_group(
         [&](cell_group_ptr& group) { group->add_sampler(h, probe_ids, sched, f, policy); });
@@ -455,10 +1458,280 @@ sampler_association_handle simulation_state::add_sampler(
     return h;
 }
 
+sampler_association_handle simulation_state::add_matrix_sampler(
+        cell_member_predicate probe_ids,
+        schedule sched,
+        matrix_sampler_function f,
+        sampling_policy policy)
+{
+    sampler_association_handle h = sassoc_handles_.acquire();
+    if (sampler_queue_) f = sampler_queue_->wrap(std::move(f));
+
+    foreach_group(
+        [&](cell_group_ptr& group) { group->add_matrix_sampler(h, probe_ids, sched, f, policy); });
+
+    return h;
+}
+
+sampler_association_handle simulation_state::add_triggered_sampler(
+        cell_member_predicate probe_ids,
+        sampling_window window,
+        sampler_function f)
+{
+    if (!(window.pre>=0) || !(window.post>=0)) {
+        throw arbor_exception(util::pprintf("invalid sampling window [-{}, {}]", window.pre, window.post));
+    }
+
+    sampler_association_handle h = sassoc_handles_.acquire();
+    if (sampler_queue_) f = sampler_queue_->wrap(std::move(f));
+
+    foreach_group(
+        [&](cell_group_ptr& group) { group->add_triggered_sampler(h, probe_ids, window, f); });
+
+    return h;
+}
+
+void simulation_state::trigger_sampler(sampler_association_handle h, time_type t) {
+    foreach_group(
+        [&](cell_group_ptr& group) { group->trigger_sampler(h, t); });
+}
+
+void simulation_state::set_sampler_threads(unsigned n_threads, std::size_t capacity) {
+    if (!n_threads) {
+        sampler_queue_ = nullptr;
+        return;
+    }
+    sampler_queues_.push_back(std::make_unique<sampler_queue>(n_threads, capacity));
+    sampler_queue_ = sampler_queues_.back().get();
+}
+
+void simulation_state::flush_sampler_queues() {
+    for (auto& q: sampler_queues_) q->flush();
+}
+
+void simulation_state::reduced_sampler::add(time_type t, const double* begin, const double* end) {
+    if (std::size_t(end-begin)!=width) {
+        throw arbor_exception(util::pprintf("reduced sampler expects samples of {} values, but a sample has {}", width, end-begin));
+    }
+
+    std::lock_guard<std::mutex> guard(mutex);
+    auto& sum = local[t];
+    sum.resize(width, 0.);
+    for (std::size_t i = 0; i<width; ++i) {
+        sum[i] += begin[i];
+    }
+}
+
+sampler_association_handle simulation_state::add_reduced_sampler(
+        cell_member_predicate probe_ids,
+        schedule sched,
+        reduced_sampler_function f,
+        std::size_t width,
+        unsigned interval,
+        int root,
+        sampling_policy policy)
+{
+    if (!interval) {
+        throw arbor_exception("reduced sampler interval must be at least one epoch");
+    }
+    if (root<0 || root>=distributed_->size()) {
+        throw arbor_exception(util::pprintf("reduced sampler root {} is not a domain", root));
+    }
+
+    auto r = std::make_shared<reduced_sampler>();
+    r->sched = sched;
+    r->fn = std::move(f);
+    r->width = width;
+    r->interval = interval;
+    r->root = root;
+
+    sampler_function accumulate = [r](probe_metadata, std::size_t n, const sample_record* records) {
+        for (std::size_t i = 0; i<n; ++i) {
+            if (auto* v = util::any_cast<const double*>(records[i].data)) {
+                r->add(records[i].time, v, v+1);
+            }
+            else if (auto* range = util::any_cast<const cable_sample_range*>(records[i].data)) {
+                r->add(records[i].time, range->first, range->second);
+            }
+            else {
+                throw arbor_exception("reduced sampler requires samples of type double or cable_sample_range");
+            }
+        }
+    };
+
+    auto h = add_sampler(std::move(probe_ids), std::move(sched), std::move(accumulate), policy);
+    reduced_samplers_[h] = std::move(r);
+    return h;
+}
+
+void simulation_state::complete_reduction(reduced_sampler& r) {
+    if (!r.request.pending()) return;
+
+    auto sums = r.request.wait();
+    if (sums.empty()) return;
+
+    std::vector<reduced_sample_record> records;
+    for (auto i: util::count_along(r.times)) {
+        records.push_back({r.times[i], sums.data()+i*r.width});
+    }
+    r.fn(r.width, records.size(), records.data());
+}
+
+void simulation_state::post_reductions(epoch current, bool last) {
+    bool flushed = last;
+    for (auto& [h, r]: reduced_samplers_) {
+        if (!last && (current.id+1)%r->interval) continue;
+
+        // Samples held back by the cell groups must be in the local sums.
+        if (!flushed) {
+            foreach_group([](cell_group_ptr& group) { group->flush_samples(); });
+            flushed = true;
+        }
+
+        complete_reduction(*r);
+
+        // Samples are taken no earlier than the start of the epoch in which
+        // they are due, so those taken at or after the end of this epoch are
+        // from groups that have been advanced further, and are posted with a
+        // later reduction.
+        auto ev = r->sched.events(r->t_posted, current.t1);
+        r->times.assign(ev.first, ev.second);
+        r->t_posted = current.t1;
+
+        std::vector<double> values(r->times.size()*r->width, 0.);
+        auto end = r->local.lower_bound(current.t1);
+        if (!r->times.empty()) {
+            for (auto i = r->local.begin(); i!=end; ++i) {
+                auto k = std::lower_bound(r->times.begin(), r->times.end(), i->first)-r->times.begin();
+                k = std::min<std::ptrdiff_t>(k, r->times.size()-1);
+                for (std::size_t j = 0; j<r->width; ++j) {
+                    values[k*r->width+j] += i->second[j];
+                }
+            }
+        }
+        r->local.erase(r->local.begin(), end);
+
+        r->request = distributed_->sum_async(std::move(values), r->root);
+        if (last) complete_reduction(*r);
+    }
+}
+
+void simulation_state::population_monitor::count(const std::vector<spike>& spikes) {
+    std::int64_t k = -1;
+    double* counts = nullptr;
+    for (const auto& s: spikes) {
+        auto i = population.find(s.source.gid);
+        if (i==population.end()) continue;
+
+        // Spikes are mostly in time order, so the bin is usually unchanged.
+        auto bin = (std::int64_t)std::floor(s.time/bin_width);
+        if (bin!=k) {
+            auto& c = local[bin];
+            c.resize(n_population, 0.);
+            counts = c.data();
+            k = bin;
+        }
+        counts[i->second] += 1;
+    }
+}
+
+population_monitor_handle simulation_state::add_population_monitor(
+        population_function population,
+        std::size_t n_population,
+        time_type bin_width,
+        population_count_function f,
+        unsigned interval,
+        int root)
+{
+    if (!(bin_width>0)) {
+        throw arbor_exception(util::pprintf("population monitor bin width {} is not positive", bin_width));
+    }
+    if (!interval) {
+        throw arbor_exception("population monitor interval must be at least one epoch");
+    }
+    if (root<0 || root>=distributed_->size()) {
+        throw arbor_exception(util::pprintf("population monitor root {} is not a domain", root));
+    }
+
+    population_monitor m;
+    for (const auto& [gid, info]: gid_to_local_) {
+        if (auto p = population(gid)) {
+            if (*p>=n_population) {
+                throw arbor_exception(util::pprintf("population {} of gid {} is not one of {} populations", *p, gid, n_population));
+            }
+            m.population[gid] = *p;
+        }
+    }
+    m.n_population = n_population;
+    m.bin_width = bin_width;
+    m.fn = std::move(f);
+    m.interval = interval;
+    m.root = root;
+    m.t_posted = epoch_.t1;
+
+    auto h = population_handles_.acquire();
+    population_monitors_[h] = std::move(m);
+    return h;
+}
+
+void simulation_state::remove_population_monitor(population_monitor_handle h) {
+    population_monitors_.erase(h);
+    population_handles_.release(h);
+}
+
+void simulation_state::complete_population_counts(population_monitor& m) {
+    if (!m.request.pending()) return;
+
+    auto counts = m.request.wait();
+    if (counts.empty()) return;
+
+    std::vector<population_count_record> records;
+    for (auto i: util::count_along(m.bins)) {
+        records.push_back({m.bins[i].first, m.bins[i].second, counts.data()+i*m.n_population});
+    }
+    m.fn(m.n_population, records.size(), records.data());
+}
+
+void simulation_state::post_population_counts(epoch current, time_type t_counted, bool last) {
+    for (auto& [h, m]: population_monitors_) {
+        if (!last && (current.id+1)%m.interval) continue;
+
+        complete_population_counts(m);
+
+        // Bins are posted up to bin index k_end, and no further than t_end.
+        auto k_end = (std::int64_t)(last? std::ceil(t_counted/m.bin_width): std::floor(t_counted/m.bin_width));
+        time_type t_end = last? t_counted: k_end*m.bin_width;
+        if (t_end<=m.t_posted) continue;
+
+        m.bins.clear();
+        std::vector<double> values;
+        for (auto k = (std::int64_t)std::floor(m.t_posted/m.bin_width); k<k_end; ++k) {
+            time_type t0 = std::max(k*m.bin_width, m.t_posted);
+            time_type t1 = std::min((k+1)*m.bin_width, t_end);
+            if (t0>=t1) continue;
+
+            m.bins.push_back({t0, t1});
+            auto i = m.local.find(k);
+            if (i!=m.local.end()) {
+                values.insert(values.end(), i->second.begin(), i->second.end());
+            }
+            else {
+                values.resize(values.size()+m.n_population, 0.);
+            }
+        }
+        m.local.erase(m.local.begin(), m.local.lower_bound(k_end));
+        m.t_posted = t_end;
+
+        m.request = distributed_->sum_async(std::move(values), m.root);
+        if (last) complete_population_counts(m);
+    }
+}
+
 void simulation_state::remove_sampler(sampler_association_handle h) {
     foreach_group(
         [h](cell_group_ptr& group) { group->remove_sampler(h); });
 
+    reduced_samplers_.erase(h);
     sassoc_handles_.release(h);
 }
 
@@ -466,6 +1739,7 @@ void simulation_state::remove_all_samplers() {
     foreach_group(
         [](cell_group_ptr& group) { group->remove_all_samplers(); });
 
+    reduced_samplers_.clear();
     sassoc_handles_.clear();
 }
 
@@ -483,20 +1757,402 @@ void simulation_state::set_binning_policy(binning_kind policy, time_type bin_int
         [&](cell_group_ptr& group) { group->set_binning_policy(policy, bin_interval); });
 }
 
+void simulation_state::set_event_delivery(event_delivery_kind kind) {
+    foreach_group(
+        [&](cell_group_ptr& group) { group->set_event_delivery(kind); });
+}
+
+void simulation_state::set_event_storage(event_storage_kind kind) {
+    // Events held in the calendar are returned to the pending events, from
+    // which the next event lanes are formed.
+    if (event_storage_==event_storage_kind::calendar && kind!=event_storage_kind::calendar && !calendar_.empty()) {
+        std::vector<pse_vector> held(calendar_.num_cells());
+        for (auto cell: util::count_along(held)) {
+            calendar_.copy(cell, held[cell]);
+        }
+        pending_events_.append(held);
+        calendar_.clear(epoch_.t1);
+    }
+    event_storage_ = kind;
+}
+
+void simulation_state::set_cost_accounting(bool enable) {
+    cost_accounting_ = enable;
+    if (enable) clear_costs();
+    for (auto i: util::count_along(cell_groups_)) {
+        cell_groups_[i]->set_phase_times(enable? &group_costs_[i].phases: nullptr);
+    }
+}
+
+void simulation_state::clear_costs() {
+    std::fill(group_costs_.begin(), group_costs_.end(), group_cost_record{});
+    group_costs_.resize(cell_groups_.size());
+}
+
+cell_group_costs simulation_state::group_costs() const {
+    cell_group_costs costs;
+    for (auto i: util::count_along(group_costs_)) {
+        const auto& r = group_costs_[i];
+        cell_group_cost c;
+        c.kind = cell_groups_[i]->get_cell_kind();
+        c.gids.resize(communicator_.group_queue_range(i).second-communicator_.group_queue_range(i).first);
+        c.updates = r.updates;
+        c.event_setup = r.enqueue + r.phases.event_setup;
+        c.sampling = r.phases.sampling;
+        c.integrate = std::max(0., r.advance - r.phases.event_setup - r.phases.sampling);
+        c.events = r.events;
+        c.spikes = r.spikes;
+        costs.groups.push_back(std::move(c));
+    }
+    for (const auto& [gid, info]: gid_to_local_) {
+        if (info.group_index<costs.groups.size()) {
+            auto first = communicator_.group_queue_range(info.group_index).first;
+            costs.groups[info.group_index].gids[info.cell_index-first] = gid;
+        }
+    }
+    return costs;
+}
+
+std::vector<double> simulation_state::cell_costs() const {
+    // The costs are gathered as spikes, with the cost of a cell in place of
+    // the spike time, as these are the only values with a gid that the
+    // distributed context gathers from all domains.
+    std::vector<spike> local;
+    for (const auto& group: group_costs().groups) {
+        auto cost = group.gids.empty()? 0.: group.time()/group.gids.size();
+        for (auto gid: group.gids) {
+            local.push_back({{gid, 0}, cost});
+        }
+    }
+    auto global = distributed_->gather_spikes(local);
+
+    std::vector<double> costs(num_global_cells_);
+    for (const auto& s: global.values()) {
+        if (s.source.gid<costs.size()) costs[s.source.gid] = s.time;
+    }
+    return costs;
+}
+
+std::ostream& operator<<(std::ostream& o, const cell_group_costs& costs) {
+    std::vector<std::size_t> order(costs.groups.size());
+    std::iota(order.begin(), order.end(), 0);
+    util::stable_sort_by(order, [&](std::size_t i) { return -costs.groups[i].time(); });
+
+    o << util::strprintf("%8s %-12s %8s %10s %8s %12s %12s %12s %12s %12s %10s\n",
+        "group", "kind", "cells", "first gid", "updates",
+        "setup ms", "integrate ms", "sampling ms", "total ms", "events", "spikes");
+    for (auto i: order) {
+        const auto& c = costs.groups[i];
+        o << util::strprintf("%8zu %-12s %8zu %10s %8llu %12.3f %12.3f %12.3f %12.3f %12llu %10llu\n",
+            i, util::pprintf("{}", c.kind), c.gids.size(),
+            c.gids.empty()? std::string("-"): std::to_string(c.gids.front()),
+            (unsigned long long)c.updates,
+            c.event_setup*1e3, c.integrate*1e3, c.sampling*1e3, c.time()*1e3,
+            (unsigned long long)c.events, (unsigned long long)c.spikes);
+    }
+    return o;
+}
+
+arb::memory_footprint simulation_state::memory_footprint() const {
+    arb::memory_footprint m;
+    m.communicator.host = communicator_.bytes();
+    if (auto map = target_resolution_map_.lock()) {
+        m.label_resolution.host = map->bytes();
+    }
+
+    m.events.host = pending_events_.bytes() + calendar_.bytes() + exchanged_local_spikes_.capacity()*sizeof(spike);
+    for (const auto& lanes: event_lanes_) {
+        for (const auto& lane: lanes) m.events.host += lane.capacity()*sizeof(spike_event);
+    }
+    for (const auto& spikes: local_spikes_) {
+        m.events.host += spikes.bytes();
+    }
+
+    for (const auto& group: cell_groups_) {
+        m.cell_groups.push_back(group->state_memory());
+        m.samplers += group->sample_memory();
+    }
+    for (const auto& [h, r]: reduced_samplers_) {
+        std::lock_guard<std::mutex> lock(r->mutex);
+        m.samplers.host += r->local.size()*(sizeof(time_type)+r->width*sizeof(double))
+                         + r->times.capacity()*sizeof(time_type);
+    }
+    return m;
+}
+
+memory_use memory_footprint::total() const {
+    memory_use t = communicator;
+    t += label_resolution;
+    t += events;
+    t += samplers;
+    for (const auto& g: cell_groups) t += g;
+    return t;
+}
+
+std::ostream& operator<<(std::ostream& o, const memory_footprint& m) {
+    auto row = [&o](const std::string& name, const memory_use& u) {
+        o << util::strprintf("%-20s %12.3f %12.3f %12.3f\n", name,
+            u.host/1048576., u.device/1048576., u.total()/1048576.);
+    };
+
+    memory_use groups;
+    for (const auto& g: m.cell_groups) groups += g;
+
+    o << util::strprintf("%-20s %12s %12s %12s\n", "", "host MB", "device MB", "total MB");
+    row("communicator", m.communicator);
+    row("label resolution", m.label_resolution);
+    row("events", m.events);
+    row("samplers", m.samplers);
+    row(util::pprintf("cell groups ({})", m.cell_groups.size()), groups);
+    row("total", m.total());
+    return o;
+}
+
+scaling_estimate simulation_state::estimate_scaling(const spike_traffic& traffic, time_type tfinal) {
+    using timer = profile::timer<>;
+
+    scaling_estimate est;
+    est.num_domains = num_domains();
+    est.num_cells = communicator_.num_local_cells();
+    est.num_connections = communicator_.num_connections();
+    est.connection_bytes = communicator_.bytes();
+    est.epoch_length = t_interval_;
+
+    std::vector<cell_gid_type> gids;
+    for (const auto& [gid, info]: gid_to_local_) {
+        gids.push_back(gid);
+    }
+    std::sort(gids.begin(), gids.end());
+
+    // Recorded spikes of the local cells, in time order.
+    std::vector<spike> recorded;
+    for (const auto& s: traffic.spikes) {
+        if (gid_to_local_.count(s.source.gid)) recorded.push_back(s);
+    }
+    util::stable_sort_by(recorded, [](const spike& s) { return s.time; });
+    auto next = recorded.begin();
+
+    std::mt19937_64 rng(traffic.seed);
+    auto record = [](epoch_statistic& stat, double value) {
+        stat.mean += value;
+        stat.max = std::max(stat.max, value);
+    };
+
+    const auto num_spikes = communicator_.num_spikes();
+    event_buffer queues(est.num_cells);
+    for (time_type t0 = 0; t0<tfinal; ++est.num_epochs) {
+        auto t1 = std::min(t0+t_interval_, tfinal);
+
+        std::vector<spike> local;
+        if (traffic.spikes.empty()) {
+            double expected = traffic.rate*1e-3*(t1-t0)*gids.size();
+            if (expected>0) {
+                std::uniform_int_distribution<std::size_t> cell(0, gids.size()-1);
+                std::uniform_real_distribution<time_type> time(t0, t1);
+                for (auto n = std::poisson_distribution<std::size_t>(expected)(rng); n; --n) {
+                    local.push_back({{gids[cell(rng)], 0}, time(rng)});
+                }
+            }
+        }
+        else {
+            auto end = std::lower_bound(next, recorded.end(), t1,
+                [](const spike& s, time_type t) { return s.time<t; });
+            local.assign(next, end);
+            next = end;
+        }
+        record(est.local_spikes, local.size());
+
+        auto tic = timer::tic();
+        auto global = communicator_.exchange(std::move(local));
+        record(est.exchange_time, timer::toc(tic));
+        record(est.received_spikes, global.size());
+        record(est.received_bytes, global.size()*sizeof(spike));
+
+        queues.clear();
+        tic = timer::tic();
+        communicator_.make_event_queues(global, queues);
+        record(est.event_time, timer::toc(tic));
+        record(est.events, queues.size());
+
+        std::size_t max_cell = 0;
+        for (auto i: util::make_span(est.num_cells)) {
+            max_cell = std::max(max_cell, queues[i].size());
+        }
+        record(est.max_cell_events, max_cell);
+
+        t0 = t1;
+    }
+    communicator_.set_num_spikes(num_spikes);
+
+    if (est.num_epochs) {
+        for (auto stat: {&est.local_spikes, &est.received_spikes, &est.received_bytes, &est.events,
+                         &est.max_cell_events, &est.exchange_time, &est.event_time}) {
+            stat->mean /= est.num_epochs;
+        }
+    }
+    return est;
+}
+
+std::ostream& operator<<(std::ostream& o, const scaling_estimate& est) {
+    o << util::strprintf("scaling estimate for one of %d domains\n", est.num_domains);
+    o << util::strprintf("  %-20s %12u\n", "cells", est.num_cells);
+    o << util::strprintf("  %-20s %12zu\n", "connections", est.num_connections);
+    o << util::strprintf("  %-20s %12.3f\n", "connection memory MB", est.connection_bytes*1e-6);
+    o << util::strprintf("  %-20s %12.3f\n", "epoch length ms", est.epoch_length);
+    o << util::strprintf("  %-20s %12u\n", "epochs", est.num_epochs);
+    o << util::strprintf("  %-20s %12s %12s\n", "per epoch", "mean", "max");
+    auto row = [&](const char* name, const epoch_statistic& stat, double scale) {
+        o << util::strprintf("  %-20s %12.3f %12.3f\n", name, stat.mean*scale, stat.max*scale);
+    };
+    row("local spikes", est.local_spikes, 1);
+    row("received spikes", est.received_spikes, 1);
+    row("received MB", est.received_bytes, 1e-6);
+    row("events", est.events, 1);
+    row("max cell events", est.max_cell_events, 1);
+    row("exchange ms", est.exchange_time, 1e3);
+    row("events ms", est.event_time, 1e3);
+    return o;
+}
+
 void simulation_state::inject_events(const cse_vector& events) {
+    const time_type t0 = inject_horizon_.value_or(epoch_.t1);
+
     // Push all events that are to be delivered to local cells into the
     // pending event list for the event's target cell.
+    std::vector<pse_vector> injected(pending_events_.num_cells());
     for (auto& [gid, pse_vector]: events) {
         for (auto& e: pse_vector) {
-            if (e.time < epoch_.t1) {
-                throw bad_event_time(e.time, epoch_.t1);
+            if (e.time < t0) {
+                throw bad_event_time(e.time, t0);
             }
             // gid_to_local_ maps gid to index in local cells and of corresponding cell group.
             if (auto lidx = util::value_by_key(gid_to_local_, gid)) {
-                pending_events_[lidx->cell_index].push_back(e);
+                injected[lidx->cell_index].push_back(e);
             }
         }
     }
+    pending_events_.append(injected);
+}
+
+void simulation_state::inject_events(std::size_t n, const cell_gid_type* gids, const cell_lid_type* targets,
+                                     const time_type* times, const float* weights)
+{
+    const time_type t0 = inject_horizon_.value_or(epoch_.t1);
+    constexpr auto npos = cell_size_type(-1);
+
+    // Count the events of each local cell, then scatter them into the pending
+    // events, which are only modified once all events have been checked.
+    std::vector<cell_size_type> cell(n, npos);
+    for (std::size_t i = 0; i<n; ++i) {
+        if (times[i] < t0) {
+            throw bad_event_time(times[i], t0);
+        }
+        if (auto lidx = util::value_by_key(gid_to_local_, gids[i])) {
+            cell[i] = lidx->cell_index;
+        }
+    }
+    for (auto c: cell) {
+        if (c!=npos) pending_events_.count(c);
+    }
+    pending_events_.allocate();
+    for (std::size_t i = 0; i<n; ++i) {
+        if (cell[i]!=npos) pending_events_.push(cell[i], spike_event{targets[i], times[i], weights[i]});
+    }
+}
+
+// A checkpoint holds the state at the end of the last epoch: the state of each
+// cell group, the events in the current lanes that are yet to be delivered,
+// and the events of the spikes exchanged at the end of the epoch. Event
+// generators are brought to the end of the epoch by replaying them.
+
+constexpr std::uint64_t checkpoint_magic = 0x74706b6362726161; // "aarbckpt"
+constexpr std::uint32_t checkpoint_version = 4;
+
+void simulation_state::serialize(std::ostream& os) const {
+    io::serializer out(os);
+
+    out.value(checkpoint_magic);
+    out.value(checkpoint_version);
+    out.value(epoch_);
+    out.value(communicator_.num_spikes());
+    communicator_.serialize(out);
+
+    out.value<std::uint64_t>(cell_groups_.size());
+    for (auto i: util::count_along(cell_groups_)) {
+        auto cells = communicator_.group_queue_range(i);
+        out.value(cell_groups_[i]->get_cell_kind());
+        out.value(cells.second-cells.first);
+        cell_groups_[i]->serialize(out);
+    }
+
+    const auto& lanes = event_lanes_[epoch_.id&1];
+    for (auto cell: util::make_span(communicator_.num_local_cells())) {
+        const auto& lane = lanes[cell];
+        std::size_t first = std::lower_bound(lane.begin(), lane.end(), epoch_.t1, event_time_less())-lane.begin();
+        out.array(lane.data()+first, lane.size()-first);
+
+        // Events held in the calendar are restored as pending events.
+        auto pending = pending_events_[cell];
+        if (calendar_.size(cell)) {
+            pse_vector held(pending.begin(), pending.end());
+            calendar_.copy(cell, held);
+            out.array(held.data(), held.size());
+        }
+        else {
+            out.array(pending.begin(), pending.size());
+        }
+    }
+}
+
+void simulation_state::deserialize(std::istream& is) {
+    io::deserializer in(is);
+
+    in.expect(checkpoint_magic, "checkpoint format");
+    in.expect(checkpoint_version, "checkpoint version");
+    auto ep = in.value<epoch>();
+    communicator_.set_num_spikes(in.value<std::uint64_t>());
+    communicator_.deserialize(in);
+
+    in.expect<std::uint64_t>(cell_groups_.size(), "number of cell groups");
+    for (auto i: util::count_along(cell_groups_)) {
+        auto cells = communicator_.group_queue_range(i);
+        in.expect(cell_groups_[i]->get_cell_kind(), "cell kind");
+        in.expect(cells.second-cells.first, "number of cells");
+        cell_groups_[i]->deserialize(in, ep.t1);
+    }
+
+    const auto n_cell = communicator_.num_local_cells();
+    for (auto& lanes: event_lanes_) {
+        for (auto& lane: lanes) {
+            lane.clear();
+        }
+    }
+    std::vector<pse_vector> pending(n_cell);
+    for (auto cell: util::make_span(n_cell)) {
+        in.vector(event_lanes(ep.id)[cell]);
+        in.vector(pending[cell]);
+    }
+    pending_events_.clear();
+    pending_events_.append(pending);
+    calendar_.clear(ep.t1);
+
+    for (auto& lane: event_generators_) {
+        for (auto& gen: lane) {
+            gen.reset();
+            gen.events(0, ep.t1);
+        }
+    }
+
+    for (auto& spikes: local_spikes_) {
+        spikes.clear();
+    }
+
+    for (auto& [h, m]: population_monitors_) {
+        m.local.clear();
+        m.t_posted = ep.t1;
+    }
+
+    epoch_ = ep;
 }
 
 // Simulation class implementations forward to implementation class.
@@ -510,13 +2166,53 @@ simulation::simulation(
 }
 
 void simulation::reset() {
+    if (impl_->running()) {
+        throw arbor_exception("simulation can't be reset while running");
+    }
     impl_->reset();
 }
 
 time_type simulation::run(time_type tfinal, time_type dt) {
+    if (impl_->running()) {
+        throw arbor_exception("simulation is already running");
+    }
     return impl_->run(tfinal, dt);
 }
 
+void simulation::start(time_type dt) {
+    impl_->start(dt);
+}
+
+std::future<time_type> simulation::run_until(time_type t) {
+    return impl_->run_until(t);
+}
+
+void simulation::stop() {
+    impl_->stop();
+}
+
+std::vector<time_type> run_ensemble(const std::vector<simulation*>& sims, time_type tfinal, time_type dt) {
+    std::vector<time_type> t(sims.size());
+    if (sims.empty()) return t;
+
+    const auto& ts = sims.front()->impl_->task_system();
+    for (auto s: sims) {
+        if (s->impl_->task_system()!=ts) {
+            throw arbor_exception("simulations of an ensemble must be built on the same context");
+        }
+        if (s->impl_->num_domains()>1) {
+            throw arbor_exception("simulations of an ensemble must not be distributed");
+        }
+    }
+
+    threading::task_group g(ts.get());
+    for (std::size_t i = 0; i<sims.size(); ++i) {
+        g.run([&, i]() { t[i] = sims[i]->run(tfinal, dt); });
+    }
+    g.wait();
+    return t;
+}
+
 sampler_association_handle simulation::add_sampler(
     cell_member_predicate probe_ids,
     schedule sched,
@@ -526,6 +2222,43 @@ sampler_association_handle simulation::add_sampler(
     return impl_->add_sampler(std::move(probe_ids), std::move(sched), std::move(f), policy);
 }
 
+sampler_association_handle simulation::add_matrix_sampler(
+    cell_member_predicate probe_ids,
+    schedule sched,
+    matrix_sampler_function f,
+    sampling_policy policy)
+{
+    return impl_->add_matrix_sampler(std::move(probe_ids), std::move(sched), std::move(f), policy);
+}
+
+sampler_association_handle simulation::add_triggered_sampler(
+    cell_member_predicate probe_ids,
+    sampling_window window,
+    sampler_function f)
+{
+    return impl_->add_triggered_sampler(std::move(probe_ids), window, std::move(f));
+}
+
+void simulation::trigger_sampler(sampler_association_handle h, time_type t) {
+    impl_->trigger_sampler(h, t);
+}
+
+void simulation::set_sampler_threads(unsigned n_threads, std::size_t capacity) {
+    impl_->set_sampler_threads(n_threads, capacity);
+}
+
+sampler_association_handle simulation::add_reduced_sampler(
+    cell_member_predicate probe_ids,
+    schedule sched,
+    reduced_sampler_function f,
+    std::size_t width,
+    unsigned interval,
+    int root,
+    sampling_policy policy)
+{
+    return impl_->add_reduced_sampler(std::move(probe_ids), std::move(sched), std::move(f), width, interval, root, policy);
+}
+
 void simulation::remove_sampler(sampler_association_handle h) {
     impl_->remove_sampler(h);
 }
@@ -534,6 +2267,21 @@ void simulation::remove_all_samplers() {
     impl_->remove_all_samplers();
 }
 
+population_monitor_handle simulation::add_population_monitor(
+    population_function population,
+    std::size_t n_population,
+    time_type bin_width,
+    population_count_function f,
+    unsigned interval,
+    int root)
+{
+    return impl_->add_population_monitor(std::move(population), n_population, bin_width, std::move(f), interval, root);
+}
+
+void simulation::remove_population_monitor(population_monitor_handle h) {
+    impl_->remove_population_monitor(h);
+}
+
 std::vector<probe_metadata> simulation::get_probe_metadata(cell_member_type probe_id) const {
     return impl_->get_probe_metadata(probe_id);
 }
@@ -542,10 +2290,62 @@ std::size_t simulation::num_spikes() const {
     return impl_->num_spikes();
 }
 
+void simulation::set_cost_accounting(bool enable) {
+    impl_->set_cost_accounting(enable);
+}
+
+cell_group_costs simulation::group_costs() const {
+    return impl_->group_costs();
+}
+
+std::vector<double> simulation::cell_costs() const {
+    return impl_->cell_costs();
+}
+
+memory_footprint simulation::memory_footprint() const {
+    return impl_->memory_footprint();
+}
+
+scaling_estimate simulation::estimate_scaling(const spike_traffic& traffic, time_type tfinal) {
+    return impl_->estimate_scaling(traffic, tfinal);
+}
+
 void simulation::set_binning_policy(binning_kind policy, time_type bin_interval) {
     impl_->set_binning_policy(policy, bin_interval);
 }
 
+void simulation::set_event_delivery(event_delivery_kind kind) {
+    impl_->set_event_delivery(kind);
+}
+
+void simulation::set_spike_exchange(spike_exchange_kind kind) {
+    impl_->set_spike_exchange(kind);
+}
+
+void simulation::set_event_sort(event_sort_kind kind) {
+    impl_->set_event_sort(kind);
+}
+
+void simulation::set_event_storage(event_storage_kind kind) {
+    impl_->set_event_storage(kind);
+}
+
+void simulation::set_epoch_schedule(epoch_schedule kind) {
+    impl_->set_epoch_schedule(kind);
+}
+
+void simulation::set_group_affinity(group_affinity affinity) {
+    impl_->set_group_affinity(affinity);
+}
+
+void simulation::set_group_rebalancing(unsigned interval) {
+    impl_->set_group_rebalancing(interval);
+}
+
+void simulation::set_external_spike_port(std::shared_ptr<external_spike_port> port) {
+    impl_->set_external_spike_port(std::move(port));
+}
+
 void simulation::set_global_spike_callback(spike_export_function export_callback) {
     impl_->global_export_callback_ = std::move(export_callback);
 }
@@ -554,10 +2354,32 @@ void simulation::set_local_spike_callback(spike_export_function export_callback)
     impl_->local_export_callback_ = std::move(export_callback);
 }
 
+void simulation::serialize(std::ostream& out) const {
+    impl_->serialize(out);
+}
+
+void simulation::deserialize(std::istream& in) {
+    impl_->deserialize(in);
+}
+
 void simulation::inject_events(const cse_vector& events) {
     impl_->inject_events(events);
 }
 
+void simulation::inject_events(std::size_t n, const cell_gid_type* gids, const cell_lid_type* targets,
+                               const time_type* times, const float* weights)
+{
+    impl_->inject_events(n, gids, targets, times, weights);
+}
+
+void simulation::set_epoch_callback(epoch_function f) {
+    impl_->set_epoch_callback(std::move(f));
+}
+
+void simulation::set_epoch_metrics_callback(epoch_metrics_function f, unsigned interval) {
+    impl_->set_epoch_metrics_callback(std::move(f), interval);
+}
+
 simulation::~simulation() = default;
 
 } // namespace arb
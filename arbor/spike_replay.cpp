@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <tuple>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/spike_replay.hpp>
+#include <arbor/spike_writer.hpp>
+
+#include "util/strprintf.hpp"
+
+namespace arb {
+
+namespace {
+// A record of a spike file, as stored.
+struct record {
+    char bytes[spike_file_record_size];
+
+    std::tuple<std::uint32_t, float> key() const {
+        std::uint32_t gid;
+        float time;
+        std::memcpy(&gid, bytes, sizeof gid);
+        std::memcpy(&time, bytes+sizeof gid+sizeof(std::uint16_t), sizeof time);
+        return {gid, time};
+    }
+};
+static_assert(sizeof(record)==spike_file_record_size, "records are not padded");
+
+// Map the spike file at path, returning the address and size of the mapping;
+// the address is null for an empty file.
+std::pair<void*, std::size_t> map_spike_file(const std::string& path, bool writable) {
+    int fd = ::open(path.c_str(), writable? O_RDWR: O_RDONLY);
+    if (fd<0) throw bad_spike_file(util::pprintf("unable to open {}", path));
+
+    struct stat st;
+    if (::fstat(fd, &st)!=0) {
+        ::close(fd);
+        throw bad_spike_file(util::pprintf("unable to open {}", path));
+    }
+
+    std::size_t size = st.st_size;
+    if (size<sizeof spike_file_magic || (size-sizeof spike_file_magic)%spike_file_record_size) {
+        ::close(fd);
+        throw bad_spike_file(util::pprintf("{} is not a spike file", path));
+    }
+
+    void* addr = ::mmap(nullptr, size, writable? PROT_READ|PROT_WRITE: PROT_READ, writable? MAP_SHARED: MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr==MAP_FAILED) throw bad_spike_file(util::pprintf("unable to map {}", path));
+
+    if (std::memcmp(addr, spike_file_magic, sizeof spike_file_magic)) {
+        ::munmap(addr, size);
+        throw bad_spike_file(util::pprintf("{} is not a spike file", path));
+    }
+    return {addr, size};
+}
+} // anonymous namespace
+
+static_assert(spike_file_record_size==10, "spike_replay_file decodes records of 10 bytes");
+
+spike_replay_file::spike_replay_file(const std::string& path) {
+    std::tie(addr_, bytes_) = map_spike_file(path, false);
+    records_ = static_cast<const char*>(addr_)+sizeof spike_file_magic;
+    n_ = (bytes_-sizeof spike_file_magic)/spike_file_record_size;
+
+    // The records are read once in order, which the kernel is advised of.
+    ::madvise(addr_, bytes_, MADV_SEQUENTIAL);
+    auto recs = reinterpret_cast<const record*>(records_);
+    for (std::size_t i = 1; i<n_; ++i) {
+        if (recs[i].key()<recs[i-1].key()) {
+            ::munmap(addr_, bytes_);
+            throw bad_spike_file(util::pprintf("{} is not ordered by gid and time at spike {}", path, i));
+        }
+    }
+    ::madvise(addr_, bytes_, MADV_NORMAL);
+}
+
+spike_replay_file::~spike_replay_file() {
+    ::munmap(addr_, bytes_);
+}
+
+std::pair<std::size_t, std::size_t> spike_replay_file::range(cell_gid_type g) const {
+    auto lower = [&](std::uint64_t v) {
+        std::size_t b = 0, e = n_;
+        while (b<e) {
+            auto m = b+(e-b)/2;
+            if (gid(m)<v) b = m+1; else e = m;
+        }
+        return b;
+    };
+    return {lower(g), lower(std::uint64_t(g)+1)};
+}
+
+void sort_spike_file(const std::string& path) {
+    auto [addr, size] = map_spike_file(path, true);
+    auto first = reinterpret_cast<record*>(static_cast<char*>(addr)+sizeof spike_file_magic);
+    auto last = first+(size-sizeof spike_file_magic)/spike_file_record_size;
+
+    std::stable_sort(first, last, [](const record& a, const record& b) { return a.key()<b.key(); });
+
+    ::msync(addr, size, MS_SYNC);
+    ::munmap(addr, size);
+}
+
+} // namespace arb
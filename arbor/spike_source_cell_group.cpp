@@ -1,5 +1,10 @@
+#include <algorithm>
+#include <cmath>
 #include <exception>
 
+#include <Random123/threefry.h>
+#include <Random123/uniform.hpp>
+
 #include <arbor/arbexcept.hpp>
 #include <arbor/recipe.hpp>
 #include <arbor/spike_source_cell.hpp>
@@ -17,28 +22,39 @@ spike_source_cell_group::spike_source_cell_group(
     const std::vector<cell_gid_type>& gids,
     const recipe& rec,
     cell_label_range& cg_sources,
-    cell_label_range& cg_targets):
-    gids_(gids)
+    cell_label_range& cg_targets)
 {
-    for (auto gid: gids_) {
+    for (auto gid: gids) {
         if (!rec.get_probes(gid).empty()) {
             throw bad_cell_probe(cell_kind::spike_source, gid);
         }
     }
 
-    time_sequences_.reserve(gids_.size());
-    for (auto gid: gids_) {
+    for (auto gid: gids) {
         cg_sources.add_cell();
         cg_targets.add_cell();
-        try {
-            auto cell = util::any_cast<spike_source_cell>(rec.get_cell_description(gid));
-            time_sequences_.push_back(std::move(cell.seq));
-            cg_sources.add_label(cell.source, {0, 1});
+
+        auto description = rec.get_cell_description(gid);
+        if (auto cell = util::any_cast<spike_source_cell>(&description)) {
+            gids_.push_back(gid);
+            time_sequences_.push_back(std::move(cell->seq));
+            cg_sources.add_label(cell->source, {0, 1});
+        }
+        else if (auto cell = util::any_cast<poisson_source_cell>(&description)) {
+            poisson_.add(gid, *cell);
+            cg_sources.add_label(cell->source, {0, 1});
         }
-        catch (std::bad_any_cast& e) {
+        else if (auto cell = util::any_cast<replay_source_cell>(&description)) {
+            if (!cell->file) throw bad_cell_description(cell_kind::spike_source, gid);
+            replay_.add(gid, *cell);
+            cg_sources.add_label(cell->source, {0, 1});
+        }
+        else {
             throw bad_cell_description(cell_kind::spike_source, gid);
         }
     }
+    poisson_.reset();
+    replay_.reset();
 }
 
 cell_kind spike_source_cell_group::get_cell_kind() const {
@@ -47,25 +63,147 @@ cell_kind spike_source_cell_group::get_cell_kind() const {
 
 void spike_source_cell_group::advance(epoch ep, time_type dt, const event_lane_subrange& event_lanes) {
     PE(advance_sscell);
+    advance_schedules(ep, spikes_);
+    poisson_.advance(ep.t1, spikes_);
+    replay_.advance(ep.t1, spikes_);
+    PL();
+}
+
+// The spikes are written straight to the spike store.
+void spike_source_cell_group::advance_collect(epoch ep, time_type dt, const event_lane_subrange& event_lanes, std::vector<spike>& out) {
+    PE(advance_sscell);
+    advance_schedules(ep, out);
+    poisson_.advance(ep.t1, out);
+    replay_.advance(ep.t1, out);
+    PL();
+}
 
+void spike_source_cell_group::advance_schedules(epoch ep, std::vector<spike>& out) {
     for (auto i: util::count_along(gids_)) {
         const auto gid = gids_[i];
 
         for (auto t: util::make_range(time_sequences_[i].events(ep.t0, ep.t1))) {
-            spikes_.push_back({{gid, 0u}, t});
+            out.push_back({{gid, 0u}, t});
         }
     }
-
-    PL();
-};
+}
 
 void spike_source_cell_group::reset() {
     for (auto& s: time_sequences_) {
         s.reset();
     }
+    poisson_.reset();
+    replay_.reset();
+    clear_spikes();
+}
+
+// Spike sources have no state besides their schedules, which are brought to
+// time t by replaying them from the start.
+void spike_source_cell_group::deserialize(io::deserializer&, time_type t) {
+    for (auto& s: time_sequences_) {
+        s.reset();
+        s.events(0, t);
+    }
+    poisson_.reset();
+    std::vector<spike> discard;
+    poisson_.advance(t, discard);
+    replay_.seek(t);
     clear_spikes();
 }
 
+// Poisson sources.
+
+// The k-th uniform variate in (0, 1] of the stream of a source. The two
+// outputs of each call to the generator give consecutive variates.
+static double poisson_uniform(std::uint64_t seed, cell_gid_type gid, std::uint64_t k) {
+    using cbrng = r123::Threefry2x64;
+    const cbrng::key_type key = {{seed, gid}};
+    const cbrng::ctr_type ctr = {{k/2, 0}};
+    return r123::u01<double>(cbrng{}(ctr, key)[k%2]);
+}
+
+void spike_source_cell_group::poisson_population::add(cell_gid_type g, const poisson_source_cell& cell) {
+    gid.push_back(g);
+    seed.push_back(cell.seed);
+    mean_isi.push_back(cell.rate_kHz>0? 1/cell.rate_kHz: terminal_time);
+    tstart.push_back(cell.tstart);
+    tstop.push_back(cell.tstop);
+}
+
+void spike_source_cell_group::poisson_population::reset() {
+    const auto n = gid.size();
+    next.resize(n);
+    count.assign(n, 1);
+    for (unsigned i = 0; i<n; ++i) {
+        next[i] = tstart[i] - mean_isi[i]*std::log(poisson_uniform(seed[i], gid[i], 0));
+    }
+}
+
+// The spikes of the epoch are generated in passes over the sources that
+// still have a spike before its end: each pass emits one spike of every
+// such source and draws the next interval of all of them in bulk, so that
+// the work is a loop over flat arrays rather than a call through a schedule
+// per source.
+void spike_source_cell_group::poisson_population::advance(time_type t1, std::vector<spike>& out) {
+    active.clear();
+    for (unsigned i = 0; i<gid.size(); ++i) {
+        if (next[i]<t1 && next[i]<tstop[i]) active.push_back(i);
+    }
+
+    while (!active.empty()) {
+        for (auto i: active) {
+            out.push_back({{gid[i], 0u}, next[i]});
+        }
+        for (auto i: active) {
+            next[i] -= mean_isi[i]*std::log(poisson_uniform(seed[i], gid[i], count[i]++));
+        }
+        active.erase(
+            std::remove_if(active.begin(), active.end(), [&](unsigned i) { return !(next[i]<t1 && next[i]<tstop[i]); }),
+            active.end());
+    }
+}
+
+// Replay sources.
+
+void spike_source_cell_group::replay_population::add(cell_gid_type g, const replay_source_cell& cell) {
+    auto [b, e] = cell.file->range(cell.file_gid);
+    gid.push_back(g);
+    file.push_back(cell.file);
+    begin.push_back(b);
+    end.push_back(e);
+}
+
+void spike_source_cell_group::replay_population::reset() {
+    cursor = begin;
+}
+
+// The first spike at or after t of each source, found by bisection of its
+// records.
+void spike_source_cell_group::replay_population::seek(time_type t) {
+    cursor.resize(gid.size());
+    for (unsigned i = 0; i<gid.size(); ++i) {
+        const auto& f = *file[i];
+        std::size_t b = begin[i], e = end[i];
+        while (b<e) {
+            auto m = b+(e-b)/2;
+            if (f.time(m)<t) b = m+1; else e = m;
+        }
+        cursor[i] = b;
+    }
+}
+
+// Each source emits its spikes before t1 in a sequential scan of its records.
+void spike_source_cell_group::replay_population::advance(time_type t1, std::vector<spike>& out) {
+    for (unsigned i = 0; i<gid.size(); ++i) {
+        const auto& f = *file[i];
+        auto c = cursor[i];
+        for (; c<end[i] && f.time(c)<t1; ++c) {
+            out.push_back({{gid[i], 0u}, f.time(c)});
+        }
+        cursor[i] = c;
+    }
+}
+
 const std::vector<spike>& spike_source_cell_group::spikes() const {
     return spikes_;
 }
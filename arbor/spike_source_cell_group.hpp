@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
 #include <vector>
 
 #include <arbor/common_types.hpp>
@@ -7,6 +9,7 @@
 #include <arbor/sampling.hpp>
 #include <arbor/schedule.hpp>
 #include <arbor/spike.hpp>
+#include <arbor/spike_source_cell.hpp>
 
 #include "cell_group.hpp"
 #include "epoch.hpp"
@@ -21,9 +24,13 @@ public:
     cell_kind get_cell_kind() const override;
 
     void advance(epoch ep, time_type dt, const event_lane_subrange& event_lanes) override;
+    void advance_collect(epoch ep, time_type dt, const event_lane_subrange& event_lanes, std::vector<spike>& out) override;
 
     void reset() override;
 
+    void serialize(io::serializer& out) const override {}
+    void deserialize(io::deserializer& in, time_type t) override;
+
     void set_binning_policy(binning_kind policy, time_type bin_interval) override {}
 
     const std::vector<spike>& spikes() const override;
@@ -38,8 +45,48 @@ public:
 
 private:
     std::vector<spike> spikes_;
+
+    // Cells described by a schedule.
     std::vector<cell_gid_type> gids_;
     std::vector<schedule> time_sequences_;
+
+    // Poisson sources, in per-source arrays: the time of the next spike of
+    // each, and the index of the interval that follows it.
+    struct poisson_population {
+        std::vector<cell_gid_type> gid;
+        std::vector<std::uint64_t> seed;
+        std::vector<time_type> mean_isi;
+        std::vector<time_type> tstart;
+        std::vector<time_type> tstop;
+        std::vector<time_type> next;
+        std::vector<std::uint64_t> count;
+
+        // Sources with a spike before the end of the current epoch.
+        std::vector<unsigned> active;
+
+        void add(cell_gid_type gid, const poisson_source_cell& cell);
+        void reset();
+        void advance(time_type t1, std::vector<spike>& out);
+    };
+    poisson_population poisson_;
+
+    // Replay sources, with the records of their spikes in their files: the
+    // next spike of each is at cursor, and its last before end.
+    struct replay_population {
+        std::vector<cell_gid_type> gid;
+        std::vector<std::shared_ptr<const spike_replay_file>> file;
+        std::vector<std::size_t> begin;
+        std::vector<std::size_t> cursor;
+        std::vector<std::size_t> end;
+
+        void add(cell_gid_type gid, const replay_source_cell& cell);
+        void reset();
+        void seek(time_type t);
+        void advance(time_type t1, std::vector<spike>& out);
+    };
+    replay_population replay_;
+
+    void advance_schedules(epoch ep, std::vector<spike>& out);
 };
 
 } // namespace arb
@@ -0,0 +1,95 @@
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/spike.hpp>
+#include <arbor/spike_writer.hpp>
+
+#include "io/async_file.hpp"
+#include "util/strprintf.hpp"
+
+namespace arb {
+
+static_assert(spike_file_record_size==sizeof(std::uint32_t)+sizeof(std::uint16_t)+sizeof(float),
+    "spike records hold a 32 bit gid, a 16 bit index and a float time");
+
+struct spike_writer::impl {
+    io::async_file<bad_spike_file> file;
+
+    impl(const std::string& path, std::size_t buffer_size):
+        file(path, buffer_size, spike_file_magic, sizeof spike_file_magic)
+    {}
+};
+
+spike_writer::spike_writer(const std::string& path, std::size_t buffer_size):
+    impl_(new impl(path, buffer_size))
+{}
+
+spike_writer::~spike_writer() = default;
+
+void spike_writer::write(const std::vector<spike>& spikes) {
+    if (spikes.empty()) return;
+
+    for (const auto& s: spikes) {
+        if (s.source.index>std::numeric_limits<std::uint16_t>::max()) {
+            throw bad_spike_file(util::pprintf("source index {} of gid {} exceeds 16 bits", s.source.index, s.source.gid));
+        }
+    }
+
+    impl_->file.append(spikes.size()*spike_file_record_size, [&spikes](char* p) {
+        for (const auto& s: spikes) {
+            std::uint32_t gid = s.source.gid;
+            std::uint16_t lid = s.source.index;
+            float time = s.time;
+
+            std::memcpy(p, &gid, sizeof gid);
+            p += sizeof gid;
+            std::memcpy(p, &lid, sizeof lid);
+            p += sizeof lid;
+            std::memcpy(p, &time, sizeof time);
+            p += sizeof time;
+        }
+    });
+}
+
+spike_export_function spike_writer::callback() {
+    return [this](const std::vector<spike>& spikes) { write(spikes); };
+}
+
+void spike_writer::flush() {
+    impl_->file.flush();
+}
+
+std::vector<spike> read_spikes(std::istream& in) {
+    char magic[sizeof spike_file_magic];
+    if (!in.read(magic, sizeof magic) || std::memcmp(magic, spike_file_magic, sizeof magic)) {
+        throw bad_spike_file("not a spike file");
+    }
+
+    std::vector<spike> spikes;
+    char record[spike_file_record_size];
+    while (in.peek()!=std::istream::traits_type::eof()) {
+        if (!in.read(record, sizeof record)) {
+            throw bad_spike_file("unexpected end of file");
+        }
+
+        std::uint32_t gid;
+        std::uint16_t lid;
+        float time;
+        const char* p = record;
+        std::memcpy(&gid, p, sizeof gid);
+        p += sizeof gid;
+        std::memcpy(&lid, p, sizeof lid);
+        p += sizeof lid;
+        std::memcpy(&time, p, sizeof time);
+
+        spikes.push_back(spike({gid, lid}, time));
+    }
+    return spikes;
+}
+
+} // namespace arb
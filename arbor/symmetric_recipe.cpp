@@ -23,9 +23,9 @@ std::vector<event_generator> symmetric_recipe::event_generators(cell_gid_type i)
 // Take connections_on from the original tile recipe for the cell we are duplicating.
 // Transate the source and destination gids
 std::vector<cell_connection> symmetric_recipe::connections_on(cell_gid_type i) const {
-    int n_local = tiled_recipe_->num_cells();
-    int n_global = num_cells();
-    int offset = (i / n_local) * n_local;
+    cell_gid_type n_local = tiled_recipe_->num_cells();
+    cell_gid_type n_global = num_cells();
+    cell_gid_type offset = (i / n_local) * n_local;
 
     std::vector<cell_connection> conns = tiled_recipe_->connections_on(i % n_local);
 
@@ -35,6 +35,53 @@ std::vector<cell_connection> symmetric_recipe::connections_on(cell_gid_type i) c
     return conns;
 }
 
+const symmetric_recipe::tile_data& symmetric_recipe::get_tile_data() const {
+    std::call_once(tile_data_->built, [this] {
+        auto& d = *tile_data_;
+        cell_gid_type n_local = tiled_recipe_->num_cells();
+        d.kinds.reserve(n_local);
+        d.conn_divs.reserve(n_local+1);
+        d.conn_divs.push_back(0);
+        for (cell_gid_type i = 0; i < n_local; ++i) {
+            d.kinds.push_back(tiled_recipe_->get_cell_kind(i));
+            for (auto& c: tiled_recipe_->connections_on(i)) {
+                d.conns.push_back(std::move(c));
+            }
+            d.conn_divs.push_back(d.conns.size());
+        }
+    });
+    return *tile_data_;
+}
+
+// With a single tile there is nothing to share, and the tile is queried
+// directly.
+void symmetric_recipe::cell_kinds(cell_gid_type begin, cell_gid_type end, cell_kind* out) const {
+    if (tiled_recipe_->num_tiles() < 2) return recipe::cell_kinds(begin, end, out);
+
+    const auto& d = get_tile_data();
+    cell_gid_type n_local = tiled_recipe_->num_cells();
+    for (auto i = begin; i < end; ++i) {
+        *out++ = d.kinds[i % n_local];
+    }
+}
+
+void symmetric_recipe::connections_on_range(cell_gid_type begin, cell_gid_type end, connection_sink& out) const {
+    if (tiled_recipe_->num_tiles() < 2) return recipe::connections_on_range(begin, end, out);
+
+    const auto& d = get_tile_data();
+    cell_gid_type n_local = tiled_recipe_->num_cells();
+    cell_gid_type n_global = num_cells();
+    for (auto i = begin; i < end; ++i) {
+        cell_gid_type offset = (i / n_local) * n_local;
+        auto k = i % n_local;
+        for (auto j = d.conn_divs[k]; j < d.conn_divs[k+1]; ++j) {
+            cell_connection c = d.conns[j];
+            c.source.gid = (c.source.gid + offset) % n_global;
+            out.add(i, std::move(c));
+        }
+    }
+}
+
 std::vector<probe_info> symmetric_recipe::get_probes(cell_gid_type i) const {
     i %= tiled_recipe_->num_cells();
     return tiled_recipe_->get_probes(i);
@@ -44,4 +91,8 @@ std::any symmetric_recipe::get_global_properties(cell_kind ck) const {
     return tiled_recipe_->get_global_properties(ck);
 };
 
+std::optional<double> symmetric_recipe::cell_cost(cell_gid_type i) const {
+    return tiled_recipe_->cell_cost(i % tiled_recipe_->num_cells());
+}
+
 } //namespace arb
\ No newline at end of file
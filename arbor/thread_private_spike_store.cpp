@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include <arbor/common_types.hpp>
@@ -9,10 +10,27 @@
 
 namespace arb {
 
+namespace {
+// The spikes of one thread, and the ends of the runs sorted by source.
+struct spike_buffer {
+    std::vector<spike> spikes;
+    std::vector<std::size_t> runs;
+};
+
+bool source_less(const spike& a, const spike& b) {
+    return a.source<b.source;
+}
+} // namespace
+
 struct local_spike_store_type {
-    threading::enumerable_thread_specific<std::vector<spike>> buffers_;
+    threading::enumerable_thread_specific<spike_buffer> buffers_;
+    task_system_handle task_system_;
+
+    // Working space of gather_sorted().
+    std::vector<spike> merged_;
+    std::vector<std::size_t> divs_;
 
-    local_spike_store_type(const task_system_handle& ts): buffers_(ts) {};
+    local_spike_store_type(const task_system_handle& ts): buffers_(ts), task_system_(ts) {};
 };
 
 thread_private_spike_store::thread_private_spike_store(thread_private_spike_store&& t):
@@ -27,26 +45,93 @@ thread_private_spike_store::~thread_private_spike_store() {}
 
 std::vector<spike> thread_private_spike_store::gather() const {
     std::vector<spike> spikes;
-    unsigned num_spikes = 0u;
+    gather(spikes);
+    return spikes;
+}
+
+void thread_private_spike_store::gather(std::vector<spike>& spikes) const {
+    std::size_t num_spikes = 0u;
     for (auto& b: impl_->buffers_) {
-        num_spikes += b.size();
+        num_spikes += b.spikes.size();
     }
+    spikes.clear();
     spikes.reserve(num_spikes);
 
     for (auto& b: impl_->buffers_) {
-        spikes.insert(spikes.begin(), b.begin(), b.end());
+        spikes.insert(spikes.end(), b.spikes.begin(), b.spikes.end());
     }
+}
 
-    return spikes;
+void thread_private_spike_store::gather_sorted(std::vector<spike>& spikes) const {
+    gather(spikes);
+
+    // Partition the gathered spikes into sorted runs; the spikes of each
+    // buffer after its last run are sorted as one more run.
+    auto& divs = impl_->divs_;
+    divs.assign(1, 0);
+    std::size_t base = 0;
+    for (auto& b: impl_->buffers_) {
+        for (auto e: b.runs) divs.push_back(base+e);
+
+        const std::size_t tail = b.runs.empty()? 0: b.runs.back();
+        if (tail<b.spikes.size()) {
+            std::sort(spikes.begin()+base+tail, spikes.begin()+base+b.spikes.size(), source_less);
+            divs.push_back(base+b.spikes.size());
+        }
+        base += b.spikes.size();
+    }
+
+    // Merge adjacent runs pairwise until one is left.
+    auto& merged = impl_->merged_;
+    while (divs.size()>2) {
+        merged.resize(spikes.size());
+        const std::size_t n_runs = divs.size()-1;
+        const int n_pairs = (n_runs+1)/2;
+        threading::parallel_for::apply(0, n_pairs, impl_->task_system_.get(),
+            [&](int p) {
+                auto b = divs[2*p];
+                auto m = divs[std::min<std::size_t>(2*p+1, n_runs)];
+                auto e = divs[std::min<std::size_t>(2*p+2, n_runs)];
+                std::merge(spikes.begin()+b, spikes.begin()+m, spikes.begin()+m, spikes.begin()+e,
+                           merged.begin()+b, source_less);
+            });
+        std::swap(spikes, merged);
+
+        std::size_t n = 1;
+        for (std::size_t i = 2; i<n_runs; i += 2) divs[n++] = divs[i];
+        divs[n++] = divs[n_runs];
+        divs.resize(n);
+    }
+}
+
+void thread_private_spike_store::close_run() {
+    auto& b = impl_->buffers_.local();
+    const std::size_t begin = b.runs.empty()? 0: b.runs.back();
+    if (begin==b.spikes.size()) return;
+
+    auto first = b.spikes.begin()+begin;
+    if (!std::is_sorted(first, b.spikes.end(), source_less)) {
+        std::sort(first, b.spikes.end(), source_less);
+    }
+    b.runs.push_back(b.spikes.size());
 }
 
 std::vector<spike>& thread_private_spike_store::get() {
-    return impl_->buffers_.local();
+    return impl_->buffers_.local().spikes;
 }
 
 void thread_private_spike_store::clear() {
     for (auto& b: impl_->buffers_) {
-        b.clear();
+        b.spikes.clear();
+        b.runs.clear();
+    }
+}
+
+std::size_t thread_private_spike_store::bytes() const {
+    std::size_t n = impl_->merged_.capacity()*sizeof(spike);
+    for (auto& b: impl_->buffers_) {
+        n += b.spikes.capacity()*sizeof(spike) + b.runs.capacity()*sizeof(std::size_t);
     }
+    return n;
 }
 } // namespace arb
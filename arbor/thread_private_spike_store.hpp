@@ -30,12 +30,31 @@ public :
     /// Does not modify the buffer contents.
     std::vector<spike> gather() const;
 
+    /// Collate all of the individual buffers into the caller-supplied vector,
+    /// replacing its contents. Reusing the same vector across calls avoids
+    /// reallocation once its capacity suffices.
+    void gather(std::vector<spike>& spikes) const;
+
+    /// As gather(), but the spikes are sorted by source. The runs closed by
+    /// close_run() are merged pairwise in a merge tree on the task system,
+    /// in O(n log k) for k runs, and only the spikes appended since the last
+    /// run of each buffer are sorted.
+    void gather_sorted(std::vector<spike>& spikes) const;
+
+    /// Sort the spikes appended to the buffer of the calling thread since its
+    /// last run by source, and close them as a run. Cell groups emit spikes
+    /// for their cells in order, so the sort is usually just a check.
+    void close_run();
+
     /// Return a reference to the thread private buffer of the calling thread
     std::vector<spike>& get();
 
     /// Clear all of the thread private buffers
     void clear();
 
+    /// Bytes allocated by the thread private buffers
+    std::size_t bytes() const;
+
     /// Append the passed spikes to the end of the thread private buffer of the
     /// calling thread
     void insert(const std::vector<spike>& spikes) {
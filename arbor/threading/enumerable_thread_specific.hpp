@@ -7,6 +7,9 @@
 namespace arb {
 namespace threading {
 
+// One value for each thread of a task system. Threads that are not of the
+// task system, such as the thread of a simulation in persistent run mode,
+// share a further value, which at most one of them may use at a time.
 template <typename T>
 class enumerable_thread_specific {
     std::unordered_map<std::thread::id, std::size_t> thread_ids_;
@@ -20,19 +23,19 @@ public:
 
     enumerable_thread_specific(const task_system_handle& ts):
         thread_ids_{ts->get_thread_ids()},
-        data{std::vector<T>(ts->get_num_threads())}
+        data{std::vector<T>(ts->get_num_threads()+1)}
     {}
 
     enumerable_thread_specific(const T& init, const task_system_handle& ts):
         thread_ids_{ts->get_thread_ids()},
-        data{std::vector<T>(ts->get_num_threads(), init)}
+        data{std::vector<T>(ts->get_num_threads()+1, init)}
     {}
 
     T& local() {
-        return data[thread_ids_.at(std::this_thread::get_id())];
+        return data[index()];
     }
     const T& local() const {
-        return data[thread_ids_.at(std::this_thread::get_id())];
+        return data[index()];
     }
 
     auto size() const { return data.size(); }
@@ -45,6 +48,12 @@ public:
 
     const_iterator cbegin() const { return data.cbegin(); }
     const_iterator cend()   const { return data.cend(); }
+
+private:
+    std::size_t index() const {
+        auto i = thread_ids_.find(std::this_thread::get_id());
+        return i==thread_ids_.end()? data.size()-1: i->second;
+    }
 };
 
 } // namespace threading
@@ -1,8 +1,12 @@
 #include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
 
 #include <arbor/assert.hpp>
 #include <arbor/util/scope_exit.hpp>
 
+#include "hardware/affinity.hpp"
 #include "threading/threading.hpp"
 
 using namespace arb::threading::impl;
@@ -25,6 +29,65 @@ priority_task notification_queue::try_pop(int priority) {
     return {};
 }
 
+priority_task notification_queue::try_pop_bound(int priority) {
+    arb_assert(priority < (int)bound_tasks_.size());
+    if (!n_bound_) return {};
+
+    lock q_lock{q_mutex_, std::try_to_lock};
+
+    if (q_lock) {
+        auto& q = bound_tasks_.at(priority);
+        if (!q.empty()) {
+            priority_task ptsk(std::move(q.front()), priority);
+            q.pop_front();
+            --n_bound_;
+            return ptsk;
+        }
+    }
+
+    return {};
+}
+
+priority_task notification_queue::try_pop_affine(int priority) {
+    arb_assert(priority < (int)affine_tasks_.size());
+    if (!n_affine_) return {};
+
+    lock q_lock{q_mutex_, std::try_to_lock};
+
+    if (q_lock) {
+        auto& q = affine_tasks_.at(priority);
+        if (!q.empty()) {
+            priority_task ptsk(std::move(q.front()), priority);
+            q.pop_front();
+            --n_affine_;
+            return ptsk;
+        }
+    }
+
+    return {};
+}
+
+priority_task notification_queue::try_steal_affine(int priority, std::size_t backlog) {
+    arb_assert(priority < (int)affine_tasks_.size());
+    if (n_affine_<backlog) return {};
+
+    lock q_lock{q_mutex_, std::try_to_lock};
+
+    // Take the most recently pushed task, leaving the owner those it
+    // will reach first.
+    if (q_lock && n_affine_>=backlog) {
+        auto& q = affine_tasks_.at(priority);
+        if (!q.empty()) {
+            priority_task ptsk(std::move(q.back()), priority);
+            q.pop_back();
+            --n_affine_;
+            return ptsk;
+        }
+    }
+
+    return {};
+}
+
 priority_task notification_queue::pop() {
     lock q_lock{q_mutex_};
 
@@ -32,8 +95,19 @@ priority_task notification_queue::pop() {
         q_tasks_available_.wait(q_lock);
     }
     for (int pri = n_priority-1; pri>=0; --pri) {
-        auto& q = q_tasks_.at(pri);
-        if (!q.empty()) {
+        if (auto& q = bound_tasks_.at(pri); !q.empty()) {
+            priority_task ptsk{std::move(q.front()), pri};
+            q.pop_front();
+            --n_bound_;
+            return ptsk;
+        }
+        if (auto& q = affine_tasks_.at(pri); !q.empty()) {
+            priority_task ptsk{std::move(q.front()), pri};
+            q.pop_front();
+            --n_affine_;
+            return ptsk;
+        }
+        if (auto& q = q_tasks_.at(pri); !q.empty()) {
             priority_task ptsk{std::move(q.front()), pri};
             q.pop_front();
             return ptsk;
@@ -63,6 +137,26 @@ void notification_queue::push(priority_task&& ptsk) {
     q_tasks_available_.notify_all();
 }
 
+void notification_queue::push_bound(priority_task&& ptsk) {
+    arb_assert(ptsk.priority < (int)bound_tasks_.size());
+    {
+        lock q_lock{q_mutex_};
+        bound_tasks_.at(ptsk.priority).push_back(ptsk.release());
+        ++n_bound_;
+    }
+    q_tasks_available_.notify_all();
+}
+
+void notification_queue::push_affine(priority_task&& ptsk) {
+    arb_assert(ptsk.priority < (int)affine_tasks_.size());
+    {
+        lock q_lock{q_mutex_};
+        affine_tasks_.at(ptsk.priority).push_back(ptsk.release());
+        ++n_affine_;
+    }
+    q_tasks_available_.notify_all();
+}
+
 void notification_queue::quit() {
     {
         lock q_lock{q_mutex_};
@@ -75,7 +169,79 @@ bool notification_queue::empty() {
     for(const auto& q: q_tasks_) {
         if (!q.empty()) return false;
     }
-    return true;
+    return !n_bound_ && !n_affine_;
+}
+
+work_stealing_deque::work_stealing_deque() {
+    rings_.emplace_back(new ring(64));
+    ring_.store(rings_.back().get(), std::memory_order_relaxed);
+}
+
+work_stealing_deque::~work_stealing_deque() {
+    auto r = ring_.load(std::memory_order_relaxed);
+    auto b = bottom_.load(std::memory_order_relaxed);
+    for (auto i = top_.load(std::memory_order_relaxed); i<b; ++i) {
+        delete r->get(i);
+    }
+}
+
+void work_stealing_deque::push(task* t) {
+    auto b = bottom_.load(std::memory_order_relaxed);
+    auto top = top_.load(std::memory_order_acquire);
+    auto r = ring_.load(std::memory_order_relaxed);
+
+    if (b-top>r->capacity()-1) {
+        auto bigger = new ring(2*r->capacity());
+        for (auto i = top; i<b; ++i) {
+            bigger->put(i, r->get(i));
+        }
+        rings_.emplace_back(bigger);
+        ring_.store(bigger, std::memory_order_release);
+        r = bigger;
+    }
+
+    r->put(b, t);
+    bottom_.store(b+1, std::memory_order_release);
+}
+
+task* work_stealing_deque::take() {
+    auto b = bottom_.load(std::memory_order_relaxed)-1;
+    auto r = ring_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto top = top_.load(std::memory_order_relaxed);
+
+    task* t = nullptr;
+    if (top<=b) {
+        t = r->get(b);
+        if (top==b) {
+            // Last task: race against thieves for it.
+            if (!top_.compare_exchange_strong(top, top+1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                t = nullptr;
+            }
+            bottom_.store(b+1, std::memory_order_relaxed);
+        }
+    }
+    else {
+        bottom_.store(b+1, std::memory_order_relaxed);
+    }
+    return t;
+}
+
+task* work_stealing_deque::steal() {
+    auto top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto b = bottom_.load(std::memory_order_acquire);
+
+    if (top<b) {
+        auto r = ring_.load(std::memory_order_acquire);
+        task* t = r->get(top);
+        if (!top_.compare_exchange_strong(top, top+1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return t;
+    }
+    return nullptr;
 }
 
 void task_system::run(priority_task ptsk) {
@@ -87,13 +253,24 @@ void task_system::run(priority_task ptsk) {
 }
 
 void task_system::run_tasks_loop(int i) {
-    auto guard = util::on_scope_exit([] { current_task_queue_ = -1; });
+    auto guard = util::on_scope_exit([] { current_task_queue_ = -1; current_task_system_ = 0; });
     current_task_queue_ = i;
+    current_task_system_ = id_;
+
+    if (work_stealing_) {
+        run_tasks_loop_ws(i);
+        return;
+    }
 
     while (true) {
         priority_task ptsk;
         // Loop over the levels of priority starting from highest to lowest
         for (int pri = n_priority-1; pri>=0; --pri) {
+            // Tasks bound to this thread come first.
+            ptsk = q_[i].try_pop_bound(pri);
+            if (ptsk) break;
+            ptsk = q_[i].try_pop_affine(pri);
+            if (ptsk) break;
             // Loop over the threads trying to pop a task of the requested priority.
             for (unsigned n = 0; n<count_; ++n) {
                 ptsk = q_[(i + n) % count_].try_pop(pri);
@@ -101,6 +278,10 @@ void task_system::run_tasks_loop(int i) {
             }
             if (ptsk) break;
         }
+        // Relieve an overloaded thread before going idle.
+        for (int pri = n_priority-1; pri>=0 && !ptsk; --pri) {
+            ptsk = try_steal_affine(i, pri);
+        }
         // If a task can not be acquired, force a pop from the queue. This is a blocking action.
         if (!ptsk) ptsk = q_[i].pop();
         if (!ptsk) break;
@@ -109,29 +290,187 @@ void task_system::run_tasks_loop(int i) {
     }
 }
 
-void task_system::try_run_task(int lowest_priority) {
+void task_system::run_tasks_loop_ws(int i) {
+    while (true) {
+        if (auto ptsk = ws_try_pop(i, 0)) {
+            run(std::move(ptsk));
+            continue;
+        }
+
+        // Wait for a task to be pushed. The count of pending tasks is
+        // incremented before the sleeper count is read by the pushing
+        // thread, so that a wake-up can not be missed.
+        lock ws_lock{ws_mutex_};
+        if (ws_quit_) break;
+        ++ws_sleepers_;
+        while (!ws_pending_ && !q_[i].has_bound() && !ws_quit_) {
+            ws_tasks_available_.wait(ws_lock);
+        }
+        --ws_sleepers_;
+    }
+}
+
+priority_task task_system::ws_try_pop(unsigned i, int lowest_priority) {
+    const bool owner = current_task_system_==id_;
+    if (!owner) i %= count_;
+
+    auto acquired = [this](task* t, int pri) {
+        std::unique_ptr<task> holder(t);
+        --ws_pending_;
+        return priority_task(std::move(*holder), pri);
+    };
+
+    for (int pri = n_priority-1; pri>=lowest_priority; --pri) {
+        // Tasks bound to thread 0 are also run by threads outside the pool.
+        if (auto ptsk = q_[owner? i: 0].try_pop_bound(pri)) return ptsk;
+        if (auto ptsk = q_[owner? i: 0].try_pop_affine(pri)) return ptsk;
+        if (owner) {
+            if (auto t = deques_[i*n_priority+pri].take()) return acquired(t, pri);
+        }
+        for (unsigned n = owner? 1: 0; n<count_; ++n) {
+            if (auto t = deques_[((i+n)%count_)*n_priority+pri].steal()) return acquired(t, pri);
+        }
+        for (unsigned n = 0; n<count_; ++n) {
+            if (auto ptsk = q_[(i+n)%count_].try_pop(pri)) {
+                --ws_pending_;
+                return ptsk;
+            }
+        }
+        if (auto ptsk = try_steal_affine(owner? i: 0, pri)) return ptsk;
+    }
+    return {};
+}
+
+priority_task task_system::try_steal_affine(unsigned i, int priority) {
+    for (unsigned n = 1; n<count_; ++n) {
+        if (auto ptsk = q_[(i+n)%count_].try_steal_affine(priority, affine_steal_backlog)) {
+            ++migrations_;
+            return ptsk;
+        }
+    }
+    return {};
+}
+
+void task_system::ws_notify() {
+    if (ws_sleepers_) {
+        lock ws_lock{ws_mutex_};
+        ws_tasks_available_.notify_one();
+    }
+}
+
+bool task_system::try_run_task(int lowest_priority) {
     unsigned i = current_task_queue_+1==0? 0: current_task_queue_;
+
+    if (work_stealing_) {
+        if (auto ptsk = ws_try_pop(i, lowest_priority)) {
+            run(std::move(ptsk));
+            return true;
+        }
+        return false;
+    }
+
     arb_assert(i>=0 && i<count_);
 
+    // Tasks bound to thread 0 are also run by threads outside the pool.
+    unsigned bound = current_task_system_==id_? i: 0;
+
     // Loop over the levels of priority starting from highest to lowest_priority
     for (int pri = n_priority-1; pri>=lowest_priority; --pri) {
+        if (auto ptsk = q_[bound].try_pop_bound(pri)) {
+            run(std::move(ptsk));
+            return true;
+        }
+        if (auto ptsk = q_[bound].try_pop_affine(pri)) {
+            run(std::move(ptsk));
+            return true;
+        }
         // Loop over the threads trying to pop a task of the requested priority.
         for (unsigned n = 0; n != count_; n++) {
             if (auto ptsk = q_[(i + n) % count_].try_pop(pri)) {
                 run(std::move(ptsk));
-                return;
+                return true;
             }
         }
+        if (auto ptsk = try_steal_affine(bound, pri)) {
+            run(std::move(ptsk));
+            return true;
+        }
+    }
+    return false;
+}
+
+void task_system::wait_for(const std::atomic<std::size_t>& in_flight, int lowest_priority) {
+    using clock = std::chrono::steady_clock;
+
+    // Failed attempts to find a task since a task was last run, and the
+    // time of the first of these.
+    std::uint64_t idle = 0;
+    clock::time_point idle_since;
+
+    auto& wait_ns = wait_ns_[current_task_system_==id_? current_task_queue_: count_].ns;
+    auto account = [&] {
+        if (idle) {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now()-idle_since).count();
+            wait_ns.fetch_add(ns, std::memory_order_relaxed);
+            idle = 0;
+        }
+    };
+
+    while (in_flight) {
+        if (try_run_task(lowest_priority)) {
+            account();
+            continue;
+        }
+        if (!idle++) idle_since = clock::now();
+
+        if (wait_policy_==task_wait_policy::spin || idle<=spin_attempts) continue;
+        if (wait_policy_==task_wait_policy::yield || idle<=spin_attempts+yield_attempts) {
+            std::this_thread::yield();
+        }
+        else {
+            park(in_flight);
+        }
     }
+    account();
+}
+
+void task_system::park(const std::atomic<std::size_t>& in_flight) {
+    lock wait_lock{wait_mutex_};
+    ++parked_;
+    // The timeout covers tasks that were enqueued after the last attempt
+    // to find one, but before parked_ was incremented.
+    if (in_flight) wait_cv_.wait_for(wait_lock, park_timeout);
+    --parked_;
+}
+
+void task_system::wake_waiters() {
+    lock wait_lock{wait_mutex_};
+    wait_cv_.notify_all();
+}
+
+double task_system::wait_time() const {
+    std::uint64_t ns = 0;
+    for (unsigned i = 0; i<=count_; ++i) {
+        ns += wait_ns_[i].ns.load(std::memory_order_relaxed);
+    }
+    return ns*1e-9;
 }
 
 thread_local int task_system::current_task_priority_ = -1;
 thread_local unsigned task_system::current_task_queue_ = -1;
+thread_local std::uint64_t task_system::current_task_system_ = 0;
+
+static std::atomic<std::uint64_t> next_task_system_id{1};
 
 // Default construct with one thread.
 task_system::task_system(): task_system(1) {}
 
-task_system::task_system(int nthreads): count_(nthreads), q_(nthreads) {
+task_system::task_system(int nthreads, bool work_stealing):
+    count_(nthreads),
+    q_(nthreads),
+    work_stealing_(work_stealing),
+    id_(next_task_system_id++)
+{
     if (nthreads <= 0)
         throw std::runtime_error("Non-positive number of threads in thread pool");
 
@@ -139,10 +478,16 @@ task_system::task_system(int nthreads): count_(nthreads), q_(nthreads) {
         index_[p] = 0;
     }
 
+    if (work_stealing_) {
+        deques_.reset(new work_stealing_deque[count_*n_priority]);
+    }
+    wait_ns_.reset(new wait_counter[count_+1]);
+
     // Main thread
     auto tid = std::this_thread::get_id();
     thread_ids_[tid] = 0;
     current_task_queue_ = 0;
+    current_task_system_ = id_;
 
     for (unsigned i = 1; i < count_; i++) {
         threads_.emplace_back([this, i]{run_tasks_loop(i);});
@@ -154,7 +499,13 @@ task_system::task_system(int nthreads): count_(nthreads), q_(nthreads) {
 task_system::~task_system() {
     current_task_priority_ = -1;
     current_task_queue_ = -1;
+    if (current_task_system_==id_) current_task_system_ = 0;
     for (auto& e: q_) e.quit();
+    {
+        lock ws_lock{ws_mutex_};
+        ws_quit_ = true;
+    }
+    ws_tasks_available_.notify_all();
     for (auto& e: threads_) e.join();
 }
 
@@ -162,15 +513,66 @@ void task_system::async(priority_task ptsk) {
     if (ptsk.priority>=n_priority) {
         run(std::move(ptsk));
     }
+    else if (work_stealing_) {
+        // Count the task before it is pushed, so that a thread going idle
+        // can not miss it.
+        ++ws_pending_;
+        if (current_task_system_==id_) {
+            deques_[current_task_queue_*n_priority+ptsk.priority].push(new task(ptsk.release()));
+        }
+        else {
+            auto i = index_[ptsk.priority]++;
+            q_[i % count_].push(std::move(ptsk));
+        }
+        ws_notify();
+    }
     else {
         arb_assert(ptsk.priority < (int)index_.size());
         auto i = index_[ptsk.priority]++;
 
-        for (unsigned n = 0; n != count_; n++) {
-            if (q_[(i + n) % count_].try_push(ptsk)) return;
+        bool pushed = false;
+        for (unsigned n = 0; n != count_ && !pushed; n++) {
+            pushed = q_[(i + n) % count_].try_push(ptsk);
         }
-        q_[i % count_].push(std::move(ptsk));
+        if (!pushed) q_[i % count_].push(std::move(ptsk));
+    }
+
+    // Threads parked in wait_for() may be able to run the new task.
+    if (parked_) wake_waiters();
+}
+
+void task_system::async_on(unsigned i, priority_task ptsk, task_affinity affinity) {
+    if (ptsk.priority>=n_priority) {
+        run(std::move(ptsk));
+        return;
+    }
+
+    if (affinity==task_affinity::bound) {
+        q_[i % count_].push_bound(std::move(ptsk));
+    }
+    else {
+        q_[i % count_].push_affine(std::move(ptsk));
+    }
+    if (work_stealing_) {
+        // The owner may be asleep waiting for unbound tasks.
+        if (ws_sleepers_) {
+            lock ws_lock{ws_mutex_};
+            ws_tasks_available_.notify_all();
+        }
+    }
+    if (parked_) wake_waiters();
+}
+
+bool task_system::bind_threads(const std::vector<int>& given) {
+    auto cpus = given.empty()? hw::available_cpus(): given;
+    if (cpus.empty()) return false;
+
+    bool bound = hw::bind_this_thread(cpus[0]);
+    for (unsigned i = 1; i<count_; ++i) {
+        bound = hw::bind_thread(threads_[i-1], cpus[i%cpus.size()]) && bound;
     }
+    threads_bound_ = bound;
+    return bound;
 }
 
 std::unordered_map<std::thread::id, std::size_t> task_system::get_thread_ids() const {
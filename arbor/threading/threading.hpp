@@ -3,10 +3,13 @@
 #include <algorithm>
 #include <array>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstddef>
+#include <cstdint>
 #include <deque>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
@@ -14,6 +17,8 @@
 #include <unordered_map>
 #include <utility>
 
+#include <arbor/context.hpp>
+
 namespace arb {
 namespace threading {
 
@@ -25,6 +30,14 @@ using task = std::function<void()>;
 // Tasks with priority higher than max_async_task_priority will be run synchronously.
 constexpr int max_async_task_priority = 1;
 
+// Affinity of a task enqueued for a particular thread: bound tasks are only
+// run by that thread; preferred tasks may be run by another thread when the
+// preferred thread has a backlog of them.
+enum class task_affinity {
+    bound,
+    preferred,
+};
+
 // Wrap task and priority; provide move/release/reset operations and reset on run()
 // to help ensure no wrapped task is run twice.
 struct priority_task {
@@ -98,6 +111,24 @@ public:
     // returns false.
     bool try_push(priority_task&);
 
+    // Bound tasks may only be run by the thread that owns the queue. They
+    // are pushed and popped like other tasks, and are taken by pop() in
+    // preference to unbound tasks of the same priority, but are not
+    // returned by try_pop().
+    void push_bound(priority_task&&);
+    priority_task try_pop_bound(int priority);
+
+    // Affine tasks are run by the owning thread like bound tasks, after
+    // any bound tasks of the same priority, but another thread may take
+    // one with try_steal_affine() while at least `backlog` affine tasks
+    // are queued, that is, while the owner is overloaded.
+    void push_affine(priority_task&&);
+    priority_task try_pop_affine(int priority);
+    priority_task try_steal_affine(int priority, std::size_t backlog);
+
+    // Whether there are any bound or affine tasks in the queue.
+    bool has_bound() const { return n_bound_ || n_affine_; }
+
     // Finish popping all waiting tasks on queue then stop trying to pop
     // new tasks
     void quit();
@@ -109,6 +140,10 @@ private:
     // deques of pending tasks. Each deque contains tasks of a single priority.
     // q_tasks_[i+1] has higher priority than q_tasks_[i]
     std::array<std::deque<task>, n_priority> q_tasks_;
+    std::array<std::deque<task>, n_priority> bound_tasks_;
+    std::array<std::deque<task>, n_priority> affine_tasks_;
+    std::atomic<std::size_t> n_bound_{0};
+    std::atomic<std::size_t> n_affine_{0};
 
     // Lock and signal on task availability change. This is the crucial bit.
     mutex q_mutex_;
@@ -118,6 +153,53 @@ private:
     bool quit_ = false;
 };
 
+// A Chase–Lev work-stealing deque of tasks.
+//
+// The owning thread pushes and takes tasks at the bottom of the deque without
+// locking, while other threads steal tasks from the top. Tasks are held by
+// pointer, so that they can be read atomically by a thief that may lose the
+// race for them; the deque takes ownership of pushed tasks.
+class work_stealing_deque {
+public:
+    work_stealing_deque();
+    ~work_stealing_deque();
+
+    work_stealing_deque(const work_stealing_deque&) = delete;
+    work_stealing_deque& operator=(const work_stealing_deque&) = delete;
+
+    // Push a task at the bottom. Must only be called by the owning thread.
+    void push(task* t);
+
+    // Take the most recently pushed task, or nullptr if the deque is empty.
+    // Must only be called by the owning thread.
+    task* take();
+
+    // Steal the least recently pushed task. Returns nullptr if the deque
+    // is empty, or if the task was taken by another thread.
+    task* steal();
+
+private:
+    struct ring {
+        std::int64_t mask;
+        std::unique_ptr<std::atomic<task*>[]> slots;
+
+        explicit ring(std::int64_t capacity):
+            mask(capacity-1), slots(new std::atomic<task*>[capacity]) {}
+
+        std::int64_t capacity() const { return mask+1; }
+        task* get(std::int64_t i) const { return slots[i&mask].load(std::memory_order_relaxed); }
+        void put(std::int64_t i, task* t) { slots[i&mask].store(t, std::memory_order_relaxed); }
+    };
+
+    alignas(64) std::atomic<std::int64_t> top_{0};
+    alignas(64) std::atomic<std::int64_t> bottom_{0};
+    std::atomic<ring*> ring_;
+
+    // All rings allocated by the deque: a ring that has been outgrown may
+    // still be read by a concurrent thief, so they are freed on destruction.
+    std::vector<std::unique_ptr<ring>> rings_;
+};
+
 }// namespace impl
 
 class task_system {
@@ -154,12 +236,75 @@ private:
     // to balance the workload among the queues.
     std::array<std::atomic<unsigned>, n_priority> index_;
 
+    // Work-stealing mode: tasks pushed by a thread of the pool go on to that
+    // thread's deque of the task's priority, with index i*n_priority+priority;
+    // tasks pushed by other threads go on to the notification queues.
+    bool work_stealing_ = false;
+    std::unique_ptr<impl::work_stealing_deque[]> deques_;
+
+    // Work-stealing mode: number of tasks waiting in any queue, and the
+    // state used by idle threads to wait for new tasks.
+    std::atomic<std::size_t> ws_pending_{0};
+    std::atomic<unsigned> ws_sleepers_{0};
+    std::atomic<bool> ws_quit_{false};
+    mutex ws_mutex_;
+    condition_variable ws_tasks_available_;
+
+    // Unique identifier of this task system, and that of the task system of
+    // which the running thread is a member, if any (zero otherwise).
+    std::uint64_t id_;
+    static thread_local std::uint64_t current_task_system_;
+
+    // Work-stealing mode: try to get a task with at least the requested
+    // priority, from the deque of thread i if owned by the caller, and
+    // then from the other deques and notification queues.
+    priority_task ws_try_pop(unsigned i, int lowest_priority);
+
+    // Work-stealing mode: wake idle threads after a task has been pushed.
+    void ws_notify();
+
+    void run_tasks_loop_ws(int i);
+
+    // Policy of threads waiting in wait_for(); see task_wait_policy.
+    // A waiting thread that can not find a task spins for spin_attempts
+    // attempts, then yields for up to yield_attempts further attempts,
+    // and then, under the park policy, sleeps on wait_cv_ for at most
+    // park_timeout before trying again. Sleeping threads are woken when
+    // a task is enqueued or a task of a task group completes.
+    task_wait_policy wait_policy_ = task_wait_policy::spin;
+    static constexpr unsigned spin_attempts = 64;
+    static constexpr unsigned yield_attempts = 1024;
+    static constexpr std::chrono::microseconds park_timeout{500};
+
+    std::atomic<unsigned> parked_{0};
+    mutex wait_mutex_;
+    condition_variable wait_cv_;
+
+    // Time in nanoseconds spent in wait_for() without running a task, for
+    // each thread of the pool, followed by that of all other threads.
+    struct alignas(64) wait_counter {
+        std::atomic<std::uint64_t> ns{0};
+    };
+    std::unique_ptr<wait_counter[]> wait_ns_;
+
+    void park(const std::atomic<std::size_t>& in_flight);
+
+    bool threads_bound_ = false;
+
+    std::atomic<std::size_t> migrations_{0};
+
+    // Try to take a preferred task of the given priority from the queue
+    // of a thread other than i with a backlog.
+    priority_task try_steal_affine(unsigned i, int priority);
+
 public:
     // Create zero new threads. Only worker thread is the main thread.
     task_system();
 
-    // Create nthreads-1 new std::threads running run_tasks_loop(tid)
-    task_system(int nthreads);
+    // Create nthreads-1 new std::threads running run_tasks_loop(tid).
+    // If work_stealing is set, tasks are distributed with per-thread
+    // work-stealing deques in place of the notification queues.
+    task_system(int nthreads, bool work_stealing = false);
 
     task_system(const task_system&) = delete;
     task_system& operator=(const task_system&) = delete;
@@ -184,6 +329,32 @@ public:
     void async(task t, int priority) { async({std::move(t), priority}); }
     void run(task t, int priority) { run({std::move(t), priority}); }
 
+    // Public interface: run task asynchronously on thread i of the pool,
+    // if priority <= max_async_task_priority, else synchronously. Bound
+    // tasks are never stolen; those bound to thread 0 may also be run by
+    // threads outside the pool when they wait on a task group. Preferred
+    // tasks are stolen by idle threads from a thread with a backlog of
+    // at least affine_steal_backlog preferred tasks.
+    void async_on(unsigned i, priority_task ptsk, task_affinity affinity = task_affinity::bound);
+
+    static constexpr std::size_t affine_steal_backlog = 2;
+
+    // Number of preferred tasks that have been run by a thread other than
+    // the one they were enqueued for.
+    std::size_t migrations() const { return migrations_; }
+
+    // Pin thread i of the pool, where thread 0 is the calling thread, to
+    // the i-th of `cpus`, or if empty of the CPUs available to the process
+    // in order of socket. Returns false if the affinity of any thread could
+    // not be set.
+    bool bind_threads(const std::vector<int>& cpus = {});
+
+    // Whether the threads have been pinned by bind_threads().
+    bool threads_bound() const { return threads_bound_; }
+
+    // Index of the calling thread in the pool, or -1 if it is not a member.
+    int current_thread() const { return current_task_system_==id_? (int)current_task_queue_: -1; }
+
     // The main function that all worker std::threads execute.
     // It will try to acquire a task of the highest possible of priority from all
     // of the notification queues. If unsuccessful it will force pop any task from
@@ -204,7 +375,33 @@ public:
     // are available or if the lock can't be acquired.
     //
     // Will start with queue corresponding to calling thread, if one exists.
-    void try_run_task(int lowest_priority);
+    //
+    // Returns true if a task was run.
+    bool try_run_task(int lowest_priority);
+
+    // Public interface: run tasks with at least the requested priority
+    // until in_flight is zero, waiting according to the wait policy when
+    // there is no task to run. The count must be decremented by
+    // task_done().
+    void wait_for(const std::atomic<std::size_t>& in_flight, int lowest_priority);
+
+    // Decrement the count of a task group on completion of one of its tasks,
+    // waking any threads waiting in wait_for().
+    void task_done(std::atomic<std::size_t>& in_flight) {
+        // Both the decrement and the load of parked_ are sequentially
+        // consistent, pairing with the increment of parked_ and load of
+        // the count in park(): either the waiter sees the new count, or
+        // the waiter is seen here and notified.
+        --in_flight;
+        if (parked_) wake_waiters();
+    }
+
+    void set_wait_policy(task_wait_policy p) { wait_policy_ = p; }
+    task_wait_policy wait_policy() const { return wait_policy_; }
+
+    // Total time in seconds that threads have spent in wait_for() without
+    // running a task, since the task system was created.
+    double wait_time() const;
 
     // Number of threads in pool, including master thread.
     // Equivalently, number of notification queues.
@@ -214,6 +411,9 @@ public:
 
     // Returns the thread_id map
     std::unordered_map<std::thread::id, std::size_t> get_thread_ids() const;
+
+private:
+    void wake_waiters();
 };
 
 class task_group {
@@ -280,20 +480,24 @@ public:
         F f_;
         std::atomic<std::size_t>& counter_;
         exception_state& exception_status_;
+        task_system* task_system_;
 
     public:
-        // Construct from a compatible function, atomic counter, and exception_state.
+        // Construct from a compatible function, atomic counter, exception_state,
+        // and the task system that runs the task.
         template <typename F2>
-        explicit wrap(F2&& other, std::atomic<std::size_t>& c, exception_state& ex):
+        explicit wrap(F2&& other, std::atomic<std::size_t>& c, exception_state& ex, task_system* ts):
                 f_(std::forward<F2>(other)),
                 counter_(c),
-                exception_status_(ex)
+                exception_status_(ex),
+                task_system_(ts)
         {}
 
         wrap(wrap&& other):
                 f_(std::move(other.f_)),
                 counter_(other.counter_),
-                exception_status_(other.exception_status_)
+                exception_status_(other.exception_status_),
+                task_system_(other.task_system_)
         {}
 
         // std::function is not guaranteed to not copy the contents on move construction,
@@ -301,7 +505,8 @@ public:
         wrap(const wrap& other):
                 f_(other.f_),
                 counter_(other.counter_),
-                exception_status_(other.exception_status_)
+                exception_status_(other.exception_status_),
+                task_system_(other.task_system_)
         {}
 
         // This is where tasks of the task_group are actually executed.
@@ -316,7 +521,7 @@ public:
                 }
             }
             // Decrement the atomic counter of the tasks in the task_group;
-            --counter_;
+            task_system_->task_done(counter_);
         }
     };
 
@@ -325,7 +530,7 @@ public:
 
     template <typename F>
     wrap<callable<F>> make_wrapped_function(F&& f, std::atomic<std::size_t>& c, exception_state& ex) {
-        return wrap<callable<F>>(std::forward<F>(f), c, ex);
+        return wrap<callable<F>>(std::forward<F>(f), c, ex, task_system_);
     }
 
     // Adds new tasks to be executed in the task_group.
@@ -348,6 +553,22 @@ public:
         task_system_->async(priority_task{make_wrapped_function(std::forward<F>(f), in_flight_, exception_status_), priority});
     }
 
+    // Adds a new task to be executed on thread i of the task system,
+    // with the priority chosen as by run().
+    template<typename F>
+    int run_on(unsigned i, F&& f) {
+        int priority = task_system::get_task_priority()+1;
+        run_on(i, std::forward<F>(f), priority);
+        return priority;
+    }
+
+    template<typename F>
+    void run_on(unsigned i, F&& f, int priority, task_affinity affinity = task_affinity::bound) {
+        running_ = true;
+        ++in_flight_;
+        task_system_->async_on(i, priority_task{make_wrapped_function(std::forward<F>(f), in_flight_, exception_status_), priority}, affinity);
+    }
+
     // Wait till all tasks in this group are done.
     // While waiting the thread will participate in executing the tasks.
     // It's necessary that the waiting thread participate in execution:
@@ -356,11 +577,11 @@ public:
     // To shorten waiting time, and reduce the chances of stack overflow,
     // the waiting thread can only execute tasks with a higher priority
     // than the task it is currently running.
+    // When there are no such tasks, the thread waits according to the
+    // wait policy of the task system.
     void wait() {
         int lowest_priority = task_system::get_task_priority()+1;
-        while (in_flight_) {
-            task_system_->try_run_task(lowest_priority);
-        }
+        task_system_->wait_for(in_flight_, lowest_priority);
         running_ = false;
 
         if (auto ex = exception_status_.reset()) {
@@ -393,9 +614,42 @@ struct parallel_for {
         g.wait();
     }
 
+    // Without a batch size, the range is partitioned automatically: it is
+    // split recursively in halves, with one half of each split enqueued as
+    // a task, until the pieces are no larger than a grain size chosen from
+    // the range length and the number of threads. Idle threads can then
+    // pick up the larger pieces near the top of the tree, and there are many
+    // fewer tasks than indices for large ranges.
     template <typename F>
     static void apply(int left, int right, task_system* ts, F f) {
-        apply(left, right, 1, ts, std::move(f));
+        if (left>=right) return;
+
+        // Aim for several pieces per thread, so that imbalance between
+        // pieces can be recovered.
+        constexpr int pieces_per_thread = 8;
+        int grain = std::max(1, (right-left)/(pieces_per_thread*ts->get_num_threads()));
+
+        task_group g(ts);
+        int priority = task_system::get_task_priority()+1;
+        g.run([=, &g, &f] { split(left, right, grain, priority, g, f); }, priority);
+        g.wait();
+    }
+
+private:
+    // Enqueue the upper halves of [left, right) as tasks until the remainder
+    // is no longer than grain, then apply f to the remainder. All pieces are
+    // run as tasks with the priority of the initial call, so that splitting
+    // within a task does not raise the priority of its descendants.
+    template <typename F>
+    static void split(int left, int right, int grain, int priority, task_group& g, const F& f) {
+        while (right-left>grain) {
+            int mid = left + (right-left)/2;
+            g.run([=, &g, &f] { split(mid, right, grain, priority, g, f); }, priority);
+            right = mid;
+        }
+        for (int i = left; i<right; ++i) {
+            f(i);
+        }
     }
 };
 } // namespace threading
@@ -450,6 +450,12 @@ void copy_extend(const Source& source, Dest&& dest, const Fill& fill) {
     std::fill(tail, end(dest), fill);
 }
 
+// Total size in bytes of the elements of the given sequences.
+template <typename... Seqs>
+std::size_t size_in_bytes(const Seqs&... seqs) {
+    return (std::size_t(0) + ... + (std::size(seqs)*sizeof(typename Seqs::value_type)));
+}
+
 } // namespace util
 } // namespace arb
 
@@ -0,0 +1,67 @@
+#pragma once
+
+// Per-thread pools of reusable scratch objects.
+//
+// `scratch_pool<T>::borrow()` hands out an object of type `T` from the pool
+// of the calling thread, and the object returns to that pool when the
+// returned handle is destroyed. Objects are not cleared in between, so that
+// containers keep their capacity: the borrower must reset what it uses.
+//
+// Work that runs on one thread at a time, such as the update of a cell
+// group, can so share one set of buffers per thread rather than hold its
+// own. A thread that runs a nested task while waiting, and so borrows again
+// before returning, is given a further object.
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace arb {
+namespace util {
+
+template <typename T>
+class scratch_pool {
+    using pool_type = std::vector<std::unique_ptr<T>>;
+
+    static pool_type& pool() {
+        static thread_local pool_type p;
+        return p;
+    }
+
+public:
+    class handle {
+    public:
+        handle(handle&& other) noexcept: ptr_(std::move(other.ptr_)) {}
+        handle& operator=(handle&&) = delete;
+
+        ~handle() {
+            if (ptr_) pool().push_back(std::move(ptr_));
+        }
+
+        T& operator*() const { return *ptr_; }
+        T* operator->() const { return ptr_.get(); }
+
+    private:
+        friend class scratch_pool;
+        explicit handle(std::unique_ptr<T> p): ptr_(std::move(p)) {}
+
+        std::unique_ptr<T> ptr_;
+    };
+
+    static handle borrow() {
+        auto& p = pool();
+        if (p.empty()) return handle(std::make_unique<T>());
+
+        auto ptr = std::move(p.back());
+        p.pop_back();
+        return handle(std::move(ptr));
+    }
+
+    // Number of idle objects in the pool of the calling thread.
+    static std::size_t idle() {
+        return pool().size();
+    }
+};
+
+} // namespace util
+} // namespace arb
@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <array>
+#include <cstdio>
 #include <cstring>
 #include <functional>
 #include <iomanip>
@@ -53,7 +54,7 @@ bool operator==(const uuid& lhs, const uuid& rhs) {
 bool operator<(const uuid& lhs, const uuid& rhs) {
     for (auto i=0u; i<lhs.bytes.size(); ++i) {
         if (lhs.bytes[i]<rhs.bytes[i]) return true;
-        if (lhs.bytes[i]>lhs.bytes[i]) return false;
+        if (lhs.bytes[i]>rhs.bytes[i]) return false;
     }
     return false;
 }
@@ -125,6 +126,31 @@ std::vector<uuid> get_gpu_uuids() {
     return uuids;
 }
 
+std::vector<std::string> get_gpu_pci_bus_ids() {
+    int ngpus = 0;
+    auto status = get_device_count(&ngpus);
+    if (status.no_device_found()) {
+        return {};
+    }
+    else if (!status) {
+        throw make_runtime_error(status);
+    }
+
+    std::vector<std::string> ids;
+    for (int i=0; i<ngpus; ++i) {
+        DeviceProp props;
+        status = get_device_properties(&props, i);
+        if (!status) {
+            throw make_runtime_error(status);
+        }
+
+        char id[32];
+        std::snprintf(id, sizeof(id), "%04x:%02x:%02x.0", props.pciDomainID, props.pciBusID, props.pciDeviceID);
+        ids.push_back(id);
+    }
+    return ids;
+}
+
 // Compare two sets of uuids
 //   1: both sets are identical
 //  -1: some common elements
@@ -149,9 +175,9 @@ int compare_gpu_groups(std::pair<I,I> l, std::pair<I,I> r) {
     return 0;
 }
 
-gpu_rank assign_gpu(const std::vector<uuid>& uids,
-                    const std::vector<int>&  uid_part,
-                    int rank)
+std::vector<int> gpu_neighbors(const std::vector<uuid>& uids,
+                               const std::vector<int>&  uid_part,
+                               int rank)
 {
     // Determine the number of ranks in MPI communicator
     auto nranks = uid_part.size()-1;
@@ -180,6 +206,20 @@ gpu_rank assign_gpu(const std::vector<uuid>& uids,
         // case where match==0 can be ignored.
     }
 
+    return neighbors;
+}
+
+gpu_rank assign_gpu(const std::vector<uuid>& uids,
+                    const std::vector<int>&  uid_part,
+                    int rank)
+{
+    // The list of ranks that share the same GPUs as this rank (including this rank).
+    auto neighbors = gpu_neighbors(uids, uid_part, rank);
+    if (neighbors.empty()) return {};
+
+    // The gpu uid range for this rank
+    auto local_gpus = std::make_pair(uids.begin()+uid_part[rank], uids.begin()+uid_part[rank+1]);
+
     // Determine the position of this rank in the sorted list of ranks.
     int pos_in_group =
         std::distance(
@@ -2,6 +2,7 @@
 
 #include <array>
 #include <ostream>
+#include <string>
 #include <vector>
 
 namespace arbenv {
@@ -28,6 +29,11 @@ std::ostream& operator<<(std::ostream& o, const uuid& id);
 // Throws std::runtime_error if there was an error on any CUDA runtime calls.
 std::vector<uuid> get_gpu_uuids();
 
+// Return the PCI bus ids of gpu devices visible to this process, of the form
+// "0000:3b:00.0", in device order.
+// Throws std::runtime_error if there was an error on any CUDA runtime calls.
+std::vector<std::string> get_gpu_pci_bus_ids();
+
 struct gpu_rank {
     bool error = true;
     int id = -1;
@@ -36,6 +42,10 @@ struct gpu_rank {
     gpu_rank() = default;
 };
 
+// The ranks, in order, that see the same set of GPUs as rank `rank`,
+// including itself; empty if any rank sees only some of them.
+std::vector<int> gpu_neighbors(const std::vector<uuid>& uids, const std::vector<int>& uid_part, int rank);
+
 gpu_rank assign_gpu(const std::vector<uuid>& uids, const std::vector<int>&  uid_part, int rank);
 
 } // namespace arbenv
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <arbor/context.hpp>
+
+namespace arbenv {
+
+// The NUMA topology of the node, read from sysfs. On systems other than
+// Linux, or if sysfs does not describe the NUMA nodes, the functions
+// return empty lists and -1.
+
+// The logical CPUs of each NUMA node, indexed by node id.
+std::vector<std::vector<int>> get_numa_cpus();
+
+// Parse a list of CPUs in the format of the kernel, e.g. "0-3,8,10-11" or
+// with a stride "0-15:2/4" for CPUs 0, 1, 4, 5, 8, 9, 12 and 13.
+std::vector<int> parse_cpu_list(const std::string& list);
+
+// The index of the NUMA node in `nodes` that holds the most of `cpus`, or
+// -1 if none holds any.
+int nearest_node(const std::vector<int>& cpus, const std::vector<std::vector<int>>& nodes);
+
+// The NUMA node of the PCI device with the given bus id, of the form
+// "0000:3b:00.0", or -1 if not known.
+int get_pci_numa_node(const std::string& bus_id);
+
+// The NUMA node of each visible GPU, in device order, or -1 for GPUs whose
+// node is not known. Empty if Arbor was built without GPU support.
+std::vector<int> get_gpu_numa_nodes();
+
+// A GPU, CPUs and NUMA node for a process, such that the CPUs nearest to
+// the GPU come first.
+struct gpu_binding {
+    // The GPU assigned to the process, or -1 if none.
+    int gpu_id = -1;
+
+    // The CPUs available to the process, those of numa_node first.
+    std::vector<int> cpus;
+
+    // The NUMA node of the GPU, or with no GPU that holds most of the CPUs
+    // of the process; -1 if not known.
+    int numa_node = -1;
+
+    // Local resources with one thread on each of the CPUs, bound to them.
+    arb::proc_allocation allocation() const;
+};
+
+// Assign GPUs to processes that share them, preferring for each process a
+// GPU on its NUMA node: `rank_nodes` holds the NUMA node of each process,
+// and `gpu_nodes` of each GPU. Processes are served in order, first with
+// GPUs on their own nodes, then with any left. Returns the GPU index for
+// each process, or -1 once the GPUs are exhausted.
+std::vector<int> assign_nearest_gpus(const std::vector<int>& rank_nodes, const std::vector<int>& gpu_nodes);
+
+// The GPU nearest to the CPUs of the calling process.
+gpu_binding find_nearest_gpu();
+
+// As find_private_gpu(), assign a unique GPU to every rank of `comm` among
+// those that share GPUs, preferring a GPU on the NUMA node of the CPUs of
+// each rank. All ranks of `comm` must call.
+template <typename Comm>
+gpu_binding find_nearest_gpu(Comm comm);
+
+} // namespace arbenv
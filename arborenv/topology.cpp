@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef ARB_HAVE_MPI
+#include <mpi.h>
+#endif
+
+#include <arbor/context.hpp>
+#include <arborenv/concurrency.hpp>
+#include <arborenv/topology.hpp>
+
+#ifdef ARB_HAVE_GPU
+#include "gpu_uuid.hpp"
+#endif
+
+namespace arbenv {
+
+std::vector<int> parse_cpu_list(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream in(list);
+    std::string range;
+    while (std::getline(in, range, ',')) {
+        if (range.empty()) continue;
+
+        // A range may take a stride "first-last:used/group": the first
+        // `used` CPUs of every `group` from `first` on.
+        int used = 1, group = 1;
+        auto colon = range.find(':');
+        if (colon!=std::string::npos) {
+            auto slash = range.find('/', colon);
+            used = std::stoi(range.substr(colon+1, slash-colon-1));
+            group = slash==std::string::npos? used: std::stoi(range.substr(slash+1));
+            if (used<1 || group<used) {
+                throw std::invalid_argument("invalid CPU list stride: "+range);
+            }
+            range.erase(colon);
+        }
+
+        auto dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash==std::string::npos? first: std::stoi(range.substr(dash+1));
+        for (int c = first; c<=last; ++c) {
+            if ((c-first)%group<used) cpus.push_back(c);
+        }
+    }
+    return cpus;
+}
+
+int nearest_node(const std::vector<int>& cpus, const std::vector<std::vector<int>>& nodes) {
+    int node = -1;
+    std::size_t most = 0;
+    for (std::size_t i = 0; i<nodes.size(); ++i) {
+        std::size_t n = std::count_if(cpus.begin(), cpus.end(),
+            [&](int c) { return std::find(nodes[i].begin(), nodes[i].end(), c)!=nodes[i].end(); });
+        if (n>most) {
+            most = n;
+            node = i;
+        }
+    }
+    return node;
+}
+
+namespace {
+// Bind to `gpu` on `gpu_node`, with the CPUs of the node of the GPU, or with
+// no GPU of the node of most of the CPUs, first.
+gpu_binding make_binding(int gpu, int gpu_node, std::vector<int> cpus, const std::vector<std::vector<int>>& nodes) {
+    gpu_binding b;
+    b.gpu_id = gpu;
+    b.numa_node = gpu_node>=0? gpu_node: nearest_node(cpus, nodes);
+    if (b.numa_node>=0 && b.numa_node<(int)nodes.size()) {
+        const auto& near = nodes[b.numa_node];
+        std::stable_partition(cpus.begin(), cpus.end(),
+            [&](int c) { return std::find(near.begin(), near.end(), c)!=near.end(); });
+    }
+    b.cpus = std::move(cpus);
+    return b;
+}
+} // namespace
+
+std::vector<std::vector<int>> get_numa_cpus() {
+    // Node ids are contiguous but on exotic systems; stop at the first one missing.
+    std::vector<std::vector<int>> nodes;
+    for (int i = 0;; ++i) {
+        std::ifstream f("/sys/devices/system/node/node"+std::to_string(i)+"/cpulist");
+        std::string list;
+        if (!std::getline(f, list)) break;
+        nodes.push_back(parse_cpu_list(list));
+    }
+    return nodes;
+}
+
+int get_pci_numa_node(const std::string& bus_id) {
+    std::string id = bus_id;
+    std::transform(id.begin(), id.end(), id.begin(), [](unsigned char c) { return std::tolower(c); });
+
+    std::ifstream f("/sys/bus/pci/devices/"+id+"/numa_node");
+    int node = -1;
+    return f >> node? node: -1;
+}
+
+std::vector<int> get_gpu_numa_nodes() {
+    std::vector<int> nodes;
+#ifdef ARB_HAVE_GPU
+    for (const auto& id: get_gpu_pci_bus_ids()) {
+        nodes.push_back(get_pci_numa_node(id));
+    }
+#endif
+    return nodes;
+}
+
+arb::proc_allocation gpu_binding::allocation() const {
+    arb::proc_allocation resources(std::max<std::size_t>(1, cpus.size()), gpu_id);
+    resources.cpus = cpus;
+    resources.bind_threads = !cpus.empty();
+    return resources;
+}
+
+std::vector<int> assign_nearest_gpus(const std::vector<int>& rank_nodes, const std::vector<int>& gpu_nodes) {
+    std::vector<int> gpus(rank_nodes.size(), -1);
+    std::vector<char> taken(gpu_nodes.size(), 0);
+
+    auto take = [&](std::size_t r, auto&& pred) {
+        for (std::size_t g = 0; g<gpu_nodes.size(); ++g) {
+            if (!taken[g] && pred(g)) {
+                taken[g] = 1;
+                gpus[r] = g;
+                return;
+            }
+        }
+    };
+
+    for (std::size_t r = 0; r<rank_nodes.size(); ++r) {
+        if (rank_nodes[r]>=0) take(r, [&](std::size_t g) { return gpu_nodes[g]==rank_nodes[r]; });
+    }
+    for (std::size_t r = 0; r<rank_nodes.size(); ++r) {
+        if (gpus[r]<0) take(r, [](std::size_t) { return true; });
+    }
+    return gpus;
+}
+
+gpu_binding find_nearest_gpu() {
+    auto cpus = get_affinity();
+    auto nodes = get_numa_cpus();
+    auto gpu_nodes = get_gpu_numa_nodes();
+
+    int gpu = assign_nearest_gpus({nearest_node(cpus, nodes)}, gpu_nodes).front();
+    return make_binding(gpu, gpu<0? -1: gpu_nodes[gpu], std::move(cpus), nodes);
+}
+
+#ifdef ARB_HAVE_MPI
+
+template <>
+gpu_binding find_nearest_gpu(MPI_Comm comm) {
+    auto cpus = get_affinity();
+    auto nodes = get_numa_cpus();
+
+#ifdef ARB_HAVE_GPU
+    int nranks;
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &nranks);
+
+    auto test_global_error = [comm](bool local_status) -> bool {
+        int l = local_status? 1: 0;
+        int global_status;
+        MPI_Allreduce(&l, &global_status, 1, MPI_INT, MPI_MAX, comm);
+        return global_status==1;
+    };
+
+    // Find the uuids and NUMA nodes of the local GPUs.
+    bool local_error = false;
+    std::string msg;
+    std::vector<uuid> uuids;
+    std::vector<int> gpu_nodes;
+    try {
+        uuids = get_gpu_uuids();
+        gpu_nodes = get_gpu_numa_nodes();
+    }
+    catch (const std::exception& e) {
+        msg = e.what();
+        local_error = true;
+    }
+    if (test_global_error(local_error)) {
+        throw std::runtime_error("unable to detect the unique id of visible GPUs: "
+            + (local_error? msg: std::string("error on another MPI rank")));
+    }
+
+    // Gather the uuids of the GPUs and the NUMA node of every rank.
+    int ngpus = uuids.size();
+    std::vector<int> gpus_per_rank(nranks);
+    MPI_Allgather(&ngpus, 1, MPI_INT, gpus_per_rank.data(), 1, MPI_INT, comm);
+
+    std::vector<int> gpu_partition(nranks+1);
+    std::partial_sum(gpus_per_rank.begin(), gpus_per_rank.end(), gpu_partition.begin()+1);
+
+    MPI_Datatype uuid_mpi_type;
+    MPI_Type_contiguous(sizeof(uuid), MPI_BYTE, &uuid_mpi_type);
+    MPI_Type_commit(&uuid_mpi_type);
+    std::vector<uuid> global_uuids(gpu_partition.back());
+    MPI_Allgatherv(uuids.data(), ngpus, uuid_mpi_type,
+                   global_uuids.data(), gpus_per_rank.data(), gpu_partition.data(),
+                   uuid_mpi_type, comm);
+    MPI_Type_free(&uuid_mpi_type);
+
+    int node = nearest_node(cpus, nodes);
+    std::vector<int> rank_nodes(nranks);
+    MPI_Allgather(&node, 1, MPI_INT, rank_nodes.data(), 1, MPI_INT, comm);
+
+    // The ranks that share the GPUs of this rank assign them in the same
+    // order, that of their uuids.
+    auto neighbors = gpu_neighbors(global_uuids, gpu_partition, rank);
+    if (test_global_error(neighbors.empty())) {
+        throw std::runtime_error(
+            "Unable to assign a unique GPU to MPI rank: the CUDA_VISIBLE_DEVICES"
+            " environment variable is likely incorrectly configured." );
+    }
+
+    std::vector<int> order(ngpus);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return uuids[a]<uuids[b]; });
+
+    std::vector<int> ordered_nodes, neighbor_nodes;
+    for (int g: order) ordered_nodes.push_back(gpu_nodes[g]);
+    for (int r: neighbors) neighbor_nodes.push_back(rank_nodes[r]);
+
+    auto pos = std::find(neighbors.begin(), neighbors.end(), rank)-neighbors.begin();
+    int choice = assign_nearest_gpus(neighbor_nodes, ordered_nodes)[pos];
+    if (choice<0) return make_binding(-1, -1, std::move(cpus), nodes);
+    return make_binding(order[choice], ordered_nodes[choice], std::move(cpus), nodes);
+#else
+    return make_binding(-1, -1, std::move(cpus), nodes);
+#endif // def ARB_HAVE_GPU
+}
+
+#endif // def ARB_HAVE_MPI
+
+} // namespace arbenv
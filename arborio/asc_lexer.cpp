@@ -1,5 +1,8 @@
 #include <cctype>
+#include <cstring>
+#include <deque>
 #include <string>
+#include <string_view>
 
 #include <arborio/neurolucida.hpp>
 
@@ -44,7 +47,7 @@ std::ostream& operator<<(std::ostream& o, const src_location& l) {
 }
 
 std::ostream& operator<<(std::ostream& o, const token& t) {
-    const char* spelling = t.spelling.c_str();
+    std::string_view spelling = t.spelling;
     if      (t.kind==tok::eof)   spelling = "\\0";
     else if (t.kind==tok::error) spelling = "";
     return o << "(token " << t.kind << " \"" << spelling << "\" " << t.loc << ")";
@@ -79,16 +82,22 @@ inline bool is_valid_symbol_char(char c) {
     }
 }
 
+// Tokens are views of the input, so that lexing allocates no memory but for
+// the messages of errors.
 class lexer_impl {
     const char* line_start_;
     const char* stream_;
+    const char* end_;
     unsigned line_;
     token token_;
+    // Messages of error tokens: a deque, so that the views of earlier
+    // messages, held by the current token or by peeked tokens, stay valid.
+    std::deque<std::string> errors_;
 
 public:
 
-    lexer_impl(const char* begin):
-        line_start_(begin), stream_(begin), line_(0)
+    lexer_impl(const char* begin, const char* end):
+        line_start_(begin), stream_(begin), end_(end), line_(0)
     {
         // Prime the first token.
         parse();
@@ -130,13 +139,22 @@ private:
     }
 
     bool empty() const {
-        return *stream_ == '\0';
+        return stream_==end_ || *stream_=='\0';
+    }
+
+    // An error token with a message that is not a literal.
+    token error(src_location l, std::string msg) {
+        errors_.push_back(std::move(msg));
+        return {l, tok::error, errors_.back()};
+    }
+
+    // The token of kind k of the characters from start to the current position.
+    token spelled(src_location l, tok k, const char* start) const {
+        return {l, k, std::string_view(start, stream_-start)};
     }
 
     // Consume and return the next token in the stream.
     void parse() {
-        using namespace std::string_literals;
-
         while (!empty()) {
             switch (*stream_) {
                 // white space
@@ -157,7 +175,7 @@ private:
                 // carriage return (windows new line)
                 case '\r'   :
                     ++stream_;
-                    if(*stream_ != '\n') {
+                    if (stream_==end_ || *stream_!='\n') {
                         token_ = {loc(), tok::error, "expected new line after cariage return (bad line ending)"};
                         return;
                     }
@@ -165,17 +183,19 @@ private:
 
                 // end of file
                 case 0      :
-                    token_ = {loc(), tok::eof, "eof"s};
+                    token_ = {loc(), tok::eof, "eof"};
                     return;
 
                 case ';':
                     eat_comment();
                     continue;
                 case '(':
-                    token_ = {loc(), tok::lparen, {character()}};
+                    token_ = {loc(), tok::lparen, "("};
+                    ++stream_;
                     return;
                 case ')':
-                    token_ = {loc(), tok::rparen, {character()}};
+                    token_ = {loc(), tok::rparen, ")"};
+                    ++stream_;
                     return;
                 case 'a' ... 'z':
                 case 'A' ... 'Z':
@@ -217,20 +237,20 @@ private:
                             return;
                         }
                     }
-                    token_ = {loc(), tok::error, std::string("Unexpected character '")+character()+"'"};
+                    token_ = error(loc(), std::string("Unexpected character '")+character()+"'");
                     return;
 
                 default:
-                    token_ = {loc(), tok::error, std::string("Unexpected character '")+character()+"'"};
+                    token_ = error(loc(), std::string("Unexpected character '")+character()+"'");
                     return;
             }
         }
 
         if (!empty()) {
-            token_ = {loc(), tok::error, "Internal lexer error: expected end of input, please open a bug report"s};
+            token_ = {loc(), tok::error, "Internal lexer error: expected end of input, please open a bug report"};
             return;
         }
-        token_ = {loc(), tok::eof, "eof"s};
+        token_ = {loc(), tok::eof, "eof"};
         return;
     }
 
@@ -238,8 +258,8 @@ private:
     // If peek to or past the end of the stream return '\0'.
     char peek_char(int n) {
         const char* c = stream_;
-        while (*c && n--) ++c;
-        return *c;
+        while (c<end_ && *c && n--) ++c;
+        return c<end_? *c: '\0';
     }
 
     // Consumes characters in the stream until end of stream or a new line.
@@ -271,81 +291,63 @@ private:
     //
     // Returns the appropriate token kind if symbol is a keyword.
     token symbol() {
-        using namespace std::string_literals;
         auto start = loc();
-        std::string symbol;
-        char c = *stream_;
+        const char* first = stream_;
 
         // Assert that current position is at the start of an identifier
-        if( !(std::isalpha(c)) ) {
-            return {start, tok::error, "Internal error: lexer attempting to read identifier when none is available '.'"s};
+        if( !(std::isalpha(*stream_)) ) {
+            return {start, tok::error, "Internal error: lexer attempting to read identifier when none is available '.'"};
         }
 
-        symbol += c;
         ++stream_;
-        while(1) {
-            c = *stream_;
-
-            if(is_valid_symbol_char(c)) {
-                symbol += c;
-                ++stream_;
-            }
-            else {
-                break;
-            }
+        while (!empty() && is_valid_symbol_char(*stream_)) {
+            ++stream_;
         }
 
-        return {start, tok::symbol, std::move(symbol)};
+        return spelled(start, tok::symbol, first);
     }
 
     token string() {
-        using namespace std::string_literals;
         if (*stream_ != '"') {
-            return {loc(), tok::error, "Internal error: lexer attempting to read identifier when none is available '.'"s};
+            return {loc(), tok::error, "Internal error: lexer attempting to read identifier when none is available '.'"};
         }
 
         auto start = loc();
-        ++stream_;
-        std::string str;
+        const char* first = ++stream_;
         while (!empty() && *stream_!='"') {
-            str.push_back(*stream_);
             ++stream_;
         }
         if (empty()) return {start, tok::error, "string missing closing \""};
+        auto str = spelled(start, tok::string, first);
         ++stream_; // gobble the closing "
 
-        return {start, tok::string, str};
+        return str;
     }
 
     token number() {
-        using namespace std::string_literals;
-
         auto start = loc();
-        std::string str;
+        const char* first = stream_;
         char c = *stream_;
 
         // Start counting the number of points in the number.
         auto num_point = (c=='.' ? 1 : 0);
         auto uses_scientific_notation = 0;
 
-        str += c;
         ++stream_;
         while(1) {
-            c = *stream_;
+            c = empty()? '\0': *stream_;
             if (std::isdigit(c)) {
-                str += c;
                 ++stream_;
             }
             else if (c=='.') {
                 if (++num_point>1) {
                     // Can't have more than one '.' in a number
-                    return {start, tok::error, "unexpected '.'"s};
+                    return {start, tok::error, "unexpected '.'"};
                 }
-                str += c;
                 ++stream_;
                 if (uses_scientific_notation) {
                     // Can't have a '.' in the mantissa
-                    return {start, tok::error, "unexpected '.'"s};
+                    return {start, tok::error, "unexpected '.'"};
                 }
             }
             else if (!uses_scientific_notation && (c=='e' || c=='E')) {
@@ -353,11 +355,10 @@ private:
                     (is_plusminus(peek_char(1)) && std::isdigit(peek_char(2))))
                 {
                     uses_scientific_notation++;
-                    str += c;
                     stream_++;
                     // Consume the next char if +/-
                     if (is_plusminus(*stream_)) {
-                        str += *stream_++;
+                        stream_++;
                     }
                 }
                 else {
@@ -371,7 +372,7 @@ private:
         }
 
         const bool is_real = uses_scientific_notation || num_point>0;
-        return {start, (is_real? tok::real: tok::integer), std::move(str)};
+        return spelled(start, (is_real? tok::real: tok::integer), first);
     }
 
     char character() {
@@ -379,8 +380,12 @@ private:
     }
 };
 
+lexer::lexer(const char* begin, const char* end):
+    impl_(new lexer_impl(begin, end))
+{}
+
 lexer::lexer(const char* begin):
-    impl_(new lexer_impl(begin))
+    lexer(begin, begin+std::strlen(begin))
 {}
 
 const token& lexer::current() {
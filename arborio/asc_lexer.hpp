@@ -3,6 +3,7 @@
 #include <memory>
 #include <ostream>
 #include <string>
+#include <string_view>
 
 namespace arborio {
 
@@ -38,10 +39,12 @@ enum class tok {
 
 std::ostream& operator<<(std::ostream&, const tok&);
 
+// The spelling of a token is a view of the input, or for errors of a message
+// held by the lexer, valid while the lexer and its input are.
 struct token {
     src_location loc;
     tok kind;
-    std::string spelling;
+    std::string_view spelling;
 };
 
 std::ostream& operator<<(std::ostream&, const token&);
@@ -51,6 +54,10 @@ class lexer_impl;
 
 class lexer {
 public:
+    // Tokenise the characters [begin, end), or up to a null character.
+    lexer(const char* begin, const char* end);
+
+    // Tokenise the null-terminated string at begin.
     lexer(const char* begin);
 
     const token& current();
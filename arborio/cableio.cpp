@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <optional>
 #include <sstream>
 #include <unordered_map>
 
@@ -519,16 +520,30 @@ parse_hopefully<std::any> eval(const s_expr& e, const eval_map& map, const eval_
 
         // Otherwise this must be a function evaluation, where head is the function name,
         // and tail is a list of arguments.
+        // Find all candidate functions that match the name of the function.
+        auto& name = e.head().atom().spelling;
+        auto matches = map.equal_range(name);
+
+        // If it's not in the provided map, maybe it's a label expression
+        // the corresponding parser is provided by the arbor lib.
+        // Try it first, so that its arguments are evaluated only once.
+        auto eval_label = [&e]() -> std::optional<std::any> {
+            if (auto l = parse_label_expression(e)) {
+                if (match<region>(l->type())) return eval_cast<region>(l.value());
+                if (match<locset>(l->type())) return eval_cast<locset>(l.value());
+            }
+            return std::nullopt;
+        };
+        if (matches.first==matches.second) {
+            if (auto l = eval_label()) return std::move(*l);
+        }
+
         // Evaluate the arguments, and return error state if an error occurred.
         auto args = eval_args(e.tail(), map, vec);
         if (!args) {
             return util::unexpected(args.error());
         }
 
-        // Find all candidate functions that match the name of the function.
-        auto& name = e.head().atom().spelling;
-        auto matches = map.equal_range(name);
-
         // Search for a candidate that matches the argument list.
         for (auto i=matches.first; i!=matches.second; ++i) {
             if (i->second.match_args(*args)) { // found a match: evaluate and return.
@@ -536,11 +551,8 @@ parse_hopefully<std::any> eval(const s_expr& e, const eval_map& map, const eval_
             }
         }
 
-        // If it's not in the provided map, maybe it's a label expression
-        // the corresponding parser is provided by the arbor lib
-        if (auto l = parse_label_expression(e)) {
-            if (match<region>(l->type())) return eval_cast<region>(l.value());
-            if (match<locset>(l->type())) return eval_cast<locset>(l.value());
+        if (matches.first!=matches.second) {
+            if (auto l = eval_label()) return std::move(*l);
         }
 
         // Unable to find a match: try to return a helpful error message.
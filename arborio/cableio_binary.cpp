@@ -0,0 +1,536 @@
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/cable_cell.hpp>
+#include <arbor/morph/segment_tree.hpp>
+#include <arbor/util/any_visitor.hpp>
+
+#include <arborio/cableio.hpp>
+#include <arborio/cv_policy_parse.hpp>
+#include <arborio/label_parse.hpp>
+
+// Binary layout, in native byte order:
+//
+//   header:   magic "ARBACCB\0", u32 format version, u32 component kind,
+//             u32 string index of the meta-data version
+//   strings:  u32 count, then for each: u32 length, characters
+//   body:     the sections of the component, a cable cell holding the
+//             morphology, label dictionary and decor sections in turn
+//
+// All names, ion species and region, locset and cv-policy expressions are
+// held once in the string table, and referred to by index. Expressions are
+// kept in their s-expression form and parsed once each when read.
+//
+//   morphology: u32 count, then per segment in id order:
+//               u32 parent, f64 x 4 proximal point, f64 x 4 distal point, i32 tag
+//   label_dict: u32 count, {u32 name, u32 locset} ..., u32 count, {u32 name, u32 region} ...
+//   decor:      u32 count, {item} ... defaults
+//               u32 count, {u32 region, item} ... paintings
+//               u32 count, {u32 locset, u32 label, item} ... placements
+//   item:       u32 item kind, then its values
+
+namespace arborio {
+
+using namespace arb;
+
+namespace {
+constexpr char binary_magic[8] = {'A', 'R', 'B', 'A', 'C', 'C', 'B', '\0'};
+constexpr std::uint32_t binary_format_version = 1;
+
+enum class component_kind: std::uint32_t {
+    morphology, label_dict, decor, cable_cell
+};
+
+enum class item_kind: std::uint32_t {
+    membrane_potential, axial_resistivity, temperature, membrane_capacitance,
+    int_concentration, ext_concentration, reversal_potential, reversal_potential_method,
+    cv_policy, mechanism, current_clamp, threshold_detector, gap_junction_site
+};
+
+struct binary_writer {
+    std::string buf;
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, std::uint32_t> string_index;
+
+    template <typename T>
+    void value(T v) {
+        buf.append(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+
+    void kind(item_kind k) { value(std::uint32_t(k)); }
+
+    std::uint32_t index(const std::string& s) {
+        auto [it, inserted] = string_index.emplace(s, strings.size());
+        if (inserted) strings.push_back(s);
+        return it->second;
+    }
+
+    void string(const std::string& s) { value(index(s)); }
+
+    template <typename T>
+    void expression(const T& x) {
+        std::stringstream s;
+        s << x;
+        string(s.str());
+    }
+
+    void point(const mpoint& p) {
+        value(p.x); value(p.y); value(p.z); value(p.radius);
+    }
+
+    void write(const morphology& m) {
+        std::vector<std::pair<msize_t, const msegment*>> segs;
+        for (msize_t b = 0; b<m.num_branches(); ++b) {
+            auto pb = m.branch_parent(b);
+            msize_t parent = pb==mnpos? mnpos: m.branch_segments(pb).back().id;
+            for (const auto& seg: m.branch_segments(b)) {
+                if (seg.id>=segs.size()) segs.resize(seg.id+1);
+                segs[seg.id] = {parent, &seg};
+                parent = seg.id;
+            }
+        }
+        value(std::uint32_t(segs.size()));
+        for (auto& [parent, seg]: segs) {
+            value(std::uint32_t(parent));
+            point(seg->prox);
+            point(seg->dist);
+            value(std::int32_t(seg->tag));
+        }
+    }
+
+    void write(const label_dict& d) {
+        value(std::uint32_t(d.locsets().size()));
+        for (auto& [name, ls]: d.locsets()) {
+            string(name);
+            expression(ls);
+        }
+        value(std::uint32_t(d.regions().size()));
+        for (auto& [name, reg]: d.regions()) {
+            string(name);
+            expression(reg);
+        }
+    }
+
+    void item(const init_membrane_potential& x) { kind(item_kind::membrane_potential); value(x.value); }
+    void item(const axial_resistivity& x)       { kind(item_kind::axial_resistivity); value(x.value); }
+    void item(const temperature_K& x)           { kind(item_kind::temperature); value(x.value); }
+    void item(const membrane_capacitance& x)    { kind(item_kind::membrane_capacitance); value(x.value); }
+    void item(const init_int_concentration& x)  { kind(item_kind::int_concentration); string(x.ion); value(x.value); }
+    void item(const init_ext_concentration& x)  { kind(item_kind::ext_concentration); string(x.ion); value(x.value); }
+    void item(const init_reversal_potential& x) { kind(item_kind::reversal_potential); string(x.ion); value(x.value); }
+    void item(const cv_policy& x)               { kind(item_kind::cv_policy); expression(x); }
+    void item(const threshold_detector& x)      { kind(item_kind::threshold_detector); value(x.threshold); }
+    void item(const gap_junction_site&)         { kind(item_kind::gap_junction_site); }
+
+    void item(const ion_reversal_potential_method& x) {
+        kind(item_kind::reversal_potential_method);
+        string(x.ion);
+        mechanism(x.method);
+    }
+
+    void item(const mechanism_desc& x) {
+        kind(item_kind::mechanism);
+        mechanism(x);
+    }
+
+    void item(const i_clamp& x) {
+        kind(item_kind::current_clamp);
+        value(std::uint32_t(x.envelope.size()));
+        for (auto& p: x.envelope) {
+            value(p.t);
+            value(p.amplitude);
+        }
+        value(x.frequency);
+        value(x.phase);
+    }
+
+    void mechanism(const mechanism_desc& x) {
+        string(x.name());
+        value(std::uint32_t(x.values().size()));
+        for (auto& [key, v]: x.values()) {
+            string(key);
+            value(v);
+        }
+    }
+
+    void write(const decor& d) {
+        auto defaults = d.defaults().serialize();
+        value(std::uint32_t(defaults.size()));
+        for (auto& x: defaults) {
+            std::visit([&](auto& v) { item(v); }, x);
+        }
+        value(std::uint32_t(d.paintings().size()));
+        for (auto& [reg, x]: d.paintings()) {
+            expression(reg);
+            std::visit([&](auto& v) { item(v); }, x);
+        }
+        value(std::uint32_t(d.placements().size()));
+        for (auto& [ls, x, label]: d.placements()) {
+            expression(ls);
+            string(label);
+            std::visit([&](auto& v) { item(v); }, x);
+        }
+    }
+
+    void write(const cable_cell& c) {
+        write(c.morphology());
+        write(c.labels());
+        write(c.decorations());
+    }
+};
+
+struct binary_format_error {
+    std::string what;
+};
+
+// Reads values from the buffer in place; the only allocations are those of
+// the objects being built, and of the table of string views into the buffer.
+struct binary_reader {
+    const char* p;
+    const char* end;
+    std::vector<std::string_view> strings;
+
+    // Expressions by string index, parsed on first use.
+    std::unordered_map<std::uint32_t, region> regions;
+    std::unordered_map<std::uint32_t, locset> locsets;
+
+    void need(std::size_t n) {
+        if (std::size_t(end-p)<n) throw binary_format_error{"unexpected end of data"};
+    }
+
+    template <typename T>
+    T value() {
+        need(sizeof(T));
+        T v;
+        std::memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        return v;
+    }
+
+    std::uint32_t count(std::size_t min_size) {
+        auto n = value<std::uint32_t>();
+        // Reject counts that can not fit in the remaining data before
+        // anything is sized by them.
+        if (min_size && n>std::size_t(end-p)/min_size) throw binary_format_error{"invalid count"};
+        return n;
+    }
+
+    std::string string() {
+        auto i = value<std::uint32_t>();
+        if (i>=strings.size()) throw binary_format_error{"invalid string index"};
+        return std::string(strings[i]);
+    }
+
+    template <typename T, typename Parse>
+    const T& expression(std::unordered_map<std::uint32_t, T>& parsed, Parse&& parse) {
+        auto i = value<std::uint32_t>();
+        if (i>=strings.size()) throw binary_format_error{"invalid string index"};
+        auto it = parsed.find(i);
+        if (it==parsed.end()) {
+            auto r = parse(std::string(strings[i]));
+            if (!r) throw binary_format_error{r.error().what()};
+            it = parsed.emplace(i, std::move(*r)).first;
+        }
+        return it->second;
+    }
+
+    const region& region_expr() { return expression(regions, parse_region_expression); }
+    const locset& locset_expr() { return expression(locsets, parse_locset_expression); }
+
+    void read_strings() {
+        auto n = count(sizeof(std::uint32_t));
+        strings.reserve(n);
+        for (std::uint32_t i = 0; i<n; ++i) {
+            auto len = value<std::uint32_t>();
+            need(len);
+            strings.emplace_back(p, len);
+            p += len;
+        }
+    }
+
+    mpoint point() {
+        mpoint x;
+        x.x = value<double>();
+        x.y = value<double>();
+        x.z = value<double>();
+        x.radius = value<double>();
+        return x;
+    }
+
+    morphology read_morphology() {
+        constexpr std::size_t record_size = 2*sizeof(std::uint32_t) + 8*sizeof(double);
+        auto n = count(record_size);
+        segment_tree tree;
+        tree.reserve(n);
+        for (std::uint32_t i = 0; i<n; ++i) {
+            auto parent = value<std::uint32_t>();
+            auto prox = point();
+            auto dist = point();
+            auto tag = value<std::int32_t>();
+            if (parent!=mnpos && parent>=i) throw binary_format_error{"invalid segment parent"};
+            tree.append(parent, prox, dist, tag);
+        }
+        return morphology(tree);
+    }
+
+    label_dict read_label_dict() {
+        label_dict d;
+        auto n_locsets = count(2*sizeof(std::uint32_t));
+        for (std::uint32_t i = 0; i<n_locsets; ++i) {
+            auto name = string();
+            d.set(name, locset_expr());
+        }
+        auto n_regions = count(2*sizeof(std::uint32_t));
+        for (std::uint32_t i = 0; i<n_regions; ++i) {
+            auto name = string();
+            d.set(name, region_expr());
+        }
+        return d;
+    }
+
+    mechanism_desc mechanism() {
+        mechanism_desc m(string());
+        auto n = count(sizeof(std::uint32_t)+sizeof(double));
+        for (std::uint32_t i = 0; i<n; ++i) {
+            auto key = string();
+            m.set(key, value<double>());
+        }
+        return m;
+    }
+
+    i_clamp clamp() {
+        auto n = count(2*sizeof(double));
+        std::vector<i_clamp::envelope_point> envelope(n);
+        for (auto& e: envelope) {
+            e.t = value<double>();
+            e.amplitude = value<double>();
+        }
+        auto frequency = value<double>();
+        auto phase = value<double>();
+        return i_clamp(std::move(envelope), frequency, phase);
+    }
+
+    template <typename Ion>
+    Ion ion_value() {
+        Ion x;
+        x.ion = string();
+        x.value = value<double>();
+        return x;
+    }
+
+    cv_policy policy() {
+        auto r = parse_cv_policy_expression(string());
+        if (!r) throw binary_format_error{r.error().what()};
+        return *r;
+    }
+
+    template <typename T>
+    T scalar() {
+        T x;
+        x.value = value<double>();
+        return x;
+    }
+
+    defaultable default_item() {
+        switch (item_kind(value<std::uint32_t>())) {
+        case item_kind::membrane_potential:   return scalar<init_membrane_potential>();
+        case item_kind::axial_resistivity:    return scalar<axial_resistivity>();
+        case item_kind::temperature:          return scalar<temperature_K>();
+        case item_kind::membrane_capacitance: return scalar<membrane_capacitance>();
+        case item_kind::int_concentration:    return ion_value<init_int_concentration>();
+        case item_kind::ext_concentration:    return ion_value<init_ext_concentration>();
+        case item_kind::reversal_potential:   return ion_value<init_reversal_potential>();
+        case item_kind::cv_policy:            return policy();
+        case item_kind::reversal_potential_method: {
+            auto ion = string();
+            return ion_reversal_potential_method{std::move(ion), mechanism()};
+        }
+        default:
+            throw binary_format_error{"invalid default item"};
+        }
+    }
+
+    paintable paint_item() {
+        switch (item_kind(value<std::uint32_t>())) {
+        case item_kind::membrane_potential:   return scalar<init_membrane_potential>();
+        case item_kind::axial_resistivity:    return scalar<axial_resistivity>();
+        case item_kind::temperature:          return scalar<temperature_K>();
+        case item_kind::membrane_capacitance: return scalar<membrane_capacitance>();
+        case item_kind::int_concentration:    return ion_value<init_int_concentration>();
+        case item_kind::ext_concentration:    return ion_value<init_ext_concentration>();
+        case item_kind::reversal_potential:   return ion_value<init_reversal_potential>();
+        case item_kind::mechanism:            return mechanism();
+        default:
+            throw binary_format_error{"invalid paint item"};
+        }
+    }
+
+    placeable place_item() {
+        switch (item_kind(value<std::uint32_t>())) {
+        case item_kind::mechanism:          return mechanism();
+        case item_kind::current_clamp:      return clamp();
+        case item_kind::threshold_detector: return threshold_detector{value<double>()};
+        case item_kind::gap_junction_site:  return gap_junction_site{};
+        default:
+            throw binary_format_error{"invalid place item"};
+        }
+    }
+
+    decor read_decor() {
+        decor d;
+        auto n_defaults = count(sizeof(std::uint32_t));
+        for (std::uint32_t i = 0; i<n_defaults; ++i) {
+            d.set_default(default_item());
+        }
+        auto n_paintings = count(2*sizeof(std::uint32_t));
+        for (std::uint32_t i = 0; i<n_paintings; ++i) {
+            const auto& reg = region_expr();
+            d.paint(reg, paint_item());
+        }
+        auto n_placements = count(3*sizeof(std::uint32_t));
+        for (std::uint32_t i = 0; i<n_placements; ++i) {
+            const auto& ls = locset_expr();
+            auto label = string();
+            d.place(ls, place_item(), std::move(label));
+        }
+        return d;
+    }
+
+    cable_cell_component read() {
+        need(sizeof(binary_magic));
+        if (std::memcmp(p, binary_magic, sizeof(binary_magic))) {
+            throw binary_format_error{"not a binary arbor-component"};
+        }
+        p += sizeof(binary_magic);
+        if (value<std::uint32_t>()!=binary_format_version) {
+            throw binary_format_error{"unsupported binary format version"};
+        }
+        auto kind = value<std::uint32_t>();
+        auto version_index = value<std::uint32_t>();
+        read_strings();
+        if (version_index>=strings.size()) throw binary_format_error{"invalid string index"};
+
+        cable_cell_component c;
+        c.meta.version = std::string(strings[version_index]);
+        if (c.meta.version!=acc_version()) {
+            throw binary_format_error{"unsupported cable-cell format version "+c.meta.version};
+        }
+
+        switch (component_kind(kind)) {
+        case component_kind::morphology:
+            c.component = read_morphology();
+            break;
+        case component_kind::label_dict:
+            c.component = read_label_dict();
+            break;
+        case component_kind::decor:
+            c.component = read_decor();
+            break;
+        case component_kind::cable_cell: {
+            auto m = read_morphology();
+            auto l = read_label_dict();
+            auto d = read_decor();
+            c.component = cable_cell(m, l, d);
+            break;
+        }
+        default:
+            throw binary_format_error{"invalid component kind"};
+        }
+        if (p!=end) throw binary_format_error{"unexpected data after component"};
+        return c;
+    }
+};
+} // namespace
+
+std::ostream& write_component_binary(std::ostream& o, const cable_cell_component& x) {
+    if (x.meta.version != acc_version()) {
+        throw cableio_version_error(x.meta.version);
+    }
+
+    binary_writer w;
+    auto version_index = w.index(x.meta.version);
+    auto kind = std::visit(arb::util::overload(
+        [&](const morphology& c) { w.write(c); return component_kind::morphology; },
+        [&](const label_dict& c) { w.write(c); return component_kind::label_dict; },
+        [&](const decor& c)      { w.write(c); return component_kind::decor; },
+        [&](const cable_cell& c) { w.write(c); return component_kind::cable_cell; }),
+        x.component);
+
+    // The string table is collected while writing the body, and so is
+    // written out after the header, ahead of the body.
+    binary_writer head;
+    head.buf.append(binary_magic, sizeof(binary_magic));
+    head.value(binary_format_version);
+    head.value(std::uint32_t(kind));
+    head.value(version_index);
+    head.value(std::uint32_t(w.strings.size()));
+    for (auto& s: w.strings) {
+        head.value(std::uint32_t(s.size()));
+        head.buf += s;
+    }
+
+    o.write(head.buf.data(), head.buf.size());
+    return o.write(w.buf.data(), w.buf.size());
+}
+
+parse_hopefully<cable_cell_component> read_component_binary(const char* begin, const char* end) {
+    try {
+        return binary_reader{begin, end}.read();
+    }
+    catch (binary_format_error& e) {
+        return util::unexpected(cableio_parse_error("Invalid binary arbor-component: "+e.what));
+    }
+    catch (arb::arbor_exception& e) {
+        return util::unexpected(cableio_parse_error(std::string("Invalid binary arbor-component: ")+e.what()));
+    }
+}
+
+parse_hopefully<cable_cell_component> read_component_binary(std::istream& s) {
+    std::string data(std::istreambuf_iterator<char>(s), {});
+    return read_component_binary(data.data(), data.data()+data.size());
+}
+
+parse_hopefully<cable_cell_component> read_component_binary_file(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd<0) throw arb::file_not_found_error(path);
+
+    struct stat st;
+    if (::fstat(fd, &st)!=0) {
+        ::close(fd);
+        throw arb::file_not_found_error(path);
+    }
+
+    std::size_t size = st.st_size;
+    if (!size) {
+        ::close(fd);
+        return read_component_binary(nullptr, nullptr);
+    }
+
+    void* addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr==MAP_FAILED) throw arb::file_not_found_error(path);
+
+    struct unmap {
+        void* addr;
+        std::size_t size;
+        ~unmap() { ::munmap(addr, size); }
+    } guard{addr, size};
+
+    auto data = static_cast<const char*>(addr);
+    return read_component_binary(data, data+size);
+}
+
+} // namespace arborio
@@ -55,6 +55,18 @@ eval_map {{"default",
           {"max-extent",
            make_call<double, region, int>([] (double i, const region& r, int f) { return arb::cv_policy{arb::cv_policy_max_extent(i, r, f) }; },
                                           "'max-extent' with three arguments (max-extent (length:double) (reg:region) (flags:int))")},
+          {"d-lambda",
+           make_call<double>([] (double d) { return arb::cv_policy{arb::cv_policy_d_lambda(d) }; },
+                             "'d-lambda' with one argument (d-lambda (d:double))")},
+          {"d-lambda",
+           make_call<double, double>([] (double d, double f) { return arb::cv_policy{arb::cv_policy_d_lambda(d, f) }; },
+                                     "'d-lambda' with two arguments (d-lambda (d:double) (freq:double))")},
+          {"d-lambda",
+           make_call<double, double, region>([] (double d, double f, const region& r) { return arb::cv_policy{arb::cv_policy_d_lambda(d, f, r) }; },
+                                             "'d-lambda' with three arguments (d-lambda (d:double) (freq:double) (reg:region))")},
+          {"d-lambda",
+           make_call<double, double, region, int>([] (double d, double f, const region& r, int fl) { return arb::cv_policy{arb::cv_policy_d_lambda(d, f, r, fl) }; },
+                                                  "'d-lambda' with four arguments (d-lambda (d:double) (freq:double) (reg:region) (flags:int))")},
           {"single",
            make_call<>([] () { return arb::cv_policy{arb::cv_policy_single()}; },
                        "'single' with no arguments")},
@@ -8,6 +8,7 @@ std::string acc_version();
 
 struct cableio_parse_error: arb::arbor_exception {
     explicit cableio_parse_error(const std::string& msg, const arb::src_location& loc);
+    explicit cableio_parse_error(const std::string& msg): arb::arbor_exception(msg) {}
 };
 
 struct cableio_morphology_error: arb::arbor_exception {
@@ -39,4 +40,18 @@ std::ostream& write_component(std::ostream&, const arb::cable_cell& x, const met
 parse_hopefully<cable_cell_component> parse_component(const std::string&);
 parse_hopefully<cable_cell_component> parse_component(std::istream&);
 
+// Compact binary form of a component, for loading many components quickly.
+// The text form remains the authoring and interchange format: binary files
+// use the native byte order and are read only by the same version of arbor.
+std::ostream& write_component_binary(std::ostream&, const cable_cell_component&);
+
+// Read a component from the binary data in [begin, end), such as a file
+// mapped into memory; the data are not referenced after the call.
+parse_hopefully<cable_cell_component> read_component_binary(const char* begin, const char* end);
+parse_hopefully<cable_cell_component> read_component_binary(std::istream&);
+
+// Map the file at `path` into memory and read a binary component from it.
+// Throws arb::file_not_found_error if the file can not be opened.
+parse_hopefully<cable_cell_component> read_component_binary_file(const std::string& path);
+
 } // namespace arborio
\ No newline at end of file
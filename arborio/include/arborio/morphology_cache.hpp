@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arbor/context.hpp>
+#include <arbor/morph/morphology.hpp>
+
+#include <arborio/neurolucida.hpp>
+
+namespace arborio {
+
+// Cache of morphologies loaded from files, for recipes that use the same
+// morphology file for many cells.
+//
+// Each call reads the file at `path`, and parses it only if no file with the
+// same contents was loaded before in the same format; otherwise it returns
+// the cached result. Entries are keyed by format and a hash of the contents,
+// so that a file that changes is loaded afresh, and files with the same
+// contents at different paths share one entry.
+//
+// The returned morphologies share their immutable implementation, and with
+// it the embedding used to evaluate regions and locsets and to discretise the
+// cells. The cache may be used from several threads at once, such as from
+// `get_cell_description`. Throws arb::file_not_found_error if the file cannot
+// be read, or the exceptions of the corresponding loader.
+
+struct morphology_cache_impl;
+
+struct morphology_cache {
+    morphology_cache();
+
+    morphology_cache(morphology_cache&&);
+    morphology_cache(const morphology_cache&) = delete;
+
+    morphology_cache& operator=(morphology_cache&&);
+    morphology_cache& operator=(const morphology_cache&) = delete;
+
+    // As `load_swc_arbor(parse_swc(...))` and `load_swc_neuron(parse_swc(...))`.
+    arb::morphology load_swc_arbor(const std::string& path);
+    arb::morphology load_swc_neuron(const std::string& path);
+
+    // As `load_asc(path)`.
+    asc_morphology load_asc(const std::string& path);
+
+    // As `load_asc(path)` for each of `paths`, in parallel on the thread pool
+    // of `ctx`; files with the same contents are parsed once.
+    std::vector<asc_morphology> load_asc(const std::vector<std::string>& paths, const arb::context& ctx);
+
+    // Number of cached entries.
+    std::size_t size() const;
+
+    // Drop all cached entries; morphologies already returned remain valid.
+    void clear();
+
+    ~morphology_cache();
+
+private:
+    std::unique_ptr<morphology_cache_impl> impl_;
+};
+
+} // namespace arborio
@@ -3,8 +3,10 @@
 #include <cstddef>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 #include <arbor/arbexcept.hpp>
+#include <arbor/context.hpp>
 #include <arbor/morph/label_dict.hpp>
 #include <arbor/morph/morphology.hpp>
 
@@ -39,7 +41,19 @@ struct asc_morphology {
     arb::label_dict labels;
 };
 
-// Load asc morphology from file with name filename.
+// Load asc morphology from file with name filename, which is mapped into
+// memory and parsed in place.
 asc_morphology load_asc(std::string filename);
 
+// Load each of the asc files in `paths`, in parallel on the thread pool of
+// `ctx`. The results are in the order of `paths`; if any file cannot be read
+// or is invalid, one of the exceptions is rethrown.
+std::vector<asc_morphology> load_asc(const std::vector<std::string>& paths, const arb::context& ctx);
+
+// Parse asc morphology from the null-terminated contents of an asc file.
+asc_morphology parse_asc_string(const char* input);
+
+// As above, for the contents of an asc file in the character range [begin, end).
+asc_morphology parse_asc_string(const char* begin, const char* end);
+
 } // namespace arborio
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <functional>
 #include <stdexcept>
 #include <optional>
 #include <memory>
@@ -129,4 +130,72 @@ private:
     std::unique_ptr<neuroml_impl> impl_;
 };
 
+// Streaming access to NeuroML documents.
+//
+// A streaming reader visits the document once, in order, without building
+// a document tree in memory, and passes each item to the corresponding
+// handler as soon as it has been read. Items without a handler are skipped.
+//
+// As with `neuroml`, only top-level <morphology>, <cell> and <network>
+// elements of the <neuroml> root are considered. The morphology handler is
+// called for each top-level <morphology>, with an empty cell id, and for
+// each <cell>, with the morphology it contains or else the top-level
+// morphology it refers to; a cell that refers to a morphology that follows
+// it is reported once that morphology has been read.
+//
+// Networks are an extension to the document interface: the handlers receive
+// each <population>, and each <connection> or <connectionWD> of each
+// <projection>, of each <network>.
+
+struct nml_population {
+    std::string network_id;
+    std::string id;
+
+    // Id of the cell of each member of the population.
+    std::string component;
+
+    // Number of cells, from the size attribute or else the number of
+    // <instance> elements.
+    unsigned long long size = 0;
+};
+
+struct nml_projection {
+    std::string network_id;
+    std::string id;
+    std::string presynaptic_population;
+    std::string postsynaptic_population;
+    std::string synapse;
+};
+
+struct nml_connection {
+    // Indices of the cells in the pre- and postsynaptic populations, from
+    // cell references of the form "../pop/index/component" or "../pop[index]".
+    unsigned long long pre_cell = 0;
+    unsigned long long post_cell = 0;
+
+    // Locations on the cells.
+    unsigned long long pre_segment = 0;
+    double pre_fraction_along = 0.5;
+    unsigned long long post_segment = 0;
+    double post_fraction_along = 0.5;
+
+    // Weight and delay [ms], which only <connectionWD> elements specify.
+    double weight = 1;
+    double delay = 0;
+};
+
+struct nml_stream_handlers {
+    std::function<void (nml_morphology_data)> morphology;
+    std::function<void (const nml_population&)> population;
+    std::function<void (const nml_projection&, const nml_connection&)> connection;
+};
+
+// Read the NeuroML document in the string, or the file at path, calling the
+// handlers. Throws arborio::xml_error if the document is not well formed,
+// the exceptions derived from neuroml_exception of the `neuroml` methods, and
+// arb::file_not_found_error if the file cannot be opened.
+
+void stream_neuroml(const std::string& nml_document, const nml_stream_handlers& handlers, enum neuroml_options::values = neuroml_options::none);
+void stream_neuroml_file(const std::string& path, const nml_stream_handlers& handlers, enum neuroml_options::values = neuroml_options::none);
+
 } // namespace arborio
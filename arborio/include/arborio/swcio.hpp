@@ -5,6 +5,7 @@
 #include <vector>
 
 #include <arbor/arbexcept.hpp>
+#include <arbor/context.hpp>
 #include <arbor/morph/morphology.hpp>
 
 namespace arborio {
@@ -117,6 +118,23 @@ public:
 swc_data parse_swc(std::istream&);
 swc_data parse_swc(const std::string&);
 
+// As above, for the SWC data in the character range [begin, end). Numbers
+// are parsed directly from the buffer, without a stream or locale; the
+// std::string overload is parsed the same way.
+
+swc_data parse_swc(const char* begin, const char* end);
+
+// Parse the SWC file at `path`, which is mapped into memory rather than read
+// through a stream. Throws arb::file_not_found_error if it cannot be read.
+
+swc_data parse_swc_file(const std::string& path);
+
+// Parse each of the SWC files in `paths` with `parse_swc_file`, in parallel
+// on the thread pool of `ctx`. The results are in the order of `paths`; if
+// any file cannot be read or is invalid, one of the exceptions is rethrown.
+
+std::vector<swc_data> parse_swc_files(const std::vector<std::string>& paths, const arb::context& ctx);
+
 // Convert a valid, ordered sequence of SWC records into a morphology.
 //
 // Note that 'one-point soma' SWC files are explicitly not supported.
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <arbor/arbexcept.hpp>
+
+namespace arborio {
+
+// A file mapped read-only into memory, to be parsed in place. The contents
+// are [begin(), end()), and are not null-terminated; an empty file has no
+// mapping. Throws arb::file_not_found_error if the file cannot be mapped.
+
+class mapped_file {
+public:
+    explicit mapped_file(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd<0) throw arb::file_not_found_error(path);
+
+        struct stat st;
+        if (::fstat(fd, &st)!=0) {
+            ::close(fd);
+            throw arb::file_not_found_error(path);
+        }
+
+        size_ = st.st_size;
+        if (!size_) {
+            ::close(fd);
+            return;
+        }
+
+        void* addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (addr==MAP_FAILED) throw arb::file_not_found_error(path);
+
+        addr_ = addr;
+        ::madvise(addr_, size_, MADV_SEQUENTIAL);
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    ~mapped_file() {
+        if (addr_) ::munmap(addr_, size_);
+    }
+
+    const char* begin() const { return static_cast<const char*>(addr_); }
+    const char* end() const { return begin()+(addr_? size_: 0); }
+
+private:
+    void* addr_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+} // namespace arborio
@@ -0,0 +1,110 @@
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <arbor/context.hpp>
+#include <arbor/morph/morphology.hpp>
+
+#include <arborio/morphology_cache.hpp>
+#include <arborio/neurolucida.hpp>
+#include <arborio/swcio.hpp>
+
+#include "mapped_file.hpp"
+
+namespace arborio {
+
+namespace {
+enum class morph_format { swc_arbor, swc_neuron, asc };
+
+struct cache_key {
+    morph_format format;
+    std::size_t size;
+    std::uint64_t hash;
+
+    bool operator==(const cache_key& other) const {
+        return format==other.format && size==other.size && hash==other.hash;
+    }
+};
+
+struct cache_key_hash {
+    std::size_t operator()(const cache_key& k) const {
+        return std::size_t(k.hash ^ (std::uint64_t(k.format)<<61));
+    }
+};
+
+// 64-bit FNV-1a hash of the file contents.
+std::uint64_t content_hash(const char* begin, const char* end) {
+    std::uint64_t h = 0xcbf29ce484222325ull;
+    for (auto p = begin; p!=end; ++p) {
+        h ^= (unsigned char)*p;
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+} // namespace
+
+struct morphology_cache_impl {
+    mutable std::mutex mutex;
+    std::unordered_map<cache_key, asc_morphology, cache_key_hash> entries;
+
+    // Files are mapped into memory, and parsed in place outside the lock, so
+    // that distinct files are loaded concurrently. If two threads load the
+    // same contents, the first entry inserted is kept and returned to both.
+    template <typename Load>
+    asc_morphology get(morph_format format, const std::string& path, Load&& load) {
+        mapped_file file(path);
+        cache_key key{format, std::size_t(file.end()-file.begin()), content_hash(file.begin(), file.end())};
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(key);
+            if (it!=entries.end()) return it->second;
+        }
+
+        asc_morphology loaded = load(file.begin(), file.end());
+
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.emplace(key, std::move(loaded)).first->second;
+    }
+};
+
+morphology_cache::morphology_cache(): impl_(new morphology_cache_impl) {}
+
+morphology_cache::morphology_cache(morphology_cache&&) = default;
+morphology_cache& morphology_cache::operator=(morphology_cache&&) = default;
+
+morphology_cache::~morphology_cache() = default;
+
+arb::morphology morphology_cache::load_swc_arbor(const std::string& path) {
+    return impl_->get(morph_format::swc_arbor, path,
+        [](const char* b, const char* e) { return asc_morphology{arborio::load_swc_arbor(parse_swc(b, e)), {}}; }).morphology;
+}
+
+arb::morphology morphology_cache::load_swc_neuron(const std::string& path) {
+    return impl_->get(morph_format::swc_neuron, path,
+        [](const char* b, const char* e) { return asc_morphology{arborio::load_swc_neuron(parse_swc(b, e)), {}}; }).morphology;
+}
+
+asc_morphology morphology_cache::load_asc(const std::string& path) {
+    return impl_->get(morph_format::asc, path,
+        [](const char* b, const char* e) { return parse_asc_string(b, e); });
+}
+
+std::vector<asc_morphology> morphology_cache::load_asc(const std::vector<std::string>& paths, const arb::context& ctx) {
+    std::vector<asc_morphology> loaded(paths.size());
+    arb::run_parallel(ctx, paths.size(), [&](std::size_t i) { loaded[i] = load_asc(paths[i]); });
+    return loaded;
+}
+
+std::size_t morphology_cache::size() const {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    return impl_->entries.size();
+}
+
+void morphology_cache::clear() {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    impl_->entries.clear();
+}
+
+} // namespace arborio
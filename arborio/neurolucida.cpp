@@ -1,14 +1,20 @@
+#include <charconv>
+#include <cstdlib>
 #include <cstring>
 #include <ostream>
-#include <fstream>
 #include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
 
+#include <arbor/context.hpp>
 #include <arbor/util/expected.hpp>
 
 #include <arborio/neurolucida.hpp>
 #include "arbor/arbexcept.hpp"
 #include "arbor/morph/primitives.hpp"
 #include "asc_lexer.hpp"
+#include "mapped_file.hpp"
 
 #include <optional>
 
@@ -76,7 +82,7 @@ using asc::tok;
 parse_hopefully<tok> expect_token(asc::lexer& l, tok kind) {
     auto& t = l.current();
     if (t.kind != kind) {
-        return unexpected(PARSE_ERROR("unexpected symbol '"+t.spelling+"'", t.loc));
+        return unexpected(PARSE_ERROR("unexpected symbol '"+std::string(t.spelling)+"'", t.loc));
     }
     l.next();
     return kind;
@@ -92,7 +98,16 @@ parse_hopefully<double> parse_double(asc::lexer& L) {
         return unexpected(PARSE_ERROR("missing real number", L.current().loc));
     }
     L.next(); // consume the number
-    return std::stod(t.spelling);
+
+    // The spelling is not null-terminated; numbers of any reasonable length
+    // are converted from a copy on the stack.
+    char buf[64];
+    if (t.spelling.size()<sizeof buf) {
+        t.spelling.copy(buf, t.spelling.size());
+        buf[t.spelling.size()] = '\0';
+        return std::strtod(buf, nullptr);
+    }
+    return std::stod(std::string(t.spelling));
 }
 
 #define PARSE_DOUBLE(L, X) {if (auto rval__ = parse_double(L)) X=*rval__; else return FORWARD_PARSE_ERROR(rval__.error());}
@@ -105,8 +120,9 @@ parse_hopefully<std::uint8_t> parse_uint8(asc::lexer& L) {
     }
 
     // convert to large integer and test
-    auto value = std::stoll(t.spelling);
-    if (value<0 || value>255) {
+    long long value = 0;
+    auto res = std::from_chars(t.spelling.data(), t.spelling.data()+t.spelling.size(), value);
+    if (res.ec!=std::errc() || value<0 || value>255) {
         return unexpected(PARSE_ERROR("value out of range [0, 255]", L.current().loc));
     }
     L.next(); // consume token
@@ -131,7 +147,7 @@ void parse_to_closing_paren(asc::lexer& L, unsigned depth=0) {
                 --depth;
                 break;
             case tok::error:
-                throw asc_parse_error(t.spelling, t.loc.line, t.loc.column);
+                throw asc_parse_error(std::string(t.spelling), t.loc.line, t.loc.column);
             case tok::eof:
                 throw asc_parse_error("unexpected end of file", t.loc.line, t.loc.column);
             default:
@@ -142,7 +158,7 @@ void parse_to_closing_paren(asc::lexer& L, unsigned depth=0) {
 
 bool parse_if_symbol_matches(const char* match, asc::lexer& L) {
     auto& t = L.current();
-    if (t.kind==tok::symbol && !std::strcmp(match, t.spelling.c_str())) {
+    if (t.kind==tok::symbol && t.spelling==match) {
         L.next();
         return true;
     }
@@ -150,7 +166,7 @@ bool parse_if_symbol_matches(const char* match, asc::lexer& L) {
 }
 
 bool symbol_matches(const char* match, const asc::token& t) {
-    return t.kind==tok::symbol && !std::strcmp(match, t.spelling.c_str());
+    return t.kind==tok::symbol && t.spelling==match;
 }
 
 // Parse a color expression, which have been observed in the wild in two forms:
@@ -167,7 +183,7 @@ std::ostream& operator<<(std::ostream& o, const asc_color& c) {
     return o << "(asc-color " << (int)c.r << " " << (int)c.g << " " << (int)c.b << ")";
 }
 
-std::unordered_map<std::string, asc_color> color_map = {
+std::unordered_map<std::string_view, asc_color> color_map = {
     {"Black",     {  0,   0,   0}},
     {"White",     {255, 255, 255}},
     {"Red",       {255,   0,   0}},
@@ -223,11 +239,11 @@ parse_hopefully<asc_color> parse_color(asc::lexer& L) {
             return it->second;
         }
         else {
-            return unexpected(PARSE_ERROR("unknown color value '"+t.spelling+"'", t.loc));
+            return unexpected(PARSE_ERROR("unknown color value '"+std::string(t.spelling)+"'", t.loc));
         }
     }
 
-    return unexpected(PARSE_ERROR("unexpected symbol in Color description \'"+t.spelling+"\'", t.loc));
+    return unexpected(PARSE_ERROR("unexpected symbol in Color description \'"+std::string(t.spelling)+"\'", t.loc));
 }
 
 #define PARSE_COLOR(L, X) {if (auto rval__ = parse_color(L)) X=*rval__; else return FORWARD_PARSE_ERROR(rval__.error());}
@@ -265,7 +281,7 @@ parse_hopefully<zsmear> parse_zsmear(asc::lexer& L) {
         return unexpected(PARSE_ERROR("expected zSmear symbol missing", L.current().loc));
     }
     // consume zSmear symbol
-    auto t = L.next();
+    L.next();
 
     zsmear s;
     PARSE_DOUBLE(L, s.alpha);
@@ -384,7 +400,7 @@ parse_hopefully<branch> parse_branch(asc::lexer& L) {
             finished = true;
         }
         else {
-            return unexpected(PARSE_ERROR("Unexpected input '"+t.spelling+"'", t.loc));
+            return unexpected(PARSE_ERROR("Unexpected input '"+std::string(t.spelling)+"'", t.loc));
         }
     }
 
@@ -453,25 +469,25 @@ parse_hopefully<sub_tree> parse_sub_tree(asc::lexer& L) {
             // Every sub-tree is marked with one of: {CellBody, Axon, Dendrite, Apical}
             // Hence it is possible to assign SWC tags for soma, axon, dend and apic.
             else if (symbol_matches("CellBody", t)) {
-                tree.name = t.spelling;
+                tree.name = std::string(t.spelling);
                 tree.tag = 1;
                 L.next(2); // consume symbol
                 EXPECT_TOKEN(L, tok::rparen);
             }
             else if (symbol_matches("Axon", t)) {
-                tree.name = t.spelling;
+                tree.name = std::string(t.spelling);
                 tree.tag = 2;
                 L.next(2); // consume symbol
                 EXPECT_TOKEN(L, tok::rparen);
             }
             else if (symbol_matches("Dendrite", t)) {
-                tree.name = t.spelling;
+                tree.name = std::string(t.spelling);
                 tree.tag = 3;
                 L.next(2); // consume symbol
                 EXPECT_TOKEN(L, tok::rparen);
             }
             else if (symbol_matches("Apical", t)) {
-                tree.name = t.spelling;
+                tree.name = std::string(t.spelling);
                 tree.tag = 4;
                 L.next(2); // consume symbol
                 EXPECT_TOKEN(L, tok::rparen);
@@ -486,7 +502,7 @@ parse_hopefully<sub_tree> parse_sub_tree(asc::lexer& L) {
                 break;
             }
             else {
-                return unexpected(PARSE_ERROR("Unexpected input'"+t.spelling+"'", t.loc));
+                return unexpected(PARSE_ERROR("Unexpected input'"+std::string(t.spelling)+"'", t.loc));
             }
         }
         else if (t.kind == tok::rparen) {
@@ -497,7 +513,7 @@ parse_hopefully<sub_tree> parse_sub_tree(asc::lexer& L) {
         }
         else {
             // An unexpected token was encountered.
-            return unexpected(PARSE_ERROR("Unexpected input '"+t.spelling+"'", t.loc));
+            return unexpected(PARSE_ERROR("Unexpected input '"+std::string(t.spelling)+"'", t.loc));
         }
     }
 
@@ -523,8 +539,8 @@ parse_hopefully<sub_tree> parse_sub_tree(asc::lexer& L) {
 
 
 // Perform the parsing of the input as a string.
-asc_morphology parse_asc_string(const char* input) {
-    asc::lexer lexer(input);
+asc_morphology parse_asc_string(const char* begin, const char* end) {
+    asc::lexer lexer(begin, end);
 
     std::vector<sub_tree> sub_trees;
 
@@ -536,7 +552,7 @@ asc_morphology parse_asc_string(const char* input) {
 
         // Test for errors
         if (t.kind == asc::tok::error) {
-            throw asc_parse_error(t.spelling, t.loc.line, t.loc.column);
+            throw asc_parse_error(std::string(t.spelling), t.loc.line, t.loc.column);
         }
 
         // Expect that all top-level expressions start with open parenthesis '('
@@ -694,24 +710,19 @@ asc_morphology parse_asc_string(const char* input) {
     return {std::move(morphology), std::move(labels)};
 }
 
-asc_morphology load_asc(std::string filename) {
-    std::ifstream fid(filename);
-
-    if (!fid.good()) {
-        throw arb::file_not_found_error(filename);
-    }
-
-    // load contents of the file into a string.
-    std::string fstr;
-    fid.seekg(0, std::ios::end);
-    fstr.reserve(fid.tellg());
-    fid.seekg(0, std::ios::beg);
+asc_morphology parse_asc_string(const char* input) {
+    return parse_asc_string(input, input+std::strlen(input));
+}
 
-    fstr.assign((std::istreambuf_iterator<char>(fid)),
-                 std::istreambuf_iterator<char>());
+asc_morphology load_asc(std::string filename) {
+    mapped_file file(filename);
+    return parse_asc_string(file.begin(), file.end());
+}
 
-    return parse_asc_string(fstr.c_str());
+std::vector<asc_morphology> load_asc(const std::vector<std::string>& paths, const arb::context& ctx) {
+    std::vector<asc_morphology> loaded(paths.size());
+    arb::run_parallel(ctx, paths.size(), [&](std::size_t i) { loaded[i] = load_asc(paths[i]); });
+    return loaded;
 }
 
 } // namespace arborio
-
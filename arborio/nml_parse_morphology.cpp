@@ -151,131 +151,60 @@ struct propx {
 } // namespace
 
 
-// Internal representations of NeuroML segment and segmentGroup data:
-
-struct neuroml_segment {
-    // Morhpological data:
-    non_negative id;
-    std::string name;
-    optional<arb::mpoint> proximal;
-    arb::mpoint distal;
-    optional<non_negative> parent_id;
-    double along = 1;
-    bool spherical = false;
-
-    // Data for error reporting:
-    unsigned line = 0;
-
-    // Topological depth:
-    std::size_t tdepth = 0;
-};
-
-struct neuroml_segment_group_subtree {
-    // Interval determined by segment ids.
-    // Represents both `<path>` and `<subTree>` elements.
-    optional<non_negative> from, to;
-
-    // Data for error reporting:
-    unsigned line = 0;
-};
-
-struct neuroml_segment_group_info {
-    std::string id;
-    std::vector<non_negative> segments;
-    std::vector<std::string> includes;
-    std::vector<neuroml_segment_group_subtree> subtrees;
-
-    // Data for error reporting:
-    unsigned line = 0;
-};
-
 // Processing of parsed segment/segmentGroup data:
 
-struct neuroml_segment_tree {
-    // Segments in topological order:
-    auto begin() const { return segments_.begin(); }
-    auto end() const { return segments_.end(); }
-
-    // How many segments?
-    std::size_t size() const { return segments_.size(); }
-    bool empty() const { return segments_.empty(); }
-
-    // Segment by id:
-    const neuroml_segment operator[](non_negative id) const {
-        return segments_.at(index_.at(id));
-    }
+neuroml_segment_tree::neuroml_segment_tree(std::vector<neuroml_segment> segs):
+    segments_(std::move(segs))
+{
+    if (segments_.empty()) return;
+    const std::size_t n_seg = segments_.size();
 
-    // Children of segment with id.
-    const std::vector<non_negative>& children(non_negative id) const {
-        static std::vector<non_negative> none{};
-        auto iter = children_.find(id);
-        return iter!=children_.end()? iter->second: none;
+    // Build index, throw on duplicate id.
+    for (std::size_t i = 0; i<n_seg; ++i) {
+        if (!index_.insert({segments_[i].id, i}).second) {
+            throw nml_bad_segment(segments_[i].id, segments_[i].line);
+        }
     }
 
-    // Does segment id exist?
-    bool contains(non_negative id) const {
-        return index_.count(id);
+    // Check parent relationship is sound.
+    for (const auto& s: segments_) {
+        if (s.parent_id && !index_.count(*s.parent_id)) {
+            throw nml_bad_segment(s.id, s.line); // No such parent id.
+        }
     }
 
-    // Construct from vector of segments. Will happily throw if something doesn't add up.
-    explicit neuroml_segment_tree(std::vector<neuroml_segment> segs):
-        segments_(std::move(segs))
-    {
-        if (segments_.empty()) return;
-        const std::size_t n_seg = segments_.size();
-
-        // Build index, throw on duplicate id.
+    // Perform topological sort.
+    auto inset = [this](std::size_t i) {
+        auto& s = segments_[i];
+        return s.parent_id? box{index_.at(*s.parent_id)}: box<std::size_t>{};
+    };
+    if (auto depths = topological_sort(n_seg, inset)) {
+        const auto& d = depths.value();
         for (std::size_t i = 0; i<n_seg; ++i) {
-            if (!index_.insert({segments_[i].id, i}).second) {
-                throw nml_bad_segment(segments_[i].id, segments_[i].line);
-            }
+            segments_[i].tdepth = d[i];
         }
+    }
+    else {
+        const auto& seg = segments_[depths.error().index];
+        throw nml_cyclic_dependency(nl_to_string(seg.id), seg.line);
+    }
+    std::sort(segments_.begin(), segments_.end(), [](auto& a, auto& b) { return a.tdepth<b.tdepth; });
 
-        // Check parent relationship is sound.
-        for (const auto& s: segments_) {
-            if (s.parent_id && !index_.count(*s.parent_id)) {
-                throw nml_bad_segment(s.id, s.line); // No such parent id.
-            }
-        }
-
-        // Perform topological sort.
-        auto inset = [this](std::size_t i) {
-            auto& s = segments_[i];
-            return s.parent_id? box{index_.at(*s.parent_id)}: box<std::size_t>{};
-        };
-        if (auto depths = topological_sort(n_seg, inset)) {
-            const auto& d = depths.value();
-            for (std::size_t i = 0; i<n_seg; ++i) {
-                segments_[i].tdepth = d[i];
-            }
-        }
-        else {
-            const auto& seg = segments_[depths.error().index];
-            throw nml_cyclic_dependency(nl_to_string(seg.id), seg.line);
-        }
-        std::sort(segments_.begin(), segments_.end(), [](auto& a, auto& b) { return a.tdepth<b.tdepth; });
-
-        // Check for multiple roots:
-        if (n_seg>1 && segments_[1].tdepth==0) throw nml_bad_segment(segments_[1].id, segments_[1].line);
+    // Check for multiple roots:
+    if (n_seg>1 && segments_[1].tdepth==0) throw nml_bad_segment(segments_[1].id, segments_[1].line);
 
-        // Update index:
-        for (std::size_t i = 0; i<n_seg; ++i) {
-            index_.at(segments_[i].id) = i;
-        }
+    // Update index:
+    for (std::size_t i = 0; i<n_seg; ++i) {
+        index_.at(segments_[i].id) = i;
+    }
 
-        // Build child tree:
-        for (const auto& seg: segments_) {
-            if (seg.parent_id) {
-                children_[*seg.parent_id].push_back(seg.id);
-            }
+    // Build child tree:
+    for (const auto& seg: segments_) {
+        if (seg.parent_id) {
+            children_[*seg.parent_id].push_back(seg.id);
         }
     }
-
-private:
-    std::vector<neuroml_segment> segments_;
-    std::unordered_map<non_negative, std::size_t> index_;
-    std::unordered_map<non_negative, std::vector<non_negative>> children_;
-};
+}
 
 static std::unordered_map<std::string, std::vector<non_negative>> evaluate_segment_groups(
     std::vector<neuroml_segment_group_info> groups,
@@ -564,6 +493,12 @@ nml_morphology_data nml_parse_morphology_element(xml_xpathctx ctx, xml_node morp
         groups.push_back(std::move(group));
     }
 
+    return nml_build_morphology(std::move(M.id), segtree, std::move(groups));
+}
+
+nml_morphology_data nml_build_morphology(std::string id, const neuroml_segment_tree& segtree, std::vector<neuroml_segment_group_info> groups) {
+    nml_morphology_data M;
+    M.id = std::move(id);
     M.group_segments = evaluate_segment_groups(std::move(groups), segtree);
 
     // Build morphology and label dictionaries:
@@ -575,7 +510,7 @@ nml_morphology_data nml_parse_morphology_element(xml_xpathctx ctx, xml_node morp
     std::unordered_multimap<std::string, non_negative> name_to_ids;
     std::unordered_set<std::string> names;
 
-    for (auto& s: segments) {
+    for (auto& s: segtree) {
         if (!s.name.empty()) {
             name_to_ids.insert({s.name, s.id});
             names.insert(s.name);
@@ -1,10 +1,101 @@
 #pragma once
 
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <arbor/morph/primitives.hpp>
+
 #include <arborio/neuroml.hpp>
 #include "xmlwrap.hpp"
 
 namespace arborio {
 
+using xmlwrap::non_negative;
+
+// Internal representations of NeuroML segment and segmentGroup data, shared
+// by the document and streaming readers:
+
+struct neuroml_segment {
+    // Morhpological data:
+    non_negative id;
+    std::string name;
+    std::optional<arb::mpoint> proximal;
+    arb::mpoint distal;
+    std::optional<non_negative> parent_id;
+    double along = 1;
+    bool spherical = false;
+
+    // Data for error reporting:
+    unsigned line = 0;
+
+    // Topological depth:
+    std::size_t tdepth = 0;
+};
+
+struct neuroml_segment_group_subtree {
+    // Interval determined by segment ids.
+    // Represents both `<path>` and `<subTree>` elements.
+    std::optional<non_negative> from, to;
+
+    // Data for error reporting:
+    unsigned line = 0;
+};
+
+struct neuroml_segment_group_info {
+    std::string id;
+    std::vector<non_negative> segments;
+    std::vector<std::string> includes;
+    std::vector<neuroml_segment_group_subtree> subtrees;
+
+    // Data for error reporting:
+    unsigned line = 0;
+};
+
+// Processing of parsed segment/segmentGroup data:
+
+struct neuroml_segment_tree {
+    // Segments in topological order:
+    auto begin() const { return segments_.begin(); }
+    auto end() const { return segments_.end(); }
+
+    // How many segments?
+    std::size_t size() const { return segments_.size(); }
+    bool empty() const { return segments_.empty(); }
+
+    // Segment by id:
+    const neuroml_segment operator[](non_negative id) const {
+        return segments_.at(index_.at(id));
+    }
+
+    // Children of segment with id.
+    const std::vector<non_negative>& children(non_negative id) const {
+        static std::vector<non_negative> none{};
+        auto iter = children_.find(id);
+        return iter!=children_.end()? iter->second: none;
+    }
+
+    // Does segment id exist?
+    bool contains(non_negative id) const {
+        return index_.count(id);
+    }
+
+    // Construct from vector of segments. Will happily throw if something doesn't add up.
+    explicit neuroml_segment_tree(std::vector<neuroml_segment> segs);
+
+private:
+    std::vector<neuroml_segment> segments_;
+    std::unordered_map<non_negative, std::size_t> index_;
+    std::unordered_map<non_negative, std::vector<non_negative>> children_;
+};
+
+
+// Evaluate the segment groups of a morphology with segments segtree, and
+// build the morphology and its label dictionaries.
+nml_morphology_data nml_build_morphology(std::string id, const neuroml_segment_tree& segtree, std::vector<neuroml_segment_group_info> groups);
+
 nml_morphology_data nml_parse_morphology_element(xmlwrap::xml_xpathctx ctx, xmlwrap::xml_node morph, enum neuroml_options::values);
 
 } // namespace arborio
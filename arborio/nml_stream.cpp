@@ -0,0 +1,388 @@
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <libxml/xmlreader.h>
+
+#include <arbor/arbexcept.hpp>
+
+#include <arborio/neuroml.hpp>
+#include <arborio/xml.hpp>
+
+#include "nml_parse_morphology.hpp"
+#include "xmlwrap.hpp"
+
+using std::optional;
+
+using namespace std::literals;
+using namespace arborio::xmlwrap;
+
+namespace arborio {
+
+namespace {
+constexpr const char* nml_namespace = "http://www.neuroml.org/schema/neuroml2";
+
+struct reader_deleter {
+    void operator()(xmlTextReader* r) const { xmlFreeTextReader(r); }
+};
+
+// Cursor over the nodes of a document, read in order by an xmlTextReader.
+struct nml_reader {
+    std::unique_ptr<xmlTextReader, reader_deleter> reader;
+
+    explicit nml_reader(xmlTextReader* r): reader(r) {
+        if (!r) throw xml_error("unable to read XML document");
+    }
+
+    // Advance to the next node; false at the end of the document.
+    bool next() {
+        int status = xmlTextReaderRead(reader.get());
+        if (status<0) throw xml_error("malformed XML document", line());
+        return status==1;
+    }
+
+    int depth() const { return xmlTextReaderDepth(reader.get()); }
+    unsigned line() const {
+        auto node = xmlTextReaderCurrentNode(reader.get());
+        return node? node->line: xmlTextReaderGetParserLineNumber(reader.get());
+    }
+
+    // Start of a NeuroML element with the given name.
+    bool at(const char* name) const {
+        if (xmlTextReaderNodeType(reader.get())!=XML_READER_TYPE_ELEMENT) return false;
+        auto ns = (const char*)xmlTextReaderConstNamespaceUri(reader.get());
+        auto local = (const char*)xmlTextReaderConstLocalName(reader.get());
+        return ns && !std::strcmp(ns, nml_namespace) && local && !std::strcmp(local, name);
+    }
+
+    // Visit the descendants of the current element, calling f at each node.
+    template <typename F>
+    void children(F&& f) {
+        if (xmlTextReaderIsEmptyElement(reader.get())) return;
+        const int d = depth();
+        while (next()) {
+            if (xmlTextReaderNodeType(reader.get())==XML_READER_TYPE_END_ELEMENT && depth()==d) return;
+            f(depth()-d);
+        }
+    }
+
+    void skip() {
+        children([](int) {});
+    }
+
+    bool has_prop(const char* name) const {
+        return (const char*)xml_string(xmlTextReaderGetAttribute(reader.get(), (const xmlChar*)name));
+    }
+
+    template <typename T>
+    T prop(const char* name, optional<T> default_value = std::nullopt) const {
+        xml_string c(xmlTextReaderGetAttribute(reader.get(), (const xmlChar*)name));
+        if (!(const char*)c) {
+            if (default_value) return default_value.value();
+            throw nml_parse_error("missing required attribute", line());
+        }
+        T v;
+        if (!nl_from_cstr(v, c)) throw nml_parse_error("attribute type error", line());
+        return v;
+    }
+};
+
+arb::mpoint parse_point(nml_reader& r, non_negative seg_id, unsigned seg_line) {
+    double x = r.prop<double>("x");
+    double y = r.prop<double>("y");
+    double z = r.prop<double>("z");
+    double diameter = r.prop<double>("diameter");
+    if (diameter<0) throw nml_bad_segment(seg_id, seg_line);
+    return arb::mpoint{x, y, z, diameter/2};
+}
+
+// Parse a <morphology> element as nml_parse_morphology_element does.
+nml_morphology_data parse_morphology(nml_reader& r, enum neuroml_options::values options) {
+    using namespace neuroml_options;
+
+    std::string id = r.prop<std::string>("id", ""s);
+    std::vector<neuroml_segment> segments;
+    std::vector<neuroml_segment_group_info> groups;
+
+    // Members of each group, with their lines, checked once all segments are known.
+    std::vector<std::vector<std::pair<non_negative, unsigned>>> members;
+
+    r.children([&](int depth) {
+        if (depth!=1) return;
+
+        if (r.at("segment")) {
+            neuroml_segment seg;
+            seg.id = -1;
+            seg.line = r.line();
+            unsigned line = seg.line;
+            bool has_parent = false, has_proximal = false, has_distal = false;
+
+            try {
+                seg.id = r.prop<non_negative>("id");
+                r.children([&](int depth) {
+                    if (depth!=1) return;
+                    if (r.at("parent") && !has_parent) {
+                        line = r.line();
+                        has_parent = true;
+                        seg.parent_id = r.prop<non_negative>("segment");
+                        seg.along = r.prop<double>("fractionAlong", 1.0);
+                    }
+                    else if (r.at("proximal") && !has_proximal) {
+                        line = r.line();
+                        has_proximal = true;
+                        seg.proximal = parse_point(r, seg.id, seg.line);
+                    }
+                    else if (r.at("distal") && !has_distal) {
+                        line = r.line();
+                        has_distal = true;
+                        seg.distal = parse_point(r, seg.id, seg.line);
+                    }
+                });
+            }
+            catch (nml_parse_error& e) {
+                throw nml_bad_segment(seg.id, line);
+            }
+
+            if (!seg.parent_id && !seg.proximal) throw nml_bad_segment(seg.id, seg.line);
+            if (!has_distal) throw nml_bad_segment(seg.id, seg.line);
+            seg.spherical = (options & allow_spherical_root) && !seg.parent_id && seg.proximal && seg.proximal.value()==seg.distal;
+
+            segments.push_back(std::move(seg));
+        }
+        else if (r.at("segmentGroup")) {
+            neuroml_segment_group_info group;
+            std::vector<std::pair<non_negative, unsigned>> group_members;
+            group.line = r.line();
+            unsigned line = group.line;
+
+            try {
+                group.id = r.prop<std::string>("id");
+
+                r.children([&](int depth) {
+                    if (depth!=1) return;
+                    line = r.line();
+                    if (r.at("member")) {
+                        group_members.push_back({r.prop<non_negative>("segment"), line});
+                    }
+                    else if (r.at("include")) {
+                        group.includes.push_back(r.prop<std::string>("segmentGroup"));
+                    }
+                    else if (r.at("path") || r.at("subTree")) {
+                        // `<path>` and `<subTree>` are treated identically.
+                        neuroml_segment_group_subtree sub;
+                        sub.line = line;
+                        r.children([&](int depth) {
+                            if (depth!=1) return;
+                            if (r.at("from") && !sub.from) {
+                                line = r.line();
+                                sub.from = r.prop<non_negative>("segment");
+                            }
+                            else if (r.at("to") && !sub.to) {
+                                line = r.line();
+                                sub.to = r.prop<non_negative>("segment");
+                            }
+                        });
+                        group.subtrees.push_back(sub);
+                    }
+                });
+            }
+            catch (nml_parse_error& e) {
+                throw nml_bad_segment_group(group.id, line);
+            }
+
+            groups.push_back(std::move(group));
+            members.push_back(std::move(group_members));
+        }
+    });
+
+    if (segments.empty()) {
+        nml_morphology_data M;
+        M.id = std::move(id);
+        return M;
+    }
+
+    neuroml_segment_tree segtree(std::move(segments));
+
+    for (std::size_t i = 0; i<groups.size(); ++i) {
+        for (auto [seg_id, line]: members[i]) {
+            if (!segtree.contains(seg_id)) throw nml_bad_segment_group(groups[i].id, line);
+            groups[i].segments.push_back(seg_id);
+        }
+    }
+
+    return nml_build_morphology(std::move(id), segtree, std::move(groups));
+}
+
+// Index of a cell in a population, from a reference "../pop/index/component"
+// or "../pop[index]".
+non_negative parse_cell_reference(const std::string& ref, unsigned line) {
+    std::string index;
+    if (auto open = ref.find('['); open!=std::string::npos) {
+        auto close = ref.find(']', open);
+        if (close!=std::string::npos) index = ref.substr(open+1, close-open-1);
+    }
+    else {
+        auto from = ref.rfind("../", 0)==0? 3: 0;
+        auto first = ref.find('/', from);
+        if (first!=std::string::npos) {
+            index = ref.substr(first+1, ref.find('/', first+1)-first-1);
+        }
+    }
+
+    non_negative i;
+    if (index.empty() || !nl_from_cstr(i, index.c_str())) {
+        throw nml_parse_error("bad cell reference \""+ref+"\"", line);
+    }
+    return i;
+}
+
+// Delay in ms, from a quantity in s, ms or us, or a bare number of ms.
+double parse_delay(std::string q, unsigned line) {
+    double scale = 1;
+    for (auto [unit, s]: {std::pair{"ms", 1.}, std::pair{"us", 1e-3}, std::pair{"s", 1e3}}) {
+        auto n = std::strlen(unit);
+        if (q.size()>=n && !q.compare(q.size()-n, n, unit)) {
+            q.erase(q.size()-n);
+            scale = s;
+            break;
+        }
+    }
+    while (!q.empty() && q.back()==' ') q.pop_back();
+
+    double v;
+    if (!nl_from_cstr(v, q.c_str())) throw nml_parse_error("bad delay", line);
+    return v*scale;
+}
+
+void parse_network(nml_reader& r, const nml_stream_handlers& handlers) {
+    std::string network_id = r.prop<std::string>("id", ""s);
+
+    r.children([&](int depth) {
+        if (depth!=1) return;
+
+        if (r.at("population")) {
+            nml_population pop;
+            pop.network_id = network_id;
+            pop.id = r.prop<std::string>("id");
+            pop.component = r.prop<std::string>("component", ""s);
+            bool has_size = r.has_prop("size");
+            pop.size = r.prop<non_negative>("size", 0ull);
+
+            r.children([&](int depth) {
+                if (!has_size && depth==1 && r.at("instance")) ++pop.size;
+            });
+            if (handlers.population) handlers.population(pop);
+        }
+        else if (r.at("projection")) {
+            if (!handlers.connection) return r.skip();
+
+            nml_projection proj;
+            proj.network_id = network_id;
+            proj.id = r.prop<std::string>("id");
+            proj.presynaptic_population = r.prop<std::string>("presynapticPopulation");
+            proj.postsynaptic_population = r.prop<std::string>("postsynapticPopulation");
+            proj.synapse = r.prop<std::string>("synapse", ""s);
+
+            r.children([&](int depth) {
+                bool weighted = r.at("connectionWD");
+                if (depth!=1 || !(weighted || r.at("connection"))) return;
+
+                unsigned line = r.line();
+                nml_connection c;
+                c.pre_cell = parse_cell_reference(r.prop<std::string>("preCellId"), line);
+                c.post_cell = parse_cell_reference(r.prop<std::string>("postCellId"), line);
+                c.pre_segment = r.prop<non_negative>("preSegmentId", 0ull);
+                c.pre_fraction_along = r.prop<double>("preFractionAlong", 0.5);
+                c.post_segment = r.prop<non_negative>("postSegmentId", 0ull);
+                c.post_fraction_along = r.prop<double>("postFractionAlong", 0.5);
+                if (weighted) {
+                    c.weight = r.prop<double>("weight");
+                    c.delay = parse_delay(r.prop<std::string>("delay"), line);
+                }
+                handlers.connection(proj, c);
+            });
+        }
+    });
+}
+
+void stream(nml_reader r, const nml_stream_handlers& handlers, enum neuroml_options::values options) {
+    // Top-level morphologies, kept for the cells that refer to them, and the
+    // cells that refer to a morphology not yet read.
+    std::unordered_map<std::string, nml_morphology_data> morphologies;
+    std::unordered_map<std::string, std::vector<std::string>> pending;
+
+    auto emit_cell = [&](const std::string& cell_id, nml_morphology_data M) {
+        M.cell_id = cell_id;
+        handlers.morphology(std::move(M));
+    };
+
+    // Find the root element.
+    while (r.next() && xmlTextReaderNodeType(r.reader.get())!=XML_READER_TYPE_ELEMENT) {}
+    if (!r.at("neuroml")) return;
+
+    r.children([&](int depth) {
+        if (depth!=1) return;
+
+        if (r.at("morphology")) {
+            if (!handlers.morphology) return r.skip();
+            nml_morphology_data M = parse_morphology(r, options);
+
+            if (auto i = pending.find(M.id); i!=pending.end()) {
+                for (const auto& cell_id: i->second) emit_cell(cell_id, M);
+                pending.erase(i);
+            }
+            morphologies.insert({M.id, M});
+            handlers.morphology(std::move(M));
+        }
+        else if (r.at("cell")) {
+            if (!handlers.morphology) return r.skip();
+            std::string cell_id = r.prop<std::string>("id");
+            std::string ref = r.prop<std::string>("morphology", ""s);
+
+            optional<nml_morphology_data> inline_morph;
+            r.children([&](int depth) {
+                if (depth==1 && r.at("morphology") && !inline_morph) {
+                    inline_morph = parse_morphology(r, options);
+                }
+            });
+
+            if (inline_morph) {
+                emit_cell(cell_id, std::move(*inline_morph));
+            }
+            else if (!ref.empty()) {
+                if (auto i = morphologies.find(ref); i!=morphologies.end()) {
+                    emit_cell(cell_id, i->second);
+                }
+                else {
+                    pending[ref].push_back(cell_id);
+                }
+            }
+        }
+        else if (r.at("network")) {
+            if (!handlers.population && !handlers.connection) return r.skip();
+            parse_network(r, handlers);
+        }
+    });
+}
+
+constexpr int xml_options = XML_PARSE_NOENT | XML_PARSE_NONET;
+} // namespace
+
+void stream_neuroml(const std::string& nml_document, const nml_stream_handlers& handlers, enum neuroml_options::values options) {
+    xml_error_scope err;
+    stream(nml_reader(xmlReaderForMemory(nml_document.data(), nml_document.size(), "", nullptr, xml_options)), handlers, options);
+}
+
+void stream_neuroml_file(const std::string& path, const nml_stream_handlers& handlers, enum neuroml_options::values options) {
+    if (!std::ifstream(path).good()) throw arb::file_not_found_error(path);
+
+    xml_error_scope err;
+    stream(nml_reader(xmlReaderForFile(path.c_str(), nullptr, xml_options)), handlers, options);
+}
+
+} // namespace arborio
@@ -1,7 +1,11 @@
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <ios>
+#include <locale>
 #include <limits>
 #include <numeric>
+#include <optional>
 #include <iostream>
 #include <set>
 #include <string>
@@ -10,12 +14,15 @@
 #include <unordered_set>
 #include <vector>
 
+#include <arbor/context.hpp>
 #include <arbor/morph/segment_tree.hpp>
 
 #include "arbor/morph/primitives.hpp"
 
 #include <arborio/swcio.hpp>
 
+#include "mapped_file.hpp"
+
 namespace arborio {
 
 // SWC exceptions:
@@ -155,9 +162,165 @@ swc_data parse_swc(std::istream& in) {
     return swc_data(metadata, std::move(records));
 }
 
+// Parse SWC data in memory. Each record line is parsed with the rules of
+// `operator>>` above, but without a stream or locale: fields are separated
+// by optional white space, and trailing text is ignored.
+
+static bool is_blank(char c) {
+    return c==' ' || c=='\t' || c=='\r' || c=='\v' || c=='\f';
+}
+
+static void skip_blank(const char*& p, const char* end) {
+    while (p<end && is_blank(*p)) ++p;
+}
+
+static bool is_digit(char c) {
+    return c>='0' && c<='9';
+}
+
+static bool parse_int(const char*& p, const char* end, int& out) {
+    skip_blank(p, end);
+    const char* q = p;
+    bool neg = false;
+    if (q<end && (*q=='-' || *q=='+')) neg = *q++=='-';
+    if (q==end || !is_digit(*q)) return false;
+
+    std::int64_t v = 0;
+    for (; q<end && is_digit(*q); ++q) {
+        v = 10*v + (*q-'0');
+        if (v>std::int64_t(std::numeric_limits<int>::max())+1) return false;
+    }
+    if (neg) v = -v;
+    if (v<std::numeric_limits<int>::min() || v>std::numeric_limits<int>::max()) return false;
+
+    out = int(v);
+    p = q;
+    return true;
+}
+
+// Values with at most 19 significant digits whose mantissa and power of ten
+// are exact doubles are computed with one correctly rounded multiplication
+// or division; others, which are rare in SWC files, are parsed by a stream
+// in the classic locale.
+static bool parse_double(const char*& p, const char* end, double& out) {
+    static constexpr double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    skip_blank(p, end);
+    const char* q = p;
+    bool neg = false;
+    if (q<end && (*q=='-' || *q=='+')) neg = *q++=='-';
+
+    std::uint64_t mantissa = 0;
+    int n_sig = 0, n_digits = 0, exp10 = 0;
+    auto digit = [&](char c) {
+        ++n_digits;
+        if (!n_sig && c=='0') return false;
+        if (++n_sig<=19) mantissa = 10*mantissa + (c-'0');
+        return true;
+    };
+    for (; q<end && is_digit(*q); ++q) {
+        if (digit(*q) && n_sig>19) ++exp10;
+    }
+    if (q<end && *q=='.') {
+        for (++q; q<end && is_digit(*q); ++q) {
+            if (!digit(*q) || n_sig<=19) --exp10;
+        }
+    }
+    if (!n_digits) return false;
+
+    if (q<end && (*q=='e' || *q=='E')) {
+        const char* e = q+1;
+        bool eneg = false;
+        if (e<end && (*e=='-' || *e=='+')) eneg = *e++=='-';
+        if (e<end && is_digit(*e)) {
+            int x = 0;
+            for (; e<end && is_digit(*e); ++e) {
+                if (x<100000) x = 10*x + (*e-'0');
+            }
+            exp10 += eneg? -x: x;
+            q = e;
+        }
+    }
+
+    if (n_sig<=19 && mantissa<=(std::uint64_t(1)<<53) && exp10>=-22 && exp10<=22) {
+        double v = double(mantissa);
+        v = exp10<0? v/pow10[-exp10]: v*pow10[exp10];
+        out = neg? -v: v;
+    }
+    else {
+        std::istringstream s(std::string(p, q));
+        s.imbue(std::locale::classic());
+        double v;
+        if (!(s >> v)) return false;
+        out = v;
+    }
+    p = q;
+    return true;
+}
+
+static bool parse_record(const char* p, const char* end, swc_record& record) {
+    swc_record r;
+    bool ok = parse_int(p, end, r.id) && parse_int(p, end, r.tag) &&
+              parse_double(p, end, r.x) && parse_double(p, end, r.y) &&
+              parse_double(p, end, r.z) && parse_double(p, end, r.r) &&
+              parse_int(p, end, r.parent_id);
+    if (ok) record = r;
+    return ok;
+}
+
+swc_data parse_swc(const char* begin, const char* end) {
+    std::string metadata;
+    std::vector<swc_record> records;
+
+    auto eol = [end](const char* p) {
+        auto q = static_cast<const char*>(std::memchr(p, '\n', end-p));
+        return q? q: end;
+    };
+
+    const char* p = begin;
+    while (p<end && *p=='#') {
+        const char* e = eol(p);
+        const char* from = p+1;
+        while (from<e && (*from==' ' || *from=='\t')) ++from;
+        metadata.append(from, e);
+        metadata += '\n';
+        p = e<end? e+1: end;
+    }
+
+    // Records end with the file, an empty line or the first line that is not
+    // a record.
+    swc_record r;
+    while (p<end && *p!='\n') {
+        const char* e = eol(p);
+        if (!parse_record(p, e, r)) break;
+        records.push_back(r);
+        p = e<end? e+1: end;
+    }
+
+    return swc_data(metadata, std::move(records));
+}
+
 swc_data parse_swc(const std::string& text) {
-    std::istringstream is(text);
-    return parse_swc(is);
+    return parse_swc(text.data(), text.data()+text.size());
+}
+
+swc_data parse_swc_file(const std::string& path) {
+    mapped_file file(path);
+    return parse_swc(file.begin(), file.end());
+}
+
+std::vector<swc_data> parse_swc_files(const std::vector<std::string>& paths, const arb::context& ctx) {
+    // swc_data has no default state, so the results are collected as
+    // optional values and moved out once all files are parsed.
+    std::vector<std::optional<swc_data>> parsed(paths.size());
+    arb::run_parallel(ctx, paths.size(), [&](std::size_t i) { parsed[i] = parse_swc_file(paths[i]); });
+
+    std::vector<swc_data> result;
+    result.reserve(paths.size());
+    for (auto& d: parsed) result.push_back(std::move(*d));
+    return result;
 }
 
 arb::morphology load_swc_arbor(const swc_data& data) {
@@ -0,0 +1,553 @@
+/*
+ * A suite of end-to-end benchmarks of standard network models, run at a set
+ * of scales and thread/GPU configurations, with results written as json.
+ */
+
+#include <any>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#ifdef __linux__
+extern "C" {
+    #include <sys/resource.h>
+}
+#endif
+
+#include <arborio/label_parse.hpp>
+
+#include <arbor/cable_cell.hpp>
+#include <arbor/context.hpp>
+#include <arbor/event_generator.hpp>
+#include <arbor/lif_cell.hpp>
+#include <arbor/load_balance.hpp>
+#include <arbor/mechcat.hpp>
+#include <arbor/morph/segment_tree.hpp>
+#include <arbor/profile/meter_manager.hpp>
+#include <arbor/profile/profiler.hpp>
+#include <arbor/profile/timer.hpp>
+#include <arbor/recipe.hpp>
+#include <arbor/simulation.hpp>
+#include <arbor/version.hpp>
+
+#include <arborenv/concurrency.hpp>
+#include <arborenv/gpu_env.hpp>
+
+#include <sup/ioutil.hpp>
+#include <sup/json_meter.hpp>
+#include <sup/json_params.hpp>
+
+#ifdef ARB_MPI_ENABLED
+#include <mpi.h>
+#include <arborenv/with_mpi.hpp>
+#endif
+
+using arb::cell_gid_type;
+using arb::cell_kind;
+using arb::cell_size_type;
+using arb::time_type;
+
+using namespace arborio::literals;
+
+// One benchmark of the suite: a model with a number of cells.
+struct run_params {
+    std::string model;
+    unsigned num_cells = 0;
+    // Number of incoming connections of each cell (brunel, detailed).
+    unsigned fan_in = 100;
+    // Number of cells in each gap junction connected chain (gap).
+    unsigned chain_length = 10;
+    // Mechanism catalogue of the cells (detailed): bbp or allen.
+    std::string catalogue = "bbp";
+};
+
+struct suite_params {
+    std::string name = "standard";
+    double duration = 100;
+    double dt = 0.025;
+    // Thread counts to run with; 0 stands for all available threads.
+    std::vector<unsigned> threads = {0};
+    // Whether to run on the CPU and on the GPU, if available.
+    std::vector<bool> gpu = {false, true};
+    std::vector<run_params> runs;
+};
+
+suite_params default_suite();
+suite_params read_suite(const std::string& fname);
+
+// Random sources of `n` connections onto cell gid, drawn from [begin, end)
+// excluding gid itself.
+std::vector<cell_gid_type> random_sources(cell_gid_type gid, cell_gid_type begin, cell_gid_type end, unsigned n) {
+    std::vector<cell_gid_type> sources;
+    bool self = gid>=begin && gid<end;
+    if (end-begin<=cell_gid_type(self)) return sources;
+    std::mt19937 G(gid);
+    std::uniform_int_distribution<cell_gid_type> dist(begin, end-1-self);
+    for (unsigned i = 0; i<n; ++i) {
+        auto s = dist(G);
+        sources.push_back(self && s>=gid? s+1: s);
+    }
+    return sources;
+}
+
+// A mechanism with parameter values.
+arb::mechanism_desc mech(const char* name, std::initializer_list<std::pair<const char*, double>> params) {
+    arb::mechanism_desc m(name);
+    for (auto& [key, value]: params) m.set(key, value);
+    return m;
+}
+
+// A soma with a dendritic tree of `depth` levels of binary branches.
+arb::segment_tree branching_tree(unsigned depth, double length) {
+    arb::segment_tree tree;
+    tree.append(arb::mnpos, {0, 0, 0, 10}, {0, 0, 20, 10}, 1);
+    std::vector<arb::msize_t> tips = {0};
+    double radius = 1.5;
+    for (unsigned level = 0; level<depth; ++level, radius *= 0.7) {
+        std::vector<arb::msize_t> next;
+        for (auto p: tips) {
+            auto& prox = tree.segments()[p].dist;
+            for (double dx: {-1., 1.}) {
+                arb::mpoint d{prox.x+dx*length/2, prox.y, prox.z+length, radius};
+                next.push_back(tree.append(p, {prox.x, prox.y, prox.z, radius}, d, 3));
+            }
+        }
+        tips = std::move(next);
+    }
+    return tree;
+}
+
+// Rings of cells with an hh soma and passive dendrites, with each cell
+// connected to the previous one, and one spike injected into each ring.
+class ring_recipe: public arb::recipe {
+public:
+    explicit ring_recipe(const run_params& p): num_cells_(p.num_cells) {
+        gprop_.default_parameters = arb::neuron_parameter_defaults;
+    }
+
+    cell_size_type num_cells() const override { return num_cells_; }
+    cell_kind get_cell_kind(cell_gid_type) const override { return cell_kind::cable; }
+    std::any get_global_properties(cell_kind) const override { return gprop_; }
+
+    arb::util::unique_any get_cell_description(cell_gid_type gid) const override {
+        arb::decor decor;
+        decor.paint("(tag 1)"_reg, "hh");
+        decor.paint("(tag 3)"_reg, "pas");
+        decor.set_default(arb::axial_resistivity{100});
+        decor.place(arb::mlocation{0, 0}, arb::threshold_detector{10}, "detector");
+        decor.place(arb::mlocation{1, 0.5}, "expsyn", "syn");
+        decor.set_default(arb::cv_policy_max_extent(10));
+        return arb::cable_cell(arb::morphology(branching_tree(2, 100)), {}, decor);
+    }
+
+    std::vector<arb::cell_connection> connections_on(cell_gid_type gid) const override {
+        cell_gid_type src = gid%ring_size? gid-1: std::min(gid+ring_size, num_cells_)-1;
+        return {arb::cell_connection({src, "detector"}, {"syn"}, 0.05, 5)};
+    }
+
+    std::vector<arb::event_generator> event_generators(cell_gid_type gid) const override {
+        if (gid%ring_size) return {};
+        return {arb::explicit_generator({{{"syn"}, 1.0, 0.05}})};
+    }
+
+private:
+    static constexpr cell_size_type ring_size = 100;
+    cell_size_type num_cells_;
+    arb::cable_cell_global_properties gprop_;
+};
+
+// A Brunel network of LIF cells, 80% excitatory and 20% inhibitory, randomly
+// connected and driven by Poisson input.
+class brunel_recipe: public arb::recipe {
+public:
+    explicit brunel_recipe(const run_params& p):
+        num_cells_(p.num_cells), num_exc_(p.num_cells*4/5), fan_in_(p.fan_in) {}
+
+    cell_size_type num_cells() const override { return num_cells_; }
+    cell_kind get_cell_kind(cell_gid_type) const override { return cell_kind::lif; }
+
+    arb::util::unique_any get_cell_description(cell_gid_type) const override {
+        auto cell = arb::lif_cell("src", "tgt");
+        cell.tau_m = 10;
+        cell.V_th = 10;
+        cell.C_m = 20;
+        cell.E_L = 0;
+        cell.V_m = 0;
+        cell.V_reset = 0;
+        cell.t_ref = 2;
+        return cell;
+    }
+
+    std::vector<arb::cell_connection> connections_on(cell_gid_type gid) const override {
+        std::vector<arb::cell_connection> cons;
+        unsigned n_exc = fan_in_*4/5;
+        for (auto s: random_sources(gid, 0, num_exc_, n_exc)) {
+            cons.push_back({{s, "src"}, {"tgt"}, weight_, delay_});
+        }
+        for (auto s: random_sources(gid, num_exc_, num_cells_, fan_in_-n_exc)) {
+            cons.push_back({{s, "src"}, {"tgt"}, -weight_, delay_});
+        }
+        return cons;
+    }
+
+    std::vector<arb::event_generator> event_generators(cell_gid_type gid) const override {
+        std::mt19937_64 G(gid);
+        return {arb::poisson_generator({"tgt"}, weight_, 0, lambda_, G)};
+    }
+
+private:
+    cell_size_type num_cells_;
+    cell_size_type num_exc_;
+    unsigned fan_in_;
+    float weight_ = 1.2;
+    float delay_ = 1;
+    // Rate of the Poisson input of each cell [kHz].
+    double lambda_ = 40;
+};
+
+// Chains of cells coupled by gap junctions between the end of the dendrite of
+// one cell and the soma of the next, with the first cell of each chain
+// stimulated and connected to the last cell of the previous chain.
+class gap_recipe: public arb::recipe {
+public:
+    explicit gap_recipe(const run_params& p): num_cells_(p.num_cells), chain_length_(p.chain_length) {
+        gprop_.default_parameters = arb::neuron_parameter_defaults;
+        gprop_.default_parameters.temperature_K = 308.15;
+    }
+
+    cell_size_type num_cells() const override { return num_cells_; }
+    cell_kind get_cell_kind(cell_gid_type) const override { return cell_kind::cable; }
+    std::any get_global_properties(cell_kind) const override { return gprop_; }
+
+    arb::util::unique_any get_cell_description(cell_gid_type gid) const override {
+        arb::segment_tree tree;
+        double soma_rad = 22.360679775/2.0;
+        tree.append(arb::mnpos, {0, 0, 0, soma_rad}, {0, 0, 2*soma_rad, soma_rad}, 1);
+        tree.append(0, {0, 0, 2*soma_rad, 1.5}, {0, 0, 2*soma_rad+300, 1.5}, 3);
+
+        arb::decor decor;
+        decor.set_default(arb::axial_resistivity{100});
+        decor.set_default(arb::membrane_capacitance{0.018});
+        decor.paint("(all)"_reg, mech("nax", {{"gbar", 0.04}, {"sh", 10}}));
+        decor.paint("(all)"_reg, mech("kdrmt", {{"gbar", 0.0001}}));
+        decor.paint("(all)"_reg, mech("kamt", {{"gbar", 0.004}}));
+        decor.paint("(all)"_reg, mech("pas/e=-65", {{"g", 1.0/12000.0}}));
+        decor.place(arb::mlocation{0, 0}, arb::threshold_detector{10}, "detector");
+        decor.place(arb::mlocation{0, 1}, arb::gap_junction_site{}, "gj_soma");
+        decor.place(arb::mlocation{1, 1}, arb::gap_junction_site{}, "gj_dend");
+        decor.place(arb::mlocation{1, 0.5}, "expsyn", "syn");
+        if (gid%chain_length_==0) {
+            decor.place(arb::mlocation{0, 0.5}, arb::i_clamp::box(0, 5, 0.4), "stim");
+        }
+        return arb::cable_cell(tree, {}, decor);
+    }
+
+    std::vector<arb::cell_connection> connections_on(cell_gid_type gid) const override {
+        if (gid%chain_length_ || gid<chain_length_) return {};
+        return {arb::cell_connection({gid-1, "detector"}, {"syn"}, 0.05, 5)};
+    }
+
+    std::vector<arb::gap_junction_connection> gap_junctions_on(cell_gid_type gid) const override {
+        using policy = arb::lid_selection_policy;
+        std::vector<arb::gap_junction_connection> conns;
+        auto begin = gid-gid%chain_length_;
+        auto end = std::min(begin+chain_length_, num_cells_);
+        if (gid+1<end) {
+            conns.push_back({{gid+1, "gj_soma", policy::assert_univalent}, {"gj_dend", policy::assert_univalent}, 0.015});
+        }
+        if (gid>begin) {
+            conns.push_back({{gid-1, "gj_dend", policy::assert_univalent}, {"gj_soma", policy::assert_univalent}, 0.015});
+        }
+        return conns;
+    }
+
+private:
+    cell_size_type num_cells_;
+    cell_size_type chain_length_;
+    arb::cable_cell_global_properties gprop_;
+};
+
+// Randomly connected cells with a branching morphology and the active
+// channels of the BBP or Allen catalogue, driven by Poisson input.
+class detailed_recipe: public arb::recipe {
+public:
+    explicit detailed_recipe(const run_params& p):
+        num_cells_(p.num_cells), fan_in_(p.fan_in), bbp_(p.catalogue=="bbp")
+    {
+        if (!bbp_ && p.catalogue!="allen") {
+            throw std::runtime_error("unknown catalogue '"+p.catalogue+"': expected bbp or allen");
+        }
+        catalogue_ = arb::global_default_catalogue();
+        catalogue_.import(bbp_? arb::global_bbp_catalogue(): arb::global_allen_catalogue(), "");
+        gprop_.catalogue = &catalogue_;
+        gprop_.default_parameters = arb::neuron_parameter_defaults;
+        gprop_.default_parameters.temperature_K = 307.15;
+    }
+
+    cell_size_type num_cells() const override { return num_cells_; }
+    cell_kind get_cell_kind(cell_gid_type) const override { return cell_kind::cable; }
+    std::any get_global_properties(cell_kind) const override { return gprop_; }
+
+    arb::util::unique_any get_cell_description(cell_gid_type gid) const override {
+        auto tree = branching_tree(4, 80);
+        // An axon from the distal end of the soma.
+        tree.append(0, {0, 0, 0, 0.5}, {0, 0, -200, 0.5}, 2);
+
+        arb::decor decor;
+        decor.set_default(arb::axial_resistivity{100});
+        decor.set_default(arb::membrane_capacitance{0.01});
+        decor.set_default(arb::init_reversal_potential{"na", 50});
+        decor.set_default(arb::init_reversal_potential{"k", -85});
+        decor.paint("(all)"_reg, mech("pas", {{"g", 3e-5}, {"e", -75}}));
+        decor.paint("(tag 3)"_reg, mech("Ih", {{bbp_? "gIhbar": "gbar", 0.0002}}));
+        if (bbp_) {
+            decor.paint("(tag 1)"_reg, mech("NaTs2_t", {{"gNaTs2_tbar", 0.983955}}));
+            decor.paint("(tag 1)"_reg, mech("SKv3_1", {{"gSKv3_1bar", 0.303472}}));
+            decor.paint("(tag 1)"_reg, mech("SK_E2", {{"gSK_E2bar", 0.008407}}));
+            decor.paint("(tag 1)"_reg, mech("Ca_HVA", {{"gCa_HVAbar", 0.000994}}));
+            decor.paint("(tag 1)"_reg, mech("Ca_LVAst", {{"gCa_LVAstbar", 0.000333}}));
+            decor.paint("(tag 1)"_reg, mech("CaDynamics_E2", {{"gamma", 0.000609}, {"decay", 210.485}}));
+            decor.paint("(tag 2)"_reg, mech("NaTa_t", {{"gNaTa_tbar", 3.137968}}));
+            decor.paint("(tag 2)"_reg, mech("K_Tst", {{"gK_Tstbar", 0.089259}}));
+            decor.paint("(tag 2)"_reg, mech("K_Pst", {{"gK_Pstbar", 0.973538}}));
+            decor.paint("(tag 2)"_reg, mech("Nap_Et2", {{"gNap_Et2bar", 0.006827}}));
+        }
+        else {
+            decor.paint("(tag 1)"_reg, mech("NaV", {{"gbar", 0.05}}));
+            decor.paint("(tag 1)"_reg, mech("Kv3_1", {{"gbar", 0.3}}));
+            decor.paint("(tag 1)"_reg, mech("K_T", {{"gbar", 0.02}}));
+            decor.paint("(tag 1)"_reg, mech("Kd", {{"gbar", 0.005}}));
+            decor.paint("(tag 1)"_reg, mech("SK", {{"gbar", 0.003}}));
+            decor.paint("(tag 1)"_reg, mech("Ca_HVA", {{"gbar", 0.0005}}));
+            decor.paint("(tag 1)"_reg, mech("Ca_LVA", {{"gbar", 0.003}}));
+            decor.paint("(tag 1)"_reg, mech("CaDynamics", {{"gamma", 0.002}, {"decay", 300}}));
+            decor.paint("(tag 2)"_reg, mech("NaV", {{"gbar", 0.1}}));
+            decor.paint("(tag 2)"_reg, mech("Kv3_1", {{"gbar", 0.5}}));
+        }
+        decor.place(arb::mlocation{0, 0.5}, arb::threshold_detector{-10}, "detector");
+        decor.place(arb::ls::uniform("(tag 3)"_reg, 0, 9, gid), "expsyn", "syn");
+        decor.set_default(arb::cv_policy_max_extent(10));
+        return arb::cable_cell(arb::morphology(tree), {}, decor);
+    }
+
+    std::vector<arb::cell_connection> connections_on(cell_gid_type gid) const override {
+        using policy = arb::lid_selection_policy;
+        std::vector<arb::cell_connection> cons;
+        for (auto s: random_sources(gid, 0, num_cells_, fan_in_)) {
+            cons.push_back({{s, "detector"}, {"syn", policy::round_robin}, 0.01, 5});
+        }
+        return cons;
+    }
+
+    std::vector<arb::event_generator> event_generators(cell_gid_type gid) const override {
+        std::mt19937_64 G(gid);
+        return {arb::poisson_generator({"syn", arb::lid_selection_policy::round_robin}, 0.02, 0, 0.5, G)};
+    }
+
+private:
+    cell_size_type num_cells_;
+    unsigned fan_in_;
+    bool bbp_;
+    arb::mechanism_catalogue catalogue_;
+    arb::cable_cell_global_properties gprop_;
+};
+
+std::unique_ptr<arb::recipe> make_recipe(const run_params& p) {
+    if (p.model=="ring")     return std::make_unique<ring_recipe>(p);
+    if (p.model=="brunel")   return std::make_unique<brunel_recipe>(p);
+    if (p.model=="gap")      return std::make_unique<gap_recipe>(p);
+    if (p.model=="detailed") return std::make_unique<detailed_recipe>(p);
+    throw std::runtime_error("unknown model '"+p.model+"': expected ring, brunel, gap or detailed");
+}
+
+// Largest resident set size of the process so far, in MB.
+double max_rss_mb() {
+#ifdef __linux__
+    rusage usage;
+    if (!getrusage(RUSAGE_SELF, &usage)) return usage.ru_maxrss/1024.;
+#endif
+    return -1;
+}
+
+// Run one benchmark on a context, and return its results.
+nlohmann::json run_benchmark(const run_params& p, const suite_params& suite, const arb::context& ctx) {
+    using timer = arb::profile::timer<>;
+
+    arb::profile::profiler_clear();
+    arb::profile::meter_manager meters;
+    meters.start(ctx);
+
+    auto t0 = timer::tic();
+    auto recipe = make_recipe(p);
+    auto decomp = arb::partition_load_balance(*recipe, ctx);
+    arb::simulation sim(*recipe, decomp, ctx);
+    double init_time = timer::toc(t0);
+    meters.checkpoint("model-init", ctx);
+
+    t0 = timer::tic();
+    sim.run(suite.duration, suite.dt);
+    double run_time = timer::toc(t0);
+    meters.checkpoint("model-run", ctx);
+
+    double cell_steps = double(recipe->num_cells())*std::ceil(suite.duration/suite.dt);
+    auto spikes = sim.num_spikes();
+
+    nlohmann::json result;
+    result["model"] = p.model;
+    result["cells"] = p.num_cells;
+    if (p.model=="brunel" || p.model=="detailed") result["fan-in"] = p.fan_in;
+    if (p.model=="gap") result["chain-length"] = p.chain_length;
+    if (p.model=="detailed") result["catalogue"] = p.catalogue;
+    result["threads"] = arb::num_threads(ctx);
+    result["ranks"] = arb::num_ranks(ctx);
+    result["gpu"] = arb::has_gpu(ctx);
+    result["init-time"] = init_time;
+    result["run-time"] = run_time;
+    result["cell-steps-per-second"] = cell_steps/run_time;
+    result["spikes"] = spikes;
+    result["spikes-per-second"] = spikes/run_time;
+    result["max-rss-mb"] = max_rss_mb();
+    result["meters"] = sup::to_json(arb::profile::make_meter_report(meters, ctx));
+
+    // Accumulated time in each profiler region, if profiling is enabled.
+    auto profile = arb::profile::profiler_summary();
+    auto& regions = result["regions"] = nlohmann::json::object();
+    for (std::size_t i = 0; i<profile.names.size(); ++i) {
+        regions[profile.names[i]] = {{"calls", profile.counts[i]}, {"time", profile.times[i]}};
+    }
+    return result;
+}
+
+int main(int argc, char** argv) {
+    try {
+        bool root = true;
+#ifdef ARB_MPI_ENABLED
+        arbenv::with_mpi guard(argc, argv, false);
+        root = [] { int r; MPI_Comm_rank(MPI_COMM_WORLD, &r); return r==0; }();
+#endif
+        std::cout << sup::mask_stream(root);
+
+        if (argc>3) {
+            throw std::runtime_error("usage: bench-suite [suite.json [results.json]]");
+        }
+        auto suite = argc>1? read_suite(argv[1]): default_suite();
+        std::string output = argc>2? argv[2]: "bench-suite.json";
+
+        unsigned max_threads = arbenv::get_env_num_threads();
+        if (!max_threads) max_threads = arbenv::thread_concurrency();
+
+        nlohmann::json results;
+        results["suite"] = suite.name;
+        results["version"] = ARB_VERSION;
+        results["source"] = ARB_SOURCE_ID;
+        results["arch"] = ARB_ARCH;
+        results["build-config"] = ARB_BUILD_CONFIG;
+        results["duration"] = suite.duration;
+        results["dt"] = suite.dt;
+        auto& runs = results["runs"] = nlohmann::json::array();
+
+        for (bool gpu: suite.gpu) {
+            for (unsigned threads: suite.threads) {
+                arb::proc_allocation resources;
+                resources.num_threads = threads? std::min(threads, max_threads): max_threads;
+#ifdef ARB_MPI_ENABLED
+                resources.gpu_id = gpu? arbenv::find_private_gpu(MPI_COMM_WORLD): -1;
+                auto ctx = arb::make_context(resources, MPI_COMM_WORLD);
+#else
+                resources.gpu_id = gpu? arbenv::default_gpu(): -1;
+                auto ctx = arb::make_context(resources);
+#endif
+                // Skip GPU configurations if there is no GPU.
+                if (gpu && !arb::has_gpu(ctx)) continue;
+                arb::profile::profiler_initialize(ctx);
+
+                for (auto& p: suite.runs) {
+                    std::cout << p.model << " " << p.num_cells << " cells, "
+                              << arb::num_threads(ctx) << " threads, "
+                              << arb::num_ranks(ctx) << " ranks" << (gpu? ", gpu": "") << ": " << std::flush;
+                    runs.push_back(run_benchmark(p, suite, ctx));
+                    auto& r = runs.back();
+                    std::cout << std::setprecision(3) << r["run-time"].get<double>() << " s, "
+                              << r["cell-steps-per-second"].get<double>() << " cell-steps/s" << std::endl;
+                }
+            }
+        }
+
+        if (root) {
+            std::ofstream fid(output);
+            if (!fid.good()) {
+                throw std::runtime_error("unable to open file "+output+" for output");
+            }
+            fid << std::setw(1) << results << "\n";
+            std::cout << "results written to " << output << "\n";
+        }
+    }
+    catch (std::exception& e) {
+        std::cerr << "exception caught in benchmark suite: " << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
+
+// Each model at a small and a large scale.
+suite_params default_suite() {
+    suite_params suite;
+    suite.runs = {
+        {"ring", 1000},
+        {"ring", 10000},
+        {"brunel", 10000},
+        {"brunel", 100000},
+        {"gap", 1000},
+        {"gap", 10000},
+        {"detailed", 200, 100, 10, "bbp"},
+        {"detailed", 2000, 100, 10, "bbp"},
+        {"detailed", 200, 100, 10, "allen"},
+        {"detailed", 2000, 100, 10, "allen"},
+    };
+    return suite;
+}
+
+suite_params read_suite(const std::string& fname) {
+    using sup::param_from_json;
+
+    std::ifstream f(fname);
+    if (!f.good()) {
+        throw std::runtime_error("Unable to open input parameter file: "+fname);
+    }
+    nlohmann::json json;
+    f >> json;
+
+    suite_params suite;
+    param_from_json(suite.name, "name", json);
+    param_from_json(suite.duration, "duration", json);
+    param_from_json(suite.dt, "dt", json);
+    param_from_json(suite.threads, "threads", json);
+    param_from_json(suite.gpu, "gpu", json);
+
+    nlohmann::json runs;
+    param_from_json(runs, "runs", json);
+    for (auto& r: runs) {
+        run_params p;
+        param_from_json(p.model, "model", r);
+        param_from_json(p.num_cells, "cells", r);
+        param_from_json(p.fan_in, "fan-in", r);
+        param_from_json(p.chain_length, "chain-length", r);
+        param_from_json(p.catalogue, "catalogue", r);
+        for (auto it=r.begin(); it!=r.end(); ++it) {
+            std::cout << "  Warning: unused run parameter: \"" << it.key() << "\"\n";
+        }
+        suite.runs.push_back(p);
+    }
+
+    for (auto it=json.begin(); it!=json.end(); ++it) {
+        std::cout << "  Warning: unused input parameter: \"" << it.key() << "\"\n";
+    }
+    return suite;
+}
@@ -36,6 +36,7 @@ struct bench_params {
         double spike_freq_hz = 10;   // Frequency in hz that cell will generate (poisson) spikes.
         double realtime_ratio = 0.1; // Integration speed relative to real time, e.g. 10 implies
                                      // that a cell is integrated 10 times slower than real time.
+        arb::benchmark_workload workload; // Synthetic work at each time step and event.
     };
     struct network_params {
         unsigned fan_in = 5000;      // Number of incoming connections on each cell.
@@ -95,7 +96,7 @@ public:
         // different MPI ranks and threads.
         auto sched = arb::poisson_schedule(1e-3*params_.cell.spike_freq_hz, rng);
 
-        return arb::benchmark_cell("src", "tgt", sched, params_.cell.realtime_ratio);
+        return arb::benchmark_cell("src", "tgt", sched, params_.cell.realtime_ratio, params_.cell.workload);
     }
 
     arb::cell_kind get_cell_kind(arb::cell_gid_type gid) const override {
@@ -212,7 +213,10 @@ std::ostream& operator<<(std::ostream& o, const bench_params& p) {
       << "  fan in:        " << p.network.fan_in << " connections/cell\n"
       << "  min delay:     " << p.network.min_delay << " ms\n"
       << "  spike freq:    " << p.cell.spike_freq_hz << " Hz\n"
-      << "  cell overhead: " << p.cell.realtime_ratio << " ms to advance 1 ms\n";
+      << "  cell overhead: " << p.cell.realtime_ratio << " ms to advance 1 ms\n"
+      << "  cell state:    " << p.cell.workload.state_bytes << " bytes, "
+                             << p.cell.workload.flops << " flops/value/step, "
+                             << p.cell.workload.event_bytes << " bytes/event\n";
     o << "expected:\n"
       << "  cell advance: " << p.expected_advance_time() << " s\n"
       << "  spikes:       " << p.expected_spikes() << "\n"
@@ -252,6 +256,9 @@ bench_params read_options(int argc, char** argv) {
     param_from_json(params.network.fan_in, "fan-in", json);
     param_from_json(params.cell.realtime_ratio, "realtime-ratio", json);
     param_from_json(params.cell.spike_freq_hz, "spike-frequency", json);
+    param_from_json(params.cell.workload.state_bytes, "state-bytes", json);
+    param_from_json(params.cell.workload.flops, "flops", json);
+    param_from_json(params.cell.workload.event_bytes, "event-bytes", json);
 
     for (auto it=json.begin(); it!=json.end(); ++it) {
         std::cout << "  Warning: unused input parameter: \"" << it.key() << "\"\n";
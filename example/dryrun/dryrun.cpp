@@ -46,10 +46,14 @@ struct run_params {
     unsigned num_ranks = 1;
     double min_delay = 10;
     double duration = 100;
+    bool scaling_report = false;
+    double spike_rate = 10;
+    std::string spike_file;
     cell_parameters cell;
 };
 
 void write_trace_json(const arb::trace_data<double>& trace);
+std::vector<arb::spike> read_spikes(const std::string& path);
 run_params read_options(int argc, char** argv);
 
 using arb::cell_gid_type;
@@ -182,6 +186,23 @@ int main(int argc, char** argv) {
         // Construct the model.
         arb::simulation sim(recipe, decomp, ctx);
 
+        // Estimate the communication costs from the recorded or modelled
+        // spikes instead of running the model.
+        if (params.scaling_report) {
+            arb::spike_traffic traffic;
+            traffic.rate = params.spike_rate;
+            if (!params.spike_file.empty()) {
+                traffic.spikes = read_spikes(params.spike_file);
+            }
+            meters.checkpoint("model-init", ctx);
+            auto estimate = sim.estimate_scaling(traffic, params.duration);
+            meters.checkpoint("model-estimate", ctx);
+
+            std::cout << "\n" << estimate << "\n";
+            std::cout << arb::profile::make_meter_report(meters, ctx);
+            return 0;
+        }
+
         // The id of the only probe on the cell: the cell_member type points to (cell 0, probe 0)
         auto probe_id = cell_member_type{0, 0};
         // The schedule for sampling is 10 samples every 1 ms.
@@ -265,6 +286,22 @@ void write_trace_json(const arb::trace_data<double>& trace) {
     file << std::setw(1) << json << "\n";
 }
 
+// Read spikes in the format of spikes.gdf: one gid and time per line.
+std::vector<arb::spike> read_spikes(const std::string& path) {
+    std::ifstream fid(path);
+    if (!fid.good()) {
+        throw std::runtime_error("Unable to open spike file: "+path);
+    }
+
+    std::vector<arb::spike> spikes;
+    cell_gid_type gid;
+    double time;
+    while (fid >> gid >> time) {
+        spikes.push_back({{gid, 0}, time});
+    }
+    return spikes;
+}
+
 run_params read_options(int argc, char** argv) {
     using sup::param_from_json;
 
@@ -294,6 +331,9 @@ run_params read_options(int argc, char** argv) {
     param_from_json(params.num_ranks, "num-ranks", json);
     param_from_json(params.duration, "duration", json);
     param_from_json(params.min_delay, "min-delay", json);
+    param_from_json(params.scaling_report, "scaling-report", json);
+    param_from_json(params.spike_rate, "spike-rate", json);
+    param_from_json(params.spike_file, "spike-file", json);
     params.cell = parse_cell_parameters(json);
 
     if (!json.empty()) {
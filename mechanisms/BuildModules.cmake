@@ -58,7 +58,7 @@ function(build_modules)
 endfunction()
 
 function("make_catalogue")
-  cmake_parse_arguments(MK_CAT "" "NAME;SOURCES;OUTPUT;PREFIX;STANDALONE;VERBOSE" "CXX_FLAGS_TARGET;MECHS" ${ARGN})
+  cmake_parse_arguments(MK_CAT "" "NAME;SOURCES;OUTPUT;PREFIX;STANDALONE;VERBOSE" "CXX_FLAGS_TARGET;MODCC_FLAGS;MECHS;BUNDLES" ${ARGN})
   set(MK_CAT_OUT_DIR "${CMAKE_CURRENT_BINARY_DIR}/generated/${MK_CAT_NAME}")
 
   # Need to set ARB_WITH_EXTERNAL_MODCC *and* modcc
@@ -70,10 +70,12 @@ function("make_catalogue")
   if(MK_CAT_VERBOSE)
     message("Catalogue name:       ${MK_CAT_NAME}")
     message("Catalogue mechanisms: ${MK_CAT_MECHS}")
+    message("Catalogue bundles:    ${MK_CAT_BUNDLES}")
     message("Catalogue sources:    ${MK_CAT_SOURCES}")
     message("Catalogue output:     ${MK_CAT_OUT_DIR}")
     message("Build as standalone:  ${MK_CAT_STANDALONE}")
     message("Arbor cxx flags:      ${MK_CAT_CXX_FLAGS_TARGET}")
+    message("Extra modcc flags:    ${MK_CAT_MODCC_FLAGS}")
     message("Arbor cxx compiler:   ${ARB_CXX}")
     message("Script prefix:        ${MK_CAT_PREFIX}")
     message("Current cxx compiler: ${CMAKE_CXX_COMPILER}")
@@ -90,15 +92,59 @@ function("make_catalogue")
     SOURCE_DIR "${MK_CAT_SOURCES}"
     DEST_DIR "${MK_CAT_OUT_DIR}"
     ${external_modcc} # NB: expands to 'MODCC <binary>' to add an optional argument
-    MODCC_FLAGS -t cpu -t gpu ${ARB_MODCC_FLAGS} -N arb::${MK_CAT_NAME}_catalogue
+    MODCC_FLAGS -t cpu -t gpu ${ARB_MODCC_FLAGS} ${MK_CAT_MODCC_FLAGS} -N arb::${MK_CAT_NAME}_catalogue
     GENERATES .hpp _cpu.cpp _gpu.cpp _gpu.cu
     TARGET build_catalogue_${MK_CAT_NAME}_mods)
 
+  # Fused current kernels over co-located mechanisms. Each entry of BUNDLES is
+  # of the form NAME:MECH,MECH,... Bundles are scalar code, so they are not
+  # built for vectorized catalogues.
+  set(bundle_names)
+  set(bundle_sources)
+  if(NOT "--simd" IN_LIST ARB_MODCC_FLAGS)
+    foreach(bundle ${MK_CAT_BUNDLES})
+      string(REPLACE ":" ";" bundle_spec "${bundle}")
+      list(GET bundle_spec 0 bundle_name)
+      list(GET bundle_spec 1 bundle_mechs)
+      string(REPLACE "," ";" bundle_mechs "${bundle_mechs}")
+
+      set(bundle_mods)
+      foreach(mech ${bundle_mechs})
+        list(APPEND bundle_mods "${MK_CAT_SOURCES}/${mech}.mod")
+      endforeach()
+
+      set(depends ${bundle_mods})
+      if(ARB_WITH_EXTERNAL_MODCC)
+        set(modcc_bin ${modcc})
+      else()
+        list(APPEND depends modcc)
+        set(modcc_bin $<TARGET_FILE:modcc>)
+      endif()
+
+      set(out "${MK_CAT_OUT_DIR}/${bundle_name}_bundle")
+      add_custom_command(
+        OUTPUT ${out}.hpp ${out}_cpu.cpp
+        DEPENDS ${depends}
+        WORKING_DIRECTORY "${CMAKE_CURRENT_SOURCE_DIR}"
+        COMMAND ${modcc_bin} -t cpu ${ARB_MODCC_FLAGS} ${MK_CAT_MODCC_FLAGS} -N arb::${MK_CAT_NAME}_catalogue -b ${bundle_name} -o ${out} ${bundle_mods}
+        COMMENT "modcc generating bundle: ${out}_cpu.cpp")
+      set_source_files_properties(${out}.hpp ${out}_cpu.cpp PROPERTIES GENERATED TRUE)
+
+      list(APPEND bundle_names ${bundle_name})
+      list(APPEND bundle_sources ${out}_cpu.cpp)
+    endforeach()
+  endif()
+  add_custom_target(build_catalogue_${MK_CAT_NAME}_bundles DEPENDS ${bundle_sources})
+  add_dependencies(build_catalogue_${MK_CAT_NAME}_mods build_catalogue_${MK_CAT_NAME}_bundles)
+
   set(catalogue_${MK_CAT_NAME}_source ${CMAKE_CURRENT_BINARY_DIR}/${MK_CAT_NAME}_catalogue.cpp)
   set(catalogue_${MK_CAT_NAME}_options -A arbor -I ${MK_CAT_OUT_DIR} -o ${catalogue_${MK_CAT_NAME}_source} -B multicore -C ${MK_CAT_NAME} -N arb::${MK_CAT_NAME}_catalogue)
   if(ARB_WITH_GPU)
     list(APPEND catalogue_${MK_CAT_NAME}_options -B gpu)
   endif()
+  foreach(bundle_name ${bundle_names})
+    list(APPEND catalogue_${MK_CAT_NAME}_options -b ${bundle_name})
+  endforeach()
 
   add_custom_command(
     OUTPUT  ${catalogue_${MK_CAT_NAME}_source}
@@ -116,6 +162,7 @@ function("make_catalogue")
       list(APPEND catalogue_${MK_CAT_NAME}_source ${MK_CAT_OUT_DIR}/${mech}_gpu.cpp ${MK_CAT_OUT_DIR}/${mech}_gpu.cu)
     endif()
   endforeach()
+  list(APPEND catalogue_${MK_CAT_NAME}_source ${bundle_sources})
   set(${MK_CAT_OUTPUT} ${catalogue_${MK_CAT_NAME}_source} PARENT_SCOPE)
 
   if(${MK_CAT_STANDALONE})
@@ -47,6 +47,9 @@ std::ostream& operator<<(std::ostream& os, NeuronBlock const& N) {
     os << "  ranges     : " << N.ranges  << std::endl;
     os << "  globals    : " << N.globals << std::endl;
     os << "  ions       : " << N.ions    << std::endl;
+    if (N.has_quiescent_state()) {
+        os << "  quiescent  : " << N.quiescent_state.spelling << " < " << N.quiescent_threshold << std::endl;
+    }
 
     return os;
 }
@@ -77,3 +80,10 @@ std::ostream& operator<<(std::ostream& os, AssignedBlock const& A) {
 
     return os;
 }
+
+std::ostream& operator<<(std::ostream& os, WhiteNoiseBlock const& W) {
+    os << blue("WhiteNoiseBlock") << std::endl;
+    os << "  parameters : "  << W.parameters << std::endl;
+
+    return os;
+}
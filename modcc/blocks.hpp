@@ -114,6 +114,12 @@ struct NeuronBlock {
     bool has_nonspecific_current() const {
         return nonspecific_current.spelling.size() > 0;
     }
+    // QUIESCENT x < threshold: an instance is quiescent while |x| < threshold.
+    Token quiescent_state;
+    std::string quiescent_threshold;
+    bool has_quiescent_state() const {
+        return quiescent_state.spelling.size() > 0;
+    }
 };
 
 // information stored in a NEURON {} block in mod file
@@ -157,6 +163,19 @@ struct AssignedBlock {
     }
 };
 
+// Variables of a WHITE_NOISE block: each takes an independent standard
+// normal value per instance and time step.
+struct WhiteNoiseBlock {
+    std::vector<Id> parameters;
+
+    auto begin() -> decltype(parameters.begin()) {
+        return parameters.begin();
+    }
+    auto end() -> decltype(parameters.end()) {
+        return parameters.end();
+    }
+};
+
 ////////////////////////////////////////////////
 // helpers for pretty printing block information
 ////////////////////////////////////////////////
@@ -178,3 +197,5 @@ std::ostream& operator<<(std::ostream& os, UnitsBlock const& U);
 std::ostream& operator<<(std::ostream& os, ParameterBlock const& P);
 
 std::ostream& operator<<(std::ostream& os, AssignedBlock const& A);
+
+std::ostream& operator<<(std::ostream& os, WhiteNoiseBlock const& W);
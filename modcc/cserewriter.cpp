@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "astmanip.hpp"
+#include "cserewriter.hpp"
+#include "expression.hpp"
+
+namespace {
+
+// Apply `f` to each operand of a unary or binary expression, replacing the
+// operand with the result if it is not null.
+template <typename F>
+void rewrite_operands(Expression* e, F&& f) {
+    if (auto u = e->is_unary()) {
+        if (auto r = f(u->expression())) u->replace_expression(std::move(r));
+    }
+    else if (auto b = e->is_binary()) {
+        if (auto r = f(b->lhs())) b->replace_lhs(std::move(r));
+        if (auto r = f(b->rhs())) b->replace_rhs(std::move(r));
+    }
+}
+
+expression_ptr product(Expression* x, long long n) {
+    auto loc = x->location();
+    expression_ptr p = x->clone();
+    for (long long i = 1; i<n; ++i) {
+        p = make_expression<MulBinaryExpression>(loc, std::move(p), x->clone());
+    }
+    return p;
+}
+
+expression_ptr expand_powers(Expression* e) {
+    rewrite_operands(e, expand_powers);
+
+    auto b = e->is_binary();
+    if (!b || b->op()!=tok::pow || !b->rhs()->is_number()) return nullptr;
+
+    double y = b->rhs()->is_number()->value();
+    if (y!=std::round(y) || y==0 || std::abs(y)>4) return nullptr;
+
+    auto n = (long long)std::abs(y);
+    auto x = b->lhs();
+    auto loc = b->location();
+    // Pair up the factors of a fourth power so that the square can be shared.
+    expression_ptr p = n==4?
+        make_expression<MulBinaryExpression>(loc, product(x, 2), product(x, 2)):
+        product(x, n);
+    if (y<0) {
+        return make_expression<DivBinaryExpression>(loc, make_expression<NumberExpression>(loc, 1.), std::move(p));
+    }
+    return p;
+}
+
+void expand_powers_in(Expression* stmt) {
+    if (auto block = stmt->is_block()) {
+        for (auto& s: block->statements()) expand_powers_in(s.get());
+    }
+    else if (auto cond = stmt->is_if()) {
+        expand_powers_in(cond->true_branch());
+        if (cond->false_branch()) expand_powers_in(cond->false_branch());
+    }
+    else if (auto assign = stmt->is_assignment()) {
+        if (auto r = expand_powers(assign->rhs())) assign->replace_rhs(std::move(r));
+    }
+}
+
+using count_map = std::unordered_map<std::string, int>;
+
+// Count assignments to each name in a statement, including nested blocks.
+void count_assignments(Expression* stmt, count_map& counts) {
+    if (auto block = stmt->is_block()) {
+        for (auto& s: block->statements()) count_assignments(s.get(), counts);
+    }
+    else if (auto cond = stmt->is_if()) {
+        count_assignments(cond->true_branch(), counts);
+        if (cond->false_branch()) count_assignments(cond->false_branch(), counts);
+    }
+    else if (auto assign = stmt->is_assignment()) {
+        if (auto id = assign->lhs()->is_identifier()) ++counts[id->spelling()];
+    }
+}
+
+// Count uses of each name in an expression or statement.
+void count_uses(Expression* e, count_map& counts) {
+    if (auto block = e->is_block()) {
+        for (auto& s: block->statements()) count_uses(s.get(), counts);
+    }
+    else if (auto cond = e->is_if()) {
+        count_uses(cond->condition(), counts);
+        count_uses(cond->true_branch(), counts);
+        if (cond->false_branch()) count_uses(cond->false_branch(), counts);
+    }
+    else if (auto assign = e->is_assignment()) {
+        count_uses(assign->rhs(), counts);
+    }
+    else if (auto id = e->is_identifier()) {
+        ++counts[id->spelling()];
+    }
+    else if (auto u = e->is_unary()) {
+        count_uses(u->expression(), counts);
+    }
+    else if (auto b = e->is_binary()) {
+        count_uses(b->lhs(), counts);
+        count_uses(b->rhs(), counts);
+    }
+}
+
+expression_ptr substitute(Expression* e, const std::string& name, Expression* value) {
+    if (auto id = e->is_identifier()) {
+        return id->spelling()==name? value->clone(): nullptr;
+    }
+    rewrite_operands(e, [&](Expression* x) { return substitute(x, name, value); });
+    return nullptr;
+}
+
+struct value_info {
+    std::string key;        // Empty if the value may not be shared.
+    bool invariant = false; // Depends only on numbers and global variables.
+};
+
+class CommonSubexpressionRewriter {
+public:
+    CommonSubexpressionRewriter(BlockExpression* block): scope_(block->scope()) {
+        for (auto& s: block->statements()) count_assignments(s.get(), assigned_);
+    }
+
+    // Identifiers in `block` are resolved in the scope of the block given on
+    // construction, so `block` can be a copy.
+    expression_ptr rewrite(BlockExpression* block) {
+        // Count occurrences of each value, then share those seen more than once.
+        for (auto& s: block->statements()) step(s.get(), true);
+
+        versions_.clear();
+        epoch_ = 0;
+        expr_list_type body;
+        for (auto& s: block->statements()) {
+            if (auto assign = s->is_assignment()) {
+                if (auto r = share(assign->rhs())) assign->replace_rhs(std::move(r));
+            }
+            for (auto& d: defs_) body.push_back(std::move(d));
+            defs_.clear();
+            body.push_back(std::move(s));
+            step(body.back().get(), false);
+        }
+
+        // Undo sharing of values that are only used once, either because all
+        // other occurrences were parts of a larger shared value, or because an
+        // invariant value is only used to compute another one.
+        count_map prologue_uses, uses;
+        for (auto& d: prologue_) count_uses(d.get(), prologue_uses);
+        for (auto& s: body) count_uses(s.get(), uses);
+        for (auto it = temps_.rbegin(); it!=temps_.rend(); ++it) {
+            auto name = it->id->is_identifier()->spelling();
+            int n = prologue_uses[name] + uses[name];
+            if (n!=1 || (it->invariant && prologue_uses[name]!=1)) continue;
+
+            auto& list = it->invariant? prologue_: body;
+            auto def = std::find_if(list.begin(), list.end(), [&](auto& s) { return s.get()==it->def; });
+            auto value = it->def->is_assignment()->rhs();
+            for (auto* stmts: {&prologue_, &body}) {
+                for (auto& s: *stmts) {
+                    if (s.get()==it->def) continue;
+                    if (auto assign = s->is_assignment()) {
+                        if (auto r = substitute(assign->rhs(), name, value)) assign->replace_rhs(std::move(r));
+                    }
+                }
+            }
+            list.erase(def);
+            decls_.erase(std::find_if(decls_.begin(), decls_.end(), [&](auto& d) { return d.get()==it->decl; }));
+        }
+
+        expr_list_type stmts;
+        for (auto& d: decls_) stmts.push_back(std::move(d));
+        for (auto& d: prologue_) stmts.push_back(std::move(d));
+        for (auto& s: body) stmts.push_back(std::move(s));
+        return make_expression<BlockExpression>(block->location(), std::move(stmts), false);
+    }
+
+private:
+    struct temp {
+        Expression* decl;
+        Expression* def;
+        expression_ptr id;
+        bool invariant;
+    };
+
+    scope_ptr scope_;
+    count_map assigned_;
+    count_map occurrences_;
+    std::unordered_map<std::string, int> versions_;
+    int epoch_ = 0;
+
+    std::vector<temp> temps_;
+    std::unordered_map<std::string, std::size_t> temp_index_;
+    expr_list_type decls_, prologue_, defs_;
+
+    value_info analyse(Expression* e) {
+        value_info info;
+        if (auto n = e->is_number()) {
+            std::ostringstream o;
+            o << std::hexfloat << n->value();
+            info.key = o.str();
+            info.invariant = true;
+        }
+        else if (auto id = e->is_identifier()) {
+            auto& name = id->spelling();
+            auto sym = scope_->find(name);
+            if (!sym) return info;
+            auto var = sym->is_variable();
+            if (var && var->is_scalar() && !assigned_.count(name)) {
+                info.key = "g:" + name;
+                info.invariant = true;
+            }
+            else {
+                info.key = name + "@" + std::to_string(versions_[name]) + ":" + std::to_string(epoch_);
+            }
+        }
+        else if (auto u = e->is_unary()) {
+            auto a = analyse(u->expression());
+            if (a.key.empty()) return info;
+            info.key = "u" + std::to_string((int)u->op()) + "(" + a.key + ")";
+            info.invariant = a.invariant;
+        }
+        else if (auto b = e->is_binary()) {
+            if (b->is_assignment()) return info;
+            auto l = analyse(b->lhs());
+            auto r = analyse(b->rhs());
+            if (l.key.empty() || r.key.empty()) return info;
+            bool commutes = b->op()==tok::plus || b->op()==tok::times || b->op()==tok::min || b->op()==tok::max;
+            if (commutes && r.key<l.key) std::swap(l.key, r.key);
+            info.key = "b" + std::to_string((int)b->op()) + "(" + l.key + "," + r.key + ")";
+            info.invariant = l.invariant && r.invariant;
+        }
+        return info;
+    }
+
+    // Values worth a local: compound expressions other than negated leaves.
+    static bool is_candidate(Expression* e) {
+        if (auto u = e->is_unary()) {
+            auto x = u->expression();
+            return u->op()!=tok::minus || !(x->is_identifier() || x->is_number());
+        }
+        return e->is_binary() && !e->is_assignment();
+    }
+
+    void count(Expression* e) {
+        if (is_candidate(e)) {
+            auto info = analyse(e);
+            if (!info.key.empty()) ++occurrences_[info.key];
+        }
+        rewrite_operands(e, [this](Expression* x) { count(x); return expression_ptr{}; });
+    }
+
+    expression_ptr share(Expression* e) {
+        if (is_candidate(e)) {
+            auto info = analyse(e);
+            if (!info.key.empty() && (info.invariant || occurrences_[info.key]>1)) {
+                auto it = temp_index_.find(info.key);
+                if (it!=temp_index_.end()) return temps_[it->second].id->clone();
+
+                rewrite_operands(e, [this](Expression* x) { return share(x); });
+                auto local = make_unique_local_decl(scope_, e->location(), "cse");
+                auto def = make_expression<AssignmentExpression>(e->location(), local.id->clone(), e->clone());
+
+                temp_index_[info.key] = temps_.size();
+                temps_.push_back({local.local_decl.get(), def.get(), local.id->clone(), info.invariant});
+                decls_.push_back(std::move(local.local_decl));
+                (info.invariant? prologue_: defs_).push_back(std::move(def));
+                return std::move(local.id);
+            }
+        }
+        rewrite_operands(e, [this](Expression* x) { return share(x); });
+        return nullptr;
+    }
+
+    // Account for a top-level statement: count the values it computes on the
+    // first pass, and update the versions of the variables it assigns.
+    void step(Expression* s, bool counting) {
+        if (s->is_local_declaration()) return;
+        if (auto assign = s->is_assignment()) {
+            if (counting) count(assign->rhs());
+            if (auto id = assign->lhs()->is_identifier()) ++versions_[id->spelling()];
+            return;
+        }
+        if (s->is_if()) {
+            count_map assigned;
+            count_assignments(s, assigned);
+            for (auto& entry: assigned) ++versions_[entry.first];
+            return;
+        }
+        // Anything else may have side effects: share nothing across it.
+        ++epoch_;
+    }
+};
+
+} // namespace
+
+expression_ptr expand_integer_powers(BlockExpression* block) {
+    auto result = block->clone();
+    expand_powers_in(result.get());
+    return result;
+}
+
+expression_ptr eliminate_common_subexpressions(BlockExpression* block) {
+    auto copy = block->clone();
+    return CommonSubexpressionRewriter(block).rewrite(copy->is_block());
+}
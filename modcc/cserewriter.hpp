@@ -0,0 +1,20 @@
+#pragma once
+
+// Common subexpression elimination and strength reduction for API method
+// bodies, once all function and procedure calls have been inlined.
+
+#include "expression.hpp"
+
+// Rewrite powers with integral exponents of magnitude at most four as
+// products, e.g. `x^3` as `x*x*x` and `x^-2` as `1/(x*x)`.
+expression_ptr expand_integer_powers(BlockExpression* block);
+
+// Rewrite a block so that subexpressions of its top-level assignments are
+// evaluated once:
+//   - a subexpression that is computed more than once with the same operand
+//     values is assigned to a new local `cseN_` before its first use;
+//   - a subexpression that depends only on numbers and global variables is
+//     assigned to a new local at the front of the block, from where printers
+//     can hoist it out of the loop over instances.
+// Statements nested in IF blocks are left unchanged.
+expression_ptr eliminate_common_subexpressions(BlockExpression* block);
@@ -101,6 +101,9 @@ std::string to_string(symbolKind k);
 enum class solverMethod {
     cnexp, // for diagonal linear ODE systems.
     sparse, // for non-diagonal linear ODE systems.
+    sdirk2, // second order implicit method for stiff ODE systems.
+    expm, // matrix exponential for linear ODE systems.
+    stochastic, // Euler-Maruyama for systems driven by WHITE_NOISE.
     none
 };
 
@@ -113,6 +116,9 @@ static std::string to_string(solverMethod m) {
     switch(m) {
         case solverMethod::cnexp:  return std::string("cnexp");
         case solverMethod::sparse: return std::string("sparse");
+        case solverMethod::sdirk2: return std::string("sdirk2");
+        case solverMethod::expm:   return std::string("expm");
+        case solverMethod::stochastic: return std::string("stochastic");
         case solverMethod::none:   return std::string("none");
     }
     return std::string("<error : undefined solverMethod>");
@@ -473,6 +479,9 @@ public:
     void state(bool s) {
         is_state_ = s;
     }
+    void white_noise(bool w) {
+        is_white_noise_ = w;
+    }
     void shadows(Symbol* s) {
         shadows_ = s;
     }
@@ -496,6 +505,7 @@ public:
 
     bool is_ion()       const {return !ion_channel_.empty();}
     bool is_state()     const {return is_state_;}
+    bool is_white_noise() const {return is_white_noise_;}
     bool is_range()     const {return range_kind_  == rangeKind::range;}
     bool is_scalar()    const {return !is_range();}
 
@@ -515,6 +525,7 @@ public:
 protected:
 
     bool           is_state_    = false;
+    bool           is_white_noise_ = false;
     accessKind     access_      = accessKind::readwrite;
     visibilityKind visibility_  = visibilityKind::local;
     linkageKind    linkage_     = linkageKind::external;
@@ -1,5 +1,6 @@
 #include <exception>
 #include <iostream>
+#include <list>
 #include <stdexcept>
 #include <unordered_map>
 #include <unordered_set>
@@ -56,6 +57,11 @@ std::unordered_map<std::string, enum simd_spec::simd_abi> simdAbiMap = {
     {"native", simd_spec::native}
 };
 
+std::unordered_map<std::string, symge::elimination> eliminationMap = {
+    {"gauss-jordan", symge::elimination::gauss_jordan},
+    {"markowitz", symge::elimination::markowitz},
+};
+
 template <typename Map, typename V>
 auto key_by_value(const Map& map, const V& v) -> decltype(map.begin()->first) {
     for (const auto& kv: map) {
@@ -68,8 +74,11 @@ struct Options {
     std::string outprefix;
     std::string modfile;
     std::string modulename;
+    std::string bundle;
+    std::vector<std::string> modfiles;
     bool verbose = false;
     bool analysis = false;
+    symge::elimination elimination = symge::elimination::gauss_jordan;
     std::unordered_set<targetKind> targets;
 };
 
@@ -99,10 +108,12 @@ std::ostream& operator<<(std::ostream& out, const Options& opt) {
 
     return out <<
         table_prefix{"file"} << opt.modfile << line_end <<
+        table_prefix{"bundle"} << (opt.bundle.empty()? "-": opt.bundle) << line_end <<
         table_prefix{"output"} << (opt.outprefix.empty()? "-": opt.outprefix) << line_end <<
         table_prefix{"verbose"} << noyes[opt.verbose] << line_end <<
         table_prefix{"targets"} << targets << line_end <<
-        table_prefix{"analysis"} << noyes[opt.analysis] << line_end;
+        table_prefix{"analysis"} << noyes[opt.analysis] << line_end <<
+        table_prefix{"elimination"} << key_by_value(eliminationMap, opt.elimination) << line_end;
 }
 
 std::ostream& operator<<(std::ostream& out, const printer_options& popt) {
@@ -112,7 +123,12 @@ std::ostream& operator<<(std::ostream& out, const printer_options& popt) {
     return out <<
         table_prefix{"namespace"} << popt.cpp_namespace << line_end <<
         table_prefix{"profile"} << noyes[popt.profile] << line_end <<
-        table_prefix{"simd"} << popt.simd << line_end;
+        table_prefix{"simd"} << popt.simd << line_end <<
+        table_prefix{"gpu single precision"} << noyes[popt.gpu_single_precision] << line_end <<
+        table_prefix{"gpu max block size"} << popt.gpu_max_block_size << line_end <<
+        table_prefix{"table tolerance"} << popt.table_tolerance << line_end <<
+        table_prefix{"fast math"} << noyes[popt.fast_math] << line_end <<
+        table_prefix{"cpu single precision"} << noyes[popt.cpu_single_precision] << line_end;
 }
 
 std::istream& operator>> (std::istream& i, simd_spec& spec) {
@@ -139,10 +155,17 @@ const char* usage_str =
         "-s|--simd              [Generate code with explicit SIMD vectorization]\n"
         "-S|--simd-abi          [Override SIMD ABI in generated code. Use /n suffix to force SIMD width to be size n. Examples: 'avx2', 'native/4', ...]\n"
         "-P|--profile           [Build with profiled kernels]\n"
+        "--gpu-single-precision [Evaluate GPU kernels in single precision]\n"
+        "--gpu-max-block-size   [Largest number of threads per block of GPU kernels; default 256]\n"
+        "--table-tolerance      [Tabulate voltage-dependent rates in CPU kernels to this relative accuracy; 0 (default) disables]\n"
+        "--fast-math            [Use reduced-precision exp, log and exprelr in SIMD kernels]\n"
+        "--cpu-single-precision [Evaluate scalar CPU kernels in single precision]\n"
+        "--elimination          [Elimination for sparse linear systems: 'gauss-jordan' (default), 'markowitz']\n"
         "-V|--verbose           [Toggle verbose mode]\n"
         "-A|--analyse           [Toggle analysis mode]\n"
         "-T|--trace-codegen     [Leave trace marks in generated source]\n"
-        "<filename>             [File to be compiled]\n";
+        "-b|--bundle            [Generate a fused current kernel with this name over all given files]\n"
+        "<filename>...          [File(s) to be compiled]\n";
 
 int main(int argc, char **argv) {
     using namespace to;
@@ -166,22 +189,38 @@ int main(int argc, char **argv) {
             opt.targets.insert(t);
         };
 
+        auto set_elimination = [&opt](symge::elimination e) {
+            opt.elimination = e;
+        };
+
         to::option options[] = {
-                { opt.modfile,  to::mandatory},
+                { to::push_back(opt.modfiles), to::mandatory},
                 { opt.outprefix,                                         "-o", "--output" },
                 { to::set(opt.verbose),  to::flag,                       "-V", "--verbose" },
                 { to::set(opt.analysis), to::flag,                       "-A", "--analyse" },
                 { opt.modulename,                                        "-m", "--module" },
+                { opt.bundle,                                            "-b", "--bundle" },
                 { to::set(popt.profile), to::flag,                       "-P", "--profile" },
                 { popt.cpp_namespace,                                    "-N", "--namespace" },
                 { to::action(enable_simd), to::flag,                     "-s", "--simd" },
                 { popt.simd,                                             "-S", "--simd-abi" },
                 { to::set(popt.trace_codegen), to::flag,                 "-T", "--trace-codegen"},
+                { to::set(popt.gpu_single_precision), to::flag,          "--gpu-single-precision" },
+                { popt.gpu_max_block_size,                               "--gpu-max-block-size" },
+                { popt.table_tolerance,                                  "--table-tolerance" },
+                { to::set(popt.fast_math), to::flag,                     "--fast-math" },
+                { to::set(popt.cpu_single_precision), to::flag,          "--cpu-single-precision" },
                 { {to::action(add_target, to::keywords(targetKindMap))}, "-t", "--target" },
+                { {to::action(set_elimination, to::keywords(eliminationMap))}, "--elimination" },
                 { to::action(help), to::flag, to::exit,                  "-h", "--help" }
         };
 
         if (!to::run(options, argc, argv+1)) return 0;
+
+        if (opt.bundle.empty() && opt.modfiles.size()>1) {
+            throw to::option_error("only one file may be compiled unless --bundle is given");
+        }
+        opt.modfile = opt.modfiles.front();
     }
     catch (to::option_error& e) {
         to::usage_error(argv[0], usage_str, e.what());
@@ -203,36 +242,60 @@ int main(int argc, char **argv) {
             cout << tableline;
         }
 
-        // Load module file and initialize Module object.
+        // Load module files and initialize Module objects, then perform
+        // parsing and semantic analysis passes.
 
-        Module m(io::read_all(opt.modfile), opt.modfile);
+        std::list<Module> modules;
+        for (const auto& modfile: opt.modfiles) {
+            Module& m = modules.emplace_back(io::read_all(modfile), modfile);
 
-        if (m.empty()) {
-            return report_error("empty file: "+opt.modfile);
-        }
+            if (m.empty()) {
+                return report_error("empty file: "+modfile);
+            }
 
-        if (!opt.modulename.empty()) {
-            m.module_name(opt.modulename);
-        }
+            if (!opt.modulename.empty() && opt.bundle.empty()) {
+                m.module_name(opt.modulename);
+            }
+            m.elimination(opt.elimination);
 
-        // Perform parsing and semantic analysis passes.
+            emit_header("parsing");
+            Parser p(m, false);
+            if (!p.parse()) {
+                // Parser::parse() writes its own errors to stderr.
+                return 1;
+            }
 
-        emit_header("parsing");
-        Parser p(m, false);
-        if (!p.parse()) {
-            // Parser::parse() writes its own errors to stderr.
-            return 1;
+            emit_header("semantic analysis");
+            m.semantic();
+            if (m.has_warning()) {
+                cerr << m.warning_string() << "\n";
+            }
+            if (m.has_error()) {
+                return report_error(m.error_string());
+            }
         }
 
-        emit_header("semantic analysis");
-        m.semantic();
-        if (m.has_warning()) {
-            cerr << m.warning_string() << "\n";
-        }
-        if (m.has_error()) {
-            return report_error(m.error_string());
+        // A bundle comprises only the fused current kernel over its members;
+        // their own implementations are generated separately.
+
+        if (!opt.bundle.empty()) {
+            emit_header("code generation");
+
+            if (opt.targets.count(targetKind::gpu)) {
+                return report_error("mechanism bundles are only supported for the cpu target");
+            }
+
+            std::vector<const Module*> members;
+            for (const auto& m: modules) members.push_back(&m);
+
+            std::string prefix = opt.outprefix.empty()? opt.bundle+"_bundle": opt.outprefix;
+            io::write_all(build_bundle_info_header(opt.bundle, popt), prefix+".hpp");
+            io::write_all(emit_cpp_bundle_source(opt.bundle, members, popt), prefix+"_cpu.cpp");
+            return 0;
         }
 
+        Module& m = modules.front();
+
         // Generate backend-specific sources for each backend provided.
 
         emit_header("code generation");
@@ -7,6 +7,7 @@
 #include <string>
 #include <unordered_set>
 
+#include "cserewriter.hpp"
 #include "errorvisitor.hpp"
 #include "functionexpander.hpp"
 #include "functioninliner.hpp"
@@ -199,6 +200,20 @@ bool Module::semantic() {
         }
     }
 
+    // A QUIESCENT state must be a STATE variable of a point process.
+    if (neuron_block_.has_quiescent_state()) {
+        const auto& q = neuron_block_.quiescent_state;
+        if (kind_ != moduleKind::point) {
+            error("QUIESCENT is only supported for point processes", q.location);
+            return false;
+        }
+        auto is_q = [&q](const Id& id) { return id.name()==q.spelling; };
+        if (std::none_of(state_block_.begin(), state_block_.end(), is_q)) {
+            error(pprintf("QUIESCENT variable '%' is not a STATE variable", yellow(q.spelling)), q.location);
+            return false;
+        }
+    }
+
     // perform semantic analysis and inlining on function and procedure bodies
     if(auto errors = semantic_func_proc()) {
         error("There were "+std::to_string(errors)+" errors in the semantic analysis");
@@ -318,6 +333,7 @@ bool Module::semantic() {
                 }
 
                 rewrite_body->semantic(init_scope);
+                solver->elimination(elimination_);
                 rewrite_body->accept(solver.get());
             } else if (solve_proc->kind() == procedureKind::kinetic &&
                        solve_expression->variant() == solverVariant::steadystate) {
@@ -325,6 +341,7 @@ bool Module::semantic() {
                 auto rewrite_body = kinetic_rewrite(solve_proc->body());
 
                 rewrite_body->semantic(init_scope);
+                solver->elimination(elimination_);
                 rewrite_body->accept(solver.get());
             } else {
                 error("A SOLVE expression in an INITIAL block can only be used to solve a "
@@ -394,10 +411,16 @@ bool Module::semantic() {
         case solverMethod::cnexp:
             solver = std::make_unique<CnexpSolverVisitor>();
             break;
-        case solverMethod::sparse: {
-            solver = std::make_unique<SparseSolverVisitor>(solve_expression->variant());
+        case solverMethod::sparse:
+        case solverMethod::sdirk2:
+        case solverMethod::expm:
+            solver = std::make_unique<SparseSolverVisitor>(solve_expression->variant(), solve_expression->method());
             break;
-        }
+        case solverMethod::stochastic: {
+            std::vector<std::string> noise;
+            for (const auto& id: white_noise_block_) noise.push_back(id.name());
+            solver = std::make_unique<EulerMaruyamaSolverVisitor>(noise);
+        } break;
         case solverMethod::none:
             solver = std::make_unique<DirectSolverVisitor>();
             break;
@@ -408,6 +431,11 @@ bool Module::semantic() {
 
         auto deriv = solve_expression->procedure();
 
+        if (solve_expression->method()==solverMethod::stochastic && deriv->kind()!=procedureKind::derivative) {
+            error("METHOD stochastic requires a DERIVATIVE block", solve_expression->location());
+            return false;
+        }
+
         if (deriv->kind()==procedureKind::kinetic) {
             auto rewrite_body = kinetic_rewrite(deriv->body());
             bool linear_kinetic = true;
@@ -420,10 +448,16 @@ bool Module::semantic() {
             }
 
             if (!linear_kinetic) {
-                solver = std::make_unique<SparseNonlinearSolverVisitor>();
+                if (solve_expression->method() == solverMethod::expm) {
+                    error("METHOD expm requires a KINETIC block that is linear in the states",
+                          solve_expression->location());
+                    return false;
+                }
+                solver = std::make_unique<SparseNonlinearSolverVisitor>(solve_expression->method());
             }
 
             rewrite_body->semantic(advance_state_scope);
+            solver->elimination(elimination_);
             rewrite_body->accept(solver.get());
         }
         else if (deriv->kind()==procedureKind::linear) {
@@ -431,9 +465,11 @@ bool Module::semantic() {
             auto rewrite_body = linear_rewrite(deriv->body(), state_vars);
 
             rewrite_body->semantic(advance_state_scope);
+            solver->elimination(elimination_);
             rewrite_body->accept(solver.get());
         }
         else {
+            solver->elimination(elimination_);
             deriv->body()->accept(solver.get());
             for (auto& s: deriv->body()->statements()) {
                 if(s->is_assignment() && !state_vars.empty()) {
@@ -537,7 +573,9 @@ bool Module::semantic() {
             }
         }
     }
-    linear_ = linear;
+    // Instances driven by white noise are independent, and may not be
+    // combined.
+    linear_ = linear && white_noise_block_.parameters.empty();
 
     post_events_ = has_symbol("post_event", symbolKind::procedure);
     if (post_events_) {
@@ -555,6 +593,19 @@ bool Module::semantic() {
     // in order to inline calls inside the newly crated API methods.
     semantic_func_proc();
 
+    check_additive_events();
+
+    // With all calls inlined, evaluate repeated and instance independent
+    // subexpressions of the API methods only once.
+    for (auto& e: symbols_) {
+        if (auto api = e.second->is_api_method()) {
+            api->body(expand_integer_powers(api->body()));
+            api->semantic(symbols_);
+            api->body(eliminate_common_subexpressions(api->body()));
+            api->semantic(symbols_);
+        }
+    }
+
     return !has_error();
 }
 
@@ -663,6 +714,18 @@ void Module::add_variables_to_symbols() {
             accessKind::readwrite, visibilityKind::local, linkageKind::local, rangeKind::range);
     }
 
+    // Add white noise variables: read-only range variables whose values
+    // are drawn by the back end in every step.
+    for (const Id& id: white_noise_block_) {
+        if (symbols_.count(id.name())) {
+            error(pprintf("the WHITE_NOISE variable % is already defined", yellow(id.name())), id.token.location);
+            continue;
+        }
+        auto& sym = create_variable(id.token,
+            accessKind::read, visibilityKind::local, linkageKind::local, rangeKind::range);
+        sym->is_variable()->white_noise(true);
+    }
+
     ////////////////////////////////////////////////////
     // parse the NEURON block data, and use it to update
     // the variables in symbols_
@@ -922,3 +985,43 @@ void Module::check_revpot_mechanism() {
 
     kind_ = moduleKind::revpot;
 }
+
+// Events are additive if NET_RECEIVE only adds to variables a multiple of the
+// weight that does not depend on any variable the block assigns. Delivering
+// events of weights w₁ and w₂ to an instance then has the same effect as a
+// single event of weight w₁+w₂.
+void Module::check_additive_events() {
+    additive_events_ = false;
+    auto it = symbols_.find("net_rec_api");
+    auto api = it==symbols_.end()? nullptr: it->second->is_api_method();
+    if (!api) return;
+
+    std::string weight = api->args().empty()? "weight": api->args().front()->is_argument()->name();
+
+    identifier_set assigned = {weight};
+    std::vector<Expression*> increments;
+    for (auto& s: api->body()->statements()) {
+        if (s->is_local_declaration()) continue;
+
+        auto assign = s->is_assignment();
+        if (!assign) return;
+        auto lhs = assign->lhs()->is_identifier();
+        if (!lhs || !lhs->symbol() || !lhs->symbol()->is_variable()) return;
+
+        auto sum = assign->rhs()->is_binary();
+        if (!sum || sum->op()!=tok::plus) return;
+
+        auto is_lhs = [&](Expression* e) { return e->is_identifier() && e->is_identifier()->spelling()==lhs->spelling(); };
+        if (is_lhs(sum->lhs())) increments.push_back(sum->rhs());
+        else if (is_lhs(sum->rhs())) increments.push_back(sum->lhs());
+        else return;
+
+        assigned.push_back(lhs->spelling());
+    }
+
+    for (auto inc: increments) {
+        auto r = linear_test(inc, {weight});
+        if (!r.is_linear || !r.is_homogeneous || involves_identifier(r.coef[weight], assigned)) return;
+    }
+    additive_events_ = !increments.empty();
+}
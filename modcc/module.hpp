@@ -8,6 +8,7 @@
 #include "blocks.hpp"
 #include "error.hpp"
 #include "expression.hpp"
+#include "symge.hpp"
 
 // wrapper around a .mod file
 class Module: public error_stack {
@@ -57,6 +58,9 @@ public:
     // Retrieve list of parameter variable ids.
     ParameterBlock const&  parameter_block()  const {return parameter_block_;}
 
+    // Retrieve list of white noise variable ids.
+    WhiteNoiseBlock const& white_noise_block() const {return white_noise_block_;}
+
     // Retrieve list of ion dependencies.
     const std::vector<IonDep>& ion_deps() const { return neuron_block_.ions; }
 
@@ -66,6 +70,7 @@ public:
     void units_block(const UnitsBlock& u) { units_block_ = u; }
     void parameter_block(const ParameterBlock& p) { parameter_block_ = p; }
     void assigned_block(const AssignedBlock& a) { assigned_block_ = a; }
+    void white_noise_block(const WhiteNoiseBlock& w) { white_noise_block_ = w; }
 
     // Add global procedure or function, before semantic pass (called from Parser).
     void add_callable(symbol_ptr callable);
@@ -88,6 +93,11 @@ public:
 
     std::string warning_string() const;
 
+    // Elimination scheme for the linear systems of sparse solvers;
+    // set before the semantic pass.
+    symge::elimination elimination() const { return elimination_; }
+    void elimination(symge::elimination e) { elimination_ = e; }
+
     // Perform semantic analysis pass.
     bool semantic();
 
@@ -105,6 +115,7 @@ public:
 
     bool is_linear() const { return linear_; }
     bool has_post_events() const { return post_events_; }
+    bool has_additive_events() const { return additive_events_; }
 
 private:
     moduleKind kind_;
@@ -118,8 +129,11 @@ private:
     UnitsBlock units_block_;
     ParameterBlock parameter_block_;
     AssignedBlock assigned_block_;
+    WhiteNoiseBlock white_noise_block_;
     bool linear_;
     bool post_events_;
+    bool additive_events_ = false;
+    symge::elimination elimination_ = symge::elimination::gauss_jordan;
 
     // AST storage.
     std::vector<symbol_ptr> callables_;
@@ -144,6 +158,9 @@ private:
     // Check requirements for reversal potential setters.
     void check_revpot_mechanism();
 
+    // Check whether the effect of NET_RECEIVE is additive in the weight.
+    void check_additive_events();
+
     // Perform semantic analysis on functions and procedures.
     // Returns the number of errors that were encountered.
     int semantic_func_proc();
@@ -103,6 +103,9 @@ bool Parser::parse() {
         case tok::assigned:
             parse_assigned_block();
             break;
+        case tok::white_noise:
+            parse_white_noise_block();
+            break;
         // INITIAL, KINETIC, DERIVATIVE, PROCEDURE, NET_RECEIVE and BREAKPOINT blocks
         // are all lowered to ProcedureExpression
         case tok::net_receive:
@@ -203,6 +206,7 @@ NEURON {
    USEION k WRITE ik READ xy
    RANGE  gkbar, ik, ek
    GLOBAL minf, mtau, hinf, htau
+   QUIESCENT g < 1e-6
 }
 */
 void Parser::parse_neuron_block() {
@@ -348,6 +352,31 @@ void Parser::parse_neuron_block() {
             }
             break;
 
+        // QUIESCENT state < threshold
+        case tok::quiescent:
+            {
+                get_token(); // consume QUIESCENT
+
+                if (token_.type != tok::identifier) {
+                    error(pprintf("invalid name for QUIESCENT state, found '%'", token_.spelling));
+                    return;
+                }
+                neuron_block.quiescent_state = token_;
+                get_token(); // consume the state name
+
+                if (token_.type != tok::lt) {
+                    error(pprintf("expected '<' after QUIESCENT state, found '%'", token_.spelling));
+                    return;
+                }
+                get_token(); // consume '<'
+
+                neuron_block.quiescent_threshold = value_literal();
+                if (status_ == lexerStatus::error) {
+                    return;
+                }
+            }
+            break;
+
         // the parser encountered an invalid symbol
         default:
             error(pprintf("there was an invalid statement '%' in NEURON block",
@@ -664,6 +693,39 @@ ass_exit:
     return;
 }
 
+void Parser::parse_white_noise_block() {
+    WhiteNoiseBlock block;
+
+    get_token();
+
+    // assert that the block starts with a curly brace
+    if (token_.type != tok::lbrace) {
+        error(pprintf("WHITE_NOISE block must start with a curly brace {, found '%'", token_.spelling));
+        return;
+    }
+
+    // the block holds only identifiers; white noise is dimensionless
+    get_token();
+    while (token_.type == tok::identifier) {
+        block.parameters.push_back(Id(token_, "", {}));
+        get_token();
+    }
+
+    if (token_.type != tok::rbrace) {
+        // only write error message if one hasn't already been logged by the lexer
+        if (status_ == lexerStatus::happy) {
+            error(token_.type == tok::eof?
+                  std::string("WHITE_NOISE block must have closing '}'"):
+                  pprintf("WHITE_NOISE block unexpected symbol '%'", token_.spelling));
+        }
+        return;
+    }
+
+    get_token(); // consume closing brace
+
+    module_->white_noise_block(block);
+}
+
 // Parse a value (integral or real) with possible preceding unary minus,
 // and return as a string.
 std::string Parser::value_literal() {
@@ -1587,6 +1649,18 @@ expression_ptr Parser::parse_solve() {
         case tok::sparse:
             method = solverMethod::sparse;
             break;
+        case tok::sdirk2:
+            if (variant == solverVariant::steadystate) goto solve_statement_error;
+            method = solverMethod::sdirk2;
+            break;
+        case tok::expm:
+            if (variant == solverVariant::steadystate) goto solve_statement_error;
+            method = solverMethod::expm;
+            break;
+        case tok::stochastic:
+            if (variant == solverVariant::steadystate) goto solve_statement_error;
+            method = solverMethod::stochastic;
+            break;
         default:
             goto solve_statement_error;
         }
@@ -1608,7 +1682,7 @@ solve_statement_error:
           "    or\n"
           "  SOLVE x\n"
           "where 'x' is the name of a DERIVATIVE block and "
-          "'method' is 'cnexp' or 'sparse'",
+          "'method' is 'cnexp', 'sparse', 'sdirk2', 'expm' or 'stochastic'",
         loc);
     return nullptr;
 }
@@ -18,7 +18,7 @@ struct FlopAccumulator {
     int pow=0;
 
     void reset() {
-        add = neg = mul = div = exp = sin = cos = log = 0;
+        add = neg = mul = div = exp = sin = cos = log = pow = 0;
     }
 };
 
@@ -34,6 +34,11 @@ std::ostream& operator<<(std::ostream& out, as_c_double wrap) {
     }
 }
 
+std::ostream& operator<<(std::ostream& out, as_c_float wrap) {
+    out << as_c_double(wrap.value);
+    return std::isfinite(wrap.value)? out << 'f': out;
+}
+
 void CExprEmitter::emit_as_call(const char* sub, Expression* e) {
     out_ << sub << '(';
     e->accept(this);
@@ -49,6 +54,10 @@ void CExprEmitter::emit_as_call(const char* sub, Expression* e1, Expression* e2)
 }
 
 void CExprEmitter::visit(NumberExpression* e) {
+    if (single_precision_) {
+        out_ << " " << as_c_float(e->value());
+        return;
+    }
     out_ << " " << as_c_double(e->value());
 }
 
@@ -12,8 +12,8 @@
 
 class CExprEmitter: public Visitor {
 public:
-    CExprEmitter(std::ostream& out, Visitor* fallback):
-        out_(out), fallback_(fallback)
+    CExprEmitter(std::ostream& out, Visitor* fallback, bool single_precision = false):
+        out_(out), fallback_(fallback), single_precision_(single_precision)
     {}
 
     void visit(Expression* e) override { e->accept(fallback_); }
@@ -28,13 +28,15 @@ public:
 protected:
     std::ostream& out_;
     Visitor* fallback_;
+    // Emit literals as float rather than double.
+    bool single_precision_ = false;
 
     void emit_as_call(const char* sub, Expression*);
     void emit_as_call(const char* sub, Expression*, Expression*);
 };
 
-inline void cexpr_emit(Expression* e, std::ostream& out, Visitor* fallback) {
-    CExprEmitter emitter(out, fallback);
+inline void cexpr_emit(Expression* e, std::ostream& out, Visitor* fallback, bool single_precision = false) {
+    CExprEmitter emitter(out, fallback, single_precision);
     e->accept(&emitter);
 }
 
@@ -97,3 +99,11 @@ struct as_c_double {
 };
 
 std::ostream& operator<<(std::ostream&, as_c_double);
+
+// As as_c_double, but with an 'f' suffix on finite values.
+struct as_c_float {
+    double value;
+    as_c_float(double value): value(value) {}
+};
+
+std::ostream& operator<<(std::ostream&, as_c_float);
@@ -1,7 +1,9 @@
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <regex>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 
 #include "expression.hpp"
@@ -12,6 +14,7 @@
 #include "printer/printeropt.hpp"
 #include "printer/printerutil.hpp"
 #include "printer/marks.hpp"
+#include "printer/ratetable.hpp"
 
 #define FMT_HEADER_ONLY YES
 #include <fmt/core.h>
@@ -50,10 +53,12 @@ struct index_prop {
     }
 };
 
-void emit_procedure_proto(std::ostream&, ProcedureExpression*, const std::string&, const std::string& qualified = "");
+void emit_procedure_proto(std::ostream&, ProcedureExpression*, const std::string&, const std::string& qualified = "", bool single_precision = false);
 void emit_simd_procedure_proto(std::ostream&, ProcedureExpression*, const std::string&, const std::string& qualified = "");
 void emit_masked_simd_procedure_proto(std::ostream&, ProcedureExpression*, const std::string&, const std::string& qualified = "");
-void emit_api_body(std::ostream&, APIMethod*, bool cv_loop = true, bool ppack_iface=true);
+void emit_api_body(std::ostream&, APIMethod*, bool cv_loop = true, bool ppack_iface=true, bool active_only=false,
+                   const rate_table_plan* table = nullptr, bool single_precision = false);
+void emit_rate_table(std::ostream&, APIMethod*, const rate_table_plan&, double tolerance);
 void emit_simd_api_body(std::ostream&, APIMethod*, const std::vector<VariableExpression*>& scalars);
 void emit_simd_index_initialize(std::ostream& out, const std::list<index_prop>& indices, simd_expr_constraint constraint);
 
@@ -71,10 +76,14 @@ void emit_simd_for_loop_per_constraint(std::ostream& out, BlockExpression* body,
 
 struct cprint {
     Expression* expr_;
-    explicit cprint(Expression* expr): expr_(expr) {}
+    std::vector<AssignmentExpression*> hoisted_;
+    bool single_precision_;
+    explicit cprint(Expression* expr, std::vector<AssignmentExpression*> hoisted = {}, bool single_precision = false):
+        expr_(expr), hoisted_(std::move(hoisted)), single_precision_(single_precision) {}
 
     friend std::ostream& operator<<(std::ostream& out, const cprint& w) {
-        CPrinter printer(out);
+        CPrinter printer(out, w.single_precision_);
+        printer.set_hoisted(w.hoisted_);
         return w.expr_->accept(&printer), out;
     }
 };
@@ -92,6 +101,7 @@ struct simdprint {
     bool is_indirect_ = false;
     bool is_masked_ = false;
     std::unordered_set<std::string> scalars_;
+    std::vector<AssignmentExpression*> hoisted_;
 
     explicit simdprint(Expression* expr, const std::vector<VariableExpression*>& scalars): expr_(expr) {
         for (const auto& s: scalars) {
@@ -105,6 +115,9 @@ struct simdprint {
     void set_masked() {
         is_masked_ = true;
     }
+    void set_hoisted(std::vector<AssignmentExpression*> hoisted) {
+        hoisted_ = std::move(hoisted);
+    }
 
     friend std::ostream& operator<<(std::ostream& out, const simdprint& w) {
         SimdPrinter printer(out);
@@ -113,10 +126,78 @@ struct simdprint {
         }
         printer.set_var_indexed(w.is_indirect_);
         printer.save_scalar_names(w.scalars_);
+        printer.set_hoisted(w.hoisted_);
         return w.expr_->accept(&printer), out;
     }
 };
 
+// A parameter that no kernel writes, and so can be given the same value for
+// all instances.
+static bool is_uniform_candidate(const VariableExpression* v) {
+    return !v->is_state() && !v->is_writeable();
+}
+
+// Bind ppack fields to local names for the generated kernels. If `uniform`
+// is set, parameters that are never written are bound to the value of the
+// first instance.
+static void emit_ppack_iface_block(std::ostream& out, const Module& module_, const module_variables_t& vars, bool uniform = false) {
+    out << fmt::format(FMT_COMPILE("#define PPACK_IFACE_BLOCK \\\n"
+                                   "[[maybe_unused]] auto  {0}width             = pp->width;\\\n"
+                                   "[[maybe_unused]] auto* {0}vec_ci            = pp->vec_ci;\\\n"
+                                   "[[maybe_unused]] auto* {0}vec_di            = pp->vec_di;\\\n"
+                                   "[[maybe_unused]] auto* {0}vec_t             = pp->vec_t;\\\n"
+                                   "[[maybe_unused]] auto* {0}vec_dt            = pp->vec_dt;\\\n"
+                                   "[[maybe_unused]] auto* {0}vec_v             = pp->vec_v;\\\n"
+                                   "[[maybe_unused]] auto* {0}vec_i             = pp->vec_i;\\\n"
+                                   "[[maybe_unused]] auto* {0}vec_g             = pp->vec_g;\\\n"
+                                   "[[maybe_unused]] auto* {0}temperature_degC  = pp->temperature_degC;\\\n"
+                                   "[[maybe_unused]] auto* {0}diam_um           = pp->diam_um;\\\n"
+                                   "[[maybe_unused]] auto* {0}time_since_spike  = pp->time_since_spike;\\\n"
+                                   "[[maybe_unused]] auto* {0}detector_divs     = pp->detector_divs;\\\n"
+                                   "[[maybe_unused]] auto* {0}node_index        = pp->node_index;\\\n"
+                                   "[[maybe_unused]] auto* {0}multiplicity      = pp->multiplicity;\\\n"
+                                   "[[maybe_unused]] auto* {0}weight            = pp->weight;\\\n"
+                                   "[[maybe_unused]] auto& {0}events            = pp->events;\\\n"
+                                   "[[maybe_unused]] auto& {0}mechanism_id      = pp->mechanism_id;\\\n"
+                                   "[[maybe_unused]] auto& {0}index_constraints = pp->index_constraints;\\\n"),
+                       pp_var_pfx);
+    auto global = 0;
+    for (const auto& scalar: vars.scalars) {
+        out << fmt::format("[[maybe_unused]] auto {}{} = pp->globals[{}];\\\n", pp_var_pfx, scalar->name(), global);
+        global++;
+    }
+    auto param = 0, state = 0;
+    for (const auto& array: vars.arrays) {
+        if (array->is_state()) {
+            out << fmt::format("[[maybe_unused]] auto* {}{} = pp->state_vars[{}];\\\n", pp_var_pfx, array->name(), state);
+            state++;
+        }
+    }
+    for (const auto& array: vars.arrays) {
+        if (!array->is_state()) {
+            if (uniform && is_uniform_candidate(array)) {
+                out << fmt::format("[[maybe_unused]] const uniform_parameter_ {}{}{{pp->width? pp->parameters[{}][0]: 0}};\\\n", pp_var_pfx, array->name(), param);
+            }
+            else {
+                out << fmt::format("[[maybe_unused]] auto* {}{} = pp->parameters[{}];\\\n", pp_var_pfx, array->name(), param);
+            }
+            param++;
+        }
+    }
+    auto random = 0;
+    for (const auto& var: vars.white_noise) {
+        out << fmt::format("[[maybe_unused]] const auto* {}{} = pp->random_numbers[{}];\\\n", pp_var_pfx, var->name(), random);
+        random++;
+    }
+    auto idx = 0;
+    for (const auto& ion: module_.ion_deps()) {
+        out << fmt::format("[[maybe_unused]] auto& {}{} = pp->ion_states[{}];\\\n",       pp_var_pfx, ion_field(ion), idx);
+        out << fmt::format("[[maybe_unused]] auto* {}{} = pp->ion_states[{}].index;\\\n", pp_var_pfx, ion_index(ion), idx);
+        idx++;
+    }
+    out << "//End of IFACEBLOCK\n\n";
+}
+
 std::string emit_cpp_source(const Module& module_, const printer_options& opt) {
     auto name           = module_.module_name();
     auto namespace_name = "kernel_" + name;
@@ -131,6 +212,9 @@ std::string emit_cpp_source(const Module& module_, const printer_options& opt) {
     APIMethod* write_ions_api  = find_api_method(module_, "write_ions");
 
     bool with_simd = opt.simd.abi!=simd_spec::none;
+    // Vectorized kernels stay in double precision: the SIMD library has no
+    // single precision vector types.
+    const bool single_precision = opt.cpu_single_precision && !with_simd;
 
     options_trace_codegen = opt.trace_codegen;
     
@@ -142,7 +226,6 @@ std::string emit_cpp_source(const Module& module_, const printer_options& opt) {
 
     auto vars = local_module_variables(module_);
     auto ion_deps = module_.ion_deps();
-    std::string fingerprint = "<placeholder>";
 
     auto profiler_enter = [name, opt](const char* region_prefix) -> std::string {
         static std::regex invalid_profile_chars("[^a-zA-Z0-9]");
@@ -166,6 +249,15 @@ std::string emit_cpp_source(const Module& module_, const printer_options& opt) {
         return opt.profile? "::arb::profile::profiler_leave();\n": "";
     };
 
+    // Voltage-only rate computations in the scalar kernels are replaced by
+    // table lookups if requested.
+    std::unordered_map<APIMethod*, rate_table_plan> rate_tables;
+    if (!with_simd && opt.table_tolerance>0) {
+        for (auto p: {init_api, state_api, current_api}) {
+            if (auto plan = make_rate_table_plan(p)) rate_tables[p] = std::move(plan);
+        }
+    }
+
     io::pfxstringstream out;
 
     ENTER(out);
@@ -180,6 +272,10 @@ std::string emit_cpp_source(const Module& module_, const printer_options& opt) {
     opt.profile &&
         out << "#include <" << arb_header_prefix() << "profile/profiler.hpp>\n";
 
+    if (!rate_tables.empty()) {
+        out << "#include <" << arb_header_prefix() << "rate_table.hpp>\n";
+    }
+
     if (with_simd) {
         out << "#include <" << arb_header_prefix() << "simd/simd.hpp>\n";
         out << "#undef NDEBUG\n";
@@ -202,9 +298,32 @@ std::string emit_cpp_source(const Module& module_, const printer_options& opt) {
         "using ::std::sin;\n"
         "\n";
 
+    if (single_precision) {
+        // Mixed precision arguments are compared in the wider type.
+        out <<
+            "inline arb_value_type min(float a, arb_value_type b) { return min<arb_value_type>(a, b); }\n"
+            "inline arb_value_type min(arb_value_type a, float b) { return min<arb_value_type>(a, b); }\n"
+            "inline arb_value_type max(float a, arb_value_type b) { return max<arb_value_type>(a, b); }\n"
+            "inline arb_value_type max(arb_value_type a, float b) { return max<arb_value_type>(a, b); }\n"
+            "\n";
+    }
+
     if (with_simd) {
+        if (opt.fast_math) {
+            // Shadow the exact functions with the fast_* variants: qualified
+            // lookup of S::exp etc. finds these before the using-directive.
+            out <<
+                "namespace S {\n"
+                "using namespace ::arb::simd;\n"
+                "template <typename I> ::arb::simd::detail::simd_impl<I> exp(const ::arb::simd::detail::simd_impl<I>& x) { return ::arb::simd::fast_exp(x); }\n"
+                "template <typename I> ::arb::simd::detail::simd_impl<I> log(const ::arb::simd::detail::simd_impl<I>& x) { return ::arb::simd::fast_log(x); }\n"
+                "template <typename I> ::arb::simd::detail::simd_impl<I> exprelr(const ::arb::simd::detail::simd_impl<I>& x) { return ::arb::simd::fast_exprelr(x); }\n"
+                "} // namespace S\n";
+        }
+        else {
+            out << "namespace S = ::arb::simd;\n";
+        }
         out <<
-            "namespace S = ::arb::simd;\n"
             "using S::index_constraint;\n"
             "using S::simd_cast;\n"
             "using S::indirect;\n"
@@ -252,175 +371,205 @@ std::string emit_cpp_source(const Module& module_, const printer_options& opt) {
         out << "static constexpr unsigned simd_width_ = 0;\n\n";
     }
 
+    // Instances of a mechanism with a QUIESCENT state are skipped by the
+    // scalar state and current kernels while quiescent; see below.
+    const bool active_index = !with_simd && module_.neuron_block().has_quiescent_state();
+
     // Make implementations
-    auto emit_body = [&](APIMethod *p) {
+    auto emit_body = [&](APIMethod *p, bool active_only = false) {
         if (with_simd) {
             emit_simd_api_body(out, p, vars.scalars);
         } else {
-            emit_api_body(out, p);
+            auto table = rate_tables.find(p);
+            bool tabulated = table!=rate_tables.end();
+            emit_api_body(out, p, true, true, active_only, tabulated? &table->second: nullptr, single_precision && !tabulated);
         }
     };
 
-    out << fmt::format(FMT_COMPILE("#define PPACK_IFACE_BLOCK \\\n"
-                                   "[[maybe_unused]] auto  {0}width             = pp->width;\\\n"
-                                   "[[maybe_unused]] auto  {0}n_detectors       = pp->n_detectors;\\\n"
-                                   "[[maybe_unused]] auto* {0}vec_ci            = pp->vec_ci;\\\n"
-                                   "[[maybe_unused]] auto* {0}vec_di            = pp->vec_di;\\\n"
-                                   "[[maybe_unused]] auto* {0}vec_t             = pp->vec_t;\\\n"
-                                   "[[maybe_unused]] auto* {0}vec_dt            = pp->vec_dt;\\\n"
-                                   "[[maybe_unused]] auto* {0}vec_v             = pp->vec_v;\\\n"
-                                   "[[maybe_unused]] auto* {0}vec_i             = pp->vec_i;\\\n"
-                                   "[[maybe_unused]] auto* {0}vec_g             = pp->vec_g;\\\n"
-                                   "[[maybe_unused]] auto* {0}temperature_degC  = pp->temperature_degC;\\\n"
-                                   "[[maybe_unused]] auto* {0}diam_um           = pp->diam_um;\\\n"
-                                   "[[maybe_unused]] auto* {0}time_since_spike  = pp->time_since_spike;\\\n"
-                                   "[[maybe_unused]] auto* {0}node_index        = pp->node_index;\\\n"
-                                   "[[maybe_unused]] auto* {0}multiplicity      = pp->multiplicity;\\\n"
-                                   "[[maybe_unused]] auto* {0}weight            = pp->weight;\\\n"
-                                   "[[maybe_unused]] auto& {0}events            = pp->events;\\\n"
-                                   "[[maybe_unused]] auto& {0}mechanism_id      = pp->mechanism_id;\\\n"
-                                   "[[maybe_unused]] auto& {0}index_constraints = pp->index_constraints;\\\n"),
-                       pp_var_pfx);
-    auto global = 0;
-    for (const auto& scalar: vars.scalars) {
-        out << fmt::format("[[maybe_unused]] auto {}{} = pp->globals[{}];\\\n", pp_var_pfx, scalar->name(), global);
-        global++;
-    }
-    auto param = 0, state = 0;
-    for (const auto& array: vars.arrays) {
-        if (array->is_state()) {
-            out << fmt::format("[[maybe_unused]] auto* {}{} = pp->state_vars[{}];\\\n", pp_var_pfx, array->name(), state);
-            state++;
+    // Parameters that no kernel writes are read per instance. If all
+    // instances of the mechanism share their values, the engine can switch to
+    // a second set of scalar kernels that reads them once.
+    const bool uniform_kernels = !with_simd &&
+        std::any_of(vars.arrays.begin(), vars.arrays.end(), [](auto v) { return is_uniform_candidate(v); });
+
+    auto emit_kernels = [&](bool uniform) {
+        emit_ppack_iface_block(out, module_, vars, uniform);
+
+
+        out << "// procedure prototypes\n";
+        for (auto proc: normal_procedures(module_)) {
+            if (with_simd) {
+                emit_simd_procedure_proto(out, proc, ppack_name);
+                out << ";\n";
+                emit_masked_simd_procedure_proto(out, proc, ppack_name);
+                out << ";\n";
+            } else {
+                emit_procedure_proto(out, proc, ppack_name, "", single_precision);
+                out << ";\n";
+            }
         }
-    }
-    for (const auto& array: vars.arrays) {
-        if (!array->is_state()) {
-            out << fmt::format("[[maybe_unused]] auto* {}{} = pp->parameters[{}];\\\n", pp_var_pfx, array->name(), param);
-            param++;
+        if (!rate_tables.empty()) {
+            out << "\n// rate tables\n";
+            for (auto p: {init_api, state_api, current_api}) {
+                if (rate_tables.count(p)) emit_rate_table(out, p, rate_tables.at(p), opt.table_tolerance);
+            }
         }
-    }
-    auto idx = 0;
-    for (const auto& ion: module_.ion_deps()) {
-        out << fmt::format("[[maybe_unused]] auto& {}{} = pp->ion_states[{}];\\\n",       pp_var_pfx, ion_field(ion), idx);
-        out << fmt::format("[[maybe_unused]] auto* {}{} = pp->ion_states[{}].index;\\\n", pp_var_pfx, ion_index(ion), idx);
-        idx++;
-    }
-    out << "//End of IFACEBLOCK\n\n";
 
-    out << "// procedure prototypes\n";
-    for (auto proc: normal_procedures(module_)) {
-        if (with_simd) {
-            emit_simd_procedure_proto(out, proc, ppack_name);
-            out << ";\n";
-            emit_masked_simd_procedure_proto(out, proc, ppack_name);
-            out << ";\n";
+        out << "\n"
+            << "// interface methods\n";
+        out << "static void init(arb_mechanism_ppack* pp) {\n" << indent;
+        if (active_index) {
+            // All instances start active; the first state update drops the quiescent ones.
+            out << "for (arb_size_type i_ = 0; i_ < pp->width; ++i_) {\n"
+                   "    pp->active_index[i_] = i_;\n"
+                   "    pp->active_flag[i_] = 1;\n"
+                   "}\n"
+                   "pp->n_active = pp->width;\n";
+        }
+        emit_body(init_api);
+        if (init_api && init_api->body() && !init_api->body()->statements().empty()) {
+            auto n = std::count_if(vars.arrays.begin(), vars.arrays.end(),
+                                   [] (const auto& v) { return v->is_state(); });
+            out << fmt::format(FMT_COMPILE("if (!{0}multiplicity) return;\n"
+                                           "for (arb_size_type ix = 0; ix < {1}; ++ix) {{\n"
+                                           "    for (arb_size_type iy = 0; iy < {0}width; ++iy) {{\n"
+                                           "        pp->state_vars[ix][iy] *= {0}multiplicity[iy];\n"
+                                           "    }}\n"
+                                           "}}\n"),
+                               pp_var_pfx,
+                               n);
+        }
+        out << popindent << "}\n\n";
+
+        out << "static void advance_state(arb_mechanism_ppack* pp) {\n" << indent;
+        out << profiler_enter("advance_integrate_state");
+        emit_body(state_api, active_index);
+        if (active_index) {
+            // Drop the instances that have become quiescent from the active index.
+            const auto& nb = module_.neuron_block();
+            auto state = 0;
+            for (const auto& array: vars.arrays) {
+                if (!array->is_state()) continue;
+                if (array->name()==nb.quiescent_state.spelling) break;
+                state++;
+            }
+            out << fmt::format(FMT_COMPILE("{{\n"
+                                           "    arb_size_type n_ = 0;\n"
+                                           "    auto* q_ = pp->state_vars[{0}];\n"
+                                           "    for (arb_size_type k_ = 0; k_ < pp->n_active; ++k_) {{\n"
+                                           "        auto i_ = pp->active_index[k_];\n"
+                                           "        if (abs(q_[i_]) < {1}) pp->active_flag[i_] = 0;\n"
+                                           "        else pp->active_index[n_++] = i_;\n"
+                                           "    }}\n"
+                                           "    pp->n_active = n_;\n"
+                                           "}}\n"),
+                               state,
+                               nb.quiescent_threshold);
+        }
+        out << profiler_leave();
+        out << popindent << "}\n\n";
+
+        out << "static void compute_currents(arb_mechanism_ppack* pp) {\n" << indent;
+        out << profiler_enter("advance_integrate_current");
+        emit_body(current_api, active_index);
+        out << profiler_leave();
+        out << popindent << "}\n\n";
+
+        out << "static void write_ions(arb_mechanism_ppack* pp) {\n" << indent;
+        emit_body(write_ions_api);
+        out << popindent << "}\n\n";
+
+        if (net_receive_api) {
+            out << fmt::format(FMT_COMPILE("static void apply_events(arb_mechanism_ppack* pp, arb_deliverable_event_stream* events) {{\n"
+                                           "    PPACK_IFACE_BLOCK;\n"
+                                           "    auto ncell = events->n_streams;\n"
+                                           "    for (arb_size_type c = 0; c<ncell; ++c) {{\n"
+                                           "        auto begin  = events->events + events->begin[c];\n"
+                                           "        auto end    = events->events + events->end[c];\n"
+                                           "        for (auto p = begin; p<end; ++p) {{\n"
+                                           "            auto i_     = p->mech_index;\n"
+                                           "            auto {1} = p->weight;\n"
+                                           "            if (p->mech_id=={0}mechanism_id) {{\n"),
+                               pp_var_pfx,
+                               net_receive_api->args().empty() ? "weight" : net_receive_api->args().front()->is_argument()->name());
+            out << indent << indent << indent << indent;
+            emit_api_body(out, net_receive_api, false, false, false, nullptr, single_precision);
+            if (active_index) {
+                // An instance receiving an event becomes active.
+                out << "if (!pp->active_flag[i_]) {\n"
+                       "    pp->active_flag[i_] = 1;\n"
+                       "    pp->active_index[pp->n_active++] = i_;\n"
+                       "}\n";
+            }
+            out << popindent << "}\n" << popindent << "}\n" << popindent << "}\n" << popindent << "}\n\n";
         } else {
-            emit_procedure_proto(out, proc, ppack_name);
-            out << ";\n";
+            out << "static void apply_events(arb_mechanism_ppack*, arb_deliverable_event_stream*) {}\n\n";
         }
-    }
-    out << "\n"
-        << "// interface methods\n";
-    out << "static void init(arb_mechanism_ppack* pp) {\n" << indent;
-    emit_body(init_api);
-    if (init_api && init_api->body() && !init_api->body()->statements().empty()) {
-        auto n = std::count_if(vars.arrays.begin(), vars.arrays.end(),
-                               [] (const auto& v) { return v->is_state(); });
-        out << fmt::format(FMT_COMPILE("if (!{0}multiplicity) return;\n"
-                                       "for (arb_size_type ix = 0; ix < {1}; ++ix) {{\n"
-                                       "    for (arb_size_type iy = 0; iy < {0}width; ++iy) {{\n"
-                                       "        pp->state_vars[ix][iy] *= {0}multiplicity[iy];\n"
-                                       "    }}\n"
-                                       "}}\n"),
-                           pp_var_pfx,
-                           n);
-    }
-    out << popindent << "}\n\n";
-
-    out << "static void advance_state(arb_mechanism_ppack* pp) {\n" << indent;
-    out << profiler_enter("advance_integrate_state");
-    emit_body(state_api);
-    out << profiler_leave();
-    out << popindent << "}\n\n";
-
-    out << "static void compute_currents(arb_mechanism_ppack* pp) {\n" << indent;
-    out << profiler_enter("advance_integrate_current");
-    emit_body(current_api);
-    out << profiler_leave();
-    out << popindent << "}\n\n";
-
-    out << "static void write_ions(arb_mechanism_ppack* pp) {\n" << indent;
-    emit_body(write_ions_api);
-    out << popindent << "}\n\n";
-
-    if (net_receive_api) {
-        out << fmt::format(FMT_COMPILE("static void apply_events(arb_mechanism_ppack* pp, arb_deliverable_event_stream* events) {{\n"
-                                       "    PPACK_IFACE_BLOCK;\n"
-                                       "    auto ncell = events->n_streams;\n"
-                                       "    for (arb_size_type c = 0; c<ncell; ++c) {{\n"
-                                       "        auto begin  = events->events + events->begin[c];\n"
-                                       "        auto end    = events->events + events->end[c];\n"
-                                       "        for (auto p = begin; p<end; ++p) {{\n"
-                                       "            auto i_     = p->mech_index;\n"
-                                       "            auto {1} = p->weight;\n"
-                                       "            if (p->mech_id=={0}mechanism_id) {{\n"),
-                           pp_var_pfx,
-                           net_receive_api->args().empty() ? "weight" : net_receive_api->args().front()->is_argument()->name());
-        out << indent << indent << indent << indent;
-        emit_api_body(out, net_receive_api, false, false);
-        out << popindent << "}\n" << popindent << "}\n" << popindent << "}\n" << popindent << "}\n\n";
-    } else {
-        out << "static void apply_events(arb_mechanism_ppack*, arb_deliverable_event_stream*) {}\n\n";
-    }
-
-    if(post_event_api) {
-        const std::string time_arg = post_event_api->args().empty() ? "time" : post_event_api->args().front()->is_argument()->name();
-        out << fmt::format(FMT_COMPILE("static void post_event(arb_mechanism_ppack* pp) {{\n"
-                                       "    PPACK_IFACE_BLOCK;\n"
-                                       "    for (arb_size_type i_ = 0; i_ < {0}width; ++i_) {{\n"
-                                       "        auto node_index_i_ = {0}node_index[i_];\n"
-                                       "        auto cid_          = {0}vec_ci[node_index_i_];\n"
-                                       "        auto offset_       = {0}n_detectors * cid_;\n"
-                                       "        for (auto c = 0; c < {0}n_detectors; c++) {{\n"
-                                       "            auto {1} = {0}time_since_spike[offset_ + c];\n"
-                                       "            if ({1} >= 0) {{\n"),
-                           pp_var_pfx,
-                           time_arg);
-        out << indent << indent << indent << indent;
-        emit_api_body(out, post_event_api, false, false);
-        out << popindent << "}\n" << popindent << "}\n" << popindent << "}\n" << popindent << "}\n";
-    } else {
-        out << "static void post_event(arb_mechanism_ppack*) {}\n";
-    }
-
-    out << "\n// Procedure definitions\n";
-    for (auto proc: normal_procedures(module_)) {
-        if (with_simd) {
-            emit_simd_procedure_proto(out, proc, ppack_name);
-            auto simd_print = simdprint(proc->body(), vars.scalars);
-            out << " {\n"
-                << indent
-                << "PPACK_IFACE_BLOCK;\n"
-                << simd_print
-                << popindent
-                << "}\n\n";
 
-            emit_masked_simd_procedure_proto(out, proc, ppack_name);
-            auto masked_print = simdprint(proc->body(), vars.scalars);
-            masked_print.set_masked();
-            out << " {\n"
-                << indent
-                << "PPACK_IFACE_BLOCK;\n"
-                << masked_print
-                << popindent
-                << "}\n\n";
+        if(post_event_api) {
+            const std::string time_arg = post_event_api->args().empty() ? "time" : post_event_api->args().front()->is_argument()->name();
+            out << fmt::format(FMT_COMPILE("static void post_event(arb_mechanism_ppack* pp) {{\n"
+                                           "    PPACK_IFACE_BLOCK;\n"
+                                           "    for (arb_size_type i_ = 0; i_ < {0}width; ++i_) {{\n"
+                                           "        auto node_index_i_ = {0}node_index[i_];\n"
+                                           "        auto cid_          = {0}vec_ci[node_index_i_];\n"
+                                           "        for (auto c = {0}detector_divs[cid_]; c < {0}detector_divs[cid_+1]; c++) {{\n"
+                                           "            auto {1} = {0}time_since_spike[c];\n"
+                                           "            if ({1} >= 0) {{\n"),
+                               pp_var_pfx,
+                               time_arg);
+            out << indent << indent << indent << indent;
+            emit_api_body(out, post_event_api, false, false, false, nullptr, single_precision);
+            out << popindent << "}\n" << popindent << "}\n" << popindent << "}\n" << popindent << "}\n";
         } else {
-            emit_procedure_proto(out, proc, ppack_name);
-            out << " {\n" << indent
-                << "PPACK_IFACE_BLOCK;\n"
-                << cprint(proc->body())
-                << popindent << "}\n";
+            out << "static void post_event(arb_mechanism_ppack*) {}\n";
+        }
+
+        out << "\n// Procedure definitions\n";
+        for (auto proc: normal_procedures(module_)) {
+            if (with_simd) {
+                emit_simd_procedure_proto(out, proc, ppack_name);
+                auto simd_print = simdprint(proc->body(), vars.scalars);
+                out << " {\n"
+                    << indent
+                    << "PPACK_IFACE_BLOCK;\n"
+                    << simd_print
+                    << popindent
+                    << "}\n\n";
+
+                emit_masked_simd_procedure_proto(out, proc, ppack_name);
+                auto masked_print = simdprint(proc->body(), vars.scalars);
+                masked_print.set_masked();
+                out << " {\n"
+                    << indent
+                    << "PPACK_IFACE_BLOCK;\n"
+                    << masked_print
+                    << popindent
+                    << "}\n\n";
+            } else {
+                emit_procedure_proto(out, proc, ppack_name, "", single_precision);
+                out << " {\n" << indent
+                    << "PPACK_IFACE_BLOCK;\n"
+                    << cprint(proc->body(), {}, single_precision)
+                    << popindent << "}\n";
+            }
         }
+    };
+
+    emit_kernels(false);
+    if (uniform_kernels) {
+        out << "#undef PPACK_IFACE_BLOCK\n"
+               "\n"
+               "namespace uniform_parameters {\n"
+               "\n"
+               "// Parameter with the same value for all instances.\n"
+               "struct uniform_parameter_ {\n"
+               "    arb_value_type value;\n"
+               "    arb_value_type operator[](arb_size_type) const { return value; }\n"
+               "};\n"
+               "\n";
+        emit_kernels(true);
+        out << "} // namespace uniform_parameters\n";
     }
 
     out << popindent
@@ -442,17 +591,30 @@ std::string emit_cpp_source(const Module& module_, const printer_options& opt) {
                                    "    result.alignment=1;\n"
                                    "    result.init_mechanism=(arb_mechanism_method){3}init;\n"
                                    "    result.compute_currents=(arb_mechanism_method){3}compute_currents;\n"
-                                   "    result.apply_events=(arb_mechanism_method){3}apply_events;\n"
+                                   "    result.apply_events=(arb_mechanism_method_events){3}apply_events;\n"
                                    "    result.advance_state=(arb_mechanism_method){3}advance_state;\n"
                                    "    result.write_ions=(arb_mechanism_method){3}write_ions;\n"
-                                   "    result.post_event=(arb_mechanism_method){3}post_event;\n"
-                                   "    return &result;\n"
-                                   "  }}"
-                                   "}}\n\n"),
+                                   "    result.post_event=(arb_mechanism_method){3}post_event;\n"),
                        std::regex_replace(opt.cpp_namespace, std::regex{"::"}, "_"),
                        name,
                        "arb_backend_kind_cpu",
                        ss.str());
+    if (uniform_kernels) {
+        out << fmt::format(FMT_COMPILE("    static arb_mechanism_interface uniform;\n"
+                                       "    uniform = result;\n"
+                                       "    uniform.uniform_parameters=nullptr;\n"
+                                       "    uniform.init_mechanism=(arb_mechanism_method){0}init;\n"
+                                       "    uniform.compute_currents=(arb_mechanism_method){0}compute_currents;\n"
+                                       "    uniform.apply_events=(arb_mechanism_method_events){0}apply_events;\n"
+                                       "    uniform.advance_state=(arb_mechanism_method){0}advance_state;\n"
+                                       "    uniform.write_ions=(arb_mechanism_method){0}write_ions;\n"
+                                       "    uniform.post_event=(arb_mechanism_method){0}post_event;\n"
+                                       "    result.uniform_parameters=&uniform;\n"),
+                           ss.str() + "uniform_parameters::");
+    }
+    out << "    return &result;\n"
+           "  }"
+           "}\n\n";
 
     EXIT(out);
     return out.str();
@@ -482,13 +644,25 @@ void CPrinter::visit(CallExpression* e) {
     out_ << ")";
 }
 
+// Pure locals other than those assigned by hoisted statements.
+static std::vector<LocalVariable*> unhoisted_locals(scope_ptr scope, const std::unordered_set<Expression*>& hoisted) {
+    std::unordered_set<std::string> names;
+    for (auto s: hoisted) names.insert(s->is_assignment()->lhs()->is_identifier()->name());
+
+    std::vector<LocalVariable*> locals;
+    for (auto local: pure_locals(scope)) {
+        if (!names.count(local->name())) locals.push_back(local);
+    }
+    return locals;
+}
+
 void CPrinter::visit(BlockExpression* block) {
     ENTERM(out_, "c:block");
     // Only include local declarations in outer-most block.
     if (!block->is_nested()) {
-        auto locals = pure_locals(block->scope());
+        auto locals = unhoisted_locals(block->scope(), hoisted_);
         if (!locals.empty()) {
-            out_ << "arb_value_type ";
+            out_ << (single_precision_? "float ": "arb_value_type ");
             io::separator sep(", ");
             for (auto local: locals) {
                 out_ << sep << local->name();
@@ -498,7 +672,7 @@ void CPrinter::visit(BlockExpression* block) {
     }
 
     for (auto& stmt: block->statements()) {
-        if (!stmt->is_local_declaration()) {
+        if (!stmt->is_local_declaration() && !hoisted_.count(stmt.get())) {
             stmt->accept(this);
             out_ << (stmt->is_if()? "": ";\n");
         }
@@ -510,10 +684,10 @@ static std::string index_i_name(const std::string& index_var) {
     return index_var+"i_";
 }
 
-void emit_procedure_proto(std::ostream& out, ProcedureExpression* e, const std::string& ppack_name, const std::string& qualified) {
+void emit_procedure_proto(std::ostream& out, ProcedureExpression* e, const std::string& ppack_name, const std::string& qualified, bool single_precision) {
     out << "static void " << qualified << (qualified.empty()? "": "::") << e->name() << "(" << ppack_name << "* pp, int i_";
     for (auto& arg: e->args()) {
-        out << ", arb_value_type " << arg->is_argument()->name();
+        out << (single_precision? ", float ": ", arb_value_type ") << arg->is_argument()->name();
     }
     out << ")";
 }
@@ -558,9 +732,9 @@ std::list<index_prop> gather_indexed_vars(const std::vector<LocalVariable*>& ind
     return indices;
 }
 
-void emit_state_read(std::ostream& out, LocalVariable* local) {
+void emit_state_read(std::ostream& out, LocalVariable* local, bool single_precision = false) {
     ENTER(out);
-    out << "arb_value_type " << cprint(local) << " = ";
+    out << (single_precision? "float ": "arb_value_type ") << cprint(local) << " = ";
 
     if (local->is_read()) {
         auto d = decode_indexed_variable(local->external_variable());
@@ -593,31 +767,330 @@ void emit_state_update(std::ostream& out, Symbol* from, IndexedVariable* externa
     EXIT(out);
 }
 
-void emit_api_body(std::ostream& out, APIMethod* method, bool cv_loop, bool ppack_iface) {
+static std::string rate_table_name(APIMethod* method) {
+    return "rate_table_" + method->name();
+}
+
+// Table builder for a method: replays the hoisted statements for a given
+// voltage and stores the table fields.
+void emit_rate_table(std::ostream& out, APIMethod* method, const rate_table_plan& plan, double tolerance) {
+    out << "static const ::arb::rate_table& " << rate_table_name(method) << "() {\n" << indent
+        << "static const auto table = ::arb::make_rate_table(" << plan.fields.size()
+        << ", -150.0, 100.0, " << as_c_double(tolerance) << ",\n" << indent
+        << "[](arb_value_type " << plan.v->name() << ", arb_value_type* r_) {\n" << indent;
+
+    out << "arb_value_type ";
+    io::separator sep(", ");
+    for (auto stmts: {&plan.constants, &plan.tabulated}) {
+        for (auto stmt: *stmts) out << sep << cprint(stmt->is_assignment()->lhs());
+    }
+    out << ";\n";
+    for (auto stmts: {&plan.constants, &plan.tabulated}) {
+        for (auto stmt: *stmts) out << cprint(stmt) << ";\n";
+    }
+    for (std::size_t j = 0; j<plan.fields.size(); ++j) {
+        out << "r_[" << j << "] = " << plan.fields[j]->name() << ";\n";
+    }
+    out << popindent << "});\n" << popindent
+        << "return table;\n"
+        << popindent << "}\n\n";
+}
+
+// Method body with the tabulated statements replaced by interpolation, if the
+// voltage is within the table; compare CPrinter::visit(BlockExpression*).
+static void emit_tabulated_body(std::ostream& out, BlockExpression* body, const rate_table_plan& plan,
+                                const std::vector<AssignmentExpression*>& invariants) {
+    std::unordered_set<Expression*> hoisted(invariants.begin(), invariants.end());
+    auto locals = unhoisted_locals(body->scope(), hoisted);
+    if (!locals.empty()) {
+        out << "arb_value_type ";
+        io::separator sep(", ");
+        for (auto local: locals) out << sep << local->name();
+        out << ";\n";
+    }
+
+    for (auto stmt: plan.constants) out << cprint(stmt) << ";\n";
+
+    auto width = plan.fields.size();
+    out << "{\n" << indent
+        << "arb_value_type tx_ = (" << plan.v->name() << " - rate_table_.vmin)*rate_table_.inv_dv;\n"
+        << "if (tx_>=0 && tx_<rate_table_.n) {\n" << indent
+        << "auto tk_ = (arb_size_type)tx_;\n"
+        << "arb_value_type tu_ = tx_ - tk_;\n"
+        << "const arb_value_type* tr_ = rate_table_.data.data() + tk_*" << width << ";\n";
+    for (std::size_t j = 0; j<width; ++j) {
+        out << fmt::format("{} = tr_[{}] + tu_*(tr_[{}] - tr_[{}]);\n", plan.fields[j]->name(), j, j+width, j);
+    }
+    out << popindent << "}\n"
+        << "else {\n" << indent;
+    for (auto stmt: plan.tabulated) out << cprint(stmt) << ";\n";
+    out << popindent << "}\n"
+        << popindent << "}\n";
+
+    for (auto& stmt: body->statements()) {
+        if (!stmt->is_local_declaration() && !plan.is_hoisted(stmt.get()) && !hoisted.count(stmt.get())) {
+            out << cprint(stmt.get()) << (stmt->is_if()? "": ";\n");
+        }
+    }
+}
+
+void emit_api_body(std::ostream& out, APIMethod* method, bool cv_loop, bool ppack_iface, bool active_only, const rate_table_plan* table, bool single_precision) {
     ENTER(out);
     auto body = method->body();
     auto indexed_vars = indexed_locals(method->scope());
 
     std::list<index_prop> indices = gather_indexed_vars(indexed_vars, "i_");
+    auto invariants = loop_invariant_prefix(body);
+    if (table) {
+        invariants.erase(std::remove_if(invariants.begin(), invariants.end(), [table](auto s) { return table->is_hoisted(s); }),
+                         invariants.end());
+    }
     if (!body->statements().empty()) {
         ppack_iface && out << "PPACK_IFACE_BLOCK;\n";
-        cv_loop && out << fmt::format("for (arb_size_type i_ = 0; i_ < {}width; ++i_) {{\n", pp_var_pfx)
-                        << indent;
-        for (auto index: indices) {
-            out << "auto " << source_index_i_name(index) << " = " << source_var(index) << "[" << index.index_name << "];\n";
+        table && out << "const auto& rate_table_ = " << rate_table_name(method) << "();\n";
+        for (auto s: invariants) {
+            out << "const arb_value_type " << s->lhs()->is_identifier()->name() << " = " << cprint(s->rhs()) << ";\n";
         }
+        // If `direct` is set, the per-instance indices are contiguous and
+        // computed from their first entry instead of being gathered.
+        auto emit_loop = [&](bool direct) {
+            if (cv_loop && active_only) {
+                out << "for (arb_size_type k_ = 0; k_ < pp->n_active; ++k_) {\n"
+                    << indent
+                    << "auto i_ = pp->active_index[k_];\n";
+            }
+            else if (cv_loop) {
+                out << fmt::format("for (arb_size_type i_ = 0; i_ < {}width; ++i_) {{\n", pp_var_pfx)
+                    << indent;
+            }
+            for (auto index: indices) {
+                out << "auto " << source_index_i_name(index) << " = ";
+                if (direct && index.index_name=="i_") {
+                    out << index.source_var << "0_ + i_;\n";
+                }
+                else {
+                    out << source_var(index) << "[" << index.index_name << "];\n";
+                }
+            }
 
-        for (auto& sym: indexed_vars) {
+            for (auto& sym: indexed_vars) {
+                emit_state_read(out, sym, single_precision);
+            }
+            if (table) {
+                emit_tabulated_body(out, body, *table, invariants);
+            }
+            else {
+                out << cprint(body, invariants, single_precision);
+            }
+
+            for (auto& sym: indexed_vars) {
+                emit_state_update(out, sym, sym->external_variable());
+            }
+            cv_loop && out << popindent << "}\n";
+        };
+
+        auto gathered = std::count_if(indices.begin(), indices.end(), [](const auto& i) { return i.index_name=="i_"; });
+        if (cv_loop && gathered) {
+            out << "if (pp->index_contiguous) {\n" << indent;
+            for (auto index: indices) {
+                if (index.index_name!="i_") continue;
+                out << "const arb_index_type " << index.source_var << "0_ = " << source_var(index) << "[0];\n";
+            }
+            emit_loop(true);
+            out << popindent << "}\n"
+                << "else {\n" << indent;
+            emit_loop(false);
+            out << popindent << "}\n";
+        }
+        else {
+            emit_loop(false);
+        }
+    }
+    EXIT(out);
+}
+
+// Fused current kernels over several mechanisms:
+
+// Per-instance current contribution of one bundle member. Voltage is passed
+// in; current and conductivity are accumulated into the caller's sums.
+static void emit_bundle_member_body(std::ostream& out, APIMethod* method) {
+    ENTER(out);
+    auto body = method->body();
+    auto indexed_vars = indexed_locals(method->scope());
+
+    auto is_shared = [](const indexed_variable_info& d) {
+        return d.node_index_var=="node_index" && (d.data_var=="vec_v" || d.data_var=="vec_i" || d.data_var=="vec_g");
+    };
+
+    out << "PPACK_IFACE_BLOCK;\n";
+    for (auto index: gather_indexed_vars(indexed_vars, "i_")) {
+        if (index.source_var=="node_index") continue;
+        out << "auto " << source_index_i_name(index) << " = " << source_var(index) << "[" << index.index_name << "];\n";
+    }
+
+    for (auto& sym: indexed_vars) {
+        auto d = decode_indexed_variable(sym->external_variable());
+        if (!is_shared(d)) {
             emit_state_read(out, sym);
         }
-        out << cprint(body);
+        else if (d.data_var=="vec_v" && sym->is_read()) {
+            out << "arb_value_type " << cprint(sym) << " = " << scaled(d.scale) << "vm_;\n";
+        }
+        else {
+            out << "arb_value_type " << cprint(sym) << " = 0;\n";
+        }
+    }
+    out << cprint(body);
+
+    for (auto& sym: indexed_vars) {
+        auto external = sym->external_variable();
+        auto d = decode_indexed_variable(external);
+        if (!is_shared(d)) {
+            emit_state_update(out, sym, external);
+        }
+        else if (external->is_write()) {
+            auto acc = d.data_var=="vec_i"? "i_acc_": "g_acc_";
+            out << acc << " = fma(" << scaled(1./d.scale) << pp_var_pfx << "weight[i_], " << sym->name() << ", " << acc << ");\n";
+        }
+    }
+    EXIT(out);
+}
+
+std::string emit_cpp_bundle_source(const std::string& name, const std::vector<const Module*>& modules, const printer_options& opt) {
+    auto namespace_name = "kernel_" + name + "_bundle";
+    auto ppack_name     = "arb_mechanism_ppack";
+    auto ns_components  = namespace_components(opt.cpp_namespace);
+
+    if (opt.simd.abi!=simd_spec::none) {
+        throw compiler_exception(std::string("mechanism bundles are generated for scalar code only"));
+    }
+
+    options_trace_codegen = opt.trace_codegen;
+
+    io::pfxstringstream out;
+
+    ENTER(out);
+    out <<
+        "#include <algorithm>\n"
+        "#include <cmath>\n"
+        "#include <cstddef>\n"
+        "#include <memory>\n"
+        "#include <"  << arb_header_prefix() << "mechanism_abi.h>\n"
+        "#include <" << arb_header_prefix() << "math.hpp>\n";
+
+    opt.profile &&
+        out << "#include <" << arb_header_prefix() << "profile/profiler.hpp>\n";
+
+    out <<"\n"
+        << namespace_declaration_open(ns_components)
+        << "namespace " << namespace_name << " {\n"
+        << "\n"
+        "using ::arb::math::exprelr;\n"
+        "using ::arb::math::safeinv;\n"
+        "using ::std::abs;\n"
+        "using ::std::cos;\n"
+        "using ::std::exp;\n"
+        "using ::std::log;\n"
+        "using ::std::max;\n"
+        "using ::std::min;\n"
+        "using ::std::pow;\n"
+        "using ::std::sin;\n"
+        "\n"
+        "static constexpr unsigned simd_width_ = 0;\n\n";
+
+    for (auto m: modules) {
+        if (m->kind()!=moduleKind::density) {
+            throw compiler_exception("mechanism bundle member "+m->module_name()+" is not a density mechanism");
+        }
+
+        APIMethod* current_api = find_api_method(*m, "compute_currents");
+        assert_has_scope(current_api, "compute_currents");
+
+        auto vars = local_module_variables(*m);
+        out << "namespace mech_" << m->module_name() << " {\n\n";
+        emit_ppack_iface_block(out, *m, vars);
 
-        for (auto& sym: indexed_vars) {
-            emit_state_update(out, sym, sym->external_variable());
+        out << "// procedure prototypes\n";
+        for (auto proc: normal_procedures(*m)) {
+            emit_procedure_proto(out, proc, ppack_name);
+            out << ";\n";
         }
-        cv_loop && out << popindent << "}\n";
+
+        out << "\n"
+               "static inline void compute_currents(arb_mechanism_ppack* pp, arb_size_type i_, [[maybe_unused]] arb_index_type node_indexi_, "
+               "arb_value_type vm_, arb_value_type& i_acc_, arb_value_type& g_acc_) {\n" << indent;
+        emit_bundle_member_body(out, current_api);
+        out << popindent << "}\n";
+
+        out << "\n// Procedure definitions\n";
+        for (auto proc: normal_procedures(*m)) {
+            emit_procedure_proto(out, proc, ppack_name);
+            out << " {\n" << indent
+                << "PPACK_IFACE_BLOCK;\n"
+                << cprint(proc->body())
+                << popindent << "}\n";
+        }
+        out << "#undef PPACK_IFACE_BLOCK\n"
+            << "} // namespace mech_" << m->module_name() << "\n\n";
+    }
+
+    out << "static void compute_currents(arb_mechanism_ppack** pp, arb_size_type) {\n" << indent;
+    if (opt.profile) {
+        static std::regex invalid_profile_chars("[^a-zA-Z0-9]");
+        out << "{\n"
+               "    static auto id = ::arb::profile::profiler_region_id(\"advance_integrate_current_"
+            << std::regex_replace(name, invalid_profile_chars, "") << "\");\n"
+               "    ::arb::profile::profiler_enter(id);\n"
+               "}\n";
+    }
+    out << "auto  width      = pp[0]->width;\n"
+           "auto* node_index = pp[0]->node_index;\n"
+           "auto* vec_v      = pp[0]->vec_v;\n"
+           "auto* vec_i      = pp[0]->vec_i;\n"
+           "auto* vec_g      = pp[0]->vec_g;\n"
+           "for (arb_size_type i_ = 0; i_ < width; ++i_) {\n" << indent
+        << "auto node_indexi_ = node_index[i_];\n"
+           "arb_value_type vm_ = vec_v[node_indexi_];\n"
+           "arb_value_type i_acc_ = 0, g_acc_ = 0;\n";
+    for (std::size_t k = 0; k < modules.size(); ++k) {
+        out << "mech_" << modules[k]->module_name() << "::compute_currents(pp[" << k << "], i_, node_indexi_, vm_, i_acc_, g_acc_);\n";
     }
+    out << "vec_i[node_indexi_] += i_acc_;\n"
+           "vec_g[node_indexi_] += g_acc_;\n"
+        << popindent << "}\n";
+    opt.profile && out << "::arb::profile::profiler_leave();\n";
+    out << popindent << "}\n\n";
+
+    out << "} // namespace " << namespace_name << "\n"
+        << namespace_declaration_close(ns_components)
+        << "\n";
+
+    std::stringstream ss;
+    for (const auto& c: ns_components) ss << c << "::";
+    ss << namespace_name << "::";
+
+    std::stringstream members;
+    for (auto m: modules) members << '"' << m->module_name() << "\", ";
+
+    out << fmt::format(FMT_COMPILE("extern \"C\" {{\n"
+                                   "  arb_mechanism_bundle_interface* make_{0}_{1}_bundle_interface_multicore() {{\n"
+                                   "    static const char* members[] = {{ {2}}};\n"
+                                   "    static arb_mechanism_bundle_interface result;\n"
+                                   "    result.backend=arb_backend_kind_cpu;\n"
+                                   "    result.members=members;\n"
+                                   "    result.n_members={3};\n"
+                                   "    result.compute_currents=(arb_mechanism_bundle_method){4}compute_currents;\n"
+                                   "    return &result;\n"
+                                   "  }}"
+                                   "}}\n\n"),
+                       std::regex_replace(opt.cpp_namespace, std::regex{"::"}, "_"),
+                       name,
+                       members.str(),
+                       modules.size(),
+                       ss.str());
+
     EXIT(out);
+    return out.str();
 }
 
 // SIMD printing:
@@ -714,7 +1187,7 @@ void SimdPrinter::visit(BlockExpression* block) {
     // Only include local declarations in outer-most block.
     ENTERM(out_, "block");
     if (!block->is_nested()) {
-        auto locals = pure_locals(block->scope());
+        auto locals = unhoisted_locals(block->scope(), hoisted_);
         if (!locals.empty()) {
             out_ << "simd_value ";
             io::separator sep(", ");
@@ -726,7 +1199,7 @@ void SimdPrinter::visit(BlockExpression* block) {
     }
 
     for (auto& stmt: block->statements()) {
-        if (!stmt->is_local_declaration()) {
+        if (!stmt->is_local_declaration() && !hoisted_.count(stmt.get())) {
             stmt->accept(this);
             if (!stmt->is_if() && !stmt->is_block()) {
                 out_ << ";\n";
@@ -802,7 +1275,9 @@ void emit_simd_state_read(std::ostream& out, LocalVariable* local, simd_expr_con
     EXIT(out);
 }
 
-void emit_simd_state_update(std::ostream& out, Symbol* from, IndexedVariable* external, simd_expr_constraint constraint) {
+// With `masked`, writes to contiguous data are restricted to the lanes in
+// `tail_mask_`, for the partial last chunk of instances.
+void emit_simd_state_update(std::ostream& out, Symbol* from, IndexedVariable* external, simd_expr_constraint constraint, bool masked = false) {
     if (!external->is_write()) return;
 
     auto d = decode_indexed_variable(external);
@@ -827,7 +1302,12 @@ void emit_simd_state_update(std::ostream& out, Symbol* from, IndexedVariable* ex
                     } else {
                         out << tempvar << " = S::fma(w_, " << from->name() << ", " << tempvar << ");\n";
                     }
-                    out << "indirect(" << data_via_ppack(d) << " + " << node_index_i_name(d) << ", simd_width_) = " << tempvar << ";\n";
+                    out << "indirect(" << data_via_ppack(d) << " + " << node_index_i_name(d) << ", simd_width_) = ";
+                    if (masked) {
+                        out << "S::where(tail_mask_, " << tempvar << ");\n";
+                    } else {
+                        out << tempvar << ";\n";
+                    }
                     break;
                 }
                 case simd_expr_constraint::constant:
@@ -860,10 +1340,12 @@ void emit_simd_state_update(std::ostream& out, Symbol* from, IndexedVariable* ex
         }
     }
     else {
+        bool masked_store = false;
         if (d.cell_index_var.empty()) {
             switch (constraint) {
                 case simd_expr_constraint::contiguous:
                     out << "indirect(" << data_via_ppack(d) << " + " << node_index_i_name(d) << ", simd_width_) = ";
+                    masked_store = masked;
                     break;
                 case simd_expr_constraint::constant:
                     out << "indirect(" << data_via_ppack(d) << ", simd_cast<simd_index>(" << node_index_i_name(d) << "), simd_width_, constraint_category_) = ";
@@ -879,11 +1361,13 @@ void emit_simd_state_update(std::ostream& out, Symbol* from, IndexedVariable* ex
                 << ", " << index_i_name(d.cell_index_var) << ", simd_width_, index_constraint::none) = ";
         }
 
+        masked_store && out << "S::where(tail_mask_, ";
         if (coeff != 1) {
-            out << "(S::mul(simd_cast<simd_value>(" << as_c_double(coeff) << ")," << from->name() << "));\n";
+            out << "(S::mul(simd_cast<simd_value>(" << as_c_double(coeff) << ")," << from->name() << "))";
         } else {
-            out << from->name() << ";\n";
+            out << from->name();
         }
+        out << (masked_store? ");\n": ";\n");
     }
 
     EXIT(out);
@@ -930,7 +1414,8 @@ void emit_simd_body_for_loop(
         const std::vector<LocalVariable*>& indexed_vars,
         const std::vector<VariableExpression*>& scalars,
         const std::list<index_prop>& indices,
-        const simd_expr_constraint& constraint) {
+        const simd_expr_constraint& constraint,
+        bool masked = false) {
     ENTER(out);
     emit_simd_index_initialize(out, indices, constraint);
 
@@ -940,11 +1425,12 @@ void emit_simd_body_for_loop(
 
     simdprint printer(body, scalars);
     printer.set_indirect_index();
+    printer.set_hoisted(loop_invariant_prefix(body));
 
     out << printer;
 
     for (auto& sym: indexed_vars) {
-        emit_simd_state_update(out, sym, sym->external_variable(), constraint);
+        emit_simd_state_update(out, sym, sym->external_variable(), constraint, masked);
     }
     EXIT(out);
 }
@@ -957,21 +1443,60 @@ void emit_simd_for_loop_per_constraint(std::ostream& out, BlockExpression* body,
                                   const simd_expr_constraint& constraint,
                                   std::string underlying_constraint_name) {
     ENTER(out);
-    out << fmt::format("constraint_category_ = index_constraint::{1};\n"
-                       "for (auto i_ = 0ul; i_ < {0}index_constraints.n_{1}; i_++) {{\n"
-                       "    arb_index_type index_ = {0}index_constraints.{1}[i_];\n",
-                       pp_var_pfx,
-                       underlying_constraint_name)
-        << indent;
-    if (requires_weight) {
-        out << fmt::format("simd_value w_;\n"
-                           "assign(w_, indirect(({}weight+index_), simd_width_));\n",
-                           pp_var_pfx);
-    }
-
-    emit_simd_body_for_loop(out, body, indexed_vars, scalars, indices, constraint);
+    auto emit_weight = [&]() {
+        if (requires_weight) {
+            out << fmt::format("simd_value w_;\n"
+                               "assign(w_, indirect(({}weight+index_), simd_width_));\n",
+                               pp_var_pfx);
+        }
+    };
 
-    out << popindent << "}\n";
+    // Reads from the padded lanes of the last contiguous chunk stay within
+    // the CVs, but the chunk may extend past the instances into CVs that
+    // belong to other mechanisms: its writes are masked.
+    bool masked_tail = constraint==simd_expr_constraint::contiguous &&
+        std::any_of(indexed_vars.begin(), indexed_vars.end(),
+                    [](auto sym) { return sym->external_variable()->is_write(); });
+
+    if (!masked_tail) {
+        out << fmt::format("constraint_category_ = index_constraint::{1};\n"
+                           "for (auto i_ = 0ul; i_ < {0}index_constraints.n_{1}; i_++) {{\n"
+                           "    arb_index_type index_ = {0}index_constraints.{1}[i_];\n",
+                           pp_var_pfx,
+                           underlying_constraint_name)
+            << indent;
+        emit_weight();
+        emit_simd_body_for_loop(out, body, indexed_vars, scalars, indices, constraint);
+        out << popindent << "}\n";
+    }
+    else {
+        out << fmt::format("constraint_category_ = index_constraint::{1};\n"
+                           "{{\n"
+                           "    arb_size_type n_contiguous_ = {0}index_constraints.n_{1};\n"
+                           "    bool tail_ = n_contiguous_ && {0}index_constraints.{1}[n_contiguous_-1] + simd_width_ > {0}width;\n"
+                           "    for (auto i_ = 0ul; i_ < n_contiguous_ - tail_; i_++) {{\n"
+                           "        arb_index_type index_ = {0}index_constraints.{1}[i_];\n",
+                           pp_var_pfx,
+                           underlying_constraint_name)
+            << indent << indent;
+        emit_weight();
+        emit_simd_body_for_loop(out, body, indexed_vars, scalars, indices, constraint);
+        out << popindent << "}\n";
+        out << fmt::format("if (tail_) {{\n"
+                           "    arb_index_type index_ = {0}index_constraints.{1}[n_contiguous_-1];\n"
+                           "    arb_value_type tail_lanes_[simd_width_];\n"
+                           "    for (unsigned tail_k_ = 0; tail_k_ < simd_width_; ++tail_k_) tail_lanes_[tail_k_] = tail_k_;\n"
+                           "    simd_value tail_lane_;\n"
+                           "    assign(tail_lane_, indirect(tail_lanes_, simd_width_));\n"
+                           "    simd_mask tail_mask_ = S::cmp_lt(tail_lane_, simd_cast<simd_value>((arb_value_type)({0}width - index_)));\n",
+                           pp_var_pfx,
+                           underlying_constraint_name)
+            << indent;
+        emit_weight();
+        emit_simd_body_for_loop(out, body, indexed_vars, scalars, indices, constraint, true);
+        out << popindent << "}\n"
+            << popindent << "}\n";
+    }
     EXIT(out);
 }
 
@@ -1004,6 +1529,9 @@ void emit_simd_api_body(std::ostream& out, APIMethod* method, const std::vector<
     if (!body->statements().empty()) {
         out << "PPACK_IFACE_BLOCK;\n";
         out << "assert(simd_width_ <= (unsigned)S::width(simd_cast<simd_value>(0)));\n";
+        for (auto s: loop_invariant_prefix(body)) {
+            out << "const arb_value_type " << s->lhs()->is_identifier()->name() << " = " << cprint(s->rhs()) << ";\n";
+        }
         if (!indices.empty()) {
             out << "index_constraint constraint_category_;\n\n";
 
@@ -1038,10 +1566,12 @@ void emit_simd_api_body(std::ostream& out, APIMethod* method, const std::vector<
                 emit_simd_state_read(out, sym, simd_expr_constraint::other);
             }
 
+            simdprint printer(body, scalars);
+            printer.set_hoisted(loop_invariant_prefix(body));
             out << fmt::format("for (arb_size_type i_ = 0; i_ < {}width; i_ += simd_width_) {{\n",
                                pp_var_pfx)
                 << indent
-                << simdprint(body, scalars)
+                << printer
                 << popindent
                 <<
                 "}\n";
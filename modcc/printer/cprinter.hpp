@@ -2,6 +2,8 @@
 
 #include <iosfwd>
 #include <string>
+#include <unordered_set>
+#include <vector>
 
 #include "module.hpp"
 #include "visitor.hpp"
@@ -11,16 +13,26 @@
 
 std::string emit_cpp_source(const Module& m, const printer_options& opt);
 
+// Fused compute_currents over several density mechanisms that share their CVs.
+std::string emit_cpp_bundle_source(const std::string& name, const std::vector<const Module*>& modules, const printer_options& opt);
+
 // CPrinter and SimdPrinter visitors exposed in header for testing purposes only.
 
 class CPrinter: public Visitor {
 public:
-    CPrinter(std::ostream& out): out_(out) {}
+    CPrinter(std::ostream& out, bool single_precision = false):
+        out_(out), single_precision_(single_precision) {}
 
     void visit(Expression* e) override {
         throw compiler_exception("CPrinter cannot translate expression "+e->to_string());
     }
 
+    // Omit statements evaluated ahead of the loop over instances from the
+    // outer-most block, together with the declarations of their locals.
+    void set_hoisted(const std::vector<AssignmentExpression*>& hoisted) {
+        hoisted_ = {hoisted.begin(), hoisted.end()};
+    }
+
     void visit(BlockExpression*) override;
     void visit(CallExpression*) override;
     void visit(IdentifierExpression*) override;
@@ -28,13 +40,16 @@ public:
     void visit(LocalVariable*) override;
 
     // Delegate low-level emits to cexpr_emit:
-    void visit(NumberExpression* e) override { cexpr_emit(e, out_, this); }
-    void visit(UnaryExpression* e) override { cexpr_emit(e, out_, this); }
-    void visit(BinaryExpression* e) override { cexpr_emit(e, out_, this); }
-    void visit(IfExpression* e) override { cexpr_emit(e, out_, this); }
+    void visit(NumberExpression* e) override { cexpr_emit(e, out_, this, single_precision_); }
+    void visit(UnaryExpression* e) override { cexpr_emit(e, out_, this, single_precision_); }
+    void visit(BinaryExpression* e) override { cexpr_emit(e, out_, this, single_precision_); }
+    void visit(IfExpression* e) override { cexpr_emit(e, out_, this, single_precision_); }
 
 protected:
     std::ostream& out_;
+    // Declare locals and emit literals as float rather than arb_value_type.
+    bool single_precision_ = false;
+    std::unordered_set<Expression*> hoisted_;
 };
 
 
@@ -60,6 +75,11 @@ public:
     void save_scalar_names(const std::unordered_set<std::string>& scalars) {
         scalars_ = scalars;
     }
+    // As for CPrinter; the locals of hoisted statements are scalars.
+    void set_hoisted(const std::vector<AssignmentExpression*>& hoisted) {
+        hoisted_ = {hoisted.begin(), hoisted.end()};
+        for (auto s: hoisted) scalars_.insert(s->lhs()->is_identifier()->name());
+    }
 
     void visit(BlockExpression*) override;
     void visit(CallExpression*) override;
@@ -78,4 +98,5 @@ private:
     std::string input_mask_;
     bool is_indirect_ = false;
     std::unordered_set<std::string> scalars_;
+    std::unordered_set<Expression*> hoisted_;
 };
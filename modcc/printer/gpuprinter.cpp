@@ -20,19 +20,21 @@ using io::indent;
 using io::popindent;
 using io::quote;
 
-void emit_api_body_cu(std::ostream& out, APIMethod* method, bool is_point_proc, bool cv_loop = true, bool ppack=true);
+void emit_api_body_cu(std::ostream& out, APIMethod* method, bool is_point_proc, bool single_precision, bool cv_loop = true, bool ppack=true);
 void emit_procedure_body_cu(std::ostream& out, ProcedureExpression* proc);
-void emit_state_read_cu(std::ostream& out, LocalVariable* local);
-void emit_state_update_cu(std::ostream& out, Symbol* from, IndexedVariable* external, bool is_point_proc);
+void emit_state_read_cu(std::ostream& out, LocalVariable* local, bool single_precision);
+void emit_state_update_cu(std::ostream& out, Symbol* from, IndexedVariable* external, bool is_point_proc, bool single_precision);
 
 const char* index_id(Symbol *s);
 
 struct cuprint {
     Expression* expr_;
-    explicit cuprint(Expression* expr): expr_(expr) {}
+    bool single_precision_;
+    explicit cuprint(Expression* expr, bool single_precision = false):
+        expr_(expr), single_precision_(single_precision) {}
 
     friend std::ostream& operator<<(std::ostream& out, const cuprint& w) {
-        GpuPrinter printer(out);
+        GpuPrinter printer(out, w.single_precision_);
         return w.expr_->accept(&printer), out;
     }
 };
@@ -42,6 +44,12 @@ static std::string make_ppack_name(const std::string& module_name) { return make
 static std::string ion_field(const IonDep& ion) { return fmt::format("ion_{}",       ion.name); }
 static std::string ion_index(const IonDep& ion) { return fmt::format("ion_{}_index", ion.name); }
 
+// A parameter that no kernel writes, and so can be loaded through the
+// read-only data cache.
+static bool is_readonly_parameter(const VariableExpression* v) {
+    return !v->is_state() && !v->is_writeable();
+}
+
 
 std::string emit_gpu_cpp_source(const Module& module_, const printer_options& opt) {
     std::string name       = module_.module_name();
@@ -76,7 +84,7 @@ std::string emit_gpu_cpp_source(const Module& module_, const printer_options& op
                                    "    result.alignment=1;\n"
                                    "    result.init_mechanism=(arb_mechanism_method){3}{0}_init_;\n"
                                    "    result.compute_currents=(arb_mechanism_method){3}{0}_compute_currents_;\n"
-                                   "    result.apply_events=(arb_mechanism_method){3}{0}_apply_events_;\n"
+                                   "    result.apply_events=(arb_mechanism_method_events){3}{0}_apply_events_;\n"
                                    "    result.advance_state=(arb_mechanism_method){3}{0}_advance_state_;\n"
                                    "    result.write_ions=(arb_mechanism_method){3}{0}_write_ions_;\n"
                                    "    result.post_event=(arb_mechanism_method){3}{0}_post_event_;\n"
@@ -99,6 +107,8 @@ std::string emit_gpu_cu_source(const Module& module_, const printer_options& opt
     auto ns_components = namespace_components(opt.cpp_namespace);
 
     const bool is_point_proc = module_.kind() == moduleKind::point;
+    const bool single_precision = opt.gpu_single_precision;
+    const char* arg_type = single_precision? "float": "arb_value_type";
 
     APIMethod* net_receive_api = find_api_method(module_, "net_rec_api");
     APIMethod* post_event_api  = find_api_method(module_, "post_event_api");
@@ -123,25 +133,25 @@ std::string emit_gpu_cu_source(const Module& module_, const printer_options& opt
     out << "\n" << namespace_declaration_open(ns_components) << "\n";
 
     out << fmt::format(FMT_COMPILE("#define PPACK_IFACE_BLOCK \\\n"
-                                   "auto  {0}width             __attribute__((unused)) = params_.width;\\\n"
-                                   "auto  {0}n_detectors       __attribute__((unused)) = params_.n_detectors;\\\n"
-                                   "auto* {0}vec_ci            __attribute__((unused)) = params_.vec_ci;\\\n"
-                                   "auto* {0}vec_di            __attribute__((unused)) = params_.vec_di;\\\n"
-                                   "auto* {0}vec_t             __attribute__((unused)) = params_.vec_t;\\\n"
-                                   "auto* {0}vec_dt            __attribute__((unused)) = params_.vec_dt;\\\n"
-                                   "auto* {0}vec_v             __attribute__((unused)) = params_.vec_v;\\\n"
-                                   "auto* {0}vec_i             __attribute__((unused)) = params_.vec_i;\\\n"
-                                   "auto* {0}vec_g             __attribute__((unused)) = params_.vec_g;\\\n"
-                                   "auto* {0}temperature_degC  __attribute__((unused)) = params_.temperature_degC;\\\n"
-                                   "auto* {0}diam_um           __attribute__((unused)) = params_.diam_um;\\\n"
-                                   "auto* {0}time_since_spike  __attribute__((unused)) = params_.time_since_spike;\\\n"
-                                   "auto* {0}node_index        __attribute__((unused)) = params_.node_index;\\\n"
-                                   "auto* {0}multiplicity      __attribute__((unused)) = params_.multiplicity;\\\n"
-                                   "auto* {0}state_vars        __attribute__((unused)) = params_.state_vars;\\\n"
-                                   "auto* {0}weight            __attribute__((unused)) = params_.weight;\\\n"
-                                   "auto& {0}events            __attribute__((unused)) = params_.events;\\\n"
-                                   "auto& {0}mechanism_id      __attribute__((unused)) = params_.mechanism_id;\\\n"
-                                   "auto& {0}index_constraints __attribute__((unused)) = params_.index_constraints;\\\n"),
+                                   "auto                               {0}width             __attribute__((unused)) = params_.width;\\\n"
+                                   "const arb_index_type* __restrict__ {0}vec_ci            __attribute__((unused)) = params_.vec_ci;\\\n"
+                                   "const arb_index_type* __restrict__ {0}vec_di            __attribute__((unused)) = params_.vec_di;\\\n"
+                                   "auto*                              {0}vec_t             __attribute__((unused)) = params_.vec_t;\\\n"
+                                   "const arb_value_type* __restrict__ {0}vec_dt            __attribute__((unused)) = params_.vec_dt;\\\n"
+                                   "const arb_value_type* __restrict__ {0}vec_v             __attribute__((unused)) = params_.vec_v;\\\n"
+                                   "auto*                              {0}vec_i             __attribute__((unused)) = params_.vec_i;\\\n"
+                                   "auto*                              {0}vec_g             __attribute__((unused)) = params_.vec_g;\\\n"
+                                   "const arb_value_type* __restrict__ {0}temperature_degC  __attribute__((unused)) = params_.temperature_degC;\\\n"
+                                   "const arb_value_type* __restrict__ {0}diam_um           __attribute__((unused)) = params_.diam_um;\\\n"
+                                   "auto*                              {0}time_since_spike  __attribute__((unused)) = params_.time_since_spike;\\\n"
+                                   "const arb_index_type* __restrict__ {0}detector_divs     __attribute__((unused)) = params_.detector_divs;\\\n"
+                                   "const arb_index_type* __restrict__ {0}node_index        __attribute__((unused)) = params_.node_index;\\\n"
+                                   "const arb_index_type* __restrict__ {0}multiplicity      __attribute__((unused)) = params_.multiplicity;\\\n"
+                                   "auto*                              {0}state_vars        __attribute__((unused)) = params_.state_vars;\\\n"
+                                   "const arb_value_type* __restrict__ {0}weight            __attribute__((unused)) = params_.weight;\\\n"
+                                   "auto&                              {0}events            __attribute__((unused)) = params_.events;\\\n"
+                                   "auto&                              {0}mechanism_id      __attribute__((unused)) = params_.mechanism_id;\\\n"
+                                   "auto&                              {0}index_constraints __attribute__((unused)) = params_.index_constraints;\\\n"),
                        pp_var_pfx);
     auto global = 0;
     for (const auto& scalar: vars.scalars) {
@@ -157,14 +167,20 @@ std::string emit_gpu_cu_source(const Module& module_, const printer_options& opt
     }
     for (const auto& array: vars.arrays) {
         if (!array->is_state()) {
-            out << fmt::format("auto* {}{} __attribute__((unused)) = params_.parameters[{}];\\\n", pp_var_pfx, array->name(), param);
+            auto type = is_readonly_parameter(array)? "const arb_value_type* __restrict__": "auto*";
+            out << fmt::format("{} {}{} __attribute__((unused)) = params_.parameters[{}];\\\n", type, pp_var_pfx, array->name(), param);
             param++;
         }
     }
+    auto random = 0;
+    for (const auto& var: vars.white_noise) {
+        out << fmt::format("const arb_value_type* __restrict__ {}{} __attribute__((unused)) = params_.random_numbers[{}];\\\n", pp_var_pfx, var->name(), random);
+        random++;
+    }
     auto idx = 0;
     for (const auto& ion: module_.ion_deps()) {
         out << fmt::format("auto& {}{} __attribute__((unused)) = params_.ion_states[{}];\\\n",       pp_var_pfx, ion_field(ion), idx);
-        out << fmt::format("auto* {}{} __attribute__((unused)) = params_.ion_states[{}].index;\\\n", pp_var_pfx, ion_index(ion), idx);
+        out << fmt::format("const arb_index_type* __restrict__ {}{} __attribute__((unused)) = params_.ion_states[{}].index;\\\n", pp_var_pfx, ion_index(ion), idx);
         idx++;
     }
     out << "//End of IFACEBLOCK\n\n";
@@ -173,7 +189,10 @@ std::string emit_gpu_cu_source(const Module& module_, const printer_options& opt
     //  - first __device__ functions that implement NMODL PROCEDUREs.
     //  - then __global__ kernels that implement API methods and call the procedures.
 
+    // Kernels are compiled for blocks of at most max_block_dim_ threads, and
+    // launched with the block size of the largest occupancy within that.
     out << "namespace {\n\n" // place inside an anonymous namespace
+        << "constexpr unsigned max_block_dim_ = " << opt.gpu_max_block_size << ";\n\n"
         << "using ::arb::gpu::exprelr;\n"
         << "using ::arb::gpu::safeinv;\n"
         << "using ::arb::gpu::min;\n"
@@ -184,10 +203,10 @@ std::string emit_gpu_cu_source(const Module& module_, const printer_options& opt
         out << fmt::format("__device__\n"
                            "void {}(arb_mechanism_ppack params_, int tid_",
                            e->name());
-        for(auto& arg: e->args()) out << ", arb_value_type " << arg->is_argument()->name();
+        for(auto& arg: e->args()) out << ", " << arg_type << " " << arg->is_argument()->name();
         out << ") {\n" << indent
             << "PPACK_IFACE_BLOCK;\n"
-            << cuprint(e->body())
+            << cuprint(e->body(), single_precision)
             << popindent << "}\n\n";
     };
 
@@ -199,18 +218,18 @@ std::string emit_gpu_cu_source(const Module& module_, const printer_options& opt
     auto emit_api_kernel = [&] (APIMethod* e) {
         // Only print the kernel if the method is not empty.
         if (!e->body()->statements().empty()) {
-            out << "__global__\n"
+            out << "__global__ __launch_bounds__(max_block_dim_)\n"
                 << "void " << e->name() << "(arb_mechanism_ppack params_) {\n" << indent
                 << "int n_ = params_.width;\n"
                 << "int tid_ = threadIdx.x + blockDim.x*blockIdx.x;\n";
-            emit_api_body_cu(out, e, is_point_proc);
+            emit_api_body_cu(out, e, is_point_proc, single_precision);
             out << popindent << "}\n\n";
         }
     };
 
     emit_api_kernel(init_api);
     if (init_api && !init_api->body()->statements().empty()) {
-        out << fmt::format(FMT_COMPILE("__global__\n"
+        out << fmt::format(FMT_COMPILE("__global__ __launch_bounds__(max_block_dim_)\n"
                                        "void multiply(arb_mechanism_ppack params_) {{\n"
                                        "    PPACK_IFACE_BLOCK;\n"
                                        "    auto tid_ = threadIdx.x + blockDim.x*blockIdx.x;\n"
@@ -227,13 +246,13 @@ std::string emit_gpu_cu_source(const Module& module_, const printer_options& opt
 
     // event delivery
     if (net_receive_api) {
-        out << fmt::format(FMT_COMPILE("__global__\n"
-                                       "void apply_events(arb_mechanism_ppack params_, arb_deliverable_event_stream* events) {{\n"
+        out << fmt::format(FMT_COMPILE("__global__ __launch_bounds__(max_block_dim_)\n"
+                                       "void apply_events(arb_mechanism_ppack params_, arb_deliverable_event_stream events) {{\n"
                                        "    PPACK_IFACE_BLOCK;\n"
                                        "    auto tid_ = threadIdx.x + blockDim.x*blockIdx.x;\n"
-                                       "    if(tid_<events->n_streams) {{\n"
-                                       "        auto begin = events->events + events->begin[tid_];\n"
-                                       "        auto end   = events->events + events->end[tid_];\n"
+                                       "    if(tid_<events.n_streams) {{\n"
+                                       "        auto begin = events.events + events.begin[tid_];\n"
+                                       "        auto end   = events.events + events.end[tid_];\n"
                                        "        for (auto p = begin; p<end; ++p) {{\n"
                                        "            if (p->mech_id=={1}mechanism_id) {{\n"
                                        "                auto tid_ = p->mech_index;\n"
@@ -241,28 +260,27 @@ std::string emit_gpu_cu_source(const Module& module_, const printer_options& opt
                            net_receive_api->args().empty() ? "weight" : net_receive_api->args().front()->is_argument()->name(),
                            pp_var_pfx);
         out << indent << indent << indent << indent;
-        emit_api_body_cu(out, net_receive_api, is_point_proc, false, false);
+        emit_api_body_cu(out, net_receive_api, is_point_proc, single_precision, false, false);
         out << popindent << "}\n" << popindent << "}\n" << popindent << "}\n" << popindent << "}\n";
     }
 
     // event delivery
     if (post_event_api) {
         const std::string time_arg = post_event_api->args().empty() ? "time" : post_event_api->args().front()->is_argument()->name();
-        out << fmt::format(FMT_COMPILE("__global__\n"
+        out << fmt::format(FMT_COMPILE("__global__ __launch_bounds__(max_block_dim_)\n"
                                        "void post_event(arb_mechanism_ppack params_) {{\n"
                                        "    PPACK_IFACE_BLOCK;\n"
                                        "    auto tid_ = threadIdx.x + blockDim.x*blockIdx.x;\n"
                                        "    if (tid_<{1}width) {{\n"
                                        "        auto node_index_i_ = {1}node_index[tid_];\n"
                                        "        auto cid_ = {1}vec_ci[node_index_i_];\n"
-                                       "        auto offset_ = {1}n_detectors * cid_;\n"
-                                       "        for (unsigned c = 0; c < {1}n_detectors; c++) {{\n"
-                                       "            auto {0} = {1}time_since_spike[offset_ + c];\n"
+                                       "        for (auto c = {1}detector_divs[cid_]; c < {1}detector_divs[cid_+1]; c++) {{\n"
+                                       "            auto {0} = {1}time_since_spike[c];\n"
                                        "            if ({0} >= 0) {{\n"),
                            time_arg,
                            pp_var_pfx);
         out << indent << indent << indent << indent;
-        emit_api_body_cu(out, post_event_api, is_point_proc, false, false);
+        emit_api_body_cu(out, post_event_api, is_point_proc, single_precision, false, false);
         out << popindent << "}\n" << popindent << "}\n" << popindent << "}\n" << popindent << "}\n";
     }
 
@@ -274,10 +292,10 @@ std::string emit_gpu_cu_source(const Module& module_, const printer_options& opt
         out << fmt::format(FMT_COMPILE("void {}_{}_(arb_mechanism_ppack* p) {{"), class_name, api_name);
         if(!e->body()->statements().empty()) {
             out << fmt::format(FMT_COMPILE("\n"
-                                           "    auto n = p->{};\n"
-                                           "    unsigned block_dim = 128;\n"
+                                           "    auto n = p->{0};\n"
+                                           "    static const unsigned block_dim = ::arb::gpu::max_block_size({1}, max_block_dim_);\n"
                                            "    unsigned grid_dim = ::arb::gpu::impl::block_count(n, block_dim);\n"
-                                           "    {}<<<grid_dim, block_dim>>>(*p);\n"),
+                                           "    {1}<<<grid_dim, block_dim, 0, arb::gpu::current_stream()>>>(*p);\n"),
                                width,
                                api_name);
         }
@@ -298,11 +316,13 @@ std::string emit_gpu_cu_source(const Module& module_, const printer_options& opt
         if(!init_api->body()->statements().empty()) {
             out << fmt::format(FMT_COMPILE("\n"
                                            "    auto n = p->{0};\n"
-                                           "    unsigned block_dim = 128;\n"
+                                           "    static const unsigned block_dim = ::arb::gpu::max_block_size({1}, max_block_dim_);\n"
                                            "    unsigned grid_dim = ::arb::gpu::impl::block_count(n, block_dim);\n"
-                                           "    {1}<<<grid_dim, block_dim>>>(*p);\n"
+                                           "    {1}<<<grid_dim, block_dim, 0, arb::gpu::current_stream()>>>(*p);\n"
                                            "    if (!p->multiplicity) return;\n"
-                                           "    multiply<<<{{grid_dim, {2}}}, block_dim>>>(*p);\n"),
+                                           "    static const unsigned multiply_block_dim = ::arb::gpu::max_block_size(multiply, max_block_dim_);\n"
+                                           "    unsigned multiply_grid_dim = ::arb::gpu::impl::block_count(n, multiply_block_dim);\n"
+                                           "    multiply<<<{{multiply_grid_dim, {2}}}, multiply_block_dim, 0, arb::gpu::current_stream()>>>(*p);\n"),
                                "width",
                                api_name,
                                n);
@@ -324,9 +344,9 @@ std::string emit_gpu_cu_source(const Module& module_, const printer_options& opt
         if(!net_receive_api->body()->statements().empty()) {
             out << fmt::format(FMT_COMPILE("\n"
                                            "    auto n = events->n_streams;\n"
-                                           "    unsigned block_dim = 128;\n"
+                                           "    static const unsigned block_dim = ::arb::gpu::max_block_size({0}, max_block_dim_);\n"
                                            "    unsigned grid_dim = ::arb::gpu::impl::block_count(n, block_dim);\n"
-                                           "    {}<<<grid_dim, block_dim>>>(*p);\n"),
+                                           "    {0}<<<grid_dim, block_dim, 0, arb::gpu::current_stream()>>>(*p, *events);\n"),
                                api_name);
         }
         out << "}\n\n";
@@ -341,7 +361,11 @@ static std::string index_i_name(const std::string& index_var) {
     return index_var+"i_";
 }
 
-void emit_api_body_cu(std::ostream& out, APIMethod* e, bool is_point_proc, bool cv_loop, bool ppack) {
+static std::string run_name(const std::string& index_var) {
+    return index_var+"run_";
+}
+
+void emit_api_body_cu(std::ostream& out, APIMethod* e, bool is_point_proc, bool single_precision, bool cv_loop, bool ppack) {
     auto body = e->body();
     auto indexed_vars = indexed_locals(e->scope());
 
@@ -384,17 +408,35 @@ void emit_api_body_cu(std::ostream& out, APIMethod* e, bool is_point_proc, bool
 
         for (auto& index: indices) {
             out << "auto " << index_i_name(index.source_var)
-                << " = " << pp_var_pfx << index.source_var << "[" << index.index_name << "];\n";
+                << " = ::arb::gpu::ldg(" << pp_var_pfx << index.source_var << "+" << index.index_name << ");\n";
         }
 
         for (auto& sym: indexed_vars) {
-            emit_state_read_cu(out, sym);
+            emit_state_read_cu(out, sym, single_precision);
         }
 
-        out << cuprint(body);
+        out << cuprint(body, single_precision);
+
+        // Point mechanisms reduce every accumulated value with the same
+        // index, such as current and conductance, over a key set computed
+        // once for that index.
+        if (is_point_proc) {
+            std::set<std::string> runs;
+            for (auto& sym: indexed_vars) {
+                auto external = sym->external_variable();
+                auto d = decode_indexed_variable(external);
+                if (!external->is_write() || !d.accumulate || d.readonly) continue;
+
+                auto index_var = d.cell_index_var.empty() ? d.node_index_var : d.cell_index_var;
+                if (runs.insert(index_var).second) {
+                    out << "::arb::gpu::key_set_pos " << run_name(index_var)
+                        << "(" << index_i_name(index_var) << ", lane_mask_);\n";
+                }
+            }
+        }
 
         for (auto& sym: indexed_vars) {
-            emit_state_update_cu(out, sym, sym->external_variable(), is_point_proc);
+            emit_state_update_cu(out, sym, sym->external_variable(), is_point_proc, single_precision);
         }
         cv_loop && out << popindent << "}\n";
     }
@@ -417,17 +459,32 @@ namespace {
                      << (wrap.v.scalar()? "0": index_i_name(index_var)) << ']';
         }
     };
+
+    // Load through the read-only data cache.
+    struct ldg_deref {
+        indexed_variable_info v;
+
+        ldg_deref(indexed_variable_info v): v(v) {}
+        friend std::ostream& operator<<(std::ostream& o, const ldg_deref& wrap) {
+            return o << "::arb::gpu::ldg(&" << deref(wrap.v) << ')';
+        }
+    };
 }
 
-void emit_state_read_cu(std::ostream& out, LocalVariable* local) {
-    out << "arb_value_type " << cuprint(local) << " = ";
+void emit_state_read_cu(std::ostream& out, LocalVariable* local, bool single_precision) {
+    out << (single_precision? "float ": "arb_value_type ") << cuprint(local) << " = ";
 
     if (local->is_read()) {
         auto d = decode_indexed_variable(local->external_variable());
         if (d.scale != 1) {
             out << as_c_double(d.scale) << "*";
         }
-        out << deref(d) << ";\n";
+        if (d.readonly) {
+            out << ldg_deref(d) << ";\n";
+        }
+        else {
+            out << deref(d) << ";\n";
+        }
     }
     else {
         out << "0;\n";
@@ -436,12 +493,15 @@ void emit_state_read_cu(std::ostream& out, LocalVariable* local) {
 
 
 void emit_state_update_cu(std::ostream& out, Symbol* from,
-                          IndexedVariable* external, bool is_point_proc) {
+                          IndexedVariable* external, bool is_point_proc, bool single_precision) {
     if (!external->is_write()) return;
 
     auto d = decode_indexed_variable(external);
     double coeff = 1./d.scale;
 
+    // Single precision locals are widened before they are written back.
+    auto value = single_precision? "arb_value_type("+from->name()+")": from->name();
+
     if (d.readonly) {
         throw compiler_exception("Cannot assign to read-only external state: "+external->to_string());
     }
@@ -450,22 +510,22 @@ void emit_state_update_cu(std::ostream& out, Symbol* from,
         out << "::arb::gpu::reduce_by_key(";
         if (coeff != 1) out << as_c_double(coeff) << '*';
 
-        out << pp_var_pfx << "weight[tid_]*" << from->name() << ',';
+        out << pp_var_pfx << "weight[tid_]*" << value << ',';
 
         auto index_var = d.cell_index_var.empty() ? d.node_index_var : d.cell_index_var;
-        out << pp_var_pfx << d.data_var << ", " << index_i_name(index_var) << ", lane_mask_);\n";
+        out << pp_var_pfx << d.data_var << ", " << index_i_name(index_var) << ", " << run_name(index_var) << ");\n";
     }
     else if (d.accumulate) {
         out << deref(d) << " = fma(";
         if (coeff != 1) out << as_c_double(coeff) << '*';
 
-        out << pp_var_pfx << "weight[tid_], " << from->name() << ", " << deref(d) << ");\n";
+        out << pp_var_pfx << "weight[tid_], " << value << ", " << deref(d) << ");\n";
     }
     else {
         out << deref(d) << " = ";
         if (coeff != 1) out << as_c_double(coeff) << '*';
 
-        out << from->name() << ";\n";
+        out << value << ";\n";
     }
 }
 
@@ -11,7 +11,7 @@ std::string emit_gpu_cu_source(const Module& m, const printer_options& opt);
 
 class GpuPrinter: public CPrinter {
 public:
-    GpuPrinter(std::ostream& out): CPrinter(out) {}
+    GpuPrinter(std::ostream& out, bool single_precision = false): CPrinter(out, single_precision) {}
 
     void visit(CallExpression*) override;
     void visit(VariableExpression*) override;
@@ -26,7 +26,7 @@ std::string build_info_header(const Module& m, const printer_options& opt, bool
 
     io::pfxstringstream out;
 
-    std::string fingerprint = "<placeholder>";
+    std::string fingerprint = module_fingerprint(m);
 
     out << fmt::format("#pragma once\n\n"
                        "#include <cmath>\n"
@@ -119,6 +119,18 @@ std::string build_info_header(const Module& m, const printer_options& opt, bool
             << "    static arb_size_type n_parameters = " << n << ";\n";
     }
 
+    {
+        auto n = 0ul;
+        io::separator sep("", ",\n                                                 ");
+        out << "    static arb_field_info random_variables[] = { ";
+        for (const auto& var: vars.white_noise) {
+            out << sep << fmt_var(var);
+            ++n;
+        }
+        out << " };\n"
+            << "    static arb_size_type n_random_variables = " << n << ";\n";
+    }
+
     {
         io::separator sep("", ",\n");
         out << "    static arb_ion_info ions[] = { ";
@@ -139,6 +151,8 @@ std::string build_info_header(const Module& m, const printer_options& opt, bool
                                    "    result.kind={2};\n"
                                    "    result.is_linear={3};\n"
                                    "    result.has_post_events={4};\n"
+                                   "    result.has_active_index={5};\n"
+                                   "    result.has_additive_events={6};\n"
                                    "    result.globals=globals;\n"
                                    "    result.n_globals=n_globals;\n"
                                    "    result.ions=ions;\n"
@@ -147,6 +161,8 @@ std::string build_info_header(const Module& m, const printer_options& opt, bool
                                    "    result.n_state_vars=n_state_vars;\n"
                                    "    result.parameters=parameters;\n"
                                    "    result.n_parameters=n_parameters;\n"
+                                   "    result.random_variables=random_variables;\n"
+                                   "    result.n_random_variables=n_random_variables;\n"
                                    "    return result;\n"
                                    "  }}\n"
                                    "\n"),
@@ -154,7 +170,9 @@ std::string build_info_header(const Module& m, const printer_options& opt, bool
                        fingerprint,
                        module_kind_str(m),
                        m.is_linear(),
-                       m.has_post_events())
+                       m.has_post_events(),
+                       m.neuron_block().has_quiescent_state(),
+                       m.has_additive_events())
         << fmt::format("  arb_mechanism_interface* make_{0}_{1}_interface_multicore(){2}\n"
                        "  arb_mechanism_interface* make_{0}_{1}_interface_gpu(){3}\n"
                        "}}\n",
@@ -164,3 +182,14 @@ std::string build_info_header(const Module& m, const printer_options& opt, bool
                        gpu ? ";" : " { return nullptr; }");
     return out.str();
 }
+
+std::string build_bundle_info_header(const std::string& name, const printer_options& opt) {
+    return fmt::format("#pragma once\n\n"
+                       "#include <{0}mechanism_abi.h>\n\n"
+                       "extern \"C\" {{\n"
+                       "  arb_mechanism_bundle_interface* make_{1}_{2}_bundle_interface_multicore();\n"
+                       "}}\n",
+                       arb_header_prefix(),
+                       std::regex_replace(opt.cpp_namespace, std::regex{"::"}, "_"),
+                       name);
+}
@@ -9,3 +9,7 @@
 // and declarations of backend-specific mechanism implementations.
 
 std::string build_info_header(const Module& m, const printer_options& opt, bool cpu=false, bool gpu=false);
+
+// Build header file declaring the implementation of a mechanism bundle.
+
+std::string build_bundle_info_header(const std::string& name, const printer_options& opt);
@@ -19,4 +19,29 @@ struct printer_options {
 
     bool profile = false;
     bool trace_codegen = false;
+
+    // Evaluate GPU kernels in single precision? State storage, voltage and
+    // the matrix solve remain double precision; only kernel locals, procedure
+    // arguments and literals are float. (GPU printer only.)
+    bool gpu_single_precision = false;
+
+    // Largest number of threads per block of GPU kernels. Kernels are
+    // compiled with this launch bound, and launched with the block size of
+    // largest occupancy up to it. (GPU printer only.)
+    unsigned gpu_max_block_size = 256;
+
+    // Replace voltage-only rate computations by interpolation in tables with
+    // this relative accuracy? Zero => evaluate exactly. (Scalar C printer only.)
+    double table_tolerance = 0;
+
+    // Evaluate exp, log and exprelr in SIMD kernels with the reduced-precision
+    // fast_* functions of the SIMD library? (Vectorized C printer only.)
+    bool fast_math = false;
+
+    // Evaluate scalar CPU kernels in single precision? As for the GPU, only
+    // kernel locals, state reads, procedure arguments and literals are
+    // float; storage and current accumulation remain double precision.
+    // (Scalar C printer only; rate tabulated and fused bundle kernels are
+    // unaffected.)
+    bool cpu_single_precision = false;
 };
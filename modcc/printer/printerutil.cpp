@@ -1,5 +1,9 @@
+#include <cstdint>
+#include <cstdio>
+#include <functional>
 #include <regex>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 
 #include "expression.hpp"
@@ -18,6 +22,18 @@ std::vector<std::string> namespace_components(const std::string& ns) {
     return components;
 }
 
+std::string module_fingerprint(const Module& m) {
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    for (char c: m.buffer()) {
+        if (!c) break;
+        hash = (hash ^ (unsigned char)c)*0x100000001b3ull;
+    }
+
+    char digits[17];
+    std::snprintf(digits, sizeof digits, "%016llx", (unsigned long long)hash);
+    return digits;
+}
+
 std::vector<LocalVariable*> indexed_locals(scope_ptr scope) {
     std::vector<LocalVariable*> vars;
     for (auto& entry: scope->locals()) {
@@ -40,6 +56,82 @@ std::vector<LocalVariable*> pure_locals(scope_ptr scope) {
     return vars;
 }
 
+static void count_assignments(Expression* stmt, std::unordered_map<std::string, int>& counts) {
+    if (auto block = stmt->is_block()) {
+        for (auto& s: block->statements()) count_assignments(s.get(), counts);
+    }
+    else if (auto cond = stmt->is_if()) {
+        count_assignments(cond->true_branch(), counts);
+        if (cond->false_branch()) count_assignments(cond->false_branch(), counts);
+    }
+    else if (auto assign = stmt->is_assignment()) {
+        if (auto id = assign->lhs()->is_identifier()) ++counts[id->name()];
+    }
+}
+
+static void find_function_arguments(Expression* e, std::unordered_set<std::string>& args) {
+    if (auto block = e->is_block()) {
+        for (auto& s: block->statements()) find_function_arguments(s.get(), args);
+    }
+    else if (auto cond = e->is_if()) {
+        find_function_arguments(cond->condition(), args);
+        find_function_arguments(cond->true_branch(), args);
+        if (cond->false_branch()) find_function_arguments(cond->false_branch(), args);
+    }
+    else if (auto u = e->is_unary()) {
+        auto id = u->expression()->is_identifier();
+        if (id && u->op()!=tok::minus) args.insert(id->name());
+        find_function_arguments(u->expression(), args);
+    }
+    else if (auto b = e->is_binary()) {
+        find_function_arguments(b->lhs(), args);
+        find_function_arguments(b->rhs(), args);
+    }
+    else if (auto call = e->is_call()) {
+        for (auto& a: call->args()) {
+            if (auto id = a->is_identifier()) args.insert(id->name());
+        }
+    }
+}
+
+std::vector<AssignmentExpression*> loop_invariant_prefix(BlockExpression* body) {
+    std::unordered_map<std::string, int> assigned;
+    count_assignments(body, assigned);
+    std::unordered_set<std::string> arguments;
+    find_function_arguments(body, arguments);
+
+    std::unordered_set<std::string> invariant;
+    std::function<bool (Expression*)> is_invariant = [&](Expression* e) {
+        if (e->is_number()) return true;
+        if (auto id = e->is_identifier()) {
+            auto sym = id->symbol();
+            if (!sym) return false;
+            if (auto var = sym->is_variable()) return var->is_scalar() && !assigned.count(id->name());
+            return invariant.count(id->name())>0;
+        }
+        if (auto u = e->is_unary()) return is_invariant(u->expression());
+        if (auto b = e->is_binary()) return !b->is_assignment() && is_invariant(b->lhs()) && is_invariant(b->rhs());
+        return false;
+    };
+
+    std::vector<AssignmentExpression*> prefix;
+    for (auto& s: body->statements()) {
+        if (s->is_local_declaration()) continue;
+
+        auto assign = s->is_assignment();
+        if (!assign) break;
+        auto id = assign->lhs()->is_identifier();
+        auto local = id && id->symbol()? id->symbol()->is_local_variable(): nullptr;
+        if (!local || local->is_arg() || local->is_indexed() || assigned[id->name()]!=1) break;
+        if (!is_invariant(assign->rhs())) break;
+        if (arguments.count(id->name())) continue;
+
+        invariant.insert(id->name());
+        prefix.push_back(assign);
+    }
+    return prefix;
+}
+
 std::vector<ProcedureExpression*> normal_procedures(const Module& m) {
     std::vector<ProcedureExpression*> procs;
 
@@ -85,7 +177,8 @@ module_variables_t local_module_variables(const Module& m) {
     for (auto& sym: m.symbols()) {
         auto v = sym.second->is_variable();
         if (v && v->linkage()==linkageKind::local) {
-            (v->is_range()? mv.arrays: mv.scalars).push_back(v);
+            if (v->is_white_noise()) mv.white_noise.push_back(v);
+            else (v->is_range()? mv.arrays: mv.scalars).push_back(v);
         }
     }
 
@@ -65,6 +65,11 @@ inline const char* module_kind_str(const Module& m) {
     }
 }
 
+// Identifier of the mechanism dynamics: 64-bit FNV-1a hash of the module
+// source, as 16 hexadecimal digits.
+
+std::string module_fingerprint(const Module& m);
+
 // Check expression non-null and scoped, or else throw.
 
 inline void assert_has_scope(Expression* expr, const std::string& context) {
@@ -83,6 +88,15 @@ std::vector<LocalVariable*> indexed_locals(scope_ptr scope);
 // All local variables in scope with `is_arg()` and `is_indexed()` false.
 std::vector<LocalVariable*> pure_locals(scope_ptr scope);
 
+// Leading assignments of a method body whose values are the same for every
+// instance: each assigns a pure local that is not assigned elsewhere in the
+// body, from numbers, global variables and locals assigned before. Printers
+// evaluate these once, ahead of the loop over instances, and then treat the
+// locals like global variables; locals that are the argument of a function
+// such as `exp` are not included, as SIMD printers cannot apply these to
+// scalars.
+std::vector<AssignmentExpression*> loop_invariant_prefix(BlockExpression* body);
+
 
 // Module state query functions:
 
@@ -103,9 +117,11 @@ public_variable_ids_t public_variable_ids(const Module&);
 struct module_variables_t {
     std::vector<VariableExpression*> scalars;
     std::vector<VariableExpression*> arrays;
+    std::vector<VariableExpression*> white_noise;
 };
 
-// Scalar and array variables with local linkage.
+// Scalar and array variables with local linkage; WHITE_NOISE variables,
+// which are filled by the library, are kept apart from the arrays.
 
 module_variables_t local_module_variables(const Module&);
 
@@ -0,0 +1,169 @@
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "expression.hpp"
+#include "visitor.hpp"
+#include "printer/printerutil.hpp"
+#include "printer/ratetable.hpp"
+
+namespace {
+
+using local_set = std::unordered_set<LocalVariable*>;
+
+LocalVariable* local_of(Expression* e) {
+    auto id = e->is_identifier();
+    return id && id->symbol()? id->symbol()->is_local_variable(): nullptr;
+}
+
+// Record every local referenced in an expression, and count the assignments
+// to each.
+class LocalUseVisitor: public Visitor {
+public:
+    void visit(Expression*) override {}
+
+    void visit(IdentifierExpression* e) override {
+        if (auto local = local_of(e)) used.insert(local);
+    }
+
+    void visit(UnaryExpression* e) override {
+        e->expression()->accept(this);
+    }
+
+    void visit(BinaryExpression* e) override {
+        e->lhs()->accept(this);
+        e->rhs()->accept(this);
+    }
+
+    void visit(AssignmentExpression* e) override {
+        if (auto local = local_of(e->lhs())) ++assigned[local];
+        e->lhs()->accept(this);
+        e->rhs()->accept(this);
+    }
+
+    void visit(CallExpression* e) override {
+        for (auto& arg: e->args()) arg->accept(this);
+    }
+
+    void visit(IfExpression* e) override {
+        e->condition()->accept(this);
+        e->true_branch()->accept(this);
+        if (e->false_branch()) e->false_branch()->accept(this);
+    }
+
+    void visit(BlockExpression* e) override {
+        for (auto& stmt: e->statements()) stmt->accept(this);
+    }
+
+    local_set used;
+    std::unordered_map<LocalVariable*, int> assigned;
+};
+
+// An expression is a pure rate expression if it is built from numbers and the
+// given locals by arithmetic and elementary functions only.
+class PureRateVisitor: public Visitor {
+public:
+    explicit PureRateVisitor(const local_set& allowed): allowed_(allowed) {}
+
+    void visit(Expression*) override { pure = false; }
+
+    void visit(NumberExpression*) override {}
+
+    void visit(IdentifierExpression* e) override {
+        auto local = local_of(e);
+        if (!local || !allowed_.count(local)) pure = false;
+    }
+
+    void visit(UnaryExpression* e) override {
+        switch (e->op()) {
+        case tok::exp:
+        case tok::log:
+        case tok::exprelr:
+        case tok::sin:
+        case tok::cos:
+            expensive = true;
+            break;
+        default: ;
+        }
+        e->expression()->accept(this);
+    }
+
+    void visit(BinaryExpression* e) override {
+        if (e->op()==tok::pow) expensive = true;
+        e->lhs()->accept(this);
+        e->rhs()->accept(this);
+    }
+
+    void visit(AssignmentExpression*) override { pure = false; }
+
+    bool pure = true;
+    bool expensive = false;
+
+private:
+    const local_set& allowed_;
+};
+
+} // namespace
+
+rate_table_plan make_rate_table_plan(APIMethod* method) {
+    rate_table_plan plan;
+    if (!method || !method->body()) return plan;
+
+    for (auto local: indexed_locals(method->scope())) {
+        if (decode_indexed_variable(local->external_variable()).data_var=="vec_v") {
+            plan.v = local;
+        }
+    }
+    if (!plan.v) return plan;
+
+    LocalUseVisitor uses;
+    method->body()->accept(&uses);
+    if (uses.assigned.count(plan.v)) return plan;
+
+    // Classify the top-level assignments to locals assigned exactly once; a
+    // statement can only depend on the constants and tabulated values that
+    // precede it.
+    local_set constants, allowed = {plan.v};
+    bool expensive = false;
+    for (auto& stmt: method->body()->statements()) {
+        auto assign = stmt->is_assignment();
+        if (!assign) continue;
+
+        auto local = local_of(assign->lhs());
+        if (!local || local->is_indexed() || uses.assigned[local]!=1) continue;
+
+        PureRateVisitor const_check(constants);
+        assign->rhs()->accept(&const_check);
+        if (const_check.pure && !const_check.expensive) {
+            constants.insert(local);
+            allowed.insert(local);
+            plan.constants.push_back(stmt.get());
+            plan.hoisted_.insert(stmt.get());
+            continue;
+        }
+
+        PureRateVisitor check(allowed);
+        assign->rhs()->accept(&check);
+        if (check.pure) {
+            expensive |= check.expensive;
+            allowed.insert(local);
+            plan.tabulated.push_back(stmt.get());
+            plan.hoisted_.insert(stmt.get());
+        }
+    }
+    if (!expensive) return rate_table_plan{};
+
+    // Table columns are the tabulated values read outside the tabulated
+    // statements, in order of definition.
+    LocalUseVisitor rest;
+    for (auto& stmt: method->body()->statements()) {
+        if (!plan.is_hoisted(stmt.get())) stmt->accept(&rest);
+    }
+    for (auto stmt: plan.tabulated) {
+        auto local = local_of(stmt->is_assignment()->lhs());
+        if (rest.used.count(local)) plan.fields.push_back(local);
+    }
+    if (plan.fields.empty()) return rate_table_plan{};
+
+    return plan;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+// Identification of voltage-only rate computations in API method bodies that
+// can be replaced by interpolation in a table built once per process.
+
+#include <unordered_set>
+#include <vector>
+
+#include "expression.hpp"
+
+struct rate_table_plan {
+    // Voltage local read by the method; the table is indexed by its value.
+    LocalVariable* v = nullptr;
+
+    // Top-level assignments of constants to locals, in source order.
+    std::vector<Expression*> constants;
+
+    // Top-level assignments to locals that depend only on `v` and constants,
+    // in source order.
+    std::vector<Expression*> tabulated;
+
+    // Tabulated locals read by the rest of the body: one table column each.
+    std::vector<LocalVariable*> fields;
+
+    // True if statement belongs to `constants` or `tabulated`.
+    bool is_hoisted(Expression* stmt) const { return hoisted_.count(stmt); }
+
+    explicit operator bool() const { return !fields.empty(); }
+
+    std::unordered_set<Expression*> hoisted_;
+};
+
+// Returns an empty plan if the body has nothing worth tabulating: the voltage
+// must not be assigned, and the tabulated statements must involve at least one
+// transcendental function or power.
+
+rate_table_plan make_rate_table_plan(APIMethod* method);
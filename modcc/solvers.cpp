@@ -1,3 +1,4 @@
+#include <cmath>
 #include <map>
 #include <set>
 #include <stdexcept>
@@ -137,6 +138,66 @@ not_gating:
 }
 
 
+// Euler-Maruyama solver visitor implementation.
+
+void EulerMaruyamaSolverVisitor::visit(AssignmentExpression *e) {
+    auto loc = e->location();
+    scope_ptr scope = e->scope();
+
+    auto lhs = e->lhs();
+    auto rhs = e->rhs();
+    auto deriv = lhs->is_derivative();
+
+    if (!deriv) {
+        statements_.push_back(e->clone());
+        return;
+    }
+
+    auto s = deriv->name();
+    linear_test_result r = linear_test(rhs, noise_);
+
+    if (!r.is_linear) {
+        error({"Derivative not linear in the WHITE_NOISE variables for stochastic", loc});
+        return;
+    }
+
+    auto push_local = [&](Expression* x, const char* prefix) {
+        auto local = make_unique_local_assign(scope, x, prefix);
+        statements_.push_back(std::move(local.local_decl));
+        statements_.push_back(std::move(local.assignment));
+        return local.id->is_identifier()->spelling();
+    };
+
+    // s' = f + sum_W g_W*W becomes d_ = f*dt + sum_W g_W*W*dt^0.5, with
+    // f_ and g_ locals for the drift and the coefficients of the noise.
+    std::string increment = "0";
+    if (r.constant && !is_zero(r.constant)) {
+        increment = pprintf("%*dt", push_local(r.constant.get(), "f_"));
+    }
+    for (const auto& w: noise_) {
+        Expression* g = r.coef[w].get();
+        if (!g || is_zero(g)) continue;
+
+        if (sqrt_dt_.empty()) {
+            auto half = Parser{"dt^0.5"}.parse_expression();
+            sqrt_dt_ = push_local(half.get(), "sqrt_dt_");
+        }
+        increment += pprintf("+%*%*%", push_local(g, "g_"), w, sqrt_dt_);
+    }
+
+    auto d = Parser{increment}.parse_expression();
+    increments_.push_back(push_local(d.get(), "d_"));
+    dvars_.push_back(s);
+}
+
+void EulerMaruyamaSolverVisitor::finalize() {
+    for (unsigned i = 0; i<dvars_.size(); ++i) {
+        const auto& s = dvars_[i];
+        statements_.push_back(Parser{pprintf("% = %+%", s, s, increments_[i])}.parse_line_expression());
+    }
+    BlockRewriterBase::finalize();
+}
+
 // Sparse solver visitor implementation.
 
 static expression_ptr as_expression(symge::symbol_term term) {
@@ -216,11 +277,51 @@ std::vector<expression_ptr> SystemSolver::generate_normalizing_assignments(expre
     return S_;
 }
 
+std::vector<local_assignment> SystemSolver::generate_back_substitution(scope_ptr scope) {
+    std::vector<local_assignment> S_;
+
+    // Solution for the pivot column of each row, in reverse order of
+    // elimination: (rhs - sum of entries times later solutions)/pivot.
+    Location loc;
+    auto nrow = A_.nrow();
+    unsigned rhs_col = A_.augcol();
+    solution_.assign(nrow, "");
+    for (auto k = pivots_.size(); k-->0; ) {
+        const symge::sym_row& row = A_[pivots_[k].row];
+        unsigned col = pivots_[k].col;
+
+        expression_ptr expr = make_expression<IdentifierExpression>(loc, symge::name(row[rhs_col]));
+        for (const auto& e: row) {
+            if (e.col==col || e.col>=nrow) continue;
+            expr = make_expression<SubBinaryExpression>(loc, std::move(expr),
+                       make_expression<MulBinaryExpression>(loc,
+                           make_expression<IdentifierExpression>(loc, symge::name(e.value)),
+                           make_expression<IdentifierExpression>(loc, solution_[e.col])));
+        }
+        expr = make_expression<DivBinaryExpression>(loc, std::move(expr),
+                   make_expression<IdentifierExpression>(loc, symge::name(row[col])));
+
+        auto local_x_term = make_unique_local_assign(scope, expr.get(), "x_");
+        solution_[col] = local_x_term.id->is_identifier()->spelling();
+        S_.push_back(std::move(local_x_term));
+    }
+    return S_;
+}
+
 std::vector<expression_ptr> SystemSolver::generate_solution_assignments(std::vector<std::string> lhs_vars) {
     std::vector<expression_ptr> U_;
+    Location loc;
+
+    if (!pivots_.empty()) {
+        for (unsigned i = 0; i < A_.nrow(); ++i) {
+            U_.push_back(make_expression<AssignmentExpression>(loc,
+                             make_expression<IdentifierExpression>(loc, lhs_vars[i]),
+                             make_expression<IdentifierExpression>(loc, solution_[i])));
+        }
+        return U_;
+    }
 
     // State variable updates given by rhs/diagonal for reduced matrix.
-    Location loc;
     auto nrow = A_.nrow();
     for (unsigned i = 0; i < nrow; ++i) {
         const symge::sym_row& row = A_[i];
@@ -248,6 +349,35 @@ std::vector<expression_ptr> SystemSolver::generate_solution_assignments(std::vec
 }
 
 
+// Return the name of the time step for the solves of `method`, adding the
+// definition of a local for gamma*dt to `statements` for SDIRK2, or for
+// dt/2^squarings for the matrix exponential.
+static std::string solver_time_step(solverMethod method, scope_ptr scope, expr_list_type& statements) {
+    if (method != solverMethod::sdirk2 && method != solverMethod::expm) return "dt";
+
+    Location loc;
+    double factor = method == solverMethod::sdirk2? sdirk2::gamma: std::ldexp(1., -(int)expm::squarings);
+    auto h_expr = make_expression<MulBinaryExpression>(loc,
+        make_expression<NumberExpression>(loc, factor),
+        make_expression<IdentifierExpression>(loc, "dt"));
+    auto local_h_term = make_unique_local_assign(scope, h_expr, "h_");
+    statements.push_back(std::move(local_h_term.local_decl));
+    statements.push_back(std::move(local_h_term.assignment));
+    return local_h_term.id->is_identifier()->spelling();
+}
+
+// Return the assignment x = y0 + ratio*(y1 - y0) of the initial value of the
+// second SDIRK2 stage, given the initial value y0 and the result y1 of the first.
+static expression_ptr sdirk2_second_stage(const std::string& x, const std::string& y0, const std::string& y1) {
+    Location loc;
+    auto id = [&loc](const std::string& name) { return make_expression<IdentifierExpression>(loc, name); };
+    return make_expression<AssignmentExpression>(loc, id(x),
+        make_expression<AddBinaryExpression>(loc, id(y0),
+            make_expression<MulBinaryExpression>(loc,
+                make_expression<NumberExpression>(loc, sdirk2::ratio),
+                make_expression<SubBinaryExpression>(loc, id(y1), id(y0)))));
+}
+
 void SparseSolverVisitor::visit(BlockExpression* e) {
     // Do a first pass to extract variables comprising ODE system
     // lhs; can't really trust 'STATE' block.
@@ -256,8 +386,18 @@ void SparseSolverVisitor::visit(BlockExpression* e) {
         if (stmt && stmt->is_assignment() && stmt->is_assignment()->lhs()->is_derivative()) {
             auto id = stmt->is_assignment()->lhs()->is_derivative();
             dvars_.push_back(id->name());
+
+            if (method_ == solverMethod::sdirk2) {
+                auto dvar_ident = make_expression<IdentifierExpression>(e->location(), id->name());
+                auto init_dvar_term = make_unique_local_assign(e->scope(), dvar_ident.get(), "p_");
+                dvar_init_.push_back(init_dvar_term.id->is_identifier()->spelling());
+
+                statements_.push_back(std::move(init_dvar_term.local_decl));
+                statements_.push_back(std::move(init_dvar_term.assignment));
+            }
         }
     }
+    dt_ = solver_time_step(method_, e->scope(), statements_);
     if (solve_variant_ == solverVariant::steadystate) {
         // create zero_epression local for the rhs
         auto zero_expr = make_expression<NumberExpression>(e->location(), 0.0);
@@ -269,6 +409,9 @@ void SparseSolverVisitor::visit(BlockExpression* e) {
         steadystate_rhs_ = a_;
     }
     scale_factor_.resize(dvars_.size());
+    if (method_ == solverMethod::expm) {
+        jacobian_.assign(dvars_.size()*dvars_.size(), "");
+    }
 
     BlockRewriterBase::visit(e);
 }
@@ -332,7 +475,7 @@ void SparseSolverVisitor::visit(AssignmentExpression *e) {
         return;
     }
 
-    auto dt_expr = make_expression<IdentifierExpression>(loc, "dt");
+    auto dt_expr = make_expression<IdentifierExpression>(loc, dt_);
     auto one_expr = make_expression<NumberExpression>(loc, 1.0);
     for (unsigned j = 0; j<dvars_.size(); ++j) {
         expression_ptr expr;
@@ -353,6 +496,19 @@ void SparseSolverVisitor::visit(AssignmentExpression *e) {
             }
         }
 
+        // For the matrix exponential, the entry is the coefficient times the
+        // (scaled) time step.
+        if (method_ == solverMethod::expm) {
+            if (!expr) continue;
+
+            auto local_a_term = make_unique_local_assign(scope, expr.get(), "a_");
+            statements_.push_back(std::move(local_a_term.local_decl));
+            statements_.push_back(std::move(local_a_term.assignment));
+
+            jacobian_[deq_index_*dvars_.size()+j] = local_a_term.id->is_identifier()->spelling();
+            continue;
+        }
+
         if (solve_variant_ != solverVariant::steadystate) {
             if (j == deq_index_) {
                 if (expr) {
@@ -381,6 +537,9 @@ void SparseSolverVisitor::visit(AssignmentExpression *e) {
 }
 
 void SparseSolverVisitor::visit(ConserveExpression *e) {
+    // The exact update keeps the conserved quantities of the system.
+    if (method_ == solverMethod::expm) return;
+
     if (system_.empty()) {
         system_.create_square_matrix(dvars_.size());
     }
@@ -448,6 +607,11 @@ void SparseSolverVisitor::visit(ConserveExpression *e) {
 }
 
 void SparseSolverVisitor::finalize() {
+    if (method_ == solverMethod::expm) {
+        exponentiate();
+        BlockRewriterBase::finalize();
+        return;
+    }
 
     if (solve_variant_ == solverVariant::steadystate && !conserve_) {
         error({"Conserve statement(s) missing in steady-state solver", {}});
@@ -463,25 +627,49 @@ void SparseSolverVisitor::finalize() {
             rhs[conserve_idx_[i]] = conserve_rhs_[i];
         }
     }
-    system_.augment(rhs);
+
+    // The second SDIRK2 stage solves the same system, which is reduced afresh
+    // as the reduction below consumes it. Conserved quantities keep their
+    // right hand side; the state variables hold the initial values of the
+    // stage.
+    SystemSolver second_stage;
+    if (method_ == solverMethod::sdirk2) {
+        second_stage.copy_entries(system_);
+    }
+
+    solve(system_, rhs);
+
+    if (method_ == solverMethod::sdirk2) {
+        for (unsigned i = 0; i < dvars_.size(); ++i) {
+            statements_.push_back(sdirk2_second_stage(dvars_[i], dvar_init_[i], dvars_[i]));
+        }
+        solve(second_stage, rhs);
+    }
+
+    BlockRewriterBase::finalize();
+}
+
+void SparseSolverVisitor::solve(SystemSolver& system, const std::vector<std::string>& rhs) {
+    system.elimination(elimination_);
+    system.augment(rhs);
 
     // Reduce the system
-    auto row_symbols = system_.reduce();
+    auto row_symbols = system.reduce();
 
     // Row by row:
     // Generate entries of the system and declare and assign as local variables
     // Generate normalizing terms and normalize the row
     for (auto& row: row_symbols) {
-        auto entries = system_.generate_row_updates(block_scope_, row);
+        auto entries = system.generate_row_updates(block_scope_, row);
         for (auto& l: entries) {
             statements_.push_back(std::move(l.local_decl));
             statements_.push_back(std::move(l.assignment));
         }
 
         // If size of system > 5 normalize the row updates
-        if (system_.size() > 5) {
-            auto norm_term = system_.generate_normalizing_term(block_scope_, row);
-            auto norm_assigns = system_.generate_normalizing_assignments(norm_term.id->clone(), row);
+        if (system.size() > 5) {
+            auto norm_term = system.generate_normalizing_term(block_scope_, row);
+            auto norm_assigns = system.generate_normalizing_assignments(norm_term.id->clone(), row);
 
             statements_.push_back(std::move(norm_term.local_decl));
             statements_.push_back(std::move(norm_term.assignment));
@@ -489,11 +677,194 @@ void SparseSolverVisitor::finalize() {
         }
     }
 
+    for (auto& l: system.generate_back_substitution(block_scope_)) {
+        statements_.push_back(std::move(l.local_decl));
+        statements_.push_back(std::move(l.assignment));
+    }
+
     // Update the state variables
-    auto updates = system_.generate_solution_assignments(dvars_);
+    auto updates = system.generate_solution_assignments(dvars_);
     std::move(std::begin(updates), std::end(updates), std::back_inserter(statements_));
+}
 
-    BlockRewriterBase::finalize();
+namespace {
+// Straight-line code for dense matrix arithmetic: matrices are held row major
+// as the names of locals, with empty names for entries known to be zero.
+struct dense_code {
+    using matrix = std::vector<std::string>;
+
+    scope_ptr scope;
+    expr_list_type& statements;
+    unsigned n;
+    Location loc;
+
+    // Sum of terms, with a null expression for an empty sum.
+    struct sum {
+        expression_ptr value;
+
+        void add(expression_ptr e, bool negate = false) {
+            Location loc;
+            if (!value) {
+                value = negate? make_expression<NegUnaryExpression>(loc, std::move(e)): std::move(e);
+            }
+            else if (negate) {
+                value = make_expression<SubBinaryExpression>(loc, std::move(value), std::move(e));
+            }
+            else {
+                value = make_expression<AddBinaryExpression>(loc, std::move(value), std::move(e));
+            }
+        }
+    };
+
+    expression_ptr id(const std::string& name) const {
+        return make_expression<IdentifierExpression>(loc, name);
+    }
+
+    expression_ptr mul(expression_ptr a, expression_ptr b) const {
+        return make_expression<MulBinaryExpression>(loc, std::move(a), std::move(b));
+    }
+
+    // Define a local for `e`, returning its name, or the empty name if `e` is null.
+    std::string define(expression_ptr e, const char* prefix = "e_") {
+        if (!e) return "";
+        auto local = make_unique_local_assign(scope, e.get(), prefix);
+        statements.push_back(std::move(local.local_decl));
+        statements.push_back(std::move(local.assignment));
+        return local.id->is_identifier()->spelling();
+    }
+
+    matrix product(const matrix& a, const matrix& b) {
+        matrix c(n*n);
+        for (unsigned i = 0; i<n; ++i) {
+            for (unsigned j = 0; j<n; ++j) {
+                sum s;
+                for (unsigned k = 0; k<n; ++k) {
+                    if (a[i*n+k].empty() || b[k*n+j].empty()) continue;
+                    s.add(mul(id(a[i*n+k]), id(b[k*n+j])));
+                }
+                c[i*n+j] = define(std::move(s.value));
+            }
+        }
+        return c;
+    }
+
+    // Sum of the matrices `terms` scaled by their coefficients, plus `diag`
+    // times the identity.
+    matrix combine(const std::vector<std::pair<double, const matrix*>>& terms, double diag = 0) {
+        matrix c(n*n);
+        for (unsigned i = 0; i<n*n; ++i) {
+            sum s;
+            for (auto& [coef, m]: terms) {
+                const auto& x = (*m)[i];
+                if (x.empty()) continue;
+                if (coef==1 || coef==-1) {
+                    s.add(id(x), coef<0);
+                }
+                else {
+                    s.add(mul(make_expression<NumberExpression>(loc, coef), id(x)));
+                }
+            }
+            if (diag && i%(n+1)==0) {
+                s.add(make_expression<NumberExpression>(loc, diag));
+            }
+            c[i] = define(std::move(s.value));
+        }
+        return c;
+    }
+
+    // Solve a*x = b for x by Gaussian elimination without pivoting, which is
+    // stable for the diagonally dominant denominator of the Padé approximant.
+    matrix solve(matrix a, matrix b) {
+        std::vector<std::string> inv(n);
+        for (unsigned k = 0; k<n; ++k) {
+            inv[k] = define(make_expression<DivBinaryExpression>(loc,
+                make_expression<NumberExpression>(loc, 1.0), id(a[k*n+k])), "inv_");
+
+            for (unsigned i = k+1; i<n; ++i) {
+                if (a[i*n+k].empty()) continue;
+                auto l = define(mul(id(a[i*n+k]), id(inv[k])));
+
+                auto eliminate = [&](matrix& m, unsigned j) {
+                    if (m[k*n+j].empty()) return;
+                    sum s;
+                    if (!m[i*n+j].empty()) s.add(id(m[i*n+j]));
+                    s.add(mul(id(l), id(m[k*n+j])), true);
+                    m[i*n+j] = define(std::move(s.value));
+                };
+                for (unsigned j = k+1; j<n; ++j) eliminate(a, j);
+                for (unsigned j = 0; j<n; ++j) eliminate(b, j);
+            }
+        }
+
+        matrix x(n*n);
+        for (unsigned k = n; k-->0; ) {
+            for (unsigned j = 0; j<n; ++j) {
+                sum s;
+                if (!b[k*n+j].empty()) s.add(id(b[k*n+j]));
+                for (unsigned m = k+1; m<n; ++m) {
+                    if (a[k*n+m].empty() || x[m*n+j].empty()) continue;
+                    s.add(mul(id(a[k*n+m]), id(x[m*n+j])), true);
+                }
+                if (s.value) {
+                    x[k*n+j] = define(mul(std::move(s.value), id(inv[k])));
+                }
+            }
+        }
+        return x;
+    }
+
+    std::vector<std::string> apply(const matrix& a, const std::vector<std::string>& x) {
+        std::vector<std::string> y(n);
+        for (unsigned i = 0; i<n; ++i) {
+            sum s;
+            for (unsigned j = 0; j<n; ++j) {
+                if (a[i*n+j].empty() || x[j].empty()) continue;
+                s.add(mul(id(a[i*n+j]), id(x[j])));
+            }
+            y[i] = define(std::move(s.value), "y_");
+        }
+        return y;
+    }
+};
+} // anonymous namespace
+
+void SparseSolverVisitor::exponentiate() {
+    static_assert(expm::squarings>0);
+    using matrix = dense_code::matrix;
+
+    unsigned n = dvars_.size();
+    dense_code code{block_scope_, statements_, n};
+    const auto& b = expm::pade;
+
+    // Padé approximant of exp(A) for A = dt*J/2^squarings: with
+    // U = A*(b7*A^6 + b5*A^4 + b3*A^2 + b1*I) and
+    // V = b6*A^6 + b4*A^4 + b2*A^2 + b0*I, it is (V - U)^-1 (V + U).
+    const matrix& A = jacobian_;
+    matrix A2 = code.product(A, A);
+    matrix A4 = code.product(A2, A2);
+    matrix A6 = code.product(A4, A2);
+
+    matrix W = code.combine({{b[7], &A6}, {b[5], &A4}, {b[3], &A2}}, b[1]);
+    matrix U = code.product(A, W);
+    matrix V = code.combine({{b[6], &A6}, {b[4], &A4}, {b[2], &A2}}, b[0]);
+
+    matrix R = code.solve(code.combine({{1, &V}, {-1, &U}}), code.combine({{1, &V}, {1, &U}}));
+
+    // Square all but once, and apply the last two factors to the state.
+    for (unsigned k = 1; k<expm::squarings; ++k) {
+        R = code.product(R, R);
+    }
+
+    auto x = code.apply(R, code.apply(R, dvars_));
+
+    Location loc;
+    for (unsigned i = 0; i<n; ++i) {
+        if (x[i].empty()) {
+            x[i] = code.define(make_expression<NumberExpression>(loc, 0.0), "y_");
+        }
+        statements_.push_back(make_expression<AssignmentExpression>(loc,
+            code.id(dvars_[i]), code.id(x[i])));
+    }
 }
 
 void LinearSolverVisitor::visit(BlockExpression* e) {
@@ -537,6 +908,7 @@ void LinearSolverVisitor::visit(LinearExpression *e) {
 }
 
 void LinearSolverVisitor::finalize() {
+    system_.elimination(elimination_);
     system_.augment(rhs_);
 
     // Reduce the system
@@ -563,6 +935,11 @@ void LinearSolverVisitor::finalize() {
         }
     }
 
+    for (auto& l: system_.generate_back_substitution(block_scope_)) {
+        statements_.push_back(std::move(l.local_decl));
+        statements_.push_back(std::move(l.assignment));
+    }
+
     // Update the state variables
     auto updates = system_.generate_solution_assignments(dvars_);
     std::move(std::begin(updates), std::end(updates), std::back_inserter(statements_));
@@ -604,6 +981,7 @@ void SparseNonlinearSolverVisitor::visit(BlockExpression* e) {
             statements_.push_back(std::move(temp_dvar_term.assignment));
         }
     }
+    dt_ = solver_time_step(method_, e->scope(), statements_);
     scale_factor_.resize(dvars_.size());
 
     BlockRewriterBase::visit(e);
@@ -664,10 +1042,11 @@ void SparseNonlinearSolverVisitor::visit(AssignmentExpression *e) {
         return;
     }
 
-    auto dt_expr = make_expression<IdentifierExpression>(loc, "dt");
+    auto dt_expr = make_expression<IdentifierExpression>(loc, dt_);
     auto one_expr = make_expression<NumberExpression>(loc, 1.0);
 
     // Form and save F(y) = y - x(t) - dt G(y)
+    // (for SDIRK2, dt is gamma*dt, and x(t) the initial value of each stage)
     // y    are stored in dvar_temp_ and are updated at every iteration of Newton's method
     // x(t) are stored in dvar_init_ and are constant across iterations of Newton's method
     // G(y) is the rhs of the derivative assignment expression
@@ -758,6 +1137,7 @@ void SparseNonlinearSolverVisitor::finalize() {
         rhs.push_back(id);
     }
 
+    system_.elimination(elimination_);
     system_.augment(rhs);
 
     // Reduce the system
@@ -785,6 +1165,11 @@ void SparseNonlinearSolverVisitor::finalize() {
         }
     }
 
+    for (auto& l: system_.generate_back_substitution(block_scope_)) {
+        statements_.push_back(std::move(l.local_decl));
+        S_.push_back(std::move(l.assignment));
+    }
+
     // Update the state variables
     auto U_ = system_.generate_solution_assignments(dvar_temp_);
 
@@ -797,20 +1182,29 @@ void SparseNonlinearSolverVisitor::finalize() {
                 make_expression<SubBinaryExpression>(u->location(), lhs->clone(), rhs->clone()));
     }
 
-    // Do 3 Newton iterations
-    for (unsigned n = 0; n < 3; n++) {
-        // Print out the statements that calulate F(xn), J(xn), solve J(xn)^-1*F(xn), update xn -> xn+1
-        for (auto &s: F_) {
-            statements_.push_back(s->clone());
-        }
-        for (auto &s: J_) {
-            statements_.push_back(s->clone());
-        }
-        for (auto &s: S_) {
-            statements_.push_back(s->clone());
+    // Do 3 Newton iterations per stage
+    unsigned n_stages = method_ == solverMethod::sdirk2? 2: 1;
+    for (unsigned stage = 0; stage < n_stages; ++stage) {
+        if (stage > 0) {
+            // Start the second SDIRK2 stage from the result of the first.
+            for (unsigned i = 0; i < dvars_.size(); ++i) {
+                statements_.push_back(sdirk2_second_stage(dvar_init_[i], dvar_init_[i], dvar_temp_[i]));
+            }
         }
-        for (auto &s: U_) {
-            statements_.push_back(s->clone());
+        for (unsigned n = 0; n < 3; n++) {
+            // Print out the statements that calulate F(xn), J(xn), solve J(xn)^-1*F(xn), update xn -> xn+1
+            for (auto &s: F_) {
+                statements_.push_back(s->clone());
+            }
+            for (auto &s: J_) {
+                statements_.push_back(s->clone());
+            }
+            for (auto &s: S_) {
+                statements_.push_back(s->clone());
+            }
+            for (auto &s: U_) {
+                statements_.push_back(s->clone());
+            }
         }
     }
 
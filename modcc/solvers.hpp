@@ -20,12 +20,19 @@ protected:
     // list of identifier names appearing in derivatives on lhs
     std::vector<std::string> dvars_;
 
+    // Elimination scheme for the linear systems of sparse solvers.
+    symge::elimination elimination_ = symge::elimination::gauss_jordan;
+
 public:
     using BlockRewriterBase::visit;
 
     SolverVisitorBase() {}
     SolverVisitorBase(scope_ptr enclosing): BlockRewriterBase(enclosing) {}
 
+    void elimination(symge::elimination e) {
+        elimination_ = e;
+    }
+
     virtual std::vector<std::string> solved_identifiers() const {
         return dvars_;
     }
@@ -67,6 +74,38 @@ public:
     virtual void visit(AssignmentExpression *e) override;
 };
 
+// Euler-Maruyama step for s' = f(s) + sum_W g_W(s)*W, where each W is a
+// WHITE_NOISE variable holding a standard normal sample for the step: the
+// increment f*dt + sum_W g_W*W*dt^0.5 of every state is computed from the
+// states at the start of the step, and the states updated at the end.
+class EulerMaruyamaSolverVisitor : public SolverVisitorBase {
+protected:
+    // The WHITE_NOISE variables.
+    std::vector<std::string> noise_;
+
+    // Local holding the increment of each of dvars_.
+    std::vector<std::string> increments_;
+
+    // Local holding dt^0.5, once declared.
+    std::string sqrt_dt_;
+
+public:
+    using SolverVisitorBase::visit;
+
+    EulerMaruyamaSolverVisitor(std::vector<std::string> noise): noise_(std::move(noise)) {}
+    EulerMaruyamaSolverVisitor(scope_ptr enclosing, std::vector<std::string> noise):
+        SolverVisitorBase(enclosing), noise_(std::move(noise)) {}
+
+    virtual void visit(AssignmentExpression *e) override;
+    virtual void finalize() override;
+
+    virtual void reset() override {
+        increments_.clear();
+        sqrt_dt_.clear();
+        SolverVisitorBase::reset();
+    }
+};
+
 class SystemSolver {
 protected:
     // Symbolic matrix for backwards Euler step.
@@ -75,6 +114,13 @@ protected:
     // 'Symbol table' for initial variables.
     symge::symbol_table symtbl_;
 
+    symge::elimination elimination_ = symge::elimination::gauss_jordan;
+
+    // Markowitz elimination only: the pivots in order of elimination, and
+    // the names of the locals holding the solution, by column.
+    std::vector<symge::pivot> pivots_;
+    std::vector<std::string> solution_;
+
 public:
     struct system_loc {
         unsigned row, col;
@@ -85,6 +131,11 @@ public:
     void reset() {
         A_.clear();
         symtbl_.clear();
+        pivots_.clear();
+        solution_.clear();
+    }
+    void elimination(symge::elimination e) {
+        elimination_ = e;
     }
     unsigned size() const {
         return A_.size();
@@ -104,6 +155,17 @@ public:
     void add_entry(system_loc loc, std::string name) {
         A_[loc.row].push_back({loc.col, symtbl_.define(name)});
     }
+    // Replace the system with the unaugmented entries of `other`.
+    void copy_entries(const SystemSolver& other) {
+        reset();
+        elimination_ = other.elimination_;
+        create_square_matrix(other.A_.nrow());
+        for (unsigned i = 0; i<other.A_.nrow(); ++i) {
+            for (const auto& e: other.A_[i]) {
+                if (e.col<other.A_.nrow()) add_entry({i, e.col}, symge::name(e.value));
+            }
+        }
+    }
     void augment(std::vector<std::string> rhs) {
         std::vector<symge::symbol> rhs_sym;
         for (unsigned r = 0; r < rhs.size(); ++r) {
@@ -115,6 +177,10 @@ public:
     // Returns a vector of rows of symbols
     // Needed for normalization
     std::vector<std::vector<symge::symbol>> reduce() {
+        pivots_.clear();
+        if (elimination_==symge::elimination::markowitz) {
+            return symge::markowitz_reduce(A_, symtbl_, pivots_);
+        }
         return symge::gj_reduce(A_, symtbl_);
     }
 
@@ -127,14 +193,50 @@ public:
     // Given a row of symbols, generates expressions normalizing row updates
     std::vector<expression_ptr> generate_normalizing_assignments(expression_ptr normalizer, std::vector<symge::symbol> row_sym);
 
+    // Returns local assignments solving the reduced system by back
+    // substitution; empty unless reduced by Markowitz elimination.
+    std::vector<local_assignment> generate_back_substitution(scope_ptr scope);
+
     // Returns solution assignment of lhs_vars
     std::vector<expression_ptr> generate_solution_assignments(std::vector<std::string> lhs_vars);
 
 };
 
+// Coefficients of the two-stage, L-stable SDIRK method of order two: both
+// stages solve (I - gamma*dt*J) y = r, with r the initial state for the first
+// stage, and r = y0 + ratio*(y1 - y0) for the second, where y1 is the result of
+// the first stage. The result of the second stage is the new state.
+namespace sdirk2 {
+constexpr double gamma = 0.29289321881345247560; // 1 - 1/sqrt(2)
+constexpr double ratio = 2.41421356237309504880; // (1 - gamma)/gamma = 1 + sqrt(2)
+}
+
+// Matrix exponential update for linear homogeneous systems x' = Jx: the new
+// state is exp(dt*J)x, exact for J constant over the step. The exponential is
+// found by scaling and squaring: the degree 7 diagonal Padé approximant of
+// exp(dt*J/2^squarings) is squared `squarings` times. The approximant is
+// accurate to double precision for ||dt*J/2^squarings||_1 <= 0.95 (Higham,
+// SIAM J. Matrix Anal. Appl. 26, 2005), so for ||dt*J||_1 up to about 240.
+namespace expm {
+constexpr unsigned squarings = 8;
+constexpr double pade[] = {17297280., 8648640., 1995840., 277200., 25200., 1512., 56., 1.};
+}
+
 class SparseSolverVisitor : public SolverVisitorBase {
 protected:
     solverVariant solve_variant_;
+    solverMethod method_;
+
+    // Time step of the implicit solve(s): `dt`, or gamma*dt for SDIRK2; for
+    // the matrix exponential, the scaled step dt/2^squarings.
+    std::string dt_;
+
+    // SDIRK2 only: initial values of the state variables.
+    std::vector<std::string> dvar_init_;
+
+    // Matrix exponential only: entries of the scaled step times the Jacobian,
+    // row major, with empty names for zero entries.
+    std::vector<std::string> jacobian_;
 
     // 'Current' differential equation is for variable with this
     // index in `dvars`.
@@ -160,12 +262,19 @@ protected:
     // System Solver helper
     SystemSolver system_;
 
+    // Reduce `system` augmented with `rhs`, and assign the solution to the
+    // state variables.
+    void solve(SystemSolver& system, const std::vector<std::string>& rhs);
+
+    // Assign exp(dt*J)x to the state variables x.
+    void exponentiate();
+
 public:
     using SolverVisitorBase::visit;
 
-    explicit SparseSolverVisitor(solverVariant s = solverVariant::regular) :
-        solve_variant_(s) {}
-    SparseSolverVisitor(scope_ptr enclosing): SolverVisitorBase(enclosing) {}
+    explicit SparseSolverVisitor(solverVariant s = solverVariant::regular, solverMethod m = solverMethod::sparse) :
+        solve_variant_(s), method_(m) {}
+    SparseSolverVisitor(scope_ptr enclosing): SolverVisitorBase(enclosing), solve_variant_(solverVariant::regular), method_(solverMethod::sparse) {}
 
     virtual void visit(BlockExpression* e) override;
     virtual void visit(AssignmentExpression *e) override;
@@ -180,6 +289,9 @@ public:
         conserve_rhs_.clear();
         conserve_idx_.clear();
         steadystate_rhs_.clear();
+        dt_.clear();
+        dvar_init_.clear();
+        jacobian_.clear();
         system_.reset();
         SolverVisitorBase::reset();
     }
@@ -187,6 +299,11 @@ public:
 
 class SparseNonlinearSolverVisitor : public SolverVisitorBase {
 protected:
+    solverMethod method_;
+
+    // Time step of the implicit solve(s): `dt`, or gamma*dt for SDIRK2.
+    std::string dt_;
+
     // 'Current' differential equation is for variable with this
     // index in `dvars`.
     unsigned deq_index_ = 0;
@@ -212,8 +329,8 @@ protected:
 public:
     using SolverVisitorBase::visit;
 
-    SparseNonlinearSolverVisitor() {}
-    SparseNonlinearSolverVisitor(scope_ptr enclosing): SolverVisitorBase(enclosing) {}
+    explicit SparseNonlinearSolverVisitor(solverMethod m = solverMethod::sparse): method_(m) {}
+    SparseNonlinearSolverVisitor(scope_ptr enclosing): SolverVisitorBase(enclosing), method_(solverMethod::sparse) {}
 
     virtual void visit(BlockExpression* e) override;
     virtual void visit(AssignmentExpression *e) override;
@@ -225,6 +342,9 @@ public:
         local_expr_.clear();
         F_.clear();
         J_.clear();
+        dvar_temp_.clear();
+        dvar_init_.clear();
+        dt_.clear();
         scale_factor_.clear();
         system_.reset();
         SolverVisitorBase::reset();
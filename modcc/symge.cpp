@@ -7,11 +7,6 @@
 
 namespace symge {
 
-struct pivot {
-    unsigned row;
-    unsigned col;
-};
-
 
 // Returns q[c]*p - p[c]*q; new symbols required due to fill-in are provided by the
 // `define_sym` functor, which takes a `symbol_term_diff` and returns a `symbol`.
@@ -51,8 +46,10 @@ sym_row row_reduce(unsigned c, const sym_row& p, const sym_row& q, DefineSym def
 }
 
 // Estimate cost of a choice of pivot for G–J reduction below. Uses a simple greedy
-// estimate based on immediate fill cost.
-double estimate_cost(const sym_matrix& A, pivot p) {
+// estimate based on immediate fill cost. Only rows for which `reduced` is true
+// are counted.
+template <typename Pred>
+double estimate_cost(const sym_matrix& A, pivot p, Pred reduced) {
     unsigned nfill = 0;
 
     auto count_fill = [&nfill](symbol_term_diff t) {
@@ -63,13 +60,17 @@ double estimate_cost(const sym_matrix& A, pivot p) {
     };
 
     for (unsigned i = 0; i<A.nrow(); ++i) {
-        if (i==p.row || A[i].index(p.col)==msparse::row_npos) continue;
+        if (i==p.row || !reduced(i) || A[i].index(p.col)==msparse::row_npos) continue;
         row_reduce(p.col, A[i], A[p.row], count_fill);
     }
 
     return nfill;
 }
 
+double estimate_cost(const sym_matrix& A, pivot p) {
+    return estimate_cost(A, p, [](unsigned) { return true; });
+}
+
 // Perform Gauss-Jordan elimination on given symbolic matrix. New symbols
 // required due to fill-in are added to the supplied symbol table.
 //
@@ -144,4 +145,61 @@ std::vector<std::vector<symge::symbol>> gj_reduce(sym_matrix& A, symbol_table& t
     return row_symbols;
 }
 
+// Perform Gaussian elimination on given symbolic matrix, as for Gauss-Jordan
+// elimination above, but without reducing rows that have already provided a
+// pivot. The cost of a pivot is estimated by the fill among the remaining
+// rows; ties go to the least row index.
+//
+// A pivot is taken from the diagonal if non-zero, otherwise from the first
+// non-zero column: as the columns of earlier pivots have been eliminated
+// from the remaining rows, this is never a column already pivoted upon.
+std::vector<std::vector<symge::symbol>> markowitz_reduce(sym_matrix& A, symbol_table& table, std::vector<pivot>& pivots) {
+    std::vector<std::vector<symge::symbol>> row_symbols;
+
+    if (A.nrow()>A.ncol()) throw std::runtime_error("improper matrix for reduction");
+
+    auto define_sym = [&table](symbol_term_diff t) { return table.define(t); };
+
+    unsigned n = A.nrow();
+    std::vector<bool> eliminated(n, false);
+    auto remaining = [&eliminated](unsigned i) { return !eliminated[i]; };
+
+    for (unsigned k = 0; k<n; ++k) {
+        pivot best{msparse::row_npos, msparse::row_npos};
+        double best_cost = 0;
+
+        for (unsigned r = 0; r<n; ++r) {
+            if (eliminated[r]) continue;
+
+            const sym_row& row = A[r];
+            pivot p{r, r};
+            if (!row[r]) {
+                auto i = std::find_if(row.begin(), row.end(), [n](auto& e) { return e.col<n; });
+                if (i==row.end()) throw std::runtime_error("singular matrix for reduction");
+                p.col = i->col;
+            }
+
+            double cost = estimate_cost(A, p, remaining);
+            if (best.row==msparse::row_npos || cost<best_cost) {
+                best = p;
+                best_cost = cost;
+            }
+        }
+
+        eliminated[best.row] = true;
+        pivots.push_back(best);
+
+        for (unsigned i = 0; i<n; ++i) {
+            if (eliminated[i] || A[i].index(best.col)==msparse::row_npos) continue;
+            A[i] = row_reduce(best.col, A[i], A[best.row], define_sym);
+
+            std::vector<symge::symbol> row;
+            std::transform(A[i].begin(), A[i].end(), std::back_inserter(row),
+                           [](auto&& entry){ return entry.value; });
+            row_symbols.emplace_back(std::move(row));
+        }
+    }
+    return row_symbols;
+}
+
 } // namespace symge
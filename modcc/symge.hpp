@@ -150,10 +150,33 @@ inline bool primitive(symbol s) {
 using sym_row = msparse::row<symbol>;
 using sym_matrix = msparse::matrix<symbol>;
 
+// Elimination schemes for the reduction of a symbolic matrix.
+
+enum class elimination {
+    // Gauss-Jordan reduction to diagonal form.
+    gauss_jordan,
+    // Gaussian elimination to triangular form for back substitution, with
+    // pivots chosen by least fill among the rows not yet eliminated.
+    markowitz
+};
+
+struct pivot {
+    unsigned row;
+    unsigned col;
+};
+
 // Perform Gauss-Jordan reduction on a (possibly augmented) symbolic matrix, with
 // pivots taken from the diagonal elements. New symbol definitions due to fill-in
 // will be added via the provided symbol table.
 // Returns a vector of vectors of symbols, partitioned by row of the matrix
 std::vector<std::vector<symge::symbol>> gj_reduce(sym_matrix& A, symbol_table& table);
 
+// Perform Gaussian elimination on a (possibly augmented) symbolic matrix,
+// reducing only the rows that have not yet provided a pivot. The pivots are
+// appended to `pivots` in order of elimination: the row of each then has
+// non-zero entries in its pivot column, the pivot columns of later pivots,
+// and the augmented columns, for solution by back substitution.
+// Returns the updated rows as for gj_reduce.
+std::vector<std::vector<symge::symbol>> markowitz_reduce(sym_matrix& A, symbol_table& table, std::vector<pivot>& pivots);
+
 } // namespace symge
@@ -28,6 +28,7 @@ static Keyword keywords[] = {
     {"CONSTANT",    tok::constant},
     {"ASSIGNED",    tok::assigned},
     {"STATE",       tok::state},
+    {"WHITE_NOISE", tok::white_noise},
     {"BREAKPOINT",  tok::breakpoint},
     {"DERIVATIVE",  tok::derivative},
     {"KINETIC",     tok::kinetic},
@@ -51,6 +52,7 @@ static Keyword keywords[] = {
     {"SOLVE",       tok::solve},
     {"THREADSAFE",  tok::threadsafe},
     {"GLOBAL",      tok::global},
+    {"QUIESCENT",   tok::quiescent},
     {"POINT_PROCESS", tok::point_process},
     {"COMPARTMENT", tok::compartment},
     {"METHOD",      tok::method},
@@ -63,6 +65,9 @@ static Keyword keywords[] = {
     {"ELSE",        tok::else_stmt},
     {"cnexp",       tok::cnexp},
     {"sparse",      tok::sparse},
+    {"sdirk2",      tok::sdirk2},
+    {"expm",        tok::expm},
+    {"stochastic",  tok::stochastic},
     {"min",         tok::min},
     {"max",         tok::max},
     {"exp",         tok::exp},
@@ -110,6 +115,7 @@ static TokenString token_strings[] = {
     {"CONSTANT",    tok::constant},
     {"ASSIGNED",    tok::assigned},
     {"STATE",       tok::state},
+    {"WHITE_NOISE", tok::white_noise},
     {"BREAKPOINT",  tok::breakpoint},
     {"DERIVATIVE",  tok::derivative},
     {"KINETIC",     tok::kinetic},
@@ -132,6 +138,7 @@ static TokenString token_strings[] = {
     {"SOLVE",       tok::solve},
     {"THREADSAFE",  tok::threadsafe},
     {"GLOBAL",      tok::global},
+    {"QUIESCENT",   tok::quiescent},
     {"POINT_PROCESS", tok::point_process},
     {"COMPARTMENT", tok::compartment},
     {"METHOD",      tok::method},
@@ -149,6 +156,10 @@ static TokenString token_strings[] = {
     {"cos",         tok::cos},
     {"sin",         tok::sin},
     {"cnexp",       tok::cnexp},
+    {"sparse",      tok::sparse},
+    {"sdirk2",      tok::sdirk2},
+    {"expm",        tok::expm},
+    {"stochastic",  tok::stochastic},
     {"CONDUCTANCE", tok::conductance},
     {"error",       tok::reserved},
 };
@@ -52,7 +52,7 @@ enum class tok {
     // block keywoards
     title,
     neuron, units, parameter,
-    constant, assigned, state, breakpoint,
+    constant, assigned, state, white_noise, breakpoint,
     derivative, kinetic, procedure, initial, function, linear,
     net_receive, post_event,
 
@@ -62,7 +62,7 @@ enum class tok {
     read, write, valence,
     range, local, conserve, compartment,
     solve, method, steadystate,
-    threadsafe, global,
+    threadsafe, global, quiescent,
     point_process,
     from, to,
 
@@ -79,6 +79,9 @@ enum class tok {
     // solver methods
     cnexp,
     sparse,
+    sdirk2,
+    expm,
+    stochastic,
 
     conductance,
 
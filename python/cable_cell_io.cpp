@@ -3,6 +3,7 @@
 
 #include <fstream>
 #include <iomanip>
+#include <sstream>
 
 #include <arbor/cable_cell.hpp>
 
@@ -36,6 +37,29 @@ void write_component(const arborio::cable_cell_component& component, const std::
     arborio::write_component(fid, component);
 }
 
+// The compact binary form of a component, as bytes.
+pybind11::bytes component_to_bytes(const arborio::cable_cell_component& component) {
+    std::ostringstream out(std::ios::binary);
+    arborio::write_component_binary(out, component);
+    return pybind11::bytes(out.str());
+}
+
+// Read a component from any contiguous buffer holding its binary form, such
+// as bytes, a bytearray or a numpy array received over MPI.
+arborio::cable_cell_component component_from_bytes(pybind11::buffer data) {
+    auto info = data.request();
+    const auto n = info.size*info.itemsize;
+    if (info.ndim>1 || (info.ndim==1 && info.strides[0]!=info.itemsize && info.size>1)) {
+        throw pyarb_error("binary component data must be a contiguous buffer");
+    }
+    const char* begin = static_cast<const char*>(info.ptr);
+    auto component = arborio::read_component_binary(begin, begin+n);
+    if (!component) {
+        throw pyarb_error(std::string("Error while trying to read binary component: ") + component.error().what());
+    }
+    return component.value();
+}
+
 void register_cable_loader(pybind11::module& m) {
     m.def("load_component",
           &load_component,
@@ -82,6 +106,37 @@ void register_cable_loader(pybind11::module& m) {
           pybind11::arg_v("filename", "the name of the file."),
           "Write cable_cell to file.");
 
+    m.def("component_to_bytes",
+          [](const arborio::cable_cell_component& d) { return component_to_bytes(d); },
+          pybind11::arg_v("object", "the cable_component object."),
+          "Return the compact binary form of a cable_component, as read by component_from_bytes.");
+
+    m.def("component_to_bytes",
+          [](const arb::decor& d) { return component_to_bytes({{}, d}); },
+          pybind11::arg_v("object", "the decor object."),
+          "Return the compact binary form of a decor, as read by component_from_bytes.");
+
+    m.def("component_to_bytes",
+          [](const arb::label_dict& d) { return component_to_bytes({{}, d}); },
+          pybind11::arg_v("object", "the label_dict object."),
+          "Return the compact binary form of a label_dict, as read by component_from_bytes.");
+
+    m.def("component_to_bytes",
+          [](const arb::morphology& d) { return component_to_bytes({{}, d}); },
+          pybind11::arg_v("object", "the morphology object."),
+          "Return the compact binary form of a morphology, as read by component_from_bytes.");
+
+    m.def("component_to_bytes",
+          [](const arb::cable_cell& d) { return component_to_bytes({{}, d}); },
+          pybind11::arg_v("object", "the cable_cell object."),
+          "Return the compact binary form of a cable_cell, as read by component_from_bytes.");
+
+    m.def("component_from_bytes",
+          &component_from_bytes,
+          pybind11::arg_v("data", "a buffer holding the binary form of a component."),
+          "Read a cable_component (decor, morphology, label_dict, cable_cell) from its binary form,\n"
+          "in any object supporting the buffer protocol, such as bytes or a numpy array.");
+
     // arborio::meta_data
     pybind11::class_<arborio::meta_data> component_meta_data(m, "component_meta_data");
     component_meta_data
@@ -1,4 +1,8 @@
+#include <algorithm>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include <pybind11/pybind11.h>
 #include <pybind11/numpy.h>
@@ -13,6 +17,7 @@
 #include <arbor/sampling.hpp>
 #include <arbor/util/any_ptr.hpp>
 
+#include "error.hpp"
 #include "pyarb.hpp"
 #include "strprintf.hpp"
 
@@ -28,12 +33,35 @@ namespace pyarb {
 template <typename Meta>
 struct recorder_cable_base: sample_recorder {
     // Return stride-column array: first column is time, remainder correspond to sample.
+    //
+    // Rows are stored in chunks that are never reallocated: a full chunk is
+    // followed by one of twice the capacity. The arrays returned view the rows
+    // of a chunk in place, sharing ownership of the chunk, and are read-only.
+    // Rows spanning more than one chunk are copied; samples() then gathers all
+    // rows into a single chunk, so that later calls are again without copies.
+    //
+    // Samples are recorded while the simulation runs without the GIL, so the
+    // rows may be read from another Python thread during a run; the mutex is
+    // taken once for each batch of samples recorded.
+
+    py::object samples() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (chunks_.size()>1) {
+            auto all = std::make_shared<chunk>();
+            all->reserve(std::max(2*n_row_, min_chunk_rows)*stride_);
+            for (auto& c: chunks_) {
+                all->insert(all->end(), c->begin(), c->end());
+            }
+            chunks_.assign(1, std::move(all));
+        }
+        return rows(0, n_row_);
+    }
 
-    py::object samples() const override {
-        auto n_record = std::ptrdiff_t(sample_raw_.size()/stride_);
-        return py::array_t<double>(
-                    std::vector<std::ptrdiff_t>{n_record, stride_},
-                    sample_raw_.data());
+    py::object new_samples() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto first = read_row_;
+        read_row_ = n_row_;
+        return rows(first, n_row_);
     }
 
     py::object meta() const override {
@@ -41,28 +69,84 @@ struct recorder_cable_base: sample_recorder {
     }
 
     void reset() override {
-        sample_raw_.clear();
+        std::lock_guard<std::mutex> lock(mutex_);
+        chunks_.clear();
+        n_row_ = 0;
+        read_row_ = 0;
     }
 
 protected:
+    using chunk = std::vector<double>;
+    static constexpr std::size_t min_chunk_rows = 1024;
+
     Meta meta_;
-    std::vector<double> sample_raw_;
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<chunk>> chunks_;
+    std::size_t n_row_ = 0;
+    std::size_t read_row_ = 0;
     std::ptrdiff_t stride_;
 
     recorder_cable_base(const Meta* meta_ptr, std::ptrdiff_t width):
         meta_(*meta_ptr), stride_(1+width)
     {}
+
+    // The chunk to which the next row is to be appended.
+    chunk& row_buffer() {
+        if (chunks_.empty() || chunks_.back()->size()+stride_>chunks_.back()->capacity()) {
+            std::size_t rows = chunks_.empty()? min_chunk_rows: 2*(chunks_.back()->capacity()/stride_);
+            chunks_.push_back(std::make_shared<chunk>());
+            chunks_.back()->reserve(rows*stride_);
+        }
+        ++n_row_;
+        return *chunks_.back();
+    }
+
+    // Rows [first, last) as a read-only array.
+    py::object rows(std::size_t first, std::size_t last) const {
+        const auto n = std::ptrdiff_t(last-first);
+        py::array_t<double> result;
+
+        std::size_t base = 0;
+        auto c = chunks_.begin();
+        for (; c!=chunks_.end() && base+(*c)->size()/stride_<=first; ++c) {
+            base += (*c)->size()/stride_;
+        }
+
+        if (c!=chunks_.end() && last<=base+(*c)->size()/stride_) {
+            // View the rows in place.
+            auto owner = new std::shared_ptr<chunk>(*c);
+            py::capsule base_obj(owner, [](void* p) { delete static_cast<std::shared_ptr<chunk>*>(p); });
+            result = py::array_t<double>(
+                        std::vector<std::ptrdiff_t>{n, stride_},
+                        (*c)->data()+(first-base)*stride_,
+                        base_obj);
+        }
+        else {
+            result = py::array_t<double>(std::vector<std::ptrdiff_t>{n, stride_});
+            double* out = result.mutable_data();
+            for (; c!=chunks_.end() && base<last; ++c) {
+                std::size_t rows_in_chunk = (*c)->size()/stride_;
+                std::size_t b = std::max(first, base), e = std::min(last, base+rows_in_chunk);
+                out = std::copy((*c)->data()+(b-base)*stride_, (*c)->data()+(e-base)*stride_, out);
+                base += rows_in_chunk;
+            }
+        }
+        result.attr("setflags")(py::arg("write") = false);
+        return std::move(result);
+    }
 };
 
 template <typename Meta>
 struct recorder_cable_scalar: recorder_cable_base<Meta> {
-    using recorder_cable_base<Meta>::sample_raw_;
+    using recorder_cable_base<Meta>::row_buffer;
 
     void record(any_ptr, std::size_t n_sample, const arb::sample_record* records) override {
+        std::lock_guard<std::mutex> lock(this->mutex_);
         for (std::size_t i = 0; i<n_sample; ++i) {
             if (auto* v_ptr =any_cast<const double*>(records[i].data)) {
-                sample_raw_.push_back(records[i].time);
-                sample_raw_.push_back(*v_ptr);
+                auto& buf = row_buffer();
+                buf.push_back(records[i].time);
+                buf.push_back(*v_ptr);
             }
             else {
                 throw arb::arbor_internal_error("unexpected sample type");
@@ -76,13 +160,15 @@ protected:
 
 template <typename Meta>
 struct recorder_cable_vector: recorder_cable_base<Meta> {
-    using recorder_cable_base<Meta>::sample_raw_;
+    using recorder_cable_base<Meta>::row_buffer;
 
     void record(any_ptr, std::size_t n_sample, const arb::sample_record* records) override {
+        std::lock_guard<std::mutex> lock(this->mutex_);
         for (std::size_t i = 0; i<n_sample; ++i) {
             if (auto* v_ptr = any_cast<const arb::cable_sample_range*>(records[i].data)) {
-                sample_raw_.push_back(records[i].time);
-                sample_raw_.insert(sample_raw_.end(), v_ptr->first, v_ptr->second);
+                auto& buf = row_buffer();
+                buf.push_back(records[i].time);
+                buf.insert(buf.end(), v_ptr->first, v_ptr->second);
             }
             else {
                 throw arb::arbor_internal_error("unexpected sample type");
@@ -117,6 +203,11 @@ struct recorder_cable_vector_point_info: recorder_cable_vector<std::vector<arb::
         recorder_cable_vector(meta_ptr, std::ptrdiff_t(meta_ptr->size())) {}
 };
 
+struct recorder_cable_vector_mpoint: recorder_cable_vector<std::vector<arb::mpoint>> {
+    explicit recorder_cable_vector_mpoint(const std::vector<arb::mpoint>* meta_ptr):
+        recorder_cable_vector(meta_ptr, std::ptrdiff_t(meta_ptr->size())) {}
+};
+
 // Helper for registering sample recorder factories and (trivial) metadata conversions.
 
 template <typename Meta, typename Recorder>
@@ -163,6 +254,15 @@ arb::probe_info cable_probe_stimulus_current_cell() {
     return arb::cable_probe_stimulus_current_cell{};
 }
 
+arb::probe_info cable_probe_extracellular_potential(std::vector<arb::mpoint> electrodes, double sigma, const std::string& method) {
+    arb::extracellular_method m;
+    if (method=="line") m = arb::extracellular_method::line_source;
+    else if (method=="point") m = arb::extracellular_method::point_source;
+    else throw pyarb_error("extracellular method must be 'line' or 'point', not '"+method+"'");
+
+    return arb::cable_probe_extracellular_potential{std::move(electrodes), sigma, m};
+}
+
 arb::probe_info cable_probe_density_state(const char* where, const char* mechanism, const char* state) {
     return arb::cable_probe_density_state{arborio::parse_locset_expression(where).unwrap(), mechanism, state};
 };
@@ -252,6 +352,11 @@ void register_cable_probes(pybind11::module& m, pyarb_global_ptr global_ptr) {
     m.def("cable_probe_stimulus_current_cell", &cable_probe_stimulus_current_cell,
         "Probe specification for cable cell stimulus current across each cable in each CV.");
 
+    m.def("cable_probe_extracellular_potential", &cable_probe_extracellular_potential,
+        "Probe specification for the extracellular potential due to the cable cell's membrane current at each electrode,\n"
+        "in a medium of conductivity sigma [S/m], treating CVs as 'line' or 'point' sources.",
+        "electrodes"_a, "sigma"_a=0.3, "method"_a="line");
+
     m.def("cable_probe_density_state", &cable_probe_density_state,
         "Probe specification for a cable cell density mechanism state variable at points in a location set.",
         "where"_a, "mechanism"_a, "state"_a);
@@ -298,6 +403,7 @@ void register_cable_probes(pybind11::module& m, pyarb_global_ptr global_ptr) {
     register_probe_meta_maps<arb::cable_probe_point_info, recorder_cable_scalar_point_info>(global_ptr);
     register_probe_meta_maps<arb::mcable_list, recorder_cable_vector_mcable>(global_ptr);
     register_probe_meta_maps<std::vector<arb::cable_probe_point_info>, recorder_cable_vector_point_info>(global_ptr);
+    register_probe_meta_maps<std::vector<arb::mpoint>, recorder_cable_vector_mpoint>(global_ptr);
 }
 
 } // namespace pyarb
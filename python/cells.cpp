@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <any>
 #include <cstddef>
+#include <cstdint>
 #include <optional>
 #include <string>
 #include <unordered_map>
@@ -14,8 +15,10 @@
 #include <arborio/cv_policy_parse.hpp>
 #include <arborio/label_parse.hpp>
 
+#include <arbor/adex_cell.hpp>
 #include <arbor/benchmark_cell.hpp>
 #include <arbor/cable_cell.hpp>
+#include <arbor/izhikevich_cell.hpp>
 #include <arbor/lif_cell.hpp>
 #include <arbor/cv_policy.hpp>
 #include <arbor/morph/label_dict.hpp>
@@ -97,6 +100,10 @@ arb::cv_policy make_cv_policy_max_extent(double cv_length, const std::string& re
     return arb::cv_policy_max_extent(cv_length, arborio::parse_region_expression(reg).unwrap());
 }
 
+arb::cv_policy make_cv_policy_d_lambda(double d_lambda, double freq, const std::string& reg) {
+    return arb::cv_policy_d_lambda(d_lambda, freq, arborio::parse_region_expression(reg).unwrap());
+}
+
 // Helper for finding a mechanism description in a Python object.
 // Allows rev_pot_method to be specified with string or mechanism_desc
 std::optional<arb::mechanism_desc> maybe_method(pybind11::object method) {
@@ -124,6 +131,18 @@ std::string lif_str(const arb::lif_cell& c){
         c.tau_m, c.V_th, c.C_m, c.E_L, c.V_m, c.t_ref, c.V_reset);
 }
 
+std::string adex_str(const arb::adex_cell& c){
+    return util::pprintf(
+        "<arbor.adex_cell: C_m {}, g_L {}, E_L {}, V_T {}, Delta_T {}, V_peak {}, V_reset {}, t_ref {}, a {}, b {}, tau_w {}>",
+        c.C_m, c.g_L, c.E_L, c.V_T, c.Delta_T, c.V_peak, c.V_reset, c.t_ref, c.a, c.b, c.tau_w);
+}
+
+std::string izhikevich_str(const arb::izhikevich_cell& c){
+    return util::pprintf(
+        "<arbor.izhikevich_cell: a {}, b {}, c {}, d {}, v_peak {}>",
+        c.a, c.b, c.c, c.d, c.v_peak);
+}
+
 
 std::string mechanism_desc_str(const arb::mechanism_desc& md) {
     return util::pprintf("mechanism('{}', {})",
@@ -161,6 +180,31 @@ void register_cells(pybind11::module& m) {
         .def("__repr__", [](const arb::spike_source_cell&){return "<arbor.spike_source_cell>";})
         .def("__str__",  [](const arb::spike_source_cell&){return "<arbor.spike_source_cell>";});
 
+    // arb::poisson_source_cell
+
+    pybind11::class_<arb::poisson_source_cell> poisson_source_cell(m, "poisson_source_cell",
+        "A spike source cell that generates spikes as a Poisson process, reproducibly for any\n"
+        "domain decomposition and number of threads.");
+
+    poisson_source_cell
+        .def(pybind11::init<>(
+            [](arb::cell_tag_type source_label, arb::time_type freq, std::uint64_t seed, arb::time_type tstart, arb::time_type tstop){
+                return arb::poisson_source_cell(std::move(source_label), freq, seed, tstart, tstop);}),
+            "source_label"_a, "freq"_a, "seed"_a=0, "tstart"_a=0., "tstop"_a=arb::terminal_time,
+            "Construct a Poisson source cell with a single source labeled 'source_label', that spikes\n"
+            "with mean rate 'freq' [kHz] from 'tstart' until 'tstop' [ms], with spike times drawn\n"
+            "from a generator keyed by 'seed' and the gid of the cell.")
+        .def_readwrite("freq", &arb::poisson_source_cell::rate_kHz,
+            "Mean rate [kHz].")
+        .def_readwrite("seed", &arb::poisson_source_cell::seed,
+            "Seed of the generator.")
+        .def_readwrite("tstart", &arb::poisson_source_cell::tstart,
+            "Start of the process [ms].")
+        .def_readwrite("tstop", &arb::poisson_source_cell::tstop,
+            "End of the process [ms].")
+        .def("__repr__", [](const arb::poisson_source_cell&){return "<arbor.poisson_source_cell>";})
+        .def("__str__",  [](const arb::poisson_source_cell&){return "<arbor.poisson_source_cell>";});
+
     // arb::benchmark_cell
 
     pybind11::class_<arb::benchmark_cell> benchmark_cell(m, "benchmark_cell",
@@ -168,25 +212,36 @@ void register_cells(pybind11::module& m) {
         "A benchmark cell generates spikes at a user-defined sequence of time points, and\n"
         "the time taken to integrate a cell can be tuned by setting the realtime_ratio,\n"
         "for example if realtime_ratio=2, a cell will take 2 seconds of CPU time to\n"
-        "simulate 1 second.\n");
+        "simulate 1 second. A synthetic workload can be set: at each time step, the cell\n"
+        "streams through state_bytes of state with flops multiply-adds per value, and each\n"
+        "event updates event_bytes of the state.\n");
 
     benchmark_cell
         .def(pybind11::init<>(
-            [](arb::cell_tag_type source_label, arb::cell_tag_type target_label, const regular_schedule_shim& sched, double ratio){
-                return arb::benchmark_cell{std::move(source_label), std::move(target_label), sched.schedule(), ratio};}),
+            [](arb::cell_tag_type source_label, arb::cell_tag_type target_label, const regular_schedule_shim& sched, double ratio,
+               std::size_t state_bytes, unsigned flops, std::size_t event_bytes){
+                return arb::benchmark_cell{std::move(source_label), std::move(target_label), sched.schedule(), ratio,
+                                         arb::benchmark_workload{state_bytes, flops, event_bytes}};}),
             "source_label"_a, "target_label"_a,"schedule"_a, "realtime_ratio"_a=1.0,
+            "state_bytes"_a=0, "flops"_a=1, "event_bytes"_a=0,
             "Construct a benchmark cell that generates spikes on 'source_label' at regular intervals.\n"
             "The cell has one source labeled 'source_label', and one target labeled 'target_label'.")
         .def(pybind11::init<>(
-            [](arb::cell_tag_type source_label, arb::cell_tag_type target_label, const explicit_schedule_shim& sched, double ratio){
-                return arb::benchmark_cell{std::move(source_label), std::move(target_label),sched.schedule(), ratio};}),
+            [](arb::cell_tag_type source_label, arb::cell_tag_type target_label, const explicit_schedule_shim& sched, double ratio,
+               std::size_t state_bytes, unsigned flops, std::size_t event_bytes){
+                return arb::benchmark_cell{std::move(source_label), std::move(target_label),sched.schedule(), ratio,
+                                         arb::benchmark_workload{state_bytes, flops, event_bytes}};}),
             "source_label"_a, "target_label"_a, "schedule"_a, "realtime_ratio"_a=1.0,
+            "state_bytes"_a=0, "flops"_a=1, "event_bytes"_a=0,
             "Construct a benchmark cell that generates spikes on 'source_label' at a sequence of user-defined times.\n"
             "The cell has one source labeled 'source_label', and one target labeled 'target_label'.")
         .def(pybind11::init<>(
-            [](arb::cell_tag_type source_label, arb::cell_tag_type target_label, const poisson_schedule_shim& sched, double ratio){
-                return arb::benchmark_cell{std::move(source_label), std::move(target_label), sched.schedule(), ratio};}),
+            [](arb::cell_tag_type source_label, arb::cell_tag_type target_label, const poisson_schedule_shim& sched, double ratio,
+               std::size_t state_bytes, unsigned flops, std::size_t event_bytes){
+                return arb::benchmark_cell{std::move(source_label), std::move(target_label), sched.schedule(), ratio,
+                                         arb::benchmark_workload{state_bytes, flops, event_bytes}};}),
             "source_label"_a, "target_label"_a, "schedule"_a, "realtime_ratio"_a=1.0,
+            "state_bytes"_a=0, "flops"_a=1, "event_bytes"_a=0,
             "Construct a benchmark cell that generates spikeson 'source_label' at times defined by a Poisson sequence.\n"
             "The cell has one source labeled 'source_label', and one target labeled 'target_label'.")
         .def("__repr__", [](const arb::benchmark_cell&){return "<arbor.benchmark_cell>";})
@@ -224,6 +279,86 @@ void register_cells(pybind11::module& m) {
         .def("__repr__", &lif_str)
         .def("__str__",  &lif_str);
 
+    // arb::adex_cell
+
+    pybind11::class_<arb::adex_cell> adex_cell(m, "adex_cell",
+        "An adaptive exponential integrate-and-fire cell.");
+
+    adex_cell
+        .def(pybind11::init<>(
+            [](arb::cell_tag_type source_label, arb::cell_tag_type target_label){
+                return arb::adex_cell(std::move(source_label), std::move(target_label));}),
+            "source_label"_a, "target_label"_a,
+            "Construct an AdEx cell with one source labeled 'source_label', and one target labeled 'target_label'.")
+        .def_readwrite("C_m", &arb::adex_cell::C_m,
+            "Membrane capacitance [pF].")
+        .def_readwrite("g_L", &arb::adex_cell::g_L,
+            "Leak conductance [nS].")
+        .def_readwrite("E_L", &arb::adex_cell::E_L,
+            "Resting potential [mV].")
+        .def_readwrite("V_T", &arb::adex_cell::V_T,
+            "Threshold of the exponential term [mV].")
+        .def_readwrite("Delta_T", &arb::adex_cell::Delta_T,
+            "Slope factor of the exponential term [mV].")
+        .def_readwrite("V_peak", &arb::adex_cell::V_peak,
+            "Spike detection threshold [mV].")
+        .def_readwrite("V_reset", &arb::adex_cell::V_reset,
+            "Reset potential [mV].")
+        .def_readwrite("t_ref", &arb::adex_cell::t_ref,
+            "Refractory period [ms].")
+        .def_readwrite("a", &arb::adex_cell::a,
+            "Subthreshold adaptation [nS].")
+        .def_readwrite("b", &arb::adex_cell::b,
+            "Spike triggered adaptation [pA].")
+        .def_readwrite("tau_w", &arb::adex_cell::tau_w,
+            "Adaptation time constant [ms].")
+        .def_readwrite("V_m", &arb::adex_cell::V_m,
+            "Initial value of the membrane potential [mV].")
+        .def_readwrite("w", &arb::adex_cell::w,
+            "Initial value of the adaptation current [pA].")
+        .def_readwrite("solver", &arb::adex_cell::solver,
+            "Integration scheme.")
+        .def_readwrite("source", &arb::adex_cell::source,
+            "Label of the single build-in source on the cell.")
+        .def_readwrite("target", &arb::adex_cell::target,
+            "Label of the single build-in target on the cell.")
+        .def("__repr__", &adex_str)
+        .def("__str__",  &adex_str);
+
+    // arb::izhikevich_cell
+
+    pybind11::class_<arb::izhikevich_cell> izhikevich_cell(m, "izhikevich_cell",
+        "An Izhikevich cell.");
+
+    izhikevich_cell
+        .def(pybind11::init<>(
+            [](arb::cell_tag_type source_label, arb::cell_tag_type target_label){
+                return arb::izhikevich_cell(std::move(source_label), std::move(target_label));}),
+            "source_label"_a, "target_label"_a,
+            "Construct an Izhikevich cell with one source labeled 'source_label', and one target labeled 'target_label'.")
+        .def_readwrite("a", &arb::izhikevich_cell::a,
+            "Time scale of the recovery variable [1/ms].")
+        .def_readwrite("b", &arb::izhikevich_cell::b,
+            "Sensitivity of the recovery variable.")
+        .def_readwrite("c", &arb::izhikevich_cell::c,
+            "Reset potential [mV].")
+        .def_readwrite("d", &arb::izhikevich_cell::d,
+            "Increase of the recovery variable on a spike.")
+        .def_readwrite("v_peak", &arb::izhikevich_cell::v_peak,
+            "Spike detection threshold [mV].")
+        .def_readwrite("v", &arb::izhikevich_cell::v,
+            "Initial value of the membrane potential [mV].")
+        .def_readwrite("u", &arb::izhikevich_cell::u,
+            "Initial value of the recovery variable.")
+        .def_readwrite("solver", &arb::izhikevich_cell::solver,
+            "Integration scheme.")
+        .def_readwrite("source", &arb::izhikevich_cell::source,
+            "Label of the single build-in source on the cell.")
+        .def_readwrite("target", &arb::izhikevich_cell::target,
+            "Label of the single build-in target on the cell.")
+        .def("__repr__", &izhikevich_str)
+        .def("__str__",  &izhikevich_str);
+
     // arb::label_dict
 
     pybind11::class_<label_dict_proxy> label_dict(m, "label_dict",
@@ -306,6 +441,13 @@ void register_cells(pybind11::module& m) {
           "domain"_a="(all)", "the domain to which the policy is to be applied",
           "Policy to use as many CVs as required to ensure that no CV has a length longer than a given value.");
 
+    m.def("cv_policy_d_lambda",
+          &make_cv_policy_d_lambda,
+          "d_lambda"_a, "the maximum CV length as a fraction of the AC length constant",
+          "freq"_a=100., "the frequency [Hz] at which the length constant is computed",
+          "domain"_a="(all)", "the domain to which the policy is to be applied",
+          "Policy to use as many CVs as required to ensure that no CV has an electrotonic length longer than a given fraction of the AC length constant.");
+
     m.def("cv_policy_fixed_per_branch",
           &make_cv_policy_fixed_per_branch,
           "n"_a, "the number of CVs per branch",
@@ -408,7 +550,7 @@ void register_cells(pybind11::module& m) {
             [](arb::cable_cell_global_properties& props, const char* ion,
                optional<double> valence, optional<double> int_con,
                optional<double> ext_con, optional<double> rev_pot,
-               pybind11::object method)
+               pybind11::object method, optional<double> diffusivity)
             {
                 if (!props.ion_species.count(ion) && !valence) {
                     throw std::runtime_error(util::pprintf("New ion species: '{}', missing valence", ion));
@@ -419,6 +561,7 @@ void register_cells(pybind11::module& m) {
                 if (int_con) data.init_int_concentration = *int_con;
                 if (ext_con) data.init_ext_concentration = *ext_con;
                 if (rev_pot) data.init_reversal_potential = *rev_pot;
+                if (diffusivity) data.diffusivity = *diffusivity;
 
                 if (auto m = maybe_method(method)) {
                     props.default_parameters.reversal_potential_method[ion] = *m;
@@ -430,6 +573,7 @@ void register_cells(pybind11::module& m) {
             pybind11::arg_v("ext_con", pybind11::none(), "initial external concentration [mM]."),
             pybind11::arg_v("rev_pot", pybind11::none(), "reversal potential [mV]."),
             pybind11::arg_v("method",  pybind11::none(), "method for calculating reversal potential."),
+            pybind11::arg_v("diffusivity", pybind11::none(), "longitudinal diffusivity of the internal concentration [m²/s]."),
             "Set the global default properties of ion species named 'ion'.\n"
             "There are 3 ion species predefined in arbor: 'ca', 'na' and 'k'.\n"
             "If 'ion' in not one of these ions it will be added to the list, making it\n"
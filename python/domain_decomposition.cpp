@@ -30,8 +30,8 @@ std::string dd_string(const arb::domain_decomposition& d) {
 
 std::string ph_string(const arb::partition_hint& h) {
     return util::pprintf(
-        "<arbor.partition_hint: cpu_group_size {}, gpu_group_size {}, prefer_gpu {}>",
-        h.cpu_group_size, h.gpu_group_size, (h.prefer_gpu == 1) ? "True" : "False");
+        "<arbor.partition_hint: cpu_group_size {}, gpu_group_size {}, prefer_gpu {}, cpu_fraction {}>",
+        h.cpu_group_size, h.gpu_group_size, (h.prefer_gpu == 1) ? "True" : "False", h.cpu_fraction);
 }
 
 void register_domain_decomposition(pybind11::module& m) {
@@ -50,6 +50,8 @@ void register_domain_decomposition(pybind11::module& m) {
             "The list of gids of the cells in the group.")
         .def_readonly("backend", &arb::group_description::backend,
             "The hardware backend on which the cell group will run.")
+        .def_readonly("device", &arb::group_description::device,
+            "For the GPU backend, the index of the local GPU on which the cell group will run.")
         .def("__str__",  &gd_string)
         .def("__repr__", &gd_string);
 
@@ -57,20 +59,23 @@ void register_domain_decomposition(pybind11::module& m) {
     pybind11::class_<arb::partition_hint> partition_hint(m, "partition_hint",
         "Provide a hint on how the cell groups should be partitioned.");
     partition_hint
-        .def(pybind11::init<std::size_t, std::size_t, bool>(),
-            "cpu_group_size"_a = 1, "gpu_group_size"_a = std::numeric_limits<std::size_t>::max(), "prefer_gpu"_a = true,
+        .def(pybind11::init<std::size_t, std::size_t, bool, double>(),
+            "cpu_group_size"_a = 1, "gpu_group_size"_a = std::numeric_limits<std::size_t>::max(), "prefer_gpu"_a = true, "cpu_fraction"_a = 0.,
             "Construct a partition hint with arguments:\n"
             "  cpu_group_size: The size of cell group assigned to CPU, each cell in its own group by default.\n"
             "                  Must be positive, else set to default value.\n"
             "  gpu_group_size: The size of cell group assigned to GPU, all cells in one group by default.\n"
             "                  Must be positive, else set to default value.\n"
-            "  prefer_gpu:     Whether GPU is preferred, True by default.")
+            "  prefer_gpu:     Whether GPU is preferred, True by default.\n"
+            "  cpu_fraction:   Fraction of the cost of GPU cells to run on the CPU instead, 0 by default.")
         .def_readwrite("cpu_group_size", &arb::partition_hint::cpu_group_size,
                                         "The size of cell group assigned to CPU.")
         .def_readwrite("gpu_group_size", &arb::partition_hint::gpu_group_size,
                                         "The size of cell group assigned to GPU.")
         .def_readwrite("prefer_gpu", &arb::partition_hint::prefer_gpu,
                                         "Whether GPU usage is preferred.")
+        .def_readwrite("cpu_fraction", &arb::partition_hint::cpu_fraction,
+                                        "Fraction of the cost of GPU cells to run in CPU cell groups instead.")
         .def_property_readonly_static("max_size",  [](pybind11::object) { return arb::partition_hint::max_size; },
                                         "Get the maximum size of cell groups.")
         .def("__str__",  &ph_string)
@@ -103,20 +108,33 @@ void register_domain_decomposition(pybind11::module& m) {
 
     // Partition load balancer
     // The Python recipe has to be shimmed for passing to the function that takes a C++ recipe.
+    py::enum_<arb::domain_partition_kind>(m, "domain_partition")
+       .value("gid_block", arb::domain_partition_kind::gid_block)
+       .value("connectivity", arb::domain_partition_kind::connectivity);
+
     m.def("partition_load_balance",
-        [](std::shared_ptr<py_recipe>& recipe, const context_shim& ctx, arb::partition_hint_map hint_map) {
+        [](std::shared_ptr<py_recipe>& recipe, const context_shim& ctx, arb::partition_hint_map hint_map, arb::domain_partition_kind partition) {
             try {
-                return arb::partition_load_balance(py_recipe_shim(recipe), ctx.context, std::move(hint_map));
+                return arb::partition_load_balance(py_recipe_shim(recipe), ctx.context, std::move(hint_map), partition);
             }
             catch (...) {
                 py_reset_and_throw();
                 throw;
             }
         },
+        // Release the python gil, so that other Python threads run while the
+        // cells are partitioned; calls into the python recipe take it again.
+        pybind11::call_guard<pybind11::gil_scoped_release>(),
         "Construct a domain_decomposition that distributes the cells in the model described by recipe\n"
         "over the distributed and local hardware resources described by context.\n"
-        "Optionally, provide a dictionary of partition hints for certain cell kinds, by default empty.",
-        "recipe"_a, "context"_a, "hints"_a=arb::partition_hint_map{});
+        "Optionally, provide a dictionary of partition hints for certain cell kinds, by default empty,\n"
+        "and the assignment of cells to domains, by default contiguous blocks of gids.",
+        "recipe"_a, "context"_a, "hints"_a=arb::partition_hint_map{}, "partition"_a=arb::domain_partition_kind::gid_block);
+
+    m.def("fuse_gpu_groups", &arb::fuse_gpu_groups,
+        "Merge the GPU cell groups of a domain_decomposition with the same cell kind and device\n"
+        "into one group, so that each device advances its cells of a kind with one sequence of kernels.",
+        "decomposition"_a);
 }
 
 } // namespace pyarb
@@ -132,10 +132,14 @@ void register_identifiers(py::module& m) {
 
     py::enum_<arb::cell_kind>(m, "cell_kind",
         "Enumeration used to identify the cell kind, used by the model to group equal kinds in the same cell group.")
+        .value("adex", arb::cell_kind::adex,
+            "Adaptive exponential integrate and fire neuron.")
         .value("benchmark", arb::cell_kind::benchmark,
             "Proxy cell used for benchmarking.")
         .value("cable", arb::cell_kind::cable,
             "A cell with morphology described by branching 1D cable segments.")
+        .value("izhikevich", arb::cell_kind::izhikevich,
+            "Izhikevich neuron.")
         .value("lif", arb::cell_kind::lif,
             "Leaky-integrate and fire neuron.")
         .value("spike_source", arb::cell_kind::spike_source,
@@ -156,6 +160,13 @@ void register_identifiers(py::module& m) {
             "Round time down to multiple of binning interval.")
         .value("following", arb::binning_kind::following,
             "Round times down to previous event if within binning interval.");
+
+    py::enum_<arb::point_solver_kind>(m, "point_solver",
+        "Enumeration for the integration scheme of point neurons with nonlinear dynamics.")
+        .value("euler", arb::point_solver_kind::euler,
+            "Forward Euler.")
+        .value("rk4", arb::point_solver_kind::rk4,
+            "Classical fourth order Runge-Kutta.");
 }
 
 } // namespace pyarb
@@ -1,5 +1,10 @@
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <stdexcept>
+#include <vector>
 
 #include <pybind11/pybind11.h>
 #include "pybind11/pytypes.h"
@@ -7,11 +12,13 @@
 
 #include <arbor/cable_cell_param.hpp>
 #include <arbor/mechanism.hpp>
+#include <arbor/mechanism_abi.h>
 #include <arbor/mechcat.hpp>
 
 #include "arbor/mechinfo.hpp"
 
 #include "conversion.hpp"
+#include "error.hpp"
 #include "strprintf.hpp"
 
 namespace pyarb {
@@ -37,6 +44,67 @@ void apply_derive(arb::mechanism_catalogue& m,
     m.derive(name, parent, G, I);
 }
 
+// A copy of the metadata of a mechanism registered from Python, so that the
+// caller need not keep its tables alive.
+struct owned_mechanism_type {
+    std::deque<std::string> strings;
+    std::vector<arb_field_info> globals, state_vars, parameters, random_variables;
+    std::vector<arb_ion_info> ions;
+    arb_mechanism_type type;
+
+    explicit owned_mechanism_type(const arb_mechanism_type& t): type(t) {
+        type.name = copy(t.name);
+        type.fingerprint = copy(t.fingerprint);
+        type.globals = copy(globals, t.globals, t.n_globals);
+        type.state_vars = copy(state_vars, t.state_vars, t.n_state_vars);
+        type.parameters = copy(parameters, t.parameters, t.n_parameters);
+        type.random_variables = copy(random_variables, t.random_variables, t.n_random_variables);
+        ions.assign(t.ions, t.ions+t.n_ions);
+        for (auto& i: ions) i.name = copy(i.name);
+        type.ions = ions.data();
+    }
+
+    const char* copy(const char* str) {
+        if (!str) return nullptr;
+        return strings.emplace_back(str).c_str();
+    }
+
+    arb_field_info* copy(std::vector<arb_field_info>& out, const arb_field_info* fields, arb_size_type n) {
+        out.assign(fields, fields+n);
+        for (auto& f: out) {
+            f.name = copy(f.name);
+            f.unit = copy(f.unit);
+        }
+        return out.data();
+    }
+};
+
+// Mechanisms registered from Python may be instantiated by any catalogue
+// copied from the one they were added to, so, as with catalogues loaded from
+// shared objects, their metadata is retained until termination.
+const arb_mechanism_type& retain_mechanism_type(const arb_mechanism_type& t) {
+    static std::mutex mutex;
+    static std::vector<std::unique_ptr<owned_mechanism_type>> retained;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    retained.push_back(std::make_unique<owned_mechanism_type>(t));
+    return retained.back()->type;
+}
+
+void register_mechanism(arb::mechanism_catalogue& cat, const std::string& name, std::uintptr_t type_ptr, std::uintptr_t interface_ptr) {
+    if (!type_ptr || !interface_ptr) {
+        throw pyarb_error("mechanism type and interface must not be NULL");
+    }
+    const auto& type = retain_mechanism_type(*reinterpret_cast<const arb_mechanism_type*>(type_ptr));
+    const auto& iface = *reinterpret_cast<const arb_mechanism_interface*>(interface_ptr);
+
+    auto proto = std::make_unique<arb::mechanism>(type, iface);
+    if (!cat.has(name)) {
+        cat.add(name, arb::mechanism_info(type));
+    }
+    cat.register_implementation(name, std::move(proto));
+}
+
 void register_mechanisms(pybind11::module& m) {
     using std::optional;
     using namespace pybind11::literals;
@@ -94,6 +162,8 @@ void register_mechanisms(pybind11::module& m) {
             "State fields vary in time and across the extent of a mechanism, and potentially can be sampled at run-time.")
         .def_readonly("ions", &arb::mechanism_info::ions,
             "Ion dependencies.")
+        .def_readonly("random_variables", &arb::mechanism_info::random_variables,
+            "Random variables take an independent standard normal value per instance and time step.")
         .def_readonly("linear", &arb::mechanism_info::linear,
             "True if a synapse mechanism has linear current contributions so that multiple instances on the same compartment can be coalesced.")
         .def("__repr__",
@@ -176,6 +246,15 @@ void register_mechanisms(pybind11::module& m) {
              "other"_a, "Catalogue to import into self",
              "prefix"_a, "Prefix for names in other",
              "Import another catalogue, possibly with a prefix. Will overwrite in case of name collisions.")
+        .def("register_mechanism", &register_mechanism,
+                "name"_a, "type"_a, "interface"_a,
+                "Add a mechanism implemented by compiled functions, for example numba or cffi callbacks.\n"
+                " name:      The name of the mechanism in the catalogue.\n"
+                " type:      The address of an arb_mechanism_type, as in arbor/mechanism_abi.h.\n"
+                " interface: The address of an arb_mechanism_interface for one back-end.\n"
+                "The metadata of the type is copied; the functions of the interface must stay alive\n"
+                "for as long as the mechanism is used. Register the interface of another back-end\n"
+                "by calling again with the same name.")
         .def("derive", &apply_derive,
                 "name"_a, "parent"_a,
                 "globals"_a=std::unordered_map<std::string, double>{},
@@ -187,6 +266,8 @@ void register_mechanisms(pybind11::module& m) {
                 [](const arb::mechanism_catalogue& cat) {
                     return util::pprintf("<arbor.mechanism_catalogue>"); });
 
+    m.attr("mechanism_abi_version") = ARB_MECH_ABI_VERSION;
+
     m.def("default_catalogue", [](){return arb::global_default_catalogue();});
     m.def("allen_catalogue", [](){return arb::global_allen_catalogue();});
     m.def("bbp_catalogue", [](){return arb::global_bbp_catalogue();});
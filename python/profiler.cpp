@@ -1,15 +1,105 @@
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
 #include <sstream>
+#include <string>
+#include <vector>
 
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
 #include <arbor/profile/meter_manager.hpp>
+#include <arbor/profile/profiler.hpp>
 
 #include "context.hpp"
+#include "error.hpp"
 #include "strprintf.hpp"
 
 namespace pyarb {
 
+namespace {
+// Regions are named by the path from the root of the region tree, joined by
+// '_', e.g. "advance_integrate_state"; the parent of a region is its path less
+// the last element, or an empty string at the top.
+std::string region_parent(const std::string& name) {
+    auto pos = name.rfind('_');
+    return pos==std::string::npos? std::string(): name.substr(0, pos);
+}
+
+// A rows x cols array filled from a vector of rows; missing values are zero.
+pybind11::array_t<double> to_array(const std::vector<std::vector<double>>& rows, std::size_t cols) {
+    pybind11::array_t<double> result(std::vector<pybind11::ssize_t>{pybind11::ssize_t(rows.size()), pybind11::ssize_t(cols)});
+    std::fill(result.mutable_data(), result.mutable_data()+result.size(), 0.);
+    auto a = result.mutable_unchecked<2>();
+    for (std::size_t i = 0; i<rows.size(); ++i) {
+        for (std::size_t j = 0; j<cols && j<rows[i].size(); ++j) {
+            a(i, j) = rows[i][j];
+        }
+    }
+    return result;
+}
+
+pybind11::dict profile_dict(const arb::profile::profile& p) {
+    using pybind11::array_t;
+
+    pybind11::dict regions;
+    std::vector<std::string> parents;
+    for (auto& n: p.names) parents.push_back(region_parent(n));
+    regions["name"] = p.names;
+    regions["parent"] = parents;
+    regions["calls"] = array_t<std::size_t>(p.counts.size(), p.counts.data());
+    regions["time"] = array_t<double>(p.times.size(), p.times.data());
+    regions["thread_time"] = to_array(p.thread_times, p.num_threads);
+
+    // One array of counts per region for each hardware event counted.
+    pybind11::dict events;
+    for (std::size_t j = 0; j<p.event_names.size(); ++j) {
+        array_t<std::uint64_t> counts(p.names.size());
+        for (std::size_t i = 0; i<p.names.size(); ++i) {
+            counts.mutable_at(i) = i<p.events.size()? p.events[i][j]: 0;
+        }
+        events[p.event_names[j].c_str()] = counts;
+    }
+    regions["events"] = events;
+
+    pybind11::dict mechanisms;
+    std::vector<std::string> mech, method;
+    std::vector<std::size_t> calls, instances;
+    std::vector<double> time;
+    for (auto& m: p.mechanisms) {
+        mech.push_back(m.mechanism);
+        method.push_back(m.method);
+        calls.push_back(m.calls);
+        instances.push_back(m.instances);
+        time.push_back(m.time);
+    }
+    mechanisms["mechanism"] = mech;
+    mechanisms["method"] = method;
+    mechanisms["calls"] = array_t<std::size_t>(calls.size(), calls.data());
+    mechanisms["instances"] = array_t<std::size_t>(instances.size(), instances.data());
+    mechanisms["time"] = array_t<double>(time.size(), time.data());
+
+    pybind11::dict result;
+    result["num_threads"] = p.num_threads;
+    result["regions"] = regions;
+    result["mechanisms"] = mechanisms;
+    return result;
+}
+
+pybind11::list meters_list(const arb::profile::meter_report& r) {
+    pybind11::list result;
+    for (auto& m: r.meters) {
+        pybind11::dict d;
+        d["name"] = m.name;
+        d["units"] = m.units;
+        d["values"] = to_array(m.measurements, r.num_domains);
+        result.append(d);
+    }
+    return result;
+}
+} // namespace
+
 void register_profiler(pybind11::module& m) {
     using namespace pybind11::literals;
 
@@ -50,8 +140,60 @@ void register_profiler(pybind11::module& m) {
             return arb::profile::make_meter_report(manager, ctx.context);
             }),
             "manager"_a, "context"_a)
+        .def_readonly("checkpoints", &arb::profile::meter_report::checkpoints,
+            "The names of the checkpoints.")
+        .def_readonly("num_domains", &arb::profile::meter_report::num_domains,
+            "The number of domains (MPI ranks) over which the meters were gathered.")
+        .def_readonly("num_hosts", &arb::profile::meter_report::num_hosts,
+            "The number of distinct hosts.")
+        .def_readonly("hosts", &arb::profile::meter_report::hosts,
+            "The name of each host.")
+        .def_property_readonly("meters", &meters_list,
+            "A list of dicts, one for each meter, with the name and units of the meter, and the\n"
+            "measured values as a numpy array with one row per checkpoint and one column per domain.")
         .def("__str__",  [](arb::profile::meter_report& r){return util::pprintf("{}", r);})
         .def("__repr__", [](arb::profile::meter_report& r){return "<arbor.meter_report>";});
+
+    // built-in profiler
+    m.def("profiler_initialize",
+        [](context_shim& ctx) {
+            arb::profile::profiler_initialize(ctx.context);
+        },
+        "context"_a,
+        "Start recording profiler regions on the threads of the context.\n"
+        "Has no effect unless arbor was built with profiling enabled.");
+    m.def("profiler_count_events",
+        [](bool on) { arb::profile::profiler_count_events(on); },
+        "on"_a,
+        "Switch counting of hardware events (cycles, instructions, L1 data and last level\n"
+        "cache misses) in each profiler region on or off; off by default.");
+    m.def("profiler_trace",
+        [](bool on, std::size_t capacity) { arb::profile::profiler_trace(on, capacity); },
+        "on"_a, "capacity"_a=std::size_t(1)<<16,
+        "Start or stop recording a trace of the profiler regions, keeping the latest\n"
+        "capacity events on each thread. Starting a trace discards the events recorded.");
+    m.def("profiler_write_trace",
+        [](const std::string& path, const context_shim& ctx) {
+            std::ostringstream out;
+            arb::profile::profiler_write_trace(out, ctx.context);
+            if (arb::rank(ctx.context)==0) {
+                std::ofstream fid(path);
+                if (!fid.good()) throw pyarb_error(util::pprintf("unable to open file '{}'", path));
+                fid << out.str();
+            }
+        },
+        "path"_a, "context"_a,
+        "Write the trace of all domains to path, on the root domain, in the Chrome trace event\n"
+        "format. Must be called on all domains.");
+    m.def("profiler_summary",
+        []() { return profile_dict(arb::profile::profiler_summary()); },
+        "Return the profiler results as a dict with entries:\n"
+        " num_threads: the number of threads profiled.\n"
+        " regions:     a dict of the name, parent region, number of calls and accumulated time of\n"
+        "              each region, its time on each thread as a regions x threads array, and\n"
+        "              events: a dict of the counts of each hardware event counted in each region.\n"
+        " mechanisms:  a dict of the mechanism, method, calls, instances and time of each\n"
+        "              timed mechanism method.");
 }
 
 } // namespace pyarb
@@ -19,7 +19,10 @@ namespace pyarb {
 
 struct sample_recorder {
     virtual void record(arb::util::any_ptr meta, std::size_t n_sample, const arb::sample_record* records) = 0;
-    virtual pybind11::object samples() const = 0;
+    // All samples recorded since the last reset.
+    virtual pybind11::object samples() = 0;
+    // The samples recorded since the last call, or since the last reset.
+    virtual pybind11::object new_samples() = 0;
     virtual pybind11::object meta() const = 0;
     virtual void reset() = 0;
     virtual ~sample_recorder() {}
@@ -1,18 +1,27 @@
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/pytypes.h>
 #include <pybind11/stl.h>
 
 #include <arbor/benchmark_cell.hpp>
 #include <arbor/cable_cell.hpp>
+#include <arbor/adex_cell.hpp>
+#include <arbor/izhikevich_cell.hpp>
 #include <arbor/lif_cell.hpp>
 #include <arbor/spike_source_cell.hpp>
 #include <arbor/event_generator.hpp>
 #include <arbor/morph/primitives.hpp>
 #include <arbor/recipe.hpp>
+#include <arbor/stochastic_input.hpp>
 
 #include "conversion.hpp"
 #include "error.hpp"
@@ -38,12 +47,21 @@ static arb::util::unique_any convert_cell(pybind11::object o) {
     if (isinstance<arb::spike_source_cell>(o)) {
         return arb::util::unique_any(cast<arb::spike_source_cell>(o));
     }
+    if (isinstance<arb::poisson_source_cell>(o)) {
+        return arb::util::unique_any(cast<arb::poisson_source_cell>(o));
+    }
     if (isinstance<arb::benchmark_cell>(o)) {
         return arb::util::unique_any(cast<arb::benchmark_cell>(o));
     }
     if (isinstance<arb::lif_cell>(o)) {
         return arb::util::unique_any(cast<arb::lif_cell>(o));
     }
+    if (isinstance<arb::adex_cell>(o)) {
+        return arb::util::unique_any(cast<arb::adex_cell>(o));
+    }
+    if (isinstance<arb::izhikevich_cell>(o)) {
+        return arb::util::unique_any(cast<arb::izhikevich_cell>(o));
+    }
     if (isinstance<arb::cable_cell>(o)) {
         return arb::util::unique_any(cast<arb::cable_cell>(o));
     }
@@ -117,6 +135,192 @@ std::vector<arb::event_generator> py_recipe_shim::event_generators(arb::cell_gid
     "Python error already thrown");
 }
 
+// The bulk recipe protocol.
+//
+// A Python recipe may implement, for a numpy array of consecutive gids,
+//
+//   cell_kinds(gids):      the cell kind of each gid, as a sequence of
+//                          arbor.cell_kind or an integer array of their values;
+//   connections_for(gids): a tuple (labels, records), where records is a numpy
+//                          array of dtype arbor.connection_dtype holding the
+//                          connections onto all of the gids, and the src_label
+//                          and dst_label fields index the list labels of str
+//                          or (str, policy) items.
+//
+// The shim asks for blocks of bulk_block_size gids, converts each block once
+// while holding the GIL, and answers the per-gid calls of the C++ recipe
+// interface from it. A block of connections is dropped once all of its gids
+// have been served. A recipe that returns None is queried one gid at a time.
+
+struct connection_record {
+    arb::cell_gid_type dst;
+    arb::cell_gid_type src;
+    std::uint32_t src_label;
+    std::uint32_t dst_label;
+    float weight;
+    float delay;
+};
+
+static constexpr arb::cell_gid_type bulk_block_size = 1024;
+
+struct py_recipe_bulk {
+    struct connection_block {
+        std::vector<std::vector<arb::cell_connection>> on;
+        std::vector<char> served;
+        arb::cell_size_type remaining;
+    };
+
+    std::mutex mutex;
+    std::optional<arb::cell_size_type> num_cells;
+    bool kinds_supported = true;
+    bool connections_supported = true;
+    std::unordered_map<arb::cell_gid_type, std::vector<arb::cell_kind>> kinds;
+    std::unordered_map<arb::cell_gid_type, connection_block> connections;
+};
+
+py_recipe_shim::py_recipe_shim(std::shared_ptr<py_recipe> r):
+    impl_(std::move(r)), bulk_(std::make_shared<py_recipe_bulk>())
+{}
+
+// The gids of a block. Only to be called while holding the GIL.
+static pybind11::array_t<arb::cell_gid_type> block_gids(arb::cell_gid_type block, arb::cell_size_type num_cells) {
+    arb::cell_gid_type first = block*bulk_block_size;
+    arb::cell_size_type n = std::min<arb::cell_size_type>(bulk_block_size, num_cells-first);
+    pybind11::array_t<arb::cell_gid_type> gids(n);
+    auto g = gids.mutable_unchecked<1>();
+    for (arb::cell_size_type i = 0; i<n; ++i) {
+        g(i) = first+i;
+    }
+    return gids;
+}
+
+// Only to be called while holding the GIL.
+static std::optional<std::vector<arb::cell_kind>> fetch_cell_kinds(const py_recipe& rec, const pybind11::array_t<arb::cell_gid_type>& gids) {
+    pybind11::object o = rec.cell_kinds(gids);
+    if (o.is_none()) return std::nullopt;
+
+    std::vector<arb::cell_kind> kinds;
+    kinds.reserve(gids.size());
+    auto dtype_kind = pybind11::isinstance<pybind11::array>(o)? o.cast<pybind11::array>().dtype().kind(): 0;
+    if (dtype_kind=='i' || dtype_kind=='u') {
+        auto values = o.cast<pybind11::array_t<int, pybind11::array::c_style|pybind11::array::forcecast>>();
+        const int* v = values.data();
+        for (pybind11::ssize_t i = 0; i<values.size(); ++i) {
+            kinds.push_back(arb::cell_kind(v[i]));
+        }
+    }
+    else {
+        for (auto k: o.cast<pybind11::sequence>()) {
+            kinds.push_back(k.cast<arb::cell_kind>());
+        }
+    }
+
+    if (kinds.size()!=std::size_t(gids.size())) {
+        throw pyarb_error(util::pprintf("recipe.cell_kinds returned {} cell kinds for {} gids", kinds.size(), gids.size()));
+    }
+    return kinds;
+}
+
+// Only to be called while holding the GIL.
+static std::optional<py_recipe_bulk::connection_block> fetch_connections(const py_recipe& rec, const pybind11::array_t<arb::cell_gid_type>& gids) {
+    pybind11::object o = rec.connections_for(gids);
+    if (o.is_none()) return std::nullopt;
+
+    auto result = o.cast<pybind11::tuple>();
+    if (result.size()!=2) {
+        throw pyarb_error("recipe.connections_for must return a tuple (labels, connections)");
+    }
+    std::vector<arb::cell_local_label_type> labels;
+    for (auto l: result[0].cast<pybind11::sequence>()) {
+        labels.push_back(l.cast<arb::cell_local_label_type>());
+    }
+    auto records = result[1].cast<pybind11::array_t<connection_record, pybind11::array::c_style|pybind11::array::forcecast>>();
+
+    arb::cell_gid_type first = gids.at(0);
+    arb::cell_size_type n = gids.size();
+    py_recipe_bulk::connection_block block{std::vector<std::vector<arb::cell_connection>>(n), std::vector<char>(n), n};
+    const connection_record* rs = records.data();
+    for (pybind11::ssize_t j = 0; j<records.size(); ++j) {
+        const auto& r = rs[j];
+        if (r.dst<first || r.dst-first>=n) {
+            throw pyarb_error(util::pprintf("recipe.connections_for returned a connection onto gid {}, outside the requested gids [{}, {})", r.dst, first, first+n));
+        }
+        if (r.src_label>=labels.size() || r.dst_label>=labels.size()) {
+            throw pyarb_error(util::pprintf("recipe.connections_for returned a label index out of range for {} labels", labels.size()));
+        }
+        block.on[r.dst-first].emplace_back(arb::cell_global_label_type{r.src, labels[r.src_label]}, labels[r.dst_label], r.weight, r.delay);
+    }
+    return block;
+}
+
+arb::cell_size_type py_recipe_shim::bulk_num_cells() const {
+    if (!bulk_->num_cells) bulk_->num_cells = num_cells();
+    return *bulk_->num_cells;
+}
+
+arb::cell_kind py_recipe_shim::get_cell_kind(arb::cell_gid_type gid) const {
+    std::unique_lock<std::mutex> lock(bulk_->mutex);
+    if (bulk_->kinds_supported) {
+        auto block = gid/bulk_block_size;
+        auto it = bulk_->kinds.find(block);
+        if (it==bulk_->kinds.end()) {
+            auto n = bulk_num_cells();
+            auto fetched = try_catch_pyexception([&](){
+                pybind11::gil_scoped_acquire guard;
+                return fetch_cell_kinds(*impl_, block_gids(block, n));
+            }, msg);
+            if (fetched) {
+                it = bulk_->kinds.emplace(block, std::move(*fetched)).first;
+            }
+            else {
+                bulk_->kinds_supported = false;
+            }
+        }
+        if (bulk_->kinds_supported) {
+            return it->second.at(gid-block*bulk_block_size);
+        }
+    }
+    lock.unlock();
+    return try_catch_pyexception([&](){ return impl_->cell_kind(gid); }, msg);
+}
+
+std::vector<arb::cell_connection> py_recipe_shim::connections_on(arb::cell_gid_type gid) const {
+    std::unique_lock<std::mutex> lock(bulk_->mutex);
+    if (bulk_->connections_supported) {
+        auto block = gid/bulk_block_size;
+        auto i = gid-block*bulk_block_size;
+        auto it = bulk_->connections.find(block);
+
+        // A gid asked for a second time is answered from a fresh block.
+        if (it!=bulk_->connections.end() && it->second.served.at(i)) {
+            bulk_->connections.erase(it);
+            it = bulk_->connections.end();
+        }
+        if (it==bulk_->connections.end()) {
+            auto n = bulk_num_cells();
+            auto fetched = try_catch_pyexception([&](){
+                pybind11::gil_scoped_acquire guard;
+                return fetch_connections(*impl_, block_gids(block, n));
+            }, msg);
+            if (fetched) {
+                it = bulk_->connections.emplace(block, std::move(*fetched)).first;
+            }
+            else {
+                bulk_->connections_supported = false;
+            }
+        }
+        if (bulk_->connections_supported) {
+            auto& cached = it->second;
+            auto result = std::move(cached.on.at(i));
+            cached.served[i] = 1;
+            if (!--cached.remaining) bulk_->connections.erase(it);
+            return result;
+        }
+    }
+    lock.unlock();
+    return try_catch_pyexception([&](){ return impl_->connections_on(gid); }, msg);
+}
+
 std::string con_to_string(const arb::cell_connection& c) {
     return util::pprintf("<arbor.connection: source ({}, \"{}\", {}), destination (\"{}\", {}), delay {}, weight {}>",
          c.source.gid, c.source.label.tag, c.source.label.policy, c.dest.tag, c.dest.policy, c.delay, c.weight);
@@ -130,6 +334,10 @@ std::string gj_to_string(const arb::gap_junction_connection& gc) {
 void register_recipe(pybind11::module& m) {
     using namespace pybind11::literals;
 
+    // Records of the bulk protocol.
+    PYBIND11_NUMPY_DTYPE(connection_record, dst, src, src_label, dst_label, weight, delay);
+    m.attr("connection_dtype") = pybind11::dtype::of<connection_record>();
+
     // Connections
     pybind11::class_<arb::cell_connection> cell_connection(m, "connection",
         "Describes a connection between two cells:\n"
@@ -172,6 +380,30 @@ void register_recipe(pybind11::module& m) {
         .def("__str__",  &gj_to_string)
         .def("__repr__", &gj_to_string);
 
+    // Stochastic inputs
+    pybind11::class_<arb::stochastic_input> stochastic_input(m, "stochastic_input",
+        "Background input to a synapse, as a Poisson process of events of a fixed weight, of which\n"
+        "the back end draws the number in each integration step instead of generating the events.\n"
+        "The synapse must be a point mechanism with additive events.");
+    stochastic_input
+        .def(pybind11::init<arb::cell_local_label_type, float, arb::time_type, std::uint64_t, arb::time_type, arb::time_type>(),
+            "target"_a, "weight"_a, "rate"_a, "seed"_a=0, "tstart"_a=0., "tstop"_a=arb::terminal_time,
+            "Construct a stochastic input with arguments:\n"
+            "  target: The label of the target synapse.\n"
+            "  weight: The weight of each event (unit defined by the type of synapse target).\n"
+            "  rate:   The mean rate of events [kHz].\n"
+            "  seed:   The seed of the generator.\n"
+            "  tstart: The start of the process [ms].\n"
+            "  tstop:  The end of the process [ms].")
+        .def_readwrite("target", &arb::stochastic_input::target, "The label of the target synapse.")
+        .def_readwrite("weight", &arb::stochastic_input::weight, "The weight of each event.")
+        .def_readwrite("rate", &arb::stochastic_input::rate_kHz, "The mean rate of events [kHz].")
+        .def_readwrite("seed", &arb::stochastic_input::seed, "The seed of the generator.")
+        .def_readwrite("tstart", &arb::stochastic_input::tstart, "The start of the process [ms].")
+        .def_readwrite("tstop", &arb::stochastic_input::tstop, "The end of the process [ms].")
+        .def("__repr__", [](const arb::stochastic_input& s) {
+            return util::pprintf("<arbor.stochastic_input: target \"{}\", weight {}, rate {} kHz>", s.target.tag, s.weight, s.rate_kHz);});
+
     // Recipes
     pybind11::class_<py_recipe,
                      py_recipe_trampoline,
@@ -190,6 +422,9 @@ void register_recipe(pybind11::module& m) {
         .def("event_generators", &py_recipe::event_generators,
             "gid"_a,
             "A list of all the event generators that are attached to gid, [] by default.")
+        .def("stochastic_inputs", &py_recipe::stochastic_inputs,
+            "gid"_a,
+            "A list of the stochastic inputs to the synapses of gid, [] by default.")
         .def("connections_on", &py_recipe::connections_on,
             "gid"_a,
             "A list of all the incoming connections to gid, [] by default.")
@@ -202,6 +437,18 @@ void register_recipe(pybind11::module& m) {
         .def("global_properties", &py_recipe::global_properties,
             "kind"_a,
             "The default properties applied to all cells of type 'kind' in the model.")
+        .def("cell_cost", &py_recipe::cell_cost,
+            "gid"_a,
+            "Estimated relative cost of simulating gid, used to balance load; None by default, for equal costs.")
+        .def("cell_kinds", &py_recipe::cell_kinds,
+            "gids"_a,
+            "The kinds of the cells with global identifiers gids, as a sequence of cell_kind or an integer array;\n"
+            "None by default, in which case cell_kind is called for each gid.")
+        .def("connections_for", &py_recipe::connections_for,
+            "gids"_a,
+            "The incoming connections to gids, as a tuple (labels, connections), where connections is\n"
+            "an array of dtype connection_dtype whose src_label and dst_label fields index the list labels;\n"
+            "None by default, in which case connections_on is called for each gid.")
         // TODO: py_recipe::global_properties
         .def("__str__",  [](const py_recipe&){return "<arbor.recipe>";})
         .def("__repr__", [](const py_recipe&){return "<arbor.recipe>";});
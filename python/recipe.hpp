@@ -1,12 +1,16 @@
 #pragma once
 
+#include <memory>
+#include <optional>
 #include <vector>
 
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/pytypes.h>
 #include <pybind11/stl.h>
 
 #include <arbor/event_generator.hpp>
+#include <arbor/stochastic_input.hpp>
 #include <arbor/cable_cell_param.hpp>
 #include <arbor/recipe.hpp>
 
@@ -36,6 +40,9 @@ public:
     virtual std::vector<pybind11::object> event_generators(arb::cell_gid_type gid) const {
         return {};
     }
+    virtual std::vector<arb::stochastic_input> stochastic_inputs(arb::cell_gid_type gid) const {
+        return {};
+    }
     virtual std::vector<arb::cell_connection> connections_on(arb::cell_gid_type gid) const {
         return {};
     }
@@ -48,6 +55,18 @@ public:
     virtual pybind11::object global_properties(arb::cell_kind kind) const {
         return pybind11::none();
     };
+    virtual std::optional<double> cell_cost(arb::cell_gid_type gid) const {
+        return std::nullopt;
+    }
+
+    // Optional bulk protocol: answers for an array of gids at once, or None
+    // to be queried one gid at a time. See recipe.cpp for the formats.
+    virtual pybind11::object cell_kinds(pybind11::array_t<arb::cell_gid_type> gids) const {
+        return pybind11::none();
+    }
+    virtual pybind11::object connections_for(pybind11::array_t<arb::cell_gid_type> gids) const {
+        return pybind11::none();
+    }
     //TODO: virtual pybind11::object global_properties(arb::cell_kind kind) const {return pybind11::none();};
 };
 
@@ -69,6 +88,10 @@ public:
         PYBIND11_OVERLOAD(std::vector<pybind11::object>, py_recipe, event_generators, gid);
     }
 
+    std::vector<arb::stochastic_input> stochastic_inputs(arb::cell_gid_type gid) const override {
+        PYBIND11_OVERLOAD(std::vector<arb::stochastic_input>, py_recipe, stochastic_inputs, gid);
+    }
+
     std::vector<arb::cell_connection> connections_on(arb::cell_gid_type gid) const override {
         PYBIND11_OVERLOAD(std::vector<arb::cell_connection>, py_recipe, connections_on, gid);
     }
@@ -84,8 +107,23 @@ public:
     pybind11::object global_properties(arb::cell_kind kind) const override {
         PYBIND11_OVERLOAD(pybind11::object, py_recipe, global_properties, kind);
     }
+
+    std::optional<double> cell_cost(arb::cell_gid_type gid) const override {
+        PYBIND11_OVERLOAD(std::optional<double>, py_recipe, cell_cost, gid);
+    }
+
+    pybind11::object cell_kinds(pybind11::array_t<arb::cell_gid_type> gids) const override {
+        PYBIND11_OVERLOAD(pybind11::object, py_recipe, cell_kinds, gids);
+    }
+
+    pybind11::object connections_for(pybind11::array_t<arb::cell_gid_type> gids) const override {
+        PYBIND11_OVERLOAD(pybind11::object, py_recipe, connections_for, gids);
+    }
 };
 
+// Blocks of cell kinds and connections fetched through the bulk protocol.
+struct py_recipe_bulk;
+
 // A recipe shim that holds a pyarb::py_recipe implementation.
 // Unwraps/translates python-side output from pyarb::recipe and forwards
 // to arb::recipe.
@@ -95,14 +133,19 @@ public:
 class py_recipe_shim: public arb::recipe {
     // pointer to the python recipe implementation
     std::shared_ptr<py_recipe> impl_;
+    std::shared_ptr<py_recipe_bulk> bulk_;
 
 public:
     using recipe::recipe;
 
-    py_recipe_shim(std::shared_ptr<py_recipe> r): impl_(std::move(r)) {}
+    py_recipe_shim(std::shared_ptr<py_recipe> r);
 
     const char* msg = "Python error already thrown";
 
+    // The number of cells, asked for once. Only to be called while holding
+    // the lock of the bulk protocol caches.
+    arb::cell_size_type bulk_num_cells() const;
+
     arb::cell_size_type num_cells() const override {
         return try_catch_pyexception([&](){ return impl_->num_cells(); }, msg);
     }
@@ -111,16 +154,16 @@ public:
     // unwrapped and copied into a util::unique_any.
     arb::util::unique_any get_cell_description(arb::cell_gid_type gid) const override;
 
-    arb::cell_kind get_cell_kind(arb::cell_gid_type gid) const override {
-        return try_catch_pyexception([&](){ return impl_->cell_kind(gid); }, msg);
-    }
+    arb::cell_kind get_cell_kind(arb::cell_gid_type gid) const override;
 
     std::vector<arb::event_generator> event_generators(arb::cell_gid_type gid) const override;
 
-    std::vector<arb::cell_connection> connections_on(arb::cell_gid_type gid) const override {
-        return try_catch_pyexception([&](){ return impl_->connections_on(gid); }, msg);
+    std::vector<arb::stochastic_input> stochastic_inputs(arb::cell_gid_type gid) const override {
+        return try_catch_pyexception([&](){ return impl_->stochastic_inputs(gid); }, msg);
     }
 
+    std::vector<arb::cell_connection> connections_on(arb::cell_gid_type gid) const override;
+
     std::vector<arb::gap_junction_connection> gap_junctions_on(arb::cell_gid_type gid) const override {
         return try_catch_pyexception([&](){ return impl_->gap_junctions_on(gid); }, msg);
     }
@@ -130,6 +173,10 @@ public:
     }
 
     std::any get_global_properties(arb::cell_kind kind) const override;
+
+    std::optional<double> cell_cost(arb::cell_gid_type gid) const override {
+        return try_catch_pyexception([&](){ return impl_->cell_cost(gid); }, msg);
+    }
 };
 
 } // namespace pyarb
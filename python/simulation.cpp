@@ -1,10 +1,19 @@
+#include <algorithm>
+#include <chrono>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
 #include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
 
 #include <arbor/common_types.hpp>
 #include <arbor/sampling.hpp>
 #include <arbor/simulation.hpp>
+#include <arbor/spike_writer.hpp>
 
 #include "context.hpp"
 #include "error.hpp"
@@ -22,12 +31,122 @@ enum class spike_recording {
     off, local, all
 };
 
+// Recorded spikes, stored as separate columns of source gid, source index
+// and time. Each column grows geometrically into a new buffer, so that rows
+// already recorded are never moved or overwritten: the arrays returned by
+// columns() view the buffers in place, sharing their ownership.
+class spike_column_record {
+    template <typename T>
+    using buffer = std::shared_ptr<std::vector<T>>;
+
+    static constexpr std::size_t min_capacity = 1024;
+
+    buffer<arb::cell_gid_type> gid_;
+    buffer<arb::cell_lid_type> index_;
+    buffer<arb::time_type> time_;
+
+    template <typename T>
+    static void grow(buffer<T>& b, std::size_t n) {
+        auto next = std::make_shared<std::vector<T>>();
+        next->reserve(n);
+        if (b) next->assign(b->begin(), b->end());
+        b = std::move(next);
+    }
+
+    template <typename T>
+    static py::array_t<T> view(const buffer<T>& b, std::size_t n) {
+        if (!b) return py::array_t<T>(0);
+        auto owner = new buffer<T>(b);
+        py::capsule base(owner, [](void* p) { delete static_cast<buffer<T>*>(p); });
+        py::array_t<T> result(py::ssize_t(n), b->data(), base);
+        result.attr("setflags")(py::arg("write") = false);
+        return result;
+    }
+
+public:
+    std::size_t size() const {
+        return gid_? gid_->size(): 0;
+    }
+
+    void append(const arb::spike* first, const arb::spike* last) {
+        std::size_t n = size()+(last-first);
+        if (!gid_ || n>gid_->capacity()) {
+            std::size_t capacity = std::max(n, std::max(min_capacity, 2*size()));
+            grow(gid_, capacity);
+            grow(index_, capacity);
+            grow(time_, capacity);
+        }
+        for (auto s = first; s!=last; ++s) {
+            gid_->push_back(s->source.gid);
+            index_->push_back(s->source.index);
+            time_->push_back(s->time);
+        }
+    }
+
+    // Drop the buffers, rather than clear them, as they may still be viewed.
+    void clear() {
+        gid_.reset();
+        index_.reset();
+        time_.reset();
+    }
+
+    py::tuple columns() const {
+        std::size_t n = size();
+        return py::make_tuple(view(gid_, n), view(index_, n), view(time_, n));
+    }
+
+    py::array_t<arb::spike> records() const {
+        std::size_t n = size();
+        py::array_t<arb::spike> result(py::ssize_t(n));
+        auto out = result.mutable_data();
+        for (std::size_t i = 0; i<n; ++i) {
+            out[i] = arb::spike({(*gid_)[i], (*index_)[i]}, (*time_)[i]);
+        }
+        return result;
+    }
+};
+
+// The time reached by a simulation in persistent run mode, see
+// simulation_shim::run_until(). Waiting releases the GIL, so that Python
+// callbacks of the simulation can run.
+struct run_future {
+    std::shared_future<arb::time_type> future;
+
+    bool done() const {
+        return future.wait_for(std::chrono::seconds(0))==std::future_status::ready;
+    }
+
+    bool wait(std::optional<double> timeout) const {
+        py::gil_scoped_release release;
+        if (!timeout) {
+            future.wait();
+            return true;
+        }
+        return future.wait_for(std::chrono::duration<double>(*timeout))==std::future_status::ready;
+    }
+
+    arb::time_type result() const {
+        py::gil_scoped_release release;
+        try {
+            return future.get();
+        }
+        catch (...) {
+            py_reset_and_throw();
+            throw;
+        }
+    }
+};
+
 // Wraps an arb::simulation object and in addition manages a set of
 // sampler callbacks for retrieving probe data.
 
 class simulation_shim {
     std::unique_ptr<arb::simulation> sim_;
-    std::vector<arb::spike> spike_record_;
+    // Spikes are recorded while the simulation runs without the GIL, and may
+    // be read concurrently from another Python thread.
+    mutable std::mutex spike_mutex_;
+    spike_column_record spike_record_;
+    std::unique_ptr<arb::spike_writer> spike_writer_;
     pyarb_global_ptr global_ptr_;
 
     using sample_recorder_ptr = std::unique_ptr<sample_recorder>;
@@ -50,6 +169,16 @@ class simulation_shim {
             }
             return result;
         }
+
+        py::list new_samples() const {
+            std::size_t size = recorders->size();
+            py::list result(size);
+
+            for (std::size_t i = 0; i<size; ++i) {
+                result[i] = py::make_tuple(recorders->at(i)->new_samples(), recorders->at(i)->meta());
+            }
+            return result;
+        }
     };
 
     std::unordered_map<arb::sampler_association_handle, sampler_callback> sampler_map_;
@@ -69,7 +198,10 @@ public:
 
     void reset() {
         sim_->reset();
-        spike_record_.clear();
+        {
+            std::lock_guard<std::mutex> lock(spike_mutex_);
+            spike_record_.clear();
+        }
         for (auto&& [handle, cb]: sampler_map_) {
             for (auto& rec: *cb.recorders) {
                 rec->reset();
@@ -78,25 +210,58 @@ public:
     }
 
     arb::time_type run(arb::time_type tfinal, arb::time_type dt) {
-        return sim_->run(tfinal, dt);
+        try {
+            return sim_->run(tfinal, dt);
+        }
+        catch (...) {
+            py_reset_and_throw();
+            throw;
+        }
+    }
+
+    void start(arb::time_type dt) {
+        sim_->start(dt);
+    }
+
+    run_future run_until(arb::time_type t) {
+        return {sim_->run_until(t).share()};
+    }
+
+    void stop() {
+        sim_->stop();
     }
 
     void set_binning_policy(arb::binning_kind policy, arb::time_type bin_interval) {
         sim_->set_binning_policy(policy, bin_interval);
     }
 
-    void record(spike_recording policy) {
-        auto spike_recorder = [this](const std::vector<arb::spike>& spikes) {
-            auto old_size = spike_record_.size();
-            // Append the new spikes to the end of the spike record.
-            spike_record_.insert(spike_record_.end(), spikes.begin(), spikes.end());
-            // Sort the newly appended spikes.
-            std::sort(spike_record_.begin()+old_size, spike_record_.end(),
+    void record(spike_recording policy, bool sort) {
+        auto spike_recorder = [this, sort](const std::vector<arb::spike>& spikes) {
+            std::lock_guard<std::mutex> lock(spike_mutex_);
+            if (!sort) {
+                spike_record_.append(spikes.data(), spikes.data()+spikes.size());
+                return;
+            }
+            // Append the spikes of each epoch to the record in sorted order.
+            std::vector<arb::spike> sorted(spikes);
+            std::sort(sorted.begin(), sorted.end(),
                     [](const auto& lhs, const auto& rhs) {
                         return std::tie(lhs.time, lhs.source.gid, lhs.source.index)<std::tie(rhs.time, rhs.source.gid, rhs.source.index);
                     });
+            spike_record_.append(sorted.data(), sorted.data()+sorted.size());
         };
 
+        set_spike_callback(policy, spike_recorder);
+        spike_writer_.reset();
+    }
+
+    void record_to_file(const std::string& path, spike_recording policy) {
+        auto writer = std::make_unique<arb::spike_writer>(path);
+        set_spike_callback(policy, writer->callback());
+        spike_writer_ = std::move(writer);
+    }
+
+    void set_spike_callback(spike_recording policy, arb::spike_export_function fn) {
         switch (policy) {
         case spike_recording::off:
             sim_->set_global_spike_callback();
@@ -104,17 +269,58 @@ public:
             break;
         case spike_recording::local:
             sim_->set_global_spike_callback();
-            sim_->set_local_spike_callback(spike_recorder);
+            sim_->set_local_spike_callback(std::move(fn));
             break;
         case spike_recording::all:
-            sim_->set_global_spike_callback(spike_recorder);
+            sim_->set_global_spike_callback(std::move(fn));
             sim_->set_local_spike_callback();
             break;
         }
     }
 
     py::object spikes() const {
-        return py::array_t<arb::spike>(py::ssize_t(spike_record_.size()), spike_record_.data());
+        std::lock_guard<std::mutex> lock(spike_mutex_);
+        return spike_record_.records();
+    }
+
+    py::tuple spike_columns() const {
+        std::lock_guard<std::mutex> lock(spike_mutex_);
+        return spike_record_.columns();
+    }
+
+    void inject_events(
+        py::array_t<arb::cell_gid_type, py::array::c_style | py::array::forcecast> gids,
+        py::array_t<arb::cell_lid_type, py::array::c_style | py::array::forcecast> targets,
+        py::array_t<arb::time_type, py::array::c_style | py::array::forcecast> times,
+        py::array_t<float, py::array::c_style | py::array::forcecast> weights)
+    {
+        auto n = gids.size();
+        if (targets.size()!=n || times.size()!=n || weights.size()!=n) {
+            throw pyarb_error("gid, target, time and weight arrays must have the same length");
+        }
+        sim_->inject_events(n, gids.data(), targets.data(), times.data(), weights.data());
+    }
+
+    // The callback is called while the simulation runs without the GIL, on
+    // any thread, and takes the GIL for the duration of the call.
+    void set_epoch_callback(py::object f) {
+        if (f.is_none()) {
+            sim_->set_epoch_callback();
+            return;
+        }
+        auto fn = std::make_shared<py::object>(std::move(f));
+        sim_->set_epoch_callback(
+            [fn](arb::time_type t, arb::time_type t_inject) {
+                try_catch_pyexception([&]() {
+                    py::gil_scoped_acquire guard;
+                    (*fn)(t, t_inject);
+                },
+                "Python error already thrown");
+            });
+    }
+
+    arb::simulation& simulation() {
+        return *sim_;
     }
 
     py::list get_probe_metadata(arb::cell_member_type probe_id) const {
@@ -160,6 +366,15 @@ public:
             return py::list{};
         }
     }
+
+    py::list new_samples(arb::sampler_association_handle sah) {
+        if (auto iter = sampler_map_.find(sah); iter!=sampler_map_.end()) {
+            return iter->second.new_samples();
+        }
+        else {
+            return py::list{};
+        }
+    }
 };
 
 void register_simulation(pybind11::module& m, pyarb_global_ptr global_ptr) {
@@ -167,13 +382,28 @@ void register_simulation(pybind11::module& m, pyarb_global_ptr global_ptr) {
 
     py::enum_<arb::sampling_policy>(m, "sampling_policy")
        .value("lax", arb::sampling_policy::lax)
-       .value("exact", arb::sampling_policy::exact);
+       .value("exact", arb::sampling_policy::exact)
+       .value("mean", arb::sampling_policy::mean)
+       .value("min", arb::sampling_policy::min)
+       .value("max", arb::sampling_policy::max)
+       .value("last", arb::sampling_policy::last);
 
     py::enum_<spike_recording>(m, "spike_recording")
        .value("off", spike_recording::off)
        .value("local", spike_recording::local)
        .value("all", spike_recording::all);
 
+    py::class_<run_future>(m, "run_future",
+        "The time reached by a simulation in persistent run mode, see simulation.run_until.")
+        .def("done", &run_future::done,
+            "Whether the time has been reached.")
+        .def("wait", &run_future::wait,
+            "Wait for the time to be reached, for at most timeout seconds if given.\n"
+            "Returns whether it has been reached.",
+            "timeout"_a = py::none())
+        .def("result", &run_future::result,
+            "Wait for the time to be reached, and return the time reached [ms].");
+
     // Simulation
     py::class_<simulation_shim> simulation(m, "simulation",
         "The executable form of a model.\n"
@@ -203,13 +433,45 @@ void register_simulation(pybind11::module& m, pyarb_global_ptr global_ptr) {
             pybind11::call_guard<pybind11::gil_scoped_release>(),
             "Run the simulation from current simulation time to tfinal [ms], with maximum time step size dt [ms].",
             "tfinal"_a, "dt"_a=0.025)
+        .def("start", &simulation_shim::start,
+            "Start the persistent run mode, in which a thread of the simulation advances it to the times\n"
+            "requested by run_until, with maximum time step size dt [ms]. The epochs continue from one\n"
+            "requested time to the next without stopping while further times are requested.",
+            "dt"_a=0.025)
+        .def("run_until", &simulation_shim::run_until,
+            "Request that a simulation started with start advance to time t [ms], no earlier than the\n"
+            "times requested before. Returns a run_future, which is done once the spikes up to t have\n"
+            "been recorded and the epoch callback has been called. Until stop, the simulation must only\n"
+            "be accessed through run_until, and from the epoch callback.",
+            "t"_a)
+        .def("stop", &simulation_shim::stop,
+            pybind11::call_guard<pybind11::gil_scoped_release>(),
+            "Wait for the times requested by run_until to be reached, and leave the persistent run mode.")
         .def("set_binning_policy", &simulation_shim::set_binning_policy,
             "Set the binning policy for event delivery, and the binning time interval if applicable [ms].",
             "policy"_a, "bin_interval"_a)
         .def("record", &simulation_shim::record,
-            "Disable or enable local or global spike recording.")
+            "Disable or enable local or global spike recording.\n"
+            "If sort is False, the spikes of each epoch are kept in the order they are delivered.",
+            "policy"_a, "sort"_a = true)
+        .def("record_to_file", &simulation_shim::record_to_file,
+            "Write local or global spikes to a binary file as the simulation runs, instead of keeping them in memory.",
+            "path"_a, "policy"_a = spike_recording::all)
+        .def("inject_events", &simulation_shim::inject_events,
+            "Add events to the targets given by arrays of cell gids, target indices on the cells,\n"
+            "times [ms] and weights. Event times must not precede the end of the last run, or,\n"
+            "within an epoch callback, its t_inject argument.",
+            "gid"_a, "target"_a, "time"_a, "weight"_a)
+        .def("set_epoch_callback", &simulation_shim::set_epoch_callback,
+            "Set a function f(t, t_inject), called during run at the end of each epoch, once the spikes\n"
+            "up to time t have been recorded, from which events at t_inject or later can be injected.\n"
+            "Pass None to remove it.",
+            "callback"_a)
         .def("spikes", &simulation_shim::spikes,
             "Retrieve recorded spikes as numpy array.")
+        .def("spike_columns", &simulation_shim::spike_columns,
+            "Retrieve recorded spikes as a tuple of read-only numpy arrays (gid, index, time),\n"
+            "which view the recorded data without copying it.")
         .def("probe_metadata", &simulation_shim::get_probe_metadata,
             "Retrieve metadata associated with given probe id.",
             "probe_id"_a)
@@ -220,12 +482,27 @@ void register_simulation(pybind11::module& m, pyarb_global_ptr global_ptr) {
         .def("samples", &simulation_shim::samples,
             "Retrieve sample data as a list, one element per probe associated with the query.",
             "handle"_a)
+        .def("new_samples", &simulation_shim::new_samples,
+            "Retrieve the sample data recorded since the last call to new_samples, as for samples.",
+            "handle"_a)
         .def("remove_sampler", &simulation_shim::remove_sampler,
             "Remove sampling associated with the given handle.",
             "handle"_a)
         .def("remove_all_samplers", &simulation_shim::remove_sampler,
             "Remove all sampling on the simulatr.");
 
+    m.def("run_ensemble",
+        [](const std::vector<simulation_shim*>& sims, arb::time_type tfinal, arb::time_type dt) {
+            std::vector<arb::simulation*> ptrs;
+            for (auto s: sims) ptrs.push_back(&s->simulation());
+            return arb::run_ensemble(ptrs, tfinal, dt);
+        },
+        pybind11::call_guard<pybind11::gil_scoped_release>(),
+        "Run independent simulations built on the same context together, from their current times\n"
+        "to tfinal [ms], with maximum time step size dt [ms], sharing the threads of the context.\n"
+        "Returns the time reached by each simulation.",
+        "simulations"_a, "tfinal"_a, "dt"_a=0.025);
+
 }
 
 } // namespace pyarb
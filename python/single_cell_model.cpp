@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <any>
 #include <memory>
 #include <string>
@@ -70,24 +71,26 @@ struct trace_callback {
 // in the single_cell_model by user calls. The recipe is generated lazily, just
 // before simulation construction, so the recipe can use const references to all
 // of the model descriptors.
+// A batched run has one cell per variant of the model, each with the same
+// probes; a plain run has just the one cell.
 struct single_cell_recipe: arb::recipe {
-    const arb::cable_cell& cell_;
+    const std::vector<arb::cable_cell>& cells_;
     const std::vector<probe_site>& probes_;
     const arb::cable_cell_global_properties& gprop_;
 
     single_cell_recipe(
-            const arb::cable_cell& c,
+            const std::vector<arb::cable_cell>& cells,
             const std::vector<probe_site>& probes,
             const arb::cable_cell_global_properties& props):
-        cell_(c), probes_(probes), gprop_(props)
+        cells_(cells), probes_(probes), gprop_(props)
     {}
 
     virtual arb::cell_size_type num_cells() const override {
-        return 1;
+        return cells_.size();
     }
 
     virtual arb::util::unique_any get_cell_description(arb::cell_gid_type gid) const override {
-        return cell_;
+        return cells_.at(gid);
     }
 
     virtual arb::cell_kind get_cell_kind(arb::cell_gid_type) const override {
@@ -169,7 +172,8 @@ public:
 
     void run(double tfinal, double dt) {
         gprop.catalogue = &cat;
-        single_cell_recipe rec(cell_, probes_, gprop);
+        std::vector<arb::cable_cell> cells = {cell_};
+        single_cell_recipe rec(cells, probes_, gprop);
 
         auto domdec = arb::partition_load_balance(rec, ctx_);
 
@@ -203,6 +207,49 @@ public:
         run_ = true;
     }
 
+    // Run one variant of the cell for each decor, with the morphology and
+    // labels of the model's cell. The variants are placed in a single cell
+    // group, so that they are integrated together. Returns the spike times
+    // and the traces of each variant, in the order of the decors; the spikes
+    // and traces of the model are not changed.
+    std::pair<std::vector<std::vector<double>>, std::vector<std::vector<trace>>>
+    run_batch(const std::vector<arb::decor>& decors, double tfinal, double dt) {
+        gprop.catalogue = &cat;
+        std::vector<arb::cable_cell> cells;
+        cells.reserve(decors.size());
+        for (auto& d: decors) {
+            cells.emplace_back(cell_.morphology(), cell_.labels(), d);
+        }
+        single_cell_recipe rec(cells, probes_, gprop);
+
+        arb::partition_hint_map hints;
+        hints[arb::cell_kind::cable].cpu_group_size = std::max<std::size_t>(1, cells.size());
+        auto domdec = arb::partition_load_balance(rec, ctx_, hints);
+        arb::simulation sim(rec, domdec, ctx_);
+
+        std::vector<std::vector<double>> spikes(cells.size());
+        std::vector<std::vector<trace>> traces(cells.size());
+        for (arb::cell_gid_type gid=0; gid<cells.size(); ++gid) {
+            traces[gid].reserve(probes_.size());
+            for (arb::cell_lid_type i=0; i<probes_.size(); ++i) {
+                const auto& p = probes_[i];
+                traces[gid].push_back({"voltage", p.site, {}, {}});
+                sim.add_sampler(arb::one_probe({gid,i}), arb::regular_schedule(1.0/p.frequency), trace_callback(traces[gid][i]));
+            }
+        }
+
+        sim.set_global_spike_callback(
+            [&spikes](const std::vector<arb::spike>& batch) {
+                for (auto& s: batch) {
+                    spikes[s.source.gid].push_back(s.time);
+                }
+            });
+
+        sim.run(tfinal, dt);
+
+        return {std::move(spikes), std::move(traces)};
+    }
+
     const std::vector<double>& spike_times() const {
         return spike_times_;
     }
@@ -235,6 +282,13 @@ void register_single_cell(pybind11::module& m) {
              "tfinal"_a,
              "dt"_a = 0.025,
              "Run model from t=0 to t=tfinal ms.")
+        .def("run_batch",
+             &single_cell_model::run_batch,
+             "decors"_a,
+             "tfinal"_a,
+             "dt"_a = 0.025,
+             "Run one variant of the cell for each decor, from t=0 to t=tfinal ms, in a single cell group.\n"
+             "Returns a tuple (spikes, traces), holding the spike times and the traces of each variant.")
         .def("probe",
             [](single_cell_model& m, const char* what, const char* where, double frequency) {
                 m.probe(what, arborio::parse_locset_expression(where).unwrap(), frequency);},
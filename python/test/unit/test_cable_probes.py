@@ -173,6 +173,28 @@ class CableProbes(unittest.TestCase):
         self.assertEqual(1, len(m))
         self.assertEqual(all_cv_cables, m[0])
 
+    def test_new_samples(self):
+        recipe = cc_recipe()
+        context = A.context()
+        dd = A.partition_load_balance(recipe, context)
+        sim = A.simulation(recipe, dd, context)
+
+        # Scalar and vector probes, sampled over enough steps to fill several chunks.
+        handles = [sim.sample((0, 0), A.regular_schedule(0.1)), sim.sample((0, 1), A.regular_schedule(0.1))]
+        parts = [[], []]
+        for t in range(1, 11):
+            sim.run(t*40, 0.1)
+            for h, p in zip(handles, parts):
+                new, _ = sim.new_samples(h)[0]
+                p.append(new)
+
+        for h, p in zip(handles, parts):
+            data, _ = sim.samples(h)[0]
+            self.assertEqual(4000, data.shape[0])
+            self.assertEqual(data.tolist(), [row for part in p for row in part.tolist()])
+            self.assertFalse(data.flags.writeable)
+            self.assertEqual(0, sim.new_samples(h)[0][0].shape[0])
+
 def suite():
     # specify class and test functions in tuple (here: all tests starting with 'test' from class Contexts
     suite = unittest.makeSuite(CableProbes, ('test'))
@@ -3,6 +3,7 @@
 # test_spikes.py
 
 import unittest
+import numpy
 import arbor as A
 
 # to be able to run .py file from child directory
@@ -51,6 +52,46 @@ class art_spiker_recipe(A.recipe):
         return A.spike_source_cell("src", A.explicit_schedule(self.trains[gid]))
 
 
+# A chain of a spike source driving two LIF cells: 0 -> 1 -> 2.
+class chain_recipe(A.recipe):
+    def __init__(self):
+        A.recipe.__init__(self)
+
+    def num_cells(self):
+        return 3
+
+    def cell_kind(self, gid):
+        return A.cell_kind.spike_source if gid==0 else A.cell_kind.lif
+
+    def connections_on(self, gid):
+        return [A.connection((gid-1, "src"), "tgt", 1000, 1)] if gid>0 else []
+
+    def cell_description(self, gid):
+        if gid==0:
+            return A.spike_source_cell("src", A.explicit_schedule([1]))
+        return A.lif_cell("src", "tgt")
+
+# The same chain, described through the bulk protocol.
+class bulk_chain_recipe(chain_recipe):
+    def cell_kind(self, gid):
+        raise RuntimeError("cell_kind called on a bulk recipe")
+
+    def connections_on(self, gid):
+        raise RuntimeError("connections_on called on a bulk recipe")
+
+    def cell_kinds(self, gids):
+        return [A.cell_kind.spike_source if gid==0 else A.cell_kind.lif for gid in gids]
+
+    def connections_for(self, gids):
+        conns = numpy.zeros(len(gids), dtype=A.connection_dtype)
+        conns["dst"] = gids
+        conns["src"] = gids-1
+        conns["src_label"] = 0
+        conns["dst_label"] = 1
+        conns["weight"] = 1000
+        conns["delay"] = 1
+        return ["src", "tgt"], conns[gids>0]
+
 class Spikes(unittest.TestCase):
     # Helper for constructing a simulation from a recipe using default context and domain decomposition.
     def init_sim(self, recipe):
@@ -76,6 +117,62 @@ class Spikes(unittest.TestCase):
         self.assertEqual([2, 1, 0, 0, 1, 2, 0, 1, 2, 0, 2, 1, 1], gids)
         self.assertEqual([0.2, 0.4, 0.8, 2., 2., 2., 2.1, 2.2, 2.8, 3., 3., 3.1, 4.5], times)
 
+    # test that the columns hold the same spikes as the structured array
+    def test_spike_columns(self):
+        sim = self.init_sim(art_spiker_recipe())
+        sim.record(A.spike_recording.all)
+        sim.run(3, 0.01)
+        gid, index, time = sim.spike_columns()
+        sim.run(5, 0.01)
+
+        spikes = sim.spikes()
+        n = len(gid)
+        self.assertEqual(spikes["source"]["gid"][:n].tolist(), gid.tolist())
+        self.assertEqual(spikes["source"]["index"][:n].tolist(), index.tolist())
+        self.assertEqual(spikes["time"][:n].tolist(), time.tolist())
+        self.assertEqual(len(spikes), len(sim.spike_columns()[2]))
+        self.assertFalse(time.flags.writeable)
+
+        sim.reset()
+        sim.record(A.spike_recording.all, sort=False)
+        sim.run(5, 0.01)
+        self.assertEqual(sorted(spikes["time"].tolist()), sorted(sim.spike_columns()[2].tolist()))
+
+    # test that recipes using the bulk protocol give the same network
+    def test_bulk_recipe(self):
+        spikes = []
+        for recipe in [chain_recipe(), bulk_chain_recipe()]:
+            sim = self.init_sim(recipe)
+            sim.record(A.spike_recording.all)
+            sim.run(10, 0.01)
+            spikes.append(sim.spikes())
+
+        gids = spikes[1]["source"]["gid"].tolist()
+        self.assertEqual([0, 1, 2], gids)
+        self.assertEqual(spikes[0]["source"]["gid"].tolist(), gids)
+        self.assertEqual(spikes[0]["time"].tolist(), spikes[1]["time"].tolist())
+
+    # test that advancing in persistent run mode gives the spikes of a run
+    def test_persistent_run(self):
+        sim = self.init_sim(art_spiker_recipe())
+        sim.record(A.spike_recording.all)
+        ends = []
+        sim.set_epoch_callback(lambda t, t_inject: ends.append(t))
+
+        sim.start(0.01)
+        steps = [sim.run_until(t) for t in [1, 2, 3, 4, 5]]
+        self.assertEqual([1, 2, 3, 4, 5], [f.result() for f in steps])
+        self.assertTrue(all(f.done() for f in steps))
+        sim.stop()
+
+        for t in [1, 2, 3, 4, 5]:
+            self.assertIn(t, ends)
+        times = sim.spikes()["time"].tolist()
+        self.assertEqual([0.2, 0.4, 0.8, 2., 2., 2., 2.1, 2.2, 2.8, 3., 3., 3.1, 4.5], sorted(times))
+
+        # after stopping, the simulation runs on as before
+        self.assertEqual(6, sim.run(6, 0.01))
+
 def suite():
     # specify class and test functions in tuple (here: all tests starting with 'test' from class Contexts
     suite = unittest.makeSuite(Spikes, ('test'))
@@ -9,6 +9,9 @@
 #include <arbor/event_generator.hpp>
 #include <arbor/cable_cell.hpp>
 #include <arbor/cable_cell_param.hpp>
+#include <arbor/cv_policy.hpp>
+#include <arbor/morph/morphology.hpp>
+#include <arbor/morph/segment_tree.hpp>
 #include <arbor/recipe.hpp>
 #include <arbor/util/unique_any.hpp>
 
@@ -124,5 +127,64 @@ protected:
     std::vector<cable_cell> cells_;
 };
 
+
+// A chain of cable cells, each a soma and a dendrite, where the end of the
+// dendrite of cell i is joined by a gap junction to the soma of cell i+1.
+// The conductances of the junctions and the current clamps on the dendrites
+// differ from cell to cell, and each cell has a voltage probe on its soma
+// and one on the end of its dendrite.
+//
+// With a positive gj_interval, the cells are simulated in different cell
+// groups, and the voltages of the junctions exchanged every gj_interval.
+
+class gap_junction_chain_recipe: public simple_recipe_base {
+public:
+    gap_junction_chain_recipe(cell_size_type n, double gj_interval = 0): n_(n) {
+        cell_gprop_.gap_junction_interval = gj_interval;
+    }
+
+    cell_size_type num_cells() const override { return n_; }
+    cell_kind get_cell_kind(cell_gid_type) const override { return cell_kind::cable; }
+
+    util::unique_any get_cell_description(cell_gid_type gid) const override {
+        segment_tree tree;
+        auto soma = tree.append(mnpos, {0, 0, 0, 6.3}, {12.6, 0, 0, 6.3}, 1);
+        tree.append(soma, {212.6, 0, 0, 0.5}, 3);
+
+        decor d;
+        d.set_default(cv_policy_fixed_per_branch(9));
+        d.paint(reg::tagged(1), mechanism_desc("hh"));
+        d.paint(reg::tagged(3), mechanism_desc("pas"));
+        d.place(mlocation{0, 0.5}, i_clamp::box(1, 4, 0.1*(gid+1)), "cc");
+        d.place(soma_site, gap_junction_site{}, "gj_soma");
+        d.place(dend_site, gap_junction_site{}, "gj_dend");
+        return cable_cell(morphology(tree), {}, d);
+    }
+
+    std::vector<gap_junction_connection> gap_junctions_on(cell_gid_type gid) const override {
+        std::vector<gap_junction_connection> conns;
+        if (gid>0) {
+            conns.emplace_back(cell_global_label_type{gid-1, "gj_dend"}, cell_local_label_type{"gj_soma"}, ggap(gid-1));
+        }
+        if (gid+1<n_) {
+            conns.emplace_back(cell_global_label_type{gid+1, "gj_soma"}, cell_local_label_type{"gj_dend"}, ggap(gid));
+        }
+        return conns;
+    }
+
+    std::vector<probe_info> get_probes(cell_gid_type) const override {
+        return {cable_probe_membrane_voltage{soma_site}, cable_probe_membrane_voltage{dend_site}};
+    }
+
+private:
+    static constexpr mlocation soma_site{0, 0.03};
+    static constexpr mlocation dend_site{0, 1};
+
+    // Conductance [µS] of the junction between cells i and i+1.
+    static double ggap(cell_gid_type i) { return 0.001*(i+1); }
+
+    cell_size_type n_;
+};
+
 } // namespace arb
 
@@ -0,0 +1,259 @@
+// Costs of delivering spikes as events, outside of cell integration:
+//
+//   * thread_private_spike_store::gather: collating the spikes of the threads;
+//   * communicator::exchange: sorting local spikes and gathering them;
+//   * communicator::make_event_queues: generating the events of the gathered
+//     spikes for the local cells;
+//   * tree_merge_events and merge_cell_events: merging the events of a cell
+//     for the next epoch.
+//
+// Several domains are emulated with a dry run context, in which the spikes of
+// the local domain are replicated with gid offsets for every other domain.
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <arbor/context.hpp>
+#include <arbor/domain_decomposition.hpp>
+#include <arbor/event_generator.hpp>
+#include <arbor/load_balance.hpp>
+#include <arbor/recipe.hpp>
+#include <arbor/spike.hpp>
+#include <arbor/spike_event.hpp>
+
+#include "communication/communicator.hpp"
+#include "event_buffer.hpp"
+#include "execution_context.hpp"
+#include "label_resolution.hpp"
+#include "merge_events.hpp"
+#include "thread_private_spike_store.hpp"
+#include "threading/threading.hpp"
+#include "util/rangeutil.hpp"
+
+namespace arb {
+void merge_cell_events(
+    time_type t_from,
+    time_type t_to,
+    event_span old_events,
+    event_span pending,
+    std::vector<event_generator>& generators,
+    pse_vector& new_events);
+} // namespace arb
+
+using namespace arb;
+
+// Cells with `fan_in` connections from random sources.
+class random_network: public recipe {
+public:
+    random_network(cell_size_type ncells, unsigned fan_in): ncells_(ncells), fan_in_(fan_in) {}
+
+    cell_size_type num_cells() const override { return ncells_; }
+    util::unique_any get_cell_description(cell_gid_type) const override { return {}; }
+    cell_kind get_cell_kind(cell_gid_type) const override { return cell_kind::benchmark; }
+
+    std::vector<cell_connection> connections_on(cell_gid_type gid) const override {
+        std::mt19937 G(gid);
+        std::uniform_int_distribution<cell_gid_type> source(0, ncells_-1);
+        std::vector<cell_connection> cons;
+        for (unsigned i = 0; i<fan_in_; ++i) {
+            cons.push_back({{source(G), "src"}, {"tgt"}, 1.f, 1.f});
+        }
+        return cons;
+    }
+
+private:
+    cell_size_type ncells_;
+    unsigned fan_in_;
+};
+
+// A communicator for the local cells of a dry run context with `ndomains`
+// domains, each with `ncells` cells.
+struct network {
+    context ctx;
+    random_network rec;
+    domain_decomposition decomp;
+    communicator comm;
+
+    network(unsigned ncells, unsigned fan_in, unsigned ndomains, unsigned nthreads):
+        ctx(make_context(proc_allocation{nthreads, -1}, dry_run_info(ndomains, ncells))),
+        rec(ncells*ndomains, fan_in),
+        decomp(partition_load_balance(rec, ctx))
+    {
+        cell_labels_and_gids sources, targets;
+        for (auto& g: decomp.groups) {
+            cell_label_range src, tgt;
+            for (auto gid: g.gids) {
+                (void)gid;
+                src.add_cell();
+                src.add_label("src", {0, 1});
+                tgt.add_cell();
+                tgt.add_label("tgt", {0, 1});
+            }
+            sources.append({src, g.gids});
+            targets.append({tgt, g.gids});
+        }
+        comm = communicator(rec, decomp, sources, label_resolution_map(targets), *ctx);
+    }
+
+    // `nspikes` spikes from random local cells in [0, 1) ms, in time order.
+    std::vector<spike> local_spikes(unsigned nspikes) const {
+        std::mt19937 G(42);
+        std::vector<cell_gid_type> gids;
+        for (auto& g: decomp.groups) gids.insert(gids.end(), g.gids.begin(), g.gids.end());
+        std::uniform_int_distribution<std::size_t> cell(0, gids.size()-1);
+
+        std::vector<spike> spikes;
+        for (unsigned i = 0; i<nspikes; ++i) {
+            spikes.push_back({{gids[cell(G)], 0}, double(i)/nspikes});
+        }
+        return spikes;
+    }
+};
+
+void spike_store_gather(benchmark::State& state) {
+    const unsigned nspikes = state.range(0);
+    const unsigned nthreads = state.range(1);
+
+    auto ts = std::make_shared<threading::task_system>(nthreads);
+    thread_private_spike_store store(ts);
+    std::vector<spike> chunk(nspikes/nthreads, spike{{0, 0}, 1.});
+    threading::parallel_for::apply(0, nthreads, ts.get(), [&](int) { store.insert(chunk); });
+
+    std::vector<spike> spikes;
+    while (state.KeepRunning()) {
+        store.gather(spikes);
+        benchmark::DoNotOptimize(spikes.data());
+    }
+}
+
+void exchange(benchmark::State& state) {
+    const unsigned nspikes = state.range(0);
+    const unsigned ndomains = state.range(1);
+
+    network net(1000, 10, ndomains, 1);
+    auto local = net.local_spikes(nspikes);
+
+    while (state.KeepRunning()) {
+        auto global = net.comm.exchange(local);
+        benchmark::DoNotOptimize(global.values().data());
+    }
+}
+
+void make_event_queues(benchmark::State& state) {
+    const unsigned nspikes = state.range(0);
+    const unsigned fan_in = state.range(1);
+    const unsigned ndomains = state.range(2);
+    const unsigned nthreads = state.range(3);
+
+    network net(1000, fan_in, ndomains, nthreads);
+    auto global = net.comm.exchange(net.local_spikes(nspikes));
+    event_buffer queues(net.comm.num_local_cells());
+
+    while (state.KeepRunning()) {
+        queues.clear();
+        net.comm.make_event_queues(global, queues);
+        benchmark::ClobberMemory();
+    }
+    state.counters["events"] = queues.size();
+}
+
+// Sorted events in [0, 1) ms on `nlanes` lanes of `nevents` events.
+std::vector<pse_vector> make_lanes(unsigned nlanes, unsigned nevents) {
+    std::mt19937 G(42);
+    std::uniform_real_distribution<time_type> time(0, 1);
+    std::vector<pse_vector> lanes(nlanes);
+    for (auto& lane: lanes) {
+        for (unsigned i = 0; i<nevents; ++i) lane.push_back({0, time(G), 1.f});
+        util::sort_by(lane, [](const spike_event& e) { return e.time; });
+    }
+    return lanes;
+}
+
+void tree_merge(benchmark::State& state) {
+    const unsigned nlanes = state.range(0);
+    const unsigned nevents = state.range(1);
+
+    auto lanes = make_lanes(nlanes, nevents);
+    pse_vector out;
+    while (state.KeepRunning()) {
+        std::vector<event_span> spans;
+        for (auto& l: lanes) spans.push_back(util::range_pointer_view(l));
+        out.clear();
+        tree_merge_events(spans, out);
+        benchmark::DoNotOptimize(out.data());
+    }
+}
+
+void merge_cell(benchmark::State& state) {
+    const unsigned nevents = state.range(0);
+    const unsigned ngenerators = state.range(1);
+
+    auto lanes = make_lanes(2, nevents);
+    std::vector<event_generator> generators;
+    for (unsigned i = 0; i<ngenerators; ++i) {
+        generators.push_back(poisson_generator({"tgt"}, 1.f, 0, nevents, std::mt19937_64(i)));
+        generators.back().resolve_label([](const cell_local_label_type&) { return 0; });
+    }
+
+    // Old and pending events, and those of each generator, in one 1 ms epoch.
+    pse_vector out;
+    while (state.KeepRunning()) {
+        for (auto& g: generators) g.reset();
+        merge_cell_events(0, 1, util::range_pointer_view(lanes[0]), util::range_pointer_view(lanes[1]), generators, out);
+        benchmark::DoNotOptimize(out.data());
+    }
+}
+
+void spikes_threads(benchmark::internal::Benchmark* b) {
+    for (auto nspikes: {1000, 100000}) {
+        for (auto nthreads: {1, 4, 16}) {
+            b->Args({nspikes, nthreads});
+        }
+    }
+}
+
+void spikes_domains(benchmark::internal::Benchmark* b) {
+    for (auto nspikes: {100, 10000}) {
+        for (auto ndomains: {1, 16, 256}) {
+            b->Args({nspikes, ndomains});
+        }
+    }
+}
+
+void spikes_fanin_domains_threads(benchmark::internal::Benchmark* b) {
+    for (auto nspikes: {100, 10000}) {
+        for (auto fan_in: {10, 1000}) {
+            for (auto ndomains: {1, 16}) {
+                for (auto nthreads: {1, 4}) {
+                    b->Args({nspikes, fan_in, ndomains, nthreads});
+                }
+            }
+        }
+    }
+}
+
+void lanes_events(benchmark::internal::Benchmark* b) {
+    for (auto nlanes: {2, 8, 64}) {
+        for (auto nevents: {10, 1000}) {
+            b->Args({nlanes, nevents});
+        }
+    }
+}
+
+void events_generators(benchmark::internal::Benchmark* b) {
+    for (auto nevents: {10, 1000}) {
+        for (auto ngenerators: {0, 1, 4}) {
+            b->Args({nevents, ngenerators});
+        }
+    }
+}
+
+BENCHMARK(spike_store_gather)->Apply(spikes_threads);
+BENCHMARK(exchange)->Apply(spikes_domains);
+BENCHMARK(make_event_queues)->Apply(spikes_fanin_domains_threads)->Unit(benchmark::kMicrosecond);
+BENCHMARK(tree_merge)->Apply(lanes_events);
+BENCHMARK(merge_cell)->Apply(events_generators);
+
+BENCHMARK_MAIN();
@@ -92,6 +92,45 @@ TEST(communicator, gather_spikes_equal) {
     }
 }
 
+// Test non-blocking spike gather against the blocking gather, with
+// differing numbers of spikes on each domain.
+TEST(communicator, gather_spikes_async) {
+    const auto rank = g_context->distributed->id();
+
+    std::vector<spike> local_spikes;
+    for (auto i=0; i<rank+1; ++i) {
+        local_spikes.push_back(gen_spike(rank, i));
+    }
+
+    const auto expected = g_context->distributed->gather_spikes(local_spikes);
+
+    auto request = g_context->distributed->gather_spikes_async(local_spikes);
+    local_spikes.clear();
+    const auto global_spikes = request.wait();
+
+    EXPECT_EQ(expected.partition(), global_spikes.partition());
+    EXPECT_EQ(expected.values(), global_spikes.values());
+}
+
+// Test non-blocking element-wise sum onto each domain in turn.
+TEST(communicator, sum_async) {
+    const auto num_domains = g_context->distributed->size();
+    const auto rank = g_context->distributed->id();
+
+    for (int root = 0; root<num_domains; ++root) {
+        auto request = g_context->distributed->sum_async({1., double(rank)}, root);
+        auto sums = request.wait();
+
+        if (rank==root) {
+            std::vector<double> expected = {double(num_domains), num_domains*(num_domains-1)/2.};
+            EXPECT_EQ(expected, sums);
+        }
+        else {
+            EXPECT_TRUE(sums.empty());
+        }
+    }
+}
+
 // Test low level spike_gather function when the number of spikes per domain
 // are not equal.
 TEST(communicator, gather_spikes_variant) {
@@ -449,14 +488,16 @@ test_ring(const domain_decomposition& D, communicator& C, F&& f) {
 
     // gather the global set of spikes
     auto global_spikes = C.exchange(local_spikes);
-    if (global_spikes.size()!=g_context->distributed->sum(local_spikes.size())) {
+    // With point-to-point exchange, only spikes with local targets are received.
+    if (C.exchange_kind()==spike_exchange_kind::allgather &&
+        global_spikes.size()!=g_context->distributed->sum(local_spikes.size())) {
         return ::testing::AssertionFailure() << "the number of gathered spikes "
             << global_spikes.size() << " doesn't match the expected "
             << g_context->distributed->sum(local_spikes.size());
     }
 
     // generate the events
-    std::vector<arb::pse_vector> queues(C.num_local_cells());
+    arb::event_buffer queues(C.num_local_cells());
     C.make_event_queues(global_spikes, queues);
 
     // Assert that all the correct events were generated.
@@ -469,7 +510,7 @@ test_ring(const domain_decomposition& D, communicator& C, F&& f) {
         if (f(src)) {
             auto expected = expected_event_ring(gid, D.num_global_cells);
             auto grp = group_map[gid];
-            auto& q = queues[grp];
+            auto q = queues[grp];
             if (std::find(q.begin(), q.end(), expected)==q.end()) {
                 return ::testing::AssertionFailure()
                     << "expected event " << expected << " was not found";
@@ -481,8 +522,7 @@ test_ring(const domain_decomposition& D, communicator& C, F&& f) {
     // Assert that only the expected events were produced. The preceding test
     // showed that all expected events were generated, so this only requires
     // that the number of generated events is as expected.
-    int num_events = std::accumulate(queues.begin(), queues.end(), 0,
-            [](int l, decltype(queues.front())& r){return l + r.size();});
+    int num_events = queues.size();
 
     if (expected_count!=num_events) {
         return ::testing::AssertionFailure() <<
@@ -541,6 +581,17 @@ TEST(communicator, ring)
     EXPECT_TRUE(test_ring(D, C, [](cell_gid_type g){return g%2==0;}));
     // odd-numbered cells fire
     EXPECT_TRUE(test_ring(D, C, [](cell_gid_type g){return g%2==1;}));
+
+    // repeat with point-to-point spike exchange
+    C.set_exchange_kind(spike_exchange_kind::point_to_point);
+    C.reset();
+    EXPECT_TRUE(test_ring(D, C, [](cell_gid_type g){return true;}));
+    EXPECT_TRUE(test_ring(D, C, [n_local](cell_gid_type g){return (g+1)%n_local == 0u;}));
+    EXPECT_TRUE(test_ring(D, C, [](cell_gid_type g){return g%2==0;}));
+    EXPECT_TRUE(test_ring(D, C, [](cell_gid_type g){return g%2==1;}));
+
+    // the global spike count is maintained even though not all spikes are received
+    EXPECT_EQ(n_global+N+n_global/2+n_global/2, C.num_spikes());
 }
 
 template <typename F>
@@ -571,9 +622,9 @@ test_all2all(const domain_decomposition& D, communicator& C, F&& f) {
     }
 
     // generate the events
-    std::vector<arb::pse_vector> queues(C.num_local_cells());
+    arb::event_buffer queues(C.num_local_cells());
     C.make_event_queues(global_spikes, queues);
-    if (queues.size() != D.groups.size()) { // one queue for each cell group
+    if (queues.num_cells() != D.groups.size()) { // one queue for each cell group
         return ::testing::AssertionFailure()
             << "expect one event queue for each cell group";
     }
@@ -585,7 +636,7 @@ test_all2all(const domain_decomposition& D, communicator& C, F&& f) {
     int expected_count = 0;
     for (auto gid: gids) {
         // get the event queue that this gid belongs to
-        auto& q = queues[group_map[gid]];
+        auto q = queues[group_map[gid]];
         for (auto src: spike_gids) {
             auto expected = expected_event_all2all(gid, src);
             if (std::find(q.begin(), q.end(), expected)==q.end()) {
@@ -600,8 +651,7 @@ test_all2all(const domain_decomposition& D, communicator& C, F&& f) {
     // Assert that only the expected events were produced. The preceding test
     // showed that all expected events were generated, so this only requires
     // that the number of generated events is as expected.
-    int num_events = std::accumulate(queues.begin(), queues.end(), 0,
-            [](int l, decltype(queues.front())& r){return l + r.size();});
+    int num_events = queues.size();
 
     if (expected_count!=num_events) {
         return ::testing::AssertionFailure() <<
@@ -639,7 +689,11 @@ TEST(communicator, all2all)
 
     // construct the communicator
     auto C = communicator(R, D, label_resolution_map(global_sources), label_resolution_map({local_targets, mc_gids}), *g_context);
+
+    // sort connections by source: with multiple threads, connections are
+    // partitioned by target cell before source.
     auto connections = C.connections();
+    std::stable_sort(connections.begin(), connections.end());
 
     for (auto i: util::make_span(0, n_global)) {
         for (unsigned j = 0; j < n_local; ++j) {
@@ -707,3 +761,33 @@ TEST(communicator, mini_network)
         }
     }
 }
+
+TEST(communicator, local_source_labels)
+{
+    // Resolving against the labels fetched for the referenced sources gives
+    // the same connections as resolving against all labels.
+    unsigned N = g_context->distributed->size();
+
+    auto R = mini_recipe(N);
+    const auto D = partition_load_balance(R, g_context);
+
+    std::vector<cell_gid_type> gids;
+    for (auto g: D.groups) {
+        gids.insert(gids.end(), g.gids.begin(), g.gids.end());
+    }
+    cell_label_range local_sources, local_targets;
+    auto mc_group = mc_cell_group(gids, R, local_sources, local_targets, make_fvm_lowered_cell(backend_kind::multicore, *g_context));
+    auto global_sources = g_context->distributed->gather_cell_labels_and_gids({local_sources, gids});
+
+    auto C_global = communicator(R, D, label_resolution_map(global_sources), label_resolution_map({local_targets, gids}), *g_context);
+    auto C_local = communicator(R, D, cell_labels_and_gids(local_sources, gids), label_resolution_map({local_targets, gids}), *g_context);
+
+    auto expected = C_global.connections();
+    auto connections = C_local.connections();
+    ASSERT_EQ(expected.size(), connections.size());
+    for (auto i: util::count_along(expected)) {
+        EXPECT_EQ(expected[i].source(), connections[i].source());
+        EXPECT_EQ(expected[i].destination(), connections[i].destination());
+        EXPECT_EQ(expected[i].index_on_domain(), connections[i].index_on_domain());
+    }
+}
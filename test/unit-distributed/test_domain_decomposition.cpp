@@ -1,5 +1,6 @@
 #include "../gtest.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <fstream>
 #include <iostream>
@@ -138,6 +139,63 @@ namespace {
         unsigned groups_;
         cell_size_type size_;
     };
+
+    // Cable cells in `n_cluster` clusters of `cluster_size` cells, with the
+    // gids of the clusters interleaved: cell gid belongs to cluster
+    // gid%n_cluster, and is connected to the preceding cell of its cluster.
+    class interleaved_clusters: public recipe {
+    public:
+        interleaved_clusters(unsigned n_cluster, unsigned cluster_size):
+            n_cluster_(n_cluster), cluster_size_(cluster_size) {}
+
+        cell_size_type num_cells() const override {
+            return n_cluster_*cluster_size_;
+        }
+
+        arb::util::unique_any get_cell_description(cell_gid_type) const override {
+            return {};
+        }
+
+        cell_kind get_cell_kind(cell_gid_type gid) const override {
+            return cell_kind::cable;
+        }
+
+        std::vector<cell_connection> connections_on(cell_gid_type gid) const override {
+            if (gid<n_cluster_) return {};
+            return {cell_connection({gid-n_cluster_, "src"}, {"tgt"}, 1.f, 1.f)};
+        }
+
+    private:
+        unsigned n_cluster_;
+        unsigned cluster_size_;
+    };
+
+    // Cable cells where the first `n_heavy` cells cost 9 times as much as the
+    // others.
+    class costed_recipe: public recipe {
+    public:
+        costed_recipe(cell_size_type size, cell_size_type n_heavy): size_(size), n_heavy_(n_heavy) {}
+
+        cell_size_type num_cells() const override {
+            return size_;
+        }
+
+        arb::util::unique_any get_cell_description(cell_gid_type) const override {
+            return {};
+        }
+
+        cell_kind get_cell_kind(cell_gid_type gid) const override {
+            return cell_kind::cable;
+        }
+
+        std::optional<double> cell_cost(cell_gid_type gid) const override {
+            return gid<n_heavy_? 9.: 1.;
+        }
+
+    private:
+        cell_size_type size_;
+        cell_size_type n_heavy_;
+    };
 }
 
 TEST(domain_decomposition, homogeneous_population_mc) {
@@ -411,3 +469,79 @@ TEST(domain_decomposition, non_symmetric_groups)
         }
     }
 }
+
+TEST(domain_decomposition, cell_costs) {
+    proc_allocation resources{1, -1};
+#ifdef TEST_MPI
+    auto ctx = make_context(resources, MPI_COMM_WORLD);
+#else
+    auto ctx = make_context(resources);
+#endif
+
+    const unsigned N = arb::num_ranks(ctx);
+    const unsigned I = arb::rank(ctx);
+
+    // One heavy cell of cost 9 and nine cells of cost 1 per domain, with all
+    // the heavy cells first: each domain should be given cells of a total
+    // cost of 18, to within the cost of a heavy cell, in contiguous ranges.
+    costed_recipe rec(10*N, N);
+    const auto D = partition_load_balance(rec, ctx);
+
+    std::vector<cell_gid_type> local_gids;
+    double local_cost = 0;
+    for (auto& g: D.groups) {
+        for (auto gid: g.gids) {
+            local_gids.push_back(gid);
+            local_cost += *rec.cell_cost(gid);
+        }
+    }
+    std::sort(local_gids.begin(), local_gids.end());
+
+    EXPECT_NEAR(18., local_cost, 9.);
+    EXPECT_EQ(D.num_local_cells, local_gids.size());
+    for (auto i: util::count_along(local_gids)) {
+        if (i) {
+            EXPECT_EQ(local_gids[i-1]+1, local_gids[i]);
+        }
+        EXPECT_EQ(I, (unsigned)D.gid_domain(local_gids[i]));
+    }
+}
+
+TEST(domain_decomposition, connectivity_partition) {
+    proc_allocation resources{1, -1};
+#ifdef TEST_MPI
+    auto ctx = make_context(resources, MPI_COMM_WORLD);
+#else
+    auto ctx = make_context(resources);
+#endif
+
+    const unsigned N = arb::num_ranks(ctx);
+    const unsigned I = arb::rank(ctx);
+
+    // One cluster per domain: each domain should be given all the cells of
+    // one cluster, although their gids are not contiguous.
+    interleaved_clusters rec(N, 10);
+    const auto D = partition_load_balance(rec, ctx, {}, domain_partition_kind::connectivity);
+
+    std::vector<cell_gid_type> local_gids;
+    for (auto& g: D.groups) {
+        for (auto gid: g.gids) local_gids.push_back(gid);
+    }
+    std::sort(local_gids.begin(), local_gids.end());
+
+    ASSERT_EQ(10u, local_gids.size());
+    EXPECT_EQ(D.num_local_cells, local_gids.size());
+    for (auto gid: local_gids) {
+        EXPECT_EQ(local_gids.front()%N, gid%N);
+        EXPECT_EQ(I, (unsigned)D.gid_domain(gid));
+    }
+
+    // Cells connected by gap junctions are kept on the same domain.
+    gj_symmetric gj_rec(N);
+    const auto E = partition_load_balance(gj_rec, ctx, {}, domain_partition_kind::connectivity);
+    for (auto gid: util::make_span(gj_rec.num_cells())) {
+        for (const auto& c: gj_rec.gap_junctions_on(gid)) {
+            EXPECT_EQ(E.gid_domain(gid), E.gid_domain(c.peer.gid));
+        }
+    }
+}
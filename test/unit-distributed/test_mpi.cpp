@@ -94,6 +94,37 @@ TEST(mpi, gather_all_with_partition) {
     EXPECT_EQ(expected_divisions, gathered.partition());
 }
 
+TEST(mpi, slot_gather) {
+    int id = mpi::rank(MPI_COMM_WORLD);
+    int size = mpi::size(MPI_COMM_WORLD);
+
+    // Rank i contributes n*i bytes: with n = 3000, all but the first two
+    // ranks overflow the initial slot, and take a second round.
+    mpi::slot_gather_request::slot_state slot;
+    for (std::size_t n: {10, 3000, 100, 0}) {
+        auto bytes = [n](int rank) {
+            std::vector<char> v(n*rank);
+            for (std::size_t j = 0; j<v.size(); ++j) v[j] = char(j+rank);
+            return v;
+        };
+
+        std::vector<char> expected_values;
+        std::vector<unsigned> expected_divisions = {0};
+        for (int i = 0; i<size; ++i) {
+            util::append(expected_values, bytes(i));
+            expected_divisions.push_back(expected_values.size());
+        }
+
+        auto gathered = mpi::slot_gather_request(bytes(id), slot, MPI_COMM_WORLD).wait();
+        EXPECT_EQ(expected_values, gathered.values());
+        EXPECT_EQ(expected_divisions, gathered.partition());
+    }
+    // The slot has grown to fit the largest contribution.
+    if (size>1) {
+        EXPECT_LE(3000u*(size-1), slot.bytes);
+    }
+}
+
 TEST(mpi, gather_string) {
     int id = mpi::rank(MPI_COMM_WORLD);
     int size = mpi::size(MPI_COMM_WORLD);
@@ -0,0 +1,77 @@
+#include "../gtest.h"
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <arbor/context.hpp>
+#include <arbor/domain_decomposition.hpp>
+#include <arbor/load_balance.hpp>
+#include <arbor/sampling.hpp>
+#include <arbor/schedule.hpp>
+#include <arbor/simulation.hpp>
+#include <arbor/util/any_cast.hpp>
+
+#include "execution_context.hpp"
+#include "util/span.hpp"
+
+#include "../simple_recipes.hpp"
+#include "test.hpp"
+
+using namespace arb;
+
+namespace {
+    // Run a chain of cells joined by gap junctions, and record the voltages
+    // of the local probes every 0.1 ms.
+    std::map<cell_member_type, std::vector<double>> run_gap_junction_chain(
+        const context& ctx, unsigned n, double gj_interval, domain_decomposition& decomp)
+    {
+        gap_junction_chain_recipe rec(n, gj_interval);
+        decomp = partition_load_balance(rec, ctx);
+        simulation sim(rec, decomp, ctx);
+
+        std::map<cell_member_type, std::vector<double>> traces;
+        std::mutex mex;
+        sim.add_sampler(all_probes, regular_schedule(0.1),
+            [&](probe_metadata pm, std::size_t n_rec, const sample_record* recs) {
+                std::lock_guard<std::mutex> lock(mex);
+                for (std::size_t i = 0; i<n_rec; ++i) {
+                    traces[pm.id].push_back(*util::any_cast<const double*>(recs[i].data));
+                }
+            });
+        sim.run(10, 0.025);
+        return traces;
+    }
+}
+
+// Cells joined by gap junctions across ranks, whose peer voltages are
+// exchanged every step, follow the same voltages as the cells joined within
+// one cell group on one rank. Each cell reads the voltages of two different
+// sites of two different cells, so a peer voltage taken from the wrong slot
+// changes the result.
+TEST(simulation, exchanged_gap_junctions) {
+    const auto n_domain = g_context->distributed->size();
+    const unsigned n = 2*n_domain;
+
+    domain_decomposition decomp;
+    auto expected = run_gap_junction_chain(make_context(), n, 0, decomp);
+    ASSERT_EQ(1u, decomp.groups.size());
+
+    auto traces = run_gap_junction_chain(g_context, n, 0.025, decomp);
+    EXPECT_EQ(n_domain, decomp.num_domains);
+    EXPECT_EQ(2u, decomp.num_local_cells);
+    EXPECT_EQ(2u, decomp.groups.size());
+
+    // Every local probe is sampled, and no other.
+    ASSERT_EQ(2*decomp.num_local_cells, traces.size());
+    for (auto& [id, v]: traces) {
+        SCOPED_TRACE(id);
+        EXPECT_EQ(decomp.domain_id, decomp.gid_domain(id.gid));
+
+        const auto& e = expected.at(id);
+        ASSERT_EQ(e.size(), v.size());
+        for (auto i: util::count_along(v)) {
+            EXPECT_NEAR(e[i], v[i], 1e-9);
+        }
+    }
+}
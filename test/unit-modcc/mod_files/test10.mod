@@ -0,0 +1,49 @@
+NEURON {
+    SUFFIX hh_gate
+    NONSPECIFIC_CURRENT i
+    RANGE gbar
+}
+
+UNITS {
+    (mV) = (millivolt)
+    (S) = (siemens)
+}
+
+PARAMETER {
+    gbar = 0.1 (S/cm2)
+}
+
+STATE { m }
+
+ASSIGNED {
+    v (mV)
+    celsius (degC)
+}
+
+INITIAL {
+    LOCAL alpha, beta
+    alpha = m_alpha(v)
+    beta = m_beta(v)
+    m = alpha/(alpha + beta)
+}
+
+BREAKPOINT {
+    SOLVE states METHOD cnexp
+    i = gbar*m*(v + 80)
+}
+
+DERIVATIVE states {
+    LOCAL qt, alpha, beta
+    qt = 3^((celsius - 6.3)/10)
+    alpha = m_alpha(v)
+    beta = m_beta(v)
+    m' = qt*(alpha - m*(alpha + beta))
+}
+
+FUNCTION m_alpha(v) {
+    m_alpha = 0.1*exprelr(-(v + 40)/10)
+}
+
+FUNCTION m_beta(v) {
+    m_beta = 4*exp(-(v + 65)/18)
+}
@@ -0,0 +1,34 @@
+: Ornstein-Uhlenbeck conductance driven by white noise.
+
+NEURON {
+    POINT_PROCESS ou_syn
+    RANGE tau, sigma, e
+    NONSPECIFIC_CURRENT i
+}
+
+PARAMETER {
+    tau = 10 (ms)
+    sigma = 0.1
+    e = 0 (mV)
+}
+
+STATE {
+    g
+}
+
+WHITE_NOISE {
+    W
+}
+
+INITIAL {
+    g = 0
+}
+
+BREAKPOINT {
+    SOLVE state METHOD stochastic
+    i = g*(v - e)
+}
+
+DERIVATIVE state {
+    g' = -g/tau + sigma*W
+}
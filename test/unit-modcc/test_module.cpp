@@ -1,6 +1,8 @@
 #include "common.hpp"
 #include "io/bulkio.hpp"
 #include "module.hpp"
+#include "perfvisitor.hpp"
+#include <cstring>
 #include <unordered_map>
 
 TEST(Module, open) {
@@ -113,3 +115,161 @@ TEST(Module, breakpoint) {
 
     EXPECT_TRUE(m.semantic());
 }
+
+TEST(Module, quiescent) {
+    {
+        Module m(io::read_all(DATADIR "/mod_files/test9.mod"), "test9.mod");
+        EXPECT_NE(m.buffer().size(), 0);
+
+        Parser p(m, false);
+        EXPECT_TRUE(p.parse());
+        EXPECT_TRUE(m.semantic());
+
+        EXPECT_TRUE(m.neuron_block().has_quiescent_state());
+        EXPECT_EQ("g", m.neuron_block().quiescent_state.spelling);
+        EXPECT_EQ("1e-6", m.neuron_block().quiescent_threshold);
+    }
+    {
+        // The QUIESCENT variable must be a STATE variable ...
+        const char* text =
+            "NEURON { POINT_PROCESS foo QUIESCENT tau < 1e-6 }\n"
+            "PARAMETER { tau = 2 }\n"
+            "STATE { g }\n"
+            "BREAKPOINT {\n"
+            "    SOLVE dg METHOD cnexp\n"
+            "}\n"
+            "DERIVATIVE dg { g' = -g/tau }\n";
+        Module m(text, text + std::strlen(text), "");
+        Parser p(m, false);
+        EXPECT_TRUE(p.parse());
+        EXPECT_FALSE(m.semantic());
+    }
+    {
+        // ... of a point process.
+        const char* text =
+            "NEURON { SUFFIX foo QUIESCENT g < 1e-6 }\n"
+            "PARAMETER { tau = 2 }\n"
+            "STATE { g }\n"
+            "BREAKPOINT {\n"
+            "    SOLVE dg METHOD cnexp\n"
+            "}\n"
+            "DERIVATIVE dg { g' = -g/tau }\n";
+        Module m(text, text + std::strlen(text), "");
+        Parser p(m, false);
+        EXPECT_TRUE(p.parse());
+        EXPECT_FALSE(m.semantic());
+    }
+}
+
+TEST(Module, common_subexpressions) {
+    const char* text =
+        "NEURON { SUFFIX foo }\n"
+        "PARAMETER { k = 10 }\n"
+        "STATE { m h }\n"
+        "BREAKPOINT {\n"
+        "    SOLVE states METHOD cnexp\n"
+        "}\n"
+        "DERIVATIVE states {\n"
+        "    m' = (exp(-(v+65)/k) - m)/k\n"
+        "    h' = (2*exp(-(v+65)/k) - h)/k^2\n"
+        "}\n";
+    Module m(text, text + std::strlen(text), "");
+    Parser p(m, false);
+    EXPECT_TRUE(p.parse());
+    EXPECT_TRUE(m.semantic());
+
+    auto method = m.symbols().at("advance_state")->is_api_method();
+    ASSERT_TRUE(method);
+
+    // The rate exponential is evaluated once for both states, and the square
+    // of the parameter is expanded as a product.
+    FlopVisitor flops;
+    method->accept(&flops);
+    EXPECT_EQ(1, flops.flops.exp);
+    EXPECT_EQ(0, flops.flops.pow);
+}
+
+TEST(Module, additive_events) {
+    auto additive = [](const char* net_receive) {
+        std::string text =
+            "NEURON { POINT_PROCESS foo }\n"
+            "PARAMETER { tau = 2 a = 3 }\n"
+            "STATE { g h }\n"
+            "BREAKPOINT {\n"
+            "    SOLVE dg METHOD cnexp\n"
+            "}\n"
+            "DERIVATIVE dg { g' = -g/tau h' = -h/tau }\n"
+            "NET_RECEIVE(weight) {\n";
+        text += net_receive;
+        text += "}\n";
+
+        Module m(text.c_str(), text.c_str() + text.size(), "");
+        Parser p(m, false);
+        EXPECT_TRUE(p.parse());
+        EXPECT_TRUE(m.semantic());
+        return m.has_additive_events();
+    };
+
+    EXPECT_TRUE(additive("g = g + weight\n"));
+    EXPECT_TRUE(additive("g = a*weight + g\n h = h + 2*weight/tau\n"));
+
+    EXPECT_FALSE(additive("g = weight\n"));
+    EXPECT_FALSE(additive("g = g + weight + 1\n"));
+    EXPECT_FALSE(additive("g = g + weight*weight\n"));
+    EXPECT_FALSE(additive("g = g + weight\n h = h + g*weight\n"));
+    EXPECT_FALSE(additive("if (weight>0) { g = g + weight }\n"));
+}
+
+TEST(Module, white_noise) {
+    {
+        Module m(io::read_all(DATADIR "/mod_files/test11.mod"), "test11.mod");
+        EXPECT_NE(m.buffer().size(), 0);
+
+        Parser p(m, false);
+        EXPECT_TRUE(p.parse());
+        EXPECT_TRUE(m.semantic());
+        EXPECT_FALSE(m.is_linear());
+
+        auto w = m.symbols().find("W");
+        ASSERT_NE(m.symbols().end(), w);
+        ASSERT_TRUE(w->second->is_variable());
+        EXPECT_TRUE(w->second->is_variable()->is_white_noise());
+
+        // The increment is scaled by dt^0.5, computed once.
+        auto advance = m.symbols().find("advance_state");
+        ASSERT_NE(m.symbols().end(), advance);
+        FlopVisitor flops;
+        advance->second->accept(&flops);
+        EXPECT_EQ(1, flops.flops.pow);
+    }
+
+    auto check = [](const char* derivative, const char* extra = "") {
+        std::string text =
+            "NEURON { POINT_PROCESS foo }\n"
+            "PARAMETER { tau = 2 sigma = 0.1 }\n"
+            "STATE { g }\n"
+            "WHITE_NOISE { W Z }\n"
+            "BREAKPOINT {\n"
+            "    SOLVE dg METHOD stochastic\n"
+            "}\n"
+            "DERIVATIVE dg {\n";
+        text += derivative;
+        text += "}\n";
+        text += extra;
+
+        Module m(text.c_str(), text.c_str() + text.size(), "");
+        Parser p(m, false);
+        return p.parse() && m.semantic();
+    };
+
+    EXPECT_TRUE(check("g' = -g/tau + sigma*W\n"));
+    EXPECT_TRUE(check("g' = -g/tau + sigma*g*W - Z/tau\n"));
+    EXPECT_TRUE(check("g' = -g/tau\n"));
+
+    // The noise must enter linearly, ...
+    EXPECT_FALSE(check("g' = -g/tau + sigma*W*W\n"));
+    EXPECT_FALSE(check("g' = -g/tau + exp(W)\n"));
+
+    // ... and may not be written.
+    EXPECT_FALSE(check("g' = -g/tau\n", "NET_RECEIVE(weight) { W = weight }\n"));
+}
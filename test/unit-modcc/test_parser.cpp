@@ -261,6 +261,22 @@ TEST(Parser, parse_solve) {
         EXPECT_EQ(s->method(), solverMethod::none);
         EXPECT_EQ(s->name(), "states");
     }
+
+    EXPECT_TRUE(check_parse(s, &Parser::parse_solve, "SOLVE states METHOD sdirk2"));
+    if (s) {
+        EXPECT_EQ(s->method(), solverMethod::sdirk2);
+        EXPECT_EQ(s->name(), "states");
+    }
+
+    EXPECT_FALSE(check_parse(s, &Parser::parse_solve, "SOLVE states STEADYSTATE sdirk2"));
+
+    EXPECT_TRUE(check_parse(s, &Parser::parse_solve, "SOLVE states METHOD expm"));
+    if (s) {
+        EXPECT_EQ(s->method(), solverMethod::expm);
+        EXPECT_EQ(s->name(), "states");
+    }
+
+    EXPECT_FALSE(check_parse(s, &Parser::parse_solve, "SOLVE states STEADYSTATE expm"));
 }
 
 TEST(Parser, parse_conductance) {
@@ -9,6 +9,7 @@
 #include "printer/cexpr_emit.hpp"
 #include "printer/cprinter.hpp"
 #include "printer/gpuprinter.hpp"
+#include "printer/infoprinter.hpp"
 #include "expression.hpp"
 #include "symdiff.hpp"
 
@@ -331,3 +332,272 @@ TEST(SimdPrinter, simd_if_else) {
 
     }
 }
+
+TEST(CPrinter, quiescent) {
+    // The scalar state and current kernels of a mechanism with a QUIESCENT
+    // state run over the active index, which events and state updates maintain.
+    Module m(io::read_all(DATADIR "/mod_files/test9.mod"), "test9.mod");
+    Parser p(m, false);
+    ASSERT_TRUE(p.parse());
+    ASSERT_TRUE(m.semantic());
+
+    printer_options opt;
+    auto text = emit_cpp_source(m, opt);
+    verbose_print(text);
+
+    // Only look at the generic kernels, not at those for uniform parameters.
+    text = text.substr(0, text.find("namespace uniform_parameters"));
+
+    auto count = [&text](const std::string& s) {
+        std::size_t n = 0;
+        for (auto pos = text.find(s); pos!=std::string::npos; pos = text.find(s, pos+1)) ++n;
+        return n;
+    };
+
+    // compute_currents and advance_state, each for contiguous and gathered
+    // indices, and the compaction that follows.
+    EXPECT_EQ(5u, count("for (arb_size_type k_ = 0; k_ < pp->n_active; ++k_)"));
+    EXPECT_EQ(1u, count("if (abs(q_[i_]) < 1e-6) pp->active_flag[i_] = 0;"));
+    EXPECT_EQ(1u, count("pp->active_index[pp->n_active++] = i_;"));
+    EXPECT_EQ(1u, count("pp->n_active = pp->width;"));
+
+    // Without a QUIESCENT state nothing changes.
+    Module m6(io::read_all(DATADIR "/mod_files/test6.mod"), "test6.mod");
+    Parser p6(m6, false);
+    ASSERT_TRUE(p6.parse());
+    ASSERT_TRUE(m6.semantic());
+    EXPECT_EQ(std::string::npos, emit_cpp_source(m6, opt).find("active_index"));
+}
+
+TEST(CPrinter, contiguous_index) {
+    // Scalar kernels compute indices from the first entry if the engine
+    // flags the index maps as contiguous, and gather them otherwise.
+    Module m(io::read_all(DATADIR "/mod_files/test8.mod"), "test8.mod");
+    Parser p(m, false);
+    ASSERT_TRUE(p.parse());
+    ASSERT_TRUE(m.semantic());
+
+    printer_options opt;
+    auto text = emit_cpp_source(m, opt);
+    verbose_print(text);
+
+    EXPECT_NE(std::string::npos, text.find("if (pp->index_contiguous) {"));
+    EXPECT_NE(std::string::npos, text.find("const arb_index_type node_index0_ = _pp_var_node_index[0];"));
+    EXPECT_NE(std::string::npos, text.find("auto node_indexi_ = node_index0_ + i_;"));
+    EXPECT_NE(std::string::npos, text.find("auto node_indexi_ = _pp_var_node_index[i_];"));
+
+    // SIMD kernels rely on the index constraints instead.
+    opt.simd = simd_spec(simd_spec::avx2);
+    EXPECT_EQ(std::string::npos, emit_cpp_source(m, opt).find("index_contiguous"));
+}
+
+TEST(CPrinter, bundle) {
+    // One loop over the shared CVs reads the voltage and accumulates current
+    // and conductivity once, calling each member's per-instance kernel.
+    Module m7(io::read_all(DATADIR "/mod_files/test7.mod"), "test7.mod");
+    Parser p7(m7, false);
+    ASSERT_TRUE(p7.parse());
+    ASSERT_TRUE(m7.semantic());
+
+    Module m2(io::read_all(DATADIR "/mod_files/test2.mod"), "test2.mod");
+    Parser p2(m2, false);
+    ASSERT_TRUE(p2.parse());
+    ASSERT_TRUE(m2.semantic());
+
+    printer_options opt;
+    auto text = emit_cpp_bundle_source("both", {&m7, &m2}, opt);
+    verbose_print(text);
+
+    auto count = [&text](const std::string& s) {
+        std::size_t n = 0;
+        for (auto pos = text.find(s); pos!=std::string::npos; pos = text.find(s, pos+1)) ++n;
+        return n;
+    };
+
+    EXPECT_EQ(1u, count("for (arb_size_type i_ = 0; i_ < width; ++i_)"));
+    EXPECT_EQ(1u, count("arb_value_type vm_ = vec_v[node_indexi_];"));
+    EXPECT_EQ(1u, count("vec_i[node_indexi_] += i_acc_;"));
+    EXPECT_EQ(1u, count("::compute_currents(pp[0], i_, node_indexi_, vm_, i_acc_, g_acc_);"));
+    EXPECT_EQ(1u, count("::compute_currents(pp[1], i_, node_indexi_, vm_, i_acc_, g_acc_);"));
+    EXPECT_EQ(0u, count("_pp_var_vec_i["));
+    EXPECT_NE(std::string::npos, text.find("make__both_bundle_interface_multicore()"));
+
+    // Members are density mechanisms.
+    Module m9(io::read_all(DATADIR "/mod_files/test9.mod"), "test9.mod");
+    Parser p9(m9, false);
+    ASSERT_TRUE(p9.parse());
+    ASSERT_TRUE(m9.semantic());
+    EXPECT_THROW(emit_cpp_bundle_source("both", {&m7, &m9}, opt), compiler_exception);
+
+    // Bundles are scalar code.
+    opt.simd = simd_spec(simd_spec::native);
+    EXPECT_THROW(emit_cpp_bundle_source("both", {&m7, &m2}, opt), compiler_exception);
+}
+
+TEST(CPrinter, rate_table) {
+    // Rates depending only on the voltage are interpolated from a table; the
+    // temperature dependent factor is still evaluated exactly.
+    Module m(io::read_all(DATADIR "/mod_files/test10.mod"), "test10.mod");
+    Parser p(m, false);
+    ASSERT_TRUE(p.parse());
+    ASSERT_TRUE(m.semantic());
+
+    printer_options opt;
+    EXPECT_EQ(std::string::npos, emit_cpp_source(m, opt).find("rate_table"));
+
+    opt.table_tolerance = 1e-6;
+    auto text = emit_cpp_source(m, opt);
+    verbose_print(text);
+
+    EXPECT_NE(std::string::npos, text.find("#include <arbor/rate_table.hpp>"));
+    EXPECT_NE(std::string::npos, text.find("static const ::arb::rate_table& rate_table_init()"));
+    EXPECT_NE(std::string::npos, text.find("static const ::arb::rate_table& rate_table_advance_state()"));
+    EXPECT_EQ(std::string::npos, text.find("rate_table_compute_currents"));
+    EXPECT_NE(std::string::npos, text.find("const auto& rate_table_ = rate_table_advance_state();"));
+
+    // Tables are scalar code.
+    opt.simd = simd_spec(simd_spec::native);
+    EXPECT_EQ(std::string::npos, emit_cpp_source(m, opt).find("rate_table"));
+}
+
+TEST(CPrinter, uniform_parameters) {
+    // A second set of scalar kernels binds the parameters to the value of the
+    // first instance.
+    Module m(io::read_all(DATADIR "/mod_files/test10.mod"), "test10.mod");
+    Parser p(m, false);
+    ASSERT_TRUE(p.parse());
+    ASSERT_TRUE(m.semantic());
+
+    printer_options opt;
+    auto text = emit_cpp_source(m, opt);
+    verbose_print(text);
+
+    EXPECT_NE(std::string::npos, text.find("namespace uniform_parameters {"));
+    EXPECT_NE(std::string::npos, text.find("const uniform_parameter_ _pp_var_gbar{pp->width? pp->parameters[0][0]: 0};"));
+    EXPECT_NE(std::string::npos, text.find("result.uniform_parameters=&uniform;"));
+
+    // Not for SIMD kernels.
+    opt.simd = simd_spec(simd_spec::native);
+    EXPECT_EQ(std::string::npos, emit_cpp_source(m, opt).find("uniform_parameters"));
+}
+
+TEST(CPrinter, single_precision) {
+    Module m(io::read_all(DATADIR "/mod_files/test6.mod"), "test6.mod");
+    Parser p(m, false);
+    ASSERT_TRUE(p.parse());
+    ASSERT_TRUE(m.semantic());
+
+    printer_options opt;
+    EXPECT_EQ(std::string::npos, emit_cpp_source(m, opt).find("float"));
+
+    opt.cpu_single_precision = true;
+    auto text = emit_cpp_source(m, opt);
+    verbose_print(text);
+
+    // Procedure arguments and literals are float, and mixed precision
+    // arguments of min and max are compared in double.
+    EXPECT_NE(std::string::npos, text.find("int i_, float x)"));
+    EXPECT_NE(std::string::npos, text.find("2.0f"));
+    EXPECT_NE(std::string::npos, text.find("inline arb_value_type max(float a, arb_value_type b)"));
+
+    // Not for SIMD kernels.
+    Module m10(io::read_all(DATADIR "/mod_files/test10.mod"), "test10.mod");
+    Parser p10(m10, false);
+    ASSERT_TRUE(p10.parse());
+    ASSERT_TRUE(m10.semantic());
+    ASSERT_NE(std::string::npos, emit_cpp_source(m10, opt).find("float"));
+    opt.simd = simd_spec(simd_spec::native);
+    EXPECT_EQ(std::string::npos, emit_cpp_source(m10, opt).find("float"));
+}
+
+TEST(InfoPrinter, fingerprint) {
+    // The fingerprint is a hash of the source: the same for identical sources
+    // only.
+    auto fingerprint = [](const std::string& file) {
+        Module m(io::read_all(DATADIR "/mod_files/" + file), file);
+        Parser p(m, false);
+        EXPECT_TRUE(p.parse());
+        EXPECT_TRUE(m.semantic());
+
+        std::smatch match;
+        auto text = build_info_header(m, printer_options{}, true);
+        EXPECT_TRUE(std::regex_search(text, match, std::regex{"result.fingerprint=\"([0-9a-f]{16})\";"}));
+        return match.str(1);
+    };
+
+    EXPECT_EQ(fingerprint("test6.mod"), fingerprint("test6.mod"));
+    EXPECT_NE(fingerprint("test6.mod"), fingerprint("test9.mod"));
+}
+
+TEST(GpuPrinter, single_precision) {
+    // Locals and literals are float; state is read and written as
+    // arb_value_type.
+    const char* source =
+        "PROCEDURE trates(v) {\n"
+        "    LOCAL k\n"
+        "    k = 2*v\n"
+        "    hinf = 1/(1+exp(k))\n"
+        "}";
+    const char* expected =
+        "float k;\n"
+        "k = 2.0f*v;\n"
+        "_pp_var_hinf[tid_] = 1.0f/(1.0f+exp(k));\n";
+
+    Scope<Symbol>::symbol_map globals;
+    globals["hinf"] = make_symbol<VariableExpression>(Location(), "hinf");
+    globals["v"]    = make_symbol<VariableExpression>(Location(), "v");
+
+    expression_ptr e = parse_procedure(source);
+    ASSERT_TRUE(e->is_symbol());
+    auto procname = e->is_symbol()->name();
+    auto& proc = (globals[procname] = symbol_ptr(e.release()->is_symbol()));
+    proc->semantic(globals);
+
+    std::stringstream out;
+    auto v = std::make_unique<GpuPrinter>(out, true);
+    proc->is_procedure()->body()->accept(v.get());
+    EXPECT_EQ(strip(expected), strip(out.str()));
+
+    // In the generated kernels, procedure arguments are float too.
+    Module m(io::read_all(DATADIR "/mod_files/test6.mod"), "test6.mod");
+    Parser p(m, false);
+    ASSERT_TRUE(p.parse());
+    ASSERT_TRUE(m.semantic());
+
+    printer_options opt;
+    EXPECT_EQ(std::string::npos, emit_gpu_cu_source(m, opt).find("float"));
+    opt.gpu_single_precision = true;
+    auto text = emit_gpu_cu_source(m, opt);
+    verbose_print(text);
+    EXPECT_NE(std::string::npos, text.find("int tid_, float x)"));
+}
+
+TEST(GpuPrinter, kernels) {
+    Module m(io::read_all(DATADIR "/mod_files/test8.mod"), "test8.mod");
+    Parser p(m, false);
+    ASSERT_TRUE(p.parse());
+    ASSERT_TRUE(m.semantic());
+
+    printer_options opt;
+    opt.gpu_max_block_size = 512;
+    auto text = emit_gpu_cu_source(m, opt);
+    verbose_print(text);
+
+    // Kernels are bounded by the largest block size, and launched with the
+    // block size of largest occupancy.
+    EXPECT_NE(std::string::npos, text.find("constexpr unsigned max_block_dim_ = 512;"));
+    EXPECT_NE(std::string::npos, text.find("__global__ __launch_bounds__(max_block_dim_)\nvoid compute_currents("));
+    EXPECT_NE(std::string::npos, text.find("::arb::gpu::max_block_size(compute_currents, max_block_dim_)"));
+    EXPECT_NE(std::string::npos, text.find("apply_events<<<grid_dim, block_dim, 0, arb::gpu::current_stream()>>>(*p, *events);"));
+
+    // Indices, voltage and parameters are read-only.
+    EXPECT_NE(std::string::npos, text.find("auto node_indexi_ = ::arb::gpu::ldg(_pp_var_node_index+tid_);"));
+    EXPECT_NE(std::string::npos, text.find("::arb::gpu::ldg(&_pp_var_vec_v[node_indexi_])"));
+    EXPECT_NE(std::string::npos, text.find("const arb_value_type* __restrict__ _pp_var_tau "));
+
+    // Current and conductance are reduced over one key set.
+    auto key_set = std::regex{"key_set_pos node_indexrun_\\(node_indexi_, lane_mask_\\)"};
+    EXPECT_EQ(1, std::distance(std::sregex_iterator(text.begin(), text.end(), key_set), std::sregex_iterator()));
+    EXPECT_NE(std::string::npos, text.find("_pp_var_vec_i, node_indexi_, node_indexrun_);"));
+    EXPECT_NE(std::string::npos, text.find("_pp_var_vec_g, node_indexi_, node_indexrun_);"));
+}
@@ -176,3 +176,77 @@ TEST(symge, gj_reduce_3x3) {
     EXPECT_NEAR(y, 7.0/4.0, 1e-6);
     EXPECT_NEAR(z, 39.0/20.0, 1e-6);
 }
+
+TEST(symge, markowitz_reduce_3x3) {
+    // solve the system of gj_reduce_3x3 by elimination and back
+    // substitution, with expected answer:
+    //
+    // x = 3/40; y = 7/4; z = 39/20
+
+    symbol_table tbl;
+    auto a = tbl.define("a");
+    auto b = tbl.define("b");
+    auto c = tbl.define("c");
+    auto d = tbl.define("d");
+    auto e = tbl.define("e");
+    auto p = tbl.define("p");
+    auto q = tbl.define("q");
+    auto r = tbl.define("r");
+
+    sym_matrix A(3,3);
+    A[0] = sym_row({{0, a}, {2, b}});
+    A[1] = sym_row({{1, c}});
+    A[2] = sym_row({{1, d}, {2, e}});
+
+    std::vector<symbol> B = { p, q, r };
+    A.augment(B);
+
+    std::vector<pivot> pivots;
+    markowitz_reduce(A, tbl, pivots);
+
+    ASSERT_EQ(3u, pivots.size());
+    std::vector<bool> row_seen(3), col_seen(3);
+    for (auto pv: pivots) {
+        ASSERT_LT(pv.row, 3u);
+        ASSERT_LT(pv.col, 3u);
+        EXPECT_FALSE(row_seen[pv.row]);
+        EXPECT_FALSE(col_seen[pv.col]);
+        row_seen[pv.row] = col_seen[pv.col] = true;
+    }
+
+    value_store v;
+    v[a] = 2;
+    v[b] = 3;
+    v[c] = 4;
+    v[d] = -1;
+    v[e] = 5;
+    v[p] = 6;
+    v[q] = 7;
+    v[r] = 8;
+
+    for (unsigned i = 0; i<tbl.size(); ++i) {
+        symbol s = tbl[i];
+        if (!primitive(s)) {
+            v.assign(s, v.eval(definition(s)));
+        }
+    }
+
+    // Each pivot row may only refer to the columns of later pivots.
+    double xs[3];
+    for (auto k = pivots.size(); k-->0; ) {
+        const sym_row& row = A[pivots[k].row];
+        double x = v.eval(row[3]);
+        for (const auto& entry: row) {
+            if (entry.col==pivots[k].col || entry.col>=3) continue;
+            for (auto j = 0u; j<=k; ++j) {
+                EXPECT_NE(entry.col, pivots[j].col);
+            }
+            x -= v.eval(entry.value)*xs[entry.col];
+        }
+        xs[pivots[k].col] = x/v.eval(row[pivots[k].col]);
+    }
+
+    EXPECT_NEAR(xs[0], 3.0/40.0, 1e-6);
+    EXPECT_NEAR(xs[1], 7.0/4.0, 1e-6);
+    EXPECT_NEAR(xs[2], 39.0/20.0, 1e-6);
+}
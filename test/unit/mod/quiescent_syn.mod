@@ -0,0 +1,34 @@
+: Exponential synapse that is quiescent once its conductance has decayed.
+
+NEURON {
+    POINT_PROCESS quiescent_syn
+    RANGE tau, e
+    NONSPECIFIC_CURRENT i
+    QUIESCENT g < 1e-6
+}
+
+PARAMETER {
+    tau = 2.0 (ms)
+    e = 0   (mV)
+}
+
+STATE {
+    g
+}
+
+INITIAL {
+    g=0
+}
+
+BREAKPOINT {
+    SOLVE state METHOD cnexp
+    i = g*(v - e)
+}
+
+DERIVATIVE state {
+    g' = -g/tau
+}
+
+NET_RECEIVE(weight) {
+    g = g + weight
+}
@@ -42,9 +42,10 @@ TEST(abi, multicore_initialisation) {
     std::vector<arb_value_type> diam(ncv, 1.);
     std::vector<arb_value_type> vinit(ncv, -65);
     std::vector<arb::fvm_gap_junction> gj = {};
+    std::vector<arb_index_type> detector_divs = {};
     std::vector<arb_index_type> src_to_spike = {};
 
-    arb::multicore::shared_state shared_state(ncell, ncell, 0,
+    arb::multicore::shared_state shared_state(ncell, ncell, detector_divs,
                                               cv_to_intdom, cv_to_intdom,
                                               gj, vinit, temp, diam, src_to_spike,
                                               mech.data_alignment());
@@ -90,6 +91,69 @@ TEST(abi, multicore_initialisation) {
 }
 
 
+TEST(abi, multicore_field_stagger) {
+    std::vector<arb_field_info> globals = {{ "G0", "kg",  123.0,     0.0, 2000.0}};
+    std::vector<arb_field_info> states  = {{ "S0", "nA",      0.123, 0.0, 2000.0},
+                                           { "S1", "mV",      0.456, 0.0, 2000.0}};
+    std::vector<arb_field_info> params  = {{ "P0", "lm", -123.0,     0.0, 2000.0}};
+
+    arb_mechanism_type type{};
+    type.globals    = globals.data(); type.n_globals    = globals.size();
+    type.parameters = params.data();  type.n_parameters = params.size();
+    type.state_vars = states.data();  type.n_state_vars = states.size();
+
+    arb_mechanism_interface iface { arb_backend_kind_cpu,
+                                    1,
+                                    1,
+                                    nullptr,
+                                    nullptr,
+                                    nullptr,
+                                    nullptr,
+                                    nullptr,
+                                    nullptr };
+
+    auto mech = arb::mechanism(type, iface);
+
+    // With 512 CVs each field spans 4 KiB, and the fields are staggered.
+    arb_size_type ncell = 1;
+    arb_size_type ncv = 512;
+    std::vector<arb_index_type> cv_to_intdom(ncv, 0);
+    std::vector<arb_value_type> temp(ncv, 23);
+    std::vector<arb_value_type> diam(ncv, 1.);
+    std::vector<arb_value_type> vinit(ncv, -65);
+    std::vector<arb::fvm_gap_junction> gj = {};
+    std::vector<arb_index_type> detector_divs = {};
+    std::vector<arb_index_type> src_to_spike = {};
+
+    arb::multicore::shared_state shared_state(ncell, ncell, detector_divs,
+                                              cv_to_intdom, cv_to_intdom,
+                                              gj, vinit, temp, diam, src_to_spike,
+                                              mech.data_alignment());
+
+    arb::mechanism_layout layout;
+    layout.weight.assign(ncv, 1.);
+    for (arb_size_type i = 0; i<ncv; ++i) layout.cv.push_back(i);
+
+    arb::mechanism_overrides overrides;
+
+    shared_state.instantiate(mech, 42, overrides, layout);
+
+    auto s0 = mech.field_data("S0");
+    auto s1 = mech.field_data("S1");
+    auto p0 = mech.field_data("P0");
+    EXPECT_EQ(0u, (std::size_t)(s1-s0)*sizeof(arb_value_type)%64);
+    EXPECT_NE(0u, (std::size_t)(s1-s0)*sizeof(arb_value_type)%4096);
+    EXPECT_LE(ncv, (arb_size_type)(s0-p0));
+    EXPECT_LE(ncv, (arb_size_type)(s1-s0));
+
+    for (auto cv = 0ul; cv < ncv; ++cv) {
+        EXPECT_EQ(params[0].default_value, p0[cv]);
+        EXPECT_EQ(states[0].default_value, s0[cv]);
+        EXPECT_EQ(states[1].default_value, s1[cv]);
+    }
+    EXPECT_EQ(globals[0].default_value, mech.global_table()[0].second);
+}
+
 #ifdef ARB_GPU_ENABLED
 TEST(abi, gpu_initialisation) {
     std::vector<arb_field_info> globals = {{ "G0", "kg",  123.0,     0.0, 2000.0},
@@ -122,9 +186,10 @@ TEST(abi, gpu_initialisation) {
     std::vector<arb_value_type> diam(ncv, 1.);
     std::vector<arb_value_type> vinit(ncv, -65);
     std::vector<arb::fvm_gap_junction> gj = {};
+    std::vector<arb_index_type> detector_divs = {};
     std::vector<arb_index_type> src_to_spike = {};
 
-    arb::multicore::shared_state shared_state(ncell, ncell, 0,
+    arb::multicore::shared_state shared_state(ncell, ncell, detector_divs,
                                               cv_to_intdom, cv_to_intdom,
                                               gj, vinit, temp, diam, src_to_spike,
                                               mech.data_alignment());
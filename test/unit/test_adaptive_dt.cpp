@@ -0,0 +1,38 @@
+#include "../gtest.h"
+
+#include "backends/adaptive_dt.hpp"
+
+using namespace arb;
+
+TEST(adaptive_dt, curvature) {
+    // Exact for a quadratic, v = 3t², with steps of unequal length.
+    auto v = [](double t) { return 3*t*t; };
+    EXPECT_DOUBLE_EQ(6., adaptive_dt_curvature(v(0), v(0.1), v(0.3), 0.1, 0.2));
+
+    // Zero for a linear voltage, and without a previous step or a step.
+    EXPECT_NEAR(0., adaptive_dt_curvature(-65, -64, -62, 0.1, 0.2), 1e-12);
+    EXPECT_EQ(0., adaptive_dt_curvature(-70, -65, -60, 0, 0.1));
+    EXPECT_EQ(0., adaptive_dt_curvature(-70, -65, -65, 0.1, 0));
+}
+
+TEST(adaptive_dt, level) {
+    const double dt = 0.025, tol = 1e-3;
+
+    // Without a previous step, or for an empty step, the level is kept.
+    EXPECT_EQ(3, adaptive_dt_level(3, 6, 100., 0, 0.2, dt, tol));
+    EXPECT_EQ(3, adaptive_dt_level(3, 6, 100., 0.2, 0, dt, tol));
+
+    // Without error, the level grows by one, up to the maximum.
+    EXPECT_EQ(4, adaptive_dt_level(3, 6, 0., 0.2, 0.2, dt, tol));
+    EXPECT_EQ(6, adaptive_dt_level(6, 6, 0., 1.6, 1.6, dt, tol));
+
+    // A small error also grows the level by one only.
+    EXPECT_EQ(3, adaptive_dt_level(2, 6, 1e-9, 0.1, 0.1, dt, tol));
+
+    // An error at the tolerance after a step of 4·dt gives a step of
+    // 0.9·4·dt, rounded down to 2·dt.
+    EXPECT_EQ(1, adaptive_dt_level(2, 6, 0.2, 0.1, 0.1, dt, tol));
+
+    // A large error drops to the base step.
+    EXPECT_EQ(0, adaptive_dt_level(5, 6, 1e6, 0.8, 0.8, dt, tol));
+}
@@ -1,10 +1,14 @@
+#include <cstdio>
 #include <iostream>
 #include <fstream>
+#include <string>
 
 #include <arbor/cable_cell.hpp>
+#include <arbor/context.hpp>
 #include <arbor/morph/primitives.hpp>
 #include <arbor/morph/segment_tree.hpp>
 
+#include <arborio/morphology_cache.hpp>
 #include <arborio/neurolucida.hpp>
 
 #include "../gtest.h"
@@ -300,3 +304,47 @@ TEST(asc, soma_connection) {
         EXPECT_EQ(m.branch_segments(7)[0].prox, (arb::mpoint{0,-5, 0, 1}));
     }
 }
+
+// Inputs given as a character range need not be null-terminated.
+TEST(asc, character_range) {
+    std::string input = "((CellBody) (0 0 1 2)) (Dendrite";
+    auto n = input.find(" (Dendrite");
+    auto m = arborio::parse_asc_string(input.data(), input.data()+n);
+    EXPECT_EQ(2u, m.morphology.num_branches());
+
+    // A number or symbol at the end of the range.
+    EXPECT_THROW(arborio::parse_asc_string(input.data(), input.data()+16), arborio::asc_parse_error);
+    EXPECT_THROW(arborio::parse_asc_string(input.data(), input.data()+8), arborio::asc_parse_error);
+}
+
+TEST(asc, load_files) {
+    const char* fname = "test_asc_load_files.asc";
+    const char* input =
+        "((CellBody) (0 0 0 4))\n"
+        "((Dendrite) (0 2 0 2) (0 5 0 2) ( (-5 5 0 2) | (6 5 0 2) ) )\n";
+    {
+        std::ofstream out(fname);
+        out << input;
+    }
+    auto expected = arborio::parse_asc_string(input);
+
+    auto m = arborio::load_asc(fname);
+    EXPECT_EQ(expected.morphology.num_branches(), m.morphology.num_branches());
+
+    // Files loaded in parallel, directly or through a cache.
+    auto ctx = arb::make_context(arb::proc_allocation(4, -1));
+    auto loaded = arborio::load_asc({fname, fname, fname}, ctx);
+    ASSERT_EQ(3u, loaded.size());
+    for (const auto& l: loaded) {
+        EXPECT_EQ(expected.morphology.num_branches(), l.morphology.num_branches());
+    }
+
+    arborio::morphology_cache cache;
+    auto cached = cache.load_asc({fname, fname}, ctx);
+    ASSERT_EQ(2u, cached.size());
+    EXPECT_EQ(1u, cache.size());
+    EXPECT_EQ(&cached[0].morphology.embedding(), &cached[1].morphology.embedding());
+
+    EXPECT_THROW(arborio::load_asc({fname, "this-file-does-not-exist.asc"}, ctx), arb::file_not_found_error);
+    std::remove(fname);
+}
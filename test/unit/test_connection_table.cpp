@@ -0,0 +1,67 @@
+#include "../gtest.h"
+
+#include <vector>
+
+#include "connection.hpp"
+
+using namespace arb;
+
+TEST(connection_values, compress) {
+    connection_values v;
+    std::vector<float> expected;
+    for (unsigned i = 0; i<1000; ++i) {
+        float x = 0.25f*(i%3);
+        v.push_back(x);
+        expected.push_back(x);
+    }
+
+    v.compress();
+    EXPECT_TRUE(v.compressed());
+    ASSERT_EQ(expected.size(), v.size());
+    for (unsigned i = 0; i<expected.size(); ++i) {
+        EXPECT_EQ(expected[i], v[i]);
+    }
+}
+
+TEST(connection_values, too_many_distinct) {
+    connection_values v;
+    const unsigned n = 70000;
+    for (unsigned i = 0; i<n; ++i) {
+        v.push_back(float(i));
+    }
+
+    // More than 2^16 distinct values are kept as they are.
+    v.compress();
+    EXPECT_FALSE(v.compressed());
+    ASSERT_EQ(n, v.size());
+    EXPECT_EQ(0.f, v[0]);
+    EXPECT_EQ(float(n-1), v[n-1]);
+}
+
+TEST(connection_table, compress) {
+    std::vector<connection> cons = {
+        {{0, 0}, 1, 0.5f, 2.f, 0},
+        {{0, 0}, 2, 0.5f, 3.f, 1},
+        {{1, 0}, 0, -1.f, 2.f, 0},
+        {{3, 1}, 4, 0.5f, 2.f, 1},
+    };
+
+    connection_table table;
+    table.append_partition(cons.begin(), cons.end());
+    table.compress();
+
+    ASSERT_EQ(cons.size(), table.size());
+    ASSERT_EQ(3u, table.sources.size());
+
+    std::size_t i = 0;
+    for (std::size_t k = 0; k<table.sources.size(); ++k) {
+        for (auto j = table.offsets[k]; j<table.offsets[k+1]; ++j, ++i) {
+            auto c = table.at(k, j);
+            EXPECT_EQ(cons[i].source(), c.source());
+            EXPECT_EQ(cons[i].destination(), c.destination());
+            EXPECT_EQ(cons[i].weight(), c.weight());
+            EXPECT_EQ(cons[i].delay(), c.delay());
+            EXPECT_EQ(cons[i].index_on_domain(), c.index_on_domain());
+        }
+    }
+}
@@ -0,0 +1,132 @@
+#include "../gtest.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/context.hpp>
+#include <arbor/custom_cell_group.hpp>
+#include <arbor/domain_decomposition.hpp>
+#include <arbor/event_generator.hpp>
+#include <arbor/load_balance.hpp>
+#include <arbor/recipe.hpp>
+#include <arbor/simulation.hpp>
+
+#include "cell_group_factory.hpp"
+#include "execution_context.hpp"
+
+using namespace arb;
+
+namespace {
+
+const cell_kind relay_kind = custom_cell_kind(0);
+
+// Cells that spike at the time of each event they receive.
+class relay_cell_group: public custom_cell_group {
+public:
+    relay_cell_group(const std::vector<cell_gid_type>& gids): gids_(gids) {}
+
+    custom_cell_label_ranges source_labels(std::size_t) const override { return {{"src", {0, 1}}}; }
+    custom_cell_label_ranges target_labels(std::size_t) const override { return {{"tgt", {0, 1}}}; }
+
+    void reset() override { spikes_.clear(); }
+
+    void advance(time_type, time_type, time_type, const custom_event_lanes& events) override {
+        for (std::size_t i = 0; i<events.size(); ++i) {
+            for (const auto& e: events[i]) {
+                spikes_.push_back({{gids_[i], 0}, e.time});
+            }
+        }
+    }
+
+    const std::vector<spike>& spikes() const override { return spikes_; }
+    void clear_spikes() override { spikes_.clear(); }
+
+private:
+    std::vector<cell_gid_type> gids_;
+    std::vector<spike> spikes_;
+};
+
+// A chain of relay cells, with an event to the first at t = 1 ms.
+class relay_recipe: public recipe {
+public:
+    relay_recipe(cell_size_type n): n_(n) {}
+
+    cell_size_type num_cells() const override { return n_; }
+    cell_kind get_cell_kind(cell_gid_type) const override { return relay_kind; }
+    util::unique_any get_cell_description(cell_gid_type) const override { return {}; }
+
+    std::vector<cell_connection> connections_on(cell_gid_type gid) const override {
+        if (!gid) return {};
+        return {cell_connection({gid-1, "src"}, {"tgt"}, 1.f, 2.)};
+    }
+
+    std::vector<event_generator> event_generators(cell_gid_type gid) const override {
+        if (gid) return {};
+        return {explicit_generator({{{"tgt"}, 1., 1.f}})};
+    }
+
+private:
+    cell_size_type n_;
+};
+
+} // anonymous namespace
+
+TEST(custom_cell_group, registration) {
+    auto ctx = make_context();
+    const auto& ectx = *ctx;
+
+    EXPECT_THROW(register_cell_group(cell_kind::lif, backend_kind::multicore, {}), arbor_exception);
+    EXPECT_FALSE(cell_kind_supported(relay_kind, backend_kind::multicore, ectx));
+
+    register_cell_group(relay_kind, backend_kind::multicore,
+        [](const std::vector<cell_gid_type>& gids, const recipe&) {
+            return custom_cell_group_ptr(new relay_cell_group(gids));
+        });
+    EXPECT_TRUE(cell_kind_supported(relay_kind, backend_kind::multicore, ectx));
+    EXPECT_FALSE(cell_kind_supported(relay_kind, backend_kind::gpu, ectx));
+
+    unregister_cell_group(relay_kind);
+    EXPECT_FALSE(cell_kind_supported(relay_kind, backend_kind::multicore, ectx));
+}
+
+TEST(custom_cell_group, simulation) {
+    register_cell_group(relay_kind, backend_kind::multicore,
+        [](const std::vector<cell_gid_type>& gids, const recipe&) {
+            return custom_cell_group_ptr(new relay_cell_group(gids));
+        });
+
+    auto ctx = make_context();
+    relay_recipe rec(4);
+
+    // Groups follow the hints of the custom kind.
+    partition_hint_map hints;
+    hints[relay_kind].cpu_group_size = 2;
+    auto decomp = partition_load_balance(rec, ctx, hints);
+    ASSERT_EQ(2u, decomp.groups.size());
+    EXPECT_EQ(relay_kind, decomp.groups[0].kind);
+
+    simulation sim(rec, decomp, ctx);
+    std::vector<spike> spikes;
+    sim.set_global_spike_callback(
+        [&](const std::vector<spike>& s) { spikes.insert(spikes.end(), s.begin(), s.end()); });
+    sim.run(10, 0.1);
+
+    ASSERT_EQ(4u, spikes.size());
+    std::sort(spikes.begin(), spikes.end(), [](auto& a, auto& b) { return a.time<b.time; });
+    for (cell_gid_type gid = 0; gid<4; ++gid) {
+        EXPECT_EQ(gid, spikes[gid].source.gid);
+        EXPECT_DOUBLE_EQ(1.+2.*gid, spikes[gid].time);
+    }
+
+    unregister_cell_group(relay_kind);
+}
+
+TEST(custom_cell_group, unregistered) {
+    auto ctx = make_context();
+    relay_recipe rec(2);
+
+    auto decomp = partition_load_balance(rec, ctx);
+    EXPECT_THROW(simulation(rec, decomp, ctx), arbor_exception);
+}
@@ -204,3 +204,37 @@ TEST(cv_layout, zero_size_cv) {
     double sigma_c = 100 * pi * r_c * r_c / (l_c * rho); // [µS]
     EXPECT_DOUBLE_EQ(sigma_c, D.face_conductance[cv_c]);
 }
+
+TEST(cv_layout, replicated_cells) {
+    // Cells with the same morphology, CV boundaries and properties share a
+    // discretization; cells that differ in any of these do not.
+    auto morph = common_morphology::m_reg_b1;
+
+    auto params = neuron_parameter_defaults;
+    params.discretization = cv_policy_explicit(ls::location(0, 0.3));
+
+    decor d10, d20;
+    d10.paint(reg::all(), init_membrane_potential{10});
+    d20.paint(reg::all(), init_membrane_potential{20});
+    decor d10_split = d10;
+    d10_split.set_default(cv_policy_explicit(ls::location(0, 0.6)));
+
+    std::vector<cable_cell> cells = {
+        {morph, {}, d10}, {morph, {}, d20}, {morph, {}, d10}, {morph, {}, d10_split}, {morph, {}, d20}};
+    fvm_cv_discretization D = fvm_cv_discretize(cells, params);
+
+    ASSERT_EQ(cells.size(), D.n_cell());
+    for (auto i: util::count_along(cells)) {
+        fvm_cv_discretization Di = fvm_cv_discretize(cells[i], params);
+        auto cvs = util::make_span(D.geometry.cell_cv_interval(i));
+        ASSERT_EQ(Di.size(), cvs.size());
+        for (auto k: util::count_along(cvs)) {
+            auto cv = cvs[k];
+            EXPECT_EQ(Di.cv_area[k], D.cv_area[cv]);
+            EXPECT_EQ(Di.face_conductance[k], D.face_conductance[cv]);
+            EXPECT_EQ(Di.init_membrane_potential[k], D.init_membrane_potential[cv]);
+            EXPECT_EQ(Di.geometry.cv_parent[k]==-1? -1: Di.geometry.cv_parent[k]+cvs.front(), D.geometry.cv_parent[cv]);
+        }
+    }
+    EXPECT_DOUBLE_EQ(20., D.init_membrane_potential[D.geometry.cell_cv_interval(4).first]);
+}
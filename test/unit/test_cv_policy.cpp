@@ -1,3 +1,4 @@
+#include <cmath>
 #include <iterator>
 #include <numeric>
 #include <utility>
@@ -5,6 +6,7 @@
 
 #include <arbor/cable_cell.hpp>
 #include <arbor/cable_cell_param.hpp>
+#include <arbor/math.hpp>
 #include <arbor/morph/morphology.hpp>
 #include <arbor/morph/locset.hpp>
 #include <arbor/morph/mprovider.hpp>
@@ -266,6 +268,59 @@ TEST(cv_policy, max_extent) {
     }
 }
 
+TEST(cv_policy, d_lambda) {
+    using L = mlocation;
+
+    // A 1000 µm cylinder of diameter 1 µm with a capacitance of 1 µF/cm² and an
+    // axial resistivity of 100 Ω·cm has an AC length constant at 100 Hz of
+    // 1e5·√(1/(4π·10^4)) µm.
+    segment_tree tree;
+    tree.append(mnpos, {0, 0, 0, 0.5}, {0, 0, 1000, 0.5}, 1);
+    morphology m(tree);
+
+    const double lambda = 1e5*std::sqrt(1/(4*math::pi<double>*1e4));
+    const double total = 1000/lambda;
+
+    decor dec;
+    dec.set_default(membrane_capacitance{0.01});
+    dec.set_default(axial_resistivity{100});
+
+    {
+        // Uniform parameters give evenly spaced boundary points.
+        cable_cell cell(m, {}, dec);
+        mlocation_list points = thingify(cv_policy_d_lambda(total/10.5, 100).cv_boundary_points(cell), cell.provider());
+        ASSERT_EQ(12u, points.size());
+        for (unsigned i = 0; i<points.size(); ++i) {
+            EXPECT_NEAR(i/11., points[i].pos, 1e-12);
+        }
+
+        // Halving the frequency lengthens the length constant by √2.
+        points = thingify(cv_policy_d_lambda(total/10.5, 50).cv_boundary_points(cell), cell.provider());
+        EXPECT_EQ(std::ceil(10.5/std::sqrt(2.))+1, points.size());
+
+        // Restricted to a sub-cable.
+        cv_policy pol = cv_policy_d_lambda(total/4, 100, reg::cable(0, 0.25, 0.75));
+        locset expected = as_locset(L{0, 0.25}, L{0, 0.5}, L{0, 0.75});
+        EXPECT_TRUE(locset_eq(cell.provider(), expected, pol.cv_boundary_points(cell)));
+    }
+    {
+        // Four times the capacitance on the distal half halves the length
+        // constant there, doubling its electrotonic length; boundary points
+        // are placed evenly in electrotonic distance.
+        dec.paint(reg::cable(0, 0.5, 1), membrane_capacitance{0.04});
+        cable_cell cell(m, {}, dec);
+
+        mlocation_list points = thingify(cv_policy_d_lambda(total/10.5, 100).cv_boundary_points(cell), cell.provider());
+        const unsigned ncv = 16; // ⌈1.5·10.5⌉
+        ASSERT_EQ(ncv+1, points.size());
+        for (unsigned i = 0; i<points.size(); ++i) {
+            double x = i*1.5*total/ncv;
+            double pos = x<=total/2? x/total: 0.5+(x-total/2)/(2*total);
+            EXPECT_NEAR(pos, points[i].pos, 1e-12);
+        }
+    }
+}
+
 TEST(cv_policy, every_segment) {
     using namespace cv_policy_flag;
 
@@ -328,6 +383,7 @@ TEST(cv_policy, domain) {
     EXPECT_TRUE(region_eq(cell.provider(), reg1, cv_policy_fixed_per_branch(3, reg1, interior_forks).domain()));
     EXPECT_TRUE(region_eq(cell.provider(), reg1, cv_policy_max_extent(3, reg1).domain()));
     EXPECT_TRUE(region_eq(cell.provider(), reg1, cv_policy_max_extent(3, reg1, interior_forks).domain()));
+    EXPECT_TRUE(region_eq(cell.provider(), reg1, cv_policy_d_lambda(0.1, 100, reg1).domain()));
     EXPECT_TRUE(region_eq(cell.provider(), reg1, cv_policy_every_segment(reg1).domain()));
 
     EXPECT_TRUE(region_eq(cell.provider(), join(reg1, reg2), (cv_policy_single(reg1)+cv_policy_single(reg2)).domain()));
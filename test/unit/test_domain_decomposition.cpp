@@ -2,8 +2,10 @@
 
 #include <stdexcept>
 
+#include <arbor/arbexcept.hpp>
 #include <arbor/context.hpp>
 #include <arbor/domain_decomposition.hpp>
+#include <arbor/lif_cell.hpp>
 #include <arbor/load_balance.hpp>
 
 #include <arborenv/gpu_env.hpp>
@@ -118,6 +120,92 @@ namespace {
     private:
         cell_size_type size_ = 15;
     };
+
+    // Cable cells where gap junctions are given only on the lower gid of
+    // each pair: 1-3, 3-4 and 0-5.
+    // With a positive gap_junction_interval, the sites of the gap junctions
+    // are exchanged between cell groups.
+    class one_sided_gap_recipe: public recipe {
+    public:
+        one_sided_gap_recipe(double gj_interval = 0): gj_interval_(gj_interval) {}
+
+        cell_size_type num_cells() const override {
+            return 6;
+        }
+
+        std::any get_global_properties(cell_kind) const override {
+            if (!gj_interval_) return {};
+            cable_cell_global_properties props;
+            props.gap_junction_interval = gj_interval_;
+            return props;
+        }
+
+        arb::util::unique_any get_cell_description(cell_gid_type) const override {
+            return {};
+        }
+
+        cell_kind get_cell_kind(cell_gid_type gid) const override {
+            return cell_kind::cable;
+        }
+
+        std::vector<gap_junction_connection> gap_junctions_on(cell_gid_type gid) const override {
+            switch (gid) {
+                case 0: return {gap_junction_connection({5, "gj"}, {"gj"}, 0.1)};
+                case 1: return {gap_junction_connection({3, "gj"}, {"gj"}, 0.1)};
+                case 3: return {gap_junction_connection({4, "gj"}, {"gj"}, 0.1)};
+                default: return {};
+            }
+        }
+
+    private:
+        double gj_interval_;
+    };
+
+    // Cable cells of given costs.
+    class costed_recipe: public recipe {
+    public:
+        costed_recipe(std::vector<double> costs): costs_(std::move(costs)) {}
+
+        cell_size_type num_cells() const override {
+            return costs_.size();
+        }
+
+        util::unique_any get_cell_description(cell_gid_type) const override {
+            return {};
+        }
+
+        cell_kind get_cell_kind(cell_gid_type) const override {
+            return cell_kind::cable;
+        }
+
+        std::optional<double> cell_cost(cell_gid_type gid) const override {
+            return costs_.at(gid);
+        }
+
+    private:
+        std::vector<double> costs_;
+    };
+
+    // Unconnected LIF cells.
+    class lif_recipe: public recipe {
+    public:
+        lif_recipe(cell_size_type s): size_(s) {}
+
+        cell_size_type num_cells() const override {
+            return size_;
+        }
+
+        util::unique_any get_cell_description(cell_gid_type) const override {
+            return lif_cell("src", "tgt");
+        }
+
+        cell_kind get_cell_kind(cell_gid_type) const override {
+            return cell_kind::lif;
+        }
+
+    private:
+        cell_size_type size_;
+    };
 }
 
 // test assumes one domain
@@ -361,3 +449,222 @@ TEST(domain_decomposition, compulsory_groups)
     EXPECT_EQ(expected_groups2, D2.groups[0].gids);
 
 }
+
+TEST(domain_decomposition, one_sided_gap_junctions)
+{
+    proc_allocation resources;
+    resources.num_threads = 1;
+    resources.gpu_id = -1; // disable GPU if available
+    auto ctx = make_context(resources);
+
+    // Cells are grouped with the cells that list gap junctions to them,
+    // and are placed in no other group.
+    const auto D = partition_load_balance(one_sided_gap_recipe(), ctx);
+
+    std::vector<std::vector<cell_gid_type>> expected_groups = { {2}, {0, 5}, {1, 3, 4} };
+    ASSERT_EQ(expected_groups.size(), D.groups.size());
+    for (auto i: util::count_along(expected_groups)) {
+        EXPECT_EQ(expected_groups[i], D.groups[i].gids);
+    }
+    EXPECT_EQ(6u, D.num_local_cells);
+}
+
+TEST(domain_decomposition, exchanged_gap_junctions)
+{
+    proc_allocation resources;
+    resources.num_threads = 1;
+    resources.gpu_id = -1; // disable GPU if available
+    auto ctx = make_context(resources);
+
+    // Cells joined by gap junctions are grouped like any other cells.
+    const auto D = partition_load_balance(one_sided_gap_recipe(0.025), ctx);
+
+    ASSERT_EQ(6u, D.groups.size());
+    for (auto i: util::count_along(D.groups)) {
+        EXPECT_EQ(std::vector<cell_gid_type>{cell_gid_type(i)}, D.groups[i].gids);
+    }
+    EXPECT_EQ(6u, D.num_local_cells);
+}
+
+TEST(domain_decomposition, connectivity_partition)
+{
+    proc_allocation resources;
+    resources.num_threads = 1;
+    resources.gpu_id = -1; // disable GPU if available
+    auto ctx = make_context(resources);
+
+    // On a single domain, all cells are local, and are grouped as when
+    // partitioned by gid.
+    partition_hint_map hints;
+    hints[cell_kind::cable].cpu_group_size = 3;
+    hints[cell_kind::cable].prefer_gpu = false;
+
+    auto R = gap_recipe();
+    const auto D = partition_load_balance(R, ctx, hints, domain_partition_kind::connectivity);
+
+    std::vector<std::vector<cell_gid_type>> expected_groups =
+            { {1, 5, 6}, {10, 12, 14}, {0, 13}, {2, 7, 11}, {3, 4, 8, 9} };
+    ASSERT_EQ(expected_groups.size(), D.groups.size());
+    for (auto i: util::count_along(expected_groups)) {
+        EXPECT_EQ(expected_groups[i], D.groups[i].gids);
+    }
+    for (auto gid: util::make_span(R.num_cells())) {
+        EXPECT_EQ(0, D.gid_domain(gid));
+    }
+}
+
+TEST(domain_decomposition, gpu_devices) {
+    proc_allocation resources;
+    resources.gpu_id = arbenv::default_gpu();
+
+    if (resources.has_gpu()) {
+        // Use the one device twice, as if the node had two GPUs: there must be
+        // a cell group on each, with the cells split evenly between them.
+        resources.extra_gpu_ids = {resources.gpu_id};
+        auto ctx = make_context(resources);
+        EXPECT_EQ(2u, num_gpus(ctx));
+
+        unsigned num_cells = 10;
+        const auto D = partition_load_balance(homo_recipe(num_cells, dummy_cell{}), ctx);
+
+        ASSERT_EQ(2u, D.groups.size());
+        for (unsigned i: {0u, 1u}) {
+            EXPECT_EQ(backend_kind::gpu, D.groups[i].backend);
+            EXPECT_EQ(i, D.groups[i].device);
+            EXPECT_EQ(num_cells/2, D.groups[i].gids.size());
+        }
+    }
+    else {
+        resources.extra_gpu_ids = {0};
+        EXPECT_THROW(make_context(resources), arbor_exception);
+    }
+}
+
+TEST(domain_decomposition, cpu_fraction) {
+    proc_allocation resources;
+    resources.gpu_id = arbenv::default_gpu();
+    auto ctx = make_context(resources);
+
+    partition_hint_map hints;
+    hints[cell_kind::cable].cpu_group_size = 2;
+    hints[cell_kind::cable].cpu_fraction = 0.3;
+
+    unsigned num_cells = 10;
+    const auto D = partition_load_balance(homo_recipe(num_cells, dummy_cell{}), ctx, hints);
+
+    if (resources.has_gpu()) {
+        // The first 70% of the cells form one GPU group, and the rest CPU
+        // groups of two cells.
+        ASSERT_EQ(3u, D.groups.size());
+        EXPECT_EQ(backend_kind::gpu, D.groups[0].backend);
+        EXPECT_EQ(7u, D.groups[0].gids.size());
+        EXPECT_EQ(backend_kind::multicore, D.groups[1].backend);
+        EXPECT_EQ((std::vector<cell_gid_type>{7, 8}), D.groups[1].gids);
+        EXPECT_EQ(backend_kind::multicore, D.groups[2].backend);
+        EXPECT_EQ((std::vector<cell_gid_type>{9}), D.groups[2].gids);
+    }
+    else {
+        // Without a GPU all cells go to the CPU.
+        ASSERT_EQ(5u, D.groups.size());
+        for (const auto& g: D.groups) EXPECT_EQ(backend_kind::multicore, g.backend);
+    }
+
+    hints[cell_kind::cable].cpu_fraction = 1.5;
+    EXPECT_THROW(partition_load_balance(homo_recipe(num_cells, dummy_cell{}), ctx, hints), arbor_exception);
+}
+
+// test assumes one domain
+TEST(domain_decomposition, cell_costs) {
+    auto ctx = make_context();
+
+    partition_hint_map hints;
+    hints[cell_kind::cable].cpu_group_size = 2;
+    hints[cell_kind::cable].prefer_gpu = false;
+
+    // With a mean cost of 2.4, groups are filled to a cost of 4.8, without
+    // overshooting by more than they would fall short.
+    auto D = partition_load_balance(costed_recipe({1, 1, 1, 1, 1, 1, 1, 1, 8, 8}), ctx, hints);
+
+    std::vector<std::vector<cell_gid_type>> expected = {{0, 1, 2, 3, 4}, {5, 6, 7}, {8}, {9}};
+    std::vector<std::vector<cell_gid_type>> groups;
+    for (auto& g: D.groups) {
+        groups.push_back(g.gids);
+    }
+    EXPECT_EQ(expected, groups);
+
+    // Costs are required of all cells if of any.
+    EXPECT_THROW(partition_load_balance(costed_recipe({1, -1}), ctx, hints), arbor_exception);
+}
+
+TEST(domain_decomposition, gid_domain_ranges) {
+    // On a dry run of 4 ranks of 10 cells, each rank holds one contiguous
+    // range of gids.
+    auto ctx = make_context(proc_allocation{}, dry_run_info(4, 10));
+    auto D = partition_load_balance(homo_recipe(40, dummy_cell{}), ctx);
+
+    for (auto gid: make_span(40)) {
+        EXPECT_EQ(int(gid/10), D.gid_domain(gid));
+    }
+    EXPECT_THROW(D.gid_domain(40), std::out_of_range);
+}
+
+TEST(domain_decomposition, tune_hints) {
+    auto ctx = make_context();
+
+    partition_hint_map hints;
+    hints[cell_kind::lif].prefer_gpu = false;
+    hints[cell_kind::cable].cpu_group_size = 3;
+
+    // Of the candidates, only those no larger than the sample of 10 cells
+    // are tried.
+    partition_tuning opts;
+    opts.group_sizes = {2, 5, 50};
+    opts.max_sample = 10;
+    opts.steps = 5;
+
+    auto tuned = tune_partition_hints(lif_recipe(30), ctx, hints, opts);
+    ASSERT_EQ(1u, tuned.count(cell_kind::lif));
+    auto size = tuned[cell_kind::lif].cpu_group_size;
+    EXPECT_TRUE(size==2 || size==5);
+    EXPECT_FALSE(tuned[cell_kind::lif].prefer_gpu);
+
+    // Hints of kinds not in the recipe are kept.
+    EXPECT_EQ(3u, tuned[cell_kind::cable].cpu_group_size);
+
+    // The tuned hints partition the cells as any others.
+    auto D = partition_load_balance(lif_recipe(30), ctx, tuned);
+    EXPECT_EQ((30+size-1)/size, D.groups.size());
+
+    opts.steps = 0;
+    EXPECT_THROW(tune_partition_hints(lif_recipe(30), ctx, hints, opts), arbor_exception);
+}
+
+TEST(domain_decomposition, fuse_gpu_groups) {
+    domain_decomposition d;
+    d.num_domains = 1;
+    d.domain_id = 0;
+    d.num_local_cells = 9;
+    d.num_global_cells = 9;
+    d.gid_domain = [](cell_gid_type) { return 0; };
+    d.groups = {
+        {cell_kind::cable, {0, 1}, backend_kind::gpu, 0},
+        {cell_kind::cable, {2, 3}, backend_kind::gpu, 1},
+        {cell_kind::lif, {4}, backend_kind::multicore},
+        {cell_kind::cable, {5, 6}, backend_kind::gpu, 0},
+        {cell_kind::cable, {7}, backend_kind::multicore},
+        {cell_kind::cable, {8}, backend_kind::gpu, 1},
+    };
+
+    // One GPU group per device, in place of the first of its groups; CPU
+    // groups are left as they are.
+    auto f = fuse_gpu_groups(d);
+    ASSERT_EQ(4u, f.groups.size());
+    EXPECT_EQ((std::vector<cell_gid_type>{0, 1, 5, 6}), f.groups[0].gids);
+    EXPECT_EQ(0u, f.groups[0].device);
+    EXPECT_EQ((std::vector<cell_gid_type>{2, 3, 8}), f.groups[1].gids);
+    EXPECT_EQ(1u, f.groups[1].device);
+    EXPECT_EQ(backend_kind::multicore, f.groups[2].backend);
+    EXPECT_EQ(cell_kind::lif, f.groups[2].kind);
+    EXPECT_EQ(backend_kind::multicore, f.groups[3].backend);
+    EXPECT_EQ(9u, f.num_local_cells);
+}
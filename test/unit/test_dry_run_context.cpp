@@ -56,6 +56,17 @@ TEST(dry_run_context, sum)
     EXPECT_EQ(unsigned(42 * num_ranks), ctx->sum(42u));
 }
 
+TEST(dry_run_context, sum_async)
+{
+    distributed_context_handle ctx = arb::make_dry_run_context(num_ranks, num_cells_per_rank);
+
+    auto request = ctx->sum_async({1., 2., 3.}, 0);
+    EXPECT_TRUE(request.test());
+
+    std::vector<double> expected = {1.*num_ranks, 2.*num_ranks, 3.*num_ranks};
+    EXPECT_EQ(expected, request.wait());
+}
+
 TEST(dry_run_context, gather_spikes)
 {
     distributed_context_handle ctx = arb::make_dry_run_context(4, 4);
@@ -117,3 +128,71 @@ TEST(dry_run_context, gather_gids)
     EXPECT_EQ(part[3], gids.size()*3);
     EXPECT_EQ(part[4], gids.size()*4);
 }
+
+TEST(dry_run_context, alltoall_spikes)
+{
+    distributed_context_handle ctx = arb::make_dry_run_context(4, 4);
+    using svec = std::vector<arb::spike>;
+    using gathered = arb::gathered_vector<arb::spike>;
+
+    // Spikes sent to domains 0, 1 and 3 from the local domain.
+    svec spikes = {
+        {{0u,0u}, 42.f},
+        {{1u,0u}, 42.f},
+        {{3u,0u}, 42.f},
+    };
+    // Domain j sends the local domain the spikes that the local domain sends
+    // to domain 4-j, translated to the sources on domain j.
+    svec received_spikes = {
+        {{0u,0u}, 42.f},
+        {{7u,0u}, 42.f},
+        {{13u,0u}, 42.f},
+    };
+
+    auto s = ctx->alltoall_spikes(gathered(svec(spikes), {0u, 1u, 2u, 2u, 3u}));
+
+    EXPECT_EQ(s.values(), received_spikes);
+    EXPECT_EQ(s.partition(), (std::vector<unsigned>{0u, 1u, 2u, 2u, 3u}));
+}
+
+TEST(dry_run_context, alltoall_gids)
+{
+    distributed_context_handle ctx = arb::make_dry_run_context(4, 4);
+    using gvec = std::vector<arb::cell_gid_type>;
+    using gathered = arb::gathered_vector<arb::cell_gid_type>;
+
+    // Gids requested from domains 0, 1 and 3 by the local domain.
+    gvec gids = {1, 4, 6, 13};
+    // Domain j requests from the local domain the gids the local domain
+    // requests from domain 4-j, translated to the local domain.
+    gvec received_gids = {1, 1, 0, 2};
+
+    auto s = ctx->alltoall_gids(gathered(gvec(gids), {0u, 1u, 3u, 3u, 4u}));
+
+    EXPECT_EQ(s.values(), received_gids);
+    EXPECT_EQ(s.partition(), (std::vector<unsigned>{0u, 1u, 2u, 2u, 4u}));
+}
+
+TEST(dry_run_context, alltoall_cell_labels_and_gids)
+{
+    distributed_context_handle ctx = arb::make_dry_run_context(4, 4);
+
+    arb::cell_label_range labels;
+    labels.add_cell(); labels.add_label("a", {0, 1});
+    labels.add_cell(); labels.add_label("b", {0, 2}); labels.add_label("c", {2, 3});
+    labels.add_cell();
+    labels.add_cell(); labels.add_label("d", {1, 2});
+    arb::cell_labels_and_gids local(labels, {0, 1, 2, 3});
+
+    // Cell 0 is sent to domain 0, cells 1 and 2 to domain 2, cell 3 to
+    // domain 3. Domain j sends the cells the local domain sends to domain
+    // 4-j, translated to domain j.
+    auto s = ctx->alltoall_cell_labels_and_gids(local, {0u, 1u, 1u, 3u, 4u});
+
+    EXPECT_EQ(s.gids, (std::vector<arb::cell_gid_type>{0, 7, 9, 10}));
+    EXPECT_EQ(s.label_range.sizes(), (std::vector<arb::cell_size_type>{1, 1, 2, 0}));
+    EXPECT_EQ(s.label_range.labels(), (std::vector<arb::cell_tag_type>{"a", "d", "b", "c"}));
+    ASSERT_EQ(4u, s.label_range.ranges().size());
+    EXPECT_EQ(1u, s.label_range.ranges()[1].begin);
+    EXPECT_EQ(2u, s.label_range.ranges()[3].begin);
+}
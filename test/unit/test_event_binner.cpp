@@ -1,5 +1,7 @@
 #include "../gtest.h"
 
+#include <vector>
+
 #include <event_binner.hpp>
 
 #include "common.hpp"
@@ -55,3 +57,31 @@ TEST(event_binner, with_min) {
     run_binner(event_binner{binning_kind::following, 0.5}, true);
     EXPECT_TRUE(seq_almost_eq<float>(times, (float []){1.0, 1.6, 1.8, 1.8, 2.2}));
 }
+
+TEST(event_binner, range) {
+    struct event {
+        time_type time;
+    };
+    std::vector<time_type> times = {0.8, 1.6, 1.9, 2.0, 2.2, 2.9, 3.3};
+    const time_type t_min = 1.0;
+
+    for (auto policy: {binning_kind::none, binning_kind::regular, binning_kind::following}) {
+        SCOPED_TRACE(int(policy));
+        for (auto interval: {0., 0.5}) {
+            event_binner one(policy, interval), range(policy, interval);
+
+            std::vector<time_type> expected;
+            for (auto t: times) expected.push_back(one.bin(t, t_min));
+
+            // Binning a range in two parts is the same as binning it whole.
+            std::vector<event> events;
+            for (auto t: times) events.push_back({t});
+            range.bin(events.data(), events.data()+3, t_min);
+            range.bin(events.data()+3, events.data()+events.size(), t_min);
+
+            for (std::size_t i = 0; i<times.size(); ++i) {
+                EXPECT_EQ(expected[i], events[i].time);
+            }
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#include "../gtest.h"
+
+#include <vector>
+
+#include <arbor/spike_event.hpp>
+
+#include "event_buffer.hpp"
+
+using namespace arb;
+
+static pse_vector as_vector(event_buffer::const_span s) {
+    return pse_vector(s.begin(), s.end());
+}
+
+TEST(event_buffer, count_scatter) {
+    event_buffer buf(3);
+    EXPECT_EQ(3u, buf.num_cells());
+    EXPECT_TRUE(buf.empty());
+
+    buf.count(2, 2);
+    buf.count(0);
+    buf.allocate();
+    EXPECT_EQ(3u, buf.size());
+
+    buf.push(2, {1, 2.0, 0.5f});
+    buf.push(0, {0, 1.0, 0.5f});
+    buf.push(2, {0, 3.0, 0.5f});
+
+    const auto& cbuf = buf;
+    EXPECT_EQ((pse_vector{{0, 1.0, 0.5f}}), as_vector(cbuf[0]));
+    EXPECT_TRUE(cbuf[1].empty());
+    EXPECT_EQ((pse_vector{{1, 2.0, 0.5f}, {0, 3.0, 0.5f}}), as_vector(cbuf[2]));
+
+    // Storage is retained on clear; the partition is reset.
+    auto data = cbuf[0].begin();
+    buf.clear();
+    EXPECT_TRUE(buf.empty());
+    EXPECT_EQ(3u, buf.num_cells());
+
+    buf.count(1);
+    buf.allocate();
+    buf.push(1, {4, 5.0, 1.f});
+    EXPECT_TRUE(cbuf[0].empty());
+    EXPECT_EQ((pse_vector{{4, 5.0, 1.f}}), as_vector(cbuf[1]));
+    EXPECT_EQ(data, cbuf[1].begin());
+}
+
+TEST(event_buffer, append) {
+    event_buffer buf(3);
+    buf.count(1);
+    buf.allocate();
+    buf.push(1, {0, 1.0, 0.5f});
+
+    buf.append({{{3, 2.0, 1.f}}, {{2, 0.5, 1.f}}, {}});
+    EXPECT_EQ(3u, buf.size());
+
+    const auto& cbuf = buf;
+    EXPECT_EQ((pse_vector{{3, 2.0, 1.f}}), as_vector(cbuf[0]));
+    EXPECT_EQ((pse_vector{{0, 1.0, 0.5f}, {2, 0.5, 1.f}}), as_vector(cbuf[1]));
+    EXPECT_TRUE(cbuf[2].empty());
+
+    // A further count and scatter pass keeps the events already held.
+    buf.count(2);
+    buf.count(0, 2);
+    buf.allocate();
+    buf.push(0, {5, 3.0, 1.f});
+    buf.push(2, {6, 4.0, 1.f});
+    buf.push(0, {7, 1.0, 1.f});
+    EXPECT_EQ(6u, buf.size());
+
+    EXPECT_EQ((pse_vector{{3, 2.0, 1.f}, {5, 3.0, 1.f}, {7, 1.0, 1.f}}), as_vector(cbuf[0]));
+    EXPECT_EQ((pse_vector{{0, 1.0, 0.5f}, {2, 0.5, 1.f}}), as_vector(cbuf[1]));
+    EXPECT_EQ((pse_vector{{6, 4.0, 1.f}}), as_vector(cbuf[2]));
+}
@@ -0,0 +1,88 @@
+#include "../gtest.h"
+
+#include <vector>
+
+#include <arbor/spike_event.hpp>
+
+#include "event_calendar.hpp"
+
+using namespace arb;
+
+TEST(event_calendar, take) {
+    event_calendar cal(2, 0.25);
+    EXPECT_TRUE(cal.empty());
+
+    cal.push(0, spike_event{1, 0.6, 1.f});
+    cal.push(0, spike_event{0, 0.1, 2.f});
+    cal.push(0, spike_event{1, 0.55, 3.f});
+    cal.push(0, spike_event{0, 0.7, 4.f});
+    cal.push(1, spike_event{2, 0.3, 5.f});
+    EXPECT_EQ(4u, cal.size(0));
+    EXPECT_EQ(5u, cal.size());
+
+    // Events are taken by step, in time order, with the events to each
+    // target in a step merged at the start of the step.
+    pse_vector out;
+    cal.take(0, 0, 0.6, out);
+    EXPECT_EQ((pse_vector{{0, 0, 2.f}, {1, 0.5, 4.f}, {0, 0.5, 4.f}}), out);
+    EXPECT_EQ(0u, cal.size(0));
+
+    // Events are delivered no earlier than the start of the interval.
+    out.clear();
+    cal.take(1, 0.3, 1.0, out);
+    EXPECT_EQ((pse_vector{{2, 0.3, 5.f}}), out);
+    EXPECT_TRUE(cal.empty());
+
+    // Late events are moved to the first step not yet taken.
+    out.clear();
+    cal.push(0, spike_event{3, 0.2, 1.f});
+    cal.take(0, 0.75, 1.0, out);
+    EXPECT_EQ((pse_vector{{3, 0.75, 1.f}}), out);
+}
+
+TEST(event_calendar, grow) {
+    // Events far beyond the steps held grow the ring; those already
+    // held keep their steps.
+    event_calendar cal(1, 1.0);
+    for (int i = 9; i>=0; --i) {
+        cal.push(0, spike_event{0, i+0.5, float(i)});
+    }
+    cal.push(0, spike_event{0, 100.5, 1.f});
+    EXPECT_EQ(11u, cal.size());
+
+    pse_vector out;
+    cal.take(0, 0, 10, out);
+    ASSERT_EQ(10u, out.size());
+    for (int i = 0; i<10; ++i) {
+        EXPECT_EQ((spike_event{0, time_type(i), float(i)}), out[i]);
+    }
+
+    out.clear();
+    cal.take(0, 10, 200, out);
+    EXPECT_EQ((pse_vector{{0, 100, 1.f}}), out);
+}
+
+TEST(event_calendar, set_step) {
+    event_calendar cal(1, 0.5);
+    cal.push(0, spike_event{0, 1.3, 1.f});
+    cal.push(0, spike_event{0, 1.8, 2.f});
+
+    // With a finer step, the events fall in separate steps.
+    cal.set_step(0.25);
+    pse_vector out;
+    cal.copy(0, out);
+    EXPECT_EQ(2u, out.size());
+
+    out.clear();
+    cal.take(0, 0, 2, out);
+    EXPECT_EQ((pse_vector{{0, 1.25, 1.f}, {0, 1.75, 2.f}}), out);
+
+    // The calendar restarts from the given time when cleared.
+    cal.push(0, spike_event{0, 5, 1.f});
+    cal.clear(4);
+    EXPECT_TRUE(cal.empty());
+    out.clear();
+    cal.push(0, spike_event{0, 3, 1.f});
+    cal.take(0, 4, 5, out);
+    EXPECT_EQ((pse_vector{{0, 4, 1.f}}), out);
+}
@@ -174,3 +174,35 @@ TEST(event_generators, poisson) {
     EXPECT_EQ(int1, int2);
 }
 
+
+TEST(event_generators, append_events) {
+    // Appending the events of a generator gives the events of events(). A
+    // target with the assert_univalent policy is resolved once; one with a
+    // round robin policy for each event.
+    unsigned n_resolved = 0;
+    auto resolve = [&n_resolved](const cell_local_label_type&) { return cell_lid_type(n_resolved++); };
+
+    event_generator univalent = regular_generator({"syn"}, 2.f, 1., 0.5);
+    event_generator round_robin = regular_generator({"syn", lid_selection_policy::round_robin}, 2.f, 1., 0.5);
+    event_generator explicit_gen = explicit_generator({{{"syn"}, 1.5, 3.f}, {{"syn"}, 4.5, 1.f}});
+
+    univalent.resolve_label(resolve);
+    pse_vector out;
+    univalent.append_events(0., 2., out);
+    univalent.append_events(2., 3., out);
+    EXPECT_EQ(1u, n_resolved);
+    EXPECT_EQ(pse_vector({{0, 1., 2.f}, {0, 1.5, 2.f}, {0, 2., 2.f}, {0, 2.5, 2.f}}), out);
+
+    n_resolved = 0;
+    round_robin.resolve_label(resolve);
+    out.clear();
+    round_robin.append_events(0., 2., out);
+    EXPECT_EQ(2u, n_resolved);
+    EXPECT_EQ(pse_vector({{0, 1., 2.f}, {1, 1.5, 2.f}}), out);
+
+    n_resolved = 0;
+    explicit_gen.resolve_label([](const cell_local_label_type&) { return 4u; });
+    out.clear();
+    explicit_gen.append_events(1., 5., out);
+    EXPECT_EQ(pse_vector({{4, 1.5, 3.f}, {4, 4.5, 1.f}}), out);
+}
@@ -0,0 +1,70 @@
+#include "../gtest.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <arbor/common_types.hpp>
+#include <arbor/spike_event.hpp>
+
+#include "event_sort.hpp"
+#include "util/rangeutil.hpp"
+
+using namespace arb;
+
+namespace {
+// Events with delivery times drawn from a few distinct delays after
+// spike times in [t0, t0+window).
+pse_vector random_events(std::size_t n, unsigned seed, time_type t0 = 10, time_type window = 1) {
+    std::minstd_rand R(seed);
+    std::uniform_real_distribution<time_type> spike_time(t0, t0+window);
+    std::uniform_int_distribution<unsigned> delay(1, 4);
+    std::uniform_int_distribution<cell_lid_type> target(0, 7);
+
+    pse_vector events;
+    for (std::size_t i = 0; i<n; ++i) {
+        events.push_back({target(R), spike_time(R)+0.5*delay(R), 1.f});
+    }
+    return events;
+}
+
+void check_sort(pse_vector events, event_sort_kind kind) {
+    auto expected = events;
+    util::sort(expected);
+
+    sort_events(util::range_pointer_view(events), kind);
+    EXPECT_EQ(expected, events);
+}
+} // anonymous namespace
+
+TEST(event_sort, empty) {
+    for (auto kind: {event_sort_kind::comparison, event_sort_kind::bucket}) {
+        pse_vector events;
+        sort_events(util::range_pointer_view(events), kind);
+        EXPECT_TRUE(events.empty());
+    }
+}
+
+TEST(event_sort, random) {
+    for (auto kind: {event_sort_kind::comparison, event_sort_kind::bucket}) {
+        for (std::size_t n: {1u, 5u, 31u, 32u, 100u, 1000u}) {
+            for (unsigned seed: {1u, 2u, 3u}) {
+                SCOPED_TRACE(n);
+                check_sort(random_events(n, seed), kind);
+            }
+        }
+    }
+}
+
+TEST(event_sort, ties) {
+    // All events at the same time, or at only two distinct times, must be
+    // ordered by target and weight.
+    pse_vector same;
+    pse_vector two;
+    for (unsigned i = 0; i<100; ++i) {
+        same.push_back({(i*37)%11, 2.0, float(i%3)});
+        two.push_back({(i*37)%11, i%2? 2.0: 3.0, float(i%3)});
+    }
+    check_sort(same, event_sort_kind::bucket);
+    check_sort(two, event_sort_kind::bucket);
+}
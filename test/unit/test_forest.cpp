@@ -240,3 +240,34 @@ TEST(forest, branches) {
         EXPECT_EQ(expected_parent_index, actual_parent_index);
     }
 }
+
+#ifdef ARB_GPU_ENABLED
+// The forest is built only with the GPU back end.
+TEST(forest, pack_blocks) {
+    // Unbranched cells of 200, 2, 200 and 2 CVs: each has one branch, so
+    // with two branches per level at most two cells share a block. The long
+    // cells share one, the short ones the other.
+    std::vector<int> p, divs = {0};
+    for (int n: {200, 2, 200, 2}) {
+        int start = divs.back();
+        p.push_back(-1);
+        for (int i = 1; i<n; ++i) p.push_back(start+i-1);
+        divs.push_back(start+n);
+    }
+
+    forest trees(p, divs);
+    EXPECT_EQ((std::vector<unsigned>{0, 1, 0, 1}), trees.pack_blocks(2));
+    EXPECT_EQ((std::vector<unsigned>{0, 0, 0, 0}), trees.pack_blocks(4));
+    EXPECT_EQ((std::vector<unsigned>{0, 2, 1, 3}), trees.pack_blocks(1));
+
+    // A cell with more branches on a level than fit a block.
+    //
+    //      0
+    //     / \.
+    //    1   2
+    std::vector<int> q = {-1, 0, 0};
+    forest fork(q, {0, 3});
+    EXPECT_THROW(fork.pack_blocks(1), std::runtime_error);
+    EXPECT_EQ((std::vector<unsigned>{0}), fork.pack_blocks(2));
+}
+#endif
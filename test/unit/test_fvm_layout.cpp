@@ -1,4 +1,8 @@
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
 #include <limits>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -15,6 +19,7 @@
 #include "util/rangeutil.hpp"
 #include "util/span.hpp"
 #include "io/sepval.hpp"
+#include "io/serialize.hpp"
 
 #include "common.hpp"
 #include "common_morphologies.hpp"
@@ -181,6 +186,176 @@ TEST(fvm_layout, mech_index) {
     EXPECT_EQ(ivec({0,6}), M.ions.at("k"s).cv);
 }
 
+namespace {
+    // Check that the discretization and mechanism data D2, M2 read back are
+    // those written, D and M.
+    void expect_same_lowered(const fvm_cv_discretization& D, const fvm_mechanism_data& M,
+                             const fvm_cv_discretization& D2, const fvm_mechanism_data& M2)
+    {
+        EXPECT_EQ(D.geometry.cv_parent, D2.geometry.cv_parent);
+        EXPECT_EQ(D.geometry.cv_to_cell, D2.geometry.cv_to_cell);
+        EXPECT_EQ(D.geometry.cell_cv_divs, D2.geometry.cell_cv_divs);
+        EXPECT_EQ(D.geometry.cv_cables, D2.geometry.cv_cables);
+        EXPECT_EQ(D.face_conductance, D2.face_conductance);
+        EXPECT_EQ(D.face_area_per_length, D2.face_area_per_length);
+        EXPECT_EQ(D.cv_area, D2.cv_area);
+        EXPECT_EQ(D.cv_capacitance, D2.cv_capacitance);
+        EXPECT_EQ(D.diam_um, D2.diam_um);
+        ASSERT_EQ(D.axial_resistivity.size(), D2.axial_resistivity.size());
+        for (auto i: util::count_along(D.axial_resistivity)) {
+            ASSERT_EQ(D.axial_resistivity[i].size(), D2.axial_resistivity[i].size());
+            for (auto j: util::count_along(D.axial_resistivity[i])) {
+                EXPECT_EQ(D.axial_resistivity[i][j].vertices(), D2.axial_resistivity[i][j].vertices());
+                EXPECT_EQ(D.axial_resistivity[i][j].elements(), D2.axial_resistivity[i][j].elements());
+            }
+        }
+
+        ASSERT_EQ(M.mechanisms.size(), M2.mechanisms.size());
+        for (auto& [name, config]: M.mechanisms) {
+            ASSERT_EQ(1u, M2.mechanisms.count(name));
+            auto& config2 = M2.mechanisms.at(name);
+            EXPECT_EQ(config.kind, config2.kind);
+            EXPECT_EQ(config.cv, config2.cv);
+            EXPECT_EQ(config.multiplicity, config2.multiplicity);
+            EXPECT_EQ(config.norm_area, config2.norm_area);
+            EXPECT_EQ(config.target, config2.target);
+            // Some parameter values are NaN, and must stay so.
+            ASSERT_EQ(config.param_values.size(), config2.param_values.size());
+            for (auto i: util::count_along(config.param_values)) {
+                const auto& [param, values] = config.param_values[i];
+                EXPECT_EQ(param, config2.param_values[i].first);
+                ASSERT_EQ(values.size(), config2.param_values[i].second.size());
+                for (auto j: util::count_along(values)) {
+                    auto v = values[j], v2 = config2.param_values[i].second[j];
+                    EXPECT_TRUE(v==v2 || (std::isnan(v) && std::isnan(v2))) << name << "." << param << ": " << v << " vs " << v2;
+                }
+            }
+        }
+
+        ASSERT_EQ(M.ions.size(), M2.ions.size());
+        for (auto& [name, config]: M.ions) {
+            ASSERT_EQ(1u, M2.ions.count(name));
+            EXPECT_EQ(config.cv, M2.ions.at(name).cv);
+            EXPECT_EQ(config.init_iconc, M2.ions.at(name).init_iconc);
+            EXPECT_EQ(config.init_revpot, M2.ions.at(name).init_revpot);
+            EXPECT_EQ(config.diffusivity, M2.ions.at(name).diffusivity);
+            EXPECT_EQ(config.constant_concentration, M2.ions.at(name).constant_concentration);
+        }
+
+        EXPECT_EQ(M.stimuli.cv, M2.stimuli.cv);
+        EXPECT_EQ(M.stimuli.frequency, M2.stimuli.frequency);
+        EXPECT_EQ(M.stimuli.envelope_amplitude, M2.stimuli.envelope_amplitude);
+        EXPECT_EQ(M.n_target, M2.n_target);
+        EXPECT_EQ(M.target_divs, M2.target_divs);
+        EXPECT_EQ(M.post_events, M2.post_events);
+    }
+
+    // The system of the serialization tests: the two cell system with a
+    // synapse on each cell. The synapse on cell 0 takes `syn0`.
+    system serialize_system(const mechanism_desc& syn0 = "expsyn") {
+        auto system = two_cell_system();
+        auto& descriptions = system.descriptions;
+        auto& builders = system.builders;
+
+        descriptions[0].decorations.place(builders[0].location({1, 0.4}), syn0, "syn0");
+        descriptions[1].decorations.place(builders[1].location({2, 0.4}), "exp2syn", "syn1");
+        return system;
+    }
+}
+
+TEST(fvm_layout, serialize) {
+    cable_cell_global_properties gprop;
+    gprop.default_parameters = neuron_parameter_defaults;
+
+    auto cells = serialize_system().cells();
+    fvm_cv_discretization D = fvm_cv_discretize(cells, gprop.default_parameters);
+    fvm_mechanism_data M = fvm_build_mechanism_data(gprop, cells, D);
+
+    std::stringstream s;
+    io::serializer out(s);
+    serialize(out, D);
+    serialize(out, M);
+
+    fvm_cv_discretization D2;
+    fvm_mechanism_data M2;
+    io::deserializer in(s);
+    deserialize(in, D2);
+    deserialize(in, M2);
+
+    expect_same_lowered(D, M, D2, M2);
+}
+
+TEST(fvm_layout, lowered_cache) {
+    namespace fs = std::filesystem;
+    const auto dir = fs::temp_directory_path()/"arb_test_lowered_cache";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    cable_cell_global_properties gprop;
+    gprop.default_parameters = neuron_parameter_defaults;
+
+    auto cells = serialize_system().cells();
+    fvm_cv_discretization D = fvm_cv_discretize(cells, gprop.default_parameters);
+    fvm_mechanism_data M = fvm_build_mechanism_data(gprop, cells, D);
+
+    // The key depends only on the cell descriptions, not on the cell objects.
+    const std::vector<cell_gid_type> gids = {3, 4};
+    const auto key = fvm_lowered_key(gprop, cells);
+    EXPECT_EQ(key, fvm_lowered_key(gprop, serialize_system().cells()));
+
+    fvm_cv_discretization D2;
+    fvm_mechanism_data M2;
+    EXPECT_FALSE(fvm_read_lowered(dir.string(), gids, key, D2, M2));
+
+    fvm_write_lowered(dir.string(), gids, key, D, M);
+    EXPECT_TRUE(fs::exists(dir/"group_3_2.bin"));
+    ASSERT_TRUE(fvm_read_lowered(dir.string(), gids, key, D2, M2));
+    expect_same_lowered(D, M, D2, M2);
+
+    // Another group with the same first gid and size.
+    EXPECT_FALSE(fvm_read_lowered(dir.string(), {3, 5}, key, D2, M2));
+
+    // A changed cell.
+    auto changed = serialize_system(mechanism_desc("expsyn").set("tau", 3.)).cells();
+    auto changed_key = fvm_lowered_key(gprop, changed);
+    EXPECT_NE(key, changed_key);
+    EXPECT_FALSE(fvm_read_lowered(dir.string(), gids, changed_key, D2, M2));
+
+    // Changed global properties.
+    auto reordered = gprop;
+    reordered.reorder_cvs = true;
+    EXPECT_NE(key, fvm_lowered_key(reordered, cells));
+
+    auto uncoalesced = gprop;
+    uncoalesced.coalesce_synapses = false;
+    EXPECT_NE(key, fvm_lowered_key(uncoalesced, cells));
+
+    auto cat = make_unit_test_catalogue(global_default_catalogue());
+    auto recatalogued = gprop;
+    recatalogued.catalogue = &cat;
+    EXPECT_NE(key, fvm_lowered_key(recatalogued, cells));
+
+    auto warmer = gprop;
+    warmer.default_parameters.temperature_K = 300;
+    EXPECT_NE(key, fvm_lowered_key(warmer, cells));
+
+    // A rewritten entry replaces the stale one, with the parameter values
+    // of the changed cell.
+    D = fvm_cv_discretize(changed, gprop.default_parameters);
+    M = fvm_build_mechanism_data(gprop, changed, D);
+    fvm_write_lowered(dir.string(), gids, changed_key, D, M);
+    EXPECT_FALSE(fvm_read_lowered(dir.string(), gids, key, D2, M2));
+    ASSERT_TRUE(fvm_read_lowered(dir.string(), gids, changed_key, D2, M2));
+    expect_same_lowered(D, M, D2, M2);
+
+    const auto& expsyn = M2.mechanisms.at("expsyn").param_values;
+    auto tau = std::find_if(expsyn.begin(), expsyn.end(), [](auto& p) { return p.first=="tau"; });
+    ASSERT_NE(expsyn.end(), tau);
+    EXPECT_EQ(std::vector<arb_value_type>{3.}, tau->second);
+
+    fs::remove_all(dir);
+}
+
 struct exp_instance {
     int cv;
     int multiplicity;
@@ -738,6 +913,78 @@ TEST(fvm_layout, valence_verify) {
     EXPECT_THROW(fvm_build_mechanism_data(gprop, cells, D), cable_cell_error);
 }
 
+TEST(fvm_layout, ion_diffusion) {
+    soma_cell_builder builder(5);
+    builder.add_branch(0, 100, 0.5, 0.5, 4, "dend");
+    auto desc = builder.make_cell();
+    desc.decorations.paint("dend"_lab, "fixed_ica_current");
+
+    mechanism_catalogue testcat = make_unit_test_catalogue();
+    cable_cell_global_properties gprop;
+    gprop.catalogue = &testcat;
+    gprop.default_parameters = neuron_parameter_defaults;
+
+    std::vector<cable_cell> cells{desc};
+    fvm_cv_discretization D = fvm_cv_discretize(cells, gprop.default_parameters);
+
+    // With a uniform axial resistivity, the face conductance is that of the
+    // face area per length.
+    double rL = gprop.default_parameters.axial_resistivity.value();
+    ASSERT_EQ(D.face_conductance.size(), D.face_area_per_length.size());
+    for (auto i: count_along(D.face_conductance)) {
+        EXPECT_DOUBLE_EQ(D.face_conductance[i]*rL/100, D.face_area_per_length[i]);
+    }
+
+    // Ions do not diffuse by default.
+    auto M = fvm_build_mechanism_data(gprop, cells, D);
+    auto& ca = M.ions.at("ca"s);
+    EXPECT_EQ(ca.cv.size(), ca.diffusivity.size());
+    EXPECT_TRUE(util::all_of(ca.diffusivity, [](fvm_value_type d) { return d==0; }));
+
+    gprop.default_parameters.ion_data["ca"].diffusivity = 1e-9;
+    M = fvm_build_mechanism_data(gprop, cells, D);
+    EXPECT_TRUE(util::all_of(M.ions.at("ca"s).diffusivity, [](fvm_value_type d) { return d==1e-9; }));
+
+    // The concentration of a diffusing ion cannot be written by a mechanism.
+    desc.decorations.paint("soma"_lab, "test_ca");
+    cells = {desc};
+    D = fvm_cv_discretize(cells, gprop.default_parameters);
+    EXPECT_THROW(fvm_build_mechanism_data(gprop, cells, D), cable_cell_error);
+
+    gprop.default_parameters.ion_data["ca"].diffusivity = -1;
+    EXPECT_THROW(fvm_build_mechanism_data(gprop, cells, D), cable_cell_error);
+}
+
+TEST(fvm_layout, constant_concentration) {
+    soma_cell_builder builder(5);
+    builder.add_branch(0, 100, 0.5, 0.5, 4, "dend");
+    auto desc = builder.make_cell();
+    desc.decorations.paint("dend"_lab, "fixed_ica_current");
+
+    mechanism_catalogue testcat = make_unit_test_catalogue();
+    cable_cell_global_properties gprop;
+    gprop.catalogue = &testcat;
+    gprop.default_parameters = neuron_parameter_defaults;
+
+    auto constant_ca = [&](const cable_cell_description& desc) {
+        std::vector<cable_cell> cells{desc};
+        fvm_cv_discretization D = fvm_cv_discretize(cells, gprop.default_parameters);
+        return fvm_build_mechanism_data(gprop, cells, D).ions.at("ca"s).constant_concentration;
+    };
+
+    // Only the current is written.
+    EXPECT_TRUE(constant_ca(desc));
+
+    // The concentration diffuses.
+    gprop.default_parameters.ion_data["ca"].diffusivity = 1e-9;
+    EXPECT_FALSE(constant_ca(desc));
+    gprop.default_parameters.ion_data["ca"].diffusivity.reset();
+
+    // The concentration is written on part of the cell.
+    desc.decorations.paint("soma"_lab, "test_ca");
+    EXPECT_FALSE(constant_ca(desc));
+}
+
 TEST(fvm_layout, ion_weights) {
     // Create a cell with 4 branches:
     //   - Soma (branch 0) plus three dendrites (1, 2, 3) meeting at a branch point.
@@ -901,6 +1148,105 @@ TEST(fvm_layout, revpot) {
     }
 }
 
+TEST(fvm_layout, reorder_cvs) {
+    // A passive dendrite forks into an active and a passive branch, and an
+    // active axon leaves the soma: in the default order, the CVs with hh are
+    // split among the passive ones.
+    soma_cell_builder b(7.);
+    auto b1 = b.add_branch(0, 200, 0.5, 0.5, 4, "dend");
+    b.add_branch(b1, 100, 0.4, 0.4, 4, "axon");
+    b.add_branch(b1, 100, 0.4, 0.4, 4, "dend");
+    b.add_branch(0, 300, 0.3, 0.3, 4, "axon");
+    auto desc = b.make_cell();
+    desc.decorations.paint("soma"_lab, "hh");
+    desc.decorations.paint("axon"_lab, "hh");
+    desc.decorations.paint("dend"_lab, "pas");
+
+    cable_cell_global_properties gprop;
+    gprop.default_parameters = neuron_parameter_defaults;
+
+    std::vector<cable_cell> cells(2, cable_cell(desc));
+    fvm_cv_discretization D = fvm_cv_discretize(cells, gprop.default_parameters);
+    fvm_cv_discretization R = D;
+    fvm_reorder_cvs(R, cells);
+    fvm_mechanism_data M = fvm_build_mechanism_data(gprop, cells, D);
+    fvm_mechanism_data MR = fvm_build_mechanism_data(gprop, cells, R);
+
+    // Number of runs of consecutive CVs.
+    auto runs = [](const std::vector<fvm_index_type>& cvs) {
+        unsigned n = 0;
+        for (auto i: count_along(cvs)) n += i==0 || cvs[i]!=cvs[i-1]+1;
+        return n;
+    };
+
+    // The CVs at the two forks have both mechanisms. Per cell, hh then runs
+    // over the soma, and over the fork beyond the dendrite, the branch after
+    // it and the axon; pas over the dendrite, and over the passive branch.
+    EXPECT_EQ(4u, runs(MR.mechanisms.at("pas").cv));
+    EXPECT_EQ(4u, runs(MR.mechanisms.at("hh").cv));
+    EXPECT_LT(runs(MR.mechanisms.at("hh").cv)+runs(MR.mechanisms.at("pas").cv),
+              runs(M.mechanisms.at("hh").cv)+runs(M.mechanisms.at("pas").cv));
+
+    // Each cell keeps its CVs, with parents before children.
+    const auto& g = R.geometry;
+    ASSERT_EQ(D.geometry.cell_cv_divs, g.cell_cv_divs);
+    EXPECT_EQ(D.geometry.cv_to_cell, g.cv_to_cell);
+    for (auto cell_idx: count_along(cells)) {
+        auto [cv0, cv1] = g.cell_cv_interval(cell_idx);
+        EXPECT_EQ(-1, g.cv_parent[cv0]);
+        for (auto cv: make_span(cv0+1, cv1)) {
+            EXPECT_LE(cv0, g.cv_parent[cv]);
+            EXPECT_LT(g.cv_parent[cv], cv);
+        }
+    }
+
+    // Find the new index of each CV by its cables.
+    std::vector<fvm_index_type> new_cv(D.size(), -1);
+    for (auto i: make_span(D.size())) {
+        auto cables = D.geometry.cables(i);
+        for (auto j: g.cell_cvs(D.geometry.cv_to_cell[i])) {
+            auto other = g.cables(j);
+            if (std::equal(cables.begin(), cables.end(), other.begin(), other.end())) new_cv[i] = j;
+        }
+        ASSERT_NE(-1, new_cv[i]);
+    }
+
+    for (auto i: make_span(D.size())) {
+        auto j = new_cv[i];
+        auto p = D.geometry.cv_parent[i];
+        EXPECT_EQ(p==-1? -1: new_cv[p], g.cv_parent[j]);
+        EXPECT_EQ(D.cv_area[i], R.cv_area[j]);
+        EXPECT_EQ(D.face_conductance[i], R.face_conductance[j]);
+        EXPECT_EQ(D.cv_capacitance[i], R.cv_capacitance[j]);
+
+        std::vector<fvm_index_type> children, children_r;
+        for (auto c: D.geometry.children(i)) children.push_back(new_cv[c]);
+        util::assign(children_r, g.children(j));
+        util::sort(children);
+        EXPECT_EQ(children, children_r);
+    }
+
+    for (auto cell_idx: count_along(cells)) {
+        for (msize_t bid = 0; bid<cells[cell_idx].morphology().num_branches(); ++bid) {
+            for (double pos: {0., 0.1, 0.5, 0.9, 1.}) {
+                mlocation loc{bid, pos};
+                for (auto prefer: {cv_prefer::cv_distal, cv_prefer::cv_proximal, cv_prefer::cv_nonempty, cv_prefer::cv_empty}) {
+                    EXPECT_EQ(new_cv[D.geometry.location_cv(cell_idx, loc, prefer)], (fvm_index_type)g.location_cv(cell_idx, loc, prefer));
+                }
+            }
+        }
+    }
+
+    for (auto& [name, config]: M.mechanisms) {
+        auto& config_r = MR.mechanisms.at(name);
+        std::vector<std::pair<fvm_index_type, fvm_value_type>> expected, actual;
+        for (auto k: count_along(config.cv)) expected.emplace_back(new_cv[config.cv[k]], config.norm_area[k]);
+        for (auto k: count_along(config_r.cv)) actual.emplace_back(config_r.cv[k], config_r.norm_area[k]);
+        util::sort(expected);
+        EXPECT_EQ(expected, actual);
+    }
+}
+
 TEST(fvm_layout, vinterp_cable) {
     // On a simple cable, expect CVs used forinterpolation to change at
     // the midpoints of interior CVs. Every site in the proximal CV should
@@ -959,6 +1305,52 @@ TEST(fvm_layout, vinterp_cable) {
     }
 }
 
+TEST(fvm_layout, extracellular_response) {
+    // Cable of length 10 µm along the x-axis, in five CVs.
+    arb::segment_tree tree;
+    tree.append(mnpos, { 0,0,0,1}, {10,0,0,1}, 1);
+    arb::morphology m(tree);
+    decor d;
+    d.set_default(cv_policy_fixed_per_branch(5));
+    cable_cell cell{m, {}, d};
+    fvm_cv_discretization D = fvm_cv_discretize(cell, neuron_parameter_defaults);
+    const unsigned n_cv = D.size();
+
+    const double sigma = 0.5;
+    const double coef = 1/(4*math::pi<double>*sigma);
+
+    // Point sources lie at the midpoints of the cables of each CV.
+    std::vector<mpoint> electrodes = {{5, 100, 0, 1}, {-20, 0, 30, 1}};
+    auto point = fvm_extracellular_response(cell, D, 0, electrodes, sigma, extracellular_method::point_source);
+
+    ASSERT_EQ(2u, point.size());
+    for (unsigned e = 0; e<2; ++e) {
+        ASSERT_EQ(n_cv, point[e].size());
+        for (unsigned cv = 0; cv<n_cv; ++cv) {
+            auto cables = D.geometry.cables(cv);
+            ASSERT_EQ(1u, cables.size());
+            double x = 5*(cables.front().prox_pos+cables.front().dist_pos);
+            double r = std::hypot(electrodes[e].x-x, electrodes[e].y, electrodes[e].z);
+            EXPECT_NEAR(coef/r, point[e][cv], 1e-12);
+        }
+    }
+
+    // Far from the cell, line sources look like point sources.
+    std::vector<mpoint> far = {{5, 1e4, 0, 1}};
+    auto line = fvm_extracellular_response(cell, D, 0, far, sigma, extracellular_method::line_source);
+    point = fvm_extracellular_response(cell, D, 0, far, sigma, extracellular_method::point_source);
+    for (unsigned cv = 0; cv<n_cv; ++cv) {
+        EXPECT_TRUE(testing::near_relative(point[0][cv], line[0][cv], 1e-6));
+        EXPECT_TRUE(testing::near_relative(coef*1e-4, line[0][cv], 1e-6));
+    }
+
+    // An electrode within the cable sees a finite potential.
+    line = fvm_extracellular_response(cell, D, 0, {{5, 0, 0, 1}}, sigma, extracellular_method::line_source);
+    for (auto v: line[0]) EXPECT_TRUE(std::isfinite(v));
+
+    EXPECT_THROW(fvm_extracellular_response(cell, D, 0, far, 0., extracellular_method::line_source), cable_cell_error);
+}
+
 TEST(fvm_layout, vinterp_forked) {
     // If a CV contains points at both ends of a branch, there will be
     // no other adjacent CV on the same branch that we can use for
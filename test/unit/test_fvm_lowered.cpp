@@ -1,5 +1,6 @@
 #include <cmath>
 #include <numeric>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -18,6 +19,7 @@
 #include <arbor/simulation.hpp>
 #include <arbor/schedule.hpp>
 #include <arbor/mechanism.hpp>
+#include <arbor/mechcat.hpp>
 #include <arbor/string_literals.hpp>
 #include <arbor/util/any_ptr.hpp>
 
@@ -27,6 +29,7 @@
 #include "execution_context.hpp"
 #include "fvm_lowered_cell.hpp"
 #include "fvm_lowered_cell_impl.hpp"
+#include "io/serialize.hpp"
 #include "mech_private_field_access.hpp"
 #include "util/meta.hpp"
 #include "util/maputil.hpp"
@@ -627,6 +630,7 @@ TEST(fvm_lowered, ionic_concentrations) {
     std::vector<fvm_value_type> diam(ncv, 1.);
     std::vector<fvm_value_type> vinit(ncv, -65);
     std::vector<fvm_gap_junction> gj = {};
+    std::vector<fvm_index_type> detector_divs = {};
     std::vector<fvm_index_type> src_to_spike = {};
 
     fvm_ion_config ion_config;
@@ -651,7 +655,7 @@ TEST(fvm_lowered, ionic_concentrations) {
     auto& write_cai_mech = write_cai.mech;
 
     auto shared_state = std::make_unique<typename backend::shared_state>(
-            ncell, ncell, 0, cv_to_intdom, cv_to_intdom, gj, vinit, temp, diam, src_to_spike, read_cai_mech->data_alignment());
+            ncell, ncell, detector_divs, cv_to_intdom, cv_to_intdom, gj, vinit, temp, diam, src_to_spike, read_cai_mech->data_alignment());
     shared_state->add_ion("ca", 2, ion_config);
 
     shared_state->instantiate(*read_cai_mech, 0, overrides, layout);
@@ -680,6 +684,117 @@ TEST(fvm_lowered, ionic_concentrations) {
     EXPECT_EQ(expected_s_values, mechanism_field(read_cai_mech.get(), "s"));
 }
 
+// The Nernst kernel of the back end matches the nernst mechanism.
+TEST(fvm_lowered, nernst_kernel) {
+    fvm_size_type ncell = 1;
+    fvm_size_type ncv = 3;
+    std::vector<fvm_index_type> cv_to_intdom(ncv, 0);
+    std::vector<fvm_value_type> temp = {279.45, 296.15, 310.15};
+    std::vector<fvm_value_type> diam(ncv, 1.);
+    std::vector<fvm_value_type> vinit(ncv, -65);
+    std::vector<fvm_gap_junction> gj = {};
+    std::vector<fvm_index_type> detector_divs = {};
+    std::vector<fvm_index_type> src_to_spike = {};
+
+    fvm_ion_config ion_config;
+    for (fvm_size_type i = 0; i<ncv; ++i) {
+        ion_config.cv.push_back(i);
+    }
+    ion_config.init_revpot.assign(ncv, 0.);
+    ion_config.init_econc.assign(ncv, 0.);
+    ion_config.init_iconc.assign(ncv, 0.);
+    ion_config.reset_econc = {2., 140., 5.};
+    ion_config.reset_iconc = {5e-5, 10., 54.4};
+
+    auto state = std::make_unique<shared_state>(
+            ncell, ncell, detector_divs, cv_to_intdom, cv_to_intdom, gj, vinit, temp, diam, src_to_spike, 1);
+    state->add_ion("ca", 2, ion_config);
+    state->add_ion("k", 1, ion_config);
+
+    const auto& nernst = global_default_catalogue()["nernst"];
+    const double R = nernst.globals.at("R").default_value;
+    const double F = nernst.globals.at("F").default_value;
+    state->configure_nernst("ca", 1e3*R/F, false);
+    state->configure_nernst("k", 1e3*R/F, true);
+
+    state->reset();
+    state->ions_nernst_reversal_potential(false);
+
+    auto& ca = state->ion_data.at("ca");
+    auto& k = state->ion_data.at("k");
+    for (fvm_size_type i = 0; i<ncv; ++i) {
+        double coeff = R*temp[i]/(2*F)*1000;
+        EXPECT_NEAR(coeff*std::log(ion_config.reset_econc[i]/ion_config.reset_iconc[i]), ca.eX_[i], 1e-9);
+        EXPECT_EQ(0., k.eX_[i]);
+    }
+
+    // Ions with constant concentrations are set apart, on reset, and the
+    // others are left as they are.
+    util::fill(ca.eX_, 0.);
+    state->ions_nernst_reversal_potential(true);
+    for (fvm_size_type i = 0; i<ncv; ++i) {
+        double coeff = R*temp[i]/F*1000;
+        EXPECT_NEAR(coeff*std::log(ion_config.reset_econc[i]/ion_config.reset_iconc[i]), k.eX_[i], 1e-9);
+        EXPECT_EQ(0., ca.eX_[i]);
+    }
+}
+
+// The Nernst kernel takes the place of the nernst mechanism only where it
+// sets the reversal potentials of all the CVs of its ions.
+TEST(fvm_lowered, nernst_kernel_mixed_methods) {
+    soma_cell_builder b(6);
+
+    mechanism_desc m1("fixed_ica_current");
+    m1["current_density"] = -1.5;
+    mechanism_desc m2("linear_ca_conc");
+    m2["coeff"] = 0.5;
+
+    auto c = b.make_cell();
+    c.decorations.paint("soma"_lab, m1);
+    c.decorations.paint("soma"_lab, m2);
+
+    const auto& nernst = global_default_catalogue()["nernst"];
+    const double R = nernst.globals.at("R").default_value;
+    const double F = nernst.globals.at("F").default_value;
+
+    // Cell 0 sets the reversal potential of calcium with the nernst
+    // mechanism; cell 1 leaves it constant, or uses the nernst mechanism too.
+    for (bool mixed: {true, false}) {
+        SCOPED_TRACE(mixed? "mixed": "nernst");
+
+        std::vector<cable_cell_description> cells(2, c);
+        cells[0].decorations.set_default(ion_reversal_potential_method{"ca", "nernst/ca"});
+        if (!mixed) {
+            cells[1].decorations.set_default(ion_reversal_potential_method{"ca", "nernst/ca"});
+        }
+
+        cable1d_recipe rec(std::vector<cable_cell>{cells[0], cells[1]});
+        rec.catalogue() = make_unit_test_catalogue(global_default_catalogue());
+
+        arb::execution_context context;
+        fvm_cell fvcell(context);
+        fvcell.initialize({0, 1}, rec);
+
+        auto& state = *(fvcell.*private_state_ptr).get();
+        auto& ion = state.ion_data.at("ca"s);
+        ASSERT_EQ(2u, ion.node_index_.size());
+        EXPECT_EQ(mixed? 0u: 1u, state.nernst_ions.size());
+
+        const double eca1 = ion.eX_[1];
+        (void)fvcell.integrate(5, 0.025, {}, {});
+
+        for (unsigned i: {0u, 1u}) {
+            if (mixed && i==1) {
+                EXPECT_EQ(eca1, ion.eX_[i]);
+            }
+            else {
+                const double T = state.temperature_degC[ion.node_index_[i]]+273.15;
+                EXPECT_NEAR(1e3*R*T/(2*F)*std::log(ion.Xo_[i]/ion.Xi_[i]), ion.eX_[i], 1e-9);
+            }
+        }
+    }
+}
+
 TEST(fvm_lowered, ionic_currents) {
     arb::proc_allocation resources;
     if (auto nt = arbenv::get_env_num_threads()) {
@@ -733,6 +848,201 @@ TEST(fvm_lowered, ionic_currents) {
     EXPECT_NEAR(expected_Xi, ion.Xi_[0], 1e-6);
 }
 
+// Reset should restore the state after initialization, so that a second run
+// reproduces the first.
+
+TEST(fvm_lowered, reset) {
+    arb::execution_context context;
+
+    soma_cell_builder b(6);
+
+    mechanism_desc m1("fixed_ica_current");
+    m1["current_density"] = 1.5;
+    mechanism_desc m2("linear_ca_conc");
+    m2["coeff"] = 0.5;
+
+    auto c = b.make_cell();
+    c.decorations.paint("soma"_lab, m1);
+    c.decorations.paint("soma"_lab, m2);
+    c.decorations.paint("soma"_lab, "hh");
+
+    cable1d_recipe rec({cable_cell{c}});
+    rec.catalogue() = make_unit_test_catalogue(global_default_catalogue());
+
+    fvm_cell fvcell(context);
+    fvcell.initialize({0}, rec);
+
+    auto& state = *(fvcell.*private_state_ptr).get();
+    auto& ion = state.ion_data.at("ca"s);
+
+    auto v0 = state.voltage[0];
+    auto iX0 = ion.iX_[0];
+    auto Xi0 = ion.Xi_[0];
+
+    const double time = 5; // [ms]
+    (void)fvcell.integrate(time, 0.025, {}, {});
+    auto v1 = state.voltage[0];
+    auto Xi1 = ion.Xi_[0];
+    EXPECT_NE(v0, v1);
+    EXPECT_NE(Xi0, Xi1);
+
+    fvcell.reset();
+    EXPECT_EQ(0., fvcell.time());
+    EXPECT_EQ(v0, state.voltage[0]);
+    EXPECT_EQ(iX0, ion.iX_[0]);
+    EXPECT_EQ(Xi0, ion.Xi_[0]);
+
+    (void)fvcell.integrate(time, 0.025, {}, {});
+    EXPECT_EQ(v1, state.voltage[0]);
+    EXPECT_EQ(Xi1, ion.Xi_[0]);
+}
+
+// Instances of a mechanism with an active index leave it when quiescent;
+// the index and the count of active instances are restored with the rest of
+// the mechanism state from a checkpoint.
+TEST(fvm_lowered, checkpoint_active_index) {
+    arb::execution_context context;
+
+    soma_cell_builder b(6);
+    auto c = b.make_cell();
+    mechanism_desc slow("quiescent_syn");
+    slow["tau"] = 5.;
+    c.decorations.place(mlocation{0, 0.5}, "quiescent_syn", "syn0");
+    c.decorations.place(mlocation{0, 0.5}, slow, "syn1");
+
+    cable1d_recipe rec({cable_cell{c}});
+    rec.catalogue() = make_unit_test_catalogue(global_default_catalogue());
+
+    fvm_cell fvcell(context);
+    fvcell.initialize({0}, rec);
+    auto& ppack = find_mechanism(fvcell, "quiescent_syn")->ppack_;
+    ASSERT_EQ(2u, ppack.width);
+    EXPECT_EQ(2u, ppack.n_active);
+
+    // The synapses do not receive events, and are quiescent after a step.
+    (void)fvcell.integrate(1, 0.025, {}, {});
+    EXPECT_EQ(0u, ppack.n_active);
+
+    std::stringstream checkpoint;
+    io::serializer out(checkpoint);
+    fvcell.serialize(out);
+
+    fvm_cell restored(context);
+    restored.initialize({0}, rec);
+    auto& restored_ppack = find_mechanism(restored, "quiescent_syn")->ppack_;
+    EXPECT_EQ(2u, restored_ppack.n_active);
+
+    io::deserializer in(checkpoint);
+    restored.deserialize(in);
+    EXPECT_EQ(0u, restored_ppack.n_active);
+    for (unsigned i = 0; i<ppack.width; ++i) {
+        EXPECT_EQ(0, restored_ppack.active_flag[i]);
+    }
+}
+
+// Quiescent instances are active again after a reset, as they are after
+// initialization.
+TEST(fvm_lowered, reset_active_index) {
+    arb::execution_context context;
+
+    soma_cell_builder b(6);
+    auto c = b.make_cell();
+    mechanism_desc slow("quiescent_syn");
+    slow["tau"] = 5.;
+    c.decorations.place(mlocation{0, 0.5}, "quiescent_syn", "syn0");
+    c.decorations.place(mlocation{0, 0.5}, slow, "syn1");
+
+    cable1d_recipe rec({cable_cell{c}});
+    rec.catalogue() = make_unit_test_catalogue(global_default_catalogue());
+
+    fvm_cell fvcell(context);
+    fvcell.initialize({0}, rec);
+    auto& ppack = find_mechanism(fvcell, "quiescent_syn")->ppack_;
+    ASSERT_EQ(2u, ppack.width);
+
+    (void)fvcell.integrate(1, 0.025, {}, {});
+    EXPECT_EQ(0u, ppack.n_active);
+
+    fvcell.reset();
+    EXPECT_EQ(2u, ppack.n_active);
+    for (unsigned i = 0; i<ppack.width; ++i) {
+        EXPECT_EQ(1, ppack.active_flag[i]);
+    }
+}
+
+// With steady-state initialization, cells start at the resting state that
+// they otherwise reach after a transient, and are returned to it on reset.
+
+TEST(fvm_lowered, steady_state) {
+    arb::execution_context context;
+
+    struct rest_recipe: cable1d_recipe {
+        rest_recipe(const cable_cell& c, double tolerance): cable1d_recipe(c) {
+            cell_gprop_.steady_state_tolerance = tolerance;
+        }
+    };
+
+    mechanism_desc pas("pas");
+    pas["e"] = -70;
+
+    soma_cell_builder b(6);
+    auto c = b.make_cell();
+    c.decorations.paint("soma"_lab, pas);
+    c.decorations.paint("soma"_lab, "hh");
+
+    fvm_cell plain(context), relaxed(context);
+    plain.initialize({0}, rest_recipe(cable_cell{c}, 0));
+    relaxed.initialize({0}, rest_recipe(cable_cell{c}, 1e-6));
+
+    auto& plain_state = *(plain.*private_state_ptr).get();
+    auto& relaxed_state = *(relaxed.*private_state_ptr).get();
+    auto v_rest = relaxed_state.voltage[0];
+    EXPECT_EQ(0., relaxed.time());
+    EXPECT_GT(std::abs(plain_state.voltage[0]-v_rest), 0.1);
+
+    (void)plain.integrate(500, 0.025, {}, {});
+    EXPECT_NEAR(v_rest, plain_state.voltage[0], 1e-3);
+
+    (void)relaxed.integrate(10, 0.025, {}, {});
+    EXPECT_NEAR(v_rest, relaxed_state.voltage[0], 1e-3);
+
+    relaxed.reset();
+    EXPECT_EQ(0., relaxed.time());
+    EXPECT_EQ(v_rest, relaxed_state.voltage[0]);
+}
+
+// With event_delivery_kind::step_start, events are applied at the start of
+// the step in which they fall, and steps are not shortened.
+
+TEST(fvm_lowered, step_start_event_delivery) {
+    using namespace arb;
+
+    arb::execution_context context;
+
+    auto desc = make_cell_ball_and_stick();
+    desc.decorations.place(mlocation{0, 0.5}, "expsyn", "syn");
+    cable1d_recipe rec({cable_cell{desc}});
+
+    const double dt = 0.025;
+    auto run = [&](event_delivery_kind kind, double t_event) {
+        fvm_cell fvcell(context);
+        auto fvm_info = fvcell.initialize({0}, rec);
+        fvcell.set_event_delivery(kind);
+
+        auto handle = fvm_info.target_handles[0];
+        (void)fvcell.integrate(1, dt, {deliverable_event(t_event, handle, 0.1f)}, {});
+        EXPECT_EQ(1., fvcell.time());
+        (void)fvcell.integrate(2.01, dt, {}, {});
+        EXPECT_EQ(2.01, fvcell.time());
+        return (fvcell.*private_state_ptr)->voltage[0];
+    };
+
+    // An event within the first step is applied at t=0.
+    auto v_exact = run(event_delivery_kind::exact, 0.);
+    EXPECT_EQ(v_exact, run(event_delivery_kind::step_start, 0.01));
+    EXPECT_NE(v_exact, run(event_delivery_kind::exact, 0.01));
+}
+
 // Test correct scaling of an ionic current updated via a point mechanism
 
 TEST(fvm_lowered, point_ionic_current) {
@@ -1324,18 +1634,21 @@ TEST(fvm_lowered, post_events_shared_state) {
 
         auto& S = fvcell.*private_state_ptr;
 
-        auto expected_detectors = util::max_value(detectors_per_cell);
+        const unsigned expected_detectors = util::sum(detectors_per_cell);
 
-        EXPECT_EQ(expected_detectors, S->n_detector);
-        EXPECT_EQ(util::sum(detectors_per_cell), S->src_to_spike.size());
-        EXPECT_EQ(expected_detectors * ncell, S->time_since_spike.size());
+        ASSERT_EQ(ncell+1, S->detector_divs.size());
+        EXPECT_EQ(expected_detectors, S->src_to_spike.size());
+        EXPECT_EQ(expected_detectors, S->time_since_spike.size());
 
         unsigned detector_id = 0;
         for (unsigned c = 0; c < detectors_per_cell.size(); ++c) {
+            EXPECT_EQ((int) detector_id, S->detector_divs[c]);
             for (unsigned d = 0; d < detectors_per_cell[c]; ++d) {
-                EXPECT_EQ((int) (c * expected_detectors + d), S->src_to_spike[detector_id++]);
+                EXPECT_EQ((int) detector_id, S->src_to_spike[detector_id]);
+                ++detector_id;
             }
         }
+        EXPECT_EQ((int) expected_detectors, S->detector_divs[ncell]);
     }
     for (const auto& detectors_per_cell: detectors_per_cell_vec) {
         detector_recipe rec(cv_per_cell, detectors_per_cell, "expsyn");
@@ -1345,7 +1658,7 @@ TEST(fvm_lowered, post_events_shared_state) {
 
         auto& S = fvcell.*private_state_ptr;
 
-        EXPECT_EQ(0u, S->n_detector);
+        EXPECT_EQ(0u, S->detector_divs.size());
         EXPECT_EQ(0u, S->src_to_spike.size());
         EXPECT_EQ(0u, S->time_since_spike.size());
     }
@@ -1540,3 +1853,36 @@ TEST(fvm_lowered, label_data) {
         EXPECT_EQ(actual_labeled_ranges, expected_labeled_ranges);
     }
 }
+
+TEST(fvm_lowered, gj_current) {
+    // Gap junctions given in arbitrary order, with several on the same CV,
+    // contribute the same current as when evaluated one by one.
+    fvm_size_type ncv = 7;
+    std::vector<fvm_index_type> cv_to_intdom(ncv, 0);
+    std::vector<fvm_value_type> temp(ncv, 23);
+    std::vector<fvm_value_type> diam(ncv, 1.);
+    std::vector<fvm_value_type> vinit(ncv);
+    std::iota(vinit.begin(), vinit.end(), -70.);
+    std::vector<fvm_index_type> detector_divs = {};
+    std::vector<fvm_index_type> src_to_spike = {};
+
+    std::vector<fvm_gap_junction> gj = {
+        {{3, 0}, 0.5}, {{0, 3}, 0.5}, {{6, 2}, 0.1}, {{3, 5}, 0.2}, {{0, 6}, 0.3},
+        {{3, 1}, 0.4}, {{2, 6}, 0.1}, {{5, 3}, 0.2}, {{3, 0}, 0.7}, {{1, 3}, 0.4},
+        {{6, 0}, 0.3}, {{0, 3}, 0.7}, {{4, 4}, 1.0}
+    };
+
+    std::vector<fvm_value_type> expected(ncv, 0.);
+    for (const auto& g: gj) {
+        expected[g.loc.first] -= g.weight*(vinit[g.loc.second]-vinit[g.loc.first]);
+    }
+
+    shared_state state(1, 1, detector_divs, cv_to_intdom, cv_to_intdom, gj, vinit, temp, diam, src_to_spike, 1);
+    state.reset();
+    state.zero_currents();
+    state.add_gj_current();
+
+    for (fvm_size_type i = 0; i<ncv; ++i) {
+        EXPECT_DOUBLE_EQ(expected[i], state.current_density[i]);
+    }
+}
@@ -28,6 +28,13 @@ namespace kernels {
         }
     }
 
+    template <unsigned BlockDim, typename F>
+    __global__
+    void push_back_block(gpu::stack_storage<int>& s, F f) {
+        int i = threadIdx.x + blockIdx.x*blockDim.x;
+        arb::gpu::push_back_block<BlockDim>(s, f(i), i);
+    }
+
     struct all_ftor {
         __host__ __device__
         bool operator() (int i) {
@@ -125,6 +132,50 @@ TEST(stack, overflow) {
     EXPECT_TRUE(s.overflow());
 }
 
+TEST(stack, push_back_block) {
+    using T = int;
+    using stack = gpu::stack<T>;
+
+    auto context = make_gpu_context(0);
+    if (!context->has_gpu()) return;
+
+    constexpr unsigned block_dim = 128;
+    const unsigned n_block = 5;
+    const unsigned n = n_block*block_dim;
+
+    // More values than fit in the prefix read with the storage.
+    auto s = stack(n, context);
+    auto& sstorage = s.storage();
+
+    for (unsigned rep=0; rep<2; ++rep) {
+        s.clear();
+        kernels::push_back_block<block_dim><<<n_block, block_dim>>>(sstorage, kernels::even_ftor());
+        s.update_host();
+        EXPECT_EQ(n/2, s.size());
+        EXPECT_FALSE(s.overflow());
+
+        // The values of each block are contiguous and in thread order.
+        auto d = s.data();
+        for (unsigned i=0; i+1<d.size(); ++i) {
+            if (d[i]/block_dim==d[i+1]/block_dim) {
+                EXPECT_EQ(d[i]+2, d[i+1]);
+            }
+        }
+        std::sort(d.begin(), d.end());
+        for (unsigned i=0; i<n/2; ++i) {
+            EXPECT_EQ(2*i, d[i]);
+        }
+    }
+
+    // Overflow is reported with the count.
+    auto small = stack(n/4, context);
+    kernels::push_back_block<block_dim><<<n_block, block_dim>>>(small.storage(), kernels::odd_ftor());
+    small.update_host();
+    EXPECT_EQ(n/4, small.size());
+    EXPECT_EQ(n/2, small.pushes());
+    EXPECT_TRUE(small.overflow());
+}
+
 TEST(stack, empty) {
     using T = int;
     using stack = gpu::stack<T>;
@@ -45,10 +45,11 @@ void run_test(std::string mech_name,
     std::vector<fvm_value_type> temp(ncv, 300.);
     std::vector<fvm_value_type> diam(ncv, 1.);
     std::vector<fvm_value_type> vinit(ncv, -65);
+    std::vector<fvm_index_type> detector_divs = {};
     std::vector<fvm_index_type> src_to_spike = {};
 
     auto shared_state = std::make_unique<typename backend::shared_state>(
-            ncell, ncell, 0, cv_to_intdom, cv_to_intdom, gj, vinit, temp, diam, src_to_spike, test->data_alignment());
+            ncell, ncell, detector_divs, cv_to_intdom, cv_to_intdom, gj, vinit, temp, diam, src_to_spike, test->data_alignment());
 
     mechanism_layout layout;
     mechanism_overrides overrides;
@@ -146,6 +147,31 @@ TEST(mech_kinetic, kinetic_nonlinear_scaled) {
     run_test<multicore::backend>("test4_kin_compartment", state_variables, {}, t0_values, t1_values, 0.1);
 }
 
+TEST(mech_kinetic, kinetic_sdirk2) {
+    // One step of the two-stage SDIRK method of order two.
+    std::vector<std::string> state_variables_0 = {"s", "h", "d"};
+    std::vector<fvm_value_type> t0_0_values = {0.5, 0.2, 0.3};
+    std::vector<fvm_value_type> t1_0_values = {0.352208955, 0.513709705, 0.134081340};
+
+    std::vector<std::string> state_variables_1 = {"a", "b", "c"};
+    std::vector<fvm_value_type> t0_1_values = {0.2, 0.3, 0.5};
+    std::vector<fvm_value_type> t1_1_values = {0.223333568, 0.311666784, 0.488333216};
+
+    run_test<multicore::backend>("test0_kin_sdirk2", state_variables_0, {}, t0_0_values, t1_0_values, 0.5);
+    run_test<multicore::backend>("test2_kin_sdirk2", state_variables_1, {}, t0_1_values, t1_1_values, 0.025);
+}
+
+TEST(mech_kinetic, kinetic_expm) {
+    // One step of the exact solution, with and without compartment scaling.
+    std::vector<std::string> state_variables = {"s", "h", "d"};
+    std::vector<fvm_value_type> t0_values = {0.5, 0.2, 0.3};
+    std::vector<fvm_value_type> t1_0_values = {0.351608706, 0.508430880, 0.139960415};
+    std::vector<fvm_value_type> t1_1_values = {0.275235121, 0.711483836, 0.013281043};
+
+    run_test<multicore::backend>("test0_kin_expm", state_variables, {}, t0_values, t1_0_values, 0.5);
+    run_test<multicore::backend>("test1_kin_expm", state_variables, {}, t0_values, t1_1_values, 0.5);
+}
+
 TEST(mech_linear, linear_system) {
     std::vector<std::string> state_variables = {"h", "s", "d"};
     std::vector<fvm_value_type> values = {0.5, 0.2, 0.3};
@@ -211,6 +237,31 @@ TEST(mech_kinetic_gpu, kinetic_nonlinear_scaled) {
     run_test<gpu::backend>("test4_kin_compartment", state_variables, {}, t0_values, t1_values, 0.1);
 }
 
+TEST(mech_kinetic_gpu, kinetic_sdirk2) {
+    // One step of the two-stage SDIRK method of order two.
+    std::vector<std::string> state_variables_0 = {"s", "h", "d"};
+    std::vector<fvm_value_type> t0_0_values = {0.5, 0.2, 0.3};
+    std::vector<fvm_value_type> t1_0_values = {0.352208955, 0.513709705, 0.134081340};
+
+    std::vector<std::string> state_variables_1 = {"a", "b", "c"};
+    std::vector<fvm_value_type> t0_1_values = {0.2, 0.3, 0.5};
+    std::vector<fvm_value_type> t1_1_values = {0.223333568, 0.311666784, 0.488333216};
+
+    run_test<gpu::backend>("test0_kin_sdirk2", state_variables_0, {}, t0_0_values, t1_0_values, 0.5);
+    run_test<gpu::backend>("test2_kin_sdirk2", state_variables_1, {}, t0_1_values, t1_1_values, 0.025);
+}
+
+TEST(mech_kinetic_gpu, kinetic_expm) {
+    // One step of the exact solution, with and without compartment scaling.
+    std::vector<std::string> state_variables = {"s", "h", "d"};
+    std::vector<fvm_value_type> t0_values = {0.5, 0.2, 0.3};
+    std::vector<fvm_value_type> t1_0_values = {0.351608706, 0.508430880, 0.139960415};
+    std::vector<fvm_value_type> t1_1_values = {0.275235121, 0.711483836, 0.013281043};
+
+    run_test<gpu::backend>("test0_kin_expm", state_variables, {}, t0_values, t1_0_values, 0.5);
+    run_test<gpu::backend>("test1_kin_expm", state_variables, {}, t0_values, t1_1_values, 0.5);
+}
+
 TEST(mech_linear_gpu, linear_system) {
     std::vector<std::string> state_variables = {"h", "s", "d"};
     std::vector<fvm_value_type> values = {0.5, 0.2, 0.3};
@@ -116,6 +116,9 @@ TEST(test_cell_labels_and_gids, build) {
 
 TEST(test_label_resolution, policies) {
     using vec = std::vector<cell_lid_type>;
+    auto partition = [](const label_resolution_map::range_set& r) {
+        return vec(r.ranges_partition.begin(), r.ranges_partition.end());
+    };
     {
         std::vector<cell_gid_type> gids = {0, 1, 2, 3, 4};
         std::vector<cell_size_type> sizes = {1, 0, 1, 2, 3};
@@ -130,7 +133,7 @@ TEST(test_label_resolution, policies) {
         auto rset = res_map.at(0, "l0_0");
         EXPECT_EQ(1u, rset.ranges.size());
         EXPECT_EQ(lid_range(0, 1), rset.ranges.front());
-        EXPECT_EQ((vec{0u, 1u}), rset.ranges_partition);
+        EXPECT_EQ((vec{0u, 1u}), partition(rset));
 
         // gid 1
         EXPECT_EQ(0u, res_map.count(1, "l0_0"));
@@ -140,34 +143,34 @@ TEST(test_label_resolution, policies) {
         rset = res_map.at(2, "l2_0");
         EXPECT_EQ(1u, rset.ranges.size());
         EXPECT_EQ(lid_range(0, 3), rset.ranges.front());
-        EXPECT_EQ((vec{0u, 3u}), rset.ranges_partition);
+        EXPECT_EQ((vec{0u, 3u}), partition(rset));
 
         // gid 3
         EXPECT_EQ(1u, res_map.count(3, "l3_0"));
         rset = res_map.at(3, "l3_0");
         EXPECT_EQ(1u, rset.ranges.size());
         EXPECT_EQ(lid_range(1, 2), rset.ranges.front());
-        EXPECT_EQ((vec{0u, 1u}), rset.ranges_partition);
+        EXPECT_EQ((vec{0u, 1u}), partition(rset));
 
         EXPECT_EQ(1u, res_map.count(3, "l3_1"));
         rset = res_map.at(3, "l3_1");
         EXPECT_EQ(1u, rset.ranges.size());
         EXPECT_EQ(lid_range(4, 10), rset.ranges.front());
-        EXPECT_EQ((vec{0u, 6u}), rset.ranges_partition);
+        EXPECT_EQ((vec{0u, 6u}), partition(rset));
 
         // gid 4
         EXPECT_EQ(1u, res_map.count(4, "l4_0"));
         rset = res_map.at(4, "l4_0");
         EXPECT_EQ(1u, rset.ranges.size());
         EXPECT_EQ(lid_range(5, 6), rset.ranges.front());
-        EXPECT_EQ((vec{0u, 1u}), rset.ranges_partition);
+        EXPECT_EQ((vec{0u, 1u}), partition(rset));
 
         EXPECT_EQ(1u, res_map.count(4, "l4_1"));
         rset = res_map.at(4, "l4_1");
         EXPECT_EQ(2u, rset.ranges.size());
         EXPECT_EQ(lid_range(8, 11), rset.ranges.at(0));
         EXPECT_EQ(lid_range(12, 14), rset.ranges.at(1));
-        EXPECT_EQ((vec{0u, 3u, 5u}), rset.ranges_partition);
+        EXPECT_EQ((vec{0u, 3u, 5u}), partition(rset));
 
         // Check lid resolution
         auto lid_resolver = arb::resolver(&res_map);
@@ -244,14 +247,14 @@ TEST(test_label_resolution, policies) {
         auto rset = res_map.at(0, "l0_1");
         EXPECT_EQ(1u, rset.ranges.size());
         EXPECT_EQ(lid_range(0, 3), rset.ranges.front());
-        EXPECT_EQ((vec{0u, 3u}), rset.ranges_partition);
+        EXPECT_EQ((vec{0u, 3u}), partition(rset));
 
         EXPECT_EQ(1u, res_map.count(0, "l0_0"));
         rset = res_map.at(0, "l0_0");
         EXPECT_EQ(2u, rset.ranges.size());
         EXPECT_EQ(lid_range(0, 1), rset.ranges.at(0));
         EXPECT_EQ(lid_range(1, 3), rset.ranges.at(1));
-        EXPECT_EQ((vec{0u, 1u, 3u}), rset.ranges_partition);
+        EXPECT_EQ((vec{0u, 1u, 3u}), partition(rset));
 
         // gid 1
         EXPECT_EQ(0u, res_map.count(1, "l0_1"));
@@ -262,21 +265,21 @@ TEST(test_label_resolution, policies) {
         EXPECT_EQ(2u, rset.ranges.size());
         EXPECT_EQ(lid_range(4, 6), rset.ranges.at(0));
         EXPECT_EQ(lid_range(9, 12), rset.ranges.at(1));
-        EXPECT_EQ((vec{0u, 2u, 5u}), rset.ranges_partition);
+        EXPECT_EQ((vec{0u, 2u, 5u}), partition(rset));
 
         EXPECT_EQ(1u, res_map.count(2, "l2_1"));
         rset = res_map.at(2, "l2_1");
         EXPECT_EQ(2u, rset.ranges.size());
         EXPECT_EQ(lid_range(1, 2), rset.ranges.at(0));
         EXPECT_EQ(lid_range(0, 1), rset.ranges.at(1));
-        EXPECT_EQ((vec{0u, 1u, 2u}), rset.ranges_partition);
+        EXPECT_EQ((vec{0u, 1u, 2u}), partition(rset));
 
         EXPECT_EQ(1u, res_map.count(2, "l2_2"));
         rset = res_map.at(2, "l2_2");
         EXPECT_EQ(2u, rset.ranges.size());
         EXPECT_EQ(lid_range(5, 5), rset.ranges.at(0));
         EXPECT_EQ(lid_range(22, 23), rset.ranges.at(1));
-        EXPECT_EQ((vec{0u, 0u, 1u}), rset.ranges_partition);
+        EXPECT_EQ((vec{0u, 0u, 1u}), partition(rset));
 
         // Check lid resolution
         auto lid_resolver = arb::resolver(&res_map);
@@ -316,3 +319,37 @@ TEST(test_label_resolution, policies) {
     }
 }
 
+
+TEST(test_label_resolution, interned_labels) {
+    // Cells given out of gid order, sharing labels.
+    std::vector<cell_gid_type> gids = {7, 3, 5};
+    std::vector<cell_size_type> sizes = {2, 2, 0};
+    std::vector<cell_tag_type> labels = {"syn", "detector", "syn", "syn"};
+    std::vector<lid_range> ranges = {{0, 2}, {0, 1}, {3, 4}, {6, 8}};
+
+    auto res_map = label_resolution_map(cell_labels_and_gids({sizes, labels, ranges}, gids));
+
+    EXPECT_EQ(label_resolution_map::npos, res_map.find(5, "syn"));
+    EXPECT_EQ(label_resolution_map::npos, res_map.find(3, "detector"));
+    EXPECT_EQ(label_resolution_map::npos, res_map.find(7, "soma"));
+    EXPECT_EQ(label_resolution_map::npos, res_map.find(4, "syn"));
+    EXPECT_THROW(res_map.at(3, "detector"), std::out_of_range);
+
+    auto i = res_map.find(3, "syn");
+    ASSERT_NE(label_resolution_map::npos, i);
+    auto rset = res_map.entry(i);
+    ASSERT_EQ(2u, rset.ranges.size());
+    EXPECT_EQ(lid_range(3, 4), rset.ranges[0]);
+    EXPECT_EQ(lid_range(6, 8), rset.ranges[1]);
+    EXPECT_EQ(3u, rset.size());
+
+    EXPECT_EQ(1u, res_map.at(7, "detector").size());
+    EXPECT_EQ(2u, res_map.at(7, "syn").size());
+
+    auto lid_resolver = arb::resolver(&res_map);
+    EXPECT_EQ(3u, lid_resolver.resolve({3, "syn", lid_selection_policy::round_robin}));
+    EXPECT_EQ(6u, lid_resolver.resolve({3, "syn", lid_selection_policy::round_robin}));
+    EXPECT_EQ(7u, lid_resolver.resolve({3, "syn", lid_selection_policy::round_robin}));
+    EXPECT_EQ(0u, lid_resolver.resolve({7, "syn", lid_selection_policy::round_robin}));
+    EXPECT_EQ(3u, lid_resolver.resolve({3, "syn", lid_selection_policy::round_robin}));
+}
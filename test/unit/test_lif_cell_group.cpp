@@ -1,5 +1,9 @@
 #include "../gtest.h"
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 #include <arbor/arbexcept.hpp>
 #include <arbor/cable_cell.hpp>
 #include <arbor/domain_decomposition.hpp>
@@ -11,6 +15,7 @@
 #include <arbor/spike_source_cell.hpp>
 
 #include "lif_cell_group.hpp"
+#include "util/span.hpp"
 
 using namespace arb;
 // Simple ring network of LIF neurons.
@@ -221,3 +226,79 @@ TEST(lif_cell_group, ring)
     }
 }
 
+
+TEST(lif_cell_group, binned) {
+    // With regular binning, cells are updated on the grid of the binning
+    // interval; events at grid points give the spikes of the exact update.
+    auto context = make_context();
+    auto recipe = ring_recipe(99, 1000, 1);
+    auto decomp = partition_load_balance(recipe, context);
+
+    auto run = [&](binning_kind policy) {
+        simulation sim(recipe, decomp, context);
+        sim.set_binning_policy(policy, 0.125);
+
+        std::vector<spike> spikes;
+        sim.set_global_spike_callback(
+            [&spikes](const std::vector<spike>& s) { spikes.insert(spikes.end(), s.begin(), s.end()); });
+        sim.run(100, 0.01);
+        std::sort(spikes.begin(), spikes.end(),
+            [](spike a, spike b) { return a.time<b.time || (a.time==b.time && a.source<b.source); });
+        return spikes;
+    };
+
+    auto exact = run(binning_kind::none);
+    EXPECT_EQ(100u, exact.size());
+    EXPECT_EQ(exact, run(binning_kind::regular));
+}
+
+TEST(lif_cell_group, binned_refractory) {
+    path_recipe recipe(2, 1000, 0.1);
+
+    auto context = make_context();
+    auto decomp = partition_load_balance(recipe, context);
+    simulation sim(recipe, decomp, context);
+    sim.set_binning_policy(binning_kind::regular, 0.125);
+
+    // The event at 1.1 is applied at 1.125, in the refractory period of the
+    // spike at 0, and is ignored.
+    cse_vector events;
+    events.push_back({0, {{0, 0, 1000}}});
+    events.push_back({0, {{0, 1.1, 1000}}});
+    events.push_back({0, {{0, 50, 1000}}});
+    sim.inject_events(events);
+
+    std::vector<spike> spikes;
+    sim.set_global_spike_callback(
+        [&spikes](const std::vector<spike>& s) { spikes.insert(spikes.end(), s.begin(), s.end()); });
+    sim.run(100, 0.01);
+
+    // The second cell spikes at the first step after the delay of 0.1.
+    std::vector<std::pair<cell_gid_type, time_type>> expected = {{0, 0}, {1, 0.125}, {0, 50}, {1, 50.125}};
+    ASSERT_EQ(expected.size(), spikes.size());
+    std::sort(spikes.begin(), spikes.end(), [](spike a, spike b) { return a.time<b.time; });
+    for (auto i: util::count_along(expected)) {
+        EXPECT_EQ(expected[i].first, spikes[i].source.gid);
+        EXPECT_EQ(expected[i].second, spikes[i].time);
+    }
+}
+
+TEST(lif_cell_group, reset) {
+    // Resetting the simulation restores the initial membrane potentials:
+    // a sub-threshold event before the reset does not add to one after it.
+    path_recipe recipe(1, 100, 0.1);
+
+    auto context = make_context();
+    auto decomp = partition_load_balance(recipe, context);
+    simulation sim(recipe, decomp, context);
+
+    std::size_t n_spikes = 0;
+    sim.set_global_spike_callback([&n_spikes](const std::vector<spike>& s) { n_spikes += s.size(); });
+
+    for (int i = 0; i<2; ++i) {
+        sim.reset();
+        sim.inject_events({{0, {{0, 1, 150}}}});
+        sim.run(10, 0.01);
+    }
+    EXPECT_EQ(0u, n_spikes);
+}
@@ -78,6 +78,49 @@ TEST(local_context, gather_spikes)
     EXPECT_EQ(part[1], spikes.size());
 }
 
+TEST(local_context, gather_spikes_async)
+{
+    arb::distributed_context ctx = arb::local_context();
+    using svec = std::vector<arb::spike>;
+
+    svec spikes = {
+        {{0u,3u}, 42.f},
+        {{1u,2u}, 42.f},
+        {{2u,1u}, 42.f},
+        {{3u,0u}, 42.f},
+    };
+
+    auto request = ctx.gather_spikes_async(spikes);
+    EXPECT_TRUE(request.pending());
+    EXPECT_TRUE(request.test());
+
+    // Local spikes are copied on initiating the gather.
+    svec expected = spikes;
+    spikes.clear();
+
+    auto s = request.wait();
+    EXPECT_FALSE(request.pending());
+
+    auto& part = s.partition();
+    EXPECT_EQ(s.values(), expected);
+    EXPECT_EQ(part.size(), 2u);
+    EXPECT_EQ(part[0], 0u);
+    EXPECT_EQ(part[1], expected.size());
+}
+
+TEST(local_context, sum_async)
+{
+    arb::distributed_context ctx = arb::local_context();
+
+    std::vector<double> values = {1., 2., 3.};
+    auto request = ctx.sum_async(values, 0);
+    EXPECT_TRUE(request.pending());
+    EXPECT_TRUE(request.test());
+
+    EXPECT_EQ(values, request.wait());
+    EXPECT_FALSE(request.pending());
+}
+
 TEST(local_context, gather_gids)
 {
     arb::local_context ctx;
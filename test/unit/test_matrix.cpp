@@ -1,4 +1,6 @@
+#include <cmath>
 #include <numeric>
+#include <random>
 #include <vector>
 
 #include "../gtest.h"
@@ -185,3 +187,276 @@ TEST(matrix, zero_diagonal_assembled)
     EXPECT_TRUE(testing::seq_almost_eq<double>(expected, x));
 }
 
+
+TEST(matrix, solve_shared_structure)
+{
+    // Cells that share a structure are solved together; check against the
+    // solution of each cell on its own, with a zero-dt cell among them.
+
+    using util::make_span;
+
+    // A branched cell of 7 CVs, and an unbranched cell of 4 CVs.
+    std::vector<index_type> branched = {0, 0, 1, 1, 0, 4, 4};
+    std::vector<index_type> unbranched = {0, 0, 1, 2};
+
+    std::vector<std::vector<index_type>> structures;
+    for (auto k: make_span(11)) {
+        structures.push_back(k%4==3? unbranched: branched);
+    }
+
+    std::vector<index_type> p, divs = {0};
+    for (auto& s: structures) {
+        index_type first = divs.back();
+        for (auto j: s) p.push_back(first+j);
+        divs.push_back(first+s.size());
+    }
+    const unsigned n = p.size();
+
+    std::minstd_rand gen(2);
+    std::uniform_real_distribution<value_type> dist(0.5, 1.5);
+    vvec d(n), u(n), rhs(n);
+    for (auto i: make_span(n)) {
+        d[i] = 4+dist(gen);
+        u[i] = -dist(gen);
+        rhs[i] = dist(gen);
+    }
+    // Zero diagonal: cell 5 is left as is.
+    for (auto i: make_span(divs[5], divs[6])) d[i] = 0;
+
+    matrix_type m(p, divs, vvec(n), vvec(n), vvec(n), std::vector<index_type>(structures.size(), 0));
+    util::assign(m.state_.d, d);
+    util::assign(m.state_.u, u);
+    util::assign(m.state_.rhs, rhs);
+
+    auto x = array(n, 0);
+    m.solve(x);
+
+    for (auto c: make_span(structures.size())) {
+        auto first = divs[c], last = divs[c+1];
+        auto nc = last-first;
+
+        matrix_type single(structures[c], {0, nc}, vvec(nc), vvec(nc), vvec(nc), {0});
+        util::assign(single.state_.d, util::subrange_view(d, first, last));
+        util::assign(single.state_.u, util::subrange_view(u, first, last));
+        util::assign(single.state_.rhs, util::subrange_view(rhs, first, last));
+
+        auto y = array(nc, 0);
+        single.solve(y);
+
+        EXPECT_TRUE(testing::seq_almost_eq<double>(y, util::subrange_view(x, first, last)));
+    }
+}
+
+TEST(matrix, assemble_uniform_dt)
+{
+    // Assembly with the same dt in every integration domain takes a
+    // vectorized path; check it and the per-domain path against the
+    // assembly formula.
+
+    using util::make_span;
+
+    const unsigned ncell = 5, ncv = 9, n = ncell*ncv;
+    std::vector<index_type> p, divs = {0}, intdom;
+    for (auto c: make_span(ncell)) {
+        index_type first = divs.back();
+        p.push_back(first);
+        for (auto j: make_span(1, ncv)) p.push_back(first+j-1);
+        divs.push_back(first+ncv);
+        intdom.push_back(c);
+    }
+
+    std::minstd_rand gen(3);
+    std::uniform_real_distribution<value_type> dist(0.5, 1.5);
+    auto random_vec = [&]() { vvec v(n); for (auto& x: v) x = dist(gen); return v; };
+
+    vvec Cm = random_vec(), g = random_vec(), area = random_vec();
+    matrix_type m(p, divs, Cm, g, area, intdom);
+
+    array v(n), i(n), mg(n);
+    util::assign(v, random_vec());
+    util::assign(i, random_vec());
+    util::assign(mg, random_vec());
+
+    for (value_type dt1: {0.025, 0.01}) {
+        array dt(ncell, 0.025);
+        dt[1] = dt1;
+        m.assemble(dt, v, i, mg);
+
+        const auto& A = m.state_;
+        for (auto c: make_span(ncell)) {
+            for (auto k: make_span(divs[c], divs[c+1])) {
+                auto gi = 1e-3/dt[c]*Cm[k] + 1e-3*area[k]*mg[k];
+                EXPECT_NEAR(gi + A.invariant_d[k], A.d[k], 1e-12);
+                EXPECT_NEAR(gi*v[k] - 1e-3*area[k]*i[k], A.rhs[k], 1e-12);
+            }
+        }
+    }
+}
+
+TEST(matrix, solve_parallel_subtrees)
+{
+    // A large cell is solved by subtrees on the task system; check against
+    // the serial solve, for a random tree with a long unbranched trunk.
+
+    using util::make_span;
+
+    const index_type n = 20000;
+    std::minstd_rand gen(4);
+    std::vector<index_type> p(n, 0);
+    for (auto i: make_span(1, n)) {
+        p[i] = i<500? i-1: std::uniform_int_distribution<index_type>(std::max(0, i-50), i-1)(gen);
+    }
+
+    std::uniform_real_distribution<value_type> dist(0.5, 1.5);
+    vvec d(n), u(n), rhs(n);
+    for (auto i: make_span(n)) {
+        d[i] = 4+dist(gen);
+        u[i] = -dist(gen);
+        rhs[i] = dist(gen);
+    }
+
+    auto solve = [&](threading::task_system* ts) {
+        matrix_type m(p, {0, n}, vvec(n), vvec(n), vvec(n), {0});
+        m.set_task_system(ts);
+        util::assign(m.state_.d, d);
+        util::assign(m.state_.u, u);
+        util::assign(m.state_.rhs, rhs);
+
+        auto x = array(n, 0);
+        m.solve(x);
+        return x;
+    };
+
+    threading::task_system ts(4);
+    auto expected = solve(nullptr);
+    auto x = solve(&ts);
+    EXPECT_TRUE(testing::seq_almost_eq<double>(expected, x));
+}
+
+TEST(matrix, assemble_solve)
+{
+    // The fused assemble and solve must agree with assemble followed by
+    // solve, for cells solved alone, in blocks of shared structure and by
+    // subtrees, with equal and differing dt, and with the tiles and blocks
+    // of cells solved serially or in parallel.
+
+    using util::make_span;
+
+    std::minstd_rand gen(5);
+    std::vector<index_type> p, divs = {0};
+    auto add_cell = [&](index_type n, bool random) {
+        index_type first = divs.back();
+        p.push_back(first);
+        for (auto j: make_span(1, n)) {
+            p.push_back(first + (random? std::uniform_int_distribution<index_type>(0, j-1)(gen): j-1));
+        }
+        divs.push_back(first+n);
+    };
+    for (auto k: make_span(9)) add_cell(5+k, true);
+    for (unsigned j = 0; j<6; ++j) add_cell(7, false);
+    add_cell(10000, true);
+    const unsigned ncell = divs.size()-1, n = p.size();
+
+    std::uniform_real_distribution<value_type> dist(0.5, 1.5);
+    auto random_vec = [&](unsigned m) { vvec v(m); for (auto& x: v) x = dist(gen); return v; };
+
+    std::vector<index_type> intdom(ncell);
+    std::iota(intdom.begin(), intdom.end(), 0);
+    vvec Cm = random_vec(n), g = random_vec(n), area = random_vec(n);
+    array v(n), i(n), mg(n);
+    util::assign(v, random_vec(n));
+    util::assign(i, random_vec(n));
+    util::assign(mg, random_vec(n));
+
+    threading::task_system ts(2);
+    for (bool parallel: {false, true}) {
+        for (value_type dt1: {0.025, 0.01, 0.}) {
+            array dt(ncell, 0.025);
+            dt[1] = dt1;
+
+            matrix_type m(p, divs, Cm, g, area, intdom);
+            m.set_task_system(&ts);
+            m.set_parallel_cells(parallel);
+            array expected(n, 0);
+            m.assemble(dt, v, i, mg);
+            m.solve(expected);
+
+            array x = v;
+            m.assemble_solve(dt, x, i, mg);
+            EXPECT_TRUE(testing::seq_almost_eq<double>(expected, x));
+        }
+    }
+}
+
+TEST(matrix, crank_nicolson)
+{
+    // A Crank–Nicolson step of dt is an implicit Euler step of dt/2,
+    // extrapolated to the end of the step, for cells solved alone, in
+    // blocks of shared structure and by subtrees.
+
+    using util::make_span;
+
+    std::minstd_rand gen(7);
+    std::vector<index_type> p, divs = {0};
+    auto add_cell = [&](index_type n, bool random) {
+        index_type first = divs.back();
+        p.push_back(first);
+        for (auto j: make_span(1, n)) {
+            p.push_back(first + (random? std::uniform_int_distribution<index_type>(0, j-1)(gen): j-1));
+        }
+        divs.push_back(first+n);
+    };
+    for (auto k: make_span(9)) add_cell(5+k, true);
+    for (unsigned j = 0; j<6; ++j) add_cell(7, false);
+    add_cell(10000, true);
+    const unsigned ncell = divs.size()-1, n = p.size();
+
+    std::uniform_real_distribution<value_type> dist(0.5, 1.5);
+    auto random_vec = [&](unsigned m) { vvec v(m); for (auto& x: v) x = dist(gen); return v; };
+
+    std::vector<index_type> intdom(ncell);
+    std::iota(intdom.begin(), intdom.end(), 0);
+    vvec Cm = random_vec(n), g = random_vec(n), area = random_vec(n);
+    array v(n), i(n), mg(n);
+    util::assign(v, random_vec(n));
+    util::assign(i, random_vec(n));
+    util::assign(mg, random_vec(n));
+
+    threading::task_system ts(2);
+    for (value_type dt1: {0.025, 0.01, 0.}) {
+        array dt(ncell, 0.025), half_dt(ncell, 0.0125);
+        dt[1] = dt1;
+        half_dt[1] = dt1/2;
+
+        matrix_type m(p, divs, Cm, g, area, intdom);
+        m.set_task_system(&ts);
+        array expected(n, 0);
+        m.assemble(half_dt, v, i, mg);
+        m.solve(expected);
+        for (auto k: make_span(n)) expected[k] = 2*expected[k] - v[k];
+
+        array x = v;
+        m.set_crank_nicolson(true);
+        m.assemble_solve(dt, x, i, mg);
+
+        // The extrapolation doubles the rounding error of the solution, so
+        // compare to a relative tolerance rather than a few ulps.
+        for (auto k: make_span(n)) {
+            EXPECT_NEAR(expected[k], x[k], 1e-12*std::abs(expected[k]));
+        }
+    }
+
+    // A passive CV relaxes to its reversal potential with the
+    // Crank–Nicolson amplification factor.
+    {
+        const value_type C = 2, a = 3, gl = 0.5, e = -65, v0 = 10, h = 0.1;
+        matrix_type m({0}, {0, 1}, {C}, {0}, {a}, {0});
+        m.set_crank_nicolson(true);
+
+        array x(1, v0), cur(1, gl*(v0-e)), cond(1, gl), dt(1, h);
+        m.assemble_solve(dt, x, cur, cond);
+
+        auto r = (2*C/h - a*gl)/(2*C/h + a*gl);
+        EXPECT_NEAR(e + r*(v0-e), x[0], 1e-12);
+    }
+}
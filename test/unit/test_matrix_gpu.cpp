@@ -158,3 +158,91 @@ TEST(matrix, backends)
 
     EXPECT_LE(max_diff_fine, 1e-12);
 }
+
+// test that the fused small cell path of the fine solver matches the flat solver
+TEST(matrix, small_cells)
+{
+    using T = fvm_value_type;
+    using I = fvm_index_type;
+
+    using state_flat = gpu::matrix_state_flat<T, I>;
+    using state_fine = gpu::matrix_state_fine<T, I>;
+
+    using gpu_array  = memory::device_vector<T>;
+
+    // Cells of 3 to 64 CVs, each a main branch with a side branch from its
+    // midpoint.
+    const int num_mtx = 300;
+    const int max_size = gpu::impl::small_cell_max_size();
+
+    std::vector<I> p;
+    std::vector<I> cell_cv_divs;
+    std::vector<I> cell_to_intdom;
+    for (auto m=0; m<num_mtx; ++m) {
+        I first = p.size();
+        I n = 3 + m%(max_size-2);
+        I mid = n/2;
+        p.push_back(first);
+        for (I i=1; i<n; ++i) {
+            p.push_back(first + (i==mid+1? mid/2: i-1));
+        }
+        cell_cv_divs.push_back(first);
+        cell_to_intdom.push_back(m);
+    }
+    cell_cv_divs.push_back(p.size());
+
+    auto group_size = cell_cv_divs.back();
+
+    auto gen  = std::mt19937();
+    gen.seed(100);
+    auto dist = std::uniform_real_distribution<T>(1, 200);
+
+    std::vector<T> Cm(group_size);
+    std::vector<T> g(group_size);
+    std::vector<T> v(group_size);
+    std::vector<T> i(group_size);
+    std::vector<T> mg(group_size);
+    std::vector<T> area(group_size, 1e3);
+
+    std::generate(Cm.begin(), Cm.end(), [&](){return dist(gen);});
+    std::generate(g.begin(), g.end(), [&](){return dist(gen);});
+    std::generate(v.begin(), v.end(), [&](){return dist(gen);});
+    std::generate(i.begin(), i.end(), [&](){return dist(gen);});
+    std::generate(mg.begin(), mg.end(), [&](){return dist(gen);});
+
+    auto flat = state_flat(p, cell_cv_divs, Cm, g, area, cell_to_intdom);
+    auto fine = state_fine(p, cell_cv_divs, Cm, g, area, cell_to_intdom);
+    EXPECT_TRUE(fine.small_cells);
+
+    // Every tenth cell has finished integrating, and keeps its voltage.
+    std::vector<T> dt(num_mtx, 0);
+    auto dt_dist = std::uniform_real_distribution<T>(0.01, 0.02);
+    for (auto m=0; m<num_mtx; ++m) {
+        dt[m] = m%10? dt_dist(gen): 0;
+    }
+
+    auto gpu_dt = on_gpu(dt);
+    auto gpu_v = on_gpu(v);
+    auto gpu_i = on_gpu(i);
+    auto gpu_mg = on_gpu(mg);
+
+    auto x_flat_d = gpu_array(group_size);
+    flat.assemble(gpu_dt, gpu_v, gpu_i, gpu_mg);
+    flat.solve(x_flat_d);
+
+    auto x_fine_d = on_gpu(v);
+    fine.assemble_solve(gpu_dt, x_fine_d, gpu_i, gpu_mg);
+
+    // Both perform the same operations in the same order.
+    std::vector<T> x_flat = assign_from(on_host(x_flat_d));
+    std::vector<T> x_fine = assign_from(on_host(x_fine_d));
+    EXPECT_EQ(x_flat, x_fine);
+
+    // A cell larger than the limit uses the packed solver.
+    std::vector<I> p_large(max_size+1);
+    std::iota(p_large.begin(), p_large.end(), -1);
+    p_large[0] = 0;
+    std::vector<T> ones(max_size+1, 1);
+    auto large = state_fine(p_large, {0, max_size+1}, ones, ones, ones, {0});
+    EXPECT_FALSE(large.small_cells);
+}
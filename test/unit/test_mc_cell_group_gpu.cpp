@@ -1,13 +1,21 @@
 #include "../gtest.h"
 
+#include <memory>
+#include <vector>
+
 #include <arbor/common_types.hpp>
+#include <arbor/sampling.hpp>
+#include <arbor/schedule.hpp>
+#include <arbor/simple_sampler.hpp>
 #include <arborio/label_parse.hpp>
 #include <arborenv/gpu_env.hpp>
 
+#include "connection.hpp"
 #include "epoch.hpp"
 #include "execution_context.hpp"
 #include "fvm_lowered_cell.hpp"
 #include "mc_cell_group.hpp"
+#include "util/rangeutil.hpp"
 
 #include "../common_cells.hpp"
 #include "../simple_recipes.hpp"
@@ -51,3 +59,140 @@ TEST(mc_cell_group, gpu_test)
     // fixed stimulus over 50 ms
     EXPECT_EQ(4u, group.spikes().size());
 }
+
+TEST(mc_cell_group, gpu_step_graph)
+{
+    struct graph_recipe: cable1d_recipe {
+        using cable1d_recipe::cable1d_recipe;
+        void use_step_graph() { cell_gprop_.gpu_step_graph = true; }
+    };
+
+    cable_cell cell = make_cell();
+    auto rec = graph_recipe({cell});
+    rec.nernst_ion("na");
+    rec.nernst_ion("ca");
+    rec.nernst_ion("k");
+
+    cell_label_range srcs, tgts;
+    mc_cell_group plain{{0}, rec, srcs, tgts, lowered_cell()};
+    rec.use_step_graph();
+    mc_cell_group graph{{0}, rec, srcs, tgts, lowered_cell()};
+
+    // Replaying recorded steps must reproduce the spikes of stepwise
+    // integration, over several epochs and an odd number of steps.
+    for (unsigned i = 0; i<5; ++i) {
+        epoch ep(i, 10.*i, 10.*(i+1));
+        plain.advance(ep, 0.0125, {});
+        graph.advance(ep, 0.0125, {});
+    }
+
+    ASSERT_EQ(plain.spikes().size(), graph.spikes().size());
+    for (std::size_t i = 0; i<plain.spikes().size(); ++i) {
+        EXPECT_EQ(plain.spikes()[i].time, graph.spikes()[i].time);
+    }
+}
+
+TEST(mc_cell_group, gpu_spike_delivery)
+{
+    struct delivery_recipe: cable1d_recipe {
+        using cable1d_recipe::cable1d_recipe;
+        void use_spike_delivery() { cell_gprop_.gpu_spike_delivery = true; }
+    };
+
+    soma_cell_builder builder(12.6157/2.0);
+    builder.add_branch(0, 200, 0.5, 0.5, 101, "dend");
+    auto d = builder.make_cell();
+    d.decorations.paint("soma"_lab, "hh");
+    d.decorations.paint("dend"_lab, "pas");
+    d.decorations.place(builder.location({1, 0.5}), "expsyn", "syn0");
+    d.decorations.place(builder.location({0, 0}), threshold_detector{0}, "detector0");
+
+    auto rec = delivery_recipe({cable_cell(d)});
+    rec.nernst_ion("na");
+    rec.nernst_ion("ca");
+    rec.nernst_ion("k");
+
+    cell_label_range srcs, tgts;
+    mc_cell_group host{{0}, rec, srcs, tgts, lowered_cell()};
+    rec.use_spike_delivery();
+    mc_cell_group device{{0}, rec, srcs, tgts, lowered_cell()};
+    ASSERT_FALSE(host.delivers_spikes());
+    ASSERT_TRUE(device.delivers_spikes());
+
+    // Spikes from source {7, 0} reach the synapse after 12 ms; the spikes of
+    // each epoch are given to the device group before the next epoch, and
+    // their events are kept on the device until they are due.
+    const float weight = 0.2f, delay = 12.f;
+    device.set_connections({connection({7, 0}, 0, weight, delay, 0)});
+
+    std::vector<spike> spikes;
+    for (double t = 0.5; t<38; t += 7.5) {
+        spikes.push_back({{7, 0}, t});
+    }
+    spikes.push_back({{8, 0}, 1.0});
+
+    std::vector<pse_vector> lanes(1);
+    for (unsigned i = 0; i<5; ++i) {
+        epoch ep(i, 10.*i, 10.*(i+1));
+
+        std::vector<spike> batch;
+        lanes[0].clear();
+        for (auto& s: spikes) {
+            if (s.time>=ep.t0-10 && s.time<ep.t0) batch.push_back(s);
+            if (s.source.gid==7 && s.time+delay>=ep.t0) lanes[0].push_back({0, s.time+delay, weight});
+        }
+        device.enqueue_spikes(std::make_shared<const std::vector<spike>>(std::move(batch)));
+
+        host.advance(ep, 0.025, util::subrange_view(lanes, 0, 1));
+        device.advance(ep, 0.025, {});
+    }
+
+    ASSERT_FALSE(host.spikes().empty());
+    ASSERT_EQ(host.spikes().size(), device.spikes().size());
+    for (std::size_t i = 0; i<host.spikes().size(); ++i) {
+        EXPECT_DOUBLE_EQ(host.spikes()[i].time, device.spikes()[i].time);
+    }
+}
+
+TEST(mc_cell_group, gpu_sample_buffer)
+{
+    struct buffer_recipe: cable1d_recipe {
+        using cable1d_recipe::cable1d_recipe;
+        void use_sample_buffer(std::size_t n) { cell_gprop_.gpu_sample_buffer_size = n; }
+    };
+
+    cable_cell cell = make_cell();
+    auto rec = buffer_recipe({cell});
+    rec.nernst_ion("na");
+    rec.nernst_ion("ca");
+    rec.nernst_ion("k");
+    rec.add_probe(0, 0, cable_probe_membrane_voltage{mlocation{0, 0.5}});
+
+    cell_label_range srcs, tgts;
+    mc_cell_group plain{{0}, rec, srcs, tgts, lowered_cell()};
+    // Each epoch takes 100 samples: samplers are called every second epoch.
+    rec.use_sample_buffer(150);
+    mc_cell_group buffered{{0}, rec, srcs, tgts, lowered_cell()};
+
+    trace_vector<double> plain_trace, buffered_trace;
+    plain.add_sampler(0, all_probes, regular_schedule(0.1), make_simple_sampler(plain_trace), sampling_policy::lax);
+    buffered.add_sampler(0, all_probes, regular_schedule(0.1), make_simple_sampler(buffered_trace), sampling_policy::lax);
+
+    for (unsigned i = 0; i<5; ++i) {
+        epoch ep(i, 10.*i, 10.*(i+1));
+        plain.advance(ep, 0.025, {});
+        buffered.advance(ep, 0.025, {});
+    }
+
+    ASSERT_EQ(1u, plain_trace.size());
+    ASSERT_EQ(1u, buffered_trace.size());
+    EXPECT_EQ(500u, plain_trace[0].size());
+    EXPECT_EQ(400u, buffered_trace[0].size());
+
+    buffered.flush_samples();
+    ASSERT_EQ(plain_trace[0].size(), buffered_trace[0].size());
+    for (std::size_t i = 0; i<plain_trace[0].size(); ++i) {
+        EXPECT_EQ(plain_trace[0][i].t, buffered_trace[0][i].t);
+        EXPECT_EQ(plain_trace[0][i].v, buffered_trace[0][i].v);
+    }
+}
@@ -34,10 +34,11 @@ void run_celsius_test() {
     std::vector<fvm_value_type> temp(ncv, temperature_K);
     std::vector<fvm_value_type> diam(ncv, 1.);
     std::vector<fvm_value_type> vinit(ncv, -65);
+    std::vector<fvm_index_type> detector_divs = {};
     std::vector<fvm_index_type> src_to_spike = {};
 
     auto shared_state = std::make_unique<typename backend::shared_state>(
-        ncell, ncell, 0, cv_to_intdom, cv_to_intdom, gj, vinit, temp, diam, src_to_spike, celsius_test->data_alignment());
+        ncell, ncell, detector_divs, cv_to_intdom, cv_to_intdom, gj, vinit, temp, diam, src_to_spike, celsius_test->data_alignment());
 
     mechanism_layout layout;
     mechanism_overrides overrides;
@@ -82,6 +83,7 @@ void run_diam_test() {
     std::vector<fvm_value_type> temp(ncv, 300.);
     std::vector<fvm_value_type> vinit(ncv, -65);
     std::vector<fvm_value_type> diam(ncv);
+    std::vector<fvm_index_type> detector_divs = {};
     std::vector<fvm_index_type> src_to_spike = {};
 
     mechanism_layout layout;
@@ -95,7 +97,7 @@ void run_diam_test() {
     }
 
     auto shared_state = std::make_unique<typename backend::shared_state>(
-            ncell, ncell, 0, cv_to_intdom, cv_to_intdom, gj, vinit, temp, diam, src_to_spike, celsius_test->data_alignment());
+            ncell, ncell, detector_divs, cv_to_intdom, cv_to_intdom, gj, vinit, temp, diam, src_to_spike, celsius_test->data_alignment());
 
 
     shared_state->instantiate(*celsius_test, 0, overrides, layout);
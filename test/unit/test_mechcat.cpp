@@ -131,6 +131,7 @@ static arb_ion_info ion_list[] {{"a"}, {"b"}, {"c"}, {"d"}, {"e"}, {"f"}};
 
 mechanism_ptr mk_fleeb_foo() {
     arb_mechanism_type m = {0};
+    m.abi_version = ARB_MECH_ABI_VERSION;
     m.fingerprint = "fleebprint";
     m.name        = "fleeb";
     m.kind        = arb_mechanism_kind_density;
@@ -145,6 +146,7 @@ mechanism_ptr mk_fleeb_foo() {
 
 mechanism_ptr mk_special_fleeb_foo() {
     arb_mechanism_type m = {0};
+    m.abi_version = ARB_MECH_ABI_VERSION;
     m.fingerprint = "fleebprint";
     m.name        = "special fleeb";
     m.kind        = arb_mechanism_kind_density;
@@ -159,6 +161,7 @@ mechanism_ptr mk_special_fleeb_foo() {
 
 mechanism_ptr mk_fleeb_bar() {
     arb_mechanism_type m = {0};
+    m.abi_version = ARB_MECH_ABI_VERSION;
     m.fingerprint = "fleebprint";
     m.name        = "fleeb";
     m.kind        = arb_mechanism_kind_density;
@@ -175,6 +178,7 @@ mechanism_ptr mk_fleeb_bar() {
 
 mechanism_ptr mk_burble_bar() {
     arb_mechanism_type m = {0};
+    m.abi_version = ARB_MECH_ABI_VERSION;
     m.fingerprint = "fnord";
     m.name        = "burble";
     m.kind        = arb_mechanism_kind_density;
@@ -627,3 +631,30 @@ TEST(mechcat, import_collisions) {
         }
     }
 }
+
+TEST(mechcat, bundles) {
+    static const char* members[] = {"fleeb", "burble"};
+    arb_mechanism_bundle_interface iface{foo_backend::kind, members, 2, nullptr};
+
+    auto cat = build_fake_catalogue();
+    cat.register_bundle(iface);
+
+    ASSERT_EQ(1u, cat.bundles(foo_backend::kind).size());
+    EXPECT_EQ((std::vector<std::string>{"fleeb", "burble"}), cat.bundles(foo_backend::kind).front().members);
+    EXPECT_TRUE(cat.bundles(bar_backend::kind).empty());
+
+    // Members are renamed on import.
+    mechanism_catalogue cat2;
+    cat2.import(cat, "fake_");
+    ASSERT_EQ(1u, cat2.bundles(foo_backend::kind).size());
+    EXPECT_EQ((std::vector<std::string>{"fake_fleeb", "fake_burble"}), cat2.bundles(foo_backend::kind).front().members);
+
+    // Removing a member drops the bundle.
+    cat.remove("burble");
+    EXPECT_TRUE(cat.bundles(foo_backend::kind).empty());
+
+    // Members must be in the catalogue.
+    static const char* unknown[] = {"fleeb", "zonkers"};
+    arb_mechanism_bundle_interface bad{foo_backend::kind, unknown, 2, nullptr};
+    EXPECT_THROW(cat.register_bundle(bad), arb::no_such_mechanism);
+}
@@ -257,6 +257,18 @@ TEST(embedding, partial_area) {
 
     double expected_ixa = 3/(9.5*8)/pi;
     EXPECT_TRUE(near_relative(expected_ixa, em.integrate_ixa(mcable{1, 0.1, 0.4}), reltol));
+
+    // Weighted area over part of a branch, starting within the weights:
+    EXPECT_TRUE(near_relative(7.*(sub_area2+sub_area3), em.integrate_area(mcable{0, 0.3, 0.9}, pw), reltol));
+    EXPECT_TRUE(near_relative(7.*sub_area3, em.integrate_area(mcable{0, 1/3., 1.}, pw), reltol));
+
+    // Integrals over a cable list are sums over its cables:
+    mcable_list cables = {{0, 0.1, 0.3}, {0, 0.3, 0.9}, {1, 0.1, 0.4}};
+    double area1 = em.integrate_area(mcable{1, 0.1, 0.4});
+    EXPECT_TRUE(near_relative(sub_area1+sub_area2+sub_area3+area1, em.integrate_area(cables), reltol));
+    EXPECT_TRUE(near_relative(0.8*em.branch_length(0)+3, em.integrate_length(cables), reltol));
+    EXPECT_TRUE(near_relative(em.integrate_ixa(mcable{0, 0.1, 0.9})+expected_ixa, em.integrate_ixa(cables), reltol));
+    EXPECT_EQ(0., em.integrate_area(mcable_list{}));
 }
 
 TEST(embedding, area_0_length_segment) {
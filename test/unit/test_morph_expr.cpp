@@ -173,6 +173,60 @@ TEST(region, thingify_named) {
     }
 }
 
+namespace {
+// A region that counts its evaluations.
+struct counted_region: region_tag {
+    int* count;
+
+    friend mextent thingify_(const counted_region& r, const mprovider&) {
+        ++*r.count;
+        return mcable_list{{0, 0.25, 0.75}};
+    }
+
+    friend std::ostream& operator<<(std::ostream& o, const counted_region&) {
+        return o << "(counted)";
+    }
+};
+}
+
+TEST(mprovider, shared_evaluation) {
+    using pvec = std::vector<msize_t>;
+    using svec = std::vector<mpoint>;
+
+    int count = 0;
+    region counted{counted_region{{}, &count}};
+
+    morphology m(segments_from_points(svec{ {0,0,0,1}, {10,0,0,1} }, pvec{mnpos, 0}));
+    label_dict dict;
+    dict.set("counted", counted);
+    dict.set("both", join(region("counted"_lab), reg::cable(0, 0.5, 1)));
+
+    mprovider p1(m, dict);
+    EXPECT_EQ(1, count);
+    EXPECT_EQ(mextent(mcable_list{{0, 0.25, 1}}), p1.region("both"));
+
+    // Providers of the morphology, or a copy of it, with the same labels share
+    // the evaluations, of labels and of other expressions alike.
+    label_dict copy = dict;
+    mprovider p2(morphology(m), copy);
+    EXPECT_EQ(1, count);
+    EXPECT_EQ(p1.region("both"), p2.region("both"));
+    EXPECT_EQ(p1.region("counted"), p2.evaluate(counted));
+    EXPECT_EQ(1, count);
+
+    // Different labels, or a different morphology, are evaluated anew.
+    dict.set("other", reg::all());
+    mprovider p3(m, dict);
+    EXPECT_EQ(2, count);
+    EXPECT_EQ(p1.region("both"), p3.region("both"));
+
+    mprovider p4(morphology(segments_from_points(svec{ {0,0,0,1}, {10,0,0,1} }, pvec{mnpos, 0})), copy);
+    EXPECT_EQ(3, count);
+
+    // Locations are distinguished to full precision.
+    EXPECT_NE(p1.evaluate(reg::cable(0, 0.1, 1)), p1.evaluate(reg::cable(0, 0.1+1e-12, 1)));
+}
+
 // Embedded evaluation (thingify) tests:
 
 TEST(locset, thingify) {
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cmath>
 #include <vector>
 
@@ -8,6 +9,7 @@
 
 #include "util/piecewise.hpp"
 #include "util/rangeutil.hpp"
+#include "util/span.hpp"
 
 #include "../test/gtest.h"
 #include "common_cells.hpp"
@@ -570,3 +572,110 @@ TEST(place_pwlin, segments) {
     EXPECT_TRUE(mpoint_almost_eq(p8p, x3all[2].prox));
     EXPECT_TRUE(mpoint_almost_eq(p8p, x3all[2].dist));
 }
+
+TEST(place_pwlin, closest) {
+    using pvec = std::vector<msize_t>;
+    using svec = std::vector<mpoint>;
+
+    // Y-shaped branched morphology, as above.
+    pvec parents = {mnpos, 0, 1, 2, 3, 4, 2, 6};
+    svec points = {
+        { 0,  0,  0,  2}, { 0,  0,  1,  2}, { 3,  0,  1,  2},
+        { 3,  0,  1,  1}, { 3,  1,  1,  1}, { 3,  2,  1,  0},
+        { 3,  0,  1,  2}, { 3, -1,  1,  2}
+    };
+    place_pwlin pl(morphology(segments_from_points(points, parents)));
+
+    auto [l1, d1] = pl.closest(3, 1.5, 1);
+    EXPECT_EQ(1u, l1.branch);
+    EXPECT_DOUBLE_EQ(0.75, l1.pos);
+    EXPECT_DOUBLE_EQ(0, d1);
+
+    auto [l2, d2] = pl.closest(3, 1.5, 3);
+    EXPECT_EQ(1u, l2.branch);
+    EXPECT_DOUBLE_EQ(0.75, l2.pos);
+    EXPECT_DOUBLE_EQ(2, d2);
+
+    auto [l3, d3] = pl.closest(1.5, 0, 5);
+    EXPECT_EQ(0u, l3.branch);
+    EXPECT_DOUBLE_EQ(0.625, l3.pos);
+    EXPECT_DOUBLE_EQ(4, d3);
+
+    auto [l4, d4] = place_pwlin(morphology()).closest(0, 0, 0);
+    EXPECT_EQ(mnpos, l4.branch);
+    EXPECT_TRUE(std::isinf(d4));
+}
+
+TEST(spatial_index, queries) {
+    using pvec = std::vector<msize_t>;
+    using svec = std::vector<mpoint>;
+
+    pvec parents = {mnpos, 0, 1, 2, 3, 4, 2, 6};
+    svec points = {
+        { 0,  0,  0,  2}, { 0,  0,  1,  2}, { 3,  0,  1,  2},
+        { 3,  0,  1,  1}, { 3,  1,  1,  1}, { 3,  2,  1,  0},
+        { 3,  0,  1,  2}, { 3, -1,  1,  2}
+    };
+    morphology m(segments_from_points(points, parents));
+
+    // Copies of the morphology placed on a grid, each with its own rotation.
+    std::vector<place_pwlin> cells;
+    for (int i = 0; i<40; ++i) {
+        auto iso = isometry::rotate(0.3*i, 1, i%3, 2)*isometry::translate(5.*(i%8), 5.*(i/8), 0.5*i);
+        cells.emplace_back(m, iso);
+    }
+    spatial_index index(cells);
+
+    // Axis segments of every cell, for brute-force comparison.
+    mcable_list branches;
+    std::size_t n_segments = 0;
+    for (msize_t b = 0; b<m.num_branches(); ++b) {
+        branches.push_back({b, 0, 1});
+        n_segments += m.branch_segments(b).size();
+    }
+    mextent all(branches);
+    EXPECT_EQ(n_segments*cells.size(), index.size());
+    auto axis_distance = [](const msegment& s, mpoint p) {
+        v3 a{s.prox.x, s.prox.y, s.prox.z}, b{s.dist.x, s.dist.y, s.dist.z}, x{p.x, p.y, p.z};
+        v3 d = b+(-1)*a, e = x+(-1)*a;
+        double t = dot(d, d)>0? std::clamp(dot(e, d)/dot(d, d), 0., 1.): 0.;
+        return length(e+(-t)*d);
+    };
+
+    std::vector<mpoint> queries;
+    for (int i = 0; i<200; ++i) {
+        queries.push_back({std::fmod(7.3*i, 45.)-2, std::fmod(3.1*i, 30.)-2, std::fmod(1.7*i, 25.)-2, 0});
+    }
+
+    const double r = 2.5;
+    auto nearest = index.closest(queries);
+    auto near = index.within(queries, r);
+    ASSERT_EQ(queries.size(), nearest.size());
+    ASSERT_EQ(queries.size(), near.size());
+
+    for (auto i: util::count_along(queries)) {
+        const auto& q = queries[i];
+        double best = INFINITY;
+        std::size_t n_within = 0;
+        for (const auto& c: cells) {
+            best = std::min(best, c.closest(q.x, q.y, q.z).second);
+            for (const auto& s: c.all_segments(all)) {
+                if (axis_distance(s, q)<=r) ++n_within;
+            }
+        }
+
+        // The nearest location is at the distance reported.
+        const auto& h = nearest[i];
+        EXPECT_NEAR(best, h.distance, 1e-12);
+        EXPECT_NEAR(h.distance, distance(cells[h.cell].at(h.loc), q), 1e-9);
+
+        EXPECT_EQ(n_within, near[i].size());
+        for (const auto& w: near[i]) {
+            EXPECT_LE(w.distance, r);
+            EXPECT_NEAR(w.distance, distance(cells[w.cell].at(w.loc), q), 1e-9);
+        }
+    }
+
+    EXPECT_TRUE(std::isinf(spatial_index().closest(0, 0, 0).distance));
+    EXPECT_TRUE(spatial_index().within(0, 0, 0, 1).empty());
+}
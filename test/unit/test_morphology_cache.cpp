@@ -0,0 +1,56 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/cable_cell.hpp>
+#include <arbor/morph/embed_pwlin.hpp>
+#include <arbor/morph/morphology.hpp>
+
+#include <arborio/morphology_cache.hpp>
+#include <arborio/swcio.hpp>
+
+#include "../gtest.h"
+
+// Path to data directory can be overriden at compile time.
+#if !defined(DATADIR)
+#   define DATADIR "../data"
+#endif
+
+using namespace arborio;
+
+// hipcc bug in reading DATADIR
+#ifndef ARB_HIP
+TEST(morphology_cache, swc) {
+    std::string fname = std::string(DATADIR) + "/pyramidal.swc";
+    std::ifstream fid(fname);
+    if (!fid.is_open()) {
+        std::cerr << "unable to open file " << fname << "... skipping test\n";
+        return;
+    }
+    auto expected = arborio::load_swc_arbor(parse_swc(fid));
+
+    morphology_cache cache;
+    auto m1 = cache.load_swc_arbor(fname);
+    auto m2 = cache.load_swc_arbor(fname);
+    EXPECT_EQ(1u, cache.size());
+    EXPECT_EQ(expected.num_branches(), m1.num_branches());
+
+    // Cells of the cached morphology share its embedding.
+    EXPECT_EQ(&m1.embedding(), &m2.embedding());
+    arb::cable_cell c1(m1), c2(m2);
+    EXPECT_EQ(&c1.embedding(), &c2.embedding());
+
+    // The same file in another format is a separate entry.
+    auto n = cache.load_swc_neuron(fname);
+    EXPECT_EQ(2u, cache.size());
+    EXPECT_NE(&m1.embedding(), &n.embedding());
+
+    cache.clear();
+    EXPECT_EQ(0u, cache.size());
+    EXPECT_EQ(expected.num_branches(), m1.num_branches());
+    EXPECT_NE(&m1.embedding(), &cache.load_swc_arbor(fname).embedding());
+
+    EXPECT_THROW(cache.load_swc_arbor(std::string(DATADIR) + "/no_such_file.swc"), arb::file_not_found_error);
+}
+#endif
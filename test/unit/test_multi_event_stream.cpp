@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 #include "../gtest.h"
 
@@ -59,6 +60,44 @@ TEST(multi_event_stream, init) {
     EXPECT_TRUE(m.empty());
 }
 
+TEST(multi_event_stream, init_order) {
+    using multi_event_stream = multicore::multi_event_stream<deliverable_event>;
+
+    // Events ordered by index are copied in one pass, others are placed by
+    // index; either way, and with the streams reused, the streams are the same.
+    auto streams = [](const multi_event_stream& m) {
+        std::vector<std::vector<float>> weights(n_cell);
+        auto ev = m.marked_events();
+        for (cell_size_type i = 0; i<n_cell; ++i) {
+            for (auto e = ev.begin_marked(i); e!=ev.end_marked(i); ++e) {
+                weights[i].push_back(e->weight);
+            }
+        }
+        return weights;
+    };
+    std::vector<time_type> t_until(n_cell, 10.);
+
+    multi_event_stream ordered(n_cell);
+    ordered.init(common_events);
+    ordered.mark_until_after(t_until);
+
+    auto events = common_events;
+    std::rotate(events.begin(), events.begin()+2, events.end());
+    ASSERT_FALSE(util::is_sorted_by(events, [](deliverable_event e) { return event_index(e); }));
+
+    multi_event_stream m(n_cell);
+    m.init(events);
+    m.mark_until_after(t_until);
+    EXPECT_EQ(streams(ordered), streams(m));
+
+    m.init(common_events);
+    m.mark_until_after(t_until);
+    EXPECT_EQ(streams(ordered), streams(m));
+
+    m.init({});
+    EXPECT_TRUE(m.empty());
+}
+
 TEST(multi_event_stream, mark) {
     using multi_event_stream = multicore::multi_event_stream<deliverable_event>;
 
@@ -210,3 +249,123 @@ TEST(multi_event_stream, time_if_before) {
 	}
     }
 }
+
+TEST(multi_event_stream, partitions) {
+    using multi_event_stream = multicore::multi_event_stream<deliverable_event>;
+
+    // Events of mech_1 in partition 1, of mech_2 in partition 0; other
+    // mechanisms receive no events.
+    std::vector<fvm_index_type> partition(mech_2+1, -1);
+    partition[mech_1] = 1;
+    partition[mech_2] = 0;
+
+    multi_event_stream m(n_cell);
+    m.set_partitions(partition);
+    EXPECT_EQ(n_cell, m.n_streams());
+    // Two partitions for the mechanisms, and one for events of no mechanism.
+    EXPECT_EQ(3u, m.n_partitions());
+
+    // Events need only be sorted by time within each index.
+    auto events = common_events;
+    std::reverse(events.begin(), events.end());
+    m.init(events);
+
+    auto marked = [&m](unsigned mech, unsigned i) {
+        auto ev = m.marked_events(mech);
+        return util::make_range(ev.begin_marked(i), ev.end_marked(i));
+    };
+
+    // Everything up to t=3: events[0] of mech_1 on cell_1, events[1] of
+    // mech_2 on cell_3 and events[2] of mech_2 on cell_2.
+    std::vector<time_type> t_until(n_cell, 3.);
+    m.mark_until_after(t_until);
+
+    for (cell_size_type i = 0; i<n_cell; ++i) {
+        auto evs_1 = marked(mech_1, i);
+        auto evs_2 = marked(mech_2, i);
+        EXPECT_TRUE(marked(0, i).empty());
+        EXPECT_TRUE(marked(mech_2+1, i).empty());
+
+        for (auto& ev: evs_1) EXPECT_EQ(mech_1, ev.mech_id);
+        for (auto& ev: evs_2) EXPECT_EQ(mech_2, ev.mech_id);
+
+        switch (i) {
+        case cell_1:
+            EXPECT_EQ(1u, evs_1.size());
+            EXPECT_EQ(0u, evs_2.size());
+            EXPECT_EQ(handle[0].mech_index, evs_1.front().mech_index);
+            break;
+        case cell_2:
+            EXPECT_EQ(0u, evs_1.size());
+            EXPECT_EQ(1u, evs_2.size());
+            EXPECT_EQ(handle[1].mech_index, evs_2.front().mech_index);
+            break;
+        case cell_3:
+            EXPECT_EQ(0u, evs_1.size());
+            EXPECT_EQ(1u, evs_2.size());
+            EXPECT_EQ(handle[3].mech_index, evs_2.front().mech_index);
+            break;
+        default:
+            EXPECT_EQ(0u, evs_1.size());
+            EXPECT_EQ(0u, evs_2.size());
+            break;
+        }
+    }
+
+    // The next event of any partition bounds the time of each index.
+    m.drop_marked_events();
+    EXPECT_FALSE(m.empty());
+
+    std::vector<double> t(n_cell, 10.);
+    m.event_time_if_before(t);
+    for (cell_size_type i = 0; i<n_cell; ++i) {
+        EXPECT_EQ(i==cell_2? 5.: 10., t[i]);
+    }
+
+    t_until.assign(n_cell, 5.);
+    m.mark_until_after(t_until);
+    ASSERT_EQ(1u, marked(mech_1, cell_2).size());
+    EXPECT_EQ(handle[2].mech_index, marked(mech_1, cell_2).front().mech_index);
+
+    m.drop_marked_events();
+    EXPECT_TRUE(m.empty());
+}
+
+TEST(multi_event_stream, unkeyed_events) {
+    using multi_event_stream = multicore::multi_event_stream<deliverable_event>;
+
+    std::vector<fvm_index_type> partition(mech_2+1, -1);
+    partition[mech_1] = 0;
+
+    // Events of exact sampling belong to no mechanism: they are never
+    // delivered, but bound the integration steps of their index.
+    target_handle sample_handle(-1, 0, cell_3);
+    std::vector<deliverable_event> events = {
+        deliverable_event(3.f, handle[0], 1.f),
+        deliverable_event(1.f, sample_handle, 0.f),
+        deliverable_event(2.f, handle[1], 2.f)
+    };
+
+    multi_event_stream m(n_cell);
+    m.set_partitions(partition);
+    EXPECT_EQ(2u, m.n_partitions());
+    m.init(events);
+
+    std::vector<double> t(n_cell, 10.);
+    m.event_time_if_before(t);
+    for (cell_size_type i = 0; i<n_cell; ++i) {
+        EXPECT_EQ(i==cell_1? 3.: i==cell_3? 1.: 10., t[i]);
+    }
+
+    std::vector<time_type> t_until(n_cell, 5.);
+    m.mark_until_after(t_until);
+    for (cell_size_type i = 0; i<n_cell; ++i) {
+        auto ev = m.marked_events(-1);
+        EXPECT_EQ(ev.begin_marked(i), ev.end_marked(i));
+    }
+    auto ev_1 = m.marked_events(mech_1);
+    EXPECT_EQ(1, ev_1.end_marked(cell_1)-ev_1.begin_marked(cell_1));
+
+    m.drop_marked_events();
+    EXPECT_TRUE(m.empty());
+}
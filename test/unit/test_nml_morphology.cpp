@@ -797,3 +797,166 @@ R"~(
     EXPECT_TRUE(region_eq(P, named("subTree1-"), join(named("1"), named("2"), named("3"))));
     EXPECT_TRUE(region_eq(P, named("subTree-3"), join(named("0"), named("1"), named("3"))));
 }
+
+TEST(neuroml, stream_morphologies) {
+    using namespace arb;
+
+    std::string doc =
+R"~(
+<neuroml xmlns="http://www.neuroml.org/schema/neuroml2">
+<cell id="c0" morphology="m1"/>
+<morphology id="m1">
+    <segment id="0">
+        <proximal x="0" y="0" z="0" diameter="1"/>
+        <distal x="1" y="0" z="0" diameter="2"/>
+    </segment>
+    <segment id="1">
+        <parent segment="0" fractionAlong="0.5"/>
+        <proximal x="0.5" y="0" z="0" diameter="1"/>
+        <distal x="0.5" y="1" z="0" diameter="2"/>
+    </segment>
+    <segment id="2">
+        <parent segment="1"/>
+        <distal x="0.5" y="2" z="0" diameter="2"/>
+    </segment>
+    <segmentGroup id="g0">
+        <member segment="0"/>
+    </segmentGroup>
+    <segmentGroup id="g12">
+        <path>
+            <from segment="1"/>
+            <to segment="2"/>
+        </path>
+    </segmentGroup>
+    <segmentGroup id="all">
+        <include segmentGroup="g0"/>
+        <subTree><from segment="1"/></subTree>
+    </segmentGroup>
+</morphology>
+<cell id="c1" morphology="m1"/>
+<cell id="c2">
+    <morphology id="m2">
+        <segment id="0">
+            <proximal x="0" y="0" z="0" diameter="1"/>
+            <distal x="0" y="0" z="3" diameter="1"/>
+        </segment>
+    </morphology>
+</cell>
+<cell id="c3" morphology="missing"/>
+</neuroml>
+)~";
+
+    std::vector<arborio::nml_morphology_data> seen;
+    arborio::nml_stream_handlers handlers;
+    handlers.morphology = [&](arborio::nml_morphology_data m) { seen.push_back(std::move(m)); };
+    arborio::stream_neuroml(doc, handlers);
+
+    // The forward reference of c0 is reported when m1 has been read.
+    ASSERT_EQ(4u, seen.size());
+    EXPECT_EQ("c0", seen[0].cell_id.value_or(""));
+    EXPECT_FALSE(seen[1].cell_id);
+    EXPECT_EQ("c1", seen[2].cell_id.value_or(""));
+    EXPECT_EQ("c2", seen[3].cell_id.value_or(""));
+    EXPECT_EQ("m1", seen[0].id);
+    EXPECT_EQ("m1", seen[1].id);
+    EXPECT_EQ("m1", seen[2].id);
+    EXPECT_EQ("m2", seen[3].id);
+
+    // The morphologies match those of the document interface.
+    arborio::neuroml N(doc);
+    auto expected = N.morphology("m1").value();
+    for (unsigned i = 0; i<3; ++i) {
+        EXPECT_EQ(expected.group_segments, seen[i].group_segments);
+        EXPECT_EQ(expected.morphology.num_branches(), seen[i].morphology.num_branches());
+    }
+    EXPECT_EQ(1u, seen[3].morphology.num_branches());
+
+    label_dict labels;
+    labels.import(seen[1].segments);
+    labels.import(seen[1].groups);
+    mprovider P(seen[1].morphology, labels);
+    EXPECT_TRUE(region_eq(P, reg::named("g12"), join(reg::named("1"), reg::named("2"))));
+    EXPECT_TRUE(region_eq(P, reg::named("all"), reg::all()));
+
+    // Morphology errors are reported as by the document interface.
+    std::string bad =
+R"~(
+<neuroml xmlns="http://www.neuroml.org/schema/neuroml2">
+<morphology id="no-proximal">
+    <segment id="0">
+        <distal x="3" y="-3.5" z="4" diameter="8.5"/>
+    </segment>
+</morphology>
+</neuroml>
+)~";
+    EXPECT_THROW(arborio::stream_neuroml(bad, handlers), arborio::nml_bad_segment);
+    EXPECT_THROW(arborio::stream_neuroml("<wha?", handlers), arborio::xml_error);
+}
+
+TEST(neuroml, stream_network) {
+    std::string doc =
+R"~(
+<neuroml xmlns="http://www.neuroml.org/schema/neuroml2">
+<network id="net">
+    <population id="A" component="cellA" size="3"/>
+    <population id="B" component="cellB">
+        <instance id="0"><location x="0" y="0" z="0"/></instance>
+        <instance id="1"><location x="1" y="0" z="0"/></instance>
+    </population>
+    <projection id="AB" presynapticPopulation="A" postsynapticPopulation="B" synapse="syn">
+        <connection id="0" preCellId="../A/2/cellA" postCellId="../B/1/cellB" postSegmentId="4" postFractionAlong="0.25"/>
+        <connectionWD id="1" preCellId="../A[1]" postCellId="../B[0]" weight="0.5" delay="2.5 ms"/>
+        <connectionWD id="2" preCellId="../A[0]" postCellId="../B[0]" weight="2" delay="0.001s"/>
+    </projection>
+</network>
+</neuroml>
+)~";
+
+    std::vector<arborio::nml_population> pops;
+    std::vector<std::pair<std::string, arborio::nml_connection>> conns;
+    arborio::nml_stream_handlers handlers;
+    handlers.population = [&](const arborio::nml_population& p) { pops.push_back(p); };
+    handlers.connection = [&](const arborio::nml_projection& p, const arborio::nml_connection& c) {
+        EXPECT_EQ("net", p.network_id);
+        EXPECT_EQ("A", p.presynaptic_population);
+        EXPECT_EQ("B", p.postsynaptic_population);
+        EXPECT_EQ("syn", p.synapse);
+        conns.push_back({p.id, c});
+    };
+    arborio::stream_neuroml(doc, handlers);
+
+    ASSERT_EQ(2u, pops.size());
+    EXPECT_EQ("A", pops[0].id);
+    EXPECT_EQ("cellA", pops[0].component);
+    EXPECT_EQ(3u, pops[0].size);
+    EXPECT_EQ("B", pops[1].id);
+    EXPECT_EQ(2u, pops[1].size);
+
+    ASSERT_EQ(3u, conns.size());
+    EXPECT_EQ("AB", conns[0].first);
+    EXPECT_EQ(2u, conns[0].second.pre_cell);
+    EXPECT_EQ(1u, conns[0].second.post_cell);
+    EXPECT_EQ(0u, conns[0].second.pre_segment);
+    EXPECT_EQ(0.5, conns[0].second.pre_fraction_along);
+    EXPECT_EQ(4u, conns[0].second.post_segment);
+    EXPECT_EQ(0.25, conns[0].second.post_fraction_along);
+    EXPECT_EQ(1., conns[0].second.weight);
+
+    EXPECT_EQ(1u, conns[1].second.pre_cell);
+    EXPECT_EQ(0u, conns[1].second.post_cell);
+    EXPECT_EQ(0.5, conns[1].second.weight);
+    EXPECT_DOUBLE_EQ(2.5, conns[1].second.delay);
+    EXPECT_DOUBLE_EQ(1., conns[2].second.delay);
+
+    std::string bad =
+R"~(
+<neuroml xmlns="http://www.neuroml.org/schema/neuroml2">
+<network id="net">
+    <projection id="AB" presynapticPopulation="A" postsynapticPopulation="B">
+        <connection id="0" preCellId="A" postCellId="../B/1/cellB"/>
+    </projection>
+</network>
+</neuroml>
+)~";
+    EXPECT_THROW(arborio::stream_neuroml(bad, handlers), arborio::nml_parse_error);
+}
@@ -25,6 +25,16 @@ TEST(padded_vector, alignment) {
     EXPECT_TRUE(is_aligned(a.data(), 1024));
 }
 
+TEST(padded_vector, huge_page_alignment) {
+    constexpr std::size_t huge = padded_allocator<double>::huge_page_size;
+    padded_allocator<double> pa(64);
+
+    // Allocations of at least a huge page start on a huge page boundary.
+    pvector<double> a(2*huge/sizeof(double), 0.0, pa);
+    EXPECT_TRUE(is_aligned(a.data(), huge));
+    EXPECT_EQ(64u, a.get_allocator().alignment());
+}
+
 TEST(padded_vector, allocator_constraints) {
     EXPECT_THROW(padded_allocator<char>(7), std::range_error);
 
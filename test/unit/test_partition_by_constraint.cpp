@@ -160,3 +160,29 @@ TEST(partition_by_constraint, partition_random) {
     }
 
 }
+
+TEST(partition_by_constraint, contiguous_tail) {
+    // Width 10 padded to a multiple of 4, with the last valid entries contiguous.
+    const unsigned width = 10, simd_width = 4;
+    iarray index = {0, 1, 2, 3, 5, 5, 5, 5, 7, 8, 8, 8};
+
+    EXPECT_FALSE(multicore::can_extend_contiguous_tail(index, width, simd_width, 10));
+    EXPECT_FALSE(multicore::can_extend_contiguous_tail(index, 8, simd_width, 20));
+    ASSERT_TRUE(multicore::can_extend_contiguous_tail(index, width, simd_width, 11));
+
+    auto part = multicore::make_constraint_partition(index, width, simd_width);
+    EXPECT_EQ((iarray{0}), part.contiguous);
+    EXPECT_EQ((iarray{8}), part.none);
+
+    multicore::extend_contiguous_tail(index, width, simd_width);
+    EXPECT_EQ((iarray{0, 1, 2, 3, 5, 5, 5, 5, 7, 8, 9, 10}), index);
+
+    part = multicore::make_constraint_partition(index, width, simd_width);
+    EXPECT_EQ((iarray{0, 8}), part.contiguous);
+    EXPECT_EQ((iarray{4}), part.constant);
+    EXPECT_TRUE(part.none.empty());
+
+    // A partial chunk that is not contiguous stays as it is.
+    iarray gapped = {0, 1, 2, 3, 4, 6, 6, 6};
+    EXPECT_FALSE(multicore::can_extend_contiguous_tail(gapped, 6, simd_width, 100));
+}
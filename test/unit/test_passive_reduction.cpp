@@ -0,0 +1,109 @@
+#include "../gtest.h"
+
+#include <cmath>
+#include <vector>
+
+#include <arbor/cable_cell.hpp>
+#include <arbor/cable_cell_param.hpp>
+#include <arbor/morph/locset.hpp>
+#include <arbor/morph/morphology.hpp>
+#include <arbor/morph/region.hpp>
+#include <arbor/morph/segment_tree.hpp>
+#include <arbor/passive_reduction.hpp>
+
+using namespace arb;
+
+namespace {
+// A soma with an axon and a dendrite that forks into two branches of the
+// given radius, 40 µm long. The dendrite has radius 1 µm, so that a child
+// radius of 2^(-2/3) µm satisfies the 3/2 power rule.
+morphology forked_dendrite(double child_radius) {
+    segment_tree tree;
+    auto soma = tree.append(mnpos, {0, 0, 0, 5}, {10, 0, 0, 5}, 1);
+    tree.append(soma, {10, 0, 0, 0.5}, {110, 0, 0, 0.5}, 2);
+    auto dend = tree.append(soma, {10, 0, 0, 1}, {10, 50, 0, 1}, 3);
+    tree.append(dend, {10, 50, 0, child_radius}, {10, 90, 0, child_radius}, 3);
+    tree.append(dend, {10, 50, 0, child_radius}, {50, 50, 0, child_radius}, 3);
+    return morphology(tree);
+}
+
+decor forked_decor() {
+    decor d;
+    d.paint(reg::all(), mechanism_desc("pas"));
+    d.paint(reg::tagged(2), mechanism_desc("hh"));
+    d.place(mlocation{0, 0.5}, mechanism_desc("expsyn"), "syn");
+    d.place(mlocation{1, 1}, threshold_detector{-10}, "det");
+    return d;
+}
+} // namespace
+
+TEST(passive_reduction, equivalent_cylinder) {
+    const double rc = std::pow(2., -2./3.);
+    cable_cell cell(forked_dendrite(rc), {}, forked_decor());
+    double area = cell.embedding().integrate_area(mcable_list{{2, 0, 1}, {3, 0, 1}, {4, 0, 1}});
+
+    auto reduced = reduce_passive_subtrees(cell);
+    ASSERT_EQ(1u, reduced.subtrees.size());
+    const auto& r = reduced.subtrees[0];
+    EXPECT_TRUE(r.reduced);
+    EXPECT_EQ(2u, r.branch);
+    EXPECT_EQ(3u, r.n_branches);
+    EXPECT_NEAR(0, r.rall_mismatch, 1e-12);
+    EXPECT_NEAR(0, r.tip_spread, 1e-12);
+    EXPECT_NEAR(area, r.area, 1e-9*area);
+
+    // The dendrite obeys the 3/2 power rule, so that the cylinder has its
+    // diameter, and the electrotonic length of dendrite and children.
+    EXPECT_NEAR(2, r.diameter, 1e-9);
+    EXPECT_NEAR(50+40*std::sqrt(2/(2*rc)), r.length, 1e-9);
+
+    const auto& rcell = reduced.cell;
+    ASSERT_EQ(3u, rcell.morphology().num_branches());
+    EXPECT_NEAR(area, rcell.embedding().integrate_area(mcable{2, 0, 1}), 1e-9*area);
+
+    // Paintings and placements are carried over.
+    const auto& mechs = rcell.region_assignments().get<mechanism_desc>();
+    EXPECT_EQ(3u, mechs.at("pas").size());
+    EXPECT_EQ(1u, mechs.at("hh").size());
+    ASSERT_EQ(1u, rcell.synapses().at("expsyn").size());
+    EXPECT_EQ((mlocation{0, 0.5}), rcell.synapses().at("expsyn")[0].loc);
+    ASSERT_EQ(1u, rcell.detectors().size());
+    EXPECT_EQ((mlocation{1, 1}), rcell.detectors()[0].loc);
+    EXPECT_EQ(cell.synapse_ranges().size(), rcell.synapse_ranges().size());
+}
+
+TEST(passive_reduction, kept_subtrees) {
+    const double rc = std::pow(2., -2./3.);
+
+    // A location to keep on the subtree.
+    {
+        cable_cell cell(forked_dendrite(rc), {}, forked_decor());
+        passive_reduction_options opts;
+        opts.keep.push_back(mlocation{3, 0.5});
+        auto reduced = reduce_passive_subtrees(cell, opts);
+        EXPECT_TRUE(reduced.subtrees.empty());
+        EXPECT_EQ(5u, reduced.cell.morphology().num_branches());
+    }
+
+    // A painting on part of the subtree.
+    {
+        auto d = forked_decor();
+        d.paint(mcable{4, 0, 1}, membrane_capacitance{0.02});
+        cable_cell cell(forked_dendrite(rc), {}, d);
+        auto reduced = reduce_passive_subtrees(cell);
+        EXPECT_TRUE(reduced.subtrees.empty());
+        EXPECT_EQ(5u, reduced.cell.morphology().num_branches());
+    }
+
+    // A subtree far from the 3/2 power rule.
+    {
+        cable_cell cell(forked_dendrite(1), {}, forked_decor());
+        passive_reduction_options opts;
+        opts.tolerance = 0.1;
+        auto reduced = reduce_passive_subtrees(cell, opts);
+        ASSERT_EQ(1u, reduced.subtrees.size());
+        EXPECT_FALSE(reduced.subtrees[0].reduced);
+        EXPECT_NEAR(1, reduced.subtrees[0].rall_mismatch, 1e-12);
+        EXPECT_EQ(5u, reduced.cell.morphology().num_branches());
+    }
+}
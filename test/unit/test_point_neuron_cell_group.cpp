@@ -0,0 +1,161 @@
+#include "../gtest.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <arbor/adex_cell.hpp>
+#include <arbor/cable_cell.hpp>
+#include <arbor/izhikevich_cell.hpp>
+#include <arbor/load_balance.hpp>
+#include <arbor/recipe.hpp>
+#include <arbor/simulation.hpp>
+
+#include "point_neuron_cell_group.hpp"
+#include "util/span.hpp"
+
+using namespace arb;
+
+namespace {
+    // Unconnected point neurons of one kind, with the solver of each cell
+    // given by a function of its gid.
+    template <typename Cell>
+    class point_recipe: public arb::recipe {
+    public:
+        point_recipe(cell_size_type n, cell_kind kind, point_solver_kind (*solver)(cell_gid_type), Cell proto, bool probe = false):
+            n_(n), kind_(kind), solver_(solver), proto_(std::move(proto)), probe_(probe)
+        {}
+
+        cell_size_type num_cells() const override { return n_; }
+        cell_kind get_cell_kind(cell_gid_type) const override { return kind_; }
+
+        util::unique_any get_cell_description(cell_gid_type gid) const override {
+            Cell c = proto_;
+            c.solver = solver_(gid);
+            return c;
+        }
+
+        std::vector<probe_info> get_probes(cell_gid_type) const override {
+            if (!probe_) return {};
+            return {arb::cable_probe_membrane_voltage{mlocation{0, 0}}};
+        }
+
+    private:
+        cell_size_type n_;
+        cell_kind kind_;
+        point_solver_kind (*solver_)(cell_gid_type);
+        Cell proto_;
+        bool probe_;
+    };
+
+    point_solver_kind euler(cell_gid_type) { return point_solver_kind::euler; }
+    point_solver_kind rk4(cell_gid_type) { return point_solver_kind::rk4; }
+    point_solver_kind alternate(cell_gid_type gid) { return gid%2? point_solver_kind::rk4: point_solver_kind::euler; }
+
+    // Place all cells in one group, so that they are updated together.
+    template <typename Cell>
+    domain_decomposition one_group(const point_recipe<Cell>& rec, const context& ctx) {
+        partition_hint_map hints = {{rec.get_cell_kind(0), {partition_hint::max_size}}};
+        return partition_load_balance(rec, ctx, hints);
+    }
+
+    template <typename Cell>
+    std::vector<spike> run(const point_recipe<Cell>& rec, const cse_vector& events, time_type t_final, time_type dt) {
+        auto ctx = make_context();
+        simulation sim(rec, one_group(rec, ctx), ctx);
+
+        std::vector<spike> spikes;
+        sim.set_global_spike_callback(
+            [&spikes](const std::vector<spike>& s) { spikes.insert(spikes.end(), s.begin(), s.end()); });
+        sim.inject_events(events);
+        sim.run(t_final, dt);
+
+        std::sort(spikes.begin(), spikes.end(),
+            [](spike a, spike b) { return a.source<b.source || (a.source==b.source && a.time<b.time); });
+        return spikes;
+    }
+}
+
+TEST(point_neuron_cell_group, throw) {
+    point_recipe<izhikevich_cell> rec(1, cell_kind::izhikevich, euler, izhikevich_cell("src", "tgt"), true);
+    auto ctx = make_context();
+    EXPECT_THROW(simulation(rec, partition_load_balance(rec, ctx), ctx), bad_cell_probe);
+}
+
+TEST(point_neuron_cell_group, izhikevich) {
+    // A regular spiking cell at rest spikes once after a kick of 20 mV, at
+    // nearly the same time with either solver.
+    izhikevich_cell proto("src", "tgt");
+    cse_vector events = {{0, {{0, 5, 20}}}};
+
+    auto e = run(point_recipe<izhikevich_cell>(1, cell_kind::izhikevich, euler, proto), events, 50, 0.025);
+    auto r = run(point_recipe<izhikevich_cell>(1, cell_kind::izhikevich, rk4, proto), events, 50, 0.025);
+
+    ASSERT_EQ(1u, e.size());
+    ASSERT_EQ(1u, r.size());
+    EXPECT_GT(e[0].time, 5);
+    EXPECT_NEAR(e[0].time, r[0].time, 0.5);
+
+    // Without the kick, it stays at rest.
+    EXPECT_TRUE(run(point_recipe<izhikevich_cell>(1, cell_kind::izhikevich, euler, proto), {}, 50, 0.025).empty());
+}
+
+TEST(point_neuron_cell_group, adex_lanes) {
+    // Cells of either solver, in numbers that are not a multiple of the SIMD
+    // width, each kicked at a time offset by its gid, spike at times offset
+    // by the same amount as the cells of the same solver.
+    const unsigned n = 11;
+    adex_cell proto("src", "tgt");
+    const double kick = 30*proto.C_m; // 30 mV
+
+    cse_vector events;
+    for (auto gid: util::make_span(n)) {
+        events.push_back({gid, {{0, 1+0.5*gid, float(kick)}}});
+    }
+
+    auto spikes = run(point_recipe<adex_cell>(n, cell_kind::adex, alternate, proto), events, 20, 0.025);
+    ASSERT_EQ(n, spikes.size());
+    for (auto gid: util::make_span(n)) {
+        ASSERT_EQ(gid, spikes[gid].source.gid);
+        EXPECT_GT(spikes[gid].time, 1+0.5*gid);
+        EXPECT_NEAR(spikes[gid%2].time+0.5*(gid-gid%2), spikes[gid].time, 1e-9);
+    }
+    EXPECT_NEAR(spikes[0].time, spikes[1].time-0.5, 0.1);
+}
+
+TEST(point_neuron_cell_group, adex_refractory) {
+    // A kick in the refractory period after a spike is ignored.
+    adex_cell proto("src", "tgt");
+    proto.t_ref = 5;
+    const float kick = 30*proto.C_m;
+
+    cse_vector events = {{0, {{0, 1, kick}, {0, 4, kick}, {0, 20, kick}}}};
+    auto spikes = run(point_recipe<adex_cell>(1, cell_kind::adex, rk4, proto), events, 40, 0.025);
+
+    ASSERT_EQ(2u, spikes.size());
+    EXPECT_LT(spikes[0].time, 4);
+    EXPECT_GT(spikes[1].time, 20);
+}
+
+TEST(point_neuron_cell_group, reset) {
+    // Resetting the simulation restores the initial state, so that a run
+    // after a reset gives the same spikes.
+    adex_cell proto("src", "tgt");
+    point_recipe<adex_cell> rec(5, cell_kind::adex, alternate, proto);
+    auto ctx = make_context();
+    simulation sim(rec, one_group(rec, ctx), ctx);
+
+    std::vector<spike> spikes;
+    sim.set_global_spike_callback(
+        [&spikes](const std::vector<spike>& s) { spikes.insert(spikes.end(), s.begin(), s.end()); });
+
+    std::vector<std::vector<spike>> runs;
+    for (int i = 0; i<2; ++i) {
+        sim.reset();
+        spikes.clear();
+        sim.inject_events({{2, {{0, 1, float(30*proto.C_m)}}}});
+        sim.run(20, 0.025);
+        runs.push_back(spikes);
+    }
+    ASSERT_EQ(1u, runs[0].size());
+    EXPECT_EQ(runs[0], runs[1]);
+}
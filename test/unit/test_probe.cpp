@@ -137,63 +137,86 @@ void run_v_i_probe_test(const context& ctx) {
         return probe_map.data_on(x).front().raw_handle_range()[i];
     };
 
-    // Voltage probes are interpolated, so expect fvm_probe_info
-    // to wrap an fvm_probe_interpolated; ion current density is
-    // implemented as an interpolated probe too, in order to account
-    // for stimulus contributions.
-
-    ASSERT_TRUE(std::get_if<fvm_probe_interpolated>(&probe_map.data_on({0, 0}).front().info));
-    ASSERT_TRUE(std::get_if<fvm_probe_interpolated>(&probe_map.data_on({0, 1}).front().info));
-    ASSERT_TRUE(std::get_if<fvm_probe_interpolated>(&probe_map.data_on({0, 2}).front().info));
-
-    probe_handle p0a = get_probe_raw_handle({0, 0}, 0);
-    probe_handle p0b = get_probe_raw_handle({0, 0}, 1);
-    probe_handle p1a = get_probe_raw_handle({0, 1}, 0);
-    probe_handle p1b = get_probe_raw_handle({0, 1}, 1);
-    probe_handle p2a = get_probe_raw_handle({0, 2}, 0);
-    probe_handle p2b = get_probe_raw_handle({0, 2}, 1);
+    // Voltage probes are interpolated, and ion current density is an
+    // interpolation too, in order to account for stimulus contributions.
+    // The interpolations are evaluated in the back end together with
+    // the reduction probes, so expect fvm_probe_info to wrap an
+    // fvm_probe_scalar referring to the interpolated value.
 
-    // Ball-and-stick cell with default discretization policy should
-    // have three CVs, one for branch 0, one trivial one covering the
-    // branch point, and one for branch 1.
-    //
-    // Consequently, expect the interpolated voltage probe handles
-    // to be on CVs 0 and 1 for probe 0,0 on branch 0,
-    // and on CVs 1 and 2 for probe 0,1 on branch 1.
+    ASSERT_TRUE(std::get_if<fvm_probe_scalar>(&probe_map.data_on({0, 0}).front().info));
+    ASSERT_TRUE(std::get_if<fvm_probe_scalar>(&probe_map.data_on({0, 1}).front().info));
+    ASSERT_TRUE(std::get_if<fvm_probe_scalar>(&probe_map.data_on({0, 2}).front().info));
+
+    probe_handle p0 = get_probe_raw_handle({0, 0});
+    probe_handle p1 = get_probe_raw_handle({0, 1});
+    probe_handle p2 = get_probe_raw_handle({0, 2});
 
     auto& state = backend_access<Backend>::state(lcell);
     auto& voltage = state.voltage;
+    const fvm_value_type* values = state.reduction_value.data();
 
-    EXPECT_EQ(voltage.data(),   p0a);
-    EXPECT_EQ(voltage.data()+1, p0b);
-    EXPECT_EQ(voltage.data()+1, p1a);
-    EXPECT_EQ(voltage.data()+2, p1b);
+    EXPECT_EQ(3u, state.reduction_value.size());
+    for (auto p: {p0, p1, p2}) {
+        EXPECT_LE(values, p);
+        EXPECT_GT(values+3, p);
+    }
+
+    // The interpolated values are updated when samples are taken.
+    auto sample = [&]() {
+        std::vector<sample_event> events;
+        for (auto p: {p0, p1, p2}) {
+            events.push_back({lcell.time(), 0, {p, (sample_size_type)events.size()}});
+        }
+        auto r = lcell.integrate(lcell.time()+0.0025, 0.0025, {}, events);
+        return std::vector<fvm_value_type>(r.sample_value.begin(), r.sample_value.end());
+    };
 
-    // Expect initial raw probe handle values to be the resting potential for
-    // the voltage probes (cell membrane potential should be constant), and
-    // zero for the current probe (including stimulus component).
+    // Expect initial probe values to be the resting potential for the voltage
+    // probes (cell membrane potential should be constant). The current probe
+    // is sampled once the stimulus is applied at the start of the step: it is
+    // the current density of the CV of the clamp, CV 2, less the accumulated
+    // stimulus current, which the step leaves in place.
 
-    fvm_value_type resting = voltage[0];
+    fvm_value_type resting = deref(voltage.data());
     EXPECT_NE(0.0, resting);
 
-    EXPECT_EQ(resting, deref(p0a));
-    EXPECT_EQ(resting, deref(p0b));
-    EXPECT_EQ(resting, deref(p1a));
-    EXPECT_EQ(resting, deref(p1a));
-    EXPECT_EQ(0.0, deref(p2a));
-    EXPECT_EQ(0.0, deref(p2b));
+    auto v = sample();
+    EXPECT_DOUBLE_EQ(resting, v[0]);
+    EXPECT_DOUBLE_EQ(resting, v[1]);
 
-    // After an integration step, expect voltage probe values
-    // to differ from resting, and for there to be a non-zero current.
+    fvm_value_type i_stim = deref(state.current_density.data()+2)-deref(state.stim_data.accu_stim_.data());
+    EXPECT_NE(0.0, i_stim);
+    EXPECT_DOUBLE_EQ(i_stim, v[2]);
+
+    // After integration, expect voltage probe values to differ from resting,
+    // and for there to be a non-zero current.
 
     lcell.integrate(0.01, 0.0025, {}, {});
+    std::vector<fvm_value_type> cv_voltage = {deref(voltage.data()), deref(voltage.data()+1), deref(voltage.data()+2)};
+    v = sample();
+
+    EXPECT_NE(resting, v[0]);
+    EXPECT_NE(resting, v[1]);
+    EXPECT_NE(0.0, v[2]);
 
-    EXPECT_NE(resting, deref(p0a));
-    EXPECT_NE(resting, deref(p0b));
-    EXPECT_NE(resting, deref(p1a));
-    EXPECT_NE(resting, deref(p1b));
-    EXPECT_NE(0.0, deref(p2a));
-    EXPECT_NE(0.0, deref(p2b));
+    // Ball-and-stick cell with default discretization policy should
+    // have three CVs, one for branch 0, one trivial one covering the
+    // branch point, and one for branch 1. Consequently, expect the
+    // voltage probe 0,0 on branch 0 to interpolate between CVs 0 and 1,
+    // and the probe 0,1 on branch 1 between CVs 1 and 2.
+
+    cable_cell cell(bs);
+    auto D = fvm_cv_discretize(cell, neuron_parameter_defaults);
+    auto in0 = fvm_interpolate_voltage(cell, D, 0, loc0);
+    auto in1 = fvm_interpolate_voltage(cell, D, 0, loc1);
+
+    EXPECT_EQ(0, in0.proximal_cv);
+    EXPECT_EQ(1, in0.distal_cv);
+    EXPECT_EQ(1, in1.proximal_cv);
+    EXPECT_EQ(2, in1.distal_cv);
+
+    EXPECT_DOUBLE_EQ(in0.proximal_coef*cv_voltage[0]+in0.distal_coef*cv_voltage[1], v[0]);
+    EXPECT_DOUBLE_EQ(in1.proximal_coef*cv_voltage[1]+in1.distal_coef*cv_voltage[2], v[1]);
 }
 
 template <typename Backend>
@@ -1297,6 +1320,83 @@ void run_exact_sampling_probe_test(const context& ctx) {
     }
 }
 
+template <typename Backend>
+void run_step_start_sampling_probe_test(const context& ctx) {
+    // With event_delivery_kind::step_start, the cell group skips sampling in
+    // steps in which it finds no sample due. Check that every sample is still
+    // taken at the start of the step that holds its time, and that times and
+    // values match those of event_delivery_kind::exact, which samples in
+    // every step and without events takes the same steps.
+
+    soma_cell_builder builder(12.6157/2.0);
+    builder.add_branch(0, 200, 1.0/2, 1.0/2, 4, "dend");
+    builder.add_branch(0, 200, 1.0/2, 1.0/2, 4, "dend");
+    auto desc = builder.make_cell();
+    desc.decorations.place(mlocation{1, 0.5}, i_clamp::box(0.1, 0.5, 0.2), "clamp");
+    cable_cell cell(desc);
+
+    cable1d_recipe rec(std::vector<cable_cell>{cell, cell}, false);
+    for (cell_gid_type gid: {0u, 1u}) {
+        rec.add_probe(gid, 0, cable_probe_membrane_voltage{mlocation{1, 0.1}});
+        rec.add_probe(gid, 0, cable_probe_membrane_voltage{mlocation{1, 0.9}});
+    }
+
+    const double dt = 0.025;
+    const double t_mid = 0.5, t_end = 1.;
+
+    // Sample times of probes {0, 0}, {0, 1}, {1, 0} and {1, 1}: off the grid
+    // of steps, with two in one step; on the grid, due at the start of a
+    // step and at the start of each run; and two schedules interleaved with
+    // the first, one ending in the last step.
+    std::vector<std::vector<time_type>> when = {
+        {0.0101, 0.3126, 0.3127, 0.8999},
+        {0., 4*dt, 13*dt, 20*dt, 30*dt},
+        {0.0102, 0.3128, 0.6124, 0.9},
+        {0.24, 0.2625, 0.6, 0.9875}
+    };
+    const unsigned n_probe = when.size();
+
+    auto run = [&](event_delivery_kind kind) {
+        partition_hint_map phints = {
+           {cell_kind::cable, {partition_hint::max_size, partition_hint::max_size, true}}
+        };
+        simulation sim(rec, partition_load_balance(rec, ctx, phints), ctx);
+        sim.set_event_delivery(kind);
+
+        std::vector<trace_vector<double>> traces(n_probe);
+        for (unsigned i = 0; i<n_probe; ++i) {
+            sim.add_sampler(one_probe({i/2, i%2}), explicit_schedule(when[i]), make_simple_sampler(traces[i]));
+        }
+        sim.run(t_mid, dt);
+        sim.run(t_end, dt);
+        return traces;
+    };
+
+    auto grid_traces = run(event_delivery_kind::step_start);
+    auto exact_traces = run(event_delivery_kind::exact);
+
+    for (unsigned i = 0; i<n_probe; ++i) {
+        ASSERT_EQ(1u, grid_traces[i].size());
+        ASSERT_EQ(1u, exact_traces[i].size());
+
+        const auto& grid_trace = grid_traces[i][0];
+        const auto& exact_trace = exact_traces[i][0];
+        ASSERT_EQ(when[i].size(), grid_trace.size());
+        ASSERT_EQ(when[i].size(), exact_trace.size());
+
+        for (unsigned j = 0; j<when[i].size(); ++j) {
+            // The step times are sums of dt, and a sample on the grid may
+            // fall at the end of the step before by rounding.
+            double t = grid_trace[j].t;
+            EXPECT_LE(t, when[i][j]+1e-9);
+            EXPECT_LT(when[i][j], t+dt+1e-9);
+
+            EXPECT_EQ(exact_trace[j].t, t);
+            EXPECT_EQ(exact_trace[j].v, grid_trace[j].v);
+        }
+    }
+}
+
 // Generate unit tests multicore_X and gpu_X for each entry X in PROBE_TESTS,
 // which establish the appropriate arbor context and then call run_X_probe_test.
 
@@ -1304,7 +1404,7 @@ void run_exact_sampling_probe_test(const context& ctx) {
 #define PROBE_TESTS \
     v_i, v_cell, v_sampled, expsyn_g, expsyn_g_cell, ion_density, \
     axial_and_ion_current_sampled, partial_density, exact_sampling, \
-    multi, total_current
+    step_start_sampling, multi, total_current
 
 #undef RUN_MULTICORE
 #define RUN_MULTICORE(x) \
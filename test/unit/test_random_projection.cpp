@@ -0,0 +1,64 @@
+#include "../gtest.h"
+
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/random_projection.hpp>
+
+using namespace arb;
+
+using conn_vector = std::vector<procedural_connection>;
+
+static std::vector<cell_gid_type> targets(const conn_vector& cs) {
+    std::vector<cell_gid_type> gids;
+    for (auto& c: cs) gids.push_back(c.target);
+    return gids;
+}
+
+TEST(random_projection, split) {
+    const cell_gid_type n = 5000;
+    random_projection p(0, 10, {"src"}, 100, 100+n, {"tgt"}, 0.1, 0.5, 2, 7);
+
+    for (cell_gid_type src = 0; src<10; ++src) {
+        conn_vector all;
+        p.connections_from(src, 0, 200+n, all);
+
+        // All connections lie within the target range, with the given weight and delay.
+        for (auto& c: all) {
+            EXPECT_LE(100u, c.target);
+            EXPECT_GT(100+n, c.target);
+            EXPECT_EQ(0.5f, c.weight);
+            EXPECT_EQ(2.f, c.delay);
+        }
+        // Expect about 500 connections.
+        EXPECT_LT(350u, all.size());
+        EXPECT_GT(650u, all.size());
+
+        // The same connections are generated over any split of the targets.
+        std::vector<cell_gid_type> bounds = {0, 333, 1200, 1201, 4000, 200+n};
+        conn_vector parts;
+        for (unsigned i = 0; i+1<bounds.size(); ++i) {
+            p.connections_from(src, bounds[i], bounds[i+1], parts);
+        }
+        EXPECT_EQ(targets(all), targets(parts));
+    }
+}
+
+TEST(random_projection, sources_differ) {
+    random_projection p(0, 2, {"src"}, 0, 1000, {"tgt"}, 0.5, 1, 1, 3);
+    conn_vector a, b;
+    p.connections_from(0, 0, 1000, a);
+    p.connections_from(1, 0, 1000, b);
+    EXPECT_NE(targets(a), targets(b));
+}
+
+TEST(random_projection, probability) {
+    conn_vector cs;
+    random_projection(0, 1, {"src"}, 0, 100, {"tgt"}, 0, 1, 1, 3).connections_from(0, 0, 100, cs);
+    EXPECT_TRUE(cs.empty());
+
+    random_projection(0, 1, {"src"}, 0, 100, {"tgt"}, 1, 1, 1, 3).connections_from(0, 0, 100, cs);
+    EXPECT_EQ(100u, cs.size());
+
+    EXPECT_THROW(random_projection(0, 1, {"src"}, 0, 100, {"tgt"}, 1.5, 1, 1, 3), arbor_exception);
+}
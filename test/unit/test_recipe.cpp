@@ -1,14 +1,18 @@
 #include "../gtest.h"
 
+#include <algorithm>
 #include <any>
+#include <atomic>
 #include <vector>
 
 #include <arbor/common_types.hpp>
 #include <arbor/domain_decomposition.hpp>
 #include <arbor/load_balance.hpp>
 #include <arbor/cable_cell.hpp>
+#include <arbor/lif_cell.hpp>
 #include <arbor/recipe.hpp>
 #include <arbor/simulation.hpp>
+#include <arbor/symmetric_recipe.hpp>
 
 #include <arborenv/concurrency.hpp>
 
@@ -90,6 +94,77 @@ namespace {
 
         return arb::cable_cell(tree, {}, decorations);
     }
+
+    // A ring of LIF cells, driven at gid 0, that answers the bulk queries
+    // if `bulk`, and counts the per-gid queries.
+    class lif_ring_recipe: public recipe {
+    public:
+        lif_ring_recipe(cell_size_type n, bool bulk): n_(n), bulk_(bulk) {}
+
+        cell_size_type num_cells() const override { return n_; }
+        arb::util::unique_any get_cell_description(cell_gid_type) const override {
+            lif_cell lif("src", "tgt");
+            lif.tau_m = 0.01;
+            lif.t_ref = 0;
+            lif.V_th = lif.E_L + 0.001;
+            return lif;
+        }
+        cell_kind get_cell_kind(cell_gid_type) const override {
+            ++per_gid_calls;
+            return cell_kind::lif;
+        }
+        std::vector<cell_connection> connections_on(cell_gid_type gid) const override {
+            ++per_gid_calls;
+            return {{{(gid+n_-1)%n_, "src"}, {"tgt"}, 2.f, 1.f}};
+        }
+        std::vector<arb::event_generator> event_generators(cell_gid_type gid) const override {
+            if (gid) return {};
+            return {explicit_generator({{{"tgt"}, 0.5, 2.f}})};
+        }
+
+        void cell_kinds(cell_gid_type begin, cell_gid_type end, cell_kind* out) const override {
+            if (!bulk_) return recipe::cell_kinds(begin, end, out);
+            std::fill(out, out+(end-begin), cell_kind::lif);
+        }
+        void connections_on_range(cell_gid_type begin, cell_gid_type end, connection_sink& out) const override {
+            if (!bulk_) return recipe::connections_on_range(begin, end, out);
+            for (auto gid = begin; gid<end; ++gid) {
+                out.add(reversed? end-1-(gid-begin): gid, {{(gid+n_-1)%n_, "src"}, {"tgt"}, 2.f, 1.f});
+            }
+        }
+
+        mutable std::atomic<unsigned> per_gid_calls = 0;
+        bool reversed = false;
+
+    private:
+        cell_size_type n_;
+        bool bulk_;
+    };
+
+    // A tile of LIF cells, each connected to the previous cell of the model.
+    class lif_tile: public tile {
+    public:
+        lif_tile(cell_size_type n, cell_size_type tiles, std::atomic<unsigned>& calls):
+            n_(n), tiles_(tiles), calls_(calls) {}
+
+        cell_size_type num_cells() const override { return n_; }
+        cell_size_type num_tiles() const override { return tiles_; }
+        arb::util::unique_any get_cell_description(cell_gid_type) const override { return lif_cell("src", "tgt"); }
+        cell_kind get_cell_kind(cell_gid_type) const override { return cell_kind::lif; }
+        std::vector<cell_connection> connections_on(cell_gid_type gid) const override {
+            ++calls_;
+            return {{{gid+n_*tiles_-1, "src"}, {"tgt"}, float(gid), 1.f}};
+        }
+
+    private:
+        cell_size_type n_, tiles_;
+        std::atomic<unsigned>& calls_;
+    };
+
+    struct collect_sink: connection_sink {
+        std::vector<std::pair<cell_gid_type, cell_connection>> conns;
+        void add(cell_gid_type gid, cell_connection c) override { conns.push_back({gid, std::move(c)}); }
+    };
 }
 
 TEST(recipe, gap_junctions)
@@ -243,3 +318,55 @@ TEST(recipe, event_generators) {
         EXPECT_THROW(simulation(recipe_0, decomp_0, context), arb::bad_connection_label);
     }
 }
+
+TEST(recipe, bulk_queries) {
+    auto context = make_context();
+
+    auto run = [&](lif_ring_recipe& rec) {
+        simulation sim(rec, partition_load_balance(rec, context), context);
+        std::vector<spike> spikes;
+        sim.set_global_spike_callback([&](const std::vector<spike>& s) { spikes.insert(spikes.end(), s.begin(), s.end()); });
+        sim.run(20, 0.01);
+        std::sort(spikes.begin(), spikes.end(), [](auto& a, auto& b) { return a.time<b.time; });
+        return spikes;
+    };
+
+    // The per-gid queries are not made when the bulk queries are answered.
+    lif_ring_recipe per_gid(5, false), bulk(5, true);
+    auto expected = run(per_gid);
+    EXPECT_LT(0u, per_gid.per_gid_calls);
+    EXPECT_EQ(20u, expected.size());
+    EXPECT_EQ(expected, run(bulk));
+    EXPECT_EQ(0u, bulk.per_gid_calls);
+
+    // The connections of a range must be given in order of gid.
+    bulk.reversed = true;
+    EXPECT_THROW(simulation(bulk, partition_load_balance(bulk, context), context), arbor_exception);
+}
+
+TEST(recipe, symmetric_bulk_queries) {
+    std::atomic<unsigned> calls = 0;
+    symmetric_recipe rec(std::make_unique<lif_tile>(4, 3, calls));
+    ASSERT_EQ(12u, rec.num_cells());
+
+    // The bulk queries give the connections of the per-gid queries, with
+    // the tile queried once for all its copies.
+    collect_sink bulk;
+    rec.connections_on_range(0, 5, bulk);
+    rec.connections_on_range(5, 12, bulk);
+    EXPECT_EQ(4u, calls);
+
+    ASSERT_EQ(12u, bulk.conns.size());
+    for (cell_gid_type gid = 0; gid<12; ++gid) {
+        auto expected = rec.connections_on(gid);
+        ASSERT_EQ(1u, expected.size());
+        EXPECT_EQ(gid, bulk.conns[gid].first);
+        EXPECT_EQ((gid+11)%12, bulk.conns[gid].second.source.gid);
+        EXPECT_EQ(expected[0].source.gid, bulk.conns[gid].second.source.gid);
+        EXPECT_EQ(expected[0].weight, bulk.conns[gid].second.weight);
+    }
+
+    std::vector<cell_kind> kinds(12, cell_kind::cable);
+    rec.cell_kinds(0, 12, kinds.data());
+    EXPECT_EQ(std::vector<cell_kind>(12, cell_kind::lif), kinds);
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <any>
 #include <typeinfo>
 
@@ -169,6 +170,38 @@ TEST(s_expr, iterate) {
     }
 }
 
+TEST(s_expr, long_lists) {
+    // Long lists are parsed, copied, measured and destroyed without
+    // recursing once per element.
+    const unsigned n = 200000;
+    std::string text = "(paint";
+    for (unsigned i = 0; i<n; ++i) {
+        text += " (x " + std::to_string(i) + ")";
+    }
+    text += ")";
+
+    auto e = parse_s_expr(text);
+    ASSERT_FALSE(e.is_atom());
+    EXPECT_EQ(n+1, length(e));
+    EXPECT_EQ(1u, location(e).line);
+    EXPECT_EQ(2u, location(e).column);
+
+    auto c = e;
+    EXPECT_EQ(n+1, length(c));
+    EXPECT_EQ("x", (c.begin()+n)->head().atom().spelling);
+    EXPECT_EQ(std::to_string(n-1), (c.begin()+n)->tail().head().atom().spelling);
+
+    // A moved-from expression is nil.
+    auto m = std::move(c);
+    EXPECT_FALSE(c);
+    EXPECT_EQ(n+1, length(m));
+
+    // Assigning a part of an expression to itself.
+    m = m.tail().head();
+    EXPECT_EQ(2u, length(m));
+    EXPECT_EQ("0", m.tail().head().atom().spelling);
+}
+
 template <typename L>
 std::string round_trip_label(const char* in) {
     if (auto x = parse_label_expression(in)) {
@@ -211,6 +244,7 @@ TEST(cv_policies, round_tripping) {
     auto literals = {"(every-segment (tag 42))",
                      "(fixed-per-branch 23 (segment 0) 1)",
                      "(max-extent 23.1 (segment 0) 1)",
+                     "(d-lambda 0.1 100 (segment 0) 1)",
                      "(single (segment 0))",
                      "(explicit (terminal) (segment 0))",
                      "(join (every-segment (tag 42)) (single (segment 0)))",
@@ -225,6 +259,8 @@ TEST(cv_policies, literals) {
     EXPECT_NO_THROW("(every-segment (tag 42))"_cvp);
     EXPECT_NO_THROW("(fixed-per-branch 23 (segment 0) 1)"_cvp);
     EXPECT_NO_THROW("(max-extent 23.1 (segment 0) 1)"_cvp);
+    EXPECT_NO_THROW("(d-lambda 0.1)"_cvp);
+    EXPECT_NO_THROW("(d-lambda 0.1 100 (segment 0) 1)"_cvp);
     EXPECT_NO_THROW("(single (segment 0))"_cvp);
     EXPECT_NO_THROW("(explicit (terminal) (segment 0))"_cvp);
     EXPECT_NO_THROW("(join (every-segment (tag 42)) (single (segment 0)))"_cvp);
@@ -882,6 +918,88 @@ TEST(cable_cell, round_tripping) {
     EXPECT_EQ(component_str, round_trip_component(stream));
 }
 
+// The items of a component in text form, sorted: label_dict and decor do not
+// keep the order in which labels and defaults are set.
+std::vector<std::string> component_items(const arborio::cable_cell_component& c) {
+    using namespace cable_s_expr;
+    // (arbor-component (meta-data ...) (kind item ...))
+    auto sexp = parse_s_expr(to_string(c));
+    const auto& body = *std::next(sexp.begin(), 2);
+    std::vector<std::string> items;
+    for (auto i = std::next(body.begin()); i!=body.end(); ++i) {
+        items.push_back(util::pprintf("{}", *i));
+    }
+    std::sort(items.begin(), items.end());
+    return items;
+}
+
+TEST(cable_cell, binary_round_tripping) {
+    using namespace cable_s_expr;
+    auto meta = "(meta-data (version \"" + arborio::acc_version() + "\"))";
+    std::vector<std::string> components = {
+        "(arbor-component " + meta + " (morphology"
+        "  (branch 0 -1 (segment 0 (point 0 0 0 2) (point 4 0 0 2) 1) (segment 1 (point 4 0 0 0.8) (point 8 0 0 0.8) 3))"
+        "  (branch 1 0 (segment 2 (point 8 0 0 0.8) (point 12 -0.5 0 0.8) 3))"
+        "  (branch 2 0 (segment 3 (point 8 0 0 0.8) (point 12 4 0 0.8) 3) (segment 4 (point 12 4 0 0.8) (point 18 4 0 0.4) 2))))",
+        "(arbor-component " + meta + " (label-dict"
+        "  (region-def \"soma\" (tag 1)) (region-def \"dend\" (join (tag 3) (tag 4)))"
+        "  (locset-def \"root\" (root)) (locset-def \"mid\" (location 0 0.5))))",
+        "(arbor-component " + meta + " (decor"
+        "  (default (membrane-potential -65.1)) (default (temperature-kelvin 301)) (default (axial-resistivity 102))"
+        "  (default (membrane-capacitance 0.01)) (default (ion-internal-concentration \"ca\" 75.1))"
+        "  (default (ion-external-concentration \"h\" -50.1)) (default (ion-reversal-potential \"na\" 30))"
+        "  (default (ion-reversal-potential-method \"ca\" (mechanism \"nernst/ca\")))"
+        "  (paint (region \"dend\") (mechanism \"pas\" (\"g\" 0.02)))"
+        "  (paint (tag 1) (mechanism \"hh\"))"
+        "  (paint (tag 1) (ion-internal-concentration \"ca\" 12))"
+        "  (place (locset \"root\") (current-clamp (envelope (10 0.5) (110 0.5) (110 0)) 10 0.25) \"clamp\")"
+        "  (place (location 0 0.5) (threshold-detector -10) \"detector\")"
+        "  (place (terminal) (gap-junction-site) \"gj\")"
+        "  (place (terminal) (mechanism \"expsyn\") \"syn\")))"
+    };
+
+    for (auto& text: components) {
+        auto comp = arborio::parse_component(text);
+        ASSERT_TRUE(comp) << comp.error().what();
+
+        std::stringstream bin;
+        arborio::write_component_binary(bin, *comp);
+        auto data = bin.str();
+        auto back = arborio::read_component_binary(data.data(), data.data()+data.size());
+        ASSERT_TRUE(back) << back.error().what();
+        EXPECT_EQ(component_items(*comp), component_items(*back));
+
+        // Truncated or altered data are rejected.
+        EXPECT_FALSE(arborio::read_component_binary(data.data(), data.data()+data.size()-1));
+        data[0] = 'X';
+        EXPECT_FALSE(arborio::read_component_binary(data.data(), data.data()+data.size()));
+    }
+
+    // A cable cell, from a stream.
+    std::string cell = "(arbor-component " + meta + " (cable-cell"
+        "  (morphology (branch 0 -1 (segment 0 (point 0 0 0 2) (point 4 0 0 2) 1)))"
+        "  (label-dict (region-def \"soma\" (tag 1)))"
+        "  (decor (paint (region \"soma\") (mechanism \"hh\")) (place (location 0 0.5) (threshold-detector -10) \"detector\"))))";
+    auto comp = arborio::parse_component(cell);
+    ASSERT_TRUE(comp) << comp.error().what();
+    std::stringstream bin;
+    arborio::write_component_binary(bin, *comp);
+    auto back = arborio::read_component_binary(bin);
+    ASSERT_TRUE(back) << back.error().what();
+    EXPECT_EQ(to_string(*comp), to_string(*back));
+
+    // A cv policy set as a default, which has no text form in a decor.
+    decor dec;
+    dec.set_default("(max-extent 2 (tag 3) 1)"_cvp);
+    bin.str("");
+    arborio::write_component_binary(bin, {{}, dec});
+    back = arborio::read_component_binary(bin);
+    ASSERT_TRUE(back) << back.error().what();
+    auto policy = std::get<decor>(back->component).defaults().discretization;
+    ASSERT_TRUE(policy);
+    EXPECT_EQ(to_string(*dec.defaults().discretization), to_string(*policy));
+}
+
 TEST(cable_cell_literals, errors) {
     for (auto expr: {"(membrane-potential \"56\")",  // invalid argument
                      "(axial-resistivity 1 2)",      // too many arguments to otherwise valid decor literal
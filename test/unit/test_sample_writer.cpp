@@ -0,0 +1,152 @@
+#include "../gtest.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/cable_cell.hpp>
+#include <arbor/sample_writer.hpp>
+#include <arbor/sampling.hpp>
+
+using namespace arb;
+
+namespace {
+    // Remove the file on scope exit.
+    struct temp_file {
+        std::string path;
+
+        explicit temp_file(const std::string& name):
+            path((std::filesystem::temp_directory_path()/name).string())
+        {}
+
+        ~temp_file() { std::remove(path.c_str()); }
+    };
+
+    std::vector<sample_block> read_file(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        return read_samples(in);
+    }
+}
+
+TEST(sample_writer, matrix) {
+    temp_file f("arb_test_sample_writer_matrix.bin");
+
+    // Rows of 3 values, with a time stride of 2 and row stride of 4.
+    std::vector<time_type> times = {0.5, -1, 1.0, -1, 1.5, -1};
+    std::vector<double> values = {
+        1, 2, 3, -1,
+        4, 5, 6, -1,
+        7, 8, 9, -1};
+    sample_matrix m{3, 3, times.data(), 2, values.data(), 4};
+
+    {
+        sample_writer w(f.path);
+        w.write(probe_metadata{{4, 2}, 7, 1, {}}, m);
+        w.write(probe_metadata{{5, 0}, 0, 0, {}}, sample_matrix{1, 3, times.data(), 1, values.data(), 4});
+    }
+
+    auto blocks = read_file(f.path);
+    ASSERT_EQ(2u, blocks.size());
+
+    EXPECT_EQ((cell_member_type{4, 2}), blocks[0].id);
+    EXPECT_EQ(7, blocks[0].tag);
+    EXPECT_EQ(1u, blocks[0].index);
+    EXPECT_EQ(3u, blocks[0].width);
+    EXPECT_EQ((std::vector<time_type>{0.5, 1.0, 1.5}), blocks[0].times);
+    EXPECT_EQ((std::vector<double>{1, 2, 3, 4, 5, 6, 7, 8, 9}), blocks[0].values);
+
+    EXPECT_EQ((cell_member_type{5, 0}), blocks[1].id);
+    EXPECT_EQ((std::vector<time_type>{0.5}), blocks[1].times);
+    EXPECT_EQ((std::vector<double>{1, 2, 3}), blocks[1].values);
+}
+
+TEST(sample_writer, records) {
+    temp_file f("arb_test_sample_writer_records.bin");
+
+    const double x[] = {1, 2, 3, 4};
+    std::vector<sample_record> scalar = {{0.1, &x[0]}, {0.2, &x[1]}};
+
+    const std::vector<cable_sample_range> ranges = {{x, x+2}, {x+2, x+4}};
+    std::vector<sample_record> vector = {{0.3, &ranges[0]}, {0.4, &ranges[1]}};
+
+    {
+        sample_writer w(f.path);
+        auto fn = w.sampler();
+        fn(probe_metadata{{0, 0}, 0, 0, {}}, scalar.size(), scalar.data());
+        fn(probe_metadata{{0, 1}, 0, 0, {}}, vector.size(), vector.data());
+
+        // Samples of unknown type or of differing widths are rejected.
+        int bad = 3;
+        sample_record unknown{0.5, &bad};
+        EXPECT_THROW(fn(probe_metadata{{0, 2}, 0, 0, {}}, 1, &unknown), bad_sample_file);
+
+        const cable_sample_range short_range{x, x+1};
+        std::vector<sample_record> ragged = {{0.5, &ranges[0]}, {0.6, &short_range}};
+        EXPECT_THROW(fn(probe_metadata{{0, 3}, 0, 0, {}}, ragged.size(), ragged.data()), bad_sample_file);
+    }
+
+    auto blocks = read_file(f.path);
+    ASSERT_EQ(2u, blocks.size());
+
+    EXPECT_EQ(1u, blocks[0].width);
+    EXPECT_EQ((std::vector<time_type>{0.1, 0.2}), blocks[0].times);
+    EXPECT_EQ((std::vector<double>{1, 2}), blocks[0].values);
+
+    EXPECT_EQ(2u, blocks[1].width);
+    EXPECT_EQ((std::vector<time_type>{0.3, 0.4}), blocks[1].times);
+    EXPECT_EQ((std::vector<double>{1, 2, 3, 4}), blocks[1].values);
+}
+
+TEST(sample_writer, concurrent) {
+    temp_file f("arb_test_sample_writer_concurrent.bin");
+
+    constexpr unsigned n_thread = 4;
+    constexpr unsigned n_call = 500;
+
+    // A small staging buffer, so that the I/O thread is handed many buffers.
+    sample_writer w(f.path, 256);
+    auto fn = w.matrix_sampler();
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t<n_thread; ++t) {
+        threads.emplace_back([&fn, t] {
+            for (unsigned i = 0; i<n_call; ++i) {
+                time_type time = i;
+                double v[2] = {double(t), double(i)};
+                fn(probe_metadata{{t, 0}, 0, 0, {}}, sample_matrix{1, 2, &time, 1, v, 2});
+            }
+        });
+    }
+    for (auto& t: threads) t.join();
+    w.flush();
+
+    auto blocks = read_file(f.path);
+    ASSERT_EQ(n_thread*n_call, blocks.size());
+
+    // Blocks from each thread are written in order.
+    std::vector<unsigned> next(n_thread, 0);
+    for (auto& b: blocks) {
+        auto t = b.id.gid;
+        ASSERT_LT(t, n_thread);
+        ASSERT_EQ(2u, b.values.size());
+        EXPECT_EQ(t, b.values[0]);
+        EXPECT_EQ(next[t], b.values[1]);
+        EXPECT_EQ(next[t], b.times[0]);
+        ++next[t];
+    }
+}
+
+TEST(sample_writer, bad_file) {
+    std::istringstream empty("");
+    EXPECT_THROW(read_samples(empty), bad_sample_file);
+
+    std::istringstream junk("not arbor samples");
+    EXPECT_THROW(read_samples(junk), bad_sample_file);
+
+    EXPECT_THROW(sample_writer("/nonexistent/directory/samples.bin"), file_not_found_error);
+}
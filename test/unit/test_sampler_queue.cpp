@@ -0,0 +1,130 @@
+#include "../gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <arbor/cable_cell.hpp>
+#include <arbor/sampling.hpp>
+#include <arbor/util/any_ptr.hpp>
+
+#include "sampler_queue.hpp"
+
+using namespace arb;
+
+TEST(sampler_queue, records) {
+    sampler_queue q(2, 8);
+
+    std::mutex mex;
+    std::vector<std::pair<time_type, double>> scalars;
+    std::vector<std::vector<double>> rows;
+    auto f = q.wrap(sampler_function(
+        [&](probe_metadata pm, std::size_t n, const sample_record* recs) {
+            std::lock_guard<std::mutex> lock(mex);
+            for (std::size_t i = 0; i<n; ++i) {
+                if (auto p = util::any_cast<const double*>(recs[i].data)) {
+                    scalars.push_back({recs[i].time, *p});
+                }
+                else {
+                    auto r = util::any_cast<const cable_sample_range*>(recs[i].data);
+                    rows.emplace_back(r->first, r->second);
+                }
+            }
+        }));
+
+    // The samples are copied before the call returns, and may be
+    // overwritten at once.
+    {
+        std::vector<double> v = {1, 2};
+        const double* p = v.data();
+        std::vector<sample_record> recs = {{0.5, p}, {1.5, p+1}};
+        f(probe_metadata{{0, 0}, 0, 0, {}}, 2, recs.data());
+        v = {-1, -1};
+    }
+    {
+        std::vector<double> v = {1, 2, 3, 4};
+        std::vector<cable_sample_range> ranges = {{&v[0], &v[2]}, {&v[2], &v[4]}};
+        const auto& cranges = ranges;
+        std::vector<sample_record> recs = {{0.5, &cranges[0]}, {1.5, &cranges[1]}};
+        f(probe_metadata{{1, 0}, 0, 0, {}}, 2, recs.data());
+        v = {-1, -1, -1, -1};
+    }
+    q.flush();
+
+    EXPECT_EQ((std::vector<std::pair<time_type, double>>{{0.5, 1}, {1.5, 2}}), scalars);
+    EXPECT_EQ((std::vector<std::vector<double>>{{1, 2}, {3, 4}}), rows);
+}
+
+TEST(sampler_queue, matrix) {
+    sampler_queue q(1, 4);
+
+    std::vector<time_type> times;
+    std::vector<double> values;
+    auto f = q.wrap(matrix_sampler_function(
+        [&](probe_metadata, const sample_matrix& m) {
+            for (std::size_t i = 0; i<m.n_sample; ++i) {
+                times.push_back(m.time(i));
+                for (std::size_t j = 0; j<m.width; ++j) values.push_back(m(i, j));
+            }
+        }));
+
+    // Strided times and rows are presented packed.
+    std::vector<time_type> t = {0.5, -1, 1.0, -1};
+    std::vector<double> v = {1, 2, -1, 3, 4, -1};
+    f(probe_metadata{{0, 0}, 0, 0, {}}, sample_matrix{2, 2, t.data(), 2, v.data(), 3});
+    q.flush();
+
+    EXPECT_EQ((std::vector<time_type>{0.5, 1.0}), times);
+    EXPECT_EQ((std::vector<double>{1, 2, 3, 4}), values);
+}
+
+TEST(sampler_queue, order_and_back_pressure) {
+    // With a slow callback, appends wait for the consumers once the queues
+    // are full; the calls for each probe are still made in order.
+    constexpr unsigned n_probe = 4;
+    constexpr unsigned n_call = 50;
+    sampler_queue q(2, 4);
+
+    std::mutex mex;
+    std::vector<std::vector<time_type>> seen(n_probe);
+    auto f = q.wrap(sampler_function(
+        [&](probe_metadata pm, std::size_t n, const sample_record* recs) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            std::lock_guard<std::mutex> lock(mex);
+            seen[pm.id.gid].push_back(recs[0].time);
+        }));
+
+    const double v = 0;
+    for (unsigned i = 0; i<n_call; ++i) {
+        for (unsigned p = 0; p<n_probe; ++p) {
+            sample_record r{time_type(i), &v};
+            f(probe_metadata{{p, 0}, 0, 0, {}}, 1, &r);
+        }
+    }
+    q.flush();
+
+    for (unsigned p = 0; p<n_probe; ++p) {
+        ASSERT_EQ(n_call, seen[p].size());
+        for (unsigned i = 0; i<n_call; ++i) EXPECT_EQ(time_type(i), seen[p][i]);
+    }
+}
+
+TEST(sampler_queue, exceptions) {
+    sampler_queue q(1, 4);
+    std::atomic<int> calls = 0;
+    auto f = q.wrap(sampler_function(
+        [&](probe_metadata, std::size_t, const sample_record*) {
+            if (++calls==1) throw std::runtime_error("sampler");
+        }));
+
+    const double v = 0;
+    sample_record r{0, &v};
+    f(probe_metadata{{0, 0}, 0, 0, {}}, 1, &r);
+    f(probe_metadata{{0, 0}, 0, 0, {}}, 1, &r);
+    EXPECT_THROW(q.flush(), std::runtime_error);
+    EXPECT_EQ(2, calls);
+    EXPECT_NO_THROW(q.flush());
+}
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 #include <random>
 #include <stdexcept>
 #include <vector>
@@ -348,3 +349,37 @@ TEST(schedule, poisson_offset_reset) {
     run_reset_check(poisson_schedule(3.3, 9.1, G), 1, 10, 7);
 }
 
+
+TEST(schedule, append_events) {
+    // Appending the times of a schedule gives the times of events(), for the
+    // built-in schedules called directly and for others through the interface.
+    struct halves {
+        std::vector<time_type> times_;
+        void reset() {}
+        time_event_span events(time_type t0, time_type t1) {
+            times_.clear();
+            for (auto t = std::ceil(2*t0)/2; t<t1; t += 0.5) times_.push_back(t);
+            return as_time_event_span(times_);
+        }
+    };
+
+    std::vector<schedule> scheds = {
+        regular_schedule(0.3, 0.7, 9.),
+        explicit_schedule({0.1, 1., 2.5, 2.5, 4.25, 8.}),
+        poisson_schedule(0.5, 2., std::mt19937_64(3)),
+        poisson_schedule(0.5, 2., std::minstd_rand(3)),
+        schedule(halves{})
+    };
+
+    for (auto& S: scheds) {
+        schedule R = S;
+        std::vector<time_type> out = {-1.};
+        for (time_type t: {0., 2., 2.5, 7.}) {
+            auto expected = as_vector(R.events(t, t+2.));
+            std::size_t n = out.size();
+            S.append_events(t, t+2., out);
+            EXPECT_EQ(expected, std::vector<time_type>(out.begin()+n, out.end()));
+        }
+        EXPECT_EQ(-1., out.front());
+    }
+}
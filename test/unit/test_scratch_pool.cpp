@@ -0,0 +1,58 @@
+#include <thread>
+#include <vector>
+
+#include "../gtest.h"
+
+#include "util/scratch_pool.hpp"
+
+using arb::util::scratch_pool;
+
+namespace {
+struct scratch {
+    std::vector<int> v;
+};
+using pool = scratch_pool<scratch>;
+}
+
+TEST(scratch_pool, reuse) {
+    std::vector<int>* first = nullptr;
+    {
+        auto s = pool::borrow();
+        s->v.assign(100, 1);
+        first = &s->v;
+    }
+    EXPECT_EQ(1u, pool::idle());
+
+    // A later borrow on the same thread gets the same object, with its
+    // contents and capacity.
+    auto s = pool::borrow();
+    EXPECT_EQ(first, &s->v);
+    EXPECT_EQ(100u, s->v.size());
+    EXPECT_EQ(0u, pool::idle());
+}
+
+TEST(scratch_pool, nested) {
+    auto a = pool::borrow();
+    {
+        auto b = pool::borrow();
+        EXPECT_NE(&a->v, &b->v);
+    }
+    EXPECT_EQ(1u, pool::idle());
+}
+
+TEST(scratch_pool, per_thread) {
+    std::vector<int>* here = nullptr;
+    {
+        auto s = pool::borrow();
+        here = &s->v;
+    }
+
+    std::vector<int>* there = nullptr;
+    std::thread t([&]() {
+        auto s = pool::borrow();
+        there = &s->v;
+    });
+    t.join();
+
+    EXPECT_NE(here, there);
+}
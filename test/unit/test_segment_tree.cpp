@@ -111,3 +111,59 @@ TEST(segment_tree, fuzz) {
     }
 }
 
+
+// Trees built from segment arrays match those built by appending.
+TEST(segment_tree, from_arrays) {
+    using mp = arb::mpoint;
+    using arb::mnpos;
+    using arb::msize_t;
+
+    std::mt19937 gen(0);
+    const int nseg = 1<<10;
+
+    std::vector<msize_t> parents;
+    std::vector<mp> prox, dist;
+    std::vector<int> tags;
+    arb::segment_tree expected;
+    for (int i=0; i<nseg; ++i) {
+        std::uniform_int_distribution<int> distrib(-1, i-1);
+        msize_t p = distrib(gen);
+        parents.push_back(p);
+        prox.push_back(mp{0, 0, double(p), 1});
+        dist.push_back(mp{0, 0, double(i), 1});
+        tags.push_back(i%4);
+        expected.append(p, prox.back(), dist.back(), tags.back());
+    }
+
+    arb::segment_tree tree(parents, prox, dist, tags);
+    ASSERT_EQ(expected.size(), tree.size());
+    EXPECT_EQ(expected.parents(), tree.parents());
+    for (int i=0; i<nseg; ++i) {
+        const auto& a = expected.segments()[i];
+        const auto& b = tree.segments()[i];
+        EXPECT_EQ(a.id, b.id);
+        EXPECT_EQ(a.prox, b.prox);
+        EXPECT_EQ(a.dist, b.dist);
+        EXPECT_EQ(a.tag, b.tag);
+        EXPECT_EQ(expected.is_fork(i), tree.is_fork(i));
+        EXPECT_EQ(expected.is_terminal(i), tree.is_terminal(i));
+        EXPECT_EQ(expected.is_root(i), tree.is_root(i));
+    }
+
+    arb::morphology m1(expected), m2(tree);
+    ASSERT_EQ(m1.num_branches(), m2.num_branches());
+    for (msize_t b=0; b<m1.num_branches(); ++b) {
+        EXPECT_EQ(m1.branch_parent(b), m2.branch_parent(b));
+        EXPECT_EQ(m1.branch_segments(b).size(), m2.branch_segments(b).size());
+    }
+
+    // Parents must precede their children.
+    parents[5] = 5;
+    EXPECT_THROW(arb::segment_tree(parents, prox, dist, tags), arb::invalid_segment_parent);
+    parents[5] = 7;
+    EXPECT_THROW(arb::segment_tree(parents, prox, dist, tags), arb::invalid_segment_parent);
+    parents[5] = 0;
+
+    tags.pop_back();
+    EXPECT_THROW(arb::segment_tree(parents, prox, dist, tags), arb::segment_array_size_mismatch);
+}
@@ -730,6 +730,56 @@ TYPED_TEST_P(simd_fp_value, fp_maths) {
     errno = 0;
 }
 
+// Reduced precision functions: relative error at most 1e-7 (or a few ulp,
+// for the full precision fallback in single precision).
+
+TYPED_TEST_P(simd_fp_value, fast_maths) {
+    using simd = TypeParam;
+    using fp = typename simd::scalar_type;
+    constexpr unsigned N = simd::width;
+
+    std::minstd_rand rng(1015);
+
+    fp tol = std::max(fp(1e-7), 8*std::numeric_limits<fp>::epsilon());
+    fp exp_max_arg = std::log(std::numeric_limits<fp>::max())/2;
+
+    auto check = [tol](const fp* expected, const fp* result) {
+        for (unsigned i = 0; i<N; ++i) {
+            EXPECT_NEAR(expected[i], result[i], tol*std::abs(expected[i]));
+        }
+    };
+
+    for (unsigned i = 0; i<nrounds; ++i) {
+        fp u[N], r[N], expected[N];
+
+        fill_random(u, rng, -exp_max_arg, exp_max_arg);
+
+        for (unsigned i = 0; i<N; ++i) expected[i] = std::exp(u[i]);
+        fast_exp(simd(u)).copy_to(r);
+        check(expected, r);
+
+        for (unsigned i = 0; i<N; ++i) expected[i] = std::log(u[i]*u[i]);
+        for (unsigned i = 0; i<N; ++i) r[i] = u[i]*u[i];
+        fast_log(simd(r)).copy_to(r);
+        check(expected, r);
+
+        // Exercise expm1 and exprelr about zero, as in gating rates.
+        fill_random(u, rng, fp(-2), fp(2));
+
+        for (unsigned i = 0; i<N; ++i) expected[i] = std::expm1(u[i]);
+        fast_expm1(simd(u)).copy_to(r);
+        check(expected, r);
+
+        for (unsigned i = 0; i<N; ++i) {
+            expected[i] = u[i]+fp(1)==fp(1)? fp(1): u[i]/std::expm1(u[i]);
+        }
+        fast_exprelr(simd(u)).copy_to(r);
+        check(expected, r);
+    }
+
+    errno = 0;
+}
+
 // Check special function behaviour for specific values including
 // qNAN, infinity etc.
 
@@ -866,7 +916,7 @@ TYPED_TEST_P(simd_fp_value, log_special_values) {
     }
 }
 
-REGISTER_TYPED_TEST_CASE_P(simd_fp_value, fp_maths, exp_special_values, expm1_special_values, log_special_values);
+REGISTER_TYPED_TEST_CASE_P(simd_fp_value, fp_maths, fast_maths, exp_special_values, expm1_special_values, log_special_values);
 
 typedef ::testing::Types<
 
@@ -1178,6 +1228,27 @@ TYPED_TEST_P(simd_indirect, constrained_add) {
 
         EXPECT_TRUE(::testing::indexed_almost_eq_n(buflen, test, array));
 
+        // None, with sorted indices in runs:
+
+        offset[0] = make_udist<index>(0, (int)(buflen)-N)(rng);
+        for (unsigned j = 1; j<N; ++j) {
+            offset[j] = offset[j-1]+make_udist<index>(0, 1)(rng);
+        }
+
+        make_test_array();
+        indirect(array, simd_index(offset), N, index_constraint::none) += simd(values);
+
+        EXPECT_TRUE(::testing::indexed_almost_eq_n(buflen, test, array));
+
+        // None, with repeated indices in any order:
+
+        fill_random(offset, rng, 0, 2);
+
+        make_test_array();
+        indirect(array, simd_index(offset), N, index_constraint::none) += simd(values);
+
+        EXPECT_TRUE(::testing::indexed_almost_eq_n(buflen, test, array));
+
     }
 }
 
@@ -1,23 +1,38 @@
 #include "../gtest.h"
 
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <optional>
 #include <random>
+#include <set>
+#include <sstream>
+#include <thread>
 #include <vector>
 #include <any>
 
+#include <arbor/arbexcept.hpp>
 #include <arbor/cable_cell.hpp>
 #include <arbor/common_types.hpp>
 #include <arbor/context.hpp>
 #include <arbor/domain_decomposition.hpp>
 #include <arbor/load_balance.hpp>
 #include <arbor/lif_cell.hpp>
+#include <arbor/random_projection.hpp>
 #include <arbor/recipe.hpp>
 #include <arbor/simulation.hpp>
 #include <arbor/spike_source_cell.hpp>
 
 #include "util/rangeutil.hpp"
+#include "util/span.hpp"
 #include "util/transform.hpp"
 
 #include "common.hpp"
+#include "../common_cells.hpp"
+#include "../simple_recipes.hpp"
 using namespace arb;
 
 struct play_spikes: public recipe {
@@ -190,3 +205,1160 @@ TEST(simulation, restart) {
         }
     }
 }
+
+TEST(simulation, epoch_schedule) {
+    std::vector<double> trigger_times = {1., 2., 3.};
+    lif_chain rec(5, 10, explicit_schedule(trigger_times));
+
+    auto ctx = n_thread_context(4);
+    auto decomp = partition_load_balance(rec, ctx);
+
+    auto run = [&](epoch_schedule kind, unsigned& n_epochs) {
+        simulation sim(rec, decomp, ctx);
+        sim.set_epoch_schedule(kind);
+
+        std::vector<spike> collected;
+        sim.set_global_spike_callback([&](const std::vector<spike>& spikes) {
+            collected.insert(collected.end(), spikes.begin(), spikes.end());
+        });
+        n_epochs = 0;
+        sim.set_epoch_callback([&](time_type, time_type) { ++n_epochs; });
+
+        // Run in stages that do not end on epoch boundaries.
+        for (double t: {7., 23., 42.}) {
+            EXPECT_EQ(t, sim.run(t, 0.01));
+        }
+        return collected;
+    };
+
+    unsigned n_overlapped = 0, n_serial = 0;
+    auto expected = run(epoch_schedule::overlapped, n_overlapped);
+    auto spikes = run(epoch_schedule::serial, n_serial);
+
+    // Spikes are exchanged in different batches.
+    auto spike_lt = [](spike a, spike b) { return a.time<b.time || (a.time==b.time && a.source<b.source); };
+    std::sort(expected.begin(), expected.end(), spike_lt);
+    std::sort(spikes.begin(), spikes.end(), spike_lt);
+    EXPECT_FALSE(expected.empty());
+    EXPECT_EQ(expected, spikes);
+
+    // Epochs of at most 5 ms and 10 ms, cut at the end of each stage.
+    EXPECT_EQ(10u, n_overlapped);
+    EXPECT_EQ(5u, n_serial);
+}
+
+TEST(simulation, event_storage) {
+    // Spike times and delays are multiples of dt, so that the calendar
+    // delivers every event at its own time.
+    std::vector<double> trigger_times = {1., 2., 3.};
+    lif_chain rec(5, 10, explicit_schedule(trigger_times));
+
+    auto ctx = n_thread_context(4);
+    auto decomp = partition_load_balance(rec, ctx);
+
+    auto run = [&](event_storage_kind kind) {
+        simulation sim(rec, decomp, ctx);
+        sim.set_event_storage(kind);
+
+        std::vector<spike> collected;
+        sim.set_global_spike_callback([&](const std::vector<spike>& spikes) {
+            collected.insert(collected.end(), spikes.begin(), spikes.end());
+        });
+        for (double t: {7., 23., 42.}) {
+            EXPECT_EQ(t, sim.run(t, 0.25));
+        }
+        return collected;
+    };
+
+    auto expected = run(event_storage_kind::lanes);
+    auto spikes = run(event_storage_kind::calendar);
+    EXPECT_EQ(13u, expected.size());
+    EXPECT_EQ(expected, spikes);
+}
+
+TEST(simulation, ensemble) {
+    // Chains of different lengths and delays, run together on one context,
+    // give the same spikes as when each is run on its own.
+    constexpr unsigned n_sim = 6;
+    constexpr double dt = 0.01;
+    double tfinal = 30;
+    auto ctx = n_thread_context(4);
+
+    std::vector<std::unique_ptr<lif_chain>> recs;
+    std::vector<std::unique_ptr<simulation>> sims;
+    std::vector<std::vector<spike>> collected(n_sim), expected(n_sim);
+    for (unsigned i = 0; i<n_sim; ++i) {
+        recs.push_back(std::make_unique<lif_chain>(2+i, 1.+i, explicit_schedule({1., 2.})));
+        auto decomp = partition_load_balance(*recs.back(), ctx);
+        sims.push_back(std::make_unique<simulation>(*recs.back(), decomp, ctx));
+
+        simulation single(*recs.back(), decomp, ctx);
+        single.set_global_spike_callback([&expected, i](const std::vector<spike>& spikes) {
+            expected[i].insert(expected[i].end(), spikes.begin(), spikes.end());
+        });
+        single.run(tfinal, dt);
+        sims.back()->set_global_spike_callback([&collected, i](const std::vector<spike>& spikes) {
+            collected[i].insert(collected[i].end(), spikes.begin(), spikes.end());
+        });
+    }
+
+    std::vector<simulation*> ptrs;
+    for (auto& s: sims) ptrs.push_back(s.get());
+    auto t = run_ensemble(ptrs, tfinal, dt);
+
+    for (unsigned i = 0; i<n_sim; ++i) {
+        SCOPED_TRACE(i);
+        EXPECT_EQ(tfinal, t[i]);
+        EXPECT_FALSE(expected[i].empty());
+        EXPECT_EQ(expected[i], collected[i]);
+    }
+
+    // Simulations on another context can't join the ensemble.
+    auto other_ctx = n_thread_context(2);
+    auto decomp = partition_load_balance(*recs[0], other_ctx);
+    simulation other(*recs[0], decomp, other_ctx);
+    ptrs.push_back(&other);
+    EXPECT_THROW(run_ensemble(ptrs, 2*tfinal, dt), arbor_exception);
+}
+
+TEST(simulation, epoch_callback) {
+    // Each cell of a chain spikes one delay after the one before it, on an
+    // event injected into the first cell.
+    constexpr double dt = 0.01;
+    double delay = 1;
+    lif_chain rec(3, delay, explicit_schedule(std::vector<time_type>{}));
+    auto ctx = n_thread_context(2);
+    auto decomp = partition_load_balance(rec, ctx);
+    simulation sim(rec, decomp, ctx);
+
+    std::vector<spike> collected;
+    sim.set_global_spike_callback([&](const std::vector<spike>& spikes) {
+        collected.insert(collected.end(), spikes.begin(), spikes.end());
+    });
+
+    // Events from arrays, before the run; cells not in the model are ignored.
+    std::vector<cell_gid_type> gids = {0, 7};
+    std::vector<cell_lid_type> targets = {0, 0};
+    std::vector<time_type> times = {0.5, 0.5};
+    std::vector<float> weights = {2, 2};
+    sim.inject_events(2, gids.data(), targets.data(), times.data(), weights.data());
+
+    // Closed loop: inject an event into the first cell as soon as possible
+    // after the last cell of the chain has spiked.
+    std::vector<std::pair<time_type, time_type>> calls;
+    time_type t_injected = -1;
+    sim.set_epoch_callback([&](time_type t, time_type t_inject) {
+        calls.push_back({t, t_inject});
+        bool last = std::any_of(collected.begin(), collected.end(), [](auto& s) { return s.source.gid==2; });
+        if (last && t_injected<0) {
+            time_type tev = t_inject;
+            cell_gid_type gid = 0;
+            cell_lid_type target = 0;
+            float weight = 2;
+            sim.inject_events(1, &gid, &target, &tev, &weight);
+            t_injected = tev;
+            EXPECT_THROW(sim.inject_events({{0, {{0, t_inject-dt, 2}}}}), bad_event_time);
+        }
+    });
+
+    sim.run(6, dt);
+
+    ASSERT_FALSE(calls.empty());
+    for (auto& [t, t_inject]: calls) {
+        EXPECT_LE(t, t_inject);
+    }
+    EXPECT_EQ(6., calls.back().first);
+    ASSERT_GT(t_injected, 0.);
+
+    std::vector<std::pair<cell_gid_type, time_type>> expected;
+    for (auto t0: {0.5, t_injected}) {
+        for (cell_gid_type i = 0; i<3; ++i) {
+            if (t0+i*delay<6) expected.push_back({i, t0+i*delay});
+        }
+    }
+    ASSERT_EQ(expected.size(), collected.size());
+    std::sort(collected.begin(), collected.end(), [](auto& a, auto& b) { return a.time<b.time; });
+    for (unsigned i = 0; i<expected.size(); ++i) {
+        EXPECT_EQ(expected[i].first, collected[i].source.gid);
+        EXPECT_NEAR(expected[i].second, collected[i].time, dt);
+    }
+
+    // Outside the callback, events must not precede the end of the last run.
+    EXPECT_THROW(sim.inject_events(1, gids.data(), targets.data(), times.data(), weights.data()), bad_event_time);
+}
+
+TEST(simulation, persistent_run) {
+    double delay = 2;
+    lif_chain rec(4, delay, poisson_schedule(0.5, std::mt19937_64(11)));
+    auto ctx = n_thread_context(2);
+    auto decomp = partition_load_balance(rec, ctx);
+    constexpr double dt = 0.01;
+    constexpr double tfinal = 20;
+
+    // The callbacks are called on the thread of the simulation.
+    std::mutex mutex;
+    auto record = [&mutex](simulation& sim, std::vector<spike>& collected) {
+        sim.set_global_spike_callback([&](const std::vector<spike>& spikes) {
+            std::lock_guard<std::mutex> lock(mutex);
+            collected.insert(collected.end(), spikes.begin(), spikes.end());
+        });
+    };
+
+    std::vector<spike> expected;
+    {
+        simulation sim(rec, decomp, ctx);
+        record(sim, expected);
+        sim.run(tfinal, dt);
+    }
+
+    for (auto schedule: {epoch_schedule::overlapped, epoch_schedule::serial}) {
+        simulation sim(rec, decomp, ctx);
+        sim.set_epoch_schedule(schedule);
+        std::vector<spike> collected;
+        record(sim, collected);
+
+        // Advance in steps of 1 ms, requesting the next step before the
+        // last is reached.
+        std::vector<time_type> epoch_ends;
+        sim.set_epoch_callback([&](time_type t, time_type) {
+            std::lock_guard<std::mutex> lock(mutex);
+            epoch_ends.push_back(t);
+        });
+        sim.start(dt);
+        EXPECT_THROW(sim.run(tfinal, dt), arbor_exception);
+
+        std::vector<std::future<time_type>> steps;
+        for (int i = 1; i<=tfinal; ++i) {
+            steps.push_back(sim.run_until(i));
+            if (i>1) {
+                EXPECT_EQ(i-1, steps[i-2].get());
+                std::lock_guard<std::mutex> lock(mutex);
+                EXPECT_GE(epoch_ends.back(), i-1.);
+                // Every spike up to the time reached has been delivered.
+                auto n = std::count_if(expected.begin(), expected.end(), [&](auto& s) { return s.time<i-1; });
+                EXPECT_LE(n, (long)collected.size());
+            }
+        }
+        EXPECT_EQ(tfinal, steps.back().get());
+        EXPECT_THROW(sim.run_until(tfinal-1), arbor_exception);
+        sim.stop();
+        EXPECT_THROW(sim.run_until(2*tfinal), arbor_exception);
+
+        // Each requested time is the end of an epoch.
+        for (int i = 1; i<=tfinal; ++i) {
+            EXPECT_NE(epoch_ends.end(), std::find(epoch_ends.begin(), epoch_ends.end(), time_type(i)));
+        }
+
+        auto spike_lt = [](spike a, spike b) { return a.time<b.time || (a.time==b.time && a.source<b.source); };
+        std::sort(collected.begin(), collected.end(), spike_lt);
+        auto sorted = expected;
+        std::sort(sorted.begin(), sorted.end(), spike_lt);
+        EXPECT_EQ(sorted, collected);
+
+        // The simulation continues from where it stopped.
+        EXPECT_EQ(tfinal+1, sim.run(tfinal+1, dt));
+    }
+}
+
+TEST(simulation, checkpoint) {
+    double delay = 10;
+    unsigned n = 5;
+    lif_chain rec(n, delay, poisson_schedule(0.5, std::mt19937_64(17)));
+
+    auto ctx = n_thread_context(4);
+    auto decomp = partition_load_balance(rec, ctx);
+
+    constexpr double dt = 0.01;
+    double t_checkpoint = 23.3;
+    double tfinal = 61.7;
+
+    auto spike_lt = [](spike a, spike b) { return a.time<b.time || (a.time==b.time && a.source<b.source); };
+    auto record = [](simulation& sim, std::vector<spike>& collected) {
+        sim.set_global_spike_callback([&collected](const std::vector<spike>& spikes) {
+            collected.insert(collected.end(), spikes.begin(), spikes.end());
+        });
+    };
+
+    // Uninterrupted reference run, and a run which is checkpointed at
+    // t_checkpoint with spikes in flight, and resumed in a new simulation.
+
+    std::vector<spike> expected, collected;
+
+    simulation ref(rec, decomp, ctx);
+    record(ref, expected);
+    ref.run(t_checkpoint, dt);
+    expected.clear();
+    ref.run(tfinal, dt);
+
+    std::stringstream checkpoint;
+    {
+        simulation sim(rec, decomp, ctx);
+        sim.run(t_checkpoint, dt);
+        sim.serialize(checkpoint);
+    }
+
+    simulation sim(rec, decomp, ctx);
+    sim.deserialize(checkpoint);
+    record(sim, collected);
+    EXPECT_EQ(t_checkpoint, sim.run(t_checkpoint, dt));
+    EXPECT_EQ(tfinal, sim.run(tfinal, dt));
+
+    std::sort(expected.begin(), expected.end(), spike_lt);
+    std::sort(collected.begin(), collected.end(), spike_lt);
+
+    ASSERT_FALSE(expected.empty());
+    ASSERT_EQ(expected.size(), collected.size());
+    for (unsigned i = 0; i<expected.size(); ++i) {
+        EXPECT_EQ(expected[i].source, collected[i].source);
+        EXPECT_DOUBLE_EQ(expected[i].time, collected[i].time);
+    }
+    EXPECT_EQ(ref.num_spikes(), sim.num_spikes());
+
+    // A checkpoint of a simulation of a different model is rejected.
+    lif_chain other(n+1, delay, poisson_schedule(0.5, std::mt19937_64(17)));
+    simulation other_sim(other, partition_load_balance(other, ctx), ctx);
+    checkpoint.seekg(0);
+    EXPECT_THROW(other_sim.deserialize(checkpoint), bad_checkpoint);
+}
+
+TEST(simulation, bind_threads) {
+    // Spikes are the same when cell groups are bound to pinned threads.
+    std::vector<double> trigger_times = {1., 2., 3.};
+    double delay = 10;
+    unsigned n = 8;
+    lif_chain rec(n, delay, explicit_schedule(trigger_times));
+
+    auto run = [&](bool bind) {
+        proc_allocation resources(4, -1);
+        resources.bind_threads = bind;
+        auto ctx = make_context(resources);
+
+        // One cell group per cell.
+        partition_hint_map hints;
+        hints[cell_kind::lif].cpu_group_size = 1;
+        auto decomp = partition_load_balance(rec, ctx, hints);
+        simulation sim(rec, decomp, ctx);
+
+        std::vector<spike> collected;
+        sim.set_global_spike_callback([&](const std::vector<spike>& spikes) {
+            collected.insert(collected.end(), spikes.begin(), spikes.end());
+        });
+        sim.run(trigger_times.back()+delay*n, 0.01);
+
+        std::sort(collected.begin(), collected.end(),
+            [](spike a, spike b) { return a.time<b.time || (a.time==b.time && a.source<b.source); });
+        return collected;
+    };
+
+    auto expected = run(false);
+    EXPECT_EQ(n*trigger_times.size(), expected.size());
+
+    // Binding pins the thread that creates the context: use a thread of its own.
+    std::vector<spike> bound;
+    std::thread t([&] { bound = run(true); });
+    t.join();
+    EXPECT_EQ(expected, bound);
+}
+
+TEST(simulation, group_affinity) {
+    // Spikes do not depend on the assignment of cell group updates to threads.
+    std::vector<double> trigger_times = {1., 2., 3.};
+    double delay = 10;
+    unsigned n = 8;
+    lif_chain rec(n, delay, explicit_schedule(trigger_times));
+
+    auto ctx = n_thread_context(4);
+    auto decomp = partition_load_balance(rec, ctx);
+    simulation sim(rec, decomp, ctx);
+
+    std::vector<spike> collected;
+    sim.set_global_spike_callback([&](const std::vector<spike>& spikes) {
+        collected.insert(collected.end(), spikes.begin(), spikes.end());
+    });
+
+    auto spike_lt = [](spike a, spike b) { return a.time<b.time || (a.time==b.time && a.source<b.source); };
+
+    std::vector<spike> expected;
+    for (auto affinity: {group_affinity::none, group_affinity::preferred, group_affinity::fixed}) {
+        collected.clear();
+        sim.reset();
+        sim.set_group_affinity(affinity);
+        sim.run(trigger_times.back()+delay*n, 0.01);
+        std::sort(collected.begin(), collected.end(), spike_lt);
+
+        if (affinity==group_affinity::none) {
+            expected = collected;
+            EXPECT_EQ(n*trigger_times.size(), expected.size());
+        }
+        else {
+            EXPECT_EQ(expected, collected);
+        }
+    }
+
+    // Nor on their reassignment to threads between epochs.
+    for (auto affinity: {group_affinity::preferred, group_affinity::fixed}) {
+        collected.clear();
+        sim.reset();
+        sim.set_group_affinity(affinity);
+        sim.set_group_rebalancing(1);
+        sim.run(trigger_times.back()+delay*n, 0.01);
+        std::sort(collected.begin(), collected.end(), spike_lt);
+        EXPECT_EQ(expected, collected);
+    }
+}
+
+// A network of LIF cells with random connectivity, given either as a
+// procedural projection or as the same connections enumerated per cell.
+struct lif_random_net: public recipe {
+    lif_random_net(unsigned n, bool procedural):
+        n_(n), procedural_(procedural),
+        projection_(std::make_shared<random_projection>(0, n, cell_local_label_type("src"), 1, n, cell_local_label_type("tgt"), 0.2, 2.0, 1.0, 42))
+    {}
+
+    cell_size_type num_cells() const override { return n_; }
+
+    cell_kind get_cell_kind(cell_gid_type) const override { return cell_kind::lif; }
+    util::unique_any get_cell_description(cell_gid_type) const override {
+        lif_cell lif("src", "tgt");
+        lif.tau_m = 0.01;
+        lif.t_ref = 2;
+        lif.V_th = lif.E_L + 0.001;
+        return lif;
+    }
+
+    std::vector<cell_connection> connections_on(cell_gid_type target) const override {
+        std::vector<cell_connection> conns;
+        if (procedural_) return conns;
+
+        std::vector<procedural_connection> generated;
+        for (cell_gid_type source = 0; source<n_; ++source) {
+            generated.clear();
+            projection_->connections_from(source, target, target+1, generated);
+            for (auto& c: generated) {
+                conns.push_back(cell_connection({source, "src"}, {"tgt"}, c.weight, c.delay));
+            }
+        }
+        return conns;
+    }
+
+    std::vector<std::shared_ptr<const procedural_projection>> projections() const override {
+        if (procedural_) return {projection_};
+        return {};
+    }
+
+    std::vector<event_generator> event_generators(cell_gid_type target) const override {
+        if (target) return {};
+        return {schedule_generator({"tgt"}, 2.0, explicit_schedule(std::vector<time_type>{0.5}))};
+    }
+
+    unsigned n_;
+    bool procedural_;
+    std::shared_ptr<random_projection> projection_;
+};
+
+TEST(simulation, procedural_projection) {
+    constexpr unsigned n = 50;
+    auto spike_lt = [](spike a, spike b) { return a.time<b.time || (a.time==b.time && a.source<b.source); };
+
+    auto run = [&](bool procedural) {
+        lif_random_net rec(n, procedural);
+        auto ctx = n_thread_context(4);
+        auto decomp = partition_load_balance(rec, ctx);
+        simulation sim(rec, decomp, ctx);
+
+        std::vector<spike> collected;
+        sim.set_global_spike_callback([&](const std::vector<spike>& spikes) {
+            collected.insert(collected.end(), spikes.begin(), spikes.end());
+        });
+        sim.run(10, 0.01);
+        std::sort(collected.begin(), collected.end(), spike_lt);
+        return collected;
+    };
+
+    auto expected = run(false);
+    EXPECT_LT(n, expected.size());
+    EXPECT_EQ(expected, run(true));
+}
+
+// A ring of identical soma-only cable cells, each with a voltage probe. The
+// connections have no effect on the cells, but split the simulation into
+// epochs of half their delay.
+struct soma_ring: public recipe {
+    soma_ring(unsigned n): n_(n) {
+        properties_.default_parameters = neuron_parameter_defaults;
+    }
+
+    cell_size_type num_cells() const override { return n_; }
+    cell_kind get_cell_kind(cell_gid_type) const override { return cell_kind::cable; }
+    util::unique_any get_cell_description(cell_gid_type) const override {
+        auto c = make_cell_soma_only();
+        c.decorations.place(mlocation{0, 0.5}, threshold_detector{10}, "det");
+        c.decorations.place(mlocation{0, 0.5}, "expsyn", "syn");
+        return cable_cell(c);
+    }
+    std::vector<cell_connection> connections_on(cell_gid_type gid) const override {
+        return {cell_connection({(gid+n_-1)%n_, "det"}, {"syn"}, 0., 2.)};
+    }
+    std::vector<probe_info> get_probes(cell_gid_type) const override {
+        return {cable_probe_membrane_voltage{mlocation{0, 0.5}}};
+    }
+    std::any get_global_properties(cell_kind) const override { return properties_; }
+
+    unsigned n_;
+    cable_cell_global_properties properties_;
+};
+
+TEST(simulation, reduced_sampler) {
+    constexpr unsigned n = 6;
+    soma_ring rec(n);
+    auto ctx = n_thread_context(2);
+    auto decomp = partition_load_balance(rec, ctx);
+    simulation sim(rec, decomp, ctx);
+
+    // Sum the samples of each probe by sample time.
+    std::map<time_type, double> expected;
+    std::mutex mex;
+    sim.add_sampler(all_probes, regular_schedule(0.25),
+        [&](probe_metadata, std::size_t n_rec, const sample_record* recs) {
+            std::lock_guard<std::mutex> lock(mex);
+            for (std::size_t i = 0; i<n_rec; ++i) {
+                expected[recs[i].time] += *util::any_cast<const double*>(recs[i].data);
+            }
+        });
+
+    std::vector<std::pair<time_type, double>> reduced;
+    auto h = sim.add_reduced_sampler(all_probes, regular_schedule(0.25),
+        [&](std::size_t width, std::size_t n_rec, const reduced_sample_record* recs) {
+            ASSERT_EQ(1u, width);
+            for (std::size_t i = 0; i<n_rec; ++i) {
+                reduced.push_back({recs[i].time, recs[i].values[0]});
+            }
+        }, 1, 3);
+
+    sim.run(10, 0.025);
+
+    ASSERT_EQ(expected.size(), reduced.size());
+    unsigned i = 0;
+    for (auto [t, v]: expected) {
+        EXPECT_NEAR(t, reduced[i].first, 0.025);
+        EXPECT_NEAR(v, reduced[i].second, 1e-9);
+        ++i;
+    }
+
+    // Samples must have a consistent width.
+    sim.remove_sampler(h);
+    sim.add_reduced_sampler(all_probes, regular_schedule(0.25),
+        [](std::size_t, std::size_t, const reduced_sample_record*) {}, 2);
+    sim.reset();
+    EXPECT_THROW(sim.run(1, 0.025), arbor_exception);
+}
+
+TEST(simulation, matrix_sampler) {
+    constexpr unsigned n = 4;
+    soma_ring rec(n);
+    auto ctx = n_thread_context(2);
+    auto decomp = partition_load_balance(rec, ctx);
+    simulation sim(rec, decomp, ctx);
+
+    using trace = std::vector<std::pair<time_type, double>>;
+    std::vector<trace> expected(n), traces(n);
+    std::mutex mex;
+
+    sim.add_sampler(all_probes, regular_schedule(0.1),
+        [&](probe_metadata pm, std::size_t n_rec, const sample_record* recs) {
+            std::lock_guard<std::mutex> lock(mex);
+            for (std::size_t i = 0; i<n_rec; ++i) {
+                expected[pm.id.gid].push_back({recs[i].time, *util::any_cast<const double*>(recs[i].data)});
+            }
+        });
+
+    sim.add_matrix_sampler(all_probes, regular_schedule(0.1),
+        [&](probe_metadata pm, const sample_matrix& m) {
+            std::lock_guard<std::mutex> lock(mex);
+            ASSERT_EQ(1u, m.width);
+            for (std::size_t i = 0; i<m.n_sample; ++i) {
+                traces[pm.id.gid].push_back({m.time(i), m(i, 0)});
+            }
+        });
+
+    sim.run(5, 0.025);
+
+    for (unsigned gid = 0; gid<n; ++gid) {
+        EXPECT_FALSE(traces[gid].empty());
+        EXPECT_EQ(expected[gid], traces[gid]);
+    }
+}
+
+TEST(simulation, sampler_schedules) {
+    constexpr unsigned n = 4;
+    soma_ring rec(n);
+    auto ctx = n_thread_context(2);
+    auto decomp = partition_load_balance(rec, ctx);
+    simulation sim(rec, decomp, ctx);
+
+    // Samplers with the same schedule see the same samples, whether or not
+    // a sampler with a different schedule samples in the same interval.
+    using trace = std::vector<std::pair<time_type, double>>;
+    std::vector<std::vector<trace>> traces(3, std::vector<trace>(n));
+    std::mutex mex;
+
+    auto record = [&](unsigned i) {
+        return [&, i](probe_metadata pm, std::size_t n_rec, const sample_record* recs) {
+            std::lock_guard<std::mutex> lock(mex);
+            for (std::size_t j = 0; j<n_rec; ++j) {
+                traces[i][pm.id.gid].push_back({recs[j].time, *util::any_cast<const double*>(recs[j].data)});
+            }
+        };
+    };
+
+    sim.add_sampler(all_probes, regular_schedule(0.1), record(0));
+    sim.add_sampler(all_probes, regular_schedule(0.1), record(1));
+    sim.run(2, 0.025);
+
+    sim.add_sampler(all_probes, explicit_schedule({2.05, 2.55, 3.05}), record(2));
+    sim.run(4, 0.025);
+
+    for (unsigned gid = 0; gid<n; ++gid) {
+        EXPECT_EQ(40u, traces[0][gid].size());
+        EXPECT_EQ(traces[0][gid], traces[1][gid]);
+        EXPECT_EQ(3u, traces[2][gid].size());
+    }
+}
+
+TEST(simulation, decimating_sampler) {
+    constexpr unsigned n = 4;
+    soma_ring rec(n);
+    auto ctx = n_thread_context(2);
+    auto decomp = partition_load_balance(rec, ctx);
+    simulation sim(rec, decomp, ctx);
+
+    // Sample once in every integration step, and with decimating policies
+    // once every 20 steps; sample times are mid-step so that each falls in
+    // an unambiguous step.
+    constexpr double dt = 0.025;
+    constexpr unsigned stride = 20;
+    constexpr unsigned n_step = 400;
+    std::vector<time_type> every_step, every_stride;
+    for (unsigned k = 0; k<n_step; ++k) {
+        every_step.push_back((k+0.5)*dt);
+        if (k%stride==0) every_stride.push_back((k+0.5)*dt);
+    }
+
+    std::vector<std::vector<double>> steps(n), mean(n), max(n);
+    std::mutex mex;
+
+    auto record = [&](std::vector<std::vector<double>>& out) {
+        return [&](probe_metadata pm, std::size_t n_rec, const sample_record* recs) {
+            std::lock_guard<std::mutex> lock(mex);
+            for (std::size_t i = 0; i<n_rec; ++i) {
+                out[pm.id.gid].push_back(*util::any_cast<const double*>(recs[i].data));
+            }
+        };
+    };
+
+    sim.add_sampler(all_probes, explicit_schedule(every_step), record(steps), sampling_policy::lax);
+    sim.add_sampler(all_probes, explicit_schedule(every_stride), record(mean), sampling_policy::mean);
+    sim.add_sampler(all_probes, explicit_schedule(every_stride), record(max), sampling_policy::max);
+
+    sim.run(n_step*dt, dt);
+
+    // Each decimated sample summarizes the values at the start of the steps
+    // since the previous sample, up to and including its own step.
+    for (unsigned gid = 0; gid<n; ++gid) {
+        ASSERT_EQ(n_step, steps[gid].size());
+        ASSERT_EQ(n_step/stride, mean[gid].size());
+        ASSERT_EQ(mean[gid].size(), max[gid].size());
+
+        for (unsigned k = 0; k<mean[gid].size(); ++k) {
+            auto b = steps[gid].begin() + (k? stride*(k-1)+1: 0);
+            auto e = steps[gid].begin() + stride*k+1;
+
+            EXPECT_NEAR(std::accumulate(b, e, 0.)/(e-b), mean[gid][k], 1e-9);
+            EXPECT_EQ(*std::max_element(b, e), max[gid][k]);
+        }
+    }
+}
+
+TEST(simulation, triggered_sampler) {
+    constexpr unsigned n = 2;
+    soma_ring rec(n);
+    auto ctx = n_thread_context(2);
+    auto decomp = partition_load_balance(rec, ctx);
+    simulation sim(rec, decomp, ctx);
+
+    // Sample every step for reference, mid-step, so that each sample falls
+    // in an unambiguous step and is recorded at the start of that step; the
+    // triggered sampler should see the same values at the start of the steps
+    // in its window. Both are keyed by step number.
+    constexpr double dt = 0.025;
+    constexpr unsigned n_step = 400;
+    using trace = std::vector<std::pair<time_type, double>>;
+    std::vector<std::map<long, double>> steps(n);
+    std::vector<std::vector<trace>> windows(n);
+    std::mutex mex;
+
+    std::vector<time_type> every_step;
+    for (unsigned k = 0; k<n_step; ++k) every_step.push_back((k+0.5)*dt);
+
+    sim.add_sampler(all_probes, explicit_schedule(every_step),
+        [&](probe_metadata pm, std::size_t n_rec, const sample_record* recs) {
+            std::lock_guard<std::mutex> lock(mex);
+            for (std::size_t i = 0; i<n_rec; ++i) {
+                steps[pm.id.gid][std::lround(recs[i].time/dt)] = *util::any_cast<const double*>(recs[i].data);
+            }
+        });
+    auto h = sim.add_triggered_sampler(all_probes, sampling_window{1, 2},
+        [&](probe_metadata pm, std::size_t n_rec, const sample_record* recs) {
+            std::lock_guard<std::mutex> lock(mex);
+            trace w;
+            for (std::size_t i = 0; i<n_rec; ++i) {
+                w.push_back({recs[i].time, *util::any_cast<const double*>(recs[i].data)});
+            }
+            windows[pm.id.gid].push_back(std::move(w));
+        });
+
+    // The cells do not spike; one trigger at 5 ms samples the steps that
+    // start in [4, 7] ms, that is steps 160 to 280. Steps cut short by
+    // rounding at the end of an update start a hair before the next step,
+    // and are counted with it.
+    sim.run(4, dt);
+    sim.trigger_sampler(h, 5);
+    sim.run(n_step*dt, dt);
+
+    for (unsigned gid = 0; gid<n; ++gid) {
+        ASSERT_EQ(n_step, steps[gid].size());
+        ASSERT_EQ(1u, windows[gid].size());
+        std::set<long> seen;
+        for (auto [t, v]: windows[gid][0]) {
+            long k = std::lround(t/dt);
+            EXPECT_NEAR(k*dt, t, 1e-9);
+            EXPECT_GE(k, 160);
+            EXPECT_LE(k, 280);
+            ASSERT_EQ(1u, steps[gid].count(k));
+            EXPECT_NEAR(steps[gid].at(k), v, 1e-9);
+            seen.insert(k);
+        }
+        EXPECT_EQ(121u, seen.size());
+    }
+}
+
+TEST(simulation, population_monitor) {
+    // Cells 0-5 in populations by gid%3, except that cell 5 is in none.
+    std::vector<std::vector<time_type>> times = {
+        {0.1, 0.2, 1.5}, {0.5, 2.5, 2.6}, {3.9}, {1.0, 1.1, 4.2}, {}, {0.3, 1.2}};
+
+    std::vector<schedule> spike_times;
+    for (auto& t: times) spike_times.push_back(explicit_schedule(t));
+    play_spikes rec(spike_times);
+    auto ctx = n_thread_context(2);
+    auto decomp = partition_load_balance(rec, ctx);
+    simulation sim(rec, decomp, ctx);
+
+    std::vector<population_count_record> bins;
+    std::vector<std::vector<double>> counts;
+    auto population = [](cell_gid_type gid) -> std::optional<unsigned> {
+        if (gid==5) return std::nullopt;
+        return gid%3;
+    };
+    sim.add_population_monitor(population, 3, 1.,
+        [&](std::size_t n_pop, std::size_t n_rec, const population_count_record* recs) {
+            ASSERT_EQ(3u, n_pop);
+            for (std::size_t i = 0; i<n_rec; ++i) {
+                bins.push_back(recs[i]);
+                counts.emplace_back(recs[i].counts, recs[i].counts+n_pop);
+            }
+        });
+
+    // The bin current at the end of a run is split across runs.
+    sim.run(2.5, 0.01);
+    sim.run(5, 0.01);
+
+    std::vector<std::pair<time_type, time_type>> expected_bins = {
+        {0, 1}, {1, 2}, {2, 2.5}, {2.5, 3}, {3, 4}, {4, 5}};
+    std::vector<std::vector<double>> expected_counts = {
+        {2, 1, 0}, {3, 0, 0}, {0, 0, 0}, {0, 2, 0}, {0, 0, 1}, {1, 0, 0}};
+
+    ASSERT_EQ(expected_bins.size(), bins.size());
+    for (unsigned i = 0; i<bins.size(); ++i) {
+        EXPECT_DOUBLE_EQ(expected_bins[i].first, bins[i].t0);
+        EXPECT_DOUBLE_EQ(expected_bins[i].second, bins[i].t1);
+    }
+    EXPECT_EQ(expected_counts, counts);
+}
+
+TEST(simulation, estimate_scaling) {
+    // One of four domains of a chain of LIF cells, each domain with n cells;
+    // the first cell of a domain is connected to the last of the previous one.
+    constexpr unsigned n = 10, n_domain = 4;
+    constexpr double delay = 10;
+    lif_chain rec(n*n_domain, delay, explicit_schedule(std::vector<time_type>{}));
+    auto ctx = make_context(proc_allocation{1, -1}, dry_run_info(n_domain, n));
+    auto decomp = partition_load_balance(rec, ctx);
+    simulation sim(rec, decomp, ctx);
+
+    // Every local cell spikes once in the first epoch.
+    spike_traffic traffic;
+    for (cell_gid_type gid = 0; gid<n; ++gid) {
+        traffic.spikes.push_back({{gid, 0}, 1.});
+    }
+
+    auto est = sim.estimate_scaling(traffic, 20);
+    EXPECT_EQ(int(n_domain), est.num_domains);
+    EXPECT_EQ(n, est.num_cells);
+    EXPECT_EQ(n-1, est.num_connections);
+    EXPECT_LT(0u, est.connection_bytes);
+    EXPECT_EQ(delay/2, est.epoch_length);
+    EXPECT_EQ(4u, est.num_epochs);
+
+    EXPECT_EQ(n, est.local_spikes.max);
+    EXPECT_EQ(n/4., est.local_spikes.mean);
+    EXPECT_EQ(n*n_domain, est.received_spikes.max);
+    EXPECT_EQ(n*n_domain*sizeof(spike), est.received_bytes.max);
+    EXPECT_EQ(n-1, est.events.max);
+    EXPECT_EQ(1, est.max_cell_events.max);
+
+    // Spikes at a modelled rate are all received by every domain.
+    spike_traffic modelled;
+    modelled.rate = 100;
+    est = sim.estimate_scaling(modelled, 1000);
+    EXPECT_EQ(200u, est.num_epochs);
+    EXPECT_NEAR(n*modelled.rate*est.epoch_length*1e-3, est.local_spikes.mean, 1.);
+    EXPECT_EQ(n_domain*est.local_spikes.mean, est.received_spikes.mean);
+
+    // The state of the simulation is unchanged.
+    EXPECT_EQ(0u, sim.num_spikes());
+}
+
+TEST(simulation, cost_accounting) {
+    // Every cell of the chain spikes once for each trigger, on an event from
+    // the generator or from the previous cell.
+    std::vector<double> trigger_times = {1., 2., 3.};
+    constexpr unsigned n = 5;
+    lif_chain rec(n, 10, explicit_schedule(trigger_times));
+    auto ctx = n_thread_context(2);
+    auto decomp = partition_load_balance(rec, ctx);
+    simulation sim(rec, decomp, ctx);
+
+    EXPECT_TRUE(sim.group_costs().groups.empty());
+
+    sim.set_cost_accounting(true);
+    sim.run(50, 0.01);
+
+    auto costs = sim.group_costs();
+    ASSERT_EQ(decomp.groups.size(), costs.groups.size());
+    std::vector<cell_gid_type> gids;
+    std::uint64_t events = 0, spikes = 0;
+    for (auto i: util::count_along(costs.groups)) {
+        const auto& c = costs.groups[i];
+        EXPECT_EQ(decomp.groups[i].gids, c.gids);
+        EXPECT_EQ(cell_kind::lif, c.kind);
+        EXPECT_LT(0u, c.updates);
+        EXPECT_LE(0., c.time());
+        events += c.events;
+        spikes += c.spikes;
+    }
+    EXPECT_EQ(n*trigger_times.size(), events);
+    EXPECT_EQ(sim.num_spikes(), spikes);
+
+    std::stringstream table;
+    table << costs;
+    EXPECT_NE(std::string::npos, table.str().find("lif"));
+
+    auto cell_costs = sim.cell_costs();
+    ASSERT_EQ(n, cell_costs.size());
+    for (auto i: util::count_along(costs.groups)) {
+        const auto& c = costs.groups[i];
+        for (auto gid: c.gids) {
+            EXPECT_DOUBLE_EQ(c.time()/c.gids.size(), cell_costs[gid]);
+        }
+    }
+
+    // Costs are cleared on reset.
+    sim.reset();
+    for (const auto& c: sim.group_costs().groups) {
+        EXPECT_EQ(0u, c.updates);
+        EXPECT_EQ(0u, c.events);
+    }
+}
+
+TEST(simulation, memory_footprint) {
+    constexpr unsigned n = 5;
+    lif_chain rec(n, 10, explicit_schedule({1., 2., 3.}));
+    auto ctx = make_context();
+    auto decomp = partition_load_balance(rec, ctx);
+    simulation sim(rec, decomp, ctx);
+    sim.run(20, 0.01);
+
+    auto m = sim.memory_footprint();
+    ASSERT_EQ(decomp.groups.size(), m.cell_groups.size());
+    for (const auto& g: m.cell_groups) {
+        EXPECT_LT(0u, g.host);
+        EXPECT_EQ(0u, g.device);
+    }
+    EXPECT_LT(0u, m.communicator.host);
+    EXPECT_LT(0u, m.label_resolution.host);
+    EXPECT_LT(0u, m.events.host);
+
+    auto total = m.communicator.total()+m.label_resolution.total()+m.events.total()+m.samplers.total();
+    for (const auto& g: m.cell_groups) total += g.total();
+    EXPECT_EQ(total, m.total().total());
+
+    std::stringstream table;
+    table << m;
+    EXPECT_NE(std::string::npos, table.str().find("communicator"));
+}
+
+TEST(simulation, epoch_metrics) {
+    std::vector<double> trigger_times = {1., 2., 3.};
+    constexpr unsigned n = 5;
+    lif_chain rec(n, 10, explicit_schedule(trigger_times));
+    auto ctx = n_thread_context(2);
+    auto decomp = partition_load_balance(rec, ctx);
+    simulation sim(rec, decomp, ctx);
+
+    std::vector<epoch_metrics> metrics;
+    sim.set_epoch_metrics_callback([&](const epoch_metrics& m) { metrics.push_back(m); }, 3);
+    sim.run(50, 0.01);
+
+    // Epochs of 5 ms, half the minimum delay: three windows of three
+    // epochs, and one of the last epoch at the end of the run.
+    ASSERT_EQ(4u, metrics.size());
+    time_type t = 0;
+    std::uint64_t events = 0, spikes = 0;
+    for (const auto& m: metrics) {
+        EXPECT_EQ(t, m.t0);
+        t = m.t1;
+        EXPECT_EQ(n, m.num_cells);
+        EXPECT_LE(m.max_epoch_time, m.wall_time);
+        EXPECT_LE(0., m.idle_time);
+        EXPECT_LT(0., m.speed());
+        EXPECT_LT(0u, m.memory.host);
+        EXPECT_EQ(m.regions.size(), m.region_times.size());
+        events += m.events;
+        spikes += m.spikes;
+    }
+    EXPECT_EQ(50., t);
+    EXPECT_EQ(3u, metrics.front().epochs);
+    EXPECT_EQ(1u, metrics.back().epochs);
+    EXPECT_EQ(n*trigger_times.size(), events);
+    EXPECT_EQ(sim.num_spikes(), spikes);
+
+    EXPECT_THROW(sim.set_epoch_metrics_callback([](const epoch_metrics&) {}, 0), arbor_exception);
+
+    // No metrics are recorded without a callback.
+    metrics.clear();
+    sim.set_epoch_metrics_callback();
+    sim.reset();
+    sim.run(50, 0.01);
+    EXPECT_TRUE(metrics.empty());
+}
+
+// Two spike sources onto a LIF cell that fires on any event of weight above 1:
+// the first through a plastic connection of initial weight below 1, the
+// second through a static connection that makes the LIF cell fire.
+struct stdp_pair: public recipe {
+    explicit stdp_pair(std::optional<stdp_rule> rule): rule_(rule) {}
+
+    cell_size_type num_cells() const override { return 3; }
+    cell_kind get_cell_kind(cell_gid_type gid) const override {
+        return gid<2? cell_kind::spike_source: cell_kind::lif;
+    }
+    util::unique_any get_cell_description(cell_gid_type gid) const override {
+        if (gid==0) return spike_source_cell("src", explicit_schedule({0.5, 20.}));
+        if (gid==1) return spike_source_cell("src", explicit_schedule({1.}));
+        lif_cell lif("src", "tgt");
+        lif.tau_m = 0.01;
+        lif.t_ref = 0;
+        lif.C_m = 1;
+        lif.V_th = lif.E_L + 1;
+        return lif;
+    }
+    std::vector<cell_connection> connections_on(cell_gid_type gid) const override {
+        if (gid<2) return {};
+        cell_connection plastic({0, "src"}, {"tgt"}, 0.95, 5);
+        plastic.plasticity = rule_;
+        return {plastic, cell_connection({1, "src"}, {"tgt"}, 2, 5)};
+    }
+
+    std::optional<stdp_rule> rule_;
+};
+
+TEST(simulation, stdp) {
+    auto run = [](std::optional<stdp_rule> rule) {
+        stdp_pair rec(rule);
+        auto ctx = make_context();
+        simulation sim(rec, partition_load_balance(rec, ctx), ctx);
+
+        std::vector<std::vector<time_type>> runs;
+        for (int i = 0; i<2; ++i) {
+            std::vector<time_type> times;
+            sim.set_global_spike_callback([&](const std::vector<spike>& spikes) {
+                for (auto& s: spikes) {
+                    if (s.source.gid==2) times.push_back(s.time);
+                }
+            });
+            sim.reset();
+            sim.run(30, 0.01);
+            runs.push_back(times);
+        }
+        // The weights are restored on reset.
+        EXPECT_EQ(runs[0], runs[1]);
+        return runs[0];
+    };
+
+    // Without plasticity, the first source never makes the LIF cell fire.
+    EXPECT_EQ((std::vector<time_type>{6.}), run(std::nullopt));
+
+    // Pairing the first spike of the first source at 0.5 ms with the spike of
+    // the LIF cell at 6 ms raises the weight by 0.1*exp(-5.5/20); the
+    // depression by 0.01*exp(-14/20) on its second spike at 20 ms leaves the
+    // weight above 1, and the LIF cell fires at 25 ms.
+    stdp_rule rule;
+    rule.a_plus = 0.1;
+    rule.a_minus = 0.01;
+    rule.w_max = 2;
+    EXPECT_EQ((std::vector<time_type>{6., 25.}), run(rule));
+
+    // Without potentiation, the weight stays below 1.
+    rule.a_plus = 0;
+    EXPECT_EQ((std::vector<time_type>{6.}), run(rule));
+}
+
+// A LIF chain driven by the cell {100, 0} of an external simulation.
+struct external_lif_chain: public lif_chain {
+    external_lif_chain(unsigned n, double delay): lif_chain(n, delay, explicit_schedule({})) {}
+
+    std::vector<external_connection> external_connections_on(cell_gid_type target) const override {
+        if (target) return {};
+        return {external_connection({100, 0}, {"tgt"}, weight_, 2)};
+    }
+};
+
+// An external simulation whose cells spike at fixed times, delivered in the
+// epoch in which they fall.
+struct fixed_spike_port: public external_spike_port {
+    std::vector<spike> external;
+    std::vector<spike> received;
+    std::vector<std::pair<time_type, time_type>> epochs;
+    bool pending = false;
+
+    void exchange_begin(time_type t0, time_type t1, const std::vector<spike>& local) override {
+        EXPECT_FALSE(pending);
+        pending = true;
+        epochs.push_back({t0, t1});
+        received.insert(received.end(), local.begin(), local.end());
+    }
+
+    std::vector<spike> exchange_end() override {
+        EXPECT_TRUE(pending);
+        pending = false;
+        auto [t0, t1] = epochs.back();
+        std::vector<spike> out;
+        for (auto& s: external) {
+            if (s.time>=t0 && s.time<t1) out.push_back(s);
+        }
+        return out;
+    }
+};
+
+TEST(simulation, external_spike_port) {
+    external_lif_chain rec(3, 10);
+    auto ctx = n_thread_context(4);
+    auto decomp = partition_load_balance(rec, ctx);
+
+    for (auto kind: {epoch_schedule::overlapped, epoch_schedule::serial}) {
+        SCOPED_TRACE(kind==epoch_schedule::serial? "serial": "overlapped");
+        simulation sim(rec, decomp, ctx);
+        sim.set_epoch_schedule(kind);
+
+        auto port = std::make_shared<fixed_spike_port>();
+        // Spikes of cells without connections onto the simulation are ignored.
+        port->external = {spike({100, 0}, 1.), spike({101, 0}, 2.), spike({100, 0}, 4.5)};
+        sim.set_external_spike_port(port);
+
+        std::vector<spike> collected;
+        sim.set_global_spike_callback([&](const std::vector<spike>& spikes) {
+            collected.insert(collected.end(), spikes.begin(), spikes.end());
+        });
+        sim.run(20, 0.01);
+
+        auto spike_lt = [](spike a, spike b) { return a.time<b.time || (a.time==b.time && a.source<b.source); };
+        std::sort(collected.begin(), collected.end(), spike_lt);
+        std::vector<spike> expected = {
+            spike({0, 0}, 3.), spike({0, 0}, 6.5), spike({1, 0}, 13.), spike({1, 0}, 16.5)};
+        ASSERT_EQ(expected.size(), collected.size());
+        for (unsigned i = 0; i<expected.size(); ++i) {
+            EXPECT_EQ(expected[i].source, collected[i].source);
+            EXPECT_DOUBLE_EQ(expected[i].time, collected[i].time);
+        }
+
+        // The local spikes are sent to the external simulation, in epochs
+        // no longer than the delay of the external connections allows.
+        std::sort(port->received.begin(), port->received.end(), spike_lt);
+        EXPECT_EQ(collected, port->received);
+        EXPECT_FALSE(port->pending);
+        for (auto [t0, t1]: port->epochs) {
+            EXPECT_LE(t1-t0, kind==epoch_schedule::serial? 2.: 1.);
+        }
+        EXPECT_EQ(20., port->epochs.back().second);
+    }
+}
+
+// Run a chain of cells joined by gap junctions, and record the voltages of
+// the probes of each cell every 0.1 ms.
+static std::map<cell_member_type, std::vector<double>> run_gap_junction_chain(unsigned n, double gj_interval, std::size_t& n_groups) {
+    gap_junction_chain_recipe rec(n, gj_interval);
+    auto ctx = n_thread_context(2);
+    auto decomp = partition_load_balance(rec, ctx);
+    n_groups = decomp.groups.size();
+    simulation sim(rec, decomp, ctx);
+
+    std::map<cell_member_type, std::vector<double>> traces;
+    std::mutex mex;
+    sim.add_sampler(all_probes, regular_schedule(0.1),
+        [&](probe_metadata pm, std::size_t n_rec, const sample_record* recs) {
+            std::lock_guard<std::mutex> lock(mex);
+            for (std::size_t i = 0; i<n_rec; ++i) {
+                traces[pm.id].push_back(*util::any_cast<const double*>(recs[i].data));
+            }
+        });
+    sim.run(10, 0.025);
+    return traces;
+}
+
+TEST(simulation, exchanged_gap_junctions) {
+    constexpr unsigned n = 4;
+
+    // Within one cell group.
+    std::size_t n_groups = 0;
+    auto expected = run_gap_junction_chain(n, 0, n_groups);
+    ASSERT_EQ(1u, n_groups);
+    ASSERT_EQ(2*n, expected.size());
+
+    // Each cell in its own group, with the voltages of the junctions
+    // exchanged every step: the coupling is as within a group. Each cell
+    // reads the voltages of two different sites of two different cells, so a
+    // peer voltage taken from the wrong slot changes the result.
+    auto traces = run_gap_junction_chain(n, 0.025, n_groups);
+    ASSERT_EQ(n, n_groups);
+    ASSERT_EQ(expected.size(), traces.size());
+    for (auto& [id, v]: expected) {
+        SCOPED_TRACE(id);
+        ASSERT_EQ(v.size(), traces[id].size());
+        for (auto i: util::count_along(v)) {
+            EXPECT_NEAR(v[i], traces[id][i], 1e-9);
+        }
+    }
+
+    // With the voltages held over four steps, the coupling lags, and the
+    // voltages stay within a quarter of a millivolt.
+    traces = run_gap_junction_chain(n, 0.1, n_groups);
+    ASSERT_EQ(n, n_groups);
+    for (auto& [id, v]: expected) {
+        SCOPED_TRACE(id);
+        ASSERT_EQ(v.size(), traces[id].size());
+        for (auto i: util::count_along(v)) {
+            EXPECT_NEAR(v[i], traces[id][i], 0.25);
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#include "../gtest.h"
+
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/spike.hpp>
+
+#include "communication/gathered_vector.hpp"
+#include "communication/spike_codec.hpp"
+
+using namespace arb;
+
+TEST(spike_codec, round_trip) {
+    std::vector<spike> spikes = {
+        {{0, 0}, 0.},
+        {{0, 3}, 0.125},
+        {{1, 0}, 1./3},
+        {{7, 200}, -1.},
+        {{2, 0}, 1e9},
+        {{std::numeric_limits<cell_gid_type>::max(), std::numeric_limits<cell_lid_type>::max()}, 5.},
+        {{0, 0}, std::numeric_limits<time_type>::denorm_min()},
+    };
+
+    auto bytes = encode_spikes(spikes);
+    std::vector<spike> decoded;
+    decode_spikes(bytes.data(), bytes.data()+bytes.size(), decoded);
+    EXPECT_EQ(spikes, decoded);
+
+    // Empty input.
+    decoded.clear();
+    bytes = encode_spikes(std::vector<spike>{});
+    EXPECT_TRUE(bytes.empty());
+    decode_spikes(bytes.data(), bytes.data()+bytes.size(), decoded);
+    EXPECT_TRUE(decoded.empty());
+}
+
+TEST(spike_codec, size) {
+    // Spikes sorted by source with index zero and small gid increments take
+    // one byte for the source.
+    std::vector<spike> spikes;
+    std::minstd_rand R;
+    std::uniform_real_distribution<time_type> U(10, 15);
+    for (cell_gid_type gid = 0; gid<1000; gid += 1+gid%7) {
+        spikes.push_back({{gid, 0}, U(R)});
+    }
+    auto bytes = encode_spikes(spikes);
+    EXPECT_EQ(spikes.size()*(1+sizeof(time_type)), bytes.size());
+    EXPECT_LT(bytes.size(), spikes.size()*sizeof(spike));
+
+    std::vector<spike> decoded;
+    decode_spikes(bytes.data(), bytes.data()+bytes.size(), decoded);
+    EXPECT_EQ(spikes, decoded);
+}
+
+TEST(spike_codec, partitioned) {
+    using count_type = gathered_vector<spike>::count_type;
+    std::vector<spike> spikes = {{{3, 0}, 1.}, {{5, 1}, 2.}, {{1, 0}, 3.}, {{2, 2}, 4.}};
+    gathered_vector<spike> gathered(std::vector<spike>(spikes), std::vector<count_type>{0, 2, 2, 4});
+
+    auto bytes = encode_spikes(gathered);
+    ASSERT_EQ(4u, bytes.partition().size());
+    EXPECT_EQ(0u, bytes.count(1));
+
+    auto decoded = decode_spikes(bytes);
+    EXPECT_EQ(spikes, decoded.values());
+    EXPECT_EQ(gathered.partition(), decoded.partition());
+
+    // Truncated input.
+    std::vector<spike> out;
+    const auto& b = bytes.values();
+    EXPECT_THROW(decode_spikes(b.data(), b.data()+b.size()-1, out), arbor_internal_error);
+}
@@ -1,8 +1,18 @@
 #include "../gtest.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/recipe.hpp>
 #include <arbor/schedule.hpp>
 #include <arbor/spike.hpp>
+#include <arbor/spike_replay.hpp>
 #include <arbor/spike_source_cell.hpp>
+#include <arbor/spike_writer.hpp>
 #include <arbor/util/unique_any.hpp>
 
 #include "spike_source_cell_group.hpp"
@@ -115,3 +125,142 @@ TEST(spike_source, exhaust)
     test_seq(regular_schedule(0, 1, 5));
     test_seq(explicit_schedule({0.3, 2.3, 4.7}));
 }
+
+using poisson_recipe = homogeneous_recipe<cell_kind::spike_source, poisson_source_cell>;
+
+static std::vector<spike> sorted(std::vector<spike> spikes) {
+    std::sort(spikes.begin(), spikes.end(),
+        [](const spike& a, const spike& b) { return a.source<b.source || (a.source==b.source && a.time<b.time); });
+    return spikes;
+}
+
+// Test that the spikes of Poisson sources do not depend on the division of
+// time into epochs or of the cells into groups.
+TEST(spike_source, poisson_reproducible)
+{
+    poisson_recipe rec(10u, poisson_source_cell("src", 0.5, 42, 1, 80));
+
+    std::vector<spike> once;
+    {
+        cell_label_range srcs, tgts;
+        spike_source_cell_group group({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}, rec, srcs, tgts);
+        group.advance_collect(epoch(0, 0., 100.), 1, {}, once);
+    }
+
+    std::vector<spike> split;
+    for (std::vector<cell_gid_type> gids: {std::vector<cell_gid_type>{0, 2, 4, 6, 8}, {1, 3, 5, 7, 9}}) {
+        cell_label_range srcs, tgts;
+        spike_source_cell_group group(gids, rec, srcs, tgts);
+        epoch ep(0, 0., 7.);
+        while (ep.t0<100) {
+            group.advance(ep, 1, {});
+            ep.advance_to(std::min(ep.t1+7, 100.));
+        }
+        split.insert(split.end(), group.spikes().begin(), group.spikes().end());
+    }
+
+    EXPECT_FALSE(once.empty());
+    EXPECT_EQ(sorted(once), sorted(split));
+    for (auto& s: once) {
+        EXPECT_LE(1., s.time);
+        EXPECT_GT(80., s.time);
+    }
+
+    // Sources with different gids or seeds have different spike trains.
+    auto times = [&](cell_gid_type gid) {
+        std::vector<time_type> ts;
+        for (auto& s: sorted(once)) if (s.source.gid==gid) ts.push_back(s.time);
+        return ts;
+    };
+    EXPECT_NE(times(0), times(1));
+
+    poisson_recipe rec2(1u, poisson_source_cell("src", 0.5, 43, 1, 80));
+    cell_label_range srcs, tgts;
+    spike_source_cell_group group({0}, rec2, srcs, tgts);
+    group.advance(epoch(0, 0., 100.), 1, {});
+    EXPECT_NE(times(0), spike_times(group.spikes()));
+}
+
+// Test that a population of Poisson sources spikes at the given rate, and
+// repeats its spikes after a reset.
+TEST(spike_source, poisson_rate)
+{
+    const unsigned n = 1000;
+    poisson_recipe rec(n, poisson_source_cell("src", 0.01));
+
+    std::vector<cell_gid_type> gids;
+    for (unsigned i = 0; i<n; ++i) gids.push_back(i);
+    cell_label_range srcs, tgts;
+    spike_source_cell_group group(gids, rec, srcs, tgts);
+
+    epoch ep(0, 0., 1000.);
+    group.advance(ep, 1, {});
+    auto spikes = group.spikes();
+
+    // The count is Poisson distributed with mean and variance 10^4.
+    EXPECT_NEAR(10000., spikes.size(), 400.);
+
+    group.reset();
+    group.advance(ep, 1, {});
+    EXPECT_EQ(spikes, group.spikes());
+}
+
+// Cells replaying the spikes of gids 10, 11, ... of a replay file.
+struct replay_recipe: recipe {
+    replay_recipe(cell_size_type n, std::shared_ptr<const spike_replay_file> file):
+        n_(n), file_(std::move(file)) {}
+
+    cell_size_type num_cells() const override { return n_; }
+    cell_kind get_cell_kind(cell_gid_type) const override { return cell_kind::spike_source; }
+    util::unique_any get_cell_description(cell_gid_type gid) const override {
+        return replay_source_cell("src", file_, 10+gid);
+    }
+
+    cell_size_type n_;
+    std::shared_ptr<const spike_replay_file> file_;
+};
+
+// Test that replay sources emit the recorded spikes of their gids, in the
+// epochs in which they fall, and again after a reset.
+TEST(spike_source, replay)
+{
+    auto path = (std::filesystem::temp_directory_path()/"arb_test_spike_source_replay.bin").string();
+    {
+        spike_writer w(path);
+        w.write({{{12, 0}, 4.5}, {{10, 0}, 3.}, {{11, 1}, 0.25}, {{10, 0}, 1.}});
+        w.write({{{10, 2}, 7.}, {{13, 0}, 2.}});
+    }
+
+    // The records are not ordered by gid and time as written.
+    EXPECT_THROW(spike_replay_file{path}, bad_spike_file);
+    sort_spike_file(path);
+    auto file = std::make_shared<const spike_replay_file>(path);
+    std::remove(path.c_str());
+    EXPECT_EQ(6u, file->size());
+    EXPECT_EQ(std::make_pair(std::size_t(0), std::size_t(3)), file->range(10));
+    EXPECT_EQ(std::make_pair(std::size_t(6), std::size_t(6)), file->range(14));
+
+    replay_recipe rec(3, file);
+    cell_label_range srcs, tgts;
+    spike_source_cell_group group({0, 1, 2}, rec, srcs, tgts);
+
+    std::vector<spike> spikes;
+    for (double t0: {0., 2., 4., 6.}) {
+        group.advance(epoch(0, t0, t0+2), 1, {});
+        for (auto& s: group.spikes()) {
+            EXPECT_LE(t0, s.time);
+            EXPECT_GT(t0+2, s.time);
+        }
+        spikes.insert(spikes.end(), group.spikes().begin(), group.spikes().end());
+        group.clear_spikes();
+    }
+
+    // The gid 13 of the file is not replayed, and all spikes of a replayed
+    // gid come from the source of its cell.
+    std::vector<spike> expected = {{{0, 0}, 1.}, {{0, 0}, 3.}, {{0, 0}, 7.}, {{1, 0}, 0.25}, {{2, 0}, 4.5}};
+    EXPECT_EQ(expected, sorted(spikes));
+
+    group.reset();
+    group.advance(epoch(0, 0., 10.), 1, {});
+    EXPECT_EQ(expected, sorted(group.spikes()));
+}
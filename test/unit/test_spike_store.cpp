@@ -1,9 +1,13 @@
 #include "../gtest.h"
 
+#include <algorithm>
+#include <vector>
+
 #include <arbor/spike.hpp>
 #include <arborenv/concurrency.hpp>
 
 #include "execution_context.hpp"
+#include "threading/threading.hpp"
 #include "thread_private_spike_store.hpp"
 
 using arb::spike;
@@ -114,3 +118,71 @@ TEST(spike_store, gather)
         EXPECT_EQ(spikes[i].time, gathered_spikes[i].time);
     }
 }
+
+TEST(spike_store, gather_into_buffer)
+{
+    using store_type = arb::thread_private_spike_store;
+
+    arb::proc_allocation resources;
+    if (auto nt = arbenv::get_env_num_threads()) {
+        resources.num_threads = nt;
+    }
+    else {
+        resources.num_threads = arbenv::thread_concurrency();
+    }
+
+    arb::execution_context context(resources);
+    store_type store(context.thread_pool);
+
+    std::vector<spike> spikes =
+        { {{0,0}, 0.0f}, {{1,2}, 0.5f}, {{2,4}, 1.0f} };
+
+    // Previous contents of the buffer are replaced.
+    std::vector<spike> buffer = { {{7,7}, 7.0f} };
+
+    // Spikes are appended in per-thread insertion order.
+    store.insert({spikes[0]});
+    store.insert({spikes[1], spikes[2]});
+    store.gather(buffer);
+    EXPECT_EQ(spikes, buffer);
+
+    store.clear();
+    store.gather(buffer);
+    EXPECT_TRUE(buffer.empty());
+}
+
+TEST(spike_store, gather_sorted)
+{
+    using store_type = arb::thread_private_spike_store;
+
+    arb::proc_allocation resources;
+    resources.num_threads = 4;
+    arb::execution_context context(resources);
+    store_type store(context.thread_pool);
+
+    // Groups of interleaved gids are added from tasks as runs, in reverse
+    // order within each group, followed by spikes that are not in a run.
+    constexpr int n_group = 37;
+    constexpr int n_per_group = 11;
+    arb::threading::parallel_for::apply(0, n_group, context.thread_pool.get(),
+        [&](int g) {
+            auto& buffer = store.get();
+            for (int i = n_per_group-1; i>=0; --i) {
+                buffer.push_back({{arb::cell_gid_type(i*n_group+g), 0}, float(g)});
+            }
+            store.close_run();
+        });
+    store.insert({{{2000, 0}, 0.f}, {{1000, 0}, 0.f}});
+
+    std::vector<spike> expected = store.gather();
+    std::sort(expected.begin(), expected.end(),
+        [](const spike& a, const spike& b) { return a.source<b.source; });
+
+    std::vector<spike> buffer;
+    store.gather_sorted(buffer);
+    EXPECT_EQ(expected, buffer);
+
+    store.clear();
+    store.gather_sorted(buffer);
+    EXPECT_TRUE(buffer.empty());
+}
@@ -0,0 +1,110 @@
+#include "../gtest.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arbor/arbexcept.hpp>
+#include <arbor/spike.hpp>
+#include <arbor/spike_writer.hpp>
+
+using namespace arb;
+
+namespace {
+    // Remove the file on scope exit.
+    struct temp_file {
+        std::string path;
+
+        explicit temp_file(const std::string& name):
+            path((std::filesystem::temp_directory_path()/name).string())
+        {}
+
+        ~temp_file() { std::remove(path.c_str()); }
+    };
+
+    std::vector<spike> read_file(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        return read_spikes(in);
+    }
+}
+
+TEST(spike_writer, round_trip) {
+    temp_file f("arb_test_spike_writer_round_trip.bin");
+
+    std::vector<spike> a = {{{3, 0}, 0.5}, {{1, 2}, 0.25}};
+    std::vector<spike> b = {{{4000000000u, 65535}, 1000.125}};
+
+    {
+        spike_writer w(f.path);
+        auto fn = w.callback();
+        fn(a);
+        fn({});
+        fn(b);
+
+        // Spikes with a source index that does not fit are rejected.
+        std::vector<spike> bad = {{{0, 0}, 2.}, {{0, 65536}, 2.}};
+        EXPECT_THROW(fn(bad), bad_spike_file);
+    }
+
+    std::ifstream in(f.path, std::ios::binary|std::ios::ate);
+    EXPECT_EQ(sizeof spike_file_magic + 3*spike_file_record_size, std::size_t(in.tellg()));
+
+    // Times are stored in single precision, which represents these exactly.
+    std::vector<spike> expected = a;
+    expected.insert(expected.end(), b.begin(), b.end());
+    EXPECT_EQ(expected, read_file(f.path));
+}
+
+TEST(spike_writer, concurrent) {
+    temp_file f("arb_test_spike_writer_concurrent.bin");
+
+    constexpr unsigned n_thread = 4;
+    constexpr unsigned n_call = 500;
+
+    // A small staging buffer, so that the I/O thread is handed many buffers.
+    spike_writer w(f.path, 64);
+    auto fn = w.callback();
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t<n_thread; ++t) {
+        threads.emplace_back([&fn, t] {
+            for (unsigned i = 0; i<n_call; ++i) {
+                fn({{{t, 0}, double(i)}, {{t, 1}, double(i)}});
+            }
+        });
+    }
+    for (auto& t: threads) t.join();
+    w.flush();
+
+    auto spikes = read_file(f.path);
+    ASSERT_EQ(2*n_thread*n_call, spikes.size());
+
+    // Spikes from each call are contiguous, and from each thread in order.
+    std::vector<unsigned> next(n_thread, 0);
+    for (std::size_t i = 0; i<spikes.size(); i += 2) {
+        auto t = spikes[i].source.gid;
+        ASSERT_LT(t, n_thread);
+        EXPECT_EQ((spike{{t, 0}, double(next[t])}), spikes[i]);
+        EXPECT_EQ((spike{{t, 1}, double(next[t])}), spikes[i+1]);
+        ++next[t];
+    }
+}
+
+TEST(spike_writer, bad_file) {
+    std::istringstream empty("");
+    EXPECT_THROW(read_spikes(empty), bad_spike_file);
+
+    std::istringstream junk("not arbor spikes");
+    EXPECT_THROW(read_spikes(junk), bad_spike_file);
+
+    std::string truncated(spike_file_magic, sizeof spike_file_magic);
+    truncated += "abc";
+    std::istringstream short_record(truncated);
+    EXPECT_THROW(read_spikes(short_record), bad_spike_file);
+
+    EXPECT_THROW(spike_writer("/nonexistent/directory/spikes.bin"), file_not_found_error);
+}
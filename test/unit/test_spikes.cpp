@@ -204,6 +204,71 @@ TEST(SPIKES_TEST_CLASS, threshold_watcher) {
     EXPECT_FALSE(watch.is_crossed(2));
 }
 
+TEST(SPIKES_TEST_CLASS, threshold_watcher_many) {
+    using value_type = backend::value_type;
+    using index_type = backend::index_type;
+    using array = backend::array;
+    using iarray = backend::iarray;
+
+    // Enough detectors that the multicore watcher tests them both in SIMD
+    // blocks and one at a time; check against the crossing rule directly.
+    execution_context context;
+    const unsigned n = 37;
+
+    std::vector<index_type> index(n), src_to_spike_vec(n);
+    std::vector<value_type> thresh(n);
+    for (unsigned i = 0; i<n; ++i) {
+        index[i] = 2*i;
+        src_to_spike_vec[i] = n-1-i;
+        thresh[i] = 0.1*(i%5);
+    }
+
+    iarray cell_index(2*n, 0);
+    array values(2*n, 0.);
+    array time_before(1, 0.), time_after(1, 0.);
+    iarray src_to_spike(n);
+    memory::copy(src_to_spike_vec, src_to_spike);
+    array time_since_spike(n, -1.0);
+
+    backend::threshold_watcher watch(cell_index.data(), values.data(), src_to_spike.data(),
+                                     &time_before, &time_after, index, thresh, context);
+
+    std::vector<value_type> v(2*n, 0.), v_prev(n, 0.);
+    std::vector<bool> crossed(n);
+    for (unsigned i = 0; i<n; ++i) crossed[i] = 0.>=thresh[i];
+
+    for (unsigned step = 1; step<=8; ++step) {
+        for (unsigned i = 0; i<n; ++i) {
+            v[2*i] = ((i*7+step*3)%11)*0.05;
+        }
+        memory::copy(v, values);
+        memory::copy(time_after, time_before);
+        memory::fill(time_after, (value_type)step);
+        watch.test(&time_since_spike);
+
+        std::vector<threshold_crossing> expected;
+        for (unsigned i = 0; i<n; ++i) {
+            auto x = v[2*i];
+            if (!crossed[i] && x>=thresh[i]) {
+                auto pos = (thresh[i] - v_prev[i])/(x - v_prev[i]);
+                expected.push_back({i, math::lerp(step-1., (double)step, pos)});
+            }
+            crossed[i] = x>=thresh[i];
+            v_prev[i] = x;
+            EXPECT_EQ(crossed[i], watch.is_crossed(i));
+        }
+
+        auto crossings = watch.crossings();
+        util::sort_by(crossings, [](auto& c) { return c.index; });
+        ASSERT_EQ(expected.size(), crossings.size());
+        for (unsigned k = 0; k<expected.size(); ++k) {
+            EXPECT_EQ(expected[k].index, crossings[k].index);
+            EXPECT_DOUBLE_EQ(expected[k].time, crossings[k].time);
+        }
+        watch.clear_crossings();
+    }
+}
+
 TEST(SPIKES_TEST_CLASS, threshold_watcher_interpolation) {
     double dt = 0.025;
     double duration = 1;
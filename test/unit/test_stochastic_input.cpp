@@ -0,0 +1,128 @@
+#include "../gtest.h"
+
+#include <cmath>
+#include <vector>
+
+#include "backends/multicore/shared_state.hpp"
+#include "backends/stochastic_input.hpp"
+#include "fvm_layout.hpp"
+#include "util/span.hpp"
+
+using namespace arb;
+
+TEST(stochastic_input, count) {
+    // The counts drawn for the steps of a long run have the mean and variance
+    // of the Poisson distribution.
+    const unsigned n = 200000;
+    const double dt = 0.025;
+    for (double lambda: {0.05, 0.8, 6.}) {
+        double sum = 0, sum_sq = 0;
+        for (auto k: util::make_span(n)) {
+            double c = stochastic_input_count(lambda, stochastic_input_uniform(1, 2, k*dt));
+            sum += c;
+            sum_sq += c*c;
+        }
+        double mean = sum/n;
+        double var = sum_sq/n - mean*mean;
+        EXPECT_NEAR(lambda, mean, 5*std::sqrt(lambda/n));
+        EXPECT_NEAR(lambda, var, 0.05*lambda);
+    }
+
+    // No events are drawn for a zero mean, even for a variate near one.
+    EXPECT_EQ(0u, stochastic_input_count(0, 1-1e-16));
+}
+
+TEST(stochastic_input, white_noise) {
+    // The pairs drawn for the steps of a long run are uncorrelated standard
+    // normal samples.
+    const unsigned n = 100000;
+    const double dt = 0.025;
+    const auto stream = white_noise_stream("ou_syn");
+    const auto instance = white_noise_instance(12, 3);
+    double sum = 0, sum_sq = 0, sum_pair = 0, sum_next = 0, sum_tail = 0;
+    double z_prev = 0;
+    for (auto k: util::make_span(n)) {
+        auto z = white_noise_normals(1, stream, instance, k*dt);
+        sum += z.z0+z.z1;
+        sum_sq += z.z0*z.z0+z.z1*z.z1;
+        sum_pair += z.z0*z.z1;
+        sum_next += z.z0*z_prev;
+        sum_tail += std::abs(z.z0)>3;
+        z_prev = z.z0;
+    }
+    EXPECT_NEAR(0, sum/(2*n), 5/std::sqrt(2*n));
+    EXPECT_NEAR(1, sum_sq/(2*n), 0.02);
+    EXPECT_NEAR(0, sum_pair/n, 5/std::sqrt(n));
+    EXPECT_NEAR(0, sum_next/n, 5/std::sqrt(n));
+    EXPECT_NEAR(0.0027, sum_tail/n, 0.001);
+
+    // The samples are a function of the key, counter and time only, and
+    // differ between seeds, mechanisms, cells, instances and pairs.
+    auto z = white_noise_normals(1, stream, instance, 0.5);
+    EXPECT_EQ(z.z0, white_noise_normals(1, stream, instance, 0.5).z0);
+    EXPECT_NE(z.z0, white_noise_normals(2, stream, instance, 0.5).z0);
+    EXPECT_NE(z.z0, white_noise_normals(1, white_noise_stream("ou_syn2"), instance, 0.5).z0);
+    EXPECT_NE(z.z0, white_noise_normals(1, stream, white_noise_instance(13, 3), 0.5).z0);
+    EXPECT_NE(z.z0, white_noise_normals(1, stream, white_noise_instance(12, 4), 0.5).z0);
+    EXPECT_NE(z.z0, white_noise_normals(1, stream, instance | 1, 0.5).z0);
+    EXPECT_NE(z.z0, white_noise_normals(1, stream, instance, 0.5+dt).z0);
+}
+
+TEST(stochastic_input, multicore_sample) {
+    // Inputs to two instances of mechanism 3, one of which has most of them,
+    // and to an instance of mechanism 5, in two integration domains: enough
+    // inputs to be drawn both with SIMD and one at a time.
+    fvm_stochastic_input_config config;
+    config.mech_id = {3, 3, 5};
+    config.mech_index = {0, 2, 1};
+    config.instance_divs = {0, 1, 12, 13};
+    for (auto i: util::make_span(13)) {
+        config.intdom.push_back(i%2);
+        config.weight.push_back(0.5+i);
+        config.rate.push_back(5*(i+1));
+        config.tstart.push_back(i==4? 1: 0);
+        config.tstop.push_back(i==5? 0.5: 10);
+        config.seed.push_back(7);
+        config.stream.push_back(i);
+    }
+
+    multicore::stochastic_input_state state(config, 1);
+    multicore::array time(2), dt(2);
+    time[0] = 0.5;
+    time[1] = 0.75;
+    dt[0] = 0.025;
+    dt[1] = 0.0125;
+    state.sample(time, dt);
+
+    // The weight of the event of each instance is the sum of the weights of
+    // the events drawn for its inputs that are active at the start of the step.
+    ASSERT_EQ(3u, state.events_.size());
+    double total = 0;
+    for (auto j: util::make_span(3)) {
+        double w = 0;
+        for (auto i = config.instance_divs[j]; i<config.instance_divs[j+1]; ++i) {
+            auto d = config.intdom[i];
+            bool active = time[d]>=config.tstart[i] && time[d]<config.tstop[i];
+            double u = stochastic_input_uniform(config.seed[i], config.stream[i], time[d]);
+            w += stochastic_input_count(active? config.rate[i]*dt[d]: 0, u)*config.weight[i];
+        }
+        EXPECT_EQ(config.mech_id[j], state.events_[j].mech_id);
+        EXPECT_EQ(config.mech_index[j], state.events_[j].mech_index);
+        EXPECT_DOUBLE_EQ(w, state.events_[j].weight);
+        total += w;
+    }
+    EXPECT_GT(total, 0);
+
+    // The events of each mechanism form one stream.
+    auto s3 = state.events(3);
+    ASSERT_EQ(1u, s3.n_streams);
+    EXPECT_EQ(0, s3.begin[0]);
+    EXPECT_EQ(2, s3.end[0]);
+
+    auto s5 = state.events(5);
+    ASSERT_EQ(1u, s5.n_streams);
+    EXPECT_EQ(2, s5.begin[0]);
+    EXPECT_EQ(3, s5.end[0]);
+
+    EXPECT_EQ(0u, state.events(4).n_streams);
+}
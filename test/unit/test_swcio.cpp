@@ -4,6 +4,7 @@
 #include <sstream>
 
 #include <arbor/cable_cell.hpp>
+#include <arbor/context.hpp>
 #include <arbor/morph/morphology.hpp>
 #include <arbor/morph/primitives.hpp>
 
@@ -253,6 +254,38 @@ TEST(swc_parser, stream_validity) {
 
 }
 
+TEST(swc_parser, buffer_parse) {
+    // Numbers parsed from a buffer are those parsed by a stream, for values
+    // on and off the exact fast path.
+    std::string text =
+        "# metadata\n"
+        "#\tmore\n"
+        "1 1 0.1 -2.5e-3 +3 .4 -1\n"
+        "  2\t3 1e22 1.7976931348623157e308 123456789012345678901234 4.9e-324 1\r\n"
+        "3 1 0.30000000000000004 -0 1E+2 7. 2 trailing text\n"
+        "4 2 0.000001 12345.678901 9007199254740993 2.2250738585072014e-308 3\n"
+        "\n"
+        "5 1 0 0 0 1 4\n";
+
+    std::istringstream is(text);
+    auto expected = parse_swc(is);
+    auto data = parse_swc(text);
+
+    EXPECT_EQ(expected.metadata(), data.metadata());
+    ASSERT_EQ(4u, data.records().size());
+    for (unsigned i = 0; i<4; ++i) {
+        const auto& a = expected.records()[i];
+        const auto& b = data.records()[i];
+        EXPECT_EQ(a, b);
+        EXPECT_EQ(a.tag, b.tag);
+    }
+
+    // Parsing stops at the first line that is not a record.
+    EXPECT_EQ(1u, parse_swc("1 1 0 0 0 1 -1\n2 1 0 0 0 1x1\n3 1 0 0 0 1 2\n").records().size());
+    EXPECT_EQ(0u, parse_swc("1 1 0 0 0 1 99999999999\n").records().size());
+    EXPECT_EQ(0u, parse_swc("1.0 1 0 0 0 1 -1\n").records().size());
+}
+
 TEST(swc_parser, arbor_compliant) {
     {
         // Otherwise, ensure segment ends and tags correspond.
@@ -797,5 +830,16 @@ TEST(swc_parser, from_neuromorpho)
 
     auto data = parse_swc(fid);
     EXPECT_EQ(5799u, data.records().size());
+
+    // Files loaded in parallel match those parsed from a stream.
+    auto ctx = arb::make_context(arb::proc_allocation(4, -1));
+    auto parsed = parse_swc_files({fname, fname, fname}, ctx);
+    ASSERT_EQ(3u, parsed.size());
+    for (const auto& d: parsed) {
+        EXPECT_EQ(data.metadata(), d.metadata());
+        EXPECT_EQ(data.records(), d.records());
+    }
+
+    EXPECT_THROW(parse_swc_files({fname, datadir + "/no_such_file.swc"}, ctx), arb::file_not_found_error);
 }
 #endif
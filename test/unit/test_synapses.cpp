@@ -90,7 +90,7 @@ TEST(synapses, syn_basic_state) {
 
     shared_state state(num_intdom,
         num_intdom,
-        0,
+        {},
         std::vector<index_type>(num_comp, 0),
         std::vector<index_type>(num_comp, 0),
         {},
@@ -183,3 +183,68 @@ TEST(synapses, syn_basic_state) {
     EXPECT_TRUE(testing::seq_almost_eq<fvm_value_type>(expected, mechanism_field(exp2syn, "B")));
 }
 
+
+TEST(synapses, additive_events) {
+    using value_type = fvm_value_type;
+    using index_type = fvm_index_type;
+
+    int num_syn = 4;
+    int num_comp = 4;
+    int num_intdom = 1;
+
+    value_type temp_K = *neuron_parameter_defaults.temperature_K;
+
+    auto expsyn = unique_cast<mechanism>(global_default_catalogue().instance(backend::kind, "expsyn").mech);
+    ASSERT_TRUE(expsyn);
+    EXPECT_TRUE(expsyn->mech_.has_additive_events);
+
+    shared_state state(num_intdom,
+        num_intdom,
+        {},
+        std::vector<index_type>(num_comp, 0),
+        std::vector<index_type>(num_comp, 0),
+        {},
+        std::vector<value_type>(num_comp, -65),
+        std::vector<value_type>(num_comp, temp_K),
+        std::vector<value_type>(num_comp, 1.),
+        std::vector<index_type>(0),
+        expsyn->data_alignment());
+
+    state.reset();
+
+    std::vector<index_type> syn_cv(num_syn, 0);
+    std::vector<index_type> syn_mult(num_syn, 1);
+    std::vector<value_type> syn_weight(num_syn, 1.0);
+
+    state.instantiate(*expsyn, 0, {}, {syn_cv, syn_weight, syn_mult});
+    expsyn->initialize();
+
+    // Events for synapses 3, 1 and 3 again, and one for another mechanism.
+
+    std::vector<deliverable_event> events = {
+        {0., {0, 3, 0}, 1.5f},
+        {0., {0, 1, 0}, 3.0f},
+        {0., {1, 2, 0}, 7.0f},
+        {0., {0, 3, 0}, 0.25f}
+    };
+    state.deliverable_events.init(events);
+    state.deliverable_events.mark_until_after(state.time);
+
+    auto evts = state.marked_events(*expsyn);
+    ASSERT_EQ(1u, evts.n_streams);
+    ASSERT_EQ(2, evts.end[0]-evts.begin[0]);
+
+    auto ev = evts.events + evts.begin[0];
+    EXPECT_EQ(0u, ev[0].mech_id);
+    EXPECT_EQ(1u, ev[0].mech_index);
+    EXPECT_EQ(3.0f, ev[0].weight);
+    EXPECT_EQ(0u, ev[1].mech_id);
+    EXPECT_EQ(3u, ev[1].mech_index);
+    EXPECT_EQ(1.75f, ev[1].weight);
+
+    expsyn->deliver_events(evts);
+
+    using fvec = std::vector<fvm_value_type>;
+    EXPECT_TRUE(testing::seq_almost_eq<fvm_value_type>(
+        fvec({0, 3.0, 0, 1.75}), mechanism_field(expsyn, "g")));
+}
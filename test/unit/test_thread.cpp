@@ -1,8 +1,13 @@
 #include "../gtest.h"
 #include "common.hpp"
 
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <memory>
 #include <ostream>
+#include <thread>
+#include <vector>
 // (Pending abstraction of threading interface)
 #include <arbor/version.hpp>
 
@@ -190,6 +195,26 @@ TEST(task_group, parallel_for) {
 }
 
 
+TEST(task_group, parallel_for_auto_partition) {
+    // Every index is visited exactly once, for ranges that do not divide
+    // evenly into pieces, and with a non-zero origin.
+    for (int nthreads = 1; nthreads < 20; nthreads*=2) {
+        task_system ts(nthreads);
+        for (int n: {1, 2, 3, 7, 97, 1000, 12347}) {
+            std::vector<std::atomic<int>> visits(n);
+            parallel_for::apply(5, 5+n, &ts, [&](int i) { ++visits[i-5]; });
+            for (int i = 0; i < n; i++) {
+                EXPECT_EQ(1, visits[i]);
+            }
+        }
+        // Empty and reversed ranges are no-ops.
+        int count = 0;
+        parallel_for::apply(3, 3, &ts, [&](int) { ++count; });
+        parallel_for::apply(3, 1, &ts, [&](int) { ++count; });
+        EXPECT_EQ(0, count);
+    }
+}
+
 TEST(task_group, manual_nested_parallel_for) {
     // Check for deadlock or stack overflow
     const int ntasks = 100000;
@@ -382,6 +407,249 @@ TEST(task_group, multi_nested_parallel_for_unbalanced) {
     }
 }
 
+TEST(work_stealing_deque, push_take_steal) {
+    work_stealing_deque d;
+    std::vector<int> order;
+
+    // Push enough tasks to grow the deque's ring buffer.
+    const int n = 200;
+    for (int i = 0; i<n; ++i) {
+        d.push(new task([&order, i] { order.push_back(i); }));
+    }
+
+    // Steal takes the oldest task; take the most recent.
+    std::unique_ptr<task> t(d.steal());
+    ASSERT_TRUE(t);
+    (*t)();
+    t.reset(d.take());
+    ASSERT_TRUE(t);
+    (*t)();
+    EXPECT_EQ((std::vector<int>{0, n-1}), order);
+
+    int count = 2;
+    while (auto p = d.take()) {
+        delete p;
+        ++count;
+    }
+    EXPECT_EQ(n, count);
+    EXPECT_EQ(nullptr, d.steal());
+}
+
+TEST(work_stealing_deque, concurrent_steal) {
+    // Each task must be run exactly once, whether taken by the owner or stolen.
+    const int n = 100000;
+    const int n_thieves = 3;
+    std::vector<std::atomic<int>> runs(n);
+    work_stealing_deque d;
+    std::atomic<bool> done{false};
+
+    auto steal = [&] {
+        while (!done) {
+            if (auto t = d.steal()) {
+                (*t)();
+                delete t;
+            }
+        }
+    };
+    std::vector<std::thread> thieves;
+    for (int i = 0; i<n_thieves; ++i) {
+        thieves.emplace_back(steal);
+    }
+
+    for (int i = 0; i<n; ++i) {
+        d.push(new task([&runs, i] { ++runs[i]; }));
+        if (i%3==0) {
+            if (auto t = d.take()) {
+                (*t)();
+                delete t;
+            }
+        }
+    }
+    while (auto t = d.take()) {
+        (*t)();
+        delete t;
+    }
+    // Wait for thieves to finish any task in hand.
+    done = true;
+    for (auto& t: thieves) t.join();
+
+    for (int i = 0; i<n; ++i) {
+        EXPECT_EQ(1, runs[i]) << "task " << i;
+    }
+}
+
+TEST(task_group, work_stealing_nested_parallel_for) {
+    for (int nthreads = 1; nthreads < 20; nthreads*=2) {
+        task_system ts(nthreads, true);
+
+        ftor_parallel_wait f(&ts);
+        task_group g(&ts);
+        for (int i = 0; i < nthreads; i++) {
+            g.run(f);
+        }
+        g.wait();
+
+        for (int m = 1; m < 512; m *= 4) {
+            for (int n = 0; n < 1000; n = !n ? 1 : 4 * n) {
+                std::vector<std::vector<int>> v(n, std::vector<int>(m, -1));
+                parallel_for::apply(0, n, &ts, [&](int i) {
+                    auto& w = v[i];
+                    parallel_for::apply(0, m, &ts, [&](int j) { w[j] = i + j; });
+                });
+                for (int i = 0; i < n; i++) {
+                    for (int j = 0; j < m; j++) {
+                        EXPECT_EQ(i + j, v[i][j]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(task_group, work_stealing_unbalanced) {
+    const int ntasks = 100000;
+    for (int nthreads = 1; nthreads < 20; nthreads *= 4) {
+        task_system ts(nthreads, true);
+        std::vector<int> v(ntasks);
+        parallel_for::apply(0, ntasks, &ts, [&](int i) {
+            parallel_for::apply(0, 1, &ts, [&](int j) { v[i] = i; });
+        });
+        for (int i = 0; i < ntasks; i++) {
+            EXPECT_EQ(i, v[i]);
+        }
+
+        std::vector<int> u(ntasks);
+        parallel_for::apply(0, 1, &ts, [&](int i) {
+            parallel_for::apply(0, ntasks, &ts, [&](int j) { u[j] = j; });
+        });
+        for (int i = 0; i < ntasks; i++) {
+            EXPECT_EQ(i, u[i]);
+        }
+    }
+}
+
+TEST(task_group, work_stealing_foreign_thread) {
+    // Tasks pushed from a thread outside the pool are run by the pool.
+    task_system ts(4, true);
+    std::vector<int> v(1000, -1);
+    std::thread foreign([&] {
+        parallel_for::apply(0, v.size(), &ts, [&](int i) { v[i] = i; });
+    });
+    foreign.join();
+    for (int i = 0; i < (int)v.size(); i++) {
+        EXPECT_EQ(i, v[i]);
+    }
+}
+
+TEST(task_group, wait_policy) {
+    // Nested parallel loops complete under every wait policy and scheduler.
+    for (auto policy: {task_wait_policy::spin, task_wait_policy::yield, task_wait_policy::park}) {
+        for (bool work_stealing: {false, true}) {
+            task_system ts(4, work_stealing);
+            ts.set_wait_policy(policy);
+            EXPECT_EQ(policy, ts.wait_policy());
+
+            std::vector<std::atomic<int>> v(50);
+            parallel_for::apply(0, v.size(), &ts, [&](int i) {
+                parallel_for::apply(0, 100, &ts, [&](int) { ++v[i]; });
+            });
+            for (auto& x: v) {
+                EXPECT_EQ(100, x);
+            }
+        }
+    }
+}
+
+TEST(task_group, wait_time) {
+    for (auto policy: {task_wait_policy::spin, task_wait_policy::yield, task_wait_policy::park}) {
+        task_system ts(2);
+        ts.set_wait_policy(policy);
+        EXPECT_EQ(0., ts.wait_time());
+
+        // Wait from within a task of the highest asynchronous priority for a
+        // task of lower priority, which the waiting thread can not run itself.
+        ts.run([&] {
+            task_group g(&ts);
+            g.run([] { std::this_thread::sleep_for(std::chrono::milliseconds(20)); }, 0);
+            g.wait();
+        }, max_async_task_priority);
+
+        EXPECT_LE(0.015, ts.wait_time());
+    }
+}
+
+TEST(task_group, run_on) {
+    // Bound tasks run on their thread, under both schedulers, including
+    // tasks bound to the main thread.
+    for (bool work_stealing: {false, true}) {
+        task_system ts(4, work_stealing);
+        auto ids = ts.get_thread_ids();
+
+        constexpr unsigned n = 200;
+        std::vector<int> ran_on(n, -1);
+        task_group g(&ts);
+        for (unsigned i = 0; i<n; ++i) {
+            g.run_on(i%4, [&, i] {
+                ran_on[i] = ids.at(std::this_thread::get_id());
+                EXPECT_EQ(ran_on[i], ts.current_thread());
+            });
+        }
+        g.wait();
+
+        for (unsigned i = 0; i<n; ++i) {
+            EXPECT_EQ(int(i%4), ran_on[i]);
+        }
+    }
+}
+
+TEST(task_group, run_on_preferred) {
+    for (bool work_stealing: {false, true}) {
+        task_system ts(4, work_stealing);
+        auto ids = ts.get_thread_ids();
+
+        // Without a backlog, preferred tasks run on their thread.
+        std::vector<int> ran_on(4, -1);
+        task_group g(&ts);
+        for (unsigned i = 0; i<4; ++i) {
+            g.run_on(i, [&, i] { ran_on[i] = ids.at(std::this_thread::get_id()); }, 0, task_affinity::preferred);
+        }
+        g.wait();
+        for (unsigned i = 0; i<4; ++i) {
+            EXPECT_EQ(int(i), ran_on[i]);
+        }
+        EXPECT_EQ(0u, ts.migrations());
+
+        // Tasks of an overloaded thread are taken by the others: all tasks
+        // are run, and those not run by their thread are counted.
+        constexpr unsigned n = 40;
+        std::atomic<unsigned> not_owner{0};
+        for (unsigned i = 0; i<n; ++i) {
+            g.run_on(1, [&] {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                if (ids.at(std::this_thread::get_id())!=1) ++not_owner;
+            }, 0, task_affinity::preferred);
+        }
+        g.wait();
+        EXPECT_EQ(not_owner, ts.migrations());
+    }
+}
+
+TEST(task_system, bind_threads) {
+    // Binding pins the creating thread too: use a thread of its own.
+    std::thread t([] {
+        task_system ts(2);
+        EXPECT_FALSE(ts.threads_bound());
+        bool bound = ts.bind_threads();
+        EXPECT_EQ(bound, ts.threads_bound());
+
+        // Tasks still run after binding.
+        std::atomic<int> count{0};
+        parallel_for::apply(0, 100, &ts, [&](int) { ++count; });
+        EXPECT_EQ(100, count);
+    });
+    t.join();
+}
+
 TEST(enumerable_thread_specific, test) {
     for (int nthreads = 1; nthreads < 20; nthreads*=2) {
         task_system_handle ts = task_system_handle(new task_system(nthreads));
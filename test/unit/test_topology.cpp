@@ -0,0 +1,76 @@
+#include <stdexcept>
+#include <vector>
+
+#include "../gtest.h"
+
+#include <arborenv/topology.hpp>
+
+using ivec = std::vector<int>;
+
+TEST(topology, parse_cpu_list) {
+    using arbenv::parse_cpu_list;
+
+    // Empty lists, as of a NUMA node without CPUs.
+    EXPECT_EQ(ivec{}, parse_cpu_list(""));
+    EXPECT_EQ(ivec{}, parse_cpu_list(","));
+
+    // Single CPUs and ranges.
+    EXPECT_EQ((ivec{3}), parse_cpu_list("3"));
+    EXPECT_EQ((ivec{0, 1, 2, 3}), parse_cpu_list("0-3"));
+    EXPECT_EQ((ivec{0, 1, 2, 3, 8, 10, 11}), parse_cpu_list("0-3,8,10-11"));
+    EXPECT_EQ((ivec{5}), parse_cpu_list("5-5"));
+
+    // Strided ranges: the first `used` of every `group` CPUs.
+    EXPECT_EQ((ivec{0, 1, 4, 5, 8, 9, 12, 13}), parse_cpu_list("0-15:2/4"));
+    EXPECT_EQ((ivec{2, 5, 8}), parse_cpu_list("2-9:1/3"));
+    EXPECT_EQ((ivec{0, 1, 2, 3}), parse_cpu_list("0-3:2"));
+    EXPECT_EQ((ivec{0, 4, 16, 17}), parse_cpu_list("0-7:1/4,16-17"));
+
+    EXPECT_THROW(parse_cpu_list("0-7:0/4"), std::invalid_argument);
+    EXPECT_THROW(parse_cpu_list("0-7:4/2"), std::invalid_argument);
+}
+
+TEST(topology, nearest_node) {
+    using arbenv::nearest_node;
+
+    std::vector<ivec> nodes = {{0, 1, 2, 3}, {4, 5, 6, 7}, {}};
+
+    EXPECT_EQ(0, nearest_node({1, 2}, nodes));
+    EXPECT_EQ(1, nearest_node({3, 4, 5}, nodes));
+
+    // Ties go to the node of lower index.
+    EXPECT_EQ(0, nearest_node({3, 4}, nodes));
+
+    // No node holds any of the CPUs.
+    EXPECT_EQ(-1, nearest_node({}, nodes));
+    EXPECT_EQ(-1, nearest_node({8, 9}, nodes));
+    EXPECT_EQ(-1, nearest_node({0, 1}, {}));
+}
+
+TEST(topology, assign_nearest_gpus) {
+    using arbenv::assign_nearest_gpus;
+
+    // One GPU on each node, ranks in the reverse order of the GPUs.
+    EXPECT_EQ((ivec{1, 0}), assign_nearest_gpus({1, 0}, {0, 1}));
+
+    // Two ranks on node 0 with one GPU there: the first gets it, the second
+    // gets the GPU left on node 1.
+    EXPECT_EQ((ivec{1, 0}), assign_nearest_gpus({0, 0}, {1, 0}));
+
+    // Ranks on an unknown node take what is left once the others are served.
+    EXPECT_EQ((ivec{1, 0, 2}), assign_nearest_gpus({-1, 0, 1}, {0, 0, 1}));
+
+    // GPUs on an unknown node are taken in order.
+    EXPECT_EQ((ivec{0, 1}), assign_nearest_gpus({0, 1}, {-1, -1}));
+
+    // More ranks than GPUs: the last ranks go without.
+    EXPECT_EQ((ivec{0, 1, -1}), assign_nearest_gpus({0, 1, 0}, {0, 1}));
+
+    // More GPUs than nodes and than ranks.
+    EXPECT_EQ((ivec{2, 0}), assign_nearest_gpus({1, 0}, {0, 0, 1, 1}));
+    EXPECT_EQ((ivec{2, 3, 0}), assign_nearest_gpus({1, 1, 0}, {0, 0, 1, 1}));
+
+    // No ranks or no GPUs.
+    EXPECT_EQ(ivec{}, assign_nearest_gpus({}, {0, 1}));
+    EXPECT_EQ((ivec{-1, -1}), assign_nearest_gpus({0, 1}, {}));
+}
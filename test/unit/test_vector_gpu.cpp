@@ -4,6 +4,7 @@
 #include <type_traits>
 
 #include <memory/memory.hpp>
+#include <gpu_context.hpp>
 #include <util/span.hpp>
 
 //
@@ -121,3 +122,84 @@ TEST(vector, copy_d2d) {
     }
 }
 
+
+// fills and copies issued on streams of a gpu_context are ordered on the
+// stream of the issuing thread
+TEST(vector, copy_on_stream) {
+    auto context = make_gpu_context(0);
+    if (!context->has_gpu()) return;
+
+    const unsigned n_stream = context->num_streams();
+    ASSERT_LT(0u, n_stream);
+    std::vector<unsigned> ids;
+    for (unsigned i = 0; i<n_stream+1; ++i) {
+        ids.push_back(context->acquire_stream());
+    }
+    EXPECT_EQ(ids.front(), ids.back());
+
+    for (auto id: ids) {
+        context->set_stream(id);
+
+        double value = id+1.;
+        memory::device_vector<double> src(1000);
+        memory::device_vector<double> tgt(1000);
+        memory::fill(src, value);
+        memory::copy(src, tgt);
+
+        auto host = memory::on_host(tgt);
+        for (auto x: host) {
+            EXPECT_EQ(value, x);
+        }
+        context->synchronize_stream(id);
+    }
+    context->set_default_stream();
+}
+
+// copies from page locked staging vectors are asynchronous, and complete
+// once the stream has been synchronized
+TEST(vector, copy_h2d_staging) {
+    constexpr auto N = 10u;
+
+    using util::make_span;
+
+    for (auto n : make_span(0u, N)) {
+        double value = (n+1)/2.;
+        memory::staging_vector<double> src(n, value);
+        memory::device_vector<double> tgt(n);
+        memory::fill(tgt, std::numeric_limits<double>::quiet_NaN());
+
+        memory::copy(src, tgt);
+        memory::gpu_synchronize_stream();
+
+        for (auto i: make_span(0u, n)) {
+            EXPECT_EQ(double(tgt[i]), value);
+        }
+    }
+}
+
+// managed vectors are addressable on the host, and may be copied to and
+// from device vectors
+TEST(vector, managed) {
+    constexpr auto N = 10u;
+
+    using util::make_span;
+
+    for (auto n : make_span(1u, N)) {
+        double value = (n+1)/2.;
+        memory::managed_vector<double> v(n);
+        for (auto i: make_span(0u, n)) {
+            v[i] = value+i;
+        }
+
+        memory::device_vector<double> d(n);
+        memory::copy(memory::device_view<double>(v.data(), n), d);
+
+        memory::managed_vector<double> w(n);
+        memory::copy(d, memory::device_view<double>(w.data(), n));
+        memory::gpu_synchronize_stream();
+
+        for (auto i: make_span(0u, n)) {
+            EXPECT_EQ(value+i, w[i]);
+        }
+    }
+}
@@ -13,20 +13,25 @@
 #include "mechanisms/non_linear.hpp"
 #include "mechanisms/param_as_state.hpp"
 #include "mechanisms/post_events_syn.hpp"
+#include "mechanisms/quiescent_syn.hpp"
 #include "mechanisms/test0_kin_diff.hpp"
 #include "mechanisms/test_linear_state.hpp"
 #include "mechanisms/test_linear_init.hpp"
 #include "mechanisms/test_linear_init_shuffle.hpp"
 #include "mechanisms/test0_kin_conserve.hpp"
 #include "mechanisms/test0_kin_steadystate.hpp"
+#include "mechanisms/test0_kin_sdirk2.hpp"
+#include "mechanisms/test0_kin_expm.hpp"
 #include "mechanisms/test0_kin_compartment.hpp"
 #include "mechanisms/test1_kin_compartment.hpp"
 #include "mechanisms/test1_kin_diff.hpp"
 #include "mechanisms/test1_kin_conserve.hpp"
 #include "mechanisms/test2_kin_diff.hpp"
+#include "mechanisms/test2_kin_sdirk2.hpp"
 #include "mechanisms/test3_kin_diff.hpp"
 #include "mechanisms/test4_kin_compartment.hpp"
 #include "mechanisms/test1_kin_steadystate.hpp"
+#include "mechanisms/test1_kin_expm.hpp"
 #include "mechanisms/fixed_ica_current.hpp"
 #include "mechanisms/point_ica_current.hpp"
 #include "mechanisms/linear_ca_conc.hpp"
@@ -68,19 +73,24 @@ mechanism_catalogue make_unit_test_catalogue(const mechanism_catalogue& from) {
     ADD_MECH(cat, diam_test)
     ADD_MECH(cat, param_as_state)
     ADD_MECH(cat, post_events_syn)
+    ADD_MECH(cat, quiescent_syn)
     ADD_MECH(cat, test_linear_state)
     ADD_MECH(cat, test_linear_init)
     ADD_MECH(cat, test_linear_init_shuffle)
     ADD_MECH(cat, test0_kin_diff)
     ADD_MECH(cat, test0_kin_conserve)
     ADD_MECH(cat, test0_kin_steadystate)
+    ADD_MECH(cat, test0_kin_sdirk2)
+    ADD_MECH(cat, test0_kin_expm)
     ADD_MECH(cat, test0_kin_compartment)
     ADD_MECH(cat, test1_kin_diff)
     ADD_MECH(cat, test1_kin_conserve)
     ADD_MECH(cat, test2_kin_diff)
+    ADD_MECH(cat, test2_kin_sdirk2)
     ADD_MECH(cat, test3_kin_diff)
     ADD_MECH(cat, test1_kin_steadystate)
     ADD_MECH(cat, test1_kin_compartment)
+    ADD_MECH(cat, test1_kin_expm)
     ADD_MECH(cat, test4_kin_compartment)
     ADD_MECH(cat, fixed_ica_current)
     ADD_MECH(cat, non_linear)